@@ -182,6 +182,9 @@ extern "C" {
   XX(GETADDRINFO, getaddrinfo)                                                \
   XX(GETNAMEINFO, getnameinfo)                                                \
   XX(RANDOM, random)                                                          \
+  XX(SPLICE, splice)                                                          \
+  XX(PROCESS_STATS, process_stats)                                            \
+  XX(GETNAMEINFO_MANY, getnameinfo_many)                                      \
 
 typedef enum {
 #define XX(code, _) UV_ ## code = UV__ ## code,
@@ -196,7 +199,9 @@ typedef enum {
   UV_HANDLE_TYPE_MAP(XX)
 #undef XX
   UV_FILE,
-  UV_HANDLE_TYPE_MAX
+  UV_HANDLE_TYPE_MAX,
+  /* Past UV_HANDLE_TYPE_MAX so that it and UV_FILE keep their values. */
+  UV_NETIF = 0x100
 } uv_handle_type;
 
 typedef enum {
@@ -224,10 +229,13 @@ typedef struct uv_prepare_s uv_prepare_t;
 typedef struct uv_check_s uv_check_t;
 typedef struct uv_idle_s uv_idle_t;
 typedef struct uv_async_s uv_async_t;
+typedef struct uv_channel_s uv_channel_t;
+typedef struct uv_shm_channel_s uv_shm_channel_t;
 typedef struct uv_process_s uv_process_t;
 typedef struct uv_fs_event_s uv_fs_event_t;
 typedef struct uv_fs_poll_s uv_fs_poll_t;
 typedef struct uv_signal_s uv_signal_t;
+typedef struct uv_netif_s uv_netif_t;
 
 /* Request types. */
 typedef struct uv_req_s uv_req_t;
@@ -239,20 +247,78 @@ typedef struct uv_connect_s uv_connect_t;
 typedef struct uv_udp_send_s uv_udp_send_t;
 typedef struct uv_fs_s uv_fs_t;
 typedef struct uv_work_s uv_work_t;
+typedef struct uv_parallel_for_s uv_parallel_for_t;
 typedef struct uv_random_s uv_random_t;
+typedef struct uv_splice_s uv_splice_t;
+typedef struct uv_process_stats_s uv_process_stats_t;
+typedef struct uv_getnameinfo_many_s uv_getnameinfo_many_t;
 
 /* None of the above. */
 typedef struct uv_env_item_s uv_env_item_t;
 typedef struct uv_cpu_info_s uv_cpu_info_t;
+typedef struct uv_cpu_sampler_s uv_cpu_sampler_t;
+typedef struct uv_resource_constraints_s uv_resource_constraints_t;
 typedef struct uv_interface_address_s uv_interface_address_t;
 typedef struct uv_dirent_s uv_dirent_t;
+typedef struct uv_dirent_packed_s uv_dirent_packed_t;
 typedef struct uv_passwd_s uv_passwd_t;
 typedef struct uv_utsname_s uv_utsname_t;
 typedef struct uv_statfs_s uv_statfs_t;
+typedef struct uv_channel_msg_s uv_channel_msg_t;
+typedef struct uv_spsc_ring_s uv_spsc_ring_t;
+typedef struct uv_mpmc_ring_s uv_mpmc_ring_t;
+typedef struct uv_tcp_info_s uv_tcp_info_t;
+typedef struct uv_fs_walk_s uv_fs_walk_t;
+typedef struct uv_fs_walk_entry_s uv_fs_walk_entry_t;
+typedef struct uv_fs_walk_options_s uv_fs_walk_options_t;
+typedef struct uv_fs_copy_s uv_fs_copy_t;
+typedef struct uv_fs_copy_options_s uv_fs_copy_options_t;
+typedef struct uv_fs_reader_s uv_fs_reader_t;
+typedef struct uv_fs_reader_options_s uv_fs_reader_options_t;
+typedef struct uv_fs_pump_s uv_fs_pump_t;
+typedef struct uv_fs_cache_s uv_fs_cache_t;
+typedef struct uv_fs_cache_req_s uv_fs_cache_req_t;
+typedef struct uv_fs_cache_options_s uv_fs_cache_options_t;
+typedef struct uv_fs_sync_group_s uv_fs_sync_group_t;
+typedef struct uv_fs_sync_req_s uv_fs_sync_req_t;
+typedef struct uv_getaddrinfo_cache_options_s uv_getaddrinfo_cache_options_t;
+typedef struct uv_getnameinfo_cache_options_s uv_getnameinfo_cache_options_t;
+typedef struct uv_defer_s uv_defer_t;
+typedef struct uv_completion_s uv_completion_t;
+typedef struct uv_read_result_s uv_read_result_t;
+typedef struct uv_shared_buf_s uv_shared_buf_t;
+typedef struct uv_tcp_connect_host_s uv_tcp_connect_host_t;
+typedef struct uv_tcp_connect_host_options_s uv_tcp_connect_host_options_t;
+typedef struct uv_metrics_s uv_metrics_t;
+typedef struct uv_metrics_lag_s uv_metrics_lag_t;
+typedef struct uv_handle_counts_s uv_handle_counts_t;
+typedef struct uv_handle_pool_stats_s uv_handle_pool_stats_t;
+typedef struct uv_io_stats_s uv_io_stats_t;
+typedef struct uv_slow_callback_info_s uv_slow_callback_info_t;
+typedef struct uv_trace_event_s uv_trace_event_t;
+typedef struct uv_threadpool_metrics_s uv_threadpool_metrics_t;
+typedef struct uv_loop_group_s uv_loop_group_t;
 
 typedef enum {
   UV_LOOP_BLOCK_SIGNAL = 0,
-  UV_METRICS_IDLE_TIME
+  UV_METRICS_IDLE_TIME,
+  UV_LOOP_USE_IO_URING,
+  UV_LOOP_USE_TIMER_WHEEL,
+  UV_LOOP_THREADPOOL_SIZE,
+  UV_LOOP_ACCEPT_BATCH,
+  UV_LOOP_USE_DNS_RESOLVER,
+  UV_METRICS_PHASE_TIME,
+  UV_LOOP_SLOW_CALLBACK,
+  UV_METRICS_LAG,
+  UV_LOOP_EDGE_TRIGGERED,
+  UV_LOOP_BUSY_POLL,
+  UV_LOOP_COARSE_CLOCK,
+  UV_LOOP_EVENT_BUFFER_SIZE,
+  UV_LOOP_THREADPOOL_AFFINITY,
+  UV_LOOP_HIGH_RES_TIMERS,
+  UV_LOOP_IO_BUDGET,
+  UV_LOOP_REALPATH_CACHE,
+  UV_LOOP_HUGE_PAGES
 } uv_loop_option;
 
 typedef enum {
@@ -270,12 +336,39 @@ typedef void* (*uv_realloc_func)(void* ptr, size_t size);
 typedef void* (*uv_calloc_func)(size_t count, size_t size);
 typedef void (*uv_free_func)(void* ptr);
 
+/* The subsystem an internal allocation is for, see
+ * uv_replace_allocator_tagged().
+ */
+typedef enum {
+  UV_ALLOC_TAG_OTHER = 0,
+  UV_ALLOC_TAG_LOOP,
+  UV_ALLOC_TAG_STREAM,
+  UV_ALLOC_TAG_UDP,
+  UV_ALLOC_TAG_FS,
+  UV_ALLOC_TAG_DNS,
+  UV_ALLOC_TAG_PROCESS,
+  UV_ALLOC_TAG_THREADPOOL,
+  UV_ALLOC_TAG_MAX
+} uv_alloc_tag;
+
+typedef void* (*uv_tagged_malloc_func)(size_t size, uv_alloc_tag tag);
+typedef void* (*uv_tagged_realloc_func)(void* ptr,
+                                        size_t size,
+                                        uv_alloc_tag tag);
+typedef void* (*uv_tagged_calloc_func)(size_t count,
+                                       size_t size,
+                                       uv_alloc_tag tag);
+
 UV_EXTERN void uv_library_shutdown(void);
 
 UV_EXTERN int uv_replace_allocator(uv_malloc_func malloc_func,
                                    uv_realloc_func realloc_func,
                                    uv_calloc_func calloc_func,
                                    uv_free_func free_func);
+UV_EXTERN int uv_replace_allocator_tagged(uv_tagged_malloc_func malloc_func,
+                                          uv_tagged_realloc_func realloc_func,
+                                          uv_tagged_calloc_func calloc_func,
+                                          uv_free_func free_func);
 
 UV_EXTERN uv_loop_t* uv_default_loop(void);
 UV_EXTERN int uv_loop_init(uv_loop_t* loop);
@@ -297,6 +390,12 @@ UV_EXTERN int uv_loop_alive(const uv_loop_t* loop);
 UV_EXTERN int uv_loop_configure(uv_loop_t* loop, uv_loop_option option, ...);
 UV_EXTERN int uv_loop_fork(uv_loop_t* loop);
 
+typedef int (*uv_loop_fork_cb)(uv_loop_t* loop, uv_os_fd_t fd, void* arg);
+
+UV_EXTERN int uv_loop_fork_ex(uv_loop_t* loop,
+                              uv_loop_fork_cb rearm_cb,
+                              void* arg);
+
 UV_EXTERN int uv_run(uv_loop_t*, uv_run_mode mode);
 UV_EXTERN void uv_stop(uv_loop_t*);
 
@@ -313,25 +412,45 @@ UV_EXTERN int uv_backend_timeout(const uv_loop_t*);
 typedef void (*uv_alloc_cb)(uv_handle_t* handle,
                             size_t suggested_size,
                             uv_buf_t* buf);
+typedef void (*uv_alloc_vec_cb)(uv_handle_t* handle,
+                                size_t suggested_size,
+                                uv_buf_t bufs[],
+                                unsigned int* nbufs);
 typedef void (*uv_read_cb)(uv_stream_t* stream,
                            ssize_t nread,
                            const uv_buf_t* buf);
 typedef void (*uv_write_cb)(uv_write_t* req, int status);
+typedef void (*uv_write_fanout_cb)(uv_shared_buf_t* buf, unsigned int nfailed);
 typedef void (*uv_connect_cb)(uv_connect_t* req, int status);
 typedef void (*uv_shutdown_cb)(uv_shutdown_t* req, int status);
+typedef void (*uv_splice_cb)(uv_splice_t* req, int status);
+typedef void (*uv_write_watermark_cb)(uv_stream_t* stream, int above);
+typedef void (*uv_tcp_writable_cb)(uv_tcp_t* handle);
 typedef void (*uv_connection_cb)(uv_stream_t* server, int status);
 typedef void (*uv_close_cb)(uv_handle_t* handle);
 typedef void (*uv_poll_cb)(uv_poll_t* handle, int status, int events);
+typedef void (*uv_shm_channel_cb)(uv_shm_channel_t* channel,
+                                  const uv_buf_t* msg);
+typedef void (*uv_shm_channel_writable_cb)(uv_shm_channel_t* channel);
 typedef void (*uv_timer_cb)(uv_timer_t* handle);
 typedef void (*uv_async_cb)(uv_async_t* handle);
+typedef void (*uv_channel_cb)(uv_channel_t* channel, uv_channel_msg_t* msg);
+typedef void (*uv_loop_group_cb)(uv_loop_group_t* group,
+                                 uv_loop_t* loop,
+                                 uv_channel_msg_t* msg);
 typedef void (*uv_prepare_cb)(uv_prepare_t* handle);
 typedef void (*uv_check_cb)(uv_check_t* handle);
 typedef void (*uv_idle_cb)(uv_idle_t* handle);
+typedef void (*uv_defer_cb)(uv_defer_t* req);
 typedef void (*uv_exit_cb)(uv_process_t*, int64_t exit_status, int term_signal);
 typedef void (*uv_walk_cb)(uv_handle_t* handle, void* arg);
 typedef void (*uv_fs_cb)(uv_fs_t* req);
 typedef void (*uv_work_cb)(uv_work_t* req);
 typedef void (*uv_after_work_cb)(uv_work_t* req, int status);
+typedef void (*uv_parallel_for_cb)(uv_parallel_for_t* pfor,
+                                   size_t begin,
+                                   size_t end);
+typedef void (*uv_parallel_for_done_cb)(uv_parallel_for_t* pfor, int status);
 typedef void (*uv_getaddrinfo_cb)(uv_getaddrinfo_t* req,
                                   int status,
                                   struct addrinfo* res);
@@ -339,10 +458,13 @@ typedef void (*uv_getnameinfo_cb)(uv_getnameinfo_t* req,
                                   int status,
                                   const char* hostname,
                                   const char* service);
+typedef void (*uv_getnameinfo_many_cb)(uv_getnameinfo_many_t* req,
+                                       int status);
 typedef void (*uv_random_cb)(uv_random_t* req,
                              int status,
                              void* buf,
                              size_t buflen);
+typedef void (*uv_process_stats_cb)(uv_process_stats_t* req, int status);
 
 typedef struct {
   long tv_sec;
@@ -375,12 +497,49 @@ typedef void (*uv_fs_event_cb)(uv_fs_event_t* handle,
                                int events,
                                int status);
 
+typedef struct {
+  const char* filename;
+  int events;
+} uv_fs_event_batch_entry_t;
+
+typedef void (*uv_fs_event_batch_cb)(uv_fs_event_t* handle,
+                                     const uv_fs_event_batch_entry_t* entries,
+                                     size_t nentries,
+                                     int status);
+
 typedef void (*uv_fs_poll_cb)(uv_fs_poll_t* handle,
                               int status,
                               const uv_stat_t* prev,
                               const uv_stat_t* curr);
 
+typedef void (*uv_fs_walk_cb)(uv_fs_walk_t* walk,
+                              int status,
+                              const uv_fs_walk_entry_t* entries,
+                              unsigned int nentries);
+typedef int (*uv_fs_walk_filter_cb)(uv_fs_walk_t* walk,
+                                    const uv_fs_walk_entry_t* dir);
+
+typedef void (*uv_tcp_connect_host_cb)(uv_tcp_connect_host_t* req,
+                                       int status);
+
+typedef void (*uv_fs_copy_cb)(uv_fs_copy_t* copy, int status);
+typedef void (*uv_fs_copy_progress_cb)(uv_fs_copy_t* copy,
+                                       uint64_t copied,
+                                       uint64_t total);
+typedef void (*uv_fs_reader_cb)(uv_fs_reader_t* reader,
+                                ssize_t nread,
+                                const uv_buf_t* buf);
+typedef void (*uv_fs_reader_close_cb)(uv_fs_reader_t* reader);
+typedef void (*uv_fs_pump_cb)(uv_fs_pump_t* pump, int status);
+typedef void (*uv_fs_cache_cb)(uv_fs_cache_req_t* req, int status);
+typedef void (*uv_fs_cache_close_cb)(uv_fs_cache_t* cache);
+typedef void (*uv_fs_sync_cb)(uv_fs_sync_req_t* req, int status);
+
 typedef void (*uv_signal_cb)(uv_signal_t* handle, int signum);
+typedef void (*uv_netif_cb)(uv_netif_t* handle,
+                            int events,
+                            const uv_interface_address_t* address,
+                            int status);
 
 
 typedef enum {
@@ -429,6 +588,32 @@ struct uv_shutdown_s {
 };
 
 
+/*
+ * Building libuv and its users with UV_COMPACT_HANDLES defined selects a
+ * smaller, incompatible handle layout. The flags fill the padding after the
+ * type and every handle type only gets the reserved slots it uses, through
+ * UV_HANDLE_RESERVED_FIELDS().
+ */
+#if defined(UV_COMPACT_HANDLES)
+#define UV_HANDLE_FIELDS                                                      \
+  /* public */                                                                \
+  void* data;                                                                 \
+  /* read-only */                                                             \
+  uv_loop_t* loop;                                                            \
+  uv_handle_type type;                                                        \
+  /* private */                                                               \
+  unsigned int flags;                                                         \
+  uv_close_cb close_cb;                                                       \
+  void* handle_queue[2];                                                      \
+  UV_HANDLE_PRIVATE_FIELDS                                                    \
+
+#define UV_HANDLE_RESERVED_FIELDS(n)                                          \
+  union {                                                                     \
+    int fd;                                                                   \
+    void* reserved[n];                                                        \
+  } u;                                                                        \
+
+#else
 #define UV_HANDLE_FIELDS                                                      \
   /* public */                                                                \
   void* data;                                                                 \
@@ -444,6 +629,9 @@ struct uv_shutdown_s {
   } u;                                                                        \
   UV_HANDLE_PRIVATE_FIELDS                                                    \
 
+#define UV_HANDLE_RESERVED_FIELDS(n) /* in UV_HANDLE_FIELDS */
+#endif
+
 /* The abstract base class of all handles. */
 struct uv_handle_s {
   UV_HANDLE_FIELDS
@@ -455,12 +643,15 @@ UV_EXTERN const char* uv_handle_type_name(uv_handle_type type);
 UV_EXTERN void* uv_handle_get_data(const uv_handle_t* handle);
 UV_EXTERN uv_loop_t* uv_handle_get_loop(const uv_handle_t* handle);
 UV_EXTERN void uv_handle_set_data(uv_handle_t* handle, void* data);
+UV_EXTERN void* uv_handle_alloc(uv_loop_t* loop, uv_handle_type type);
 
 UV_EXTERN size_t uv_req_size(uv_req_type type);
 UV_EXTERN void* uv_req_get_data(const uv_req_t* req);
 UV_EXTERN void uv_req_set_data(uv_req_t* req, void* data);
 UV_EXTERN uv_req_type uv_req_get_type(const uv_req_t* req);
 UV_EXTERN const char* uv_req_type_name(uv_req_type type);
+UV_EXTERN void* uv_req_alloc(uv_loop_t* loop, uv_req_type type);
+UV_EXTERN void uv_req_free(uv_loop_t* loop, void* req);
 
 UV_EXTERN int uv_is_active(const uv_handle_t* handle);
 
@@ -470,10 +661,63 @@ UV_EXTERN void uv_walk(uv_loop_t* loop, uv_walk_cb walk_cb, void* arg);
 UV_EXTERN void uv_print_all_handles(uv_loop_t* loop, FILE* stream);
 UV_EXTERN void uv_print_active_handles(uv_loop_t* loop, FILE* stream);
 
+enum {
+  UV_SNAPSHOT_ACTIVE = 1,
+  UV_SNAPSHOT_REF = 2,
+  UV_SNAPSHOT_CLOSING = 4,
+  UV_SNAPSHOT_INTERNAL = 8
+};
+
+typedef struct {
+  const uv_handle_t* handle;
+  uv_handle_type type;
+  unsigned int flags;
+  uv_os_fd_t fd;
+  size_t write_queue_size;
+  uint64_t timer_due;
+  uint64_t timer_repeat;
+} uv_handle_snapshot_t;
+
+UV_EXTERN int uv_loop_snapshot(const uv_loop_t* loop,
+                               uv_handle_snapshot_t* handles,
+                               size_t* count);
+
 UV_EXTERN void uv_close(uv_handle_t* handle, uv_close_cb close_cb);
+UV_EXTERN void uv_close_many(uv_handle_t* handles[],
+                             unsigned int nhandles,
+                             uv_close_cb close_cb);
+UV_EXTERN int uv_close_all(uv_loop_t* loop,
+                           uv_handle_type type,
+                           uv_close_cb close_cb);
 
 UV_EXTERN int uv_send_buffer_size(uv_handle_t* handle, int* value);
 UV_EXTERN int uv_recv_buffer_size(uv_handle_t* handle, int* value);
+UV_EXTERN int uv_pacing_rate(uv_handle_t* handle, uint64_t* value);
+
+struct uv_io_stats_s {
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+  uint64_t read_calls;   /* System calls, including the ones that failed. */
+  uint64_t write_calls;
+  uint64_t read_eagain;  /* Calls that found nothing to read. */
+  uint64_t write_eagain;  /* Calls that found the socket buffer full. */
+};
+
+UV_EXTERN int uv_handle_set_io_stats(uv_handle_t* handle, int enable);
+UV_EXTERN int uv_handle_get_io_stats(const uv_handle_t* handle,
+                                     uv_io_stats_t* stats);
+
+typedef enum {
+  UV_IO_PRIORITY_NORMAL = 0,
+  UV_IO_PRIORITY_HIGH,
+  UV_IO_PRIORITY_LOW
+} uv_io_priority;
+
+UV_EXTERN int uv_handle_set_io_priority(uv_handle_t* handle,
+                                        uv_io_priority priority);
+
+UV_EXTERN int uv_handle_detach(uv_handle_t* handle);
+UV_EXTERN int uv_handle_attach(uv_handle_t* handle, uv_loop_t* loop);
 
 UV_EXTERN int uv_fileno(const uv_handle_t* handle, uv_os_fd_t* fd);
 
@@ -487,6 +731,7 @@ UV_EXTERN int uv_socketpair(int type,
                             int flags1);
 
 #define UV_STREAM_FIELDS                                                      \
+  UV_HANDLE_RESERVED_FIELDS(4)                                                \
   /* number of bytes queued for writing */                                    \
   size_t write_queue_size;                                                    \
   uv_alloc_cb alloc_cb;                                                       \
@@ -515,6 +760,47 @@ UV_EXTERN int uv_read_start(uv_stream_t*,
                             uv_alloc_cb alloc_cb,
                             uv_read_cb read_cb);
 UV_EXTERN int uv_read_stop(uv_stream_t*);
+UV_EXTERN int uv_read_start_pooled(uv_stream_t*, uv_read_cb read_cb);
+UV_EXTERN int uv_read_start_vec(uv_stream_t*,
+                                uv_alloc_vec_cb alloc_cb,
+                                uv_read_cb read_cb);
+UV_EXTERN void uv_read_buf_release(uv_loop_t* loop, const uv_buf_t* buf);
+
+typedef struct uv_stream_read_options_s {
+  size_t min_size;  /* Bounds of the size passed to alloc_cb. */
+  size_t max_size;
+  unsigned int max_reads;  /* Reads per loop iteration, 0 for the default. */
+  size_t max_bytes;  /* Bytes per loop iteration, 0 for no limit. */
+} uv_stream_read_options_t;
+
+UV_EXTERN int uv_stream_set_read_options(
+    uv_stream_t* stream,
+    const uv_stream_read_options_t* options);
+
+typedef struct uv_stream_accept_policy_s {
+  unsigned int max_lag;  /* Milliseconds since the last poll, 0 for none. */
+  unsigned int max_events;  /* Events of the last poll, 0 for no limit. */
+} uv_stream_accept_policy_t;
+
+UV_EXTERN int uv_stream_set_accept_policy(
+    uv_stream_t* server,
+    const uv_stream_accept_policy_t* policy);
+
+struct uv_read_result_s {
+  uv_stream_t* stream;
+  ssize_t nread;
+  uv_buf_t buf;
+};
+
+typedef void (*uv_read_batch_cb)(uv_loop_t* loop,
+                                 uv_read_result_t* results,
+                                 size_t nresults);
+
+UV_EXTERN void uv_loop_set_read_batch_cb(uv_loop_t* loop,
+                                         uv_read_batch_cb cb);
+UV_EXTERN void uv_read_batched_cb(uv_stream_t* stream,
+                                  ssize_t nread,
+                                  const uv_buf_t* buf);
 
 UV_EXTERN int uv_write(uv_write_t* req,
                        uv_stream_t* handle,
@@ -527,6 +813,43 @@ UV_EXTERN int uv_write2(uv_write_t* req,
                         unsigned int nbufs,
                         uv_stream_t* send_handle,
                         uv_write_cb cb);
+UV_EXTERN int uv_write_fds(uv_write_t* req,
+                           uv_stream_t* handle,
+                           const uv_buf_t bufs[],
+                           unsigned int nbufs,
+                           const uv_os_fd_t fds[],
+                           unsigned int nfds,
+                           uv_write_cb cb);
+UV_EXTERN int uv_write_copy(uv_stream_t* handle,
+                            const uv_buf_t bufs[],
+                            unsigned int nbufs);
+
+struct uv_shared_buf_s {
+  uv_buf_t buf;
+  void* data;
+  /* private */
+  unsigned int refcount;
+};
+
+UV_EXTERN uv_shared_buf_t* uv_shared_buf_new(size_t size);
+UV_EXTERN uv_shared_buf_t* uv_shared_buf_ref(uv_shared_buf_t* buf);
+UV_EXTERN void uv_shared_buf_unref(uv_shared_buf_t* buf);
+UV_EXTERN int uv_write_fanout(uv_stream_t* handles[],
+                              unsigned int nhandles,
+                              uv_shared_buf_t* buf,
+                              uv_write_fanout_cb cb);
+UV_EXTERN int uv_stream_sendfile(uv_write_t* req,
+                                 uv_stream_t* handle,
+                                 uv_file fd,
+                                 int64_t offset,
+                                 size_t length,
+                                 uv_write_cb cb);
+UV_EXTERN int uv_stream_set_write_watermarks(uv_stream_t* handle,
+                                             size_t low,
+                                             size_t high,
+                                             uv_write_watermark_cb cb);
+UV_EXTERN int uv_stream_cork(uv_stream_t* handle);
+UV_EXTERN int uv_stream_uncork(uv_stream_t* handle);
 UV_EXTERN int uv_try_write(uv_stream_t* handle,
                            const uv_buf_t bufs[],
                            unsigned int nbufs);
@@ -545,6 +868,22 @@ struct uv_write_s {
 };
 
 
+UV_EXTERN int uv_stream_splice(uv_splice_t* req,
+                               uv_stream_t* src,
+                               uv_stream_t* dst,
+                               uv_splice_cb cb);
+
+/* uv_splice_t is a subclass of uv_req_t. */
+struct uv_splice_s {
+  UV_REQ_FIELDS
+  uv_stream_t* src;
+  uv_stream_t* dst;
+  uint64_t nbytes;  /* Bytes moved so far. */
+  uv_splice_cb cb;
+  UV_SPLICE_PRIVATE_FIELDS
+};
+
+
 UV_EXTERN int uv_is_readable(const uv_stream_t* handle);
 UV_EXTERN int uv_is_writable(const uv_stream_t* handle);
 
@@ -568,19 +907,47 @@ UV_EXTERN int uv_tcp_init(uv_loop_t*, uv_tcp_t* handle);
 UV_EXTERN int uv_tcp_init_ex(uv_loop_t*, uv_tcp_t* handle, unsigned int flags);
 UV_EXTERN int uv_tcp_open(uv_tcp_t* handle, uv_os_sock_t sock);
 UV_EXTERN int uv_tcp_nodelay(uv_tcp_t* handle, int enable);
+UV_EXTERN int uv_tcp_zerocopy(uv_tcp_t* handle, size_t threshold);
+UV_EXTERN int uv_tcp_set_notsent_lowat(uv_tcp_t* handle,
+                                       unsigned int lowat,
+                                       uv_tcp_writable_cb cb);
+UV_EXTERN int uv_tcp_recv_timestamps(uv_tcp_t* handle, int enable);
+UV_EXTERN int uv_tcp_get_read_timestamp(const uv_tcp_t* handle,
+                                        uv_timespec_t* ts);
+
+typedef enum {
+  UV_TLS_TX = 1,
+  UV_TLS_RX = 2
+} uv_tls_direction;
+
+UV_EXTERN int uv_tcp_tls_offload(uv_tcp_t* handle,
+                                 uv_tls_direction direction,
+                                 const void* crypto_info,
+                                 size_t size);
+UV_EXTERN int uv_tcp_set_incoming_cpu(uv_tcp_t* handle, int cpu);
 UV_EXTERN int uv_tcp_keepalive(uv_tcp_t* handle,
                                int enable,
                                unsigned int delay);
 UV_EXTERN int uv_tcp_simultaneous_accepts(uv_tcp_t* handle, int enable);
+UV_EXTERN int uv_tcp_set_pending_accepts(uv_tcp_t* handle,
+                                         unsigned int min,
+                                         unsigned int max);
 
 enum uv_tcp_flags {
   /* Used with uv_tcp_bind, when an IPv6 address is used. */
-  UV_TCP_IPV6ONLY = 1
+  UV_TCP_IPV6ONLY = 1,
+
+  /* Used with uv_tcp_bind, lets several sockets bind the same address and
+   * port. The kernel balances incoming connections between them.
+   */
+  UV_TCP_REUSEPORT = 2
 };
 
 UV_EXTERN int uv_tcp_bind(uv_tcp_t* handle,
                           const struct sockaddr* addr,
                           unsigned int flags);
+UV_EXTERN int uv_tcp_reuseport_steer_by_cpu(uv_tcp_t* handle);
+UV_EXTERN int uv_tcp_set_busy_poll(uv_tcp_t* handle, unsigned int usec);
 UV_EXTERN int uv_tcp_getsockname(const uv_tcp_t* handle,
                                  struct sockaddr* name,
                                  int* namelen);
@@ -592,6 +959,53 @@ UV_EXTERN int uv_tcp_connect(uv_connect_t* req,
                              uv_tcp_t* handle,
                              const struct sockaddr* addr,
                              uv_connect_cb cb);
+UV_EXTERN int uv_tcp_connect_fastopen(uv_connect_t* req,
+                                      uv_tcp_t* handle,
+                                      const struct sockaddr* addr,
+                                      const uv_buf_t bufs[],
+                                      unsigned int nbufs,
+                                      uv_connect_cb cb);
+UV_EXTERN int uv_tcp_fastopen(uv_tcp_t* handle, int qlen);
+
+struct uv_tcp_connect_host_options_s {
+  unsigned int attempt_delay;  /* In milliseconds, 0 means 250. */
+  int family;                  /* AF_UNSPEC, AF_INET or AF_INET6. */
+};
+
+struct uv_tcp_connect_host_s {
+  void* data;
+  /* Read-only. */
+  uv_tcp_t* handle;
+  /* Private, don't touch. */
+  void* connect_ctx;
+};
+
+UV_EXTERN int uv_tcp_connect_host(uv_tcp_connect_host_t* req,
+                                  uv_tcp_t* handle,
+                                  const char* host,
+                                  const char* service,
+                                  const uv_tcp_connect_host_options_t* options,
+                                  uv_tcp_connect_host_cb cb);
+UV_EXTERN int uv_tcp_connect_host_cancel(uv_tcp_connect_host_t* req);
+UV_EXTERN int uv_tcp_defer_accept(uv_tcp_t* handle, unsigned int timeout);
+
+struct uv_tcp_info_s {
+  uint64_t rtt;             /* Smoothed round trip time, in microseconds. */
+  uint64_t rtt_var;         /* Its mean deviation, in microseconds. */
+  uint64_t min_rtt;         /* Lowest round trip time seen, in microseconds. */
+  uint64_t rto;             /* Retransmission timeout, in microseconds. */
+  uint64_t mss;             /* Sender maximum segment size, in bytes. */
+  uint64_t snd_cwnd;        /* Congestion window, in segments. */
+  uint64_t snd_ssthresh;    /* Slow start threshold, in segments. */
+  uint64_t total_retrans;   /* Segments retransmitted. */
+  uint64_t delivery_rate;   /* Recent delivery rate, in bytes per second. */
+  uint64_t bytes_sent;      /* Including retransmissions. */
+  uint64_t bytes_retrans;
+  uint64_t bytes_received;
+  uint64_t spare[4];
+};
+
+UV_EXTERN int uv_tcp_get_info(const uv_tcp_t* handle, uv_tcp_info_t* info);
 
 /* uv_connect_t is a subclass of uv_req_t. */
 struct uv_connect_s {
@@ -642,10 +1056,48 @@ enum uv_udp_flags {
    * This flag is no-op on platforms other than Linux.
    */
   UV_UDP_LINUX_RECVERR = 32,
+  /*
+   * Indicates if UDP_GRO will be set when binding the handle. The Linux
+   * kernel then coalesces consecutive datagrams from the same peer into a
+   * single buffer, see UV_UDP_GRO_SEGMENTS. This flag is no-op on platforms
+   * other than Linux.
+   */
+  UV_UDP_LINUX_GRO = 64,
+  /*
+   * Indicates that the buffer holds several datagrams coalesced by the
+   * kernel, each uv_udp_get_recv_segment_size() bytes long except possibly
+   * the last one. Used in uv_udp_recv_cb.
+   */
+  UV_UDP_GRO_SEGMENTS = 128,
   /*
    * Indicates that recvmmsg should be used, if available.
    */
-  UV_UDP_RECVMMSG = 256
+  UV_UDP_RECVMMSG = 256,
+  /*
+   * Indicates if SO_REUSEPORT (SO_REUSEPORT_LB on FreeBSD) will be set when
+   * binding the handle. Unlike UV_UDP_REUSEADDR, the kernel then spreads the
+   * incoming datagrams over all the sockets bound to the address, so each
+   * event loop (thread) can own one of them.
+   */
+  UV_UDP_REUSEPORT = 512,
+  /*
+   * Indicates that datagrams should be received with Registered I/O, if
+   * available. Windows only, ignored on other platforms.
+   */
+  UV_UDP_RIO = 2048,
+  /*
+   * Indicates if IP_PKTINFO/IPV6_RECVPKTINFO will be set when binding the
+   * handle, so uv_udp_get_recv_dstaddr() tells which local address each
+   * datagram was sent to. Linux only, binding fails with UV_ENOTSUP on other
+   * platforms.
+   */
+  UV_UDP_PKTINFO = 4096,
+  /*
+   * Indicates if SO_TIMESTAMPING will be set when binding the handle, so
+   * uv_udp_get_recv_timestamp() tells when each datagram came in. Linux only,
+   * binding fails with UV_ENOTSUP on other platforms.
+   */
+  UV_UDP_TIMESTAMP = 8192
 };
 
 typedef void (*uv_udp_send_cb)(uv_udp_send_t* req, int status);
@@ -658,6 +1110,7 @@ typedef void (*uv_udp_recv_cb)(uv_udp_t* handle,
 /* uv_udp_t is a subclass of uv_handle_t. */
 struct uv_udp_s {
   UV_HANDLE_FIELDS
+  UV_HANDLE_RESERVED_FIELDS(4)
   /* read-only */
   /*
    * Number of bytes queued for sending. This field strictly shows how much
@@ -686,6 +1139,8 @@ UV_EXTERN int uv_udp_bind(uv_udp_t* handle,
                           const struct sockaddr* addr,
                           unsigned int flags);
 UV_EXTERN int uv_udp_connect(uv_udp_t* handle, const struct sockaddr* addr);
+UV_EXTERN int uv_udp_reuseport_steer_by_cpu(uv_udp_t* handle);
+UV_EXTERN int uv_udp_set_busy_poll(uv_udp_t* handle, unsigned int usec);
 
 UV_EXTERN int uv_udp_getpeername(const uv_udp_t* handle,
                                  struct sockaddr* name,
@@ -718,10 +1173,37 @@ UV_EXTERN int uv_udp_try_send(uv_udp_t* handle,
                               const uv_buf_t bufs[],
                               unsigned int nbufs,
                               const struct sockaddr* addr);
+UV_EXTERN int uv_udp_try_send_batch(uv_udp_t* handle,
+                                    const uv_buf_t bufs[],
+                                    const struct sockaddr* const addrs[],
+                                    unsigned int count);
+UV_EXTERN int uv_udp_send_segmented(uv_udp_send_t* req,
+                                    uv_udp_t* handle,
+                                    const uv_buf_t* buf,
+                                    size_t segment_size,
+                                    const struct sockaddr* addr,
+                                    uv_udp_send_cb send_cb);
+UV_EXTERN int uv_udp_send_from(uv_udp_send_t* req,
+                               uv_udp_t* handle,
+                               const uv_buf_t bufs[],
+                               unsigned int nbufs,
+                               const struct sockaddr* addr,
+                               const struct sockaddr* src,
+                               uv_udp_send_cb send_cb);
 UV_EXTERN int uv_udp_recv_start(uv_udp_t* handle,
                                 uv_alloc_cb alloc_cb,
                                 uv_udp_recv_cb recv_cb);
 UV_EXTERN int uv_udp_using_recvmmsg(const uv_udp_t* handle);
+UV_EXTERN int uv_udp_set_recvmmsg(uv_udp_t* handle,
+                                  unsigned int nmsgs,
+                                  size_t msg_size);
+UV_EXTERN int uv_udp_set_recv_depth(uv_udp_t* handle, unsigned int depth);
+UV_EXTERN size_t uv_udp_get_recv_segment_size(const uv_udp_t* handle);
+UV_EXTERN int uv_udp_get_recv_dstaddr(const uv_udp_t* handle,
+                                      struct sockaddr* name,
+                                      int* namelen);
+UV_EXTERN int uv_udp_get_recv_timestamp(const uv_udp_t* handle,
+                                        uv_timespec_t* ts);
 UV_EXTERN int uv_udp_recv_stop(uv_udp_t* handle);
 UV_EXTERN size_t uv_udp_get_send_queue_size(const uv_udp_t* handle);
 UV_EXTERN size_t uv_udp_get_send_queue_count(const uv_udp_t* handle);
@@ -764,6 +1246,7 @@ UV_EXTERN int uv_tty_init(uv_loop_t*, uv_tty_t*, uv_file fd, int readable);
 UV_EXTERN int uv_tty_set_mode(uv_tty_t*, uv_tty_mode_t mode);
 UV_EXTERN int uv_tty_reset_mode(void);
 UV_EXTERN int uv_tty_get_winsize(uv_tty_t*, int* width, int* height);
+UV_EXTERN int uv_tty_set_write_buffer(uv_tty_t* handle, size_t size);
 UV_EXTERN void uv_tty_set_vterm_state(uv_tty_vtermstate_t state);
 UV_EXTERN int uv_tty_get_vterm_state(uv_tty_vtermstate_t* state);
 
@@ -792,7 +1275,21 @@ struct uv_pipe_s {
   UV_PIPE_PRIVATE_FIELDS
 };
 
+enum uv_pipe_flags {
+  /* Same as the ipc argument of uv_pipe_init(). */
+  UV_PIPE_IPC = 1,
+  /* Unix only: bind and connect SOCK_SEQPACKET sockets that keep message
+   * boundaries.
+   */
+  UV_PIPE_SEQPACKET = 2,
+  /* Linux only: write large buffers with vmsplice(), see uv_pipe_init_ex(). */
+  UV_PIPE_VMSPLICE = 4
+};
+
 UV_EXTERN int uv_pipe_init(uv_loop_t*, uv_pipe_t* handle, int ipc);
+UV_EXTERN int uv_pipe_init_ex(uv_loop_t*,
+                              uv_pipe_t* handle,
+                              unsigned int flags);
 UV_EXTERN int uv_pipe_open(uv_pipe_t*, uv_file file);
 UV_EXTERN int uv_pipe_bind(uv_pipe_t* handle, const char* name);
 UV_EXTERN void uv_pipe_connect(uv_connect_t* req,
@@ -806,9 +1303,16 @@ UV_EXTERN int uv_pipe_getpeername(const uv_pipe_t* handle,
                                   char* buffer,
                                   size_t* size);
 UV_EXTERN void uv_pipe_pending_instances(uv_pipe_t* handle, int count);
+UV_EXTERN int uv_pipe_set_pending_instances(uv_pipe_t* handle,
+                                            int min,
+                                            int max);
 UV_EXTERN int uv_pipe_pending_count(uv_pipe_t* handle);
 UV_EXTERN uv_handle_type uv_pipe_pending_type(uv_pipe_t* handle);
+UV_EXTERN int uv_pipe_accept_fds(uv_pipe_t* handle,
+                                 uv_os_fd_t fds[],
+                                 unsigned int nfds);
 UV_EXTERN int uv_pipe_chmod(uv_pipe_t* handle, int flags);
+UV_EXTERN int uv_pipe_buffer_size(uv_pipe_t* handle, int* value);
 
 
 struct uv_poll_s {
@@ -832,6 +1336,40 @@ UV_EXTERN int uv_poll_start(uv_poll_t* handle, int events, uv_poll_cb cb);
 UV_EXTERN int uv_poll_stop(uv_poll_t* handle);
 
 
+/*
+ * uv_shm_channel_t is a subclass of uv_poll_t.
+ */
+struct uv_shm_channel_s {
+  UV_HANDLE_FIELDS
+  uv_poll_cb poll_cb;
+  UV_POLL_PRIVATE_FIELDS
+  uv_shm_channel_cb recv_cb;
+  uv_shm_channel_writable_cb writable_cb;
+  /* private */
+  void* shm;
+  size_t shm_size;
+  uv_os_fd_t fds[3];
+  int side;
+  int blocked;
+};
+
+UV_EXTERN int uv_shm_channel_init(uv_loop_t*,
+                                  uv_shm_channel_t* channel,
+                                  size_t size,
+                                  uv_shm_channel_cb recv_cb);
+UV_EXTERN int uv_shm_channel_open(uv_loop_t*,
+                                  uv_shm_channel_t* channel,
+                                  const uv_os_fd_t fds[3],
+                                  uv_shm_channel_cb recv_cb);
+UV_EXTERN int uv_shm_channel_fds(const uv_shm_channel_t* channel,
+                                 uv_os_fd_t fds[3]);
+UV_EXTERN int uv_shm_channel_send(uv_shm_channel_t* channel,
+                                  const uv_buf_t bufs[],
+                                  unsigned int nbufs);
+UV_EXTERN void uv_shm_channel_close(uv_shm_channel_t* channel,
+                                    uv_close_cb close_cb);
+
+
 struct uv_prepare_s {
   UV_HANDLE_FIELDS
   UV_PREPARE_PRIVATE_FIELDS
@@ -862,8 +1400,40 @@ UV_EXTERN int uv_idle_start(uv_idle_t* idle, uv_idle_cb cb);
 UV_EXTERN int uv_idle_stop(uv_idle_t* idle);
 
 
+struct uv_defer_s {
+  void* data;
+  /* private */
+  uv_defer_cb cb;
+  void* queue[2];
+};
+
+UV_EXTERN int uv_defer(uv_loop_t* loop, uv_defer_t* req, uv_defer_cb cb);
+UV_EXTERN int uv_defer_cancel(uv_defer_t* req);
+
+struct uv_completion_s {
+  uv_req_t* req;
+  void* token;     /* req->data */
+  ssize_t result;  /* The status or, for uv_fs_t, the result. */
+};
+
+typedef void (*uv_completion_ready_cb)(uv_loop_t* loop);
+
+UV_EXTERN void uv_loop_set_completion_cb(uv_loop_t* loop,
+                                         uv_completion_ready_cb cb);
+UV_EXTERN size_t uv_loop_poll_completions(uv_loop_t* loop,
+                                          uv_completion_t* completions,
+                                          size_t ncompletions);
+UV_EXTERN void uv_completion_fs_cb(uv_fs_t* req);
+UV_EXTERN void uv_completion_work_cb(uv_work_t* req, int status);
+UV_EXTERN void uv_completion_write_cb(uv_write_t* req, int status);
+UV_EXTERN void uv_completion_connect_cb(uv_connect_t* req, int status);
+UV_EXTERN void uv_completion_shutdown_cb(uv_shutdown_t* req, int status);
+UV_EXTERN void uv_completion_udp_send_cb(uv_udp_send_t* req, int status);
+
+
 struct uv_async_s {
   UV_HANDLE_FIELDS
+  UV_HANDLE_RESERVED_FIELDS(1)
   UV_ASYNC_PRIVATE_FIELDS
 };
 
@@ -873,6 +1443,65 @@ UV_EXTERN int uv_async_init(uv_loop_t*,
 UV_EXTERN int uv_async_send(uv_async_t* async);
 
 
+/*
+ * uv_channel_t is a subclass of uv_async_t.
+ */
+struct uv_channel_msg_s {
+  void* data;
+  /* private */
+  uv_channel_msg_t* next;
+};
+
+struct uv_channel_s {
+  UV_HANDLE_FIELDS
+  UV_HANDLE_RESERVED_FIELDS(1)
+  UV_ASYNC_PRIVATE_FIELDS
+  uv_channel_cb channel_cb;
+  /* private */
+  uv_channel_msg_t* msgs;
+};
+
+UV_EXTERN int uv_channel_init(uv_loop_t*,
+                              uv_channel_t* channel,
+                              uv_channel_cb channel_cb);
+UV_EXTERN int uv_channel_send(uv_channel_t* channel, uv_channel_msg_t* msg);
+
+
+/*
+ * uv_loop_group_t runs a set of loops, each on a thread of its own.
+ */
+enum uv_loop_group_flags {
+  /* Bind the thread of loop i to CPU i. */
+  UV_LOOP_GROUP_PIN_THREADS = 1,
+  /* Make uv_loop_group_next() pick the least busy loop. */
+  UV_LOOP_GROUP_LEAST_LOADED = 2
+};
+
+struct uv_loop_group_s {
+  void* data;
+  /* private */
+  unsigned int nloops;
+  unsigned int flags;
+  unsigned int next;
+  uv_loop_group_cb msg_cb;
+  void* members;
+};
+
+UV_EXTERN int uv_loop_group_init(uv_loop_group_t* group,
+                                 unsigned int nloops,
+                                 unsigned int nthreads,
+                                 unsigned int flags,
+                                 uv_loop_group_cb msg_cb);
+UV_EXTERN int uv_loop_group_close(uv_loop_group_t* group);
+UV_EXTERN unsigned int uv_loop_group_size(const uv_loop_group_t* group);
+UV_EXTERN uv_loop_t* uv_loop_group_get(const uv_loop_group_t* group,
+                                       unsigned int index);
+UV_EXTERN unsigned int uv_loop_group_next(uv_loop_group_t* group);
+UV_EXTERN int uv_loop_group_send(uv_loop_group_t* group,
+                                 unsigned int index,
+                                 uv_channel_msg_t* msg);
+
+
 /*
  * uv_timer_t is a subclass of uv_handle_t.
  *
@@ -880,6 +1509,7 @@ UV_EXTERN int uv_async_send(uv_async_t* async);
  */
 struct uv_timer_s {
   UV_HANDLE_FIELDS
+  UV_HANDLE_RESERVED_FIELDS(1)
   UV_TIMER_PRIVATE_FIELDS
 };
 
@@ -888,10 +1518,17 @@ UV_EXTERN int uv_timer_start(uv_timer_t* handle,
                              uv_timer_cb cb,
                              uint64_t timeout,
                              uint64_t repeat);
+UV_EXTERN int uv_timer_start_many(uv_timer_t* handles[],
+                                  unsigned int nhandles,
+                                  uv_timer_cb cb,
+                                  const uint64_t timeouts[],
+                                  uint64_t repeat);
 UV_EXTERN int uv_timer_stop(uv_timer_t* handle);
 UV_EXTERN int uv_timer_again(uv_timer_t* handle);
 UV_EXTERN void uv_timer_set_repeat(uv_timer_t* handle, uint64_t repeat);
 UV_EXTERN uint64_t uv_timer_get_repeat(const uv_timer_t* handle);
+UV_EXTERN void uv_timer_set_slack(uv_timer_t* handle, uint64_t slack);
+UV_EXTERN uint64_t uv_timer_get_slack(const uv_timer_t* handle);
 UV_EXTERN uint64_t uv_timer_get_due_in(const uv_timer_t* handle);
 
 
@@ -917,6 +1554,17 @@ UV_EXTERN int uv_getaddrinfo(uv_loop_t* loop,
                              const struct addrinfo* hints);
 UV_EXTERN void uv_freeaddrinfo(struct addrinfo* ai);
 
+/* All times are in milliseconds. */
+struct uv_getaddrinfo_cache_options_s {
+  uint64_t ttl;
+  uint64_t negative_ttl;
+  uint64_t stale_ttl;
+  unsigned int max_entries;
+};
+
+UV_EXTERN int uv_getaddrinfo_cache_configure(
+    const uv_getaddrinfo_cache_options_t* options);
+
 
 /*
 * uv_getnameinfo_t is a subclass of uv_req_t.
@@ -937,6 +1585,44 @@ UV_EXTERN int uv_getnameinfo(uv_loop_t* loop,
                              const struct sockaddr* addr,
                              int flags);
 
+/* One address of a uv_getnameinfo_many() batch. */
+typedef struct {
+  struct sockaddr_storage addr;  /* Filled in by the caller. */
+  int status;
+  char host[NI_MAXHOST];
+  char service[NI_MAXSERV];
+} uv_nameinfo_t;
+
+/* uv_getnameinfo_many_t is a subclass of uv_req_t. */
+struct uv_getnameinfo_many_s {
+  UV_REQ_FIELDS
+  /* read-only */
+  uv_loop_t* loop;
+  uv_nameinfo_t* names;
+  unsigned int nnames;
+  int flags;
+  /* private */
+  uv_getnameinfo_many_cb cb;
+  struct uv__work work_req;
+};
+
+UV_EXTERN int uv_getnameinfo_many(uv_loop_t* loop,
+                                  uv_getnameinfo_many_t* req,
+                                  uv_nameinfo_t names[],
+                                  unsigned int nnames,
+                                  int flags,
+                                  uv_getnameinfo_many_cb cb);
+
+/* All times are in milliseconds. */
+struct uv_getnameinfo_cache_options_s {
+  uint64_t ttl;
+  uint64_t negative_ttl;
+  unsigned int max_entries;
+};
+
+UV_EXTERN int uv_getnameinfo_cache_configure(
+    const uv_getnameinfo_cache_options_t* options);
+
 
 /* uv_spawn() options. */
 typedef enum {
@@ -1071,6 +1757,7 @@ enum uv_process_flags {
  */
 struct uv_process_s {
   UV_HANDLE_FIELDS
+  UV_HANDLE_RESERVED_FIELDS(1)
   uv_exit_cb exit_cb;
   int pid;
   UV_PROCESS_PRIVATE_FIELDS
@@ -1079,10 +1766,42 @@ struct uv_process_s {
 UV_EXTERN int uv_spawn(uv_loop_t* loop,
                        uv_process_t* handle,
                        const uv_process_options_t* options);
+UV_EXTERN int uv_spawn_server_start(void);
+UV_EXTERN int uv_spawn_server_stop(void);
 UV_EXTERN int uv_process_kill(uv_process_t*, int signum);
 UV_EXTERN int uv_kill(int pid, int signum);
 UV_EXTERN uv_pid_t uv_process_get_pid(const uv_process_t*);
 
+typedef struct {
+  uv_pid_t pid;
+  int status;  /* 0, or why the other fields aren't filled in. */
+  uint64_t utime;  /* User CPU time, in microseconds. */
+  uint64_t stime;  /* System CPU time, in microseconds. */
+  uint64_t rss;  /* Resident set size, in bytes. */
+  uint64_t minflt;  /* Page reclaims (soft page faults). */
+  uint64_t majflt;  /* Page faults (hard page faults). */
+  uint64_t nthreads;
+} uv_process_usage_t;
+
+/* uv_process_stats_t is a subclass of uv_req_t. */
+struct uv_process_stats_s {
+  UV_REQ_FIELDS
+  /* read-only */
+  uv_loop_t* loop;
+  uv_process_usage_t* usage;
+  unsigned int nusage;
+  /* private */
+  uv_process_stats_cb cb;
+  struct uv__work work_req;
+};
+
+UV_EXTERN int uv_process_get_stats_many(uv_loop_t* loop,
+                                        uv_process_stats_t* req,
+                                        uv_process_t* processes[],
+                                        uv_process_usage_t usage[],
+                                        unsigned int nprocesses,
+                                        uv_process_stats_cb cb);
+
 
 /*
  * uv_work_t is a subclass of uv_req_t.
@@ -1095,10 +1814,103 @@ struct uv_work_s {
   UV_WORK_PRIVATE_FIELDS
 };
 
+typedef enum {
+  UV_WORK_PRIORITY_HIGH = 0,
+  UV_WORK_PRIORITY_NORMAL,
+  UV_WORK_PRIORITY_BACKGROUND
+} uv_work_priority;
+
 UV_EXTERN int uv_queue_work(uv_loop_t* loop,
                             uv_work_t* req,
                             uv_work_cb work_cb,
                             uv_after_work_cb after_work_cb);
+UV_EXTERN int uv_queue_work_ex(uv_loop_t* loop,
+                               uv_work_t* req,
+                               uv_work_priority priority,
+                               uv_work_cb work_cb,
+                               uv_after_work_cb after_work_cb);
+UV_EXTERN int uv_queue_work_batch(uv_loop_t* loop,
+                                  uv_work_t* reqs[],
+                                  unsigned int nreqs,
+                                  uv_work_cb work_cb,
+                                  uv_after_work_cb after_work_cb);
+
+struct uv_parallel_for_s {
+  void* data;
+  /* Read-only. */
+  uv_loop_t* loop;
+  /* Private, don't touch. */
+  void* pfor_ctx;
+};
+
+UV_EXTERN int uv_parallel_for(uv_loop_t* loop,
+                              uv_parallel_for_t* pfor,
+                              size_t begin,
+                              size_t end,
+                              size_t grain,
+                              uv_parallel_for_cb body_cb,
+                              uv_parallel_for_done_cb done_cb);
+
+UV_EXTERN void uv_work_set_scope(uv_loop_t* loop,
+                                 void* tag,
+                                 uint64_t timeout);
+UV_EXTERN int uv_work_cancel_tag(uv_loop_t* loop, void* tag);
+typedef enum {
+  UV_THREADPOOL_WORK_CPU = 0,
+  UV_THREADPOOL_WORK_FAST_IO,
+  UV_THREADPOOL_WORK_SLOW_IO,
+  UV_THREADPOOL_WORK_MAX
+} uv_threadpool_work_kind;
+
+#define UV_THREADPOOL_HISTOGRAM_SIZE 96
+
+typedef struct {
+  uint64_t submitted;
+  uint64_t completed;
+  uint64_t cancelled;
+  uint64_t queued;
+  uint64_t wait_time;
+  uint64_t exec_time;
+  uint64_t wait_histogram[UV_THREADPOOL_HISTOGRAM_SIZE];
+  uint64_t exec_histogram[UV_THREADPOOL_HISTOGRAM_SIZE];
+} uv_threadpool_work_metrics_t;
+
+struct uv_threadpool_metrics_s {
+  unsigned int threads;
+  unsigned int idle_threads;
+  uv_threadpool_work_metrics_t kinds[UV_THREADPOOL_WORK_MAX];
+};
+
+UV_EXTERN int uv_threadpool_metrics(uv_loop_t* loop,
+                                    uv_threadpool_metrics_t* metrics);
+UV_EXTERN uint64_t uv_threadpool_histogram_bound(unsigned int index);
+UV_EXTERN int uv_threadpool_set_limits(unsigned int min_threads,
+                                       unsigned int max_threads,
+                                       uint64_t idle_timeout);
+UV_EXTERN int uv_threadpool_set_kind_size(uv_threadpool_work_kind kind,
+                                          unsigned int nthreads);
+
+typedef void* (*uv_threadpool_init_cb)(void* arg);
+typedef void (*uv_threadpool_exit_cb)(void* arg, void* context);
+
+typedef enum {
+  UV_THREADPOOL_NO_FLAGS = 0x00,
+  UV_THREADPOOL_HAS_STACK_SIZE = 0x01,
+  UV_THREADPOOL_HAS_PRIORITY = 0x02
+} uv_threadpool_options_flags;
+
+typedef struct {
+  unsigned int flags;
+  uv_threadpool_init_cb init_cb;
+  uv_threadpool_exit_cb exit_cb;
+  void* arg;
+  const char* name;
+  size_t stack_size;  /* UV_THREADPOOL_HAS_STACK_SIZE */
+  int priority;  /* UV_THREADPOOL_HAS_PRIORITY, UV_PRIORITY_* */
+} uv_threadpool_options_t;
+
+UV_EXTERN int uv_threadpool_set_options(const uv_threadpool_options_t* options);
+UV_EXTERN void* uv_threadpool_context(void);
 
 UV_EXTERN int uv_cancel(uv_req_t* req);
 
@@ -1117,6 +1929,16 @@ struct uv_cpu_info_s {
   struct uv_cpu_times_s cpu_times;
 };
 
+struct uv_cpu_sampler_s {
+  /* Private, don't touch. */
+  int fd;
+  int count;
+  unsigned int multiplier;
+  char* buf;
+  size_t buf_size;
+  uint64_t* ticks;
+};
+
 struct uv_interface_address_s {
   char* name;
   char phys_addr[6];
@@ -1176,6 +1998,14 @@ struct uv_dirent_s {
   uv_dirent_type_t type;
 };
 
+/* Entries of uv_fs_readdir_packed(), back to back in the caller's buffer. */
+struct uv_dirent_packed_s {
+  unsigned int reclen;   /* Offset of the next entry from this one. */
+  unsigned int namelen;  /* Not counting the terminating nul byte. */
+  uv_dirent_type_t type;
+  char name[1];
+};
+
 UV_EXTERN char** uv_setup_args(int argc, char** argv);
 UV_EXTERN int uv_get_process_title(char* buffer, size_t size);
 UV_EXTERN int uv_set_process_title(const char* title);
@@ -1244,6 +2074,11 @@ UV_EXTERN int uv_os_setpriority(uv_pid_t pid, int priority);
 
 UV_EXTERN int uv_cpu_info(uv_cpu_info_t** cpu_infos, int* count);
 UV_EXTERN void uv_free_cpu_info(uv_cpu_info_t* cpu_infos, int count);
+UV_EXTERN int uv_cpu_sampler_init(uv_cpu_sampler_t* sampler, int* count);
+UV_EXTERN int uv_cpu_sampler_sample(uv_cpu_sampler_t* sampler,
+                                    struct uv_cpu_times_s* deltas,
+                                    int count);
+UV_EXTERN void uv_cpu_sampler_close(uv_cpu_sampler_t* sampler);
 
 UV_EXTERN int uv_interface_addresses(uv_interface_address_t** addresses,
                                      int* count);
@@ -1276,8 +2111,94 @@ UV_EXTERN int uv_os_gethostname(char* buffer, size_t* size);
 
 UV_EXTERN int uv_os_uname(uv_utsname_t* buffer);
 
+typedef enum {
+  UV_METRICS_PHASE_TIMERS = 0,
+  UV_METRICS_PHASE_PENDING,
+  UV_METRICS_PHASE_IDLE_PREPARE,
+  UV_METRICS_PHASE_POLL,
+  UV_METRICS_PHASE_CHECK,
+  UV_METRICS_PHASE_CLOSING,
+  UV_METRICS_PHASE_MAX
+} uv_metrics_phase;
+
+/* Polls that returned 0, 1, 2-3, 4-7, ... 1024+ events. */
+#define UV_METRICS_POLL_HISTOGRAM_SIZE 12
+
+struct uv_metrics_s {
+  uint64_t loop_count;
+  uint64_t events;
+  uint64_t phase_time[UV_METRICS_PHASE_MAX];
+  uint64_t polls;
+  uint64_t polls_empty;
+  uint64_t polls_saturated;  /* Filled the event buffer. */
+  uint64_t poll_histogram[UV_METRICS_POLL_HISTOGRAM_SIZE];
+  /* private */
+  uint64_t* reserved[8];
+};
+
+UV_EXTERN int uv_metrics_info(uv_loop_t* loop, uv_metrics_t* metrics);
 UV_EXTERN uint64_t uv_metrics_idle_time(uv_loop_t* loop);
 
+/* Buckets as in uv_threadpool_histogram_bound(). */
+typedef struct {
+  uint64_t count;
+  uint64_t total;  /* In nanoseconds, like max. */
+  uint64_t max;
+  uint64_t histogram[UV_THREADPOOL_HISTOGRAM_SIZE];
+} uv_lag_histogram_t;
+
+struct uv_metrics_lag_s {
+  uv_lag_histogram_t timers;  /* Due time to timer callback. */
+  uv_lag_histogram_t io;      /* Poll return to I/O callback. */
+};
+
+UV_EXTERN int uv_metrics_lag(uv_loop_t* loop, uv_metrics_lag_t* lag);
+
+struct uv_handle_counts_s {
+  uint64_t handles[UV_HANDLE_TYPE_MAX];  /* Initialized, not yet closed. */
+  uint64_t active[UV_HANDLE_TYPE_MAX];
+  uint64_t closing[UV_HANDLE_TYPE_MAX];
+  uint64_t reqs[UV_REQ_TYPE_MAX];
+};
+
+UV_EXTERN int uv_metrics_handle_counts(const uv_loop_t* loop,
+                                       uv_handle_counts_t* counts);
+
+struct uv_handle_pool_stats_s {
+  uint64_t allocated;  /* By uv_handle_alloc(), in total. */
+  uint64_t reused;     /* Of those, taken from the free list. */
+  uint64_t in_use;     /* Close callback not run yet. */
+  uint64_t free;       /* On the free list. */
+};
+
+UV_EXTERN int uv_metrics_handle_pool(const uv_loop_t* loop,
+                                     uv_handle_type type,
+                                     uv_handle_pool_stats_t* stats);
+
+struct uv_slow_callback_info_s {
+  uv_handle_t* handle;
+  uv_handle_type type;
+  void (*cb)(void);
+  uint64_t duration;
+};
+
+typedef void (*uv_slow_callback_cb)(uv_loop_t* loop,
+                                    const uv_slow_callback_info_t* info);
+
+struct uv_trace_event_s {
+  uint64_t start;     /* uv_hrtime() when the callback was called. */
+  uint64_t duration;  /* In nanoseconds. */
+  uv_metrics_phase phase;
+  uv_handle_type type;
+  void (*cb)(void);
+};
+
+UV_EXTERN int uv_loop_trace_start(uv_loop_t* loop,
+                                  uv_trace_event_t* events,
+                                  size_t nevents);
+UV_EXTERN void uv_loop_trace_stop(uv_loop_t* loop);
+UV_EXTERN int uv_loop_trace_dump(uv_loop_t* loop, FILE* stream);
+
 typedef enum {
   UV_FS_UNKNOWN = -1,
   UV_FS_CUSTOM,
@@ -1316,7 +2237,23 @@ typedef enum {
   UV_FS_CLOSEDIR,
   UV_FS_STATFS,
   UV_FS_MKSTEMP,
-  UV_FS_LUTIME
+  UV_FS_LUTIME,
+  UV_FS_STAT_MANY,
+  UV_FS_MMAP,
+  UV_FS_MUNMAP,
+  UV_FS_FADVISE,
+  UV_FS_READAHEAD,
+  UV_FS_FALLOCATE,
+  UV_FS_WRITE_BATCH,
+  UV_FS_READDIR_PACKED,
+  UV_FS_OPENAT,
+  UV_FS_STATAT,
+  UV_FS_UNLINKAT,
+  UV_FS_MKDIRAT,
+  UV_FS_STATX,
+  UV_FS_MKDIR_P,
+  UV_FS_RM_RF,
+  UV_FS_WRITE_ATOMIC
 } uv_fs_type;
 
 struct uv_dir_s {
@@ -1404,6 +2341,11 @@ UV_EXTERN int uv_fs_mkdir(uv_loop_t* loop,
                           const char* path,
                           int mode,
                           uv_fs_cb cb);
+UV_EXTERN int uv_fs_mkdir_p(uv_loop_t* loop,
+                            uv_fs_t* req,
+                            const char* path,
+                            int mode,
+                            uv_fs_cb cb);
 UV_EXTERN int uv_fs_mkdtemp(uv_loop_t* loop,
                             uv_fs_t* req,
                             const char* tpl,
@@ -1416,6 +2358,15 @@ UV_EXTERN int uv_fs_rmdir(uv_loop_t* loop,
                           uv_fs_t* req,
                           const char* path,
                           uv_fs_cb cb);
+UV_EXTERN int uv_fs_rm_rf(uv_loop_t* loop,
+                          uv_fs_t* req,
+                          const char* path,
+                          uv_fs_cb cb);
+/*
+ * This flag can be used with uv_fs_scandir() to skip sorting the entries.
+ */
+#define UV_FS_SCANDIR_UNSORTED     0x0001
+
 UV_EXTERN int uv_fs_scandir(uv_loop_t* loop,
                             uv_fs_t* req,
                             const char* path,
@@ -1431,6 +2382,12 @@ UV_EXTERN int uv_fs_readdir(uv_loop_t* loop,
                             uv_fs_t* req,
                             uv_dir_t* dir,
                             uv_fs_cb cb);
+UV_EXTERN int uv_fs_readdir_packed(uv_loop_t* loop,
+                                   uv_fs_t* req,
+                                   uv_dir_t* dir,
+                                   void* buf,
+                                   size_t len,
+                                   uv_fs_cb cb);
 UV_EXTERN int uv_fs_closedir(uv_loop_t* loop,
                              uv_fs_t* req,
                              uv_dir_t* dir,
@@ -1500,6 +2457,46 @@ UV_EXTERN int uv_fs_lstat(uv_loop_t* loop,
                           uv_fs_t* req,
                           const char* path,
                           uv_fs_cb cb);
+UV_EXTERN int uv_fs_stat_many(uv_loop_t* loop,
+                              uv_fs_t* req,
+                              const char* const paths[],
+                              unsigned int npaths,
+                              uv_stat_t* statbufs,
+                              int* results,
+                              uv_fs_cb cb);
+
+/*
+ * Fields that uv_fs_statx() is asked for and reports in req->result. The
+ * values are the same as the STATX_* values of Linux.
+ */
+#define UV_STATX_TYPE               0x0001
+#define UV_STATX_MODE               0x0002
+#define UV_STATX_NLINK              0x0004
+#define UV_STATX_UID                0x0008
+#define UV_STATX_GID                0x0010
+#define UV_STATX_ATIME              0x0020
+#define UV_STATX_MTIME              0x0040
+#define UV_STATX_CTIME              0x0080
+#define UV_STATX_INO                0x0100
+#define UV_STATX_SIZE               0x0200
+#define UV_STATX_BLOCKS             0x0400
+#define UV_STATX_BASIC_STATS        0x07FF
+#define UV_STATX_BTIME              0x0800
+#define UV_STATX_ALL                0x0FFF
+
+/*
+ * Flags to be passed to uv_fs_statx().
+ */
+#define UV_FS_STATX_NOFOLLOW        0x0001
+#define UV_FS_STATX_DONT_SYNC       0x0002
+#define UV_FS_STATX_FORCE_SYNC      0x0004
+
+UV_EXTERN int uv_fs_statx(uv_loop_t* loop,
+                          uv_fs_t* req,
+                          const char* path,
+                          unsigned int mask,
+                          int flags,
+                          uv_fs_cb cb);
 UV_EXTERN int uv_fs_link(uv_loop_t* loop,
                          uv_fs_t* req,
                          const char* path,
@@ -1532,6 +2529,7 @@ UV_EXTERN int uv_fs_realpath(uv_loop_t* loop,
                              uv_fs_t* req,
                              const char* path,
                              uv_fs_cb cb);
+UV_EXTERN void uv_fs_realpath_cache_flush(uv_loop_t* loop, const char* path);
 UV_EXTERN int uv_fs_fchmod(uv_loop_t* loop,
                            uv_fs_t* req,
                            uv_file file,
@@ -1560,6 +2558,170 @@ UV_EXTERN int uv_fs_statfs(uv_loop_t* loop,
                            const char* path,
                            uv_fs_cb cb);
 
+/*
+ * Flags to be passed to uv_fs_mmap().
+ */
+#define UV_FS_MMAP_WRITE           0x0001
+#define UV_FS_MMAP_POPULATE        0x0002
+
+/*
+ * Advice to be passed to uv_fs_madvise().
+ */
+typedef enum {
+  UV_FS_MADV_NORMAL = 0,
+  UV_FS_MADV_SEQUENTIAL,
+  UV_FS_MADV_RANDOM,
+  UV_FS_MADV_WILLNEED,
+  UV_FS_MADV_DONTNEED
+} uv_fs_madvice_t;
+
+UV_EXTERN int uv_fs_mmap(uv_loop_t* loop,
+                         uv_fs_t* req,
+                         uv_file file,
+                         int64_t offset,
+                         size_t length,
+                         int flags,
+                         uv_fs_cb cb);
+UV_EXTERN int uv_fs_munmap(uv_loop_t* loop,
+                           uv_fs_t* req,
+                           void* addr,
+                           size_t length,
+                           uv_fs_cb cb);
+UV_EXTERN int uv_fs_madvise(void* addr, size_t length, uv_fs_madvice_t advice);
+
+/*
+ * Advice to be passed to uv_fs_fadvise().
+ */
+typedef enum {
+  UV_FS_FADV_NORMAL = 0,
+  UV_FS_FADV_SEQUENTIAL,
+  UV_FS_FADV_RANDOM,
+  UV_FS_FADV_NOREUSE,
+  UV_FS_FADV_WILLNEED,
+  UV_FS_FADV_DONTNEED
+} uv_fs_fadvice_t;
+
+UV_EXTERN int uv_fs_fadvise(uv_loop_t* loop,
+                            uv_fs_t* req,
+                            uv_file file,
+                            int64_t offset,
+                            uint64_t length,
+                            uv_fs_fadvice_t advice,
+                            uv_fs_cb cb);
+UV_EXTERN int uv_fs_readahead(uv_loop_t* loop,
+                              uv_fs_t* req,
+                              uv_file file,
+                              int64_t offset,
+                              uint64_t length,
+                              uv_fs_cb cb);
+
+/*
+ * Flags to be passed to uv_fs_fallocate().
+ */
+#define UV_FS_FALLOCATE_KEEP_SIZE   0x0001
+#define UV_FS_FALLOCATE_PUNCH_HOLE  0x0002
+#define UV_FS_FALLOCATE_ZERO_RANGE  0x0004
+
+UV_EXTERN int uv_fs_fallocate(uv_loop_t* loop,
+                              uv_fs_t* req,
+                              uv_file file,
+                              int64_t offset,
+                              int64_t length,
+                              int flags,
+                              uv_fs_cb cb);
+
+/*
+ * One positional write of a uv_fs_write_batch() request.
+ */
+typedef struct {
+  int64_t offset;
+  const uv_buf_t* bufs;
+  unsigned int nbufs;
+} uv_fs_write_segment_t;
+
+/*
+ * Flags to be passed to uv_fs_write_atomic().
+ */
+#define UV_FS_WRITE_ATOMIC_NOSYNC   0x0001
+
+UV_EXTERN int uv_fs_write_atomic(uv_loop_t* loop,
+                                 uv_fs_t* req,
+                                 const char* path,
+                                 const uv_buf_t bufs[],
+                                 unsigned int nbufs,
+                                 int mode,
+                                 int flags,
+                                 uv_fs_cb cb);
+
+/*
+ * Flags to be passed to uv_fs_write_batch().
+ */
+#define UV_FS_WRITE_BATCH_DATASYNC  0x0001
+
+UV_EXTERN int uv_fs_write_batch(uv_loop_t* loop,
+                                uv_fs_t* req,
+                                uv_file file,
+                                const uv_fs_write_segment_t segments[],
+                                unsigned int nsegments,
+                                int flags,
+                                uv_fs_cb cb);
+UV_EXTERN int uv_fs_get_dio_alignment(uv_file file,
+                                      size_t* mem_align,
+                                      size_t* offset_align);
+UV_EXTERN void* uv_fs_aligned_alloc(size_t alignment, size_t size);
+UV_EXTERN void uv_fs_aligned_free(void* ptr);
+UV_EXTERN int uv_fs_read_direct(uv_loop_t* loop,
+                                uv_fs_t* req,
+                                uv_file file,
+                                const uv_buf_t bufs[],
+                                unsigned int nbufs,
+                                int64_t offset,
+                                uv_fs_cb cb);
+UV_EXTERN int uv_fs_write_direct(uv_loop_t* loop,
+                                 uv_fs_t* req,
+                                 uv_file file,
+                                 const uv_buf_t bufs[],
+                                 unsigned int nbufs,
+                                 int64_t offset,
+                                 uv_fs_cb cb);
+
+/*
+ * Flags to be passed to uv_fs_openat(), uv_fs_statat(), uv_fs_unlinkat() and
+ * uv_fs_mkdirat().
+ */
+#define UV_FS_AT_SYMLINK_NOFOLLOW   0x0001
+#define UV_FS_AT_REMOVEDIR          0x0002
+#define UV_FS_AT_BENEATH            0x0004
+
+UV_EXTERN int uv_fs_openat(uv_loop_t* loop,
+                           uv_fs_t* req,
+                           uv_file dir,
+                           const char* path,
+                           int flags,
+                           int mode,
+                           int at_flags,
+                           uv_fs_cb cb);
+UV_EXTERN int uv_fs_statat(uv_loop_t* loop,
+                           uv_fs_t* req,
+                           uv_file dir,
+                           const char* path,
+                           int at_flags,
+                           uv_fs_cb cb);
+UV_EXTERN int uv_fs_unlinkat(uv_loop_t* loop,
+                             uv_fs_t* req,
+                             uv_file dir,
+                             const char* path,
+                             int at_flags,
+                             uv_fs_cb cb);
+UV_EXTERN int uv_fs_mkdirat(uv_loop_t* loop,
+                            uv_fs_t* req,
+                            uv_file dir,
+                            const char* path,
+                            int mode,
+                            int at_flags,
+                            uv_fs_cb cb);
+UV_EXTERN int uv_fs_dir_fileno(const uv_dir_t* dir, uv_file* fd);
+
 
 enum uv_fs_event {
   UV_RENAME = 1,
@@ -1569,12 +2731,24 @@ enum uv_fs_event {
 
 struct uv_fs_event_s {
   UV_HANDLE_FIELDS
+  UV_HANDLE_RESERVED_FIELDS(1)
   /* private */
   char* path;
   UV_FS_EVENT_PRIVATE_FIELDS
 };
 
 
+/*
+ * Flags to be passed to uv_fs_poll_start_ex().
+ */
+enum uv_fs_poll_flags {
+  /*
+   * Wait for native change notifications instead of polling when the file
+   * system supports them.
+   */
+  UV_FS_POLL_NATIVE = 1
+};
+
 /*
  * uv_fs_stat() based polling file watcher.
  */
@@ -1589,12 +2763,194 @@ UV_EXTERN int uv_fs_poll_start(uv_fs_poll_t* handle,
                                uv_fs_poll_cb poll_cb,
                                const char* path,
                                unsigned int interval);
+UV_EXTERN int uv_fs_poll_start_ex(uv_fs_poll_t* handle,
+                                  uv_fs_poll_cb poll_cb,
+                                  const char* path,
+                                  unsigned int interval,
+                                  unsigned int flags);
 UV_EXTERN int uv_fs_poll_stop(uv_fs_poll_t* handle);
 UV_EXTERN int uv_fs_poll_getpath(uv_fs_poll_t* handle,
                                  char* buffer,
                                  size_t* size);
 
 
+/*
+ * Flags to be passed to uv_fs_walk().
+ */
+enum uv_fs_walk_flags {
+  /* Fill in uv_fs_walk_entry_t.statbuf with lstat() data. */
+  UV_FS_WALK_STAT = 1
+};
+
+struct uv_fs_walk_entry_s {
+  const char* path;
+  uv_dirent_type_t type;
+  unsigned int depth;
+  const uv_stat_t* statbuf;
+};
+
+struct uv_fs_walk_options_s {
+  unsigned int max_depth;
+  unsigned int concurrency;
+  unsigned int flags;
+  uv_fs_walk_filter_cb filter_cb;
+};
+
+struct uv_fs_walk_s {
+  void* data;
+  /* Read-only. */
+  uv_loop_t* loop;
+  /* Private, don't touch. */
+  void* walk_ctx;
+};
+
+UV_EXTERN int uv_fs_walk(uv_loop_t* loop,
+                         uv_fs_walk_t* walk,
+                         const char* path,
+                         const uv_fs_walk_options_t* options,
+                         uv_fs_walk_cb cb);
+UV_EXTERN int uv_fs_walk_stop(uv_fs_walk_t* walk);
+
+
+struct uv_fs_copy_options_s {
+  int flags;
+  unsigned int concurrency;
+  uint64_t chunk_size;
+  uv_fs_copy_progress_cb progress_cb;
+};
+
+struct uv_fs_copy_s {
+  void* data;
+  /* Read-only. */
+  uv_loop_t* loop;
+  /* Private, don't touch. */
+  void* copy_ctx;
+};
+
+UV_EXTERN int uv_fs_copyfile_parallel(uv_loop_t* loop,
+                                      uv_fs_copy_t* copy,
+                                      const char* path,
+                                      const char* new_path,
+                                      const uv_fs_copy_options_t* options,
+                                      uv_fs_copy_cb cb);
+
+
+struct uv_fs_reader_options_s {
+  unsigned int depth;   /* Chunks in flight or held by the caller. */
+  size_t chunk_size;
+  int64_t offset;
+  uint64_t length;      /* 0 reads up to the end of the file. */
+};
+
+struct uv_fs_reader_s {
+  void* data;
+  /* Read-only. */
+  uv_loop_t* loop;
+  /* Private, don't touch. */
+  void* reader_ctx;
+};
+
+UV_EXTERN int uv_fs_reader_start(uv_loop_t* loop,
+                                 uv_fs_reader_t* reader,
+                                 uv_file file,
+                                 const uv_fs_reader_options_t* options,
+                                 uv_fs_reader_cb read_cb);
+UV_EXTERN int uv_fs_reader_release(uv_fs_reader_t* reader,
+                                   const uv_buf_t* buf);
+UV_EXTERN int uv_fs_reader_close(uv_fs_reader_t* reader,
+                                 uv_fs_reader_close_cb close_cb);
+
+struct uv_fs_pump_s {
+  void* data;
+  /* Read-only. */
+  uv_loop_t* loop;
+  uint64_t written;
+  /* Private, don't touch. */
+  void* pump_ctx;
+};
+
+UV_EXTERN int uv_fs_pump_start(uv_loop_t* loop,
+                               uv_fs_pump_t* pump,
+                               uv_file file,
+                               uv_stream_t* stream,
+                               const uv_fs_reader_options_t* options,
+                               uv_fs_pump_cb cb);
+UV_EXTERN int uv_fs_pump_stop(uv_fs_pump_t* pump);
+
+enum uv_fs_cache_flags {
+  /* Drop entries when the file changes, in addition to the TTL. */
+  UV_FS_CACHE_WATCH = 1
+};
+
+struct uv_fs_cache_options_s {
+  unsigned int max_entries;  /* Unreferenced files kept open. */
+  uint64_t ttl;              /* In milliseconds, 0 keeps entries. */
+  unsigned int flags;
+};
+
+struct uv_fs_cache_s {
+  void* data;
+  /* Read-only. */
+  uv_loop_t* loop;
+  uint64_t hits;
+  uint64_t misses;
+  /* Private, don't touch. */
+  void* cache_ctx;
+};
+
+struct uv_fs_cache_req_s {
+  void* data;
+  /* Read-only. */
+  uv_file file;
+  const uv_stat_t* statbuf;
+  /* Private, don't touch. */
+  void* entry;
+  void* queue[2];
+  uv_fs_cache_cb cb;
+};
+
+UV_EXTERN int uv_fs_cache_init(uv_loop_t* loop,
+                               uv_fs_cache_t* cache,
+                               const uv_fs_cache_options_t* options);
+UV_EXTERN int uv_fs_cache_get(uv_fs_cache_t* cache,
+                              uv_fs_cache_req_t* req,
+                              const char* path,
+                              uv_fs_cache_cb cb);
+UV_EXTERN void uv_fs_cache_put(uv_fs_cache_t* cache, uv_fs_cache_req_t* req);
+UV_EXTERN int uv_fs_cache_invalidate(uv_fs_cache_t* cache, const char* path);
+UV_EXTERN int uv_fs_cache_close(uv_fs_cache_t* cache,
+                                uv_fs_cache_close_cb close_cb);
+
+struct uv_fs_sync_group_s {
+  void* data;
+  /* Read-only. */
+  uv_loop_t* loop;
+  uv_file file;
+  uint64_t synced;   /* Highest offset of a waiter that was flushed. */
+  uint64_t flushes;
+  /* Private, don't touch. */
+  void* group_ctx;
+};
+
+struct uv_fs_sync_req_s {
+  void* data;
+  /* Read-only. */
+  uint64_t offset;
+  /* Private, don't touch. */
+  void* queue[2];
+  uv_fs_sync_cb cb;
+};
+
+UV_EXTERN int uv_fs_sync_group_init(uv_loop_t* loop,
+                                    uv_fs_sync_group_t* group,
+                                    uv_file file);
+UV_EXTERN int uv_fs_sync_group_wait(uv_fs_sync_group_t* group,
+                                    uv_fs_sync_req_t* req,
+                                    uint64_t offset,
+                                    uv_fs_sync_cb cb);
+UV_EXTERN int uv_fs_sync_group_close(uv_fs_sync_group_t* group);
+
+
 struct uv_signal_s {
   UV_HANDLE_FIELDS
   uv_signal_cb signal_cb;
@@ -1611,6 +2967,27 @@ UV_EXTERN int uv_signal_start_oneshot(uv_signal_t* handle,
                                       int signum);
 UV_EXTERN int uv_signal_stop(uv_signal_t* handle);
 
+
+/*
+ * Events passed to uv_netif_cb.
+ */
+enum uv_netif_event {
+  UV_NETIF_ADDR_ADDED = 1,
+  UV_NETIF_ADDR_REMOVED = 2,
+  UV_NETIF_LINK_CHANGED = 4,
+  UV_NETIF_LINK_REMOVED = 8
+};
+
+struct uv_netif_s {
+  UV_HANDLE_FIELDS
+  uv_netif_cb cb;
+  UV_NETIF_PRIVATE_FIELDS
+};
+
+UV_EXTERN int uv_netif_init(uv_loop_t* loop, uv_netif_t* handle);
+UV_EXTERN int uv_netif_start(uv_netif_t* handle, uv_netif_cb cb);
+UV_EXTERN int uv_netif_stop(uv_netif_t* handle);
+
 UV_EXTERN void uv_loadavg(double avg[3]);
 
 
@@ -1650,10 +3027,18 @@ UV_EXTERN int uv_fs_event_start(uv_fs_event_t* handle,
                                 uv_fs_event_cb cb,
                                 const char* path,
                                 unsigned int flags);
+UV_EXTERN int uv_fs_event_start_batch(uv_fs_event_t* handle,
+                                      uv_fs_event_batch_cb cb,
+                                      const char* path,
+                                      unsigned int flags,
+                                      unsigned int window);
 UV_EXTERN int uv_fs_event_stop(uv_fs_event_t* handle);
 UV_EXTERN int uv_fs_event_getpath(uv_fs_event_t* handle,
                                   char* buffer,
                                   size_t* size);
+UV_EXTERN int uv_fs_event_getstat(const uv_fs_event_t* handle,
+                                  uv_stat_t* statbuf);
+UV_EXTERN int uv_fs_event_buffer_size(uv_fs_event_t* handle, int* value);
 
 UV_EXTERN int uv_ip4_addr(const char* ip, int port, struct sockaddr_in* addr);
 UV_EXTERN int uv_ip6_addr(const char* ip, int port, struct sockaddr_in6* addr);
@@ -1664,6 +3049,7 @@ UV_EXTERN int uv_ip_name(const struct sockaddr* src, char* dst, size_t size);
 
 UV_EXTERN int uv_inet_ntop(int af, const void* src, char* dst, size_t size);
 UV_EXTERN int uv_inet_pton(int af, const char* src, void* dst);
+UV_EXTERN int uv_idna_toascii(const char* s, char* d, size_t size);
 
 
 struct uv_random_s {
@@ -1678,11 +3064,16 @@ struct uv_random_s {
   struct uv__work work_req;
 };
 
+enum uv_random_flags {
+  /* Use a per-thread generator seeded from the system CSPRNG. */
+  UV_RANDOM_FAST = 1
+};
+
 UV_EXTERN int uv_random(uv_loop_t* loop,
                         uv_random_t* req,
                         void *buf,
                         size_t buflen,
-                        unsigned flags,  /* For future extension; must be 0. */
+                        unsigned flags,  /* enum uv_random_flags */
                         uv_random_cb cb);
 
 #if defined(IF_NAMESIZE)
@@ -1710,6 +3101,23 @@ UV_EXTERN uint64_t uv_get_free_memory(void);
 UV_EXTERN uint64_t uv_get_total_memory(void);
 UV_EXTERN uint64_t uv_get_constrained_memory(void);
 
+struct uv_resource_constraints_s {
+  int cgroup_version;  /* 1 or 2, 0 if unknown. */
+  uint64_t cpu_quota;  /* Microseconds per period, 0 if unlimited. */
+  uint64_t cpu_period;  /* Microseconds. */
+  uint64_t memory_limit;  /* Bytes, 0 if unlimited. */
+  uint64_t memory_usage;  /* Bytes, 0 if unknown. */
+  /* Share of time stalled over 10, 60 and 300 seconds in percent, -1 if
+   * unknown.
+   */
+  double cpu_pressure[3];
+  double memory_pressure[3];
+  double io_pressure[3];
+};
+
+UV_EXTERN int uv_get_resource_constraints(uv_resource_constraints_t* rc);
+UV_EXTERN unsigned int uv_available_parallelism(void);
+
 UV_EXTERN uint64_t uv_hrtime(void);
 UV_EXTERN void uv_sleep(unsigned int msec);
 
@@ -1722,6 +3130,7 @@ UV_EXTERN const char* uv_dlerror(const uv_lib_t* lib);
 
 UV_EXTERN int uv_mutex_init(uv_mutex_t* handle);
 UV_EXTERN int uv_mutex_init_recursive(uv_mutex_t* handle);
+UV_EXTERN int uv_mutex_init_adaptive(uv_mutex_t* handle);
 UV_EXTERN void uv_mutex_destroy(uv_mutex_t* handle);
 UV_EXTERN void uv_mutex_lock(uv_mutex_t* handle);
 UV_EXTERN int uv_mutex_trylock(uv_mutex_t* handle);
@@ -1751,6 +3160,51 @@ UV_EXTERN int uv_barrier_init(uv_barrier_t* barrier, unsigned int count);
 UV_EXTERN void uv_barrier_destroy(uv_barrier_t* barrier);
 UV_EXTERN int uv_barrier_wait(uv_barrier_t* barrier);
 
+/* Keeps the producer and consumer side of a ring on separate cache lines. */
+#define UV_RING_CACHE_LINE_SIZE 64
+
+typedef union {
+  struct {
+    unsigned int pos;
+    unsigned int cached;  /* Last seen position of the other side. */
+  } index;
+  char padding[UV_RING_CACHE_LINE_SIZE];
+} uv_ring_index_t;
+
+struct uv_spsc_ring_s {
+  /* private */
+  uv_ring_index_t head;  /* Consumer. */
+  uv_ring_index_t tail;  /* Producer. */
+  void** slots;
+  unsigned int mask;
+  uv_async_t* async;
+};
+
+struct uv_mpmc_ring_s {
+  /* private */
+  uv_ring_index_t head;  /* Consumers. */
+  uv_ring_index_t tail;  /* Producers. */
+  void* cells;
+  unsigned int mask;
+  uv_async_t* async;
+};
+
+UV_EXTERN int uv_spsc_ring_init(uv_spsc_ring_t* ring,
+                                unsigned int capacity,
+                                uv_async_t* async);
+UV_EXTERN void uv_spsc_ring_destroy(uv_spsc_ring_t* ring);
+UV_EXTERN int uv_spsc_ring_push(uv_spsc_ring_t* ring, void* item);
+UV_EXTERN int uv_spsc_ring_pop(uv_spsc_ring_t* ring, void** item);
+UV_EXTERN unsigned int uv_spsc_ring_capacity(const uv_spsc_ring_t* ring);
+
+UV_EXTERN int uv_mpmc_ring_init(uv_mpmc_ring_t* ring,
+                                unsigned int capacity,
+                                uv_async_t* async);
+UV_EXTERN void uv_mpmc_ring_destroy(uv_mpmc_ring_t* ring);
+UV_EXTERN int uv_mpmc_ring_push(uv_mpmc_ring_t* ring, void* item);
+UV_EXTERN int uv_mpmc_ring_pop(uv_mpmc_ring_t* ring, void** item);
+UV_EXTERN unsigned int uv_mpmc_ring_capacity(const uv_mpmc_ring_t* ring);
+
 UV_EXTERN void uv_cond_wait(uv_cond_t* cond, uv_mutex_t* mutex);
 UV_EXTERN int uv_cond_timedwait(uv_cond_t* cond,
                                 uv_mutex_t* mutex,
@@ -1771,12 +3225,15 @@ UV_EXTERN int uv_thread_create(uv_thread_t* tid, uv_thread_cb entry, void* arg);
 
 typedef enum {
   UV_THREAD_NO_FLAGS = 0x00,
-  UV_THREAD_HAS_STACK_SIZE = 0x01
+  UV_THREAD_HAS_STACK_SIZE = 0x01,
+  UV_THREAD_HAS_AFFINITY = 0x02
 } uv_thread_create_flags;
 
 struct uv_thread_options_s {
   unsigned int flags;
   size_t stack_size;
+  const char* cpumask;  /* UV_THREAD_HAS_AFFINITY, cpumask[i] != 0 is CPU i */
+  size_t mask_size;
   /* More fields may be added at any time. */
 };
 
@@ -1790,6 +3247,11 @@ UV_EXTERN uv_thread_t uv_thread_self(void);
 UV_EXTERN int uv_thread_join(uv_thread_t *tid);
 UV_EXTERN int uv_thread_equal(const uv_thread_t* t1, const uv_thread_t* t2);
 
+UV_EXTERN int uv_cpumask_size(void);
+UV_EXTERN int uv_numa_node_cpumask(unsigned int node,
+                                   char* cpumask,
+                                   size_t mask_size);
+
 /* The presence of these unions force similar struct layout. */
 #define XX(_, name) uv_ ## name ## _t name;
 union uv_any_handle {
@@ -223,7 +223,7 @@ typedef struct {
   int backend_fd;                                                             \
   void* pending_queue[2];                                                     \
   void* watcher_queue[2];                                                     \
-  uv__io_t** watchers;                                                        \
+  void** watchers;                                                            \
   unsigned int nwatchers;                                                     \
   unsigned int nfds;                                                          \
   void* wq[2];                                                                \
@@ -239,6 +239,7 @@ typedef struct {
   void (*async_unused)(void);  /* TODO(bnoordhuis) Remove in libuv v2. */     \
   uv__io_t async_io_watcher;                                                  \
   int async_wfd;                                                              \
+  /* Unused, timers are kept elsewhere. TODO: Remove in libuv v2.x. */       \
   struct {                                                                    \
     void* min;                                                                \
     unsigned int nelts;                                                       \
@@ -270,6 +271,11 @@ typedef struct {
 
 #define UV_SHUTDOWN_PRIVATE_FIELDS /* empty */
 
+#define UV_SPLICE_PRIVATE_FIELDS                                              \
+  int pipefd[2];                                                              \
+  size_t pending;                                                             \
+  int eof;                                                                    \
+
 #define UV_UDP_SEND_PRIVATE_FIELDS                                            \
   void* queue[2];                                                             \
   struct sockaddr_storage addr;                                               \
@@ -279,10 +285,18 @@ typedef struct {
   uv_udp_send_cb send_cb;                                                     \
   uv_buf_t bufsml[4];                                                         \
 
-#define UV_HANDLE_PRIVATE_FIELDS                                              \
+#if defined(UV_COMPACT_HANDLES)
+/* The flags sit next to the handle type, see UV_HANDLE_FIELDS. */
+# define UV_HANDLE_PRIVATE_FIELDS                                             \
+  uv_handle_t* next_closing;                                                  \
+
+#else
+# define UV_HANDLE_PRIVATE_FIELDS                                             \
   uv_handle_t* next_closing;                                                  \
   unsigned int flags;                                                         \
 
+#endif
+
 #define UV_STREAM_PRIVATE_FIELDS                                              \
   uv_connect_t *connect_req;                                                  \
   uv_shutdown_t *shutdown_req;                                                \
@@ -390,6 +404,9 @@ typedef struct {
   unsigned int caught_signals;                                                \
   unsigned int dispatched_signals;
 
+#define UV_NETIF_PRIVATE_FIELDS                                               \
+  uv__io_t io_watcher;
+
 #define UV_FS_EVENT_PRIVATE_FIELDS                                            \
   uv_fs_event_cb cb;                                                          \
   UV_PLATFORM_FS_EVENT_FIELDS                                                 \
@@ -497,6 +514,7 @@ typedef struct {
 
 /* fs open() flags supported on other platforms: */
 #define UV_FS_O_FILEMAP       0
+#define UV_FS_O_OVERLAPPED    0
 #define UV_FS_O_RANDOM        0
 #define UV_FS_O_SHORT_LIVED   0
 #define UV_FS_O_SEQUENTIAL    0
@@ -333,7 +333,7 @@ typedef struct {
   uv_req_t* pending_reqs_tail;                                                \
   /* Head of a single-linked list of closed handles */                        \
   uv_handle_t* endgame_handles;                                               \
-  /* TODO(bnoordhuis) Stop heap-allocating |timer_heap| in libuv v2.x. */     \
+  /* Unused, timers are kept elsewhere. TODO: Remove in libuv v2.x. */       \
   void* timer_heap;                                                           \
     /* Lists of active loop (prepare / check / idle) watchers */              \
   uv_prepare_t* prepare_handles;                                              \
@@ -392,6 +392,9 @@ typedef struct {
 #define UV_SHUTDOWN_PRIVATE_FIELDS                                            \
   /* empty */
 
+#define UV_SPLICE_PRIVATE_FIELDS                                              \
+  /* empty */
+
 #define UV_UDP_SEND_PRIVATE_FIELDS                                            \
   /* empty */
 
@@ -569,9 +572,15 @@ typedef struct {
   uv_idle_t* idle_next;                                                       \
   uv_idle_cb idle_cb;
 
-#define UV_HANDLE_PRIVATE_FIELDS                                              \
+#if defined(UV_COMPACT_HANDLES)
+/* The flags sit next to the handle type, see UV_HANDLE_FIELDS. */
+# define UV_HANDLE_PRIVATE_FIELDS                                             \
+  uv_handle_t* endgame_next;
+#else
+# define UV_HANDLE_PRIVATE_FIELDS                                             \
   uv_handle_t* endgame_next;                                                  \
   unsigned int flags;
+#endif
 
 #define UV_GETADDRINFO_PRIVATE_FIELDS                                         \
   struct uv__work work_req;                                                   \
@@ -579,9 +588,8 @@ typedef struct {
   void* alloc;                                                                \
   WCHAR* node;                                                                \
   WCHAR* service;                                                             \
-  /* The addrinfoW field is used to store a pointer to the hints, and    */   \
-  /* later on to store the result of GetAddrInfoW. The final result will */   \
-  /* be converted to struct addrinfo* and stored in the addrinfo field.  */   \
+  /* Unused, the lookup state lives in the alloc block. The result is   */   \
+  /* converted to struct addrinfo* and stored in the addrinfo field.     */   \
   struct addrinfoW* addrinfow;                                                \
   struct addrinfo* addrinfo;                                                  \
   int retcode;
@@ -646,6 +654,9 @@ typedef struct {
   WCHAR* dirw;                                                                \
   char* buffer;
 
+#define UV_NETIF_PRIVATE_FIELDS                                               \
+  /* Change notifications are not implemented on Windows. */
+
 #define UV_SIGNAL_PRIVATE_FIELDS                                              \
   RB_ENTRY(uv_signal_s) tree_entry;                                           \
   struct uv_req_s signal_req;                                                 \
@@ -687,5 +698,6 @@ typedef struct {
 #define UV_FS_O_NOCTTY       0
 #define UV_FS_O_NOFOLLOW     0
 #define UV_FS_O_NONBLOCK     0
+#define UV_FS_O_OVERLAPPED   0x40000000 /* FILE_FLAG_OVERLAPPED */
 #define UV_FS_O_SYMLINK      0
 #define UV_FS_O_SYNC         0x08000000 /* FILE_FLAG_WRITE_THROUGH */
@@ -0,0 +1,124 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* A channel is a uv_async_t with a lock-free stack of messages. Senders push
+ * onto the stack with a compare-and-swap, the loop thread takes the whole
+ * stack at once and delivers it in the order it was sent. Only the sender
+ * that finds the stack empty wakes up the loop, later senders piggyback on
+ * that wakeup until the loop has taken the batch.
+ */
+
+#include "uv.h"
+#include "uv-common.h"
+
+#ifdef _WIN32
+#include "win/internal.h"
+#else
+#include "unix/atomic-ops.h"
+#endif
+
+#include <stddef.h>
+
+
+static uv_channel_msg_t* channel_cmpxchg(uv_channel_t* channel,
+                                         uv_channel_msg_t* oldval,
+                                         uv_channel_msg_t* newval) {
+#ifdef _WIN32
+  return InterlockedCompareExchangePointer((PVOID volatile*) &channel->msgs,
+                                           newval,
+                                           oldval);
+#else
+  return cmpxchgp((void**) &channel->msgs, oldval, newval);
+#endif
+}
+
+
+static void channel_async_cb(uv_async_t* handle) {
+  uv_channel_t* channel;
+  uv_channel_msg_t* batch;
+  uv_channel_msg_t* prev;
+  uv_channel_msg_t* msg;
+  uv_channel_msg_t* next;
+
+  channel = (uv_channel_t*) handle;
+
+  /* Detach the whole stack. */
+  batch = *(uv_channel_msg_t* volatile*) &channel->msgs;
+  while (batch != NULL) {
+    prev = channel_cmpxchg(channel, batch, NULL);
+    if (prev == batch)
+      break;
+    batch = prev;
+  }
+
+  /* The stack is newest first, restore the send order. */
+  msg = NULL;
+  while (batch != NULL) {
+    next = batch->next;
+    batch->next = msg;
+    msg = batch;
+    batch = next;
+  }
+
+  while (msg != NULL) {
+    /* The callback is free to reuse or release the message. */
+    next = msg->next;
+    msg->next = NULL;
+    channel->channel_cb(channel, msg);
+    msg = next;
+
+    if (uv__is_closing(channel))
+      break;
+  }
+}
+
+
+int uv_channel_init(uv_loop_t* loop,
+                    uv_channel_t* channel,
+                    uv_channel_cb channel_cb) {
+  if (channel_cb == NULL)
+    return UV_EINVAL;
+
+  channel->channel_cb = channel_cb;
+  channel->msgs = NULL;
+  return uv_async_init(loop, (uv_async_t*) channel, channel_async_cb);
+}
+
+
+int uv_channel_send(uv_channel_t* channel, uv_channel_msg_t* msg) {
+  uv_channel_msg_t* head;
+  uv_channel_msg_t* prev;
+
+  head = *(uv_channel_msg_t* volatile*) &channel->msgs;
+  for (;;) {
+    msg->next = head;
+    prev = channel_cmpxchg(channel, head, msg);
+    if (prev == head)
+      break;
+    head = prev;
+  }
+
+  /* A wakeup for the batch is already on its way. */
+  if (head != NULL)
+    return 0;
+
+  return uv_async_send((uv_async_t*) channel);
+}
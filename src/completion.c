@@ -0,0 +1,130 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Completion queue. Requests that are given one of the callbacks below
+ * don't call back into the application one by one. They're appended to a
+ * queue in the loop, linked through the reserved fields of the request,
+ * which uv_loop_poll_completions() drains in batches. Nothing is allocated.
+ */
+
+#include "uv.h"
+#include "uv-common.h"
+
+#include <stdint.h>
+
+/* The first few reserved fields are taken while some requests are in
+ * flight, these are free again by the time the request completes.
+ */
+#define COMPLETION_NEXT(req) ((req)->reserved[4])
+#define COMPLETION_RESULT(req) ((req)->reserved[5])
+
+
+static void completion_ready(uv_defer_t* req) {
+  uv__loop_internal_fields_t* lfields;
+  uv_loop_t* loop;
+
+  loop = req->data;
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->completion_cb != NULL && lfields->completion_head != NULL)
+    lfields->completion_cb(loop);
+}
+
+
+static void completion_push(uv_loop_t* loop, uv_req_t* req, ssize_t result) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  COMPLETION_NEXT(req) = NULL;
+  COMPLETION_RESULT(req) = (void*) (intptr_t) result;
+
+  if (lfields->completion_tail == NULL)
+    lfields->completion_head = req;
+  else
+    COMPLETION_NEXT((uv_req_t*) lfields->completion_tail) = req;
+  lfields->completion_tail = req;
+
+  /* Once per batch, UV_EBUSY means it's queued already. */
+  if (lfields->completion_cb != NULL) {
+    lfields->completion_req.data = loop;
+    uv_defer(loop, &lfields->completion_req, completion_ready);
+  }
+}
+
+
+void uv_loop_set_completion_cb(uv_loop_t* loop, uv_completion_ready_cb cb) {
+  uv__get_internal_fields(loop)->completion_cb = cb;
+}
+
+
+size_t uv_loop_poll_completions(uv_loop_t* loop,
+                                uv_completion_t* completions,
+                                size_t ncompletions) {
+  uv__loop_internal_fields_t* lfields;
+  uv_req_t* req;
+  size_t n;
+
+  lfields = uv__get_internal_fields(loop);
+  for (n = 0; n < ncompletions; n++) {
+    req = lfields->completion_head;
+    if (req == NULL)
+      break;
+
+    lfields->completion_head = COMPLETION_NEXT(req);
+    completions[n].req = req;
+    completions[n].token = req->data;
+    completions[n].result = (ssize_t) (intptr_t) COMPLETION_RESULT(req);
+  }
+
+  if (lfields->completion_head == NULL)
+    lfields->completion_tail = NULL;
+
+  return n;
+}
+
+
+void uv_completion_fs_cb(uv_fs_t* req) {
+  completion_push(req->loop, (uv_req_t*) req, req->result);
+}
+
+
+void uv_completion_work_cb(uv_work_t* req, int status) {
+  completion_push(req->loop, (uv_req_t*) req, status);
+}
+
+
+void uv_completion_write_cb(uv_write_t* req, int status) {
+  completion_push(req->handle->loop, (uv_req_t*) req, status);
+}
+
+
+void uv_completion_connect_cb(uv_connect_t* req, int status) {
+  completion_push(req->handle->loop, (uv_req_t*) req, status);
+}
+
+
+void uv_completion_shutdown_cb(uv_shutdown_t* req, int status) {
+  completion_push(req->handle->loop, (uv_req_t*) req, status);
+}
+
+
+void uv_completion_udp_send_cb(uv_udp_send_t* req, int status) {
+  completion_push(req->handle->loop, (uv_req_t*) req, status);
+}
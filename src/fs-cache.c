@@ -0,0 +1,483 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
+#include "uv.h"
+#include "uv-common.h"
+#include "uv/tree.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_DEFAULT_MAX_ENTRIES 256
+
+/* An open file. Entries that nobody holds are on the LRU list and get closed
+ * when the cache is over its size. A stale entry is out of the tree, a new
+ * lookup opens the file again, and is closed when its last holder is done.
+ */
+struct cache_entry {
+  RB_ENTRY(cache_entry) tree_entry;
+  void* lru[2];
+  void* waiters[2];  /* Requests waiting for the open to finish. */
+  struct cache_ctx* ctx;
+  uv_work_t work_req;
+  uv_fs_t close_req;
+  uv_fs_event_t watcher;
+  uv_stat_t statbuf;
+  uint64_t loaded;
+  uv_file file;
+  int status;
+  unsigned int refs;
+  unsigned int pending;  /* Closes of the file and watcher in progress. */
+  int loading;
+  int watching;
+  int stale;
+  const char* path;  /* Points past the struct, or at the lookup key. */
+};
+
+RB_HEAD(cache_tree, cache_entry);
+
+struct cache_ctx {
+  uv_fs_cache_t* cache;
+  uv_fs_cache_close_cb close_cb;
+  uv_defer_t close_req;
+  struct cache_tree entries;
+  void* lru[2];
+  unsigned int nentries;  /* In the tree. */
+  unsigned int max_entries;
+  uint64_t ttl;
+  unsigned int flags;
+  unsigned int pending;   /* Entries being closed. */
+  int closing;
+};
+
+
+static int cache_entry_cmp(const struct cache_entry* a,
+                           const struct cache_entry* b) {
+  return strcmp(a->path, b->path);
+}
+
+
+RB_GENERATE_STATIC(cache_tree, cache_entry, tree_entry, cache_entry_cmp)
+
+
+static void cache_finish(uv_defer_t* req) {
+  uv_fs_cache_close_cb close_cb;
+  struct cache_ctx* ctx;
+  uv_fs_cache_t* cache;
+
+  ctx = container_of(req, struct cache_ctx, close_req);
+  cache = ctx->cache;
+  close_cb = ctx->close_cb;
+
+  cache->cache_ctx = NULL;
+  uv__free(ctx);
+
+  if (close_cb != NULL)
+    close_cb(cache);
+}
+
+
+static void cache_entry_free(struct cache_entry* e) {
+  struct cache_ctx* ctx;
+
+  ctx = e->ctx;
+  uv__free(e);
+
+  if (--ctx->pending == 0 && ctx->closing)
+    uv_defer(ctx->cache->loop, &ctx->close_req, cache_finish);
+}
+
+
+static void cache_file_closed(uv_fs_t* req) {
+  struct cache_entry* e;
+
+  e = container_of(req, struct cache_entry, close_req);
+  uv_fs_req_cleanup(req);
+  if (--e->pending == 0)
+    cache_entry_free(e);
+}
+
+
+static void cache_watcher_closed(uv_handle_t* handle) {
+  struct cache_entry* e;
+
+  e = container_of(handle, struct cache_entry, watcher);
+  if (--e->pending == 0)
+    cache_entry_free(e);
+}
+
+
+/* Closes the file off the loop thread, it can block on network file systems.
+ * Entries that failed to open hold no file.
+ */
+static void cache_entry_close(struct cache_entry* e) {
+  struct cache_ctx* ctx;
+  int err;
+
+  ctx = e->ctx;
+  ctx->pending++;
+  e->pending = 1;
+
+  if (e->watching) {
+    e->pending++;
+    uv_close((uv_handle_t*) &e->watcher, cache_watcher_closed);
+  }
+
+  if (e->file >= 0) {
+    e->pending++;
+    err = uv_fs_close(ctx->cache->loop,
+                      &e->close_req,
+                      e->file,
+                      cache_file_closed);
+    assert(err == 0);
+    (void) err;
+  }
+
+  if (--e->pending == 0)
+    cache_entry_free(e);
+}
+
+
+/* |e->lru| is an empty list while the entry is off the LRU. */
+static void cache_lru_remove(struct cache_entry* e) {
+  if (QUEUE_EMPTY(&e->lru))
+    return;
+
+  QUEUE_REMOVE(&e->lru);
+  QUEUE_INIT(&e->lru);
+}
+
+
+static void cache_entry_drop(struct cache_entry* e) {
+  struct cache_ctx* ctx;
+
+  if (e->stale)
+    return;
+
+  ctx = e->ctx;
+  e->stale = 1;
+  RB_REMOVE(cache_tree, &ctx->entries, e);
+  ctx->nentries--;
+
+  if (e->watching)
+    uv_fs_event_stop(&e->watcher);
+
+  if (e->refs == 0 && !e->loading) {
+    cache_lru_remove(e);
+    cache_entry_close(e);
+  }
+}
+
+
+static void cache_evict(struct cache_ctx* ctx) {
+  struct cache_entry* e;
+  QUEUE* q;
+
+  while (ctx->nentries > ctx->max_entries && !QUEUE_EMPTY(&ctx->lru)) {
+    q = QUEUE_HEAD(&ctx->lru);
+    e = QUEUE_DATA(q, struct cache_entry, lru);
+    cache_entry_drop(e);
+  }
+}
+
+
+/* Any change to the file or its name makes what we hold out of date. */
+static void cache_watcher_cb(uv_fs_event_t* handle,
+                             const char* filename,
+                             int events,
+                             int status) {
+  cache_entry_drop(container_of(handle, struct cache_entry, watcher));
+}
+
+
+/* Runs on the threadpool, one hop for both the open and the fstat. */
+static void cache_load_work(uv_work_t* req) {
+  struct cache_entry* e;
+  uv_fs_t fs_req;
+  int r;
+
+  e = container_of(req, struct cache_entry, work_req);
+
+  r = uv_fs_open(NULL, &fs_req, e->path, UV_FS_O_RDONLY, 0, NULL);
+  uv_fs_req_cleanup(&fs_req);
+  if (r < 0) {
+    e->status = r;
+    return;
+  }
+  e->file = r;
+
+  r = uv_fs_fstat(NULL, &fs_req, e->file, NULL);
+  e->statbuf = fs_req.statbuf;
+  uv_fs_req_cleanup(&fs_req);
+  e->status = r;
+}
+
+
+static void cache_hold(struct cache_entry* e, uv_fs_cache_req_t* req) {
+  e->refs++;
+  req->entry = e;
+  req->file = e->file;
+  req->statbuf = &e->statbuf;
+}
+
+
+/* Drops a reference. The last one closes a stale entry or puts the entry on
+ * the LRU, where it waits for a lookup or eviction.
+ */
+static void cache_release(struct cache_entry* e) {
+  struct cache_ctx* ctx;
+
+  if (--e->refs > 0)
+    return;
+
+  if (e->stale) {
+    cache_entry_close(e);
+    return;
+  }
+
+  ctx = e->ctx;
+  if (QUEUE_EMPTY(&e->lru))
+    QUEUE_INSERT_TAIL(&ctx->lru, &e->lru);
+  cache_evict(ctx);
+}
+
+
+static void cache_load_done(uv_work_t* req, int status) {
+  uv_fs_cache_req_t* creq;
+  struct cache_entry* e;
+  struct cache_ctx* ctx;
+  QUEUE waiters;
+  QUEUE* q;
+
+  e = container_of(req, struct cache_entry, work_req);
+  ctx = e->ctx;
+
+  if (status == 0)
+    status = e->status;
+
+  if (status == 0) {
+    e->loaded = uv_now(ctx->cache->loop);
+    if ((ctx->flags & UV_FS_CACHE_WATCH) && !e->stale) {
+      /* Without a watcher the TTL is what's left to notice changes. Open
+       * files don't keep the loop alive, neither do their watchers.
+       */
+      if (uv_fs_event_init(ctx->cache->loop, &e->watcher) == 0) {
+        e->watching = 1;
+        uv_fs_event_start(&e->watcher, cache_watcher_cb, e->path, 0);
+        uv_unref((uv_handle_t*) &e->watcher);
+      }
+    }
+  } else {
+    cache_entry_drop(e);
+  }
+
+  e->loading = 0;
+
+  /* Callbacks can look up the same path again or put the entry back, the
+   * extra reference keeps it from being closed or evicted under us.
+   */
+  e->refs++;
+  QUEUE_MOVE(&e->waiters, &waiters);
+  while (!QUEUE_EMPTY(&waiters)) {
+    q = QUEUE_HEAD(&waiters);
+    QUEUE_REMOVE(q);
+    creq = QUEUE_DATA(q, uv_fs_cache_req_t, queue);
+    if (status == 0) {
+      cache_hold(e, creq);
+    } else {
+      creq->entry = NULL;
+      creq->file = -1;
+      creq->statbuf = NULL;
+    }
+    creq->cb(creq, status);
+  }
+
+  cache_release(e);
+}
+
+
+int uv_fs_cache_init(uv_loop_t* loop,
+                     uv_fs_cache_t* cache,
+                     const uv_fs_cache_options_t* options) {
+  struct cache_ctx* ctx;
+
+  if (loop == NULL || cache == NULL)
+    return UV_EINVAL;
+
+  if (options != NULL && (options->flags & ~UV_FS_CACHE_WATCH))
+    return UV_EINVAL;
+
+  ctx = uv__calloc(1, sizeof(*ctx));
+  if (ctx == NULL)
+    return UV_ENOMEM;
+
+  RB_INIT(&ctx->entries);
+  QUEUE_INIT(&ctx->lru);
+  ctx->cache = cache;
+  ctx->max_entries = CACHE_DEFAULT_MAX_ENTRIES;
+  if (options != NULL) {
+    if (options->max_entries != 0)
+      ctx->max_entries = options->max_entries;
+    ctx->ttl = options->ttl;
+    ctx->flags = options->flags;
+  }
+
+  cache->loop = loop;
+  cache->hits = 0;
+  cache->misses = 0;
+  cache->cache_ctx = ctx;
+  return 0;
+}
+
+
+int uv_fs_cache_get(uv_fs_cache_t* cache,
+                    uv_fs_cache_req_t* req,
+                    const char* path,
+                    uv_fs_cache_cb cb) {
+  struct cache_entry lookup;
+  struct cache_entry* e;
+  struct cache_ctx* ctx;
+  size_t len;
+  int err;
+
+  if (cache == NULL || req == NULL || path == NULL || cb == NULL)
+    return UV_EINVAL;
+
+  ctx = cache->cache_ctx;
+  if (ctx == NULL || ctx->closing)
+    return UV_EINVAL;
+
+  lookup.path = path;
+  e = RB_FIND(cache_tree, &ctx->entries, &lookup);
+
+  if (e != NULL && !e->loading && ctx->ttl != 0 &&
+      uv_now(cache->loop) - e->loaded >= ctx->ttl) {
+    cache_entry_drop(e);
+    e = NULL;
+  }
+
+  if (e == NULL) {
+    len = strlen(path);
+    e = uv__calloc(1, sizeof(*e) + len + 1);
+    if (e == NULL)
+      return UV_ENOMEM;
+
+    memcpy(e + 1, path, len + 1);
+    e->path = (const char*) (e + 1);
+    e->ctx = ctx;
+    e->file = -1;
+    e->loading = 1;
+    QUEUE_INIT(&e->waiters);
+    QUEUE_INIT(&e->lru);
+
+    err = uv_queue_work(cache->loop,
+                        &e->work_req,
+                        cache_load_work,
+                        cache_load_done);
+    if (err) {
+      uv__free(e);
+      return err;
+    }
+
+    RB_INSERT(cache_tree, &ctx->entries, e);
+    ctx->nentries++;
+  }
+
+  if (e->loading) {
+    cache->misses++;
+    req->cb = cb;
+    QUEUE_INSERT_TAIL(&e->waiters, &req->queue);
+    return 0;
+  }
+
+  cache->hits++;
+  cache_lru_remove(e);
+  cache_hold(e, req);
+  return 1;
+}
+
+
+void uv_fs_cache_put(uv_fs_cache_t* cache, uv_fs_cache_req_t* req) {
+  struct cache_entry* e;
+
+  if (req == NULL || req->entry == NULL)
+    return;
+
+  e = req->entry;
+  req->entry = NULL;
+  req->file = -1;
+  req->statbuf = NULL;
+  cache_release(e);
+}
+
+
+int uv_fs_cache_invalidate(uv_fs_cache_t* cache, const char* path) {
+  struct cache_entry lookup;
+  struct cache_entry* e;
+  struct cache_ctx* ctx;
+
+  if (cache == NULL || path == NULL)
+    return UV_EINVAL;
+
+  ctx = cache->cache_ctx;
+  if (ctx == NULL)
+    return UV_EINVAL;
+
+  lookup.path = path;
+  e = RB_FIND(cache_tree, &ctx->entries, &lookup);
+  if (e == NULL)
+    return UV_ENOENT;
+
+  cache_entry_drop(e);
+  return 0;
+}
+
+
+int uv_fs_cache_close(uv_fs_cache_t* cache, uv_fs_cache_close_cb close_cb) {
+  struct cache_entry* e;
+  struct cache_entry* next;
+  struct cache_ctx* ctx;
+
+  if (cache == NULL)
+    return UV_EINVAL;
+
+  ctx = cache->cache_ctx;
+  if (ctx == NULL || ctx->closing)
+    return UV_EINVAL;
+
+  /* Files still held or being opened would be closed under their users. */
+  RB_FOREACH(e, cache_tree, &ctx->entries)
+    if (e->refs > 0 || e->loading)
+      return UV_EBUSY;
+
+  ctx->closing = 1;
+  ctx->close_cb = close_cb;
+  RB_FOREACH_SAFE(e, cache_tree, &ctx->entries, next)
+    cache_entry_drop(e);
+
+  if (ctx->pending == 0)
+    uv_defer(cache->loop, &ctx->close_req, cache_finish);
+
+  return 0;
+}
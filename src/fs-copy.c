@@ -0,0 +1,366 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
+#include "uv.h"
+#include "uv-common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COPY_DEFAULT_CONCURRENCY 4
+#define COPY_DEFAULT_CHUNK_SIZE (64 * 1024 * 1024)
+
+struct copy_chunk {
+  uv_work_t work_req;
+  struct copy_ctx* ctx;
+  uint64_t off;
+  uint64_t len;
+  int status;
+};
+
+struct copy_ctx {
+  uv_fs_copy_t* copy;
+  uv_fs_copy_cb copy_cb;
+  uv_fs_copy_progress_cb progress_cb;
+  int flags;
+  unsigned int concurrency;
+  uint64_t chunk_size;
+  uv_work_t work_req;   /* Setup and teardown. */
+  uv_file src;
+  uv_file dst;
+  int created;          /* Remove the destination on error. */
+  int done;             /* Nothing left to copy after setup. */
+  int status;
+  uint64_t size;
+  uint64_t next_off;
+  uint64_t copied;
+  unsigned int active;  /* Chunks being copied on the threadpool. */
+  struct copy_chunk* chunks;
+  const char* new_path;
+  char path[1];         /* variable length, followed by new_path */
+};
+
+static void copy_teardown(struct copy_ctx* ctx);
+
+
+/* Runs on the threadpool. Opens both files and sizes the destination so the
+ * chunks can be written in any order. Tries a reflink first when asked to.
+ */
+static void copy_setup_work(uv_work_t* req) {
+  struct copy_ctx* ctx;
+  uv_stat_t src_stat;
+  uv_fs_t fs_req;
+  int dst_flags;
+  int r;
+
+  ctx = container_of(req, struct copy_ctx, work_req);
+
+  r = uv_fs_open(NULL, &fs_req, ctx->path, UV_FS_O_RDONLY, 0, NULL);
+  uv_fs_req_cleanup(&fs_req);
+  if (r < 0)
+    goto error;
+  ctx->src = r;
+
+  r = uv_fs_fstat(NULL, &fs_req, ctx->src, NULL);
+  src_stat = fs_req.statbuf;
+  uv_fs_req_cleanup(&fs_req);
+  if (r < 0)
+    goto error;
+
+  dst_flags = UV_FS_O_WRONLY | UV_FS_O_CREAT;
+  if (ctx->flags & UV_FS_COPYFILE_EXCL)
+    dst_flags |= UV_FS_O_EXCL;
+
+  r = uv_fs_open(NULL, &fs_req, ctx->new_path, dst_flags,
+                 (int) src_stat.st_mode, NULL);
+  uv_fs_req_cleanup(&fs_req);
+  if (r < 0)
+    goto error;
+  ctx->dst = r;
+  ctx->created = 1;
+
+  if ((ctx->flags & UV_FS_COPYFILE_EXCL) == 0) {
+    r = uv_fs_fstat(NULL, &fs_req, ctx->dst, NULL);
+    if (r == 0 &&
+        fs_req.statbuf.st_dev == src_stat.st_dev &&
+        fs_req.statbuf.st_ino == src_stat.st_ino) {
+      /* Copying a file onto itself, nothing to do. */
+      uv_fs_req_cleanup(&fs_req);
+      ctx->created = 0;
+      ctx->done = 1;
+      return;
+    }
+    uv_fs_req_cleanup(&fs_req);
+    if (r < 0)
+      goto error;
+  }
+
+  if (ctx->flags & (UV_FS_COPYFILE_FICLONE | UV_FS_COPYFILE_FICLONE_FORCE)) {
+    r = uv__fs_clone(ctx->src, ctx->dst);
+    if (r == 0) {
+      ctx->size = src_stat.st_size;
+      ctx->copied = ctx->size;
+      ctx->done = 1;
+      return;
+    }
+    if (ctx->flags & UV_FS_COPYFILE_FICLONE_FORCE)
+      goto error;
+  }
+
+  r = uv_fs_ftruncate(NULL, &fs_req, ctx->dst, src_stat.st_size, NULL);
+  uv_fs_req_cleanup(&fs_req);
+  if (r < 0)
+    goto error;
+
+  /* An existing destination keeps its mode otherwise. */
+  r = uv_fs_fchmod(NULL, &fs_req, ctx->dst, (int) src_stat.st_mode, NULL);
+  uv_fs_req_cleanup(&fs_req);
+  if (r < 0)
+    goto error;
+
+  ctx->size = src_stat.st_size;
+  ctx->done = ctx->size == 0;
+  return;
+
+error:
+  ctx->status = r;
+}
+
+
+static void copy_chunk_work(uv_work_t* req) {
+  struct copy_chunk* chunk;
+
+  chunk = container_of(req, struct copy_chunk, work_req);
+  chunk->status = uv__fs_copy_range(chunk->ctx->src,
+                                    chunk->ctx->dst,
+                                    chunk->off,
+                                    chunk->len);
+}
+
+
+static void copy_chunk_done(uv_work_t* req, int status);
+
+
+static void copy_chunk_start(struct copy_chunk* chunk) {
+  struct copy_ctx* ctx;
+  int err;
+
+  ctx = chunk->ctx;
+  chunk->off = ctx->next_off;
+  chunk->len = ctx->size - ctx->next_off;
+  if (chunk->len > ctx->chunk_size)
+    chunk->len = ctx->chunk_size;
+  chunk->status = 0;
+  ctx->next_off += chunk->len;
+  ctx->active++;
+
+  err = uv_queue_work(ctx->copy->loop,
+                      &chunk->work_req,
+                      copy_chunk_work,
+                      copy_chunk_done);
+  assert(err == 0);
+  (void) err;
+}
+
+
+/* Runs on the loop thread. Reports progress and hands the next range to the
+ * chunk that just finished.
+ */
+static void copy_chunk_done(uv_work_t* req, int status) {
+  struct copy_chunk* chunk;
+  struct copy_ctx* ctx;
+
+  chunk = container_of(req, struct copy_chunk, work_req);
+  ctx = chunk->ctx;
+  ctx->active--;
+
+  if (status == 0)
+    status = chunk->status;
+
+  if (status < 0) {
+    if (ctx->status == 0)
+      ctx->status = status;
+  } else if (ctx->status == 0) {
+    ctx->copied += chunk->len;
+    if (ctx->progress_cb != NULL)
+      ctx->progress_cb(ctx->copy, ctx->copied, ctx->size);
+  }
+
+  if (ctx->status == 0 && ctx->next_off < ctx->size) {
+    copy_chunk_start(chunk);
+    return;
+  }
+
+  if (ctx->active == 0)
+    copy_teardown(ctx);
+}
+
+
+static void copy_setup_done(uv_work_t* req, int status) {
+  struct copy_ctx* ctx;
+  unsigned int i;
+
+  ctx = container_of(req, struct copy_ctx, work_req);
+
+  if (status < 0 && ctx->status == 0)
+    ctx->status = status;
+
+  if (ctx->status < 0 || ctx->done) {
+    /* A reflink copies everything at once. */
+    if (ctx->status == 0 && ctx->copied > 0 && ctx->progress_cb != NULL)
+      ctx->progress_cb(ctx->copy, ctx->copied, ctx->size);
+    copy_teardown(ctx);
+    return;
+  }
+
+  ctx->chunks = uv__calloc(ctx->concurrency, sizeof(*ctx->chunks));
+  if (ctx->chunks == NULL) {
+    ctx->status = UV_ENOMEM;
+    copy_teardown(ctx);
+    return;
+  }
+
+  for (i = 0; i < ctx->concurrency && ctx->next_off < ctx->size; i++) {
+    ctx->chunks[i].ctx = ctx;
+    copy_chunk_start(&ctx->chunks[i]);
+  }
+}
+
+
+/* Runs on the threadpool. Closes the files and, like uv_fs_copyfile(),
+ * removes a partially written destination.
+ */
+static void copy_teardown_work(uv_work_t* req) {
+  struct copy_ctx* ctx;
+  uv_fs_t fs_req;
+  int r;
+
+  ctx = container_of(req, struct copy_ctx, work_req);
+
+  if (ctx->src >= 0) {
+    uv_fs_close(NULL, &fs_req, ctx->src, NULL);
+    uv_fs_req_cleanup(&fs_req);
+  }
+
+  if (ctx->dst >= 0) {
+    r = uv_fs_close(NULL, &fs_req, ctx->dst, NULL);
+    uv_fs_req_cleanup(&fs_req);
+    if (r < 0 && ctx->status == 0)
+      ctx->status = r;
+  }
+
+  if (ctx->status < 0 && ctx->created) {
+    uv_fs_unlink(NULL, &fs_req, ctx->new_path, NULL);
+    uv_fs_req_cleanup(&fs_req);
+  }
+}
+
+
+static void copy_teardown_done(uv_work_t* req, int status) {
+  struct copy_ctx* ctx;
+  uv_fs_copy_t* copy;
+
+  ctx = container_of(req, struct copy_ctx, work_req);
+  copy = ctx->copy;
+  status = ctx->status;
+
+  copy->copy_ctx = NULL;
+  ctx->copy_cb(copy, status);
+
+  uv__free(ctx->chunks);
+  uv__free(ctx);
+}
+
+
+static void copy_teardown(struct copy_ctx* ctx) {
+  int err;
+
+  err = uv_queue_work(ctx->copy->loop,
+                      &ctx->work_req,
+                      copy_teardown_work,
+                      copy_teardown_done);
+  assert(err == 0);
+  (void) err;
+}
+
+
+int uv_fs_copyfile_parallel(uv_loop_t* loop,
+                            uv_fs_copy_t* copy,
+                            const char* path,
+                            const char* new_path,
+                            const uv_fs_copy_options_t* options,
+                            uv_fs_copy_cb cb) {
+  struct copy_ctx* ctx;
+  size_t path_len;
+  size_t new_path_len;
+  int flags;
+  int err;
+
+  if (loop == NULL || copy == NULL || path == NULL || new_path == NULL ||
+      cb == NULL)
+    return UV_EINVAL;
+
+  flags = options != NULL ? options->flags : 0;
+  if (flags & ~(UV_FS_COPYFILE_EXCL |
+                UV_FS_COPYFILE_FICLONE |
+                UV_FS_COPYFILE_FICLONE_FORCE))
+    return UV_EINVAL;
+
+  path_len = strlen(path);
+  new_path_len = strlen(new_path);
+  ctx = uv__calloc(1, sizeof(*ctx) + path_len + new_path_len + 1);
+  if (ctx == NULL)
+    return UV_ENOMEM;
+
+  memcpy(ctx->path, path, path_len + 1);
+  memcpy(ctx->path + path_len + 1, new_path, new_path_len + 1);
+  ctx->new_path = ctx->path + path_len + 1;
+  ctx->copy = copy;
+  ctx->copy_cb = cb;
+  ctx->flags = flags;
+  ctx->src = -1;
+  ctx->dst = -1;
+  ctx->concurrency = COPY_DEFAULT_CONCURRENCY;
+  ctx->chunk_size = COPY_DEFAULT_CHUNK_SIZE;
+
+  if (options != NULL) {
+    ctx->progress_cb = options->progress_cb;
+    if (options->concurrency != 0)
+      ctx->concurrency = options->concurrency;
+    if (options->chunk_size != 0)
+      ctx->chunk_size = options->chunk_size;
+  }
+
+  copy->loop = loop;
+  copy->copy_ctx = ctx;
+
+  err = uv_queue_work(loop, &ctx->work_req, copy_setup_work, copy_setup_done);
+  if (err) {
+    copy->copy_ctx = NULL;
+    uv__free(ctx);
+    return err;
+  }
+
+  return 0;
+}
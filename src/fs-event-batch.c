@@ -0,0 +1,249 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
+#include "uv.h"
+#include "uv-common.h"
+#include "uv/tree.h"
+
+#ifdef _WIN32
+#include "win/internal.h"
+#include "win/handle-inl.h"
+#else
+#include "unix/internal.h"
+#endif
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The events seen for one path during the current window. */
+struct batch_entry {
+  RB_ENTRY(batch_entry) tree_entry;
+  int events;
+  const char* filename;  /* Points past the struct, or at the lookup key. */
+};
+
+RB_HEAD(batch_tree, batch_entry);
+
+struct batch_ctx {
+  uv_fs_event_t* handle;  /* NULL once the handle is stopped. */
+  uv_fs_event_batch_cb batch_cb;
+  unsigned int window;
+  uv_timer_t timer_handle;
+  struct batch_tree entries;
+  size_t nentries;
+};
+
+
+static int batch_entry_cmp(const struct batch_entry* a,
+                           const struct batch_entry* b) {
+  return strcmp(a->filename, b->filename);
+}
+
+
+RB_GENERATE_STATIC(batch_tree, batch_entry, tree_entry, batch_entry_cmp)
+
+
+static void batch_free_entries(struct batch_ctx* ctx) {
+  struct batch_entry* e;
+  struct batch_entry* next;
+
+  RB_FOREACH_SAFE(e, batch_tree, &ctx->entries, next) {
+    RB_REMOVE(batch_tree, &ctx->entries, e);
+    uv__free(e);
+  }
+
+  ctx->nentries = 0;
+}
+
+
+/* Hands everything collected so far to the user in one call. */
+static void batch_flush(struct batch_ctx* ctx) {
+  uv_fs_event_batch_entry_t* batch;
+  struct batch_entry* e;
+  size_t i;
+
+  uv_timer_stop(&ctx->timer_handle);
+
+  if (ctx->nentries == 0)
+    return;
+
+  batch = uv__malloc(ctx->nentries * sizeof(*batch));
+  if (batch == NULL) {
+    batch_free_entries(ctx);
+    ctx->batch_cb(ctx->handle, NULL, 0, UV_ENOMEM);
+    return;
+  }
+
+  i = 0;
+  RB_FOREACH(e, batch_tree, &ctx->entries) {
+    batch[i].filename = e->filename;
+    batch[i].events = e->events;
+    i++;
+  }
+
+  /* The callback may stop the handle, ctx stays around until the timer is
+   * closed, which can't happen before we return.
+   */
+  ctx->batch_cb(ctx->handle, batch, i, 0);
+
+  uv__free(batch);
+  batch_free_entries(ctx);
+}
+
+
+static void batch_timer_cb(uv_timer_t* timer) {
+  struct batch_ctx* ctx;
+
+  ctx = container_of(timer, struct batch_ctx, timer_handle);
+  if (ctx->handle != NULL)
+    batch_flush(ctx);
+}
+
+
+static void batch_event_cb(uv_fs_event_t* handle,
+                           const char* filename,
+                           int events,
+                           int status) {
+  struct uv__fs_event_state* state;
+  struct batch_entry lookup;
+  struct batch_entry* e;
+  struct batch_ctx* ctx;
+  size_t len;
+
+  state = handle->u.reserved[0];
+  ctx = state->batch;
+  assert(ctx != NULL && ctx->handle == handle);
+
+  if (status < 0) {
+    batch_flush(ctx);
+    if (ctx->handle != NULL)
+      ctx->batch_cb(handle, NULL, 0, status);
+    return;
+  }
+
+  /* Some platforms can't always tell which file changed. */
+  if (filename == NULL)
+    filename = "";
+
+  lookup.filename = filename;
+  e = RB_FIND(batch_tree, &ctx->entries, &lookup);
+
+  if (e == NULL) {
+    len = strlen(filename) + 1;
+    e = uv__malloc(sizeof(*e) + len);
+    if (e == NULL) {
+      ctx->batch_cb(handle, NULL, 0, UV_ENOMEM);
+      return;
+    }
+    e->events = 0;
+    e->filename = memcpy(e + 1, filename, len);
+    RB_INSERT(batch_tree, &ctx->entries, e);
+    ctx->nentries++;
+  }
+
+  e->events |= events;
+
+  /* The window opens with the first event, a steady stream of events can't
+   * hold the batch back forever.
+   */
+  if (!uv_is_active((uv_handle_t*) &ctx->timer_handle))
+    if (uv_timer_start(&ctx->timer_handle, batch_timer_cb, ctx->window, 0))
+      abort();
+}
+
+
+static void batch_close_cb(uv_handle_t* timer) {
+  struct batch_ctx* ctx;
+
+  ctx = container_of(timer, struct batch_ctx, timer_handle);
+  batch_free_entries(ctx);
+  uv__free(ctx);
+}
+
+
+int uv_fs_event_start_batch(uv_fs_event_t* handle,
+                            uv_fs_event_batch_cb cb,
+                            const char* path,
+                            unsigned int flags,
+                            unsigned int window) {
+  struct uv__fs_event_state* state;
+  struct batch_ctx* ctx;
+  int err;
+
+  if (cb == NULL)
+    return UV_EINVAL;
+
+  if (uv_is_active((uv_handle_t*) handle))
+    return UV_EINVAL;
+
+  state = uv__fs_event_state(handle);
+  if (state == NULL)
+    return UV_ENOMEM;
+
+  ctx = uv__malloc(sizeof(*ctx));
+  if (ctx == NULL)
+    return UV_ENOMEM;
+
+  ctx->handle = handle;
+  ctx->batch_cb = cb;
+  ctx->window = window;
+  ctx->nentries = 0;
+  RB_INIT(&ctx->entries);
+
+  err = uv_timer_init(handle->loop, &ctx->timer_handle);
+  if (err) {
+    uv__free(ctx);
+    return err;
+  }
+
+  ctx->timer_handle.flags |= UV_HANDLE_INTERNAL;
+  uv__handle_unref(&ctx->timer_handle);
+
+  err = uv_fs_event_start(handle, batch_event_cb, path, flags);
+  if (err) {
+    uv_close((uv_handle_t*) &ctx->timer_handle, batch_close_cb);
+    return err;
+  }
+
+  state->batch = ctx;
+  return 0;
+}
+
+
+/* Called by the platform's uv_fs_event_stop(). Pending events are dropped,
+ * a stopped handle doesn't run callbacks.
+ */
+void uv__fs_event_batch_stop(uv_fs_event_t* handle) {
+  struct uv__fs_event_state* state;
+  struct batch_ctx* ctx;
+
+  state = handle->u.reserved[0];
+  if (state == NULL || state->batch == NULL)
+    return;
+
+  ctx = state->batch;
+  state->batch = NULL;
+  ctx->handle = NULL;
+  uv_close((uv_handle_t*) &ctx->timer_handle, batch_close_cb);
+}
@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
 #include "uv.h"
 #include "uv-common.h"
 
@@ -34,14 +36,30 @@
 #include <stdlib.h>
 #include <string.h>
 
+/* What UV_FS_POLL_NATIVE has found out about the path so far. */
+enum {
+  EVENT_UNPROBED,  /* The file system type is not known yet. */
+  EVENT_IDLE,      /* Notifications may work but aren't armed. */
+  EVENT_WATCHING,  /* Notifications are armed, the timer is not running. */
+  EVENT_NEVER      /* Remote file system or no notifications, stat() only. */
+};
+
 struct poll_ctx {
   uv_fs_poll_t* parent_handle;
   int busy_polling;
   unsigned int interval;
+  unsigned int flags;
   uint64_t start_time;
   uv_loop_t* loop;
   uv_fs_poll_cb poll_cb;
   uv_timer_t timer_handle;
+  uv_fs_event_t event_handle;
+  int event_state;
+  uint64_t event_dev; /* inode the notifications are armed on */
+  uint64_t event_ino;
+  int req_active; /* fs_req is in flight */
+  int stat_again; /* a notification arrived while fs_req was in flight */
+  int close_pending; /* internal handles left to close */
   uv_fs_t fs_req; /* TODO(bnoordhuis) mark fs_req internal */
   uv_stat_t statbuf;
   struct poll_ctx* previous; /* context from previous start()..stop() period */
@@ -50,8 +68,12 @@ struct poll_ctx {
 
 static int statbuf_eq(const uv_stat_t* a, const uv_stat_t* b);
 static void poll_cb(uv_fs_t* req);
+static void poll_close(struct poll_ctx* ctx);
+static int poll_native(struct poll_ctx* ctx, int ok);
+static void poll_stat(struct poll_ctx* ctx);
 static void timer_cb(uv_timer_t* timer);
 static void timer_close_cb(uv_handle_t* handle);
+static void event_close_cb(uv_handle_t* handle);
 
 static uv_stat_t zero_statbuf;
 
@@ -67,11 +89,23 @@ int uv_fs_poll_start(uv_fs_poll_t* handle,
                      uv_fs_poll_cb cb,
                      const char* path,
                      unsigned int interval) {
+  return uv_fs_poll_start_ex(handle, cb, path, interval, 0);
+}
+
+
+int uv_fs_poll_start_ex(uv_fs_poll_t* handle,
+                        uv_fs_poll_cb cb,
+                        const char* path,
+                        unsigned int interval,
+                        unsigned int flags) {
   struct poll_ctx* ctx;
   uv_loop_t* loop;
   size_t len;
   int err;
 
+  if (flags & ~UV_FS_POLL_NATIVE)
+    return UV_EINVAL;
+
   if (uv_is_active((uv_handle_t*)handle))
     return 0;
 
@@ -85,8 +119,10 @@ int uv_fs_poll_start(uv_fs_poll_t* handle,
   ctx->loop = loop;
   ctx->poll_cb = cb;
   ctx->interval = interval ? interval : 1;
+  ctx->flags = flags;
   ctx->start_time = uv_now(loop);
   ctx->parent_handle = handle;
+  ctx->event_state = EVENT_NEVER;
   memcpy(ctx->path, path, len + 1);
 
   err = uv_timer_init(loop, &ctx->timer_handle);
@@ -95,10 +131,22 @@ int uv_fs_poll_start(uv_fs_poll_t* handle,
 
   ctx->timer_handle.flags |= UV_HANDLE_INTERNAL;
   uv__handle_unref(&ctx->timer_handle);
+  ctx->close_pending = 1;
+
+  if (flags & UV_FS_POLL_NATIVE) {
+    /* Initializing doesn't acquire resources, it can't fail in practice. */
+    if (uv_fs_event_init(loop, &ctx->event_handle) == 0) {
+      ctx->event_handle.flags |= UV_HANDLE_INTERNAL;
+      uv__handle_unref(&ctx->event_handle);
+      ctx->event_state = EVENT_UNPROBED;
+      ctx->close_pending++;
+    }
+  }
 
   err = uv_fs_stat(loop, &ctx->fs_req, ctx->path, poll_cb);
   if (err < 0)
     goto error;
+  ctx->req_active = 1;
 
   if (handle->poll_ctx != NULL)
     ctx->previous = handle->poll_ctx;
@@ -123,11 +171,11 @@ int uv_fs_poll_stop(uv_fs_poll_t* handle) {
   assert(ctx != NULL);
   assert(ctx->parent_handle == handle);
 
-  /* Close the timer if it's active. If it's inactive, there's a stat request
-   * in progress and poll_cb will take care of the cleanup.
+  /* If there's a stat request in progress, poll_cb will take care of the
+   * cleanup.
    */
-  if (uv_is_active((uv_handle_t*)&ctx->timer_handle))
-    uv_close((uv_handle_t*)&ctx->timer_handle, timer_close_cb);
+  if (!ctx->req_active)
+    poll_close(ctx);
 
   uv__handle_stop(handle);
 
@@ -169,27 +217,184 @@ void uv__fs_poll_close(uv_fs_poll_t* handle) {
 }
 
 
+static void poll_stat(struct poll_ctx* ctx) {
+  ctx->start_time = uv_now(ctx->loop);
+  ctx->req_active = 1;
+  ctx->stat_again = 0;
+
+  if (uv_fs_stat(ctx->loop, &ctx->fs_req, ctx->path, poll_cb))
+    abort();
+}
+
+
+static void poll_schedule(struct poll_ctx* ctx) {
+  uint64_t interval;
+
+  /* Reschedule timer, subtract the delay from doing the stat(). */
+  interval = ctx->interval;
+  interval -= (uv_now(ctx->loop) - ctx->start_time) % interval;
+
+  if (uv_timer_start(&ctx->timer_handle, timer_cb, interval, 0))
+    abort();
+}
+
+
 static void timer_cb(uv_timer_t* timer) {
   struct poll_ctx* ctx;
 
   ctx = container_of(timer, struct poll_ctx, timer_handle);
   assert(ctx->parent_handle != NULL);
   assert(ctx->parent_handle->poll_ctx == ctx);
-  ctx->start_time = uv_now(ctx->loop);
+  poll_stat(ctx);
+}
 
-  if (uv_fs_stat(ctx->loop, &ctx->fs_req, ctx->path, poll_cb))
-    abort();
+
+static void event_cb(uv_fs_event_t* event,
+                     const char* filename,
+                     int events,
+                     int status) {
+  struct poll_ctx* ctx;
+  uv_fs_poll_t* handle;
+
+  ctx = container_of(event, struct poll_ctx, event_handle);
+  handle = ctx->parent_handle;
+
+  if (!uv_is_active((uv_handle_t*)handle) || uv__is_closing(handle))
+    return;
+
+  if (handle->poll_ctx != ctx)
+    return;
+
+  /* The watch is gone, poll_cb re-arms it or falls back to the timer. */
+  if (status < 0) {
+    uv_fs_event_stop(&ctx->event_handle);
+    ctx->event_state = EVENT_IDLE;
+  }
+
+  /* Notifications only say that something happened, the stat() tells what.
+   * Coalesce the ones that arrive while it's in progress.
+   */
+  if (ctx->req_active)
+    ctx->stat_again = 1;
+  else
+    poll_stat(ctx);
+}
+
+
+/* Linux is the only platform where uv_statfs_t.f_type is a well-known magic
+ * number. Notifications for changes made by other machines don't reach us on
+ * these, they have to be polled.
+ */
+static int poll_is_remote(const uv_statfs_t* statfs) {
+#if defined(__linux__)
+  switch (statfs->f_type) {
+    case 0x00006969:  /* NFS */
+    case 0x0000517B:  /* SMB */
+    case 0xFF534D42:  /* CIFS */
+    case 0xFE534D42:  /* SMB2 */
+    case 0x0000564C:  /* NCP */
+    case 0x73757245:  /* CODA */
+    case 0x5346414F:  /* AFS */
+    case 0x00C36400:  /* CEPH */
+    case 0x01021997:  /* 9P */
+    case 0x0BD00BD0:  /* LUSTRE */
+    case 0x01161970:  /* GFS2 */
+    case 0x7461636F:  /* OCFS2 */
+    case 0x65735546:  /* FUSE */
+      return 1;
+  }
+#endif
+  return 0;
+}
+
+
+static void statfs_cb(uv_fs_t* req) {
+  struct poll_ctx* ctx;
+  uv_fs_poll_t* handle;
+
+  ctx = container_of(req, struct poll_ctx, fs_req);
+  handle = ctx->parent_handle;
+  ctx->req_active = 0;
+
+  if (req->result == 0)
+    ctx->event_state = poll_is_remote(req->ptr) ? EVENT_NEVER : EVENT_IDLE;
+
+  uv_fs_req_cleanup(req);
+
+  if (!uv_is_active((uv_handle_t*)handle) || uv__is_closing(handle)) {
+    poll_close(ctx);
+    return;
+  }
+
+  /* On error, try again after the next successful stat(). */
+  if (ctx->event_state == EVENT_UNPROBED || !poll_native(ctx, 1))
+    poll_schedule(ctx);
+}
+
+
+/* Called after every stat() in UV_FS_POLL_NATIVE mode. Returns 1 when
+ * notifications (or a request started from here) take over from the timer.
+ */
+static int poll_native(struct poll_ctx* ctx, int ok) {
+  if (ctx->event_state == EVENT_NEVER)
+    return 0;
+
+  if (!ok) {
+    /* Can't watch what isn't there, poll until it comes back. */
+    if (ctx->event_state == EVENT_WATCHING) {
+      uv_fs_event_stop(&ctx->event_handle);
+      ctx->event_state = EVENT_IDLE;
+    }
+    return 0;
+  }
+
+  if (ctx->event_state == EVENT_UNPROBED) {
+    if (uv_fs_statfs(ctx->loop, &ctx->fs_req, ctx->path, statfs_cb)) {
+      ctx->event_state = EVENT_NEVER;
+      return 0;
+    }
+    ctx->req_active = 1;
+    return 1;
+  }
+
+  if (ctx->event_state == EVENT_WATCHING &&
+      ctx->event_dev == ctx->statbuf.st_dev &&
+      ctx->event_ino == ctx->statbuf.st_ino) {
+    if (ctx->stat_again)
+      poll_stat(ctx);
+    return 1;
+  }
+
+  /* Not armed yet, or the path now names a different file (an editor saved
+   * it by renaming over it) and the watch is on the old one.
+   */
+  if (ctx->event_state == EVENT_WATCHING)
+    uv_fs_event_stop(&ctx->event_handle);
+
+  if (uv_fs_event_start(&ctx->event_handle, event_cb, ctx->path, 0)) {
+    ctx->event_state = EVENT_IDLE;
+    return 0;
+  }
+
+  ctx->event_state = EVENT_WATCHING;
+  ctx->event_dev = ctx->statbuf.st_dev;
+  ctx->event_ino = ctx->statbuf.st_ino;
+
+  /* Catch changes made between the stat() and arming the watch. */
+  poll_stat(ctx);
+  return 1;
 }
 
 
 static void poll_cb(uv_fs_t* req) {
   uv_stat_t* statbuf;
   struct poll_ctx* ctx;
-  uint64_t interval;
   uv_fs_poll_t* handle;
+  int ok;
 
   ctx = container_of(req, struct poll_ctx, fs_req);
   handle = ctx->parent_handle;
+  ok = 0;
 
   if (!uv_is_active((uv_handle_t*)handle) || uv__is_closing(handle))
     goto out;
@@ -213,31 +418,39 @@ static void poll_cb(uv_fs_t* req) {
 
   ctx->statbuf = *statbuf;
   ctx->busy_polling = 1;
+  ok = 1;
 
 out:
   uv_fs_req_cleanup(req);
+  ctx->req_active = 0;
 
   if (!uv_is_active((uv_handle_t*)handle) || uv__is_closing(handle)) {
-    uv_close((uv_handle_t*)&ctx->timer_handle, timer_close_cb);
+    poll_close(ctx);
     return;
   }
 
-  /* Reschedule timer, subtract the delay from doing the stat(). */
-  interval = ctx->interval;
-  interval -= (uv_now(ctx->loop) - ctx->start_time) % interval;
+  if (poll_native(ctx, ok))
+    return;
 
-  if (uv_timer_start(&ctx->timer_handle, timer_cb, interval, 0))
-    abort();
+  poll_schedule(ctx);
 }
 
 
-static void timer_close_cb(uv_handle_t* timer) {
-  struct poll_ctx* ctx;
+static void poll_close(struct poll_ctx* ctx) {
+  uv_close((uv_handle_t*)&ctx->timer_handle, timer_close_cb);
+  if (ctx->close_pending > 1)
+    uv_close((uv_handle_t*)&ctx->event_handle, event_close_cb);
+}
+
+
+static void poll_ctx_free(struct poll_ctx* ctx) {
   struct poll_ctx* it;
   struct poll_ctx* last;
   uv_fs_poll_t* handle;
 
-  ctx = container_of(timer, struct poll_ctx, timer_handle);
+  if (--ctx->close_pending > 0)
+    return;
+
   handle = ctx->parent_handle;
   if (ctx == handle->poll_ctx) {
     handle->poll_ctx = ctx->previous;
@@ -255,6 +468,16 @@ static void timer_close_cb(uv_handle_t* timer) {
 }
 
 
+static void timer_close_cb(uv_handle_t* timer) {
+  poll_ctx_free(container_of(timer, struct poll_ctx, timer_handle));
+}
+
+
+static void event_close_cb(uv_handle_t* event) {
+  poll_ctx_free(container_of(event, struct poll_ctx, event_handle));
+}
+
+
 static int statbuf_eq(const uv_stat_t* a, const uv_stat_t* b) {
   return a->st_ctim.tv_nsec == b->st_ctim.tv_nsec
       && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec
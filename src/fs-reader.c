@@ -0,0 +1,517 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
+#include "uv.h"
+#include "uv-common.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#define READER_DEFAULT_DEPTH 3
+#define READER_DEFAULT_CHUNK_SIZE (256 * 1024)
+#define READER_MAX_DEPTH 64
+
+/* A chunk is free, being read on the threadpool, waiting for the chunks
+ * before it, or held by the caller until uv_fs_reader_release().
+ */
+enum reader_state {
+  READER_CHUNK_FREE,
+  READER_CHUNK_READING,
+  READER_CHUNK_READY,
+  READER_CHUNK_HELD
+};
+
+struct reader_chunk {
+  uv_fs_t req;
+  struct reader_ctx* ctx;
+  char* base;
+  size_t len;
+  ssize_t result;
+  uint64_t seq;
+  enum reader_state state;
+};
+
+struct reader_ctx {
+  uv_fs_reader_t* reader;
+  uv_fs_reader_cb read_cb;
+  uv_fs_reader_close_cb close_cb;
+  uv_defer_t close_req;
+  uv_file file;
+  size_t chunk_size;
+  unsigned int depth;
+  unsigned int active;   /* Reads on the threadpool. */
+  int64_t next_off;
+  uint64_t remaining;    /* Still to be read when the length is bounded. */
+  uint64_t next_seq;     /* Of the next read. */
+  uint64_t deliver_seq;  /* Of the next chunk for the read callback. */
+  int bounded;
+  int last;              /* No more reads will be started. */
+  int done;              /* The read callback got UV_EOF or an error. */
+  int closing;
+  char* bufs;
+  struct reader_chunk chunks[1];  /* variable length */
+};
+
+static void reader_read_done(uv_fs_t* req);
+
+
+static void reader_chunk_start(struct reader_ctx* ctx,
+                               struct reader_chunk* chunk) {
+  uv_buf_t buf;
+  int err;
+
+  chunk->len = ctx->chunk_size;
+  if (ctx->bounded) {
+    if (chunk->len > ctx->remaining)
+      chunk->len = ctx->remaining;
+    ctx->remaining -= chunk->len;
+    ctx->last = ctx->remaining == 0;
+  }
+
+  chunk->seq = ctx->next_seq++;
+  chunk->state = READER_CHUNK_READING;
+  buf = uv_buf_init(chunk->base, chunk->len);
+  ctx->active++;
+
+  err = uv_fs_read(ctx->reader->loop,
+                   &chunk->req,
+                   ctx->file,
+                   &buf,
+                   1,
+                   ctx->next_off,
+                   reader_read_done);
+  assert(err == 0);
+  (void) err;
+
+  ctx->next_off += chunk->len;
+}
+
+
+/* Puts every free chunk to work, so up to |depth| reads overlap. */
+static void reader_fill(struct reader_ctx* ctx) {
+  unsigned int i;
+
+  for (i = 0; i < ctx->depth; i++) {
+    if (ctx->last || ctx->done || ctx->closing)
+      return;
+
+    if (ctx->chunks[i].state == READER_CHUNK_FREE)
+      reader_chunk_start(ctx, &ctx->chunks[i]);
+  }
+}
+
+
+static struct reader_chunk* reader_next_ready(struct reader_ctx* ctx) {
+  unsigned int i;
+
+  for (i = 0; i < ctx->depth; i++)
+    if (ctx->chunks[i].state == READER_CHUNK_READY &&
+        ctx->chunks[i].seq == ctx->deliver_seq)
+      return &ctx->chunks[i];
+
+  return NULL;
+}
+
+
+/* Reads finish in any order, the read callback gets them in file order. The
+ * callback can release buffers and close the reader, so look again at the
+ * state after each one.
+ */
+static void reader_deliver(struct reader_ctx* ctx) {
+  struct reader_chunk* chunk;
+  uv_buf_t buf;
+
+  while (!ctx->done && !ctx->closing) {
+    chunk = reader_next_ready(ctx);
+    if (chunk == NULL) {
+      if (ctx->last && ctx->deliver_seq == ctx->next_seq) {
+        ctx->done = 1;
+        ctx->read_cb(ctx->reader, UV_EOF, NULL);
+      }
+      return;
+    }
+
+    ctx->deliver_seq++;
+
+    if (chunk->result <= 0) {
+      chunk->state = READER_CHUNK_FREE;
+      ctx->done = 1;
+      ctx->read_cb(ctx->reader, chunk->result == 0 ? UV_EOF : chunk->result,
+                   NULL);
+      return;
+    }
+
+    chunk->state = READER_CHUNK_HELD;
+    buf = uv_buf_init(chunk->base, (unsigned int) chunk->result);
+    ctx->read_cb(ctx->reader, chunk->result, &buf);
+  }
+}
+
+
+static void reader_finish(uv_defer_t* req) {
+  uv_fs_reader_close_cb close_cb;
+  struct reader_ctx* ctx;
+  uv_fs_reader_t* reader;
+
+  ctx = container_of(req, struct reader_ctx, close_req);
+  reader = ctx->reader;
+  close_cb = ctx->close_cb;
+
+  reader->reader_ctx = NULL;
+  uv__free(ctx->bufs);
+  uv__free(ctx);
+
+  if (close_cb != NULL)
+    close_cb(reader);
+}
+
+
+static void reader_read_done(uv_fs_t* req) {
+  struct reader_chunk* chunk;
+  struct reader_ctx* ctx;
+
+  chunk = container_of(req, struct reader_chunk, req);
+  ctx = chunk->ctx;
+  chunk->result = req->result;
+  uv_fs_req_cleanup(req);
+  ctx->active--;
+
+  if (ctx->closing || ctx->done) {
+    chunk->state = READER_CHUNK_FREE;
+    if (ctx->closing && ctx->active == 0)
+      uv_defer(ctx->reader->loop, &ctx->close_req, reader_finish);
+    return;
+  }
+
+  /* A regular file only comes up short at its end. */
+  if (chunk->result >= 0 && (size_t) chunk->result < chunk->len)
+    ctx->last = 1;
+
+  chunk->state = READER_CHUNK_READY;
+  reader_deliver(ctx);
+  reader_fill(ctx);
+}
+
+
+int uv_fs_reader_start(uv_loop_t* loop,
+                       uv_fs_reader_t* reader,
+                       uv_file file,
+                       const uv_fs_reader_options_t* options,
+                       uv_fs_reader_cb read_cb) {
+  struct reader_ctx* ctx;
+  unsigned int depth;
+  size_t chunk_size;
+  unsigned int i;
+
+  if (loop == NULL || reader == NULL || read_cb == NULL || file < 0)
+    return UV_EINVAL;
+
+  depth = READER_DEFAULT_DEPTH;
+  chunk_size = READER_DEFAULT_CHUNK_SIZE;
+  if (options != NULL) {
+    if (options->offset < 0)
+      return UV_EINVAL;
+    if (options->depth != 0)
+      depth = options->depth;
+    if (options->chunk_size != 0)
+      chunk_size = options->chunk_size;
+  }
+
+  /* The size of a read has to fit a uv_buf_t and its result. */
+  if (depth > READER_MAX_DEPTH || chunk_size > INT_MAX)
+    return UV_EINVAL;
+
+  if (chunk_size > SIZE_MAX / depth)
+    return UV_ENOMEM;
+
+  ctx = uv__calloc(1, sizeof(*ctx) + (depth - 1) * sizeof(ctx->chunks[0]));
+  if (ctx == NULL)
+    return UV_ENOMEM;
+
+  ctx->bufs = uv__malloc(depth * chunk_size);
+  if (ctx->bufs == NULL) {
+    uv__free(ctx);
+    return UV_ENOMEM;
+  }
+
+  for (i = 0; i < depth; i++) {
+    ctx->chunks[i].ctx = ctx;
+    ctx->chunks[i].base = ctx->bufs + i * chunk_size;
+    ctx->chunks[i].state = READER_CHUNK_FREE;
+  }
+
+  ctx->reader = reader;
+  ctx->read_cb = read_cb;
+  ctx->file = file;
+  ctx->depth = depth;
+  ctx->chunk_size = chunk_size;
+  if (options != NULL) {
+    ctx->next_off = options->offset;
+    ctx->remaining = options->length;
+    ctx->bounded = options->length != 0;
+  }
+
+  reader->loop = loop;
+  reader->reader_ctx = ctx;
+  reader_fill(ctx);
+  return 0;
+}
+
+
+int uv_fs_reader_release(uv_fs_reader_t* reader, const uv_buf_t* buf) {
+  struct reader_ctx* ctx;
+  unsigned int i;
+
+  if (reader == NULL || buf == NULL)
+    return UV_EINVAL;
+
+  ctx = reader->reader_ctx;
+  if (ctx == NULL)
+    return UV_EINVAL;
+
+  for (i = 0; i < ctx->depth; i++)
+    if (ctx->chunks[i].base == buf->base &&
+        ctx->chunks[i].state == READER_CHUNK_HELD)
+      break;
+
+  if (i == ctx->depth)
+    return UV_EINVAL;
+
+  ctx->chunks[i].state = READER_CHUNK_FREE;
+  reader_fill(ctx);
+  return 0;
+}
+
+
+int uv_fs_reader_close(uv_fs_reader_t* reader,
+                       uv_fs_reader_close_cb close_cb) {
+  struct reader_ctx* ctx;
+  unsigned int i;
+
+  if (reader == NULL)
+    return UV_EINVAL;
+
+  ctx = reader->reader_ctx;
+  if (ctx == NULL || ctx->closing)
+    return UV_EINVAL;
+
+  ctx->closing = 1;
+  ctx->close_cb = close_cb;
+
+  /* Reads that didn't start yet complete with UV_ECANCELED. */
+  for (i = 0; i < ctx->depth; i++)
+    if (ctx->chunks[i].state == READER_CHUNK_READING)
+      uv_cancel((uv_req_t*) &ctx->chunks[i].req);
+
+  if (ctx->active == 0)
+    uv_defer(reader->loop, &ctx->close_req, reader_finish);
+
+  return 0;
+}
+
+
+/* uv_fs_pump_start() writes the chunks of a reader as they come, straight
+ * from the reader's buffers. A buffer goes back to the reader when its write
+ * is done, so the stream never has more than depth * chunk_size bytes of
+ * the file in its write queue and reading stalls while the peer is slow.
+ */
+struct pump_write {
+  uv_write_t req;
+  struct pump_ctx* ctx;
+  uv_buf_t buf;
+  int busy;
+};
+
+struct pump_ctx {
+  uv_fs_pump_t* pump;
+  uv_fs_pump_cb cb;
+  uv_stream_t* stream;
+  uv_fs_reader_t reader;
+  unsigned int depth;
+  unsigned int writes;  /* Writes in the stream's queue. */
+  int status;
+  int eof;
+  int closing;
+  struct pump_write ws[1];  /* variable length */
+};
+
+
+static void pump_reader_closed(uv_fs_reader_t* reader) {
+  struct pump_ctx* ctx;
+  uv_fs_pump_t* pump;
+  uv_fs_pump_cb cb;
+  int status;
+
+  ctx = reader->data;
+  pump = ctx->pump;
+  cb = ctx->cb;
+  status = ctx->status;
+
+  pump->pump_ctx = NULL;
+  uv__free(ctx);
+  cb(pump, status);
+}
+
+
+/* The buffers go away with the reader, wait for the writes using them. */
+static void pump_maybe_finish(struct pump_ctx* ctx) {
+  if (ctx->closing || ctx->writes > 0)
+    return;
+
+  if (ctx->status == 0 && !ctx->eof)
+    return;
+
+  ctx->closing = 1;
+  uv_fs_reader_close(&ctx->reader, pump_reader_closed);
+}
+
+
+static void pump_write_cb(uv_write_t* req, int status) {
+  struct pump_write* w;
+  struct pump_ctx* ctx;
+
+  w = container_of(req, struct pump_write, req);
+  ctx = w->ctx;
+  w->busy = 0;
+  ctx->writes--;
+
+  if (status < 0) {
+    if (ctx->status == 0)
+      ctx->status = status;
+  } else {
+    ctx->pump->written += w->buf.len;
+  }
+
+  uv_fs_reader_release(&ctx->reader, &w->buf);
+  pump_maybe_finish(ctx);
+}
+
+
+static void pump_read_cb(uv_fs_reader_t* reader,
+                         ssize_t nread,
+                         const uv_buf_t* buf) {
+  struct pump_write* w;
+  struct pump_ctx* ctx;
+  unsigned int i;
+  int err;
+
+  ctx = reader->data;
+
+  if (nread < 0) {
+    if (nread == UV_EOF)
+      ctx->eof = 1;
+    else if (ctx->status == 0)
+      ctx->status = nread;
+    pump_maybe_finish(ctx);
+    return;
+  }
+
+  if (ctx->status != 0) {
+    uv_fs_reader_release(reader, buf);
+    return;
+  }
+
+  /* The reader has no more buffers out than there are writes. */
+  for (i = 0; ctx->ws[i].busy; i++)
+    assert(i + 1 < ctx->depth);
+
+  w = &ctx->ws[i];
+  w->buf = *buf;
+  err = uv_write(&w->req, ctx->stream, &w->buf, 1, pump_write_cb);
+  if (err) {
+    ctx->status = err;
+    uv_fs_reader_release(reader, buf);
+    pump_maybe_finish(ctx);
+    return;
+  }
+
+  w->busy = 1;
+  ctx->writes++;
+}
+
+
+int uv_fs_pump_start(uv_loop_t* loop,
+                     uv_fs_pump_t* pump,
+                     uv_file file,
+                     uv_stream_t* stream,
+                     const uv_fs_reader_options_t* options,
+                     uv_fs_pump_cb cb) {
+  struct pump_ctx* ctx;
+  unsigned int depth;
+  unsigned int i;
+  int err;
+
+  if (pump == NULL || stream == NULL || cb == NULL)
+    return UV_EINVAL;
+
+  depth = READER_DEFAULT_DEPTH;
+  if (options != NULL && options->depth != 0)
+    depth = options->depth;
+
+  if (depth > READER_MAX_DEPTH)
+    return UV_EINVAL;
+
+  ctx = uv__calloc(1, sizeof(*ctx) + (depth - 1) * sizeof(ctx->ws[0]));
+  if (ctx == NULL)
+    return UV_ENOMEM;
+
+  for (i = 0; i < depth; i++)
+    ctx->ws[i].ctx = ctx;
+
+  ctx->pump = pump;
+  ctx->cb = cb;
+  ctx->stream = stream;
+  ctx->depth = depth;
+  ctx->reader.data = ctx;
+
+  err = uv_fs_reader_start(loop, &ctx->reader, file, options, pump_read_cb);
+  if (err) {
+    uv__free(ctx);
+    return err;
+  }
+
+  pump->loop = loop;
+  pump->written = 0;
+  pump->pump_ctx = ctx;
+  return 0;
+}
+
+
+int uv_fs_pump_stop(uv_fs_pump_t* pump) {
+  struct pump_ctx* ctx;
+
+  if (pump == NULL)
+    return UV_EINVAL;
+
+  ctx = pump->pump_ctx;
+  if (ctx == NULL || ctx->closing)
+    return UV_EINVAL;
+
+  if (ctx->status == 0)
+    ctx->status = UV_ECANCELED;
+
+  pump_maybe_finish(ctx);
+  return 0;
+}
@@ -0,0 +1,260 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
+#include "uv.h"
+#include "uv-common.h"
+#include "uv/tree.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The uv_fs_realpath() results of a loop, for UV_LOOP_REALPATH_CACHE. Only
+ * the loop thread touches it: lookups happen before a request is queued,
+ * results are stored when it completes.
+ */
+struct realpath_entry {
+  RB_ENTRY(realpath_entry) tree_entry;
+  QUEUE lru;
+  const char* path;
+  const char* resolved;  /* Both in the same allocation as the entry. */
+};
+
+RB_HEAD(realpath_tree, realpath_entry);
+
+struct uv__realpath_cache {
+  struct realpath_tree entries;
+  QUEUE lru;
+  unsigned int nentries;
+  unsigned int max_entries;
+};
+
+
+static int realpath_entry_cmp(const struct realpath_entry* a,
+                              const struct realpath_entry* b) {
+  return strcmp(a->path, b->path);
+}
+
+
+RB_GENERATE_STATIC(realpath_tree, realpath_entry, tree_entry,
+                   realpath_entry_cmp)
+
+
+/* Relative paths depend on the working directory, they're not cached. */
+static int realpath_is_absolute(const char* path) {
+#ifdef _WIN32
+  if (path[0] == '\\' || path[0] == '/')
+    return 1;
+  return path[0] != '\0' && path[1] == ':' &&
+         (path[2] == '\\' || path[2] == '/');
+#else
+  return path[0] == '/';
+#endif
+}
+
+
+static int realpath_is_separator(char c) {
+#ifdef _WIN32
+  return c == '\\' || c == '/';
+#else
+  return c == '/';
+#endif
+}
+
+
+/* Whether |path| is |prefix| or a path below it. */
+static int realpath_has_prefix(const char* path,
+                               const char* prefix,
+                               size_t len) {
+  if (strncmp(path, prefix, len) != 0)
+    return 0;
+
+  return path[len] == '\0' ||
+         realpath_is_separator(path[len]) ||
+         (len > 0 && realpath_is_separator(prefix[len - 1]));
+}
+
+
+static void realpath_remove(struct uv__realpath_cache* cache,
+                            struct realpath_entry* entry) {
+  RB_REMOVE(realpath_tree, &cache->entries, entry);
+  QUEUE_REMOVE(&entry->lru);
+  cache->nentries--;
+  uv__free(entry);
+}
+
+
+static void realpath_trim(struct uv__realpath_cache* cache) {
+  QUEUE* q;
+
+  while (cache->nentries > cache->max_entries) {
+    q = QUEUE_PREV(&cache->lru);
+    realpath_remove(cache, QUEUE_DATA(q, struct realpath_entry, lru));
+  }
+}
+
+
+static struct realpath_entry* realpath_find(struct uv__realpath_cache* cache,
+                                            const char* path) {
+  struct realpath_entry lookup;
+
+  lookup.path = path;
+  return RB_FIND(realpath_tree, &cache->entries, &lookup);
+}
+
+
+int uv__realpath_cache_configure(uv_loop_t* loop, unsigned int max_entries) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__realpath_cache* cache;
+
+  lfields = uv__get_internal_fields(loop);
+  cache = lfields->realpath_cache;
+
+  if (max_entries == 0) {
+    uv__realpath_cache_delete(loop);
+    return 0;
+  }
+
+  if (cache == NULL) {
+    cache = uv__malloc(sizeof(*cache));
+    if (cache == NULL)
+      return UV_ENOMEM;
+
+    RB_INIT(&cache->entries);
+    QUEUE_INIT(&cache->lru);
+    cache->nentries = 0;
+    lfields->realpath_cache = cache;
+  }
+
+  cache->max_entries = max_entries;
+  realpath_trim(cache);
+
+  return 0;
+}
+
+
+void uv__realpath_cache_delete(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->realpath_cache == NULL)
+    return;
+
+  uv_fs_realpath_cache_flush(loop, NULL);
+  uv__free(lfields->realpath_cache);
+  lfields->realpath_cache = NULL;
+}
+
+
+char* uv__realpath_cache_lookup(uv_loop_t* loop, const char* path) {
+  struct uv__realpath_cache* cache;
+  struct realpath_entry* entry;
+
+  if (loop == NULL)
+    return NULL;
+
+  cache = uv__get_internal_fields(loop)->realpath_cache;
+  if (cache == NULL || !realpath_is_absolute(path))
+    return NULL;
+
+  entry = realpath_find(cache, path);
+  if (entry == NULL)
+    return NULL;
+
+  QUEUE_REMOVE(&entry->lru);
+  QUEUE_INSERT_HEAD(&cache->lru, &entry->lru);
+
+  return uv__strdup(entry->resolved);
+}
+
+
+/* Failing to allocate only means the next lookup misses. */
+void uv__realpath_cache_store(uv_loop_t* loop,
+                              const char* path,
+                              const char* resolved) {
+  struct uv__realpath_cache* cache;
+  struct realpath_entry* entry;
+  size_t resolved_len;
+  size_t len;
+  char* p;
+
+  if (loop == NULL)
+    return;
+
+  cache = uv__get_internal_fields(loop)->realpath_cache;
+  if (cache == NULL || !realpath_is_absolute(path))
+    return;
+
+  entry = realpath_find(cache, path);
+  if (entry != NULL) {
+    if (strcmp(entry->resolved, resolved) == 0) {
+      QUEUE_REMOVE(&entry->lru);
+      QUEUE_INSERT_HEAD(&cache->lru, &entry->lru);
+      return;
+    }
+
+    realpath_remove(cache, entry);
+  }
+
+  len = strlen(path) + 1;
+  resolved_len = strlen(resolved) + 1;
+  entry = uv__malloc(sizeof(*entry) + len + resolved_len);
+  if (entry == NULL)
+    return;
+
+  p = (char*) (entry + 1);
+  memcpy(p, path, len);
+  memcpy(p + len, resolved, resolved_len);
+  entry->path = p;
+  entry->resolved = p + len;
+  RB_INSERT(realpath_tree, &cache->entries, entry);
+  QUEUE_INSERT_HEAD(&cache->lru, &entry->lru);
+  cache->nentries++;
+  realpath_trim(cache);
+}
+
+
+void uv_fs_realpath_cache_flush(uv_loop_t* loop, const char* path) {
+  struct uv__realpath_cache* cache;
+  struct realpath_entry* entry;
+  struct realpath_entry* next;
+  size_t len;
+
+  cache = uv__get_internal_fields(loop)->realpath_cache;
+  if (cache == NULL)
+    return;
+
+  len = path == NULL ? 0 : strlen(path);
+
+  /* Anything that ran through |path|, as given or once resolved. */
+  for (entry = RB_MIN(realpath_tree, &cache->entries);
+       entry != NULL;
+       entry = next) {
+    next = RB_NEXT(realpath_tree, &cache->entries, entry);
+    if (path == NULL ||
+        realpath_has_prefix(entry->path, path, len) ||
+        realpath_has_prefix(entry->resolved, path, len)) {
+      realpath_remove(cache, entry);
+    }
+  }
+}
@@ -0,0 +1,175 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Group commit. Waiters that arrive while a flush runs can't ride along, the
+ * flush may have started before their write finished. They're collected for
+ * the next flush instead, which starts as soon as the current one is done.
+ * The first flush of a burst starts after the loop phase, so that waiters
+ * from the same round of callbacks share it.
+ */
+
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
+#include "uv.h"
+#include "uv-common.h"
+
+#include <assert.h>
+#include <string.h>
+
+struct sync_group_ctx {
+  uv_fs_sync_group_t* group;
+  uv_fs_t req;
+  uv_defer_t start_req;
+  void* flushing[2];  /* Waiters covered by the flush in progress. */
+  void* waiting[2];   /* Waiters for the next flush. */
+  uint64_t flushing_offset;
+  uint64_t waiting_offset;
+  int busy;
+};
+
+
+static void sync_group_flush_cb(uv_fs_t* req);
+
+
+static void sync_group_start(struct sync_group_ctx* ctx) {
+  int err;
+
+  QUEUE_MOVE(&ctx->waiting, &ctx->flushing);
+  ctx->flushing_offset = ctx->waiting_offset;
+  ctx->waiting_offset = 0;
+  ctx->busy = 1;
+
+  err = uv_fs_fdatasync(ctx->group->loop,
+                        &ctx->req,
+                        ctx->group->file,
+                        sync_group_flush_cb);
+  assert(err == 0);
+  (void) err;
+}
+
+
+static void sync_group_start_cb(uv_defer_t* req) {
+  struct sync_group_ctx* ctx;
+
+  ctx = container_of(req, struct sync_group_ctx, start_req);
+  if (!ctx->busy && !QUEUE_EMPTY(&ctx->waiting))
+    sync_group_start(ctx);
+}
+
+
+static void sync_group_flush_cb(uv_fs_t* req) {
+  uv_fs_sync_group_t* group;
+  struct sync_group_ctx* ctx;
+  uv_fs_sync_req_t* sreq;
+  QUEUE flushed;
+  QUEUE* q;
+  int status;
+
+  ctx = container_of(req, struct sync_group_ctx, req);
+  group = ctx->group;
+  status = (int) req->result;
+  uv_fs_req_cleanup(req);
+
+  ctx->busy = 0;
+  group->flushes++;
+  if (status == 0 && ctx->flushing_offset > group->synced)
+    group->synced = ctx->flushing_offset;
+
+  QUEUE_MOVE(&ctx->flushing, &flushed);
+  if (!QUEUE_EMPTY(&ctx->waiting))
+    sync_group_start(ctx);
+
+  while (!QUEUE_EMPTY(&flushed)) {
+    q = QUEUE_HEAD(&flushed);
+    QUEUE_REMOVE(q);
+    sreq = QUEUE_DATA(q, uv_fs_sync_req_t, queue);
+    sreq->cb(sreq, status);
+  }
+}
+
+
+int uv_fs_sync_group_init(uv_loop_t* loop,
+                          uv_fs_sync_group_t* group,
+                          uv_file file) {
+  struct sync_group_ctx* ctx;
+
+  if (loop == NULL || group == NULL || file < 0)
+    return UV_EINVAL;
+
+  ctx = uv__calloc(1, sizeof(*ctx));
+  if (ctx == NULL)
+    return UV_ENOMEM;
+
+  ctx->group = group;
+  QUEUE_INIT(&ctx->flushing);
+  QUEUE_INIT(&ctx->waiting);
+
+  group->loop = loop;
+  group->file = file;
+  group->synced = 0;
+  group->flushes = 0;
+  group->group_ctx = ctx;
+  return 0;
+}
+
+
+int uv_fs_sync_group_wait(uv_fs_sync_group_t* group,
+                          uv_fs_sync_req_t* req,
+                          uint64_t offset,
+                          uv_fs_sync_cb cb) {
+  struct sync_group_ctx* ctx;
+
+  if (group == NULL || req == NULL || cb == NULL)
+    return UV_EINVAL;
+
+  ctx = group->group_ctx;
+  if (ctx == NULL)
+    return UV_EINVAL;
+
+  req->offset = offset;
+  req->cb = cb;
+  QUEUE_INSERT_TAIL(&ctx->waiting, &req->queue);
+  if (offset > ctx->waiting_offset)
+    ctx->waiting_offset = offset;
+
+  /* UV_EBUSY means it's queued already. */
+  if (!ctx->busy)
+    uv_defer(group->loop, &ctx->start_req, sync_group_start_cb);
+
+  return 0;
+}
+
+
+int uv_fs_sync_group_close(uv_fs_sync_group_t* group) {
+  struct sync_group_ctx* ctx;
+
+  if (group == NULL || group->group_ctx == NULL)
+    return UV_EINVAL;
+
+  ctx = group->group_ctx;
+  if (ctx->busy || !QUEUE_EMPTY(&ctx->waiting))
+    return UV_EBUSY;
+
+  /* The start request can only be pending with waiters. */
+  group->group_ctx = NULL;
+  uv__free(ctx);
+  return 0;
+}
@@ -0,0 +1,363 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
+#include "uv.h"
+#include "uv-common.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define WALK_DEFAULT_CONCURRENCY 4
+
+struct walk_ctx {
+  uv_fs_walk_t* walk;
+  uv_fs_walk_cb walk_cb;
+  uv_fs_walk_filter_cb filter_cb;
+  unsigned int max_depth;
+  unsigned int concurrency;
+  unsigned int flags;
+  unsigned int active;  /* Directories being read on the threadpool. */
+  int stopped;
+  QUEUE pending;        /* Directories waiting for a free slot. */
+};
+
+/* One directory to read. Holds the batch of entries when the read is done. */
+struct walk_dir {
+  QUEUE member;
+  uv_work_t work_req;
+  struct walk_ctx* ctx;
+  unsigned int depth;
+  int status;
+  unsigned int nentries;
+  uv_fs_walk_entry_t* entries;
+  char* paths;
+  char path[1];  /* variable length */
+};
+
+static void walk_schedule(struct walk_ctx* ctx);
+
+
+static struct walk_dir* walk_dir_new(struct walk_ctx* ctx,
+                                     const char* path,
+                                     unsigned int depth) {
+  struct walk_dir* dir;
+  size_t len;
+
+  len = strlen(path);
+  dir = uv__malloc(sizeof(*dir) + len);
+  if (dir == NULL)
+    return NULL;
+
+  dir->ctx = ctx;
+  dir->depth = depth;
+  dir->status = 0;
+  dir->nentries = 0;
+  dir->entries = NULL;
+  dir->paths = NULL;
+  memcpy(dir->path, path, len + 1);
+
+  return dir;
+}
+
+
+static void walk_dir_free(struct walk_dir* dir) {
+  uv__free(dir->entries);
+  uv__free(dir->paths);
+  uv__free(dir);
+}
+
+
+static uv_dirent_type_t walk_stat_type(const uv_stat_t* statbuf) {
+  switch (statbuf->st_mode & S_IFMT) {
+    case S_IFDIR:
+      return UV_DIRENT_DIR;
+    case S_IFREG:
+      return UV_DIRENT_FILE;
+    case S_IFLNK:
+      return UV_DIRENT_LINK;
+    default:
+      return UV_DIRENT_UNKNOWN;
+  }
+}
+
+
+/* Runs on the threadpool. Reads the directory into a single entries array
+ * (followed by the stat buffers when UV_FS_WALK_STAT is set) and a single
+ * block of joined paths.
+ */
+static void walk_work(uv_work_t* req) {
+  struct walk_dir* dir;
+  uv_stat_t* statbufs;
+  uv_dirent_t dent;
+  uv_fs_t fs_req;
+  size_t* offsets;
+  size_t pathlen;
+  size_t namelen;
+  size_t used;
+  size_t size;
+  size_t cap;
+  unsigned int i;
+  char* paths;
+  char* tmp;
+  int do_stat;
+  int r;
+
+  dir = container_of(req, struct walk_dir, work_req);
+  do_stat = dir->ctx->flags & UV_FS_WALK_STAT;
+
+  r = uv_fs_scandir(NULL, &fs_req, dir->path, UV_FS_SCANDIR_UNSORTED, NULL);
+  if (r <= 0) {
+    dir->status = r;
+    uv_fs_req_cleanup(&fs_req);
+    return;
+  }
+
+  size = r * sizeof(*dir->entries);
+  if (do_stat)
+    size += r * sizeof(*statbufs);
+
+  dir->entries = uv__malloc(size);
+  offsets = uv__malloc(r * sizeof(*offsets));
+  statbufs = (uv_stat_t*) (dir->entries + r);
+  pathlen = strlen(dir->path);
+  paths = NULL;
+  used = 0;
+  cap = 0;
+  i = 0;
+
+  if (dir->entries == NULL || offsets == NULL)
+    goto nomem;
+
+  while (i < (unsigned int) r && 0 == uv_fs_scandir_next(&fs_req, &dent)) {
+    namelen = strlen(dent.name);
+    if (used + pathlen + namelen + 2 > cap) {
+      cap = 2 * cap + pathlen + namelen + 2;
+      tmp = uv__realloc(paths, cap);
+      if (tmp == NULL)
+        goto nomem;
+      paths = tmp;
+    }
+
+    offsets[i] = used;
+    memcpy(paths + used, dir->path, pathlen);
+    paths[used + pathlen] = '/';
+    memcpy(paths + used + pathlen + 1, dent.name, namelen + 1);
+    used += pathlen + namelen + 2;
+
+    dir->entries[i].type = dent.type;
+    dir->entries[i].depth = dir->depth + 1;
+    dir->entries[i].statbuf = NULL;
+
+    /* Not every file system reports the type, find out with lstat(). */
+    if (do_stat || dent.type == UV_DIRENT_UNKNOWN) {
+      uv_fs_t stat_req;
+
+      if (0 == uv_fs_lstat(NULL, &stat_req, paths + offsets[i], NULL)) {
+        dir->entries[i].type = walk_stat_type(&stat_req.statbuf);
+        if (do_stat) {
+          statbufs[i] = stat_req.statbuf;
+          dir->entries[i].statbuf = &statbufs[i];
+        }
+      }
+      uv_fs_req_cleanup(&stat_req);
+    }
+
+    i++;
+  }
+
+  for (dir->nentries = i, i = 0; i < dir->nentries; i++)
+    dir->entries[i].path = paths + offsets[i];
+
+  dir->paths = paths;
+  uv__free(offsets);
+  uv_fs_req_cleanup(&fs_req);
+  return;
+
+nomem:
+  dir->status = UV_ENOMEM;
+  uv__free(dir->entries);
+  dir->entries = NULL;
+  uv__free(offsets);
+  uv__free(paths);
+  uv_fs_req_cleanup(&fs_req);
+}
+
+
+/* Runs on the loop thread. Hands the batch to the user and queues the
+ * subdirectories that should be descended into.
+ */
+static void walk_after_work(uv_work_t* req, int status) {
+  struct walk_ctx* ctx;
+  struct walk_dir* child;
+  struct walk_dir* dir;
+  uv_fs_walk_entry_t self;
+  uv_fs_walk_entry_t* ent;
+  unsigned int i;
+
+  dir = container_of(req, struct walk_dir, work_req);
+  ctx = dir->ctx;
+  ctx->active--;
+
+  if (status == 0)
+    status = dir->status;
+
+  if (!ctx->stopped) {
+    if (status < 0) {
+      self.path = dir->path;
+      self.type = UV_DIRENT_DIR;
+      self.depth = dir->depth;
+      self.statbuf = NULL;
+      ctx->walk_cb(ctx->walk, status, &self, 1);
+    } else if (dir->nentries > 0) {
+      ctx->walk_cb(ctx->walk, 0, dir->entries, dir->nentries);
+    }
+  }
+
+  for (i = 0; i < dir->nentries && !ctx->stopped; i++) {
+    ent = &dir->entries[i];
+
+    if (ent->type != UV_DIRENT_DIR)
+      continue;
+
+    if (ctx->max_depth != 0 && ent->depth >= ctx->max_depth)
+      continue;
+
+    if (ctx->filter_cb != NULL && !ctx->filter_cb(ctx->walk, ent))
+      continue;
+
+    child = walk_dir_new(ctx, ent->path, ent->depth);
+    if (child == NULL) {
+      self.path = ent->path;
+      self.type = UV_DIRENT_DIR;
+      self.depth = ent->depth;
+      self.statbuf = NULL;
+      ctx->walk_cb(ctx->walk, UV_ENOMEM, &self, 1);
+      continue;
+    }
+
+    QUEUE_INSERT_TAIL(&ctx->pending, &child->member);
+  }
+
+  walk_dir_free(dir);
+  walk_schedule(ctx);
+}
+
+
+static void walk_schedule(struct walk_ctx* ctx) {
+  struct walk_dir* dir;
+  uv_fs_walk_t* walk;
+  QUEUE* q;
+  int err;
+
+  while (!ctx->stopped &&
+         ctx->active < ctx->concurrency &&
+         !QUEUE_EMPTY(&ctx->pending)) {
+    q = QUEUE_HEAD(&ctx->pending);
+    QUEUE_REMOVE(q);
+    dir = QUEUE_DATA(q, struct walk_dir, member);
+
+    ctx->active++;
+    err = uv_queue_work(ctx->walk->loop,
+                        &dir->work_req,
+                        walk_work,
+                        walk_after_work);
+    if (err) {
+      walk_after_work(&dir->work_req, err);
+      return;
+    }
+  }
+
+  if (ctx->active > 0)
+    return;
+
+  if (!ctx->stopped && !QUEUE_EMPTY(&ctx->pending))
+    return;
+
+  while (!QUEUE_EMPTY(&ctx->pending)) {
+    q = QUEUE_HEAD(&ctx->pending);
+    QUEUE_REMOVE(q);
+    walk_dir_free(QUEUE_DATA(q, struct walk_dir, member));
+  }
+
+  walk = ctx->walk;
+  walk->walk_ctx = NULL;
+  err = ctx->stopped ? UV_ECANCELED : UV_EOF;
+  ctx->walk_cb(walk, err, NULL, 0);
+  uv__free(ctx);
+}
+
+
+int uv_fs_walk(uv_loop_t* loop,
+               uv_fs_walk_t* walk,
+               const char* path,
+               const uv_fs_walk_options_t* options,
+               uv_fs_walk_cb cb) {
+  struct walk_ctx* ctx;
+  struct walk_dir* root;
+
+  if (loop == NULL || walk == NULL || path == NULL || cb == NULL)
+    return UV_EINVAL;
+
+  ctx = uv__calloc(1, sizeof(*ctx));
+  if (ctx == NULL)
+    return UV_ENOMEM;
+
+  root = walk_dir_new(ctx, path, 0);
+  if (root == NULL) {
+    uv__free(ctx);
+    return UV_ENOMEM;
+  }
+
+  ctx->walk = walk;
+  ctx->walk_cb = cb;
+  ctx->concurrency = WALK_DEFAULT_CONCURRENCY;
+  QUEUE_INIT(&ctx->pending);
+  QUEUE_INSERT_TAIL(&ctx->pending, &root->member);
+
+  if (options != NULL) {
+    ctx->max_depth = options->max_depth;
+    ctx->flags = options->flags;
+    ctx->filter_cb = options->filter_cb;
+    if (options->concurrency != 0)
+      ctx->concurrency = options->concurrency;
+  }
+
+  walk->loop = loop;
+  walk->walk_ctx = ctx;
+  walk_schedule(ctx);
+
+  return 0;
+}
+
+
+int uv_fs_walk_stop(uv_fs_walk_t* walk) {
+  struct walk_ctx* ctx;
+
+  ctx = walk->walk_ctx;
+  if (ctx == NULL)
+    return UV_EINVAL;
+
+  ctx->stopped = 1;
+  return 0;
+}
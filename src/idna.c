@@ -267,15 +267,46 @@ static int uv__idna_toascii_label(const char* s, const char* se,
   return 0;
 }
 
+/* Checks eight bytes at a time for a byte with the high bit set. */
+static int uv__idna_is_ascii(const char* s, const char* se) {
+  uint64_t w;
+
+  for (; se - s >= (ptrdiff_t) sizeof(w); s += sizeof(w)) {
+    memcpy(&w, s, sizeof(w));
+    if (w & UINT64_C(0x8080808080808080))
+      return 0;
+  }
+
+  for (; s < se; s++)
+    if ((unsigned char) *s > 127)
+      return 0;
+
+  return 1;
+}
+
 long uv__idna_toascii(const char* s, const char* se, char* d, char* de) {
   const char* si;
   const char* st;
   unsigned c;
   char* ds;
+  size_t n;
   int rc;
 
   ds = d;
 
+  /* Nearly every host name is plain ASCII. Those come out unchanged, '.' is
+   * the only separator that can appear in them. */
+  if (uv__idna_is_ascii(s, se)) {
+    n = se - s;
+    if (n > (size_t) (de - d))
+      n = de - d;
+    memcpy(d, s, n);
+    d += n;
+    if (d < de)
+      *d++ = '\0';
+    return d - ds;
+  }
+
   si = s;
   while (si < se) {
     st = si;
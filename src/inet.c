@@ -15,7 +15,6 @@
  * OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-#include <stdio.h>
 #include <string.h>
 
 #if defined(_MSC_VER) && _MSC_VER < 1600
@@ -50,16 +49,48 @@ int uv_inet_ntop(int af, const void* src, char* dst, size_t size) {
 }
 
 
+/* Formatting by hand, snprintf() costs more than the rest of the function. */
+static char *inet_fmt_dec(char *tp, unsigned int val) {
+  if (val >= 100) {
+    *tp++ = '0' + val / 100;
+    val %= 100;
+    *tp++ = '0' + val / 10;
+  } else if (val >= 10) {
+    *tp++ = '0' + val / 10;
+  }
+  *tp++ = '0' + val % 10;
+  return tp;
+}
+
+
+static char *inet_fmt_hex(char *tp, unsigned int val) {
+  static const char xdigits[] = "0123456789abcdef";
+  int shift;
+
+  /* No leading zeroes, but at least one digit. */
+  for (shift = 12; shift > 0 && (val >> shift) == 0; shift -= 4);
+  for (; shift >= 0; shift -= 4)
+    *tp++ = xdigits[(val >> shift) & 0xf];
+  return tp;
+}
+
+
 static int inet_ntop4(const unsigned char *src, char *dst, size_t size) {
-  static const char fmt[] = "%u.%u.%u.%u";
-  char tmp[UV__INET_ADDRSTRLEN];
-  int l;
+  char tmp[UV__INET_ADDRSTRLEN], *tp;
+  int i;
 
-  l = snprintf(tmp, sizeof(tmp), fmt, src[0], src[1], src[2], src[3]);
-  if (l <= 0 || (size_t) l >= size) {
+  tp = tmp;
+  for (i = 0; i < 4; i++) {
+    if (i != 0)
+      *tp++ = '.';
+    tp = inet_fmt_dec(tp, src[i]);
+  }
+  *tp++ = '\0';
+
+  if ((size_t) (tp - tmp) > size) {
     return UV_ENOSPC;
   }
-  uv__strscpy(dst, tmp, size);
+  memcpy(dst, tmp, tp - tmp);
   return 0;
 }
 
@@ -135,7 +166,7 @@ static int inet_ntop6(const unsigned char *src, char *dst, size_t size) {
       tp += strlen(tp);
       break;
     }
-    tp += sprintf(tp, "%x", words[i]);
+    tp = inet_fmt_hex(tp, words[i]);
   }
   /* Was it a trailing run of 0x00's? */
   if (best.base != -1 && (best.base + best.len) == ARRAY_SIZE(words))
@@ -143,7 +174,7 @@ static int inet_ntop6(const unsigned char *src, char *dst, size_t size) {
   *tp++ = '\0';
   if ((size_t) (tp - tmp) > size)
     return UV_ENOSPC;
-  uv__strscpy(dst, tmp, size);
+  memcpy(dst, tmp, tp - tmp);
   return 0;
 }
 
@@ -177,8 +208,18 @@ int uv_inet_pton(int af, const char* src, void* dst) {
 }
 
 
+/* Returns the value of hex digit `ch`, or -1. */
+static int inet_xdigit(int ch) {
+  if (ch >= '0' && ch <= '9')
+    return ch - '0';
+  ch |= 0x20;  /* Lower case. */
+  if (ch >= 'a' && ch <= 'f')
+    return ch - 'a' + 10;
+  return -1;
+}
+
+
 static int inet_pton4(const char *src, unsigned char *dst) {
-  static const char digits[] = "0123456789";
   int saw_digit, octets, ch;
   unsigned char tmp[sizeof(struct in_addr)], *tp;
 
@@ -186,10 +227,8 @@ static int inet_pton4(const char *src, unsigned char *dst) {
   octets = 0;
   *(tp = tmp) = 0;
   while ((ch = *src++) != '\0') {
-    const char *pch;
-
-    if ((pch = strchr(digits, ch)) != NULL) {
-      unsigned int nw = *tp * 10 + (pch - digits);
+    if (ch >= '0' && ch <= '9') {
+      unsigned int nw = *tp * 10 + (ch - '0');
 
       if (saw_digit && *tp == 0)
         return UV_EINVAL;
@@ -217,11 +256,9 @@ static int inet_pton4(const char *src, unsigned char *dst) {
 
 
 static int inet_pton6(const char *src, unsigned char *dst) {
-  static const char xdigits_l[] = "0123456789abcdef",
-                    xdigits_u[] = "0123456789ABCDEF";
   unsigned char tmp[sizeof(struct in6_addr)], *tp, *endp, *colonp;
-  const char *xdigits, *curtok;
-  int ch, seen_xdigits;
+  const char *curtok;
+  int ch, digit, seen_xdigits;
   unsigned int val;
 
   memset((tp = tmp), '\0', sizeof tmp);
@@ -235,13 +272,10 @@ static int inet_pton6(const char *src, unsigned char *dst) {
   seen_xdigits = 0;
   val = 0;
   while ((ch = *src++) != '\0') {
-    const char *pch;
-
-    if ((pch = strchr((xdigits = xdigits_l), ch)) == NULL)
-      pch = strchr((xdigits = xdigits_u), ch);
-    if (pch != NULL) {
+    digit = inet_xdigit(ch);
+    if (digit != -1) {
       val <<= 4;
-      val |= (pch - xdigits);
+      val |= digit;
       if (++seen_xdigits > 4)
         return UV_EINVAL;
       continue;
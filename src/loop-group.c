@@ -0,0 +1,280 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* A loop group owns |nloops| loops and a thread for each of them. Every
+ * loop has a channel for the messages that other threads send it, the
+ * channel also keeps the loop alive until the group is closed.
+ */
+
+#include "uv.h"
+#include "uv-common.h"
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdlib.h>  /* abort() */
+
+struct uv__loop_group_member {
+  uv_loop_t loop;
+  uv_channel_t channel;
+  uv_channel_msg_t stop_msg;
+  uv_thread_t thread;
+  uv_loop_group_t* group;
+  unsigned int cpu;
+};
+
+
+static struct uv__loop_group_member* member_get(const uv_loop_group_t* group,
+                                                unsigned int index) {
+  return (struct uv__loop_group_member*) group->members + index;
+}
+
+
+static void loop_group_channel_cb(uv_channel_t* channel,
+                                  uv_channel_msg_t* msg) {
+  struct uv__loop_group_member* m;
+
+  m = container_of(channel, struct uv__loop_group_member, channel);
+  if (msg == &m->stop_msg) {
+    /* The loop ends once the handles of the user are closed as well. */
+    uv_close((uv_handle_t*) channel, NULL);
+    return;
+  }
+
+  m->group->msg_cb(m->group, &m->loop, msg);
+}
+
+
+static void loop_group_thread(void* arg) {
+  struct uv__loop_group_member* m;
+
+  m = arg;
+
+  /* Best effort, the loop works the same when it floats. */
+  if (m->group->flags & UV_LOOP_GROUP_PIN_THREADS)
+    uv__thread_pin(m->cpu);
+
+  uv_run(&m->loop, UV_RUN_DEFAULT);
+}
+
+
+static void loop_group_stop(uv_loop_group_t* group, unsigned int nthreads) {
+  struct uv__loop_group_member* m;
+  unsigned int i;
+
+  for (i = 0; i < nthreads; i++)
+    uv_channel_send(&member_get(group, i)->channel,
+                    &member_get(group, i)->stop_msg);
+
+  for (i = 0; i < nthreads; i++) {
+    m = member_get(group, i);
+    if (uv_thread_join(&m->thread))
+      abort();
+  }
+}
+
+
+/* Closes the first |nloops| loops, the last one first. The first loop owns
+ * the shared threadpool, it goes away with the last reference to it.
+ */
+static int loop_group_close_loops(uv_loop_group_t* group,
+                                  unsigned int nloops) {
+  struct uv__loop_group_member* m;
+  int err;
+  int rc;
+
+  rc = 0;
+  while (nloops > 0) {
+    m = member_get(group, --nloops);
+
+    /* Runs the close callback of a channel that was never started. */
+    if (!uv__is_closing(&m->channel))
+      uv_close((uv_handle_t*) &m->channel, NULL);
+    uv_run(&m->loop, UV_RUN_DEFAULT);
+
+    err = uv_loop_close(&m->loop);
+    if (err != 0 && rc == 0)
+      rc = err;
+  }
+
+  return rc;
+}
+
+
+int uv_loop_group_init(uv_loop_group_t* group,
+                       unsigned int nloops,
+                       unsigned int nthreads,
+                       unsigned int flags,
+                       uv_loop_group_cb msg_cb) {
+  struct uv__loop_group_member* m;
+  uv_cpu_info_t* cpu_infos;
+  unsigned int ncpus;
+  unsigned int nready;
+  unsigned int i;
+  int count;
+  int err;
+
+  if (nloops == 0 || msg_cb == NULL)
+    return UV_EINVAL;
+
+  if (flags & ~(UV_LOOP_GROUP_PIN_THREADS | UV_LOOP_GROUP_LEAST_LOADED))
+    return UV_EINVAL;
+
+  if (nloops > UINT_MAX / sizeof(*m))
+    return UV_EINVAL;
+
+  group->members = uv__calloc(nloops, sizeof(*m));
+  if (group->members == NULL)
+    return UV_ENOMEM;
+
+  group->nloops = nloops;
+  group->flags = flags;
+  group->next = 0;
+  group->msg_cb = msg_cb;
+
+  ncpus = nloops;
+  if (flags & UV_LOOP_GROUP_PIN_THREADS)
+    if (uv_cpu_info(&cpu_infos, &count) == 0) {
+      if (count > 0)
+        ncpus = count;
+      uv_free_cpu_info(cpu_infos, count);
+    }
+
+  for (nready = 0; nready < nloops; nready++) {
+    m = member_get(group, nready);
+    m->group = group;
+    m->cpu = nready % ncpus;
+
+    err = uv_loop_init(&m->loop);
+    if (err)
+      goto fail;
+
+    err = uv_channel_init(&m->loop, &m->channel, loop_group_channel_cb);
+    if (err) {
+      uv_loop_close(&m->loop);
+      goto fail;
+    }
+  }
+
+  /* The loops share one pool rather than each getting one of their own. */
+  if (nthreads > 0) {
+    err = uv__threadpool_loop_configure(&member_get(group, 0)->loop,
+                                        nthreads);
+    for (i = 1; err == 0 && i < nloops; i++)
+      err = uv__threadpool_loop_share(&member_get(group, i)->loop,
+                                      &member_get(group, 0)->loop);
+    if (err)
+      goto fail;
+  }
+
+  for (i = 0; i < nloops; i++) {
+    m = member_get(group, i);
+    err = uv_thread_create(&m->thread, loop_group_thread, m);
+    if (err) {
+      loop_group_stop(group, i);
+      goto fail;
+    }
+  }
+
+  return 0;
+
+fail:
+  loop_group_close_loops(group, nready);
+  uv__free(group->members);
+  group->members = NULL;
+  return err;
+}
+
+
+/* Must not be called from one of the threads of the group. */
+int uv_loop_group_close(uv_loop_group_t* group) {
+  int err;
+
+  if (group->members == NULL)
+    return UV_EINVAL;
+
+  loop_group_stop(group, group->nloops);
+  err = loop_group_close_loops(group, group->nloops);
+  if (err)
+    return err;
+
+  uv__free(group->members);
+  group->members = NULL;
+  return 0;
+}
+
+
+unsigned int uv_loop_group_size(const uv_loop_group_t* group) {
+  return group->nloops;
+}
+
+
+uv_loop_t* uv_loop_group_get(const uv_loop_group_t* group,
+                             unsigned int index) {
+  if (index >= group->nloops)
+    return NULL;
+
+  return &member_get(group, index)->loop;
+}
+
+
+/* The load of a loop is read from another thread, it's only a hint. */
+static unsigned int loop_group_load(const uv_loop_t* loop) {
+  return *(const volatile unsigned int*) &loop->active_handles +
+         *(const volatile unsigned int*) &loop->active_reqs.count;
+}
+
+
+unsigned int uv_loop_group_next(uv_loop_group_t* group) {
+  unsigned int best_load;
+  unsigned int start;
+  unsigned int best;
+  unsigned int load;
+  unsigned int i;
+  unsigned int k;
+
+  /* Start the scan where the rotation is, that spreads out ties. */
+  start = group->next++ % group->nloops;
+  best = start;
+  if (!(group->flags & UV_LOOP_GROUP_LEAST_LOADED))
+    return best;
+
+  best_load = loop_group_load(&member_get(group, best)->loop);
+  for (k = 1; k < group->nloops; k++) {
+    i = (start + k) % group->nloops;
+    load = loop_group_load(&member_get(group, i)->loop);
+    if (load < best_load) {
+      best = i;
+      best_load = load;
+    }
+  }
+
+  return best;
+}
+
+
+int uv_loop_group_send(uv_loop_group_t* group,
+                       unsigned int index,
+                       uv_channel_msg_t* msg) {
+  if (index >= group->nloops)
+    return UV_EINVAL;
+
+  return uv_channel_send(&member_get(group, index)->channel, msg);
+}
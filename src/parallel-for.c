@@ -0,0 +1,187 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Fan-out and fan-in over a range. A few runners are queued on the
+ * threadpool, never more than it has threads, and each of them claims
+ * chunks of |grain| indices until the range is used up. Runners that start
+ * late simply find less work left, so uneven chunks even out by themselves.
+ */
+
+#define UV__ALLOC_TAG UV_ALLOC_TAG_THREADPOOL
+
+#include "uv.h"
+#include "uv-common.h"
+
+#include <assert.h>
+#include <string.h>
+
+/* Chunks per runner when the caller leaves the grain to us. */
+#define PARALLEL_FOR_CHUNKS_PER_RUNNER 4
+
+struct pfor_runner {
+  uv_work_t req;
+  struct pfor_ctx* ctx;
+};
+
+struct pfor_ctx {
+  uv_parallel_for_t* pfor;
+  uv_parallel_for_cb body_cb;
+  uv_parallel_for_done_cb done_cb;
+  uv_mutex_t mutex;
+  size_t next;  /* Protected by |mutex|. */
+  size_t end;
+  size_t grain;
+  unsigned int running;
+  int status;
+  struct pfor_runner runners[1];  /* variable length */
+};
+
+
+static void pfor_work(uv_work_t* req) {
+  struct pfor_runner* runner;
+  struct pfor_ctx* ctx;
+  size_t begin;
+  size_t end;
+
+  runner = container_of(req, struct pfor_runner, req);
+  ctx = runner->ctx;
+
+  for (;;) {
+    uv_mutex_lock(&ctx->mutex);
+    begin = ctx->next;
+    end = begin + ctx->grain;
+    if (end > ctx->end || end < begin)
+      end = ctx->end;
+    ctx->next = end;
+    uv_mutex_unlock(&ctx->mutex);
+
+    if (begin == end)
+      break;
+
+    ctx->body_cb(ctx->pfor, begin, end);
+  }
+}
+
+
+static void pfor_after_work(uv_work_t* req, int status) {
+  uv_parallel_for_done_cb done_cb;
+  struct pfor_runner* runner;
+  uv_parallel_for_t* pfor;
+  struct pfor_ctx* ctx;
+
+  runner = container_of(req, struct pfor_runner, req);
+  ctx = runner->ctx;
+
+  /* A runner that was cancelled leaves its chunks to the others. */
+  if (status != 0)
+    ctx->status = status;
+
+  if (--ctx->running > 0)
+    return;
+
+  /* Only an error if nobody got to part of the range. */
+  status = 0;
+  if (ctx->next != ctx->end)
+    status = ctx->status;
+
+  pfor = ctx->pfor;
+  done_cb = ctx->done_cb;
+  uv_mutex_destroy(&ctx->mutex);
+  uv__free(ctx);
+  pfor->pfor_ctx = NULL;
+
+  if (done_cb != NULL)
+    done_cb(pfor, status);
+}
+
+
+int uv_parallel_for(uv_loop_t* loop,
+                    uv_parallel_for_t* pfor,
+                    size_t begin,
+                    size_t end,
+                    size_t grain,
+                    uv_parallel_for_cb body_cb,
+                    uv_parallel_for_done_cb done_cb) {
+  uv_threadpool_metrics_t metrics;
+  uv_work_t* reqs[64];
+  struct pfor_ctx* ctx;
+  unsigned int nrunners;
+  unsigned int i;
+  size_t nchunks;
+  int err;
+
+  if (loop == NULL || pfor == NULL || body_cb == NULL || begin >= end)
+    return UV_EINVAL;
+
+  memset(&metrics, 0, sizeof(metrics));
+  err = uv_threadpool_metrics(loop, &metrics);
+  if (err)
+    return err;
+
+  nrunners = metrics.threads;
+  if (nrunners == 0)
+    nrunners = 1;
+  if (nrunners > ARRAY_SIZE(reqs))
+    nrunners = ARRAY_SIZE(reqs);
+
+  if (grain == 0) {
+    grain = (end - begin) / (nrunners * PARALLEL_FOR_CHUNKS_PER_RUNNER);
+    if (grain == 0)
+      grain = 1;
+  }
+
+  nchunks = (end - begin) / grain + ((end - begin) % grain != 0);
+  if (nrunners > nchunks)
+    nrunners = (unsigned int) nchunks;
+
+  ctx = uv__malloc(sizeof(*ctx) + (nrunners - 1) * sizeof(ctx->runners[0]));
+  if (ctx == NULL)
+    return UV_ENOMEM;
+
+  err = uv_mutex_init(&ctx->mutex);
+  if (err) {
+    uv__free(ctx);
+    return err;
+  }
+
+  ctx->pfor = pfor;
+  ctx->body_cb = body_cb;
+  ctx->done_cb = done_cb;
+  ctx->next = begin;
+  ctx->end = end;
+  ctx->grain = grain;
+  ctx->running = nrunners;
+  ctx->status = 0;
+
+  for (i = 0; i < nrunners; i++) {
+    ctx->runners[i].ctx = ctx;
+    reqs[i] = &ctx->runners[i].req;
+  }
+
+  pfor->loop = loop;
+  pfor->pfor_ctx = ctx;
+
+  err = uv_queue_work_batch(loop, reqs, nrunners, pfor_work, pfor_after_work);
+  assert(err == 0);
+  (void) err;
+
+  return 0;
+}
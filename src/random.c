@@ -22,10 +22,13 @@
 #include "uv.h"
 #include "uv-common.h"
 
+#include <string.h>
+
 #ifdef _WIN32
 #  include "win/internal.h"
 #else
 #  include "unix/internal.h"
+#  include <pthread.h>
 #endif
 
 static int uv__random(void* buf, size_t buflen) {
@@ -70,6 +73,243 @@ static int uv__random(void* buf, size_t buflen) {
 }
 
 
+/*
+ * UV_RANDOM_FAST: a ChaCha20 keystream per thread, built like OpenBSD's
+ * arc4random. It is seeded from uv__random() and seeded again after
+ * UV__DRBG_RESEED bytes and in the child after fork(). Every refill of the
+ * buffer takes the next key from the start of the new keystream, and bytes
+ * are wiped once they're handed out, so the state never tells what it
+ * produced before.
+ */
+#define UV__DRBG_KEYSZ 32
+#define UV__DRBG_IVSZ 8
+#define UV__DRBG_BUFSZ (16 * 64)
+#define UV__DRBG_RESEED (1600 * 1024)
+
+struct uv__drbg {
+  uint32_t input[16];
+  unsigned char buf[UV__DRBG_BUFSZ];
+  size_t have;  /* Unused bytes at the end of buf. */
+  size_t count;  /* Bytes until the next reseed. */
+  unsigned int generation;  /* uv__drbg_generation when last seeded. */
+  int seeded;
+};
+
+static uv_once_t uv__drbg_once = UV_ONCE_INIT;
+static unsigned int uv__drbg_generation;
+#ifdef _WIN32
+static DWORD uv__drbg_key;
+#else
+static pthread_key_t uv__drbg_key;
+#endif
+
+
+static void uv__drbg_wipe(void* p, size_t len) {
+  volatile unsigned char* q;
+
+  for (q = p; len > 0; len--)
+    *q++ = 0;
+}
+
+
+#ifdef _WIN32
+static void WINAPI uv__drbg_free(void* p) {
+#else
+static void uv__drbg_free(void* p) {
+#endif
+  if (p == NULL)
+    return;
+
+  uv__drbg_wipe(p, sizeof(struct uv__drbg));
+  uv__free(p);
+}
+
+
+#ifndef _WIN32
+static void uv__drbg_atfork(void) {
+  uv__drbg_generation++;
+}
+#endif
+
+
+static void uv__drbg_init(void) {
+#ifdef _WIN32
+  /* Fiber local storage, unlike TlsAlloc() it calls uv__drbg_free() when
+   * the thread exits. */
+  uv__drbg_key = FlsAlloc(uv__drbg_free);
+  if (uv__drbg_key == FLS_OUT_OF_INDEXES)
+    abort();
+#else
+  if (pthread_key_create(&uv__drbg_key, uv__drbg_free))
+    abort();
+  if (pthread_atfork(NULL, NULL, uv__drbg_atfork))
+    abort();
+#endif
+}
+
+
+#define UV__ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define UV__QUARTERROUND(x, a, b, c, d)                                       \
+  do {                                                                        \
+    x[a] += x[b]; x[d] = UV__ROTL32(x[d] ^ x[a], 16);                         \
+    x[c] += x[d]; x[b] = UV__ROTL32(x[b] ^ x[c], 12);                         \
+    x[a] += x[b]; x[d] = UV__ROTL32(x[d] ^ x[a], 8);                          \
+    x[c] += x[d]; x[b] = UV__ROTL32(x[b] ^ x[c], 7);                          \
+  } while (0)
+
+
+static uint32_t uv__load32le(const unsigned char* p) {
+  return (uint32_t) p[0] |
+         (uint32_t) p[1] << 8 |
+         (uint32_t) p[2] << 16 |
+         (uint32_t) p[3] << 24;
+}
+
+
+/* Keys the cipher with the first KEYSZ + IVSZ bytes of `p`. */
+static void uv__chacha20_keysetup(uint32_t input[16], const unsigned char* p) {
+  int i;
+
+  input[0] = 0x61707865;  /* "expand 32-byte k" */
+  input[1] = 0x3320646e;
+  input[2] = 0x79622d32;
+  input[3] = 0x6b206574;
+  for (i = 0; i < 8; i++)
+    input[4 + i] = uv__load32le(p + 4 * i);
+  input[12] = 0;
+  input[13] = 0;
+  input[14] = uv__load32le(p + UV__DRBG_KEYSZ);
+  input[15] = uv__load32le(p + UV__DRBG_KEYSZ + 4);
+}
+
+
+static void uv__chacha20_block(uint32_t input[16], unsigned char out[64]) {
+  uint32_t x[16];
+  int i;
+
+  memcpy(x, input, sizeof(x));
+  for (i = 0; i < 10; i++) {
+    UV__QUARTERROUND(x, 0, 4, 8, 12);
+    UV__QUARTERROUND(x, 1, 5, 9, 13);
+    UV__QUARTERROUND(x, 2, 6, 10, 14);
+    UV__QUARTERROUND(x, 3, 7, 11, 15);
+    UV__QUARTERROUND(x, 0, 5, 10, 15);
+    UV__QUARTERROUND(x, 1, 6, 11, 12);
+    UV__QUARTERROUND(x, 2, 7, 8, 13);
+    UV__QUARTERROUND(x, 3, 4, 9, 14);
+  }
+
+  for (i = 0; i < 16; i++) {
+    x[i] += input[i];
+    out[4 * i + 0] = (unsigned char) x[i];
+    out[4 * i + 1] = (unsigned char) (x[i] >> 8);
+    out[4 * i + 2] = (unsigned char) (x[i] >> 16);
+    out[4 * i + 3] = (unsigned char) (x[i] >> 24);
+  }
+
+  /* 64 bit block counter. */
+  if (++input[12] == 0)
+    input[13]++;
+
+  uv__drbg_wipe(x, sizeof(x));
+}
+
+
+/* Refills the buffer and rekeys from its first bytes, mixed with `seed`. */
+static void uv__drbg_rekey(struct uv__drbg* s,
+                           const unsigned char* seed,
+                           size_t seedlen) {
+  size_t i;
+
+  for (i = 0; i < sizeof(s->buf); i += 64)
+    uv__chacha20_block(s->input, s->buf + i);
+
+  for (i = 0; i < seedlen; i++)
+    s->buf[i] ^= seed[i];
+
+  uv__chacha20_keysetup(s->input, s->buf);
+  uv__drbg_wipe(s->buf, UV__DRBG_KEYSZ + UV__DRBG_IVSZ);
+  s->have = sizeof(s->buf) - UV__DRBG_KEYSZ - UV__DRBG_IVSZ;
+}
+
+
+static int uv__drbg_stir(struct uv__drbg* s) {
+  unsigned char seed[UV__DRBG_KEYSZ + UV__DRBG_IVSZ];
+  int err;
+
+  err = uv__random(seed, sizeof(seed));
+  if (err)
+    return err;
+
+  if (s->seeded)
+    uv__drbg_rekey(s, seed, sizeof(seed));
+  else
+    uv__chacha20_keysetup(s->input, seed);
+  uv__drbg_wipe(seed, sizeof(seed));
+
+  /* Nothing from before the reseed is handed out after it. */
+  uv__drbg_wipe(s->buf, sizeof(s->buf));
+  s->have = 0;
+  s->count = UV__DRBG_RESEED;
+  s->generation = uv__drbg_generation;
+  s->seeded = 1;
+  return 0;
+}
+
+
+static int uv__drbg_fill(unsigned char* out, size_t len) {
+  struct uv__drbg* s;
+  unsigned char* p;
+  size_t n;
+  int err;
+
+  uv_once(&uv__drbg_once, uv__drbg_init);
+#ifdef _WIN32
+  s = FlsGetValue(uv__drbg_key);
+#else
+  s = pthread_getspecific(uv__drbg_key);
+#endif
+
+  if (s == NULL) {
+    s = uv__calloc(1, sizeof(*s));
+    if (s == NULL)
+      return UV_ENOMEM;
+#ifdef _WIN32
+    if (!FlsSetValue(uv__drbg_key, s)) {
+#else
+    if (pthread_setspecific(uv__drbg_key, s)) {
+#endif
+      uv__free(s);
+      return UV_ENOMEM;
+    }
+  }
+
+  if (!s->seeded || s->generation != uv__drbg_generation || s->count <= len) {
+    err = uv__drbg_stir(s);
+    if (err)
+      return err;
+  }
+
+  s->count = s->count > len ? s->count - len : 0;
+
+  while (len > 0) {
+    if (s->have == 0)
+      uv__drbg_rekey(s, NULL, 0);
+
+    n = len < s->have ? len : s->have;
+    p = s->buf + sizeof(s->buf) - s->have;
+    memcpy(out, p, n);
+    uv__drbg_wipe(p, n);
+    out += n;
+    len -= n;
+    s->have -= n;
+  }
+
+  return 0;
+}
+
+
 static void uv__random_work(struct uv__work* w) {
   uv_random_t* req;
 
@@ -78,6 +318,12 @@ static void uv__random_work(struct uv__work* w) {
 }
 
 
+/* UV_RANDOM_FAST requests are filled by uv_random(), the pool only gets the
+ * callback off the caller's stack. */
+static void uv__random_fast_work(struct uv__work* w) {
+}
+
+
 static void uv__random_done(struct uv__work* w, int status) {
   uv_random_t* req;
 
@@ -100,11 +346,14 @@ int uv_random(uv_loop_t* loop,
   if (buflen > 0x7FFFFFFFu)
     return UV_E2BIG;
 
-  if (flags != 0)
+  if (flags & ~UV_RANDOM_FAST)
     return UV_EINVAL;
 
-  if (cb == NULL)
+  if (cb == NULL) {
+    if (flags & UV_RANDOM_FAST)
+      return uv__drbg_fill(buf, buflen);
     return uv__random(buf, buflen);
+  }
 
   uv__req_init(loop, req, UV_RANDOM);
   req->loop = loop;
@@ -113,6 +362,16 @@ int uv_random(uv_loop_t* loop,
   req->buf = buf;
   req->buflen = buflen;
 
+  if (flags & UV_RANDOM_FAST) {
+    req->status = uv__drbg_fill(buf, buflen);
+    uv__work_submit(loop,
+                    &req->work_req,
+                    UV__WORK_CPU,
+                    uv__random_fast_work,
+                    uv__random_done);
+    return 0;
+  }
+
   uv__work_submit(loop,
                   &req->work_req,
                   UV__WORK_CPU,
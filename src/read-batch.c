@@ -0,0 +1,145 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/* Read batches. Streams that read with uv_read_batched_cb() don't call into
+ * the application for every read. Their results are added to an array in
+ * the loop and handed over in one go at the end of the loop phase, so all
+ * the reads of that phase happen before any of the parsing.
+ */
+
+#include "uv.h"
+#include "uv-common.h"
+
+#define READ_BATCH_MIN_SIZE 64
+
+
+static void read_batch_flush(uv_loop_t* loop, uv_read_result_t* results,
+                             size_t nresults) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->read_batch_cb != NULL)
+    lfields->read_batch_cb(loop, results, nresults);
+}
+
+
+static void read_batch_ready(uv_defer_t* req) {
+  uv__loop_internal_fields_t* lfields;
+  uv_read_result_t* results;
+  uv_loop_t* loop;
+  size_t nresults;
+  size_t size;
+
+  loop = req->data;
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->read_batch_cb == NULL || lfields->read_batch_count == 0)
+    return;
+
+  /* Take the array so that reads that come in from the callback start a
+   * batch of their own.
+   */
+  results = lfields->read_batch;
+  nresults = lfields->read_batch_count;
+  size = lfields->read_batch_size;
+  lfields->read_batch = NULL;
+  lfields->read_batch_count = 0;
+  lfields->read_batch_size = 0;
+
+  read_batch_flush(loop, results, nresults);
+
+  /* Reuse it for the next batch unless one was started in the meantime. */
+  if (lfields->read_batch == NULL) {
+    lfields->read_batch = results;
+    lfields->read_batch_size = size;
+  } else {
+    uv__free(results);
+  }
+}
+
+
+static int read_batch_grow(uv__loop_internal_fields_t* lfields) {
+  uv_read_result_t* results;
+  size_t size;
+
+  size = lfields->read_batch_size * 2;
+  if (size == 0)
+    size = READ_BATCH_MIN_SIZE;
+
+  if (size < lfields->read_batch_size || size > (size_t) -1 / sizeof(*results))
+    return UV_ENOMEM;
+
+  results = uv__realloc(lfields->read_batch, size * sizeof(*results));
+  if (results == NULL)
+    return UV_ENOMEM;
+
+  lfields->read_batch = results;
+  lfields->read_batch_size = size;
+  return 0;
+}
+
+
+void uv_loop_set_read_batch_cb(uv_loop_t* loop, uv_read_batch_cb cb) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  lfields->read_batch_cb = cb;
+
+  /* Hand over what was read before there was a callback. */
+  if (cb != NULL && lfields->read_batch_count != 0) {
+    lfields->read_batch_req.data = loop;
+    uv_defer(loop, &lfields->read_batch_req, read_batch_ready);
+  }
+}
+
+
+void uv_read_batched_cb(uv_stream_t* stream,
+                        ssize_t nread,
+                        const uv_buf_t* buf) {
+  uv__loop_internal_fields_t* lfields;
+  uv_read_result_t result;
+  uv_loop_t* loop;
+
+  /* Nothing was read and there's no buffer to give back. */
+  if (nread == 0 && buf->base == NULL)
+    return;
+
+  loop = stream->loop;
+  lfields = uv__get_internal_fields(loop);
+  result.stream = stream;
+  result.nread = nread;
+  result.buf = *buf;
+
+  if (lfields->read_batch_count == lfields->read_batch_size &&
+      read_batch_grow(lfields) != 0) {
+    /* Out of memory, this one goes out on its own. */
+    read_batch_flush(loop, &result, 1);
+    return;
+  }
+
+  lfields->read_batch[lfields->read_batch_count++] = result;
+
+  /* Once per batch, UV_EBUSY means it's queued already. */
+  if (lfields->read_batch_cb != NULL) {
+    lfields->read_batch_req.data = loop;
+    uv_defer(loop, &lfields->read_batch_req, read_batch_ready);
+  }
+}
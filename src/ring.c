@@ -0,0 +1,354 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Bounded rings of pointers. Positions run freely and are masked on use, so
+ * all slots are usable and full and empty don't need a spare slot to tell
+ * them apart.
+ *
+ * The single producer, single consumer ring only ever has one writer per
+ * position and gets by with loads and stores. The multi producer, multi
+ * consumer ring gives each cell a sequence number that says whose turn it
+ * is, and producers and consumers claim positions with a compare-and-swap.
+ *
+ * When the ring has an async handle, the producer that fills a ring the
+ * consumer has emptied sends the wakeup. Both sides issue a full fence
+ * between publishing their own position and reading the other's, so either
+ * the consumer sees the new item or the producer sees the ring was empty.
+ */
+
+#include "uv.h"
+#include "uv-common.h"
+
+#ifdef _WIN32
+#include "win/internal.h"
+#else
+#include "unix/atomic-ops.h"
+#endif
+
+#include <string.h>
+
+#if defined(__clang__) ||                                                     \
+    defined(__GNUC__) && (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ >= 7)
+#define UV__RING_ATOMICS 1
+#endif
+
+#if !defined(UV__RING_ATOMICS) && defined(_MSC_VER)
+#include <intrin.h>
+#if defined(_M_IX86) || defined(_M_X64)
+/* Plain loads and stores are already ordered, only the compiler isn't. */
+#define ring_barrier() _ReadWriteBarrier()
+#else
+#define ring_barrier() MemoryBarrier()
+#endif
+#endif
+
+#define UV__RING_MAX_CAPACITY (1u << 31)
+
+struct uv__ring_cell {
+  unsigned int seq;
+  void* item;
+};
+
+
+static unsigned int ring_load(unsigned int* p) {
+#if defined(UV__RING_ATOMICS)
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#elif defined(_MSC_VER)
+  unsigned int val;
+
+  val = *(volatile unsigned int*) p;
+  ring_barrier();
+  return val;
+#else
+  unsigned int val;
+
+  val = *(volatile unsigned int*) p;
+  __sync_synchronize();
+  return val;
+#endif
+}
+
+
+static void ring_store(unsigned int* p, unsigned int val) {
+#if defined(UV__RING_ATOMICS)
+  __atomic_store_n(p, val, __ATOMIC_RELEASE);
+#elif defined(_MSC_VER)
+  ring_barrier();
+  *(volatile unsigned int*) p = val;
+#else
+  __sync_synchronize();
+  *(volatile unsigned int*) p = val;
+#endif
+}
+
+
+static unsigned int ring_cmpxchg(unsigned int* p,
+                                 unsigned int oldval,
+                                 unsigned int newval) {
+#ifdef _WIN32
+  return (unsigned int) InterlockedCompareExchange((LONG volatile*) p,
+                                                   (LONG) newval,
+                                                   (LONG) oldval);
+#else
+  return (unsigned int) cmpxchgi((int*) p, (int) oldval, (int) newval);
+#endif
+}
+
+
+static void ring_fence(void) {
+#if defined(UV__RING_ATOMICS)
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#elif defined(_WIN32)
+  MemoryBarrier();
+#else
+  __sync_synchronize();
+#endif
+}
+
+
+static int ring_size(unsigned int capacity,
+                     size_t elem_size,
+                     unsigned int* size) {
+  unsigned int n;
+
+  if (capacity == 0 || capacity > UV__RING_MAX_CAPACITY)
+    return UV_EINVAL;
+
+  n = 1;
+  while (n < capacity)
+    n <<= 1;
+
+  if (n > (size_t) -1 / elem_size)
+    return UV_ENOMEM;
+
+  *size = n;
+  return 0;
+}
+
+
+int uv_spsc_ring_init(uv_spsc_ring_t* ring,
+                      unsigned int capacity,
+                      uv_async_t* async) {
+  unsigned int size;
+  int err;
+
+  err = ring_size(capacity, sizeof(*ring->slots), &size);
+  if (err)
+    return err;
+
+  ring->slots = uv__malloc(size * sizeof(*ring->slots));
+  if (ring->slots == NULL)
+    return UV_ENOMEM;
+
+  memset(&ring->head, 0, sizeof(ring->head));
+  memset(&ring->tail, 0, sizeof(ring->tail));
+  ring->mask = size - 1;
+  ring->async = async;
+  return 0;
+}
+
+
+void uv_spsc_ring_destroy(uv_spsc_ring_t* ring) {
+  uv__free(ring->slots);
+  ring->slots = NULL;
+}
+
+
+int uv_spsc_ring_push(uv_spsc_ring_t* ring, void* item) {
+  unsigned int tail;
+  unsigned int head;
+
+  /* Only the producer writes |tail|, it can read it without ceremony. */
+  tail = ring->tail.index.pos;
+  if (tail - ring->tail.index.cached > ring->mask) {
+    ring->tail.index.cached = ring_load(&ring->head.index.pos);
+    if (tail - ring->tail.index.cached > ring->mask)
+      return UV_ENOBUFS;
+  }
+
+  ring->slots[tail & ring->mask] = item;
+  ring_store(&ring->tail.index.pos, tail + 1);
+
+  if (ring->async == NULL)
+    return 0;
+
+  ring_fence();
+  head = ring_load(&ring->head.index.pos);
+  ring->tail.index.cached = head;
+
+  if (head == tail)
+    uv_async_send(ring->async);
+
+  return 0;
+}
+
+
+int uv_spsc_ring_pop(uv_spsc_ring_t* ring, void** item) {
+  unsigned int head;
+
+  head = ring->head.index.pos;
+  if (head == ring->head.index.cached) {
+    ring->head.index.cached = ring_load(&ring->tail.index.pos);
+
+    if (head == ring->head.index.cached) {
+      if (ring->async == NULL)
+        return UV_EAGAIN;
+
+      /* Look again after the fence before the producer is left to wake us. */
+      ring_fence();
+      ring->head.index.cached = ring_load(&ring->tail.index.pos);
+      if (head == ring->head.index.cached)
+        return UV_EAGAIN;
+    }
+  }
+
+  *item = ring->slots[head & ring->mask];
+  ring_store(&ring->head.index.pos, head + 1);
+  return 0;
+}
+
+
+unsigned int uv_spsc_ring_capacity(const uv_spsc_ring_t* ring) {
+  return ring->mask + 1;
+}
+
+
+int uv_mpmc_ring_init(uv_mpmc_ring_t* ring,
+                      unsigned int capacity,
+                      uv_async_t* async) {
+  struct uv__ring_cell* cells;
+  unsigned int size;
+  unsigned int i;
+  int err;
+
+  err = ring_size(capacity, sizeof(*cells), &size);
+  if (err)
+    return err;
+
+  cells = uv__malloc(size * sizeof(*cells));
+  if (cells == NULL)
+    return UV_ENOMEM;
+
+  /* A cell is free for the producer at position |seq|. */
+  for (i = 0; i < size; i++) {
+    cells[i].seq = i;
+    cells[i].item = NULL;
+  }
+
+  memset(&ring->head, 0, sizeof(ring->head));
+  memset(&ring->tail, 0, sizeof(ring->tail));
+  ring->cells = cells;
+  ring->mask = size - 1;
+  ring->async = async;
+  return 0;
+}
+
+
+void uv_mpmc_ring_destroy(uv_mpmc_ring_t* ring) {
+  uv__free(ring->cells);
+  ring->cells = NULL;
+}
+
+
+int uv_mpmc_ring_push(uv_mpmc_ring_t* ring, void* item) {
+  struct uv__ring_cell* cell;
+  unsigned int prev;
+  unsigned int pos;
+  unsigned int seq;
+  int diff;
+
+  pos = ring_load(&ring->tail.index.pos);
+  for (;;) {
+    cell = (struct uv__ring_cell*) ring->cells + (pos & ring->mask);
+    seq = ring_load(&cell->seq);
+    diff = (int) (seq - pos);
+
+    if (diff == 0) {
+      prev = ring_cmpxchg(&ring->tail.index.pos, pos, pos + 1);
+      if (prev == pos)
+        break;
+      pos = prev;
+    } else if (diff < 0) {
+      /* Still holds the item from the previous lap. */
+      return UV_ENOBUFS;
+    } else {
+      /* Another producer took |pos|. */
+      pos = ring_load(&ring->tail.index.pos);
+    }
+  }
+
+  cell->item = item;
+  ring_store(&cell->seq, pos + 1);
+
+  if (ring->async == NULL)
+    return 0;
+
+  /* Only the item at the consumers' position can have been missed. */
+  ring_fence();
+  if (ring_load(&ring->head.index.pos) == pos)
+    uv_async_send(ring->async);
+
+  return 0;
+}
+
+
+int uv_mpmc_ring_pop(uv_mpmc_ring_t* ring, void** item) {
+  struct uv__ring_cell* cell;
+  unsigned int prev;
+  unsigned int pos;
+  unsigned int seq;
+  int fenced;
+  int diff;
+
+  fenced = 0;
+  pos = ring_load(&ring->head.index.pos);
+  for (;;) {
+    cell = (struct uv__ring_cell*) ring->cells + (pos & ring->mask);
+    seq = ring_load(&cell->seq);
+    diff = (int) (seq - (pos + 1));
+
+    if (diff == 0) {
+      prev = ring_cmpxchg(&ring->head.index.pos, pos, pos + 1);
+      if (prev == pos)
+        break;
+      pos = prev;
+    } else if (diff < 0) {
+      if (ring->async == NULL || fenced)
+        return UV_EAGAIN;
+
+      /* Same as in uv_spsc_ring_pop(), look once more after the fence. */
+      ring_fence();
+      fenced = 1;
+    } else {
+      /* Another consumer took |pos|. */
+      pos = ring_load(&ring->head.index.pos);
+    }
+  }
+
+  *item = cell->item;
+  ring_store(&cell->seq, pos + ring->mask + 1);
+  return 0;
+}
+
+
+unsigned int uv_mpmc_ring_capacity(const uv_mpmc_ring_t* ring) {
+  return ring->mask + 1;
+}
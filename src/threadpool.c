@@ -19,242 +19,1642 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_THREADPOOL
+
 #include "uv-common.h"
 
 #if !defined(_WIN32)
 # include "unix/internal.h"
+# include "unix/atomic-ops.h"
 #endif
 
 #include <stdlib.h>
 
 #define MAX_THREADPOOL_SIZE 1024
 
+/* Number of workers uv__work_submit() looks at for an idle one. */
+#define MAX_STEAL_PROBES 4
+
+/* One queue per uv_work_priority, highest priority first. */
+#define NUM_PRIORITIES 3
+
+/* One set of statistics per enum uv__work_kind. */
+#define NUM_KINDS UV_THREADPOOL_WORK_MAX
+
+/* Counters for uv_threadpool_metrics(), protected by the mutex of the pool
+ * or worker they belong to. The number of queued requests isn't counted,
+ * it's taken from the queues themselves.
+ */
+struct uv__work_stats {
+  uint64_t submitted;
+  uint64_t completed;
+  uint64_t cancelled;
+  uint64_t wait_time;
+  uint64_t exec_time;
+  uint64_t wait_histogram[UV_THREADPOOL_HISTOGRAM_SIZE];
+  uint64_t exec_histogram[UV_THREADPOOL_HISTOGRAM_SIZE];
+};
+
+/* Per-thread state of a pool in work stealing mode. */
+struct uv__worker {
+  uv_mutex_t mutex;
+  uv_cond_t cond;
+  struct uv__threadpool* pool;
+  QUEUE wq[NUM_PRIORITIES];
+  QUEUE idle_queue;  /* Link in pool->idle_workers. */
+  struct uv__work_stats stats[NUM_KINDS];
+  int idle;
+  int exiting;
+};
+
+struct uv__threadpool {
+  uv_cond_t cond;
+  uv_mutex_t mutex;
+  uv__latch_t started;
+  unsigned int idle_threads;
+  unsigned int wakeups_pending;  /* Signalled idle threads not yet awake. */
+  unsigned int slow_io_work_running;
+  unsigned int slow_io_pending;  /* Hint, !QUEUE_EMPTY(&slow_io_pending_wq) */
+  unsigned int nthreads;
+  unsigned int min_threads;
+  unsigned int max_threads;
+  unsigned int thread_slots;  /* Capacity of |threads|. */
+  uint64_t idle_timeout;  /* Milliseconds. */
+  unsigned int refs;  /* Loops using the pool, see uv__threadpool_loop_share. */
+  uv_loop_t* owner;  /* Loop that re-creates the threads after a fork. */
+  char* cpumask;  /* CPUs the threads run on, NULL for any. */
+  size_t mask_size;
+  int exiting;
+  int dedicated;  /* Only runs the kind of work it's in kind_pools for. */
+  int has_retired;
+  uv_thread_t retired;  /* Last thread that retired, not yet joined. */
+  uv_thread_t* threads;
+  struct uv__worker* workers;  /* NULL unless in work stealing mode. */
+  QUEUE idle_workers;
+  QUEUE exit_message;
+  QUEUE wq[NUM_PRIORITIES];
+  QUEUE run_slow_work_message;
+  QUEUE slow_io_pending_wq;
+  struct uv__work_stats stats[NUM_KINDS];
+};
+
+/* What the threadpool keeps about a request it's been given, struct uv__work
+ * has no room for it. The record is queued in place of the request, whose
+ * wq[0] points to the record and wq[1] is NULL until the request is back on
+ * the loop. Records are taken and released on the loop thread, see
+ * work_record_get(), the threads only read them.
+ */
+struct uv__work_record {
+  QUEUE wq;
+  struct uv__work* w;
+  uint64_t submit_time;  /* For uv_threadpool_metrics(). */
+  uint64_t deadline;  /* uv_hrtime() after which it's not run, 0 for none. */
+  void* tag;  /* uv_work_set_scope() */
+  int kind;
+};
+
 static uv_once_t once = UV_ONCE_INIT;
-static uv_cond_t cond;
-static uv_mutex_t mutex;
-static unsigned int idle_threads;
-static unsigned int slow_io_work_running;
-static unsigned int nthreads;
-static uv_thread_t* threads;
+static struct uv__threadpool default_pool;
 static uv_thread_t default_threads[4];
-static QUEUE exit_message;
-static QUEUE wq;
-static QUEUE run_slow_work_message;
-static QUEUE slow_io_pending_wq;
+static unsigned int default_min_threads;
+static unsigned int default_max_threads;
+static uint64_t default_idle_timeout;
+
+/* Pools of their own for kinds of work, see uv_threadpool_set_kind_size().
+ * The entry for UV__WORK_CPU is unused, that's what |default_pool| runs.
+ */
+static struct uv__threadpool kind_pools[NUM_KINDS];
+static unsigned int kind_sizes[NUM_KINDS];
+static int pools_started;
+
+/* Options for the threads of all pools, see uv_threadpool_set_options().
+ * They're fixed once the first pool has started threads.
+ */
+static uv_threadpool_options_t thread_options;
+static char thread_name[64];
+static uv_key_t context_key;
+static int has_context_key;
+static int thread_options_used;
+
+static void record_work(struct uv__work_stats* stats,
+                        int kind,
+                        uint64_t wait_time,
+                        uint64_t exec_time) {
+  struct uv__work_stats* s;
+
+  s = &stats[kind];
+  s->completed++;
+  s->wait_time += wait_time;
+  s->exec_time += exec_time;
+  s->wait_histogram[uv__histogram_bucket(wait_time)]++;
+  s->exec_histogram[uv__histogram_bucket(exec_time)]++;
+}
+
+
+static unsigned int slow_work_thread_threshold(struct uv__threadpool* pool) {
+  /* No other work to keep threads free for. */
+  if (pool->dedicated)
+    return pool->nthreads;
+  return (pool->nthreads + 1) / 2;
+}
+
+static void uv__cancelled(struct uv__work* w) {
+  abort();
+}
+
+
+static void uv__expired(struct uv__work* w) {
+  abort();
+}
+
+
+static void* work_cmpxchg(void** p, void* oldval, void* newval) {
+#ifdef _WIN32
+  return InterlockedCompareExchangePointer(p, newval, oldval);
+#else
+  return cmpxchgp(p, oldval, newval);
+#endif
+}
+
+
+/* Hand the finished work request back to its loop. Requests that were past
+ * their deadline when a thread got to them come back without having run.
+ *
+ * Finished requests go on a lock-free stack in the loop, linked through
+ * wq[1] of their record. wq[0] still points to itself, i.e. the queue is
+ * empty, which tells uv_cancel() the request isn't queued anymore. Only the
+ * push onto an empty stack wakes up the loop, it takes everything that piled
+ * up since at once.
+ */
+static void finish_work(struct uv__work_record* rec, int expired) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__work* w;
+  uv_loop_t* loop;
+  void* head;
+  void* prev;
+
+  w = rec->w;
+  loop = w->loop;  /* |rec| and |w| may be gone once it's pushed. */
+  lfields = uv__get_internal_fields(loop);
+  w->work = expired ? uv__expired : NULL;
+
+  head = uv__load_relaxed(&lfields->work_done);
+  for (;;) {
+    rec->wq[1] = head;
+    prev = work_cmpxchg(&lfields->work_done, head, rec);
+    if (prev == head)
+      break;
+    head = prev;
+  }
+
+  if (head == NULL)
+    uv_async_send(&loop->wq_async);
+}
+
+
+/* Dequeue the oldest request from the highest priority non-empty queue out
+ * of the first |n| queues.
+ */
+static QUEUE* pop_work(QUEUE* queues, unsigned int n) {
+  unsigned int i;
+  QUEUE* q;
+
+  for (i = 0; i < n; i++) {
+    if (QUEUE_EMPTY(&queues[i]))
+      continue;
+
+    q = QUEUE_HEAD(&queues[i]);
+    QUEUE_REMOVE(q);
+    QUEUE_INIT(q);  /* Signal uv_cancel() that the work req is executing. */
+    return q;
+  }
+
+  return NULL;
+}
+
+
+static int uv__worker_empty(const struct uv__worker* worker) {
+  unsigned int i;
+
+  for (i = 0; i < NUM_PRIORITIES; i++)
+    if (!QUEUE_EMPTY(&worker->wq[i]))
+      return 0;
+
+  return 1;
+}
+
+
+/* Returns the next request a worker should run, NULL if there's none. Slow
+ * I/O is represented by |run_slow_work_message|; it's skipped while the
+ * slow I/O threshold is reached.
+ */
+static QUEUE* next_work(struct uv__threadpool* pool) {
+  unsigned int i;
+  QUEUE* q;
+
+  for (i = 0; i < NUM_PRIORITIES; i++) {
+    if (QUEUE_EMPTY(&pool->wq[i]))
+      continue;
+
+    q = QUEUE_HEAD(&pool->wq[i]);
+    if (q != &pool->run_slow_work_message ||
+        pool->slow_io_work_running < slow_work_thread_threshold(pool))
+      return q;
+
+    /* At the slow I/O threshold, re-schedule until after the other work in
+     * the queue is done.
+     */
+    if (QUEUE_NEXT(q) == &pool->wq[i])
+      continue;
+
+    QUEUE_REMOVE(q);
+    QUEUE_INSERT_TAIL(&pool->wq[i], q);
+    return QUEUE_HEAD(&pool->wq[i]);
+  }
+
+  return NULL;
+}
+
+
+/* Threads above |max_threads| retire as soon as they run out of work,
+ * threads above |min_threads| after having been idle for |idle_timeout|.
+ */
+static int should_retire(struct uv__threadpool* pool, int timed_out) {
+  if (pool->exiting)
+    return 0;
+
+  if (pool->nthreads > pool->max_threads)
+    return 1;
+
+  return timed_out && pool->nthreads > pool->min_threads;
+}
+
+
+/* Removes the calling thread from the pool. Threads can't join themselves,
+ * so each retiring thread joins the one that retired before it and leaves
+ * itself to be joined by the next one or by threadpool_destroy().
+ */
+static void retire(struct uv__threadpool* pool) {
+  uv_thread_t self;
+  uv_thread_t prev;
+  unsigned int i;
+  int has_prev;
+
+  self = uv_thread_self();
+  for (i = 0; i < pool->nthreads; i++)
+    if (uv_thread_equal(pool->threads + i, &self))
+      break;
+
+  assert(i < pool->nthreads);
+  self = pool->threads[i];
+  pool->threads[i] = pool->threads[--pool->nthreads];
+
+  prev = pool->retired;
+  has_prev = pool->has_retired;
+  pool->retired = self;
+  pool->has_retired = 1;
+  uv_mutex_unlock(&pool->mutex);
+
+  if (has_prev)
+    if (uv_thread_join(&prev))
+      abort();
+}
+
+
+/* To avoid deadlock with uv_cancel() it's crucial that the worker
+ * never holds the pool mutex and the loop-local mutex at the same time.
+ */
+static void worker_run(struct uv__threadpool* pool) {
+  struct uv__work_record* rec;
+  struct uv__work* w;
+  uint64_t wait_time;
+  uint64_t start;
+  uint64_t end;
+  QUEUE* q;
+  int is_slow_work;
+  int timed_out;
+  int expired;
+  int kind;
+
+  uv_mutex_lock(&pool->mutex);
+  for (;;) {
+    /* `mutex` should always be locked at this point. */
+
+    /* Keep waiting while either no work is present or only slow I/O
+       and we're at the threshold for that. */
+    timed_out = 0;
+    while ((q = next_work(pool)) == NULL) {
+      if (should_retire(pool, timed_out)) {
+        retire(pool);  /* Unlocks `mutex`. */
+        return;
+      }
+
+      pool->idle_threads += 1;
+      if (pool->nthreads > pool->min_threads && !pool->exiting)
+        timed_out = UV_ETIMEDOUT == uv_cond_timedwait(&pool->cond,
+                                                      &pool->mutex,
+                                                      pool->idle_timeout * 1000000);
+      else
+        uv_cond_wait(&pool->cond, &pool->mutex);
+      pool->idle_threads -= 1;
+
+      if (!timed_out && pool->wakeups_pending > 0)
+        pool->wakeups_pending -= 1;
+    }
+
+    if (q == &pool->exit_message) {
+      uv_cond_signal(&pool->cond);
+      uv_mutex_unlock(&pool->mutex);
+      break;
+    }
+
+    QUEUE_REMOVE(q);
+    QUEUE_INIT(q);  /* Signal uv_cancel() that the work req is executing. */
+
+    is_slow_work = 0;
+    if (q == &pool->run_slow_work_message) {
+      /* If we encountered a request to run slow I/O work but there is none
+         to run, that means it's cancelled => Start over. */
+      if (QUEUE_EMPTY(&pool->slow_io_pending_wq))
+        continue;
+
+      is_slow_work = 1;
+      pool->slow_io_work_running++;
+
+      q = QUEUE_HEAD(&pool->slow_io_pending_wq);
+      QUEUE_REMOVE(q);
+      QUEUE_INIT(q);
+
+      /* If there is more slow I/O work, schedule it to be run as well. */
+      if (!QUEUE_EMPTY(&pool->slow_io_pending_wq)) {
+        QUEUE_INSERT_TAIL(&pool->wq[UV_WORK_PRIORITY_NORMAL],
+                          &pool->run_slow_work_message);
+        if (pool->idle_threads > 0)
+          uv_cond_signal(&pool->cond);
+      }
+    }
+
+    uv_mutex_unlock(&pool->mutex);
+
+    /* |rec| and |w| may be gone once finish_work() has handed them back. */
+    rec = QUEUE_DATA(q, struct uv__work_record, wq);
+    w = rec->w;
+    kind = rec->kind;
+    start = uv_hrtime();
+    wait_time = start - rec->submit_time;
+    expired = rec->deadline != 0 && start > rec->deadline;
+    if (!expired) {
+      UV__TRACE1(work__start, w);
+      w->work(w);
+    }
+    end = uv_hrtime();
+    finish_work(rec, expired);
+
+    /* Lock `mutex` since that is expected at the start of the next
+     * iteration. */
+    uv_mutex_lock(&pool->mutex);
+    if (expired)
+      pool->stats[kind].cancelled++;
+    else
+      record_work(pool->stats, kind, wait_time, end - start);
+    if (is_slow_work) {
+      /* `slow_io_work_running` is protected by `mutex`. */
+      pool->slow_io_work_running--;
+    }
+  }
+}
+
+
+/* Runs on every thread of every pool before it looks for work. Naming the
+ * thread and changing its priority are best effort.
+ */
+static void worker_start(void) {
+  void* context;
+
+  if (thread_options.name != NULL)
+    uv__thread_setname(thread_options.name);
+
+  if (thread_options.flags & UV_THREADPOOL_HAS_PRIORITY)
+    uv__thread_setpriority(thread_options.priority);
+
+  if (thread_options.init_cb != NULL) {
+    context = thread_options.init_cb(thread_options.arg);
+    uv_key_set(&context_key, context);
+  }
+}
+
+
+/* Runs on threads that exit or retire, not on threads lost to a fork. */
+static void worker_stop(void) {
+  if (thread_options.exit_cb != NULL)
+    thread_options.exit_cb(thread_options.arg, uv_threadpool_context());
+
+  if (has_context_key)
+    uv_key_set(&context_key, NULL);
+}
+
+
+static void worker(void* arg) {
+  struct uv__threadpool* pool;
+
+  pool = arg;
+  uv__latch_arrive(&pool->started);
+  arg = NULL;
+
+  worker_start();
+  worker_run(pool);
+  worker_stop();
+}
+
+
+static int thread_create(struct uv__threadpool* pool,
+                         uv_thread_t* tid,
+                         uv_thread_cb entry,
+                         void* arg) {
+  uv_thread_options_t options;
+
+  options.flags = UV_THREAD_NO_FLAGS;
+  if (thread_options.flags & UV_THREADPOOL_HAS_STACK_SIZE) {
+    options.flags |= UV_THREAD_HAS_STACK_SIZE;
+    options.stack_size = thread_options.stack_size;
+  }
+
+  if (pool->cpumask != NULL) {
+    options.flags |= UV_THREAD_HAS_AFFINITY;
+    options.cpumask = pool->cpumask;
+    options.mask_size = pool->mask_size;
+  }
+
+  return uv_thread_create_ex(tid, &options, entry, arg);
+}
+
+
+/* Threads that are started after threadpool_init() has returned. */
+static void spawned_worker(void* arg) {
+  worker_start();
+  worker_run(arg);
+  worker_stop();
+}
+
+
+/* Starts another thread if the pool is allowed to grow. Called with the
+ * pool mutex held.
+ */
+static void spawn_worker(struct uv__threadpool* pool) {
+  if (pool->exiting || pool->workers != NULL)
+    return;
+
+  if (pool->nthreads >= pool->max_threads ||
+      pool->nthreads >= pool->thread_slots)
+    return;
+
+  if (thread_create(pool, pool->threads + pool->nthreads, spawned_worker, pool))
+    return;  /* Try again on the next backlog. */
+
+  pool->nthreads++;
+}
+
+
+/* Work stealing mode. Every worker has a queue and a lock of its own, the
+ * submitting thread spreads work over them and workers that run dry take
+ * work from the back of their peers' queues. The pool mutex is only taken
+ * for slow I/O work and when workers go to sleep or are woken up, which
+ * keeps it off the hot path when the pool is busy.
+ */
+static void wake_idle_worker(struct uv__threadpool* pool) {
+  struct uv__worker* worker;
+  QUEUE* q;
+
+  if (uv__load_relaxed(&pool->idle_threads) == 0)
+    return;
+
+  uv_mutex_lock(&pool->mutex);
+  worker = NULL;
+  if (!QUEUE_EMPTY(&pool->idle_workers)) {
+    q = QUEUE_HEAD(&pool->idle_workers);
+    QUEUE_REMOVE(q);
+    QUEUE_INIT(q);
+    worker = QUEUE_DATA(q, struct uv__worker, idle_queue);
+  }
+  uv_mutex_unlock(&pool->mutex);
+
+  if (worker == NULL)
+    return;
+
+  uv_mutex_lock(&worker->mutex);
+  uv_cond_signal(&worker->cond);
+  uv_mutex_unlock(&worker->mutex);
+}
+
+
+static int take_slow_work(struct uv__threadpool* pool, QUEUE** qp) {
+  QUEUE* q;
+
+  if (uv__load_relaxed(&pool->slow_io_pending) == 0)
+    return 0;
+
+  q = NULL;
+  uv_mutex_lock(&pool->mutex);
+  if (!QUEUE_EMPTY(&pool->slow_io_pending_wq) &&
+      pool->slow_io_work_running < slow_work_thread_threshold(pool)) {
+    q = QUEUE_HEAD(&pool->slow_io_pending_wq);
+    QUEUE_REMOVE(q);
+    QUEUE_INIT(q);  /* Signal uv_cancel() that the work req is executing. */
+    pool->slow_io_work_running++;
+    uv__store_relaxed(&pool->slow_io_pending,
+                      !QUEUE_EMPTY(&pool->slow_io_pending_wq));
+  }
+  uv_mutex_unlock(&pool->mutex);
+
+  *qp = q;
+  return q != NULL;
+}
+
+
+static int steal_work(struct uv__worker* self, QUEUE** qp) {
+  struct uv__threadpool* pool;
+  struct uv__worker* victim;
+  unsigned int i;
+  unsigned int p;
+  QUEUE* q;
+
+  pool = self->pool;
+  for (i = 1; i < pool->nthreads; i++) {
+    victim = &pool->workers[(self - pool->workers + i) % pool->nthreads];
+
+    uv_mutex_lock(&victim->mutex);
+    q = NULL;
+    for (p = 0; p < NUM_PRIORITIES; p++) {
+      if (QUEUE_EMPTY(&victim->wq[p]))
+        continue;
+
+      q = QUEUE_PREV(&victim->wq[p]);
+      QUEUE_REMOVE(q);
+      QUEUE_INIT(q);  /* Signal uv_cancel() that the work req is executing. */
+      break;
+    }
+    uv_mutex_unlock(&victim->mutex);
+
+    if (q != NULL) {
+      *qp = q;
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+
+static void stealing_worker(void* arg) {
+  struct uv__threadpool* pool;
+  struct uv__worker* self;
+  struct uv__work_record* rec;
+  struct uv__work* w;
+  uint64_t wait_time;
+  uint64_t start;
+  uint64_t end;
+  QUEUE* q;
+  int is_slow_work;
+  int expired;
+  int kind;
+
+  self = arg;
+  pool = self->pool;
+  uv__latch_arrive(&pool->started);
+  arg = NULL;
+
+  /* Wait for threadpool_init() to finish. */
+  uv_mutex_lock(&pool->mutex);
+  uv_mutex_unlock(&pool->mutex);
+
+  worker_start();
+
+  for (;;) {
+    /* High priority work goes before slow I/O, everything else after. */
+    uv_mutex_lock(&self->mutex);
+    q = pop_work(self->wq, UV_WORK_PRIORITY_HIGH + 1);
+    uv_mutex_unlock(&self->mutex);
+
+    is_slow_work = 0;
+    if (q == NULL)
+      is_slow_work = take_slow_work(pool, &q);
+
+    if (q == NULL) {
+      uv_mutex_lock(&self->mutex);
+      while ((q = pop_work(self->wq, NUM_PRIORITIES)) == NULL &&
+             !self->exiting) {
+        uv_mutex_unlock(&self->mutex);
+
+        if (steal_work(self, &q))
+          goto run;
+
+        if (take_slow_work(pool, &q)) {
+          is_slow_work = 1;
+          goto run;
+        }
+
+        uv_mutex_lock(&self->mutex);
+        if (!uv__worker_empty(self) || self->exiting)
+          continue;
+
+        /* Slow I/O work posted after take_slow_work() came up empty would
+         * otherwise sit in the queue until the next wakeup.
+         */
+        uv_mutex_lock(&pool->mutex);
+        if (!QUEUE_EMPTY(&pool->slow_io_pending_wq) &&
+            pool->slow_io_work_running < slow_work_thread_threshold(pool)) {
+          uv_mutex_unlock(&pool->mutex);
+          continue;
+        }
+        QUEUE_INSERT_TAIL(&pool->idle_workers, &self->idle_queue);
+        uv__store_relaxed(&pool->idle_threads, pool->idle_threads + 1);
+        uv_mutex_unlock(&pool->mutex);
+
+        self->idle = 1;
+        uv_cond_wait(&self->cond, &self->mutex);
+        self->idle = 0;
+
+        uv_mutex_lock(&pool->mutex);
+        if (!QUEUE_EMPTY(&self->idle_queue)) {
+          QUEUE_REMOVE(&self->idle_queue);
+          QUEUE_INIT(&self->idle_queue);
+        }
+        uv__store_relaxed(&pool->idle_threads, pool->idle_threads - 1);
+        uv_mutex_unlock(&pool->mutex);
+      }
+      uv_mutex_unlock(&self->mutex);
+
+      if (q == NULL)
+        break;  /* Exiting. */
+    }
+
+run:
+    rec = QUEUE_DATA(q, struct uv__work_record, wq);
+    w = rec->w;
+    kind = rec->kind;
+    start = uv_hrtime();
+    wait_time = start - rec->submit_time;
+    expired = rec->deadline != 0 && start > rec->deadline;
+    if (!expired) {
+      UV__TRACE1(work__start, w);
+      w->work(w);
+    }
+    end = uv_hrtime();
+    finish_work(rec, expired);
+
+    uv_mutex_lock(&self->mutex);
+    if (expired)
+      self->stats[kind].cancelled++;
+    else
+      record_work(self->stats, kind, wait_time, end - start);
+    uv_mutex_unlock(&self->mutex);
+
+    if (is_slow_work) {
+      uv_mutex_lock(&pool->mutex);
+      pool->slow_io_work_running--;
+      uv_mutex_unlock(&pool->mutex);
+      wake_idle_worker(pool);
+    }
+  }
+
+  worker_stop();
+}
+
+
+static void stealing_post(struct uv__threadpool* pool,
+                          uv_loop_t* loop,
+                          QUEUE* q,
+                          enum uv__work_kind kind,
+                          uv_work_priority priority) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__worker* worker;
+  unsigned int start;
+  unsigned int i;
+  int idle;
+
+  if (kind == UV__WORK_SLOW_IO) {
+    uv_mutex_lock(&pool->mutex);
+    QUEUE_INSERT_TAIL(&pool->slow_io_pending_wq, q);
+    pool->stats[kind].submitted++;
+    uv__store_relaxed(&pool->slow_io_pending, 1);
+    uv_mutex_unlock(&pool->mutex);
+    wake_idle_worker(pool);
+    return;
+  }
+
+  /* Submitting happens on the loop thread, the loop-local round robin
+   * counter doesn't need to be synchronized.
+   */
+  lfields = uv__get_internal_fields(loop);
+  start = lfields->threadpool_next++;
+
+  /* Prefer a worker that's idle, without waiting for locks that are held. */
+  worker = NULL;
+  for (i = 0; i < MAX_STEAL_PROBES && i < pool->nthreads; i++) {
+    worker = &pool->workers[(start + i) % pool->nthreads];
+    if (uv_mutex_trylock(&worker->mutex) == 0) {
+      if (worker->idle)
+        break;
+      uv_mutex_unlock(&worker->mutex);
+    }
+    worker = NULL;
+  }
+
+  if (worker == NULL) {
+    worker = &pool->workers[start % pool->nthreads];
+    uv_mutex_lock(&worker->mutex);
+  }
+
+  QUEUE_INSERT_TAIL(&worker->wq[priority], q);
+  worker->stats[kind].submitted++;
+  idle = worker->idle;
+  if (idle)
+    uv_cond_signal(&worker->cond);
+  uv_mutex_unlock(&worker->mutex);
+
+  /* The worker is busy, let an idle peer steal the work. */
+  if (!idle)
+    wake_idle_worker(pool);
+}
+
+
+static void post(struct uv__threadpool* pool,
+                 QUEUE* q,
+                 enum uv__work_kind kind,
+                 uv_work_priority priority) {
+  uv_mutex_lock(&pool->mutex);
+  if (q != &pool->exit_message)
+    pool->stats[kind].submitted++;
+
+  if (kind == UV__WORK_SLOW_IO) {
+    /* Insert into a separate queue. */
+    QUEUE_INSERT_TAIL(&pool->slow_io_pending_wq, q);
+    if (!QUEUE_EMPTY(&pool->run_slow_work_message)) {
+      /* Running slow I/O tasks is already scheduled => Nothing to do here.
+         The worker that runs said other task will schedule this one as well. */
+      uv_mutex_unlock(&pool->mutex);
+      return;
+    }
+    q = &pool->run_slow_work_message;
+    priority = UV_WORK_PRIORITY_NORMAL;
+  }
+
+  QUEUE_INSERT_TAIL(&pool->wq[priority], q);
+  if (pool->idle_threads > pool->wakeups_pending) {
+    pool->wakeups_pending += 1;
+    uv_cond_signal(&pool->cond);
+  } else {
+    /* Every idle thread already has work coming its way. */
+    if (pool->idle_threads > 0)
+      uv_cond_signal(&pool->cond);
+    spawn_worker(pool);
+  }
+  uv_mutex_unlock(&pool->mutex);
+}
+
+
+/* Queues |n| requests under one acquisition of the lock and wakes as many
+ * idle threads as there is work for.
+ */
+static void post_batch(struct uv__threadpool* pool,
+                       struct uv__work_record** recs,
+                       unsigned int n,
+                       enum uv__work_kind kind,
+                       uv_work_priority priority) {
+  unsigned int wakeups;
+  unsigned int i;
+
+  uv_mutex_lock(&pool->mutex);
+  pool->stats[kind].submitted += n;
+  for (i = 0; i < n; i++)
+    QUEUE_INSERT_TAIL(&pool->wq[priority], &recs[i]->wq);
+
+  wakeups = 0;
+  if (pool->idle_threads > pool->wakeups_pending)
+    wakeups = pool->idle_threads - pool->wakeups_pending;
+  if (wakeups > n)
+    wakeups = n;
+
+  pool->wakeups_pending += wakeups;
+  for (i = 0; i < wakeups; i++)
+    uv_cond_signal(&pool->cond);
+
+  /* Start threads for the rest, as far as the pool may grow. */
+  for (i = wakeups; i < n; i++) {
+    if (pool->nthreads >= pool->max_threads)
+      break;
+    spawn_worker(pool);
+  }
+  uv_mutex_unlock(&pool->mutex);
+}
+
+
+/* Work stealing mode: each worker gets its share of the batch in one go. */
+static void stealing_post_batch(struct uv__threadpool* pool,
+                                uv_loop_t* loop,
+                                struct uv__work_record** recs,
+                                unsigned int n,
+                                enum uv__work_kind kind,
+                                uv_work_priority priority) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__worker* worker;
+  unsigned int start;
+  unsigned int i;
+  unsigned int j;
+
+  lfields = uv__get_internal_fields(loop);
+  start = lfields->threadpool_next;
+  lfields->threadpool_next += n;
+
+  for (i = 0; i < pool->nthreads && i < n; i++) {
+    worker = &pool->workers[(start + i) % pool->nthreads];
+    uv_mutex_lock(&worker->mutex);
+    for (j = i; j < n; j += pool->nthreads) {
+      QUEUE_INSERT_TAIL(&worker->wq[priority], &recs[j]->wq);
+      worker->stats[kind].submitted++;
+    }
+    if (worker->idle)
+      uv_cond_signal(&worker->cond);
+    uv_mutex_unlock(&worker->mutex);
+  }
+}
+
+
+/* Starts |nthreads| threads. |threads| may point to preallocated storage for
+ * that many threads, else it is allocated on the heap.
+ */
+static int threadpool_init_workers(struct uv__threadpool* pool) {
+  struct uv__worker* worker;
+  unsigned int i;
+  unsigned int p;
+  int err;
+
+  pool->workers = uv__calloc(pool->nthreads, sizeof(pool->workers[0]));
+  if (pool->workers == NULL)
+    return UV_ENOMEM;
+
+  for (i = 0; i < pool->nthreads; i++) {
+    worker = &pool->workers[i];
+    worker->pool = pool;
+    for (p = 0; p < NUM_PRIORITIES; p++)
+      QUEUE_INIT(&worker->wq[p]);
+    QUEUE_INIT(&worker->idle_queue);
+
+    err = uv_mutex_init_adaptive(&worker->mutex);
+    if (err)
+      goto fail;
+
+    err = uv_cond_init(&worker->cond);
+    if (err) {
+      uv_mutex_destroy(&worker->mutex);
+      goto fail;
+    }
+  }
+
+  return 0;
+
+fail:
+  while (i-- > 0) {
+    uv_cond_destroy(&pool->workers[i].cond);
+    uv_mutex_destroy(&pool->workers[i].mutex);
+  }
+  uv__free(pool->workers);
+  pool->workers = NULL;
+  return err;
+}
+
+
+static void threadpool_destroy_workers(struct uv__threadpool* pool,
+                                       unsigned int nworkers) {
+  unsigned int i;
+
+  if (pool->workers == NULL)
+    return;
+
+  for (i = 0; i < nworkers; i++) {
+    uv_cond_destroy(&pool->workers[i].cond);
+    uv_mutex_destroy(&pool->workers[i].mutex);
+  }
+
+  uv__free(pool->workers);
+  pool->workers = NULL;
+}
+
+
+static int use_work_stealing(void) {
+  const char* val;
+
+  val = getenv("UV_THREADPOOL_WORK_STEALING");
+  return val != NULL && atoi(val) != 0;
+}
+
+
+static int threadpool_init(struct uv__threadpool* pool,
+                           unsigned int nthreads,
+                           uv_thread_t* threads,
+                           const char* cpumask,
+                           size_t mask_size) {
+  unsigned int i;
+  int err;
+
+  memset(pool, 0, sizeof(*pool));
+  thread_options_used = 1;
+  pool->nthreads = nthreads;
+  pool->thread_slots = nthreads;
+  pool->threads = threads;
+  QUEUE_INIT(&pool->idle_workers);
+
+  if (cpumask != NULL) {
+    pool->cpumask = uv__malloc(mask_size);
+    if (pool->cpumask == NULL)
+      return UV_ENOMEM;
+    memcpy(pool->cpumask, cpumask, mask_size);
+    pool->mask_size = mask_size;
+  }
+
+  if (pool->threads == NULL) {
+    pool->threads = uv__malloc(nthreads * sizeof(pool->threads[0]));
+    if (pool->threads == NULL) {
+      err = UV_ENOMEM;
+      goto fail_threads;
+    }
+  }
+
+  if (use_work_stealing()) {
+    err = threadpool_init_workers(pool);
+    if (err)
+      goto fail_workers;
+  }
+
+  err = uv_cond_init(&pool->cond);
+  if (err)
+    goto fail_cond;
+
+  /* Critical sections are short, spinning briefly beats sleeping. */
+  err = uv_mutex_init_adaptive(&pool->mutex);
+  if (err)
+    goto fail_mutex;
+
+  err = uv__latch_init(&pool->started);
+  if (err)
+    goto fail_sem;
+
+  for (i = 0; i < NUM_PRIORITIES; i++)
+    QUEUE_INIT(&pool->wq[i]);
+  QUEUE_INIT(&pool->slow_io_pending_wq);
+  QUEUE_INIT(&pool->run_slow_work_message);
+
+  /* Workers don't start looking for work until |nthreads| is final. */
+  uv_mutex_lock(&pool->mutex);
+
+  for (i = 0; i < nthreads; i++) {
+    if (pool->workers != NULL)
+      err = thread_create(pool,
+                          pool->threads + i,
+                          stealing_worker,
+                          &pool->workers[i]);
+    else
+      err = thread_create(pool, pool->threads + i, worker, pool);
+    if (err)
+      break;
+  }
+
+  /* Make do with fewer threads if not all of them could be started. */
+  pool->nthreads = i;
+  pool->min_threads = i;
+  pool->max_threads = i;
+  uv_mutex_unlock(&pool->mutex);
+
+  uv__latch_wait(&pool->started, i);
+  uv__latch_destroy(&pool->started);
+
+  if (pool->nthreads > 0)
+    return 0;
+
+fail_sem:
+  uv_mutex_destroy(&pool->mutex);
+fail_mutex:
+  uv_cond_destroy(&pool->cond);
+fail_cond:
+  threadpool_destroy_workers(pool, nthreads);
+fail_workers:
+  if (pool->threads != threads)
+    uv__free(pool->threads);
+  pool->threads = NULL;
+fail_threads:
+  uv__free(pool->cpumask);
+  pool->cpumask = NULL;
+
+  return err;
+}
+
+
+static void threadpool_destroy(struct uv__threadpool* pool,
+                               uv_thread_t* threads) {
+  unsigned int i;
+
+  if (pool->nthreads == 0)
+    return;
+
+  if (pool->workers != NULL) {
+    for (i = 0; i < pool->nthreads; i++) {
+      uv_mutex_lock(&pool->workers[i].mutex);
+      pool->workers[i].exiting = 1;
+      uv_cond_signal(&pool->workers[i].cond);
+      uv_mutex_unlock(&pool->workers[i].mutex);
+    }
+  } else {
+    /* Stop threads from retiring, the set of threads to join is final. */
+    uv_mutex_lock(&pool->mutex);
+    pool->exiting = 1;
+    uv_mutex_unlock(&pool->mutex);
+
+    /* Queued last so pending work of any priority still runs first. */
+    post(pool, &pool->exit_message, UV__WORK_CPU, UV_WORK_PRIORITY_BACKGROUND);
+  }
+
+  for (i = 0; i < pool->nthreads; i++)
+    if (uv_thread_join(pool->threads + i))
+      abort();
+
+  if (pool->has_retired)
+    if (uv_thread_join(&pool->retired))
+      abort();
+
+  threadpool_destroy_workers(pool, pool->nthreads);
+  if (pool->threads != threads)
+    uv__free(pool->threads);
+
+  uv_mutex_destroy(&pool->mutex);
+  uv_cond_destroy(&pool->cond);
+  uv__free(pool->cpumask);
+
+  pool->threads = NULL;
+  pool->cpumask = NULL;
+  pool->nthreads = 0;
+}
+
+
+#ifdef __MVS__
+/* TODO(itodorov) - zos: revisit when Woz compiler is available. */
+__attribute__((destructor))
+#endif
+void uv__threadpool_cleanup(void) {
+#ifndef __MVS__
+  unsigned int kind;
+
+  /* TODO(gabylb) - zos: revisit when Woz compiler is available. */
+  threadpool_destroy(&default_pool, default_threads);
+  for (kind = 0; kind < NUM_KINDS; kind++)
+    threadpool_destroy(&kind_pools[kind], NULL);
+#endif
+}
+
+
+/* Updates the bounds of a running pool. Called with the pool mutex held. */
+static int threadpool_set_limits(struct uv__threadpool* pool,
+                                 unsigned int min_threads,
+                                 unsigned int max_threads,
+                                 uint64_t idle_timeout,
+                                 uv_thread_t* threads) {
+  uv_thread_t* slots;
+
+  /* The work stealing mode has a fixed set of workers. */
+  if (pool->workers != NULL) {
+    if (min_threads == pool->nthreads && max_threads == pool->nthreads)
+      return 0;
+    return UV_ENOTSUP;
+  }
+
+  if (max_threads > pool->thread_slots) {
+    slots = uv__malloc(max_threads * sizeof(slots[0]));
+    if (slots == NULL)
+      return UV_ENOMEM;
+
+    memcpy(slots, pool->threads, pool->nthreads * sizeof(slots[0]));
+    if (pool->threads != threads)
+      uv__free(pool->threads);
+    pool->threads = slots;
+    pool->thread_slots = max_threads;
+  }
+
+  pool->min_threads = min_threads;
+  pool->max_threads = max_threads;
+  pool->idle_timeout = idle_timeout;
+
+  while (pool->nthreads < min_threads) {
+    spawn_worker(pool);
+    if (pool->nthreads < min_threads)
+      return UV_EAGAIN;
+  }
+
+  /* Let idle threads re-check whether they're still needed. */
+  uv_cond_broadcast(&pool->cond);
+  return 0;
+}
+
+
+/* Kinds of work that fail to get a pool of their own share |default_pool|. */
+static void init_kind_pools(void) {
+  struct uv__threadpool* pool;
+  unsigned int kind;
+
+  for (kind = 0; kind < NUM_KINDS; kind++) {
+    pool = &kind_pools[kind];
+    if (kind == UV__WORK_CPU || kind_sizes[kind] == 0)
+      continue;
+
+    if (threadpool_init(pool, kind_sizes[kind], NULL, NULL, 0)) {
+      pool->nthreads = 0;
+      continue;
+    }
+
+    uv_mutex_lock(&pool->mutex);
+    pool->dedicated = 1;
+    uv_mutex_unlock(&pool->mutex);
+  }
+}
+
+
+static void init_threads(void) {
+  unsigned int nthreads;
+  const char* val;
+  uv_thread_t* threads;
+
+  pools_started = 1;
+  init_kind_pools();
+
+  nthreads = ARRAY_SIZE(default_threads);
+  val = getenv("UV_THREADPOOL_SIZE");
+  if (val != NULL)
+    nthreads = atoi(val);
+  if (kind_sizes[UV__WORK_CPU] != 0)
+    nthreads = kind_sizes[UV__WORK_CPU];
+  if (default_max_threads != 0)
+    nthreads = default_min_threads;  /* Restarting after fork. */
+  if (nthreads == 0)
+    nthreads = 1;
+  if (nthreads > MAX_THREADPOOL_SIZE)
+    nthreads = MAX_THREADPOOL_SIZE;
+
+  threads = default_threads;
+  if (nthreads > ARRAY_SIZE(default_threads))
+    threads = NULL;
+
+  if (threadpool_init(&default_pool, nthreads, threads, NULL, 0) == 0) {
+    if (default_max_threads != 0) {
+      uv_mutex_lock(&default_pool.mutex);
+      threadpool_set_limits(&default_pool,
+                            default_pool.nthreads,
+                            default_max_threads,
+                            default_idle_timeout,
+                            default_threads);
+      uv_mutex_unlock(&default_pool.mutex);
+    }
+    return;
+  }
+
+  /* Retry with the statically allocated threads. */
+  if (threads == default_threads)
+    abort();
+
+  if (threadpool_init(&default_pool,
+                      ARRAY_SIZE(default_threads),
+                      default_threads,
+                      NULL,
+                      0))
+    abort();
+}
+
+
+#ifndef _WIN32
+static void reset_once(void) {
+  uv_once_t child_once = UV_ONCE_INIT;
+  memcpy(&once, &child_once, sizeof(child_once));
+}
+#endif
+
+
+static void init_once(void) {
+#ifndef _WIN32
+  /* Re-initialize the threadpool after fork.
+   * Note that this discards the global mutex and condition as well
+   * as the work queue.
+   */
+  if (pthread_atfork(NULL, NULL, &reset_once))
+    abort();
+#endif
+  init_threads();
+}
+
+
+/* Returns the pool that runs the loop's work, either its own pool or the
+ * process-wide one.
+ */
+static struct uv__threadpool* threadpool_get(uv_loop_t* loop) {
+  struct uv__threadpool* pool;
+
+  pool = uv__get_internal_fields(loop)->threadpool;
+  if (pool != NULL)
+    return pool;
+
+  uv_once(&once, init_once);
+  return &default_pool;
+}
+
+
+/* Like threadpool_get() but for a kind of work that may have a global pool
+ * of its own.
+ */
+static struct uv__threadpool* threadpool_get_kind(uv_loop_t* loop,
+                                                  enum uv__work_kind kind) {
+  struct uv__threadpool* pool;
+
+  pool = threadpool_get(loop);
+  if (pool == &default_pool && kind_pools[kind].nthreads > 0)
+    return &kind_pools[kind];
+
+  return pool;
+}
+
+
+int uv_threadpool_set_kind_size(uv_threadpool_work_kind kind,
+                                unsigned int nthreads) {
+  if ((unsigned int) kind >= NUM_KINDS || nthreads > MAX_THREADPOOL_SIZE)
+    return UV_EINVAL;
+
+  if (pools_started)
+    return UV_EBUSY;
+
+  kind_sizes[kind] = nthreads;
+  return 0;
+}
+
+
+int uv_threadpool_set_options(const uv_threadpool_options_t* options) {
+  unsigned int flags;
+  int err;
+
+  if (options == NULL)
+    return UV_EINVAL;
+
+  flags = UV_THREADPOOL_HAS_STACK_SIZE | UV_THREADPOOL_HAS_PRIORITY;
+  if (options->flags & ~flags)
+    return UV_EINVAL;
+
+  if (options->flags & UV_THREADPOOL_HAS_PRIORITY)
+    if (options->priority < UV_PRIORITY_HIGHEST ||
+        options->priority > UV_PRIORITY_LOW)
+      return UV_EINVAL;
+
+  if (options->name != NULL && strlen(options->name) >= sizeof(thread_name))
+    return UV_EINVAL;
+
+  if (thread_options_used)
+    return UV_EBUSY;
+
+  if (!has_context_key &&
+      (options->init_cb != NULL || options->exit_cb != NULL)) {
+    err = uv_key_create(&context_key);
+    if (err)
+      return err;
+    has_context_key = 1;
+  }
+
+  thread_options = *options;
+  if (options->name != NULL) {
+    memcpy(thread_name, options->name, strlen(options->name) + 1);
+    thread_options.name = thread_name;
+  }
+
+  return 0;
+}
+
+
+void* uv_threadpool_context(void) {
+  if (!has_context_key)
+    return NULL;
+
+  return uv_key_get(&context_key);
+}
+
+
+int uv_threadpool_set_limits(unsigned int min_threads,
+                             unsigned int max_threads,
+                             uint64_t idle_timeout) {
+  int err;
+
+  if (min_threads == 0 || min_threads > max_threads)
+    return UV_EINVAL;
+
+  if (max_threads > MAX_THREADPOOL_SIZE)
+    return UV_EINVAL;
+
+  /* Keep uv_cond_timedwait()'s nanosecond timeout from overflowing. */
+  if (idle_timeout > UINT64_MAX / 1000000)
+    idle_timeout = UINT64_MAX / 1000000;
+
+  uv_once(&once, init_once);
+
+  uv_mutex_lock(&default_pool.mutex);
+  err = threadpool_set_limits(&default_pool,
+                              min_threads,
+                              max_threads,
+                              idle_timeout,
+                              default_threads);
+  if (err == 0 || err == UV_EAGAIN) {
+    default_min_threads = min_threads;
+    default_max_threads = max_threads;
+    default_idle_timeout = idle_timeout;
+  }
+  uv_mutex_unlock(&default_pool.mutex);
+
+  return err;
+}
+
+
+static void threadpool_loop_release(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__threadpool* pool;
+
+  lfields = uv__get_internal_fields(loop);
+  pool = lfields->threadpool;
+  if (pool == NULL)
+    return;
+
+  lfields->threadpool = NULL;
+  if (pool->owner == loop)
+    pool->owner = NULL;
 
-static unsigned int slow_work_thread_threshold(void) {
-  return (nthreads + 1) / 2;
-}
+  if (--pool->refs > 0)
+    return;
 
-static void uv__cancelled(struct uv__work* w) {
-  abort();
+  threadpool_destroy(pool, NULL);
+  uv__free(pool);
 }
 
 
-/* To avoid deadlock with uv_cancel() it's crucial that the worker
- * never holds the global mutex and the loop-local mutex at the same time.
- */
-static void worker(void* arg) {
-  struct uv__work* w;
-  QUEUE* q;
-  int is_slow_work;
+int uv__threadpool_loop_configure(uv_loop_t* loop, unsigned int nthreads) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__threadpool* pool;
+  int err;
 
-  uv_sem_post((uv_sem_t*) arg);
-  arg = NULL;
+  /* Work that's in flight has to finish on the pool it was posted to. */
+  if (uv__has_active_reqs(loop))
+    return UV_EBUSY;
 
-  uv_mutex_lock(&mutex);
-  for (;;) {
-    /* `mutex` should always be locked at this point. */
+  if (nthreads > MAX_THREADPOOL_SIZE)
+    nthreads = MAX_THREADPOOL_SIZE;
 
-    /* Keep waiting while either no work is present or only slow I/O
-       and we're at the threshold for that. */
-    while (QUEUE_EMPTY(&wq) ||
-           (QUEUE_HEAD(&wq) == &run_slow_work_message &&
-            QUEUE_NEXT(&run_slow_work_message) == &wq &&
-            slow_io_work_running >= slow_work_thread_threshold())) {
-      idle_threads += 1;
-      uv_cond_wait(&cond, &mutex);
-      idle_threads -= 1;
+  pool = NULL;
+  if (nthreads > 0) {
+    pool = uv__malloc(sizeof(*pool));
+    if (pool == NULL)
+      return UV_ENOMEM;
+
+    lfields = uv__get_internal_fields(loop);
+    err = threadpool_init(pool,
+                          nthreads,
+                          NULL,
+                          lfields->threadpool_cpumask,
+                          lfields->threadpool_mask_size);
+    if (err) {
+      uv__free(pool);
+      return err;
     }
 
-    q = QUEUE_HEAD(&wq);
-    if (q == &exit_message) {
-      uv_cond_signal(&cond);
-      uv_mutex_unlock(&mutex);
-      break;
-    }
+    pool->refs = 1;
+    pool->owner = loop;
+  }
 
-    QUEUE_REMOVE(q);
-    QUEUE_INIT(q);  /* Signal uv_cancel() that the work req is executing. */
+  threadpool_loop_release(loop);
 
-    is_slow_work = 0;
-    if (q == &run_slow_work_message) {
-      /* If we're at the slow I/O threshold, re-schedule until after all
-         other work in the queue is done. */
-      if (slow_io_work_running >= slow_work_thread_threshold()) {
-        QUEUE_INSERT_TAIL(&wq, q);
-        continue;
-      }
+  lfields = uv__get_internal_fields(loop);
+  lfields->threadpool = pool;
 
-      /* If we encountered a request to run slow I/O work but there is none
-         to run, that means it's cancelled => Start over. */
-      if (QUEUE_EMPTY(&slow_io_pending_wq))
-        continue;
+  return 0;
+}
 
-      is_slow_work = 1;
-      slow_io_work_running++;
 
-      q = QUEUE_HEAD(&slow_io_pending_wq);
-      QUEUE_REMOVE(q);
-      QUEUE_INIT(q);
+/* Sets the CPUs that the loop's own pool runs on. A pool that's running
+ * already is replaced by a new one of the same size.
+ */
+int uv__threadpool_loop_affinity(uv_loop_t* loop,
+                                 const char* cpumask,
+                                 size_t mask_size) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__threadpool* pool;
+  char* copy;
+  char* old;
+  size_t old_size;
+  size_t i;
+  int err;
 
-      /* If there is more slow I/O work, schedule it to be run as well. */
-      if (!QUEUE_EMPTY(&slow_io_pending_wq)) {
-        QUEUE_INSERT_TAIL(&wq, &run_slow_work_message);
-        if (idle_threads > 0)
-          uv_cond_signal(&cond);
-      }
-    }
+  if (cpumask != NULL) {
+    for (i = 0; i < mask_size; i++)
+      if (cpumask[i])
+        break;
 
-    uv_mutex_unlock(&mutex);
+    if (i == mask_size)
+      return UV_EINVAL;
+  }
 
-    w = QUEUE_DATA(q, struct uv__work, wq);
-    w->work(w);
+  if (uv__has_active_reqs(loop))
+    return UV_EBUSY;
 
-    uv_mutex_lock(&w->loop->wq_mutex);
-    w->work = NULL;  /* Signal uv_cancel() that the work req is done
-                        executing. */
-    QUEUE_INSERT_TAIL(&w->loop->wq, &w->wq);
-    uv_async_send(&w->loop->wq_async);
-    uv_mutex_unlock(&w->loop->wq_mutex);
+  copy = NULL;
+  if (cpumask != NULL) {
+    copy = uv__malloc(mask_size);
+    if (copy == NULL)
+      return UV_ENOMEM;
+    memcpy(copy, cpumask, mask_size);
+  }
 
-    /* Lock `mutex` since that is expected at the start of the next
-     * iteration. */
-    uv_mutex_lock(&mutex);
-    if (is_slow_work) {
-      /* `slow_io_work_running` is protected by `mutex`. */
-      slow_io_work_running--;
-    }
+  lfields = uv__get_internal_fields(loop);
+  old = lfields->threadpool_cpumask;
+  old_size = lfields->threadpool_mask_size;
+  lfields->threadpool_cpumask = copy;
+  lfields->threadpool_mask_size = copy != NULL ? mask_size : 0;
+
+  err = 0;
+  pool = lfields->threadpool;
+  if (pool != NULL && pool->owner == loop)
+    err = uv__threadpool_loop_configure(loop, pool->max_threads);
+
+  if (err) {
+    lfields->threadpool_cpumask = old;
+    lfields->threadpool_mask_size = old_size;
+    old = copy;
   }
+
+  uv__free(old);
+  return err;
 }
 
 
-static void post(QUEUE* q, enum uv__work_kind kind) {
-  uv_mutex_lock(&mutex);
-  if (kind == UV__WORK_SLOW_IO) {
-    /* Insert into a separate queue. */
-    QUEUE_INSERT_TAIL(&slow_io_pending_wq, q);
-    if (!QUEUE_EMPTY(&run_slow_work_message)) {
-      /* Running slow I/O tasks is already scheduled => Nothing to do here.
-         The worker that runs said other task will schedule this one as well. */
-      uv_mutex_unlock(&mutex);
-      return;
-    }
-    q = &run_slow_work_message;
+void uv__threadpool_loop_close(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__work_record* rec;
+
+  threadpool_loop_release(loop);
+
+  lfields = uv__get_internal_fields(loop);
+  while (lfields->work_records != NULL) {
+    rec = lfields->work_records;
+    lfields->work_records = rec->wq[0];
+    uv__free(rec);
   }
 
-  QUEUE_INSERT_TAIL(&wq, q);
-  if (idle_threads > 0)
-    uv_cond_signal(&cond);
-  uv_mutex_unlock(&mutex);
+  uv__free(lfields->threadpool_cpumask);
+  lfields->threadpool_cpumask = NULL;
+  lfields->threadpool_mask_size = 0;
 }
 
 
-#ifdef __MVS__
-/* TODO(itodorov) - zos: revisit when Woz compiler is available. */
-__attribute__((destructor))
-#endif
-void uv__threadpool_cleanup(void) {
-  unsigned int i;
+/* Makes |loop| post its work to the private pool of |owner|. The loops are
+ * closed from the same thread, the reference count isn't synchronized.
+ */
+int uv__threadpool_loop_share(uv_loop_t* loop, uv_loop_t* owner) {
+  struct uv__threadpool* pool;
 
-  if (nthreads == 0)
-    return;
+  if (uv__has_active_reqs(loop))
+    return UV_EBUSY;
 
-#ifndef __MVS__
-  /* TODO(gabylb) - zos: revisit when Woz compiler is available. */
-  post(&exit_message, UV__WORK_CPU);
-#endif
+  pool = uv__get_internal_fields(owner)->threadpool;
+  if (pool == NULL)
+    return UV_EINVAL;
 
-  for (i = 0; i < nthreads; i++)
-    if (uv_thread_join(threads + i))
-      abort();
+  threadpool_loop_release(loop);
+  pool->refs++;
+  uv__get_internal_fields(loop)->threadpool = pool;
 
-  if (threads != default_threads)
-    uv__free(threads);
+  return 0;
+}
 
-  uv_mutex_destroy(&mutex);
-  uv_cond_destroy(&cond);
 
-  threads = NULL;
-  nthreads = 0;
-}
+#ifndef _WIN32
+int uv__threadpool_loop_fork(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__threadpool* pool;
+  unsigned int refs;
+  int err;
 
+  lfields = uv__get_internal_fields(loop);
+  pool = lfields->threadpool;
+  if (pool == NULL)
+    return 0;
 
-static void init_threads(void) {
-  unsigned int i;
-  const char* val;
-  uv_sem_t sem;
+  /* A shared pool is restarted once, by the loop that created it. */
+  if (pool->owner != loop)
+    return 0;
 
-  nthreads = ARRAY_SIZE(default_threads);
-  val = getenv("UV_THREADPOOL_SIZE");
-  if (val != NULL)
-    nthreads = atoi(val);
-  if (nthreads == 0)
-    nthreads = 1;
-  if (nthreads > MAX_THREADPOOL_SIZE)
-    nthreads = MAX_THREADPOOL_SIZE;
+  /* The threads didn't survive the fork and the mutex may have been held
+   * by one of them. Discard the old state, like the global pool does, and
+   * start over with fresh threads.
+   */
+  refs = pool->refs;
+  uv__free(pool->workers);
+  uv__free(pool->threads);
+  uv__free(pool->cpumask);
+  err = threadpool_init(pool,
+                        pool->nthreads,
+                        NULL,
+                        lfields->threadpool_cpumask,
+                        lfields->threadpool_mask_size);
+  pool->refs = refs;
+  pool->owner = loop;
+  return err;
+}
+#endif
 
-  threads = default_threads;
-  if (nthreads > ARRAY_SIZE(default_threads)) {
-    threads = uv__malloc(nthreads * sizeof(threads[0]));
-    if (threads == NULL) {
-      nthreads = ARRAY_SIZE(default_threads);
-      threads = default_threads;
-    }
-  }
 
-  if (uv_cond_init(&cond))
-    abort();
+/* Unix loops set up |wq_async| when they first use the threadpool, see
+ * uv_loop_init(). Always called on the loop thread, before anything can
+ * signal it.
+ */
+static void work_loop_init(uv_loop_t* loop) {
+  if (loop->wq_async.type == UV_ASYNC)
+    return;
 
-  if (uv_mutex_init(&mutex))
+  /* Like a threadpool that can't start, there's no way to report it. */
+  if (uv_async_init(loop, &loop->wq_async, uv__work_done))
     abort();
 
-  QUEUE_INIT(&wq);
-  QUEUE_INIT(&slow_io_pending_wq);
-  QUEUE_INIT(&run_slow_work_message);
+  uv__handle_unref(&loop->wq_async);
+  loop->wq_async.flags |= UV_HANDLE_INTERNAL;
+}
+
+
+/* The records of finished requests are kept for the next ones, the loop
+ * needs as many as it has requests in the threadpool at once.
+ */
+static struct uv__work_record* work_record_get(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__work_record* rec;
+
+  lfields = uv__get_internal_fields(loop);
+  rec = lfields->work_records;
+  if (rec != NULL) {
+    lfields->work_records = rec->wq[0];
+    return rec;
+  }
 
-  if (uv_sem_init(&sem, 0))
+  /* Like a threadpool that can't start, there's no way to report it. */
+  rec = uv__malloc(sizeof(*rec));
+  if (rec == NULL)
     abort();
 
-  for (i = 0; i < nthreads; i++)
-    if (uv_thread_create(threads + i, worker, &sem))
-      abort();
+  return rec;
+}
 
-  for (i = 0; i < nthreads; i++)
-    uv_sem_wait(&sem);
 
-  uv_sem_destroy(&sem);
+static void work_record_put(uv_loop_t* loop, struct uv__work_record* rec) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  rec->wq[0] = lfields->work_records;
+  lfields->work_records = rec;
 }
 
 
-#ifndef _WIN32
-static void reset_once(void) {
-  uv_once_t child_once = UV_ONCE_INIT;
-  memcpy(&once, &child_once, sizeof(child_once));
+/* NULL unless |w| is queued or running on the threadpool, or finished and
+ * not yet picked up by uv__work_done().
+ */
+static struct uv__work_record* work_record(const struct uv__work* w) {
+  if (w->wq[1] != NULL)
+    return NULL;
+  return w->wq[0];
 }
-#endif
 
 
-static void init_once(void) {
-#ifndef _WIN32
-  /* Re-initialize the threadpool after fork.
-   * Note that this discards the global mutex and condition as well
-   * as the work queue.
-   */
-  if (pthread_atfork(NULL, NULL, &reset_once))
-    abort();
-#endif
-  init_threads();
+static struct uv__work_record* work_init(uv_loop_t* loop,
+                                         struct uv__work* w,
+                                         enum uv__work_kind kind,
+                                         void (*work)(struct uv__work* w),
+                                         void (*done)(struct uv__work* w,
+                                                      int status),
+                                         uint64_t now) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__work_record* rec;
+
+  work_loop_init(loop);
+  lfields = uv__get_internal_fields(loop);
+  rec = work_record_get(loop);
+  rec->w = w;
+  rec->kind = kind;
+  rec->submit_time = now;
+  rec->tag = lfields->work_tag;
+  rec->deadline = 0;
+  if (lfields->work_timeout != 0)
+    rec->deadline = now + lfields->work_timeout;
+
+  w->loop = loop;
+  w->work = work;
+  w->done = done;
+  w->wq[0] = rec;
+  w->wq[1] = NULL;
+  UV__TRACE2(work__submit, w, kind);
+  return rec;
 }
 
 
@@ -263,30 +1663,92 @@ void uv__work_submit(uv_loop_t* loop,
                      enum uv__work_kind kind,
                      void (*work)(struct uv__work* w),
                      void (*done)(struct uv__work* w, int status)) {
-  uv_once(&once, init_once);
+  uv__work_submit_priority(loop,
+                           w,
+                           kind,
+                           UV_WORK_PRIORITY_NORMAL,
+                           work,
+                           done);
+}
+
+
+void uv__work_submit_priority(uv_loop_t* loop,
+                              struct uv__work* w,
+                              enum uv__work_kind kind,
+                              uv_work_priority priority,
+                              void (*work)(struct uv__work* w),
+                              void (*done)(struct uv__work* w, int status)) {
+  struct uv__work_record* rec;
+  struct uv__threadpool* pool;
+
+  pool = threadpool_get_kind(loop, kind);
+  rec = work_init(loop, w, kind, work, done, uv_hrtime());
+
+  if (pool->workers != NULL)
+    stealing_post(pool, loop, &rec->wq, kind, priority);
+  else
+    post(pool, &rec->wq, kind, priority);
+}
+
+
+/* Queues |w| for completion on the loop without running anything on the
+ * threadpool. Used for requests whose result is already known. They can't
+ * be cancelled since |w->work| is NULL.
+ */
+void uv__work_post(uv_loop_t* loop,
+                   struct uv__work* w,
+                   void (*done)(struct uv__work* w, int status)) {
+  work_loop_init(loop);
   w->loop = loop;
-  w->work = work;
+  w->work = NULL;
   w->done = done;
-  post(&w->wq, kind);
+
+  uv_mutex_lock(&loop->wq_mutex);
+  QUEUE_INSERT_TAIL(&loop->wq, &w->wq);
+  uv_async_send(&loop->wq_async);
+  uv_mutex_unlock(&loop->wq_mutex);
 }
 
 
 static int uv__work_cancel(uv_loop_t* loop, uv_req_t* req, struct uv__work* w) {
+  struct uv__work_record* rec;
+  struct uv__threadpool* pool;
+  unsigned int i;
   int cancelled;
 
-  uv_mutex_lock(&mutex);
-  uv_mutex_lock(&w->loop->wq_mutex);
+  /* Posted requests and those back in the loop's queue already can't be. */
+  rec = work_record(w);
+  if (rec == NULL)
+    return UV_EBUSY;
+
+  pool = threadpool_get_kind(w->loop, (enum uv__work_kind) rec->kind);
+
+  /* The request can be in any of the workers' queues. */
+  if (pool->workers != NULL)
+    for (i = 0; i < pool->nthreads; i++)
+      uv_mutex_lock(&pool->workers[i].mutex);
+
+  uv_mutex_lock(&pool->mutex);
 
-  cancelled = !QUEUE_EMPTY(&w->wq) && w->work != NULL;
-  if (cancelled)
-    QUEUE_REMOVE(&w->wq);
+  /* Threads take the record out of the queue before they run it. */
+  cancelled = !QUEUE_EMPTY(&rec->wq);
+  if (cancelled) {
+    QUEUE_REMOVE(&rec->wq);
+    pool->stats[rec->kind].cancelled++;
+    uv__store_relaxed(&pool->slow_io_pending,
+                      !QUEUE_EMPTY(&pool->slow_io_pending_wq));
+  }
+
+  uv_mutex_unlock(&pool->mutex);
 
-  uv_mutex_unlock(&w->loop->wq_mutex);
-  uv_mutex_unlock(&mutex);
+  if (pool->workers != NULL)
+    for (i = pool->nthreads; i > 0; i--)
+      uv_mutex_unlock(&pool->workers[i - 1].mutex);
 
   if (!cancelled)
     return UV_EBUSY;
 
+  work_record_put(loop, rec);
   w->work = uv__cancelled;
   uv_mutex_lock(&loop->wq_mutex);
   QUEUE_INSERT_TAIL(&loop->wq, &w->wq);
@@ -297,24 +1759,276 @@ static int uv__work_cancel(uv_loop_t* loop, uv_req_t* req, struct uv__work* w) {
 }
 
 
+/* Moves the requests of |loop| with |tag| from |wq| to |cancelled|. */
+static void cancel_tagged(struct uv__threadpool* pool,
+                          QUEUE* wq,
+                          uv_loop_t* loop,
+                          void* tag,
+                          QUEUE* cancelled) {
+  struct uv__work_record* rec;
+  QUEUE* next;
+  QUEUE* q;
+
+  for (q = QUEUE_HEAD(wq); q != wq; q = next) {
+    next = QUEUE_NEXT(q);
+    if (q == &pool->run_slow_work_message || q == &pool->exit_message)
+      continue;
+
+    rec = QUEUE_DATA(q, struct uv__work_record, wq);
+    if (rec->w->loop != loop || rec->tag != tag)
+      continue;
+
+    QUEUE_REMOVE(q);
+    QUEUE_INSERT_TAIL(cancelled, q);
+    pool->stats[rec->kind].cancelled++;
+  }
+}
+
+
+void uv_work_set_scope(uv_loop_t* loop, void* tag, uint64_t timeout) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  lfields->work_tag = tag;
+  lfields->work_timeout = timeout * 1000000;
+}
+
+
+static void cancel_tagged_pool(struct uv__threadpool* pool,
+                               uv_loop_t* loop,
+                               void* tag,
+                               QUEUE* cancelled) {
+  unsigned int i;
+  unsigned int p;
+
+  /* Same locking order as uv__work_cancel(). */
+  if (pool->workers != NULL)
+    for (i = 0; i < pool->nthreads; i++)
+      uv_mutex_lock(&pool->workers[i].mutex);
+
+  uv_mutex_lock(&pool->mutex);
+
+  for (p = 0; p < NUM_PRIORITIES; p++) {
+    cancel_tagged(pool, &pool->wq[p], loop, tag, cancelled);
+    if (pool->workers != NULL)
+      for (i = 0; i < pool->nthreads; i++)
+        cancel_tagged(pool, &pool->workers[i].wq[p], loop, tag, cancelled);
+  }
+  cancel_tagged(pool, &pool->slow_io_pending_wq, loop, tag, cancelled);
+  uv__store_relaxed(&pool->slow_io_pending,
+                    !QUEUE_EMPTY(&pool->slow_io_pending_wq));
+
+  uv_mutex_unlock(&pool->mutex);
+
+  if (pool->workers != NULL)
+    for (i = pool->nthreads; i > 0; i--)
+      uv_mutex_unlock(&pool->workers[i - 1].mutex);
+}
+
+
+int uv_work_cancel_tag(uv_loop_t* loop, void* tag) {
+  struct uv__work_record* rec;
+  struct uv__threadpool* pool;
+  struct uv__work* w;
+  unsigned int kind;
+  QUEUE cancelled;
+  QUEUE wq;
+  QUEUE* q;
+  int n;
+
+  if (tag == NULL)
+    return UV_EINVAL;
+
+  pool = threadpool_get(loop);
+  QUEUE_INIT(&cancelled);
+  cancel_tagged_pool(pool, loop, tag, &cancelled);
+
+  if (pool == &default_pool)
+    for (kind = 0; kind < NUM_KINDS; kind++)
+      if (kind_pools[kind].nthreads > 0)
+        cancel_tagged_pool(&kind_pools[kind], loop, tag, &cancelled);
+
+  n = 0;
+  QUEUE_INIT(&wq);
+  while (!QUEUE_EMPTY(&cancelled)) {
+    q = QUEUE_HEAD(&cancelled);
+    QUEUE_REMOVE(q);
+    rec = QUEUE_DATA(q, struct uv__work_record, wq);
+    w = rec->w;
+    work_record_put(loop, rec);
+    w->work = uv__cancelled;
+    QUEUE_INSERT_TAIL(&wq, &w->wq);
+    n++;
+  }
+
+  if (n == 0)
+    return 0;
+
+  uv_mutex_lock(&loop->wq_mutex);
+  QUEUE_ADD(&loop->wq, &wq);
+  uv_async_send(&loop->wq_async);
+  uv_mutex_unlock(&loop->wq_mutex);
+
+  return n;
+}
+
+
+static void add_stats(uv_threadpool_metrics_t* metrics,
+                      const struct uv__work_stats* stats) {
+  uv_threadpool_work_metrics_t* m;
+  const struct uv__work_stats* s;
+  unsigned int i;
+  unsigned int k;
+
+  for (k = 0; k < NUM_KINDS; k++) {
+    m = &metrics->kinds[k];
+    s = &stats[k];
+    m->submitted += s->submitted;
+    m->completed += s->completed;
+    m->cancelled += s->cancelled;
+    m->wait_time += s->wait_time;
+    m->exec_time += s->exec_time;
+    for (i = 0; i < UV_THREADPOOL_HISTOGRAM_SIZE; i++) {
+      m->wait_histogram[i] += s->wait_histogram[i];
+      m->exec_histogram[i] += s->exec_histogram[i];
+    }
+  }
+}
+
+
+static void count_queued(uv_threadpool_metrics_t* metrics,
+                         struct uv__threadpool* pool,
+                         QUEUE* wq) {
+  QUEUE* q;
+
+  QUEUE_FOREACH(q, wq) {
+    if (q == &pool->run_slow_work_message || q == &pool->exit_message)
+      continue;
+    metrics->kinds[QUEUE_DATA(q, struct uv__work_record, wq)->kind].queued++;
+  }
+}
+
+
+static void pool_metrics(uv_threadpool_metrics_t* metrics,
+                         struct uv__threadpool* pool) {
+  struct uv__worker* worker;
+  unsigned int i;
+  unsigned int p;
+
+  /* Same lock order as uv__work_cancel(), the workers before the pool. The
+   * workers are locked one at a time, the totals are not a snapshot.
+   */
+  if (pool->workers != NULL) {
+    for (i = 0; i < pool->nthreads; i++) {
+      worker = &pool->workers[i];
+      uv_mutex_lock(&worker->mutex);
+      add_stats(metrics, worker->stats);
+      for (p = 0; p < NUM_PRIORITIES; p++)
+        count_queued(metrics, pool, &worker->wq[p]);
+      uv_mutex_unlock(&worker->mutex);
+    }
+  }
+
+  uv_mutex_lock(&pool->mutex);
+  add_stats(metrics, pool->stats);
+  for (p = 0; p < NUM_PRIORITIES; p++)
+    count_queued(metrics, pool, &pool->wq[p]);
+  count_queued(metrics, pool, &pool->slow_io_pending_wq);
+  metrics->threads += pool->nthreads;
+  metrics->idle_threads += pool->idle_threads;
+  uv_mutex_unlock(&pool->mutex);
+}
+
+
+int uv_threadpool_metrics(uv_loop_t* loop, uv_threadpool_metrics_t* metrics) {
+  struct uv__threadpool* pool;
+  unsigned int kind;
+
+  if (metrics == NULL)
+    return UV_EINVAL;
+
+  if (loop != NULL) {
+    pool = threadpool_get(loop);
+  } else {
+    uv_once(&once, init_once);
+    pool = &default_pool;
+  }
+
+  memset(metrics, 0, sizeof(*metrics));
+  pool_metrics(metrics, pool);
+
+  /* The global pool's numbers include the pools of the kinds of work. */
+  if (pool == &default_pool)
+    for (kind = 0; kind < NUM_KINDS; kind++)
+      if (kind_pools[kind].nthreads > 0)
+        pool_metrics(metrics, &kind_pools[kind]);
+
+  return 0;
+}
+
+
+uint64_t uv_threadpool_histogram_bound(unsigned int index) {
+  unsigned int e;
+
+  if (index >= UV_THREADPOOL_HISTOGRAM_SIZE)
+    return UINT64_MAX;
+
+  if (index < 4)
+    return index;
+
+  e = index / 4 + 1;
+  return (uint64_t) (4 + index % 4) << (e - 2);
+}
+
+
 void uv__work_done(uv_async_t* handle) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__work_record* rec;
   struct uv__work* w;
   uv_loop_t* loop;
+  void* head;
+  void* prev;
   QUEUE* q;
   QUEUE wq;
   int err;
 
   loop = container_of(handle, uv_loop_t, wq_async);
+  lfields = uv__get_internal_fields(loop);
+
+  /* Cancelled and posted requests. */
   uv_mutex_lock(&loop->wq_mutex);
   QUEUE_MOVE(&loop->wq, &wq);
   uv_mutex_unlock(&loop->wq_mutex);
 
+  head = uv__load_relaxed(&lfields->work_done);
+  while (head != NULL) {
+    prev = work_cmpxchg(&lfields->work_done, head, NULL);
+    if (prev == head)
+      break;
+    head = prev;
+  }
+
+  /* The stack is newest first, restore the order of completion. */
+  q = QUEUE_PREV(&wq);
+  while (head != NULL) {
+    rec = head;
+    head = rec->wq[1];
+    w = rec->w;
+    work_record_put(loop, rec);
+    QUEUE_INSERT_HEAD(q, &w->wq);
+  }
+
   while (!QUEUE_EMPTY(&wq)) {
     q = QUEUE_HEAD(&wq);
     QUEUE_REMOVE(q);
 
     w = container_of(q, struct uv__work, wq);
-    err = (w->work == uv__cancelled) ? UV_ECANCELED : 0;
+    err = 0;
+    if (w->work == uv__cancelled)
+      err = UV_ECANCELED;
+    else if (w->work == uv__expired)
+      err = UV_ETIMEDOUT;
+    UV__TRACE2(work__done, w, err);
     w->done(w, err);
   }
 }
@@ -344,18 +2058,88 @@ int uv_queue_work(uv_loop_t* loop,
                   uv_work_t* req,
                   uv_work_cb work_cb,
                   uv_after_work_cb after_work_cb) {
+  return uv_queue_work_ex(loop,
+                          req,
+                          UV_WORK_PRIORITY_NORMAL,
+                          work_cb,
+                          after_work_cb);
+}
+
+
+int uv_queue_work_ex(uv_loop_t* loop,
+                     uv_work_t* req,
+                     uv_work_priority priority,
+                     uv_work_cb work_cb,
+                     uv_after_work_cb after_work_cb) {
   if (work_cb == NULL)
     return UV_EINVAL;
 
+  if (priority < UV_WORK_PRIORITY_HIGH ||
+      priority > UV_WORK_PRIORITY_BACKGROUND)
+    return UV_EINVAL;
+
   uv__req_init(loop, req, UV_WORK);
   req->loop = loop;
   req->work_cb = work_cb;
   req->after_work_cb = after_work_cb;
-  uv__work_submit(loop,
-                  &req->work_req,
-                  UV__WORK_CPU,
-                  uv__queue_work,
-                  uv__queue_done);
+  uv__work_submit_priority(loop,
+                           &req->work_req,
+                           UV__WORK_CPU,
+                           priority,
+                           uv__queue_work,
+                           uv__queue_done);
+  return 0;
+}
+
+
+int uv_queue_work_batch(uv_loop_t* loop,
+                        uv_work_t* reqs[],
+                        unsigned int nreqs,
+                        uv_work_cb work_cb,
+                        uv_after_work_cb after_work_cb) {
+  struct uv__work_record* recs[64];
+  struct uv__threadpool* pool;
+  unsigned int done;
+  unsigned int n;
+  unsigned int i;
+  uint64_t now;
+
+  if (reqs == NULL || work_cb == NULL)
+    return UV_EINVAL;
+
+  for (i = 0; i < nreqs; i++)
+    if (reqs[i] == NULL)
+      return UV_EINVAL;
+
+  pool = threadpool_get_kind(loop, UV__WORK_CPU);
+  now = uv_hrtime();
+
+  /* In slices, so that the array of records doesn't need an allocation. */
+  for (done = 0; done < nreqs; done += n) {
+    n = nreqs - done;
+    if (n > ARRAY_SIZE(recs))
+      n = ARRAY_SIZE(recs);
+
+    for (i = 0; i < n; i++) {
+      uv__req_init(loop, reqs[done + i], UV_WORK);
+      reqs[done + i]->loop = loop;
+      reqs[done + i]->work_cb = work_cb;
+      reqs[done + i]->after_work_cb = after_work_cb;
+      recs[i] = work_init(loop,
+                          &reqs[done + i]->work_req,
+                          UV__WORK_CPU,
+                          uv__queue_work,
+                          uv__queue_done,
+                          now);
+    }
+
+    if (pool->workers != NULL)
+      stealing_post_batch(pool, loop, recs, n, UV__WORK_CPU,
+                          UV_WORK_PRIORITY_NORMAL);
+    else
+      post_batch(pool, recs, n, UV__WORK_CPU, UV_WORK_PRIORITY_NORMAL);
+  }
+
   return 0;
 }
 
@@ -370,6 +2154,9 @@ int uv_cancel(uv_req_t* req) {
     wreq = &((uv_fs_t*) req)->work_req;
     break;
   case UV_GETADDRINFO:
+#ifdef _WIN32
+    return uv__getaddrinfo_cancel((uv_getaddrinfo_t*) req);
+#endif
     loop =  ((uv_getaddrinfo_t*) req)->loop;
     wreq = &((uv_getaddrinfo_t*) req)->work_req;
     break;
@@ -377,6 +2164,10 @@ int uv_cancel(uv_req_t* req) {
     loop = ((uv_getnameinfo_t*) req)->loop;
     wreq = &((uv_getnameinfo_t*) req)->work_req;
     break;
+  case UV_GETNAMEINFO_MANY:
+    loop = ((uv_getnameinfo_many_t*) req)->loop;
+    wreq = &((uv_getnameinfo_many_t*) req)->work_req;
+    break;
   case UV_RANDOM:
     loop = ((uv_random_t*) req)->loop;
     wreq = &((uv_random_t*) req)->work_req;
@@ -18,31 +18,57 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_LOOP
+
 #include "uv.h"
 #include "uv-common.h"
-#include "heap-inl.h"
 
 #include <assert.h>
 #include <limits.h>
+#include <string.h>
 
-
-static struct heap *timer_heap(const uv_loop_t* loop) {
-#ifdef _WIN32
-  return (struct heap*) loop->timer_heap;
-#else
-  return (struct heap*) &loop->timer_heap;
-#endif
+/* Timers live in an array-backed 4-ary min-heap. The children of the timer at
+ * index i are at 4i+1 through 4i+4, so a sift visits half as many levels as
+ * in a binary heap and the siblings it compares share a cache line or two.
+ * While a timer is in the heap, heap_node[0] holds its index.
+ */
+#define UV__HEAP_ARITY 4
+#define UV__HEAP_MIN_SIZE 64
+#define UV__HEAP_MAX_SIZE (UINT_MAX / sizeof(uv_timer_t*))
+
+/* Hierarchical timing wheel, enabled with UV_LOOP_USE_TIMER_WHEEL. Four
+ * levels of 256 slots cover deadlines up to 2^32 milliseconds out. Timers
+ * cascade down a level as their deadline approaches, so they still expire
+ * with millisecond precision. Timers that are due within the span of the
+ * first level, or further out than the last one, stay in the heap.
+ */
+#define UV__TW_BITS 8
+#define UV__TW_SLOTS (1u << UV__TW_BITS)
+#define UV__TW_MASK (UV__TW_SLOTS - 1)
+#define UV__TW_LEVELS 4
+#define UV__TW_DUE UV__TW_LEVELS
+
+struct uv__timer_wheel {
+  uint64_t time;  /* Next millisecond to expire. */
+  uint64_t next[UV__TW_LEVELS];  /* Earliest timeout in each level. */
+  unsigned int next_valid;  /* Bit per level, see timer_wheel_next(). */
+  unsigned int count[UV__TW_LEVELS + 1];
+  QUEUE due;
+  QUEUE slots[UV__TW_LEVELS][UV__TW_SLOTS];
+};
+
+
+static struct uv__timer_heap* timer_heap(const uv_loop_t* loop) {
+  return &uv__get_internal_fields(loop)->timer_heap;
 }
 
 
-static int timer_less_than(const struct heap_node* ha,
-                           const struct heap_node* hb) {
-  const uv_timer_t* a;
-  const uv_timer_t* b;
+static struct uv__timer_wheel* timer_wheel(const uv_loop_t* loop) {
+  return uv__get_internal_fields(loop)->timer_wheel;
+}
 
-  a = container_of(ha, uv_timer_t, heap_node);
-  b = container_of(hb, uv_timer_t, heap_node);
 
+static int timer_less_than(const uv_timer_t* a, const uv_timer_t* b) {
   if (a->timeout < b->timeout)
     return 1;
   if (b->timeout < a->timeout)
@@ -55,26 +81,463 @@ static int timer_less_than(const struct heap_node* ha,
 }
 
 
+static void timer_heap_set(struct uv__timer_heap* heap,
+                           unsigned int index,
+                           uv_timer_t* handle) {
+  heap->timers[index] = handle;
+  handle->heap_node[0] = (void*) (uintptr_t) index;
+}
+
+
+static unsigned int timer_heap_index(const uv_timer_t* handle) {
+  return (unsigned int) (uintptr_t) handle->heap_node[0];
+}
+
+
+static void timer_heap_sift_up(struct uv__timer_heap* heap,
+                               unsigned int index,
+                               uv_timer_t* handle) {
+  unsigned int parent;
+
+  while (index > 0) {
+    parent = (index - 1) / UV__HEAP_ARITY;
+    if (!timer_less_than(handle, heap->timers[parent]))
+      break;
+    timer_heap_set(heap, index, heap->timers[parent]);
+    index = parent;
+  }
+
+  timer_heap_set(heap, index, handle);
+}
+
+
+static void timer_heap_sift_down(struct uv__timer_heap* heap,
+                                 unsigned int index,
+                                 uv_timer_t* handle) {
+  unsigned int smallest;
+  unsigned int child;
+  unsigned int end;
+
+  for (;;) {
+    child = index * UV__HEAP_ARITY + 1;
+    if (child >= heap->nelts || child <= index)
+      break;
+
+    end = heap->nelts - child > UV__HEAP_ARITY ?
+        child + UV__HEAP_ARITY : heap->nelts;
+    for (smallest = child++; child < end; child++)
+      if (timer_less_than(heap->timers[child], heap->timers[smallest]))
+        smallest = child;
+
+    if (!timer_less_than(heap->timers[smallest], handle))
+      break;
+
+    timer_heap_set(heap, index, heap->timers[smallest]);
+    index = smallest;
+  }
+
+  timer_heap_set(heap, index, handle);
+}
+
+
+static uv_timer_t* timer_heap_min(const struct uv__timer_heap* heap) {
+  if (heap->nelts == 0)
+    return NULL;
+
+  return heap->timers[0];
+}
+
+
+/* Make room for |n| more timers. */
+static int timer_heap_reserve(struct uv__timer_heap* heap, unsigned int n) {
+  uv_timer_t** timers;
+  unsigned int size;
+
+  if (n > UV__HEAP_MAX_SIZE - heap->nelts)
+    return UV_ENOMEM;
+
+  size = heap->size == 0 ? UV__HEAP_MIN_SIZE : heap->size;
+  while (size < heap->nelts + n)
+    size = size > UV__HEAP_MAX_SIZE / 2 ? UV__HEAP_MAX_SIZE : 2 * size;
+
+  if (size == heap->size)
+    return 0;
+
+  timers = uv__realloc(heap->timers, size * sizeof(*timers));
+  if (timers == NULL)
+    return UV_ENOMEM;
+
+  heap->timers = timers;
+  heap->size = size;
+  return 0;
+}
+
+
+static int timer_heap_insert(struct uv__timer_heap* heap,
+                             uv_timer_t* handle) {
+  int err;
+
+  err = timer_heap_reserve(heap, 1);
+  if (err)
+    return err;
+
+  timer_heap_sift_up(heap, heap->nelts++, handle);
+  return 0;
+}
+
+
+static void timer_heap_remove(struct uv__timer_heap* heap,
+                              uv_timer_t* handle) {
+  uv_timer_t* last;
+  unsigned int index;
+
+  index = timer_heap_index(handle);
+  assert(index < heap->nelts && heap->timers[index] == handle);
+
+  last = heap->timers[--heap->nelts];
+  if (last != handle) {
+    if (index > 0 &&
+        timer_less_than(last, heap->timers[(index - 1) / UV__HEAP_ARITY]))
+      timer_heap_sift_up(heap, index, last);
+    else
+      timer_heap_sift_down(heap, index, last);
+  }
+}
+
+
+/* Give memory back once the heap has shrunk well below its size. Halving at
+ * a quarter full leaves room for the uv_timer_again() that follows the
+ * removal of a repeating timer, so that never needs to reallocate.
+ */
+static void timer_heap_trim(struct uv__timer_heap* heap) {
+  uv_timer_t** timers;
+
+  if (heap->size > UV__HEAP_MIN_SIZE && heap->nelts < heap->size / 4) {
+    timers = uv__realloc(heap->timers, heap->size / 2 * sizeof(*timers));
+    if (timers != NULL) {
+      heap->timers = timers;
+      heap->size /= 2;
+    }
+  }
+}
+
+
+void uv__timer_heap_delete(uv_loop_t* loop) {
+  struct uv__timer_heap* heap;
+
+  heap = timer_heap(loop);
+  uv__free(heap->timers);
+  heap->timers = NULL;
+  heap->nelts = 0;
+  heap->size = 0;
+}
+
+
+/* The heap_node field doubles as the wheel's list node. The third pointer
+ * records the level the timer sits in, UV__TW_DUE once it has expired.
+ */
+static QUEUE* timer_wheel_node(uv_timer_t* handle) {
+  return (QUEUE*) &handle->heap_node[0];
+}
+
+
+static int timer_wheel_eligible(const struct uv__timer_wheel* tw,
+                                uint64_t timeout) {
+  if (timeout < tw->time + UV__TW_SLOTS)
+    return 0;
+
+  return timeout - tw->time <= (uint64_t) UINT32_MAX;
+}
+
+
+static void timer_wheel_insert(struct uv__timer_wheel* tw,
+                               uv_timer_t* handle) {
+  unsigned int level;
+  unsigned int slot;
+  uint64_t expires;
+  uint64_t delta;
+
+  expires = handle->timeout;
+  if (expires < tw->time)
+    expires = tw->time;
+
+  delta = expires - tw->time;
+  level = 0;
+  while (level + 1 < UV__TW_LEVELS &&
+         delta >> (UV__TW_BITS * (level + 1)) != 0)
+    level++;
+
+  slot = (expires >> (UV__TW_BITS * level)) & UV__TW_MASK;
+  QUEUE_INSERT_TAIL(&tw->slots[level][slot], timer_wheel_node(handle));
+  handle->heap_node[2] = (void*) (uintptr_t) level;
+  tw->count[level]++;
+
+  if ((tw->next_valid & (1u << level)) && handle->timeout < tw->next[level])
+    tw->next[level] = handle->timeout;
+}
+
+
+static void timer_wheel_remove(struct uv__timer_wheel* tw,
+                               uv_timer_t* handle) {
+  unsigned int level;
+
+  level = (uintptr_t) handle->heap_node[2];
+  QUEUE_REMOVE(timer_wheel_node(handle));
+  tw->count[level]--;
+
+  /* Only the earliest timer of a level invalidates its cached timeout. */
+  if (level != UV__TW_DUE && handle->timeout <= tw->next[level])
+    tw->next_valid &= ~(1u << level);
+}
+
+
+/* Redistribute the timers of a slot over the levels below it. */
+static void timer_wheel_cascade(struct uv__timer_wheel* tw,
+                                unsigned int level,
+                                unsigned int slot) {
+  uv_timer_t* handle;
+  QUEUE queue;
+  QUEUE* q;
+
+  QUEUE_MOVE(&tw->slots[level][slot], &queue);
+  while (!QUEUE_EMPTY(&queue)) {
+    q = QUEUE_HEAD(&queue);
+    handle = QUEUE_DATA(q, uv_timer_t, heap_node);
+    timer_wheel_remove(tw, handle);
+    timer_wheel_insert(tw, handle);
+  }
+}
+
+
+/* Move all timers that expire at or before |now| to the due list. */
+static void timer_wheel_advance(struct uv__timer_wheel* tw, uint64_t now) {
+  uv_timer_t* handle;
+  unsigned int level;
+  unsigned int slot;
+  uint64_t span;
+  uint64_t time;
+  QUEUE* q;
+
+  while (tw->time <= now) {
+    /* Skip ahead over stretches where the lower levels are empty. */
+    for (level = 0; level < UV__TW_LEVELS; level++)
+      if (tw->count[level] != 0)
+        break;
+
+    if (level == UV__TW_LEVELS) {
+      tw->time = now + 1;
+      break;
+    }
+
+    if (level > 0) {
+      span = (uint64_t) 1 << (UV__TW_BITS * level);
+      time = (tw->time + span - 1) & ~(span - 1);
+      if (time > now) {
+        tw->time = now + 1;
+        break;
+      }
+      tw->time = time;
+    }
+
+    slot = tw->time & UV__TW_MASK;
+    for (level = 1; slot == 0 && level < UV__TW_LEVELS; level++) {
+      slot = (tw->time >> (UV__TW_BITS * level)) & UV__TW_MASK;
+      timer_wheel_cascade(tw, level, slot);
+    }
+
+    slot = tw->time & UV__TW_MASK;
+    while (!QUEUE_EMPTY(&tw->slots[0][slot])) {
+      q = QUEUE_HEAD(&tw->slots[0][slot]);
+      handle = QUEUE_DATA(q, uv_timer_t, heap_node);
+      timer_wheel_remove(tw, handle);
+      QUEUE_INSERT_TAIL(&tw->due, q);
+      handle->heap_node[2] = (void*) (uintptr_t) UV__TW_DUE;
+      tw->count[UV__TW_DUE]++;
+    }
+
+    tw->time++;
+  }
+}
+
+
+/* The earliest timeout of a level. Its timers are spread over the slots in
+ * deadline order, starting at the current one, so the first slot that isn't
+ * empty holds it.
+ */
+static uint64_t timer_wheel_level_next(struct uv__timer_wheel* tw,
+                                       unsigned int level) {
+  uv_timer_t* handle;
+  QUEUE* slot;
+  QUEUE* q;
+  unsigned int shift;
+  unsigned int k;
+  uint64_t block;
+  uint64_t next;
+
+  shift = UV__TW_BITS * level;
+  block = tw->time >> shift;
+  next = (uint64_t) -1;
+
+  for (k = 0; k < UV__TW_SLOTS; k++) {
+    slot = &tw->slots[level][(block + k) & UV__TW_MASK];
+    if (QUEUE_EMPTY(slot))
+      continue;
+
+    QUEUE_FOREACH(q, slot) {
+      handle = QUEUE_DATA(q, uv_timer_t, heap_node);
+      if (handle->timeout < next)
+        next = handle->timeout;
+    }
+    break;
+  }
+
+  return next;
+}
+
+
+/* Computes the earliest timeout in the wheel, 0 when timers have expired.
+ * The timeout of each level is cached until its earliest timer goes away.
+ * Returns 0 when the wheel is empty.
+ */
+static int timer_wheel_next(struct uv__timer_wheel* tw, uint64_t* result) {
+  unsigned int level;
+  uint64_t next;
+
+  if (!QUEUE_EMPTY(&tw->due)) {
+    *result = 0;
+    return 1;
+  }
+
+  next = (uint64_t) -1;
+  for (level = 0; level < UV__TW_LEVELS; level++) {
+    if (tw->count[level] == 0)
+      continue;
+
+    if (!(tw->next_valid & (1u << level))) {
+      tw->next[level] = timer_wheel_level_next(tw, level);
+      tw->next_valid |= 1u << level;
+    }
+
+    if (tw->next[level] < next)
+      next = tw->next[level];
+  }
+
+  *result = next;
+  return next != (uint64_t) -1;
+}
+
+
+int uv__timer_wheel_enable(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__timer_wheel* tw;
+  unsigned int level;
+  unsigned int slot;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->timer_wheel != NULL)
+    return 0;
+
+  tw = uv__malloc(sizeof(*tw));
+  if (tw == NULL)
+    return UV_ENOMEM;
+
+  memset(tw->count, 0, sizeof(tw->count));
+  memset(tw->next, 0, sizeof(tw->next));
+  tw->time = loop->time;
+  tw->next_valid = 0;
+  QUEUE_INIT(&tw->due);
+  for (level = 0; level < UV__TW_LEVELS; level++)
+    for (slot = 0; slot < UV__TW_SLOTS; slot++)
+      QUEUE_INIT(&tw->slots[level][slot]);
+
+  lfields->timer_wheel = tw;
+
+  return 0;
+}
+
+
+void uv__timer_wheel_delete(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  uv__free(lfields->timer_wheel);
+  lfields->timer_wheel = NULL;
+}
+
+
+/* The slack lives in the reserved handle fields to keep the ABI stable. */
+static uint64_t timer_slack(const uv_timer_t* handle) {
+  return (uintptr_t) handle->u.reserved[0];
+}
+
+
+static uint64_t timer_deadline(const uv_timer_t* handle) {
+  uint64_t deadline;
+
+  deadline = handle->timeout + timer_slack(handle);
+  if (deadline < handle->timeout)
+    deadline = (uint64_t) -1;
+
+  return deadline;
+}
+
+
+/* Find the earliest time by which a timer in the subtree must run. Timers
+ * are allowed to run up to their slack late so waking up at that time runs
+ * everything that's due by then in one go. The heap is ordered by timeout
+ * so subtrees whose root expires after the best deadline so far are skipped.
+ */
+static void timer_min_deadline(const struct uv__timer_heap* heap,
+                               unsigned int index,
+                               uint64_t* deadline) {
+  const uv_timer_t* handle;
+  unsigned int child;
+  unsigned int k;
+  uint64_t d;
+
+  handle = heap->timers[index];
+  if (handle->timeout >= *deadline)
+    return;
+
+  d = timer_deadline(handle);
+  if (d < *deadline)
+    *deadline = d;
+
+  child = index * UV__HEAP_ARITY + 1;
+  for (k = 0; k < UV__HEAP_ARITY; k++) {
+    if (child + k >= heap->nelts || child + k <= index)
+      break;
+    timer_min_deadline(heap, child + k, deadline);
+  }
+}
+
+
 int uv_timer_init(uv_loop_t* loop, uv_timer_t* handle) {
   uv__handle_init(loop, (uv_handle_t*)handle, UV_TIMER);
   handle->timer_cb = NULL;
   handle->timeout = 0;
   handle->repeat = 0;
+  handle->u.reserved[0] = NULL;
   return 0;
 }
 
 
-int uv_timer_start(uv_timer_t* handle,
-                   uv_timer_cb cb,
-                   uint64_t timeout,
-                   uint64_t repeat) {
-  uint64_t clamped_timeout;
+static void timer_stop(uv_timer_t* handle) {
+  if (handle->flags & UV_HANDLE_TIMER_WHEEL) {
+    timer_wheel_remove(timer_wheel(handle->loop), handle);
+    handle->flags &= ~UV_HANDLE_TIMER_WHEEL;
+  } else {
+    timer_heap_remove(timer_heap(handle->loop), handle);
+  }
+  uv__handle_stop(handle);
+}
 
-  if (uv__is_closing(handle) || cb == NULL)
-    return UV_EINVAL;
 
-  if (uv__is_active(handle))
-    uv_timer_stop(handle);
+static void timer_setup(uv_timer_t* handle,
+                        uv_timer_cb cb,
+                        uint64_t timeout,
+                        uint64_t repeat) {
+  uint64_t clamped_timeout;
 
   clamped_timeout = handle->loop->time + timeout;
   if (clamped_timeout < timeout)
@@ -85,24 +548,107 @@ int uv_timer_start(uv_timer_t* handle,
   handle->repeat = repeat;
   /* start_id is the second index to be compared in timer_less_than() */
   handle->start_id = handle->loop->timer_counter++;
+}
+
+
+/* Returns 1 if the timer went into the wheel, 0 if it belongs in the heap. */
+static int timer_wheel_start(uv_timer_t* handle) {
+  struct uv__timer_wheel* tw;
+
+  tw = timer_wheel(handle->loop);
+  if (tw == NULL || !timer_wheel_eligible(tw, handle->timeout))
+    return 0;
+
+  timer_wheel_insert(tw, handle);
+  handle->flags |= UV_HANDLE_TIMER_WHEEL;
+
+  return 1;
+}
+
+
+int uv_timer_start(uv_timer_t* handle,
+                   uv_timer_cb cb,
+                   uint64_t timeout,
+                   uint64_t repeat) {
+  int err;
 
-  heap_insert(timer_heap(handle->loop),
-              (struct heap_node*) &handle->heap_node,
-              timer_less_than);
+  if (uv__is_closing(handle) || cb == NULL)
+    return UV_EINVAL;
+
+  if (uv__is_active(handle))
+    uv_timer_stop(handle);
+
+  timer_setup(handle, cb, timeout, repeat);
+  if (!timer_wheel_start(handle)) {
+    err = timer_heap_insert(timer_heap(handle->loop), handle);
+    if (err)
+      return err;
+  }
   uv__handle_start(handle);
 
   return 0;
 }
 
 
+int uv_timer_start_many(uv_timer_t* handles[],
+                        unsigned int nhandles,
+                        uv_timer_cb cb,
+                        const uint64_t timeouts[],
+                        uint64_t repeat) {
+  struct uv__timer_heap* heap;
+  uv_timer_t* handle;
+  uv_loop_t* loop;
+  unsigned int i;
+  int err;
+
+  if (handles == NULL || timeouts == NULL || cb == NULL)
+    return UV_EINVAL;
+
+  /* Only look at the pointers, the timers themselves are touched once. */
+  for (i = 0; i < nhandles; i++)
+    if (handles[i] == NULL)
+      return UV_EINVAL;
+
+  if (nhandles == 0)
+    return 0;
+
+  /* Reserve room for all of them up front so that either every timer is
+   * started or none is. Stopping active timers only makes more room, as
+   * long as the heap isn't trimmed in between.
+   */
+  loop = handles[0]->loop;
+  heap = timer_heap(loop);
+  err = timer_heap_reserve(heap, nhandles);
+  if (err)
+    return err;
+
+  /* Sift each timer up as it's added rather than heapify the lot after.
+   * With the heap in an array that is O(1) on average for timeouts in
+   * random or ascending order, and the timers are the memory that counts.
+   * Heapifying means coming back to them to store their new index.
+   */
+  for (i = 0; i < nhandles; i++) {
+    handle = handles[i];
+    assert(handle->loop == loop);
+    assert(!uv__is_closing(handle));
+    if (uv__is_active(handle))
+      timer_stop(handle);
+    timer_setup(handle, cb, timeouts[i], repeat);
+    if (!timer_wheel_start(handle))
+      timer_heap_sift_up(heap, heap->nelts++, handle);
+    uv__handle_start(handle);
+  }
+
+  return 0;
+}
+
+
 int uv_timer_stop(uv_timer_t* handle) {
   if (!uv__is_active(handle))
     return 0;
 
-  heap_remove(timer_heap(handle->loop),
-              (struct heap_node*) &handle->heap_node,
-              timer_less_than);
-  uv__handle_stop(handle);
+  timer_stop(handle);
+  timer_heap_trim(timer_heap(handle->loop));
 
   return 0;
 }
@@ -131,6 +677,19 @@ uint64_t uv_timer_get_repeat(const uv_timer_t* handle) {
 }
 
 
+void uv_timer_set_slack(uv_timer_t* handle, uint64_t slack) {
+  if (slack > (uintptr_t) -1)
+    slack = (uintptr_t) -1;
+
+  handle->u.reserved[0] = (void*) (uintptr_t) slack;
+}
+
+
+uint64_t uv_timer_get_slack(const uv_timer_t* handle) {
+  return timer_slack(handle);
+}
+
+
 uint64_t uv_timer_get_due_in(const uv_timer_t* handle) {
   if (handle->loop->time >= handle->timeout)
     return 0;
@@ -140,19 +699,32 @@ uint64_t uv_timer_get_due_in(const uv_timer_t* handle) {
 
 
 int uv__next_timeout(const uv_loop_t* loop) {
-  const struct heap_node* heap_node;
   const uv_timer_t* handle;
+  struct uv__timer_wheel* tw;
+  uint64_t timeout;
   uint64_t diff;
 
-  heap_node = heap_min(timer_heap(loop));
-  if (heap_node == NULL)
+  timeout = (uint64_t) -1;
+
+  handle = timer_heap_min(timer_heap(loop));
+  if (handle != NULL) {
+    timeout = handle->timeout;
+    if (timeout > loop->time) {
+      timeout = (uint64_t) -1;
+      timer_min_deadline(timer_heap(loop), 0, &timeout);
+    }
+  }
+
+  tw = timer_wheel(loop);
+  if (tw != NULL && timer_wheel_next(tw, &diff) && diff < timeout)
+    timeout = diff;
+  else if (handle == NULL)
     return -1; /* block indefinitely */
 
-  handle = container_of(heap_node, uv_timer_t, heap_node);
-  if (handle->timeout <= loop->time)
+  if (timeout <= loop->time)
     return 0;
 
-  diff = handle->timeout - loop->time;
+  diff = timeout - loop->time;
   if (diff > INT_MAX)
     diff = INT_MAX;
 
@@ -160,22 +732,66 @@ int uv__next_timeout(const uv_loop_t* loop) {
 }
 
 
+/* |timeout| is in loop time, which runs on the same clock as uv_hrtime(). */
+static void timer_record_lag(uv_loop_t* loop, uint64_t timeout) {
+  uint64_t now;
+  uint64_t due;
+
+  now = uv_hrtime();
+  due = timeout * 1000000;
+  uv__metrics_record_lag(&uv__get_loop_metrics(loop)->lag.timers,
+                         now > due ? now - due : 0);
+}
+
+
 void uv__run_timers(uv_loop_t* loop) {
-  struct heap_node* heap_node;
+  struct uv__timer_wheel* tw;
   uv_timer_t* handle;
+  uv_timer_t* due;
+  uv_timer_cb cb;
+  uint64_t start;
+
+  tw = timer_wheel(loop);
+  if (tw != NULL)
+    timer_wheel_advance(tw, loop->time);
 
   for (;;) {
-    heap_node = heap_min(timer_heap(loop));
-    if (heap_node == NULL)
+    handle = timer_heap_min(timer_heap(loop));
+    if (handle != NULL && handle->timeout > loop->time)
+      handle = NULL;
+
+    /* Expired wheel timers are already in deadline order, merge them with
+     * the heap so that timers still run in the order they were scheduled.
+     */
+    if (tw != NULL && !QUEUE_EMPTY(&tw->due)) {
+      due = QUEUE_DATA(QUEUE_HEAD(&tw->due), uv_timer_t, heap_node);
+      if (handle == NULL || timer_less_than(due, handle))
+        handle = due;
+    }
+
+    if (handle == NULL)
       break;
 
-    handle = container_of(heap_node, uv_timer_t, heap_node);
-    if (handle->timeout > loop->time)
-      break;
+    if (uv__metrics_lag_enabled(loop))
+      timer_record_lag(loop, handle->timeout);
 
     uv_timer_stop(handle);
     uv_timer_again(handle);
-    handle->timer_cb(handle);
+    UV__TRACE1(timer__fire, handle);
+
+    if (!uv__callbacks_timed(loop)) {
+      handle->timer_cb(handle);
+      continue;
+    }
+
+    cb = handle->timer_cb;
+    start = uv_hrtime();
+    cb(handle);
+    uv__callback_done(loop,
+                      (uv_handle_t*) handle,
+                      UV_TIMER,
+                      (void (*)(void)) cb,
+                      start);
   }
 }
 
@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_LOOP
+
 #include "uv.h"
 #include "internal.h"
 
@@ -149,7 +151,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int user_timeout;
   int reset_timeout;
 
-  if (loop->nfds == 0) {
+  if (loop->nfds == 0 && timeout == 0) {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
     return;
   }
@@ -242,6 +244,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
      * operating system didn't reschedule our process while in the syscall.
      */
     SAVE_ERRNO(uv__update_time(loop));
+    uv__metrics_poll(loop, nfds, ARRAY_SIZE(events));
 
     if (nfds == 0) {
       if (reset_timeout != 0) {
@@ -281,8 +284,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     nevents = 0;
 
     assert(loop->watchers != NULL);
-    loop->watchers[loop->nwatchers] = (void*) events;
-    loop->watchers[loop->nwatchers + 1] = (void*) (uintptr_t) nfds;
+    uv__fd_map_events(loop) = (void*) events;
+    uv__fd_map_nevents(loop) = (void*) (uintptr_t) nfds;
 
     for (i = 0; i < nfds; i++) {
       pe = events + i;
@@ -296,7 +299,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       assert(pc.fd >= 0);
       assert((unsigned) pc.fd < loop->nwatchers);
 
-      w = loop->watchers[pc.fd];
+      w = uv__fd_watcher(loop, pc.fd);
 
       if (w == NULL) {
         /* File descriptor that we've stopped watching, disarm it.
@@ -315,12 +318,14 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         have_signals = 1;
       } else {
         uv__metrics_update_idle_time(loop);
-        w->cb(loop, w, pe->revents);
+        uv__io_dispatch(loop, w, pe->revents);
       }
 
       nevents++;
     }
 
+    uv__metrics_inc_events(loop, nevents);
+
     if (reset_timeout != 0) {
       timeout = user_timeout;
       reset_timeout = 0;
@@ -328,11 +333,11 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
 
     if (have_signals != 0) {
       uv__metrics_update_idle_time(loop);
-      loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
+      uv__io_dispatch(loop, &loop->signal_io_watcher, POLLIN);
     }
 
-    loop->watchers[loop->nwatchers] = NULL;
-    loop->watchers[loop->nwatchers + 1] = NULL;
+    uv__fd_map_events(loop) = NULL;
+    uv__fd_map_nevents(loop) = NULL;
 
     if (have_signals != 0)
       return;  /* Event loop should cycle now so don't poll again. */
@@ -757,6 +762,7 @@ static void uv__ahafs_event(uv_loop_t* loop, uv__io_t* event_watch, unsigned int
 int uv_fs_event_init(uv_loop_t* loop, uv_fs_event_t* handle) {
 #ifdef HAVE_SYS_AHAFS_EVPRODS_H
   uv__handle_init(loop, (uv_handle_t*)handle, UV_FS_EVENT);
+  handle->u.reserved[0] = NULL;
   return 0;
 #else
   return UV_ENOSYS;
@@ -840,6 +846,7 @@ int uv_fs_event_stop(uv_fs_event_t* handle) {
   if (!uv__is_active(handle))
     return 0;
 
+  uv__fs_event_batch_stop(handle);
   uv__io_close(handle->loop, &handle->event_watcher);
   uv__handle_stop(handle);
 
@@ -1286,8 +1293,8 @@ void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
   assert(loop->watchers != NULL);
   assert(fd >= 0);
 
-  events = (struct pollfd*) loop->watchers[loop->nwatchers];
-  nfds = (uintptr_t) loop->watchers[loop->nwatchers + 1];
+  events = (struct pollfd*) uv__fd_map_events(loop);
+  nfds = (uintptr_t) uv__fd_map_nevents(loop);
 
   if (events != NULL)
     /* Invalidate events with same file descriptor */
@@ -20,6 +20,12 @@
 
 /* This file contains both the uv__async internal infrastructure and the
  * user-facing uv_async_t functions.
+ *
+ * uv_async_send() pushes the handle onto a lock-free stack in the loop's
+ * internal fields, linked through handle->u.reserved[0]. The loop thread
+ * moves the stack over to loop->async_handles, which only holds handles
+ * that are pending and is only touched by the loop thread, so a wakeup
+ * costs O(signalled handles) rather than O(all handles).
  */
 
 #include "uv.h"
@@ -40,6 +46,72 @@
 
 static void uv__async_send(uv_loop_t* loop);
 static int uv__async_start(uv_loop_t* loop);
+static void uv__async_process(uv_loop_t* loop);
+
+/* Without a write end, the watcher is the eventfd on Linux and holds the
+ * place of the EVFILT_USER event on kqueue platforms that support it.
+ */
+#if defined(UV__KQUEUE_EVFILT_USER)
+#define uv__async_evfilt_user(loop) ((loop)->async_wfd == -1)
+#else
+#define uv__async_evfilt_user(loop) 0
+#endif
+
+
+static void** uv__async_pending(uv_loop_t* loop) {
+  return &uv__get_internal_fields(loop)->async_pending;
+}
+
+
+/* Push |handle| onto the pending stack. Returns 1 if the stack was empty. */
+static int uv__async_push(uv_async_t* handle) {
+  void** head;
+  void* prev;
+  void* old;
+
+  head = uv__async_pending(handle->loop);
+  old = *(void* volatile*) head;
+  for (;;) {
+    handle->u.reserved[0] = old;
+    prev = cmpxchgp(head, old, handle);
+    if (prev == old)
+      return old == NULL;
+    old = prev;
+  }
+}
+
+
+/* Only call this from the event loop thread. Moves the pending stack over
+ * to loop->async_handles, oldest first.
+ */
+static void uv__async_take(uv_loop_t* loop) {
+  void** head;
+  void* prev;
+  void* old;
+  uv_async_t* h;
+  uv_async_t* next;
+  uv_async_t* list;
+
+  head = uv__async_pending(loop);
+  old = *(void* volatile*) head;
+  while (old != NULL) {
+    prev = cmpxchgp(head, old, NULL);
+    if (prev == old)
+      break;
+    old = prev;
+  }
+
+  /* Reverse, the stack is newest first. */
+  list = NULL;
+  for (h = old; h != NULL; h = next) {
+    next = h->u.reserved[0];
+    h->u.reserved[0] = list;
+    list = h;
+  }
+
+  for (h = list; h != NULL; h = h->u.reserved[0])
+    QUEUE_INSERT_TAIL(&loop->async_handles, &h->queue);
+}
 
 
 int uv_async_init(uv_loop_t* loop, uv_async_t* handle, uv_async_cb async_cb) {
@@ -52,8 +124,9 @@ int uv_async_init(uv_loop_t* loop, uv_async_t* handle, uv_async_cb async_cb) {
   uv__handle_init(loop, (uv_handle_t*)handle, UV_ASYNC);
   handle->async_cb = async_cb;
   handle->pending = 0;
+  handle->u.reserved[0] = NULL;
 
-  QUEUE_INSERT_TAIL(&loop->async_handles, &handle->queue);
+  QUEUE_INIT(&handle->queue);
   uv__handle_start(handle);
 
   return 0;
@@ -69,8 +142,17 @@ int uv_async_send(uv_async_t* handle) {
   if (cmpxchgi(&handle->pending, 0, 1) != 0)
     return 0;
 
-  /* Wake up the other thread's event loop. */
-  uv__async_send(handle->loop);
+  /* Wake up the other thread's event loop, unless another handle that is
+   * waiting to be processed already did or the loop is running callbacks and
+   * looks at the stack before it polls again. A handle that is being closed
+   * mustn't go back on the stack, uv__async_close() already took it off
+   * and its loop may be gone by now.
+   */
+  if (!(ACCESS_ONCE(unsigned int, handle->flags) & UV_HANDLE_CLOSING))
+    if (uv__async_push(handle))
+      if (ACCESS_ONCE(int, uv__get_internal_fields(handle->loop)->async_awake)
+          == 0)
+        uv__async_send(handle->loop);
 
   /* Tell the other thread we're done. */
   if (cmpxchgi(&handle->pending, 1, 2) != 1)
@@ -80,6 +162,51 @@ int uv_async_send(uv_async_t* handle) {
 }
 
 
+static int uv__async_has_pending(uv_loop_t* loop) {
+  return ACCESS_ONCE(void*, *uv__async_pending(loop)) != NULL;
+}
+
+
+/* The loop thread calls these from uv_run(). While the loop is awake,
+ * uv_async_send() pushes handles without waking it. Whenever the loop stops
+ * being awake it looks at the stack again, after a full barrier, so either
+ * it sees the handle or the sender sees it has to wake the loop up.
+ */
+void uv__async_run_start(uv_loop_t* loop) {
+  uv__get_internal_fields(loop)->async_awake = 1;
+}
+
+
+void uv__async_run_stop(uv_loop_t* loop) {
+  /* Handles pushed without a wakeup would wait for the next uv_run(). Make
+   * the backend fd readable for embedders that poll it in the meantime.
+   */
+  cmpxchgi(&uv__get_internal_fields(loop)->async_awake, 1, 0);
+  if (uv__async_has_pending(loop))
+    uv__async_send(loop);
+}
+
+
+int uv__async_poll_start(uv_loop_t* loop, int timeout) {
+  cmpxchgi(&uv__get_internal_fields(loop)->async_awake, 1, 0);
+  if (uv__async_has_pending(loop))
+    return 0;
+
+  return timeout;
+}
+
+
+void uv__async_poll_stop(uv_loop_t* loop) {
+  uv__get_internal_fields(loop)->async_awake = 1;
+  if (!uv__async_has_pending(loop))
+    return;
+
+  /* Counts like the wakeup it replaces. */
+  uv__metrics_inc_events(loop, 1);
+  uv__async_process(loop);
+}
+
+
 /* Only call this from the event loop thread. */
 static int uv__async_spin(uv_async_t* handle) {
   int i;
@@ -113,8 +240,14 @@ static int uv__async_spin(uv_async_t* handle) {
 
 
 void uv__async_close(uv_async_t* handle) {
-  uv__async_spin(handle);
+  /* A pending handle is on the stack or in loop->async_handles. Empty the
+   * stack so it can be unlinked. The other handles stay pending.
+   */
+  if (uv__async_spin(handle) != 0)
+    uv__async_take(handle->loop);
+
   QUEUE_REMOVE(&handle->queue);
+  QUEUE_INIT(&handle->queue);
   uv__handle_stop(handle);
 }
 
@@ -122,12 +255,13 @@ void uv__async_close(uv_async_t* handle) {
 static void uv__async_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
   char buf[1024];
   ssize_t r;
-  QUEUE queue;
-  QUEUE* q;
-  uv_async_t* h;
 
   assert(w == &loop->async_io_watcher);
 
+  /* EVFILT_USER is EV_CLEAR, there's nothing to drain. */
+  if (uv__async_evfilt_user(loop))
+    goto take;
+
   for (;;) {
     r = read(w->fd, buf, sizeof(buf));
 
@@ -146,13 +280,28 @@ static void uv__async_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
     abort();
   }
 
+take:
+  uv__async_process(loop);
+}
+
+
+static void uv__async_process(uv_loop_t* loop) {
+  QUEUE queue;
+  QUEUE* q;
+  uv_async_t* h;
+
+  uv__async_take(loop);
+
+  /* Handles that are signalled from the callbacks go on the stack and are
+   * processed on the next wakeup.
+   */
   QUEUE_MOVE(&loop->async_handles, &queue);
   while (!QUEUE_EMPTY(&queue)) {
     q = QUEUE_HEAD(&queue);
     h = QUEUE_DATA(q, uv_async_t, queue);
 
     QUEUE_REMOVE(q);
-    QUEUE_INSERT_TAIL(&loop->async_handles, q);
+    QUEUE_INIT(q);
 
     if (0 == uv__async_spin(h))
       continue;  /* Not pending. */
@@ -166,11 +315,29 @@ static void uv__async_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
 
 
 static void uv__async_send(uv_loop_t* loop) {
+#if defined(UV__KQUEUE_EVFILT_USER)
+  struct kevent ev;
+#endif
   const void* buf;
   ssize_t len;
   int fd;
   int r;
 
+#if defined(UV__KQUEUE_EVFILT_USER)
+  if (uv__async_evfilt_user(loop)) {
+    EV_SET(&ev, loop->async_io_watcher.fd, EVFILT_USER, 0, NOTE_TRIGGER, 0, 0);
+
+    do
+      r = kevent(loop->backend_fd, &ev, 1, NULL, 0, NULL);
+    while (r == -1 && errno == EINTR);
+
+    if (r == 0)
+      return;
+
+    abort();
+  }
+#endif
+
   buf = "";
   len = 1;
   fd = loop->async_wfd;
@@ -199,6 +366,34 @@ static void uv__async_send(uv_loop_t* loop) {
 }
 
 
+#if defined(UV__KQUEUE_EVFILT_USER)
+/* Sets up the EVFILT_USER event uv_async_send() triggers. The fd it returns
+ * is never read or written, it only holds a place among the loop's watchers
+ * and names the event. Returns a negative value on kernels that don't
+ * support EVFILT_USER after all.
+ */
+static int uv__async_evfilt_user_start(uv_loop_t* loop) {
+  struct kevent ev;
+  int fd;
+
+  fd = uv__open_cloexec("/dev/null", O_RDONLY);
+  if (fd < 0)
+    return fd;
+
+  /* Added right away, the first uv_async_send() may come before the next
+   * uv__io_poll().
+   */
+  EV_SET(&ev, fd, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, 0);
+  if (kevent(loop->backend_fd, &ev, 1, NULL, 0, NULL)) {
+    uv__close(fd);
+    return UV__ERR(errno);
+  }
+
+  return fd;
+}
+#endif
+
+
 static int uv__async_start(uv_loop_t* loop) {
   int pipefd[2];
   int err;
@@ -214,9 +409,16 @@ static int uv__async_start(uv_loop_t* loop) {
   pipefd[0] = err;
   pipefd[1] = -1;
 #else
-  err = uv__make_pipe(pipefd, UV_NONBLOCK_PIPE);
-  if (err < 0)
-    return err;
+  pipefd[0] = -1;
+  pipefd[1] = -1;
+#if defined(UV__KQUEUE_EVFILT_USER)
+  pipefd[0] = uv__async_evfilt_user_start(loop);
+#endif
+  if (pipefd[0] < 0) {
+    err = uv__make_pipe(pipefd, UV_NONBLOCK_PIPE);
+    if (err < 0)
+      return err;
+  }
 #endif
 
   uv__io_init(&loop->async_io_watcher, uv__async_io, pipefd[0]);
@@ -228,19 +430,44 @@ static int uv__async_start(uv_loop_t* loop) {
 
 
 int uv__async_fork(uv_loop_t* loop) {
+  int err;
+
   if (loop->async_io_watcher.fd == -1) /* never started */
     return 0;
 
   uv__async_stop(loop);
 
-  return uv__async_start(loop);
+  err = uv__async_start(loop);
+  if (err)
+    return err;
+
+  /* The wakeups of handles that were pending went with the old fd. */
+  uv__async_take(loop);
+  if (!QUEUE_EMPTY(&loop->async_handles))
+    uv__async_send(loop);
+
+  return 0;
 }
 
 
 void uv__async_stop(uv_loop_t* loop) {
+#if defined(UV__KQUEUE_EVFILT_USER)
+  struct kevent ev;
+#endif
+
   if (loop->async_io_watcher.fd == -1)
     return;
 
+#if defined(UV__KQUEUE_EVFILT_USER)
+  /* Not tied to the fd, it has to go by itself. After a fork the kqueue it
+   * was added to is gone already.
+   */
+  if (uv__async_evfilt_user(loop)) {
+    EV_SET(&ev, loop->async_io_watcher.fd, EVFILT_USER, EV_DELETE, 0, 0, 0);
+    kevent(loop->backend_fd, &ev, 1, NULL, 0, NULL);
+  }
+#endif
+
   if (loop->async_wfd != -1) {
     if (loop->async_wfd != loop->async_io_watcher.fd)
       uv__close(loop->async_wfd);
@@ -18,6 +18,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_LOOP
+
 #include "uv.h"
 #include "internal.h"
 
@@ -42,6 +44,7 @@
 #include <pwd.h>
 #include <sys/utsname.h>
 #include <sys/time.h>
+#include <sys/mman.h>  /* mmap() */
 
 #ifdef __sun
 # include <sys/filio.h>
@@ -84,6 +87,8 @@ extern char** environ;
 #endif
 
 #if defined(__linux__)
+# include <linux/filter.h>
+# include <linux/net_tstamp.h>
 # include <sys/syscall.h>
 # define uv__accept4 accept4
 #endif
@@ -114,6 +119,7 @@ void uv_close(uv_handle_t* handle, uv_close_cb close_cb) {
 
   handle->flags |= UV_HANDLE_CLOSING;
   handle->close_cb = close_cb;
+  uv__handle_count_closing(handle);
 
   switch (handle->type) {
   case UV_NAMED_PIPE:
@@ -158,6 +164,7 @@ void uv_close(uv_handle_t* handle, uv_close_cb close_cb) {
 
   case UV_FS_EVENT:
     uv__fs_event_close((uv_fs_event_t*)handle);
+    uv__fs_event_state_free((uv_fs_event_t*)handle);
     break;
 
   case UV_POLL:
@@ -174,6 +181,10 @@ void uv_close(uv_handle_t* handle, uv_close_cb close_cb) {
     uv__signal_close((uv_signal_t*) handle);
     break;
 
+  case UV_NETIF:
+    uv__netif_close((uv_netif_t*) handle);
+    break;
+
   default:
     assert(0);
   }
@@ -181,6 +192,96 @@ void uv_close(uv_handle_t* handle, uv_close_cb close_cb) {
   uv__make_close_pending(handle);
 }
 
+
+static int uv__fd_cmp(const void* a, const void* b) {
+  return *(const int*) a - *(const int*) b;
+}
+
+
+/* Close the file descriptors that uv_close_many() collected. Runs of
+ * consecutive descriptors, common for the sockets of a busy server, go in
+ * a single close_range() call where the kernel has it.
+ */
+static void uv__close_fds(int* fds, unsigned int nfds) {
+#if defined(__linux__) && !defined(__SANITIZE_THREAD__)
+  static int no_close_range;
+#endif
+  unsigned int i;
+  unsigned int j;
+
+  qsort(fds, nfds, sizeof(*fds), uv__fd_cmp);
+
+  for (i = 0; i < nfds; i = j) {
+    for (j = i + 1; j < nfds; j++)
+      if (fds[j] != fds[j - 1] + 1)
+        break;
+
+#if defined(__linux__) && !defined(__SANITIZE_THREAD__)
+    if (j - i > 1 && !uv__load_relaxed(&no_close_range)) {
+      if (uv__close_range(fds[i], fds[j - 1], 0) == 0)
+        continue;
+      /* ENOSYS before Linux 5.9, EPERM when a seccomp filter blocks it. */
+      uv__store_relaxed(&no_close_range, 1);
+    }
+#endif
+
+    for (; i < j; i++)
+      uv__close(fds[i]);
+  }
+}
+
+
+/* Close fd now, or at the end of the uv_close_many() call that is running. */
+void uv__close_batched(uv_loop_t* loop, int fd) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->close_batch_count < lfields->close_batch_size)
+    lfields->close_batch[lfields->close_batch_count++] = fd;
+  else
+    uv__close(fd);
+}
+
+
+void uv_close_many(uv_handle_t* handles[],
+                   unsigned int nhandles,
+                   uv_close_cb close_cb) {
+  uv__loop_internal_fields_t* lfields;
+  unsigned int i;
+  int* fds;
+
+  if (nhandles == 0)
+    return;
+
+  /* Without memory for the batch the handles just get closed one by one. */
+  lfields = uv__get_internal_fields(handles[0]->loop);
+  fds = NULL;
+  if (nhandles > 1 && lfields->close_batch == NULL)
+    fds = uv__malloc(nhandles * sizeof(*fds));
+
+  if (fds != NULL) {
+    lfields->close_batch = fds;
+    lfields->close_batch_count = 0;
+    lfields->close_batch_size = nhandles;
+  }
+
+  for (i = 0; i < nhandles; i++) {
+    assert(handles[i]->loop == handles[0]->loop);
+    uv_close(handles[i], close_cb);
+  }
+
+  if (fds == NULL)
+    return;
+
+  /* The watchers are gone already, uv__io_close() ran for every handle. */
+  uv__close_fds(fds, lfields->close_batch_count);
+  lfields->close_batch = NULL;
+  lfields->close_batch_count = 0;
+  lfields->close_batch_size = 0;
+  uv__free(fds);
+}
+
+
 int uv__socket_sockopt(uv_handle_t* handle, int optname, int* value) {
   int r;
   int fd;
@@ -209,6 +310,374 @@ int uv__socket_sockopt(uv_handle_t* handle, int optname, int* value) {
   return 0;
 }
 
+
+int uv_pacing_rate(uv_handle_t* handle, uint64_t* value) {
+#if defined(SO_MAX_PACING_RATE)
+  uint32_t rate32;
+  uint64_t rate;
+  socklen_t len;
+  int fd;
+
+  if (handle == NULL || value == NULL)
+    return UV_EINVAL;
+
+  if (handle->type == UV_TCP)
+    fd = uv__stream_fd((uv_stream_t*) handle);
+  else if (handle->type == UV_UDP)
+    fd = ((uv_udp_t*) handle)->io_watcher.fd;
+  else
+    return UV_ENOTSUP;
+
+  if (fd == -1)
+    return UV_EBADF;
+
+  if (*value == 0) {
+    /* Kernels before 4.20 only know about 32-bit rates. */
+    rate = 0;
+    len = sizeof(rate);
+    if (getsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, &len))
+      return UV__ERR(errno);
+    if (len == sizeof(rate32)) {
+      memcpy(&rate32, &rate, sizeof(rate32));
+      rate = rate32 == (uint32_t) -1 ? (uint64_t) -1 : rate32;
+    }
+    *value = rate;
+    return 0;
+  }
+
+  if (*value < (uint32_t) -1) {
+    rate32 = *value;
+    if (setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate32, sizeof(rate32)))
+      return UV__ERR(errno);
+  } else {
+    rate = *value;
+    if (setsockopt(fd, SOL_SOCKET, SO_MAX_PACING_RATE, &rate, sizeof(rate)))
+      return UV__ERR(errno);
+  }
+
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
+int uv_handle_detach(uv_handle_t* handle) {
+  uv__handle_counts_t* counts;
+  int err;
+
+  if (handle == NULL || handle->loop == NULL || uv__is_closing(handle))
+    return UV_EINVAL;
+
+  switch (handle->type) {
+    case UV_NAMED_PIPE:
+    case UV_TCP:
+      err = uv__stream_detach((uv_stream_t*) handle);
+      break;
+    case UV_UDP:
+      err = uv__udp_detach((uv_udp_t*) handle);
+      break;
+    default:
+      return UV_ENOTSUP;
+  }
+
+  if (err)
+    return err;
+
+  /* Stays active, it's counted on the loop it's attached to next. */
+  counts = uv__get_handle_counts(handle->loop);
+  if (uv__is_active(handle)) {
+    counts->active[handle->type]--;
+    if (uv__has_ref(handle))
+      uv__active_handle_rm(handle);
+  }
+
+  counts->handles[handle->type]--;
+  QUEUE_REMOVE(&handle->handle_queue);
+  handle->loop = NULL;
+
+  return 0;
+}
+
+
+/* The watcher behind a TCP, pipe, TTY, UDP or poll handle. */
+static uv__io_t* uv__handle_io_watcher(uv_handle_t* handle) {
+  switch (handle->type) {
+    case UV_NAMED_PIPE:
+    case UV_TCP:
+    case UV_TTY:
+      return &((uv_stream_t*) handle)->io_watcher;
+    case UV_UDP:
+      return &((uv_udp_t*) handle)->io_watcher;
+    case UV_POLL:
+      return &((uv_poll_t*) handle)->io_watcher;
+    default:
+      return NULL;
+  }
+}
+
+
+int uv_handle_attach(uv_handle_t* handle, uv_loop_t* loop) {
+  uv__handle_counts_t* counts;
+  uv__io_t* w;
+  int err;
+
+  if (handle == NULL || loop == NULL || handle->loop != NULL)
+    return UV_EINVAL;
+
+  if (handle->type != UV_NAMED_PIPE &&
+      handle->type != UV_TCP &&
+      handle->type != UV_UDP)
+    return UV_EINVAL;
+
+  /* Restore the priority uv__io_detach() saved first, it can fail. */
+  w = uv__handle_io_watcher(handle);
+  if (w->events != UV_IO_PRIORITY_NORMAL) {
+    err = uv__io_set_priority(loop, w->fd, w->events);
+    if (err)
+      return err;
+    w->events = 0;
+  }
+
+  handle->loop = loop;
+  QUEUE_INSERT_TAIL(&loop->handle_queue, &handle->handle_queue);
+
+  counts = uv__get_handle_counts(loop);
+  counts->handles[handle->type]++;
+  if (uv__is_active(handle)) {
+    counts->active[handle->type]++;
+    if (uv__has_ref(handle))
+      uv__active_handle_add(handle);
+  }
+
+  if (handle->type == UV_UDP)
+    uv__udp_attach((uv_udp_t*) handle);
+  else
+    uv__stream_attach((uv_stream_t*) handle);
+
+  return 0;
+}
+
+
+int uv_handle_set_io_priority(uv_handle_t* handle,
+                              uv_io_priority priority) {
+  uv__io_t* w;
+
+  if (handle == NULL || uv__is_closing(handle))
+    return UV_EINVAL;
+
+  switch (priority) {
+    case UV_IO_PRIORITY_NORMAL:
+    case UV_IO_PRIORITY_HIGH:
+    case UV_IO_PRIORITY_LOW:
+      break;
+    default:
+      return UV_EINVAL;
+  }
+
+  w = uv__handle_io_watcher(handle);
+  if (w == NULL)
+    return UV_ENOTSUP;
+
+  if (w->fd < 0)
+    return UV_EBADF;
+
+  return uv__io_set_priority(handle->loop, w->fd, priority);
+}
+
+
+int uv_handle_set_io_stats(uv_handle_t* handle, int enable) {
+  if (handle == NULL || uv__is_closing(handle))
+    return UV_EINVAL;
+
+  switch (handle->type) {
+    case UV_NAMED_PIPE:
+    case UV_TCP:
+    case UV_TTY:
+      return uv__stream_set_io_stats((uv_stream_t*) handle, enable);
+    case UV_UDP:
+      return uv__udp_set_io_stats((uv_udp_t*) handle, enable);
+    default:
+      return UV_ENOTSUP;
+  }
+}
+
+
+int uv_handle_get_io_stats(const uv_handle_t* handle, uv_io_stats_t* stats) {
+  const uv_io_stats_t* s;
+
+  if (handle == NULL || stats == NULL)
+    return UV_EINVAL;
+
+  switch (handle->type) {
+    case UV_NAMED_PIPE:
+    case UV_TCP:
+    case UV_TTY:
+      s = uv__stream_io_stats((const uv_stream_t*) handle);
+      break;
+    case UV_UDP:
+      s = uv__udp_io_stats((const uv_udp_t*) handle);
+      break;
+    default:
+      return UV_ENOTSUP;
+  }
+
+  if (s == NULL)
+    return UV_EINVAL;  /* Not enabled. */
+
+  *stats = *s;
+  return 0;
+}
+
+
+int uv__reuseport_steer_by_cpu(int fd) {
+#if defined(__linux__) && defined(SO_ATTACH_REUSEPORT_CBPF) && \
+    defined(SKF_AD_CPU)
+  /* Return the number of the CPU that took the packet. The kernel uses it
+   * as an index into the SO_REUSEPORT group and falls back to hashing when
+   * it's out of range.
+   */
+  struct sock_filter code[] = {
+    { BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+    { BPF_RET | BPF_A, 0, 0, 0 }
+  };
+  struct sock_fprog prog;
+
+  if (fd == -1)
+    return UV_EBADF;
+
+  prog.len = ARRAY_SIZE(code);
+  prog.filter = code;
+  if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)))
+    return UV__ERR(errno);
+
+  return 0;
+#else
+  return UV_ENOSYS;
+#endif
+}
+
+
+int uv__busy_poll(uv_loop_t* loop, int fd, unsigned int usec) {
+#if defined(__linux__) && defined(SO_BUSY_POLL)
+#if defined(SO_PREFER_BUSY_POLL)
+  int prefer;
+#endif
+  int val;
+
+  if (fd == -1)
+    return UV_EBADF;
+
+  if (usec > INT_MAX)
+    return UV_EINVAL;
+
+  /* Raising it above net.core.busy_read takes CAP_NET_ADMIN. */
+  val = usec;
+  if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)))
+    return UV__ERR(errno);
+
+#if defined(SO_PREFER_BUSY_POLL)
+  /* Best effort, it's Linux 5.11+. */
+  prefer = usec != 0;
+  if (setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)))
+    prefer = 0;
+
+  if (prefer)
+    uv__epoll_prefer_busy_poll(loop);
+#endif  /* defined(SO_PREFER_BUSY_POLL) */
+
+  return 0;
+#else
+  return UV_ENOSYS;
+#endif
+}
+
+
+/* Asks for the time the datagrams or stream data came in, as a control
+ * message that uv__rx_timestamp() picks up.
+ */
+int uv__rx_timestamps(int fd, int enable) {
+#if defined(__linux__) && defined(SO_TIMESTAMPING) && defined(SO_TIMESTAMPNS)
+  int flags;
+  int on;
+
+  if (fd == -1)
+    return UV_EBADF;
+
+  /* The NIC's time where it has hardware timestamps switched on, with
+   * SIOCSHWTSTAMP, the time the kernel took the packet in otherwise.
+   */
+  flags = 0;
+  if (enable)
+    flags = SOF_TIMESTAMPING_RX_HARDWARE |
+            SOF_TIMESTAMPING_RAW_HARDWARE |
+            SOF_TIMESTAMPING_RX_SOFTWARE |
+            SOF_TIMESTAMPING_SOFTWARE;
+
+  /* Kernels that don't do SO_TIMESTAMPING for the socket still have the
+   * software timestamp, SO_TIMESTAMPNS.
+   */
+  setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags));
+
+  /* SO_TIMESTAMPNS goes on next to SO_TIMESTAMPING too. The kernel switches
+   * timestamps on from a work queue, and only SO_TIMESTAMPNS gets datagrams
+   * that came in before that a timestamp.
+   */
+  on = !!enable;
+  if (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)))
+    return UV__ERR(errno);
+
+  return 0;
+#else
+  return UV_ENOSYS;
+#endif
+}
+
+
+/* Returns 0 and the receive timestamp that came with `h`, or UV_ENOENT.
+ * A hardware timestamp wins over the software one.
+ */
+int uv__rx_timestamp(struct msghdr* h, uv_timespec_t* ts) {
+#if defined(__linux__) && defined(SO_TIMESTAMPING) && defined(SO_TIMESTAMPNS)
+  struct timespec t[3];
+  struct cmsghdr* cmsg;
+  int found;
+
+  found = 0;
+  for (cmsg = CMSG_FIRSTHDR(h); cmsg != NULL; cmsg = CMSG_NXTHDR(h, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET)
+      continue;
+
+    if (cmsg->cmsg_type == SCM_TIMESTAMPING) {
+      /* The software timestamp comes first, the raw hardware one last. */
+      memcpy(t, CMSG_DATA(cmsg), sizeof(t));
+      if (t[2].tv_sec != 0 || t[2].tv_nsec != 0) {
+        ts->tv_sec = t[2].tv_sec;
+        ts->tv_nsec = t[2].tv_nsec;
+        return 0;
+      }
+    } else if (cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+      memcpy(t, CMSG_DATA(cmsg), sizeof(t[0]));
+    } else {
+      continue;
+    }
+
+    /* Zero when it wasn't generated for this one. */
+    if (t[0].tv_sec != 0 || t[0].tv_nsec != 0) {
+      ts->tv_sec = t[0].tv_sec;
+      ts->tv_nsec = t[0].tv_nsec;
+      found = 1;
+    }
+  }
+
+  if (found)
+    return 0;
+#endif
+
+  return UV_ENOENT;
+}
+
+
 void uv__make_close_pending(uv_handle_t* handle) {
   assert(handle->flags & UV_HANDLE_CLOSING);
   assert(!(handle->flags & UV_HANDLE_CLOSED));
@@ -245,7 +714,12 @@ int uv__getiovmax(void) {
 
 
 static void uv__finish_close(uv_handle_t* handle) {
+  uv_close_cb close_cb;
+  uv_handle_type type;
   uv_signal_t* sh;
+  uv_loop_t* loop;
+  uint64_t start;
+  int pooled;
 
   /* Note: while the handle is in the UV_HANDLE_CLOSING state now, it's still
    * possible for it to be active in the sense that uv__is_active() returns
@@ -269,6 +743,7 @@ static void uv__finish_close(uv_handle_t* handle) {
     case UV_FS_EVENT:
     case UV_FS_POLL:
     case UV_POLL:
+    case UV_NETIF:
       break;
 
     case UV_SIGNAL:
@@ -301,11 +776,29 @@ static void uv__finish_close(uv_handle_t* handle) {
   }
 
   uv__handle_unref(handle);
-  QUEUE_REMOVE(&handle->handle_queue);
+  uv__handle_remove(handle);
+
+  /* Read before the close callback, which can free handles that aren't
+   * pooled.
+   */
+  pooled = handle->flags & UV_HANDLE_POOLED;
 
   if (handle->close_cb) {
-    handle->close_cb(handle);
+    if (!uv__callbacks_timed(handle->loop)) {
+      handle->close_cb(handle);
+    } else {
+      /* The close callback can free the handle. */
+      loop = handle->loop;
+      type = handle->type;
+      close_cb = handle->close_cb;
+      start = uv_hrtime();
+      close_cb(handle);
+      uv__callback_done(loop, handle, type, (void (*)(void)) close_cb, start);
+    }
   }
+
+  if (pooled)
+    uv__handle_pool_put(handle);
 }
 
 
@@ -338,6 +831,7 @@ static int uv__loop_alive(const uv_loop_t* loop) {
   return uv__has_active_handles(loop) ||
          uv__has_active_reqs(loop) ||
          !QUEUE_EMPTY(&loop->pending_queue) ||
+         uv__has_deferred(loop) ||
          loop->closing_handles != NULL;
 }
 
@@ -348,6 +842,7 @@ static int uv__backend_timeout(const uv_loop_t* loop) {
       (uv__has_active_handles(loop) || uv__has_active_reqs(loop)) &&
       QUEUE_EMPTY(&loop->pending_queue) &&
       QUEUE_EMPTY(&loop->idle_handles) &&
+      !uv__has_deferred(loop) &&
       loop->closing_handles == NULL)
     return uv__next_timeout(loop);
   return 0;
@@ -368,6 +863,8 @@ int uv_loop_alive(const uv_loop_t* loop) {
 
 
 int uv_run(uv_loop_t* loop, uv_run_mode mode) {
+  uint64_t events;
+  uint64_t t;
   int timeout;
   int r;
   int ran_pending;
@@ -376,18 +873,33 @@ int uv_run(uv_loop_t* loop, uv_run_mode mode) {
   if (!r)
     uv__update_time(loop);
 
+  uv__async_run_start(loop);
+
   while (r != 0 && loop->stop_flag == 0) {
+    UV__TRACE1(loop__iteration__start, loop);
+    uv__metrics_inc_loop_count(loop);
     uv__update_time(loop);
+    t = uv__metrics_phase_start(loop);
     uv__run_timers(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_METRICS_PHASE_TIMERS, &t);
     ran_pending = uv__run_pending(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_METRICS_PHASE_PENDING, &t);
     uv__run_idle(loop);
     uv__run_prepare(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_METRICS_PHASE_IDLE_PREPARE, &t);
 
     timeout = 0;
     if ((mode == UV_RUN_ONCE && !ran_pending) || mode == UV_RUN_DEFAULT)
       timeout = uv_backend_timeout(loop);
 
+    events = uv__get_loop_metrics(loop)->events;
+    timeout = uv__async_poll_start(loop, timeout);
+    UV__TRACE2(poll__enter, loop, timeout);
     uv__io_poll(loop, timeout);
+    UV__TRACE2(poll__exit, loop, uv__get_loop_metrics(loop)->events - events);
 
     /* Run one final update on the provider_idle_time in case uv__io_poll
      * returned because the timeout expired, but no events were received. This
@@ -395,9 +907,16 @@ int uv_run(uv_loop_t* loop, uv_run_mode mode) {
      * the timeout == 0) or was already updated b/c an event was received.
      */
     uv__metrics_update_idle_time(loop);
+    uv__async_poll_stop(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_METRICS_PHASE_POLL, &t);
 
     uv__run_check(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_METRICS_PHASE_CHECK, &t);
     uv__run_closing_handles(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_METRICS_PHASE_CLOSING, &t);
 
     if (mode == UV_RUN_ONCE) {
       /* UV_RUN_ONCE implies forward progress: at least one callback must have
@@ -410,13 +929,18 @@ int uv_run(uv_loop_t* loop, uv_run_mode mode) {
        */
       uv__update_time(loop);
       uv__run_timers(loop);
+      uv__run_deferred(loop);
+      uv__metrics_phase(loop, UV_METRICS_PHASE_TIMERS, &t);
     }
 
     r = uv__loop_alive(loop);
+    UV__TRACE1(loop__iteration__end, loop);
     if (mode == UV_RUN_ONCE || mode == UV_RUN_NOWAIT)
       break;
   }
 
+  uv__async_run_stop(loop);
+
   /* The if statement lets gcc compile it to a conditional store. Avoids
    * dirtying a cache line.
    */
@@ -677,6 +1201,17 @@ int uv__cloexec_fcntl(int fd, int set) {
 }
 
 
+/* Like readv(), but with a plain read() when there's only one buffer. Returns
+ * -1 and sets errno on error.
+ */
+ssize_t uv__readv(int fd, const struct iovec* iov, int iovcnt) {
+  if (iovcnt == 1)
+    return read(fd, iov[0].iov_base, iov[0].iov_len);
+
+  return readv(fd, iov, iovcnt);
+}
+
+
 ssize_t uv__recvmsg(int fd, struct msghdr* msg, int flags) {
   struct cmsghdr* cmsg;
   ssize_t rc;
@@ -819,7 +1354,7 @@ static int uv__run_pending(uv_loop_t* loop) {
     QUEUE_REMOVE(q);
     QUEUE_INIT(q);
     w = QUEUE_DATA(q, uv__io_t, pending_queue);
-    w->cb(loop, w, POLLOUT);
+    uv__io_dispatch(loop, w, POLLOUT);
   }
 
   return 1;
@@ -837,38 +1372,127 @@ static unsigned int next_power_of_two(unsigned int val) {
   return val;
 }
 
-static void maybe_resize(uv_loop_t* loop, unsigned int len) {
-  uv__io_t** watchers;
+/* Returns the slot of `fd` in the watcher table, growing the table and
+ * allocating the page when needed. See uv__fd_watcher().
+ */
+static uv__io_t** uv__fd_map_slot(uv_loop_t* loop, int fd) {
+  uv__io_t** page;
+  void** watchers;
   void* fake_watcher_list;
   void* fake_watcher_count;
-  unsigned int nwatchers;
+  unsigned int npages;
+  unsigned int n;
   unsigned int i;
 
-  if (len <= loop->nwatchers)
-    return;
+  npages = loop->nwatchers >> UV__FD_PAGE_SHIFT;
+  n = ((unsigned) fd >> UV__FD_PAGE_SHIFT) + 1;
+
+  if (n > npages) {
+    /* Preserve fake watcher list and count at the end of the table. */
+    if (loop->watchers != NULL) {
+      fake_watcher_list = uv__fd_map_events(loop);
+      fake_watcher_count = uv__fd_map_nevents(loop);
+    } else {
+      fake_watcher_list = NULL;
+      fake_watcher_count = NULL;
+    }
 
-  /* Preserve fake watcher list and count at the end of the watchers */
-  if (loop->watchers != NULL) {
-    fake_watcher_list = loop->watchers[loop->nwatchers];
-    fake_watcher_count = loop->watchers[loop->nwatchers + 1];
-  } else {
-    fake_watcher_list = NULL;
-    fake_watcher_count = NULL;
+    n = next_power_of_two(n + 2) - 2;
+    watchers = uv__reallocf(loop->watchers, (n + 2) * sizeof(watchers[0]));
+    if (watchers == NULL)
+      abort();
+
+    for (i = npages; i < n; i++)
+      watchers[i] = NULL;
+    watchers[n] = fake_watcher_list;
+    watchers[n + 1] = fake_watcher_count;
+
+    loop->watchers = watchers;
+    loop->nwatchers = n << UV__FD_PAGE_SHIFT;
+  }
+
+  page = loop->watchers[(unsigned) fd >> UV__FD_PAGE_SHIFT];
+  if (page == NULL) {
+    page = uv__calloc(UV__FD_PAGE_SIZE, sizeof(page[0]));
+    if (page == NULL)
+      abort();
+    loop->watchers[(unsigned) fd >> UV__FD_PAGE_SHIFT] = page;
+  }
+
+  return page + (fd & (UV__FD_PAGE_SIZE - 1));
+}
+
+
+/* A table without pages, just the two slots of the poll that's being
+ * dispatched. A loop can poll before it watches any file descriptor.
+ */
+int uv__fd_map_init(uv_loop_t* loop) {
+  loop->watchers = uv__calloc(2, sizeof(loop->watchers[0]));
+  if (loop->watchers == NULL)
+    return UV_ENOMEM;
+
+  loop->nwatchers = 0;
+  return 0;
+}
+
+
+void uv__fd_map_delete(uv_loop_t* loop) {
+  unsigned int npages;
+  unsigned int i;
+
+  npages = loop->nwatchers >> UV__FD_PAGE_SHIFT;
+  for (i = 0; i < npages; i++)
+    uv__free(loop->watchers[i]);
+
+  uv__free(loop->watchers);
+  loop->watchers = NULL;
+  loop->nwatchers = 0;
+}
+
+
+void uv__io_dispatch_timed(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
+  uv__loop_metrics_t* metrics;
+  uv_handle_t* handle;
+  uv_stream_t* stream;
+  void (*cb)(void);
+  uint64_t start;
+
+  /* Find the handle and the user callback before running anything, the
+   * callback may stop or close the handle.
+   */
+  handle = NULL;
+  cb = NULL;
+  if (w->cb == uv__stream_io || w->cb == uv__server_io) {
+    stream = container_of(w, uv_stream_t, io_watcher);
+    handle = (uv_handle_t*) stream;
+    if (w->cb == uv__server_io)
+      cb = (void (*)(void)) stream->connection_cb;
+    else
+      cb = (void (*)(void)) stream->read_cb;
+  } else if (w->cb == uv__udp_io) {
+    handle = (uv_handle_t*) container_of(w, uv_udp_t, io_watcher);
+    cb = (void (*)(void)) ((uv_udp_t*) handle)->recv_cb;
+  } else if (w->cb == uv__poll_io) {
+    handle = (uv_handle_t*) container_of(w, uv_poll_t, io_watcher);
+    cb = (void (*)(void)) ((uv_poll_t*) handle)->poll_cb;
   }
 
-  nwatchers = next_power_of_two(len + 2) - 2;
-  watchers = uv__reallocf(loop->watchers,
-                          (nwatchers + 2) * sizeof(loop->watchers[0]));
+  if (cb == NULL)
+    cb = (void (*)(void)) w->cb;
 
-  if (watchers == NULL)
-    abort();
-  for (i = loop->nwatchers; i < nwatchers; i++)
-    watchers[i] = NULL;
-  watchers[nwatchers] = fake_watcher_list;
-  watchers[nwatchers + 1] = fake_watcher_count;
+  start = uv_hrtime();
+  if (uv__metrics_lag_enabled(loop)) {
+    metrics = uv__get_loop_metrics(loop);
+    if (metrics->poll_return != 0 && start > metrics->poll_return)
+      uv__metrics_record_lag(&metrics->lag.io, start - metrics->poll_return);
+  }
 
-  loop->watchers = watchers;
-  loop->nwatchers = nwatchers;
+  w->cb(loop, w, events);
+  uv__callback_done(loop,
+                    handle,
+                    handle != NULL ? handle->type : UV_UNKNOWN_HANDLE,
+                    cb,
+                    start);
 }
 
 
@@ -890,28 +1514,30 @@ void uv__io_init(uv__io_t* w, uv__io_cb cb, int fd) {
 
 
 void uv__io_start(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
+  uv__io_t** slot;
+
   assert(0 == (events & ~(POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI)));
   assert(0 != events);
   assert(w->fd >= 0);
   assert(w->fd < INT_MAX);
 
   w->pevents |= events;
-  maybe_resize(loop, w->fd + 1);
+  slot = uv__fd_map_slot(loop, w->fd);
 
 #if !defined(__sun)
   /* The event ports backend needs to rearm all file descriptors on each and
    * every tick of the event loop but the other backends allow us to
    * short-circuit here if the event mask is unchanged.
    */
-  if (w->events == w->pevents)
+  if ((w->events & ~(UV__POLLET | UV__POLLEXCLUSIVE)) == w->pevents)
     return;
 #endif
 
   if (QUEUE_EMPTY(&w->watcher_queue))
     QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
 
-  if (loop->watchers[w->fd] == NULL) {
-    loop->watchers[w->fd] = w;
+  if (*slot == NULL) {
+    *slot = w;
     loop->nfds++;
   }
 }
@@ -932,14 +1558,20 @@ void uv__io_stop(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
 
   w->pevents &= ~events;
 
+#if defined(__linux__)
+  /* Multishot requests don't expire like polls do. */
+  if ((events & POLLIN) && uv__iou_enabled(loop))
+    uv__iou_stop_multishot(loop, w->fd);
+#endif
+
   if (w->pevents == 0) {
     QUEUE_REMOVE(&w->watcher_queue);
     QUEUE_INIT(&w->watcher_queue);
     w->events = 0;
 
-    if (w == loop->watchers[w->fd]) {
+    if (w == uv__fd_watcher(loop, w->fd)) {
       assert(loop->nfds > 0);
-      loop->watchers[w->fd] = NULL;
+      *uv__fd_map_slot(loop, w->fd) = NULL;
       loop->nfds--;
     }
   }
@@ -953,8 +1585,93 @@ void uv__io_close(uv_loop_t* loop, uv__io_t* w) {
   QUEUE_REMOVE(&w->pending_queue);
 
   /* Remove stale events for this file descriptor */
-  if (w->fd != -1)
+  if (w->fd != -1) {
     uv__platform_invalidate_fd(loop, w->fd);
+    uv__io_reset_priority(loop, w->fd);
+  }
+}
+
+
+/* The priorities are kept by the loop, indexed by file descriptor, so that
+ * uv__io_t doesn't grow. From the first one that isn't UV_IO_PRIORITY_NORMAL
+ * on uv__io_poll() makes a pass per priority.
+ */
+int uv__io_set_priority(uv_loop_t* loop, int fd, unsigned int priority) {
+  uv__loop_internal_fields_t* lfields;
+  unsigned char* priorities;
+  unsigned int n;
+
+  assert(fd >= 0);
+  lfields = uv__get_internal_fields(loop);
+
+  if ((unsigned) fd >= lfields->nio_priorities) {
+    if (priority == UV_IO_PRIORITY_NORMAL)
+      return 0;
+
+    n = next_power_of_two(fd + 1);
+    priorities = uv__realloc(lfields->io_priorities, n);
+    if (priorities == NULL)
+      return UV_ENOMEM;
+
+    memset(priorities + lfields->nio_priorities,
+           UV_IO_PRIORITY_NORMAL,
+           n - lfields->nio_priorities);
+    lfields->io_priorities = priorities;
+    lfields->nio_priorities = n;
+  }
+
+  lfields->io_priorities[fd] = priority;
+  return 0;
+}
+
+
+unsigned int uv__io_priority(uv_loop_t* loop, int fd) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  if ((unsigned) fd >= lfields->nio_priorities)
+    return UV_IO_PRIORITY_NORMAL;
+
+  return lfields->io_priorities[fd];
+}
+
+
+void uv__io_reset_priority(uv_loop_t* loop, int fd) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  if ((unsigned) fd < lfields->nio_priorities)
+    lfields->io_priorities[fd] = UV_IO_PRIORITY_NORMAL;
+}
+
+
+/* Like uv__io_close() but remembers the events the watcher was started for,
+ * uv__io_attach() starts it for them on another loop. Its priority is kept
+ * in `events`, which is unused while the watcher has no loop.
+ */
+void uv__io_detach(uv_loop_t* loop, uv__io_t* w) {
+  unsigned int priority;
+  unsigned int pevents;
+
+  priority = UV_IO_PRIORITY_NORMAL;
+  if (w->fd != -1)
+    priority = uv__io_priority(loop, w->fd);
+
+  pevents = w->pevents;
+  uv__io_close(loop, w);
+  w->pevents = pevents;
+  w->events = priority;
+}
+
+
+void uv__io_attach(uv_loop_t* loop, uv__io_t* w) {
+  unsigned int pevents;
+
+  assert(w->events == UV_IO_PRIORITY_NORMAL);
+  pevents = w->pevents;
+  w->pevents = 0;
+  if (pevents != 0)
+    uv__io_start(loop, w, pevents);
 }
 
 
@@ -964,6 +1681,21 @@ void uv__io_feed(uv_loop_t* loop, uv__io_t* w) {
 }
 
 
+/* An edge-triggered watcher is told about readiness only once. Called when
+ * it stops short of draining its file descriptor, like uv__read() does to
+ * avoid starving other handles, to have uv__io_poll() report `events` again.
+ * Level-triggered watchers don't need it, the kernel keeps reporting them.
+ */
+void uv__io_ready(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
+  if (!(w->events & UV__POLLET) || !(w->pevents & events))
+    return;
+
+  w->events &= ~events;
+  if (QUEUE_EMPTY(&w->watcher_queue))
+    QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
+}
+
+
 int uv__io_active(const uv__io_t* w, unsigned int events) {
   assert(0 == (events & ~(POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI)));
   assert(0 != events);
@@ -972,7 +1704,7 @@ int uv__io_active(const uv__io_t* w, unsigned int events) {
 
 
 int uv__fd_exists(uv_loop_t* loop, int fd) {
-  return (unsigned) fd < loop->nwatchers && loop->watchers[fd] != NULL;
+  return uv__fd_watcher(loop, fd) != NULL;
 }
 
 
@@ -1622,3 +2354,143 @@ int uv__search_path(const char* prog, char* buf, size_t* buflen) {
   /* Out of tokens (path entries), and no match found */
   return UV_EINVAL;
 }
+
+
+#if !defined(__linux__)
+int uv_netif_init(uv_loop_t* loop, uv_netif_t* handle) {
+  uv__handle_init(loop, (uv_handle_t*) handle, UV_NETIF);
+  handle->cb = NULL;
+  return 0;
+}
+
+
+int uv_netif_start(uv_netif_t* handle, uv_netif_cb cb) {
+  return UV_ENOSYS;
+}
+
+
+int uv_netif_stop(uv_netif_t* handle) {
+  return 0;
+}
+
+
+void uv__netif_close(uv_netif_t* handle) {
+}
+
+
+int uv_cpu_sampler_init(uv_cpu_sampler_t* sampler, int* count) {
+  *count = 0;
+  sampler->fd = -1;
+  sampler->buf = NULL;
+  sampler->ticks = NULL;
+  return UV_ENOSYS;
+}
+
+
+int uv_cpu_sampler_sample(uv_cpu_sampler_t* sampler,
+                          struct uv_cpu_times_s* deltas,
+                          int count) {
+  return UV_ENOSYS;
+}
+
+
+void uv_cpu_sampler_close(uv_cpu_sampler_t* sampler) {
+}
+
+
+int uv_get_resource_constraints(uv_resource_constraints_t* rc) {
+  return UV_ENOSYS;
+}
+
+
+unsigned int uv_available_parallelism(void) {
+  long rc;
+
+  rc = sysconf(_SC_NPROCESSORS_ONLN);
+  if (rc < 1)
+    rc = 1;
+
+  return (unsigned int) rc;
+}
+#endif  /* !defined(__linux__) */
+
+
+/* Memory for the arenas of the read pool, see uv__read_pool_configure().
+ * Explicit huge pages need a reserved pool (vm.nr_hugepages), without one
+ * this falls back to a region that's aligned so transparent huge pages can
+ * back it. The pages are bound to |node| before they're touched, with -1
+ * they come from the node of the thread that touches them first.
+ */
+void* uv__huge_alloc(size_t size, int node) {
+  uintptr_t addr;
+  size_t skip;
+  char* base;
+#if defined(__linux__)
+  unsigned long mask[UV__NUMA_MAX_NODES / (8 * sizeof(unsigned long))];
+  unsigned int bits;
+#endif
+
+#if defined(MAP_HUGETLB)
+  base = mmap(NULL,
+              size,
+              PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+              -1,
+              0);
+  if (base != MAP_FAILED)
+    goto bind;
+#endif
+
+  /* Twice the size, then trim it down to an aligned |size| bytes. */
+  base = mmap(NULL,
+              2 * size,
+              PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS,
+              -1,
+              0);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  addr = (uintptr_t) base;
+  skip = (size - addr % size) % size;
+  if (skip > 0)
+    munmap(base, skip);
+  munmap(base + skip + size, size - skip);
+  base += skip;
+
+#if defined(MADV_HUGEPAGE)
+  madvise(base, size, MADV_HUGEPAGE);
+#endif
+
+#if defined(MAP_HUGETLB)
+bind:
+#endif
+#if defined(__linux__)
+  /* Best effort, the memory is still usable without the binding. */
+  if (node >= 0) {
+    bits = 8 * sizeof(mask[0]);
+    memset(mask, 0, sizeof(mask));
+    mask[node / bits] |= 1UL << (node % bits);
+    syscall(SYS_mbind, base, size, 2 /* MPOL_BIND */, mask, UV__NUMA_MAX_NODES,
+            0);
+  }
+#endif
+
+  return base;
+}
+
+
+void uv__huge_free(void* base, size_t size) {
+  munmap(base, size);
+}
+
+
+/* The kernel interfaces only report names, see win/fs-event.c. */
+int uv_fs_event_getstat(const uv_fs_event_t* handle, uv_stat_t* statbuf) {
+  return UV_ENOSYS;
+}
+
+
+int uv_fs_event_buffer_size(uv_fs_event_t* handle, int* value) {
+  return UV_ENOSYS;
+}
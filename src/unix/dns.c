@@ -0,0 +1,1313 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* A stub resolver that runs on the event loop, see UV_LOOP_USE_DNS_RESOLVER.
+ * It answers uv_getaddrinfo() requests from the hosts file or by sending A
+ * and AAAA queries to the servers in resolv.conf, over UDP and over TCP when
+ * the answer is truncated. Requests it doesn't know how to answer the way
+ * getaddrinfo() would go to the threadpool like before.
+ */
+
+#define UV__ALLOC_TAG UV_ALLOC_TAG_DNS
+
+#include "uv.h"
+#include "internal.h"
+
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>  /* strncasecmp() */
+
+#include <arpa/inet.h>
+#include <net/if.h>  /* IF_NAMESIZE */
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#define UV__DNS_RESOLV_CONF "/etc/resolv.conf"
+#define UV__DNS_HOSTS "/etc/hosts"
+
+#define UV__DNS_MAX_SERVERS 3
+#define UV__DNS_MAX_SEARCH 6
+#define UV__DNS_MAX_ADDRS 32
+#define UV__DNS_MAX_NAME 253
+#define UV__DNS_MAX_FILE (64 * 1024 * 1024)
+
+#define UV__DNS_PORT 53
+#define UV__DNS_TYPE_A 1
+#define UV__DNS_TYPE_AAAA 28
+#define UV__DNS_CLASS_IN 1
+
+/* Lengths of the query header and the largest query we build. */
+#define UV__DNS_HEADER_SIZE 12
+#define UV__DNS_QUERY_SIZE (UV__DNS_HEADER_SIZE + UV__DNS_MAX_NAME + 2 + 4)
+
+enum {
+  UV__DNS_PENDING,
+  UV__DNS_ANSWER,
+  UV__DNS_NXDOMAIN,
+  UV__DNS_NODATA,
+  UV__DNS_FAILED,     /* Server error or garbage, try the next server. */
+  UV__DNS_TRUNCATED,  /* Ask the same server again over TCP. */
+  UV__DNS_IGNORE      /* Not an answer to our question. */
+};
+
+struct uv__dns_stamp {
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  time_t mtime;
+};
+
+struct uv__dns_resolver {
+  uv_timer_t timer;
+  QUEUE queries;
+  struct sockaddr_storage servers[UV__DNS_MAX_SERVERS];
+  unsigned int nservers;
+  char search[UV__DNS_MAX_SEARCH][UV__DNS_MAX_NAME + 1];
+  unsigned int nsearch;
+  unsigned int ndots;
+  unsigned int timeout;  /* In milliseconds. */
+  unsigned int attempts;
+  uint32_t seed;
+  char* hosts;
+  struct uv__dns_stamp conf_stamp;
+  struct uv__dns_stamp hosts_stamp;
+  char* conf_path;
+};
+
+struct uv__dns_query;
+
+/* An A or AAAA query for the name that is being tried. */
+struct uv__dns_lookup {
+  struct uv__dns_query* query;
+  uv__io_t io;
+  uint64_t deadline;  /* 0 when not waiting for an answer. */
+  unsigned int attempt;
+  unsigned int naddrs;
+  uint32_t ttl;
+  uint16_t type;
+  uint16_t id;
+  int state;
+  int tcp;
+  int tcp_sent;
+  size_t tcp_len;
+  unsigned char* tcp_buf;
+  size_t msglen;
+  unsigned char msg[2 + UV__DNS_QUERY_SIZE];  /* TCP length prefix first. */
+  unsigned char addrs[UV__DNS_MAX_ADDRS][16];
+};
+
+struct uv__dns_query {
+  QUEUE member;
+  uv_getaddrinfo_t* req;
+  struct uv__dns_resolver* resolver;
+  unsigned int nlookups;
+  unsigned int pending;
+  unsigned int name;
+  unsigned int nnames;
+  unsigned short port;
+  int socktype;
+  int protocol;
+  int flags;
+  struct uv__dns_lookup lookups[2];
+  char names[UV__DNS_MAX_SEARCH + 1][UV__DNS_MAX_NAME + 1];
+};
+
+/* What uv__getaddrinfo_complete() gets, one per address and socket type. */
+struct uv__dns_addrinfo {
+  struct addrinfo ai;
+  struct sockaddr_storage addr;
+};
+
+static void uv__dns_lookup_send(struct uv__dns_lookup* l);
+static void uv__dns_query_step(struct uv__dns_query* q);
+
+
+static struct uv__dns_resolver* uv__dns_get(uv_loop_t* loop) {
+  return uv__get_internal_fields(loop)->dns;
+}
+
+
+static uint16_t uv__dns_next_id(struct uv__dns_resolver* r) {
+  uint32_t x;
+
+  /* xorshift32, seeded from uv_random(). */
+  x = r->seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  r->seed = x;
+
+  return (uint16_t) (x >> 8);
+}
+
+
+/* Returns 1 and updates |stamp| when |path| changed since the last call. */
+static int uv__dns_stamp_update(const char* path, struct uv__dns_stamp* stamp) {
+  struct uv__dns_stamp now;
+  struct stat s;
+
+  memset(&now, 0, sizeof(now));
+  if (0 == stat(path, &s)) {
+    now.dev = s.st_dev;
+    now.ino = s.st_ino;
+    now.size = s.st_size;
+    now.mtime = s.st_mtime;
+  }
+
+  if (0 == memcmp(&now, stamp, sizeof(now)))
+    return 0;
+
+  *stamp = now;
+  return 1;
+}
+
+
+static char* uv__dns_read_file(const char* path) {
+  struct stat s;
+  size_t size;
+  size_t len;
+  ssize_t n;
+  char* buf;
+  int fd;
+
+  fd = uv__open_cloexec(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  buf = NULL;
+  if (fstat(fd, &s) || s.st_size > UV__DNS_MAX_FILE)
+    goto out;
+
+  size = s.st_size;
+  buf = uv__malloc(size + 1);
+  if (buf == NULL)
+    goto out;
+
+  for (len = 0; len < size; len += n) {
+    do
+      n = read(fd, buf + len, size - len);
+    while (n == -1 && errno == EINTR);
+
+    if (n <= 0)
+      break;
+  }
+
+  buf[len] = '\0';
+
+out:
+  uv__close(fd);
+  return buf;
+}
+
+
+/* Besides the usual addresses, "1.2.3.4:53" and "[::1]:53" are accepted so
+ * a server on another port can be used.
+ */
+static int uv__dns_parse_server(const char* s, struct sockaddr_storage* addr) {
+  char buf[INET6_ADDRSTRLEN + IF_NAMESIZE + 2];
+  const char* port;
+  const char* end;
+  char* endp;
+  size_t len;
+  long p;
+
+  port = NULL;
+  if (s[0] == '[') {
+    s++;
+    end = strchr(s, ']');
+    if (end == NULL)
+      return UV_EINVAL;
+    if (end[1] == ':')
+      port = end + 2;
+    else if (end[1] != '\0')
+      return UV_EINVAL;
+  } else {
+    end = strchr(s, ':');
+    if (end != NULL && strchr(end + 1, ':') == NULL)
+      port = end + 1;
+    else
+      end = s + strlen(s);
+  }
+
+  len = end - s;
+  if (len >= sizeof(buf))
+    return UV_EINVAL;
+
+  memcpy(buf, s, len);
+  buf[len] = '\0';
+
+  p = UV__DNS_PORT;
+  if (port != NULL) {
+    p = strtol(port, &endp, 10);
+    if (*port == '\0' || *endp != '\0' || p <= 0 || p > 65535)
+      return UV_EINVAL;
+  }
+
+  memset(addr, 0, sizeof(*addr));
+  if (0 == uv_ip4_addr(buf, p, (struct sockaddr_in*) addr))
+    return 0;
+
+  return uv_ip6_addr(buf, p, (struct sockaddr_in6*) addr);
+}
+
+
+static void uv__dns_parse_conf(struct uv__dns_resolver* r, char* buf) {
+  char* next;
+  char* line;
+  char* save;
+  char* tok;
+  char* p;
+  size_t len;
+  long n;
+
+  r->nservers = 0;
+  r->nsearch = 0;
+  r->ndots = 1;
+  r->timeout = 5000;
+  r->attempts = 2;
+
+  for (line = buf; line != NULL; line = next) {
+    next = strchr(line, '\n');
+    if (next != NULL)
+      *next++ = '\0';
+
+    p = strpbrk(line, "#;");
+    if (p != NULL)
+      *p = '\0';
+
+    tok = strtok_r(line, " \t\r", &save);
+    if (tok == NULL)
+      continue;
+
+    if (0 == strcmp(tok, "nameserver")) {
+      tok = strtok_r(NULL, " \t\r", &save);
+      if (tok != NULL && r->nservers < UV__DNS_MAX_SERVERS)
+        if (0 == uv__dns_parse_server(tok, &r->servers[r->nservers]))
+          r->nservers++;
+    } else if (0 == strcmp(tok, "search") || 0 == strcmp(tok, "domain")) {
+      /* The last one wins, like in glibc. */
+      r->nsearch = 0;
+      while (NULL != (tok = strtok_r(NULL, " \t\r", &save))) {
+        len = strlen(tok);
+        if (len > 0 && tok[len - 1] == '.')
+          tok[--len] = '\0';
+        if (len == 0 || len > UV__DNS_MAX_NAME)
+          continue;
+        if (r->nsearch == UV__DNS_MAX_SEARCH)
+          break;
+        memcpy(r->search[r->nsearch++], tok, len + 1);
+      }
+    } else if (0 == strcmp(tok, "options")) {
+      while (NULL != (tok = strtok_r(NULL, " \t\r", &save))) {
+        if (0 == strncmp(tok, "ndots:", 6)) {
+          n = strtol(tok + 6, NULL, 10);
+          r->ndots = n < 0 ? 0 : n > 15 ? 15 : n;
+        } else if (0 == strncmp(tok, "timeout:", 8)) {
+          n = strtol(tok + 8, NULL, 10);
+          r->timeout = 1000 * (n < 1 ? 1 : n > 30 ? 30 : n);
+        } else if (0 == strncmp(tok, "attempts:", 9)) {
+          n = strtol(tok + 9, NULL, 10);
+          r->attempts = n < 1 ? 1 : n > 5 ? 5 : n;
+        }
+      }
+    }
+  }
+
+  /* No servers means the local one, same as libc. */
+  if (r->nservers == 0) {
+    uv_ip4_addr("127.0.0.1",
+                UV__DNS_PORT,
+                (struct sockaddr_in*) &r->servers[0]);
+    r->nservers = 1;
+  }
+}
+
+
+/* Picks up edits to resolv.conf and the hosts file. */
+static void uv__dns_reload(struct uv__dns_resolver* r) {
+  char none[] = "";
+  char* buf;
+
+  if (uv__dns_stamp_update(r->conf_path, &r->conf_stamp)) {
+    buf = uv__dns_read_file(r->conf_path);
+    if (buf != NULL) {
+      uv__dns_parse_conf(r, buf);
+      uv__free(buf);
+    } else {
+      uv__dns_parse_conf(r, none);
+    }
+  }
+
+  if (uv__dns_stamp_update(UV__DNS_HOSTS, &r->hosts_stamp)) {
+    uv__free(r->hosts);
+    r->hosts = uv__dns_read_file(UV__DNS_HOSTS);
+  }
+}
+
+
+static struct uv__dns_lookup* uv__dns_query_lookup(struct uv__dns_query* q,
+                                                   uint16_t type) {
+  unsigned int i;
+
+  for (i = 0; i < q->nlookups; i++)
+    if (q->lookups[i].type == type)
+      return &q->lookups[i];
+
+  return NULL;
+}
+
+
+static void uv__dns_add_addr(struct uv__dns_lookup* l,
+                             const void* addr,
+                             uint32_t ttl) {
+  if (l->naddrs == UV__DNS_MAX_ADDRS)
+    return;
+
+  memcpy(l->addrs[l->naddrs++], addr, l->type == UV__DNS_TYPE_A ? 4 : 16);
+  if (ttl < l->ttl)
+    l->ttl = ttl;
+}
+
+
+/* Returns 1 if the hosts file has addresses for |name|. Like with the "files
+ * dns" order in nsswitch.conf, DNS isn't asked in that case.
+ */
+static int uv__dns_hosts_lookup(struct uv__dns_query* q, const char* name) {
+  struct uv__dns_lookup* l;
+  unsigned char addr[16];
+  const char* tok;
+  const char* end;
+  const char* p;
+  char buf[INET6_ADDRSTRLEN];
+  size_t namelen;
+  size_t len;
+  unsigned int i;
+  int match;
+
+  p = q->resolver->hosts;
+  if (p == NULL)
+    return 0;
+
+  namelen = strlen(name);
+  if (namelen > 0 && name[namelen - 1] == '.')
+    namelen--;
+
+  while (*p != '\0') {
+    /* The address, then the canonical name and the aliases. */
+    len = 0;
+    match = 0;
+    for (i = 0; ; i++) {
+      while (*p == ' ' || *p == '\t' || *p == '\r')
+        p++;
+
+      if (*p == '\0' || *p == '\n' || *p == '#')
+        break;
+
+      tok = p;
+      while (*p != '\0' && *p != '\n' && *p != '#' &&
+             *p != ' ' && *p != '\t' && *p != '\r')
+        p++;
+
+      if (i == 0) {
+        len = p - tok;
+        if (len >= sizeof(buf))
+          len = 0;
+        memcpy(buf, tok, len);
+        buf[len] = '\0';
+      } else if ((size_t) (p - tok) == namelen &&
+                 0 == strncasecmp(tok, name, namelen)) {
+        match = 1;
+      }
+    }
+
+    end = strchr(p, '\n');
+    p = end != NULL ? end + 1 : p + strlen(p);
+
+    if (!match || len == 0)
+      continue;
+
+    if (1 == inet_pton(AF_INET, buf, addr))
+      l = uv__dns_query_lookup(q, UV__DNS_TYPE_A);
+    else if (1 == inet_pton(AF_INET6, buf, addr))
+      l = uv__dns_query_lookup(q, UV__DNS_TYPE_AAAA);
+    else
+      l = NULL;
+
+    if (l != NULL)
+      uv__dns_add_addr(l, addr, (uint32_t) -1);
+  }
+
+  for (i = 0; i < q->nlookups; i++)
+    if (q->lookups[i].naddrs > 0)
+      return 1;
+
+  return 0;
+}
+
+
+/* Builds the list of names to try from |hostname| and the search domains,
+ * the same way the libc resolver does with the ndots option.
+ */
+static void uv__dns_query_names(struct uv__dns_query* q, const char* hostname) {
+  struct uv__dns_resolver* r;
+  const char* p;
+  unsigned int ndots;
+  unsigned int i;
+  size_t len;
+  size_t n;
+  int bare_first;
+
+  r = q->resolver;
+  len = strlen(hostname);
+  q->nnames = 0;
+
+  if (hostname[len - 1] == '.') {
+    memcpy(q->names[q->nnames], hostname, len - 1);
+    q->names[q->nnames++][len - 1] = '\0';
+    return;
+  }
+
+  for (ndots = 0, p = hostname; *p != '\0'; p++)
+    ndots += (*p == '.');
+
+  bare_first = ndots >= r->ndots;
+  if (bare_first || r->nsearch == 0)
+    memcpy(q->names[q->nnames++], hostname, len + 1);
+
+  for (i = 0; i < r->nsearch; i++) {
+    n = strlen(r->search[i]);
+    if (len + 1 + n > UV__DNS_MAX_NAME)
+      continue;
+
+    memcpy(q->names[q->nnames], hostname, len);
+    q->names[q->nnames][len] = '.';
+    memcpy(q->names[q->nnames] + len + 1, r->search[i], n + 1);
+    q->nnames++;
+  }
+
+  if (!bare_first && r->nsearch != 0)
+    memcpy(q->names[q->nnames++], hostname, len + 1);
+}
+
+
+static int uv__dns_encode(struct uv__dns_lookup* l, const char* name) {
+  const char* dot;
+  unsigned char* p;
+  size_t off;
+  size_t len;
+
+  if (*name == '\0')
+    return UV_EAI_NONAME;
+
+  p = l->msg + 2;
+  l->id = uv__dns_next_id(l->query->resolver);
+  memset(p, 0, UV__DNS_HEADER_SIZE);
+  p[0] = l->id >> 8;
+  p[1] = l->id & 0xFF;
+  p[2] = 0x01;  /* Recursion desired. */
+  p[5] = 1;     /* One question. */
+  off = UV__DNS_HEADER_SIZE;
+
+  while (*name != '\0') {
+    dot = strchr(name, '.');
+    len = dot != NULL ? (size_t) (dot - name) : strlen(name);
+    if (len == 0 || len > 63)
+      return UV_EAI_NONAME;
+
+    p[off++] = len;
+    memcpy(p + off, name, len);
+    off += len;
+    name += len + (dot != NULL);
+  }
+
+  p[off++] = 0;
+  p[off++] = 0;
+  p[off++] = l->type;
+  p[off++] = 0;
+  p[off++] = UV__DNS_CLASS_IN;
+
+  l->msglen = off;
+  l->msg[0] = off >> 8;
+  l->msg[1] = off & 0xFF;
+
+  return 0;
+}
+
+
+static int uv__dns_skip_name(const unsigned char* p, size_t n, size_t* off) {
+  size_t i;
+
+  for (i = *off; i < n; i += 1 + p[i]) {
+    if (p[i] == 0) {
+      *off = i + 1;
+      return 0;
+    }
+
+    if ((p[i] & 0xC0) == 0xC0) {
+      if (i + 2 > n)
+        return -1;
+      *off = i + 2;
+      return 0;
+    }
+
+    if (p[i] & 0xC0)
+      return -1;
+  }
+
+  return -1;
+}
+
+
+static int uv__dns_parse(struct uv__dns_lookup* l,
+                         const unsigned char* p,
+                         size_t n) {
+  const unsigned char* question;
+  unsigned int ancount;
+  unsigned int rdlen;
+  unsigned int type;
+  unsigned int cls;
+  unsigned int i;
+  uint32_t ttl;
+  size_t qlen;
+  size_t off;
+
+  if (n < UV__DNS_HEADER_SIZE)
+    return UV__DNS_IGNORE;
+
+  if ((p[0] << 8 | p[1]) != l->id || !(p[2] & 0x80))
+    return UV__DNS_IGNORE;
+
+  /* The question is echoed back as-is, modulo the case of the letters. */
+  question = l->msg + 2 + UV__DNS_HEADER_SIZE;
+  qlen = l->msglen - UV__DNS_HEADER_SIZE;
+  if ((p[4] << 8 | p[5]) != 1 || n < UV__DNS_HEADER_SIZE + qlen)
+    return UV__DNS_IGNORE;
+
+  for (i = 0; i < qlen; i++)
+    if (tolower(p[UV__DNS_HEADER_SIZE + i]) != tolower(question[i]))
+      return UV__DNS_IGNORE;
+
+  if (p[2] & 0x02)
+    return UV__DNS_TRUNCATED;
+
+  switch (p[3] & 0x0F) {
+  case 0:
+    break;
+  case 3:
+    return UV__DNS_NXDOMAIN;
+  default:
+    return UV__DNS_FAILED;
+  }
+
+  ancount = p[6] << 8 | p[7];
+  off = UV__DNS_HEADER_SIZE + qlen;
+
+  /* Records for the CNAMEs on the way are skipped, only the addresses are
+   * picked up.
+   */
+  for (i = 0; i < ancount; i++) {
+    if (uv__dns_skip_name(p, n, &off) || off + 10 > n)
+      return UV__DNS_FAILED;
+
+    type = p[off] << 8 | p[off + 1];
+    cls = p[off + 2] << 8 | p[off + 3];
+    ttl = (uint32_t) p[off + 4] << 24 | (uint32_t) p[off + 5] << 16 |
+          (uint32_t) p[off + 6] << 8 | (uint32_t) p[off + 7];
+    rdlen = p[off + 8] << 8 | p[off + 9];
+    off += 10;
+
+    if (off + rdlen > n)
+      return UV__DNS_FAILED;
+
+    if (type == l->type &&
+        cls == UV__DNS_CLASS_IN &&
+        rdlen == (type == UV__DNS_TYPE_A ? 4u : 16u))
+      uv__dns_add_addr(l, p + off, ttl);
+
+    off += rdlen;
+  }
+
+  return l->naddrs > 0 ? UV__DNS_ANSWER : UV__DNS_NODATA;
+}
+
+
+static void uv__dns_lookup_close(struct uv__dns_lookup* l) {
+  if (l->io.fd == -1)
+    return;
+
+  uv__io_close(l->query->req->loop, &l->io);
+  uv__close(l->io.fd);
+  l->io.fd = -1;
+  l->deadline = 0;
+}
+
+
+static void uv__dns_lookup_finish(struct uv__dns_lookup* l, int state) {
+  struct uv__dns_query* q;
+
+  q = l->query;
+  uv__dns_lookup_close(l);
+  l->state = state;
+
+  assert(q->pending > 0);
+  if (--q->pending == 0)
+    uv__dns_query_step(q);
+}
+
+
+/* Gives up on the current server and moves on to the next attempt. */
+static void uv__dns_lookup_next(struct uv__dns_lookup* l) {
+  l->attempt++;
+  l->tcp = 0;
+  uv__dns_lookup_send(l);
+}
+
+
+static void uv__dns_lookup_handle(struct uv__dns_lookup* l, int rc) {
+  switch (rc) {
+  case UV__DNS_TRUNCATED:
+    if (l->tcp) {
+      uv__dns_lookup_next(l);
+    } else {
+      l->tcp = 1;
+      uv__dns_lookup_send(l);
+    }
+    break;
+  case UV__DNS_FAILED:
+  case UV__DNS_IGNORE:
+    uv__dns_lookup_next(l);
+    break;
+  default:
+    uv__dns_lookup_finish(l, rc);
+  }
+}
+
+
+static void uv__dns_tcp_io(struct uv__dns_lookup* l) {
+  uv_loop_t* loop;
+  socklen_t len;
+  ssize_t n;
+  size_t need;
+  int err;
+  int fd;
+
+  loop = l->query->req->loop;
+  fd = l->io.fd;
+
+  if (!l->tcp_sent) {
+    len = sizeof(err);
+    if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) || err != 0)
+      goto fail;
+
+    do
+      n = write(fd, l->msg, l->msglen + 2);
+    while (n == -1 && errno == EINTR);
+
+    /* The query is tiny, it's either written in one go or not at all. */
+    if (n != (ssize_t) l->msglen + 2)
+      goto fail;
+
+    l->tcp_sent = 1;
+    uv__io_stop(loop, &l->io, POLLOUT);
+    uv__io_start(loop, &l->io, POLLIN);
+    return;
+  }
+
+  if (l->tcp_buf == NULL) {
+    l->tcp_buf = uv__malloc(2 + 65535);
+    if (l->tcp_buf == NULL)
+      goto fail;
+  }
+
+  for (;;) {
+    do
+      n = read(fd, l->tcp_buf + l->tcp_len, 2 + 65535 - l->tcp_len);
+    while (n == -1 && errno == EINTR);
+
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return;
+
+    if (n <= 0)
+      goto fail;
+
+    l->tcp_len += n;
+    if (l->tcp_len < 2)
+      continue;
+
+    need = 2 + (l->tcp_buf[0] << 8 | l->tcp_buf[1]);
+    if (l->tcp_len < need)
+      continue;
+
+    uv__dns_lookup_handle(l, uv__dns_parse(l, l->tcp_buf + 2, need - 2));
+    return;
+  }
+
+fail:
+  uv__dns_lookup_next(l);
+}
+
+
+static void uv__dns_arm(struct uv__dns_resolver* r);
+
+
+static void uv__dns_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
+  struct uv__dns_resolver* r;
+  struct uv__dns_lookup* l;
+  unsigned char buf[4096];
+  ssize_t n;
+  int rc;
+
+  l = container_of(w, struct uv__dns_lookup, io);
+  r = l->query->resolver;
+
+  if (l->tcp) {
+    uv__dns_tcp_io(l);
+    uv__dns_arm(r);
+    return;
+  }
+
+  for (;;) {
+    do
+      n = recv(w->fd, buf, sizeof(buf), 0);
+    while (n == -1 && errno == EINTR);
+
+    if (n == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return;
+      /* ECONNREFUSED and the like, nobody is listening there. */
+      uv__dns_lookup_next(l);
+      break;
+    }
+
+    /* Spoofed or late answers are dropped, keep waiting for the real one. */
+    rc = uv__dns_parse(l, buf, n);
+    if (rc != UV__DNS_IGNORE) {
+      uv__dns_lookup_handle(l, rc);
+      break;
+    }
+  }
+
+  uv__dns_arm(r);
+}
+
+
+static int uv__dns_lookup_connect(struct uv__dns_lookup* l,
+                                  const struct sockaddr_storage* server) {
+  socklen_t addrlen;
+  ssize_t n;
+  int err;
+  int fd;
+  int r;
+
+  fd = uv__socket(server->ss_family, l->tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+  if (fd < 0)
+    return fd;
+
+  if (server->ss_family == AF_INET6)
+    addrlen = sizeof(struct sockaddr_in6);
+  else
+    addrlen = sizeof(struct sockaddr_in);
+
+  /* A connected UDP socket only sees datagrams from the server. */
+  do
+    r = connect(fd, (const struct sockaddr*) server, addrlen);
+  while (r == -1 && errno == EINTR);
+
+  if (r == -1 && !(l->tcp && errno == EINPROGRESS))
+    goto fail;
+
+  if (!l->tcp) {
+    do
+      n = send(fd, l->msg + 2, l->msglen, 0);
+    while (n == -1 && errno == EINTR);
+
+    if (n != (ssize_t) l->msglen)
+      goto fail;
+  }
+
+  l->tcp_sent = 0;
+  l->tcp_len = 0;
+  uv__io_init(&l->io, uv__dns_io, fd);
+  uv__io_start(l->query->req->loop, &l->io, l->tcp ? POLLOUT : POLLIN);
+  return 0;
+
+fail:
+  err = UV__ERR(errno);
+  uv__close(fd);
+  return err ? err : UV_EIO;
+}
+
+
+static void uv__dns_lookup_send(struct uv__dns_lookup* l) {
+  struct uv__dns_resolver* r;
+
+  r = l->query->resolver;
+  uv__dns_lookup_close(l);
+
+  for (; l->attempt < r->nservers * r->attempts; l->attempt++, l->tcp = 0) {
+    if (0 == uv__dns_lookup_connect(l, &r->servers[l->attempt % r->nservers])) {
+      l->deadline = uv_now(l->query->req->loop) + r->timeout;
+      return;
+    }
+  }
+
+  uv__dns_lookup_finish(l, UV__DNS_FAILED);
+}
+
+
+static void uv__dns_query_finish(struct uv__dns_query* q, int retcode) {
+  struct uv__dns_addrinfo* list;
+  struct uv__dns_addrinfo* ent;
+  struct uv__dns_lookup* l;
+  struct addrinfo* prev;
+  static const int socktypes[3][2] = {
+    { SOCK_STREAM, IPPROTO_TCP },
+    { SOCK_DGRAM, IPPROTO_UDP },
+    { SOCK_RAW, 0 }
+  };
+  unsigned int nsocktypes;
+  unsigned int naddrs;
+  unsigned int i;
+  unsigned int j;
+  unsigned int k;
+  uint64_t ttl;
+
+  nsocktypes = q->socktype == 0 ? 3 : 1;
+  ttl = (uint64_t) -1;
+  list = NULL;
+  prev = NULL;
+
+  for (naddrs = 0, i = 0; i < q->nlookups; i++)
+    naddrs += q->lookups[i].naddrs;
+
+  if (retcode == 0) {
+    list = uv__calloc(naddrs * nsocktypes, sizeof(*list));
+    if (list == NULL)
+      retcode = UV_EAI_MEMORY;
+  }
+
+  for (ent = list, i = 0; list != NULL && i < q->nlookups; i++) {
+    l = &q->lookups[i];
+    if (l->naddrs > 0 && l->ttl != (uint32_t) -1 && l->ttl * (uint64_t) 1000 < ttl)
+      ttl = l->ttl * (uint64_t) 1000;
+
+    for (j = 0; j < l->naddrs; j++) {
+      for (k = 0; k < nsocktypes; k++, ent++) {
+        if (l->type == UV__DNS_TYPE_A) {
+          struct sockaddr_in* sin = (struct sockaddr_in*) &ent->addr;
+          sin->sin_family = AF_INET;
+          sin->sin_port = htons(q->port);
+          memcpy(&sin->sin_addr, l->addrs[j], 4);
+          ent->ai.ai_family = AF_INET;
+          ent->ai.ai_addrlen = sizeof(*sin);
+        } else {
+          struct sockaddr_in6* sin6 = (struct sockaddr_in6*) &ent->addr;
+          sin6->sin6_family = AF_INET6;
+          sin6->sin6_port = htons(q->port);
+          memcpy(&sin6->sin6_addr, l->addrs[j], 16);
+          ent->ai.ai_family = AF_INET6;
+          ent->ai.ai_addrlen = sizeof(*sin6);
+        }
+
+        if (q->socktype == 0) {
+          ent->ai.ai_socktype = socktypes[k][0];
+          ent->ai.ai_protocol = socktypes[k][1];
+        } else {
+          ent->ai.ai_socktype = q->socktype;
+          ent->ai.ai_protocol = q->protocol;
+        }
+
+        ent->ai.ai_flags = q->flags;
+        ent->ai.ai_addr = (struct sockaddr*) &ent->addr;
+        if (prev != NULL)
+          prev->ai_next = &ent->ai;
+        prev = &ent->ai;
+      }
+    }
+  }
+
+  QUEUE_REMOVE(&q->member);
+  for (i = 0; i < q->nlookups; i++) {
+    uv__dns_lookup_close(&q->lookups[i]);
+    uv__free(q->lookups[i].tcp_buf);
+  }
+
+  uv__getaddrinfo_complete(q->req,
+                           retcode,
+                           list != NULL ? &list->ai : NULL,
+                           ttl);
+  uv__free(list);
+  uv__free(q);
+}
+
+
+/* Sends the queries for the name that is up next. */
+static void uv__dns_query_start(struct uv__dns_query* q) {
+  struct uv__dns_lookup* l;
+  unsigned int nlookups;
+  unsigned int i;
+
+  q->pending = q->nlookups;
+  for (i = 0; i < q->nlookups; i++) {
+    l = &q->lookups[i];
+    l->state = UV__DNS_PENDING;
+    l->attempt = 0;
+    l->tcp = 0;
+    l->naddrs = 0;
+    l->ttl = (uint32_t) -1;
+    if (uv__dns_encode(l, q->names[q->name]))
+      l->state = UV__DNS_NXDOMAIN;
+  }
+
+  /* Sending can finish a lookup and with that the query, don't touch |q|
+   * after the last one.
+   */
+  nlookups = q->nlookups;
+  for (i = 0; i < nlookups; i++) {
+    l = &q->lookups[i];
+    if (l->state == UV__DNS_PENDING) {
+      uv__dns_lookup_send(l);
+    } else if (--q->pending == 0) {
+      uv__dns_query_step(q);
+      return;
+    }
+  }
+}
+
+
+/* Runs when all lookups for the current name are done. */
+static void uv__dns_query_step(struct uv__dns_query* q) {
+  unsigned int i;
+  int failed;
+
+  failed = 0;
+  for (i = 0; i < q->nlookups; i++) {
+    if (q->lookups[i].naddrs > 0) {
+      uv__dns_query_finish(q, 0);
+      return;
+    }
+    failed |= q->lookups[i].state == UV__DNS_FAILED;
+  }
+
+  if (failed) {
+    uv__dns_query_finish(q, UV_EAI_AGAIN);
+    return;
+  }
+
+  if (++q->name == q->nnames) {
+    uv__dns_query_finish(q, UV_EAI_NONAME);
+    return;
+  }
+
+  uv__dns_query_start(q);
+}
+
+
+static void uv__dns_timer_cb(uv_timer_t* timer) {
+  struct uv__dns_resolver* r;
+  struct uv__dns_query* query;
+  struct uv__dns_lookup* l;
+  unsigned int i;
+  uint64_t now;
+  QUEUE* q;
+
+  r = container_of(timer, struct uv__dns_resolver, timer);
+  now = uv_now(timer->loop);
+
+  /* Retrying can finish the query, start over after every one. */
+again:
+  QUEUE_FOREACH(q, &r->queries) {
+    query = QUEUE_DATA(q, struct uv__dns_query, member);
+    for (i = 0; i < query->nlookups; i++) {
+      l = &query->lookups[i];
+      if (l->deadline != 0 && l->deadline <= now) {
+        uv__dns_lookup_next(l);
+        goto again;
+      }
+    }
+  }
+
+  uv__dns_arm(r);
+}
+
+
+static void uv__dns_arm(struct uv__dns_resolver* r) {
+  struct uv__dns_query* query;
+  unsigned int i;
+  uint64_t deadline;
+  uint64_t now;
+  QUEUE* q;
+
+  deadline = 0;
+  QUEUE_FOREACH(q, &r->queries) {
+    query = QUEUE_DATA(q, struct uv__dns_query, member);
+    for (i = 0; i < query->nlookups; i++)
+      if (query->lookups[i].deadline != 0)
+        if (deadline == 0 || query->lookups[i].deadline < deadline)
+          deadline = query->lookups[i].deadline;
+  }
+
+  if (deadline == 0) {
+    uv_timer_stop(&r->timer);
+    return;
+  }
+
+  now = uv_now(r->timer.loop);
+  uv_timer_start(&r->timer,
+                 uv__dns_timer_cb,
+                 deadline > now ? deadline - now : 0,
+                 0);
+}
+
+
+static void uv__dns_local_families(int* has4, int* has6) {
+  uv_interface_address_t* addrs;
+  const unsigned char* a6;
+  int naddrs;
+  int i;
+
+  *has4 = 0;
+  *has6 = 0;
+  if (uv_interface_addresses(&addrs, &naddrs))
+    return;
+
+  for (i = 0; i < naddrs; i++) {
+    if (addrs[i].is_internal)
+      continue;
+
+    if (addrs[i].address.address4.sin_family == AF_INET) {
+      *has4 = 1;
+    } else if (addrs[i].address.address4.sin_family == AF_INET6) {
+      /* Link-local addresses don't count. */
+      a6 = addrs[i].address.address6.sin6_addr.s6_addr;
+      if (!(a6[0] == 0xFE && (a6[1] & 0xC0) == 0x80))
+        *has6 = 1;
+    }
+  }
+
+  uv_free_interface_addresses(addrs, naddrs);
+}
+
+
+static int uv__dns_is_numeric(const char* hostname) {
+  struct in_addr addr;
+
+  /* Host names can't have colons, those are IPv6 addresses. */
+  if (strchr(hostname, ':') != NULL || strchr(hostname, '%') != NULL)
+    return 1;
+
+  return inet_aton(hostname, &addr) != 0;
+}
+
+
+int uv__dns_getaddrinfo(uv_getaddrinfo_t* req) {
+  struct uv__dns_resolver* r;
+  struct uv__dns_query* q;
+  unsigned int i;
+  size_t len;
+  char* end;
+  long port;
+  int family;
+  int flags;
+  int want4;
+  int want6;
+  int has4;
+  int has6;
+
+  r = uv__dns_get(req->loop);
+  if (r == NULL || req->hostname == NULL)
+    return UV_ENOSYS;
+
+  family = AF_UNSPEC;
+  flags = 0;
+  if (req->hints != NULL) {
+    family = req->hints->ai_family;
+    flags = req->hints->ai_flags;
+  }
+
+  /* Canonical names, V4MAPPED and the like are left to libc. */
+  if (flags & ~(AI_ADDRCONFIG | AI_NUMERICSERV | AI_PASSIVE))
+    return UV_ENOSYS;
+
+  if (family != AF_UNSPEC && family != AF_INET && family != AF_INET6)
+    return UV_ENOSYS;
+
+  /* Service names need /etc/services, only port numbers are handled. */
+  port = 0;
+  if (req->service != NULL) {
+    port = strtol(req->service, &end, 10);
+    if (*req->service == '\0' || *end != '\0' || port < 0 || port > 65535)
+      return UV_ENOSYS;
+  }
+
+  len = strlen(req->hostname);
+  if (len == 0 || len > UV__DNS_MAX_NAME + 1)
+    return UV_ENOSYS;
+
+  if (uv__dns_is_numeric(req->hostname))
+    return UV_ENOSYS;
+
+  want4 = family != AF_INET6;
+  want6 = family != AF_INET;
+  has4 = 0;
+  has6 = 0;
+  if (family == AF_UNSPEC || (flags & AI_ADDRCONFIG))
+    uv__dns_local_families(&has4, &has6);
+
+  if ((flags & AI_ADDRCONFIG) && (has4 || has6)) {
+    want4 &= has4;
+    want6 &= has6;
+  }
+
+  if (!want4 && !want6)
+    return UV_ENOSYS;
+
+  q = uv__calloc(1, sizeof(*q));
+  if (q == NULL)
+    return UV_ENOMEM;
+
+  uv__dns_reload(r);
+
+  q->req = req;
+  q->resolver = r;
+  q->port = (unsigned short) port;
+  q->flags = flags;
+  if (req->hints != NULL) {
+    q->socktype = req->hints->ai_socktype;
+    q->protocol = req->hints->ai_protocol;
+    if (q->protocol == 0 && q->socktype == SOCK_STREAM)
+      q->protocol = IPPROTO_TCP;
+    if (q->protocol == 0 && q->socktype == SOCK_DGRAM)
+      q->protocol = IPPROTO_UDP;
+  }
+
+  /* IPv6 addresses go first when the host has IPv6 connectivity. */
+  if (want6 && has6)
+    q->lookups[q->nlookups++].type = UV__DNS_TYPE_AAAA;
+  if (want4)
+    q->lookups[q->nlookups++].type = UV__DNS_TYPE_A;
+  if (want6 && !has6)
+    q->lookups[q->nlookups++].type = UV__DNS_TYPE_AAAA;
+
+  for (i = 0; i < q->nlookups; i++) {
+    q->lookups[i].query = q;
+    q->lookups[i].ttl = (uint32_t) -1;
+    uv__io_init(&q->lookups[i].io, uv__dns_io, -1);
+  }
+
+  /* Nothing runs on the threadpool, uv_cancel() returns UV_EBUSY. */
+  QUEUE_INIT(&req->work_req.wq);
+  req->work_req.loop = req->loop;
+  req->work_req.work = NULL;
+
+  QUEUE_INSERT_TAIL(&r->queries, &q->member);
+
+  if (uv__dns_hosts_lookup(q, req->hostname)) {
+    uv__dns_query_finish(q, 0);
+    return 0;
+  }
+
+  uv__dns_query_names(q, req->hostname);
+  uv__dns_query_start(q);
+  uv__dns_arm(r);
+
+  return 0;
+}
+
+
+int uv__dns_enable(uv_loop_t* loop, const char* resolv_conf) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__dns_resolver* r;
+  char* path;
+  int err;
+
+  if (resolv_conf == NULL)
+    resolv_conf = UV__DNS_RESOLV_CONF;
+
+  path = uv__strdup(resolv_conf);
+  if (path == NULL)
+    return UV_ENOMEM;
+
+  lfields = uv__get_internal_fields(loop);
+  r = lfields->dns;
+
+  if (r == NULL) {
+    r = uv__calloc(1, sizeof(*r));
+    if (r == NULL) {
+      uv__free(path);
+      return UV_ENOMEM;
+    }
+
+    err = uv_random(NULL, NULL, &r->seed, sizeof(r->seed), 0, NULL);
+    if (err == 0)
+      err = uv_timer_init(loop, &r->timer);
+
+    if (err) {
+      uv__free(path);
+      uv__free(r);
+      return err;
+    }
+
+    if (r->seed == 0)
+      r->seed = 1;
+
+    uv__handle_unref(&r->timer);
+    r->timer.flags |= UV_HANDLE_INTERNAL;
+    QUEUE_INIT(&r->queries);
+    lfields->dns = r;
+  }
+
+  /* Forces a reload on the next lookup. */
+  uv__free(r->conf_path);
+  r->conf_path = path;
+  memset(&r->conf_stamp, 0, sizeof(r->conf_stamp));
+  memset(&r->hosts_stamp, 0, sizeof(r->hosts_stamp));
+  r->conf_stamp.mtime = -1;
+  r->hosts_stamp.mtime = -1;
+
+  return 0;
+}
+
+
+void uv__dns_loop_close(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__dns_resolver* r;
+
+  lfields = uv__get_internal_fields(loop);
+  r = lfields->dns;
+  if (r == NULL)
+    return;
+
+  /* Every query holds a request, there are none left at this point. */
+  assert(QUEUE_EMPTY(&r->queries));
+  uv_timer_stop(&r->timer);
+  uv__handle_remove(&r->timer);
+  uv__free(r->conf_path);
+  uv__free(r->hosts);
+  uv__free(r);
+  lfields->dns = NULL;
+}
@@ -19,10 +19,25 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_LOOP
+
 #include "uv.h"
 #include "internal.h"
 #include <errno.h>
 #include <sys/epoll.h>
+#include <sys/ioctl.h>
+
+/* From <linux/eventpoll.h>, Linux 6.9+. Older headers don't have it. */
+struct uv__epoll_params {
+  uint32_t busy_poll_usecs;
+  uint16_t busy_poll_budget;
+  uint8_t prefer_busy_poll;
+  uint8_t pad;
+};
+
+#define UV__EPIOCSPARAMS _IOW(0x8A, 0x01, struct uv__epoll_params)
+
+static void uv__epoll_set_params(uv_loop_t* loop);
 
 int uv__epoll_init(uv_loop_t* loop) {
   int fd;
@@ -42,10 +57,194 @@ int uv__epoll_init(uv_loop_t* loop) {
   if (fd == -1)
     return UV__ERR(errno);
 
+  /* Not set yet when called from uv_loop_init(), but it is after a fork. */
+  if (loop->internal_fields != NULL)
+    uv__epoll_set_params(loop);
+
+  return 0;
+}
+
+
+/* Lets the kernel poll the NIC queues of the sockets in the epoll set
+ * before epoll_wait() sleeps. Best effort, it needs Linux 6.9 and a driver
+ * with NAPI, and the spinning in uv__epoll_busy_wait() works without it.
+ */
+static void uv__epoll_set_params(uv_loop_t* loop) {
+  struct uv__epoll_params params;
+  uint64_t usec;
+
+  usec = uv__get_internal_fields(loop)->busy_poll / 1000;
+  if (usec == 0)
+    return;
+
+  memset(&params, 0, sizeof(params));
+  params.busy_poll_usecs = usec;
+  params.busy_poll_budget = 8;  /* BUSY_POLL_BUDGET, no privileges needed. */
+  params.prefer_busy_poll = uv__get_internal_fields(loop)->prefer_busy_poll;
+  ioctl(loop->backend_fd, UV__EPIOCSPARAMS, &params);
+}
+
+
+int uv__epoll_busy_poll(uv_loop_t* loop, unsigned int usec) {
+  uv__get_internal_fields(loop)->busy_poll = (uint64_t) usec * 1000;
+  uv__epoll_set_params(loop);
+  return 0;
+}
+
+
+/* From uv_tcp_set_busy_poll() and uv_udp_set_busy_poll(). Preferring busy
+ * polling keeps the device's interrupts masked for as long as the loop
+ * polls it often enough, that only pays off if the epoll set does it too.
+ */
+void uv__epoll_prefer_busy_poll(uv_loop_t* loop) {
+  if (uv__get_internal_fields(loop)->prefer_busy_poll)
+    return;
+
+  uv__get_internal_fields(loop)->prefer_busy_poll = 1;
+  uv__epoll_set_params(loop);
+}
+
+
+int uv__epoll_io_budget(uv_loop_t* loop,
+                        unsigned int ncallbacks,
+                        unsigned int time) {
+  uv__get_internal_fields(loop)->io_budget = ncallbacks;
+  uv__get_internal_fields(loop)->io_budget_time = time;
+  return 0;
+}
+
+
+/* Whether the UV_LOOP_IO_BUDGET of this uv__io_poll() call is used up,
+ * after |ncallbacks| callbacks. |deadline| is in loop time.
+ */
+static int uv__epoll_budget_spent(uv_loop_t* loop,
+                                  unsigned int ncallbacks,
+                                  uint64_t deadline) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->io_budget != 0 && ncallbacks >= lfields->io_budget)
+    return 1;
+
+  if (lfields->io_budget_time != 0 && uv__loop_clock(loop) >= deadline)
+    return 1;
+
+  return 0;
+}
+
+
+/* The dispatch pass of each uv_io_priority: high, normal, then low. */
+static const int uv__epoll_pass[] = { 1, 0, 2 };
+
+
+/* Bounds of the UV_LOOP_EVENT_BUFFER_SIZE buffer. It doubles after this many
+ * consecutive polls filled it.
+ */
+#define UV__EPOLL_EVENTS_MAX (64 * 1024)
+#define UV__EPOLL_GROW_AFTER 4
+
+
+int uv__epoll_buffer_size(uv_loop_t* loop, unsigned int nevents) {
+  uv__loop_internal_fields_t* lfields;
+  struct epoll_event* events;
+
+  if (nevents == 0 || nevents > UV__EPOLL_EVENTS_MAX)
+    return UV_EINVAL;
+
+  /* uv__io_poll() is using the buffer when called from a callback. */
+  if (uv__fd_map_events(loop) != NULL)
+    return UV_EBUSY;
+
+  lfields = uv__get_internal_fields(loop);
+  events = uv__malloc(nevents * sizeof(*events));
+  if (events == NULL)
+    return UV_ENOMEM;
+
+  uv__free(lfields->poll_events);
+  lfields->poll_events = events;
+  lfields->poll_nevents = nevents;
+  lfields->poll_saturated = 0;
+
   return 0;
 }
 
 
+/* Called after a poll that returned `nfds` events, with the buffer no longer
+ * in use. Failing to grow it is no problem, the events that didn't fit are
+ * picked up by the next poll.
+ */
+static void uv__epoll_buffer_update(uv_loop_t* loop, int nfds) {
+  uv__loop_internal_fields_t* lfields;
+  struct epoll_event* events;
+  unsigned int nevents;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->poll_events == NULL)
+    return;
+
+  if ((unsigned int) nfds < lfields->poll_nevents) {
+    lfields->poll_saturated = 0;
+    return;
+  }
+
+  if (++lfields->poll_saturated < UV__EPOLL_GROW_AFTER)
+    return;
+
+  lfields->poll_saturated = 0;
+  nevents = lfields->poll_nevents * 2;
+  if (nevents > UV__EPOLL_EVENTS_MAX)
+    return;
+
+  events = uv__realloc(lfields->poll_events, nevents * sizeof(*events));
+  if (events == NULL)
+    return;
+
+  lfields->poll_events = events;
+  lfields->poll_nevents = nevents;
+}
+
+
+/* Polls without blocking until there are events, `budget` nanoseconds have
+ * passed or the timeout expires, whichever comes first. Returns what the
+ * last epoll_wait() returned and leaves loop->time and `*timeout` current.
+ * The budget is measured with UV_CLOCK_FAST, UV_LOOP_COARSE_CLOCK may be
+ * too coarse for it.
+ */
+static int uv__epoll_busy_wait(uv_loop_t* loop,
+                               struct epoll_event* events,
+                               int nevents,
+                               uint64_t budget,
+                               int* timeout) {
+  uint64_t deadline;
+  uint64_t start;
+  uint64_t spent;
+  uint64_t now;
+  int nfds;
+
+  start = uv__hrtime(UV_CLOCK_FAST);
+  if (*timeout > 0 && budget > (uint64_t) *timeout * 1000000)
+    budget = (uint64_t) *timeout * 1000000;
+  deadline = start + budget;
+
+  do {
+    nfds = epoll_wait(loop->backend_fd, events, nevents, 0);
+    now = uv__hrtime(UV_CLOCK_FAST);
+  } while (nfds == 0 && now < deadline);
+
+  uv__update_time(loop);
+
+  if (*timeout > 0) {
+    spent = (now - start) / 1000000;
+    if (spent < (uint64_t) *timeout)
+      *timeout -= spent;
+    else
+      *timeout = 0;
+  }
+
+  return nfds;
+}
+
+
 void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
   struct epoll_event* events;
   struct epoll_event dummy;
@@ -55,8 +254,8 @@ void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
   assert(loop->watchers != NULL);
   assert(fd >= 0);
 
-  events = (struct epoll_event*) loop->watchers[loop->nwatchers];
-  nfds = (uintptr_t) loop->watchers[loop->nwatchers + 1];
+  events = (struct epoll_event*) uv__fd_map_events(loop);
+  nfds = (uintptr_t) uv__fd_map_nevents(loop);
   if (events != NULL)
     /* Invalidate events with same file descriptor */
     for (i = 0; i < nfds; i++)
@@ -76,6 +275,9 @@ void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
     memset(&dummy, 0, sizeof(dummy));
     epoll_ctl(loop->backend_fd, EPOLL_CTL_DEL, fd, &dummy);
   }
+
+  if (uv__iou_enabled(loop))
+    uv__iou_invalidate_fd(loop, fd);
 }
 
 
@@ -100,6 +302,60 @@ int uv__io_check_fd(uv_loop_t* loop, int fd) {
 }
 
 
+/* UV_LOOP_EDGE_TRIGGERED applies to streams and UDP handles, the ones that
+ * read until EAGAIN or call uv__io_ready() when they stop short. Servers
+ * and uv_poll_t handles stay level-triggered.
+ */
+static int uv__epoll_edge_triggered(uv_loop_t* loop, const uv__io_t* w) {
+  if (!(uv__get_internal_fields(loop)->flags & UV__LOOP_EDGE_TRIGGERED))
+    return 0;
+
+  return w->cb == uv__stream_io || w->cb == uv__udp_io;
+}
+
+
+/* Listening sockets are registered with EPOLLEXCLUSIVE so that when several
+ * loops share one, see benchmark-multi-accept.c, a new connection wakes up
+ * one of them and not all. It only matters for the loops that are blocked
+ * in epoll_wait(), a loop that is busy picks the connection up on its next
+ * poll. The kernel rejects it with events other than POLLIN and POLLOUT and
+ * for EPOLL_CTL_MOD, those watchers are deleted and added again instead.
+ * Kernels older than 4.5 ignore the flag.
+ */
+static int uv__epoll_exclusive(const uv__io_t* w) {
+  return w->cb == uv__server_io && (w->pevents & ~(POLLIN | POLLOUT)) == 0;
+}
+
+
+static void uv__epoll_dispatch_ready(uv_loop_t* loop, QUEUE* ready) {
+  QUEUE* q;
+  uv__io_t* w;
+  unsigned int events;
+
+  while (!QUEUE_EMPTY(ready)) {
+    q = QUEUE_HEAD(ready);
+    QUEUE_REMOVE(q);
+    QUEUE_INIT(q);
+
+    /* Only the events that were just added, the callbacks that ran before
+     * may have stopped some of them.
+     */
+    w = QUEUE_DATA(q, uv__io_t, watcher_queue);
+    events = w->pevents & ~w->events & (POLLIN | POLLOUT);
+    w->events = UV__POLLET | w->pevents;
+    if (events == 0)
+      continue;
+
+    /* Whether the peer hung up isn't known, assume it did. */
+    if (events & POLLIN)
+      events |= UV__POLLRDHUP;
+
+    uv__metrics_inc_events(loop, 1);
+    uv__io_dispatch(loop, w, events);
+  }
+}
+
+
 void uv__io_poll(uv_loop_t* loop, int timeout) {
   /* A bug in kernels < 2.6.37 makes timeouts larger than ~30 minutes
    * effectively infinite on 32 bits architectures.  To avoid blocking
@@ -114,17 +370,27 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   static int no_epoll_wait_cached;
   int no_epoll_pwait;
   int no_epoll_wait;
-  struct epoll_event events[1024];
+  struct epoll_event stack_events[1024];
+  struct epoll_event* events;
   struct epoll_event* pe;
   struct epoll_event e;
+  unsigned int revents;
   int real_timeout;
+  QUEUE ready;
   QUEUE* q;
   uv__io_t* w;
   sigset_t sigset;
   uint64_t sigmask;
+  uint64_t busy_poll;
+  uint64_t deadline;
   uint64_t base;
+  unsigned int ncallbacks;
+  int budgeted;
+  int spent;
   int have_signals;
+  int npasses;
   int nevents;
+  int capacity;
   int count;
   int nfds;
   int fd;
@@ -133,12 +399,21 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int user_timeout;
   int reset_timeout;
 
-  if (loop->nfds == 0) {
+  if (uv__iou_enabled(loop)) {
+    uv__iou_io_poll(loop, timeout);
+    return;
+  }
+
+  /* A loop that watches no file descriptors yet still sleeps until its
+   * next timer, see uv_loop_init().
+   */
+  if (loop->nfds == 0 && timeout == 0) {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
     return;
   }
 
   memset(&e, 0, sizeof(e));
+  QUEUE_INIT(&ready);
 
   while (!QUEUE_EMPTY(&loop->watcher_queue)) {
     q = QUEUE_HEAD(&loop->watcher_queue);
@@ -150,17 +425,53 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     assert(w->fd >= 0);
     assert(w->fd < (int) loop->nwatchers);
 
+    /* Edge-triggered watchers stay registered for everything, so changing
+     * their mask takes no system call. Readiness the kernel reported while
+     * the watcher wasn't interested isn't reported again, so assume it's
+     * there; a read or write that finds the socket not ready costs no more
+     * than an EPOLL_CTL_MOD would.
+     */
+    if (w->events & UV__POLLET) {
+      if (w->pevents & ~w->events & (POLLIN | POLLOUT)) {
+        /* Synced when dispatched, see uv__epoll_dispatch_ready(). */
+        w->events &= UV__POLLET | w->pevents;
+        QUEUE_INSERT_TAIL(&ready, q);
+      } else {
+        w->events = UV__POLLET | w->pevents;
+      }
+      continue;
+    }
+
+    /* Narrowing the event mask is done lazily: the kernel keeps reporting
+     * the old events, they're filtered out below and the EPOLL_CTL_MOD is
+     * only made when one of them actually fires. When the watcher widens
+     * its mask again before that happens, which is what a write-heavy
+     * stream toggling POLLOUT does, no system call is made at all.
+     */
+    if (w->events != 0 && (w->pevents & ~w->events) == 0)
+      continue;
+
     e.events = w->pevents;
     e.data.fd = w->fd;
 
+    /* Exclusive registrations can't be modified, only replaced. */
+    if (w->events & UV__POLLEXCLUSIVE) {
+      if (epoll_ctl(loop->backend_fd, EPOLL_CTL_DEL, w->fd, &e))
+        abort();
+      w->events = 0;
+    }
+
+    if (w->events == 0 && uv__epoll_edge_triggered(loop, w))
+      e.events |= POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLET;
+
+    if (w->events == 0 && uv__epoll_exclusive(w))
+      e.events |= UV__POLLEXCLUSIVE;
+
     if (w->events == 0)
       op = EPOLL_CTL_ADD;
     else
       op = EPOLL_CTL_MOD;
 
-    /* XXX Future optimization: do EPOLL_CTL_MOD lazily if we stop watching
-     * events, skip the syscall and squelch the events after epoll_wait().
-     */
     if (epoll_ctl(loop->backend_fd, op, w->fd, &e)) {
       if (errno != EEXIST)
         abort();
@@ -168,11 +479,24 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       assert(op == EPOLL_CTL_ADD);
 
       /* We've reactivated a file descriptor that's been watched before. */
-      if (epoll_ctl(loop->backend_fd, EPOLL_CTL_MOD, w->fd, &e))
+      if (e.events & UV__POLLEXCLUSIVE)
+        if (epoll_ctl(loop->backend_fd, EPOLL_CTL_DEL, w->fd, &e))
+          abort();
+
+      op = (e.events & UV__POLLEXCLUSIVE) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+      if (epoll_ctl(loop->backend_fd, op, w->fd, &e))
         abort();
     }
 
-    w->events = w->pevents;
+    w->events = w->pevents | (e.events & (UV__POLLET | UV__POLLEXCLUSIVE));
+  }
+
+  /* Report the assumed readiness. The watchers that the callbacks start
+   * are only registered by the next call, so don't block this time.
+   */
+  if (!QUEUE_EMPTY(&ready)) {
+    uv__epoll_dispatch_ready(loop, &ready);
+    timeout = 0;
   }
 
   sigmask = 0;
@@ -187,6 +511,12 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   count = 48; /* Benchmarks suggest this gives the best throughput. */
   real_timeout = timeout;
 
+  budgeted = uv__get_internal_fields(loop)->io_budget != 0 ||
+             uv__get_internal_fields(loop)->io_budget_time != 0;
+  deadline = 0;
+  ncallbacks = 0;
+  spent = 0;
+
   if (uv__get_internal_fields(loop)->flags & UV_METRICS_IDLE_TIME) {
     reset_timeout = 1;
     user_timeout = timeout;
@@ -205,7 +535,22 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   no_epoll_pwait = uv__load_relaxed(&no_epoll_pwait_cached);
   no_epoll_wait = uv__load_relaxed(&no_epoll_wait_cached);
 
+  /* Spinning needs the plain epoll_wait(), the signal mask would cost a
+   * system call per spin where epoll_pwait() isn't available.
+   */
+  busy_poll = uv__get_internal_fields(loop)->busy_poll;
+  if (sigmask != 0 || no_epoll_wait != 0)
+    busy_poll = 0;
+
   for (;;) {
+    /* Looked up every time, the last poll may have grown it. */
+    events = uv__get_internal_fields(loop)->poll_events;
+    capacity = uv__get_internal_fields(loop)->poll_nevents;
+    if (events == NULL) {
+      events = stack_events;
+      capacity = ARRAY_SIZE(stack_events);
+    }
+
     /* Only need to set the provider_entry_time if timeout != 0. The function
      * will return early if the loop isn't configured with UV_METRICS_IDLE_TIME.
      */
@@ -222,10 +567,20 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       if (pthread_sigmask(SIG_BLOCK, &sigset, NULL))
         abort();
 
-    if (no_epoll_wait != 0 || (sigmask != 0 && no_epoll_pwait == 0)) {
+    nfds = 0;
+    if (busy_poll != 0 && timeout != 0)
+      nfds = uv__epoll_busy_wait(loop,
+                                 events,
+                                 capacity,
+                                 busy_poll,
+                                 &timeout);
+
+    if (nfds != 0) {
+      /* Events or an error while spinning. */
+    } else if (no_epoll_wait != 0 || (sigmask != 0 && no_epoll_pwait == 0)) {
       nfds = epoll_pwait(loop->backend_fd,
                          events,
-                         ARRAY_SIZE(events),
+                         capacity,
                          timeout,
                          &sigset);
       if (nfds == -1 && errno == ENOSYS) {
@@ -235,7 +590,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     } else {
       nfds = epoll_wait(loop->backend_fd,
                         events,
-                        ARRAY_SIZE(events),
+                        capacity,
                         timeout);
       if (nfds == -1 && errno == ENOSYS) {
         uv__store_relaxed(&no_epoll_wait_cached, 1);
@@ -252,6 +607,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
      * operating system didn't reschedule our process while in the syscall.
      */
     SAVE_ERRNO(uv__update_time(loop));
+    uv__metrics_poll(loop, nfds, capacity);
 
     if (nfds == 0) {
       assert(timeout != -1);
@@ -301,21 +657,32 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     have_signals = 0;
     nevents = 0;
 
+    /* Counted from the end of the first poll that returned events. */
+    if (budgeted && ncallbacks == 0)
+      deadline = loop->time + uv__get_internal_fields(loop)->io_budget_time;
+
     {
       /* Squelch a -Waddress-of-packed-member warning with gcc >= 9. */
       union {
         struct epoll_event* events;
-        uv__io_t* watchers;
+        void* watchers;
       } x;
 
       x.events = events;
       assert(loop->watchers != NULL);
-      loop->watchers[loop->nwatchers] = x.watchers;
-      loop->watchers[loop->nwatchers + 1] = (void*) (uintptr_t) nfds;
+      uv__fd_map_events(loop) = x.watchers;
+      uv__fd_map_nevents(loop) = (void*) (uintptr_t) nfds;
     }
 
-    for (i = 0; i < nfds; i++) {
-      pe = events + i;
+    /* With I/O priorities the events are gone through once per priority,
+     * see uv_handle_set_io_priority().
+     */
+    npasses = 1;
+    if (uv__get_internal_fields(loop)->io_priorities != NULL)
+      npasses = ARRAY_SIZE(uv__epoll_pass);
+
+    for (i = 0; i < nfds * npasses; i++) {
+      pe = events + i % nfds;
       fd = pe->data.fd;
 
       /* Skip invalidated events, see uv__platform_invalidate_fd */
@@ -325,7 +692,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       assert(fd >= 0);
       assert((unsigned) fd < loop->nwatchers);
 
-      w = loop->watchers[fd];
+      w = uv__fd_watcher(loop, fd);
 
       if (w == NULL) {
         /* File descriptor that we've stopped watching, disarm it.
@@ -334,16 +701,30 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
          * when the file descriptor is closed.
          */
         epoll_ctl(loop->backend_fd, EPOLL_CTL_DEL, fd, pe);
+        pe->data.fd = -1;
         continue;
       }
 
+      if (npasses > 1) {
+        if (uv__epoll_pass[uv__io_priority(loop, fd)] != i / nfds)
+          continue;
+        pe->data.fd = -1;  /* Even if a callback changes its priority. */
+      }
+
       /* Give users only events they're interested in. Prevents spurious
        * callbacks when previous callback invocation in this loop has stopped
        * the current watcher. Also, filters out events that users has not
        * requested us to watch.
        */
+      revents = pe->events;
       pe->events &= w->pevents | POLLERR | POLLHUP;
 
+      /* The hangup tells edge-triggered streams to read on after a short
+       * read, the EOF won't be reported separately. See uv__read().
+       */
+      if ((w->events & UV__POLLET) && (pe->events & POLLIN))
+        pe->events |= revents & UV__POLLRDHUP;
+
       /* Work around an epoll quirk where it sometimes reports just the
        * EPOLLERR or EPOLLHUP event.  In order to force the event loop to
        * move forward, we merge in the read/write events that the watcher
@@ -363,21 +744,43 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         pe->events |=
           w->pevents & (POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI);
 
+      /* Only events we've stopped watching, see the lazy narrowing of the
+       * event mask above. Narrow it now to avoid spinning on them.
+       */
+      if (pe->events == 0 &&
+          w->events != w->pevents &&
+          !(w->events & (UV__POLLET | UV__POLLEXCLUSIVE))) {
+        e.events = w->pevents;
+        e.data.fd = fd;
+        if (epoll_ctl(loop->backend_fd, EPOLL_CTL_MOD, fd, &e) == 0)
+          w->events = w->pevents;
+      }
+
       if (pe->events != 0) {
         /* Run signal watchers last.  This also affects child process watchers
          * because those are implemented in terms of signal watchers.
          */
         if (w == &loop->signal_io_watcher) {
           have_signals = 1;
+        } else if (spent) {
+          /* Left for the next loop iteration, after the timers. The kernel
+           * reports level-triggered watchers again by itself.
+           */
+          uv__io_ready(loop, w, pe->events & (POLLIN | POLLOUT));
+          continue;
         } else {
           uv__metrics_update_idle_time(loop);
-          w->cb(loop, w, pe->events);
+          uv__io_dispatch(loop, w, pe->events);
+          if (budgeted)
+            spent = uv__epoll_budget_spent(loop, ++ncallbacks, deadline);
         }
 
         nevents++;
       }
     }
 
+    uv__metrics_inc_events(loop, nevents);
+
     if (reset_timeout != 0) {
       timeout = user_timeout;
       reset_timeout = 0;
@@ -385,17 +788,18 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
 
     if (have_signals != 0) {
       uv__metrics_update_idle_time(loop);
-      loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
+      uv__io_dispatch(loop, &loop->signal_io_watcher, POLLIN);
     }
 
-    loop->watchers[loop->nwatchers] = NULL;
-    loop->watchers[loop->nwatchers + 1] = NULL;
+    uv__fd_map_events(loop) = NULL;
+    uv__fd_map_nevents(loop) = NULL;
+    uv__epoll_buffer_update(loop, nfds);
 
-    if (have_signals != 0)
+    if (have_signals != 0 || spent)
       return;  /* Event loop should cycle now so don't poll again. */
 
     if (nevents != 0) {
-      if (nfds == ARRAY_SIZE(events) && --count != 0) {
+      if (nfds == capacity && --count != 0) {
         /* Poll for more events but don't block this time. */
         timeout = 0;
         continue;
@@ -26,6 +26,8 @@
  * getting the errno to the right place (req->result or as the return value.)
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
 #include "uv.h"
 #include "internal.h"
 
@@ -45,6 +47,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <poll.h>
+#include <sys/mman.h>
 
 #if defined(__DragonFly__)        ||                                      \
     defined(__FreeBSD__)          ||                                      \
@@ -58,6 +61,19 @@
 
 #if defined(__linux__)
 # include "sys/utsname.h"
+# include <sys/ioctl.h>
+# ifndef BLKSSZGET
+#  define BLKSSZGET _IO(0x12, 104)
+# endif
+# ifndef FALLOC_FL_KEEP_SIZE
+#  define FALLOC_FL_KEEP_SIZE 0x01
+# endif
+# ifndef FALLOC_FL_PUNCH_HOLE
+#  define FALLOC_FL_PUNCH_HOLE 0x02
+# endif
+# ifndef FALLOC_FL_ZERO_RANGE
+#  define FALLOC_FL_ZERO_RANGE 0x10
+# endif
 #endif
 
 #if defined(__linux__) || defined(__sun)
@@ -98,6 +114,9 @@
 extern char *mkdtemp(char *template); /* See issue #740 on AIX < 7 */
 #endif
 
+/* Set in req->flags by uv_fs_read_direct() and uv_fs_write_direct(). */
+#define UV__FS_DIRECT_IO 0x20000000
+
 #define INIT(subtype)                                                         \
   do {                                                                        \
     if (req == NULL)                                                          \
@@ -105,6 +124,7 @@ extern char *mkdtemp(char *template); /* See issue #740 on AIX < 7 */
     UV_REQ_INIT(req, UV_FS);                                                  \
     req->fs_type = UV_FS_ ## subtype;                                         \
     req->result = 0;                                                          \
+    req->flags = 0;                                                           \
     req->ptr = NULL;                                                          \
     req->loop = loop;                                                         \
     req->path = NULL;                                                         \
@@ -151,11 +171,12 @@ extern char *mkdtemp(char *template); /* See issue #740 on AIX < 7 */
   do {                                                                        \
     if (cb != NULL) {                                                         \
       uv__req_register(loop, req);                                            \
-      uv__work_submit(loop,                                                   \
-                      &req->work_req,                                         \
-                      UV__WORK_FAST_IO,                                       \
-                      uv__fs_work,                                            \
-                      uv__fs_done);                                           \
+      uv__work_submit_priority(loop,                                          \
+                               &req->work_req,                                \
+                               UV__WORK_FAST_IO,                              \
+                               uv__fs_work_priority(req->fs_type),            \
+                               uv__fs_work,                                   \
+                               uv__fs_done);                                  \
       return 0;                                                               \
     }                                                                         \
     else {                                                                    \
@@ -543,12 +564,148 @@ static int uv__fs_scandir_sort(UV_CONST_DIRENT** a, UV_CONST_DIRENT** b) {
 }
 
 
+#if defined(__linux__)
+/* Reads the directory with getdents64() and packs the entries and the
+ * pointer table into a single allocation, avoiding the per-entry malloc()
+ * that scandir(3) does. The block comes from the system allocator so that
+ * uv__fs_scandir_cleanup() can release it like a scandir(3) result.
+ */
+static ssize_t uv__fs_scandir_getdents(uv_fs_t* req) {
+  struct uv__dirent64* d;
+  uv__dirent_t** dents;
+  uv__dirent_t* dent;
+  size_t namelen;
+  size_t reclen;
+  size_t used;
+  size_t size;
+  size_t cap;
+  size_t off;
+  ssize_t nread;
+  ssize_t i;
+  char* recs;
+  char* tmp;
+  char* buf;
+  ssize_t n;
+  int saved;
+  int fd;
+
+  fd = uv__open_cloexec(req->path, O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    errno = -fd;
+    return -1;
+  }
+
+  buf = uv__malloc(32 * 1024);
+  recs = NULL;
+  used = 0;
+  cap = 0;
+  n = 0;
+
+  if (buf == NULL) {
+    errno = ENOMEM;
+    goto error;
+  }
+
+  for (;;) {
+    nread = uv__getdents64(fd, buf, 32 * 1024);
+    if (nread == -1 && errno == EINTR)
+      continue;
+    if (nread == -1)
+      goto error;
+    if (nread == 0)
+      break;
+
+    for (off = 0; off < (size_t) nread; off += d->d_reclen) {
+      d = (struct uv__dirent64*) (buf + off);
+      if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0)
+        continue;
+
+      namelen = strlen(d->d_name);
+      reclen = offsetof(uv__dirent_t, d_name) + namelen + 1;
+      reclen = (reclen + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+      if (used + reclen > cap) {
+        cap = cap == 0 ? 64 * 1024 : 2 * cap;
+        tmp = uv__realloc(recs, cap);
+        if (tmp == NULL) {
+          errno = ENOMEM;
+          goto error;
+        }
+        recs = tmp;
+      }
+
+      dent = (uv__dirent_t*) (recs + used);
+#ifdef HAVE_DIRENT_TYPES
+      dent->d_type = d->d_type;
+#endif
+      memcpy(dent->d_name, d->d_name, namelen + 1);
+      used += reclen;
+      n++;
+    }
+  }
+
+  uv__close(fd);
+  uv__free(buf);
+  fd = -1;
+  buf = NULL;
+
+  req->nbufs = 0;
+  req->ptr = NULL;
+
+  if (n == 0) {
+    uv__free(recs);
+    return 0;
+  }
+
+  size = n * sizeof(*dents);
+  dents = malloc(size + used);
+  if (dents == NULL) {
+    errno = ENOMEM;
+    goto error;
+  }
+
+  memcpy((char*) dents + size, recs, used);
+  uv__free(recs);
+
+  for (i = 0, off = size; i < n; i++) {
+    dent = (uv__dirent_t*) ((char*) dents + off);
+    dents[i] = dent;
+    reclen = offsetof(uv__dirent_t, d_name) + strlen(dent->d_name) + 1;
+    off += (reclen + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  }
+
+  req->flags |= UV__FS_SCANDIR_PACKED;
+  req->ptr = dents;
+
+  return n;
+
+error:
+  saved = errno;
+  if (fd != -1)
+    uv__close(fd);
+  uv__free(buf);
+  uv__free(recs);
+  errno = saved;
+  return -1;
+}
+#endif  /* defined(__linux__) */
+
+
 static ssize_t uv__fs_scandir(uv_fs_t* req) {
   uv__dirent_t** dents;
   int n;
 
-  dents = NULL;
-  n = scandir(req->path, &dents, uv__fs_scandir_filter, uv__fs_scandir_sort);
+  if (req->flags & UV_FS_SCANDIR_UNSORTED) {
+#if defined(__linux__)
+    return uv__fs_scandir_getdents(req);
+#else
+    dents = NULL;
+    n = scandir(req->path, &dents, uv__fs_scandir_filter, NULL);
+#endif
+  } else {
+    dents = NULL;
+    n = scandir(req->path, &dents, uv__fs_scandir_filter, uv__fs_scandir_sort);
+  }
 
   /* NOTE: We will use nbufs as an index field */
   req->nbufs = 0;
@@ -634,6 +791,59 @@ error:
   return -1;
 }
 
+/* Entries that don't fit stay in the directory stream for the next call. */
+static int uv__fs_readdir_packed(uv_fs_t* req) {
+  uv_dirent_packed_t* ent;
+  struct dirent* res;
+  uv_dir_t* dir;
+  size_t namelen;
+  size_t reclen;
+  size_t used;
+  char* buf;
+  long pos;
+  int n;
+
+  dir = req->ptr;
+  buf = req->bufsml[0].base;
+  used = 0;
+  n = 0;
+
+  for (;;) {
+    pos = telldir(dir->dir);
+    errno = 0;
+    res = readdir(dir->dir);
+
+    if (res == NULL) {
+      if (errno != 0)
+        return -1;
+      break;
+    }
+
+    if (strcmp(res->d_name, ".") == 0 || strcmp(res->d_name, "..") == 0)
+      continue;
+
+    namelen = strlen(res->d_name);
+    reclen = uv__dirent_packed_size(namelen);
+    if (reclen > req->bufsml[0].len - used) {
+      seekdir(dir->dir, pos);
+      if (n > 0)
+        break;
+      errno = ENOBUFS;
+      return -1;
+    }
+
+    ent = (uv_dirent_packed_t*) (buf + used);
+    ent->reclen = reclen;
+    ent->namelen = namelen;
+    ent->type = uv__fs_get_dirent_type(res);
+    memcpy(ent->name, res->d_name, namelen + 1);
+    used += reclen;
+    n++;
+  }
+
+  return n;
+}
+
 static int uv__fs_closedir(uv_fs_t* req) {
   uv_dir_t* dir;
 
@@ -1249,6 +1459,103 @@ done:
   return r;
 }
 
+/* Copies |len| bytes at |off| from |in| to the same offset in |out| without
+ * touching either file position, so several ranges can be copied in parallel.
+ */
+int uv__fs_copy_range(uv_file in, uv_file out, int64_t off, uint64_t len) {
+  off_t in_off;
+  off_t out_off;
+  ssize_t nread;
+  ssize_t nwritten;
+  ssize_t done;
+  size_t chunk;
+  char* buf;
+  int err;
+
+  in_off = off;
+  out_off = off;
+
+#ifdef __linux__
+  while (len > 0) {
+    chunk = len > SSIZE_MAX ? SSIZE_MAX : len;
+    nwritten = uv__fs_copy_file_range(in, &in_off, out, &out_off, chunk, 0);
+
+    if (nwritten == -1 && errno == EINTR)
+      continue;
+
+    if (nwritten == -1) {
+      /* Not supported between these files, fall back to reading and
+       * writing whatever is left.
+       */
+      if (errno == ENOSYS || errno == EXDEV || errno == EINVAL ||
+          errno == EOPNOTSUPP || errno == EPERM || errno == ETXTBSY)
+        break;
+      return UV__ERR(errno);
+    }
+
+    if (nwritten == 0)
+      return 0;  /* Source got shorter. */
+
+    len -= nwritten;
+  }
+
+  if (len == 0)
+    return 0;
+#endif
+
+  chunk = 1024 * 1024;
+  if (chunk > len)
+    chunk = len;
+
+  buf = uv__malloc(chunk);
+  if (buf == NULL)
+    return UV_ENOMEM;
+
+  err = 0;
+  while (len > 0) {
+    do
+      nread = pread(in, buf, len < chunk ? len : chunk, in_off);
+    while (nread == -1 && errno == EINTR);
+
+    if (nread <= 0) {
+      if (nread == -1)
+        err = UV__ERR(errno);
+      break;
+    }
+
+    for (done = 0; done < nread; done += nwritten) {
+      do
+        nwritten = pwrite(out, buf + done, nread - done, out_off + done);
+      while (nwritten == -1 && errno == EINTR);
+
+      if (nwritten == -1) {
+        err = UV__ERR(errno);
+        goto out;
+      }
+    }
+
+    in_off += nread;
+    out_off += nread;
+    len -= nread;
+  }
+
+out:
+  uv__free(buf);
+  return err;
+}
+
+
+int uv__fs_clone(uv_file in, uv_file out) {
+#ifdef FICLONE
+  if (ioctl(out, FICLONE, in) == 0)
+    return 0;
+  return UV__ERR(errno);
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
 static ssize_t uv__fs_copyfile(uv_fs_t* req) {
   uv_fs_t fs_req;
   uv_file srcfd;
@@ -1493,36 +1800,54 @@ static void uv__to_stat(struct stat* src, uv_stat_t* dst) {
 }
 
 
-static int uv__fs_statx(int fd,
-                        const char* path,
-                        int is_fstat,
-                        int is_lstat,
-                        uv_stat_t* buf) {
+#ifdef __linux__
+void uv__statx_to_stat(const struct uv__statx* statxbuf, uv_stat_t* buf) {
+  buf->st_dev = makedev(statxbuf->stx_dev_major, statxbuf->stx_dev_minor);
+  buf->st_mode = statxbuf->stx_mode;
+  buf->st_nlink = statxbuf->stx_nlink;
+  buf->st_uid = statxbuf->stx_uid;
+  buf->st_gid = statxbuf->stx_gid;
+  buf->st_rdev = makedev(statxbuf->stx_rdev_major, statxbuf->stx_rdev_minor);
+  buf->st_ino = statxbuf->stx_ino;
+  buf->st_size = statxbuf->stx_size;
+  buf->st_blksize = statxbuf->stx_blksize;
+  buf->st_blocks = statxbuf->stx_blocks;
+  buf->st_atim.tv_sec = statxbuf->stx_atime.tv_sec;
+  buf->st_atim.tv_nsec = statxbuf->stx_atime.tv_nsec;
+  buf->st_mtim.tv_sec = statxbuf->stx_mtime.tv_sec;
+  buf->st_mtim.tv_nsec = statxbuf->stx_mtime.tv_nsec;
+  buf->st_ctim.tv_sec = statxbuf->stx_ctime.tv_sec;
+  buf->st_ctim.tv_nsec = statxbuf->stx_ctime.tv_nsec;
+  buf->st_birthtim.tv_sec = statxbuf->stx_btime.tv_sec;
+  buf->st_birthtim.tv_nsec = statxbuf->stx_btime.tv_nsec;
+  buf->st_flags = 0;
+  buf->st_gen = 0;
+}
+#endif
+
+
+/* Asks for the fields in |*mask| and stores the ones that were filled in
+ * there on success.
+ */
+static int uv__fs_statx_mask(int dirfd,
+                             const char* path,
+                             int flags,
+                             unsigned int* mask,
+                             uv_stat_t* buf) {
   STATIC_ASSERT(UV_ENOSYS != -1);
 #ifdef __linux__
   static int no_statx;
   struct uv__statx statxbuf;
-  int dirfd;
-  int flags;
-  int mode;
   int rc;
 
   if (uv__load_relaxed(&no_statx))
     return UV_ENOSYS;
 
-  dirfd = AT_FDCWD;
-  flags = 0; /* AT_STATX_SYNC_AS_STAT */
-  mode = 0xFFF; /* STATX_BASIC_STATS + STATX_BTIME */
-
-  if (is_fstat) {
-    dirfd = fd;
-    flags |= 0x1000; /* AT_EMPTY_PATH */
-  }
+  /* The fields that weren't asked for aren't necessarily written. */
+  if (*mask != UV_STATX_ALL)
+    memset(&statxbuf, 0, sizeof(statxbuf));
 
-  if (is_lstat)
-    flags |= AT_SYMLINK_NOFOLLOW;
-
-  rc = uv__statx(dirfd, path, flags, mode, &statxbuf);
+  rc = uv__statx(dirfd, path, flags, *mask, &statxbuf);
 
   switch (rc) {
   case 0:
@@ -1545,26 +1870,8 @@ static int uv__fs_statx(int fd,
     return UV_ENOSYS;
   }
 
-  buf->st_dev = makedev(statxbuf.stx_dev_major, statxbuf.stx_dev_minor);
-  buf->st_mode = statxbuf.stx_mode;
-  buf->st_nlink = statxbuf.stx_nlink;
-  buf->st_uid = statxbuf.stx_uid;
-  buf->st_gid = statxbuf.stx_gid;
-  buf->st_rdev = makedev(statxbuf.stx_rdev_major, statxbuf.stx_rdev_minor);
-  buf->st_ino = statxbuf.stx_ino;
-  buf->st_size = statxbuf.stx_size;
-  buf->st_blksize = statxbuf.stx_blksize;
-  buf->st_blocks = statxbuf.stx_blocks;
-  buf->st_atim.tv_sec = statxbuf.stx_atime.tv_sec;
-  buf->st_atim.tv_nsec = statxbuf.stx_atime.tv_nsec;
-  buf->st_mtim.tv_sec = statxbuf.stx_mtime.tv_sec;
-  buf->st_mtim.tv_nsec = statxbuf.stx_mtime.tv_nsec;
-  buf->st_ctim.tv_sec = statxbuf.stx_ctime.tv_sec;
-  buf->st_ctim.tv_nsec = statxbuf.stx_ctime.tv_nsec;
-  buf->st_birthtim.tv_sec = statxbuf.stx_btime.tv_sec;
-  buf->st_birthtim.tv_nsec = statxbuf.stx_btime.tv_nsec;
-  buf->st_flags = 0;
-  buf->st_gen = 0;
+  uv__statx_to_stat(&statxbuf, buf);
+  *mask = statxbuf.stx_mask;
 
   return 0;
 #else
@@ -1573,6 +1880,29 @@ static int uv__fs_statx(int fd,
 }
 
 
+static int uv__fs_statx(int fd,
+                        const char* path,
+                        int is_fstat,
+                        int is_lstat,
+                        uv_stat_t* buf) {
+  unsigned int mask;
+  int dirfd;
+  int flags;
+
+  dirfd = fd == -1 ? AT_FDCWD : fd;
+  flags = 0; /* AT_STATX_SYNC_AS_STAT */
+  mask = UV_STATX_ALL; /* STATX_BASIC_STATS + STATX_BTIME */
+
+  if (is_fstat)
+    flags |= 0x1000; /* AT_EMPTY_PATH */
+
+  if (is_lstat)
+    flags |= AT_SYMLINK_NOFOLLOW;
+
+  return uv__fs_statx_mask(dirfd, path, flags, &mask, buf);
+}
+
+
 static int uv__fs_stat(const char *path, uv_stat_t *buf) {
   struct stat pbuf;
   int ret;
@@ -1589,94 +1919,1106 @@ static int uv__fs_stat(const char *path, uv_stat_t *buf) {
 }
 
 
-static int uv__fs_lstat(const char *path, uv_stat_t *buf) {
-  struct stat pbuf;
-  int ret;
+static ssize_t uv__fs_mmap(uv_fs_t* req) {
+  struct stat statbuf;
+  size_t length;
+  size_t delta;
+  char* base;
+  int flags;
+  int prot;
 
-  ret = uv__fs_statx(-1, path, /* is_fstat */ 0, /* is_lstat */ 1, buf);
-  if (ret != UV_ENOSYS)
-    return ret;
+  length = req->bufsml[0].len;
+  if (req->off < 0)
+    return errno = EINVAL, -1;
 
-  ret = lstat(path, &pbuf);
-  if (ret == 0)
-    uv__to_stat(&pbuf, buf);
+  if (length == 0) {
+    if (fstat(req->file, &statbuf))
+      return -1;
 
-  return ret;
-}
+    if (req->off >= statbuf.st_size)
+      return errno = EINVAL, -1;
 
+    length = statbuf.st_size - req->off;
+  }
 
-static int uv__fs_fstat(int fd, uv_stat_t *buf) {
-  struct stat pbuf;
-  int ret;
+  /* mmap() wants a page aligned offset, map from the start of the page. */
+  delta = req->off % getpagesize();
 
-  ret = uv__fs_statx(fd, "", /* is_fstat */ 1, /* is_lstat */ 0, buf);
-  if (ret != UV_ENOSYS)
-    return ret;
+  prot = PROT_READ;
+  if (req->flags & UV_FS_MMAP_WRITE)
+    prot |= PROT_WRITE;
 
-  ret = fstat(fd, &pbuf);
-  if (ret == 0)
-    uv__to_stat(&pbuf, buf);
+  flags = MAP_SHARED;
+#if defined(MAP_POPULATE)
+  if (req->flags & UV_FS_MMAP_POPULATE)
+    flags |= MAP_POPULATE;
+#endif
 
-  return ret;
-}
+  base = mmap(NULL, length + delta, prot, flags, req->file, req->off - delta);
+  if (base == MAP_FAILED)
+    return -1;
 
-static size_t uv__fs_buf_offset(uv_buf_t* bufs, size_t size) {
-  size_t offset;
-  /* Figure out which bufs are done */
-  for (offset = 0; size > 0 && bufs[offset].len <= size; ++offset)
-    size -= bufs[offset].len;
+#if !defined(MAP_POPULATE)
+  /* Fault the pages in now, on the threadpool, rather than on first access
+   * from the loop thread.
+   */
+  if (req->flags & UV_FS_MMAP_POPULATE) {
+    size_t off;
 
-  /* Fix a partial read/write */
-  if (size > 0) {
-    bufs[offset].base += size;
-    bufs[offset].len -= size;
+    for (off = 0; off < length + delta; off += getpagesize())
+      *(volatile char*) (base + off);
   }
-  return offset;
+#endif
+
+  req->ptr = base + delta;
+  return length;
 }
 
-static ssize_t uv__fs_write_all(uv_fs_t* req) {
-  unsigned int iovmax;
-  unsigned int nbufs;
-  uv_buf_t* bufs;
-  ssize_t total;
-  ssize_t result;
 
-  iovmax = uv__getiovmax();
-  nbufs = req->nbufs;
-  bufs = req->bufs;
-  total = 0;
+static int uv__fs_munmap(uv_fs_t* req) {
+  size_t delta;
+  char* addr;
 
-  while (nbufs > 0) {
-    req->nbufs = nbufs;
-    if (req->nbufs > iovmax)
-      req->nbufs = iovmax;
+  addr = req->bufsml[0].base;
+  delta = (uintptr_t) addr % getpagesize();
 
-    do
-      result = uv__fs_write(req);
-    while (result < 0 && errno == EINTR);
+  return munmap(addr - delta, req->bufsml[0].len + delta);
+}
 
-    if (result <= 0) {
-      if (total == 0)
-        total = result;
-      break;
-    }
 
-    if (req->off >= 0)
-      req->off += result;
+int uv_fs_get_dio_alignment(uv_file file,
+                            size_t* mem_align,
+                            size_t* offset_align) {
+  struct stat statbuf;
+#if defined(__linux__)
+  struct uv__statx statxbuf;
+  int sector_size;
+#endif
 
-    req->nbufs = uv__fs_buf_offset(req->bufs, result);
+  if (mem_align == NULL || offset_align == NULL)
+    return UV_EINVAL;
+
+#if defined(__linux__)
+  /* STATX_DIOALIGN, Linux 6.1+. */
+  if (0 == uv__statx(file, "", 0x1000 /* AT_EMPTY_PATH */,
+                     0x2000 /* STATX_DIOALIGN */, &statxbuf) &&
+      (statxbuf.stx_mask & 0x2000)) {
+    if (statxbuf.stx_dio_mem_align == 0)
+      return UV_ENOTSUP;  /* File system doesn't do direct I/O. */
+    *mem_align = statxbuf.stx_dio_mem_align;
+    *offset_align = statxbuf.stx_dio_offset_align;
+    return 0;
+  }
+#endif
+
+  if (fstat(file, &statbuf))
+    return UV__ERR(errno);
+
+#if defined(__linux__)
+  if (S_ISBLK(statbuf.st_mode)) {
+    if (ioctl(file, BLKSSZGET, &sector_size))
+      return UV__ERR(errno);
+    *mem_align = sector_size;
+    *offset_align = sector_size;
+    return 0;
+  }
+#endif
+
+  /* The preferred I/O size is a multiple of the logical block size on all
+   * file systems that matter, and the page size is a safe buffer alignment.
+   */
+  *offset_align = statbuf.st_blksize > 0 ? statbuf.st_blksize : 4096;
+  *mem_align = getpagesize();
+  if (*mem_align > *offset_align)
+    *mem_align = *offset_align;
+
+  return 0;
+}
+
+
+/* Positional reads and writes for uv_fs_read_direct() and uv_fs_write_direct().
+ * The request is checked against the alignment rules of the file first, then
+ * carried out one buffer at a time, resuming after short transfers for as
+ * long as they leave the file offset aligned.
+ */
+static ssize_t uv__fs_direct_io(uv_fs_t* req, int is_read) {
+  size_t offset_align;
+  size_t mem_align;
+  unsigned int i;
+  ssize_t total;
+  ssize_t r;
+  size_t done;
+  off_t off;
+  char* base;
+  int err;
+
+  err = uv_fs_get_dio_alignment(req->file, &mem_align, &offset_align);
+  if (err == 0)
+    err = uv__fs_dio_check(req->bufs,
+                           req->nbufs,
+                           req->off,
+                           mem_align,
+                           offset_align);
+  if (err) {
+    total = -1;
+    errno = -err;
+    goto out;
+  }
+
+  total = 0;
+  off = req->off;
+
+  for (i = 0; i < req->nbufs; i++) {
+    base = req->bufs[i].base;
+    done = 0;
+
+    while (done < req->bufs[i].len) {
+      if (is_read)
+        r = pread(req->file, base + done, req->bufs[i].len - done, off);
+      else
+        r = pwrite(req->file, base + done, req->bufs[i].len - done, off);
+
+      if (r == -1 && errno == EINTR)
+        continue;
+
+      if (r == -1) {
+        if (total == 0)
+          total = -1;
+        goto out;
+      }
+
+      if (r == 0)
+        goto out;  /* End of file. */
+
+      done += r;
+      off += r;
+      total += r;
+
+      /* An unaligned short transfer can't be continued, it's the tail of
+       * the file for reads.
+       */
+      if ((size_t) r % offset_align != 0)
+        goto out;
+    }
+  }
+
+out:
+  if (req->bufs != req->bufsml)
+    uv__free(req->bufs);
+
+  req->bufs = NULL;
+  req->nbufs = 0;
+
+  return total;
+}
+
+
+static int uv__fs_readahead(uv_fs_t* req) {
+#if defined(__linux__)
+  int r;
+
+  /* readahead() has no "up to the end of the file" length. */
+  if (req->bufsml[0].len != 0)
+    return readahead(req->file, req->off, req->bufsml[0].len);
+
+  r = posix_fadvise(req->file, req->off, 0, POSIX_FADV_WILLNEED);
+  if (r != 0)
+    return errno = r, -1;
+
+  return 0;
+#elif defined(__APPLE__)
+  struct radvisory ra;
+
+  ra.ra_offset = req->off;
+  ra.ra_count = req->bufsml[0].len;
+  if (req->bufsml[0].len == 0 || req->bufsml[0].len > INT_MAX)
+    ra.ra_count = INT_MAX;
+
+  return fcntl(req->file, F_RDADVISE, &ra);
+#elif defined(POSIX_FADV_WILLNEED)
+  int r;
+
+  r = posix_fadvise(req->file, req->off, req->bufsml[0].len,
+                    POSIX_FADV_WILLNEED);
+  if (r != 0)
+    return errno = r, -1;
+
+  return 0;
+#else
+  return 0;
+#endif
+}
+
+
+static int uv__fs_fadvise(uv_fs_t* req) {
+#if defined(POSIX_FADV_NORMAL)
+  int advice;
+  int r;
+
+  switch (req->flags) {
+    case UV_FS_FADV_NORMAL:
+      advice = POSIX_FADV_NORMAL;
+      break;
+    case UV_FS_FADV_SEQUENTIAL:
+      advice = POSIX_FADV_SEQUENTIAL;
+      break;
+    case UV_FS_FADV_RANDOM:
+      advice = POSIX_FADV_RANDOM;
+      break;
+    case UV_FS_FADV_NOREUSE:
+      advice = POSIX_FADV_NOREUSE;
+      break;
+    case UV_FS_FADV_WILLNEED:
+      advice = POSIX_FADV_WILLNEED;
+      break;
+    case UV_FS_FADV_DONTNEED:
+      advice = POSIX_FADV_DONTNEED;
+      break;
+    default:
+      return errno = EINVAL, -1;
+  }
+
+  /* posix_fadvise() returns the error instead of setting errno. */
+  r = posix_fadvise(req->file, req->off, req->bufsml[0].len, advice);
+  if (r != 0)
+    return errno = r, -1;
+
+  return 0;
+#else
+  if (req->flags == UV_FS_FADV_WILLNEED)
+    return uv__fs_readahead(req);
+
+  return 0;
+#endif
+}
+
+
+static int uv__fs_fallocate(uv_fs_t* req) {
+  int64_t len;
+  int r;
+
+  len = (int64_t) (((uint64_t) req->bufsml[1].len << 32) | req->bufsml[0].len);
+
+#if defined(__linux__)
+  {
+    int mode;
+
+    mode = 0;
+    if (req->flags & UV_FS_FALLOCATE_KEEP_SIZE)
+      mode |= FALLOC_FL_KEEP_SIZE;
+    if (req->flags & UV_FS_FALLOCATE_PUNCH_HOLE)
+      mode |= FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE;
+    if (req->flags & UV_FS_FALLOCATE_ZERO_RANGE)
+      mode |= FALLOC_FL_ZERO_RANGE;
+
+    r = fallocate(req->file, mode, req->off, len);
+    if (r == 0 || errno != EOPNOTSUPP || mode != 0)
+      return r;
+  }
+#elif defined(__APPLE__)
+  if (req->flags & UV_FS_FALLOCATE_PUNCH_HOLE) {
+# if defined(F_PUNCHHOLE)
+    fpunchhole_t hole;
+
+    memset(&hole, 0, sizeof(hole));
+    hole.fp_offset = req->off;
+    hole.fp_length = len;
+    return fcntl(req->file, F_PUNCHHOLE, &hole);
+# else
+    return errno = ENOTSUP, -1;
+# endif
+  }
+
+  if (req->flags & UV_FS_FALLOCATE_ZERO_RANGE)
+    return errno = ENOTSUP, -1;
+
+  {
+    struct stat st;
+    fstore_t store;
+
+    if (fstat(req->file, &st))
+      return -1;
+
+    if (req->off + len <= st.st_size)
+      return 0;
+
+    /* F_PEOFPOSMODE allocates from the physical end of the file. Ask for a
+     * contiguous extent first, then settle for whatever is available.
+     */
+    memset(&store, 0, sizeof(store));
+    store.fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL;
+    store.fst_posmode = F_PEOFPOSMODE;
+    store.fst_offset = 0;
+    store.fst_length = req->off + len - st.st_size;
+
+    r = fcntl(req->file, F_PREALLOCATE, &store);
+    if (r == -1) {
+      store.fst_flags = F_ALLOCATEALL;
+      r = fcntl(req->file, F_PREALLOCATE, &store);
+    }
+
+    if (r == -1)
+      return -1;
+
+    if (req->flags & UV_FS_FALLOCATE_KEEP_SIZE)
+      return 0;
+
+    return ftruncate(req->file, req->off + len);
+  }
+#endif
+
+#if !defined(__APPLE__)
+  if (req->flags != 0)
+    return errno = ENOTSUP, -1;
+
+  /* posix_fallocate() returns the error instead of setting errno. */
+  r = posix_fallocate(req->file, req->off, len);
+  if (r != 0)
+    return errno = r, -1;
+
+  return 0;
+#endif
+}
+
+
+static ssize_t uv__fs_stat_many(uv_fs_t* req) {
+  struct uv__fs_stat_many* sm;
+  unsigned int i;
+  ssize_t n;
+  int r;
+
+  sm = req->ptr;
+  n = 0;
+
+  for (i = 0; i < sm->npaths; i++) {
+    do
+      r = uv__fs_stat(sm->paths[i], &sm->statbufs[i]);
+    while (r == -1 && errno == EINTR);
+
+    if (r == -1)
+      r = UV__ERR(errno);
+    else if (r == 0)
+      n++;
+
+    sm->results[i] = r;
+  }
+
+  return n;
+}
+
+
+/* uv_fs_statx(), returns the mask of the fields that were filled in. */
+static int uv__fs_statx_fields(uv_fs_t* req) {
+  struct stat pbuf;
+  unsigned int mask;
+  int flags;
+  int ret;
+
+  flags = 0;
+  if (req->flags & UV_FS_STATX_NOFOLLOW)
+    flags |= AT_SYMLINK_NOFOLLOW;
+  if (req->flags & UV_FS_STATX_DONT_SYNC)
+    flags |= 0x4000; /* AT_STATX_DONT_SYNC */
+  if (req->flags & UV_FS_STATX_FORCE_SYNC)
+    flags |= 0x2000; /* AT_STATX_FORCE_SYNC */
+
+  mask = req->mode;
+  ret = uv__fs_statx_mask(AT_FDCWD, req->path, flags, &mask, &req->statbuf);
+  if (ret == 0)
+    return mask & UV_STATX_ALL;
+  if (ret != UV_ENOSYS)
+    return ret;
+
+  /* stat() has no say in what it fetches, it fills in everything. */
+  if (req->flags & UV_FS_STATX_NOFOLLOW)
+    ret = lstat(req->path, &pbuf);
+  else
+    ret = stat(req->path, &pbuf);
+  if (ret != 0)
+    return ret;
+
+  uv__to_stat(&pbuf, &req->statbuf);
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__)
+  return UV_STATX_ALL;
+#else
+  return UV_STATX_BASIC_STATS;
+#endif
+}
+
+
+static int uv__fs_lstat(const char *path, uv_stat_t *buf) {
+  struct stat pbuf;
+  int ret;
+
+  ret = uv__fs_statx(-1, path, /* is_fstat */ 0, /* is_lstat */ 1, buf);
+  if (ret != UV_ENOSYS)
+    return ret;
+
+  ret = lstat(path, &pbuf);
+  if (ret == 0)
+    uv__to_stat(&pbuf, buf);
+
+  return ret;
+}
+
+
+static int uv__fs_fstat(int fd, uv_stat_t *buf) {
+  struct stat pbuf;
+  int ret;
+
+  ret = uv__fs_statx(fd, "", /* is_fstat */ 1, /* is_lstat */ 0, buf);
+  if (ret != UV_ENOSYS)
+    return ret;
+
+  ret = fstat(fd, &pbuf);
+  if (ret == 0)
+    uv__to_stat(&pbuf, buf);
+
+  return ret;
+}
+
+
+/* The *at() requests keep the directory in req->file and their UV_FS_AT_*
+ * flags in req->off.
+ */
+#if defined(__linux__)
+/* Resolves |path| with RESOLVE_BENEATH, which fails with EXDEV for absolute
+ * paths, for ".." past |dir| and for symlinks that lead out of it.
+ */
+static int uv__fs_open_beneath(int dir, const char* path, int flags, int mode) {
+  struct uv__open_how how;
+
+  memset(&how, 0, sizeof(how));
+  how.flags = flags | O_CLOEXEC;
+  if (flags & O_CREAT)
+    how.mode = mode;
+  how.resolve = UV__RESOLVE_BENEATH;
+
+  return uv__openat2(dir, path, &how);
+}
+#endif  /* defined(__linux__) */
+
+
+static ssize_t uv__fs_openat(uv_fs_t* req) {
+  int r;
+
+  if (req->off & UV_FS_AT_BENEATH) {
+#if defined(__linux__)
+    return uv__fs_open_beneath(req->file, req->path, req->flags, req->mode);
+#else
+    return errno = ENOSYS, -1;
+#endif
+  }
+
+#ifdef O_CLOEXEC
+  r = openat(req->file, req->path, req->flags | O_CLOEXEC, req->mode);
+#else
+  r = openat(req->file, req->path, req->flags, req->mode);
+  if (r >= 0 && uv__cloexec(r, 1)) {
+    uv__close(r);
+    r = -1;
+  }
+#endif
+
+  return r;
+}
+
+
+static ssize_t uv__fs_statat(uv_fs_t* req) {
+  struct stat pbuf;
+  int nofollow;
+  int ret;
+#if defined(__linux__)
+  int fd;
+#endif
+
+  nofollow = req->off & UV_FS_AT_SYMLINK_NOFOLLOW;
+
+  if (req->off & UV_FS_AT_BENEATH) {
+#if defined(__linux__)
+    /* An O_PATH descriptor of the link itself with O_NOFOLLOW. */
+    fd = uv__fs_open_beneath(req->file,
+                             req->path,
+                             O_PATH | (nofollow ? O_NOFOLLOW : 0),
+                             0);
+    if (fd == -1)
+      return -1;
+
+    ret = uv__fs_fstat(fd, &req->statbuf);
+    uv__close(fd);
+    return ret;
+#else
+    return errno = ENOSYS, -1;
+#endif
+  }
+
+  ret = uv__fs_statx(req->file,
+                     req->path,
+                     /* is_fstat */ 0,
+                     nofollow,
+                     &req->statbuf);
+  if (ret != UV_ENOSYS)
+    return ret;
+
+  ret = fstatat(req->file,
+                req->path,
+                &pbuf,
+                nofollow ? AT_SYMLINK_NOFOLLOW : 0);
+  if (ret == 0)
+    uv__to_stat(&pbuf, &req->statbuf);
+
+  return ret;
+}
+
+
+/* uv_fs_unlinkat() and uv_fs_mkdirat(), on the name |name| in |dir|. */
+static int uv__fs_at_name(uv_fs_t* req, int dir, const char* name) {
+  if (req->fs_type == UV_FS_MKDIRAT)
+    return mkdirat(dir, name, req->mode);
+
+  return unlinkat(dir,
+                  name,
+                  req->off & UV_FS_AT_REMOVEDIR ? AT_REMOVEDIR : 0);
+}
+
+
+/* Neither operation follows the last component, so with UV_FS_AT_BENEATH
+ * it's enough to resolve the parent directory beneath |dir|. The name itself
+ * can't be "..", that would be the directory above.
+ */
+static ssize_t uv__fs_at(uv_fs_t* req) {
+#if defined(__linux__)
+  char* parent;
+  char* name;
+  size_t len;
+  int saved;
+  int dir;
+  int r;
+
+  if (!(req->off & UV_FS_AT_BENEATH))
+    return uv__fs_at_name(req, req->file, req->path);
+
+  parent = uv__strdup(req->path);
+  if (parent == NULL)
+    return errno = ENOMEM, -1;
+
+  len = strlen(parent);
+  while (len > 1 && parent[len - 1] == '/')
+    parent[--len] = '\0';
+
+  dir = req->file;
+  name = strrchr(parent, '/');
+  if (name == NULL) {
+    name = parent;
+  } else if (name == parent) {
+    uv__free(parent);
+    return errno = EXDEV, -1;  /* Absolute. */
+  } else {
+    *name++ = '\0';
+    dir = uv__fs_open_beneath(req->file, parent, O_PATH | O_DIRECTORY, 0);
+    if (dir == -1) {
+      uv__free(parent);
+      return -1;
+    }
+  }
+
+  if (strcmp(name, "..") == 0)
+    r = (errno = EXDEV, -1);
+  else
+    r = uv__fs_at_name(req, dir, name);
+
+  saved = errno;
+  if (dir != req->file)
+    uv__close(dir);
+  uv__free(parent);
+  errno = saved;
+
+  return r;
+#else
+  if (req->off & UV_FS_AT_BENEATH)
+    return errno = ENOSYS, -1;
+
+  return uv__fs_at_name(req, req->file, req->path);
+#endif
+}
+
+
+/* Creates the parents that are missing as well, with search and write
+ * permission for the owner like mkdir -p does. An existing directory is
+ * not an error.
+ */
+static int uv__fs_mkdir_p(uv_fs_t* req) {
+  struct stat pbuf;
+  char* path;
+  char* p;
+  int saved;
+  int r;
+
+  if (mkdir(req->path, req->mode) == 0)
+    return 0;
+
+  if (errno == ENOENT) {
+    path = uv__strdup(req->path);
+    if (path == NULL)
+      return errno = ENOMEM, -1;
+
+    r = 0;
+    for (p = path; r == 0 && *p != '\0'; p++) {
+      if (p == path || *p != '/' || p[-1] == '/')
+        continue;
+
+      *p = '\0';
+      r = mkdir(path, req->mode | S_IWUSR | S_IXUSR);
+      /* A file in the way makes the last mkdir() fail with ENOTDIR. Other
+       * errors, like EACCES, are fine for parents that exist.
+       */
+      if (r == -1 && errno != EEXIST) {
+        saved = errno;
+        if (stat(path, &pbuf) == 0 && S_ISDIR(pbuf.st_mode))
+          r = 0;
+        else
+          errno = saved;
+      } else {
+        r = 0;
+      }
+      *p = '/';
+    }
+
+    saved = errno;
+    uv__free(path);
+    errno = saved;
+
+    if (r == -1)
+      return -1;
+
+    if (mkdir(req->path, req->mode) == 0)
+      return 0;
+  }
+
+  if (errno != EEXIST)
+    return -1;
+
+  if (stat(req->path, &pbuf))
+    return -1;
+
+  if (!S_ISDIR(pbuf.st_mode))
+    return errno = EEXIST, -1;
+
+  return 0;
+}
+
+
+/* Removes what's in the directory |name| in |parent| and then the directory.
+ * Directories are opened relative to their parent, so the walk builds no
+ * paths and doesn't follow symbolic links. It holds a descriptor per level.
+ */
+static int uv__fs_rm_tree(int parent, const char* name) {
+  uv__dirent_t* ent;
+  struct stat pbuf;
+  unsigned int removed;
+  DIR* dir;
+  int isdir;
+  int saved;
+  int fd;
+  int r;
+
+  fd = openat(parent, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd == -1)
+    return -1;
+
+  dir = fdopendir(fd);
+  if (dir == NULL) {
+    saved = errno;
+    uv__close(fd);
+    errno = saved;
+    return -1;
+  }
+
+  for (;;) {
+    removed = 0;
+    r = 0;
+
+    for (;;) {
+      errno = 0;
+      ent = readdir(dir);
+      if (ent == NULL) {
+        if (errno != 0)
+          r = -1;
+        break;
+      }
+
+      if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+        continue;
+
+#ifdef HAVE_DIRENT_TYPES
+      isdir = ent->d_type == UV__DT_DIR;
+#else
+      isdir = 0;
+#endif
+
+      if (!isdir) {
+        if (unlinkat(fd, ent->d_name, 0) == 0 || errno == ENOENT) {
+          removed++;
+          continue;
+        }
+
+        /* EISDIR on Linux, EPERM elsewhere, if it's a directory after all. */
+        saved = errno;
+        if (fstatat(fd, ent->d_name, &pbuf, AT_SYMLINK_NOFOLLOW) ||
+            !S_ISDIR(pbuf.st_mode)) {
+          errno = saved;
+          r = -1;
+          break;
+        }
+      }
+
+      if (uv__fs_rm_tree(fd, ent->d_name) && errno != ENOENT) {
+        r = -1;
+        break;
+      }
+
+      removed++;
+    }
+
+    if (r == 0)
+      r = unlinkat(parent, name, AT_REMOVEDIR);
+
+    /* Some file systems skip entries when the directory changes while it's
+     * read. Go over it again for as long as that gets somewhere.
+     */
+    if (r == -1 && (errno == ENOTEMPTY || errno == EEXIST) && removed > 0) {
+      rewinddir(dir);
+      continue;
+    }
+
+    break;
+  }
+
+  saved = errno;
+  closedir(dir);
+  errno = saved;
+
+  return r;
+}
+
+
+/* Like rm -rf, it's not an error when |req->path| doesn't exist. */
+static int uv__fs_rm_rf(uv_fs_t* req) {
+  struct stat pbuf;
+  int r;
+
+  if (lstat(req->path, &pbuf))
+    return errno == ENOENT ? 0 : -1;
+
+  if (S_ISDIR(pbuf.st_mode))
+    r = uv__fs_rm_tree(AT_FDCWD, req->path);
+  else
+    r = unlink(req->path);
+
+  if (r == -1 && errno == ENOENT)
+    r = 0;
+
+  return r;
+}
+
+static size_t uv__fs_buf_offset(uv_buf_t* bufs, size_t size) {
+  size_t offset;
+  /* Figure out which bufs are done */
+  for (offset = 0; size > 0 && bufs[offset].len <= size; ++offset)
+    size -= bufs[offset].len;
+
+  /* Fix a partial read/write */
+  if (size > 0) {
+    bufs[offset].base += size;
+    bufs[offset].len -= size;
+  }
+  return offset;
+}
+
+/* Applies the segments in order. Stops at the first error, earlier segments
+ * stay written.
+ */
+static ssize_t uv__fs_write_batch(uv_fs_t* req) {
+  struct uv__fs_write_batch* wb;
+  unsigned int iovmax;
+  unsigned int nbufs;
+  unsigned int n;
+  uv_buf_t* bufs;
+  ssize_t total;
+  ssize_t result;
+  unsigned int i;
+
+  wb = req->ptr;
+  iovmax = uv__getiovmax();
+  total = wb->written;
+
+  for (i = 0; i < wb->nsegs; i++) {
+    /* Cast away the const, the buffer descriptors are a private copy. */
+    bufs = (uv_buf_t*) wb->segs[i].bufs;
+    nbufs = wb->segs[i].nbufs;
+    req->off = wb->segs[i].offset;
+
+    while (nbufs > 0) {
+      req->bufs = bufs;
+      req->nbufs = nbufs;
+      if (req->nbufs > iovmax)
+        req->nbufs = iovmax;
+
+      do
+        result = uv__fs_write(req);
+      while (result < 0 && errno == EINTR);
+
+      if (result < 0) {
+        total = -1;
+        goto done;
+      }
+
+      n = uv__fs_buf_offset(bufs, result);
+      if (result == 0 && n == 0)
+        break;  /* Only empty buffers left. */
+
+      req->off += result;
+      bufs += n;
+      nbufs -= n;
+      total += result;
+    }
+  }
+
+  if (req->flags & UV_FS_WRITE_BATCH_DATASYNC)
+    if (uv__fs_fdatasync(req))
+      total = -1;
+
+done:
+  req->bufs = NULL;
+  req->nbufs = 0;
+
+  return total;
+}
+
+
+static ssize_t uv__fs_write_all(uv_fs_t* req) {
+  unsigned int iovmax;
+  unsigned int nbufs;
+  uv_buf_t* bufs;
+  ssize_t total;
+  ssize_t result;
+
+  iovmax = uv__getiovmax();
+  nbufs = req->nbufs;
+  bufs = req->bufs;
+  total = 0;
+
+  while (nbufs > 0) {
+    req->nbufs = nbufs;
+    if (req->nbufs > iovmax)
+      req->nbufs = iovmax;
+
+    do
+      result = uv__fs_write(req);
+    while (result < 0 && errno == EINTR);
+
+    if (result <= 0) {
+      if (total == 0)
+        total = result;
+      break;
+    }
+
+    if (req->off >= 0)
+      req->off += result;
+
+    req->nbufs = uv__fs_buf_offset(req->bufs, result);
     req->bufs += req->nbufs;
     nbufs -= req->nbufs;
     total += result;
   }
 
-  if (bufs != req->bufsml)
-    uv__free(bufs);
+  if (bufs != req->bufsml)
+    uv__free(bufs);
+
+  req->bufs = NULL;
+  req->nbufs = 0;
+
+  return total;
+}
+
+
+/* A name for the temporary file next to |base| in the same directory. */
+static int uv__fs_atomic_name(char* buf, size_t size, const char* base) {
+  unsigned char r[6];
+  int err;
+
+  err = uv_random(NULL, NULL, r, sizeof(r), 0, NULL);
+  if (err)
+    return errno = -err, -1;
+
+  snprintf(buf,
+           size,
+           "%s.%02x%02x%02x%02x%02x%02x.tmp",
+           base,
+           r[0], r[1], r[2], r[3], r[4], r[5]);
+  return 0;
+}
+
+
+static int uv__fs_atomic_data(uv_fs_t* req, int fd, size_t size) {
+  ssize_t n;
+
+  req->file = fd;
+  req->off = -1;
+  errno = 0;
+  n = uv__fs_write_all(req);
+  if (n < 0)
+    return -1;
+
+  if ((size_t) n != size) {
+    if (errno == 0)
+      errno = EIO;
+    return -1;
+  }
+
+  if (req->flags & UV_FS_WRITE_ATOMIC_NOSYNC)
+    return 0;
+
+  return uv__fs_fdatasync(req);
+}
+
+
+/* Writes the data to a file that nobody else sees, syncs it and renames it
+ * over |req->path|. Readers get either the old or the new contents. On Linux
+ * the file is an O_TMPFILE that only gets a name once the data is on disk,
+ * so a crash doesn't leave a half written temporary file behind.
+ */
+static int uv__fs_write_atomic(uv_fs_t* req) {
+  const char* base;
+  char* name;
+  char* dir;
+  size_t size;
+  size_t len;
+  int saved;
+  int dirfd;
+  int tries;
+  int named;
+  int fd;
+  int r;
+#if defined(__linux__) && defined(O_TMPFILE)
+  struct stat pbuf;
+  char proc[32];
+#endif
+
+  size = uv__count_bufs(req->bufs, req->nbufs);
+  dirfd = -1;
+  named = 0;
+  fd = -1;
+  r = -1;
+
+  len = strlen(req->path);
+  dir = uv__malloc(2 * len + 34);
+  if (dir == NULL) {
+    errno = ENOMEM;
+    goto out;
+  }
+
+  memcpy(dir, req->path, len + 1);
+  name = dir + len + 2;
+  base = strrchr(req->path, '/');
+  if (base == NULL) {
+    base = req->path;
+    strcpy(dir, ".");
+  } else {
+    dir[base - req->path + (base == req->path)] = '\0';
+    base++;
+  }
+
+  dirfd = uv__open_cloexec(dir, O_RDONLY | O_DIRECTORY);
+  if (dirfd < 0) {
+    errno = -dirfd;
+    dirfd = -1;
+    goto out;
+  }
+
+#if defined(__linux__) && defined(O_TMPFILE)
+  /* Older kernels and some file systems don't do O_TMPFILE. Giving it a
+   * name later takes /proc, make sure that's there before writing.
+   */
+  fd = openat(dirfd, ".", O_TMPFILE | O_WRONLY | O_CLOEXEC, req->mode);
+  if (fd != -1) {
+    snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+    if (lstat(proc, &pbuf)) {
+      uv__close(fd);
+      fd = -1;
+    }
+  }
+
+  if (fd != -1) {
+    if (uv__fs_atomic_data(req, fd, size))
+      goto out;
+
+    for (tries = 0; !named && tries < 16; tries++) {
+      if (uv__fs_atomic_name(name, len + 32, base))
+        goto out;
+
+      if (linkat(AT_FDCWD, proc, dirfd, name, AT_SYMLINK_FOLLOW) == 0)
+        named = 1;
+      else if (errno != EEXIST)
+        goto out;
+    }
+
+    if (!named)
+      goto out;
+  }
+#endif
+
+  for (tries = 0; fd == -1 && tries < 16; tries++) {
+    if (uv__fs_atomic_name(name, len + 32, base))
+      goto out;
+
+    fd = openat(dirfd,
+                name,
+                O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC,
+                req->mode);
+    if (fd == -1 && errno != EEXIST)
+      goto out;
+
+    if (fd != -1) {
+      named = 1;
+      if (uv__fs_atomic_data(req, fd, size))
+        goto out;
+    }
+  }
+
+  if (fd == -1)
+    goto out;
+
+  if (renameat(dirfd, name, dirfd, base))
+    goto out;
 
+  named = 0;
+  r = 0;
+
+  /* Make the rename itself durable. */
+  if (!(req->flags & UV_FS_WRITE_ATOMIC_NOSYNC)) {
+    req->file = dirfd;
+    r = uv__fs_fsync(req);
+  }
+
+out:
+  saved = errno;
+
+  if (named)
+    unlinkat(dirfd, name, 0);
+  if (fd != -1)
+    uv__close(fd);
+  if (dirfd != -1)
+    uv__close(dirfd);
+  uv__free(dir);
+
+  if (req->bufs != NULL && req->bufs != req->bufsml)
+    uv__free(req->bufs);
   req->bufs = NULL;
   req->nbufs = 0;
 
-  return total;
+  errno = saved;
+  return r;
 }
 
 
@@ -1715,10 +3057,14 @@ static void uv__fs_work(struct uv__work* w) {
     X(LSTAT, uv__fs_lstat(req->path, &req->statbuf));
     X(LINK, link(req->path, req->new_path));
     X(MKDIR, mkdir(req->path, req->mode));
+    X(MKDIRAT, uv__fs_at(req));
+    X(MKDIR_P, uv__fs_mkdir_p(req));
     X(MKDTEMP, uv__fs_mkdtemp(req));
     X(MKSTEMP, uv__fs_mkstemp(req));
     X(OPEN, uv__fs_open(req));
-    X(READ, uv__fs_read(req));
+    X(OPENAT, uv__fs_openat(req));
+    X(READ, req->flags & UV__FS_DIRECT_IO ? uv__fs_direct_io(req, 1)
+                                          : uv__fs_read(req));
     X(SCANDIR, uv__fs_scandir(req));
     X(OPENDIR, uv__fs_opendir(req));
     X(READDIR, uv__fs_readdir(req));
@@ -1727,13 +3073,27 @@ static void uv__fs_work(struct uv__work* w) {
     X(REALPATH, uv__fs_realpath(req));
     X(RENAME, rename(req->path, req->new_path));
     X(RMDIR, rmdir(req->path));
+    X(RM_RF, uv__fs_rm_rf(req));
     X(SENDFILE, uv__fs_sendfile(req));
     X(STAT, uv__fs_stat(req->path, &req->statbuf));
+    X(STATAT, uv__fs_statat(req));
     X(STATFS, uv__fs_statfs(req));
+    X(STAT_MANY, uv__fs_stat_many(req));
+    X(STATX, uv__fs_statx_fields(req));
+    X(MMAP, uv__fs_mmap(req));
+    X(MUNMAP, uv__fs_munmap(req));
+    X(FADVISE, uv__fs_fadvise(req));
+    X(READAHEAD, uv__fs_readahead(req));
+    X(FALLOCATE, uv__fs_fallocate(req));
+    X(WRITE_BATCH, uv__fs_write_batch(req));
+    X(WRITE_ATOMIC, uv__fs_write_atomic(req));
+    X(READDIR_PACKED, uv__fs_readdir_packed(req));
     X(SYMLINK, symlink(req->path, req->new_path));
     X(UNLINK, unlink(req->path));
+    X(UNLINKAT, uv__fs_at(req));
     X(UTIME, uv__fs_utime(req));
-    X(WRITE, uv__fs_write_all(req));
+    X(WRITE, req->flags & UV__FS_DIRECT_IO ? uv__fs_direct_io(req, 0)
+                                           : uv__fs_write_all(req));
     default: abort();
     }
 #undef X
@@ -1746,9 +3106,13 @@ static void uv__fs_work(struct uv__work* w) {
 
   if (r == 0 && (req->fs_type == UV_FS_STAT ||
                  req->fs_type == UV_FS_FSTAT ||
-                 req->fs_type == UV_FS_LSTAT)) {
+                 req->fs_type == UV_FS_LSTAT ||
+                 req->fs_type == UV_FS_STATAT)) {
     req->ptr = &req->statbuf;
   }
+
+  if (r >= 0 && req->fs_type == UV_FS_STATX)
+    req->ptr = &req->statbuf;
 }
 
 
@@ -1758,15 +3122,33 @@ static void uv__fs_done(struct uv__work* w, int status) {
   req = container_of(w, uv_fs_t, work_req);
   uv__req_unregister(req->loop, req);
 
-  if (status == UV_ECANCELED) {
+  /* Cancelled or expired in the queue, it never ran. */
+  if (status == UV_ECANCELED || status == UV_ETIMEDOUT) {
     assert(req->result == 0);
-    req->result = UV_ECANCELED;
+    req->result = status;
   }
 
+  if (req->fs_type == UV_FS_REALPATH && req->result == 0)
+    uv__realpath_cache_store(req->loop, req->path, req->ptr);
+
   req->cb(req);
 }
 
 
+/* Hands an asynchronous request to the threadpool, like POST does. For the
+ * io_uring backend when the ring can't finish a request by itself.
+ */
+void uv__fs_post(uv_loop_t* loop, uv_fs_t* req) {
+  uv__req_register(loop, req);
+  uv__work_submit_priority(loop,
+                           &req->work_req,
+                           UV__WORK_FAST_IO,
+                           uv__fs_work_priority(req->fs_type),
+                           uv__fs_work,
+                           uv__fs_done);
+}
+
+
 int uv_fs_access(uv_loop_t* loop,
                  uv_fs_t* req,
                  const char* path,
@@ -1808,6 +3190,9 @@ int uv_fs_chown(uv_loop_t* loop,
 int uv_fs_close(uv_loop_t* loop, uv_fs_t* req, uv_file file, uv_fs_cb cb) {
   INIT(CLOSE);
   req->file = file;
+  if (cb != NULL)
+    if (uv__iou_fs_close(loop, req))
+      return 0;
   POST;
 }
 
@@ -1855,6 +3240,9 @@ int uv_fs_lchown(uv_loop_t* loop,
 int uv_fs_fdatasync(uv_loop_t* loop, uv_fs_t* req, uv_file file, uv_fs_cb cb) {
   INIT(FDATASYNC);
   req->file = file;
+  if (cb != NULL)
+    if (uv__iou_fs_fsync_or_fdatasync(loop, req, UV__IORING_FSYNC_DATASYNC))
+      return 0;
   POST;
 }
 
@@ -1862,6 +3250,9 @@ int uv_fs_fdatasync(uv_loop_t* loop, uv_fs_t* req, uv_file file, uv_fs_cb cb) {
 int uv_fs_fstat(uv_loop_t* loop, uv_fs_t* req, uv_file file, uv_fs_cb cb) {
   INIT(FSTAT);
   req->file = file;
+  if (cb != NULL)
+    if (uv__iou_fs_statx(loop, req, /* is_fstat */ 1, /* is_lstat */ 0))
+      return 0;
   POST;
 }
 
@@ -1869,6 +3260,9 @@ int uv_fs_fstat(uv_loop_t* loop, uv_fs_t* req, uv_file file, uv_fs_cb cb) {
 int uv_fs_fsync(uv_loop_t* loop, uv_fs_t* req, uv_file file, uv_fs_cb cb) {
   INIT(FSYNC);
   req->file = file;
+  if (cb != NULL)
+    if (uv__iou_fs_fsync_or_fdatasync(loop, req, /* no flags */ 0))
+      return 0;
   POST;
 }
 
@@ -1915,6 +3309,9 @@ int uv_fs_lutime(uv_loop_t* loop,
 int uv_fs_lstat(uv_loop_t* loop, uv_fs_t* req, const char* path, uv_fs_cb cb) {
   INIT(LSTAT);
   PATH;
+  if (cb != NULL)
+    if (uv__iou_fs_statx(loop, req, /* is_fstat */ 0, /* is_lstat */ 1))
+      return 0;
   POST;
 }
 
@@ -1942,6 +3339,18 @@ int uv_fs_mkdir(uv_loop_t* loop,
 }
 
 
+int uv_fs_mkdir_p(uv_loop_t* loop,
+                  uv_fs_t* req,
+                  const char* path,
+                  int mode,
+                  uv_fs_cb cb) {
+  INIT(MKDIR_P);
+  PATH;
+  req->mode = mode;
+  POST;
+}
+
+
 int uv_fs_mkdtemp(uv_loop_t* loop,
                   uv_fs_t* req,
                   const char* tpl,
@@ -1976,6 +3385,9 @@ int uv_fs_open(uv_loop_t* loop,
   PATH;
   req->flags = flags;
   req->mode = mode;
+  if (cb != NULL)
+    if (uv__iou_fs_open(loop, req))
+      return 0;
   POST;
 }
 
@@ -2004,6 +3416,11 @@ int uv_fs_read(uv_loop_t* loop, uv_fs_t* req,
   memcpy(req->bufs, bufs, nbufs * sizeof(*bufs));
 
   req->off = off;
+
+  if (cb != NULL)
+    if (uv__iou_fs_read_or_write(loop, req, /* is_read */ 1))
+      return 0;
+
   POST;
 }
 
@@ -2015,7 +3432,7 @@ int uv_fs_scandir(uv_loop_t* loop,
                   uv_fs_cb cb) {
   INIT(SCANDIR);
   PATH;
-  req->flags = flags;
+  req->flags = flags & ~UV__FS_SCANDIR_PACKED;
   POST;
 }
 
@@ -2041,6 +3458,23 @@ int uv_fs_readdir(uv_loop_t* loop,
   POST;
 }
 
+int uv_fs_readdir_packed(uv_loop_t* loop,
+                         uv_fs_t* req,
+                         uv_dir_t* dir,
+                         void* buf,
+                         size_t len,
+                         uv_fs_cb cb) {
+  INIT(READDIR_PACKED);
+
+  if (dir == NULL || dir->dir == NULL || buf == NULL)
+    return UV_EINVAL;
+
+  req->ptr = dir;
+  req->bufsml[0].base = buf;
+  req->bufsml[0].len = len;
+  POST;
+}
+
 int uv_fs_closedir(uv_loop_t* loop,
                    uv_fs_t* req,
                    uv_dir_t* dir,
@@ -2070,6 +3504,27 @@ int uv_fs_realpath(uv_loop_t* loop,
                   uv_fs_cb cb) {
   INIT(REALPATH);
   PATH;
+
+  /* With UV_LOOP_REALPATH_CACHE, hits skip the threadpool and complete on
+   * the next loop iteration.
+   */
+  req->ptr = uv__realpath_cache_lookup(loop, path);
+  if (req->ptr != NULL) {
+    if (cb == NULL)
+      return 0;
+
+    uv__req_register(loop, req);
+    uv__work_post(loop, &req->work_req, uv__fs_done);
+    return 0;
+  }
+
+  if (cb == NULL) {
+    uv__fs_work(&req->work_req);
+    if (req->result == 0)
+      uv__realpath_cache_store(loop, path, req->ptr);
+    return req->result;
+  }
+
   POST;
 }
 
@@ -2092,6 +3547,13 @@ int uv_fs_rmdir(uv_loop_t* loop, uv_fs_t* req, const char* path, uv_fs_cb cb) {
 }
 
 
+int uv_fs_rm_rf(uv_loop_t* loop, uv_fs_t* req, const char* path, uv_fs_cb cb) {
+  INIT(RM_RF);
+  PATH;
+  POST;
+}
+
+
 int uv_fs_sendfile(uv_loop_t* loop,
                    uv_fs_t* req,
                    uv_file out_fd,
@@ -2111,6 +3573,9 @@ int uv_fs_sendfile(uv_loop_t* loop,
 int uv_fs_stat(uv_loop_t* loop, uv_fs_t* req, const char* path, uv_fs_cb cb) {
   INIT(STAT);
   PATH;
+  if (cb != NULL)
+    if (uv__iou_fs_statx(loop, req, /* is_fstat */ 0, /* is_lstat */ 0))
+      return 0;
   POST;
 }
 
@@ -2174,6 +3639,11 @@ int uv_fs_write(uv_loop_t* loop,
   memcpy(req->bufs, bufs, nbufs * sizeof(*bufs));
 
   req->off = off;
+
+  if (cb != NULL)
+    if (uv__iou_fs_read_or_write(loop, req, /* is_read */ 0))
+      return 0;
+
   POST;
 }
 
@@ -2205,7 +3675,10 @@ void uv_fs_req_cleanup(uv_fs_t* req) {
     uv__free(req->bufs);
   req->bufs = NULL;
 
-  if (req->fs_type != UV_FS_OPENDIR && req->ptr != &req->statbuf)
+  if (req->fs_type != UV_FS_OPENDIR &&
+      req->fs_type != UV_FS_READDIR_PACKED &&
+      req->fs_type != UV_FS_MMAP &&
+      req->ptr != &req->statbuf)
     uv__free(req->ptr);
   req->ptr = NULL;
 }
@@ -2231,6 +3704,300 @@ int uv_fs_copyfile(uv_loop_t* loop,
 }
 
 
+int uv_fs_stat_many(uv_loop_t* loop,
+                    uv_fs_t* req,
+                    const char* const paths[],
+                    unsigned int npaths,
+                    uv_stat_t* statbufs,
+                    int* results,
+                    uv_fs_cb cb) {
+  int err;
+
+  INIT(STAT_MANY);
+  err = uv__fs_stat_many_init(req,
+                              paths,
+                              npaths,
+                              statbufs,
+                              results,
+                              cb != NULL);
+  if (err)
+    return err;
+  POST;
+}
+
+
+int uv_fs_statx(uv_loop_t* loop,
+                uv_fs_t* req,
+                const char* path,
+                unsigned int mask,
+                int flags,
+                uv_fs_cb cb) {
+  INIT(STATX);
+
+  if (flags & ~(UV_FS_STATX_NOFOLLOW |
+                UV_FS_STATX_DONT_SYNC |
+                UV_FS_STATX_FORCE_SYNC))
+    return UV_EINVAL;
+
+  if ((flags & UV_FS_STATX_DONT_SYNC) && (flags & UV_FS_STATX_FORCE_SYNC))
+    return UV_EINVAL;
+
+  if (mask == 0 || (mask & ~UV_STATX_ALL))
+    return UV_EINVAL;
+
+  PATH;
+  req->mode = mask;
+  req->flags = flags;
+  POST;
+}
+
+
+int uv_fs_mmap(uv_loop_t* loop,
+               uv_fs_t* req,
+               uv_file file,
+               int64_t offset,
+               size_t length,
+               int flags,
+               uv_fs_cb cb) {
+  INIT(MMAP);
+  req->file = file;
+  req->off = offset;
+  req->flags = flags;
+  req->bufsml[0].base = NULL;
+  req->bufsml[0].len = length;
+  POST;
+}
+
+
+int uv_fs_munmap(uv_loop_t* loop,
+                 uv_fs_t* req,
+                 void* addr,
+                 size_t length,
+                 uv_fs_cb cb) {
+  INIT(MUNMAP);
+  if (addr == NULL || length == 0)
+    return UV_EINVAL;
+  req->bufsml[0].base = addr;
+  req->bufsml[0].len = length;
+  POST;
+}
+
+
+int uv_fs_madvise(void* addr, size_t length, uv_fs_madvice_t advice) {
+  size_t delta;
+  int a;
+
+  switch (advice) {
+    case UV_FS_MADV_NORMAL:
+      a = MADV_NORMAL;
+      break;
+    case UV_FS_MADV_SEQUENTIAL:
+      a = MADV_SEQUENTIAL;
+      break;
+    case UV_FS_MADV_RANDOM:
+      a = MADV_RANDOM;
+      break;
+    case UV_FS_MADV_WILLNEED:
+      a = MADV_WILLNEED;
+      break;
+    case UV_FS_MADV_DONTNEED:
+      a = MADV_DONTNEED;
+      break;
+    default:
+      return UV_EINVAL;
+  }
+
+  if (addr == NULL)
+    return UV_EINVAL;
+
+  delta = (uintptr_t) addr % getpagesize();
+  if (madvise((char*) addr - delta, length + delta, a))
+    return UV__ERR(errno);
+
+  return 0;
+}
+
+
+static int uv__fs_direct_init(uv_fs_t* req,
+                              uv_file file,
+                              const uv_buf_t bufs[],
+                              unsigned int nbufs,
+                              int64_t off) {
+  if (bufs == NULL || nbufs == 0 || off < 0)
+    return UV_EINVAL;
+
+  req->file = file;
+  req->flags = UV__FS_DIRECT_IO;
+
+  req->nbufs = nbufs;
+  req->bufs = req->bufsml;
+  if (nbufs > ARRAY_SIZE(req->bufsml))
+    req->bufs = uv__malloc(nbufs * sizeof(*bufs));
+
+  if (req->bufs == NULL)
+    return UV_ENOMEM;
+
+  memcpy(req->bufs, bufs, nbufs * sizeof(*bufs));
+
+  req->off = off;
+  return 0;
+}
+
+
+int uv_fs_read_direct(uv_loop_t* loop,
+                      uv_fs_t* req,
+                      uv_file file,
+                      const uv_buf_t bufs[],
+                      unsigned int nbufs,
+                      int64_t off,
+                      uv_fs_cb cb) {
+  int err;
+
+  INIT(READ);
+  err = uv__fs_direct_init(req, file, bufs, nbufs, off);
+  if (err)
+    return err;
+  POST;
+}
+
+
+int uv_fs_write_direct(uv_loop_t* loop,
+                       uv_fs_t* req,
+                       uv_file file,
+                       const uv_buf_t bufs[],
+                       unsigned int nbufs,
+                       int64_t off,
+                       uv_fs_cb cb) {
+  int err;
+
+  INIT(WRITE);
+  err = uv__fs_direct_init(req, file, bufs, nbufs, off);
+  if (err)
+    return err;
+  POST;
+}
+
+
+int uv_fs_fadvise(uv_loop_t* loop,
+                  uv_fs_t* req,
+                  uv_file file,
+                  int64_t offset,
+                  uint64_t length,
+                  uv_fs_fadvice_t advice,
+                  uv_fs_cb cb) {
+  INIT(FADVISE);
+  if (offset < 0 ||
+      advice < UV_FS_FADV_NORMAL ||
+      advice > UV_FS_FADV_DONTNEED)
+    return UV_EINVAL;
+  req->file = file;
+  req->off = offset;
+  req->flags = advice;
+  req->bufsml[0].base = NULL;
+  req->bufsml[0].len = length;
+  POST;
+}
+
+
+int uv_fs_readahead(uv_loop_t* loop,
+                    uv_fs_t* req,
+                    uv_file file,
+                    int64_t offset,
+                    uint64_t length,
+                    uv_fs_cb cb) {
+  INIT(READAHEAD);
+  if (offset < 0)
+    return UV_EINVAL;
+  req->file = file;
+  req->off = offset;
+  req->bufsml[0].base = NULL;
+  req->bufsml[0].len = length;
+  POST;
+}
+
+
+int uv_fs_fallocate(uv_loop_t* loop,
+                    uv_fs_t* req,
+                    uv_file file,
+                    int64_t offset,
+                    int64_t length,
+                    int flags,
+                    uv_fs_cb cb) {
+  INIT(FALLOCATE);
+  if (offset < 0 || length <= 0 || uv__fs_fallocate_check(flags))
+    return UV_EINVAL;
+  req->file = file;
+  req->off = offset;
+  req->flags = flags;
+  /* Split in two so the length survives a 32 bits size_t. */
+  req->bufsml[0].base = NULL;
+  req->bufsml[0].len = (size_t) ((uint64_t) length & 0xFFFFFFFF);
+  req->bufsml[1].len = (size_t) ((uint64_t) length >> 32);
+  POST;
+}
+
+
+int uv_fs_write_atomic(uv_loop_t* loop,
+                       uv_fs_t* req,
+                       const char* path,
+                       const uv_buf_t bufs[],
+                       unsigned int nbufs,
+                       int mode,
+                       int flags,
+                       uv_fs_cb cb) {
+  INIT(WRITE_ATOMIC);
+
+  if (bufs == NULL && nbufs > 0)
+    return UV_EINVAL;
+
+  if (flags & ~UV_FS_WRITE_ATOMIC_NOSYNC)
+    return UV_EINVAL;
+
+  PATH;
+
+  req->nbufs = nbufs;
+  req->bufs = req->bufsml;
+  if (nbufs > ARRAY_SIZE(req->bufsml))
+    req->bufs = uv__malloc(nbufs * sizeof(*bufs));
+
+  if (req->bufs == NULL) {
+    if (cb != NULL)
+      uv__free((char*) req->path);
+    req->path = NULL;
+    return UV_ENOMEM;
+  }
+
+  if (nbufs > 0)
+    memcpy(req->bufs, bufs, nbufs * sizeof(*bufs));
+
+  req->mode = mode;
+  req->flags = flags;
+  POST;
+}
+
+
+int uv_fs_write_batch(uv_loop_t* loop,
+                      uv_fs_t* req,
+                      uv_file file,
+                      const uv_fs_write_segment_t segments[],
+                      unsigned int nsegments,
+                      int flags,
+                      uv_fs_cb cb) {
+  int err;
+
+  INIT(WRITE_BATCH);
+  err = uv__fs_write_batch_init(req, segments, nsegments, flags);
+  if (err)
+    return err;
+  req->file = file;
+  req->flags = flags;
+  if (cb != NULL)
+    if (uv__iou_fs_write_batch(loop, req))
+      return 0;
+  POST;
+}
+
+
 int uv_fs_statfs(uv_loop_t* loop,
                  uv_fs_t* req,
                  const char* path,
@@ -2240,6 +4007,88 @@ int uv_fs_statfs(uv_loop_t* loop,
   POST;
 }
 
+
+#define AT(allowed)                                                           \
+  do {                                                                        \
+    if (at_flags & ~(allowed))                                                \
+      return UV_EINVAL;                                                       \
+    req->file = dir;                                                          \
+    req->off = at_flags;                                                      \
+  }                                                                           \
+  while (0)
+
+
+int uv_fs_openat(uv_loop_t* loop,
+                 uv_fs_t* req,
+                 uv_file dir,
+                 const char* path,
+                 int flags,
+                 int mode,
+                 int at_flags,
+                 uv_fs_cb cb) {
+  INIT(OPENAT);
+  AT(UV_FS_AT_BENEATH);
+  PATH;
+  req->flags = flags;
+  req->mode = mode;
+  POST;
+}
+
+
+int uv_fs_statat(uv_loop_t* loop,
+                 uv_fs_t* req,
+                 uv_file dir,
+                 const char* path,
+                 int at_flags,
+                 uv_fs_cb cb) {
+  INIT(STATAT);
+  AT(UV_FS_AT_SYMLINK_NOFOLLOW | UV_FS_AT_BENEATH);
+  PATH;
+  POST;
+}
+
+
+int uv_fs_unlinkat(uv_loop_t* loop,
+                   uv_fs_t* req,
+                   uv_file dir,
+                   const char* path,
+                   int at_flags,
+                   uv_fs_cb cb) {
+  INIT(UNLINKAT);
+  AT(UV_FS_AT_REMOVEDIR | UV_FS_AT_BENEATH);
+  PATH;
+  POST;
+}
+
+
+int uv_fs_mkdirat(uv_loop_t* loop,
+                  uv_fs_t* req,
+                  uv_file dir,
+                  const char* path,
+                  int mode,
+                  int at_flags,
+                  uv_fs_cb cb) {
+  INIT(MKDIRAT);
+  AT(UV_FS_AT_BENEATH);
+  PATH;
+  req->mode = mode;
+  POST;
+}
+
+#undef AT
+
+
+int uv_fs_dir_fileno(const uv_dir_t* dir, uv_file* fd) {
+  if (dir == NULL || fd == NULL || dir->dir == NULL)
+    return UV_EINVAL;
+
+  *fd = dirfd(dir->dir);
+  if (*fd == -1)
+    return UV__ERR(errno);
+
+  return 0;
+}
+
 int uv_fs_get_system_error(const uv_fs_t* req) {
   return -req->result;
 }
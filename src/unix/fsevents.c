@@ -18,6 +18,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
 #include "uv.h"
 #include "internal.h"
 
@@ -22,6 +22,8 @@
  * include any headers.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_DNS
+
 #include "uv.h"
 #include "internal.h"
 #include "idna.h"
@@ -35,6 +37,61 @@
 /* EAI_* constants. */
 #include <netdb.h>
 
+#define UV__GAI_CACHE_DEFAULT_ENTRIES 1024
+
+/* Keeps the sockaddr and canonname copies in a flattened list aligned. */
+#define UV__GAI_ALIGN(n) (((n) + 15) & ~(size_t) 15)
+
+enum {
+  UV__GAI_CACHE_MISS,
+  UV__GAI_CACHE_HIT,
+  UV__GAI_CACHE_REFRESH  /* Stale hit, the caller should refresh it. */
+};
+
+/* A result list copied into a single allocation. The ones handed out to the
+ * user, by the cache or by the built-in resolver, are tracked so that
+ * uv_freeaddrinfo() can tell them apart from the lists that libc allocated.
+ */
+struct uv__gai_copy {
+  RB_ENTRY(uv__gai_copy) tree_entry;
+  struct addrinfo* addrinfo;
+};
+
+struct uv__gai_entry {
+  RB_ENTRY(uv__gai_entry) tree_entry;
+  QUEUE lru;
+  uint64_t expires;  /* In milliseconds, uv__hrtime() based. */
+  int retcode;
+  int refreshing;
+  struct uv__gai_copy* result;  /* NULL for negative entries. */
+  char* key;
+};
+
+RB_HEAD(uv__gai_entries, uv__gai_entry);
+RB_HEAD(uv__gai_copies, uv__gai_copy);
+
+static struct {
+  uv_mutex_t mutex;
+  uv_getaddrinfo_cache_options_t options;
+  struct uv__gai_entries entries;
+  struct uv__gai_copies copies;
+  unsigned int nentries;
+  QUEUE lru;
+  int enabled;
+} uv__gai_cache;
+
+static uv_once_t uv__gai_cache_once = UV_ONCE_INIT;
+static int uv__gai_cache_used;
+
+static int uv__getaddrinfo_init(uv_loop_t* loop,
+                                uv_getaddrinfo_t* req,
+                                uv_getaddrinfo_cb cb,
+                                const char* hostname,
+                                const char* service,
+                                const struct addrinfo* hints);
+static void uv__getaddrinfo_work(struct uv__work* w);
+static void uv__getaddrinfo_done(struct uv__work* w, int status);
+
 
 int uv__getaddrinfo_translate_error(int sys_err) {
   switch (sys_err) {
@@ -95,6 +152,462 @@ int uv__getaddrinfo_translate_error(int sys_err) {
 }
 
 
+static int uv__gai_entry_cmp(const struct uv__gai_entry* a,
+                             const struct uv__gai_entry* b) {
+  return strcmp(a->key, b->key);
+}
+
+
+static int uv__gai_copy_cmp(const struct uv__gai_copy* a,
+                            const struct uv__gai_copy* b) {
+  if (a->addrinfo < b->addrinfo)
+    return -1;
+  return a->addrinfo > b->addrinfo;
+}
+
+
+RB_GENERATE_STATIC(uv__gai_entries, uv__gai_entry, tree_entry,
+                   uv__gai_entry_cmp)
+RB_GENERATE_STATIC(uv__gai_copies, uv__gai_copy, tree_entry, uv__gai_copy_cmp)
+
+
+static void uv__gai_cache_init(void) {
+  if (uv_mutex_init(&uv__gai_cache.mutex))
+    abort();
+
+  QUEUE_INIT(&uv__gai_cache.lru);
+}
+
+
+static uint64_t uv__gai_cache_now(void) {
+  return uv__hrtime(UV_CLOCK_FAST) / 1000000;
+}
+
+
+/* Lookups only share an entry when getaddrinfo() would have been called with
+ * the same arguments. NULL strings are told apart from empty ones and the
+ * length prefix keeps the hostname from running into the service.
+ */
+static char* uv__gai_cache_key(const char* hostname,
+                               const char* service,
+                               const struct addrinfo* hints) {
+  size_t size;
+  char* key;
+  int n;
+
+  size = 64;
+  size += hostname ? strlen(hostname) : 0;
+  size += service ? strlen(service) : 0;
+  key = uv__malloc(size);
+  if (key == NULL)
+    return NULL;
+
+  if (hints != NULL)
+    n = snprintf(key, size, "%d,%d,%d,%d|",
+                 hints->ai_family,
+                 hints->ai_socktype,
+                 hints->ai_protocol,
+                 hints->ai_flags);
+  else
+    n = snprintf(key, size, "-|");
+
+  if (hostname != NULL)
+    n += snprintf(key + n, size - n, "%lu:%s|",
+                  (unsigned long) strlen(hostname),
+                  hostname);
+  else
+    n += snprintf(key + n, size - n, "-|");
+
+  if (service != NULL)
+    snprintf(key + n, size - n, ":%s", service);
+  else
+    snprintf(key + n, size - n, "-");
+
+  return key;
+}
+
+
+static struct uv__gai_copy* uv__gai_copy_list(const struct addrinfo* ai) {
+  const struct addrinfo* p;
+  struct uv__gai_copy* copy;
+  struct addrinfo* prev;
+  struct addrinfo* node;
+  size_t size;
+  size_t len;
+  char* buf;
+
+  size = UV__GAI_ALIGN(sizeof(*copy));
+  for (p = ai; p != NULL; p = p->ai_next) {
+    size += UV__GAI_ALIGN(sizeof(*p));
+    if (p->ai_addr != NULL)
+      size += UV__GAI_ALIGN(p->ai_addrlen);
+    if (p->ai_canonname != NULL)
+      size += UV__GAI_ALIGN(strlen(p->ai_canonname) + 1);
+  }
+
+  buf = uv__malloc(size);
+  if (buf == NULL)
+    return NULL;
+
+  copy = (struct uv__gai_copy*) buf;
+  copy->addrinfo = NULL;
+  buf += UV__GAI_ALIGN(sizeof(*copy));
+  prev = NULL;
+
+  for (p = ai; p != NULL; p = p->ai_next) {
+    node = (struct addrinfo*) buf;
+    buf += UV__GAI_ALIGN(sizeof(*node));
+    memcpy(node, p, sizeof(*node));
+    node->ai_next = NULL;
+
+    if (p->ai_addr != NULL) {
+      node->ai_addr = memcpy(buf, p->ai_addr, p->ai_addrlen);
+      buf += UV__GAI_ALIGN(p->ai_addrlen);
+    }
+
+    if (p->ai_canonname != NULL) {
+      len = strlen(p->ai_canonname) + 1;
+      node->ai_canonname = memcpy(buf, p->ai_canonname, len);
+      buf += UV__GAI_ALIGN(len);
+    }
+
+    if (prev == NULL)
+      copy->addrinfo = node;
+    else
+      prev->ai_next = node;
+    prev = node;
+  }
+
+  return copy;
+}
+
+
+/* Must be called with the cache mutex held. */
+static struct uv__gai_entry* uv__gai_cache_find(char* key) {
+  struct uv__gai_entry lookup;
+
+  lookup.key = key;
+  return RB_FIND(uv__gai_entries, &uv__gai_cache.entries, &lookup);
+}
+
+
+/* Must be called with the cache mutex held. */
+static void uv__gai_cache_remove(struct uv__gai_entry* entry) {
+  RB_REMOVE(uv__gai_entries, &uv__gai_cache.entries, entry);
+  QUEUE_REMOVE(&entry->lru);
+  uv__gai_cache.nentries--;
+  uv__free(entry->result);
+  uv__free(entry);
+}
+
+
+/* Must be called with the cache mutex held. Evicts the least recently used
+ * entries until the cache is within its limit again.
+ */
+static void uv__gai_cache_trim(unsigned int max_entries) {
+  QUEUE* q;
+
+  while (uv__gai_cache.nentries > max_entries) {
+    q = QUEUE_PREV(&uv__gai_cache.lru);
+    uv__gai_cache_remove(QUEUE_DATA(q, struct uv__gai_entry, lru));
+  }
+}
+
+
+/* Fills in |req| from the cache. A stale entry is only served when
+ * |allow_stale| is set and then the first caller to see it is asked to
+ * refresh it, the others get the stale result until the refresh lands.
+ */
+static int uv__gai_cache_lookup(uv_getaddrinfo_t* req, int allow_stale) {
+  struct uv__gai_entry* entry;
+  struct uv__gai_copy* copy;
+  uint64_t now;
+  char* key;
+  int rc;
+
+  if (!uv__load_relaxed(&uv__gai_cache_used))
+    return UV__GAI_CACHE_MISS;
+
+  key = uv__gai_cache_key(req->hostname, req->service, req->hints);
+  if (key == NULL)
+    return UV__GAI_CACHE_MISS;
+
+  rc = UV__GAI_CACHE_MISS;
+  uv_mutex_lock(&uv__gai_cache.mutex);
+
+  if (!uv__gai_cache.enabled)
+    goto out;
+
+  entry = uv__gai_cache_find(key);
+  if (entry == NULL)
+    goto out;
+
+  now = uv__gai_cache_now();
+  if (now < entry->expires) {
+    rc = UV__GAI_CACHE_HIT;
+  } else if (allow_stale &&
+             now < entry->expires + uv__gai_cache.options.stale_ttl) {
+    rc = entry->refreshing ? UV__GAI_CACHE_HIT : UV__GAI_CACHE_REFRESH;
+  } else {
+    /* Not removed when a refresh is in flight, it will replace the entry. */
+    if (!entry->refreshing)
+      uv__gai_cache_remove(entry);
+    goto out;
+  }
+
+  if (entry->result != NULL) {
+    copy = uv__gai_copy_list(entry->result->addrinfo);
+    if (copy == NULL) {
+      rc = UV__GAI_CACHE_MISS;
+      goto out;
+    }
+    RB_INSERT(uv__gai_copies, &uv__gai_cache.copies, copy);
+    req->addrinfo = copy->addrinfo;
+  }
+
+  if (rc == UV__GAI_CACHE_REFRESH)
+    entry->refreshing = 1;
+
+  req->retcode = entry->retcode;
+  QUEUE_REMOVE(&entry->lru);
+  QUEUE_INSERT_HEAD(&uv__gai_cache.lru, &entry->lru);
+
+out:
+  uv_mutex_unlock(&uv__gai_cache.mutex);
+  uv__free(key);
+  return rc;
+}
+
+
+/* Runs after every lookup. Successful lookups and lookups for names that
+ * don't exist are cached; transient errors are not, so that a refresh that
+ * fails keeps serving the stale entry. |max_ttl| caps the configured TTL when
+ * the lookup knows the TTL of the records.
+ */
+static void uv__gai_cache_store(const uv_getaddrinfo_t* req,
+                                uint64_t max_ttl) {
+  struct uv__gai_entry* entry;
+  struct uv__gai_copy* copy;
+  uint64_t ttl;
+  size_t len;
+  char* key;
+
+  if (!uv__load_relaxed(&uv__gai_cache_used))
+    return;
+
+  key = uv__gai_cache_key(req->hostname, req->service, req->hints);
+  if (key == NULL)
+    return;
+
+  entry = NULL;
+  copy = NULL;
+  uv_mutex_lock(&uv__gai_cache.mutex);
+
+  if (!uv__gai_cache.enabled)
+    goto out;
+
+  entry = uv__gai_cache_find(key);
+
+  switch (req->retcode) {
+  case 0:
+    ttl = uv__gai_cache.options.ttl;
+    break;
+  case UV_EAI_NONAME:
+  case UV_EAI_NODATA:
+    ttl = uv__gai_cache.options.negative_ttl;
+    break;
+  default:
+    ttl = 0;
+  }
+
+  if (ttl > max_ttl)
+    ttl = max_ttl;
+
+  if (ttl == 0)
+    goto out;
+
+  if (req->retcode == 0) {
+    copy = uv__gai_copy_list(req->addrinfo);
+    if (copy == NULL)
+      goto out;
+  }
+
+  if (entry == NULL) {
+    len = strlen(key) + 1;
+    entry = uv__malloc(sizeof(*entry) + len);
+    if (entry == NULL) {
+      uv__free(copy);
+      goto out;
+    }
+
+    entry->key = memcpy(entry + 1, key, len);
+    entry->result = NULL;
+    RB_INSERT(uv__gai_entries, &uv__gai_cache.entries, entry);
+    QUEUE_INSERT_HEAD(&uv__gai_cache.lru, &entry->lru);
+    uv__gai_cache.nentries++;
+  } else {
+    QUEUE_REMOVE(&entry->lru);
+    QUEUE_INSERT_HEAD(&uv__gai_cache.lru, &entry->lru);
+  }
+
+  uv__free(entry->result);
+  entry->result = copy;
+  entry->retcode = req->retcode;
+  entry->expires = uv__gai_cache_now() + ttl;
+  entry->refreshing = 0;
+  entry = NULL;
+
+  uv__gai_cache_trim(uv__gai_cache.options.max_entries);
+
+out:
+  if (entry != NULL)
+    entry->refreshing = 0;
+
+  uv_mutex_unlock(&uv__gai_cache.mutex);
+  uv__free(key);
+}
+
+
+/* Returns 1 if |ai| was handed out by the cache or the built-in resolver and
+ * has now been freed.
+ */
+static int uv__gai_cache_release(struct addrinfo* ai) {
+  struct uv__gai_copy lookup;
+  struct uv__gai_copy* copy;
+
+  if (!uv__load_relaxed(&uv__gai_cache_used))
+    return 0;
+
+  lookup.addrinfo = ai;
+  uv_mutex_lock(&uv__gai_cache.mutex);
+  copy = RB_FIND(uv__gai_copies, &uv__gai_cache.copies, &lookup);
+  if (copy != NULL)
+    RB_REMOVE(uv__gai_copies, &uv__gai_cache.copies, copy);
+  uv_mutex_unlock(&uv__gai_cache.mutex);
+
+  if (copy == NULL)
+    return 0;
+
+  uv__free(copy);
+  return 1;
+}
+
+
+static void uv__getaddrinfo_submit(uv_loop_t* loop, uv_getaddrinfo_t* req) {
+  if (0 == uv__dns_getaddrinfo(req))
+    return;
+
+  uv__work_submit(loop,
+                  &req->work_req,
+                  UV__WORK_SLOW_IO,
+                  uv__getaddrinfo_work,
+                  uv__getaddrinfo_done);
+}
+
+
+/* Called by the built-in resolver, see dns.c. |ai| belongs to the caller.
+ * The callback runs on the next loop iteration.
+ */
+void uv__getaddrinfo_complete(uv_getaddrinfo_t* req,
+                              int retcode,
+                              const struct addrinfo* ai,
+                              uint64_t ttl) {
+  struct uv__gai_copy* copy;
+
+  if (retcode == 0) {
+    copy = uv__gai_copy_list(ai);
+    if (copy == NULL) {
+      retcode = UV_EAI_MEMORY;
+    } else {
+      uv_once(&uv__gai_cache_once, uv__gai_cache_init);
+      uv_mutex_lock(&uv__gai_cache.mutex);
+      RB_INSERT(uv__gai_copies, &uv__gai_cache.copies, copy);
+      uv__store_relaxed(&uv__gai_cache_used, 1);
+      uv_mutex_unlock(&uv__gai_cache.mutex);
+      req->addrinfo = copy->addrinfo;
+    }
+  }
+
+  req->retcode = retcode;
+  uv__gai_cache_store(req, ttl);
+  uv__work_post(req->loop, &req->work_req, uv__getaddrinfo_done);
+}
+
+
+static void uv__gai_cache_refresh_cb(uv_getaddrinfo_t* req,
+                                     int status,
+                                     struct addrinfo* res) {
+  uv_freeaddrinfo(res);
+  uv__free(req);
+}
+
+
+/* Looks up |req| again in the background. The result only goes into the
+ * cache, the internal request keeps the loop alive until it's done.
+ */
+static void uv__gai_cache_refresh(uv_loop_t* loop, uv_getaddrinfo_t* req) {
+  struct uv__gai_entry* entry;
+  uv_getaddrinfo_t* refresh;
+  char* key;
+
+  refresh = uv__malloc(sizeof(*refresh));
+  if (refresh != NULL) {
+    if (0 == uv__getaddrinfo_init(loop,
+                                  refresh,
+                                  uv__gai_cache_refresh_cb,
+                                  req->hostname,
+                                  req->service,
+                                  req->hints)) {
+      uv__getaddrinfo_submit(loop, refresh);
+      return;
+    }
+    uv__free(refresh);
+  }
+
+  /* Let the next stale hit try again. */
+  key = uv__gai_cache_key(req->hostname, req->service, req->hints);
+  if (key == NULL)
+    return;
+
+  uv_mutex_lock(&uv__gai_cache.mutex);
+  entry = uv__gai_cache_find(key);
+  if (entry != NULL)
+    entry->refreshing = 0;
+  uv_mutex_unlock(&uv__gai_cache.mutex);
+  uv__free(key);
+}
+
+
+int uv_getaddrinfo_cache_configure(
+    const uv_getaddrinfo_cache_options_t* options) {
+  struct uv__gai_entry* entry;
+
+  if (options != NULL && options->ttl == 0)
+    return UV_EINVAL;
+
+  uv_once(&uv__gai_cache_once, uv__gai_cache_init);
+  uv_mutex_lock(&uv__gai_cache.mutex);
+
+  if (options == NULL) {
+    uv__gai_cache.enabled = 0;
+    while (NULL != (entry = RB_MIN(uv__gai_entries, &uv__gai_cache.entries)))
+      uv__gai_cache_remove(entry);
+  } else {
+    uv__gai_cache.enabled = 1;
+    uv__gai_cache.options = *options;
+    if (uv__gai_cache.options.max_entries == 0)
+      uv__gai_cache.options.max_entries = UV__GAI_CACHE_DEFAULT_ENTRIES;
+    uv__gai_cache_trim(uv__gai_cache.options.max_entries);
+  }
+
+  /* Never reset, lists handed out earlier must still go to uv__free(). */
+  uv__store_relaxed(&uv__gai_cache_used, 1);
+  uv_mutex_unlock(&uv__gai_cache.mutex);
+
+  return 0;
+}
+
+
 static void uv__getaddrinfo_work(struct uv__work* w) {
   uv_getaddrinfo_t* req;
   int err;
@@ -102,6 +615,7 @@ static void uv__getaddrinfo_work(struct uv__work* w) {
   req = container_of(w, uv_getaddrinfo_t, work_req);
   err = getaddrinfo(req->hostname, req->service, req->hints, &req->addrinfo);
   req->retcode = uv__getaddrinfo_translate_error(err);
+  uv__gai_cache_store(req, (uint64_t) -1);
 }
 
 
@@ -128,6 +642,9 @@ static void uv__getaddrinfo_done(struct uv__work* w, int status) {
   if (status == UV_ECANCELED) {
     assert(req->retcode == 0);
     req->retcode = UV_EAI_CANCELED;
+  } else if (status == UV_ETIMEDOUT) {
+    assert(req->retcode == 0);
+    req->retcode = UV_ETIMEDOUT;
   }
 
   if (req->cb)
@@ -135,39 +652,17 @@ static void uv__getaddrinfo_done(struct uv__work* w, int status) {
 }
 
 
-int uv_getaddrinfo(uv_loop_t* loop,
-                   uv_getaddrinfo_t* req,
-                   uv_getaddrinfo_cb cb,
-                   const char* hostname,
-                   const char* service,
-                   const struct addrinfo* hints) {
-  char hostname_ascii[256];
+static int uv__getaddrinfo_init(uv_loop_t* loop,
+                                uv_getaddrinfo_t* req,
+                                uv_getaddrinfo_cb cb,
+                                const char* hostname,
+                                const char* service,
+                                const struct addrinfo* hints) {
   size_t hostname_len;
   size_t service_len;
   size_t hints_len;
   size_t len;
   char* buf;
-  long rc;
-
-  if (req == NULL || (hostname == NULL && service == NULL))
-    return UV_EINVAL;
-
-  /* FIXME(bnoordhuis) IDNA does not seem to work z/OS,
-   * probably because it uses EBCDIC rather than ASCII.
-   */
-#ifdef __MVS__
-  (void) &hostname_ascii;
-#else
-  if (hostname != NULL) {
-    rc = uv__idna_toascii(hostname,
-                          hostname + strlen(hostname),
-                          hostname_ascii,
-                          hostname_ascii + sizeof(hostname_ascii));
-    if (rc < 0)
-      return rc;
-    hostname = hostname_ascii;
-  }
-#endif
 
   hostname_len = hostname ? strlen(hostname) + 1 : 0;
   service_len = service ? strlen(service) + 1 : 0;
@@ -202,15 +697,63 @@ int uv_getaddrinfo(uv_loop_t* loop,
   if (hostname)
     req->hostname = memcpy(buf + len, hostname, hostname_len);
 
+  return 0;
+}
+
+
+int uv_getaddrinfo(uv_loop_t* loop,
+                   uv_getaddrinfo_t* req,
+                   uv_getaddrinfo_cb cb,
+                   const char* hostname,
+                   const char* service,
+                   const struct addrinfo* hints) {
+  char hostname_ascii[256];
+  long rc;
+  int hit;
+
+  if (req == NULL || (hostname == NULL && service == NULL))
+    return UV_EINVAL;
+
+  /* FIXME(bnoordhuis) IDNA does not seem to work z/OS,
+   * probably because it uses EBCDIC rather than ASCII.
+   */
+#ifdef __MVS__
+  (void) &hostname_ascii;
+#else
+  if (hostname != NULL) {
+    rc = uv__idna_toascii(hostname,
+                          hostname + strlen(hostname),
+                          hostname_ascii,
+                          hostname_ascii + sizeof(hostname_ascii));
+    if (rc < 0)
+      return rc;
+    hostname = hostname_ascii;
+  }
+#endif
+
+  rc = uv__getaddrinfo_init(loop, req, cb, hostname, service, hints);
+  if (rc != 0)
+    return rc;
+
+  /* A stale entry is only good enough when the result is delivered
+   * asynchronously, the refresh needs a loop iteration to run on.
+   */
+  hit = uv__gai_cache_lookup(req, cb != NULL);
+
   if (cb) {
-    uv__work_submit(loop,
-                    &req->work_req,
-                    UV__WORK_SLOW_IO,
-                    uv__getaddrinfo_work,
-                    uv__getaddrinfo_done);
+    if (hit == UV__GAI_CACHE_MISS) {
+      uv__getaddrinfo_submit(loop, req);
+      return 0;
+    }
+
+    /* Hits skip the threadpool and complete on the next loop iteration. */
+    uv__work_post(loop, &req->work_req, uv__getaddrinfo_done);
+    if (hit == UV__GAI_CACHE_REFRESH)
+      uv__gai_cache_refresh(loop, req);
     return 0;
   } else {
-    uv__getaddrinfo_work(&req->work_req);
+    if (hit == UV__GAI_CACHE_MISS)
+      uv__getaddrinfo_work(&req->work_req);
     uv__getaddrinfo_done(&req->work_req, 0);
     return req->retcode;
   }
@@ -218,7 +761,10 @@ int uv_getaddrinfo(uv_loop_t* loop,
 
 
 void uv_freeaddrinfo(struct addrinfo* ai) {
-  if (ai)
+  if (ai == NULL)
+    return;
+
+  if (!uv__gai_cache_release(ai))
     freeaddrinfo(ai);
 }
 
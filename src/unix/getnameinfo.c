@@ -27,29 +27,310 @@
 #include "uv.h"
 #include "internal.h"
 
+#define UV__GNI_CACHE_DEFAULT_ENTRIES 1024
 
-static void uv__getnameinfo_work(struct uv__work* w) {
-  uv_getnameinfo_t* req;
-  int err;
-  socklen_t salen;
+/* Batch entries that still need a lookup. Never seen by the user, statuses
+ * are 0 or negative by the time the callback runs.
+ */
+#define UV__GNI_PENDING 1
 
-  req = container_of(w, uv_getnameinfo_t, work_req);
+/* Everything getnameinfo() looks at. Zeroed before it's filled in so that
+ * entries compare with memcmp().
+ */
+struct uv__gni_key {
+  unsigned char addr[16];
+  uint32_t scope_id;
+  int flags;
+  unsigned short family;
+  unsigned short port;
+};
+
+struct uv__gni_entry {
+  RB_ENTRY(uv__gni_entry) tree_entry;
+  QUEUE lru;
+  struct uv__gni_key key;
+  uint64_t expires;  /* In milliseconds, uv__hrtime() based. */
+  int retcode;
+  char* host;
+  char* service;
+};
+
+RB_HEAD(uv__gni_entries, uv__gni_entry);
+
+static struct {
+  uv_mutex_t mutex;
+  uv_getnameinfo_cache_options_t options;
+  struct uv__gni_entries entries;
+  unsigned int nentries;
+  QUEUE lru;
+  int enabled;
+} uv__gni_cache;
+
+static uv_once_t uv__gni_cache_once = UV_ONCE_INIT;
+static int uv__gni_cache_used;
+
+
+static int uv__gni_entry_cmp(const struct uv__gni_entry* a,
+                             const struct uv__gni_entry* b) {
+  return memcmp(&a->key, &b->key, sizeof(a->key));
+}
+
+
+RB_GENERATE_STATIC(uv__gni_entries, uv__gni_entry, tree_entry,
+                   uv__gni_entry_cmp)
+
+
+static void uv__gni_cache_init(void) {
+  if (uv_mutex_init(&uv__gni_cache.mutex))
+    abort();
+
+  QUEUE_INIT(&uv__gni_cache.lru);
+}
+
+
+static uint64_t uv__gni_cache_now(void) {
+  return uv__hrtime(UV_CLOCK_FAST) / 1000000;
+}
+
+
+static void uv__gni_cache_key(const struct sockaddr_storage* storage,
+                              int flags,
+                              struct uv__gni_key* key) {
+  const struct sockaddr_in6* a6;
+  const struct sockaddr_in* a4;
+
+  memset(key, 0, sizeof(*key));
+  key->flags = flags;
+  key->family = storage->ss_family;
+
+  if (storage->ss_family == AF_INET) {
+    a4 = (const struct sockaddr_in*) storage;
+    memcpy(key->addr, &a4->sin_addr, sizeof(a4->sin_addr));
+    key->port = a4->sin_port;
+  } else {
+    a6 = (const struct sockaddr_in6*) storage;
+    memcpy(key->addr, &a6->sin6_addr, sizeof(a6->sin6_addr));
+    key->port = a6->sin6_port;
+    key->scope_id = a6->sin6_scope_id;
+  }
+}
+
+
+/* Must be called with the cache mutex held. */
+static void uv__gni_cache_remove(struct uv__gni_entry* entry) {
+  RB_REMOVE(uv__gni_entries, &uv__gni_cache.entries, entry);
+  QUEUE_REMOVE(&entry->lru);
+  uv__gni_cache.nentries--;
+  uv__free(entry);
+}
+
+
+/* Must be called with the cache mutex held. Evicts the least recently used
+ * entries until the cache is within its limit again.
+ */
+static void uv__gni_cache_trim(unsigned int max_entries) {
+  QUEUE* q;
+
+  while (uv__gni_cache.nentries > max_entries) {
+    q = QUEUE_PREV(&uv__gni_cache.lru);
+    uv__gni_cache_remove(QUEUE_DATA(q, struct uv__gni_entry, lru));
+  }
+}
+
+
+/* Returns 1 and fills in |host| and |service|, buffers of NI_MAXHOST and
+ * NI_MAXSERV bytes, when |key| has a fresh entry.
+ */
+static int uv__gni_cache_lookup(const struct uv__gni_key* key,
+                                int* retcode,
+                                char* host,
+                                char* service) {
+  struct uv__gni_entry lookup;
+  struct uv__gni_entry* entry;
+  int hit;
+
+  if (!uv__load_relaxed(&uv__gni_cache_used))
+    return 0;
+
+  hit = 0;
+  lookup.key = *key;
+  uv_mutex_lock(&uv__gni_cache.mutex);
+
+  if (!uv__gni_cache.enabled)
+    goto out;
+
+  entry = RB_FIND(uv__gni_entries, &uv__gni_cache.entries, &lookup);
+  if (entry == NULL)
+    goto out;
+
+  if (uv__gni_cache_now() >= entry->expires) {
+    uv__gni_cache_remove(entry);
+    goto out;
+  }
+
+  *retcode = entry->retcode;
+  if (entry->retcode == 0) {
+    strcpy(host, entry->host);
+    strcpy(service, entry->service);
+  }
+
+  QUEUE_REMOVE(&entry->lru);
+  QUEUE_INSERT_HEAD(&uv__gni_cache.lru, &entry->lru);
+  hit = 1;
+
+out:
+  uv_mutex_unlock(&uv__gni_cache.mutex);
+  return hit;
+}
+
+
+/* Successful lookups and lookups of addresses without a name are cached,
+ * transient errors are not.
+ */
+static void uv__gni_cache_store(const struct uv__gni_key* key,
+                                int retcode,
+                                const char* host,
+                                const char* service) {
+  struct uv__gni_entry lookup;
+  struct uv__gni_entry* entry;
+  size_t host_len;
+  size_t service_len;
+  uint64_t ttl;
+
+  if (!uv__load_relaxed(&uv__gni_cache_used))
+    return;
+
+  host_len = 0;
+  service_len = 0;
+  if (retcode == 0) {
+    host_len = strlen(host) + 1;
+    service_len = strlen(service) + 1;
+  }
+
+  lookup.key = *key;
+  uv_mutex_lock(&uv__gni_cache.mutex);
+
+  if (!uv__gni_cache.enabled)
+    goto out;
+
+  switch (retcode) {
+  case 0:
+    ttl = uv__gni_cache.options.ttl;
+    break;
+  case UV_EAI_NONAME:
+  case UV_EAI_NODATA:
+    ttl = uv__gni_cache.options.negative_ttl;
+    break;
+  default:
+    ttl = 0;
+  }
+
+  if (ttl == 0)
+    goto out;
+
+  /* Replaced rather than updated, the strings live in the same allocation. */
+  entry = RB_FIND(uv__gni_entries, &uv__gni_cache.entries, &lookup);
+  if (entry != NULL)
+    uv__gni_cache_remove(entry);
+
+  entry = uv__malloc(sizeof(*entry) + host_len + service_len);
+  if (entry == NULL)
+    goto out;
+
+  entry->key = *key;
+  entry->retcode = retcode;
+  entry->expires = uv__gni_cache_now() + ttl;
+  entry->host = NULL;
+  entry->service = NULL;
+  if (retcode == 0) {
+    entry->host = memcpy(entry + 1, host, host_len);
+    entry->service = memcpy(entry->host + host_len, service, service_len);
+  }
+
+  RB_INSERT(uv__gni_entries, &uv__gni_cache.entries, entry);
+  QUEUE_INSERT_HEAD(&uv__gni_cache.lru, &entry->lru);
+  uv__gni_cache.nentries++;
+  uv__gni_cache_trim(uv__gni_cache.options.max_entries);
+
+out:
+  uv_mutex_unlock(&uv__gni_cache.mutex);
+}
+
+
+int uv_getnameinfo_cache_configure(
+    const uv_getnameinfo_cache_options_t* options) {
+  struct uv__gni_entry* entry;
+
+  if (options != NULL && options->ttl == 0)
+    return UV_EINVAL;
+
+  uv_once(&uv__gni_cache_once, uv__gni_cache_init);
+  uv_mutex_lock(&uv__gni_cache.mutex);
 
-  if (req->storage.ss_family == AF_INET)
+  if (options == NULL) {
+    uv__gni_cache.enabled = 0;
+    while (NULL != (entry = RB_MIN(uv__gni_entries, &uv__gni_cache.entries)))
+      uv__gni_cache_remove(entry);
+  } else {
+    uv__gni_cache.enabled = 1;
+    uv__gni_cache.options = *options;
+    if (uv__gni_cache.options.max_entries == 0)
+      uv__gni_cache.options.max_entries = UV__GNI_CACHE_DEFAULT_ENTRIES;
+    uv__gni_cache_trim(uv__gni_cache.options.max_entries);
+  }
+
+  uv__store_relaxed(&uv__gni_cache_used, 1);
+  uv_mutex_unlock(&uv__gni_cache.mutex);
+
+  return 0;
+}
+
+
+/* |host| and |service| are NI_MAXHOST and NI_MAXSERV bytes. */
+static int uv__getnameinfo_resolve(const struct sockaddr_storage* storage,
+                                   int flags,
+                                   char* host,
+                                   char* service) {
+  struct uv__gni_key key;
+  socklen_t salen;
+  int retcode;
+  int err;
+
+  if (storage->ss_family == AF_INET)
     salen = sizeof(struct sockaddr_in);
-  else if (req->storage.ss_family == AF_INET6)
+  else if (storage->ss_family == AF_INET6)
     salen = sizeof(struct sockaddr_in6);
   else
     abort();
 
-  err = getnameinfo((struct sockaddr*) &req->storage,
+  /* Looked up again here, an earlier entry of the same batch or a request
+   * on another thread may have filled it in the meantime.
+   */
+  uv__gni_cache_key(storage, flags, &key);
+  if (uv__gni_cache_lookup(&key, &retcode, host, service))
+    return retcode;
+
+  err = getnameinfo((const struct sockaddr*) storage,
                     salen,
-                    req->host,
-                    sizeof(req->host),
-                    req->service,
-                    sizeof(req->service),
-                    req->flags);
-  req->retcode = uv__getaddrinfo_translate_error(err);
+                    host,
+                    NI_MAXHOST,
+                    service,
+                    NI_MAXSERV,
+                    flags);
+  retcode = uv__getaddrinfo_translate_error(err);
+  uv__gni_cache_store(&key, retcode, host, service);
+  return retcode;
+}
+
+
+static void uv__getnameinfo_work(struct uv__work* w) {
+  uv_getnameinfo_t* req;
+
+  req = container_of(w, uv_getnameinfo_t, work_req);
+  req->retcode = uv__getnameinfo_resolve(&req->storage,
+                                         req->flags,
+                                         req->host,
+                                         req->service);
 }
 
 static void uv__getnameinfo_done(struct uv__work* w, int status) {
@@ -64,6 +345,9 @@ static void uv__getnameinfo_done(struct uv__work* w, int status) {
   if (status == UV_ECANCELED) {
     assert(req->retcode == 0);
     req->retcode = UV_EAI_CANCELED;
+  } else if (status == UV_ETIMEDOUT) {
+    assert(req->retcode == 0);
+    req->retcode = UV_ETIMEDOUT;
   } else if (req->retcode == 0) {
     host = req->host;
     service = req->service;
@@ -83,6 +367,9 @@ int uv_getnameinfo(uv_loop_t* loop,
                    uv_getnameinfo_cb getnameinfo_cb,
                    const struct sockaddr* addr,
                    int flags) {
+  struct uv__gni_key key;
+  int hit;
+
   if (req == NULL || addr == NULL)
     return UV_EINVAL;
 
@@ -106,7 +393,16 @@ int uv_getnameinfo(uv_loop_t* loop,
   req->loop = loop;
   req->retcode = 0;
 
+  uv__gni_cache_key(&req->storage, flags, &key);
+  hit = uv__gni_cache_lookup(&key, &req->retcode, req->host, req->service);
+
   if (getnameinfo_cb) {
+    /* Hits skip the threadpool and complete on the next loop iteration. */
+    if (hit) {
+      uv__work_post(loop, &req->work_req, uv__getnameinfo_done);
+      return 0;
+    }
+
     uv__work_submit(loop,
                     &req->work_req,
                     UV__WORK_SLOW_IO,
@@ -114,8 +410,110 @@ int uv_getnameinfo(uv_loop_t* loop,
                     uv__getnameinfo_done);
     return 0;
   } else {
-    uv__getnameinfo_work(&req->work_req);
+    if (!hit)
+      uv__getnameinfo_work(&req->work_req);
     uv__getnameinfo_done(&req->work_req, 0);
     return req->retcode;
   }
 }
+
+
+static void uv__getnameinfo_many_work(struct uv__work* w) {
+  uv_getnameinfo_many_t* req;
+  uv_nameinfo_t* name;
+  unsigned int i;
+
+  req = container_of(w, uv_getnameinfo_many_t, work_req);
+
+  for (i = 0; i < req->nnames; i++) {
+    name = &req->names[i];
+    if (name->status == UV__GNI_PENDING)
+      name->status = uv__getnameinfo_resolve(&name->addr,
+                                             req->flags,
+                                             name->host,
+                                             name->service);
+  }
+}
+
+
+static void uv__getnameinfo_many_done(struct uv__work* w, int status) {
+  uv_getnameinfo_many_t* req;
+  unsigned int i;
+  int retcode;
+
+  req = container_of(w, uv_getnameinfo_many_t, work_req);
+  uv__req_unregister(req->loop, req);
+
+  retcode = UV_EAI_CANCELED;
+  if (status == UV_ETIMEDOUT)
+    retcode = UV_ETIMEDOUT;
+
+  for (i = 0; i < req->nnames; i++)
+    if (req->names[i].status == UV__GNI_PENDING)
+      req->names[i].status = retcode;
+
+  req->cb(req, status);
+}
+
+
+int uv_getnameinfo_many(uv_loop_t* loop,
+                        uv_getnameinfo_many_t* req,
+                        uv_nameinfo_t names[],
+                        unsigned int nnames,
+                        int flags,
+                        uv_getnameinfo_many_cb cb) {
+  struct uv__gni_key key;
+  uv_nameinfo_t* name;
+  unsigned int pending;
+  unsigned int i;
+
+  if (nnames > 0 && names == NULL)
+    return UV_EINVAL;
+
+  /* Cache hits are answered here, the pool only gets the rest. */
+  pending = 0;
+  for (i = 0; i < nnames; i++) {
+    name = &names[i];
+    name->host[0] = '\0';
+    name->service[0] = '\0';
+
+    if (name->addr.ss_family != AF_INET && name->addr.ss_family != AF_INET6) {
+      name->status = UV_EINVAL;
+      continue;
+    }
+
+    uv__gni_cache_key(&name->addr, flags, &key);
+    if (uv__gni_cache_lookup(&key, &name->status, name->host, name->service))
+      continue;
+
+    name->status = UV__GNI_PENDING;
+    pending++;
+  }
+
+  if (cb == NULL) {
+    for (i = 0; i < nnames; i++)
+      if (names[i].status == UV__GNI_PENDING)
+        names[i].status = uv__getnameinfo_resolve(&names[i].addr,
+                                                  flags,
+                                                  names[i].host,
+                                                  names[i].service);
+    return 0;
+  }
+
+  uv__req_init(loop, req, UV_GETNAMEINFO_MANY);
+  req->loop = loop;
+  req->names = names;
+  req->nnames = nnames;
+  req->flags = flags;
+  req->cb = cb;
+
+  if (pending == 0)
+    uv__work_post(loop, &req->work_req, uv__getnameinfo_many_done);
+  else
+    uv__work_submit(loop,
+                    &req->work_req,
+                    UV__WORK_SLOW_IO,
+                    uv__getnameinfo_many_work,
+                    uv__getnameinfo_many_done);
+  return 0;
+}
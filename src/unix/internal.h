@@ -50,6 +50,14 @@
 # include <port.h>
 #endif /* __sun */
 
+#if defined(UV_HAVE_KQUEUE)
+# include <sys/event.h>
+# if defined(EVFILT_USER) && defined(NOTE_TRIGGER)
+/* uv_async_send() wakes the loop with an EVFILT_USER event, see async.c. */
+#  define UV__KQUEUE_EVFILT_USER 1
+# endif
+#endif /* UV_HAVE_KQUEUE */
+
 #if defined(_AIX)
 # define reqevents events
 # define rtnevents revents
@@ -133,6 +141,25 @@ int uv__pthread_sigmask(int how, const sigset_t* set, sigset_t* oset);
 # define UV__POLLPRI 0
 #endif
 
+/* Set in uv__io_t.events by the epoll backend for watchers that it has
+ * registered edge-triggered, see UV_LOOP_EDGE_TRIGGERED. Same value as
+ * EPOLLET.
+ */
+#if defined(__linux__)
+# define UV__POLLET 0x80000000u
+#else
+# define UV__POLLET 0
+#endif
+
+/* Set in uv__io_t.events for listening sockets that the epoll backend has
+ * registered with EPOLLEXCLUSIVE. Same value as EPOLLEXCLUSIVE.
+ */
+#if defined(__linux__)
+# define UV__POLLEXCLUSIVE 0x10000000u
+#else
+# define UV__POLLEXCLUSIVE 0
+#endif
+
 #if !defined(O_CLOEXEC) && defined(__FreeBSD__)
 /*
  * It may be that we are just missing `__POSIX_VISIBLE >= 200809`.
@@ -157,7 +184,8 @@ enum {
 
 typedef enum {
   UV_CLOCK_PRECISE = 0,  /* Use the highest resolution clock available. */
-  UV_CLOCK_FAST = 1      /* Use the fastest clock with <= 1ms granularity. */
+  UV_CLOCK_FAST = 1,     /* Use the fastest clock with <= 1ms granularity. */
+  UV_CLOCK_COARSE = 2    /* Use the fastest clock, whatever its granularity. */
 } uv_clocktype_t;
 
 struct uv__stream_queued_fds_s {
@@ -203,8 +231,10 @@ int uv__nonblock_ioctl(int fd, int set);
 int uv__nonblock_fcntl(int fd, int set);
 int uv__close(int fd); /* preserves errno */
 int uv__close_nocheckstdio(int fd);
+void uv__close_batched(uv_loop_t* loop, int fd);
 int uv__close_nocancel(int fd);
 int uv__socket(int domain, int type, int protocol);
+ssize_t uv__readv(int fd, const struct iovec* iov, int iovcnt);
 ssize_t uv__recvmsg(int fd, struct msghdr *msg, int flags);
 void uv__make_close_pending(uv_handle_t* handle);
 int uv__getiovmax(void);
@@ -213,16 +243,41 @@ void uv__io_init(uv__io_t* w, uv__io_cb cb, int fd);
 void uv__io_start(uv_loop_t* loop, uv__io_t* w, unsigned int events);
 void uv__io_stop(uv_loop_t* loop, uv__io_t* w, unsigned int events);
 void uv__io_close(uv_loop_t* loop, uv__io_t* w);
+void uv__io_detach(uv_loop_t* loop, uv__io_t* w);
+int uv__io_set_priority(uv_loop_t* loop, int fd, unsigned int priority);
+unsigned int uv__io_priority(uv_loop_t* loop, int fd);
+void uv__io_reset_priority(uv_loop_t* loop, int fd);
+void uv__io_attach(uv_loop_t* loop, uv__io_t* w);
 void uv__io_feed(uv_loop_t* loop, uv__io_t* w);
+void uv__io_ready(uv_loop_t* loop, uv__io_t* w, unsigned int events);
 int uv__io_active(const uv__io_t* w, unsigned int events);
 int uv__io_check_fd(uv_loop_t* loop, int fd);
 void uv__io_poll(uv_loop_t* loop, int timeout); /* in milliseconds or -1 */
 int uv__io_fork(uv_loop_t* loop);
 int uv__fd_exists(uv_loop_t* loop, int fd);
+int uv__fd_map_init(uv_loop_t* loop);
+void uv__fd_map_delete(uv_loop_t* loop);
+void uv__io_dispatch_timed(uv_loop_t* loop, uv__io_t* w, unsigned int events);
+
+/* Runs the watcher's callback, timed when a UV_LOOP_SLOW_CALLBACK hook is
+ * installed or the loop is traced.
+ */
+#define uv__io_dispatch(loop, w, events)                                      \
+  do {                                                                        \
+    if (!uv__callbacks_timed(loop) && !uv__metrics_lag_enabled(loop))         \
+      (w)->cb((loop), (w), (events));                                         \
+    else                                                                      \
+      uv__io_dispatch_timed((loop), (w), (events));                           \
+  }                                                                           \
+  while (0)
 
 /* async */
 void uv__async_stop(uv_loop_t* loop);
 int uv__async_fork(uv_loop_t* loop);
+void uv__async_run_start(uv_loop_t* loop);
+void uv__async_run_stop(uv_loop_t* loop);
+int uv__async_poll_start(uv_loop_t* loop, int timeout);
+void uv__async_poll_stop(uv_loop_t* loop);
 
 
 /* loop */
@@ -234,11 +289,24 @@ void uv__run_prepare(uv_loop_t* loop);
 void uv__stream_init(uv_loop_t* loop, uv_stream_t* stream,
     uv_handle_type type);
 int uv__stream_open(uv_stream_t*, int fd, int flags);
+int uv__stream_zerocopy(uv_stream_t* stream, size_t threshold);
+int uv__stream_set_io_stats(uv_stream_t* stream, int enable);
+int uv__stream_set_writable_cb(uv_stream_t* stream, uv_tcp_writable_cb cb);
+int uv__stream_has_accept_policy(const uv_stream_t* stream);
+int uv__stream_has_rx_timestamps(const uv_stream_t* stream);
+int uv__stream_rx_timestamps(uv_stream_t* stream, int enable);
+int uv__stream_read_timestamp(const uv_stream_t* stream, uv_timespec_t* ts);
+int uv__stream_set_write_buffer(uv_stream_t* stream, size_t size);
+uv_io_stats_t* uv__stream_io_stats(const uv_stream_t* stream);
+int uv__stream_detach(uv_stream_t* stream);
+void uv__stream_attach(uv_stream_t* stream);
 void uv__stream_destroy(uv_stream_t* stream);
+int uv__stream_queue_fd(uv_stream_t* stream, int fd);
 #if defined(__APPLE__)
 int uv__stream_try_select(uv_stream_t* stream, int* fd);
 #endif /* defined(__APPLE__) */
 void uv__server_io(uv_loop_t* loop, uv__io_t* w, unsigned int events);
+void uv__stream_io(uv_loop_t* loop, uv__io_t* w, unsigned int events);
 int uv__accept(int sockfd);
 int uv__dup2_cloexec(int oldfd, int newfd);
 int uv__open_cloexec(const char* path, int flags);
@@ -260,7 +328,14 @@ int uv__signal_loop_fork(uv_loop_t* loop);
 /* platform specific */
 uint64_t uv__hrtime(uv_clocktype_t type);
 int uv__kqueue_init(uv_loop_t* loop);
+int uv__kqueue_buffer_size(uv_loop_t* loop, unsigned int nevents);
 int uv__epoll_init(uv_loop_t* loop);
+int uv__epoll_busy_poll(uv_loop_t* loop, unsigned int usec);
+void uv__epoll_prefer_busy_poll(uv_loop_t* loop);
+int uv__epoll_buffer_size(uv_loop_t* loop, unsigned int nevents);
+int uv__epoll_io_budget(uv_loop_t* loop,
+                        unsigned int ncallbacks,
+                        unsigned int time);
 int uv__platform_loop_init(uv_loop_t* loop);
 void uv__platform_loop_delete(uv_loop_t* loop);
 void uv__platform_invalidate_fd(uv_loop_t* loop, int fd);
@@ -269,21 +344,52 @@ void uv__platform_invalidate_fd(uv_loop_t* loop, int fd);
 void uv__async_close(uv_async_t* handle);
 void uv__check_close(uv_check_t* handle);
 void uv__fs_event_close(uv_fs_event_t* handle);
+void uv__fs_post(uv_loop_t* loop, uv_fs_t* req);
 void uv__idle_close(uv_idle_t* handle);
+void uv__netif_close(uv_netif_t* handle);
 void uv__pipe_close(uv_pipe_t* handle);
 void uv__poll_close(uv_poll_t* handle);
+void uv__poll_io(uv_loop_t* loop, uv__io_t* w, unsigned int events);
 void uv__prepare_close(uv_prepare_t* handle);
 void uv__process_close(uv_process_t* handle);
 void uv__stream_close(uv_stream_t* handle);
 void uv__tcp_close(uv_tcp_t* handle);
 size_t uv__thread_stack_size(void);
 void uv__udp_close(uv_udp_t* handle);
+void uv__udp_io(uv_loop_t* loop, uv__io_t* w, unsigned int revents);
 void uv__udp_finish_close(uv_udp_t* handle);
+int uv__udp_set_io_stats(uv_udp_t* handle, int enable);
+uv_io_stats_t* uv__udp_io_stats(const uv_udp_t* handle);
+int uv__udp_detach(uv_udp_t* handle);
+void uv__udp_attach(uv_udp_t* handle);
 uv_handle_type uv__handle_type(int fd);
 FILE* uv__open_file(const char* path);
 int uv__getpwuid_r(uv_passwd_t* pwd);
 int uv__search_path(const char* prog, char* buf, size_t* buflen);
 void uv__wait_children(uv_loop_t* loop);
+int uv__spawn_and_init_child_fork(uv_loop_t* loop,
+                                  const uv_process_options_t* options,
+                                  int stdio_count,
+                                  int (*pipes)[2],
+                                  pid_t* pid,
+                                  int* exec_errorno);
+
+/* spawn-server */
+int uv__spawn_server_spawn(const uv_process_options_t* options,
+                           int stdio_count,
+                           int (*pipes)[2],
+                           pid_t* pid,
+                           int* exec_errorno,
+                           int* exit_fd);
+
+/* dns */
+int uv__dns_enable(uv_loop_t* loop, const char* resolv_conf);
+int uv__dns_getaddrinfo(uv_getaddrinfo_t* req);
+void uv__dns_loop_close(uv_loop_t* loop);
+void uv__getaddrinfo_complete(uv_getaddrinfo_t* req,
+                              int retcode,
+                              const struct addrinfo* ai,
+                              uint64_t ttl);
 
 /* random */
 int uv__random_devurandom(void* buf, size_t buflen);
@@ -309,10 +415,76 @@ void uv__fsevents_loop_delete(uv_loop_t* loop);
 
 #endif /* defined(__APPLE__) */
 
-UV_UNUSED(static void uv__update_time(uv_loop_t* loop)) {
+/* Watchers by file descriptor. loop->watchers is a table of pages of
+ * UV__FD_PAGE_SIZE watchers that are allocated when the first file
+ * descriptor in their range is watched, so the cost follows the number of
+ * watched file descriptors rather than the highest one. loop->nwatchers is
+ * the number of file descriptors the table covers. The two slots after the
+ * last page hold the events of the poll that is being dispatched and their
+ * count, see uv__platform_invalidate_fd().
+ */
+#define UV__FD_PAGE_SHIFT 9
+#define UV__FD_PAGE_SIZE (1u << UV__FD_PAGE_SHIFT)
+
+#define uv__fd_map_events(loop)                                               \
+  ((loop)->watchers[(loop)->nwatchers >> UV__FD_PAGE_SHIFT])
+
+#define uv__fd_map_nevents(loop)                                              \
+  ((loop)->watchers[((loop)->nwatchers >> UV__FD_PAGE_SHIFT) + 1])
+
+UV_UNUSED(static uv__io_t* uv__fd_watcher(const uv_loop_t* loop, int fd)) {
+  uv__io_t** page;
+
+  if ((unsigned) fd >= loop->nwatchers)
+    return NULL;
+
+  page = loop->watchers[(unsigned) fd >> UV__FD_PAGE_SHIFT];
+  if (page == NULL)
+    return NULL;
+
+  return page[fd & (UV__FD_PAGE_SIZE - 1)];
+}
+
+/* The current time on the clock of loop->time, in milliseconds. */
+UV_UNUSED(static uint64_t uv__loop_clock(uv_loop_t* loop)) {
+  uv_clocktype_t type;
+
   /* Use a fast time source if available.  We only need millisecond precision.
    */
-  loop->time = uv__hrtime(UV_CLOCK_FAST) / 1000000;
+  type = UV_CLOCK_FAST;
+  if (uv__get_internal_fields(loop)->flags & UV__LOOP_COARSE_CLOCK)
+    type = UV_CLOCK_COARSE;
+
+  return uv__hrtime(type) / 1000000;
+}
+
+UV_UNUSED(static void uv__update_time(uv_loop_t* loop)) {
+  loop->time = uv__loop_clock(loop);
+}
+
+/* Account for a read(2)-like system call that returned |n|, see
+ * uv_handle_set_io_stats(). |stats| is NULL when they are off.
+ */
+UV_UNUSED(static void uv__io_stats_read(uv_io_stats_t* stats, ssize_t n)) {
+  if (stats == NULL)
+    return;
+
+  stats->read_calls++;
+  if (n > 0)
+    stats->bytes_read += n;
+  else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    stats->read_eagain++;
+}
+
+UV_UNUSED(static void uv__io_stats_write(uv_io_stats_t* stats, ssize_t n)) {
+  if (stats == NULL)
+    return;
+
+  stats->write_calls++;
+  if (n > 0)
+    stats->bytes_written += n;
+  else if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    stats->write_eagain++;
 }
 
 UV_UNUSED(static char* uv__basename_r(const char* path)) {
@@ -327,6 +499,47 @@ UV_UNUSED(static char* uv__basename_r(const char* path)) {
 
 #if defined(__linux__)
 int uv__inotify_fork(uv_loop_t* loop, void* old_watchers);
+int uv__numa_node_cpumask(unsigned int node, char* cpumask, size_t mask_size);
+int uv__netlink_interface_addresses(uv_interface_address_t** addresses,
+                                    int* count);
+
+#define uv__iou_enabled(loop)                                                 \
+  (uv__get_internal_fields(loop)->iou.ringfd != -1)
+
+int uv__iou_enable(uv_loop_t* loop);
+void uv__iou_fork_release(uv_loop_t* loop);
+int uv__iou_fork(uv_loop_t* loop);
+void uv__iou_loop_init(uv_loop_t* loop);
+void uv__iou_loop_delete(uv_loop_t* loop);
+void uv__iou_invalidate_fd(uv_loop_t* loop, int fd);
+void uv__iou_io_poll(uv_loop_t* loop, int timeout);
+int uv__iou_fs_close(uv_loop_t* loop, uv_fs_t* req);
+int uv__iou_fs_fsync_or_fdatasync(uv_loop_t* loop,
+                                  uv_fs_t* req,
+                                  uint32_t fsync_flags);
+int uv__iou_fs_open(uv_loop_t* loop, uv_fs_t* req);
+int uv__iou_fs_read_or_write(uv_loop_t* loop, uv_fs_t* req, int is_read);
+int uv__iou_fs_write_batch(uv_loop_t* loop, uv_fs_t* req);
+int uv__iou_fs_statx(uv_loop_t* loop,
+                     uv_fs_t* req,
+                     int is_fstat,
+                     int is_lstat);
+ssize_t uv__iou_readv(uv_loop_t* loop,
+                      int fd,
+                      const struct iovec* iov,
+                      int iovcnt);
+int uv__iou_buffered(uv_loop_t* loop, int fd);
+void uv__iou_stop_multishot(uv_loop_t* loop, int fd);
+void uv__statx_to_stat(const struct uv__statx* statxbuf, uv_stat_t* buf);
+#else
+#define uv__iou_readv(loop, fd, iov, iovcnt) uv__readv(fd, iov, iovcnt)
+#define uv__iou_buffered(loop, fd) 0
+#define uv__iou_fs_close(loop, req) 0
+#define uv__iou_fs_fsync_or_fdatasync(loop, req, fsync_flags) 0
+#define uv__iou_fs_open(loop, req) 0
+#define uv__iou_fs_read_or_write(loop, req, is_read) 0
+#define uv__iou_fs_write_batch(loop, req) 0
+#define uv__iou_fs_statx(loop, req, is_fstat, is_lstat) 0
 #endif
 
 typedef int (*uv__peersockfunc)(int, struct sockaddr*, socklen_t*);
@@ -336,6 +549,19 @@ int uv__getsockpeername(const uv_handle_t* handle,
                         struct sockaddr* name,
                         int* namelen);
 
+int uv__reuseport_steer_by_cpu(int fd);
+int uv__busy_poll(uv_loop_t* loop, int fd, unsigned int usec);
+
+/* Room for the SCM_TIMESTAMPING and SCM_TIMESTAMPNS control messages of
+ * uv__rx_timestamp().
+ */
+#define UV__RX_TIMESTAMP_SPACE                                                \
+  (CMSG_SPACE(3 * sizeof(struct timespec)) +                                  \
+   CMSG_SPACE(sizeof(struct timespec)))
+
+int uv__rx_timestamps(int fd, int enable);
+int uv__rx_timestamp(struct msghdr* h, uv_timespec_t* ts);
+
 #if defined(__linux__)            ||                                      \
     defined(__FreeBSD__)          ||                                      \
     defined(__FreeBSD_kernel__)   ||                                       \
@@ -18,6 +18,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_LOOP
+
 #include "uv.h"
 #include "internal.h"
 
@@ -45,6 +47,40 @@
 #define EV_OOBAND  EV_FLAG1
 #endif
 
+/* Bounds of the UV_LOOP_EVENT_BUFFER_SIZE buffer. It doubles after this many
+ * consecutive polls filled it.
+ */
+#define UV__KQUEUE_EVENTS_MAX (64 * 1024)
+#define UV__KQUEUE_GROW_AFTER 4
+
+/* EV_DELETEs that wait for the next kevent() call instead of getting one of
+ * their own, stored in uv__loop_internal_fields_t.poll_changes. They're for
+ * filters that fired when their watcher no longer wanted them. |w| is that
+ * watcher, an EV_ADD by it cancels the EV_DELETE out. It's NULL when the fd
+ * had no watcher at all, the fd may have been closed and reused since.
+ */
+struct uv__kqueue_change {
+  struct kevent ev;
+  uv__io_t* w;
+};
+
+struct uv__kqueue_changes {
+  unsigned int n;
+  unsigned int size;
+  struct uv__kqueue_change entries[1];
+};
+
+/* The changelist of the kevent() call that's being put together. The
+ * deferred EV_DELETEs come first, at the same indices as in the
+ * uv__kqueue_changes they were taken from.
+ */
+struct uv__kqueue_changelist {
+  struct kevent* events;
+  unsigned int capacity;
+  unsigned int nevents;
+  unsigned int ndeferred;
+};
+
 static void uv__fs_event(uv_loop_t* loop, uv__io_t* w, unsigned int fflags);
 
 
@@ -70,6 +106,11 @@ int uv__io_fork(uv_loop_t* loop) {
   if (err)
     return err;
 
+  /* The new kqueue has none of the filters they were meant for. */
+  if (uv__get_internal_fields(loop)->poll_changes != NULL)
+    ((struct uv__kqueue_changes*) uv__get_internal_fields(loop)->poll_changes)
+        ->n = 0;
+
 #if defined(__APPLE__) && MAC_OS_X_VERSION_MAX_ALLOWED >= 1070
   if (loop->cf_state != NULL) {
     /* We cannot start another CFRunloop and/or thread in the child
@@ -109,9 +150,231 @@ int uv__io_check_fd(uv_loop_t* loop, int fd) {
 }
 
 
+int uv__kqueue_buffer_size(uv_loop_t* loop, unsigned int nevents) {
+  uv__loop_internal_fields_t* lfields;
+  struct kevent* events;
+
+  if (nevents == 0 || nevents > UV__KQUEUE_EVENTS_MAX)
+    return UV_EINVAL;
+
+  /* uv__io_poll() is using the buffer when called from a callback. */
+  if (uv__fd_map_events(loop) != NULL)
+    return UV_EBUSY;
+
+  lfields = uv__get_internal_fields(loop);
+  events = uv__malloc(nevents * sizeof(*events));
+  if (events == NULL)
+    return UV_ENOMEM;
+
+  uv__free(lfields->poll_events);
+  lfields->poll_events = events;
+  lfields->poll_nevents = nevents;
+  lfields->poll_saturated = 0;
+
+  return 0;
+}
+
+
+/* Called after a poll that returned `nfds` events, with the buffer no longer
+ * in use. Failing to grow it is no problem, the events that didn't fit are
+ * picked up by the next poll.
+ */
+static void uv__kqueue_buffer_update(uv_loop_t* loop, int nfds) {
+  uv__loop_internal_fields_t* lfields;
+  struct kevent* events;
+  unsigned int nevents;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->poll_events == NULL)
+    return;
+
+  if ((unsigned int) nfds < lfields->poll_nevents) {
+    lfields->poll_saturated = 0;
+    return;
+  }
+
+  if (++lfields->poll_saturated < UV__KQUEUE_GROW_AFTER)
+    return;
+
+  lfields->poll_saturated = 0;
+  nevents = lfields->poll_nevents * 2;
+  if (nevents > UV__KQUEUE_EVENTS_MAX)
+    return;
+
+  events = uv__realloc(lfields->poll_events, nevents * sizeof(*events));
+  if (events == NULL)
+    return;
+
+  lfields->poll_events = events;
+  lfields->poll_nevents = nevents;
+}
+
+
+static void uv__kqueue_delete_now(uv_loop_t* loop, const struct kevent* ev) {
+  if (kevent(loop->backend_fd, ev, 1, NULL, 0, NULL))
+    if (errno != EBADF && errno != ENOENT)
+      abort();
+}
+
+
+static void uv__kqueue_defer_delete(uv_loop_t* loop,
+                                    uv__io_t* w,
+                                    int fd,
+                                    int filter) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__kqueue_changes* changes;
+  struct uv__kqueue_change* entry;
+  struct kevent ev;
+  unsigned int size;
+
+  EV_SET(&ev, fd, filter, EV_DELETE, 0, 0, 0);
+
+  lfields = uv__get_internal_fields(loop);
+  changes = lfields->poll_changes;
+  if (changes == NULL || changes->n == changes->size) {
+    size = changes == NULL ? 16 : 2 * changes->size;
+    changes = uv__realloc(changes,
+                          sizeof(*changes) +
+                          (size - 1) * sizeof(changes->entries[0]));
+    if (changes == NULL) {
+      uv__kqueue_delete_now(loop, &ev);
+      return;
+    }
+
+    if (lfields->poll_changes == NULL)
+      changes->n = 0;
+    changes->size = size;
+    lfields->poll_changes = changes;
+  }
+
+  entry = changes->entries + changes->n++;
+  entry->ev = ev;
+  entry->w = w;
+
+  /* Have uv__io_poll() add it again if the watcher wants it back. */
+  if (w == NULL)
+    return;
+
+  if (filter == EVFILT_READ)
+    w->events &= ~POLLIN;
+  else if (filter == EVFILT_WRITE)
+    w->events &= ~POLLOUT;
+  else if (filter == EV_OOBAND)
+    w->events &= ~UV__POLLPRI;
+}
+
+
+/* Starts a changelist with the deferred EV_DELETEs. There are only this many
+ * when a lot of filters fired at once for watchers that had stopped, they
+ * don't get to crowd out the rest.
+ */
+static void uv__kqueue_changelist_init(uv_loop_t* loop,
+                                       struct uv__kqueue_changelist* cl,
+                                       struct kevent* stack_events,
+                                       unsigned int nstack_events) {
+  uv__loop_internal_fields_t* lfields;
+  struct uv__kqueue_changes* changes;
+  unsigned int i;
+
+  lfields = uv__get_internal_fields(loop);
+  cl->events = lfields->poll_events;
+  cl->capacity = lfields->poll_nevents;
+  if (cl->events == NULL) {
+    cl->events = stack_events;
+    cl->capacity = nstack_events;
+  }
+
+  cl->nevents = 0;
+  cl->ndeferred = 0;
+
+  changes = lfields->poll_changes;
+  if (changes == NULL || changes->n == 0)
+    return;
+
+  if (changes->n > cl->capacity / 2) {
+    for (i = 0; i < changes->n; i++)
+      uv__kqueue_delete_now(loop, &changes->entries[i].ev);
+    changes->n = 0;
+    return;
+  }
+
+  for (i = 0; i < changes->n; i++)
+    cl->events[i] = changes->entries[i].ev;
+
+  cl->nevents = changes->n;
+  cl->ndeferred = changes->n;
+}
+
+
+/* The changes in the changelist have been handed to the kernel. */
+static void uv__kqueue_changelist_done(uv_loop_t* loop,
+                                       struct uv__kqueue_changelist* cl) {
+  struct uv__kqueue_changes* changes;
+
+  changes = uv__get_internal_fields(loop)->poll_changes;
+  if (changes != NULL)
+    changes->n = 0;
+
+  cl->nevents = 0;
+  cl->ndeferred = 0;
+}
+
+
+static void uv__kqueue_changelist_add(uv_loop_t* loop,
+                                      struct uv__kqueue_changelist* cl,
+                                      uv__io_t* w,
+                                      int filter,
+                                      int op,
+                                      int fflags) {
+  struct uv__kqueue_changes* changes;
+  unsigned int last;
+  unsigned int i;
+
+  /* The filter is still there if its EV_DELETE hasn't gone out yet. */
+  changes = uv__get_internal_fields(loop)->poll_changes;
+  for (i = 0; i < cl->ndeferred; i++) {
+    if (changes->entries[i].w != w ||
+        (int) cl->events[i].ident != w->fd ||
+        cl->events[i].filter != filter)
+      continue;
+
+    last = --cl->ndeferred;
+    changes->entries[i] = changes->entries[last];
+    cl->events[i] = cl->events[last];
+    cl->events[last] = cl->events[--cl->nevents];
+    changes->n--;
+    return;
+  }
+
+  EV_SET(cl->events + cl->nevents, w->fd, filter, op, fflags, 0, 0);
+  if (++cl->nevents < cl->capacity)
+    return;
+
+  /* Full, hand it over now. The deferred EV_DELETEs may fail when the fd
+   * has been closed, do them one by one so they don't take the rest of the
+   * changes down with them.
+   */
+  for (i = 0; i < cl->ndeferred; i++)
+    uv__kqueue_delete_now(loop, cl->events + i);
+
+  if (kevent(loop->backend_fd,
+             cl->events + cl->ndeferred,
+             cl->nevents - cl->ndeferred,
+             NULL,
+             0,
+             NULL))
+    abort();
+
+  uv__kqueue_changelist_done(loop, cl);
+}
+
+
 void uv__io_poll(uv_loop_t* loop, int timeout) {
-  struct kevent events[1024];
+  struct kevent stack_events[1024];
+  struct uv__kqueue_changelist cl;
+  struct kevent* events;
   struct kevent* ev;
+  unsigned int capacity;
   struct timespec spec;
   unsigned int nevents;
   unsigned int revents;
@@ -132,12 +395,15 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int user_timeout;
   int reset_timeout;
 
-  if (loop->nfds == 0) {
+  if (loop->nfds == 0 && timeout == 0) {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
     return;
   }
 
-  nevents = 0;
+  uv__kqueue_changelist_init(loop,
+                             &cl,
+                             stack_events,
+                             ARRAY_SIZE(stack_events));
 
   while (!QUEUE_EMPTY(&loop->watcher_queue)) {
     q = QUEUE_HEAD(&loop->watcher_queue);
@@ -161,34 +427,22 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         op = EV_ADD | EV_ONESHOT; /* Stop the event from firing repeatedly. */
       }
 
-      EV_SET(events + nevents, w->fd, filter, op, fflags, 0, 0);
-
-      if (++nevents == ARRAY_SIZE(events)) {
-        if (kevent(loop->backend_fd, events, nevents, NULL, 0, NULL))
-          abort();
-        nevents = 0;
+#if defined(UV__KQUEUE_EVFILT_USER)
+      /* Its fd only names the event uv_async_send() triggers, see async.c. */
+      if (w == &loop->async_io_watcher && loop->async_wfd == -1) {
+        filter = EVFILT_USER;
+        op = EV_ADD | EV_CLEAR;
       }
-    }
-
-    if ((w->events & POLLOUT) == 0 && (w->pevents & POLLOUT) != 0) {
-      EV_SET(events + nevents, w->fd, EVFILT_WRITE, EV_ADD, 0, 0, 0);
+#endif
 
-      if (++nevents == ARRAY_SIZE(events)) {
-        if (kevent(loop->backend_fd, events, nevents, NULL, 0, NULL))
-          abort();
-        nevents = 0;
-      }
+      uv__kqueue_changelist_add(loop, &cl, w, filter, op, fflags);
     }
 
-   if ((w->events & UV__POLLPRI) == 0 && (w->pevents & UV__POLLPRI) != 0) {
-      EV_SET(events + nevents, w->fd, EV_OOBAND, EV_ADD, 0, 0, 0);
+    if ((w->events & POLLOUT) == 0 && (w->pevents & POLLOUT) != 0)
+      uv__kqueue_changelist_add(loop, &cl, w, EVFILT_WRITE, EV_ADD, 0);
 
-      if (++nevents == ARRAY_SIZE(events)) {
-        if (kevent(loop->backend_fd, events, nevents, NULL, 0, NULL))
-          abort();
-        nevents = 0;
-      }
-    }
+    if ((w->events & UV__POLLPRI) == 0 && (w->pevents & UV__POLLPRI) != 0)
+      uv__kqueue_changelist_add(loop, &cl, w, EV_OOBAND, EV_ADD, 0);
 
     w->events = w->pevents;
   }
@@ -212,7 +466,10 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     reset_timeout = 0;
   }
 
-  for (;; nevents = 0) {
+  for (;; uv__kqueue_changelist_init(loop,
+                                     &cl,
+                                     stack_events,
+                                     ARRAY_SIZE(stack_events))) {
     /* Only need to set the provider_entry_time if timeout != 0. The function
      * will return early if the loop isn't configured with UV_METRICS_IDLE_TIME.
      */
@@ -228,11 +485,14 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       pthread_sigmask(SIG_BLOCK, pset, NULL);
 
     nfds = kevent(loop->backend_fd,
-                  events,
-                  nevents,
-                  events,
-                  ARRAY_SIZE(events),
+                  cl.events,
+                  cl.nevents,
+                  cl.events,
+                  cl.capacity,
                   timeout == -1 ? NULL : &spec);
+    events = cl.events;
+    capacity = cl.capacity;
+    uv__kqueue_changelist_done(loop, &cl);
 
     if (pset != NULL)
       pthread_sigmask(SIG_UNBLOCK, pset, NULL);
@@ -242,6 +502,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
      * operating system didn't reschedule our process while in the syscall.
      */
     SAVE_ERRNO(uv__update_time(loop));
+    uv__metrics_poll(loop, nfds, capacity);
 
     if (nfds == 0) {
       if (reset_timeout != 0) {
@@ -280,8 +541,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     nevents = 0;
 
     assert(loop->watchers != NULL);
-    loop->watchers[loop->nwatchers] = (void*) events;
-    loop->watchers[loop->nwatchers + 1] = (void*) (uintptr_t) nfds;
+    uv__fd_map_events(loop) = (void*) events;
+    uv__fd_map_nevents(loop) = (void*) (uintptr_t) nfds;
     for (i = 0; i < nfds; i++) {
       ev = events + i;
       if (ev->filter == EVFILT_PROC) {
@@ -289,22 +550,20 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         nevents++;
         continue;
       }
+      /* A deferred EV_DELETE for a filter that went away with its fd, the
+       * kernel reports failed changes in place of events.
+       */
+      if ((ev->flags & EV_ERROR) && ev->data == ENOENT)
+        continue;
       fd = ev->ident;
       /* Skip invalidated events, see uv__platform_invalidate_fd */
       if (fd == -1)
         continue;
-      w = loop->watchers[fd];
+      w = uv__fd_watcher(loop, fd);
 
       if (w == NULL) {
-        /* File descriptor that we've stopped watching, disarm it.
-         * TODO: batch up. */
-        struct kevent events[1];
-
-        EV_SET(events + 0, fd, ev->filter, EV_DELETE, 0, 0, 0);
-        if (kevent(loop->backend_fd, events, 1, NULL, 0, NULL))
-          if (errno != EBADF && errno != ENOENT)
-            abort();
-
+        /* File descriptor that we've stopped watching, disarm it. */
+        uv__kqueue_defer_delete(loop, NULL, fd, ev->filter);
         continue;
       }
 
@@ -312,7 +571,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         assert(w->events == POLLIN);
         assert(w->pevents == POLLIN);
         uv__metrics_update_idle_time(loop);
-        w->cb(loop, w, ev->fflags); /* XXX always uv__fs_event() */
+        uv__io_dispatch(loop, w, ev->fflags); /* XXX always uv__fs_event() */
         nevents++;
         continue;
       }
@@ -324,12 +583,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
           revents |= POLLIN;
           w->rcount = ev->data;
         } else {
-          /* TODO batch up */
-          struct kevent events[1];
-          EV_SET(events + 0, fd, ev->filter, EV_DELETE, 0, 0, 0);
-          if (kevent(loop->backend_fd, events, 1, NULL, 0, NULL))
-            if (errno != ENOENT)
-              abort();
+          uv__kqueue_defer_delete(loop, w, fd, ev->filter);
         }
         if ((ev->flags & EV_EOF) && (w->pevents & UV__POLLRDHUP))
           revents |= UV__POLLRDHUP;
@@ -340,26 +594,23 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
           revents |= UV__POLLPRI;
           w->rcount = ev->data;
         } else {
-          /* TODO batch up */
-          struct kevent events[1];
-          EV_SET(events + 0, fd, ev->filter, EV_DELETE, 0, 0, 0);
-          if (kevent(loop->backend_fd, events, 1, NULL, 0, NULL))
-            if (errno != ENOENT)
-              abort();
+          uv__kqueue_defer_delete(loop, w, fd, ev->filter);
         }
       }
 
+#if defined(UV__KQUEUE_EVFILT_USER)
+      if (ev->filter == EVFILT_USER) {
+        assert(w == &loop->async_io_watcher);
+        revents |= POLLIN;
+      }
+#endif
+
       if (ev->filter == EVFILT_WRITE) {
         if (w->pevents & POLLOUT) {
           revents |= POLLOUT;
           w->wcount = ev->data;
         } else {
-          /* TODO batch up */
-          struct kevent events[1];
-          EV_SET(events + 0, fd, ev->filter, EV_DELETE, 0, 0, 0);
-          if (kevent(loop->backend_fd, events, 1, NULL, 0, NULL))
-            if (errno != ENOENT)
-              abort();
+          uv__kqueue_defer_delete(loop, w, fd, ev->filter);
         }
       }
 
@@ -376,7 +627,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         have_signals = 1;
       } else {
         uv__metrics_update_idle_time(loop);
-        w->cb(loop, w, revents);
+        uv__io_dispatch(loop, w, revents);
       }
 
       nevents++;
@@ -387,6 +638,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       uv__wait_children(loop);
     }
 
+    uv__metrics_inc_events(loop, nevents);
+
     if (reset_timeout != 0) {
       timeout = user_timeout;
       reset_timeout = 0;
@@ -394,17 +647,18 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
 
     if (have_signals != 0) {
       uv__metrics_update_idle_time(loop);
-      loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
+      uv__io_dispatch(loop, &loop->signal_io_watcher, POLLIN);
     }
 
-    loop->watchers[loop->nwatchers] = NULL;
-    loop->watchers[loop->nwatchers + 1] = NULL;
+    uv__fd_map_events(loop) = NULL;
+    uv__fd_map_nevents(loop) = NULL;
+    uv__kqueue_buffer_update(loop, nfds);
 
     if (have_signals != 0)
       return;  /* Event loop should cycle now so don't poll again. */
 
     if (nevents != 0) {
-      if (nfds == ARRAY_SIZE(events) && --count != 0) {
+      if ((unsigned int) nfds == capacity && --count != 0) {
         /* Poll for more events but don't block this time. */
         timeout = 0;
         continue;
@@ -431,6 +685,7 @@ update_timeout:
 
 
 void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
+  struct uv__kqueue_changes* changes;
   struct kevent* events;
   uintptr_t i;
   uintptr_t nfds;
@@ -438,8 +693,18 @@ void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
   assert(loop->watchers != NULL);
   assert(fd >= 0);
 
-  events = (struct kevent*) loop->watchers[loop->nwatchers];
-  nfds = (uintptr_t) loop->watchers[loop->nwatchers + 1];
+  /* Its deferred EV_DELETEs go too. Either the fd is closed and takes the
+   * filters with it, or any that fire again are disarmed then. They must not
+   * be cancelled out by the next watcher of a reused fd.
+   */
+  changes = uv__get_internal_fields(loop)->poll_changes;
+  if (changes != NULL)
+    for (i = changes->n; i-- > 0;)
+      if ((int) changes->entries[i].ev.ident == fd)
+        changes->entries[i] = changes->entries[--changes->n];
+
+  events = (struct kevent*) uv__fd_map_events(loop);
+  nfds = (uintptr_t) uv__fd_map_nevents(loop);
   if (events == NULL)
     return;
 
@@ -494,6 +759,7 @@ static void uv__fs_event(uv_loop_t* loop, uv__io_t* w, unsigned int fflags) {
 
 int uv_fs_event_init(uv_loop_t* loop, uv_fs_event_t* handle) {
   uv__handle_init(loop, (uv_handle_t*)handle, UV_FS_EVENT);
+  handle->u.reserved[0] = NULL;
   return 0;
 }
 
@@ -568,6 +834,7 @@ int uv_fs_event_stop(uv_fs_event_t* handle) {
   if (!uv__is_active(handle))
     return 0;
 
+  uv__fs_event_batch_stop(handle);
   uv__handle_stop(handle);
 
 #if defined(__APPLE__) && MAC_OS_X_VERSION_MAX_ALLOWED >= 1070
@@ -35,6 +35,7 @@
 #include <errno.h>
 
 #include <net/if.h>
+#include <sched.h>
 #include <sys/epoll.h>
 #include <sys/param.h>
 #include <sys/prctl.h>
@@ -86,6 +87,7 @@ int uv__platform_loop_init(uv_loop_t* loop) {
   
   loop->inotify_fd = -1;
   loop->inotify_watchers = NULL;
+  uv__iou_loop_init(loop);
 
   return uv__epoll_init(loop);
 }
@@ -93,9 +95,15 @@ int uv__platform_loop_init(uv_loop_t* loop) {
 
 int uv__io_fork(uv_loop_t* loop) {
   int err;
+  int use_iou;
   void* old_watchers;
 
   old_watchers = loop->inotify_watchers;
+  use_iou = uv__iou_enabled(loop);
+
+  /* The ring is shared with the parent process, the child needs its own. */
+  if (use_iou)
+    uv__iou_fork_release(loop);
 
   uv__close(loop->backend_fd);
   loop->backend_fd = -1;
@@ -105,11 +113,18 @@ int uv__io_fork(uv_loop_t* loop) {
   if (err)
     return err;
 
+  if (use_iou) {
+    err = uv__iou_fork(loop);
+    if (err)
+      return err;
+  }
+
   return uv__inotify_fork(loop, old_watchers);
 }
 
 
 void uv__platform_loop_delete(uv_loop_t* loop) {
+  uv__iou_loop_delete(loop);
   if (loop->inotify_fd == -1) return;
   uv__io_stop(loop, &loop->inotify_read_watcher, POLLIN);
   uv__close(loop->inotify_fd);
@@ -131,6 +146,11 @@ uint64_t uv__hrtime(uv_clocktype_t type) {
   /* TODO(bnoordhuis) Use CLOCK_MONOTONIC_COARSE for UV_CLOCK_PRECISE
    * when it has microsecond granularity or better (unlikely).
    */
+  /* Always serviced from the vDSO, at the granularity of the timer tick. */
+  clock_id = CLOCK_MONOTONIC_COARSE;
+  if (type == UV_CLOCK_COARSE)
+    goto done;
+
   clock_id = CLOCK_MONOTONIC;
   if (type != UV_CLOCK_FAST)
     goto done;
@@ -236,6 +256,44 @@ static int uv__slurp(const char* filename, char* buf, size_t len) {
   return 0;
 }
 
+/* Parses the node's cpulist, e.g. "0-7,16-23". */
+int uv__numa_node_cpumask(unsigned int node, char* cpumask, size_t mask_size) {
+  char filename[64];
+  char buf[4096];
+  unsigned long lo;
+  unsigned long hi;
+  char* end;
+  char* p;
+  int err;
+
+  snprintf(filename,
+           sizeof(filename),
+           "/sys/devices/system/node/node%u/cpulist",
+           node);
+
+  err = uv__slurp(filename, buf, sizeof(buf));
+  if (err)
+    return err;
+
+  memset(cpumask, 0, mask_size);
+
+  /* A node without CPUs has an empty list. */
+  for (p = buf; *p >= '0' && *p <= '9'; p = end + 1) {
+    lo = strtoul(p, &end, 10);
+    hi = lo;
+    if (*end == '-')
+      hi = strtoul(end + 1, &end, 10);
+
+    for (; lo <= hi && lo < mask_size; lo++)
+      cpumask[lo] = 1;
+
+    if (*end != ',')
+      break;
+  }
+
+  return 0;
+}
+
 int uv_uptime(double* uptime) {
   static volatile int no_clock_boottime;
   char buf[128];
@@ -341,6 +399,264 @@ out:
 }
 
 
+/* The sampler keeps /proc/stat open and re-reads it into the same buffer.
+ * Only the per-CPU time counters are parsed; models and speeds never change
+ * between samples.
+ */
+static const char* uv__cpu_sampler_u64(const char* p,
+                                       const char* end,
+                                       uint64_t* val) {
+  uint64_t v;
+
+  while (p < end && *p == ' ')
+    p++;
+
+  if (p == end || *p < '0' || *p > '9')
+    return NULL;
+
+  for (v = 0; p < end && *p >= '0' && *p <= '9'; p++)
+    v = 10 * v + (*p - '0');
+
+  *val = v;
+  return p;
+}
+
+
+/* Parses the next "cpu<n>" line into user, nice, sys, idle and irq ticks.
+ * Returns 0 once the cpu lines are over.
+ */
+static int uv__cpu_sampler_next(const char** pp,
+                                const char* end,
+                                uint64_t* cpu,
+                                uint64_t ticks[5]) {
+  const char* eol;
+  const char* p;
+  const char* q;
+  uint64_t v[6];
+  int i;
+
+  for (p = *pp; p < end; p = eol + 1) {
+    eol = memchr(p, '\n', end - p);
+    if (eol == NULL)
+      break;
+
+    if (eol - p < 4 || memcmp(p, "cpu", 3))
+      break;
+
+    /* Skip the "cpu " line with the totals. */
+    if (p[3] < '0' || p[3] > '9')
+      continue;
+
+    q = uv__cpu_sampler_u64(p + 3, eol, cpu);
+
+    /* user, nice, system, idle, iowait, irq. */
+    for (i = 0; q != NULL && i < 6; i++)
+      q = uv__cpu_sampler_u64(q, eol, &v[i]);
+
+    if (q == NULL)
+      continue;
+
+    ticks[0] = v[0];
+    ticks[1] = v[1];
+    ticks[2] = v[2];
+    ticks[3] = v[3];
+    ticks[4] = v[5];
+    *pp = eol + 1;
+    return 1;
+  }
+
+  *pp = end;
+  return 0;
+}
+
+
+/* Reads /proc/stat up to the end of the cpu lines, which come first. The
+ * buffer only grows when it can't hold them, i.e. on the first read.
+ */
+static ssize_t uv__cpu_sampler_read(uv_cpu_sampler_t* sampler) {
+  const char* eol;
+  const char* p;
+  const char* end;
+  size_t size;
+  ssize_t n;
+  char* buf;
+
+  for (;;) {
+    do
+      n = pread(sampler->fd, sampler->buf, sampler->buf_size, 0);
+    while (n == -1 && errno == EINTR);
+
+    if (n == -1)
+      return UV__ERR(errno);
+
+    if ((size_t) n < sampler->buf_size)
+      return n;
+
+    end = sampler->buf + n;
+    for (p = sampler->buf; p < end; p = eol + 1) {
+      eol = memchr(p, '\n', end - p);
+      if (eol == NULL)
+        break;
+      if (eol - p < 3 || memcmp(p, "cpu", 3))
+        return n;
+    }
+
+    size = 2 * sampler->buf_size;
+    buf = uv__realloc(sampler->buf, size);
+    if (buf == NULL)
+      return UV_ENOMEM;
+
+    sampler->buf = buf;
+    sampler->buf_size = size;
+  }
+}
+
+
+int uv_cpu_sampler_init(uv_cpu_sampler_t* sampler, int* count) {
+  const char* end;
+  const char* p;
+  uint64_t ticks[5];
+  uint64_t cpu;
+  uint64_t num;
+  unsigned int hz;
+  ssize_t n;
+  long conf;
+  int err;
+
+  *count = 0;
+
+  hz = (unsigned int) sysconf(_SC_CLK_TCK);
+  assert(hz != (unsigned int) -1);
+  assert(hz != 0);
+
+  sampler->multiplier = 1000 / hz;
+  sampler->ticks = NULL;
+  sampler->buf_size = 4096;
+  sampler->buf = uv__malloc(sampler->buf_size);
+  if (sampler->buf == NULL)
+    return UV_ENOMEM;
+
+  sampler->fd = uv__open_cloexec("/proc/stat", O_RDONLY);
+  if (sampler->fd < 0) {
+    err = sampler->fd;
+    goto fail;
+  }
+
+  n = uv__cpu_sampler_read(sampler);
+  if (n < 0) {
+    err = n;
+    goto fail;
+  }
+
+  /* Offline CPUs have no line, size for the ones that may come online. */
+  conf = sysconf(_SC_NPROCESSORS_CONF);
+  num = conf > 0 ? (uint64_t) conf : 0;
+
+  end = sampler->buf + n;
+  for (p = sampler->buf; uv__cpu_sampler_next(&p, end, &cpu, ticks);)
+    if (cpu >= num)
+      num = cpu + 1;
+
+  err = UV_EIO;
+  if (num == 0 || num > INT_MAX / 5)
+    goto fail;
+
+  err = UV_ENOMEM;
+  sampler->ticks = uv__calloc(num * 5, sizeof(*sampler->ticks));
+  if (sampler->ticks == NULL)
+    goto fail;
+
+  for (p = sampler->buf; uv__cpu_sampler_next(&p, end, &cpu, ticks);)
+    memcpy(&sampler->ticks[cpu * 5], ticks, sizeof(ticks));
+
+  sampler->count = num;
+  *count = num;
+
+  return 0;
+
+fail:
+  if (sampler->fd >= 0)
+    uv__close(sampler->fd);
+  uv__free(sampler->buf);
+  sampler->fd = -1;
+  sampler->buf = NULL;
+
+  return err;
+}
+
+
+static uint64_t uv__cpu_sampler_delta(uint64_t now, uint64_t prev) {
+  return now > prev ? now - prev : 0;
+}
+
+
+int uv_cpu_sampler_sample(uv_cpu_sampler_t* sampler,
+                          struct uv_cpu_times_s* deltas,
+                          int count) {
+  struct uv_cpu_times_s* d;
+  const char* end;
+  const char* p;
+  uint64_t ticks[5];
+  uint64_t* prev;
+  uint64_t cpu;
+  ssize_t n;
+
+  if (sampler->fd < 0 || count < 0)
+    return UV_EINVAL;
+
+  n = uv__cpu_sampler_read(sampler);
+  if (n < 0)
+    return n;
+
+  if (count > sampler->count)
+    count = sampler->count;
+
+  /* CPUs that are offline right now report zero. */
+  memset(deltas, 0, count * sizeof(*deltas));
+
+  end = sampler->buf + n;
+  for (p = sampler->buf; uv__cpu_sampler_next(&p, end, &cpu, ticks);) {
+    if (cpu >= (uint64_t) sampler->count)
+      continue;
+
+    /* A CPU that came online after uv_cpu_sampler_init() starts counting
+     * from its first sample, not from boot.
+     */
+    prev = &sampler->ticks[cpu * 5];
+    if (prev[0] + prev[1] + prev[2] + prev[3] + prev[4] == 0) {
+      memcpy(prev, ticks, sizeof(ticks));
+      continue;
+    }
+
+    if (cpu < (uint64_t) count) {
+      d = &deltas[cpu];
+      d->user = uv__cpu_sampler_delta(ticks[0], prev[0]) * sampler->multiplier;
+      d->nice = uv__cpu_sampler_delta(ticks[1], prev[1]) * sampler->multiplier;
+      d->sys = uv__cpu_sampler_delta(ticks[2], prev[2]) * sampler->multiplier;
+      d->idle = uv__cpu_sampler_delta(ticks[3], prev[3]) * sampler->multiplier;
+      d->irq = uv__cpu_sampler_delta(ticks[4], prev[4]) * sampler->multiplier;
+    }
+
+    memcpy(prev, ticks, sizeof(ticks));
+  }
+
+  return 0;
+}
+
+
+void uv_cpu_sampler_close(uv_cpu_sampler_t* sampler) {
+  if (sampler->fd < 0)
+    return;
+
+  uv__close(sampler->fd);
+  uv__free(sampler->buf);
+  uv__free(sampler->ticks);
+  sampler->fd = -1;
+  sampler->buf = NULL;
+  sampler->ticks = NULL;
+}
+
+
 static void read_speeds(unsigned int numcpus, uv_cpu_info_t* ci) {
   unsigned int num;
 
@@ -655,7 +971,8 @@ static int uv__ifaddr_exclude(struct ifaddrs *ent, int exclude_type) {
   return !exclude_type;
 }
 
-int uv_interface_addresses(uv_interface_address_t** addresses, int* count) {
+static int uv__ifaddrs_interface_addresses(uv_interface_address_t** addresses,
+                                           int* count) {
 #ifndef HAVE_IFADDRS_H
   *count = 0;
   *addresses = NULL;
@@ -743,6 +1060,22 @@ int uv_interface_addresses(uv_interface_address_t** addresses, int* count) {
 }
 
 
+int uv_interface_addresses(uv_interface_address_t** addresses, int* count) {
+  int err;
+
+  /* getifaddrs() matches every address against every link by name, which
+   * gets slow with thousands of interfaces. The rtnetlink dump looks links
+   * up by index instead. Fall back when netlink is unavailable, e.g. when a
+   * seccomp filter forbids AF_NETLINK sockets.
+   */
+  err = uv__netlink_interface_addresses(addresses, count);
+  if (err == 0 || err == UV_ENOMEM)
+    return err;
+
+  return uv__ifaddrs_interface_addresses(addresses, count);
+}
+
+
 void uv_free_interface_addresses(uv_interface_address_t* addresses,
   int count) {
   int i;
@@ -816,27 +1149,356 @@ uint64_t uv_get_total_memory(void) {
 }
 
 
-static uint64_t uv__read_cgroups_uint64(const char* cgroup, const char* param) {
-  char filename[256];
-  char buf[32];  /* Large enough to hold an encoded uint64_t. */
-  uint64_t rc;
+/* cgroup v1 reports "no limit" as the largest page aligned 64 bits signed
+ * value. Anything that large is as good as no limit.
+ */
+#define UV__CGROUP_UNLIMITED ((uint64_t) 1 << 62)
 
-  rc = 0;
-  snprintf(filename, sizeof(filename), "/sys/fs/cgroup/%s/%s", cgroup, param);
-  if (0 == uv__slurp(filename, buf, sizeof(buf)))
-    sscanf(buf, "%" PRIu64, &rc);
+struct uv__cgroup {
+  char buf[4096];  /* /proc/self/cgroup, lines NUL terminated in place. */
+  const char* unified;  /* Path in the v2 hierarchy, NULL if none. */
+  const char* cpu;  /* Path of the v1 cpu controller, NULL if none. */
+  const char* memory;  /* Path of the v1 memory controller, NULL if none. */
+  const char* root;  /* Mount point of the v2 hierarchy. */
+};
+
+
+static int uv__cgroup_has_controller(const char* list, const char* name) {
+  size_t n;
+
+  n = strlen(name);
+  for (;;) {
+    if (strncmp(list, name, n) == 0 && (list[n] == ',' || list[n] == '\0'))
+      return 1;
+
+    list = strchr(list, ',');
+    if (list == NULL)
+      return 0;
+
+    list++;
+  }
+}
+
+
+/* Lines in /proc/self/cgroup look like "4:memory:/path" for v1 controllers
+ * and "0::/path" for the v2 hierarchy.
+ */
+static int uv__cgroup_init(struct uv__cgroup* cg) {
+  char* controllers;
+  char* path;
+  char* eol;
+  char* p;
+  int err;
+
+  cg->unified = NULL;
+  cg->cpu = NULL;
+  cg->memory = NULL;
+  cg->root = "/sys/fs/cgroup";
+
+  err = uv__slurp("/proc/self/cgroup", cg->buf, sizeof(cg->buf));
+  if (err)
+    return err;
+
+  for (p = cg->buf; *p != '\0'; p = eol) {
+    eol = strchr(p, '\n');
+    if (eol != NULL)
+      *eol++ = '\0';
+    else
+      eol = p + strlen(p);
+
+    controllers = strchr(p, ':');
+    if (controllers == NULL)
+      continue;
+
+    path = strchr(++controllers, ':');
+    if (path == NULL)
+      continue;
+
+    *path++ = '\0';
+    if (*controllers == '\0') {
+      cg->unified = path;
+    } else {
+      if (uv__cgroup_has_controller(controllers, "cpu"))
+        cg->cpu = path;
+      if (uv__cgroup_has_controller(controllers, "memory"))
+        cg->memory = path;
+    }
+  }
+
+  /* Hybrid setups mount the v2 hierarchy next to the v1 controllers. */
+  if (cg->cpu != NULL || cg->memory != NULL)
+    cg->root = "/sys/fs/cgroup/unified";
+
+  return 0;
+}
+
+
+static int uv__cgroup_read(const char* root,
+                           const char* path,
+                           const char* file,
+                           char* buf,
+                           size_t len) {
+  char filename[PATH_MAX];
+
+  snprintf(filename, sizeof(filename), "%s%s/%s", root, path, file);
+  return uv__slurp(filename, buf, len);
+}
+
+
+/* The v1 paths are those of the host when the container doesn't have a
+ * cgroup namespace of its own and the controller is mounted at the cgroup
+ * of the container. Try both.
+ */
+static int uv__cgroup1_read_uint64(const char* controller,
+                                   const char* path,
+                                   const char* file,
+                                   uint64_t* val) {
+  char root[32];
+  char buf[32];
+  int64_t v;
+
+  snprintf(root, sizeof(root), "/sys/fs/cgroup/%s", controller);
+  if (uv__cgroup_read(root, path, file, buf, sizeof(buf)))
+    if (uv__cgroup_read(root, "", file, buf, sizeof(buf)))
+      return UV_ENOENT;
+
+  if (sscanf(buf, "%" PRId64, &v) != 1)
+    return UV_EINVAL;
+
+  /* cpu.cfs_quota_us is -1 without a quota. */
+  *val = v < 0 ? 0 : (uint64_t) v;
+  return 0;
+}
+
+
+/* Strips the last component off |path|, returns 0 at the root. */
+static int uv__cgroup_parent(char* path) {
+  char* p;
+
+  p = strrchr(path, '/');
+  if (p == NULL || path[1] == '\0')
+    return 0;
+
+  if (p == path)
+    p++;
+
+  *p = '\0';
+  return 1;
+}
+
+
+static void uv__cgroup_cpu(const struct uv__cgroup* cg,
+                           uint64_t* quota,
+                           uint64_t* period) {
+  char path[PATH_MAX];
+  char buf[64];
+  uint64_t q;
+  uint64_t p;
+
+  *quota = 0;
+  *period = 0;
+
+  if (cg->cpu != NULL) {
+    if (uv__cgroup1_read_uint64("cpu", cg->cpu, "cpu.cfs_quota_us", &q) ||
+        uv__cgroup1_read_uint64("cpu", cg->cpu, "cpu.cfs_period_us", &p)) {
+      return;
+    }
+
+    if (q != 0 && p != 0) {
+      *quota = q;
+      *period = p;
+    }
+
+    return;
+  }
+
+  if (cg->unified == NULL)
+    return;
+
+  /* A quota on any ancestor applies too, report the tightest one. */
+  uv__strscpy(path, cg->unified, sizeof(path));
+  do {
+    if (uv__cgroup_read(cg->root, path, "cpu.max", buf, sizeof(buf)))
+      continue;
 
-  return rc;
+    /* "max 100000" without a quota. */
+    if (sscanf(buf, "%" PRIu64 " %" PRIu64, &q, &p) != 2 || q == 0 || p == 0)
+      continue;
+
+    if (*quota == 0 || q * *period < *quota * p) {
+      *quota = q;
+      *period = p;
+    }
+  } while (uv__cgroup_parent(path));
+}
+
+
+static void uv__cgroup_memory(const struct uv__cgroup* cg,
+                              uint64_t* limit,
+                              uint64_t* usage) {
+  char path[PATH_MAX];
+  char buf[32];
+  uint64_t v;
+
+  *limit = 0;
+  *usage = 0;
+
+  if (cg->memory != NULL) {
+    if (uv__cgroup1_read_uint64("memory",
+                                cg->memory,
+                                "memory.limit_in_bytes",
+                                &v) == 0) {
+      if (v < UV__CGROUP_UNLIMITED)
+        *limit = v;
+    }
+
+    if (uv__cgroup1_read_uint64("memory",
+                                cg->memory,
+                                "memory.usage_in_bytes",
+                                &v) == 0) {
+      *usage = v;
+    }
+
+    return;
+  }
+
+  if (cg->unified == NULL)
+    return;
+
+  if (uv__cgroup_read(cg->root, cg->unified, "memory.current", buf,
+                      sizeof(buf)) == 0) {
+    if (sscanf(buf, "%" PRIu64, &v) == 1)
+      *usage = v;
+  }
+
+  uv__strscpy(path, cg->unified, sizeof(path));
+  do {
+    if (uv__cgroup_read(cg->root, path, "memory.max", buf, sizeof(buf)))
+      continue;
+
+    /* "max" without a limit. */
+    if (sscanf(buf, "%" PRIu64, &v) != 1)
+      continue;
+
+    if (*limit == 0 || v < *limit)
+      *limit = v;
+  } while (uv__cgroup_parent(path));
+}
+
+
+/* Reads the "some" line of a PSI file, the share of time at least one task
+ * was stalled on the resource.
+ */
+static void uv__cgroup_pressure(const struct uv__cgroup* cg,
+                                const char* resource,
+                                double avg[3]) {
+  char file[32];
+  char buf[256];
+  int err;
+
+  avg[0] = -1;
+  avg[1] = -1;
+  avg[2] = -1;
+
+  snprintf(file, sizeof(file), "%s.pressure", resource);
+
+  err = UV_ENOENT;
+  if (cg->unified != NULL)
+    err = uv__cgroup_read(cg->root, cg->unified, file, buf, sizeof(buf));
+
+  /* Without a v2 cgroup only the system-wide numbers are available. */
+  if (err)
+    err = uv__cgroup_read("/proc/pressure", "", resource, buf, sizeof(buf));
+
+  if (err)
+    return;
+
+  if (sscanf(buf, "some avg10=%lf avg60=%lf avg300=%lf",
+             &avg[0], &avg[1], &avg[2]) != 3) {
+    avg[0] = -1;
+    avg[1] = -1;
+    avg[2] = -1;
+  }
+}
+
+
+int uv_get_resource_constraints(uv_resource_constraints_t* rc) {
+  struct uv__cgroup cg;
+  int err;
+
+  memset(rc, 0, sizeof(*rc));
+
+  err = uv__cgroup_init(&cg);
+  if (err)
+    return err;
+
+  if (cg.cpu != NULL || cg.memory != NULL)
+    rc->cgroup_version = 1;
+  else if (cg.unified != NULL)
+    rc->cgroup_version = 2;
+
+  uv__cgroup_cpu(&cg, &rc->cpu_quota, &rc->cpu_period);
+  uv__cgroup_memory(&cg, &rc->memory_limit, &rc->memory_usage);
+  uv__cgroup_pressure(&cg, "cpu", rc->cpu_pressure);
+  uv__cgroup_pressure(&cg, "memory", rc->memory_pressure);
+  uv__cgroup_pressure(&cg, "io", rc->io_pressure);
+
+  return 0;
 }
 
 
 uint64_t uv_get_constrained_memory(void) {
+  struct uv__cgroup cg;
+  uint64_t limit;
+  uint64_t usage;
+
   /*
    * This might return 0 if there was a problem getting the memory limit from
    * cgroups. This is OK because a return value of 0 signifies that the memory
    * limit is unknown.
    */
-  return uv__read_cgroups_uint64("memory", "memory.limit_in_bytes");
+  if (uv__cgroup_init(&cg))
+    return 0;
+
+  uv__cgroup_memory(&cg, &limit, &usage);
+  return limit;
+}
+
+
+unsigned int uv_available_parallelism(void) {
+  struct uv__cgroup cg;
+  cpu_set_t set;
+  uint64_t quota;
+  uint64_t period;
+  uint64_t limit;
+  long rc;
+
+  memset(&set, 0, sizeof(set));
+
+  /* sched_getaffinity() fails with EINVAL on machines with more CPUs than
+   * fit in a cpu_set_t.
+   */
+  rc = 0;
+  if (0 == sched_getaffinity(0, sizeof(set), &set))
+    rc = CPU_COUNT(&set);
+
+  if (rc < 1)
+    rc = sysconf(_SC_NPROCESSORS_ONLN);
+
+  if (rc < 1)
+    rc = 1;
+
+  /* A CPU quota of 1.5 CPUs keeps two threads busy part of the time. */
+  if (uv__cgroup_init(&cg) == 0) {
+    uv__cgroup_cpu(&cg, &quota, &period);
+    if (quota != 0) {
+      limit = (quota + period - 1) / period;
+      if (limit < (uint64_t) rc)
+        rc = limit;
+    }
+  }
+
+  return (unsigned int) rc;
 }
 
 
@@ -18,6 +18,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
 #include "uv.h"
 #include "uv/tree.h"
 #include "internal.h"
@@ -31,8 +33,16 @@
 
 #include <sys/inotify.h>
 #include <sys/types.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <unistd.h>
 
+/* Recursive watches need FAN_REPORT_DFID_NAME, i.e. linux >= 5.9 headers. */
+#include <sys/fanotify.h>
+#if defined(FAN_REPORT_DFID_NAME) && defined(FAN_MARK_FILESYSTEM)
+# define UV__HAVE_FANOTIFY 1
+#endif
+
 struct watcher_list {
   RB_ENTRY(watcher_list) entry;
   QUEUE watchers;
@@ -240,8 +250,275 @@ static void uv__inotify_read(uv_loop_t* loop,
 }
 
 
+#if defined(UV__HAVE_FANOTIFY)
+
+/* One fanotify group per UV_FS_EVENT_RECURSIVE handle. The mark covers the
+ * whole file system the directory lives on, events are resolved to a path
+ * and filtered down to the ones below the directory.
+ */
+struct fanotify_watch {
+  uv__io_t io_watcher;
+  uv_fs_event_t* handle;  /* NULL once stopped from inside the callback. */
+  int iterating;
+  int mount_fd;           /* The directory, anchors open_by_handle_at(). */
+  size_t len;
+  char* path;             /* As passed to uv_fs_event_start(). */
+  char realpath[1];       /* variable length, followed by path */
+};
+
+
+static void fanotify_free(struct fanotify_watch* fw) {
+  uv__close(fw->io_watcher.fd);
+  uv__close(fw->mount_fd);
+  uv__free(fw);
+}
+
+
+/* Turns the directory handle and name of an event into a path relative to
+ * the watched directory. Returns 0 for events outside of it.
+ */
+static int fanotify_event_path(struct fanotify_watch* fw,
+                               struct file_handle* fh,
+                               const char* name,
+                               char* buf,
+                               size_t size) {
+  char proc[32];
+  char dir[PATH_MAX];
+  const char* rel;
+  ssize_t n;
+  int fd;
+
+  fd = open_by_handle_at(fw->mount_fd, fh, O_PATH | O_CLOEXEC);
+  if (fd == -1)
+    return 0;  /* The directory is gone already. */
+
+  snprintf(proc, sizeof(proc), "/proc/self/fd/%d", fd);
+  n = readlink(proc, dir, sizeof(dir) - 1);
+  uv__close(fd);
+  if (n == -1)
+    return 0;
+  dir[n] = '\0';
+
+  if ((size_t) n < fw->len || memcmp(dir, fw->realpath, fw->len) != 0)
+    return 0;
+
+  rel = dir + fw->len;
+  if (*rel == '/')
+    rel++;
+  else if (*rel != '\0' && fw->len > 1)
+    return 0;  /* A sibling whose name starts with the directory's. */
+
+  if (strcmp(name, ".") == 0)
+    name = "";
+
+  if (*rel == '\0')
+    n = snprintf(buf, size, "%s", *name ? name : uv__basename_r(fw->path));
+  else if (*name == '\0')
+    n = snprintf(buf, size, "%s", rel);
+  else
+    n = snprintf(buf, size, "%s/%s", rel, name);
+
+  return n > 0 && (size_t) n < size;
+}
+
+
+static void uv__fanotify_read(uv_loop_t* loop,
+                              uv__io_t* w,
+                              unsigned int revents) {
+  const struct fanotify_event_metadata* m;
+  struct fanotify_event_info_fid* info;
+  struct fanotify_watch* fw;
+  struct file_handle* fh;
+  uv_fs_event_t* h;
+  char path[PATH_MAX];
+  const char* name;
+  ssize_t size;
+  int events;
+  /* Aligned for the event metadata. */
+  union {
+    struct fanotify_event_metadata m;
+    char buf[8192];
+  } u;
+
+  fw = container_of(w, struct fanotify_watch, io_watcher);
+  fw->iterating = 1;
+
+  while (fw->handle != NULL) {
+    do
+      size = read(w->fd, u.buf, sizeof(u.buf));
+    while (size == -1 && errno == EINTR);
+
+    if (size == -1) {
+      assert(errno == EAGAIN || errno == EWOULDBLOCK);
+      break;
+    }
+
+    for (m = &u.m;
+         fw->handle != NULL && FAN_EVENT_OK(m, size);
+         m = FAN_EVENT_NEXT(m, size)) {
+      if (m->vers != FANOTIFY_METADATA_VERSION)
+        continue;
+
+      if (m->event_len < sizeof(*m) + sizeof(*info))
+        continue;
+
+      info = (struct fanotify_event_info_fid*) (m + 1);
+      if (info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME)
+        continue;
+
+      fh = (struct file_handle*) info->handle;
+      name = (const char*) fh->f_handle + fh->handle_bytes;
+      if (!fanotify_event_path(fw, fh, name, path, sizeof(path)))
+        continue;
+
+      events = 0;
+      if (m->mask & (FAN_ATTRIB | FAN_MODIFY))
+        events |= UV_CHANGE;
+      if (m->mask & ~(FAN_ATTRIB | FAN_MODIFY | FAN_ONDIR))
+        events |= UV_RENAME;
+
+      h = fw->handle;
+      h->cb(h, path, events, 0);
+    }
+  }
+
+  fw->iterating = 0;
+  if (fw->handle == NULL)
+    fanotify_free(fw);
+}
+
+
+static int uv__fanotify_start(uv_fs_event_t* handle,
+                              uv_fs_event_cb cb,
+                              const char* path) {
+  struct uv__fs_event_state* state;
+  struct fanotify_watch* fw;
+  struct file_handle* fh;
+  char real[PATH_MAX];
+  size_t real_len;
+  size_t len;
+  uint64_t mask;
+  int mount_id;
+  int mount_fd;
+  int fd;
+  int err;
+  union {
+    struct file_handle fh;
+    char buf[sizeof(struct file_handle) + MAX_HANDLE_SZ];
+  } u;
+
+  mount_fd = uv__open_cloexec(path, O_RDONLY | O_DIRECTORY);
+  if (mount_fd < 0)
+    return mount_fd;
+
+  if (realpath(path, real) == NULL) {
+    err = UV__ERR(errno);
+    uv__close(mount_fd);
+    return err;
+  }
+
+  /* Resolving events needs CAP_DAC_READ_SEARCH, find out now rather than
+   * silently dropping every event later.
+   */
+  fh = &u.fh;
+  fh->handle_bytes = MAX_HANDLE_SZ;
+  if (name_to_handle_at(mount_fd, "", fh, &mount_id, AT_EMPTY_PATH)) {
+    err = UV__ERR(errno);
+    uv__close(mount_fd);
+    return err;
+  }
+
+  fd = open_by_handle_at(mount_fd, fh, O_PATH | O_CLOEXEC);
+  if (fd == -1) {
+    err = UV__ERR(errno);
+    uv__close(mount_fd);
+    return err;
+  }
+  uv__close(fd);
+
+  fd = fanotify_init(FAN_CLASS_NOTIF |
+                     FAN_CLOEXEC |
+                     FAN_NONBLOCK |
+                     FAN_REPORT_DFID_NAME,
+                     O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    err = UV__ERR(errno);
+    uv__close(mount_fd);
+    return err;
+  }
+
+  mask = FAN_ATTRIB
+       | FAN_CREATE
+       | FAN_MODIFY
+       | FAN_DELETE
+       | FAN_DELETE_SELF
+       | FAN_MOVE_SELF
+       | FAN_MOVED_FROM
+       | FAN_MOVED_TO
+       | FAN_ONDIR;
+
+  if (fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, mask,
+                    mount_fd, NULL)) {
+    err = UV__ERR(errno);
+    uv__close(fd);
+    uv__close(mount_fd);
+    return err;
+  }
+
+  state = uv__fs_event_state(handle);
+  real_len = strlen(real);
+  len = strlen(path);
+  fw = uv__malloc(sizeof(*fw) + real_len + len + 1);
+  if (state == NULL || fw == NULL) {
+    uv__free(fw);
+    uv__close(fd);
+    uv__close(mount_fd);
+    return UV_ENOMEM;
+  }
+
+  fw->handle = handle;
+  fw->iterating = 0;
+  fw->mount_fd = mount_fd;
+  fw->len = real_len;
+  memcpy(fw->realpath, real, real_len + 1);
+  fw->path = fw->realpath + real_len + 1;
+  memcpy(fw->path, path, len + 1);
+
+  uv__io_init(&fw->io_watcher, uv__fanotify_read, fd);
+  uv__io_start(handle->loop, &fw->io_watcher, POLLIN);
+
+  uv__handle_start(handle);
+  state->fanotify = fw;
+  handle->path = fw->path;
+  handle->cb = cb;
+  handle->wd = -1;
+
+  return 0;
+}
+
+
+static void uv__fanotify_stop(uv_fs_event_t* handle) {
+  struct uv__fs_event_state* state;
+  struct fanotify_watch* fw;
+
+  state = handle->u.reserved[0];
+  fw = state->fanotify;
+  state->fanotify = NULL;
+  handle->path = NULL;
+  uv__handle_stop(handle);
+
+  uv__io_close(handle->loop, &fw->io_watcher);
+  fw->handle = NULL;
+  if (!fw->iterating)
+    fanotify_free(fw);
+}
+
+#endif  /* UV__HAVE_FANOTIFY */
+
+
 int uv_fs_event_init(uv_loop_t* loop, uv_fs_event_t* handle) {
   uv__handle_init(loop, (uv_handle_t*)handle, UV_FS_EVENT);
+  handle->u.reserved[0] = NULL;
   return 0;
 }
 
@@ -259,6 +536,15 @@ int uv_fs_event_start(uv_fs_event_t* handle,
   if (uv__is_active(handle))
     return UV_EINVAL;
 
+#if defined(UV__HAVE_FANOTIFY)
+  /* Without fanotify (too old a kernel, no CAP_SYS_ADMIN, not a directory)
+   * fall back to watching just the directory itself, like before.
+   */
+  if (flags & UV_FS_EVENT_RECURSIVE)
+    if (uv__fanotify_start(handle, cb, path) == 0)
+      return 0;
+#endif
+
   err = init_inotify(handle->loop);
   if (err)
     return err;
@@ -303,11 +589,24 @@ no_insert:
 
 
 int uv_fs_event_stop(uv_fs_event_t* handle) {
+#if defined(UV__HAVE_FANOTIFY)
+  struct uv__fs_event_state* state;
+#endif
   struct watcher_list* w;
 
   if (!uv__is_active(handle))
     return 0;
 
+  uv__fs_event_batch_stop(handle);
+
+#if defined(UV__HAVE_FANOTIFY)
+  state = handle->u.reserved[0];
+  if (state != NULL && state->fanotify != NULL) {
+    uv__fanotify_stop(handle);
+    return 0;
+  }
+#endif
+
   w = find_watcher(handle->loop, handle->wd);
   assert(w != NULL);
 
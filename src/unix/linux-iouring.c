@@ -0,0 +1,1853 @@
+/* Copyright libuv contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* io_uring based replacement for the epoll readiness loop.
+ *
+ * Every watched file descriptor gets a one-shot IORING_OP_POLL_ADD request.
+ * Arming, re-arming and cancelling polls only prepares submission queue
+ * entries; they are flushed to the kernel by the same io_uring_enter() call
+ * that waits for completions. That collapses the epoll_ctl() + epoll_wait()
+ * pair into a single system call per loop iteration.
+ *
+ * A poll completion carries the file descriptor and a per-fd generation
+ * counter in its user_data. uv__platform_invalidate_fd() bumps the generation
+ * so that completions that were already in flight when the file descriptor
+ * was closed are recognized as stale and dropped, which is what the epoll
+ * backend does by scribbling over its event buffer.
+ *
+ * While the ring is enabled, asynchronous uv_fs_read(), uv_fs_write(),
+ * uv_fs_open(), uv_fs_close(), uv_fs_fsync(), uv_fs_fdatasync() and the
+ * stat family are submitted to it instead of the threadpool. Their
+ * completions carry the (even) address of the uv_fs_t and run the callback
+ * straight from the poll loop. uv_fs_write_batch() becomes a chain of linked
+ * writes that the kernel runs in order, with one completion per link.
+ *
+ * Listeners and reading TCP streams aren't polled for POLLIN. They get a
+ * multishot accept or recv request instead, which stays armed and posts a
+ * completion per connection or per chunk of data, without a system call
+ * for each. Accepted connections are queued on the listener like
+ * UV_LOOP_ACCEPT_BATCH does before it's reported readable. Received data
+ * lands in buffers the kernel picks from a ring of provided buffers;
+ * uv__read() copies it out with uv__iou_readv() in place of readv(), and the
+ * buffer goes back to the ring. Multishot requests have a generation
+ * counter of their own in uv__iou_ms. When a stream stops reading or a
+ * listener stops accepting the request is cancelled, what arrives in the
+ * meantime is kept for when it starts again. Kernels without multishot
+ * support fail the first request with EINVAL, from then on the loop polls.
+ */
+
+#define UV__ALLOC_TAG UV_ALLOC_TAG_LOOP
+
+#include "uv.h"
+#include "internal.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+
+#define UV__IOU_ENTRIES 1024
+#define UV__IOU_CQ_ENTRIES 8192
+
+/* Poll completions have their low bit set. Even user_data values are free
+ * for pointers to in-flight requests.
+ */
+#define UV__IOU_POLL_DATA(fd, gen)                                            \
+  (((uint64_t) ((gen) & UV__IOU_GEN_MASK) << 32) |                            \
+   ((uint64_t) (uint32_t) (fd) << 1) | 1)
+#define UV__IOU_IGNORE ((uint64_t) -1)
+
+/* Multishot completions also have the top bit set, and the one below it for
+ * accepts. That leaves 30 bits of generation.
+ */
+#define UV__IOU_MULTISHOT ((uint64_t) 1 << 63)
+#define UV__IOU_ACCEPT ((uint64_t) 1 << 62)
+#define UV__IOU_GEN_MASK 0x3FFFFFFFu
+#define UV__IOU_MULTISHOT_DATA(fd, gen, kind)                                 \
+  (UV__IOU_POLL_DATA(fd, gen) | UV__IOU_MULTISHOT |                           \
+   ((kind) == UV__IOU_MULTISHOT_ACCEPT ? UV__IOU_ACCEPT : 0))
+
+#define UV__IOU_NBUFS 256  /* Power of two. */
+#define UV__IOU_BUF_SIZE (16 * 1024)
+#define UV__IOU_BGID 0
+
+enum {
+  UV__IOU_MULTISHOT_ACCEPT = 1,
+  UV__IOU_MULTISHOT_RECV = 2
+};
+
+enum {
+  UV__IOU_MS_IDLE,
+  UV__IOU_MS_ARMED,
+  UV__IOU_MS_CANCELLING
+};
+
+struct uv__iou_ms {
+  uv__io_t* w;      /* Listener that accepted connections are queued on. */
+  uint32_t gen;
+  int kind;
+  int state;
+  int status;       /* How recv ended, UV_EOF or an error, after the data. */
+  int head;         /* Received buffers not read yet, -1 if none. */
+  int tail;
+  int next_ready;
+  unsigned int ready:1;
+  unsigned int nobufs:1;  /* Out of buffers, poll once before trying again. */
+};
+
+struct uv__iou_buf {
+  uint32_t len;
+  uint32_t off;
+  int next;
+};
+
+STATIC_ASSERT(40 == sizeof(struct uv__io_sqring_offsets));
+STATIC_ASSERT(40 == sizeof(struct uv__io_cqring_offsets));
+STATIC_ASSERT(120 == sizeof(struct uv__io_uring_params));
+STATIC_ASSERT(64 == sizeof(struct uv__io_uring_sqe));
+STATIC_ASSERT(16 == sizeof(struct uv__io_uring_cqe));
+STATIC_ASSERT(24 == sizeof(struct uv__io_uring_getevents_arg));
+STATIC_ASSERT(0 == offsetof(struct uv__io_uring_sqe, opcode));
+STATIC_ASSERT(4 == offsetof(struct uv__io_uring_sqe, fd));
+STATIC_ASSERT(8 == offsetof(struct uv__io_uring_sqe, off));
+STATIC_ASSERT(16 == offsetof(struct uv__io_uring_sqe, addr));
+STATIC_ASSERT(24 == offsetof(struct uv__io_uring_sqe, len));
+STATIC_ASSERT(28 == offsetof(struct uv__io_uring_sqe, poll32_events));
+STATIC_ASSERT(32 == offsetof(struct uv__io_uring_sqe, user_data));
+STATIC_ASSERT(40 == offsetof(struct uv__io_uring_sqe, buf_index));
+STATIC_ASSERT(16 == sizeof(struct uv__io_uring_buf));
+STATIC_ASSERT(40 == sizeof(struct uv__io_uring_buf_reg));
+
+struct uv__kernel_timespec {
+  int64_t tv_sec;
+  int64_t tv_nsec;
+};
+
+
+static struct uv__iou* uv__iou_get(uv_loop_t* loop) {
+  return &uv__get_internal_fields(loop)->iou;
+}
+
+
+static void uv__iou_init(struct uv__iou* iou) {
+  memset(iou, 0, sizeof(*iou));
+  iou->ready = -1;
+  iou->ringfd = -1;
+}
+
+
+static void uv__iou_delete(struct uv__iou* iou) {
+  if (iou->ringfd == -1)
+    return;
+
+  if (iou->bufs != NULL) {
+    munmap(iou->bufring, UV__IOU_NBUFS * sizeof(struct uv__io_uring_buf));
+    munmap(iou->bufbase, (size_t) UV__IOU_NBUFS * UV__IOU_BUF_SIZE);
+    uv__free(iou->bufs);
+  }
+
+  munmap(iou->sq, iou->maxlen);
+  munmap(iou->sqe, iou->sqelen);
+  uv__close(iou->ringfd);
+  uv__free(iou->fdgen);
+  uv__free(iou->fdmask);
+  uv__free(iou->ms);
+  uv__iou_init(iou);
+}
+
+
+static int uv__iou_setup(struct uv__iou* iou) {
+  struct uv__io_uring_params params;
+  uint32_t required;
+  uint32_t i;
+  size_t sqlen;
+  size_t cqlen;
+  size_t maxlen;
+  size_t sqelen;
+  char* sq;
+  char* sqe;
+  int ringfd;
+  int err;
+
+  memset(&params, 0, sizeof(params));
+  params.flags = UV__IORING_SETUP_CQSIZE;
+  params.cq_entries = UV__IOU_CQ_ENTRIES;
+
+  ringfd = uv__io_uring_setup(UV__IOU_ENTRIES, &params);
+  if (ringfd == -1)
+    return UV__ERR(errno);
+
+  /* IORING_FEAT_EXT_ARG was added in 5.11 and is the last feature we depend
+   * on; it lets us pass a timeout and a signal mask to io_uring_enter()
+   * without burning a submission queue entry on IORING_OP_TIMEOUT.
+   */
+  required = UV__IORING_FEAT_SINGLE_MMAP |
+             UV__IORING_FEAT_NODROP |
+             UV__IORING_FEAT_EXT_ARG;
+
+  if ((params.features & required) != required) {
+    uv__close(ringfd);
+    return UV_ENOSYS;
+  }
+
+  sqlen = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  cqlen = params.cq_off.cqes +
+          params.cq_entries * sizeof(struct uv__io_uring_cqe);
+  maxlen = sqlen < cqlen ? cqlen : sqlen;
+  sqelen = params.sq_entries * sizeof(struct uv__io_uring_sqe);
+
+  sq = mmap(0,
+            maxlen,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            ringfd,
+            UV__IORING_OFF_SQ_RING);
+
+  if (sq == MAP_FAILED) {
+    err = UV__ERR(errno);
+    uv__close(ringfd);
+    return err;
+  }
+
+  sqe = mmap(0,
+             sqelen,
+             PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_POPULATE,
+             ringfd,
+             UV__IORING_OFF_SQES);
+
+  if (sqe == MAP_FAILED) {
+    err = UV__ERR(errno);
+    munmap(sq, maxlen);
+    uv__close(ringfd);
+    return err;
+  }
+
+  iou->sqhead = (uint32_t*) (sq + params.sq_off.head);
+  iou->sqtail = (uint32_t*) (sq + params.sq_off.tail);
+  iou->sqmask = *(uint32_t*) (sq + params.sq_off.ring_mask);
+  iou->sqarray = (uint32_t*) (sq + params.sq_off.array);
+  iou->cqhead = (uint32_t*) (sq + params.cq_off.head);
+  iou->cqtail = (uint32_t*) (sq + params.cq_off.tail);
+  iou->cqmask = *(uint32_t*) (sq + params.cq_off.ring_mask);
+  iou->sq = sq;
+  iou->cqe = sq + params.cq_off.cqes;
+  iou->sqe = sqe;
+  iou->sqlen = sqlen;
+  iou->cqlen = cqlen;
+  iou->maxlen = maxlen;
+  iou->sqelen = sqelen;
+  iou->ringfd = ringfd;
+
+  /* Submission queue entries are always used in ring order. */
+  for (i = 0; i <= iou->sqmask; i++)
+    iou->sqarray[i] = i;
+
+  /* Until the kernel says otherwise, see uv__iou_multishot_done(). */
+  iou->multishot = UV__IOU_MULTISHOT_ACCEPT | UV__IOU_MULTISHOT_RECV;
+
+  return 0;
+}
+
+
+/* Give buffer |bid| back to the kernel. */
+static void uv__iou_buf_put(struct uv__iou* iou, int bid) {
+  struct uv__io_uring_buf* ring;
+  struct uv__io_uring_buf* b;
+
+  ring = iou->bufring;
+  b = &ring[iou->buftail & (UV__IOU_NBUFS - 1)];
+  b->addr = (uintptr_t) (iou->bufbase + (size_t) bid * UV__IOU_BUF_SIZE);
+  b->len = UV__IOU_BUF_SIZE;
+  b->bid = bid;
+
+  /* The tail is the |resv| field of the first buffer. */
+  iou->buftail++;
+  __atomic_store_n(&ring[0].resv, iou->buftail, __ATOMIC_RELEASE);
+}
+
+
+static int uv__iou_bufs_setup(struct uv__iou* iou) {
+  struct uv__io_uring_buf_reg reg;
+  struct uv__iou_buf* bufs;
+  size_t ringlen;
+  size_t len;
+  char* base;
+  void* ring;
+  int err;
+  int i;
+
+  ringlen = UV__IOU_NBUFS * sizeof(struct uv__io_uring_buf);
+  len = (size_t) UV__IOU_NBUFS * UV__IOU_BUF_SIZE;
+
+  ring = mmap(NULL,
+              ringlen,
+              PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS,
+              -1,
+              0);
+  if (ring == MAP_FAILED)
+    return UV__ERR(errno);
+
+  base = mmap(NULL,
+              len,
+              PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS,
+              -1,
+              0);
+  if (base == MAP_FAILED) {
+    err = UV__ERR(errno);
+    munmap(ring, ringlen);
+    return err;
+  }
+
+  bufs = uv__malloc(UV__IOU_NBUFS * sizeof(*bufs));
+  if (bufs == NULL) {
+    munmap(base, len);
+    munmap(ring, ringlen);
+    return UV_ENOMEM;
+  }
+
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = (uintptr_t) ring;
+  reg.ring_entries = UV__IOU_NBUFS;
+  reg.bgid = UV__IOU_BGID;
+
+  if (uv__io_uring_register(iou->ringfd,
+                            UV__IORING_REGISTER_PBUF_RING,
+                            &reg,
+                            1)) {
+    err = UV__ERR(errno);
+    uv__free(bufs);
+    munmap(base, len);
+    munmap(ring, ringlen);
+    return err;
+  }
+
+  iou->bufs = bufs;
+  iou->bufring = ring;
+  iou->bufbase = base;
+  iou->buftail = 0;
+
+  for (i = 0; i < UV__IOU_NBUFS; i++)
+    uv__iou_buf_put(iou, i);
+
+  return 0;
+}
+
+
+static unsigned int uv__iou_sq_pending(struct uv__iou* iou) {
+  return *iou->sqtail - __atomic_load_n(iou->sqhead, __ATOMIC_ACQUIRE);
+}
+
+
+/* Hand prepared submission queue entries to the kernel without waiting. */
+static int uv__iou_submit(struct uv__iou* iou) {
+  int rc;
+
+  do
+    rc = uv__io_uring_enter(iou->ringfd,
+                            uv__iou_sq_pending(iou),
+                            0,
+                            0,
+                            NULL,
+                            0);
+  while (rc == -1 && errno == EINTR);
+
+  if (rc == -1)
+    return UV__ERR(errno);
+
+  return 0;
+}
+
+
+static struct uv__io_uring_sqe* uv__iou_get_sqe(struct uv__iou* iou) {
+  struct uv__io_uring_sqe* sqe;
+  uint32_t tail;
+
+  if (uv__iou_sq_pending(iou) > iou->sqmask)
+    if (uv__iou_submit(iou))
+      return NULL;  /* Completion queue overflow, try again later. */
+
+  tail = *iou->sqtail;
+  sqe = iou->sqe;
+  sqe = &sqe[tail & iou->sqmask];
+  memset(sqe, 0, sizeof(*sqe));
+
+  __atomic_store_n(iou->sqtail, tail + 1, __ATOMIC_RELEASE);
+
+  return sqe;
+}
+
+
+static int uv__iou_maybe_resize(struct uv__iou* iou, int fd) {
+  struct uv__iou_ms* ms;
+  unsigned int nfdgen;
+  unsigned int i;
+  uint32_t* fdgen;
+  uint32_t* fdmask;
+
+  if ((unsigned) fd < iou->nfdgen)
+    return 0;
+
+  nfdgen = iou->nfdgen ? iou->nfdgen : 64;
+  while (nfdgen <= (unsigned) fd)
+    nfdgen *= 2;
+
+  fdgen = uv__realloc(iou->fdgen, nfdgen * sizeof(*fdgen));
+  if (fdgen == NULL)
+    return UV_ENOMEM;
+  iou->fdgen = fdgen;
+
+  fdmask = uv__realloc(iou->fdmask, nfdgen * sizeof(*fdmask));
+  if (fdmask == NULL)
+    return UV_ENOMEM;
+  iou->fdmask = fdmask;
+
+  ms = uv__realloc(iou->ms, nfdgen * sizeof(*ms));
+  if (ms == NULL)
+    return UV_ENOMEM;
+  iou->ms = ms;
+
+  memset(fdgen + iou->nfdgen, 0, (nfdgen - iou->nfdgen) * sizeof(*fdgen));
+  memset(fdmask + iou->nfdgen, 0, (nfdgen - iou->nfdgen) * sizeof(*fdmask));
+  memset(ms + iou->nfdgen, 0, (nfdgen - iou->nfdgen) * sizeof(*ms));
+  for (i = iou->nfdgen; i < nfdgen; i++) {
+    ms[i].head = -1;
+    ms[i].tail = -1;
+  }
+  iou->nfdgen = nfdgen;
+
+  return 0;
+}
+
+
+/* Cancel the poll request that is currently armed for |fd|, if any. */
+static int uv__iou_disarm(struct uv__iou* iou, int fd) {
+  struct uv__io_uring_sqe* sqe;
+
+  if ((unsigned) fd >= iou->nfdgen || iou->fdmask[fd] == 0)
+    return 0;
+
+  sqe = uv__iou_get_sqe(iou);
+  if (sqe == NULL)
+    return UV_EAGAIN;
+
+  sqe->opcode = UV__IORING_OP_POLL_REMOVE;
+  sqe->addr_u64 = UV__IOU_POLL_DATA(fd, iou->fdgen[fd]);
+  sqe->user_data = UV__IOU_IGNORE;
+
+  iou->fdgen[fd]++;
+  iou->fdmask[fd] = 0;
+
+  return 0;
+}
+
+
+/* The multishot request that takes the place of polling |w| for POLLIN. */
+static int uv__iou_multishot_kind(struct uv__iou* iou, uv__io_t* w) {
+  uv_stream_t* stream;
+  struct uv__iou_ms* ms;
+
+  if (!(w->pevents & POLLIN))
+    return 0;
+
+  stream = container_of(w, uv_stream_t, io_watcher);
+
+  if (w->cb == uv__server_io) {
+    if (stream->type == UV_TCP &&
+        (stream->flags & UV_HANDLE_TCP_SINGLE_ACCEPT)) {
+      return 0;  /* Leaves connections to other processes, see tcp.c. */
+    }
+
+    if (stream->flags & UV_HANDLE_SHARED_TCP_SOCKET)
+      return 0;  /* Would take them all, see uv__stream_share(). */
+
+    if (uv__stream_has_accept_policy(stream))
+      return 0;  /* Would accept while the loop is overloaded. */
+
+    return iou->multishot & UV__IOU_MULTISHOT_ACCEPT;
+  }
+
+  if (w->cb != uv__stream_io ||
+      stream->type != UV_TCP ||
+      stream->connect_req != NULL ||
+      !(stream->flags & UV_HANDLE_READING)) {
+    return 0;
+  }
+
+  if (uv__stream_has_rx_timestamps(stream))
+    return 0;  /* Would lose the control messages. */
+
+  ms = &iou->ms[w->fd];
+  if (ms->nobufs) {
+    ms->nobufs = 0;
+    return 0;
+  }
+
+  if ((iou->multishot & UV__IOU_MULTISHOT_RECV) && iou->bufs == NULL)
+    if (uv__iou_bufs_setup(iou))
+      iou->multishot &= ~UV__IOU_MULTISHOT_RECV;
+
+  return iou->multishot & UV__IOU_MULTISHOT_RECV;
+}
+
+
+static int uv__iou_multishot_cancel(struct uv__iou* iou, int fd) {
+  struct uv__io_uring_sqe* sqe;
+  struct uv__iou_ms* ms;
+
+  ms = &iou->ms[fd];
+  assert(ms->state == UV__IOU_MS_ARMED);
+
+  sqe = uv__iou_get_sqe(iou);
+  if (sqe == NULL)
+    return UV_EAGAIN;
+
+  sqe->opcode = UV__IORING_OP_ASYNC_CANCEL;
+  sqe->addr_u64 = UV__IOU_MULTISHOT_DATA(fd, ms->gen, ms->kind);
+  sqe->user_data = UV__IOU_IGNORE;
+
+  ms->state = UV__IOU_MS_CANCELLING;
+
+  return 0;
+}
+
+
+static int uv__iou_multishot_arm(struct uv__iou* iou, uv__io_t* w, int kind) {
+  struct uv__io_uring_sqe* sqe;
+  struct uv__iou_ms* ms;
+
+  ms = &iou->ms[w->fd];
+
+  if (kind == 0) {
+    if (ms->state == UV__IOU_MS_ARMED)
+      return uv__iou_multishot_cancel(iou, w->fd);
+    return 0;
+  }
+
+  /* Cancelled requests are re-armed once their last completion is in. */
+  if (ms->state != UV__IOU_MS_IDLE)
+    return 0;
+
+  sqe = uv__iou_get_sqe(iou);
+  if (sqe == NULL)
+    return UV_EAGAIN;
+
+  sqe->fd = w->fd;
+
+  if (kind == UV__IOU_MULTISHOT_ACCEPT) {
+    sqe->opcode = UV__IORING_OP_ACCEPT;
+    sqe->ioprio = UV__IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    ms->w = w;
+  } else {
+    sqe->opcode = UV__IORING_OP_RECV;
+    sqe->ioprio = UV__IORING_RECV_MULTISHOT;
+    sqe->flags = UV__IOSQE_BUFFER_SELECT;
+    sqe->buf_group = UV__IOU_BGID;
+  }
+
+  sqe->user_data = UV__IOU_MULTISHOT_DATA(w->fd, ms->gen, kind);
+
+  ms->kind = kind;
+  ms->state = UV__IOU_MS_ARMED;
+  iou->narmed++;
+
+  return 0;
+}
+
+
+static int uv__iou_has_data(const struct uv__iou_ms* ms) {
+  return ms->head != -1 || ms->status != 0;
+}
+
+
+/* The watcher for |fd| if it's a stream that reads. */
+static uv__io_t* uv__iou_reader(uv_loop_t* loop, int fd) {
+  uv_stream_t* stream;
+  uv__io_t* w;
+
+  w = uv__fd_watcher(loop, fd);
+  if (w == NULL || w->cb != uv__stream_io || !(w->pevents & POLLIN))
+    return NULL;
+
+  stream = container_of(w, uv_stream_t, io_watcher);
+  if (!(stream->flags & UV_HANDLE_READING))
+    return NULL;
+
+  return w;
+}
+
+
+/* The watcher for |fd| if it has something to hand out that won't come
+ * with another completion: received data that uv__read() left behind, or
+ * connections that were queued while the listener wasn't accepting.
+ */
+static uv__io_t* uv__iou_ready_watcher(uv_loop_t* loop,
+                                       struct uv__iou* iou,
+                                       int fd) {
+  uv_stream_t* stream;
+  uv__io_t* w;
+
+  w = uv__fd_watcher(loop, fd);
+  if (w == NULL || w->cb != uv__server_io || !(w->pevents & POLLIN)) {
+    if (uv__iou_has_data(&iou->ms[fd]))
+      return uv__iou_reader(loop, fd);
+    return NULL;
+  }
+
+  stream = container_of(w, uv_stream_t, io_watcher);
+  if (stream->accepted_fd == -1)
+    return NULL;
+
+  return w;
+}
+
+
+/* Put |fd| on the list uv__iou_io_poll() hands out from, if it needs to. */
+static void uv__iou_check_ready(uv_loop_t* loop,
+                                struct uv__iou* iou,
+                                int fd) {
+  struct uv__iou_ms* ms;
+
+  ms = &iou->ms[fd];
+  if (ms->ready || uv__iou_ready_watcher(loop, iou, fd) == NULL)
+    return;
+
+  ms->ready = 1;
+  ms->next_ready = iou->ready;
+  iou->ready = fd;
+}
+
+
+static void uv__iou_drop_data(struct uv__iou* iou, struct uv__iou_ms* ms) {
+  while (ms->head != -1) {
+    uv__iou_buf_put(iou, ms->head);
+    ms->head = iou->bufs[ms->head].next;
+  }
+
+  ms->tail = -1;
+  ms->status = 0;
+}
+
+
+static int uv__iou_arm(uv_loop_t* loop, struct uv__iou* iou, uv__io_t* w) {
+  struct uv__io_uring_sqe* sqe;
+  uint32_t pevents;
+  uint32_t events;
+  int kind;
+  int err;
+
+  err = uv__iou_maybe_resize(iou, w->fd);
+  if (err)
+    return err;
+
+  uv__iou_check_ready(loop, iou, w->fd);
+
+  kind = uv__iou_multishot_kind(iou, w);
+  err = uv__iou_multishot_arm(iou, w, kind);
+  if (err)
+    return err;
+
+  pevents = w->pevents;
+  if (kind != 0)
+    pevents &= ~POLLIN;
+
+  if (iou->fdmask[w->fd] == pevents)
+    return 0;
+
+  err = uv__iou_disarm(iou, w->fd);
+  if (err)
+    return err;
+
+  if (pevents == 0)
+    return 0;
+
+  sqe = uv__iou_get_sqe(iou);
+  if (sqe == NULL)
+    return UV_EAGAIN;
+
+  events = pevents;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  /* The kernel swaps the halfwords for compatibility with the old 16 bits
+   * poll_events field.
+   */
+  events = (events << 16) | (events >> 16);
+#endif
+
+  sqe->opcode = UV__IORING_OP_POLL_ADD;
+  sqe->fd = w->fd;
+  sqe->poll32_events = events;
+  sqe->user_data = UV__IOU_POLL_DATA(w->fd, iou->fdgen[w->fd]);
+
+  iou->fdmask[w->fd] = pevents;
+  iou->narmed++;
+
+  return 0;
+}
+
+
+/* Polls are one-shot. Put the watcher back on the watcher queue so that it's
+ * re-armed before the next wait if it's still interested in events.
+ */
+static void uv__iou_rearm(uv_loop_t* loop, uv__io_t* w, int fd) {
+  if (uv__fd_watcher(loop, fd) != w)
+    return;
+
+  if (w->pevents == 0 || !QUEUE_EMPTY(&w->watcher_queue))
+    return;
+
+  w->events = 0;
+  QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
+}
+
+
+static void uv__iou_arm_watchers(uv_loop_t* loop, struct uv__iou* iou) {
+  QUEUE* q;
+  uv__io_t* w;
+
+  while (!QUEUE_EMPTY(&loop->watcher_queue)) {
+    q = QUEUE_HEAD(&loop->watcher_queue);
+    w = QUEUE_DATA(q, uv__io_t, watcher_queue);
+    assert(w->pevents != 0);
+    assert(w->fd >= 0);
+    assert(w->fd < (int) loop->nwatchers);
+
+    /* Leave the remaining watchers queued when the rings are congested,
+     * they're armed on the next iteration of the poll loop.
+     */
+    if (uv__iou_arm(loop, iou, w))
+      break;
+
+    QUEUE_REMOVE(q);
+    QUEUE_INIT(q);
+    w->events = w->pevents;
+  }
+}
+
+
+static struct uv__io_uring_sqe* uv__iou_get_sqe_for_req(uv_loop_t* loop,
+                                                        uv_fs_t* req) {
+  struct uv__io_uring_sqe* sqe;
+  struct uv__iou* iou;
+
+  if (!uv__iou_enabled(loop))
+    return NULL;
+
+  iou = uv__iou_get(loop);
+  sqe = uv__iou_get_sqe(iou);
+  if (sqe == NULL)
+    return NULL;  /* Ring is congested, use the threadpool. */
+
+  sqe->user_data = (uintptr_t) req;
+
+  /* Not on the threadpool, so uv_cancel() returns UV_EBUSY. */
+  req->work_req.loop = loop;
+  req->work_req.work = NULL;
+  req->work_req.done = NULL;
+  QUEUE_INIT(&req->work_req.wq);
+
+  uv__req_register(loop, req);
+  iou->in_flight++;
+
+  return sqe;
+}
+
+
+int uv__iou_fs_close(uv_loop_t* loop, uv_fs_t* req) {
+  struct uv__io_uring_sqe* sqe;
+
+  sqe = uv__iou_get_sqe_for_req(loop, req);
+  if (sqe == NULL)
+    return 0;
+
+  sqe->opcode = UV__IORING_OP_CLOSE;
+  sqe->fd = req->file;
+
+  return 1;
+}
+
+
+int uv__iou_fs_fsync_or_fdatasync(uv_loop_t* loop,
+                                  uv_fs_t* req,
+                                  uint32_t fsync_flags) {
+  struct uv__io_uring_sqe* sqe;
+
+  sqe = uv__iou_get_sqe_for_req(loop, req);
+  if (sqe == NULL)
+    return 0;
+
+  sqe->opcode = UV__IORING_OP_FSYNC;
+  sqe->fd = req->file;
+  sqe->fsync_flags = fsync_flags;
+
+  return 1;
+}
+
+
+int uv__iou_fs_open(uv_loop_t* loop, uv_fs_t* req) {
+  struct uv__io_uring_sqe* sqe;
+
+  sqe = uv__iou_get_sqe_for_req(loop, req);
+  if (sqe == NULL)
+    return 0;
+
+  sqe->opcode = UV__IORING_OP_OPENAT;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = (void*) req->path;
+  sqe->len = req->mode;
+  sqe->open_flags = req->flags | O_CLOEXEC;
+
+  return 1;
+}
+
+
+int uv__iou_fs_read_or_write(uv_loop_t* loop, uv_fs_t* req, int is_read) {
+  struct uv__io_uring_sqe* sqe;
+  unsigned int iovmax;
+
+  /* Reads are capped like the threadpool does. Writes have to be written in
+   * full, which takes the loop in uv__fs_write_all().
+   */
+  iovmax = uv__getiovmax();
+  if (req->nbufs > iovmax) {
+    if (!is_read)
+      return 0;
+    req->nbufs = iovmax;
+  }
+
+  sqe = uv__iou_get_sqe_for_req(loop, req);
+  if (sqe == NULL)
+    return 0;
+
+  sqe->opcode = is_read ? UV__IORING_OP_READV : UV__IORING_OP_WRITEV;
+  sqe->fd = req->file;
+  sqe->addr = req->bufs;
+  sqe->len = req->nbufs;
+  /* -1 reads or writes at the file position, like read() and write(). */
+  sqe->off = req->off < 0 ? (uint64_t) -1 : (uint64_t) req->off;
+
+  return 1;
+}
+
+
+int uv__iou_fs_statx(uv_loop_t* loop,
+                     uv_fs_t* req,
+                     int is_fstat,
+                     int is_lstat) {
+  struct uv__io_uring_sqe* sqe;
+  struct uv__statx* statxbuf;
+
+  if (!uv__iou_enabled(loop))
+    return 0;
+
+  statxbuf = uv__malloc(sizeof(*statxbuf));
+  if (statxbuf == NULL)
+    return 0;
+
+  sqe = uv__iou_get_sqe_for_req(loop, req);
+  if (sqe == NULL) {
+    uv__free(statxbuf);
+    return 0;
+  }
+
+  req->ptr = statxbuf;
+
+  sqe->opcode = UV__IORING_OP_STATX;
+  sqe->fd = AT_FDCWD;
+  sqe->addr = (void*) req->path;
+  sqe->addr2 = (uintptr_t) statxbuf;
+  sqe->len = 0xFFF;  /* STATX_BASIC_STATS + STATX_BTIME */
+
+  if (is_fstat) {
+    sqe->fd = req->file;
+    sqe->addr = "";
+    sqe->statx_flags |= 0x1000;  /* AT_EMPTY_PATH */
+  }
+
+  if (is_lstat)
+    sqe->statx_flags |= AT_SYMLINK_NOFOLLOW;
+
+  return 1;
+}
+
+
+/* A batch is a chain of linked writes, and an fdatasync if it asks for one.
+ * The kernel runs them in order and fails the rest of the chain when a
+ * write fails or comes up short.
+ */
+int uv__iou_fs_write_batch(uv_loop_t* loop, uv_fs_t* req) {
+  struct uv__fs_write_batch* wb;
+  struct uv__io_uring_sqe* sqe;
+  struct uv__iou* iou;
+  unsigned int iovmax;
+  unsigned int nsqes;
+  unsigned int i;
+
+  if (!uv__iou_enabled(loop))
+    return 0;
+
+  /* Segments with too many buffers for one writev take the threadpool. */
+  wb = req->ptr;
+  iovmax = uv__getiovmax();
+  for (i = 0; i < wb->nsegs; i++)
+    if (wb->segs[i].nbufs > iovmax)
+      return 0;
+
+  /* The chain has to reach the kernel in one io_uring_enter() call. */
+  iou = uv__iou_get(loop);
+  nsqes = wb->nsegs + !!(req->flags & UV_FS_WRITE_BATCH_DATASYNC);
+  if (uv__iou_sq_pending(iou) + nsqes > iou->sqmask + 1)
+    if (uv__iou_submit(iou) ||
+        uv__iou_sq_pending(iou) + nsqes > iou->sqmask + 1) {
+      return 0;
+    }
+
+  sqe = uv__iou_get_sqe_for_req(loop, req);
+  assert(sqe != NULL);
+
+  for (i = 0; i < nsqes; i++) {
+    if (i > 0) {
+      sqe = uv__iou_get_sqe(iou);
+      assert(sqe != NULL);
+      sqe->user_data = (uintptr_t) req;
+    }
+
+    if (i + 1 < nsqes)
+      sqe->flags = UV__IOSQE_IO_LINK;
+
+    sqe->fd = req->file;
+
+    if (i == wb->nsegs) {
+      sqe->opcode = UV__IORING_OP_FSYNC;
+      sqe->fsync_flags = UV__IORING_FSYNC_DATASYNC;
+      continue;
+    }
+
+    sqe->opcode = UV__IORING_OP_WRITEV;
+    sqe->addr = (void*) wb->segs[i].bufs;
+    sqe->len = wb->segs[i].nbufs;
+    sqe->off = wb->segs[i].offset;
+  }
+
+  wb->pending = nsqes;
+
+  return 1;
+}
+
+
+/* Takes in a completion of the chain, zero while more are to come. */
+static int uv__iou_write_batch_done(uv_fs_t* req, int res) {
+  struct uv__fs_write_batch* wb;
+  uv_fs_write_segment_t* seg;
+  unsigned int i;
+  unsigned int j;
+  size_t len;
+
+  wb = req->ptr;
+  i = wb->next++;
+
+  /* What follows a failed or short write comes back with UV_ECANCELED. */
+  if (wb->error == 0 && wb->resume == -1) {
+    if (res < 0) {
+      wb->error = res;
+    } else if (i < wb->nsegs) {
+      seg = &wb->segs[i];
+      wb->written += res;
+
+      len = 0;
+      for (j = 0; j < seg->nbufs; j++)
+        len += seg->bufs[j].len;
+
+      if ((size_t) res < len) {
+        seg->offset += res;
+        while (res > 0 && (size_t) res >= seg->bufs[0].len) {
+          res -= seg->bufs[0].len;
+          seg->bufs++;
+          seg->nbufs--;
+        }
+        /* Cast away the const, the buffer descriptors are a private copy. */
+        ((uv_buf_t*) seg->bufs)[0].base += res;
+        ((uv_buf_t*) seg->bufs)[0].len -= res;
+        wb->resume = seg - wb->segs;
+      }
+    }
+  }
+
+  return --wb->pending == 0;
+}
+
+
+static void uv__iou_fs_done(uv_loop_t* loop,
+                            struct uv__iou* iou,
+                            uv_fs_t* req,
+                            int res) {
+  struct uv__fs_write_batch* wb;
+  struct uv__statx* statxbuf;
+
+  if (req->fs_type == UV_FS_WRITE_BATCH) {
+    if (!uv__iou_write_batch_done(req, res))
+      return;
+
+    wb = req->ptr;
+    if (wb->error == 0 && wb->resume != -1) {
+      /* Short write, let the threadpool write the rest. */
+      wb->segs += wb->resume;
+      wb->nsegs -= wb->resume;
+      iou->in_flight--;
+      uv__req_unregister(loop, req);
+      uv__fs_post(loop, req);
+      return;
+    }
+  }
+
+  iou->in_flight--;
+  uv__req_unregister(loop, req);
+
+  req->result = res;
+
+  switch (req->fs_type) {
+  case UV_FS_READ:
+  case UV_FS_WRITE:
+    /* Same early cleanup as the threadpool does. */
+    if (req->bufs != req->bufsml)
+      uv__free(req->bufs);
+    req->bufs = NULL;
+    req->nbufs = 0;
+    break;
+
+  case UV_FS_WRITE_BATCH:
+    wb = req->ptr;
+    req->result = wb->error != 0 ? wb->error : wb->written;
+    break;
+
+  case UV_FS_STAT:
+  case UV_FS_LSTAT:
+  case UV_FS_FSTAT:
+    statxbuf = req->ptr;
+    req->ptr = NULL;
+    if (res == 0) {
+      uv__statx_to_stat(statxbuf, &req->statbuf);
+      req->ptr = &req->statbuf;
+    }
+    uv__free(statxbuf);
+    break;
+
+  default:
+    break;
+  }
+
+  uv__metrics_update_idle_time(loop);
+  req->cb(req);
+}
+
+
+static int uv__iou_accept_done(uv_loop_t* loop,
+                               struct uv__iou* iou,
+                               int fd,
+                               int res) {
+  uv_stream_t* stream;
+  uv__io_t* w;
+
+  w = iou->ms[fd].w;
+  stream = container_of(w, uv_stream_t, io_watcher);
+
+  if (res < 0) {
+    /* Errors end the request. Have uv__server_io() run into the error
+     * with accept() and report it.
+     */
+    if (uv__fd_watcher(loop, fd) != w || stream->accepted_fd != -1)
+      return 0;
+  } else {
+    if (stream->accepted_fd == -1)
+      stream->accepted_fd = res;
+    else if (uv__stream_queue_fd(stream, res))
+      uv__close(res);
+
+    if (uv__fd_watcher(loop, fd) != w) {
+      /* Not accepting, leave the rest in the backlog. */
+      if (iou->ms[fd].state == UV__IOU_MS_ARMED)
+        uv__iou_multishot_cancel(iou, fd);
+      return 0;
+    }
+  }
+
+  uv__metrics_update_idle_time(loop);
+  uv__io_dispatch(loop, w, POLLIN);
+  return 1;
+}
+
+
+/* Take in a recv completion. */
+static void uv__iou_recv_stash(struct uv__iou* iou,
+                               struct uv__iou_ms* ms,
+                               int res,
+                               uint32_t flags) {
+  struct uv__iou_buf* b;
+  int bid;
+
+  if (!(flags & UV__IORING_CQE_F_MORE)) {
+    ms->state = UV__IOU_MS_IDLE;
+
+    if (res == UV_EINVAL) {
+      /* Kernel can't do it, poll from now on. */
+      iou->multishot &= ~UV__IOU_MULTISHOT_RECV;
+      return;
+    }
+  }
+
+  if (res > 0) {
+    assert(flags & UV__IORING_CQE_F_BUFFER);
+    bid = flags >> UV__IORING_CQE_BUFFER_SHIFT;
+    b = &iou->bufs[bid];
+    b->len = res;
+    b->off = 0;
+    b->next = -1;
+
+    if (ms->tail == -1)
+      ms->head = bid;
+    else
+      iou->bufs[ms->tail].next = bid;
+    ms->tail = bid;
+  } else if (res == UV_ENOBUFS) {
+    ms->nobufs = 1;
+  } else if (res == 0) {
+    ms->status = UV_EOF;
+  } else if (res != UV_ECANCELED) {
+    ms->status = res;
+  }
+}
+
+
+static int uv__iou_recv_done(uv_loop_t* loop, struct uv__iou* iou, int fd) {
+  struct uv__iou_ms* ms;
+  uv__io_t* w;
+
+  ms = &iou->ms[fd];
+  if (!uv__iou_has_data(ms))
+    return 0;
+
+  w = uv__iou_reader(loop, fd);
+  if (w == NULL) {
+    /* Not reading, keep it for when it starts again. */
+    if (ms->state == UV__IOU_MS_ARMED)
+      uv__iou_multishot_cancel(iou, fd);
+    return 0;
+  }
+
+  uv__metrics_update_idle_time(loop);
+  uv__io_dispatch(loop, w, POLLIN);
+  return 1;
+}
+
+
+static int uv__iou_multishot_done(uv_loop_t* loop,
+                                  struct uv__iou* iou,
+                                  uint64_t data,
+                                  int res,
+                                  uint32_t flags) {
+  struct uv__iou_ms* ms;
+  uint32_t gen;
+  uv__io_t* w;
+  int nevents;
+  int kind;
+  int fd;
+
+  fd = (int) ((uint32_t) data >> 1);
+  gen = (uint32_t) (data >> 32) & UV__IOU_GEN_MASK;
+  kind = (data & UV__IOU_ACCEPT) ? UV__IOU_MULTISHOT_ACCEPT
+                                 : UV__IOU_MULTISHOT_RECV;
+
+  assert((unsigned) fd < iou->nfdgen);
+  ms = &iou->ms[fd];
+
+  if (!(flags & UV__IORING_CQE_F_MORE))
+    iou->narmed--;
+
+  if ((ms->gen & UV__IOU_GEN_MASK) != gen) {
+    /* The file descriptor was closed. */
+    if (flags & UV__IORING_CQE_F_BUFFER)
+      uv__iou_buf_put(iou, flags >> UV__IORING_CQE_BUFFER_SHIFT);
+    else if (kind == UV__IOU_MULTISHOT_ACCEPT && res >= 0)
+      uv__close(res);
+    return 0;
+  }
+
+  if (kind == UV__IOU_MULTISHOT_ACCEPT) {
+    if (!(flags & UV__IORING_CQE_F_MORE)) {
+      ms->state = UV__IOU_MS_IDLE;
+
+      if (res == UV_EINVAL) {
+        /* Same as in uv__iou_recv_stash(). */
+        iou->multishot &= ~UV__IOU_MULTISHOT_ACCEPT;
+        res = UV_ECANCELED;
+      }
+    }
+
+    nevents = 0;
+    if (res != UV_ECANCELED)
+      nevents = uv__iou_accept_done(loop, iou, fd, res);
+  } else {
+    uv__iou_recv_stash(iou, ms, res, flags);
+    nevents = uv__iou_recv_done(loop, iou, fd);
+  }
+
+  /* Callbacks may have closed it. */
+  if ((ms->gen & UV__IOU_GEN_MASK) != gen)
+    return nevents;
+
+  if (ms->state == UV__IOU_MS_IDLE) {
+    w = uv__fd_watcher(loop, fd);
+    if (w != NULL)
+      uv__iou_rearm(loop, w, fd);
+  }
+
+  uv__iou_check_ready(loop, iou, fd);
+
+  return nevents;
+}
+
+
+/* Hand out what's been left behind, see uv__iou_check_ready(). */
+static int uv__iou_run_ready(uv_loop_t* loop, struct uv__iou* iou) {
+  struct uv__iou_ms* ms;
+  uv__io_t* w;
+  int nevents;
+  int next;
+  int fd;
+
+  nevents = 0;
+  next = iou->ready;
+  iou->ready = -1;
+
+  while (next != -1) {
+    fd = next;
+    ms = &iou->ms[fd];
+    next = ms->next_ready;
+    ms->ready = 0;
+
+    w = uv__iou_ready_watcher(loop, iou, fd);
+    if (w == NULL)
+      continue;
+
+    uv__metrics_update_idle_time(loop);
+    uv__io_dispatch(loop, w, POLLIN);
+    nevents++;
+
+    uv__iou_check_ready(loop, iou, fd);
+  }
+
+  return nevents;
+}
+
+
+static int uv__iou_reap(uv_loop_t* loop, struct uv__iou* iou) {
+  struct uv__io_uring_cqe* cqe;
+  struct uv__io_uring_cqe* e;
+  unsigned int events;
+  uint64_t data;
+  uint32_t flags;
+  uint32_t head;
+  uint32_t tail;
+  uint32_t gen;
+  uv__io_t* w;
+  int have_signals;
+  int nevents;
+  int res;
+  int fd;
+
+  cqe = iou->cqe;
+  have_signals = 0;
+  nevents = 0;
+
+  head = *iou->cqhead;
+  tail = __atomic_load_n(iou->cqtail, __ATOMIC_ACQUIRE);
+
+  for (; head != tail; head++) {
+    e = &cqe[head & iou->cqmask];
+    data = e->user_data;
+    res = e->res;
+    flags = e->flags;
+
+    /* Release the slot right away, callbacks may submit new requests. */
+    __atomic_store_n(iou->cqhead, head + 1, __ATOMIC_RELEASE);
+
+    if (data == UV__IOU_IGNORE)
+      continue;
+
+    if ((data & 1) == 0) {
+      uv__iou_fs_done(loop, iou, (uv_fs_t*) (uintptr_t) data, res);
+      nevents++;
+      continue;
+    }
+
+    if (data & UV__IOU_MULTISHOT) {
+      nevents += uv__iou_multishot_done(loop, iou, data, res, flags);
+      continue;
+    }
+
+    fd = (int) ((uint32_t) data >> 1);
+    gen = (uint32_t) (data >> 32);
+    iou->narmed--;
+
+    if ((unsigned) fd >= iou->nfdgen ||
+        (iou->fdgen[fd] & UV__IOU_GEN_MASK) != gen) {
+      continue;  /* Stale, see uv__iou_invalidate_fd(). */
+    }
+
+    iou->fdmask[fd] = 0;  /* One-shot poll has fired. */
+
+    w = uv__fd_watcher(loop, fd);
+    if (w == NULL)
+      continue;  /* File descriptor that we've stopped watching. */
+
+    /* Error completions (like EBADF when the file descriptor was closed
+     * behind our back) are reported as POLLERR so that the read and write
+     * paths surface the error to the user.
+     */
+    events = res < 0 ? POLLERR : (unsigned int) res;
+    events &= w->pevents | POLLERR | POLLHUP;
+
+    /* Same quirk as the epoll backend, see the comment in epoll.c. */
+    if (events == POLLERR || events == POLLHUP)
+      events |= w->pevents & (POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI);
+
+    if (events != 0) {
+      /* Run signal watchers last, like the epoll backend. */
+      if (w == &loop->signal_io_watcher) {
+        have_signals = 1;
+        nevents++;
+        continue;
+      }
+
+      uv__metrics_update_idle_time(loop);
+      uv__io_dispatch(loop, w, events);
+      nevents++;
+    }
+
+    uv__iou_rearm(loop, w, fd);
+  }
+
+  nevents += uv__iou_run_ready(loop, iou);
+  uv__metrics_inc_events(loop, nevents);
+
+  if (have_signals != 0) {
+    uv__metrics_update_idle_time(loop);
+    uv__io_dispatch(loop, &loop->signal_io_watcher, POLLIN);
+    uv__iou_rearm(loop,
+                  &loop->signal_io_watcher,
+                  loop->signal_io_watcher.fd);
+    return -1;  /* Event loop should cycle now so don't poll again. */
+  }
+
+  return nevents;
+}
+
+
+/* Sets up the ring without touching the watchers. */
+static int uv__iou_start(uv_loop_t* loop) {
+  struct epoll_event e;
+  struct uv__iou* iou;
+  int err;
+
+  iou = uv__iou_get(loop);
+  err = uv__iou_setup(iou);
+  if (err)
+    return err;
+
+  /* Make the ring visible through uv_backend_fd() for embedders. */
+  memset(&e, 0, sizeof(e));
+  e.events = POLLIN;
+  e.data.fd = iou->ringfd;
+  if (epoll_ctl(loop->backend_fd, EPOLL_CTL_ADD, iou->ringfd, &e)) {
+    err = UV__ERR(errno);
+    uv__iou_delete(iou);
+    return err;
+  }
+
+  return 0;
+}
+
+
+/* The ring is shared with the parent process. Let go of it without
+ * cancelling the parent's requests.
+ */
+void uv__iou_fork_release(uv_loop_t* loop) {
+  uv__iou_delete(uv__iou_get(loop));
+}
+
+
+/* The child of a fork() gets a ring of its own. The watchers are left to
+ * uv_loop_fork(), which only rearms the ones uv_loop_fork_ex() asks for.
+ */
+int uv__iou_fork(uv_loop_t* loop) {
+  return uv__iou_start(loop);
+}
+
+
+int uv__iou_enable(uv_loop_t* loop) {
+  struct epoll_event e;
+  unsigned int i;
+  uv__io_t* w;
+  int err;
+
+  if (uv__iou_get(loop)->ringfd != -1)
+    return 0;
+
+  err = uv__iou_start(loop);
+  if (err)
+    return err;
+
+  memset(&e, 0, sizeof(e));
+
+  /* Move watchers that were registered with epoll over to the ring. */
+  for (i = 0; i < loop->nwatchers; i++) {
+    w = uv__fd_watcher(loop, i);
+    if (w == NULL)
+      continue;
+
+    if (w->events != 0)
+      epoll_ctl(loop->backend_fd, EPOLL_CTL_DEL, w->fd, &e);
+
+    if (w->pevents != 0 && QUEUE_EMPTY(&w->watcher_queue)) {
+      w->events = 0;
+      QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
+    }
+  }
+
+  return 0;
+}
+
+
+void uv__iou_loop_init(uv_loop_t* loop) {
+  uv__iou_init(uv__iou_get(loop));
+}
+
+
+/* Cancel what's still armed and reap it. Poll and multishot requests hold
+ * references to their files, a listener would otherwise keep its port until
+ * the kernel gets around to tearing down the ring.
+ */
+static void uv__iou_cancel_all(struct uv__iou* iou) {
+  struct uv__io_uring_getevents_arg arg;
+  struct uv__kernel_timespec ts;
+  struct uv__io_uring_cqe* cqe;
+  struct uv__io_uring_cqe* e;
+  unsigned int fd;
+  uint64_t data;
+  uint32_t head;
+  uint32_t tail;
+  int rc;
+
+  for (fd = 0; fd < iou->nfdgen; fd++) {
+    uv__iou_disarm(iou, fd);
+    if (iou->ms[fd].state == UV__IOU_MS_ARMED)
+      uv__iou_multishot_cancel(iou, fd);
+  }
+
+  /* Cancellations normally complete right away. Don't hang on requests that
+   * couldn't be cancelled for want of submission queue entries.
+   */
+  memset(&arg, 0, sizeof(arg));
+  memset(&ts, 0, sizeof(ts));
+  ts.tv_nsec = 100 * 1000000;
+  arg.ts = (uintptr_t) &ts;
+  cqe = iou->cqe;
+
+  while (iou->narmed != 0) {
+    rc = uv__io_uring_enter(iou->ringfd,
+                            uv__iou_sq_pending(iou),
+                            1,
+                            UV__IORING_ENTER_GETEVENTS |
+                                UV__IORING_ENTER_EXT_ARG,
+                            &arg,
+                            sizeof(arg));
+
+    head = *iou->cqhead;
+    tail = __atomic_load_n(iou->cqtail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; head++) {
+      e = &cqe[head & iou->cqmask];
+      data = e->user_data;
+
+      if (data == UV__IOU_IGNORE || (data & 1) == 0)
+        continue;
+
+      if (!(data & UV__IOU_MULTISHOT) || !(e->flags & UV__IORING_CQE_F_MORE))
+        iou->narmed--;
+
+      if ((data & UV__IOU_ACCEPT) && e->res >= 0)
+        uv__close(e->res);
+    }
+
+    __atomic_store_n(iou->cqhead, head, __ATOMIC_RELEASE);
+
+    if (rc == -1 && errno != EINTR)
+      break;
+  }
+}
+
+
+void uv__iou_loop_delete(uv_loop_t* loop) {
+  struct uv__iou* iou;
+
+  iou = uv__iou_get(loop);
+  if (iou->ringfd != -1)
+    uv__iou_cancel_all(iou);
+
+  uv__iou_delete(iou);
+}
+
+
+void uv__iou_invalidate_fd(uv_loop_t* loop, int fd) {
+  struct uv__iou_ms* ms;
+  struct uv__iou* iou;
+  int submit;
+
+  iou = uv__iou_get(loop);
+  if ((unsigned) fd >= iou->nfdgen)
+    return;
+
+  /* Same as below, multishot requests hold a reference to the file too.
+   * Completions that are still on their way are recognized by the new
+   * generation; they have their buffer put back, or the connection closed.
+   */
+  ms = &iou->ms[fd];
+  if (ms->state == UV__IOU_MS_ARMED)
+    uv__iou_multishot_cancel(iou, fd);
+  submit = ms->state != UV__IOU_MS_IDLE;  /* Cancellation may be unsent. */
+
+  uv__iou_drop_data(iou, ms);
+  ms->gen++;
+  ms->state = UV__IOU_MS_IDLE;
+  ms->w = NULL;
+  ms->nobufs = 0;
+
+  if (iou->fdmask[fd] != 0) {
+    /* An armed poll request holds a reference to the file. Flush the
+     * cancellation now, otherwise closing a listen socket doesn't release
+     * the port until the next io_uring_enter() call.
+     */
+    if (uv__iou_disarm(iou, fd) == 0) {
+      uv__iou_submit(iou);
+      return;
+    }
+
+    /* Out of submission queue entries. The poll request stays armed until
+     * it fires; sever the link with the file descriptor so that completion
+     * is ignored.
+     */
+    iou->fdmask[fd] = 0;
+  }
+
+  iou->fdgen[fd]++;
+
+  if (submit)
+    uv__iou_submit(iou);
+}
+
+
+/* Stand-in for readv() on TCP streams, which hands out what the multishot
+ * recv request received.
+ */
+ssize_t uv__iou_readv(uv_loop_t* loop,
+                      int fd,
+                      const struct iovec* iov,
+                      int iovcnt) {
+  struct uv__iou_buf* b;
+  struct uv__iou_ms* ms;
+  struct uv__iou* iou;
+  size_t nread;
+  size_t off;
+  size_t n;
+  int status;
+  int i;
+
+  if (!uv__iou_enabled(loop))
+    return uv__readv(fd, iov, iovcnt);
+
+  iou = uv__iou_get(loop);
+  if ((unsigned) fd >= iou->nfdgen)
+    return uv__readv(fd, iov, iovcnt);
+
+  ms = &iou->ms[fd];
+  nread = 0;
+  off = 0;
+  i = 0;
+
+  while (i < iovcnt && ms->head != -1) {
+    if (off == iov[i].iov_len) {
+      off = 0;
+      i++;
+      continue;
+    }
+
+    b = &iou->bufs[ms->head];
+    n = b->len - b->off;
+    if (n > iov[i].iov_len - off)
+      n = iov[i].iov_len - off;
+
+    memcpy((char*) iov[i].iov_base + off,
+           iou->bufbase + (size_t) ms->head * UV__IOU_BUF_SIZE + b->off,
+           n);
+    nread += n;
+    off += n;
+    b->off += n;
+
+    if (b->off == b->len) {
+      uv__iou_buf_put(iou, ms->head);
+      ms->head = b->next;
+      if (ms->head == -1)
+        ms->tail = -1;
+    }
+  }
+
+  if (nread > 0)
+    return nread;
+
+  if (ms->status != 0) {
+    status = ms->status;
+    ms->status = 0;
+    if (status == UV_EOF)
+      return 0;
+    errno = -status;
+    return -1;
+  }
+
+  /* Reading from the socket now could get ahead of the request. */
+  if (ms->state != UV__IOU_MS_IDLE && ms->kind == UV__IOU_MULTISHOT_RECV) {
+    errno = EAGAIN;
+    return -1;
+  }
+
+  return uv__readv(fd, iov, iovcnt);
+}
+
+
+/* Stop the recv request on |fd| and take in what it received, without
+ * running any callbacks. Its completions are taken out of the queue.
+ */
+static void uv__iou_recv_flush(struct uv__iou* iou, int fd) {
+  struct uv__io_uring_cqe* cqe;
+  struct uv__io_uring_cqe* e;
+  struct uv__iou_ms* ms;
+  uint64_t data;
+  uint32_t head;
+  uint32_t tail;
+
+  ms = &iou->ms[fd];
+  if (ms->state == UV__IOU_MS_ARMED && uv__iou_multishot_cancel(iou, fd))
+    return;
+
+  if (uv__iou_submit(iou))
+    return;
+
+  cqe = iou->cqe;
+  data = UV__IOU_MULTISHOT_DATA(fd, ms->gen, UV__IOU_MULTISHOT_RECV);
+  head = *iou->cqhead;
+  tail = __atomic_load_n(iou->cqtail, __ATOMIC_ACQUIRE);
+
+  for (; head != tail; head++) {
+    e = &cqe[head & iou->cqmask];
+    if (e->user_data != data)
+      continue;
+
+    e->user_data = UV__IOU_IGNORE;
+    if (!(e->flags & UV__IORING_CQE_F_MORE))
+      iou->narmed--;
+    uv__iou_recv_stash(iou, ms, e->res, e->flags);
+  }
+}
+
+
+/* Whether a multishot recv request reads from |fd|, or has received data
+ * that hasn't been handed out yet. Listeners don't count, only connections
+ * that come in while they're detached from the loop are lost.
+ */
+int uv__iou_buffered(uv_loop_t* loop, int fd) {
+  struct uv__iou_ms* ms;
+  struct uv__iou* iou;
+
+  if (!uv__iou_enabled(loop))
+    return 0;
+
+  iou = uv__iou_get(loop);
+  if ((unsigned) fd >= iou->nfdgen)
+    return 0;
+
+  ms = &iou->ms[fd];
+  if (ms->state != UV__IOU_MS_IDLE && ms->kind == UV__IOU_MULTISHOT_RECV)
+    uv__iou_recv_flush(iou, fd);
+
+  if (uv__iou_has_data(ms))
+    return 1;
+
+  return ms->state != UV__IOU_MS_IDLE && ms->kind == UV__IOU_MULTISHOT_RECV;
+}
+
+
+void uv__iou_stop_multishot(uv_loop_t* loop, int fd) {
+  struct uv__iou* iou;
+
+  iou = uv__iou_get(loop);
+  if ((unsigned) fd >= iou->nfdgen)
+    return;
+
+  /* On failure the next completion tries again, see uv__iou_recv_done(). */
+  if (iou->ms[fd].state == UV__IOU_MS_ARMED)
+    uv__iou_multishot_cancel(iou, fd);
+}
+
+
+void uv__iou_io_poll(uv_loop_t* loop, int timeout) {
+  struct uv__io_uring_getevents_arg arg;
+  struct uv__kernel_timespec ts;
+  struct uv__iou* iou;
+  unsigned int flags;
+  sigset_t sigset;
+  uint64_t sigmask;
+  uint64_t base;
+  int real_timeout;
+  int user_timeout;
+  int reset_timeout;
+  int nevents;
+  int rc;
+
+  iou = uv__iou_get(loop);
+
+  if (loop->nfds == 0 && iou->in_flight == 0 && timeout == 0) {
+    assert(QUEUE_EMPTY(&loop->watcher_queue));
+    return;
+  }
+
+  sigmask = 0;
+  if (loop->flags & UV_LOOP_BLOCK_SIGPROF) {
+    sigemptyset(&sigset);
+    sigaddset(&sigset, SIGPROF);
+    sigmask |= 1 << (SIGPROF - 1);
+  }
+
+  assert(timeout >= -1);
+  base = loop->time;
+  real_timeout = timeout;
+
+  if (uv__get_internal_fields(loop)->flags & UV_METRICS_IDLE_TIME) {
+    reset_timeout = 1;
+    user_timeout = timeout;
+    timeout = 0;
+  } else {
+    reset_timeout = 0;
+    user_timeout = 0;
+  }
+
+  for (;;) {
+    uv__iou_arm_watchers(loop, iou);
+
+    /* Received data waits to be handed out, see uv__iou_run_ready(). */
+    if (iou->ready != -1)
+      timeout = 0;
+
+    if (timeout != 0)
+      uv__metrics_set_provider_entry_time(loop);
+
+    rc = 0;
+    flags = 0;
+
+    if (timeout != 0) {
+      memset(&arg, 0, sizeof(arg));
+
+      if (sigmask != 0) {
+        arg.sigmask = (uintptr_t) &sigset;
+        arg.sigmask_sz = 8;  /* sizeof(kernel sigset_t) */
+      }
+
+      if (timeout > 0) {
+        ts.tv_sec = timeout / 1000;
+        ts.tv_nsec = (timeout % 1000) * 1000000;
+        arg.ts = (uintptr_t) &ts;
+      }
+
+      flags = UV__IORING_ENTER_GETEVENTS | UV__IORING_ENTER_EXT_ARG;
+    }
+
+    /* With a zero timeout there's nothing to wait for; only make the system
+     * call when there are submissions to flush.
+     */
+    if (flags != 0 || uv__iou_sq_pending(iou) != 0)
+      rc = uv__io_uring_enter(iou->ringfd,
+                              uv__iou_sq_pending(iou),
+                              flags != 0,
+                              flags,
+                              flags != 0 ? &arg : NULL,
+                              flags != 0 ? sizeof(arg) : 0);
+
+    if (rc == -1) {
+      /* EBUSY and EAGAIN mean the completion queue overflowed. Reap what is
+       * there and come back.
+       */
+      if (errno != EINTR &&
+          errno != ETIME &&
+          errno != EBUSY &&
+          errno != EAGAIN) {
+        abort();
+      }
+    }
+
+    /* Update loop->time unconditionally, see the comment in epoll.c. */
+    SAVE_ERRNO(uv__update_time(loop));
+    uv__metrics_poll(loop,
+                     (int) (__atomic_load_n(iou->cqtail, __ATOMIC_ACQUIRE) -
+                            *iou->cqhead),
+                     iou->cqmask + 1);
+
+    nevents = uv__iou_reap(loop, iou);
+
+    if (reset_timeout != 0) {
+      timeout = user_timeout;
+      reset_timeout = 0;
+      if (nevents == 0)
+        continue;
+    }
+
+    if (nevents != 0)
+      return;  /* nevents == -1 means signals were dispatched. */
+
+    if (timeout == 0)
+      return;
+
+    if (timeout == -1)
+      continue;
+
+    assert(timeout > 0);
+
+    real_timeout -= (loop->time - base);
+    if (real_timeout <= 0)
+      return;
+
+    timeout = real_timeout;
+  }
+}
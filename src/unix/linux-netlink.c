@@ -0,0 +1,576 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* rtnetlink helpers: a single dump for uv_interface_addresses() and the
+ * multicast groups behind uv_netif_t.
+ */
+
+#include "uv.h"
+#include "internal.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+/* The kernel sizes dump messages after the largest buffer we read with, up
+ * to 32 kB. Anything bigger is reported as MSG_TRUNC.
+ */
+#define UV__NETLINK_BUFSIZE (32 * 1024)
+
+/* Best effort, capped by net.core.rmem_max. Bursts of link changes on
+ * container hosts otherwise overflow the default buffer.
+ */
+#define UV__NETLINK_RCVBUF (1024 * 1024)
+
+struct uv__netlink_link {
+  int index;
+  unsigned int flags;
+  char name[IF_NAMESIZE];
+  char phys_addr[6];
+};
+
+struct uv__netlink_dump {
+  struct uv__netlink_link* links;
+  size_t nlinks;
+  size_t links_size;
+  uv_interface_address_t* addresses;
+  int naddresses;
+  int addresses_size;
+};
+
+typedef int (*uv__netlink_dump_cb)(struct nlmsghdr* nh, void* arg);
+
+
+static int uv__netlink_parse_link(struct nlmsghdr* nh,
+                                  struct uv__netlink_link* link) {
+  struct ifinfomsg* ifi;
+  struct rtattr* rta;
+  size_t n;
+  int len;
+
+  if (nh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifi)))
+    return -1;
+
+  ifi = NLMSG_DATA(nh);
+  memset(link, 0, sizeof(*link));
+  link->index = ifi->ifi_index;
+  link->flags = ifi->ifi_flags;
+
+  len = IFLA_PAYLOAD(nh);
+  for (rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+    n = RTA_PAYLOAD(rta);
+    switch (rta->rta_type) {
+      case IFLA_IFNAME:
+        if (n > sizeof(link->name) - 1)
+          n = sizeof(link->name) - 1;
+        memcpy(link->name, RTA_DATA(rta), n);
+        link->name[n] = '\0';
+        break;
+
+      case IFLA_ADDRESS:
+        if (n > sizeof(link->phys_addr))
+          n = sizeof(link->phys_addr);
+        memcpy(link->phys_addr, RTA_DATA(rta), n);
+        break;
+    }
+  }
+
+  return 0;
+}
+
+
+/* Fills in everything but the name. |label| receives IFA_LABEL, the alias
+ * name of an IPv4 address, or the empty string.
+ */
+static int uv__netlink_parse_addr(struct nlmsghdr* nh,
+                                  uv_interface_address_t* address,
+                                  char label[IF_NAMESIZE],
+                                  int* index) {
+  struct ifaddrmsg* ifa;
+  struct rtattr* rta;
+  unsigned char* mask;
+  const void* local;
+  const void* addr;
+  size_t alen;
+  size_t n;
+  int plen;
+  int len;
+  int i;
+
+  if (nh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifa)))
+    return -1;
+
+  ifa = NLMSG_DATA(nh);
+  if (ifa->ifa_family == AF_INET)
+    alen = sizeof(struct in_addr);
+  else if (ifa->ifa_family == AF_INET6)
+    alen = sizeof(struct in6_addr);
+  else
+    return -1;
+
+  local = NULL;
+  addr = NULL;
+  label[0] = '\0';
+
+  len = IFA_PAYLOAD(nh);
+  for (rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+    n = RTA_PAYLOAD(rta);
+    switch (rta->rta_type) {
+      case IFA_ADDRESS:
+        if (n >= alen)
+          addr = RTA_DATA(rta);
+        break;
+
+      case IFA_LOCAL:
+        if (n >= alen)
+          local = RTA_DATA(rta);
+        break;
+
+      case IFA_LABEL:
+        if (n > IF_NAMESIZE - 1)
+          n = IF_NAMESIZE - 1;
+        memcpy(label, RTA_DATA(rta), n);
+        label[n] = '\0';
+        break;
+    }
+  }
+
+  /* On point-to-point links IFA_ADDRESS is the peer, IFA_LOCAL is ours. */
+  if (local != NULL)
+    addr = local;
+  if (addr == NULL)
+    return -1;
+
+  memset(address, 0, sizeof(*address));
+  if (ifa->ifa_family == AF_INET) {
+    address->address.address4.sin_family = AF_INET;
+    memcpy(&address->address.address4.sin_addr, addr, alen);
+    address->netmask.netmask4.sin_family = AF_INET;
+    mask = (unsigned char*) &address->netmask.netmask4.sin_addr;
+  } else {
+    address->address.address6.sin6_family = AF_INET6;
+    memcpy(&address->address.address6.sin6_addr, addr, alen);
+    if (IN6_IS_ADDR_LINKLOCAL(&address->address.address6.sin6_addr) ||
+        IN6_IS_ADDR_MC_LINKLOCAL(&address->address.address6.sin6_addr)) {
+      address->address.address6.sin6_scope_id = ifa->ifa_index;
+    }
+    address->netmask.netmask6.sin6_family = AF_INET6;
+    mask = address->netmask.netmask6.sin6_addr.s6_addr;
+  }
+
+  plen = ifa->ifa_prefixlen;
+  if (plen > (int) alen * 8)
+    plen = alen * 8;
+  for (i = 0; plen >= 8; i++, plen -= 8)
+    mask[i] = 0xFF;
+  if (plen > 0)
+    mask[i] = (unsigned char) (0xFF << (8 - plen));
+
+  address->is_internal = ifa->ifa_scope == RT_SCOPE_HOST;
+  *index = ifa->ifa_index;
+
+  return 0;
+}
+
+
+static int uv__netlink_dump(int fd,
+                            char* buf,
+                            int type,
+                            unsigned int seq,
+                            uv__netlink_dump_cb cb,
+                            void* arg) {
+  struct {
+    struct nlmsghdr nh;
+    union {
+      struct ifinfomsg ifi;
+      struct ifaddrmsg ifa;
+    } u;
+  } req;
+  struct sockaddr_nl sa;
+  struct nlmsgerr* err;
+  struct nlmsghdr* nh;
+  socklen_t salen;
+  ssize_t n;
+  int len;
+  int r;
+
+  memset(&req, 0, sizeof(req));
+  if (type == RTM_GETLINK)
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.u.ifi));
+  else
+    req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(req.u.ifa));
+  req.nh.nlmsg_type = type;
+  req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+  req.nh.nlmsg_seq = seq;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.nl_family = AF_NETLINK;
+
+  do
+    n = sendto(fd, &req, req.nh.nlmsg_len, 0, (struct sockaddr*) &sa,
+               sizeof(sa));
+  while (n == -1 && errno == EINTR);
+
+  if (n == -1)
+    return UV__ERR(errno);
+
+  for (;;) {
+    salen = sizeof(sa);
+    do
+      n = recvfrom(fd, buf, UV__NETLINK_BUFSIZE, MSG_TRUNC,
+                   (struct sockaddr*) &sa, &salen);
+    while (n == -1 && errno == EINTR);
+
+    if (n == -1)
+      return UV__ERR(errno);
+
+    if (n == 0)
+      return UV_EIO;
+
+    if (n > UV__NETLINK_BUFSIZE)
+      return UV_EMSGSIZE;
+
+    /* Only the kernel gets to answer. */
+    if (sa.nl_pid != 0)
+      continue;
+
+    len = n;
+    for (nh = (struct nlmsghdr*) buf; NLMSG_OK(nh, len);
+         nh = NLMSG_NEXT(nh, len)) {
+      if (nh->nlmsg_seq != seq)
+        continue;
+
+      if (nh->nlmsg_type == NLMSG_DONE)
+        return 0;
+
+      if (nh->nlmsg_type == NLMSG_ERROR) {
+        if (nh->nlmsg_len < NLMSG_LENGTH(sizeof(*err)))
+          return UV_EIO;
+        err = NLMSG_DATA(nh);
+        if (err->error != 0)
+          return UV__ERR(-err->error);
+        continue;
+      }
+
+      r = cb(nh, arg);
+      if (r != 0)
+        return r;
+    }
+  }
+}
+
+
+static int uv__netlink_link_cmp(const void* a, const void* b) {
+  const struct uv__netlink_link* x;
+  const struct uv__netlink_link* y;
+
+  x = a;
+  y = b;
+
+  return (x->index > y->index) - (x->index < y->index);
+}
+
+
+static int uv__netlink_link_cb(struct nlmsghdr* nh, void* arg) {
+  struct uv__netlink_dump* d;
+  struct uv__netlink_link* links;
+  size_t size;
+
+  d = arg;
+
+  if (nh->nlmsg_type != RTM_NEWLINK)
+    return 0;
+
+  if (d->nlinks == d->links_size) {
+    size = d->links_size == 0 ? 16 : 2 * d->links_size;
+    links = uv__realloc(d->links, size * sizeof(*links));
+    if (links == NULL)
+      return UV_ENOMEM;
+    d->links = links;
+    d->links_size = size;
+  }
+
+  if (uv__netlink_parse_link(nh, &d->links[d->nlinks]) == 0)
+    d->nlinks++;
+
+  return 0;
+}
+
+
+static int uv__netlink_addr_cb(struct nlmsghdr* nh, void* arg) {
+  struct uv__netlink_dump* d;
+  struct uv__netlink_link* link;
+  struct uv__netlink_link key;
+  uv_interface_address_t* addresses;
+  uv_interface_address_t address;
+  char label[IF_NAMESIZE];
+  int size;
+
+  d = arg;
+
+  if (nh->nlmsg_type != RTM_NEWADDR)
+    return 0;
+
+  if (uv__netlink_parse_addr(nh, &address, label, &key.index))
+    return 0;
+
+  link = bsearch(&key, d->links, d->nlinks, sizeof(*link),
+                 uv__netlink_link_cmp);
+  if (link == NULL)
+    return 0;
+
+  if (!((link->flags & IFF_UP) && (link->flags & IFF_RUNNING)))
+    return 0;
+
+  if (d->naddresses == d->addresses_size) {
+    size = d->addresses_size == 0 ? 16 : 2 * d->addresses_size;
+    addresses = uv__realloc(d->addresses, size * sizeof(*addresses));
+    if (addresses == NULL)
+      return UV_ENOMEM;
+    d->addresses = addresses;
+    d->addresses_size = size;
+  }
+
+  /* Alias interfaces share the physical address of their link. */
+  address.name = uv__strdup(label[0] != '\0' ? label : link->name);
+  if (address.name == NULL)
+    return UV_ENOMEM;
+
+  memcpy(address.phys_addr, link->phys_addr, sizeof(address.phys_addr));
+  address.is_internal = !!(link->flags & IFF_LOOPBACK);
+  d->addresses[d->naddresses++] = address;
+
+  return 0;
+}
+
+
+int uv__netlink_interface_addresses(uv_interface_address_t** addresses,
+                                    int* count) {
+  struct uv__netlink_dump d;
+  char* buf;
+  int err;
+  int fd;
+
+  *count = 0;
+  *addresses = NULL;
+
+  fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+  if (fd == -1)
+    return UV__ERR(errno);
+
+  buf = uv__malloc(UV__NETLINK_BUFSIZE);
+  if (buf == NULL) {
+    uv__close(fd);
+    return UV_ENOMEM;
+  }
+
+  memset(&d, 0, sizeof(d));
+
+  /* Links first so that every address can look up its flags and physical
+   * address by index, rather than by matching names.
+   */
+  err = uv__netlink_dump(fd, buf, RTM_GETLINK, 1, uv__netlink_link_cb, &d);
+  if (err == 0) {
+    qsort(d.links, d.nlinks, sizeof(*d.links), uv__netlink_link_cmp);
+    err = uv__netlink_dump(fd, buf, RTM_GETADDR, 2, uv__netlink_addr_cb, &d);
+  }
+
+  uv__close(fd);
+  uv__free(buf);
+  uv__free(d.links);
+
+  if (err != 0) {
+    uv_free_interface_addresses(d.addresses, d.naddresses);
+    return err;
+  }
+
+  *addresses = d.addresses;
+  *count = d.naddresses;
+
+  return 0;
+}
+
+
+static void uv__netif_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
+  uv_interface_address_t address;
+  struct uv__netlink_link link;
+  struct sockaddr_nl sa;
+  struct nlmsghdr* nh;
+  uv_netif_t* handle;
+  char name[IF_NAMESIZE];
+  char buf[16 * 1024];
+  socklen_t salen;
+  ssize_t n;
+  int change;
+  int index;
+  int len;
+  int err;
+  int fd;
+
+  handle = container_of(w, uv_netif_t, io_watcher);
+  fd = w->fd;
+
+  for (;;) {
+    salen = sizeof(sa);
+    do
+      n = recvfrom(fd, buf, sizeof(buf), MSG_TRUNC, (struct sockaddr*) &sa,
+                   &salen);
+    while (n == -1 && errno == EINTR);
+
+    if (n == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return;
+
+      /* ENOBUFS means the kernel dropped events. The socket is still good,
+       * the user re-syncs with uv_interface_addresses().
+       */
+      err = errno;
+      handle->cb(handle, 0, NULL, UV__ERR(err));
+      if (err != ENOBUFS || w->fd != fd)
+        return;
+      continue;
+    }
+
+    /* A truncated message is a lost event too. */
+    if (n > (ssize_t) sizeof(buf)) {
+      handle->cb(handle, 0, NULL, UV_ENOBUFS);
+      if (w->fd != fd)
+        return;
+      continue;
+    }
+
+    if (sa.nl_pid != 0)
+      continue;
+
+    len = n;
+    for (nh = (struct nlmsghdr*) buf; NLMSG_OK(nh, len);
+         nh = NLMSG_NEXT(nh, len)) {
+      switch (nh->nlmsg_type) {
+        case RTM_NEWADDR:
+        case RTM_DELADDR:
+          if (uv__netlink_parse_addr(nh, &address, name, &index))
+            continue;
+          if (name[0] == '\0' && if_indextoname(index, name) == NULL)
+            name[0] = '\0';
+          address.name = name;
+          if (nh->nlmsg_type == RTM_NEWADDR)
+            change = UV_NETIF_ADDR_ADDED;
+          else
+            change = UV_NETIF_ADDR_REMOVED;
+          break;
+
+        case RTM_NEWLINK:
+        case RTM_DELLINK:
+          if (uv__netlink_parse_link(nh, &link))
+            continue;
+          memset(&address, 0, sizeof(address));
+          address.name = link.name;
+          memcpy(address.phys_addr, link.phys_addr, sizeof(link.phys_addr));
+          address.is_internal = !!(link.flags & IFF_LOOPBACK);
+          if (nh->nlmsg_type == RTM_NEWLINK)
+            change = UV_NETIF_LINK_CHANGED;
+          else
+            change = UV_NETIF_LINK_REMOVED;
+          break;
+
+        default:
+          continue;
+      }
+
+      handle->cb(handle, change, &address, 0);
+
+      /* Stopped or closed from the callback. */
+      if (w->fd != fd)
+        return;
+    }
+  }
+}
+
+
+int uv_netif_init(uv_loop_t* loop, uv_netif_t* handle) {
+  uv__handle_init(loop, (uv_handle_t*) handle, UV_NETIF);
+  uv__io_init(&handle->io_watcher, uv__netif_io, -1);
+  handle->cb = NULL;
+  return 0;
+}
+
+
+int uv_netif_start(uv_netif_t* handle, uv_netif_cb cb) {
+  struct sockaddr_nl sa;
+  int size;
+  int err;
+  int fd;
+
+  if (uv__is_active(handle) || uv__is_closing(handle) || cb == NULL)
+    return UV_EINVAL;
+
+  fd = uv__socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+  if (fd < 0)
+    return fd;
+
+  size = UV__NETLINK_RCVBUF;
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+  memset(&sa, 0, sizeof(sa));
+  sa.nl_family = AF_NETLINK;
+  sa.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+
+  if (bind(fd, (struct sockaddr*) &sa, sizeof(sa))) {
+    err = UV__ERR(errno);
+    uv__close(fd);
+    return err;
+  }
+
+  handle->cb = cb;
+  handle->io_watcher.fd = fd;
+  uv__io_start(handle->loop, &handle->io_watcher, POLLIN);
+  uv__handle_start(handle);
+
+  return 0;
+}
+
+
+int uv_netif_stop(uv_netif_t* handle) {
+  int fd;
+
+  if (!uv__is_active(handle))
+    return 0;
+
+  fd = handle->io_watcher.fd;
+  uv__io_close(handle->loop, &handle->io_watcher);
+  uv__handle_stop(handle);
+  uv__close(fd);
+  handle->io_watcher.fd = -1;
+
+  return 0;
+}
+
+
+void uv__netif_close(uv_netif_t* handle) {
+  uv_netif_stop(handle);
+}
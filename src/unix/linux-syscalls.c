@@ -140,6 +140,78 @@
 # endif
 #endif /* __NR_getrandom */
 
+#ifndef __NR_io_uring_setup
+# if defined(__alpha__)
+#  define __NR_io_uring_setup 535
+# elif defined(__arm__)
+#  define __NR_io_uring_setup (UV_SYSCALL_BASE + 425)
+# else
+#  define __NR_io_uring_setup 425
+# endif
+#endif /* __NR_io_uring_setup */
+
+#ifndef __NR_io_uring_enter
+# if defined(__alpha__)
+#  define __NR_io_uring_enter 536
+# elif defined(__arm__)
+#  define __NR_io_uring_enter (UV_SYSCALL_BASE + 426)
+# else
+#  define __NR_io_uring_enter 426
+# endif
+#endif /* __NR_io_uring_enter */
+
+#ifndef __NR_io_uring_register
+# if defined(__alpha__)
+#  define __NR_io_uring_register 537
+# elif defined(__arm__)
+#  define __NR_io_uring_register (UV_SYSCALL_BASE + 427)
+# else
+#  define __NR_io_uring_register 427
+# endif
+#endif /* __NR_io_uring_register */
+
+#ifndef __NR_pidfd_open
+# if defined(__alpha__)
+#  define __NR_pidfd_open 544
+# elif defined(__arm__)
+#  define __NR_pidfd_open (UV_SYSCALL_BASE + 434)
+# else
+#  define __NR_pidfd_open 434
+# endif
+#endif /* __NR_pidfd_open */
+
+#ifndef __NR_close_range
+# if defined(__alpha__)
+#  define __NR_close_range 546
+# elif defined(__arm__)
+#  define __NR_close_range (UV_SYSCALL_BASE + 436)
+# else
+#  define __NR_close_range 436
+# endif
+#endif /* __NR_close_range */
+
+#ifndef __NR_memfd_create
+# if defined(__x86_64__)
+#  define __NR_memfd_create 319
+# elif defined(__i386__)
+#  define __NR_memfd_create 356
+# elif defined(__arm__)
+#  define __NR_memfd_create (UV_SYSCALL_BASE + 385)
+# elif defined(__aarch64__)
+#  define __NR_memfd_create 279
+# endif
+#endif /* __NR_memfd_create */
+
+#ifndef __NR_openat2
+# if defined(__alpha__)
+#  define __NR_openat2 547
+# elif defined(__arm__)
+#  define __NR_openat2 (UV_SYSCALL_BASE + 437)
+# else
+#  define __NR_openat2 437
+# endif
+#endif /* __NR_openat2 */
+
 struct uv__mmsghdr;
 
 int uv__sendmmsg(int fd, struct uv__mmsghdr* mmsg, unsigned int vlen) {
@@ -262,3 +334,86 @@ ssize_t uv__getrandom(void* buf, size_t buflen, unsigned flags) {
   return syscall(__NR_getrandom, buf, buflen, flags);
 #endif
 }
+
+
+ssize_t uv__getdents64(int fd, void* buf, size_t buflen) {
+#if !defined(__NR_getdents64)
+  return errno = ENOSYS, -1;
+#else
+  return syscall(__NR_getdents64, fd, buf, buflen);
+#endif
+}
+
+
+int uv__io_uring_setup(int entries, struct uv__io_uring_params* params) {
+#if defined(__ANDROID_API__)
+  return errno = ENOSYS, -1;
+#else
+  return syscall(__NR_io_uring_setup, entries, params);
+#endif
+}
+
+
+int uv__io_uring_enter(int fd,
+                       unsigned to_submit,
+                       unsigned min_complete,
+                       unsigned flags,
+                       const void* arg,
+                       size_t argsz) {
+#if defined(__ANDROID_API__)
+  return errno = ENOSYS, -1;
+#else
+  return syscall(__NR_io_uring_enter,
+                 fd,
+                 to_submit,
+                 min_complete,
+                 flags,
+                 arg,
+                 argsz);
+#endif
+}
+
+
+int uv__io_uring_register(int fd, unsigned opcode, void* arg, unsigned nargs) {
+#if defined(__ANDROID_API__)
+  return errno = ENOSYS, -1;
+#else
+  return syscall(__NR_io_uring_register, fd, opcode, arg, nargs);
+#endif
+}
+
+
+int uv__pidfd_open(pid_t pid, unsigned int flags) {
+#if defined(__ANDROID_API__)
+  return errno = ENOSYS, -1;
+#else
+  return syscall(__NR_pidfd_open, pid, flags);
+#endif
+}
+
+
+int uv__memfd_create(const char* name, unsigned int flags) {
+#if defined(__NR_memfd_create) && !defined(__ANDROID_API__)
+  return syscall(__NR_memfd_create, name, flags);
+#else
+  return errno = ENOSYS, -1;
+#endif
+}
+
+
+int uv__close_range(unsigned int first, unsigned int last, unsigned int flags) {
+#if defined(__ANDROID_API__)
+  return errno = ENOSYS, -1;
+#else
+  return syscall(__NR_close_range, first, last, flags);
+#endif
+}
+
+
+int uv__openat2(int dirfd, const char* path, struct uv__open_how* how) {
+#if defined(__ANDROID_API__)
+  return errno = ENOSYS, -1;
+#else
+  return syscall(__NR_openat2, dirfd, path, how, sizeof(*how));
+#endif
+}
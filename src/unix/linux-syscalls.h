@@ -55,7 +55,188 @@ struct uv__statx {
   uint32_t stx_rdev_minor;
   uint32_t stx_dev_major;
   uint32_t stx_dev_minor;
-  uint64_t unused1[14];
+  uint64_t stx_mnt_id;
+  uint32_t stx_dio_mem_align;
+  uint32_t stx_dio_offset_align;
+  uint64_t unused1[12];
+};
+
+struct uv__dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  uint16_t d_reclen;
+  uint8_t d_type;
+  char d_name[1];
+};
+
+enum {
+  UV__IORING_SETUP_SQPOLL = 2u,
+  UV__IORING_SETUP_CQSIZE = 8u
+};
+
+enum {
+  UV__IORING_FEAT_SINGLE_MMAP = 1u,
+  UV__IORING_FEAT_NODROP = 2u,
+  UV__IORING_FEAT_EXT_ARG = 256u
+};
+
+enum {
+  UV__IORING_OP_NOP = 0,
+  UV__IORING_OP_READV = 1,
+  UV__IORING_OP_WRITEV = 2,
+  UV__IORING_OP_FSYNC = 3,
+  UV__IORING_OP_POLL_ADD = 6,
+  UV__IORING_OP_POLL_REMOVE = 7,
+  UV__IORING_OP_ACCEPT = 13,
+  UV__IORING_OP_ASYNC_CANCEL = 14,
+  UV__IORING_OP_OPENAT = 18,
+  UV__IORING_OP_CLOSE = 19,
+  UV__IORING_OP_STATX = 21,
+  UV__IORING_OP_RECV = 27
+};
+
+enum {
+  UV__IORING_FSYNC_DATASYNC = 1u
+};
+
+enum {
+  UV__IOSQE_IO_LINK = 4u,
+  UV__IOSQE_BUFFER_SELECT = 32u
+};
+
+/* Go in sqe->ioprio. */
+enum {
+  UV__IORING_ACCEPT_MULTISHOT = 1u,
+  UV__IORING_RECV_MULTISHOT = 2u
+};
+
+enum {
+  UV__IORING_CQE_F_BUFFER = 1u,
+  UV__IORING_CQE_F_MORE = 2u
+};
+
+enum {
+  UV__IORING_CQE_BUFFER_SHIFT = 16
+};
+
+enum {
+  UV__IORING_REGISTER_PBUF_RING = 22
+};
+
+enum {
+  UV__IORING_ENTER_GETEVENTS = 1u,
+  UV__IORING_ENTER_SQ_WAKEUP = 2u,
+  UV__IORING_ENTER_EXT_ARG = 8u
+};
+
+enum {
+  UV__IORING_OFF_SQ_RING = 0,
+  UV__IORING_OFF_SQES = 0x10000000
+};
+
+/* io_uring structures, copied from <linux/io_uring.h> so we don't depend
+ * on recent kernel headers.
+ */
+struct uv__io_sqring_offsets {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t flags;
+  uint32_t dropped;
+  uint32_t array;
+  uint32_t reserved0;
+  uint64_t reserved1;
+};
+
+struct uv__io_cqring_offsets {
+  uint32_t head;
+  uint32_t tail;
+  uint32_t ring_mask;
+  uint32_t ring_entries;
+  uint32_t overflow;
+  uint32_t cqes;
+  uint64_t reserved0;
+  uint64_t reserved1;
+};
+
+struct uv__io_uring_params {
+  uint32_t sq_entries;
+  uint32_t cq_entries;
+  uint32_t flags;
+  uint32_t sq_thread_cpu;
+  uint32_t sq_thread_idle;
+  uint32_t features;
+  uint32_t reserved[4];
+  struct uv__io_sqring_offsets sq_off;  /* 40 bytes */
+  struct uv__io_cqring_offsets cq_off;  /* 40 bytes */
+};
+
+struct uv__io_uring_sqe {
+  uint8_t opcode;
+  uint8_t flags;
+  uint16_t ioprio;
+  int32_t fd;
+  union {
+    uint64_t off;
+    uint64_t addr2;
+  };
+  union {
+    void* addr;
+    uint64_t addr_u64;
+  };
+  uint32_t len;
+  union {
+    uint32_t rw_flags;
+    uint32_t fsync_flags;
+    uint32_t open_flags;
+    uint32_t statx_flags;
+    uint32_t poll32_events;
+    uint32_t accept_flags;
+  };
+  uint64_t user_data;
+  union {
+    uint16_t buf_index;
+    uint16_t buf_group;
+    uint64_t pad[3];
+  };
+};
+
+struct uv__io_uring_cqe {
+  uint64_t user_data;
+  int32_t res;
+  uint32_t flags;
+};
+
+/* A provided buffer. The ring's tail overlaps the |resv| of the first one. */
+struct uv__io_uring_buf {
+  uint64_t addr;
+  uint32_t len;
+  uint16_t bid;
+  uint16_t resv;
+};
+
+struct uv__io_uring_buf_reg {
+  uint64_t ring_addr;
+  uint32_t ring_entries;
+  uint16_t bgid;
+  uint16_t flags;
+  uint64_t resv[3];
+};
+
+#define UV__RESOLVE_BENEATH 0x08
+
+struct uv__open_how {
+  uint64_t flags;
+  uint64_t mode;
+  uint64_t resolve;
+};
+
+struct uv__io_uring_getevents_arg {
+  uint64_t sigmask;
+  uint32_t sigmask_sz;
+  uint32_t pad;
+  uint64_t ts;
 };
 
 ssize_t uv__preadv(int fd, const struct iovec *iov, int iovcnt, int64_t offset);
@@ -74,5 +255,18 @@ int uv__statx(int dirfd,
               unsigned int mask,
               struct uv__statx* statxbuf);
 ssize_t uv__getrandom(void* buf, size_t buflen, unsigned flags);
+ssize_t uv__getdents64(int fd, void* buf, size_t buflen);
+int uv__io_uring_setup(int entries, struct uv__io_uring_params* params);
+int uv__io_uring_enter(int fd,
+                       unsigned to_submit,
+                       unsigned min_complete,
+                       unsigned flags,
+                       const void* arg,
+                       size_t argsz);
+int uv__io_uring_register(int fd, unsigned opcode, void* arg, unsigned nargs);
+int uv__pidfd_open(pid_t pid, unsigned int flags);
+int uv__memfd_create(const char* name, unsigned int flags);
+int uv__openat2(int dirfd, const char* path, struct uv__open_how* how);
+int uv__close_range(unsigned int first, unsigned int last, unsigned int flags);
 
 #endif /* UV_LINUX_SYSCALL_H_ */
@@ -46,7 +46,9 @@
   }                                                                           \
                                                                               \
   void uv__run_##name(uv_loop_t* loop) {                                      \
+    uv_##name##_cb cb;                                                        \
     uv_##name##_t* h;                                                         \
+    uint64_t start;                                                           \
     QUEUE queue;                                                              \
     QUEUE* q;                                                                 \
     QUEUE_MOVE(&loop->name##_handles, &queue);                                \
@@ -55,7 +57,18 @@
       h = QUEUE_DATA(q, uv_##name##_t, queue);                                \
       QUEUE_REMOVE(q);                                                        \
       QUEUE_INSERT_TAIL(&loop->name##_handles, q);                            \
-      h->name##_cb(h);                                                        \
+      if (!uv__callbacks_timed(loop)) {                                       \
+        h->name##_cb(h);                                                      \
+        continue;                                                             \
+      }                                                                       \
+      cb = h->name##_cb;                                                      \
+      start = uv_hrtime();                                                    \
+      cb(h);                                                                  \
+      uv__callback_done(loop,                                                 \
+                        (uv_handle_t*) h,                                     \
+                        UV_##type,                                            \
+                        (void (*)(void)) cb,                                  \
+                        start);                                               \
     }                                                                         \
   }                                                                           \
                                                                               \
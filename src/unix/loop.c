@@ -19,10 +19,11 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_LOOP
+
 #include "uv.h"
 #include "uv/tree.h"
 #include "internal.h"
-#include "heap-inl.h"
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -41,12 +42,12 @@ int uv_loop_init(uv_loop_t* loop) {
   if (lfields == NULL)
     return UV_ENOMEM;
   loop->internal_fields = lfields;
+  QUEUE_INIT(&lfields->defer_queue);
 
   err = uv_mutex_init(&lfields->loop_metrics.lock);
   if (err)
     goto fail_metrics_mutex_init;
 
-  heap_init((struct heap*) &loop->timer_heap);
   QUEUE_INIT(&loop->wq);
   QUEUE_INIT(&loop->idle_handles);
   QUEUE_INIT(&loop->async_handles);
@@ -57,8 +58,6 @@ int uv_loop_init(uv_loop_t* loop) {
   loop->active_handles = 0;
   loop->active_reqs.count = 0;
   loop->nfds = 0;
-  loop->watchers = NULL;
-  loop->nwatchers = 0;
   QUEUE_INIT(&loop->pending_queue);
   QUEUE_INIT(&loop->watcher_queue);
 
@@ -68,23 +67,27 @@ int uv_loop_init(uv_loop_t* loop) {
   loop->async_wfd = -1;
   loop->signal_pipefd[0] = -1;
   loop->signal_pipefd[1] = -1;
+#if defined(__linux__)
+  lfields->signalfd_watcher.fd = -1;
+#endif
   loop->backend_fd = -1;
   loop->emfile_fd = -1;
 
   loop->timer_counter = 0;
   loop->stop_flag = 0;
 
-  err = uv__platform_loop_init(loop);
+  err = uv__fd_map_init(loop);
   if (err)
     goto fail_platform_init;
 
-  uv__signal_global_once_init();
-  err = uv_signal_init(loop, &loop->child_watcher);
+  err = uv__platform_loop_init(loop);
   if (err)
-    goto fail_signal_init;
+    goto fail_platform_init;
 
-  uv__handle_unref(&loop->child_watcher);
-  loop->child_watcher.flags |= UV_HANDLE_INTERNAL;
+  /* |child_watcher| and |wq_async| are set up on first use, by uv_spawn()
+   * and the threadpool. They'd cost every loop a pipe and an eventfd.
+   */
+  uv__signal_global_once_init();
   QUEUE_INIT(&loop->process_handles);
 
   err = uv_rwlock_init(&loop->cloexec_lock);
@@ -95,25 +98,12 @@ int uv_loop_init(uv_loop_t* loop) {
   if (err)
     goto fail_mutex_init;
 
-  err = uv_async_init(loop, &loop->wq_async, uv__work_done);
-  if (err)
-    goto fail_async_init;
-
-  uv__handle_unref(&loop->wq_async);
-  loop->wq_async.flags |= UV_HANDLE_INTERNAL;
-
   return 0;
 
-fail_async_init:
-  uv_mutex_destroy(&loop->wq_mutex);
-
 fail_mutex_init:
   uv_rwlock_destroy(&loop->cloexec_lock);
 
 fail_rwlock_init:
-  uv__signal_loop_cleanup(loop);
-
-fail_signal_init:
   uv__platform_loop_delete(loop);
 
 fail_platform_init:
@@ -123,13 +113,15 @@ fail_metrics_mutex_init:
   uv__free(lfields);
   loop->internal_fields = NULL;
 
-  uv__free(loop->watchers);
-  loop->nwatchers = 0;
+  uv__fd_map_delete(loop);
   return err;
 }
 
 
-int uv_loop_fork(uv_loop_t* loop) {
+static int uv__loop_fork(uv_loop_t* loop,
+                         int rearm_all,
+                         uv_loop_fork_cb rearm_cb,
+                         void* arg) {
   int err;
   unsigned int i;
   uv__io_t* w;
@@ -146,25 +138,47 @@ int uv_loop_fork(uv_loop_t* loop) {
   if (err)
     return err;
 
-  /* Rearm all the watchers that aren't re-queued by the above. */
+  err = uv__threadpool_loop_fork(loop);
+  if (err)
+    return err;
+
+  /* Rearm all the watchers that aren't re-queued by the above, or the ones
+   * rearm_cb asks for. The new backend has none of them, the others get
+   * registered again when they're restarted.
+   */
   for (i = 0; i < loop->nwatchers; i++) {
-    w = loop->watchers[i];
+    w = uv__fd_watcher(loop, i);
     if (w == NULL)
       continue;
 
-    if (w->pevents != 0 && QUEUE_EMPTY(&w->watcher_queue)) {
-      w->events = 0; /* Force re-registration in uv__io_poll. */
-      QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
+    if (w->pevents == 0 || !QUEUE_EMPTY(&w->watcher_queue)) {
+      w->events = 0;
+      continue;
     }
+
+    w->events = 0; /* Force re-registration in uv__io_poll. */
+    if (rearm_all || (rearm_cb != NULL && rearm_cb(loop, w->fd, arg)))
+      QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
   }
 
   return 0;
 }
 
 
+int uv_loop_fork(uv_loop_t* loop) {
+  return uv__loop_fork(loop, 1, NULL, NULL);
+}
+
+
+int uv_loop_fork_ex(uv_loop_t* loop, uv_loop_fork_cb rearm_cb, void* arg) {
+  return uv__loop_fork(loop, 0, rearm_cb, arg);
+}
+
+
 void uv__loop_close(uv_loop_t* loop) {
   uv__loop_internal_fields_t* lfields;
 
+  uv__dns_loop_close(loop);
   uv__signal_loop_cleanup(loop);
   uv__platform_loop_delete(loop);
   uv__async_stop(loop);
@@ -197,11 +211,16 @@ void uv__loop_close(uv_loop_t* loop) {
   assert(loop->nfds == 0);
 #endif
 
-  uv__free(loop->watchers);
-  loop->watchers = NULL;
-  loop->nwatchers = 0;
+  uv__fd_map_delete(loop);
+
+  uv__timer_heap_delete(loop);
+  uv__timer_wheel_delete(loop);
 
   lfields = uv__get_internal_fields(loop);
+  uv__free(lfields->read_batch);
+  uv__free(lfields->poll_events);
+  uv__free(lfields->poll_changes);
+  uv__free(lfields->io_priorities);
   uv_mutex_destroy(&lfields->loop_metrics.lock);
   uv__free(lfields);
   loop->internal_fields = NULL;
@@ -217,6 +236,60 @@ int uv__loop_configure(uv_loop_t* loop, uv_loop_option option, va_list ap) {
     return 0;
   }
 
+#if defined(__linux__)
+  if (option == UV_LOOP_USE_IO_URING)
+    return uv__iou_enable(loop);
+
+  if (option == UV_LOOP_EDGE_TRIGGERED) {
+    lfields->flags |= UV__LOOP_EDGE_TRIGGERED;
+    return 0;
+  }
+
+  if (option == UV_LOOP_BUSY_POLL)
+    return uv__epoll_busy_poll(loop, va_arg(ap, unsigned int));
+
+  if (option == UV_LOOP_EVENT_BUFFER_SIZE) {
+    /* The ring reaps its completions without the epoll buffer. */
+    if (uv__iou_enabled(loop))
+      return UV_ENOTSUP;
+    return uv__epoll_buffer_size(loop, va_arg(ap, unsigned int));
+  }
+
+  if (option == UV_LOOP_IO_BUDGET) {
+    unsigned int ncallbacks;
+
+    ncallbacks = va_arg(ap, unsigned int);
+    return uv__epoll_io_budget(loop, ncallbacks, va_arg(ap, unsigned int));
+  }
+#endif
+
+#if defined(UV_HAVE_KQUEUE)
+  if (option == UV_LOOP_EVENT_BUFFER_SIZE)
+    return uv__kqueue_buffer_size(loop, va_arg(ap, unsigned int));
+#endif
+
+  if (option == UV_LOOP_SLOW_CALLBACK) {
+    lfields->slow_cb = va_arg(ap, uv_slow_callback_cb);
+    lfields->slow_cb_threshold = (uint64_t) va_arg(ap, unsigned int) * 1000000;
+    return 0;
+  }
+
+  if (option == UV_LOOP_COARSE_CLOCK) {
+    lfields->flags |= UV__LOOP_COARSE_CLOCK;
+    uv__update_time(loop);
+    return 0;
+  }
+
+  if (option == UV_LOOP_USE_DNS_RESOLVER)
+    return uv__dns_enable(loop, va_arg(ap, const char*));
+
+  if (option == UV_LOOP_ACCEPT_BATCH) {
+    lfields->accept_batch = va_arg(ap, unsigned int);
+    if (lfields->accept_batch == 0)
+      return UV_EINVAL;
+    return 0;
+  }
+
   if (option != UV_LOOP_BLOCK_SIGNAL)
     return UV_ENOSYS;
 
@@ -20,6 +20,8 @@
  */
 
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_LOOP
+
 #include "os390-syscalls.h"
 #include <errno.h>
 #include <stdlib.h>
@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_LOOP
+
 #include "internal.h"
 #include <sys/ioctl.h>
 #include <net/if.h>
@@ -494,8 +496,8 @@ void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
   assert(loop->watchers != NULL);
   assert(fd >= 0);
 
-  events = (struct epoll_event*) loop->watchers[loop->nwatchers];
-  nfds = (uintptr_t) loop->watchers[loop->nwatchers + 1];
+  events = (struct epoll_event*) uv__fd_map_events(loop);
+  nfds = (uintptr_t) uv__fd_map_nevents(loop);
   if (events != NULL)
     /* Invalidate events with same file descriptor */
     for (i = 0; i < nfds; i++)
@@ -536,6 +538,7 @@ void uv__fs_event_close(uv_fs_event_t* handle) {
 
 int uv_fs_event_init(uv_loop_t* loop, uv_fs_event_t* handle) {
   uv__handle_init(loop, (uv_handle_t*)handle, UV_FS_EVENT);
+  handle->u.reserved[0] = NULL;
   return 0;
 }
 
@@ -584,6 +587,7 @@ int uv_fs_event_stop(uv_fs_event_t* handle) {
   if (!uv__is_active(handle))
     return 0;
 
+  uv__fs_event_batch_stop(handle);
   ep = handle->loop->ep;
   assert(ep->msg_queue != -1);
 
@@ -662,7 +666,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int user_timeout;
   int reset_timeout;
 
-  if (loop->nfds == 0) {
+  if (loop->nfds == 0 && timeout == 0) {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
     return;
   }
@@ -741,6 +745,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
      */
     base = loop->time;
     SAVE_ERRNO(uv__update_time(loop));
+    uv__metrics_poll(loop, nfds, ARRAY_SIZE(events));
     if (nfds == 0) {
       assert(timeout != -1);
 
@@ -783,8 +788,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
 
 
     assert(loop->watchers != NULL);
-    loop->watchers[loop->nwatchers] = (void*) events;
-    loop->watchers[loop->nwatchers + 1] = (void*) (uintptr_t) nfds;
+    uv__fd_map_events(loop) = (void*) events;
+    uv__fd_map_nevents(loop) = (void*) (uintptr_t) nfds;
     for (i = 0; i < nfds; i++) {
       pe = events + i;
       fd = pe->fd;
@@ -802,7 +807,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       assert(fd >= 0);
       assert((unsigned) fd < loop->nwatchers);
 
-      w = loop->watchers[fd];
+      w = uv__fd_watcher(loop, fd);
 
       if (w == NULL) {
         /* File descriptor that we've stopped watching, disarm it.
@@ -826,12 +831,13 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
 
       if (pe->events != 0) {
         uv__metrics_update_idle_time(loop);
-        w->cb(loop, w, pe->events);
+        uv__io_dispatch(loop, w, pe->events);
         nevents++;
       }
     }
-    loop->watchers[loop->nwatchers] = NULL;
-    loop->watchers[loop->nwatchers + 1] = NULL;
+    uv__fd_map_events(loop) = NULL;
+    uv__fd_map_nevents(loop) = NULL;
+    uv__metrics_inc_events(loop, nevents);
 
     if (reset_timeout != 0) {
       timeout = user_timeout;
@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_STREAM
+
 #include "uv.h"
 #include "internal.h"
 
@@ -40,6 +42,37 @@ int uv_pipe_init(uv_loop_t* loop, uv_pipe_t* handle, int ipc) {
 }
 
 
+int uv_pipe_init_ex(uv_loop_t* loop, uv_pipe_t* handle, unsigned int flags) {
+  if (flags & ~(UV_PIPE_IPC | UV_PIPE_SEQPACKET | UV_PIPE_VMSPLICE))
+    return UV_EINVAL;
+
+#if !defined(SOCK_SEQPACKET)
+  if (flags & UV_PIPE_SEQPACKET)
+    return UV_ENOTSUP;
+#endif
+
+  uv_pipe_init(loop, handle, !!(flags & UV_PIPE_IPC));
+  if (flags & UV_PIPE_SEQPACKET)
+    handle->flags |= UV_HANDLE_PIPE_SEQPACKET;
+#if defined(__linux__)
+  if (flags & UV_PIPE_VMSPLICE)
+    handle->flags |= UV_HANDLE_PIPE_VMSPLICE;
+#endif
+
+  return 0;
+}
+
+
+/* The socket type that uv_pipe_bind() and uv_pipe_connect() create. */
+static int uv__pipe_socktype(const uv_pipe_t* handle) {
+#if defined(SOCK_SEQPACKET)
+  if (handle->flags & UV_HANDLE_PIPE_SEQPACKET)
+    return SOCK_SEQPACKET;
+#endif
+  return SOCK_STREAM;
+}
+
+
 int uv_pipe_bind(uv_pipe_t* handle, const char* name) {
   struct sockaddr_un saddr;
   const char* pipe_fname;
@@ -60,7 +93,7 @@ int uv_pipe_bind(uv_pipe_t* handle, const char* name) {
   /* We've got a copy, don't touch the original any more. */
   name = NULL;
 
-  err = uv__socket(AF_UNIX, SOCK_STREAM, 0);
+  err = uv__socket(AF_UNIX, uv__pipe_socktype(handle), 0);
   if (err < 0)
     goto err_socket;
   sockfd = err;
@@ -135,6 +168,10 @@ void uv__pipe_close(uv_pipe_t* handle) {
 
 
 int uv_pipe_open(uv_pipe_t* handle, uv_file fd) {
+#if defined(SOCK_SEQPACKET)
+  socklen_t len;
+  int type;
+#endif
   int flags;
   int mode;
   int err;
@@ -166,6 +203,13 @@ int uv_pipe_open(uv_pipe_t* handle, uv_file fd) {
   if (mode != O_RDONLY)
     flags |= UV_HANDLE_WRITABLE;
 
+#if defined(SOCK_SEQPACKET)
+  len = sizeof(type);
+  if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) == 0 &&
+      type == SOCK_SEQPACKET)
+    flags |= UV_HANDLE_PIPE_SEQPACKET;
+#endif
+
   return uv__stream_open((uv_stream_t*)handle, fd, flags);
 }
 
@@ -182,7 +226,7 @@ void uv_pipe_connect(uv_connect_t* req,
   new_sock = (uv__stream_fd(handle) == -1);
 
   if (new_sock) {
-    err = uv__socket(AF_UNIX, SOCK_STREAM, 0);
+    err = uv__socket(AF_UNIX, uv__pipe_socktype(handle), 0);
     if (err < 0)
       goto out;
     handle->io_watcher.fd = err;
@@ -295,6 +339,14 @@ void uv_pipe_pending_instances(uv_pipe_t* handle, int count) {
 }
 
 
+int uv_pipe_set_pending_instances(uv_pipe_t* handle, int min, int max) {
+  if (min < 1 || min > max || max > UV__PIPE_PENDING_INSTANCES_MAX)
+    return UV_EINVAL;
+
+  return 0;
+}
+
+
 int uv_pipe_pending_count(uv_pipe_t* handle) {
   uv__stream_queued_fds_t* queued_fds;
 
@@ -312,6 +364,52 @@ int uv_pipe_pending_count(uv_pipe_t* handle) {
 }
 
 
+int uv_pipe_accept_fds(uv_pipe_t* handle,
+                       uv_os_fd_t fds[],
+                       unsigned int nfds) {
+  uv__stream_queued_fds_t* queued_fds;
+  unsigned int count;
+  unsigned int rest;
+
+  if (!handle->ipc)
+    return UV_EINVAL;
+
+  if (nfds == 0 || handle->accepted_fd == -1)
+    return 0;
+
+  fds[0] = handle->accepted_fd;
+  handle->accepted_fd = -1;
+
+  queued_fds = handle->queued_fds;
+  if (queued_fds == NULL)
+    return 1;
+
+  count = queued_fds->offset;
+  if (count > nfds - 1)
+    count = nfds - 1;
+
+  memcpy(fds + 1, queued_fds->fds, count * sizeof(*fds));
+
+  /* The next one after those moves up into |accepted_fd|. */
+  rest = queued_fds->offset - count;
+  if (rest > 0) {
+    handle->accepted_fd = queued_fds->fds[count];
+    rest--;
+    memmove(queued_fds->fds,
+            queued_fds->fds + count + 1,
+            rest * sizeof(*queued_fds->fds));
+  }
+
+  queued_fds->offset = rest;
+  if (rest == 0) {
+    uv__free(queued_fds);
+    handle->queued_fds = NULL;
+  }
+
+  return count + 1;
+}
+
+
 uv_handle_type uv_pipe_pending_type(uv_pipe_t* handle) {
   if (!handle->ipc)
     return UV_UNKNOWN_HANDLE;
@@ -381,6 +479,58 @@ int uv_pipe_chmod(uv_pipe_t* handle, int mode) {
 }
 
 
+int uv_pipe_buffer_size(uv_pipe_t* handle, int* value) {
+  struct stat s;
+  int size;
+  int err;
+  int fd;
+#if defined(F_SETPIPE_SZ) && defined(F_GETPIPE_SZ)
+  int r;
+#endif
+
+  if (handle == NULL || value == NULL || *value < 0)
+    return UV_EINVAL;
+
+  fd = uv__stream_fd(handle);
+  if (fd == -1)
+    return UV_EBADF;
+
+  if (fstat(fd, &s))
+    return UV__ERR(errno);
+
+  /* Socket pairs, like the stdio pipes of uv_spawn(), have one buffer per
+   * direction. Report the send side, set both.
+   */
+  if (!S_ISFIFO(s.st_mode)) {
+    if (*value == 0)
+      return uv_send_buffer_size((uv_handle_t*) handle, value);
+
+    size = *value;
+    err = uv_send_buffer_size((uv_handle_t*) handle, &size);
+    if (err == 0)
+      err = uv_recv_buffer_size((uv_handle_t*) handle, &size);
+
+    return err;
+  }
+
+#if defined(F_SETPIPE_SZ) && defined(F_GETPIPE_SZ)
+  /* The kernel rounds the new capacity up, hand that back. */
+  if (*value == 0)
+    r = fcntl(fd, F_GETPIPE_SZ);
+  else
+    r = fcntl(fd, F_SETPIPE_SZ, *value);
+
+  if (r == -1)
+    return UV__ERR(errno);
+
+  *value = r;
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
 int uv_pipe(uv_os_fd_t fds[2], int read_flags, int write_flags) {
   uv_os_fd_t temp[2];
   int err;
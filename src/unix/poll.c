@@ -27,7 +27,7 @@
 #include <errno.h>
 
 
-static void uv__poll_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
+void uv__poll_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
   uv_poll_t* handle;
   int pevents;
 
@@ -117,7 +117,6 @@ int uv_poll_stop(uv_poll_t* handle) {
 
 
 int uv_poll_start(uv_poll_t* handle, int pevents, uv_poll_cb poll_cb) {
-  uv__io_t** watchers;
   uv__io_t* w;
   int events;
 
@@ -125,11 +124,10 @@ int uv_poll_start(uv_poll_t* handle, int pevents, uv_poll_cb poll_cb) {
                       UV_PRIORITIZED)) == 0);
   assert(!uv__is_closing(handle));
 
-  watchers = handle->loop->watchers;
   w = &handle->io_watcher;
 
   if (uv__fd_exists(handle->loop, w->fd))
-    if (watchers[w->fd] != w)
+    if (uv__fd_watcher(handle->loop, w->fd) != w)
       return UV_EEXIST;
 
   uv__poll_stop(handle);
@@ -157,4 +155,5 @@ int uv_poll_start(uv_poll_t* handle, int pevents, uv_poll_cb poll_cb) {
 
 void uv__poll_close(uv_poll_t* handle) {
   uv__poll_stop(handle);
+  uv__io_reset_priority(handle->loop, handle->io_watcher.fd);
 }
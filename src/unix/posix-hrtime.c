@@ -30,6 +30,15 @@
 
 uint64_t uv__hrtime(uv_clocktype_t type) {
   struct timespec ts;
-  clock_gettime(CLOCK_MONOTONIC, &ts);
+  clockid_t clock_id;
+
+  clock_id = CLOCK_MONOTONIC;
+#if defined(CLOCK_MONOTONIC_FAST)
+  /* FreeBSD and DragonFly BSD, precise to the timer tick. */
+  if (type == UV_CLOCK_COARSE)
+    clock_id = CLOCK_MONOTONIC_FAST;
+#endif
+
+  clock_gettime(clock_id, &ts);
   return (((uint64_t) ts.tv_sec) * NANOSEC + ts.tv_nsec);
 }
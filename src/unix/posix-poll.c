@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_LOOP
+
 #include "uv.h"
 #include "internal.h"
 
@@ -147,7 +149,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int user_timeout;
   int reset_timeout;
 
-  if (loop->nfds == 0) {
+  if (loop->nfds == 0 && timeout == 0) {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
     return;
   }
@@ -211,6 +213,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
      * operating system didn't reschedule our process while in the syscall.
      */
     SAVE_ERRNO(uv__update_time(loop));
+    uv__metrics_poll(loop, nfds, 0);
 
     if (nfds == 0) {
       if (reset_timeout != 0) {
@@ -266,7 +269,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       assert(fd >= 0);
       assert((unsigned) fd < loop->nwatchers);
 
-      w = loop->watchers[fd];
+      w = uv__fd_watcher(loop, fd);
 
       if (w == NULL) {
         /* File descriptor that we've stopped watching, ignore.  */
@@ -285,13 +288,15 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
           have_signals = 1;
         } else {
           uv__metrics_update_idle_time(loop);
-          w->cb(loop, w, pe->revents);
+          uv__io_dispatch(loop, w, pe->revents);
         }
 
         nevents++;
       }
     }
 
+    uv__metrics_inc_events(loop, nevents);
+
     if (reset_timeout != 0) {
       timeout = user_timeout;
       reset_timeout = 0;
@@ -299,7 +304,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
 
     if (have_signals != 0) {
       uv__metrics_update_idle_time(loop);
-      loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
+      uv__io_dispatch(loop, &loop->signal_io_watcher, POLLIN);
     }
 
     loop->poll_fds_iterating = 0;
@@ -19,11 +19,14 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_PROCESS
+
 #include "uv.h"
 #include "internal.h"
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <errno.h>
 #include <signal.h>
@@ -45,10 +48,28 @@ extern char **environ;
 # include <grp.h>
 #endif
 
+#if defined(__APPLE__) && !TARGET_OS_IPHONE
+# include <libproc.h>
+# include <mach/mach_time.h>
+#endif
+
 #if defined(__MVS__)
 # include "zos-base.h"
 #endif
 
+/* glibc implements posix_spawn() with clone(CLONE_VM | CLONE_VFORK) and
+ * reports exec() failures to the caller since 2.24.
+ */
+#if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+# if __GLIBC_PREREQ(2, 24)
+#  include <spawn.h>
+#  define UV__HAVE_POSIX_SPAWN 1
+# endif
+# if __GLIBC_PREREQ(2, 29)
+#  define UV__HAVE_POSIX_SPAWN_CHDIR 1
+# endif
+#endif
+
 #if defined(__APPLE__) || defined(__DragonFly__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
 #include <sys/event.h>
 #endif
@@ -61,10 +82,143 @@ static void uv__chld(uv_signal_t* handle, int signum) {
 }
 #endif
 
-void uv__wait_children(uv_loop_t* loop) {
-  uv_process_t* process;
+static void uv__process_report_exit(uv_process_t* process) {
   int exit_status;
   int term_signal;
+
+  uv__handle_stop(process);
+
+  if (process->exit_cb == NULL)
+    return;
+
+  exit_status = 0;
+  if (WIFEXITED(process->status))
+    exit_status = WEXITSTATUS(process->status);
+
+  term_signal = 0;
+  if (WIFSIGNALED(process->status))
+    term_signal = WTERMSIG(process->status);
+
+  process->exit_cb(process, exit_status, term_signal);
+}
+
+
+/* Watches the pidfd or the spawn server socket of a child, stored in
+ * process->u.reserved[0] so that uv_process_t keeps its size. NULL when the
+ * child is waited for with SIGCHLD or kqueue.
+ */
+struct uv__process_exit {
+  uv__io_t io;
+  uv_process_t* process;
+};
+
+
+static void uv__process_exit_watcher_stop(uv_loop_t* loop,
+                                          uv_process_t* process) {
+  struct uv__process_exit* exit_watcher;
+
+  exit_watcher = process->u.reserved[0];
+  if (exit_watcher == NULL)
+    return;
+
+  if (exit_watcher->io.fd != -1) {
+    uv__io_close(loop, &exit_watcher->io);
+    uv__close(exit_watcher->io.fd);
+  }
+
+  process->u.reserved[0] = NULL;
+  uv__free(exit_watcher);
+}
+
+
+/* Children started by the spawn server are not ours to wait for. The server
+ * writes the wait status to the socket when the child exits.
+ */
+static void uv__process_server_exit_cb(uv_loop_t* loop,
+                                       uv__io_t* w,
+                                       unsigned int events) {
+  uv_process_t* process;
+  ssize_t r;
+  int status;
+
+  process = container_of(w, struct uv__process_exit, io)->process;
+
+  do
+    r = read(w->fd, &status, sizeof(status));
+  while (r == -1 && errno == EINTR);
+
+  if (r == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    return;
+
+  /* The server went away, report the child as killed. */
+  if (r != sizeof(status))
+    status = SIGKILL;
+
+  uv__process_exit_watcher_stop(loop, process);
+  process->status = status;
+  uv__process_report_exit(process);
+}
+
+
+#if defined(__linux__)
+
+static void uv__process_pidfd_cb(uv_loop_t* loop,
+                                 uv__io_t* w,
+                                 unsigned int events) {
+  uv_process_t* process;
+  int status;
+  pid_t pid;
+
+  process = container_of(w, struct uv__process_exit, io)->process;
+
+  do
+    pid = waitpid(process->pid, &status, WNOHANG);
+  while (pid == -1 && errno == EINTR);
+
+  if (pid == 0)
+    return;
+
+  if (pid == -1 && errno != ECHILD)
+    abort();
+
+  uv__process_exit_watcher_stop(loop, process);
+
+  /* Reaped by someone else, like uv__wait_children() there is no exit status
+   * to report then.
+   */
+  if (pid == -1)
+    return;
+
+  process->status = status;
+  uv__process_report_exit(process);
+}
+
+
+/* A pidfd becomes readable when the child exits. That way only the handle of
+ * the child that exited is looked at, instead of calling waitpid() for every
+ * child on the loop on each SIGCHLD. Needs Linux 5.3.
+ */
+static int uv__process_pidfd_start(uv_loop_t* loop,
+                                   uv_process_t* process,
+                                   pid_t pid) {
+  struct uv__process_exit* exit_watcher;
+  int fd;
+
+  fd = uv__pidfd_open(pid, 0);
+  if (fd == -1)
+    return UV__ERR(errno);
+
+  exit_watcher = process->u.reserved[0];
+  uv__io_init(&exit_watcher->io, uv__process_pidfd_cb, fd);
+  uv__io_start(loop, &exit_watcher->io, POLLIN);
+
+  return 0;
+}
+#endif
+
+
+void uv__wait_children(uv_loop_t* loop) {
+  uv_process_t* process;
   int status;
   pid_t pid;
   QUEUE pending;
@@ -105,20 +259,7 @@ void uv__wait_children(uv_loop_t* loop) {
 
     QUEUE_REMOVE(&process->queue);
     QUEUE_INIT(&process->queue);
-    uv__handle_stop(process);
-
-    if (process->exit_cb == NULL)
-      continue;
-
-    exit_status = 0;
-    if (WIFEXITED(process->status))
-      exit_status = WEXITSTATUS(process->status);
-
-    term_signal = 0;
-    if (WIFSIGNALED(process->status))
-      term_signal = WTERMSIG(process->status);
-
-    process->exit_cb(process, exit_status, term_signal);
+    uv__process_report_exit(process);
   }
   assert(QUEUE_EMPTY(&pending));
 }
@@ -347,61 +488,20 @@ static void uv__process_child_init(const uv_process_options_t* options,
 }
 #endif
 
-
-int uv_spawn(uv_loop_t* loop,
-             uv_process_t* process,
-             const uv_process_options_t* options) {
-#if defined(__APPLE__) && (TARGET_OS_TV || TARGET_OS_WATCH)
-  /* fork is marked __WATCHOS_PROHIBITED __TVOS_PROHIBITED. */
-  return UV_ENOSYS;
-#else
+#if !(defined(__APPLE__) && (TARGET_OS_TV || TARGET_OS_WATCH))
+/* Also used by the spawn server, which has no loop and no other threads. */
+int uv__spawn_and_init_child_fork(uv_loop_t* loop,
+                                  const uv_process_options_t* options,
+                                  int stdio_count,
+                                  int (*pipes)[2],
+                                  pid_t* pid,
+                                  int* exec_errorno) {
   sigset_t signewset;
   sigset_t sigoldset;
   int signal_pipe[2] = { -1, -1 };
-  int pipes_storage[8][2];
-  int (*pipes)[2];
-  int stdio_count;
+  int status;
   ssize_t r;
-  pid_t pid;
   int err;
-  int exec_errorno;
-  int i;
-  int status;
-
-  assert(options->file != NULL);
-  assert(!(options->flags & ~(UV_PROCESS_DETACHED |
-                              UV_PROCESS_SETGID |
-                              UV_PROCESS_SETUID |
-                              UV_PROCESS_WINDOWS_HIDE |
-                              UV_PROCESS_WINDOWS_HIDE_CONSOLE |
-                              UV_PROCESS_WINDOWS_HIDE_GUI |
-                              UV_PROCESS_WINDOWS_VERBATIM_ARGUMENTS)));
-
-  uv__handle_init(loop, (uv_handle_t*)process, UV_PROCESS);
-  QUEUE_INIT(&process->queue);
-
-  stdio_count = options->stdio_count;
-  if (stdio_count < 3)
-    stdio_count = 3;
-
-  err = UV_ENOMEM;
-  pipes = pipes_storage;
-  if (stdio_count > (int) ARRAY_SIZE(pipes_storage))
-    pipes = uv__malloc(stdio_count * sizeof(*pipes));
-
-  if (pipes == NULL)
-    goto error;
-
-  for (i = 0; i < stdio_count; i++) {
-    pipes[i][0] = -1;
-    pipes[i][1] = -1;
-  }
-
-  for (i = 0; i < options->stdio_count; i++) {
-    err = uv__process_init_stdio(options->stdio + i, pipes[i]);
-    if (err)
-      goto error;
-  }
 
   /* This pipe is used by the parent to wait until
    * the child has called `execve()`. We need this
@@ -425,14 +525,11 @@ int uv_spawn(uv_loop_t* loop,
    */
   err = uv__make_pipe(signal_pipe, 0);
   if (err)
-    goto error;
-
-#if !(defined(__APPLE__) || defined(__DragonFly__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__))
-  uv_signal_start(&loop->child_watcher, uv__chld, SIGCHLD);
-#endif
+    return err;
 
   /* Acquire write lock to prevent opening new fds in worker threads */
-  uv_rwlock_wrlock(&loop->cloexec_lock);
+  if (loop != NULL)
+    uv_rwlock_wrlock(&loop->cloexec_lock);
 
   /* Start the child with most signals blocked, to avoid any issues before we
    * can reset them, but allow program failures to exit (and not hang). */
@@ -448,49 +545,432 @@ int uv_spawn(uv_loop_t* loop,
   if (pthread_sigmask(SIG_BLOCK, &signewset, &sigoldset) != 0)
     abort();
 
-  pid = fork();
-  if (pid == -1)
+  *pid = fork();
+  if (*pid == -1)
     err = UV__ERR(errno);
 
-  if (pid == 0)
+  if (*pid == 0)
     uv__process_child_init(options, stdio_count, pipes, signal_pipe[1]);
 
   if (pthread_sigmask(SIG_SETMASK, &sigoldset, NULL) != 0)
     abort();
 
   /* Release lock in parent process */
-  uv_rwlock_wrunlock(&loop->cloexec_lock);
+  if (loop != NULL)
+    uv_rwlock_wrunlock(&loop->cloexec_lock);
 
   uv__close(signal_pipe[1]);
 
-  if (pid == -1) {
+  if (*pid == -1) {
     uv__close(signal_pipe[0]);
-    goto error;
+    return err;
   }
 
-  process->status = 0;
-  exec_errorno = 0;
+  *exec_errorno = 0;
   do
-    r = read(signal_pipe[0], &exec_errorno, sizeof(exec_errorno));
+    r = read(signal_pipe[0], exec_errorno, sizeof(*exec_errorno));
   while (r == -1 && errno == EINTR);
 
   if (r == 0)
     ; /* okay, EOF */
-  else if (r == sizeof(exec_errorno)) {
+  else if (r == sizeof(*exec_errorno)) {
     do
-      err = waitpid(pid, &status, 0); /* okay, read errorno */
+      err = waitpid(*pid, &status, 0); /* okay, read errorno */
     while (err == -1 && errno == EINTR);
-    assert(err == pid);
+    assert(err == *pid);
   } else if (r == -1 && errno == EPIPE) {
     do
-      err = waitpid(pid, &status, 0); /* okay, got EPIPE */
+      err = waitpid(*pid, &status, 0); /* okay, got EPIPE */
     while (err == -1 && errno == EINTR);
-    assert(err == pid);
+    assert(err == *pid);
   } else
     abort();
 
   uv__close_nocheckstdio(signal_pipe[0]);
 
+  return 0;
+}
+#endif
+
+
+#ifdef UV__HAVE_POSIX_SPAWN
+static const char* uv__spawn_env_path(char** env) {
+  for (; *env != NULL; env++)
+    if (strncmp(*env, "PATH=", 5) == 0)
+      return *env + 5;
+
+  return NULL;
+}
+
+
+/* posix_spawn() runs the child on the parent's address space until it has
+ * called execve(), so it doesn't pay for copying the page tables like fork()
+ * does. It can't drop privileges though, and the working directory and new
+ * session need libc support.
+ */
+static int uv__spawn_can_use_posix_spawn(const uv_process_options_t* options) {
+  if (options->flags & (UV_PROCESS_SETUID | UV_PROCESS_SETGID))
+    return 0;
+
+#ifndef POSIX_SPAWN_SETSID
+  if (options->flags & UV_PROCESS_DETACHED)
+    return 0;
+#endif
+
+#ifndef UV__HAVE_POSIX_SPAWN_CHDIR
+  if (options->cwd != NULL)
+    return 0;
+#endif
+
+  /* Without a PATH, execvp() falls back to a built-in search path that
+   * posix_spawnp() doesn't expose.
+   */
+  if (options->env != NULL &&
+      strchr(options->file, '/') == NULL &&
+      uv__spawn_env_path(options->env) == NULL)
+    return 0;
+
+  return 1;
+}
+
+
+/* The fork() path calls execvp() after switching to the new environment, so
+ * the PATH of that environment is the one that is searched. posix_spawnp()
+ * uses the PATH of the parent, walk the new one by hand instead.
+ */
+static int uv__spawn_posix_spawnp(pid_t* pid,
+                                  const uv_process_options_t* options,
+                                  const posix_spawn_file_actions_t* actions,
+                                  const posix_spawnattr_t* attrs) {
+  const char* path;
+  const char* end;
+  size_t filelen;
+  size_t dirlen;
+  int seen_eacces;
+  char* buf;
+  int err;
+
+  if (options->env == NULL)
+    return UV__ERR(posix_spawnp(pid,
+                                options->file,
+                                actions,
+                                attrs,
+                                options->args,
+                                environ));
+
+  if (strchr(options->file, '/') != NULL)
+    return UV__ERR(posix_spawn(pid,
+                               options->file,
+                               actions,
+                               attrs,
+                               options->args,
+                               options->env));
+
+  path = uv__spawn_env_path(options->env);
+  filelen = strlen(options->file);
+  buf = uv__malloc(strlen(path) + filelen + 2);
+  if (buf == NULL)
+    return UV_ENOMEM;
+
+  seen_eacces = 0;
+  for (;;) {
+    end = strchr(path, ':');
+    if (end == NULL)
+      end = path + strlen(path);
+
+    /* An empty entry means the current working directory. */
+    dirlen = end - path;
+    memcpy(buf, path, dirlen);
+    if (dirlen > 0)
+      buf[dirlen++] = '/';
+    memcpy(buf + dirlen, options->file, filelen + 1);
+
+    err = posix_spawn(pid, buf, actions, attrs, options->args, options->env);
+    if (err == EACCES)
+      seen_eacces = 1;
+    else if (err != ENOENT && err != ENOTDIR)
+      break;
+
+    if (*end == '\0')
+      break;
+
+    path = end + 1;
+  }
+
+  if (err != 0 && seen_eacces)
+    err = EACCES;
+
+  uv__free(buf);
+  return UV__ERR(err);
+}
+
+
+static int uv__spawn_and_init_child_posix_spawn(
+    uv_loop_t* loop,
+    const uv_process_options_t* options,
+    int stdio_count,
+    int (*pipes)[2],
+    pid_t* pid,
+    int* exec_errorno) {
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attrs;
+  sigset_t sigdefault;
+  sigset_t sigmask;
+  int dups_storage[8];
+  int* dups;
+  short flags;
+  int use_fd;
+  int err;
+  int fd;
+  int n;
+
+  dups = dups_storage;
+  if (stdio_count > (int) ARRAY_SIZE(dups_storage))
+    dups = uv__malloc(stdio_count * sizeof(*dups));
+
+  if (dups == NULL)
+    return UV_ENOMEM;
+
+  for (fd = 0; fd < stdio_count; fd++)
+    dups[fd] = -1;
+
+  err = posix_spawn_file_actions_init(&actions);
+  if (err) {
+    if (dups != dups_storage)
+      uv__free(dups);
+    return UV__ERR(err);
+  }
+
+  err = posix_spawnattr_init(&attrs);
+  if (err) {
+    posix_spawn_file_actions_destroy(&actions);
+    if (dups != dups_storage)
+      uv__free(dups);
+    return UV__ERR(err);
+  }
+
+  /* Reset the same signal dispositions as uv__process_child_init() does, and
+   * start the child with an empty signal mask.
+   */
+  sigemptyset(&sigdefault);
+  for (n = 1; n < 32; n += 1)
+    if (n != SIGKILL && n != SIGSTOP)
+      sigaddset(&sigdefault, n);
+
+  sigemptyset(&sigmask);
+  flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+#ifdef POSIX_SPAWN_SETSID
+  if (options->flags & UV_PROCESS_DETACHED)
+    flags |= POSIX_SPAWN_SETSID;
+#endif
+
+  err = posix_spawnattr_setsigdefault(&attrs, &sigdefault);
+  if (err == 0)
+    err = posix_spawnattr_setsigmask(&attrs, &sigmask);
+  if (err == 0)
+    err = posix_spawnattr_setflags(&attrs, flags);
+  if (err) {
+    err = UV__ERR(err);
+    goto out;
+  }
+
+  /* Acquire write lock to prevent opening new fds in worker threads */
+  uv_rwlock_wrlock(&loop->cloexec_lock);
+
+  for (fd = 0; fd < stdio_count && err == 0; fd++) {
+    use_fd = pipes[fd][1];
+
+    if (use_fd < 0) {
+      if (fd >= 3)
+        continue;
+
+      /* redirect stdin, stdout and stderr to /dev/null even if UV_IGNORE is
+       * set
+       */
+      err = posix_spawn_file_actions_addopen(&actions,
+                                             fd,
+                                             "/dev/null",
+                                             fd == 0 ? O_RDONLY : O_RDWR,
+                                             0);
+      err = UV__ERR(err);
+      continue;
+    }
+
+    /* The file actions run in order, so a low numbered fd could be replaced
+     * before it is duplicated. Move it out of the way first. The copy is
+     * close-on-exec, dup2() clears the flag on the target, which also takes
+     * care of an fd that is inherited in place.
+     */
+    if (use_fd < stdio_count) {
+      dups[fd] = fcntl(use_fd, F_DUPFD_CLOEXEC, stdio_count);
+      if (dups[fd] == -1) {
+        err = UV__ERR(errno);
+        break;
+      }
+      use_fd = dups[fd];
+    }
+
+    if (fd <= 2)
+      uv__nonblock_fcntl(use_fd, 0);
+
+    err = UV__ERR(posix_spawn_file_actions_adddup2(&actions, use_fd, fd));
+  }
+
+  for (fd = 0; fd < stdio_count && err == 0; fd++) {
+    use_fd = pipes[fd][1];
+
+    if (use_fd < stdio_count)
+      continue;
+
+    for (n = 0; n < fd; n++)
+      if (pipes[n][1] == use_fd)
+        break;
+
+    if (n == fd)
+      err = UV__ERR(posix_spawn_file_actions_addclose(&actions, use_fd));
+  }
+
+#ifdef UV__HAVE_POSIX_SPAWN_CHDIR
+  if (err == 0 && options->cwd != NULL)
+    err = UV__ERR(posix_spawn_file_actions_addchdir_np(&actions,
+                                                       options->cwd));
+#endif
+
+  /* posix_spawn() only returns once the child has called execve(), or has
+   * failed to and was reaped, so no handshake pipe is needed.
+   */
+  if (err == 0)
+    *exec_errorno = uv__spawn_posix_spawnp(pid, options, &actions, &attrs);
+
+  /* Release lock in parent process */
+  uv_rwlock_wrunlock(&loop->cloexec_lock);
+
+  for (fd = 0; fd < stdio_count; fd++)
+    if (dups[fd] != -1)
+      uv__close(dups[fd]);
+
+out:
+  posix_spawnattr_destroy(&attrs);
+  posix_spawn_file_actions_destroy(&actions);
+
+  if (dups != dups_storage)
+    uv__free(dups);
+
+  return err;
+}
+#endif
+
+
+int uv_spawn(uv_loop_t* loop,
+             uv_process_t* process,
+             const uv_process_options_t* options) {
+#if defined(__APPLE__) && (TARGET_OS_TV || TARGET_OS_WATCH)
+  /* fork is marked __WATCHOS_PROHIBITED __TVOS_PROHIBITED. */
+  return UV_ENOSYS;
+#else
+  int pipes_storage[8][2];
+  int (*pipes)[2];
+  int stdio_count;
+  pid_t pid;
+  int err;
+  struct uv__process_exit* exit_watcher;
+  int exec_errorno;
+  int exit_fd;
+  int i;
+
+  assert(options->file != NULL);
+  assert(!(options->flags & ~(UV_PROCESS_DETACHED |
+                              UV_PROCESS_SETGID |
+                              UV_PROCESS_SETUID |
+                              UV_PROCESS_WINDOWS_HIDE |
+                              UV_PROCESS_WINDOWS_HIDE_CONSOLE |
+                              UV_PROCESS_WINDOWS_HIDE_GUI |
+                              UV_PROCESS_WINDOWS_VERBATIM_ARGUMENTS)));
+
+  exit_fd = -1;
+  uv__handle_init(loop, (uv_handle_t*)process, UV_PROCESS);
+  QUEUE_INIT(&process->queue);
+  process->u.reserved[0] = NULL;
+
+  stdio_count = options->stdio_count;
+  if (stdio_count < 3)
+    stdio_count = 3;
+
+  err = UV_ENOMEM;
+  pipes = pipes_storage;
+  if (stdio_count > (int) ARRAY_SIZE(pipes_storage))
+    pipes = uv__malloc(stdio_count * sizeof(*pipes));
+
+  if (pipes == NULL)
+    goto error;
+
+  /* Allocated up front, there is no backing out once the child runs. */
+  exit_watcher = uv__malloc(sizeof(*exit_watcher));
+  if (exit_watcher == NULL)
+    goto error;
+
+  uv__io_init(&exit_watcher->io, uv__process_server_exit_cb, -1);
+  exit_watcher->process = process;
+  process->u.reserved[0] = exit_watcher;
+
+  for (i = 0; i < stdio_count; i++) {
+    pipes[i][0] = -1;
+    pipes[i][1] = -1;
+  }
+
+  for (i = 0; i < options->stdio_count; i++) {
+    err = uv__process_init_stdio(options->stdio + i, pipes[i]);
+    if (err)
+      goto error;
+  }
+
+  pid = 0;
+  exec_errorno = 0;
+  err = uv__spawn_server_spawn(options,
+                               stdio_count,
+                               pipes,
+                               &pid,
+                               &exec_errorno,
+                               &exit_fd);
+
+  if (err == UV_ENOSYS) {
+#if !(defined(__APPLE__) || defined(__DragonFly__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__))
+    /* Set up on first use, it costs the loop a pipe. */
+    if (loop->child_watcher.type != UV_SIGNAL) {
+      err = uv_signal_init(loop, &loop->child_watcher);
+      if (err)
+        goto error;
+
+      uv__handle_unref(&loop->child_watcher);
+      loop->child_watcher.flags |= UV_HANDLE_INTERNAL;
+    }
+
+    uv_signal_start(&loop->child_watcher, uv__chld, SIGCHLD);
+#endif
+
+#ifdef UV__HAVE_POSIX_SPAWN
+    if (uv__spawn_can_use_posix_spawn(options))
+      err = uv__spawn_and_init_child_posix_spawn(loop,
+                                                 options,
+                                                 stdio_count,
+                                                 pipes,
+                                                 &pid,
+                                                 &exec_errorno);
+    else
+#endif
+      err = uv__spawn_and_init_child_fork(loop,
+                                          options,
+                                          stdio_count,
+                                          pipes,
+                                          &pid,
+                                          &exec_errorno);
+  }
+
+  if (err)
+    goto error;
+
+  process->status = 0;
+
   for (i = 0; i < options->stdio_count; i++) {
     err = uv__process_open_stream(options->stdio + i, pipes[i]);
     if (err == 0)
@@ -503,7 +983,12 @@ int uv_spawn(uv_loop_t* loop,
   }
 
   /* Only activate this handle if exec() happened successfully */
-  if (exec_errorno == 0) {
+  if (exec_errorno == 0 && exit_fd != -1) {
+    uv__io_init(&exit_watcher->io, uv__process_server_exit_cb, exit_fd);
+    uv__io_start(loop, &exit_watcher->io, POLLIN);
+    exit_fd = -1;
+    uv__handle_start(process);
+  } else if (exec_errorno == 0) {
 #if defined(__APPLE__) || defined(__DragonFly__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
     struct kevent event;
     EV_SET(&event, pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, 0);
@@ -515,8 +1000,19 @@ int uv_spawn(uv_loop_t* loop,
     }
 #endif
 
-    QUEUE_INSERT_TAIL(&loop->process_handles, &process->queue);
+#if defined(__linux__)
+    /* Fall back to SIGCHLD and waitpid() on kernels without pidfd_open(). */
+    err = uv__process_pidfd_start(loop, process, pid);
+#else
+    err = UV_ENOSYS;
+#endif
+    if (err != 0) {
+      uv__process_exit_watcher_stop(loop, process);
+      QUEUE_INSERT_TAIL(&loop->process_handles, &process->queue);
+    }
     uv__handle_start(process);
+  } else {
+    uv__process_exit_watcher_stop(loop, process);
   }
 
   process->pid = pid;
@@ -528,6 +1024,11 @@ int uv_spawn(uv_loop_t* loop,
   return exec_errorno;
 
 error:
+  uv__process_exit_watcher_stop(loop, process);
+
+  if (exit_fd != -1)
+    uv__close(exit_fd);
+
   if (pipes != NULL) {
     for (i = 0; i < stdio_count; i++) {
       if (i < options->stdio_count)
@@ -561,8 +1062,174 @@ int uv_kill(int pid, int signum) {
 }
 
 
+#if defined(__linux__)
+/* Fields 3 and up of /proc/<pid>/stat, counting from 1 like proc(5) does. */
+static int uv__process_read_usage(int procfd, uv_process_usage_t* usage) {
+  uint64_t fields[25];
+  char path[32];
+  char buf[1024];
+  char* p;
+  long ticks;
+  int field;
+  int fd;
+  ssize_t n;
+
+  snprintf(path, sizeof(path), "%d/stat", (int) usage->pid);
+  fd = openat(procfd, path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return errno == ENOENT ? UV_ESRCH : UV__ERR(errno);
+
+  do
+    n = read(fd, buf, sizeof(buf) - 1);
+  while (n == -1 && errno == EINTR);
+
+  if (n == -1)
+    n = UV__ERR(errno);
+  uv__close(fd);
+  if (n < 0)
+    return n;
+  buf[n] = '\0';
+
+  /* The command name, field 2, is in parentheses and can contain spaces. */
+  p = strrchr(buf, ')');
+  if (p == NULL || p[1] != ' ')
+    return UV_EINVAL;
+
+  /* Field 3 is the state, a letter, the rest are numbers. */
+  p += 2;
+  p += strcspn(p, " ");
+  for (field = 4; field < (int) ARRAY_SIZE(fields); field++) {
+    if (*p != ' ')
+      return UV_EINVAL;
+    fields[field] = strtoull(p + 1, &p, 10);
+  }
+
+  ticks = sysconf(_SC_CLK_TCK);
+  if (ticks <= 0)
+    ticks = 100;
+
+  usage->minflt = fields[10];
+  usage->majflt = fields[12];
+  usage->utime = fields[14] * 1000000 / ticks;
+  usage->stime = fields[15] * 1000000 / ticks;
+  usage->nthreads = fields[20];
+  usage->rss = fields[24] * getpagesize();
+  return 0;
+}
+#elif defined(__APPLE__) && !TARGET_OS_IPHONE
+static int uv__process_read_usage(int procfd, uv_process_usage_t* usage) {
+  static mach_timebase_info_data_t timebase;
+  struct proc_taskinfo ti;
+
+  if (timebase.denom == 0)
+    if (mach_timebase_info(&timebase) != KERN_SUCCESS)
+      return UV_EIO;
+
+  if (proc_pidinfo(usage->pid, PROC_PIDTASKINFO, 0, &ti, sizeof(ti)) !=
+      (int) sizeof(ti))
+    return errno == 0 ? UV_ESRCH : UV__ERR(errno);
+
+  /* The times are in mach absolute time units. */
+  usage->utime = ti.pti_total_user * timebase.numer / timebase.denom / 1000;
+  usage->stime = ti.pti_total_system * timebase.numer / timebase.denom / 1000;
+  usage->rss = ti.pti_resident_size;
+  usage->majflt = ti.pti_pageins;
+  usage->minflt = ti.pti_faults - ti.pti_pageins;
+  usage->nthreads = ti.pti_threadnum;
+  return 0;
+}
+#endif
+
+
+#if defined(__linux__) || (defined(__APPLE__) && !TARGET_OS_IPHONE)
+static void uv__process_stats(uv_process_usage_t* usage, unsigned int n) {
+  unsigned int i;
+  int procfd;
+
+  procfd = -1;
+#if defined(__linux__)
+  /* One lookup of /proc for the whole batch, then relative opens. */
+  procfd = uv__open_cloexec("/proc", O_RDONLY | O_DIRECTORY);
+  if (procfd < 0) {
+    for (i = 0; i < n; i++)
+      if (usage[i].status == 0)
+        usage[i].status = procfd;
+    return;
+  }
+#endif
+
+  for (i = 0; i < n; i++)
+    if (usage[i].status == 0)
+      usage[i].status = uv__process_read_usage(procfd, &usage[i]);
+
+  if (procfd != -1)
+    uv__close(procfd);
+}
+
+
+static void uv__process_stats_work(struct uv__work* w) {
+  uv_process_stats_t* req;
+
+  req = container_of(w, uv_process_stats_t, work_req);
+  uv__process_stats(req->usage, req->nusage);
+}
+
+
+static void uv__process_stats_done(struct uv__work* w, int status) {
+  uv_process_stats_t* req;
+
+  req = container_of(w, uv_process_stats_t, work_req);
+  uv__req_unregister(req->loop, req);
+  req->cb(req, status);
+}
+#endif
+
+
+int uv_process_get_stats_many(uv_loop_t* loop,
+                              uv_process_stats_t* req,
+                              uv_process_t* processes[],
+                              uv_process_usage_t usage[],
+                              unsigned int nprocesses,
+                              uv_process_stats_cb cb) {
+#if defined(__linux__) || (defined(__APPLE__) && !TARGET_OS_IPHONE)
+  unsigned int i;
+
+  /* The handles are only looked at here, the pool works on the pids. A pid
+   * of a child that exited but wasn't reaped yet still has its zombie entry,
+   * uv_process_t handles stop being active once their child is reaped.
+   */
+  for (i = 0; i < nprocesses; i++) {
+    memset(&usage[i], 0, sizeof(usage[i]));
+    usage[i].pid = processes[i]->pid;
+    if (processes[i]->pid == 0 || !uv__is_active(processes[i]))
+      usage[i].status = UV_ESRCH;
+  }
+
+  if (cb == NULL) {
+    uv__process_stats(usage, nprocesses);
+    return 0;
+  }
+
+  uv__req_init(loop, req, UV_PROCESS_STATS);
+  req->loop = loop;
+  req->usage = usage;
+  req->nusage = nprocesses;
+  req->cb = cb;
+  uv__work_submit(loop,
+                  &req->work_req,
+                  UV__WORK_SLOW_IO,
+                  uv__process_stats_work,
+                  uv__process_stats_done);
+  return 0;
+#else
+  return UV_ENOSYS;
+#endif
+}
+
+
 void uv__process_close(uv_process_t* handle) {
   QUEUE_REMOVE(&handle->queue);
+  uv__process_exit_watcher_stop(handle->loop, handle);
   uv__handle_stop(handle);
   if (QUEUE_EMPTY(&handle->loop->process_handles))
     uv_signal_stop(&handle->loop->child_watcher);
@@ -0,0 +1,526 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* A shared memory channel is a pair of single producer, single consumer byte
+ * rings in a memfd, one per direction, plus an eventfd per side to wake it
+ * up. The side that creates it is side 0 and sends on ring 0, the side that
+ * opens the passed fds is side 1 and sends on ring 1.
+ *
+ * Messages are a 32 bits length and the payload, padded to 8 bytes. One that
+ * doesn't fit in the space up to the end of the ring is preceded by a pad
+ * record that skips to the start, so the receiver gets every message in one
+ * piece, straight from the shared memory.
+ *
+ * Wakeups work like they do for the rings of uv_spsc_ring_init(). The
+ * receiver says it's going to sleep with |waiting| and a sender that
+ * publishes a message after that signals the eventfd. A sender that runs
+ * out of room sets |full| and the receiver signals it once it made room.
+ * Both sides issue a full fence between storing their own position or flag
+ * and looking at the other side's, so while messages flow neither side
+ * makes a system call.
+ */
+
+#include "uv.h"
+#include "internal.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__clang__) ||                                                     \
+    defined(__GNUC__) && (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ >= 7)
+#define UV__SHM_ATOMICS 1
+#endif
+
+#define UV__SHM_MAGIC 0x75767368u  /* "uvsh" */
+#define UV__SHM_HEADER 4096
+#define UV__SHM_MIN_SIZE 4096
+#define UV__SHM_MAX_SIZE (1u << 30)
+#define UV__SHM_PAD 0xFFFFFFFFu
+#define UV__MFD_CLOEXEC 1
+
+/* Keeps the fields that each side writes on cache lines of their own. */
+struct uv__shm_ring {
+  unsigned int tail;  /* Sender. */
+  unsigned int full;  /* The sender waits for room. */
+  char pad0[64 - 2 * sizeof(unsigned int)];
+  unsigned int head;  /* Receiver. */
+  unsigned int waiting;  /* The receiver waits for messages. */
+  char pad1[64 - 2 * sizeof(unsigned int)];
+};
+
+struct uv__shm_header {
+  unsigned int magic;
+  unsigned int size;  /* Of each ring's data. */
+  char pad[64 - 2 * sizeof(unsigned int)];
+  struct uv__shm_ring rings[2];
+};
+
+
+static unsigned int shm_load(unsigned int* p) {
+#if defined(UV__SHM_ATOMICS)
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#else
+  unsigned int val;
+
+  val = *(volatile unsigned int*) p;
+  __sync_synchronize();
+  return val;
+#endif
+}
+
+
+static void shm_store(unsigned int* p, unsigned int val) {
+#if defined(UV__SHM_ATOMICS)
+  __atomic_store_n(p, val, __ATOMIC_RELEASE);
+#else
+  __sync_synchronize();
+  *(volatile unsigned int*) p = val;
+#endif
+}
+
+
+static void shm_fence(void) {
+#if defined(UV__SHM_ATOMICS)
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#else
+  __sync_synchronize();
+#endif
+}
+
+
+static unsigned int shm_record(size_t len) {
+  return (unsigned int) ((sizeof(uint32_t) + len + 7) & ~(size_t) 7);
+}
+
+
+static struct uv__shm_header* shm_header(const uv_shm_channel_t* channel) {
+  return channel->shm;
+}
+
+
+static char* shm_data(const uv_shm_channel_t* channel, int ring) {
+  return (char*) channel->shm + UV__SHM_HEADER +
+         (size_t) ring * shm_header(channel)->size;
+}
+
+
+static void shm_wake(int fd) {
+  uint64_t val;
+  ssize_t r;
+
+  val = 1;
+  do
+    r = write(fd, &val, sizeof(val));
+  while (r == -1 && errno == EINTR);
+}
+
+
+/* fds[1] wakes up side 0, fds[2] side 1. */
+static void shm_signal(uv_shm_channel_t* channel) {
+  shm_wake(channel->fds[2 - channel->side]);
+}
+
+
+static void shm_channel_recv(uv_shm_channel_t* channel) {
+  struct uv__shm_ring* ring;
+  unsigned int start;
+  unsigned int mask;
+  unsigned int head;
+  unsigned int tail;
+  unsigned int off;
+  uint32_t len;
+  uv_buf_t buf;
+  char* data;
+
+  ring = &shm_header(channel)->rings[1 - channel->side];
+  data = shm_data(channel, 1 - channel->side);
+  mask = shm_header(channel)->size - 1;
+  head = ring->head;
+  start = head;
+
+  for (;;) {
+    tail = shm_load(&ring->tail);
+
+    if (head == tail) {
+      shm_store(&ring->waiting, 1);
+      shm_fence();
+      if (head == shm_load(&ring->tail))
+        return;
+      shm_store(&ring->waiting, 0);
+      continue;
+    }
+
+    while (head != tail) {
+      off = head & mask;
+      memcpy(&len, data + off, sizeof(len));
+
+      if (len == UV__SHM_PAD) {
+        head += mask + 1 - off;
+      } else {
+        /* The peer wrote garbage, stop listening to it. */
+        if (len > mask + 1 - off - sizeof(len)) {
+          uv_poll_stop((uv_poll_t*) channel);
+          return;
+        }
+
+        buf = uv_buf_init(data + off + sizeof(len), len);
+        channel->recv_cb(channel, &buf);
+
+        /* Closed by the callback, the memory is gone. */
+        if (channel->shm == NULL)
+          return;
+
+        head += shm_record(len);
+      }
+
+      shm_store(&ring->head, head);
+    }
+
+    /* Room for a sender that ran into a full ring. */
+    shm_fence();
+    if (shm_load(&ring->full)) {
+      shm_store(&ring->full, 0);
+      shm_signal(channel);
+    }
+
+    /* A ring's worth per wakeup so a busy sender doesn't starve the loop.
+     * Not waiting, so come back in the next iteration.
+     */
+    if (head - start > mask) {
+      shm_wake(channel->fds[1 + channel->side]);
+      return;
+    }
+  }
+}
+
+
+static void shm_channel_poll_cb(uv_poll_t* handle, int status, int events) {
+  uv_shm_channel_t* channel;
+  uint64_t val;
+  ssize_t r;
+
+  channel = (uv_shm_channel_t*) handle;
+
+  do
+    r = read(channel->fds[1 + channel->side], &val, sizeof(val));
+  while (r == -1 && errno == EINTR);
+
+  shm_channel_recv(channel);
+  if (channel->shm == NULL)
+    return;
+
+  /* The peer made room, or it's a spurious wakeup and the next send finds
+   * the ring still full, which arms |full| again.
+   */
+  if (channel->blocked) {
+    channel->blocked = 0;
+    if (channel->writable_cb != NULL)
+      channel->writable_cb(channel);
+  }
+}
+
+
+static int shm_channel_start(uv_loop_t* loop,
+                             uv_shm_channel_t* channel,
+                             uv_shm_channel_cb recv_cb) {
+  int err;
+
+  err = uv_poll_init(loop,
+                     (uv_poll_t*) channel,
+                     channel->fds[1 + channel->side]);
+  if (err)
+    return err;
+
+  channel->recv_cb = recv_cb;
+  channel->writable_cb = NULL;
+  channel->blocked = 0;
+  return uv_poll_start((uv_poll_t*) channel, UV_READABLE, shm_channel_poll_cb);
+}
+
+
+static void shm_channel_release(uv_shm_channel_t* channel) {
+  int i;
+
+  if (channel->shm != NULL)
+    munmap(channel->shm, channel->shm_size);
+  channel->shm = NULL;
+
+  for (i = 0; i < 3; i++) {
+    if (channel->fds[i] != -1)
+      uv__close(channel->fds[i]);
+    channel->fds[i] = -1;
+  }
+}
+
+
+int uv_shm_channel_init(uv_loop_t* loop,
+                        uv_shm_channel_t* channel,
+                        size_t size,
+                        uv_shm_channel_cb recv_cb) {
+  struct uv__shm_header* hdr;
+  size_t n;
+  int err;
+  int i;
+
+  if (recv_cb == NULL || size > UV__SHM_MAX_SIZE)
+    return UV_EINVAL;
+
+  n = UV__SHM_MIN_SIZE;
+  while (n < size)
+    n <<= 1;
+
+  channel->shm = NULL;
+  channel->shm_size = UV__SHM_HEADER + 2 * n;
+  channel->side = 0;
+  for (i = 0; i < 3; i++)
+    channel->fds[i] = -1;
+
+  channel->fds[0] = uv__memfd_create("libuv-shm-channel", UV__MFD_CLOEXEC);
+  if (channel->fds[0] == -1)
+    goto fail;
+
+  if (ftruncate(channel->fds[0], channel->shm_size))
+    goto fail;
+
+  for (i = 1; i < 3; i++) {
+    channel->fds[i] = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (channel->fds[i] == -1)
+      goto fail;
+  }
+
+  channel->shm = mmap(NULL,
+                      channel->shm_size,
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED,
+                      channel->fds[0],
+                      0);
+  if (channel->shm == MAP_FAILED) {
+    channel->shm = NULL;
+    goto fail;
+  }
+
+  /* Fresh from ftruncate(), everything else is zero. Both receivers start
+   * out asleep, the first message wakes them.
+   */
+  hdr = channel->shm;
+  hdr->magic = UV__SHM_MAGIC;
+  hdr->size = (unsigned int) n;
+  hdr->rings[0].waiting = 1;
+  hdr->rings[1].waiting = 1;
+
+  err = shm_channel_start(loop, channel, recv_cb);
+  if (err == 0)
+    return 0;
+
+  shm_channel_release(channel);
+  return err;
+
+fail:
+  err = UV__ERR(errno);
+  shm_channel_release(channel);
+  return err;
+}
+
+
+int uv_shm_channel_open(uv_loop_t* loop,
+                        uv_shm_channel_t* channel,
+                        const uv_os_fd_t fds[3],
+                        uv_shm_channel_cb recv_cb) {
+  struct uv__shm_header* hdr;
+  struct stat s;
+  void* shm;
+  int err;
+
+  if (recv_cb == NULL)
+    return UV_EINVAL;
+
+  if (fstat(fds[0], &s))
+    return UV__ERR(errno);
+
+  if (s.st_size < UV__SHM_HEADER)
+    return UV_EINVAL;
+
+  shm = mmap(NULL,
+             (size_t) s.st_size,
+             PROT_READ | PROT_WRITE,
+             MAP_SHARED,
+             fds[0],
+             0);
+  if (shm == MAP_FAILED)
+    return UV__ERR(errno);
+
+  hdr = shm;
+  if (hdr->magic != UV__SHM_MAGIC ||
+      hdr->size < UV__SHM_MIN_SIZE ||
+      hdr->size > UV__SHM_MAX_SIZE ||
+      (hdr->size & (hdr->size - 1)) != 0 ||
+      (off_t) (UV__SHM_HEADER + 2 * (size_t) hdr->size) != s.st_size) {
+    munmap(shm, (size_t) s.st_size);
+    return UV_EINVAL;
+  }
+
+  channel->shm = shm;
+  channel->shm_size = (size_t) s.st_size;
+  channel->side = 1;
+  memcpy(channel->fds, fds, sizeof(channel->fds));
+
+  err = shm_channel_start(loop, channel, recv_cb);
+  if (err) {
+    /* The fds are still the caller's. */
+    munmap(shm, channel->shm_size);
+    channel->shm = NULL;
+  }
+
+  return err;
+}
+
+
+int uv_shm_channel_fds(const uv_shm_channel_t* channel, uv_os_fd_t fds[3]) {
+  if (channel->side != 0)
+    return UV_EINVAL;
+
+  memcpy(fds, channel->fds, sizeof(channel->fds));
+  return 0;
+}
+
+
+int uv_shm_channel_send(uv_shm_channel_t* channel,
+                        const uv_buf_t bufs[],
+                        unsigned int nbufs) {
+  struct uv__shm_ring* ring;
+  unsigned int contig;
+  unsigned int mask;
+  unsigned int need;
+  unsigned int tail;
+  unsigned int head;
+  unsigned int off;
+  unsigned int rec;
+  unsigned int i;
+  uint32_t len;
+  char* data;
+  size_t size;
+
+  if (channel->shm == NULL)
+    return UV_EBADF;
+
+  mask = shm_header(channel)->size - 1;
+  size = uv__count_bufs(bufs, nbufs);
+  if (size > (mask + 1) / 2 - sizeof(len))
+    return UV_EINVAL;
+
+  ring = &shm_header(channel)->rings[channel->side];
+  data = shm_data(channel, channel->side);
+  rec = shm_record(size);
+
+  /* Only this side writes |tail|. */
+  tail = ring->tail;
+  off = tail & mask;
+  contig = mask + 1 - off;
+  need = contig < rec ? contig + rec : rec;
+
+  head = shm_load(&ring->head);
+  if (mask + 1 - (tail - head) < need) {
+    shm_store(&ring->full, 1);
+    shm_fence();
+    head = shm_load(&ring->head);
+    if (mask + 1 - (tail - head) < need) {
+      channel->blocked = 1;
+      return UV_ENOBUFS;
+    }
+  }
+
+  if (contig < rec) {
+    len = UV__SHM_PAD;
+    memcpy(data + off, &len, sizeof(len));
+    tail += contig;
+    off = 0;
+  }
+
+  len = (uint32_t) size;
+  memcpy(data + off, &len, sizeof(len));
+  off += sizeof(len);
+  for (i = 0; i < nbufs; i++) {
+    memcpy(data + off, bufs[i].base, bufs[i].len);
+    off += bufs[i].len;
+  }
+
+  shm_store(&ring->tail, tail + rec);
+
+  shm_fence();
+  if (shm_load(&ring->waiting)) {
+    shm_store(&ring->waiting, 0);
+    shm_signal(channel);
+  }
+
+  return 0;
+}
+
+
+void uv_shm_channel_close(uv_shm_channel_t* channel, uv_close_cb close_cb) {
+  /* Takes the eventfd out of the poll set before it's closed. */
+  uv_close((uv_handle_t*) channel, close_cb);
+  shm_channel_release(channel);
+}
+
+#else  /* !defined(__linux__) */
+
+int uv_shm_channel_init(uv_loop_t* loop,
+                        uv_shm_channel_t* channel,
+                        size_t size,
+                        uv_shm_channel_cb recv_cb) {
+  return UV_ENOSYS;
+}
+
+
+int uv_shm_channel_open(uv_loop_t* loop,
+                        uv_shm_channel_t* channel,
+                        const uv_os_fd_t fds[3],
+                        uv_shm_channel_cb recv_cb) {
+  return UV_ENOSYS;
+}
+
+
+int uv_shm_channel_fds(const uv_shm_channel_t* channel, uv_os_fd_t fds[3]) {
+  return UV_ENOSYS;
+}
+
+
+int uv_shm_channel_send(uv_shm_channel_t* channel,
+                        const uv_buf_t bufs[],
+                        unsigned int nbufs) {
+  return UV_ENOSYS;
+}
+
+
+/* uv_shm_channel_init() and uv_shm_channel_open() never succeed, there's
+ * nothing to close.
+ */
+void uv_shm_channel_close(uv_shm_channel_t* channel, uv_close_cb close_cb) {
+}
+
+#endif  /* defined(__linux__) */
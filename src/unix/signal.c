@@ -28,6 +28,10 @@
 #include <string.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+# include <sys/signalfd.h>
+#endif
+
 #ifndef SA_RESTART
 # define SA_RESTART 0
 #endif
@@ -180,19 +184,13 @@ static uv_signal_t* uv__signal_first_handle(int signum) {
 }
 
 
-static void uv__signal_handler(int signum) {
+static void uv__signal_dispatch(int signum) {
+  /* This function must be called with the signal lock held. */
   uv__signal_msg_t msg;
   uv_signal_t* handle;
-  int saved_errno;
 
-  saved_errno = errno;
   memset(&msg, 0, sizeof msg);
 
-  if (uv__signal_lock()) {
-    errno = saved_errno;
-    return;
-  }
-
   for (handle = uv__signal_first_handle(signum);
        handle != NULL && handle->signum == signum;
        handle = RB_NEXT(uv__signal_tree_s, &uv__signal_tree, handle)) {
@@ -215,12 +213,115 @@ static void uv__signal_handler(int signum) {
     if (r != -1)
       handle->caught_signals++;
   }
+}
+
+
+static void uv__signal_handler(int signum) {
+  int saved_errno;
+
+  saved_errno = errno;
+
+  if (uv__signal_lock()) {
+    errno = saved_errno;
+    return;
+  }
+
+  uv__signal_dispatch(signum);
 
   uv__signal_unlock();
   errno = saved_errno;
 }
 
 
+#if defined(__linux__)
+/* A signal that is blocked in the thread that starts watching it will not
+ * reach the signal handler there. Read it from a signalfd on the loop thread
+ * instead, in batches and without a trip through the signal handler. The
+ * signal is passed on to all watchers of it, in every loop, exactly like the
+ * signal handler does.
+ */
+static int uv__signal_is_blocked(int signum) {
+  sigset_t mask;
+
+  if (pthread_sigmask(SIG_BLOCK, NULL, &mask))
+    return 0;
+
+  return sigismember(&mask, signum) == 1;
+}
+
+
+static void uv__signalfd_event(uv_loop_t* loop,
+                               uv__io_t* w,
+                               unsigned int events) {
+  struct signalfd_siginfo si[32];
+  sigset_t saved_sigmask;
+  size_t i;
+  size_t n;
+  ssize_t r;
+
+  do {
+    do
+      r = read(w->fd, si, sizeof(si));
+    while (r == -1 && errno == EINTR);
+
+    if (r == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return;
+
+    if (r == -1)
+      abort();
+
+    n = r / sizeof(si[0]);
+
+    uv__signal_block_and_lock(&saved_sigmask);
+    for (i = 0; i < n; i++)
+      uv__signal_dispatch(si[i].ssi_signo);
+    uv__signal_unlock_and_unblock(&saved_sigmask);
+  } while (n == ARRAY_SIZE(si));
+}
+
+
+static int uv__signalfd_update(uv_loop_t* loop) {
+  /* This function must be called with the signal lock held. */
+  uv_signal_t* handle;
+  uv__io_t* w;
+  sigset_t mask;
+  int empty;
+  int fd;
+
+  empty = 1;
+  sigemptyset(&mask);
+
+  RB_FOREACH(handle, uv__signal_tree_s, &uv__signal_tree) {
+    if (handle->loop == loop && (handle->flags & UV_SIGNAL_SIGNALFD)) {
+      sigaddset(&mask, handle->signum);
+      empty = 0;
+    }
+  }
+
+  w = &uv__get_internal_fields(loop)->signalfd_watcher;
+  if (w->fd == -1) {
+    if (empty)
+      return 0;
+
+    fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd == -1)
+      return UV__ERR(errno);
+
+    uv__io_init(w, uv__signalfd_event, fd);
+  } else if (signalfd(w->fd, &mask, 0) == -1) {
+    return UV__ERR(errno);
+  }
+
+  if (empty)
+    uv__io_stop(loop, w, POLLIN);
+  else
+    uv__io_start(loop, w, POLLIN);
+
+  return 0;
+}
+#endif
+
+
 static int uv__signal_register_handler(int signum, int oneshot) {
   /* When this function is called, the signal lock must be held. */
   struct sigaction sa;
@@ -279,6 +380,9 @@ static int uv__signal_loop_once_init(uv_loop_t* loop) {
 
 
 int uv__signal_loop_fork(uv_loop_t* loop) {
+  if (loop->signal_pipefd[0] == -1)  /* Never created. */
+    return 0;
+
   uv__io_stop(loop, &loop->signal_io_watcher, POLLIN);
   uv__close(loop->signal_pipefd[0]);
   uv__close(loop->signal_pipefd[1]);
@@ -289,6 +393,9 @@ int uv__signal_loop_fork(uv_loop_t* loop) {
 
 
 void uv__signal_loop_cleanup(uv_loop_t* loop) {
+#if defined(__linux__)
+  uv__io_t* w;
+#endif
   QUEUE* q;
 
   /* Stop all the signal watchers that are still attached to this loop. This
@@ -313,6 +420,15 @@ void uv__signal_loop_cleanup(uv_loop_t* loop) {
     uv__close(loop->signal_pipefd[1]);
     loop->signal_pipefd[1] = -1;
   }
+
+#if defined(__linux__)
+  w = &uv__get_internal_fields(loop)->signalfd_watcher;
+  if (w->fd != -1) {
+    uv__io_close(loop, w);
+    uv__close(w->fd);
+    w->fd = -1;
+  }
+#endif
 }
 
 
@@ -356,6 +472,9 @@ static int uv__signal_start(uv_signal_t* handle,
   sigset_t saved_sigmask;
   int err;
   uv_signal_t* first_handle;
+#if defined(__linux__)
+  int blocked;
+#endif
 
   assert(!uv__is_closing(handle));
 
@@ -381,6 +500,10 @@ static int uv__signal_start(uv_signal_t* handle,
     uv__signal_stop(handle);
   }
 
+#if defined(__linux__)
+  blocked = uv__signal_is_blocked(signum);
+#endif
+
   uv__signal_block_and_lock(&saved_sigmask);
 
   /* If at this point there are no active signal watchers for this signum (in
@@ -404,6 +527,15 @@ static int uv__signal_start(uv_signal_t* handle,
 
   RB_INSERT(uv__signal_tree_s, &uv__signal_tree, handle);
 
+#if defined(__linux__)
+  if (blocked) {
+    handle->flags |= UV_SIGNAL_SIGNALFD;
+    /* Keep relying on the signal handler when that fails. */
+    if (uv__signalfd_update(handle->loop))
+      handle->flags &= ~UV_SIGNAL_SIGNALFD;
+  }
+#endif
+
   uv__signal_unlock_and_unblock(&saved_sigmask);
 
   handle->signal_cb = signal_cb;
@@ -535,6 +667,13 @@ static void uv__signal_stop(uv_signal_t* handle) {
   assert(removed_handle == handle);
   (void) removed_handle;
 
+#if defined(__linux__)
+  if (handle->flags & UV_SIGNAL_SIGNALFD) {
+    handle->flags &= ~UV_SIGNAL_SIGNALFD;
+    uv__signalfd_update(handle->loop);
+  }
+#endif
+
   /* Check if there are other active signal watchers observing this signal. If
    * not, unregister the signal handler.
    */
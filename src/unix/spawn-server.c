@@ -0,0 +1,726 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* The spawn server is a process that is forked while the parent is still
+ * small. uv_spawn() sends it the options and the stdio file descriptors, it
+ * forks and executes the child and passes back the pid. Every request comes
+ * with a socket of its own, the server writes the wait status of the child to
+ * it when the child exits and the loop of the parent watches the other end.
+ */
+
+#define UV__ALLOC_TAG UV_ALLOC_TAG_PROCESS
+
+#include "uv.h"
+#include "internal.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__APPLE__) && !TARGET_OS_IPHONE
+# include <crt_externs.h>
+# define environ (*_NSGetEnviron())
+#else
+extern char **environ;
+#endif
+
+#ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+#endif
+
+#ifndef MSG_CMSG_CLOEXEC
+# define MSG_CMSG_CLOEXEC 0
+#endif
+
+/* The reply socket plus the stdio file descriptors. */
+#define UV__SPAWN_SERVER_MAX_FDS 64
+
+struct uv__spawn_server_msg {
+  unsigned int flags;
+  uv_uid_t uid;
+  uv_gid_t gid;
+  int stdio_count;
+  int nargs;
+  int nenv;
+  int has_cwd;
+  int nfds;
+  size_t len;  /* Size of the fd map and the strings that follow. */
+};
+
+struct uv__spawn_server_child {
+  pid_t pid;
+  int fd;
+};
+
+static uv_once_t spawn_server_once = UV_ONCE_INIT;
+static uv_mutex_t spawn_server_mutex;
+static int spawn_server_fd = -1;
+
+
+static void uv__spawn_server_init(void) {
+  if (uv_mutex_init(&spawn_server_mutex))
+    abort();
+}
+
+
+static int uv__spawn_server_write(int fd, const char* buf, size_t len) {
+  ssize_t n;
+
+  while (len > 0) {
+    do
+      n = send(fd, buf, len, MSG_NOSIGNAL);
+    while (n == -1 && errno == EINTR);
+
+    if (n == -1)
+      return UV__ERR(errno);
+
+    buf += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+
+static int uv__spawn_server_read(int fd, char* buf, size_t len) {
+  ssize_t n;
+
+  while (len > 0) {
+    do
+      n = read(fd, buf, len);
+    while (n == -1 && errno == EINTR);
+
+    if (n == -1)
+      return UV__ERR(errno);
+
+    if (n == 0)
+      return UV_EOF;
+
+    buf += n;
+    len -= n;
+  }
+
+  return 0;
+}
+
+
+static int uv__spawn_server_sendmsg(int fd,
+                                    const struct uv__spawn_server_msg* msg,
+                                    const int* fds,
+                                    int nfds) {
+  union {
+    char data[CMSG_SPACE(UV__SPAWN_SERVER_MAX_FDS * sizeof(int))];
+    struct cmsghdr alias;
+  } scratch;
+  struct cmsghdr* cmsg;
+  struct msghdr mh;
+  struct iovec iov;
+  ssize_t n;
+
+  iov.iov_base = (void*) msg;
+  iov.iov_len = sizeof(*msg);
+
+  memset(&mh, 0, sizeof(mh));
+  mh.msg_iov = &iov;
+  mh.msg_iovlen = 1;
+  mh.msg_control = &scratch.alias;
+  mh.msg_controllen = CMSG_SPACE(nfds * sizeof(int));
+
+  cmsg = CMSG_FIRSTHDR(&mh);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+  memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+
+  do
+    n = sendmsg(fd, &mh, MSG_NOSIGNAL);
+  while (n == -1 && errno == EINTR);
+
+  if (n == -1)
+    return UV__ERR(errno);
+
+  /* The file descriptors went with the first byte, send the rest. */
+  return uv__spawn_server_write(fd,
+                                (const char*) msg + n,
+                                sizeof(*msg) - n);
+}
+
+
+static size_t uv__spawn_server_strings_len(char** strings, int* count) {
+  size_t len;
+  int n;
+
+  len = 0;
+  for (n = 0; strings[n] != NULL; n++)
+    len += strlen(strings[n]) + 1;
+
+  *count = n;
+  return len;
+}
+
+
+static char* uv__spawn_server_put_strings(char* p, char** strings, int count) {
+  size_t len;
+  int n;
+
+  for (n = 0; n < count; n++) {
+    len = strlen(strings[n]) + 1;
+    memcpy(p, strings[n], len);
+    p += len;
+  }
+
+  return p;
+}
+
+
+/* Returns UV_ENOSYS when there's no server, or it can't take the request,
+ * so that uv_spawn() starts the child itself.
+ */
+int uv__spawn_server_spawn(const uv_process_options_t* options,
+                           int stdio_count,
+                           int (*pipes)[2],
+                           pid_t* pid,
+                           int* exec_errorno,
+                           int* exit_fd) {
+  struct uv__spawn_server_msg msg;
+  int fds[UV__SPAWN_SERVER_MAX_FDS];
+  char cwd[PATH_MAX];
+  size_t cwdlen;
+  char** env;
+  int* fdmap;
+  int reply[2];
+  int sv[2];
+  char* buf;
+  char* p;
+  int err;
+  int i;
+
+  uv_once(&spawn_server_once, uv__spawn_server_init);
+
+  /* Unlocked peek, the common case is that there is no server. */
+  if (spawn_server_fd == -1)
+    return UV_ENOSYS;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.flags = options->flags;
+  msg.uid = options->uid;
+  msg.gid = options->gid;
+  msg.stdio_count = stdio_count;
+  msg.nfds = 1;
+
+  for (i = 0; i < stdio_count; i++)
+    if (pipes[i][1] >= 0)
+      msg.nfds++;
+
+  if (msg.nfds > UV__SPAWN_SERVER_MAX_FDS)
+    return UV_ENOSYS;
+
+  /* The server was forked a while ago, send what the child would inherit
+   * from us now.
+   */
+  cwdlen = 0;
+  if (options->cwd != NULL) {
+    cwdlen = strlen(options->cwd) + 1;
+  } else {
+    cwdlen = sizeof(cwd);
+    if (uv_cwd(cwd, &cwdlen) == 0)
+      cwdlen++;
+    else
+      cwdlen = 0;
+  }
+
+  msg.has_cwd = cwdlen > 0;
+
+  env = options->env != NULL ? options->env : environ;
+  msg.len = stdio_count * sizeof(*fdmap) + strlen(options->file) + 1 + cwdlen;
+  msg.len += uv__spawn_server_strings_len(options->args, &msg.nargs);
+  msg.len += uv__spawn_server_strings_len(env, &msg.nenv);
+
+  buf = uv__malloc(msg.len);
+  if (buf == NULL)
+    return UV_ENOMEM;
+
+  /* Index into the file descriptors that are passed, -1 if there's none. */
+  fdmap = (int*) buf;
+  for (msg.nfds = 1, i = 0; i < stdio_count; i++) {
+    fdmap[i] = -1;
+    if (pipes[i][1] >= 0) {
+      fdmap[i] = msg.nfds;
+      fds[msg.nfds++] = pipes[i][1];
+    }
+  }
+
+  p = buf + stdio_count * sizeof(*fdmap);
+  memcpy(p, options->file, strlen(options->file) + 1);
+  p += strlen(options->file) + 1;
+  p = uv__spawn_server_put_strings(p, options->args, msg.nargs);
+  p = uv__spawn_server_put_strings(p, env, msg.nenv);
+  if (cwdlen > 0)
+    memcpy(p, options->cwd != NULL ? options->cwd : cwd, cwdlen);
+
+  err = uv_socketpair(SOCK_STREAM, 0, sv, 0, 0);
+  if (err) {
+    uv__free(buf);
+    return err;
+  }
+
+  fds[0] = sv[1];
+
+  uv_mutex_lock(&spawn_server_mutex);
+
+  err = UV_ENOSYS;
+  if (spawn_server_fd != -1) {
+    err = uv__spawn_server_sendmsg(spawn_server_fd, &msg, fds, msg.nfds);
+    if (err == 0)
+      err = uv__spawn_server_write(spawn_server_fd, buf, msg.len);
+
+    /* The server is gone. Stop using it, and spawn the child ourselves. */
+    if (err) {
+      uv__close(spawn_server_fd);
+      spawn_server_fd = -1;
+      err = UV_ENOSYS;
+    }
+  }
+
+  uv_mutex_unlock(&spawn_server_mutex);
+
+  uv__free(buf);
+  uv__close(sv[1]);
+
+  if (err == 0)
+    if (uv__spawn_server_read(sv[0], (char*) reply, sizeof(reply)))
+      err = UV_ENOSYS;
+
+  if (err) {
+    uv__close(sv[0]);
+    return err;
+  }
+
+  *pid = reply[0];
+  *exec_errorno = reply[1];
+
+  if (reply[1] != 0) {
+    uv__close(sv[0]);
+    return 0;
+  }
+
+  uv__nonblock(sv[0], 1);
+  *exit_fd = sv[0];
+
+  return 0;
+}
+
+
+#if !(defined(__APPLE__) && (TARGET_OS_TV || TARGET_OS_WATCH))
+/* Only used in the server process. */
+static int spawn_server_chld_fd = -1;
+
+
+static void uv__spawn_server_sigchld(int signum) {
+  int saved_errno;
+  ssize_t n;
+
+  saved_errno = errno;
+
+  do
+    n = write(spawn_server_chld_fd, "", 1);
+  while (n == -1 && errno == EINTR);
+
+  errno = saved_errno;
+}
+
+
+/* Runs in the server process. Receives one request and starts the child. */
+static int uv__spawn_server_serve(int fd,
+                                  struct uv__spawn_server_child** children,
+                                  size_t* nchildren,
+                                  size_t* capacity) {
+  union {
+    char data[CMSG_SPACE(UV__SPAWN_SERVER_MAX_FDS * sizeof(int))];
+    struct cmsghdr alias;
+  } scratch;
+  struct uv__spawn_server_child* tmp;
+  struct uv__spawn_server_msg msg;
+  uv_process_options_t options;
+  struct cmsghdr* cmsg;
+  struct msghdr mh;
+  struct iovec iov;
+  int fds[UV__SPAWN_SERVER_MAX_FDS];
+  int (*pipes)[2];
+  char** strings;
+  int exec_errorno;
+  int reply[2];
+  int* fdmap;
+  char* buf;
+  char* p;
+  pid_t pid;
+  ssize_t n;
+  int nfds;
+  int err;
+  int i;
+
+  iov.iov_base = &msg;
+  iov.iov_len = sizeof(msg);
+
+  memset(&mh, 0, sizeof(mh));
+  mh.msg_iov = &iov;
+  mh.msg_iovlen = 1;
+  mh.msg_control = &scratch.alias;
+  mh.msg_controllen = sizeof(scratch);
+
+  do
+    n = recvmsg(fd, &mh, MSG_CMSG_CLOEXEC);
+  while (n == -1 && errno == EINTR);
+
+  if (n <= 0)
+    return UV_EOF;
+
+  nfds = 0;
+  for (cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+    if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+      continue;
+
+    nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    memcpy(fds, CMSG_DATA(cmsg), nfds * sizeof(int));
+  }
+
+  for (i = 0; i < nfds; i++)
+    uv__cloexec(fds[i], 1);
+
+  err = uv__spawn_server_read(fd, (char*) &msg + n, sizeof(msg) - n);
+  if (err)
+    goto out;
+
+  err = UV_EPROTO;
+  if (nfds < 1 || nfds != msg.nfds)
+    goto out;
+
+  buf = uv__malloc(msg.len + 1);
+  strings = uv__malloc((msg.nargs + msg.nenv + 2) * sizeof(*strings));
+  pipes = uv__malloc(msg.stdio_count * sizeof(*pipes));
+
+  err = UV_ENOMEM;
+  if (buf == NULL || strings == NULL || pipes == NULL)
+    goto fail;
+
+  err = uv__spawn_server_read(fd, buf, msg.len);
+  if (err)
+    goto fail;
+
+  fdmap = (int*) buf;
+  for (i = 0; i < msg.stdio_count; i++) {
+    pipes[i][0] = -1;
+    pipes[i][1] = -1;
+    if (fdmap[i] > 0 && fdmap[i] < nfds)
+      pipes[i][1] = fds[fdmap[i]];
+  }
+
+  buf[msg.len] = '\0';
+  p = buf + msg.stdio_count * sizeof(*fdmap);
+
+  memset(&options, 0, sizeof(options));
+  options.flags = msg.flags;
+  options.uid = msg.uid;
+  options.gid = msg.gid;
+  options.file = p;
+  p += strlen(p) + 1;
+
+  options.args = strings;
+  for (i = 0; i < msg.nargs; i++, p += strlen(p) + 1)
+    strings[i] = p;
+  strings[i] = NULL;
+
+  options.env = strings + msg.nargs + 1;
+  for (i = 0; i < msg.nenv; i++, p += strlen(p) + 1)
+    options.env[i] = p;
+  options.env[i] = NULL;
+
+  if (msg.has_cwd)
+    options.cwd = p;
+
+  pid = 0;
+  exec_errorno = 0;
+  err = uv__spawn_and_init_child_fork(NULL,
+                                      &options,
+                                      msg.stdio_count,
+                                      pipes,
+                                      &pid,
+                                      &exec_errorno);
+  if (err)
+    exec_errorno = err;
+
+  if (exec_errorno == 0 && *nchildren == *capacity) {
+    tmp = uv__realloc(*children, (2 * *capacity + 16) * sizeof(**children));
+    if (tmp == NULL) {
+      /* The child runs, but its exit can't be tracked. */
+      kill(pid, SIGKILL);
+      exec_errorno = UV_ENOMEM;
+    } else {
+      *children = tmp;
+      *capacity = 2 * *capacity + 16;
+    }
+  }
+
+  reply[0] = pid;
+  reply[1] = exec_errorno;
+  uv__spawn_server_write(fds[0], (const char*) reply, sizeof(reply));
+
+  if (exec_errorno == 0) {
+    (*children)[*nchildren].pid = pid;
+    (*children)[*nchildren].fd = fds[0];
+    (*nchildren)++;
+    fds[0] = -1;
+  }
+
+  err = 0;
+
+fail:
+  uv__free(pipes);
+  uv__free(strings);
+  uv__free(buf);
+
+out:
+  /* Closing the reply socket without an answer makes the parent spawn the
+   * child itself. Any error here leaves the stream out of sync, so the caller
+   * hangs up after that.
+   */
+  for (i = 0; i < nfds; i++)
+    if (fds[i] != -1)
+      uv__close(fds[i]);
+
+  return err;
+}
+
+
+/* Runs in the server process. Passes on the wait status of each child. */
+static void uv__spawn_server_reap(struct uv__spawn_server_child* children,
+                                  size_t* nchildren) {
+  size_t i;
+  int status;
+  pid_t pid;
+
+  for (;;) {
+    do
+      pid = waitpid(-1, &status, WNOHANG);
+    while (pid == -1 && errno == EINTR);
+
+    if (pid <= 0)
+      return;
+
+    for (i = 0; i < *nchildren; i++)
+      if (children[i].pid == pid)
+        break;
+
+    if (i == *nchildren)
+      continue;
+
+    uv__spawn_server_write(children[i].fd, (const char*) &status,
+                           sizeof(status));
+    uv__close(children[i].fd);
+    children[i] = children[--*nchildren];
+  }
+}
+
+
+static void uv__spawn_server_close_fds(int keep) {
+  struct dirent* ent;
+  DIR* dir;
+  long max;
+  int fd;
+
+  dir = opendir("/dev/fd");
+  if (dir != NULL) {
+    while ((ent = readdir(dir)) != NULL) {
+      fd = atoi(ent->d_name);
+      if (fd > 2 && fd != keep && fd != dirfd(dir))
+        uv__close_nocheckstdio(fd);
+    }
+
+    closedir(dir);
+    return;
+  }
+
+  max = sysconf(_SC_OPEN_MAX);
+  if (max == -1 || max > INT_MAX)
+    max = INT_MAX;
+
+  for (fd = 3; fd < max; fd++)
+    if (fd != keep)
+      uv__close_nocheckstdio(fd);
+}
+
+
+static void uv__spawn_server_run(int fd) {
+  struct uv__spawn_server_child* children;
+  struct sigaction sa;
+  struct pollfd pfd[2];
+  size_t nchildren;
+  size_t capacity;
+  sigset_t sigset;
+  int chld_pipe[2];
+  char buf[64];
+  int r;
+
+  /* Forget the signal lock pipe before its descriptors are closed below.
+   * Otherwise, the atfork handler would close whatever later reuses those
+   * numbers in each child, such as the stdio the client sent us.
+   */
+  uv__signal_cleanup();
+  uv__spawn_server_close_fds(fd);
+
+  if (uv__make_pipe(chld_pipe, UV_NONBLOCK_PIPE))
+    _exit(127);
+
+  spawn_server_chld_fd = chld_pipe[1];
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = uv__spawn_server_sigchld;
+  sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+  sigemptyset(&sa.sa_mask);
+  if (sigaction(SIGCHLD, &sa, NULL))
+    _exit(127);
+
+  signal(SIGPIPE, SIG_IGN);
+
+  sigemptyset(&sigset);
+  if (sigprocmask(SIG_SETMASK, &sigset, NULL))
+    _exit(127);
+
+  children = NULL;
+  nchildren = 0;
+  capacity = 0;
+
+  /* Keep going after the parent hung up until all children have exited, so
+   * that their exit status still makes it to the parent's loop.
+   */
+  while (fd != -1 || nchildren > 0) {
+    pfd[0].fd = chld_pipe[0];
+    pfd[0].events = POLLIN;
+    pfd[0].revents = 0;
+    pfd[1].fd = fd;
+    pfd[1].events = POLLIN;
+    pfd[1].revents = 0;
+
+    r = poll(pfd, 2, -1);
+    if (r == -1 && errno == EINTR)
+      continue;
+
+    if (r == -1)
+      break;
+
+    if (pfd[0].revents != 0) {
+      while (read(chld_pipe[0], buf, sizeof(buf)) > 0);
+      uv__spawn_server_reap(children, &nchildren);
+    }
+
+    if (pfd[1].revents != 0)
+      if (uv__spawn_server_serve(fd, &children, &nchildren, &capacity)) {
+        uv__close(fd);
+        fd = -1;
+      }
+  }
+
+  _exit(0);
+}
+#endif
+
+
+int uv_spawn_server_start(void) {
+#if defined(__APPLE__) && (TARGET_OS_TV || TARGET_OS_WATCH)
+  /* fork is marked __WATCHOS_PROHIBITED __TVOS_PROHIBITED. */
+  return UV_ENOSYS;
+#else
+  int status;
+  pid_t pid;
+  int sv[2];
+  int err;
+
+  uv_once(&spawn_server_once, uv__spawn_server_init);
+  uv_mutex_lock(&spawn_server_mutex);
+
+  err = UV_EBUSY;
+  if (spawn_server_fd != -1)
+    goto out;
+
+  err = uv_socketpair(SOCK_STREAM, 0, sv, 0, 0);
+  if (err)
+    goto out;
+
+  /* Fork twice so that the server is not a child of ours. It outlives
+   * uv_spawn_server_stop() until its own children have exited, and it must
+   * not show up in anybody's waitpid().
+   */
+  pid = fork();
+  if (pid == 0) {
+    uv__close(sv[0]);
+    if (fork() == 0)
+      uv__spawn_server_run(sv[1]);
+    _exit(0);
+  }
+
+  if (pid == -1) {
+    err = UV__ERR(errno);
+    uv__close(sv[0]);
+    uv__close(sv[1]);
+    goto out;
+  }
+
+  uv__close(sv[1]);
+
+  do
+    err = waitpid(pid, &status, 0);
+  while (err == -1 && errno == EINTR);
+
+  spawn_server_fd = sv[0];
+  err = 0;
+
+out:
+  uv_mutex_unlock(&spawn_server_mutex);
+  return err;
+#endif
+}
+
+
+int uv_spawn_server_stop(void) {
+  int err;
+
+  uv_once(&spawn_server_once, uv__spawn_server_init);
+  uv_mutex_lock(&spawn_server_mutex);
+
+  err = UV_EINVAL;
+  if (spawn_server_fd != -1) {
+    uv__close(spawn_server_fd);
+    spawn_server_fd = -1;
+    err = 0;
+  }
+
+  uv_mutex_unlock(&spawn_server_mutex);
+  return err;
+}
@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_STREAM
+
 #include "uv.h"
 #include "internal.h"
 
@@ -60,12 +62,109 @@ struct uv__stream_select_s {
 };
 #endif /* defined(__APPLE__) */
 
+#if defined(__linux__)
+# include <sys/sendfile.h>
+# include <netinet/in.h>
+# include <linux/errqueue.h>
+# if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && \
+     defined(SO_EE_ORIGIN_ZEROCOPY)
+#  define UV__HAVE_ZEROCOPY 1
+# endif
+#endif
+
+/* Optional write settings of a stream, stored in stream->u.reserved[1].
+ *
+ * Zero-copy sends, see uv_tcp_zerocopy(). A write request that went out
+ * with MSG_ZEROCOPY records the send count in req->reserved[0] and its
+ * callback waits until the kernel reports that it's done with that send's
+ * pages.
+ *
+ * Write queue watermarks, see uv_stream_set_write_watermarks().
+ *
+ * The writable callback of uv_tcp_set_notsent_lowat(). It's armed by every
+ * write and runs once the write queue is empty and the socket polls
+ * writable again, which with TCP_NOTSENT_LOWAT means the kernel has sent
+ * all but |lowat| bytes. POLLOUT stays on while it's armed.
+ *
+ * The accept policy of a listener, see uv_stream_set_accept_policy().
+ *
+ * Receive timestamps, see uv_tcp_recv_timestamps(). With them on, reads
+ * use recvmsg() and keep the timestamp of the last one.
+ *
+ * The alloc callback of uv_read_start_vec().
+ */
+struct uv__stream_write_state {
+  size_t threshold;  /* 0 once turned off. */
+  unsigned int sent;  /* Zero-copy sends so far. */
+  unsigned int done;  /* Sends the kernel has released the buffers of. */
+  size_t low;
+  size_t high;  /* 0 when there are no watermarks. */
+  uv_write_watermark_cb watermark_cb;
+  int above;  /* Reported to be above high, waiting to drop to low. */
+  struct uv__write_copy* spare;  /* Kept for the next uv_write_copy(). */
+  uv_io_stats_t* stats;  /* uv_handle_set_io_stats(), reads count here too. */
+  size_t buffer;  /* uv_tty_set_write_buffer(), 0 when unbuffered. */
+  uv_tcp_writable_cb writable_cb;
+  int writable;  /* Armed, writable_cb is due once the queue drains. */
+  unsigned int max_lag;
+  unsigned int max_events;
+  int rx_timestamps;
+  int rx_timestamp_valid;  /* The last read came with one. */
+  uv_timespec_t rx_timestamp;
+  uv_alloc_vec_cb alloc_vec_cb;
+};
+
+/* Internal write request of uv_write_copy(). Small writes are appended to
+ * the last one in the write queue for as long as they fit.
+ */
+struct uv__write_copy {
+  uv_write_t req;
+  char data[UV__WRITE_COPY_MAX];
+};
+
 static void uv__stream_connect(uv_stream_t*);
 static void uv__write(uv_stream_t* stream);
-static void uv__read(uv_stream_t* stream);
-static void uv__stream_io(uv_loop_t* loop, uv__io_t* w, unsigned int events);
+static int uv__server_overloaded(uv_stream_t* stream);
+/* Per-stream read settings, see uv_stream_set_read_options(). Stored in
+ * stream->u.reserved[0], NULL if the stream uses the defaults.
+ */
+struct uv__stream_read_tuning {
+  size_t size;  /* Current suggested size. */
+  size_t min_size;
+  size_t max_size;
+  unsigned int max_reads;
+  size_t max_bytes;
+};
+
+/* File range of a uv_stream_sendfile() request, stored in req->reserved[2].
+ * The number of bytes that are left is kept in req->bufs[0].len, so the
+ * write queue accounting works as it does for other writes.
+ */
+struct uv__write_sendfile {
+  uv_file fd;
+  int64_t offset;
+};
+
+/* The descriptors of a uv_write_fds() request go out as a ready-made
+ * SCM_RIGHTS control message, stored in req->reserved[3] until the first
+ * part of the payload is sent.
+ */
+#if defined(__PASE__)
+/* on IBMi PASE the control message length can not exceed 256. */
+# define UV__CMSG_FD_COUNT 60
+#else
+# define UV__CMSG_FD_COUNT 64
+#endif
+#define UV__CMSG_FD_SIZE (UV__CMSG_FD_COUNT * sizeof(int))
+
+static void uv__read(uv_stream_t* stream, int hangup);
 static void uv__write_callbacks(uv_stream_t* stream);
 static size_t uv__write_req_size(uv_write_t* req);
+static void uv__splice_cancel(uv_stream_t* stream);
+static void uv__splice_detach(uv_stream_t* stream);
+static void uv__splice_pump(uv_splice_t* req);
+static int uv__stream_zerocopy_inflight(uv_stream_t* stream);
+static int uv__stream_is_seqpacket(const uv_stream_t* stream);
 
 
 void uv__stream_init(uv_loop_t* loop,
@@ -86,6 +185,10 @@ void uv__stream_init(uv_loop_t* loop,
   QUEUE_INIT(&stream->write_queue);
   QUEUE_INIT(&stream->write_completed_queue);
   stream->write_queue_size = 0;
+  stream->u.reserved[0] = NULL;
+  stream->u.reserved[1] = NULL;
+  stream->u.reserved[2] = NULL;
+  stream->u.reserved[3] = NULL;
 
   if (loop->emfile_fd == -1) {
     err = uv__open_cloexec("/dev/null", O_RDONLY);
@@ -453,6 +556,7 @@ void uv__stream_destroy(uv_stream_t* stream) {
 
   uv__stream_flush_write_queue(stream, UV_ECANCELED);
   uv__write_callbacks(stream);
+  uv__splice_cancel(stream);
 
   if (stream->shutdown_req) {
     /* The ECANCELED error code is a lie, the shutdown(2) syscall is a
@@ -511,54 +615,121 @@ static int uv__emfile_trick(uv_loop_t* loop, int accept_fd) {
 #endif /* defined(UV_HAVE_KQUEUE) */
 
 
+/* Hand out accepted connections. connection_cb normally calls uv_accept()
+ * once, which moves the next queued connection into accepted_fd, so keep
+ * calling it until the queue is drained or the user stops accepting.
+ */
+static int uv__server_hand_out(uv_loop_t* loop, uv_stream_t* stream) {
+  int fd;
+
+  while (stream->accepted_fd != -1) {
+    fd = stream->accepted_fd;
+    stream->connection_cb(stream, 0);
+
+    if (uv__stream_fd(stream) == -1)
+      return -1;
+
+    if (stream->accepted_fd == fd) {
+      /* The user hasn't yet accepted called uv_accept() */
+      uv__io_stop(loop, &stream->io_watcher, POLLIN);
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+
 void uv__server_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
   uv_stream_t* stream;
+  unsigned int batch;
+  unsigned int n;
+  int fd;
   int err;
 
   stream = container_of(w, uv_stream_t, io_watcher);
   assert(events & POLLIN);
-  assert(stream->accepted_fd == -1);
   assert(!(stream->flags & UV_HANDLE_CLOSING));
 
   uv__io_start(stream->loop, &stream->io_watcher, POLLIN);
 
+  /* With multishot accept the io_uring backend accepts the connections
+   * itself, and queues them before it reports the listener readable.
+   */
+  if (stream->accepted_fd != -1) {
+    uv__server_hand_out(loop, stream);
+    return;
+  }
+
+  /* Connections stay in the backlog while the loop is behind. The listener
+   * is still readable then, so it's looked at again next time around.
+   */
+  if (uv__server_overloaded(stream))
+    return;
+
+  batch = uv__get_internal_fields(loop)->accept_batch;
+  if (batch == 0)
+    batch = 1;
+
   /* connection_cb can close the server socket while we're
    * in the loop so check it on each iteration.
    */
   while (uv__stream_fd(stream) != -1) {
     assert(stream->accepted_fd == -1);
 
+    /* Accept up to `batch` connections before running any callbacks. The
+     * first one goes into accepted_fd, the rest are queued the same way
+     * IPC pipes queue received handles, and uv_accept() picks them up.
+     */
+    err = 0;
+    n = 0;
+    while (n < batch) {
 #if defined(UV_HAVE_KQUEUE)
-    if (w->rcount <= 0)
-      return;
+      if (w->rcount <= 0)
+        break;
 #endif /* defined(UV_HAVE_KQUEUE) */
 
-    err = uv__accept(uv__stream_fd(stream));
-    if (err < 0) {
-      if (err == UV_EAGAIN || err == UV__ERR(EWOULDBLOCK))
-        return;  /* Not an error. */
+      fd = uv__accept(uv__stream_fd(stream));
+      if (fd < 0) {
+        if (fd == UV_ECONNABORTED)
+          continue;  /* Ignore. Nothing we can do about that. */
 
-      if (err == UV_ECONNABORTED)
-        continue;  /* Ignore. Nothing we can do about that. */
+        err = fd;
+        break;
+      }
 
-      if (err == UV_EMFILE || err == UV_ENFILE) {
-        err = uv__emfile_trick(loop, uv__stream_fd(stream));
-        if (err == UV_EAGAIN || err == UV__ERR(EWOULDBLOCK))
+      UV_DEC_BACKLOG(w)
+      if (n++ == 0) {
+        stream->accepted_fd = fd;
+      } else {
+        err = uv__stream_queue_fd(stream, fd);
+        if (err) {
+          uv__close(fd);
           break;
+        }
       }
-
-      stream->connection_cb(stream, err);
-      continue;
     }
 
-    UV_DEC_BACKLOG(w)
-    stream->accepted_fd = err;
-    stream->connection_cb(stream, 0);
+    if (uv__server_hand_out(loop, stream))
+      return;
 
-    if (stream->accepted_fd != -1) {
-      /* The user hasn't yet accepted called uv_accept() */
-      uv__io_stop(loop, &stream->io_watcher, POLLIN);
+    if (err == UV_EAGAIN || err == UV__ERR(EWOULDBLOCK))
+      return;  /* Not an error. */
+
+#if defined(UV_HAVE_KQUEUE)
+    if (err == 0 && w->rcount <= 0)
       return;
+#endif /* defined(UV_HAVE_KQUEUE) */
+
+    if (err == UV_EMFILE || err == UV_ENFILE) {
+      err = uv__emfile_trick(loop, uv__stream_fd(stream));
+      if (err == UV_EAGAIN || err == UV__ERR(EWOULDBLOCK))
+        break;
+    }
+
+    if (err) {
+      stream->connection_cb(stream, err);
+      continue;
     }
 
     if (stream->type == UV_TCP &&
@@ -608,6 +779,12 @@ int uv_accept(uv_stream_t* server, uv_stream_t* client) {
   }
 
   client->flags |= UV_HANDLE_BOUND;
+  if (uv__stream_is_seqpacket(server) && client->type == UV_NAMED_PIPE)
+    client->flags |= UV_HANDLE_PIPE_SEQPACKET;
+
+  /* Sent by another process, which may still be listening on it. */
+  if (server->type == UV_NAMED_PIPE && client->type == UV_TCP)
+    client->flags |= UV_HANDLE_SHARED_TCP_SOCKET;
 
 done:
   /* Process queued fds */
@@ -619,6 +796,14 @@ done:
     /* Read first */
     server->accepted_fd = queued_fds->fds[0];
 
+    /* A listener that stopped accepting has its next connection handed out
+     * again once it's readable, see uv__server_io().
+     */
+    if (server->io_watcher.cb == uv__server_io &&
+        !uv__io_active(&server->io_watcher, POLLIN)) {
+      uv__io_start(server->loop, &server->io_watcher, POLLIN);
+    }
+
     /* All read, free */
     assert(queued_fds->offset > 0);
     if (--queued_fds->offset == 0) {
@@ -662,13 +847,61 @@ int uv_listen(uv_stream_t* stream, int backlog, uv_connection_cb cb) {
 }
 
 
+static int uv__write_armed(const uv_stream_t* stream) {
+  struct uv__stream_write_state* ws;
+
+  ws = stream->u.reserved[1];
+  return ws != NULL && ws->writable;
+}
+
+
+/* Arms the writable callback, if there is one. */
+static void uv__write_arm(uv_stream_t* stream) {
+  struct uv__stream_write_state* ws;
+
+  ws = stream->u.reserved[1];
+  if (ws == NULL || ws->writable_cb == NULL || ws->writable)
+    return;
+
+  if (stream->flags & UV_HANDLE_SHUT)
+    return;
+
+  ws->writable = 1;
+  uv__io_start(stream->loop, &stream->io_watcher, POLLOUT);
+  uv__stream_osx_interrupt_select(stream);
+}
+
+
+/* Runs the writable callback when POLLOUT came in with nothing to write. */
+static void uv__write_writable(uv_stream_t* stream) {
+  struct uv__stream_write_state* ws;
+
+  ws = stream->u.reserved[1];
+  if (ws == NULL || !ws->writable)
+    return;
+
+  if (uv__stream_fd(stream) == -1 || uv__is_closing(stream))
+    return;
+
+  if (!QUEUE_EMPTY(&stream->write_queue))
+    return;
+
+  ws->writable = 0;
+  uv__io_stop(stream->loop, &stream->io_watcher, POLLOUT);
+  uv__stream_osx_interrupt_select(stream);
+  ws->writable_cb((uv_tcp_t*) stream);
+}
+
+
 static void uv__drain(uv_stream_t* stream) {
   uv_shutdown_t* req;
   int err;
 
   assert(QUEUE_EMPTY(&stream->write_queue));
-  uv__io_stop(stream->loop, &stream->io_watcher, POLLOUT);
-  uv__stream_osx_interrupt_select(stream);
+  if (!uv__write_armed(stream)) {
+    uv__io_stop(stream->loop, &stream->io_watcher, POLLOUT);
+    uv__stream_osx_interrupt_select(stream);
+  }
 
   /* Shutdown? */
   if ((stream->flags & UV_HANDLE_SHUTTING) &&
@@ -702,6 +935,41 @@ static ssize_t uv__writev(int fd, struct iovec* vec, size_t n) {
 }
 
 
+/* Writes from a pipe opened with UV_PIPE_VMSPLICE of at least this size map
+ * the pages into the pipe instead of copying them.
+ */
+#define UV__VMSPLICE_MIN (64 * 1024)
+
+
+static ssize_t uv__stream_writev(uv_stream_t* stream,
+                                 struct iovec* iov,
+                                 int iovcnt) {
+  ssize_t n;
+
+#if defined(__linux__)
+  if (stream->type == UV_NAMED_PIPE &&
+      (stream->flags & UV_HANDLE_PIPE_VMSPLICE) &&
+      uv__count_bufs((const uv_buf_t*) iov, iovcnt) >= UV__VMSPLICE_MIN) {
+    do
+      n = vmsplice(uv__stream_fd(stream), iov, iovcnt, 0);
+    while (n == -1 && errno == EINTR);
+
+    if (n != -1 || (errno != EBADF && errno != EINVAL))
+      return n;
+
+    /* Not a pipe but a socket or a file, stop trying. */
+    stream->flags &= ~UV_HANDLE_PIPE_VMSPLICE;
+  }
+#endif
+
+  do
+    n = uv__writev(uv__stream_fd(stream), iov, iovcnt);
+  while (n == -1 && errno == EINTR);
+
+  return n;
+}
+
+
 static size_t uv__write_req_size(uv_write_t* req) {
   size_t size;
 
@@ -729,6 +997,12 @@ static int uv__write_req_update(uv_stream_t* stream,
   assert(n <= stream->write_queue_size);
   stream->write_queue_size -= n;
 
+  if (req->reserved[2] != NULL) {
+    ((struct uv__write_sendfile*) req->reserved[2])->offset += n;
+    req->bufs[0].len -= n;
+    return req->bufs[0].len == 0;
+  }
+
   buf = req->bufs + req->write_index;
 
   do {
@@ -759,8 +1033,12 @@ static void uv__write_req_finish(uv_write_t* req) {
    */
   if (req->error == 0) {
     if (req->bufs != req->bufsml)
-      uv__free(req->bufs);
+      uv__bufs_pool_put(stream->loop, req->bufs, req->nbufs);
     req->bufs = NULL;
+    uv__free(req->reserved[2]);
+    req->reserved[2] = NULL;
+    uv__free(req->reserved[3]);
+    req->reserved[3] = NULL;
   }
 
   /* Add it to the write_completed_queue where it will have its
@@ -785,10 +1063,10 @@ static int uv__handle_fd(uv_handle_t* handle) {
   }
 }
 
-static int uv__try_write(uv_stream_t* stream,
-                         const uv_buf_t bufs[],
-                         unsigned int nbufs,
-                         uv_stream_t* send_handle) {
+static int uv__try_write_cmsg(uv_stream_t* stream,
+                              const uv_buf_t bufs[],
+                              unsigned int nbufs,
+                              struct cmsghdr* cmsg) {
   struct iovec* iov;
   int iovmax;
   int iovcnt;
@@ -811,23 +1089,8 @@ static int uv__try_write(uv_stream_t* stream,
    * Now do the actual writev. Note that we've been updating the pointers
    * inside the iov each time we write. So there is no need to offset it.
    */
-  if (send_handle != NULL) {
-    int fd_to_send;
+  if (cmsg != NULL) {
     struct msghdr msg;
-    struct cmsghdr *cmsg;
-    union {
-      char data[64];
-      struct cmsghdr alias;
-    } scratch;
-
-    if (uv__is_closing(send_handle))
-      return UV_EBADF;
-
-    fd_to_send = uv__handle_fd((uv_handle_t*) send_handle);
-
-    memset(&scratch, 0, sizeof(scratch));
-
-    assert(fd_to_send >= 0);
 
     msg.msg_name = NULL;
     msg.msg_namelen = 0;
@@ -835,32 +1098,22 @@ static int uv__try_write(uv_stream_t* stream,
     msg.msg_iovlen = iovcnt;
     msg.msg_flags = 0;
 
-    msg.msg_control = &scratch.alias;
-    msg.msg_controllen = CMSG_SPACE(sizeof(fd_to_send));
-
-    cmsg = CMSG_FIRSTHDR(&msg);
-    cmsg->cmsg_level = SOL_SOCKET;
-    cmsg->cmsg_type = SCM_RIGHTS;
-    cmsg->cmsg_len = CMSG_LEN(sizeof(fd_to_send));
-
-    /* silence aliasing warning */
-    {
-      void* pv = CMSG_DATA(cmsg);
-      int* pi = pv;
-      *pi = fd_to_send;
-    }
+    msg.msg_control = cmsg;
+    msg.msg_controllen = CMSG_SPACE(cmsg->cmsg_len - CMSG_LEN(0));
 
     do
       n = sendmsg(uv__stream_fd(stream), &msg, 0);
     while (n == -1 && errno == EINTR);
   } else {
-    do
-      n = uv__writev(uv__stream_fd(stream), iov, iovcnt);
-    while (n == -1 && errno == EINTR);
+    n = uv__stream_writev(stream, iov, iovcnt);
   }
 
-  if (n >= 0)
+  uv__io_stats_write(uv__stream_io_stats(stream), n);
+
+  if (n >= 0) {
+    UV__TRACE2(stream__write, stream, n);
     return n;
+  }
 
   if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
     return UV_EAGAIN;
@@ -882,133 +1135,1107 @@ static int uv__try_write(uv_stream_t* stream,
   return UV__ERR(errno);
 }
 
-static void uv__write(uv_stream_t* stream) {
-  QUEUE* q;
-  uv_write_t* req;
-  ssize_t n;
 
-  assert(uv__stream_fd(stream) >= 0);
-
-  for (;;) {
-    if (QUEUE_EMPTY(&stream->write_queue))
-      return;
+static int uv__try_write(uv_stream_t* stream,
+                         const uv_buf_t bufs[],
+                         unsigned int nbufs,
+                         uv_stream_t* send_handle) {
+  int fd_to_send;
+  struct cmsghdr *cmsg;
+  union {
+    char data[64];
+    struct cmsghdr alias;
+  } scratch;
 
-    q = QUEUE_HEAD(&stream->write_queue);
-    req = QUEUE_DATA(q, uv_write_t, queue);
-    assert(req->handle == stream);
+  if (send_handle == NULL)
+    return uv__try_write_cmsg(stream, bufs, nbufs, NULL);
 
-    n = uv__try_write(stream,
-                      &(req->bufs[req->write_index]),
-                      req->nbufs - req->write_index,
-                      req->send_handle);
+  if (uv__is_closing(send_handle))
+    return UV_EBADF;
 
-    /* Ensure the handle isn't sent again in case this is a partial write. */
-    if (n >= 0) {
-      req->send_handle = NULL;
-      if (uv__write_req_update(stream, req, n)) {
-        uv__write_req_finish(req);
-        return;  /* TODO(bnoordhuis) Start trying to write the next request. */
-      }
-    } else if (n != UV_EAGAIN)
-      break;
+  fd_to_send = uv__handle_fd((uv_handle_t*) send_handle);
 
-    /* If this is a blocking stream, try again. */
-    if (stream->flags & UV_HANDLE_BLOCKING_WRITES)
-      continue;
+  memset(&scratch, 0, sizeof(scratch));
 
-    /* We're not done. */
-    uv__io_start(stream->loop, &stream->io_watcher, POLLOUT);
+  assert(fd_to_send >= 0);
 
-    /* Notify select() thread about state change */
-    uv__stream_osx_interrupt_select(stream);
+  cmsg = &scratch.alias;
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fd_to_send));
 
-    return;
+  /* silence aliasing warning */
+  {
+    void* pv = CMSG_DATA(cmsg);
+    int* pi = pv;
+    *pi = fd_to_send;
   }
 
-  req->error = n;
-  // XXX(jwn): this must call uv__stream_flush_write_queue(stream, n) here, since we won't generate any more events
-  uv__write_req_finish(req);
-  uv__io_stop(stream->loop, &stream->io_watcher, POLLOUT);
-  uv__stream_osx_interrupt_select(stream);
+  return uv__try_write_cmsg(stream, bufs, nbufs, cmsg);
 }
 
+static struct uv__stream_write_state* uv__stream_write_state(
+    uv_stream_t* stream) {
+  if (stream->u.reserved[1] == NULL)
+    stream->u.reserved[1] = uv__calloc(1, sizeof(struct uv__stream_write_state));
 
-static void uv__write_callbacks(uv_stream_t* stream) {
-  uv_write_t* req;
-  QUEUE* q;
-  QUEUE pq;
+  return stream->u.reserved[1];
+}
 
-  if (QUEUE_EMPTY(&stream->write_completed_queue))
+
+static void uv__stream_write_state_free(uv_stream_t* stream) {
+  struct uv__stream_write_state* ws;
+
+  ws = stream->u.reserved[1];
+  if (ws == NULL)
     return;
 
-  QUEUE_MOVE(&stream->write_completed_queue, &pq);
+  uv__free(ws->spare);
+  uv__free(ws->stats);
+  uv__free(ws);
+  stream->u.reserved[1] = NULL;
+}
 
-  while (!QUEUE_EMPTY(&pq)) {
-    /* Pop a req off write_completed_queue. */
-    q = QUEUE_HEAD(&pq);
-    req = QUEUE_DATA(q, uv_write_t, queue);
-    QUEUE_REMOVE(q);
-    uv__req_unregister(stream->loop, req);
 
-    if (req->bufs != NULL) {
-      stream->write_queue_size -= uv__write_req_size(req);
-      if (req->bufs != req->bufsml)
-        uv__free(req->bufs);
-      req->bufs = NULL;
-    }
+uv_alloc_vec_cb uv__stream_alloc_vec_cb(const uv_stream_t* stream) {
+  const struct uv__stream_write_state* ws;
 
-    /* NOTE: call callback AFTER freeing the request data. */
-    if (req->cb)
-      req->cb(req, req->error);
-  }
-}
+  ws = stream->u.reserved[1];
+  if (ws == NULL)
+    return NULL;
 
+  return ws->alloc_vec_cb;
+}
 
-uv_handle_type uv__handle_type(int fd) {
-  struct sockaddr_storage ss;
-  socklen_t sslen;
-  socklen_t len;
-  int type;
 
-  memset(&ss, 0, sizeof(ss));
-  sslen = sizeof(ss);
+int uv__stream_set_alloc_vec_cb(uv_stream_t* stream, uv_alloc_vec_cb alloc_cb) {
+  struct uv__stream_write_state* ws;
 
-  if (getsockname(fd, (struct sockaddr*)&ss, &sslen))
-    return UV_UNKNOWN_HANDLE;
+  ws = uv__stream_write_state(stream);
+  if (ws == NULL)
+    return UV_ENOMEM;
 
-  len = sizeof type;
+  ws->alloc_vec_cb = alloc_cb;
+  return 0;
+}
 
-  if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len))
-    return UV_UNKNOWN_HANDLE;
 
-  if (type == SOCK_STREAM) {
-#if defined(_AIX) || defined(__DragonFly__)
-    /* on AIX/DragonFly the getsockname call returns an empty sa structure
-     * for sockets of type AF_UNIX.  For all other types it will
-     * return a properly filled in structure.
-     */
-    if (sslen == 0)
-      return UV_NAMED_PIPE;
-#endif
-    switch (ss.ss_family) {
-      case AF_UNIX:
-        return UV_NAMED_PIPE;
-      case AF_INET:
-      case AF_INET6:
-        return UV_TCP;
-      }
-  }
+static size_t uv__stream_write_buffer(const uv_stream_t* stream) {
+  struct uv__stream_write_state* ws;
 
-  if (type == SOCK_DGRAM &&
-      (ss.ss_family == AF_INET || ss.ss_family == AF_INET6))
-    return UV_UDP;
+  ws = stream->u.reserved[1];
+  if (ws == NULL)
+    return 0;
 
-  return UV_UNKNOWN_HANDLE;
+  return ws->buffer;
 }
 
 
-static void uv__stream_eof(uv_stream_t* stream, const uv_buf_t* buf) {
-  stream->flags |= UV_HANDLE_READ_EOF;
+int uv__stream_set_write_buffer(uv_stream_t* stream, size_t size) {
+  struct uv__stream_write_state* ws;
+
+  if (size != 0) {
+    ws = uv__stream_write_state(stream);
+    if (ws == NULL)
+      return UV_ENOMEM;
+
+    ws->buffer = size;
+    return 0;
+  }
+
+  ws = stream->u.reserved[1];
+  if (ws == NULL || ws->buffer == 0)
+    return 0;
+
+  ws->buffer = 0;
+
+  /* Whatever is still held back goes out before unbuffered writes. */
+  if (!QUEUE_EMPTY(&stream->write_queue) &&
+      !(stream->flags & UV_HANDLE_CORKED) &&
+      !uv__io_active(&stream->io_watcher, POLLOUT))
+    uv__write(stream);
+
+  return 0;
+}
+
+
+uv_io_stats_t* uv__stream_io_stats(const uv_stream_t* stream) {
+  struct uv__stream_write_state* ws;
+
+  ws = stream->u.reserved[1];
+  if (ws == NULL)
+    return NULL;
+
+  return ws->stats;
+}
+
+
+/* See uv_handle_detach(). Requests that can't be moved to another loop, or
+ * whose callbacks are due on this one, make it fail with UV_EBUSY. The
+ * writes that are still queued go along.
+ */
+int uv__stream_detach(uv_stream_t* stream) {
+  QUEUE* q;
+
+  if (stream->connect_req != NULL ||
+      stream->shutdown_req != NULL ||
+      stream->accepted_fd != -1 ||
+      stream->queued_fds != NULL ||
+      stream->u.reserved[2] != NULL ||
+      stream->u.reserved[3] != NULL ||
+      !QUEUE_EMPTY(&stream->write_completed_queue) ||
+      !QUEUE_EMPTY(&stream->io_watcher.pending_queue) ||
+      uv__stream_zerocopy_inflight(stream) ||
+      uv__iou_buffered(stream->loop, uv__stream_fd(stream)))
+    return UV_EBUSY;
+
+#if defined(__APPLE__)
+  if (stream->select != NULL)
+    return UV_EBUSY;
+#endif
+
+  QUEUE_FOREACH(q, &stream->write_queue)
+    uv__req_unregister(stream->loop, QUEUE_DATA(q, uv_write_t, queue));
+
+  uv__io_detach(stream->loop, &stream->io_watcher);
+
+  return 0;
+}
+
+
+void uv__stream_attach(uv_stream_t* stream) {
+  QUEUE* q;
+
+  QUEUE_FOREACH(q, &stream->write_queue)
+    uv__req_register(stream->loop, QUEUE_DATA(q, uv_write_t, queue));
+
+  uv__io_attach(stream->loop, &stream->io_watcher);
+}
+
+
+int uv__stream_set_io_stats(uv_stream_t* stream, int enable) {
+  struct uv__stream_write_state* ws;
+
+  if (!enable) {
+    ws = stream->u.reserved[1];
+    if (ws != NULL) {
+      uv__free(ws->stats);
+      ws->stats = NULL;
+    }
+    return 0;
+  }
+
+  ws = uv__stream_write_state(stream);
+  if (ws == NULL)
+    return UV_ENOMEM;
+
+  if (ws->stats == NULL) {
+    ws->stats = uv__calloc(1, sizeof(*ws->stats));
+    if (ws->stats == NULL)
+      return UV_ENOMEM;
+  }
+
+  return 0;
+}
+
+
+static int uv__server_overloaded(uv_stream_t* stream) {
+  struct uv__stream_write_state* ws;
+  uv_loop_t* loop;
+
+  ws = stream->u.reserved[1];
+  if (ws == NULL)
+    return 0;
+
+  loop = stream->loop;
+  if (ws->max_events != 0 &&
+      uv__get_loop_metrics(loop)->poll_nevents > ws->max_events) {
+    return 1;
+  }
+
+  /* loop->time is from right after the poll. */
+  if (ws->max_lag != 0 && uv__loop_clock(loop) - loop->time > ws->max_lag)
+    return 1;
+
+  return 0;
+}
+
+
+int uv__stream_has_accept_policy(const uv_stream_t* stream) {
+  struct uv__stream_write_state* ws;
+
+  ws = stream->u.reserved[1];
+  return ws != NULL && (ws->max_lag != 0 || ws->max_events != 0);
+}
+
+
+int uv__stream_has_rx_timestamps(const uv_stream_t* stream) {
+  struct uv__stream_write_state* ws;
+
+  ws = stream->u.reserved[1];
+  return ws != NULL && ws->rx_timestamps;
+}
+
+
+int uv__stream_rx_timestamps(uv_stream_t* stream, int enable) {
+  struct uv__stream_write_state* ws;
+  int err;
+
+  err = uv__rx_timestamps(uv__stream_fd(stream), enable);
+  if (err)
+    return err;
+
+  ws = stream->u.reserved[1];
+  if (ws == NULL && !enable)
+    return 0;
+
+  ws = uv__stream_write_state(stream);
+  if (ws == NULL)
+    return UV_ENOMEM;
+
+  ws->rx_timestamps = !!enable;
+  ws->rx_timestamp_valid = 0;
+
+  /* Restarting the watcher swaps the io_uring backend's multishot recv,
+   * which doesn't carry control messages, for polling. What it received
+   * already is read first, without timestamps.
+   */
+  if (enable && uv__io_active(&stream->io_watcher, POLLIN)) {
+    uv__io_stop(stream->loop, &stream->io_watcher, POLLIN);
+    uv__io_start(stream->loop, &stream->io_watcher, POLLIN);
+  }
+
+  return 0;
+}
+
+
+int uv__stream_read_timestamp(const uv_stream_t* stream, uv_timespec_t* ts) {
+  struct uv__stream_write_state* ws;
+
+  ws = stream->u.reserved[1];
+  if (ws == NULL || !ws->rx_timestamps)
+    return UV_EINVAL;
+
+  if (!ws->rx_timestamp_valid)
+    return UV_ENOENT;
+
+  *ts = ws->rx_timestamp;
+  return 0;
+}
+
+
+int uv_stream_set_accept_policy(uv_stream_t* server,
+                                const uv_stream_accept_policy_t* policy) {
+  struct uv__stream_write_state* ws;
+
+  if (server->type != UV_TCP && server->type != UV_NAMED_PIPE)
+    return UV_EINVAL;
+
+  ws = server->u.reserved[1];
+  if (policy == NULL || (policy->max_lag == 0 && policy->max_events == 0)) {
+    if (ws != NULL) {
+      ws->max_lag = 0;
+      ws->max_events = 0;
+    }
+  } else {
+    ws = uv__stream_write_state(server);
+    if (ws == NULL)
+      return UV_ENOMEM;
+
+    ws->max_lag = policy->max_lag;
+    ws->max_events = policy->max_events;
+  }
+
+  /* Multishot accept doesn't wait for uv__server_io(), see linux-iouring.c. */
+  if (server->io_watcher.cb == uv__server_io &&
+      uv__io_active(&server->io_watcher, POLLIN)) {
+    uv__io_stop(server->loop, &server->io_watcher, POLLIN);
+    uv__io_start(server->loop, &server->io_watcher, POLLIN);
+  }
+
+  return 0;
+}
+
+
+static int uv__stream_zerocopy_inflight(uv_stream_t* stream) {
+  struct uv__stream_write_state* zc;
+
+  zc = stream->u.reserved[1];
+  return zc != NULL && zc->sent != zc->done;
+}
+
+
+/* Tells the owner when the write queue crosses one of its watermarks. */
+static void uv__write_watermark(uv_stream_t* stream) {
+  struct uv__stream_write_state* ws;
+
+  ws = stream->u.reserved[1];
+  if (ws == NULL || ws->high == 0 || uv__is_closing(stream))
+    return;
+
+  if (!ws->above && stream->write_queue_size >= ws->high) {
+    ws->above = 1;
+    ws->watermark_cb(stream, 1);
+  } else if (ws->above && stream->write_queue_size <= ws->low) {
+    ws->above = 0;
+    ws->watermark_cb(stream, 0);
+  }
+}
+
+
+int uv_stream_set_write_watermarks(uv_stream_t* stream,
+                                   size_t low,
+                                   size_t high,
+                                   uv_write_watermark_cb cb) {
+  struct uv__stream_write_state* ws;
+
+  if (high != 0 && (cb == NULL || low >= high))
+    return UV_EINVAL;
+
+  ws = stream->u.reserved[1];
+  if (high == 0) {
+    if (ws != NULL)
+      ws->high = 0;
+    return 0;
+  }
+
+  ws = uv__stream_write_state(stream);
+  if (ws == NULL)
+    return UV_ENOMEM;
+
+  ws->low = low;
+  ws->high = high;
+  ws->watermark_cb = cb;
+  ws->above = 0;
+
+  return 0;
+}
+
+
+int uv__stream_set_writable_cb(uv_stream_t* stream, uv_tcp_writable_cb cb) {
+  struct uv__stream_write_state* ws;
+
+  if (cb == NULL) {
+    ws = stream->u.reserved[1];
+    if (ws != NULL) {
+      ws->writable_cb = NULL;
+      ws->writable = 0;
+      if (QUEUE_EMPTY(&stream->write_queue) && stream->connect_req == NULL &&
+          !(stream->flags & UV_HANDLE_SHUTTING))
+        uv__io_stop(stream->loop, &stream->io_watcher, POLLOUT);
+    }
+    return 0;
+  }
+
+  ws = uv__stream_write_state(stream);
+  if (ws == NULL)
+    return UV_ENOMEM;
+
+  ws->writable_cb = cb;
+  uv__write_arm(stream);
+  return 0;
+}
+
+
+static int uv__write_zerocopy_pending(uv_stream_t* stream, uv_write_t* req) {
+  struct uv__stream_write_state* zc;
+  unsigned int seq;
+
+  if (req->reserved[1] == NULL || req->error != 0)
+    return 0;
+
+  /* Nothing more is coming in after close. */
+  if (uv__is_closing(stream))
+    return 0;
+
+  zc = stream->u.reserved[1];
+  seq = (unsigned int) (uintptr_t) req->reserved[0];
+  return (int) (zc->done - seq) < 0;
+}
+
+
+static int uv__try_write_zerocopy(uv_stream_t* stream,
+                                  uv_write_t* req,
+                                  struct uv__stream_write_state* zc) {
+#if defined(UV__HAVE_ZEROCOPY)
+  struct msghdr msg;
+  int iovmax;
+  ssize_t n;
+
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = (struct iovec*) &req->bufs[req->write_index];
+  msg.msg_iovlen = req->nbufs - req->write_index;
+
+  iovmax = uv__getiovmax();
+  if (msg.msg_iovlen > (size_t) iovmax)
+    msg.msg_iovlen = iovmax;
+
+  do
+    n = sendmsg(uv__stream_fd(stream), &msg, MSG_ZEROCOPY);
+  while (n == -1 && errno == EINTR);
+
+  uv__io_stats_write(zc->stats, n);
+
+  if (n >= 0) {
+    zc->sent++;
+    req->reserved[0] = (void*) (uintptr_t) zc->sent;
+    req->reserved[1] = zc;
+    /* Keep the fd in the poll set until the completion arrives. The
+     * notification itself shows up as POLLERR.
+     */
+    uv__io_start(stream->loop, &stream->io_watcher, UV__POLLPRI);
+    return n;
+  }
+
+  /* Out of option memory for the notifications, copy this one. */
+  if (errno != ENOBUFS) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return UV_EAGAIN;
+    return UV__ERR(errno);
+  }
+#endif  /* defined(UV__HAVE_ZEROCOPY) */
+
+  return uv__try_write(stream,
+                       &req->bufs[req->write_index],
+                       req->nbufs - req->write_index,
+                       NULL);
+}
+
+
+/* Reads the zero-copy completions off the socket's error queue. */
+static void uv__stream_zerocopy_done(uv_stream_t* stream) {
+#if defined(UV__HAVE_ZEROCOPY)
+  struct uv__stream_write_state* zc;
+  struct sock_extended_err* serr;
+  struct cmsghdr* cmsg;
+  struct msghdr msg;
+  union {
+    char data[256];
+    struct cmsghdr alias;
+  } control;
+  ssize_t r;
+
+  zc = stream->u.reserved[1];
+
+  for (;;) {
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = &control.alias;
+    msg.msg_controllen = sizeof(control);
+
+    do
+      r = recvmsg(uv__stream_fd(stream), &msg, MSG_ERRQUEUE);
+    while (r == -1 && errno == EINTR);
+
+    if (r == -1)
+      break;
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+          !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+        continue;
+
+      serr = (struct sock_extended_err*) CMSG_DATA(cmsg);
+      if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+        continue;
+
+      /* [ee_info, ee_data] is the inclusive range of completed sends. */
+      if ((int) (serr->ee_data + 1 - zc->done) > 0)
+        zc->done = serr->ee_data + 1;
+    }
+  }
+
+  if (zc->done == zc->sent)
+    uv__io_stop(stream->loop, &stream->io_watcher, UV__POLLPRI);
+#endif  /* defined(UV__HAVE_ZEROCOPY) */
+}
+
+
+int uv__stream_zerocopy(uv_stream_t* stream, size_t threshold) {
+#if defined(UV__HAVE_ZEROCOPY)
+  struct uv__stream_write_state* zc;
+  int on;
+
+  if (uv__stream_fd(stream) == -1)
+    return UV_EBADF;
+
+  zc = stream->u.reserved[1];
+  if (threshold == 0) {
+    if (zc != NULL)
+      zc->threshold = 0;  /* Keep counting the sends that are in flight. */
+    return 0;
+  }
+
+  on = 1;
+  if (setsockopt(uv__stream_fd(stream),
+                 SOL_SOCKET,
+                 SO_ZEROCOPY,
+                 &on,
+                 sizeof(on)))
+    return UV__ERR(errno);
+
+  zc = uv__stream_write_state(stream);
+  if (zc == NULL)
+    return UV_ENOMEM;
+
+  zc->threshold = threshold;
+  return 0;
+#else
+  return UV_ENOSYS;
+#endif  /* defined(UV__HAVE_ZEROCOPY) */
+}
+
+
+/* Each write is a message of its own on SOCK_SEQPACKET pipes, writes must not
+ * be merged.
+ */
+static int uv__stream_is_seqpacket(const uv_stream_t* stream) {
+  return stream->type == UV_NAMED_PIPE &&
+         (stream->flags & UV_HANDLE_PIPE_SEQPACKET);
+}
+
+
+/* Requests that can share a writev() with the requests around them. */
+static int uv__write_req_plain(uv_stream_t* stream, uv_write_t* req) {
+  struct uv__stream_write_state* zc;
+
+  if (uv__stream_is_seqpacket(stream))
+    return 0;
+
+  if (req->send_handle != NULL ||
+      req->reserved[2] != NULL ||
+      req->reserved[3] != NULL)
+    return 0;
+
+  zc = stream->u.reserved[1];
+  if (zc != NULL && zc->threshold != 0)
+    return uv__write_req_size(req) < zc->threshold;
+
+  return 1;
+}
+
+
+/* Writes the buffers of req and of the plain requests queued after it with
+ * a single writev() call. Stores the number of bytes it tried to write in
+ * *size.
+ */
+static ssize_t uv__write_gather(uv_stream_t* stream,
+                                uv_write_t* req,
+                                size_t* size) {
+  uv_buf_t bufs[64];
+  unsigned int nbufs;
+  unsigned int n;
+  unsigned int iovmax;
+  QUEUE* q;
+
+  iovmax = uv__getiovmax();
+  if (iovmax > ARRAY_SIZE(bufs))
+    iovmax = ARRAY_SIZE(bufs);
+
+  nbufs = 0;
+  q = &req->queue;
+
+  do {
+    req = QUEUE_DATA(q, uv_write_t, queue);
+    if (!uv__write_req_plain(stream, req))
+      break;
+
+    n = req->nbufs - req->write_index;
+    if (nbufs + n > iovmax) {
+      if (nbufs > 0)
+        break;
+      n = iovmax;  /* Only the first part of a very long request. */
+    }
+
+    memcpy(bufs + nbufs, req->bufs + req->write_index, n * sizeof(bufs[0]));
+    nbufs += n;
+    q = QUEUE_NEXT(q);
+  } while (q != &stream->write_queue && nbufs < iovmax);
+
+  *size = uv__count_bufs(bufs, nbufs);
+  return uv__try_write(stream, bufs, nbufs, NULL);
+}
+
+
+/* Hands the n bytes written by uv__write_gather() out to the requests. */
+static void uv__write_gather_update(uv_stream_t* stream, size_t n) {
+  uv_write_t* req;
+  size_t size;
+
+  for (;;) {
+    req = QUEUE_DATA(QUEUE_HEAD(&stream->write_queue), uv_write_t, queue);
+    size = uv__write_req_size(req);
+
+    if (n < size) {
+      uv__write_req_update(stream, req, n);
+      return;
+    }
+
+    uv__write_req_update(stream, req, size);
+    uv__write_req_finish(req);
+    n -= size;
+
+    if (n == 0)
+      return;
+  }
+}
+
+
+/* Sends the next part of a uv_stream_sendfile() request. */
+static ssize_t uv__try_sendfile(uv_stream_t* stream, uv_write_t* req) {
+  struct uv__write_sendfile* sf;
+  char buf[8192];
+  size_t len;
+  ssize_t n;
+#if defined(__linux__)
+  off_t off;
+#endif
+
+  sf = req->reserved[2];
+  len = req->bufs[0].len;
+  if (len == 0)
+    return 0;
+
+#if defined(__linux__)
+  off = sf->offset;
+  do
+    n = sendfile(uv__stream_fd(stream), sf->fd, &off, len);
+  while (n == -1 && errno == EINTR);
+
+  uv__io_stats_write(uv__stream_io_stats(stream), n);
+
+  if (n == 0)
+    return UV_EOF;  /* The file is shorter than the range. */
+
+  if (n > 0)
+    return n;
+
+  if (errno == EAGAIN || errno == EWOULDBLOCK)
+    return UV_EAGAIN;
+
+  /* Not every kind of file can be sent, copy those. */
+  if (errno != EINVAL && errno != ENOSYS)
+    return UV__ERR(errno);
+#endif  /* defined(__linux__) */
+
+  if (len > sizeof(buf))
+    len = sizeof(buf);
+
+  do
+    n = pread(sf->fd, buf, len, sf->offset);
+  while (n == -1 && errno == EINTR);
+
+  if (n == -1)
+    return UV__ERR(errno);
+
+  if (n == 0)
+    return UV_EOF;
+
+  /* What doesn't fit is read again next time. */
+  do
+    n = write(uv__stream_fd(stream), buf, n);
+  while (n == -1 && errno == EINTR);
+
+  uv__io_stats_write(uv__stream_io_stats(stream), n);
+
+  if (n == -1) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return UV_EAGAIN;
+    return UV__ERR(errno);
+  }
+
+  return n;
+}
+
+
+static void uv__write(uv_stream_t* stream) {
+  struct uv__stream_write_state* zc;
+  QUEUE* q;
+  uv_write_t* req;
+  size_t size;
+  ssize_t n;
+
+  assert(uv__stream_fd(stream) >= 0);
+
+  for (;;) {
+    if (QUEUE_EMPTY(&stream->write_queue))
+      return;
+
+    q = QUEUE_HEAD(&stream->write_queue);
+    req = QUEUE_DATA(q, uv_write_t, queue);
+    assert(req->handle == stream);
+
+    /* More than one request queued, try to write them all in one go. */
+    if (QUEUE_NEXT(q) != &stream->write_queue &&
+        uv__write_req_plain(stream, req)) {
+      n = uv__write_gather(stream, req, &size);
+      if (n >= 0) {
+        uv__write_gather_update(stream, n);
+        if ((size_t) n == size)
+          continue;
+      } else if (n != UV_EAGAIN) {
+        break;
+      }
+
+      if (stream->flags & UV_HANDLE_BLOCKING_WRITES)
+        continue;
+
+      uv__io_start(stream->loop, &stream->io_watcher, POLLOUT);
+      uv__stream_osx_interrupt_select(stream);
+      return;
+    }
+
+    zc = stream->u.reserved[1];
+    if (req->reserved[2] != NULL)
+      n = uv__try_sendfile(stream, req);
+    else if (req->reserved[3] != NULL)
+      n = uv__try_write_cmsg(stream,
+                             &(req->bufs[req->write_index]),
+                             req->nbufs - req->write_index,
+                             req->reserved[3]);
+    else if (zc != NULL &&
+        zc->threshold != 0 &&
+        req->send_handle == NULL &&
+        uv__write_req_size(req) >= zc->threshold)
+      n = uv__try_write_zerocopy(stream, req, zc);
+    else
+      n = uv__try_write(stream,
+                        &(req->bufs[req->write_index]),
+                        req->nbufs - req->write_index,
+                        req->send_handle);
+
+    /* Ensure the handle isn't sent again in case this is a partial write. */
+    if (n >= 0) {
+      req->send_handle = NULL;
+      uv__free(req->reserved[3]);
+      req->reserved[3] = NULL;
+      if (uv__write_req_update(stream, req, n)) {
+        uv__write_req_finish(req);
+        return;  /* TODO(bnoordhuis) Start trying to write the next request. */
+      }
+    } else if (n != UV_EAGAIN)
+      break;
+
+    /* If this is a blocking stream, try again. */
+    if (stream->flags & UV_HANDLE_BLOCKING_WRITES)
+      continue;
+
+    /* We're not done. */
+    uv__io_start(stream->loop, &stream->io_watcher, POLLOUT);
+
+    /* Notify select() thread about state change */
+    uv__stream_osx_interrupt_select(stream);
+
+    return;
+  }
+
+  req->error = n;
+  // XXX(jwn): this must call uv__stream_flush_write_queue(stream, n) here, since we won't generate any more events
+  uv__write_req_finish(req);
+  uv__io_stop(stream->loop, &stream->io_watcher, POLLOUT);
+  uv__stream_osx_interrupt_select(stream);
+}
+
+
+static void uv__write_callbacks(uv_stream_t* stream) {
+  uv_write_t* req;
+  QUEUE* q;
+  QUEUE pq;
+
+  if (QUEUE_EMPTY(&stream->write_completed_queue)) {
+    uv__write_watermark(stream);  /* Partial writes count, too. */
+    return;
+  }
+
+  QUEUE_MOVE(&stream->write_completed_queue, &pq);
+
+  while (!QUEUE_EMPTY(&pq)) {
+    /* Pop a req off write_completed_queue. */
+    q = QUEUE_HEAD(&pq);
+    req = QUEUE_DATA(q, uv_write_t, queue);
+
+    /* The kernel still uses the buffers. Put the rest back, in order, so the
+     * callbacks still run in the order the writes were made.
+     */
+    if (uv__write_zerocopy_pending(stream, req)) {
+      if (!QUEUE_EMPTY(&stream->write_completed_queue))
+        QUEUE_ADD(&pq, &stream->write_completed_queue);
+      QUEUE_MOVE(&pq, &stream->write_completed_queue);
+      break;
+    }
+
+    QUEUE_REMOVE(q);
+    uv__req_unregister(stream->loop, req);
+
+    if (req->bufs != NULL) {
+      stream->write_queue_size -= uv__write_req_size(req);
+      if (req->bufs != req->bufsml)
+        uv__bufs_pool_put(stream->loop, req->bufs, req->nbufs);
+      req->bufs = NULL;
+      uv__free(req->reserved[2]);
+      req->reserved[2] = NULL;
+      uv__free(req->reserved[3]);
+      req->reserved[3] = NULL;
+    }
+
+    /* NOTE: call callback AFTER freeing the request data. */
+    if (req->cb)
+      req->cb(req, req->error);
+  }
+
+  uv__write_watermark(stream);
+}
+
+
+/* Splicing moves data from one stream to another through a pipe without
+ * copying it to user space. The request is stored in src->u.reserved[2] and
+ * in dst->u.reserved[3] while it runs.
+ */
+#define UV__SPLICE_CHUNK (64 * 1024)
+
+
+static void uv__splice_unlink(uv_splice_t* req) {
+  if (req->src->u.reserved[2] == req)
+    req->src->u.reserved[2] = NULL;
+  if (req->dst->u.reserved[3] == req)
+    req->dst->u.reserved[3] = NULL;
+
+  /* Nobody else wants these events, src can't be read from while splicing. */
+  if (!uv__is_closing(req->src) && !(req->src->flags & UV_HANDLE_READING))
+    uv__io_stop(req->src->loop, &req->src->io_watcher, POLLIN);
+  if (!uv__is_closing(req->dst) && QUEUE_EMPTY(&req->dst->write_queue))
+    uv__io_stop(req->dst->loop, &req->dst->io_watcher, POLLOUT);
+
+  if (req->pipefd[0] != -1) {
+    uv__close(req->pipefd[0]);
+    uv__close(req->pipefd[1]);
+    req->pipefd[0] = -1;
+    req->pipefd[1] = -1;
+  }
+}
+
+
+static void uv__splice_finish(uv_splice_t* req, int status) {
+  uv__splice_unlink(req);
+  uv__req_unregister(req->src->loop, req);
+
+  if (req->cb != NULL)
+    req->cb(req, status);
+}
+
+
+/* Called when src is readable or dst is writable. */
+static void uv__splice_pump(uv_splice_t* req) {
+#if defined(__linux__)
+  uv_stream_t* src;
+  uv_stream_t* dst;
+  ssize_t n;
+  int count;
+
+  src = req->src;
+  dst = req->dst;
+
+  /* Same limit as uv__read(), don't starve the other handles. */
+  for (count = 32; count > 0; count--) {
+    /* Queued writes go first, they were made before the data in the pipe. */
+    while (req->pending > 0 && QUEUE_EMPTY(&dst->write_queue)) {
+      do
+        n = splice(req->pipefd[0],
+                   NULL,
+                   uv__stream_fd(dst),
+                   NULL,
+                   req->pending,
+                   SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+      while (n == -1 && errno == EINTR);
+
+      if (n == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+          break;
+        uv__splice_finish(req, UV__ERR(errno));
+        return;
+      }
+
+      req->pending -= n;
+      req->nbytes += n;
+    }
+
+    /* dst is full, stop reading from src until it has drained. */
+    if (req->pending > 0) {
+      uv__io_stop(src->loop, &src->io_watcher, POLLIN);
+      uv__io_start(dst->loop, &dst->io_watcher, POLLOUT);
+      return;
+    }
+
+    if (req->eof) {
+      uv__splice_finish(req, 0);
+      return;
+    }
+
+    do
+      n = splice(uv__stream_fd(src),
+                 NULL,
+                 req->pipefd[1],
+                 NULL,
+                 UV__SPLICE_CHUNK,
+                 SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    while (n == -1 && errno == EINTR);
+
+    if (n == -1) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        uv__splice_finish(req, UV__ERR(errno));
+        return;
+      }
+      break;
+    }
+
+    if (n == 0)
+      req->eof = 1;
+
+    req->pending += n;
+  }
+
+  if (count == 0)
+    uv__io_ready(src->loop, &src->io_watcher, POLLIN);
+
+  if (QUEUE_EMPTY(&dst->write_queue))
+    uv__io_stop(dst->loop, &dst->io_watcher, POLLOUT);
+  uv__io_start(src->loop, &src->io_watcher, POLLIN);
+#endif  /* defined(__linux__) */
+}
+
+
+/* The request can't go on once one of the streams closes. Its callback runs
+ * from uv__stream_destroy() with UV_ECANCELED, like the other requests.
+ */
+static void uv__splice_detach(uv_stream_t* stream) {
+  uv_splice_t* req;
+  int i;
+
+  for (i = 2; i < 4; i++) {
+    req = stream->u.reserved[i];
+    if (req == NULL)
+      continue;
+
+    uv__splice_unlink(req);
+    stream->u.reserved[i] = req;
+  }
+}
+
+
+static void uv__splice_cancel(uv_stream_t* stream) {
+  uv_splice_t* req;
+  int i;
+
+  for (i = 2; i < 4; i++) {
+    req = stream->u.reserved[i];
+    if (req == NULL)
+      continue;
+
+    stream->u.reserved[i] = NULL;
+    uv__req_unregister(stream->loop, req);
+
+    if (req->cb != NULL)
+      req->cb(req, UV_ECANCELED);
+  }
+}
+
+
+int uv_stream_splice(uv_splice_t* req,
+                     uv_stream_t* src,
+                     uv_stream_t* dst,
+                     uv_splice_cb cb) {
+#if defined(__linux__)
+  int err;
+
+  if (src == dst)
+    return UV_EINVAL;
+
+  if (uv__stream_fd(src) < 0 || uv__stream_fd(dst) < 0)
+    return UV_EBADF;
+
+  if (!(src->flags & UV_HANDLE_READABLE))
+    return UV_ENOTCONN;
+
+  if (!(dst->flags & UV_HANDLE_WRITABLE))
+    return UV_EPIPE;
+
+  if (src->flags & UV_HANDLE_READING)
+    return UV_EBUSY;
+
+  if (src->u.reserved[2] != NULL || dst->u.reserved[3] != NULL)
+    return UV_EBUSY;
+
+  /* splice() would skip what the io_uring backend has read already. */
+  if (uv__iou_buffered(src->loop, uv__stream_fd(src)))
+    return UV_EBUSY;
+
+  err = uv__make_pipe(req->pipefd, UV_NONBLOCK_PIPE);
+  if (err)
+    return err;
+
+  uv__req_init(src->loop, req, UV_SPLICE);
+  req->src = src;
+  req->dst = dst;
+  req->nbytes = 0;
+  req->cb = cb;
+  req->pending = 0;
+  req->eof = 0;
+
+  src->u.reserved[2] = req;
+  dst->u.reserved[3] = req;
+  uv__io_start(src->loop, &src->io_watcher, POLLIN);
+
+  return 0;
+#else
+  return UV_ENOSYS;
+#endif  /* defined(__linux__) */
+}
+
+
+uv_handle_type uv__handle_type(int fd) {
+  struct sockaddr_storage ss;
+  socklen_t sslen;
+  socklen_t len;
+  int type;
+
+  memset(&ss, 0, sizeof(ss));
+  sslen = sizeof(ss);
+
+  if (getsockname(fd, (struct sockaddr*)&ss, &sslen))
+    return UV_UNKNOWN_HANDLE;
+
+  len = sizeof type;
+
+  if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len))
+    return UV_UNKNOWN_HANDLE;
+
+  if (type == SOCK_STREAM) {
+#if defined(_AIX) || defined(__DragonFly__)
+    /* on AIX/DragonFly the getsockname call returns an empty sa structure
+     * for sockets of type AF_UNIX.  For all other types it will
+     * return a properly filled in structure.
+     */
+    if (sslen == 0)
+      return UV_NAMED_PIPE;
+#endif
+    switch (ss.ss_family) {
+      case AF_UNIX:
+        return UV_NAMED_PIPE;
+      case AF_INET:
+      case AF_INET6:
+        return UV_TCP;
+      }
+  }
+
+  if (type == SOCK_DGRAM &&
+      (ss.ss_family == AF_INET || ss.ss_family == AF_INET6))
+    return UV_UDP;
+
+  return UV_UNKNOWN_HANDLE;
+}
+
+
+static void uv__stream_eof(uv_stream_t* stream, const uv_buf_t* buf) {
+  stream->flags |= UV_HANDLE_READ_EOF;
   stream->flags &= ~UV_HANDLE_READING;
   uv__io_stop(stream->loop, &stream->io_watcher, POLLIN);
   uv__handle_stop(stream);
@@ -1017,7 +2244,7 @@ static void uv__stream_eof(uv_stream_t* stream, const uv_buf_t* buf) {
 }
 
 
-static int uv__stream_queue_fd(uv_stream_t* stream, int fd) {
+int uv__stream_queue_fd(uv_stream_t* stream, int fd) {
   uv__stream_queued_fds_t* queued_fds;
   unsigned int queue_size;
 
@@ -1056,15 +2283,6 @@ static int uv__stream_queue_fd(uv_stream_t* stream, int fd) {
 }
 
 
-#if defined(__PASE__)
-/* on IBMi PASE the control message length can not exceed 256. */
-# define UV__CMSG_FD_COUNT 60
-#else
-# define UV__CMSG_FD_COUNT 64
-#endif
-#define UV__CMSG_FD_SIZE (UV__CMSG_FD_COUNT * sizeof(int))
-
-
 static int uv__stream_recv_cmsg(uv_stream_t* stream, struct msghdr* msg) {
   struct cmsghdr* cmsg;
 
@@ -1121,21 +2339,57 @@ static int uv__stream_recv_cmsg(uv_stream_t* stream, struct msghdr* msg) {
 # pragma clang diagnostic ignored "-Wvla-extension"
 #endif
 
-static void uv__read(uv_stream_t* stream) {
-  uv_buf_t buf;
+/* Grow the suggested size when reads fill the buffer, shrink it when they
+ * use less than a quarter of it.
+ */
+static void uv__read_adapt(struct uv__stream_read_tuning* tuning,
+                           size_t nread,
+                           size_t suggested) {
+  if (nread >= suggested) {
+    tuning->size = suggested * 2;
+    if (tuning->size > tuning->max_size || tuning->size < suggested)
+      tuning->size = tuning->max_size;
+  } else if (nread < suggested / 4) {
+    tuning->size = suggested / 2;
+    if (tuning->size < tuning->min_size)
+      tuning->size = tuning->min_size;
+  }
+}
+
+
+static void uv__read(uv_stream_t* stream, int hangup) {
+  struct uv__stream_read_tuning* tuning;
+  struct uv__stream_write_state* ws;
+  uv_buf_t bufs[UV__READ_VEC_MAX];
+  unsigned int nbufs;
   ssize_t nread;
   struct msghdr msg;
   char cmsg_space[CMSG_SPACE(UV__CMSG_FD_SIZE)];
+  size_t suggested;
+  size_t max_bytes;
+  size_t total;
   int count;
   int err;
   int is_ipc;
+  int use_msg;
+  int timestamps;
+  int done;
 
   stream->flags &= ~UV_HANDLE_READ_PARTIAL;
 
   /* Prevent loop starvation when the data comes in as fast as (or faster than)
-   * we can read it. XXX Need to rearm fd if we switch to edge-triggered I/O.
+   * we can read it. Edge-triggered watchers are rearmed with uv__io_ready()
+   * when we stop before EAGAIN.
    */
   count = 32;
+  max_bytes = 0;
+  total = 0;
+
+  tuning = stream->u.reserved[0];
+  if (tuning != NULL) {
+    count = tuning->max_reads;
+    max_bytes = tuning->max_bytes;
+  }
 
   is_ipc = stream->type == UV_NAMED_PIPE && ((uv_pipe_t*) stream)->ipc;
 
@@ -1147,27 +2401,50 @@ static void uv__read(uv_stream_t* stream) {
       && (count-- > 0)) {
     assert(stream->alloc_cb != NULL);
 
-    buf = uv_buf_init(NULL, 0);
-    stream->alloc_cb((uv_handle_t*)stream, 64 * 1024, &buf);
-    if (buf.base == NULL || buf.len == 0) {
+    /* Can change from inside read_cb. */
+    tuning = stream->u.reserved[0];
+    suggested = 64 * 1024;
+    if (tuning != NULL)
+      suggested = tuning->size;
+
+    nbufs = uv__read_alloc(stream, suggested, bufs, ARRAY_SIZE(bufs));
+    if (nbufs == 0) {
       /* User indicates it can't or won't handle the read. */
-      stream->read_cb(stream, UV_ENOBUFS, &buf);
+      stream->read_cb(stream, UV_ENOBUFS, bufs);
+      uv__io_ready(stream->loop, &stream->io_watcher, POLLIN);
       return;
     }
 
-    assert(buf.base != NULL);
+    assert(bufs[0].base != NULL);
     assert(uv__stream_fd(stream) >= 0);
 
-    if (!is_ipc) {
+    /* Timestamps come as a control message. Data that the io_uring backend
+     * received already goes out first, without.
+     */
+    ws = stream->u.reserved[1];
+    timestamps = ws != NULL && ws->rx_timestamps;
+    if (timestamps)
+      ws->rx_timestamp_valid = 0;
+    use_msg = is_ipc;
+    if (timestamps && !uv__iou_buffered(stream->loop, uv__stream_fd(stream)))
+      use_msg = 1;
+
+    if (!use_msg) {
+      /* Comes out of the io_uring backend's buffers when it received the
+       * data already.
+       */
       do {
-        nread = read(uv__stream_fd(stream), buf.base, buf.len);
+        nread = uv__iou_readv(stream->loop,
+                              uv__stream_fd(stream),
+                              (struct iovec*) bufs,
+                              nbufs);
       }
       while (nread < 0 && errno == EINTR);
     } else {
-      /* ipc uses recvmsg */
+      /* ipc and timestamps use recvmsg */
       msg.msg_flags = 0;
-      msg.msg_iov = (struct iovec*) &buf;
-      msg.msg_iovlen = 1;
+      msg.msg_iov = (struct iovec*) bufs;
+      msg.msg_iovlen = nbufs;
       msg.msg_name = NULL;
       msg.msg_namelen = 0;
       /* Set up to receive a descriptor even if one isn't in the message */
@@ -1180,6 +2457,14 @@ static void uv__read(uv_stream_t* stream) {
       while (nread < 0 && errno == EINTR);
     }
 
+    uv__io_stats_read(uv__stream_io_stats(stream), nread);
+
+    /* Pooled buffers only go out with data in them. */
+    if (nread <= 0 && stream->alloc_cb == uv__read_pool_alloc) {
+      uv__read_pool_put(stream->loop, bufs[0].base);
+      bufs[0] = uv_buf_init(NULL, 0);
+    }
+
     if (nread < 0) {
       /* Error */
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
@@ -1188,16 +2473,16 @@ static void uv__read(uv_stream_t* stream) {
           uv__io_start(stream->loop, &stream->io_watcher, POLLIN);
           uv__stream_osx_interrupt_select(stream);
         }
-        stream->read_cb(stream, 0, &buf);
+        stream->read_cb(stream, 0, bufs);
 #if defined(__CYGWIN__) || defined(__MSYS__)
       } else if (errno == ECONNRESET && stream->type == UV_NAMED_PIPE) {
-        uv__stream_eof(stream, &buf);
+        uv__stream_eof(stream, bufs);
         return;
 #endif
       } else {
         /* Error. User should call uv_close(). */
         stream->flags &= ~(UV_HANDLE_READABLE | UV_HANDLE_WRITABLE);
-        stream->read_cb(stream, UV__ERR(errno), &buf);
+        stream->read_cb(stream, UV__ERR(errno), bufs);
         if (stream->flags & UV_HANDLE_READING) {
           stream->flags &= ~UV_HANDLE_READING;
           uv__io_stop(stream->loop, &stream->io_watcher, POLLIN);
@@ -1207,18 +2492,20 @@ static void uv__read(uv_stream_t* stream) {
       }
       return;
     } else if (nread == 0) {
-      uv__stream_eof(stream, &buf);
+      uv__stream_eof(stream, bufs);
       return;
     } else {
       /* Successful read */
-      ssize_t buflen = buf.len;
+      ssize_t buflen = uv__count_bufs(bufs, nbufs);
 
       if (is_ipc) {
         err = uv__stream_recv_cmsg(stream, &msg);
         if (err != 0) {
-          stream->read_cb(stream, err, &buf);
+          stream->read_cb(stream, err, bufs);
           return;
         }
+      } else if (timestamps && use_msg) {
+        ws->rx_timestamp_valid = uv__rx_timestamp(&msg, &ws->rx_timestamp) == 0;
       }
 
 #if defined(__MVS__)
@@ -1236,7 +2523,7 @@ static void uv__read(uv_stream_t* stream) {
           nread = uv__recvmsg(uv__stream_fd(stream), &msg, 0);
           err = uv__stream_recv_cmsg(stream, &msg);
           if (err != 0) {
-            stream->read_cb(stream, err, &buf);
+            stream->read_cb(stream, err, bufs);
             msg.msg_iov = old;
             return;
           }
@@ -1244,15 +2531,34 @@ static void uv__read(uv_stream_t* stream) {
         msg.msg_iov = old;
       }
 #endif
-      stream->read_cb(stream, nread, &buf);
-
-      /* Return if we didn't fill the buffer, there is no more data to read. */
-      if (nread < buflen) {
+      /* |tuning| may be gone after read_cb. */
+      if (tuning != NULL)
+        uv__read_adapt(tuning, nread, suggested);
+
+      total += nread;
+      done = max_bytes != 0 && total >= max_bytes;
+
+      UV__TRACE2(stream__read, stream, nread);
+      stream->read_cb(stream, nread, bufs);
+
+      /* Return if we didn't fill the buffer, there is no more data to read.
+       * Unless the peer hung up: edge-triggered watchers aren't told again
+       * about the EOF that came in with the data. On SOCK_SEQPACKET sockets
+       * a short read only means the message was short.
+       */
+      if (nread < buflen && !uv__stream_is_seqpacket(stream)) {
         stream->flags |= UV_HANDLE_READ_PARTIAL;
-        return;
+        if (!hangup)
+          return;
       }
+
+      /* Leave the rest for the next loop iteration. */
+      if (done)
+        break;
     }
   }
+
+  uv__io_ready(stream->loop, &stream->io_watcher, POLLIN);
 }
 
 
@@ -1260,10 +2566,6 @@ static void uv__read(uv_stream_t* stream) {
 # pragma clang diagnostic pop
 #endif
 
-#undef UV__CMSG_FD_COUNT
-#undef UV__CMSG_FD_SIZE
-
-
 int uv_shutdown(uv_shutdown_t* req, uv_stream_t* stream, uv_shutdown_cb cb) {
   assert(stream->type == UV_TCP ||
          stream->type == UV_TTY ||
@@ -1293,8 +2595,9 @@ int uv_shutdown(uv_shutdown_t* req, uv_stream_t* stream, uv_shutdown_cb cb) {
 }
 
 
-static void uv__stream_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
+void uv__stream_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
   uv_stream_t* stream;
+  int idle;
 
   stream = container_of(w, uv_stream_t, io_watcher);
 
@@ -1310,9 +2613,19 @@ static void uv__stream_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
 
   assert(uv__stream_fd(stream) >= 0);
 
+  /* Zero-copy completions, the write callbacks are run below. */
+  if ((events & POLLERR) && uv__stream_zerocopy_inflight(stream))
+    uv__stream_zerocopy_done(stream);
+
+  if ((events & (POLLIN | POLLERR | POLLHUP)) && stream->u.reserved[2] != NULL) {
+    uv__splice_pump(stream->u.reserved[2]);
+    if (uv__stream_fd(stream) == -1)
+      return;  /* splice_cb closed stream. */
+  }
+
   /* Ignore POLLHUP here. Even if it's set, there may still be data to read. */
   if (events & (POLLIN | POLLERR | POLLHUP))
-    uv__read(stream);
+    uv__read(stream, (events & UV__POLLRDHUP) != 0);
 
   if (uv__stream_fd(stream) == -1)
     return;  /* read_cb closed stream. */
@@ -1335,12 +2648,24 @@ static void uv__stream_io(uv_loop_t* loop, uv__io_t* w, unsigned int events) {
     return;  /* read_cb closed stream. */
 
   if (events & (POLLOUT | POLLERR | POLLHUP)) {
+    /* Only a POLLOUT that finds the queue already empty says anything
+     * about the kernel's send buffer, the writes that just went out may
+     * have filled it again.
+     */
+    idle = (events & POLLOUT) && QUEUE_EMPTY(&stream->write_queue);
+
     uv__write(stream);
     uv__write_callbacks(stream);
 
     /* Write queue drained. */
     if (QUEUE_EMPTY(&stream->write_queue))
       uv__drain(stream);
+
+    if (idle)
+      uv__write_writable(stream);
+
+    if (stream->u.reserved[3] != NULL && !uv__is_closing(stream))
+      uv__splice_pump(stream->u.reserved[3]);
   }
 }
 
@@ -1382,9 +2707,12 @@ static void uv__stream_connect(uv_stream_t* stream) {
   stream->connect_req = NULL;
   uv__req_unregister(stream->loop, req);
 
-  if (error < 0 || QUEUE_EMPTY(&stream->write_queue)) {
+  /* The queued writes go out on the next POLLOUT. */
+  if (error < 0 || (QUEUE_EMPTY(&stream->write_queue) &&
+                    !uv__write_armed(stream)))
     uv__io_stop(stream->loop, &stream->io_watcher, POLLOUT);
-  }
+  else
+    uv__io_ready(stream->loop, &stream->io_watcher, POLLOUT);
 
   if (req->cb)
     req->cb(req, error);
@@ -1437,18 +2765,65 @@ static int uv__check_before_write(uv_stream_t* stream,
   return 0;
 }
 
-int uv_write2(uv_write_t* req,
-              uv_stream_t* stream,
-              const uv_buf_t bufs[],
-              unsigned int nbufs,
-              uv_stream_t* send_handle,
-              uv_write_cb cb) {
-  int empty_queue;
-  int err;
 
-  err = uv__check_before_write(stream, nbufs, send_handle);
-  if (err < 0)
-    return err;
+/* Writes to a buffered stream go out together with the rest of the loop
+ * iteration's output when the pending watchers run, see uv__run_pending(),
+ * or right away once more than the buffer holds is queued.
+ */
+static void uv__write_buffered(uv_stream_t* stream) {
+  if (stream->write_queue_size >= uv__stream_write_buffer(stream))
+    uv__write(stream);
+  else
+    uv__io_feed(stream->loop, &stream->io_watcher);
+}
+
+
+static void uv__write_queue(uv_stream_t* stream,
+                            uv_write_t* req,
+                            int empty_queue) {
+  /* Append the request to write_queue. */
+  QUEUE_INSERT_TAIL(&stream->write_queue, &req->queue);
+
+  /* If the queue was empty when this function began, we should attempt to
+   * do the write immediately. Otherwise start the write_watcher and wait
+   * for the fd to become writable.
+   */
+  if (stream->connect_req) {
+    /* Still connecting, do nothing. */
+  }
+  else if (stream->flags & UV_HANDLE_CORKED) {
+    /* Held back until uv_stream_uncork(). */
+  }
+  else if (uv__stream_write_buffer(stream) != 0) {
+    uv__write_buffered(stream);
+  }
+  else if (empty_queue) {
+    uv__write(stream);
+  }
+  else {
+    /*
+     * blocking streams should never have anything in the queue.
+     * if this assert fires then somehow the blocking stream isn't being
+     * sufficiently flushed in uv__write.
+     */
+    assert(!(stream->flags & UV_HANDLE_BLOCKING_WRITES));
+    uv__io_start(stream->loop, &stream->io_watcher, POLLOUT);
+    uv__stream_osx_interrupt_select(stream);
+  }
+
+  uv__write_arm(stream);
+  uv__write_watermark(stream);
+}
+
+
+static int uv__write2(uv_write_t* req,
+                      uv_stream_t* stream,
+                      const uv_buf_t bufs[],
+                      unsigned int nbufs,
+                      uv_stream_t* send_handle,
+                      struct cmsghdr* cmsg,
+                      uv_write_cb cb) {
+  int empty_queue;
 
   /* It's legal for write_queue_size > 0 even when the write_queue is empty;
    * it means there are error-state requests in the write_completed_queue that
@@ -1464,11 +2839,15 @@ int uv_write2(uv_write_t* req,
   req->handle = stream;
   req->error = 0;
   req->send_handle = send_handle;
+  req->reserved[0] = NULL;
+  req->reserved[1] = NULL;
+  req->reserved[2] = NULL;
+  req->reserved[3] = cmsg;
   QUEUE_INIT(&req->queue);
 
   req->bufs = req->bufsml;
   if (nbufs > ARRAY_SIZE(req->bufsml))
-    req->bufs = uv__malloc(nbufs * sizeof(bufs[0]));
+    req->bufs = uv__bufs_pool_get(stream->loop, nbufs);
 
   if (req->bufs == NULL)
     return UV_ENOMEM;
@@ -1478,31 +2857,103 @@ int uv_write2(uv_write_t* req,
   req->write_index = 0;
   stream->write_queue_size += uv__count_bufs(bufs, nbufs);
 
-  /* Append the request to write_queue. */
-  QUEUE_INSERT_TAIL(&stream->write_queue, &req->queue);
+  uv__write_queue(stream, req, empty_queue);
+  return 0;
+}
 
-  /* If the queue was empty when this function began, we should attempt to
-   * do the write immediately. Otherwise start the write_watcher and wait
-   * for the fd to become writable.
-   */
-  if (stream->connect_req) {
-    /* Still connecting, do nothing. */
-  }
-  else if (empty_queue) {
-    uv__write(stream);
-  }
-  else {
-    /*
-     * blocking streams should never have anything in the queue.
-     * if this assert fires then somehow the blocking stream isn't being
-     * sufficiently flushed in uv__write.
-     */
-    assert(!(stream->flags & UV_HANDLE_BLOCKING_WRITES));
-    uv__io_start(stream->loop, &stream->io_watcher, POLLOUT);
-    uv__stream_osx_interrupt_select(stream);
+
+/* The socket of a TCP handle sent to another process can end up with a
+ * listener there too. The io_uring backend then polls for connections instead
+ * of taking them all with a multishot accept, so restart the watcher.
+ */
+static void uv__stream_share(uv_stream_t* send_handle) {
+  if (send_handle->type != UV_TCP)
+    return;
+
+  send_handle->flags |= UV_HANDLE_SHARED_TCP_SOCKET;
+
+  if (send_handle->io_watcher.cb == uv__server_io &&
+      uv__io_active(&send_handle->io_watcher, POLLIN)) {
+    uv__io_stop(send_handle->loop, &send_handle->io_watcher, POLLIN);
+    uv__io_start(send_handle->loop, &send_handle->io_watcher, POLLIN);
   }
+}
 
-  return 0;
+
+int uv_write2(uv_write_t* req,
+              uv_stream_t* stream,
+              const uv_buf_t bufs[],
+              unsigned int nbufs,
+              uv_stream_t* send_handle,
+              uv_write_cb cb) {
+  int err;
+
+  err = uv__check_before_write(stream, nbufs, send_handle);
+  if (err < 0)
+    return err;
+
+  if (send_handle != NULL)
+    uv__stream_share(send_handle);
+
+  return uv__write2(req, stream, bufs, nbufs, send_handle, NULL, cb);
+}
+
+
+int uv_write_fds(uv_write_t* req,
+                 uv_stream_t* stream,
+                 const uv_buf_t bufs[],
+                 unsigned int nbufs,
+                 const uv_os_fd_t fds[],
+                 unsigned int nfds,
+                 uv_write_cb cb) {
+  struct cmsghdr* cmsg;
+  unsigned int i;
+  void* pv;
+  int* pi;
+  int err;
+
+  if (nfds == 0 || nfds > UV__CMSG_FD_COUNT)
+    return UV_EINVAL;
+
+  if (stream->type != UV_NAMED_PIPE || !((uv_pipe_t*) stream)->ipc)
+    return UV_EINVAL;
+
+  /* The descriptors ride along with the payload, there has to be some. */
+  if (nbufs == 0 || uv__count_bufs(bufs, nbufs) == 0)
+    return UV_EINVAL;
+
+  for (i = 0; i < nfds; i++)
+    if (fds[i] < 0)
+      return UV_EBADF;
+
+#if defined(__CYGWIN__) || defined(__MSYS__)
+  /* See uv__check_before_write(). */
+  return UV_ENOSYS;
+#endif
+
+  err = uv__check_before_write(stream, nbufs, NULL);
+  if (err < 0)
+    return err;
+
+  cmsg = uv__calloc(1, CMSG_SPACE(nfds * sizeof(int)));
+  if (cmsg == NULL)
+    return UV_ENOMEM;
+
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(nfds * sizeof(int));
+
+  /* silence aliasing warning */
+  pv = CMSG_DATA(cmsg);
+  pi = pv;
+  for (i = 0; i < nfds; i++)
+    pi[i] = fds[i];
+
+  err = uv__write2(req, stream, bufs, nbufs, NULL, cmsg, cb);
+  if (err)
+    uv__free(cmsg);
+
+  return err;
 }
 
 
@@ -1518,6 +2969,199 @@ int uv_write(uv_write_t* req,
 }
 
 
+int uv_stream_sendfile(uv_write_t* req,
+                       uv_stream_t* stream,
+                       uv_file fd,
+                       int64_t offset,
+                       size_t length,
+                       uv_write_cb cb) {
+  struct uv__write_sendfile* sf;
+  int empty_queue;
+  int err;
+
+  if (fd < 0 || offset < 0)
+    return UV_EINVAL;
+
+  err = uv__check_before_write(stream, 1, NULL);
+  if (err < 0)
+    return err;
+
+  sf = uv__malloc(sizeof(*sf));
+  if (sf == NULL)
+    return UV_ENOMEM;
+
+  sf->fd = fd;
+  sf->offset = offset;
+
+  /* See uv_write2(). */
+  empty_queue = (stream->write_queue_size == 0);
+
+  uv__req_init(stream->loop, req, UV_WRITE);
+  req->cb = cb;
+  req->handle = stream;
+  req->error = 0;
+  req->send_handle = NULL;
+  req->reserved[0] = NULL;
+  req->reserved[1] = NULL;
+  req->reserved[2] = sf;
+  req->reserved[3] = NULL;
+  QUEUE_INIT(&req->queue);
+
+  req->bufs = req->bufsml;
+  req->bufs[0].base = NULL;
+  req->bufs[0].len = length;
+  req->nbufs = 1;
+  req->write_index = 0;
+  stream->write_queue_size += length;
+
+  uv__write_queue(stream, req, empty_queue);
+  return 0;
+}
+
+
+static void uv__write_copy_cb(uv_write_t* req, int status) {
+  struct uv__stream_write_state* ws;
+  struct uv__write_copy* wc;
+
+  wc = container_of(req, struct uv__write_copy, req);
+  ws = req->handle->u.reserved[1];  /* NULL once the stream is closing. */
+
+  if (ws != NULL && ws->spare == NULL) {
+    ws->spare = wc;
+    return;
+  }
+
+  uv__free(wc);
+}
+
+
+int uv_write_copy(uv_stream_t* stream,
+                  const uv_buf_t bufs[],
+                  unsigned int nbufs) {
+  struct uv__stream_write_state* ws;
+  struct uv__write_copy* wc;
+  uv_write_t* req;
+  uv_buf_t buf;
+  size_t size;
+  size_t skip;
+  size_t used;
+  size_t len;
+  char* p;
+  int err;
+  unsigned int i;
+
+  if (nbufs == 0)
+    return UV_EINVAL;
+
+  size = uv__count_bufs(bufs, nbufs);
+  if (size > UV__WRITE_COPY_MAX)
+    return UV_E2BIG;
+
+  err = uv__check_before_write(stream, nbufs, NULL);
+  if (err < 0)
+    return err;
+
+  /* Nothing queued, maybe it can go out right away without copying. */
+  skip = 0;
+  if (!(stream->flags & UV_HANDLE_CORKED) &&
+      uv__stream_write_buffer(stream) == 0) {
+    err = uv_try_write(stream, bufs, nbufs);
+    if (err >= 0)
+      skip = err;
+    else if (err != UV_EAGAIN)
+      return err;
+  }
+
+  if (skip == size)
+    return 0;
+
+  wc = NULL;
+  p = NULL;
+
+  /* Append to the last request if that's one of ours with room to spare.
+   * Its unwritten data always ends at the end of the used part of the buffer.
+   */
+  if (!QUEUE_EMPTY(&stream->write_queue) && !uv__stream_is_seqpacket(stream)) {
+    req = QUEUE_DATA(QUEUE_PREV(&stream->write_queue), uv_write_t, queue);
+    if (req->cb == uv__write_copy_cb) {
+      wc = container_of(req, struct uv__write_copy, req);
+      p = req->bufs[0].base + req->bufs[0].len;
+      used = p - wc->data;
+      if (used + size - skip > sizeof(wc->data))
+        wc = NULL;
+    }
+  }
+
+  if (wc == NULL) {
+    ws = stream->u.reserved[1];
+    if (ws != NULL && ws->spare != NULL) {
+      wc = ws->spare;
+      ws->spare = NULL;
+    } else {
+      wc = uv__malloc(sizeof(*wc));
+      if (wc == NULL)
+        return UV_ENOMEM;
+    }
+    p = wc->data;
+  }
+
+  len = 0;
+  for (i = 0; i < nbufs; i++) {
+    if (skip >= bufs[i].len) {
+      skip -= bufs[i].len;
+      continue;
+    }
+
+    memcpy(p + len, bufs[i].base + skip, bufs[i].len - skip);
+    len += bufs[i].len - skip;
+    skip = 0;
+  }
+
+  if (p != wc->data) {
+    wc->req.bufs[0].len += len;
+    stream->write_queue_size += len;
+    if (uv__stream_write_buffer(stream) != 0 &&
+        !(stream->flags & UV_HANDLE_CORKED))
+      uv__write_buffered(stream);
+    uv__write_watermark(stream);
+    return 0;
+  }
+
+  buf = uv_buf_init(wc->data, len);
+  err = uv_write(&wc->req, stream, &buf, 1, uv__write_copy_cb);
+  if (err)
+    uv__free(wc);
+
+  return err;
+}
+
+
+int uv_stream_cork(uv_stream_t* stream) {
+  stream->flags |= UV_HANDLE_CORKED;
+  return 0;
+}
+
+
+int uv_stream_uncork(uv_stream_t* stream) {
+  if (!(stream->flags & UV_HANDLE_CORKED))
+    return 0;
+
+  stream->flags &= ~UV_HANDLE_CORKED;
+
+  if (uv__stream_fd(stream) < 0 || stream->connect_req != NULL)
+    return 0;
+
+  /* Everything that queued up goes out in as few writev() calls as possible,
+   * see uv__write_gather().
+   */
+  if (!QUEUE_EMPTY(&stream->write_queue) &&
+      !uv__io_active(&stream->io_watcher, POLLOUT))
+    uv__write(stream);
+
+  return 0;
+}
+
+
 int uv_try_write(uv_stream_t* stream,
                  const uv_buf_t bufs[],
                  unsigned int nbufs) {
@@ -1539,7 +3183,14 @@ int uv_try_write2(uv_stream_t* stream,
   if (err < 0)
     return err;
 
-  return uv__try_write(stream, bufs, nbufs, send_handle);
+  if (send_handle != NULL)
+    uv__stream_share(send_handle);
+
+  err = uv__try_write(stream, bufs, nbufs, send_handle);
+  if (err > 0)
+    uv__write_arm(stream);
+
+  return err;
 }
 
 
@@ -1549,6 +3200,10 @@ int uv__read_start(uv_stream_t* stream,
   assert(stream->type == UV_TCP || stream->type == UV_NAMED_PIPE ||
       stream->type == UV_TTY);
 
+  /* Data goes straight to the other stream while splicing. */
+  if (stream->u.reserved[2] != NULL)
+    return UV_EBUSY;
+
   /* The UV_HANDLE_READING flag is irrelevant of the state of the stream - it
    * just expresses the desired state of the user. */
   stream->flags |= UV_HANDLE_READING;
@@ -1584,6 +3239,44 @@ int uv_read_stop(uv_stream_t* stream) {
 }
 
 
+int uv_stream_set_read_options(uv_stream_t* stream,
+                               const uv_stream_read_options_t* options) {
+  struct uv__stream_read_tuning* tuning;
+
+  tuning = stream->u.reserved[0];
+  if (options == NULL) {
+    uv__free(tuning);
+    stream->u.reserved[0] = NULL;
+    return 0;
+  }
+
+  if (options->min_size == 0 || options->min_size > options->max_size)
+    return UV_EINVAL;
+
+  if (tuning == NULL) {
+    tuning = uv__malloc(sizeof(*tuning));
+    if (tuning == NULL)
+      return UV_ENOMEM;
+
+    tuning->size = 64 * 1024;
+    stream->u.reserved[0] = tuning;
+  }
+
+  tuning->min_size = options->min_size;
+  tuning->max_size = options->max_size;
+  tuning->max_reads = options->max_reads;
+  tuning->max_bytes = options->max_bytes;
+  if (tuning->max_reads == 0)
+    tuning->max_reads = 32;
+  if (tuning->size < tuning->min_size)
+    tuning->size = tuning->min_size;
+  if (tuning->size > tuning->max_size)
+    tuning->size = tuning->max_size;
+
+  return 0;
+}
+
+
 int uv_is_readable(const uv_stream_t* stream) {
   return !!(stream->flags & UV_HANDLE_READABLE);
 }
@@ -1615,6 +3308,17 @@ void uv__stream_close(uv_stream_t* handle) {
   unsigned int i;
   uv__stream_queued_fds_t* queued_fds;
 
+  /* Give output held back by uv_tty_set_write_buffer() a last chance. */
+  if (uv__stream_write_buffer(handle) != 0 &&
+      handle->io_watcher.fd != -1 &&
+      !QUEUE_EMPTY(&handle->write_queue))
+    uv__write(handle);
+
+  uv__free(handle->u.reserved[0]);
+  handle->u.reserved[0] = NULL;
+  uv__stream_write_state_free(handle);
+  uv__splice_detach(handle);
+
 #if defined(__APPLE__)
   /* Terminate select loop first */
   if (handle->select != NULL) {
@@ -1644,7 +3348,7 @@ void uv__stream_close(uv_stream_t* handle) {
   if (handle->io_watcher.fd != -1) {
     /* Don't close stdio file descriptors.  Nothing good comes from it. */
     if (handle->io_watcher.fd > STDERR_FILENO)
-      uv__close(handle->io_watcher.fd);
+      uv__close_batched(handle->loop, handle->io_watcher.fd);
     handle->io_watcher.fd = -1;
   }
 
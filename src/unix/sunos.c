@@ -18,6 +18,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_LOOP
+
 #include "uv.h"
 #include "internal.h"
 
@@ -119,8 +121,8 @@ void uv__platform_invalidate_fd(uv_loop_t* loop, int fd) {
   assert(loop->watchers != NULL);
   assert(fd >= 0);
 
-  events = (struct port_event*) loop->watchers[loop->nwatchers];
-  nfds = (uintptr_t) loop->watchers[loop->nwatchers + 1];
+  events = (struct port_event*) uv__fd_map_events(loop);
+  nfds = (uintptr_t) uv__fd_map_nevents(loop);
   if (events == NULL)
     return;
 
@@ -166,7 +168,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
   int user_timeout;
   int reset_timeout;
 
-  if (loop->nfds == 0) {
+  if (loop->nfds == 0 && timeout == 0) {
     assert(QUEUE_EMPTY(&loop->watcher_queue));
     return;
   }
@@ -257,6 +259,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
      * operating system didn't reschedule our process while in the syscall.
      */
     SAVE_ERRNO(uv__update_time(loop));
+    uv__metrics_poll(loop, (int) nfds, ARRAY_SIZE(events));
 
     if (events[0].portev_source == 0) {
       if (reset_timeout != 0) {
@@ -282,8 +285,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
     nevents = 0;
 
     assert(loop->watchers != NULL);
-    loop->watchers[loop->nwatchers] = (void*) events;
-    loop->watchers[loop->nwatchers + 1] = (void*) (uintptr_t) nfds;
+    uv__fd_map_events(loop) = (void*) events;
+    uv__fd_map_nevents(loop) = (void*) (uintptr_t) nfds;
     for (i = 0; i < nfds; i++) {
       pe = events + i;
       fd = pe->portev_object;
@@ -295,7 +298,7 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
       assert(fd >= 0);
       assert((unsigned) fd < loop->nwatchers);
 
-      w = loop->watchers[fd];
+      w = uv__fd_watcher(loop, fd);
 
       /* File descriptor that we've stopped watching, ignore. */
       if (w == NULL)
@@ -308,12 +311,12 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         have_signals = 1;
       } else {
         uv__metrics_update_idle_time(loop);
-        w->cb(loop, w, pe->portev_events);
+        uv__io_dispatch(loop, w, pe->portev_events);
       }
 
       nevents++;
 
-      if (w != loop->watchers[fd])
+      if (w != uv__fd_watcher(loop, fd))
         continue;  /* Disabled by callback. */
 
       /* Events Ports operates in oneshot mode, rearm timer on next run. */
@@ -321,6 +324,8 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
         QUEUE_INSERT_TAIL(&loop->watcher_queue, &w->watcher_queue);
     }
 
+    uv__metrics_inc_events(loop, nevents);
+
     if (reset_timeout != 0) {
       timeout = user_timeout;
       reset_timeout = 0;
@@ -328,11 +333,11 @@ void uv__io_poll(uv_loop_t* loop, int timeout) {
 
     if (have_signals != 0) {
       uv__metrics_update_idle_time(loop);
-      loop->signal_io_watcher.cb(loop, &loop->signal_io_watcher, POLLIN);
+      uv__io_dispatch(loop, &loop->signal_io_watcher, POLLIN);
     }
 
-    loop->watchers[loop->nwatchers] = NULL;
-    loop->watchers[loop->nwatchers + 1] = NULL;
+    uv__fd_map_events(loop) = NULL;
+    uv__fd_map_nevents(loop) = NULL;
 
     if (have_signals != 0)
       return;  /* Event loop should cycle now so don't poll again. */
@@ -496,6 +501,7 @@ static void uv__fs_event_read(uv_loop_t* loop,
 
 int uv_fs_event_init(uv_loop_t* loop, uv_fs_event_t* handle) {
   uv__handle_init(loop, (uv_handle_t*)handle, UV_FS_EVENT);
+  handle->u.reserved[0] = NULL;
   return 0;
 }
 
@@ -546,6 +552,8 @@ int uv_fs_event_stop(uv_fs_event_t* handle) {
   if (!uv__is_active(handle))
     return 0;
 
+  uv__fs_event_batch_stop(handle);
+
   if (handle->fd == PORT_FIRED || handle->fd == PORT_LOADED) {
     port_dissociate(handle->loop->fs_fd,
                     PORT_SOURCE_FILE,
@@ -0,0 +1,404 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* uv_tcp_connect_host(), connection racing as in RFC 8305. Every address is
+ * tried on a handle of its own. The socket of the first one that connects
+ * moves over to the user's handle, the others are closed.
+ */
+
+#define UV__ALLOC_TAG UV_ALLOC_TAG_STREAM
+
+#include "uv.h"
+#include "internal.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UV__CONNECT_HOST_DEFAULT_DELAY 250  /* ms, from RFC 8305 */
+
+struct uv__connect_attempt {
+  uv_tcp_t handle;
+  uv_connect_t req;
+  struct uv__connect_host* ctx;
+  int initialized;
+};
+
+struct uv__connect_host {
+  uv_tcp_connect_host_t* req;
+  uv_tcp_connect_host_cb cb;
+  uv_loop_t* loop;
+  uv_getaddrinfo_t gai;
+  uv_timer_t timer;
+  struct sockaddr_storage* addrs;
+  struct uv__connect_attempt* attempts;
+  unsigned int naddrs;
+  unsigned int next;      /* Next address to try. */
+  unsigned int active;    /* Attempts in flight. */
+  unsigned int refs;      /* Handles that aren't closed yet, and the lookup. */
+  unsigned int attempt_delay;
+  int family;
+  int status;             /* Error of the last attempt that failed. */
+  int resolving;
+  int canceled;
+  int done;
+};
+
+static void uv__connect_host_next(struct uv__connect_host* ctx);
+
+
+static void uv__connect_host_unref(struct uv__connect_host* ctx) {
+  assert(ctx->refs > 0);
+  if (--ctx->refs > 0)
+    return;
+
+  uv__free(ctx->addrs);
+  uv__free(ctx->attempts);
+  uv__free(ctx);
+}
+
+
+static void uv__connect_host_close_cb(uv_handle_t* handle) {
+  struct uv__connect_attempt* a;
+  struct uv__connect_host* ctx;
+
+  if (handle->type == UV_TIMER) {
+    ctx = container_of(handle, struct uv__connect_host, timer);
+  } else {
+    a = container_of(handle, struct uv__connect_attempt, handle);
+    ctx = a->ctx;
+  }
+
+  uv__connect_host_unref(ctx);
+}
+
+
+/* Closes what is left and runs the callback. The memory goes away once all
+ * handles are closed and the lookup is done.
+ */
+static void uv__connect_host_finish(struct uv__connect_host* ctx, int status) {
+  struct uv__connect_attempt* a;
+  uv_tcp_connect_host_t* req;
+  unsigned int i;
+
+  if (ctx->done)
+    return;
+
+  ctx->done = 1;
+  uv_close((uv_handle_t*) &ctx->timer, uv__connect_host_close_cb);
+
+  /* Pending connects get UV_ECANCELED. */
+  for (i = 0; i < ctx->next; i++) {
+    a = &ctx->attempts[i];
+    if (a->initialized && !uv_is_closing((uv_handle_t*) &a->handle))
+      uv_close((uv_handle_t*) &a->handle, uv__connect_host_close_cb);
+  }
+
+  req = ctx->req;
+  req->connect_ctx = NULL;
+  ctx->cb(req, status);
+}
+
+
+/* Hands the connected socket of |from| over to |to|. |from| is left without
+ * a socket so closing it doesn't close the connection.
+ */
+static int uv__connect_host_adopt(uv_tcp_t* from, uv_tcp_t* to) {
+  int err;
+  int fd;
+
+  fd = from->io_watcher.fd;
+  uv__io_stop(from->loop,
+              &from->io_watcher,
+              POLLIN | POLLOUT | UV__POLLRDHUP | UV__POLLPRI);
+  uv__platform_invalidate_fd(from->loop, fd);
+  from->io_watcher.fd = -1;
+
+  err = uv_tcp_open(to, fd);
+  if (err)
+    uv__close(fd);
+
+  return err;
+}
+
+
+static void uv__connect_host_connect_cb(uv_connect_t* req, int status) {
+  struct uv__connect_attempt* a;
+  struct uv__connect_host* ctx;
+
+  a = container_of(req, struct uv__connect_attempt, req);
+  ctx = a->ctx;
+  ctx->active--;
+
+  if (ctx->done || ctx->canceled)
+    return;
+
+  if (status == 0) {
+    status = uv__connect_host_adopt(&a->handle, ctx->req->handle);
+    uv__connect_host_finish(ctx, status);
+    return;
+  }
+
+  /* Don't wait for the delay, a failed attempt makes way for the next. */
+  ctx->status = status;
+  uv_close((uv_handle_t*) &a->handle, uv__connect_host_close_cb);
+  uv_timer_stop(&ctx->timer);
+  uv__connect_host_next(ctx);
+}
+
+
+static void uv__connect_host_timer_cb(uv_timer_t* timer) {
+  uv__connect_host_next(container_of(timer, struct uv__connect_host, timer));
+}
+
+
+static void uv__connect_host_cancel_cb(uv_timer_t* timer) {
+  struct uv__connect_host* ctx;
+
+  ctx = container_of(timer, struct uv__connect_host, timer);
+  uv__connect_host_finish(ctx, UV_ECANCELED);
+}
+
+
+/* Starts the next attempt. While it is in flight the timer starts the one
+ * after that, so a slow address never holds up the others for long.
+ */
+static void uv__connect_host_next(struct uv__connect_host* ctx) {
+  struct uv__connect_attempt* a;
+  int err;
+
+  while (ctx->next < ctx->naddrs) {
+    a = &ctx->attempts[ctx->next];
+    a->ctx = ctx;
+
+    err = uv_tcp_init(ctx->loop, &a->handle);
+    if (err) {
+      ctx->status = err;
+      ctx->next++;
+      continue;
+    }
+
+    a->initialized = 1;
+    a->handle.flags |= UV_HANDLE_INTERNAL;
+    ctx->refs++;
+
+    err = uv_tcp_connect(&a->req,
+                         &a->handle,
+                         (const struct sockaddr*) &ctx->addrs[ctx->next],
+                         uv__connect_host_connect_cb);
+    ctx->next++;
+
+    if (err) {
+      ctx->status = err;
+      uv_close((uv_handle_t*) &a->handle, uv__connect_host_close_cb);
+      continue;
+    }
+
+    ctx->active++;
+    if (ctx->next < ctx->naddrs)
+      uv_timer_start(&ctx->timer,
+                     uv__connect_host_timer_cb,
+                     ctx->attempt_delay,
+                     0);
+    return;
+  }
+
+  if (ctx->active == 0)
+    uv__connect_host_finish(ctx, ctx->status);
+}
+
+
+/* Orders the addresses like RFC 8305 section 4 says: the family of the first
+ * address goes first, then the families take turns.
+ */
+static int uv__connect_host_sort(struct uv__connect_host* ctx,
+                                 const struct addrinfo* res) {
+  const struct addrinfo* p;
+  const struct addrinfo* lists[2];
+  unsigned int n;
+  int family;
+  int i;
+
+  n = 0;
+  for (p = res; p != NULL; p = p->ai_next)
+    if (p->ai_family == AF_INET || p->ai_family == AF_INET6)
+      n++;
+
+  if (n == 0)
+    return UV_EAI_NODATA;
+
+  ctx->addrs = uv__calloc(n, sizeof(*ctx->addrs));
+  ctx->attempts = uv__calloc(n, sizeof(*ctx->attempts));
+  if (ctx->addrs == NULL || ctx->attempts == NULL)
+    return UV_ENOMEM;
+
+  lists[0] = res;
+  lists[1] = res;
+  family = res->ai_family;
+
+  for (i = 0; ctx->naddrs < n; i ^= 1) {
+    p = lists[i];
+    while (p != NULL) {
+      if (p->ai_family == AF_INET || p->ai_family == AF_INET6)
+        if ((p->ai_family == family) == (i == 0))
+          break;
+      p = p->ai_next;
+    }
+
+    if (p == NULL)
+      continue;
+
+    memcpy(&ctx->addrs[ctx->naddrs++], p->ai_addr, p->ai_addrlen);
+    lists[i] = p->ai_next;
+  }
+
+  return 0;
+}
+
+
+static void uv__connect_host_gai_cb(uv_getaddrinfo_t* gai,
+                                    int status,
+                                    struct addrinfo* res) {
+  struct uv__connect_host* ctx;
+
+  ctx = container_of(gai, struct uv__connect_host, gai);
+  ctx->resolving = 0;
+
+  if (status == 0 && !ctx->done)
+    status = uv__connect_host_sort(ctx, res);
+
+  uv_freeaddrinfo(res);
+
+  if (ctx->done) {
+    uv__connect_host_unref(ctx);
+    return;
+  }
+
+  if (status == UV_EAI_CANCELED || ctx->canceled)
+    status = UV_ECANCELED;
+
+  if (status == 0)
+    uv__connect_host_next(ctx);
+  else
+    uv__connect_host_finish(ctx, status);
+
+  uv__connect_host_unref(ctx);
+}
+
+
+int uv_tcp_connect_host(uv_tcp_connect_host_t* req,
+                        uv_tcp_t* handle,
+                        const char* host,
+                        const char* service,
+                        const uv_tcp_connect_host_options_t* options,
+                        uv_tcp_connect_host_cb cb) {
+  struct uv__connect_host* ctx;
+  struct addrinfo hints;
+  int err;
+
+  if (req == NULL || handle == NULL || host == NULL || cb == NULL)
+    return UV_EINVAL;
+
+  /* The handle gets the socket of the winning attempt. */
+  if (handle->type != UV_TCP || uv__stream_fd(handle) != -1)
+    return UV_EINVAL;
+
+  ctx = uv__calloc(1, sizeof(*ctx));
+  if (ctx == NULL)
+    return UV_ENOMEM;
+
+  ctx->req = req;
+  ctx->cb = cb;
+  ctx->loop = handle->loop;
+  ctx->attempt_delay = UV__CONNECT_HOST_DEFAULT_DELAY;
+  ctx->family = AF_UNSPEC;
+  ctx->status = UV_ECONNREFUSED;
+
+  if (options != NULL) {
+    if (options->attempt_delay != 0)
+      ctx->attempt_delay = options->attempt_delay;
+    ctx->family = options->family;
+  }
+
+  if (ctx->family != AF_UNSPEC &&
+      ctx->family != AF_INET &&
+      ctx->family != AF_INET6) {
+    uv__free(ctx);
+    return UV_EINVAL;
+  }
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = ctx->family;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_ADDRCONFIG;
+
+  err = uv_timer_init(ctx->loop, &ctx->timer);
+  if (err) {
+    uv__free(ctx);
+    return err;
+  }
+
+  ctx->timer.flags |= UV_HANDLE_INTERNAL;
+
+  /* One for the timer, one for the lookup. */
+  ctx->refs = 2;
+  err = uv_getaddrinfo(ctx->loop,
+                       &ctx->gai,
+                       uv__connect_host_gai_cb,
+                       host,
+                       service,
+                       &hints);
+  if (err) {
+    ctx->refs = 1;
+    ctx->done = 1;
+    uv_close((uv_handle_t*) &ctx->timer, uv__connect_host_close_cb);
+    return err;
+  }
+
+  ctx->resolving = 1;
+  req->handle = handle;
+  req->connect_ctx = ctx;
+
+  return 0;
+}
+
+
+int uv_tcp_connect_host_cancel(uv_tcp_connect_host_t* req) {
+  struct uv__connect_host* ctx;
+
+  ctx = req->connect_ctx;
+  if (ctx == NULL)
+    return UV_EINVAL;
+
+  if (ctx->canceled)
+    return 0;
+
+  /* The callback runs from the loop, never from in here. A lookup that can't
+   * be cancelled anymore reports UV_ECANCELED when it comes back.
+   */
+  ctx->canceled = 1;
+  if (ctx->resolving)
+    uv_cancel((uv_req_t*) &ctx->gai);
+  else
+    uv_timer_start(&ctx->timer, uv__connect_host_cancel_cb, 0, 0);
+
+  return 0;
+}
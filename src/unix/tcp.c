@@ -23,9 +23,77 @@
 #include "internal.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <assert.h>
 #include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#if defined(__linux__)
+# include <linux/tls.h>
+# if defined(TCP_ULP) && defined(SOL_TLS) && defined(TLS_TX) && defined(TLS_RX)
+#  define UV__HAVE_KTLS 1
+# endif
+#endif
+
+#if defined(__linux__) && defined(TCP_INFO)
+/* struct tcp_info as the kernel fills it in. The glibc copy stops at
+ * tcpi_total_retrans. Older kernels fill in less, the rest stays zero.
+ */
+struct uv__tcp_info {
+  uint8_t state;
+  uint8_t ca_state;
+  uint8_t retransmits;
+  uint8_t probes;
+  uint8_t backoff;
+  uint8_t options;
+  uint8_t wscale;
+  uint8_t flags;
+  uint32_t rto;
+  uint32_t ato;
+  uint32_t snd_mss;
+  uint32_t rcv_mss;
+  uint32_t unacked;
+  uint32_t sacked;
+  uint32_t lost;
+  uint32_t retrans;
+  uint32_t fackets;
+  uint32_t last_data_sent;
+  uint32_t last_ack_sent;
+  uint32_t last_data_recv;
+  uint32_t last_ack_recv;
+  uint32_t pmtu;
+  uint32_t rcv_ssthresh;
+  uint32_t rtt;
+  uint32_t rttvar;
+  uint32_t snd_ssthresh;
+  uint32_t snd_cwnd;
+  uint32_t advmss;
+  uint32_t reordering;
+  uint32_t rcv_rtt;
+  uint32_t rcv_space;
+  uint32_t total_retrans;
+  uint64_t pacing_rate;
+  uint64_t max_pacing_rate;
+  uint64_t bytes_acked;
+  uint64_t bytes_received;
+  uint32_t segs_out;
+  uint32_t segs_in;
+  uint32_t notsent_bytes;
+  uint32_t min_rtt;
+  uint32_t data_segs_in;
+  uint32_t data_segs_out;
+  uint64_t delivery_rate;
+  uint64_t busy_time;
+  uint64_t rwnd_limited;
+  uint64_t sndbuf_limited;
+  uint32_t delivered;
+  uint32_t delivered_ce;
+  uint64_t bytes_sent;
+  uint64_t bytes_retrans;
+};
+#endif  /* defined(__linux__) && defined(TCP_INFO) */
 
 
 static int new_socket(uv_tcp_t* handle, int domain, unsigned long flags) {
@@ -131,7 +199,7 @@ int uv_tcp_init_ex(uv_loop_t* loop, uv_tcp_t* tcp, unsigned int flags) {
   if (domain != AF_UNSPEC) {
     int err = maybe_new_socket(tcp, domain, 0);
     if (err) {
-      QUEUE_REMOVE(&tcp->handle_queue);
+      uv__handle_remove(tcp);
       return err;
     }
   }
@@ -164,6 +232,27 @@ int uv__tcp_bind(uv_tcp_t* tcp,
   if (setsockopt(tcp->io_watcher.fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)))
     return UV__ERR(errno);
 
+  if (flags & UV_TCP_REUSEPORT) {
+    /* FreeBSD's plain SO_REUSEPORT doesn't balance between listeners. */
+#if defined(SO_REUSEPORT_LB)
+    if (setsockopt(tcp->io_watcher.fd,
+                   SOL_SOCKET,
+                   SO_REUSEPORT_LB,
+                   &on,
+                   sizeof(on)))
+      return UV__ERR(errno);
+#elif defined(SO_REUSEPORT) && !defined(__MVS__)
+    if (setsockopt(tcp->io_watcher.fd,
+                   SOL_SOCKET,
+                   SO_REUSEPORT,
+                   &on,
+                   sizeof(on)))
+      return UV__ERR(errno);
+#else
+    return UV_ENOTSUP;
+#endif
+  }
+
 #ifndef __OpenBSD__
 #ifdef IPV6_V6ONLY
   if (addr->sa_family == AF_INET6) {
@@ -201,11 +290,19 @@ int uv__tcp_bind(uv_tcp_t* tcp,
 }
 
 
-int uv__tcp_connect(uv_connect_t* req,
-                    uv_tcp_t* handle,
-                    const struct sockaddr* addr,
-                    unsigned int addrlen,
-                    uv_connect_cb cb) {
+static int uv__tcp_connect_data(uv_connect_t* req,
+                                uv_tcp_t* handle,
+                                const struct sockaddr* addr,
+                                unsigned int addrlen,
+                                const uv_buf_t bufs[],
+                                unsigned int nbufs,
+                                uv_connect_cb cb) {
+#if defined(MSG_FASTOPEN)
+  struct msghdr msg;
+#endif
+  uv_buf_t buf;
+  size_t sent;
+  unsigned int i;
   int err;
   int r;
 
@@ -223,6 +320,37 @@ int uv__tcp_connect(uv_connect_t* req,
   if (err)
     return err;
 
+  sent = 0;
+
+#if defined(MSG_FASTOPEN)
+  /* Connect and put as much of the data as fits into the SYN. Without a
+   * cookie from an earlier connection that's nothing, with one the server
+   * gets the data without waiting for the handshake to finish.
+   */
+  r = -1;
+  if (nbufs > 0) {
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = (struct sockaddr*) addr;
+    msg.msg_namelen = addrlen;
+    msg.msg_iov = (struct iovec*) bufs;
+    msg.msg_iovlen = nbufs;
+    if (msg.msg_iovlen > (size_t) uv__getiovmax())
+      msg.msg_iovlen = uv__getiovmax();
+
+    do {
+      errno = 0;
+      r = sendmsg(uv__stream_fd(handle), &msg, MSG_FASTOPEN | MSG_NOSIGNAL);
+    } while (r == -1 && errno == EINTR);
+
+    if (r >= 0) {
+      sent = r;
+      r = 0;
+    }
+  }
+
+  /* Fast open is disabled with the net.ipv4.tcp_fastopen sysctl. */
+  if (nbufs == 0 || (r == -1 && errno == EOPNOTSUPP))
+#endif  /* defined(MSG_FASTOPEN) */
   do {
     errno = 0;
     r = connect(uv__stream_fd(handle), addr, addrlen);
@@ -260,6 +388,25 @@ out:
 
   uv__io_start(handle->loop, &handle->io_watcher, POLLOUT);
 
+  /* Queue what didn't go out with the SYN, it's written once connected. If
+   * that fails the connection is no good, report it through the callback.
+   */
+  for (i = 0; i < nbufs && handle->delayed_error == 0; i++) {
+    buf = bufs[i];
+    if (sent >= buf.len) {
+      sent -= buf.len;
+      continue;
+    }
+
+    buf.base += sent;
+    buf.len -= sent;
+    sent = 0;
+
+    err = uv_write_copy((uv_stream_t*) handle, &buf, 1);
+    if (err)
+      handle->delayed_error = err;
+  }
+
   if (handle->delayed_error)
     uv__io_feed(handle->loop, &handle->io_watcher);
 
@@ -267,6 +414,57 @@ out:
 }
 
 
+int uv__tcp_connect(uv_connect_t* req,
+                    uv_tcp_t* handle,
+                    const struct sockaddr* addr,
+                    unsigned int addrlen,
+                    uv_connect_cb cb) {
+  return uv__tcp_connect_data(req, handle, addr, addrlen, NULL, 0, cb);
+}
+
+
+int uv__tcp_connect_fastopen(uv_connect_t* req,
+                             uv_tcp_t* handle,
+                             const struct sockaddr* addr,
+                             unsigned int addrlen,
+                             const uv_buf_t bufs[],
+                             unsigned int nbufs,
+                             uv_connect_cb cb) {
+  if (nbufs == 0)
+    return UV_EINVAL;
+
+  /* The rest is queued with uv_write_copy(), check its limit up front. */
+  if (uv__count_bufs(bufs, nbufs) > UV__WRITE_COPY_MAX)
+    return UV_E2BIG;
+
+  return uv__tcp_connect_data(req, handle, addr, addrlen, bufs, nbufs, cb);
+}
+
+
+int uv_tcp_fastopen(uv_tcp_t* handle, int qlen) {
+#if defined(TCP_FASTOPEN)
+  int fd;
+
+  if (qlen < 0)
+    return UV_EINVAL;
+
+  fd = uv__stream_fd(handle);
+  if (fd == -1)
+    return UV_EBADF;
+
+  /* Linux and FreeBSD take the queue length, macOS only looks at whether
+   * it's zero.
+   */
+  if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &qlen, sizeof(qlen)))
+    return UV__ERR(errno);
+
+  return 0;
+#else
+  return UV_ENOSYS;
+#endif  /* defined(TCP_FASTOPEN) */
+}
+
+
 int uv_tcp_open(uv_tcp_t* handle, uv_os_sock_t sock) {
   int err;
 
@@ -428,6 +626,234 @@ int uv_tcp_nodelay(uv_tcp_t* handle, int on) {
 }
 
 
+int uv_tcp_zerocopy(uv_tcp_t* handle, size_t threshold) {
+  return uv__stream_zerocopy((uv_stream_t*) handle, threshold);
+}
+
+
+int uv_tcp_recv_timestamps(uv_tcp_t* handle, int enable) {
+  return uv__stream_rx_timestamps((uv_stream_t*) handle, enable);
+}
+
+
+int uv_tcp_get_read_timestamp(const uv_tcp_t* handle, uv_timespec_t* ts) {
+  return uv__stream_read_timestamp((const uv_stream_t*) handle, ts);
+}
+
+
+int uv_tcp_set_notsent_lowat(uv_tcp_t* handle,
+                             unsigned int lowat,
+                             uv_tcp_writable_cb cb) {
+#if defined(TCP_NOTSENT_LOWAT)
+  int fd;
+
+  fd = uv__stream_fd(handle);
+  if (fd == -1)
+    return UV_EBADF;
+
+  if (setsockopt(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, &lowat, sizeof(lowat)))
+    return UV__ERR(errno);
+
+  return uv__stream_set_writable_cb((uv_stream_t*) handle, cb);
+#else
+  return UV_ENOSYS;
+#endif  /* defined(TCP_NOTSENT_LOWAT) */
+}
+
+
+int uv_tcp_tls_offload(uv_tcp_t* handle,
+                       uv_tls_direction direction,
+                       const void* crypto_info,
+                       size_t size) {
+#if defined(UV__HAVE_KTLS)
+  int optname;
+  int fd;
+
+  if (direction == UV_TLS_TX)
+    optname = TLS_TX;
+  else if (direction == UV_TLS_RX)
+    optname = TLS_RX;
+  else
+    return UV_EINVAL;
+
+  if (crypto_info == NULL || size == 0)
+    return UV_EINVAL;
+
+  fd = uv__stream_fd(handle);
+  if (fd == -1)
+    return UV_EBADF;
+
+  /* The first call attaches the TLS layer, after that it's already there. */
+  if (setsockopt(fd, IPPROTO_TCP, TCP_ULP, "tls", sizeof("tls")))
+    if (errno != EEXIST)
+      return UV__ERR(errno);
+
+  if (setsockopt(fd, SOL_TLS, optname, crypto_info, size))
+    return UV__ERR(errno);
+
+  return 0;
+#else
+  return UV_ENOSYS;
+#endif  /* defined(UV__HAVE_KTLS) */
+}
+
+
+int uv_tcp_get_info(const uv_tcp_t* handle, uv_tcp_info_t* info) {
+#if defined(__linux__) && defined(TCP_INFO)
+  struct uv__tcp_info ti;
+#elif defined(__APPLE__) && defined(TCP_CONNECTION_INFO)
+  struct tcp_connection_info ti;
+#elif defined(__FreeBSD__) && defined(TCP_INFO)
+  struct tcp_info ti;
+#endif
+  socklen_t len;
+  int fd;
+
+  fd = uv__stream_fd(handle);
+  if (fd == -1)
+    return UV_EBADF;
+
+  memset(info, 0, sizeof(*info));
+
+#if defined(__linux__) && defined(TCP_INFO)
+  memset(&ti, 0, sizeof(ti));
+  len = sizeof(ti);
+  if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &len))
+    return UV__ERR(errno);
+
+  info->rtt = ti.rtt;
+  info->rtt_var = ti.rttvar;
+  info->min_rtt = ti.min_rtt;
+  info->rto = ti.rto;
+  info->mss = ti.snd_mss;
+  info->snd_cwnd = ti.snd_cwnd;
+  info->snd_ssthresh = ti.snd_ssthresh;
+  info->total_retrans = ti.total_retrans;
+  info->delivery_rate = ti.delivery_rate;
+  info->bytes_sent = ti.bytes_sent;
+  info->bytes_retrans = ti.bytes_retrans;
+  info->bytes_received = ti.bytes_received;
+  return 0;
+#elif defined(__APPLE__) && defined(TCP_CONNECTION_INFO)
+  memset(&ti, 0, sizeof(ti));
+  len = sizeof(ti);
+  if (getsockopt(fd, IPPROTO_TCP, TCP_CONNECTION_INFO, &ti, &len))
+    return UV__ERR(errno);
+
+  /* Times are in milliseconds, the window and threshold in bytes. */
+  info->rtt = (uint64_t) ti.tcpi_srtt * 1000;
+  info->rtt_var = (uint64_t) ti.tcpi_rttvar * 1000;
+  info->rto = (uint64_t) ti.tcpi_rto * 1000;
+  info->mss = ti.tcpi_maxseg;
+  if (ti.tcpi_maxseg > 0) {
+    info->snd_cwnd = ti.tcpi_snd_cwnd / ti.tcpi_maxseg;
+    info->snd_ssthresh = ti.tcpi_snd_ssthresh / ti.tcpi_maxseg;
+  }
+  info->bytes_sent = ti.tcpi_txbytes;
+  info->bytes_retrans = ti.tcpi_txretransmitbytes;
+  info->bytes_received = ti.tcpi_rxbytes;
+  return 0;
+#elif defined(__FreeBSD__) && defined(TCP_INFO)
+  memset(&ti, 0, sizeof(ti));
+  len = sizeof(ti);
+  if (getsockopt(fd, IPPROTO_TCP, TCP_INFO, &ti, &len))
+    return UV__ERR(errno);
+
+  /* The window and threshold are in bytes. */
+  info->rtt = ti.tcpi_rtt;
+  info->rtt_var = ti.tcpi_rttvar;
+  info->rto = ti.tcpi_rto;
+  info->mss = ti.tcpi_snd_mss;
+  if (ti.tcpi_snd_mss > 0) {
+    info->snd_cwnd = ti.tcpi_snd_cwnd / ti.tcpi_snd_mss;
+    info->snd_ssthresh = ti.tcpi_snd_ssthresh / ti.tcpi_snd_mss;
+  }
+  info->total_retrans = ti.tcpi_snd_rexmitpack;
+  return 0;
+#else
+  (void) len;
+  return UV_ENOSYS;
+#endif
+}
+
+
+int uv_tcp_defer_accept(uv_tcp_t* handle, unsigned int timeout) {
+#if defined(TCP_DEFER_ACCEPT)
+  int fd;
+  int secs;
+
+  fd = uv__stream_fd(handle);
+  if (fd == -1)
+    return UV_EBADF;
+
+  if (timeout > INT_MAX)
+    return UV_EINVAL;
+
+  secs = timeout;
+  if (setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &secs, sizeof(secs)))
+    return UV__ERR(errno);
+
+  return 0;
+#elif defined(SO_ACCEPTFILTER)
+  struct accept_filter_arg afa;
+  int fd;
+
+  fd = uv__stream_fd(handle);
+  if (fd == -1)
+    return UV_EBADF;
+
+  /* accf_data(9) has no timeout, any non-zero value turns it on. It can only
+   * be attached to a listening socket.
+   */
+  if (timeout == 0) {
+    if (setsockopt(fd, SOL_SOCKET, SO_ACCEPTFILTER, NULL, 0))
+      return UV__ERR(errno);
+    return 0;
+  }
+
+  memset(&afa, 0, sizeof(afa));
+  strcpy(afa.af_name, "dataready");
+  if (setsockopt(fd, SOL_SOCKET, SO_ACCEPTFILTER, &afa, sizeof(afa)))
+    return UV__ERR(errno);
+
+  return 0;
+#else
+  return UV_ENOSYS;
+#endif
+}
+
+
+int uv_tcp_reuseport_steer_by_cpu(uv_tcp_t* handle) {
+  return uv__reuseport_steer_by_cpu(uv__stream_fd(handle));
+}
+
+
+int uv_tcp_set_busy_poll(uv_tcp_t* handle, unsigned int usec) {
+  return uv__busy_poll(handle->loop, uv__stream_fd(handle), usec);
+}
+
+
+int uv_tcp_set_incoming_cpu(uv_tcp_t* handle, int cpu) {
+#if defined(SO_INCOMING_CPU)
+  int fd;
+
+  if (cpu < 0)
+    return UV_EINVAL;
+
+  fd = uv__stream_fd(handle);
+  if (fd == -1)
+    return UV_EBADF;
+
+  if (setsockopt(fd, SOL_SOCKET, SO_INCOMING_CPU, &cpu, sizeof(cpu)))
+    return UV__ERR(errno);
+
+  return 0;
+#else
+  return UV_ENOSYS;
+#endif  /* defined(SO_INCOMING_CPU) */
+}
+
+
 int uv_tcp_keepalive(uv_tcp_t* handle, int on, unsigned int delay) {
   int err;
 
@@ -459,6 +885,17 @@ int uv_tcp_simultaneous_accepts(uv_tcp_t* handle, int enable) {
 }
 
 
+/* There are no accept requests to post, the kernel queues the connections. */
+int uv_tcp_set_pending_accepts(uv_tcp_t* handle,
+                               unsigned int min,
+                               unsigned int max) {
+  if (min == 0 || min > max || max > UV__TCP_PENDING_ACCEPTS_MAX)
+    return UV_EINVAL;
+
+  return 0;
+}
+
+
 void uv__tcp_close(uv_tcp_t* handle) {
   uv__stream_close((uv_stream_t*)handle);
 }
@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_THREADPOOL
+
 #include "uv.h"
 #include "internal.h"
 
@@ -32,6 +34,12 @@
 
 #include <limits.h>
 
+#if defined(__linux__)
+#include <sched.h>  /* sched_setaffinity() */
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
 #ifdef __MVS__
 #include <sys/ipc.h>
 #include <sys/sem.h>
@@ -44,6 +52,17 @@
 #undef NANOSEC
 #define NANOSEC ((uint64_t) 1e9)
 
+#if defined(__linux__)
+/* Lives on the stack of uv_thread_create_ex() until |started| is in. */
+struct uv__thread_start {
+  void (*entry)(void* arg);
+  void* arg;
+  cpu_set_t cpuset;
+  uv__latch_t started;
+  int err;
+};
+#endif
+
 #if defined(PTHREAD_BARRIER_SERIAL_THREAD)
 STATIC_ASSERT(sizeof(uv_barrier_t) == sizeof(pthread_barrier_t));
 #endif
@@ -233,10 +252,81 @@ int uv_thread_create(uv_thread_t *tid, void (*entry)(void *arg), void *arg) {
   return uv_thread_create_ex(tid, &params, entry, arg);
 }
 
+#if defined(__linux__)
+/* The thread binds itself to its CPUs before running any code of the user,
+ * its stack and the memory it touches first are then local to them. The
+ * glibc-only pthread_attr_setaffinity_np() does the same but isn't there
+ * on musl and Android.
+ */
+static void* uv__thread_start(void* arg) {
+  struct uv__thread_start* start;
+  void (*entry)(void* arg);
+  void* entry_arg;
+  int err;
+
+  start = arg;
+  entry = start->entry;
+  entry_arg = start->arg;
+
+  err = 0;
+  if (sched_setaffinity(0, sizeof(start->cpuset), &start->cpuset))
+    err = UV__ERR(errno);
+
+  start->err = err;
+  uv__latch_arrive(&start->started);
+
+  if (err == 0)
+    entry(entry_arg);
+
+  return NULL;
+}
+
+
+static int uv__thread_cpuset(const uv_thread_options_t* params,
+                             cpu_set_t* cpuset) {
+  size_t i;
+
+  if (params->cpumask == NULL || params->mask_size > CPU_SETSIZE)
+    return UV_EINVAL;
+
+  CPU_ZERO(cpuset);
+  for (i = 0; i < params->mask_size; i++)
+    if (params->cpumask[i])
+      CPU_SET(i, cpuset);
+
+  if (CPU_COUNT(cpuset) == 0)
+    return UV_EINVAL;
+
+  return 0;
+}
+#endif
+
+
+int uv_cpumask_size(void) {
+#if defined(__linux__)
+  return CPU_SETSIZE;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
+int uv_numa_node_cpumask(unsigned int node, char* cpumask, size_t mask_size) {
+#if defined(__linux__)
+  return uv__numa_node_cpumask(node, cpumask, mask_size);
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
 int uv_thread_create_ex(uv_thread_t* tid,
                         const uv_thread_options_t* params,
                         void (*entry)(void *arg),
                         void *arg) {
+#if defined(__linux__)
+  struct uv__thread_start start;
+#endif
   int err;
   pthread_attr_t* attr;
   pthread_attr_t attr_storage;
@@ -250,6 +340,27 @@ int uv_thread_create_ex(uv_thread_t* tid,
     void* (*out)(void*);
   } f;
 
+  f.in = entry;
+  if (params->flags & UV_THREAD_HAS_AFFINITY) {
+#if defined(__linux__)
+    err = uv__thread_cpuset(params, &start.cpuset);
+    if (err)
+      return err;
+
+    err = uv__latch_init(&start.started);
+    if (err)
+      return err;
+
+    start.entry = entry;
+    start.arg = arg;
+    start.err = 0;
+    f.out = uv__thread_start;
+    arg = &start;
+#else
+    return UV_ENOTSUP;
+#endif
+  }
+
   stack_size =
       params->flags & UV_THREAD_HAS_STACK_SIZE ? params->stack_size : 0;
 
@@ -275,12 +386,24 @@ int uv_thread_create_ex(uv_thread_t* tid,
       abort();
   }
 
-  f.in = entry;
   err = pthread_create(tid, attr, f.out, arg);
 
   if (attr != NULL)
     pthread_attr_destroy(attr);
 
+#if defined(__linux__)
+  if (params->flags & UV_THREAD_HAS_AFFINITY) {
+    if (err == 0) {
+      uv__latch_wait(&start.started, 1);
+      if (start.err != 0) {
+        pthread_join(*tid, NULL);
+        err = -start.err;
+      }
+    }
+    uv__latch_destroy(&start.started);
+  }
+#endif
+
   return UV__ERR(err);
 }
 
@@ -299,6 +422,66 @@ int uv_thread_equal(const uv_thread_t* t1, const uv_thread_t* t2) {
 }
 
 
+/* Binds the calling thread to |cpu|. */
+int uv__thread_pin(unsigned int cpu) {
+#if defined(__linux__)
+  cpu_set_t set;
+
+  if (cpu >= CPU_SETSIZE)
+    return UV_EINVAL;
+
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+
+  /* Not pthread_setaffinity_np(), Android doesn't have it. */
+  if (sched_setaffinity(0, sizeof(set), &set))
+    return UV__ERR(errno);
+
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
+/* Names the calling thread. Linux cuts names off at 15 characters. */
+int uv__thread_setname(const char* name) {
+#if defined(__linux__)
+  char buf[16];
+  int err;
+
+  uv__strscpy(buf, name, sizeof(buf));
+  err = pthread_setname_np(pthread_self(), buf);
+  if (err)
+    return UV__ERR(err);
+
+  return 0;
+#elif defined(__APPLE__)
+  if (pthread_setname_np(name))
+    return UV__ERR(errno);
+
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
+/* Sets the nice value of the calling thread. Only Linux has per-thread
+ * nice values, elsewhere setpriority() would change the whole process.
+ */
+int uv__thread_setpriority(int priority) {
+#if defined(__linux__)
+  if (setpriority(PRIO_PROCESS, (id_t) syscall(SYS_gettid), priority))
+    return UV__ERR(errno);
+
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
 int uv_mutex_init(uv_mutex_t* mutex) {
 #if defined(NDEBUG) || !defined(PTHREAD_MUTEX_ERRORCHECK)
   return UV__ERR(pthread_mutex_init(mutex, NULL));
@@ -341,6 +524,33 @@ int uv_mutex_init_recursive(uv_mutex_t* mutex) {
 }
 
 
+/* glibc's adaptive mutexes spin for a while, in proportion to how long the
+ * lock was held before, until they park in the kernel. Elsewhere there's no
+ * portable equivalent and this is a regular mutex.
+ */
+int uv_mutex_init_adaptive(uv_mutex_t* mutex) {
+#if defined(PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP)
+  pthread_mutexattr_t attr;
+  int err;
+
+  if (pthread_mutexattr_init(&attr))
+    abort();
+
+  if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_ADAPTIVE_NP))
+    abort();
+
+  err = pthread_mutex_init(mutex, &attr);
+
+  if (pthread_mutexattr_destroy(&attr))
+    abort();
+
+  return UV__ERR(err);
+#else
+  return uv_mutex_init(mutex);
+#endif
+}
+
+
 void uv_mutex_destroy(uv_mutex_t* mutex) {
   if (pthread_mutex_destroy(mutex))
     abort();
@@ -713,6 +923,96 @@ int uv_sem_trywait(uv_sem_t* sem) {
 #endif /* defined(__APPLE__) && defined(__MACH__) */
 
 
+#if defined(__linux__)
+
+#define UV__LATCH_WAITING 0x80000000u
+
+int uv__latch_init(uv__latch_t* latch) {
+  latch->word = 0;
+  return 0;
+}
+
+
+void uv__latch_destroy(uv__latch_t* latch) {
+}
+
+
+void uv__latch_arrive(uv__latch_t* latch) {
+  unsigned int old;
+
+  old = __atomic_fetch_add(&latch->word, 1, __ATOMIC_SEQ_CST);
+  if (old & UV__LATCH_WAITING)
+    syscall(SYS_futex, &latch->word, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+}
+
+
+void uv__latch_wait(uv__latch_t* latch, unsigned int count) {
+  unsigned int word;
+
+  word = __atomic_load_n(&latch->word, __ATOMIC_ACQUIRE);
+  while ((word & ~UV__LATCH_WAITING) < count) {
+    if (!(word & UV__LATCH_WAITING)) {
+      if (!__atomic_compare_exchange_n(&latch->word,
+                                       &word,
+                                       word | UV__LATCH_WAITING,
+                                       0,
+                                       __ATOMIC_SEQ_CST,
+                                       __ATOMIC_ACQUIRE)) {
+        continue;  /* Someone arrived, |word| is up to date. */
+      }
+      word |= UV__LATCH_WAITING;
+    }
+
+    /* Returns right away when the word changed since we looked at it. */
+    syscall(SYS_futex, &latch->word, FUTEX_WAIT_PRIVATE, word, NULL);
+    word = __atomic_load_n(&latch->word, __ATOMIC_ACQUIRE);
+  }
+}
+
+#else  /* !defined(__linux__) */
+
+int uv__latch_init(uv__latch_t* latch) {
+  int err;
+
+  err = uv_mutex_init(&latch->mutex);
+  if (err)
+    return err;
+
+  err = uv_cond_init(&latch->cond);
+  if (err) {
+    uv_mutex_destroy(&latch->mutex);
+    return err;
+  }
+
+  latch->count = 0;
+  return 0;
+}
+
+
+void uv__latch_destroy(uv__latch_t* latch) {
+  uv_cond_destroy(&latch->cond);
+  uv_mutex_destroy(&latch->mutex);
+}
+
+
+void uv__latch_arrive(uv__latch_t* latch) {
+  uv_mutex_lock(&latch->mutex);
+  latch->count++;
+  uv_cond_signal(&latch->cond);
+  uv_mutex_unlock(&latch->mutex);
+}
+
+
+void uv__latch_wait(uv__latch_t* latch, unsigned int count) {
+  uv_mutex_lock(&latch->mutex);
+  while (latch->count < count)
+    uv_cond_wait(&latch->cond, &latch->mutex);
+  uv_mutex_unlock(&latch->mutex);
+}
+
+#endif  /* defined(__linux__) */
+
+
 #if defined(__APPLE__) && defined(__MACH__) || defined(__MVS__)
 
 int uv_cond_init(uv_cond_t* cond) {
@@ -120,6 +120,27 @@ static int uv__tty_is_slave(const int fd) {
   return result;
 }
 
+/* When ttyname_r() can't name the device, for example because /dev/pts isn't
+ * mounted in a container, the controlling terminal may still be reachable as
+ * /dev/tty. Only use it when it is the same device as |fd|.
+ */
+static int uv__tty_reopen_ctty(int fd, int mode) {
+  struct stat a;
+  struct stat b;
+  int r;
+
+  r = uv__open_cloexec("/dev/tty", mode | O_NOCTTY);
+  if (r < 0)
+    return r;
+
+  if (fstat(fd, &a) || fstat(r, &b) || a.st_rdev != b.st_rdev) {
+    uv__close(r);
+    return UV_ENOTTY;
+  }
+
+  return r;
+}
+
 int uv_tty_init(uv_loop_t* loop, uv_tty_t* tty, int fd, int unused) {
   uv_handle_type type;
   int flags;
@@ -171,6 +192,9 @@ int uv_tty_init(uv_loop_t* loop, uv_tty_t* tty, int fd, int unused) {
     else
       r = -1;
 
+    if (r < 0 && uv__tty_is_slave(fd))
+      r = uv__tty_reopen_ctty(fd, mode);
+
     if (r < 0) {
       /* fallback to using blocking writes */
       if (mode != O_RDONLY)
@@ -209,7 +233,7 @@ skip:
     int rc = r;
     if (newfd != -1)
       uv__close(newfd);
-    QUEUE_REMOVE(&tty->handle_queue);
+    uv__handle_remove(tty);
     do
       r = fcntl(fd, F_SETFL, saved_flags);
     while (r == -1 && errno == EINTR);
@@ -330,6 +354,14 @@ int uv_tty_get_winsize(uv_tty_t* tty, int* width, int* height) {
 }
 
 
+int uv_tty_set_write_buffer(uv_tty_t* tty, size_t size) {
+  if (!(tty->flags & UV_HANDLE_WRITABLE) || size > UV__TTY_WRITE_BUFFER_MAX)
+    return UV_EINVAL;
+
+  return uv__stream_set_write_buffer((uv_stream_t*) tty, size);
+}
+
+
 uv_handle_type uv_guess_handle(uv_file file) {
   struct sockaddr sa;
   struct stat s;
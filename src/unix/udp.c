@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_UDP
+
 #include "uv.h"
 #include "internal.h"
 
@@ -32,6 +34,25 @@
 #endif
 #include <sys/un.h>
 
+#if defined(__linux__)
+# include <netinet/udp.h>
+# ifndef UDP_SEGMENT
+#  define UDP_SEGMENT 103
+# endif
+# ifndef UDP_GRO
+#  define UDP_GRO 104
+# endif
+# define UV__HAVE_UDP_GSO 1
+# define UV__HAVE_UDP_GRO 1
+# define UV__HAVE_UDP_PKTINFO 1  /* And receive timestamps. */
+#endif
+
+/* Limits of a uv_udp_send_segmented() request, what Linux accepts for one
+ * UDP_SEGMENT send.
+ */
+#define UV__UDP_MAX_SEGMENTS 64
+#define UV__UDP_MAX_PAYLOAD 65507
+
 #if defined(IPV6_JOIN_GROUP) && !defined(IPV6_ADD_MEMBERSHIP)
 # define IPV6_ADD_MEMBERSHIP IPV6_JOIN_GROUP
 #endif
@@ -46,17 +67,59 @@ union uv__sockaddr {
   struct sockaddr addr;
 };
 
+#if defined(UV__HAVE_UDP_PKTINFO)
+/* Room for the IP_PKTINFO or IPV6_PKTINFO control message of a datagram. */
+#define UV__UDP_PKTINFO_SPACE CMSG_SPACE(sizeof(struct in6_pktinfo))
+
+/* And for its receive timestamp. */
+#define UV__UDP_CONTROL_SPACE (UV__UDP_PKTINFO_SPACE + UV__RX_TIMESTAMP_SPACE)
+
+/* Local address and receive timestamp of the datagram that recv_cb runs
+ * for, for handles bound with UV_UDP_PKTINFO or UV_UDP_TIMESTAMP. Stored
+ * in handle->u.reserved[3].
+ */
+struct uv__udp_recv_info {
+  unsigned int flags;  /* UV_UDP_PKTINFO and UV_UDP_TIMESTAMP. */
+  union uv__sockaddr dst;  /* AF_UNSPEC when the datagram came without. */
+  uint16_t port;  /* The socket's, in network byte order. */
+  int ts_valid;
+  uv_timespec_t ts;
+  char* control;  /* recvmmsg(), UV__UDP_CONTROL_SPACE bytes per datagram. */
+  size_t ncontrol;
+};
+
+union uv__udp_src_control {
+  char buf[UV__UDP_PKTINFO_SPACE];
+  struct cmsghdr align;
+};
+#endif
+
 static void uv__udp_run_completed(uv_udp_t* handle);
-static void uv__udp_io(uv_loop_t* loop, uv__io_t* w, unsigned int revents);
 static void uv__udp_recvmsg(uv_udp_t* handle);
 static void uv__udp_sendmsg(uv_udp_t* handle);
 static int uv__udp_maybe_deferred_bind(uv_udp_t* handle,
                                        int domain,
                                        unsigned int flags);
+static ssize_t uv__udp_send_segments(uv_udp_t* handle, uv_udp_send_t* req);
 
 #if HAVE_MMSG
 
 #define UV__MMSG_MAXWIDTH 20
+#define UV__MMSG_MAX_RECV_WIDTH 1024
+#define UV__MMSG_MAX_SEND_WIDTH 128
+
+/* Receive batch set with uv_udp_set_recvmmsg(), stored in
+ * handle->u.reserved[1]. The arrays live in the same allocation.
+ */
+struct uv__udp_recvmmsg_state {
+  unsigned int capacity;
+  unsigned int width;
+  size_t msg_size;
+  int busy;
+  struct uv__mmsghdr* msgs;
+  struct iovec* iov;
+  struct sockaddr_in6* peers;
+};
 
 static int uv__udp_recvmmsg(uv_udp_t* handle, uv_buf_t* buf);
 static void uv__udp_sendmmsg(uv_udp_t* handle);
@@ -90,7 +153,7 @@ void uv__udp_close(uv_udp_t* handle) {
   uv__handle_stop(handle);
 
   if (handle->io_watcher.fd != -1) {
-    uv__close(handle->io_watcher.fd);
+    uv__close_batched(handle->loop, handle->io_watcher.fd);
     handle->io_watcher.fd = -1;
   }
 }
@@ -121,6 +184,18 @@ void uv__udp_finish_close(uv_udp_t* handle) {
   handle->recv_cb = NULL;
   handle->alloc_cb = NULL;
   /* but _do not_ touch close_cb */
+
+  uv__free(handle->u.reserved[1]);
+  handle->u.reserved[1] = NULL;
+  uv__free(handle->u.reserved[2]);
+  handle->u.reserved[2] = NULL;
+
+#if defined(UV__HAVE_UDP_PKTINFO)
+  if (handle->u.reserved[3] != NULL)
+    uv__free(((struct uv__udp_recv_info*) handle->u.reserved[3])->control);
+#endif
+  uv__free(handle->u.reserved[3]);
+  handle->u.reserved[3] = NULL;
 }
 
 
@@ -142,8 +217,10 @@ static void uv__udp_run_completed(uv_udp_t* handle) {
     handle->send_queue_count--;
 
     if (req->bufs != req->bufsml)
-      uv__free(req->bufs);
+      uv__bufs_pool_put(handle->loop, req->bufs, req->nbufs);
     req->bufs = NULL;
+    uv__free(req->reserved[2]);  /* uv_udp_send_from() source address. */
+    req->reserved[2] = NULL;
 
     if (req->send_cb == NULL)
       continue;
@@ -168,7 +245,7 @@ static void uv__udp_run_completed(uv_udp_t* handle) {
 }
 
 
-static void uv__udp_io(uv_loop_t* loop, uv__io_t* w, unsigned int revents) {
+void uv__udp_io(uv_loop_t* loop, uv__io_t* w, unsigned int revents) {
   uv_udp_t* handle;
 
   handle = container_of(w, uv_udp_t, io_watcher);
@@ -183,24 +260,146 @@ static void uv__udp_io(uv_loop_t* loop, uv__io_t* w, unsigned int revents) {
   }
 }
 
+#if defined(UV__HAVE_UDP_PKTINFO)
+/* Records the local address that the datagram that came with `h` was sent
+ * to and when, for uv_udp_get_recv_dstaddr() and uv_udp_get_recv_timestamp().
+ */
+static void uv__udp_recv_info(uv_udp_t* handle, struct msghdr* h) {
+  struct uv__udp_recv_info* ri;
+  struct in6_pktinfo in6;
+  struct in_pktinfo in;
+  struct cmsghdr* cmsg;
+
+  ri = handle->u.reserved[3];
+  if (ri == NULL)
+    return;
+
+  ri->ts_valid = 0;
+  if (ri->flags & UV_UDP_TIMESTAMP)
+    ri->ts_valid = uv__rx_timestamp(h, &ri->ts) == 0;
+
+  memset(&ri->dst, 0, sizeof(ri->dst));
+  ri->dst.addr.sa_family = AF_UNSPEC;
+  if (!(ri->flags & UV_UDP_PKTINFO) || (h->msg_flags & MSG_CTRUNC))
+    return;
+
+  for (cmsg = CMSG_FIRSTHDR(h); cmsg != NULL; cmsg = CMSG_NXTHDR(h, cmsg)) {
+    if (cmsg->cmsg_level == IPPROTO_IP && cmsg->cmsg_type == IP_PKTINFO) {
+      memcpy(&in, CMSG_DATA(cmsg), sizeof(in));
+      ri->dst.in.sin_family = AF_INET;
+      ri->dst.in.sin_port = ri->port;
+      ri->dst.in.sin_addr = in.ipi_addr;
+      return;
+    }
+
+    if (cmsg->cmsg_level == IPPROTO_IPV6 && cmsg->cmsg_type == IPV6_PKTINFO) {
+      memcpy(&in6, CMSG_DATA(cmsg), sizeof(in6));
+      ri->dst.in6.sin6_family = AF_INET6;
+      ri->dst.in6.sin6_port = ri->port;
+      ri->dst.in6.sin6_addr = in6.ipi6_addr;
+      if (IN6_IS_ADDR_LINKLOCAL(&in6.ipi6_addr))
+        ri->dst.in6.sin6_scope_id = in6.ipi6_ifindex;
+      return;
+    }
+  }
+}
+
+
+/* Returns room for the control messages of `n` datagrams for recvmmsg(), or
+ * NULL if that can't be allocated; the datagrams then come without.
+ */
+static char* uv__udp_recv_control(uv_udp_t* handle, size_t n) {
+  struct uv__udp_recv_info* ri;
+  char* control;
+
+  ri = handle->u.reserved[3];
+  if (ri->ncontrol < n) {
+    control = uv__realloc(ri->control, n * UV__UDP_CONTROL_SPACE);
+    if (control == NULL)
+      return NULL;
+    ri->control = control;
+    ri->ncontrol = n;
+  }
+
+  return ri->control;
+}
+
+
+/* Points `h` at a control message in `control` that sends from `src`. */
+static void uv__udp_pktinfo_send(struct msghdr* h,
+                                 const union uv__sockaddr* src,
+                                 union uv__udp_src_control* control) {
+  struct in6_pktinfo in6;
+  struct in_pktinfo in;
+  struct cmsghdr* cmsg;
+
+  memset(control, 0, sizeof(*control));
+  h->msg_control = control->buf;
+  h->msg_controllen = sizeof(control->buf);
+  cmsg = CMSG_FIRSTHDR(h);
+
+  if (src->addr.sa_family == AF_INET) {
+    memset(&in, 0, sizeof(in));
+    in.ipi_spec_dst = src->in.sin_addr;
+    cmsg->cmsg_level = IPPROTO_IP;
+    cmsg->cmsg_type = IP_PKTINFO;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(in));
+    memcpy(CMSG_DATA(cmsg), &in, sizeof(in));
+    h->msg_controllen = CMSG_SPACE(sizeof(in));
+  } else {
+    memset(&in6, 0, sizeof(in6));
+    in6.ipi6_addr = src->in6.sin6_addr;
+    in6.ipi6_ifindex = src->in6.sin6_scope_id;
+    cmsg->cmsg_level = IPPROTO_IPV6;
+    cmsg->cmsg_type = IPV6_PKTINFO;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(in6));
+    memcpy(CMSG_DATA(cmsg), &in6, sizeof(in6));
+    h->msg_controllen = CMSG_SPACE(sizeof(in6));
+  }
+}
+#endif
+
 #if HAVE_MMSG
 static int uv__udp_recvmmsg(uv_udp_t* handle, uv_buf_t* buf) {
-  struct sockaddr_in6 peers[UV__MMSG_MAXWIDTH];
-  struct iovec iov[UV__MMSG_MAXWIDTH];
-  struct uv__mmsghdr msgs[UV__MMSG_MAXWIDTH];
+  struct sockaddr_in6 default_peers[UV__MMSG_MAXWIDTH];
+  struct iovec default_iov[UV__MMSG_MAXWIDTH];
+  struct uv__mmsghdr default_msgs[UV__MMSG_MAXWIDTH];
+  struct uv__udp_recvmmsg_state* state;
+  struct sockaddr_in6* peers;
+  struct iovec* iov;
+  struct uv__mmsghdr* msgs;
+  uv_io_stats_t* stats;
   ssize_t nread;
   uv_buf_t chunk_buf;
+  size_t msg_size;
   size_t chunks;
+#if defined(UV__HAVE_UDP_PKTINFO)
+  char* control;
+#endif
   int flags;
   size_t k;
 
+  state = handle->u.reserved[1];
+  if (state != NULL) {
+    peers = state->peers;
+    iov = state->iov;
+    msgs = state->msgs;
+    msg_size = state->msg_size;
+    chunks = state->width;
+  } else {
+    peers = default_peers;
+    iov = default_iov;
+    msgs = default_msgs;
+    msg_size = UV__UDP_DGRAM_MAXSIZE;
+    chunks = UV__MMSG_MAXWIDTH;
+  }
+
   /* prepare structures for recvmmsg */
-  chunks = buf->len / UV__UDP_DGRAM_MAXSIZE;
-  if (chunks > ARRAY_SIZE(iov))
-    chunks = ARRAY_SIZE(iov);
+  if (chunks > buf->len / msg_size)
+    chunks = buf->len / msg_size;
   for (k = 0; k < chunks; ++k) {
-    iov[k].iov_base = buf->base + k * UV__UDP_DGRAM_MAXSIZE;
-    iov[k].iov_len = UV__UDP_DGRAM_MAXSIZE;
+    iov[k].iov_base = buf->base + k * msg_size;
+    iov[k].iov_len = msg_size;
     memset(&msgs[k].msg_hdr, 0, sizeof(msgs[k].msg_hdr));
     msgs[k].msg_hdr.msg_iov = iov + k;
     msgs[k].msg_hdr.msg_iovlen = 1;
@@ -211,22 +410,49 @@ static int uv__udp_recvmmsg(uv_udp_t* handle, uv_buf_t* buf) {
     msgs[k].msg_hdr.msg_flags = 0;
   }
 
+#if defined(UV__HAVE_UDP_PKTINFO)
+  control = NULL;
+  if (handle->u.reserved[3] != NULL)
+    control = uv__udp_recv_control(handle, chunks);
+  for (k = 0; control != NULL && k < chunks; ++k) {
+    msgs[k].msg_hdr.msg_control = control + k * UV__UDP_CONTROL_SPACE;
+    msgs[k].msg_hdr.msg_controllen = UV__UDP_CONTROL_SPACE;
+  }
+#endif
+
   do
     nread = uv__recvmmsg(handle->io_watcher.fd, msgs, chunks);
   while (nread == -1 && errno == EINTR);
 
+  stats = handle->u.reserved[2];
+  if (stats != NULL) {
+    stats->read_calls++;
+    if (nread == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      stats->read_eagain++;
+    for (k = 0; nread > 0 && k < (size_t) nread; k++)
+      stats->bytes_read += msgs[k].msg_len;
+  }
+
   if (nread < 1) {
-    if (nread == 0 || errno == EAGAIN || errno == EWOULDBLOCK)
+    if (nread == 0 || errno == EAGAIN || errno == EWOULDBLOCK) {
       handle->recv_cb(handle, 0, buf, NULL, 0);
-    else
+    } else {
+      /* More datagrams may be queued behind the error. */
+      uv__io_ready(handle->loop, &handle->io_watcher, POLLIN);
       handle->recv_cb(handle, UV__ERR(errno), buf, NULL, 0);
+    }
   } else {
     /* pass each chunk to the application */
+    if (state != NULL)
+      state->busy = 1;
     for (k = 0; k < (size_t) nread && handle->recv_cb != NULL; k++) {
       flags = UV_UDP_MMSG_CHUNK;
       if (msgs[k].msg_hdr.msg_flags & MSG_TRUNC)
         flags |= UV_UDP_PARTIAL;
 
+#if defined(UV__HAVE_UDP_PKTINFO)
+      uv__udp_recv_info(handle, &msgs[k].msg_hdr);
+#endif
       chunk_buf = uv_buf_init(iov[k].iov_base, iov[k].iov_len);
       handle->recv_cb(handle,
                       msgs[k].msg_len,
@@ -235,12 +461,51 @@ static int uv__udp_recvmmsg(uv_udp_t* handle, uv_buf_t* buf) {
                       flags);
     }
 
+    if (state != NULL)
+      state->busy = 0;
+
     /* one last callback so the original buffer is freed */
     if (handle->recv_cb != NULL)
       handle->recv_cb(handle, 0, buf, NULL, UV_UDP_MMSG_FREE);
   }
   return nread;
 }
+
+
+/* Returns the alloc_cb size hint for a batch configured with
+ * uv_udp_set_recvmmsg().
+ */
+static size_t uv__udp_recvmmsg_size(uv_udp_t* handle) {
+  struct uv__udp_recvmmsg_state* state;
+
+  state = handle->u.reserved[1];
+  if (state == NULL)
+    return UV__UDP_DGRAM_MAXSIZE;
+
+  return state->width * state->msg_size;
+}
+#endif
+
+#if defined(UV__HAVE_UDP_GRO)
+/* Returns the size of the datagrams the kernel coalesced into the buffer that
+ * came with `h`, or 0 if the UDP_GRO control message is absent.
+ */
+static size_t uv__udp_gro_segment_size(struct msghdr* h) {
+  struct cmsghdr* cmsg;
+  int size;
+
+  if (h->msg_flags & MSG_CTRUNC)
+    return 0;
+
+  for (cmsg = CMSG_FIRSTHDR(h); cmsg != NULL; cmsg = CMSG_NXTHDR(h, cmsg)) {
+    if (cmsg->cmsg_level != IPPROTO_UDP || cmsg->cmsg_type != UDP_GRO)
+      continue;
+    memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+    return size > 0 ? (size_t) size : 0;
+  }
+
+  return 0;
+}
 #endif
 
 static void uv__udp_recvmsg(uv_udp_t* handle) {
@@ -248,28 +513,47 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
   struct msghdr h;
   ssize_t nread;
   uv_buf_t buf;
+  size_t segment_size;
+  size_t suggested_size;
   int flags;
   int count;
+#if defined(UV__HAVE_UDP_GRO)
+  union {
+    char buf[CMSG_SPACE(sizeof(int)) + UV__UDP_CONTROL_SPACE];
+    struct cmsghdr align;
+  } control;
+#endif
 
   assert(handle->recv_cb != NULL);
   assert(handle->alloc_cb != NULL);
 
   /* Prevent loop starvation when the data comes in as fast as (or faster than)
-   * we can read it. XXX Need to rearm fd if we switch to edge-triggered I/O.
+   * we can read it. Edge-triggered watchers are rearmed with uv__io_ready()
+   * when we stop before EAGAIN.
    */
   count = 32;
 
+  suggested_size = UV__UDP_DGRAM_MAXSIZE;
+#if HAVE_MMSG
+  if (!(handle->flags & UV_HANDLE_UDP_GRO) && uv_udp_using_recvmmsg(handle))
+    suggested_size = uv__udp_recvmmsg_size(handle);
+#endif
+
   do {
     buf = uv_buf_init(NULL, 0);
-    handle->alloc_cb((uv_handle_t*) handle, UV__UDP_DGRAM_MAXSIZE, &buf);
+    handle->alloc_cb((uv_handle_t*) handle, suggested_size, &buf);
     if (buf.base == NULL || buf.len == 0) {
       handle->recv_cb(handle, UV_ENOBUFS, &buf, NULL, 0);
+      uv__io_ready(handle->loop, &handle->io_watcher, POLLIN);
       return;
     }
     assert(buf.base != NULL);
 
 #if HAVE_MMSG
-    if (uv_udp_using_recvmmsg(handle)) {
+    /* A GRO buffer already carries many datagrams, so it wins over recvmmsg;
+     * the coalesced segment size only comes with a single recvmsg().
+     */
+    if (!(handle->flags & UV_HANDLE_UDP_GRO) && uv_udp_using_recvmmsg(handle)) {
       nread = uv__udp_recvmmsg(handle, &buf);
       if (nread > 0)
         count -= nread;
@@ -283,23 +567,48 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
     h.msg_namelen = sizeof(peer);
     h.msg_iov = (void*) &buf;
     h.msg_iovlen = 1;
+#if defined(UV__HAVE_UDP_GRO)
+    if (handle->flags & UV_HANDLE_UDP_GRO || handle->u.reserved[3] != NULL) {
+      h.msg_control = &control;
+      h.msg_controllen = sizeof(control);
+    }
+#endif
 
     do {
       nread = recvmsg(handle->io_watcher.fd, &h, 0);
     }
     while (nread == -1 && errno == EINTR);
 
+    uv__io_stats_read(handle->u.reserved[2], nread);
+
     if (nread == -1) {
-      if (errno == EAGAIN || errno == EWOULDBLOCK)
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
         handle->recv_cb(handle, 0, &buf, NULL, 0);
-      else
+      } else {
+        /* More datagrams may be queued behind the error. */
+        uv__io_ready(handle->loop, &handle->io_watcher, POLLIN);
         handle->recv_cb(handle, UV__ERR(errno), &buf, NULL, 0);
+      }
     }
     else {
       flags = 0;
       if (h.msg_flags & MSG_TRUNC)
         flags |= UV_UDP_PARTIAL;
 
+      segment_size = 0;
+#if defined(UV__HAVE_UDP_GRO)
+      if (handle->flags & UV_HANDLE_UDP_GRO)
+        segment_size = uv__udp_gro_segment_size(&h);
+      if (segment_size >= (size_t) nread)
+        segment_size = 0;
+      if (segment_size != 0)
+        flags |= UV_UDP_GRO_SEGMENTS;
+#endif
+      handle->u.reserved[0] = (void*) (uintptr_t) segment_size;
+#if defined(UV__HAVE_UDP_PKTINFO)
+      uv__udp_recv_info(handle, &h);
+#endif
+
       handle->recv_cb(handle, nread, &buf, (const struct sockaddr*) &peer, flags);
     }
     count--;
@@ -309,6 +618,9 @@ static void uv__udp_recvmsg(uv_udp_t* handle) {
       && count > 0
       && handle->io_watcher.fd != -1
       && handle->recv_cb != NULL);
+
+  if (nread != -1)
+    uv__io_ready(handle->loop, &handle->io_watcher, POLLIN);
 }
 
 #if HAVE_MMSG
@@ -316,6 +628,9 @@ static void uv__udp_sendmmsg(uv_udp_t* handle) {
   uv_udp_send_t* req;
   struct uv__mmsghdr h[UV__MMSG_MAXWIDTH];
   struct uv__mmsghdr *p;
+#if defined(UV__HAVE_UDP_PKTINFO)
+  union uv__udp_src_control src_control[UV__MMSG_MAXWIDTH];
+#endif
   QUEUE* q;
   ssize_t npkts;
   size_t pkts;
@@ -332,6 +647,10 @@ write_queue_drain:
     req = QUEUE_DATA(q, uv_udp_send_t, queue);
     assert(req != NULL);
 
+    /* Segmented sends go out on their own, see below. */
+    if (req->reserved[0] != NULL)
+      break;
+
     p = &h[pkts];
     memset(p, 0, sizeof(*p));
     if (req->addr.ss_family == AF_UNSPEC) {
@@ -352,6 +671,24 @@ write_queue_drain:
     }
     h[pkts].msg_hdr.msg_iov = (struct iovec*) req->bufs;
     h[pkts].msg_hdr.msg_iovlen = req->nbufs;
+#if defined(UV__HAVE_UDP_PKTINFO)
+    if (req->reserved[2] != NULL)
+      uv__udp_pktinfo_send(&p->msg_hdr, req->reserved[2], &src_control[pkts]);
+#endif
+  }
+
+  if (pkts == 0) {
+    npkts = uv__udp_send_segments(handle, req);
+    if (npkts == UV_EAGAIN)
+      return;
+
+    req->status = npkts;
+    QUEUE_REMOVE(&req->queue);
+    QUEUE_INSERT_TAIL(&handle->write_completed_queue, &req->queue);
+    if (!QUEUE_EMPTY(&handle->write_queue))
+      goto write_queue_drain;
+    uv__io_feed(handle->loop, &handle->io_watcher);
+    return;
   }
 
   do
@@ -405,9 +742,161 @@ write_queue_drain:
 }
 #endif
 
+static socklen_t uv__udp_req_namelen(const uv_udp_send_t* req) {
+  if (req->addr.ss_family == AF_INET6)
+    return sizeof(struct sockaddr_in6);
+  if (req->addr.ss_family == AF_INET)
+    return sizeof(struct sockaddr_in);
+  if (req->addr.ss_family == AF_UNIX)
+    return sizeof(struct sockaddr_un);
+  return 0;  /* AF_UNSPEC, connected socket. */
+}
+
+
+/* Send a uv_udp_send_segmented() request: one UDP_SEGMENT sendmsg() where
+ * the kernel supports it, one datagram per segment otherwise. Returns the
+ * number of bytes sent, UV_EAGAIN if the socket is full or an error. The
+ * number of bytes sent so far is kept in req->reserved[1] in between.
+ */
+static ssize_t uv__udp_send_segments(uv_udp_t* handle, uv_udp_send_t* req) {
+#if defined(UV__HAVE_UDP_GSO)
+  char control[CMSG_SPACE(sizeof(uint16_t))];
+  struct cmsghdr* cmsg;
+  uint16_t gso_size;
+#endif
+#if HAVE_MMSG
+  struct uv__mmsghdr mh[UV__MMSG_MAXWIDTH];
+  struct iovec iovs[UV__MMSG_MAXWIDTH];
+  size_t n;
+#endif
+  struct msghdr h;
+  struct iovec iov;
+  size_t segment_size;
+  size_t offset;
+  size_t len;
+  char* base;
+  ssize_t r;
+
+  segment_size = (uintptr_t) req->reserved[0];
+  offset = (uintptr_t) req->reserved[1];
+  base = req->bufs[0].base;
+  len = req->bufs[0].len;
+
+  memset(&h, 0, sizeof(h));
+  if (req->addr.ss_family != AF_UNSPEC) {
+    h.msg_name = &req->addr;
+    h.msg_namelen = uv__udp_req_namelen(req);
+  }
+
+#if defined(UV__HAVE_UDP_GSO)
+  if (offset == 0 && len > segment_size) {
+    iov.iov_base = base;
+    iov.iov_len = len;
+    h.msg_iov = &iov;
+    h.msg_iovlen = 1;
+
+    memset(control, 0, sizeof(control));
+    h.msg_control = control;
+    h.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&h);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(gso_size));
+    gso_size = segment_size;
+    memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+
+    do
+      r = sendmsg(handle->io_watcher.fd, &h, 0);
+    while (r == -1 && errno == EINTR);
+
+    if (r >= 0)
+      return r;
+
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+      return UV_EAGAIN;
+
+    /* Kernels before 4.18 don't know UDP_SEGMENT and devices without
+     * checksum offload fail with EIO. Send the segments one by one.
+     */
+    if (errno != EIO &&
+        errno != EINVAL &&
+        errno != ENOPROTOOPT &&
+        errno != EOPNOTSUPP) {
+      return UV__ERR(errno);
+    }
+
+    h.msg_control = NULL;
+    h.msg_controllen = 0;
+  }
+#endif  /* defined(UV__HAVE_UDP_GSO) */
+
+  while (offset < len) {
+#if HAVE_MMSG
+    if (uv__sendmmsg_avail) {
+      for (n = 0; n < UV__MMSG_MAXWIDTH && offset < len; n++) {
+        iovs[n].iov_base = base + offset;
+        iovs[n].iov_len = len - offset;
+        if (iovs[n].iov_len > segment_size)
+          iovs[n].iov_len = segment_size;
+        offset += iovs[n].iov_len;
+
+        memset(&mh[n], 0, sizeof(mh[n]));
+        mh[n].msg_hdr.msg_name = h.msg_name;
+        mh[n].msg_hdr.msg_namelen = h.msg_namelen;
+        mh[n].msg_hdr.msg_iov = &iovs[n];
+        mh[n].msg_hdr.msg_iovlen = 1;
+      }
+
+      do
+        r = uv__sendmmsg(handle->io_watcher.fd, mh, n);
+      while (r == -1 && errno == EINTR);
+
+      /* Rewind to the first segment that didn't go out. */
+      while (n > (size_t) (r > 0 ? r : 0))
+        offset -= iovs[--n].iov_len;
+
+      if (r < 1)
+        goto error;
+
+      continue;
+    }
+#endif  /* HAVE_MMSG */
+
+    iov.iov_base = base + offset;
+    iov.iov_len = len - offset;
+    if (iov.iov_len > segment_size)
+      iov.iov_len = segment_size;
+    h.msg_iov = &iov;
+    h.msg_iovlen = 1;
+
+    do
+      r = sendmsg(handle->io_watcher.fd, &h, 0);
+    while (r == -1 && errno == EINTR);
+
+    if (r == -1)
+      goto error;
+
+    offset += iov.iov_len;
+  }
+
+  return len;
+
+error:
+  if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+    req->reserved[1] = (void*) (uintptr_t) offset;
+    return UV_EAGAIN;
+  }
+
+  return UV__ERR(errno);
+}
+
+
 static void uv__udp_sendmsg(uv_udp_t* handle) {
   uv_udp_send_t* req;
   struct msghdr h;
+#if defined(UV__HAVE_UDP_PKTINFO)
+  union uv__udp_src_control src_control;
+#endif
   QUEUE* q;
   ssize_t size;
 
@@ -426,6 +915,18 @@ static void uv__udp_sendmsg(uv_udp_t* handle) {
     req = QUEUE_DATA(q, uv_udp_send_t, queue);
     assert(req != NULL);
 
+    if (req->reserved[0] != NULL) {
+      size = uv__udp_send_segments(handle, req);
+      if (size == UV_EAGAIN)
+        break;
+
+      req->status = size;
+      QUEUE_REMOVE(&req->queue);
+      QUEUE_INSERT_TAIL(&handle->write_completed_queue, &req->queue);
+      uv__io_feed(handle->loop, &handle->io_watcher);
+      continue;
+    }
+
     memset(&h, 0, sizeof h);
     if (req->addr.ss_family == AF_UNSPEC) {
       h.msg_name = NULL;
@@ -445,6 +946,10 @@ static void uv__udp_sendmsg(uv_udp_t* handle) {
     }
     h.msg_iov = (struct iovec*) req->bufs;
     h.msg_iovlen = req->nbufs;
+#if defined(UV__HAVE_UDP_PKTINFO)
+    if (req->reserved[2] != NULL)
+      uv__udp_pktinfo_send(&h, req->reserved[2], &src_control);
+#endif
 
     do {
       size = sendmsg(handle->io_watcher.fd, &h, 0);
@@ -506,6 +1011,35 @@ static int uv__set_reuse(int fd) {
   return 0;
 }
 
+static int uv__set_reuseport(int fd) {
+  int yes;
+
+  yes = 1;
+  /* FreeBSD's plain SO_REUSEPORT doesn't balance between sockets. */
+#if defined(SO_REUSEPORT_LB)
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT_LB, &yes, sizeof(yes)))
+    return UV__ERR(errno);
+#elif defined(SO_REUSEPORT) && !defined(__MVS__)
+  if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)))
+    return UV__ERR(errno);
+#else
+  return UV_ENOTSUP;
+#endif
+
+  return 0;
+}
+
+static int uv__set_gro(int fd) {
+#if defined(UV__HAVE_UDP_GRO)
+  int yes;
+
+  yes = 1;
+  if (setsockopt(fd, IPPROTO_UDP, UDP_GRO, &yes, sizeof(yes)))
+    return UV__ERR(errno);
+#endif
+  return 0;
+}
+
 /*
  * The Linux kernel suppresses some ICMP error messages by default for UDP
  * sockets. Setting IP_RECVERR/IPV6_RECVERR on the socket enables full ICMP
@@ -529,6 +1063,61 @@ static int uv__set_recverr(int fd, sa_family_t ss_family) {
 }
 
 
+#if defined(UV__HAVE_UDP_PKTINFO)
+/* Asks for the destination address and receive timestamp of the datagrams
+ * on a bound socket, as `flags` says. IPv6 sockets ask for IP_PKTINFO too,
+ * for IPv4 datagrams to v4-mapped addresses.
+ */
+static int uv__udp_set_recv_info(uv_udp_t* handle,
+                                 int fd,
+                                 int family,
+                                 unsigned int flags) {
+  struct uv__udp_recv_info* ri;
+  union uv__sockaddr addr;
+  socklen_t addrlen;
+  int err;
+  int yes;
+
+  yes = 1;
+  addrlen = sizeof(addr);
+  if (flags & UV_UDP_PKTINFO) {
+    if (family == AF_INET6) {
+      if (setsockopt(fd, IPPROTO_IPV6, IPV6_RECVPKTINFO, &yes, sizeof(yes)))
+        return UV__ERR(errno);
+      setsockopt(fd, IPPROTO_IP, IP_PKTINFO, &yes, sizeof(yes));
+    } else {
+      if (setsockopt(fd, IPPROTO_IP, IP_PKTINFO, &yes, sizeof(yes)))
+        return UV__ERR(errno);
+    }
+
+    if (getsockname(fd, &addr.addr, &addrlen))
+      return UV__ERR(errno);
+  }
+
+  if (flags & UV_UDP_TIMESTAMP) {
+    err = uv__rx_timestamps(fd, 1);
+    if (err)
+      return err;
+  }
+
+  ri = handle->u.reserved[3];
+  if (ri == NULL) {
+    ri = uv__calloc(1, sizeof(*ri));
+    if (ri == NULL)
+      return UV_ENOMEM;
+    handle->u.reserved[3] = ri;
+  }
+
+  ri->flags = flags & (UV_UDP_PKTINFO | UV_UDP_TIMESTAMP);
+  ri->dst.addr.sa_family = AF_UNSPEC;
+  ri->ts_valid = 0;
+  if (flags & UV_UDP_PKTINFO)
+    ri->port = family == AF_INET6 ? addr.in6.sin6_port : addr.in.sin_port;
+  return 0;
+}
+#endif
+
+
 int uv__udp_bind(uv_udp_t* handle,
                  const struct sockaddr* addr,
                  unsigned int addrlen,
@@ -538,9 +1127,20 @@ int uv__udp_bind(uv_udp_t* handle,
   int fd;
 
   /* Check for bad flags. */
-  if (flags & ~(UV_UDP_IPV6ONLY | UV_UDP_REUSEADDR | UV_UDP_LINUX_RECVERR))
+  if (flags & ~(UV_UDP_IPV6ONLY |
+                UV_UDP_REUSEADDR |
+                UV_UDP_LINUX_RECVERR |
+                UV_UDP_LINUX_GRO |
+                UV_UDP_REUSEPORT |
+                UV_UDP_PKTINFO |
+                UV_UDP_TIMESTAMP))
     return UV_EINVAL;
 
+#if !defined(UV__HAVE_UDP_PKTINFO)
+  if (flags & (UV_UDP_PKTINFO | UV_UDP_TIMESTAMP))
+    return UV_ENOTSUP;
+#endif
+
   /* Cannot set IPv6-only mode on non-IPv6 socket. */
   if ((flags & UV_UDP_IPV6ONLY) && addr->sa_family != AF_INET6)
     return UV_EINVAL;
@@ -560,12 +1160,25 @@ int uv__udp_bind(uv_udp_t* handle,
       return err;
   }
 
+  if (flags & UV_UDP_LINUX_GRO) {
+    err = uv__set_gro(fd);
+    if (err)
+      return err;
+    handle->flags |= UV_HANDLE_UDP_GRO;
+  }
+
   if (flags & UV_UDP_REUSEADDR) {
     err = uv__set_reuse(fd);
     if (err)
       return err;
   }
 
+  if (flags & UV_UDP_REUSEPORT) {
+    err = uv__set_reuseport(fd);
+    if (err)
+      return err;
+  }
+
   if (flags & UV_UDP_IPV6ONLY) {
 #ifdef IPV6_V6ONLY
     yes = 1;
@@ -588,6 +1201,14 @@ int uv__udp_bind(uv_udp_t* handle,
     return err;
   }
 
+#if defined(UV__HAVE_UDP_PKTINFO)
+  if (flags & (UV_UDP_PKTINFO | UV_UDP_TIMESTAMP)) {
+    err = uv__udp_set_recv_info(handle, fd, addr->sa_family, flags);
+    if (err)
+      return err;
+  }
+#endif
+
   if (addr->sa_family == AF_INET6)
     handle->flags |= UV_HANDLE_IPV6;
 
@@ -720,13 +1341,16 @@ int uv__udp_disconnect(uv_udp_t* handle) {
     return 0;
 }
 
-int uv__udp_send(uv_udp_send_t* req,
-                 uv_udp_t* handle,
-                 const uv_buf_t bufs[],
-                 unsigned int nbufs,
-                 const struct sockaddr* addr,
-                 unsigned int addrlen,
-                 uv_udp_send_cb send_cb) {
+static int uv__udp_queue_send(uv_udp_send_t* req,
+                              uv_udp_t* handle,
+                              const uv_buf_t bufs[],
+                              unsigned int nbufs,
+                              const struct sockaddr* addr,
+                              unsigned int addrlen,
+                              size_t segment_size,
+                              const struct sockaddr* src,
+                              uv_udp_send_cb send_cb) {
+  union uv__sockaddr* src_copy;
   int err;
   int empty_queue;
 
@@ -738,6 +1362,17 @@ int uv__udp_send(uv_udp_send_t* req,
       return err;
   }
 
+  src_copy = NULL;
+  if (src != NULL) {
+    src_copy = uv__malloc(sizeof(*src_copy));
+    if (src_copy == NULL)
+      return UV_ENOMEM;
+    if (src->sa_family == AF_INET6)
+      memcpy(src_copy, src, sizeof(struct sockaddr_in6));
+    else
+      memcpy(src_copy, src, sizeof(struct sockaddr_in));
+  }
+
   /* It's legal for send_queue_count > 0 even when the write_queue is empty;
    * it means there are error-state requests in the write_completed_queue that
    * will touch up send_queue_size/count later.
@@ -753,13 +1388,17 @@ int uv__udp_send(uv_udp_send_t* req,
   req->send_cb = send_cb;
   req->handle = handle;
   req->nbufs = nbufs;
+  req->reserved[0] = (void*) (uintptr_t) segment_size;
+  req->reserved[1] = NULL;
+  req->reserved[2] = src_copy;
 
   req->bufs = req->bufsml;
   if (nbufs > ARRAY_SIZE(req->bufsml))
-    req->bufs = uv__malloc(nbufs * sizeof(bufs[0]));
+    req->bufs = uv__bufs_pool_get(handle->loop, nbufs);
 
   if (req->bufs == NULL) {
     uv__req_unregister(handle->loop, req);
+    uv__free(src_copy);
     return UV_ENOMEM;
   }
 
@@ -786,6 +1425,82 @@ int uv__udp_send(uv_udp_send_t* req,
 }
 
 
+int uv__udp_send(uv_udp_send_t* req,
+                 uv_udp_t* handle,
+                 const uv_buf_t bufs[],
+                 unsigned int nbufs,
+                 const struct sockaddr* addr,
+                 unsigned int addrlen,
+                 uv_udp_send_cb send_cb) {
+  return uv__udp_queue_send(req,
+                            handle,
+                            bufs,
+                            nbufs,
+                            addr,
+                            addrlen,
+                            0,
+                            NULL,
+                            send_cb);
+}
+
+
+int uv__udp_send_segmented(uv_udp_send_t* req,
+                           uv_udp_t* handle,
+                           const uv_buf_t* buf,
+                           size_t segment_size,
+                           const struct sockaddr* addr,
+                           unsigned int addrlen,
+                           uv_udp_send_cb send_cb) {
+  if (segment_size == 0 || buf->len == 0)
+    return UV_EINVAL;
+
+  if (buf->len > UV__UDP_MAX_PAYLOAD ||
+      (buf->len + segment_size - 1) / segment_size > UV__UDP_MAX_SEGMENTS) {
+    return UV_EMSGSIZE;
+  }
+
+  return uv__udp_queue_send(req,
+                            handle,
+                            buf,
+                            1,
+                            addr,
+                            addrlen,
+                            segment_size,
+                            NULL,
+                            send_cb);
+}
+
+
+int uv__udp_send_from(uv_udp_send_t* req,
+                      uv_udp_t* handle,
+                      const uv_buf_t bufs[],
+                      unsigned int nbufs,
+                      const struct sockaddr* addr,
+                      unsigned int addrlen,
+                      const struct sockaddr* src,
+                      uv_udp_send_cb send_cb) {
+#if defined(UV__HAVE_UDP_PKTINFO)
+  /* An IPv4 source is fine for IPv6 sockets, for v4-mapped peers. */
+  if (src->sa_family == AF_INET6 && addr != NULL &&
+      addr->sa_family == AF_INET) {
+    return UV_EINVAL;
+  }
+
+  return uv__udp_queue_send(req,
+                            handle,
+                            bufs,
+                            nbufs,
+                            addr,
+                            addrlen,
+                            0,
+                            src,
+                            send_cb);
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
 int uv__udp_try_send(uv_udp_t* handle,
                      const uv_buf_t bufs[],
                      unsigned int nbufs,
@@ -830,6 +1545,87 @@ int uv__udp_try_send(uv_udp_t* handle,
 }
 
 
+int uv__udp_try_send_batch(uv_udp_t* handle,
+                           const uv_buf_t bufs[],
+                           const struct sockaddr* const addrs[],
+                           unsigned int count) {
+#if HAVE_MMSG
+  struct uv__mmsghdr h[UV__MMSG_MAX_SEND_WIDTH];
+  unsigned int pkts;
+  int npkts;
+#endif
+  const struct sockaddr* addr;
+  unsigned int sent;
+  unsigned int i;
+  int err;
+
+  /* already sending a message */
+  if (handle->send_queue_count != 0)
+    return UV_EAGAIN;
+
+  addr = addrs ? addrs[0] : NULL;
+  if (addr != NULL) {
+    err = uv__udp_maybe_deferred_bind(handle, addr->sa_family, 0);
+    if (err)
+      return err;
+  } else {
+    assert(handle->flags & UV_HANDLE_UDP_CONNECTED);
+  }
+
+  sent = 0;
+
+#if HAVE_MMSG
+  uv_once(&once, uv__udp_mmsg_init);
+  while (uv__sendmmsg_avail && sent < count) {
+    pkts = count - sent;
+    if (pkts > ARRAY_SIZE(h))
+      pkts = ARRAY_SIZE(h);
+
+    memset(h, 0, pkts * sizeof(h[0]));
+    for (i = 0; i < pkts; i++) {
+      addr = addrs ? addrs[sent + i] : NULL;
+      if (addr != NULL) {
+        h[i].msg_hdr.msg_name = (struct sockaddr*) addr;
+        h[i].msg_hdr.msg_namelen = uv__udp_check_before_send(handle, addr);
+      }
+      h[i].msg_hdr.msg_iov = (struct iovec*) &bufs[sent + i];
+      h[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    do
+      npkts = uv__sendmmsg(handle->io_watcher.fd, h, pkts);
+    while (npkts == -1 && errno == EINTR);
+
+    if (npkts == -1) {
+      if (sent > 0)
+        return sent;
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+        return UV_EAGAIN;
+      return UV__ERR(errno);
+    }
+
+    sent += npkts;
+    if ((unsigned int) npkts < pkts)
+      return sent;
+  }
+#endif
+
+  /* No sendmmsg(), one datagram per system call. */
+  for (i = sent; i < count; i++) {
+    addr = addrs ? addrs[i] : NULL;
+    err = uv__udp_try_send(handle,
+                           &bufs[i],
+                           1,
+                           addr,
+                           addr ? uv__udp_check_before_send(handle, addr) : 0);
+    if (err < 0)
+      return i > 0 ? (int) i : err;
+  }
+
+  return count;
+}
+
+
 static int uv__udp_set_membership4(uv_udp_t* handle,
                                    const struct sockaddr_in* multicast_addr,
                                    const char* interface_addr,
@@ -1042,6 +1838,10 @@ int uv__udp_init_ex(uv_loop_t* loop,
   handle->recv_cb = NULL;
   handle->send_queue_size = 0;
   handle->send_queue_count = 0;
+  handle->u.reserved[0] = NULL;  /* GRO segment size of the last read. */
+  handle->u.reserved[1] = NULL;  /* uv_udp_set_recvmmsg() batch. */
+  handle->u.reserved[2] = NULL;  /* uv_handle_set_io_stats() counters. */
+  handle->u.reserved[3] = NULL;  /* UV_UDP_PKTINFO, UV_UDP_TIMESTAMP. */
   uv__io_init(&handle->io_watcher, uv__udp_io, fd);
   QUEUE_INIT(&handle->write_queue);
   QUEUE_INIT(&handle->write_completed_queue);
@@ -1061,6 +1861,183 @@ int uv_udp_using_recvmmsg(const uv_udp_t* handle) {
 }
 
 
+int uv_udp_set_recvmmsg(uv_udp_t* handle,
+                        unsigned int nmsgs,
+                        size_t msg_size) {
+#if HAVE_MMSG
+  struct uv__udp_recvmmsg_state* state;
+  char* p;
+
+  if (nmsgs == 0 || nmsgs > UV__MMSG_MAX_RECV_WIDTH)
+    return UV_EINVAL;
+
+  if (msg_size == 0 || msg_size > UV__UDP_DGRAM_MAXSIZE)
+    return UV_EINVAL;
+
+  if (!uv_udp_using_recvmmsg(handle))
+    return UV_ENOTSUP;
+
+  /* The arrays are in use while recv_cb runs for each chunk. */
+  state = handle->u.reserved[1];
+  if (state != NULL && state->busy)
+    return UV_EBUSY;
+
+  if (state == NULL || state->capacity < nmsgs) {
+    p = uv__malloc(sizeof(*state) +
+                   nmsgs * (sizeof(*state->msgs) +
+                            sizeof(*state->iov) +
+                            sizeof(*state->peers)));
+    if (p == NULL)
+      return UV_ENOMEM;
+
+    uv__free(state);
+    state = (struct uv__udp_recvmmsg_state*) p;
+    p += sizeof(*state);
+    state->msgs = (struct uv__mmsghdr*) p;
+    p += nmsgs * sizeof(*state->msgs);
+    state->iov = (struct iovec*) p;
+    p += nmsgs * sizeof(*state->iov);
+    state->peers = (struct sockaddr_in6*) p;
+    state->capacity = nmsgs;
+    state->busy = 0;
+    handle->u.reserved[1] = state;
+  }
+
+  state->width = nmsgs;
+  state->msg_size = msg_size;
+  return 0;
+#else
+  return UV_ENOTSUP;
+#endif
+}
+
+
+int uv_udp_set_recv_depth(uv_udp_t* handle, unsigned int depth) {
+  if (depth == 0 || depth > UV__UDP_RECV_DEPTH_MAX)
+    return UV_EINVAL;
+
+  /* Reads are readiness based here, recvmmsg is what batches them. */
+  return 0;
+}
+
+
+int uv_udp_reuseport_steer_by_cpu(uv_udp_t* handle) {
+  return uv__reuseport_steer_by_cpu(handle->io_watcher.fd);
+}
+
+
+int uv_udp_set_busy_poll(uv_udp_t* handle, unsigned int usec) {
+  return uv__busy_poll(handle->loop, handle->io_watcher.fd, usec);
+}
+
+
+size_t uv_udp_get_recv_segment_size(const uv_udp_t* handle) {
+  return (size_t) (uintptr_t) handle->u.reserved[0];
+}
+
+
+int uv_udp_get_recv_dstaddr(const uv_udp_t* handle,
+                            struct sockaddr* name,
+                            int* namelen) {
+#if defined(UV__HAVE_UDP_PKTINFO)
+  struct uv__udp_recv_info* ri;
+  int len;
+
+  if (name == NULL || namelen == NULL)
+    return UV_EINVAL;
+
+  ri = handle->u.reserved[3];
+  if (ri == NULL || !(ri->flags & UV_UDP_PKTINFO))
+    return UV_EINVAL;
+
+  if (ri->dst.addr.sa_family == AF_INET6)
+    len = sizeof(ri->dst.in6);
+  else if (ri->dst.addr.sa_family == AF_INET)
+    len = sizeof(ri->dst.in);
+  else
+    return UV_ENOENT;
+
+  if (*namelen < len)
+    return UV_ENOBUFS;
+
+  memcpy(name, &ri->dst, len);
+  *namelen = len;
+  return 0;
+#else
+  return UV_EINVAL;
+#endif
+}
+
+
+int uv_udp_get_recv_timestamp(const uv_udp_t* handle, uv_timespec_t* ts) {
+#if defined(UV__HAVE_UDP_PKTINFO)
+  struct uv__udp_recv_info* ri;
+
+  ri = handle->u.reserved[3];
+  if (ri == NULL || !(ri->flags & UV_UDP_TIMESTAMP))
+    return UV_EINVAL;
+
+  if (!ri->ts_valid)
+    return UV_ENOENT;
+
+  *ts = ri->ts;
+  return 0;
+#else
+  return UV_EINVAL;
+#endif
+}
+
+
+uv_io_stats_t* uv__udp_io_stats(const uv_udp_t* handle) {
+  return handle->u.reserved[2];
+}
+
+
+/* See uv_handle_detach() and uv__stream_detach(). */
+int uv__udp_detach(uv_udp_t* handle) {
+  QUEUE* q;
+
+  if ((handle->flags & UV_HANDLE_UDP_PROCESSING) ||
+      !QUEUE_EMPTY(&handle->write_completed_queue) ||
+      !QUEUE_EMPTY(&handle->io_watcher.pending_queue))
+    return UV_EBUSY;
+
+  QUEUE_FOREACH(q, &handle->write_queue)
+    uv__req_unregister(handle->loop, QUEUE_DATA(q, uv_udp_send_t, queue));
+
+  uv__io_detach(handle->loop, &handle->io_watcher);
+
+  return 0;
+}
+
+
+void uv__udp_attach(uv_udp_t* handle) {
+  QUEUE* q;
+
+  QUEUE_FOREACH(q, &handle->write_queue)
+    uv__req_register(handle->loop, QUEUE_DATA(q, uv_udp_send_t, queue));
+
+  uv__io_attach(handle->loop, &handle->io_watcher);
+}
+
+
+int uv__udp_set_io_stats(uv_udp_t* handle, int enable) {
+  if (!enable) {
+    uv__free(handle->u.reserved[2]);
+    handle->u.reserved[2] = NULL;
+    return 0;
+  }
+
+  if (handle->u.reserved[2] == NULL) {
+    handle->u.reserved[2] = uv__calloc(1, sizeof(uv_io_stats_t));
+    if (handle->u.reserved[2] == NULL)
+      return UV_ENOMEM;
+  }
+
+  return 0;
+}
+
+
 int uv_udp_open(uv_udp_t* handle, uv_os_sock_t sock) {
   int err;
 
@@ -21,6 +21,7 @@
 
 #include "uv.h"
 #include "uv-common.h"
+#include "idna.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -43,6 +44,10 @@ typedef struct {
   uv_realloc_func local_realloc;
   uv_calloc_func local_calloc;
   uv_free_func local_free;
+  /* Set by uv_replace_allocator_tagged(), take precedence when set. */
+  uv_tagged_malloc_func tagged_malloc;
+  uv_tagged_realloc_func tagged_realloc;
+  uv_tagged_calloc_func tagged_calloc;
 } uv__allocator_t;
 
 static uv__allocator_t uv__allocator = {
@@ -50,32 +55,37 @@ static uv__allocator_t uv__allocator = {
   realloc,
   calloc,
   free,
+  NULL,
+  NULL,
+  NULL,
 };
 
-char* uv__strdup(const char* s) {
+char* uv__strdup_tag(const char* s, uv_alloc_tag tag) {
   size_t len = strlen(s) + 1;
-  char* m = uv__malloc(len);
+  char* m = uv__malloc_tag(len, tag);
   if (m == NULL)
     return NULL;
   return memcpy(m, s, len);
 }
 
-char* uv__strndup(const char* s, size_t n) {
+char* uv__strndup_tag(const char* s, size_t n, uv_alloc_tag tag) {
   char* m;
   size_t len = strlen(s);
   if (n < len)
     len = n;
-  m = uv__malloc(len + 1);
+  m = uv__malloc_tag(len + 1, tag);
   if (m == NULL)
     return NULL;
   m[len] = '\0';
   return memcpy(m, s, len);
 }
 
-void* uv__malloc(size_t size) {
-  if (size > 0)
-    return uv__allocator.local_malloc(size);
-  return NULL;
+void* uv__malloc_tag(size_t size, uv_alloc_tag tag) {
+  if (size == 0)
+    return NULL;
+  if (uv__allocator.tagged_malloc != NULL)
+    return uv__allocator.tagged_malloc(size, tag);
+  return uv__allocator.local_malloc(size);
 }
 
 void uv__free(void* ptr) {
@@ -89,21 +99,26 @@ void uv__free(void* ptr) {
   errno = saved_errno;
 }
 
-void* uv__calloc(size_t count, size_t size) {
+void* uv__calloc_tag(size_t count, size_t size, uv_alloc_tag tag) {
+  if (uv__allocator.tagged_calloc != NULL)
+    return uv__allocator.tagged_calloc(count, size, tag);
   return uv__allocator.local_calloc(count, size);
 }
 
-void* uv__realloc(void* ptr, size_t size) {
-  if (size > 0)
-    return uv__allocator.local_realloc(ptr, size);
-  uv__free(ptr);
-  return NULL;
+void* uv__realloc_tag(void* ptr, size_t size, uv_alloc_tag tag) {
+  if (size == 0) {
+    uv__free(ptr);
+    return NULL;
+  }
+  if (uv__allocator.tagged_realloc != NULL)
+    return uv__allocator.tagged_realloc(ptr, size, tag);
+  return uv__allocator.local_realloc(ptr, size);
 }
 
-void* uv__reallocf(void* ptr, size_t size) {
+void* uv__reallocf_tag(void* ptr, size_t size, uv_alloc_tag tag) {
   void* newptr;
 
-  newptr = uv__realloc(ptr, size);
+  newptr = uv__realloc_tag(ptr, size, tag);
   if (newptr == NULL)
     if (size > 0)
       uv__free(ptr);
@@ -124,6 +139,26 @@ int uv_replace_allocator(uv_malloc_func malloc_func,
   uv__allocator.local_realloc = realloc_func;
   uv__allocator.local_calloc = calloc_func;
   uv__allocator.local_free = free_func;
+  uv__allocator.tagged_malloc = NULL;
+  uv__allocator.tagged_realloc = NULL;
+  uv__allocator.tagged_calloc = NULL;
+
+  return 0;
+}
+
+int uv_replace_allocator_tagged(uv_tagged_malloc_func malloc_func,
+                                uv_tagged_realloc_func realloc_func,
+                                uv_tagged_calloc_func calloc_func,
+                                uv_free_func free_func) {
+  if (malloc_func == NULL || realloc_func == NULL ||
+      calloc_func == NULL || free_func == NULL) {
+    return UV_EINVAL;
+  }
+
+  uv__allocator.tagged_malloc = malloc_func;
+  uv__allocator.tagged_realloc = realloc_func;
+  uv__allocator.tagged_calloc = calloc_func;
+  uv__allocator.local_free = free_func;
 
   return 0;
 }
@@ -133,6 +168,8 @@ int uv_replace_allocator(uv_malloc_func malloc_func,
 size_t uv_handle_size(uv_handle_type type) {
   switch (type) {
     UV_HANDLE_TYPE_MAP(XX)
+    case UV_NETIF:
+      return sizeof(uv_netif_t);
     default:
       return -1;
   }
@@ -162,6 +199,126 @@ uv_buf_t uv_buf_init(char* base, unsigned int len) {
 }
 
 
+/* The write requests of a uv_write_fanout() call, allocated in one go. The
+ * call holds a reference on the buffer until the last of them is done.
+ */
+struct uv__write_fanout {
+  uv_shared_buf_t* buf;
+  uv_write_fanout_cb cb;
+  unsigned int pending;
+  unsigned int nfailed;
+  uv_write_t reqs[1];
+};
+
+
+uv_shared_buf_t* uv_shared_buf_new(size_t size) {
+  uv_shared_buf_t* buf;
+
+  /* uv_buf_t has an unsigned long length on Windows. */
+  if (size > (unsigned int) -1)
+    return NULL;
+
+  if (size > (size_t) -1 - sizeof(*buf))
+    return NULL;
+
+  /* The data follows the header, both go in one allocation. */
+  buf = uv__malloc(sizeof(*buf) + size);
+  if (buf == NULL)
+    return NULL;
+
+  buf->buf = uv_buf_init((char*) (buf + 1), (unsigned int) size);
+  buf->data = NULL;
+  buf->refcount = 1;
+  return buf;
+}
+
+
+uv_shared_buf_t* uv_shared_buf_ref(uv_shared_buf_t* buf) {
+  assert(buf->refcount > 0);
+  buf->refcount++;
+  return buf;
+}
+
+
+void uv_shared_buf_unref(uv_shared_buf_t* buf) {
+  assert(buf->refcount > 0);
+  if (--buf->refcount == 0)
+    uv__free(buf);
+}
+
+
+static void uv__write_fanout_cb(uv_write_t* req, int status) {
+  struct uv__write_fanout* fo;
+
+  fo = req->data;
+  if (status != 0)
+    fo->nfailed++;
+
+  if (--fo->pending > 0)
+    return;
+
+  if (fo->cb != NULL)
+    fo->cb(fo->buf, fo->nfailed);
+
+  uv_shared_buf_unref(fo->buf);
+  uv__free(fo);
+}
+
+
+int uv_write_fanout(uv_stream_t* handles[],
+                    unsigned int nhandles,
+                    uv_shared_buf_t* buf,
+                    uv_write_fanout_cb cb) {
+  struct uv__write_fanout* fo;
+  uv_write_t* req;
+  unsigned int i;
+  size_t n;
+  int first_err;
+  int err;
+
+  if (nhandles == 0)
+    return UV_EINVAL;
+
+  n = nhandles - 1;
+  if (n > ((size_t) -1 - sizeof(*fo)) / sizeof(fo->reqs[0]))
+    return UV_ENOMEM;
+
+  fo = uv__malloc(sizeof(*fo) + n * sizeof(fo->reqs[0]));
+  if (fo == NULL)
+    return UV_ENOMEM;
+
+  fo->buf = buf;
+  fo->cb = cb;
+  fo->pending = 0;
+  fo->nfailed = 0;
+  first_err = 0;
+
+  /* Streams that can't take the write count as failed. The callbacks of the
+   * others can't run before this function returns, uv_write() defers them.
+   */
+  for (i = 0; i < nhandles; i++) {
+    req = &fo->reqs[i];
+    req->data = fo;
+    err = uv_write(req, handles[i], &buf->buf, 1, uv__write_fanout_cb);
+    if (err == 0) {
+      fo->pending++;
+    } else {
+      fo->nfailed++;
+      if (first_err == 0)
+        first_err = err;
+    }
+  }
+
+  if (fo->pending == 0) {
+    uv__free(fo);
+    return first_err;
+  }
+
+  uv_shared_buf_ref(buf);
+  return 0;
+}
+
+
 static const char* uv__unknown_err_code(int err) {
   char buf[32];
   char* copy;
@@ -218,6 +375,24 @@ const char* uv_strerror(int err) {
 #undef UV_STRERROR_GEN
 
 
+int uv_idna_toascii(const char* s, char* d, size_t size) {
+  long rc;
+
+  if (s == NULL || d == NULL)
+    return UV_EINVAL;
+
+  rc = uv__idna_toascii(s, s + strlen(s), d, d + size);
+  if (rc < 0)
+    return (int) rc;
+
+  /* Output that didn't fit is cut off without a nul byte. */
+  if (rc == 0 || d[rc - 1] != '\0')
+    return UV_ENOSPC;
+
+  return (int) rc - 1;
+}
+
+
 int uv_ip4_addr(const char* ip, int port, struct sockaddr_in* addr) {
   memset(addr, 0, sizeof(*addr));
   addr->sin_family = AF_INET;
@@ -319,7 +494,7 @@ int uv_udp_init_ex(uv_loop_t* loop, uv_udp_t* handle, unsigned flags) {
 
   /* Use the higher bits for extra flags. */
   extra_flags = flags & ~0xFF;
-  if (extra_flags & ~UV_UDP_RECVMMSG)
+  if (extra_flags & ~(UV_UDP_RECVMMSG | UV_UDP_RIO))
     return UV_EINVAL;
 
   rc = uv__udp_init_ex(loop, handle, flags, domain);
@@ -376,6 +551,28 @@ int uv_tcp_connect(uv_connect_t* req,
 }
 
 
+int uv_tcp_connect_fastopen(uv_connect_t* req,
+                            uv_tcp_t* handle,
+                            const struct sockaddr* addr,
+                            const uv_buf_t bufs[],
+                            unsigned int nbufs,
+                            uv_connect_cb cb) {
+  unsigned int addrlen;
+
+  if (handle->type != UV_TCP)
+    return UV_EINVAL;
+
+  if (addr->sa_family == AF_INET)
+    addrlen = sizeof(struct sockaddr_in);
+  else if (addr->sa_family == AF_INET6)
+    addrlen = sizeof(struct sockaddr_in6);
+  else
+    return UV_EINVAL;
+
+  return uv__tcp_connect_fastopen(req, handle, addr, addrlen, bufs, nbufs, cb);
+}
+
+
 int uv_udp_connect(uv_udp_t* handle, const struct sockaddr* addr) {
   unsigned int addrlen;
 
@@ -465,6 +662,58 @@ int uv_udp_send(uv_udp_send_t* req,
 }
 
 
+int uv_udp_send_segmented(uv_udp_send_t* req,
+                          uv_udp_t* handle,
+                          const uv_buf_t* buf,
+                          size_t segment_size,
+                          const struct sockaddr* addr,
+                          uv_udp_send_cb send_cb) {
+  int addrlen;
+
+  addrlen = uv__udp_check_before_send(handle, addr);
+  if (addrlen < 0)
+    return addrlen;
+
+  return uv__udp_send_segmented(req,
+                                handle,
+                                buf,
+                                segment_size,
+                                addr,
+                                addrlen,
+                                send_cb);
+}
+
+
+int uv_udp_send_from(uv_udp_send_t* req,
+                     uv_udp_t* handle,
+                     const uv_buf_t bufs[],
+                     unsigned int nbufs,
+                     const struct sockaddr* addr,
+                     const struct sockaddr* src,
+                     uv_udp_send_cb send_cb) {
+  int addrlen;
+
+  addrlen = uv__udp_check_before_send(handle, addr);
+  if (addrlen < 0)
+    return addrlen;
+
+  if (src == NULL)
+    return uv__udp_send(req, handle, bufs, nbufs, addr, addrlen, send_cb);
+
+  if (src->sa_family != AF_INET && src->sa_family != AF_INET6)
+    return UV_EINVAL;
+
+  return uv__udp_send_from(req,
+                           handle,
+                           bufs,
+                           nbufs,
+                           addr,
+                           addrlen,
+                           src,
+                           send_cb);
+}
+
+
 int uv_udp_try_send(uv_udp_t* handle,
                     const uv_buf_t bufs[],
                     unsigned int nbufs,
@@ -479,6 +728,27 @@ int uv_udp_try_send(uv_udp_t* handle,
 }
 
 
+int uv_udp_try_send_batch(uv_udp_t* handle,
+                          const uv_buf_t bufs[],
+                          const struct sockaddr* const addrs[],
+                          unsigned int count) {
+  unsigned int i;
+  int addrlen;
+
+  if (count == 0)
+    return UV_EINVAL;
+
+  /* Reject bad arguments before anything goes out on the wire. */
+  for (i = 0; i < count; i++) {
+    addrlen = uv__udp_check_before_send(handle, addrs ? addrs[i] : NULL);
+    if (addrlen < 0)
+      return addrlen;
+  }
+
+  return uv__udp_try_send_batch(handle, bufs, addrs, count);
+}
+
+
 int uv_udp_recv_start(uv_udp_t* handle,
                       uv_alloc_cb alloc_cb,
                       uv_udp_recv_cb recv_cb) {
@@ -516,6 +786,52 @@ void uv_walk(uv_loop_t* loop, uv_walk_cb walk_cb, void* arg) {
 }
 
 
+static int uv__close_all_match(const uv_handle_t* h, uv_handle_type type) {
+  if (h->flags & (UV_HANDLE_INTERNAL | UV_HANDLE_CLOSING))
+    return 0;
+  return type == UV_UNKNOWN_HANDLE || h->type == type;
+}
+
+
+int uv_close_all(uv_loop_t* loop, uv_handle_type type, uv_close_cb close_cb) {
+  uv_handle_t** handles;
+  uv_handle_t* h;
+  unsigned int n;
+  unsigned int i;
+  QUEUE* q;
+
+  if ((unsigned int) type >= UV_HANDLE_TYPE_MAX)
+    return UV_EINVAL;
+
+  n = 0;
+  QUEUE_FOREACH(q, &loop->handle_queue) {
+    h = QUEUE_DATA(q, uv_handle_t, handle_queue);
+    if (uv__close_all_match(h, type))
+      n++;
+  }
+
+  if (n == 0)
+    return 0;
+
+  handles = uv__malloc(n * sizeof(*handles));
+  if (handles == NULL)
+    return UV_ENOMEM;
+
+  i = 0;
+  QUEUE_FOREACH(q, &loop->handle_queue) {
+    h = QUEUE_DATA(q, uv_handle_t, handle_queue);
+    if (uv__close_all_match(h, type))
+      handles[i++] = h;
+  }
+
+  assert(i == n);
+  uv_close_many(handles, n, close_cb);
+  uv__free(handles);
+
+  return n;
+}
+
+
 static void uv__print_handles(uv_loop_t* loop, int only_active, FILE* stream) {
   const char* type;
   QUEUE* q;
@@ -534,6 +850,7 @@ static void uv__print_handles(uv_loop_t* loop, int only_active, FILE* stream) {
 #define X(uc, lc) case UV_##uc: type = #lc; break;
       UV_HANDLE_TYPE_MAP(X)
 #undef X
+      case UV_NETIF: type = "netif"; break;
       default: type = "<unknown>";
     }
 
@@ -558,6 +875,70 @@ void uv_print_active_handles(uv_loop_t* loop, FILE* stream) {
 }
 
 
+int uv_loop_snapshot(const uv_loop_t* loop,
+                     uv_handle_snapshot_t* handles,
+                     size_t* count) {
+  uv_handle_snapshot_t* s;
+  const uv_handle_t* h;
+  const QUEUE* q;
+  size_t n;
+
+  if (loop == NULL || count == NULL || (handles == NULL && *count != 0))
+    return UV_EINVAL;
+
+  n = 0;
+  QUEUE_FOREACH(q, &loop->handle_queue) {
+    h = QUEUE_DATA(q, uv_handle_t, handle_queue);
+
+    if (!uv__is_active(h))
+      continue;
+
+    if (n++ >= *count)
+      continue;
+
+    s = &handles[n - 1];
+    memset(s, 0, sizeof(*s));
+    s->handle = h;
+    s->type = h->type;
+    s->flags = UV_SNAPSHOT_ACTIVE;
+    if (h->flags & UV_HANDLE_REF)
+      s->flags |= UV_SNAPSHOT_REF;
+    if (uv__is_closing(h))
+      s->flags |= UV_SNAPSHOT_CLOSING;
+    if (h->flags & UV_HANDLE_INTERNAL)
+      s->flags |= UV_SNAPSHOT_INTERNAL;
+
+    if (uv_fileno(h, &s->fd) != 0)
+      s->fd = (uv_os_fd_t) -1;
+
+    switch (h->type) {
+      case UV_NAMED_PIPE:
+      case UV_TCP:
+      case UV_TTY:
+        s->write_queue_size = ((const uv_stream_t*) h)->write_queue_size;
+        break;
+      case UV_UDP:
+        s->write_queue_size = ((const uv_udp_t*) h)->send_queue_size;
+        break;
+      case UV_TIMER:
+        s->timer_due = ((const uv_timer_t*) h)->timeout;
+        s->timer_repeat = ((const uv_timer_t*) h)->repeat;
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (n > *count) {
+    *count = n;
+    return UV_ENOBUFS;
+  }
+
+  *count = n;
+  return 0;
+}
+
+
 void uv_ref(uv_handle_t* handle) {
   uv__handle_ref(handle);
 }
@@ -624,6 +1005,20 @@ int uv_fs_event_getpath(uv_fs_event_t* handle, char* buffer, size_t* size) {
   return 0;
 }
 
+
+struct uv__fs_event_state* uv__fs_event_state(uv_fs_event_t* handle) {
+  if (handle->u.reserved[0] == NULL)
+    handle->u.reserved[0] = uv__calloc(1, sizeof(struct uv__fs_event_state));
+
+  return handle->u.reserved[0];
+}
+
+
+void uv__fs_event_state_free(uv_fs_event_t* handle) {
+  uv__free(handle->u.reserved[0]);
+  handle->u.reserved[0] = NULL;
+}
+
 /* The windows implementation does not have the same structure layout as
  * the unix implementation (nbufs is not directly inside req but is
  * contained in a nested union/struct) so this function locates it.
@@ -636,6 +1031,197 @@ static unsigned int* uv__get_nbufs(uv_fs_t* req) {
 #endif
 }
 
+/* Bulk copies can keep a thread busy for a long time, don't let them hold
+ * up the short metadata operations that are queued behind them.
+ */
+uv_work_priority uv__fs_work_priority(uv_fs_type fs_type) {
+  switch (fs_type) {
+  case UV_FS_COPYFILE:
+  case UV_FS_SENDFILE:
+    return UV_WORK_PRIORITY_BACKGROUND;
+  default:
+    return UV_WORK_PRIORITY_NORMAL;
+  }
+}
+
+/* Goes through uv__malloc() so that a replaced allocator is honored; the
+ * pointer returned by the allocator is stashed right below the aligned block.
+ */
+void* uv_fs_aligned_alloc(size_t alignment, size_t size) {
+  uintptr_t addr;
+  void* ptr;
+
+  if (alignment == 0 || (alignment & (alignment - 1)) != 0)
+    return NULL;
+
+  if (alignment < sizeof(void*))
+    alignment = sizeof(void*);
+
+  if (size > (size_t) -1 - alignment - sizeof(void*))
+    return NULL;
+
+  ptr = uv__malloc(size + alignment + sizeof(void*));
+  if (ptr == NULL)
+    return NULL;
+
+  addr = (uintptr_t) ptr + sizeof(void*);
+  addr = (addr + alignment - 1) & ~(uintptr_t) (alignment - 1);
+  ((void**) addr)[-1] = ptr;
+
+  return (void*) addr;
+}
+
+
+void uv_fs_aligned_free(void* ptr) {
+  if (ptr != NULL)
+    uv__free(((void**) ptr)[-1]);
+}
+
+
+/* Direct I/O wants the file offset and every buffer's length to be a multiple
+ * of the logical block size, and the buffers to be suitably aligned in memory.
+ * Catch that up front rather than letting the kernel fail with a bare EINVAL.
+ */
+int uv__fs_dio_check(const uv_buf_t bufs[],
+                     unsigned int nbufs,
+                     int64_t offset,
+                     size_t mem_align,
+                     size_t offset_align) {
+  unsigned int i;
+
+  if (bufs == NULL || nbufs == 0)
+    return UV_EINVAL;
+
+  if (offset < 0 || offset % offset_align != 0)
+    return UV_EINVAL;
+
+  for (i = 0; i < nbufs; i++) {
+    if ((uintptr_t) bufs[i].base % mem_align != 0)
+      return UV_EINVAL;
+    if (bufs[i].len % offset_align != 0)
+      return UV_EINVAL;
+  }
+
+  return 0;
+}
+
+
+int uv__fs_fallocate_check(int flags) {
+  if (flags & ~(UV_FS_FALLOCATE_KEEP_SIZE |
+                UV_FS_FALLOCATE_PUNCH_HOLE |
+                UV_FS_FALLOCATE_ZERO_RANGE))
+    return UV_EINVAL;
+
+  if ((flags & UV_FS_FALLOCATE_PUNCH_HOLE) &&
+      (flags & UV_FS_FALLOCATE_ZERO_RANGE))
+    return UV_EINVAL;
+
+  return 0;
+}
+
+
+/* Copies the segments of a uv_fs_write_batch() request and their buffer
+ * descriptors into a single block. The copies are private to the request,
+ * the work function adjusts them as partial writes complete.
+ */
+int uv__fs_write_batch_init(uv_fs_t* req,
+                            const uv_fs_write_segment_t segs[],
+                            unsigned int nsegs,
+                            int flags) {
+  struct uv__fs_write_batch* wb;
+  uv_buf_t* bufs;
+  unsigned int i;
+  size_t nbufs;
+
+  if (segs == NULL || nsegs == 0)
+    return UV_EINVAL;
+
+  if (flags & ~UV_FS_WRITE_BATCH_DATASYNC)
+    return UV_EINVAL;
+
+  nbufs = 0;
+  for (i = 0; i < nsegs; i++) {
+    if (segs[i].offset < 0)
+      return UV_EINVAL;
+    if (segs[i].bufs == NULL && segs[i].nbufs > 0)
+      return UV_EINVAL;
+    nbufs += segs[i].nbufs;
+  }
+
+  wb = uv__malloc(sizeof(*wb) +
+                  nsegs * sizeof(*wb->segs) +
+                  nbufs * sizeof(*bufs));
+  if (wb == NULL)
+    return UV_ENOMEM;
+
+  memset(wb, 0, sizeof(*wb));
+  wb->nsegs = nsegs;
+  wb->resume = -1;
+  wb->segs = (uv_fs_write_segment_t*) (wb + 1);
+  bufs = (uv_buf_t*) (wb->segs + nsegs);
+
+  for (i = 0; i < nsegs; i++) {
+    wb->segs[i].offset = segs[i].offset;
+    wb->segs[i].nbufs = segs[i].nbufs;
+    wb->segs[i].bufs = bufs;
+    if (segs[i].nbufs > 0)
+      memcpy(bufs, segs[i].bufs, segs[i].nbufs * sizeof(*bufs));
+    bufs += segs[i].nbufs;
+  }
+
+  req->ptr = wb;
+  return 0;
+}
+
+
+/* Allocates the bookkeeping for uv_fs_stat_many() as a single block: the
+ * header, the path pointer table and, when |copy| is set, the path strings.
+ */
+int uv__fs_stat_many_init(uv_fs_t* req,
+                          const char* const paths[],
+                          unsigned int npaths,
+                          uv_stat_t* statbufs,
+                          int* results,
+                          int copy) {
+  struct uv__fs_stat_many* sm;
+  unsigned int i;
+  size_t size;
+  size_t len;
+  char* p;
+
+  if (npaths == 0 || paths == NULL || statbufs == NULL || results == NULL)
+    return UV_EINVAL;
+
+  size = sizeof(*sm) + npaths * sizeof(*sm->paths);
+  if (copy)
+    for (i = 0; i < npaths; i++)
+      size += strlen(paths[i]) + 1;
+
+  sm = uv__malloc(size);
+  if (sm == NULL)
+    return UV_ENOMEM;
+
+  sm->npaths = npaths;
+  sm->statbufs = statbufs;
+  sm->results = results;
+  sm->paths = (const char**) (sm + 1);
+  p = (char*) (sm->paths + npaths);
+
+  for (i = 0; i < npaths; i++) {
+    if (copy) {
+      len = strlen(paths[i]) + 1;
+      memcpy(p, paths[i], len);
+      sm->paths[i] = p;
+      p += len;
+    } else {
+      sm->paths[i] = paths[i];
+    }
+  }
+
+  req->ptr = sm;
+  return 0;
+}
+
 /* uv_fs_scandir() uses the system allocator to allocate memory on non-Windows
  * systems. So, the memory should be released using free(). On Windows,
  * uv__malloc() is used, so use uv__free() to free memory.
@@ -646,16 +1232,25 @@ static unsigned int* uv__get_nbufs(uv_fs_t* req) {
 # define uv__fs_scandir_free free
 #endif
 
+/* Packed results store the entries in the same block as the pointer table,
+ * they must not be freed individually.
+ */
+static int uv__fs_scandir_is_packed(const uv_fs_t* req) {
+  return req->flags & UV__FS_SCANDIR_PACKED;
+}
+
 void uv__fs_scandir_cleanup(uv_fs_t* req) {
   uv__dirent_t** dents;
 
   unsigned int* nbufs = uv__get_nbufs(req);
 
   dents = req->ptr;
-  if (*nbufs > 0 && *nbufs != (unsigned int) req->result)
-    (*nbufs)--;
-  for (; *nbufs < (unsigned int) req->result; (*nbufs)++)
-    uv__fs_scandir_free(dents[*nbufs]);
+  if (!uv__fs_scandir_is_packed(req)) {
+    if (*nbufs > 0 && *nbufs != (unsigned int) req->result)
+      (*nbufs)--;
+    for (; *nbufs < (unsigned int) req->result; (*nbufs)++)
+      uv__fs_scandir_free(dents[*nbufs]);
+  }
 
   uv__fs_scandir_free(req->ptr);
   req->ptr = NULL;
@@ -681,7 +1276,7 @@ int uv_fs_scandir_next(uv_fs_t* req, uv_dirent_t* ent) {
   dents = req->ptr;
 
   /* Free previous entity */
-  if (*nbufs > 0)
+  if (*nbufs > 0 && !uv__fs_scandir_is_packed(req))
     uv__fs_scandir_free(dents[*nbufs - 1]);
 
   /* End was already reached */
@@ -735,6 +1330,15 @@ uv_dirent_type_t uv__fs_get_dirent_type(uv__dirent_t* dent) {
   return type;
 }
 
+/* Keeps every entry of uv_fs_readdir_packed() aligned like a pointer. */
+size_t uv__dirent_packed_size(size_t namelen) {
+  size_t size;
+
+  size = offsetof(uv_dirent_packed_t, name) + namelen + 1;
+  return (size + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+}
+
+
 void uv__fs_readdir_cleanup(uv_fs_t* req) {
   uv_dir_t* dir;
   uv_dirent_t* dirents;
@@ -758,12 +1362,31 @@ void uv__fs_readdir_cleanup(uv_fs_t* req) {
 
 
 int uv_loop_configure(uv_loop_t* loop, uv_loop_option option, ...) {
+  const char* cpumask;
   va_list ap;
   int err;
 
   va_start(ap, option);
   /* Any platform-agnostic options should be handled here. */
-  err = uv__loop_configure(loop, option, ap);
+  if (option == UV_LOOP_USE_TIMER_WHEEL)
+    err = uv__timer_wheel_enable(loop);
+  else if (option == UV_LOOP_THREADPOOL_SIZE)
+    err = uv__threadpool_loop_configure(loop, va_arg(ap, unsigned int));
+  else if (option == UV_LOOP_REALPATH_CACHE)
+    err = uv__realpath_cache_configure(loop, va_arg(ap, unsigned int));
+  else if (option == UV_LOOP_HUGE_PAGES)
+    err = uv__read_pool_configure(loop, va_arg(ap, int));
+  else if (option == UV_LOOP_THREADPOOL_AFFINITY) {
+    cpumask = va_arg(ap, const char*);
+    err = uv__threadpool_loop_affinity(loop, cpumask, va_arg(ap, size_t));
+  } else if (option == UV_METRICS_PHASE_TIME) {
+    uv__get_internal_fields(loop)->flags |= UV__METRICS_PHASE_TIME;
+    err = 0;
+  } else if (option == UV_METRICS_LAG) {
+    uv__get_internal_fields(loop)->flags |= UV__METRICS_LAG;
+    err = 0;
+  } else
+    err = uv__loop_configure(loop, option, ap);
   va_end(ap);
 
   return err;
@@ -802,14 +1425,64 @@ uv_loop_t* uv_loop_new(void) {
 }
 
 
-int uv_loop_close(uv_loop_t* loop) {
-  QUEUE* q;
-  uv_handle_t* h;
-#ifndef NDEBUG
-  void* saved_data;
-#endif
+int uv_defer(uv_loop_t* loop, uv_defer_t* req, uv_defer_cb cb) {
+  if (cb == NULL)
+    return UV_EINVAL;
+
+  if (req->cb != NULL)
+    return UV_EBUSY;
+
+  req->cb = cb;
+  QUEUE_INSERT_TAIL(&uv__get_internal_fields(loop)->defer_queue, &req->queue);
+  return 0;
+}
+
+
+int uv_defer_cancel(uv_defer_t* req) {
+  if (req->cb == NULL)
+    return UV_EINVAL;
+
+  QUEUE_REMOVE(&req->queue);
+  QUEUE_INIT(&req->queue);
+  req->cb = NULL;
+  return 0;
+}
+
+
+/* Runs what was deferred up to now. Callbacks that defer again land on the
+ * fresh queue and run after the next phase, so a callback that keeps
+ * rescheduling itself can't starve the loop.
+ */
+void uv__run_deferred(uv_loop_t* loop) {
+  uv_defer_cb cb;
+  uv_defer_t* req;
+  QUEUE queue;
+  QUEUE* q;
+
+  if (!uv__has_deferred(loop))
+    return;
 
-  if (uv__has_active_reqs(loop))
+  QUEUE_MOVE(&uv__get_internal_fields(loop)->defer_queue, &queue);
+  while (!QUEUE_EMPTY(&queue)) {
+    q = QUEUE_HEAD(&queue);
+    req = QUEUE_DATA(q, uv_defer_t, queue);
+    QUEUE_REMOVE(q);
+    QUEUE_INIT(q);
+    cb = req->cb;
+    req->cb = NULL;
+    cb(req);
+  }
+}
+
+
+int uv_loop_close(uv_loop_t* loop) {
+  QUEUE* q;
+  uv_handle_t* h;
+#ifndef NDEBUG
+  void* saved_data;
+#endif
+
+  if (uv__has_active_reqs(loop) || uv__has_deferred(loop))
     return UV_EBUSY;
 
   QUEUE_FOREACH(q, &loop->handle_queue) {
@@ -818,6 +1491,11 @@ int uv_loop_close(uv_loop_t* loop) {
       return UV_EBUSY;
   }
 
+  uv__threadpool_loop_close(loop);
+  uv__read_pool_delete(loop);
+  uv__req_pool_delete(loop);
+  uv__handle_pool_delete(loop);
+  uv__realpath_cache_delete(loop);
   uv__loop_close(loop);
 
 #ifndef NDEBUG
@@ -865,6 +1543,435 @@ int uv_read_start(uv_stream_t* stream,
 }
 
 
+/* Buffers for uv_read_start_pooled(). Free buffers are kept in a list that
+ * is linked through the first bytes of each buffer.
+ */
+static void uv__read_pool_push(struct uv__read_pool* pool, char* base) {
+  memcpy(base, &pool->free, sizeof(pool->free));
+  pool->free = base;
+  pool->nfree++;
+}
+
+
+/* UV_LOOP_HUGE_PAGES: splits another arena into buffers. They stay in the
+ * pool until the loop is closed. Linking them into the free list touches
+ * every page of the arena on the loop thread, which places it on the loop
+ * thread's NUMA node unless a node was given.
+ */
+static void uv__read_pool_grow(struct uv__read_pool* pool) {
+  struct uv__read_pool_arena* arena;
+  size_t offset;
+
+  arena = uv__malloc(sizeof(*arena));
+  if (arena == NULL)
+    return;
+
+  arena->base = uv__huge_alloc(UV__READ_POOL_ARENA_SIZE, pool->node);
+  if (arena->base == NULL) {
+    uv__free(arena);
+    return;
+  }
+
+  arena->next = pool->arenas;
+  pool->arenas = arena;
+
+  offset = UV__READ_POOL_ARENA_SIZE;
+  while (offset > 0) {
+    offset -= UV__READ_POOL_BUFSIZE;
+    uv__read_pool_push(pool, arena->base + offset);
+  }
+}
+
+
+void uv__read_pool_alloc(uv_handle_t* handle,
+                         size_t suggested_size,
+                         uv_buf_t* buf) {
+  struct uv__read_pool* pool;
+  char* base;
+
+  pool = &uv__get_internal_fields(handle->loop)->read_pool;
+  if (pool->free == NULL && pool->huge_pages)
+    uv__read_pool_grow(pool);
+
+  base = pool->free;
+  if (base != NULL) {
+    memcpy(&pool->free, base, sizeof(pool->free));
+    pool->nfree--;
+  } else if (!pool->huge_pages) {
+    base = uv__malloc(UV__READ_POOL_BUFSIZE);
+  }
+
+  if (base != NULL)
+    pool->nused++;
+
+  *buf = uv_buf_init(base, base == NULL ? 0 : UV__READ_POOL_BUFSIZE);
+}
+
+
+void uv__read_pool_put(uv_loop_t* loop, char* base) {
+  struct uv__read_pool* pool;
+
+  if (base == NULL)
+    return;
+
+  pool = &uv__get_internal_fields(loop)->read_pool;
+  pool->nused--;
+  if (!pool->huge_pages && pool->nfree >= UV__READ_POOL_MAX_FREE) {
+    uv__free(base);
+    return;
+  }
+
+  uv__read_pool_push(pool, base);
+}
+
+
+void uv__read_pool_delete(uv_loop_t* loop) {
+  struct uv__read_pool_arena* arena;
+  struct uv__read_pool* pool;
+  char* base;
+
+  pool = &uv__get_internal_fields(loop)->read_pool;
+  while (pool->free != NULL && !pool->huge_pages) {
+    base = pool->free;
+    memcpy(&pool->free, base, sizeof(pool->free));
+    uv__free(base);
+  }
+
+  while (pool->arenas != NULL) {
+    arena = pool->arenas;
+    pool->arenas = arena->next;
+    uv__huge_free(arena->base, UV__READ_POOL_ARENA_SIZE);
+    uv__free(arena);
+  }
+
+  pool->free = NULL;
+  pool->nfree = 0;
+}
+
+
+int uv__read_pool_configure(uv_loop_t* loop, int node) {
+  struct uv__read_pool* pool;
+
+  if (node < -1 || node >= UV__NUMA_MAX_NODES)
+    return UV_EINVAL;
+
+  /* Buffers that are out would come back to the wrong kind of pool. */
+  pool = &uv__get_internal_fields(loop)->read_pool;
+  if (pool->nused > 0)
+    return UV_EBUSY;
+
+  uv__read_pool_delete(loop);
+  pool->huge_pages = 1;
+  pool->node = node;
+  return 0;
+}
+
+
+int uv_read_start_pooled(uv_stream_t* stream, uv_read_cb read_cb) {
+  return uv_read_start(stream, uv__read_pool_alloc, read_cb);
+}
+
+
+/* Stand-in alloc_cb of uv_read_start_vec() streams, for the reads that only
+ * take one buffer.
+ */
+void uv__read_vec_alloc(uv_handle_t* handle,
+                        size_t suggested_size,
+                        uv_buf_t* buf) {
+  uv__read_alloc((uv_stream_t*) handle, suggested_size, buf, 1);
+}
+
+
+/* Buffers for the next read from the alloc callback of |stream|, at most
+ * |nbufs| of them. Returns how many there are, 0 when the callback didn't
+ * hand out any space.
+ */
+unsigned int uv__read_alloc(uv_stream_t* stream,
+                            size_t suggested_size,
+                            uv_buf_t bufs[],
+                            unsigned int nbufs) {
+  unsigned int n;
+
+  bufs[0] = uv_buf_init(NULL, 0);
+
+  if (stream->alloc_cb != uv__read_vec_alloc) {
+    stream->alloc_cb((uv_handle_t*) stream, suggested_size, bufs);
+    n = 1;
+  } else {
+    n = nbufs;
+    uv__stream_alloc_vec_cb(stream)((uv_handle_t*) stream,
+                                    suggested_size,
+                                    bufs,
+                                    &n);
+    assert(n <= nbufs);
+  }
+
+  if (n == 0 || bufs[0].base == NULL || uv__count_bufs(bufs, n) == 0)
+    return 0;
+
+  return n;
+}
+
+
+int uv_read_start_vec(uv_stream_t* stream,
+                      uv_alloc_vec_cb alloc_cb,
+                      uv_read_cb read_cb) {
+  uv_alloc_vec_cb prev;
+  int err;
+
+  if (stream == NULL || alloc_cb == NULL)
+    return UV_EINVAL;
+
+  /* Windows can post a read, and call alloc_cb, from uv_read_start(). */
+  prev = uv__stream_alloc_vec_cb(stream);
+  err = uv__stream_set_alloc_vec_cb(stream, alloc_cb);
+  if (err != 0)
+    return err;
+
+  err = uv_read_start(stream, uv__read_vec_alloc, read_cb);
+  if (err != 0)
+    uv__stream_set_alloc_vec_cb(stream, prev);
+
+  return err;
+}
+
+
+void uv_read_buf_release(uv_loop_t* loop, const uv_buf_t* buf) {
+  uv__read_pool_put(loop, buf->base);
+}
+
+
+/* Free requests are linked through their data field, free uv_buf_t arrays
+ * through their first bytes, like the read buffers above.
+ */
+void* uv_req_alloc(uv_loop_t* loop, uv_req_type type) {
+  struct uv__req_pool* pool;
+  uv_req_t* req;
+  size_t size;
+
+  if (loop == NULL || type <= UV_UNKNOWN_REQ || type >= UV_REQ_TYPE_MAX)
+    return NULL;
+
+  size = uv_req_size(type);
+  if (size == (size_t) -1)
+    return NULL;
+
+  pool = &uv__get_internal_fields(loop)->req_pool;
+  req = pool->free[type];
+  if (req != NULL) {
+    pool->free[type] = req->data;
+    pool->nfree[type]--;
+  } else {
+    req = uv__malloc(size);
+    if (req == NULL)
+      return NULL;
+  }
+
+  req->data = NULL;
+  req->type = type;
+  return req;
+}
+
+
+void uv_req_free(uv_loop_t* loop, void* ptr) {
+  struct uv__req_pool* pool;
+  uv_req_t* req;
+
+  req = ptr;
+  if (req == NULL)
+    return;
+
+  pool = &uv__get_internal_fields(loop)->req_pool;
+  if (req->type <= UV_UNKNOWN_REQ ||
+      req->type >= UV_REQ_TYPE_MAX ||
+      pool->nfree[req->type] >= UV__REQ_POOL_MAX_FREE) {
+    uv__free(req);
+    return;
+  }
+
+  req->data = pool->free[req->type];
+  pool->free[req->type] = req;
+  pool->nfree[req->type]++;
+}
+
+
+static unsigned int uv__bufs_pool_class(unsigned int nbufs) {
+  unsigned int i;
+
+  for (i = 0; i < UV__BUFS_POOL_CLASSES; i++)
+    if (nbufs <= ((unsigned int) UV__BUFS_POOL_MIN << i))
+      return i;
+
+  return i;
+}
+
+
+uv_buf_t* uv__bufs_pool_get(uv_loop_t* loop, unsigned int nbufs) {
+  struct uv__req_pool* pool;
+  unsigned int i;
+  uv_buf_t* bufs;
+
+  i = uv__bufs_pool_class(nbufs);
+  if (i == UV__BUFS_POOL_CLASSES)
+    return uv__malloc(nbufs * sizeof(*bufs));
+
+  pool = &uv__get_internal_fields(loop)->req_pool;
+  bufs = pool->bufs_free[i];
+  if (bufs == NULL)
+    return uv__malloc((UV__BUFS_POOL_MIN << i) * sizeof(*bufs));
+
+  memcpy(&pool->bufs_free[i], bufs, sizeof(pool->bufs_free[i]));
+  pool->bufs_nfree[i]--;
+  return bufs;
+}
+
+
+void uv__bufs_pool_put(uv_loop_t* loop, uv_buf_t* bufs, unsigned int nbufs) {
+  struct uv__req_pool* pool;
+  unsigned int i;
+
+  i = uv__bufs_pool_class(nbufs);
+  pool = &uv__get_internal_fields(loop)->req_pool;
+  if (i == UV__BUFS_POOL_CLASSES ||
+      pool->bufs_nfree[i] >= UV__BUFS_POOL_MAX_FREE) {
+    uv__free(bufs);
+    return;
+  }
+
+  memcpy(bufs, &pool->bufs_free[i], sizeof(pool->bufs_free[i]));
+  pool->bufs_free[i] = bufs;
+  pool->bufs_nfree[i]++;
+}
+
+
+void uv__req_pool_delete(uv_loop_t* loop) {
+  struct uv__req_pool* pool;
+  uv_buf_t* bufs;
+  uv_req_t* req;
+  unsigned int i;
+
+  pool = &uv__get_internal_fields(loop)->req_pool;
+  for (i = 0; i < UV_REQ_TYPE_MAX; i++) {
+    while (pool->free[i] != NULL) {
+      req = pool->free[i];
+      pool->free[i] = req->data;
+      uv__free(req);
+    }
+    pool->nfree[i] = 0;
+  }
+
+  for (i = 0; i < UV__BUFS_POOL_CLASSES; i++) {
+    while (pool->bufs_free[i] != NULL) {
+      bufs = pool->bufs_free[i];
+      memcpy(&pool->bufs_free[i], bufs, sizeof(pool->bufs_free[i]));
+      uv__free(bufs);
+    }
+    pool->bufs_nfree[i] = 0;
+  }
+}
+
+
+/* Only handles whose init function needs nothing but the loop. */
+static int uv__handle_pool_init(uv_loop_t* loop,
+                                uv_handle_t* handle,
+                                uv_handle_type type) {
+  switch (type) {
+    case UV_CHECK:
+      return uv_check_init(loop, (uv_check_t*) handle);
+    case UV_FS_EVENT:
+      return uv_fs_event_init(loop, (uv_fs_event_t*) handle);
+    case UV_FS_POLL:
+      return uv_fs_poll_init(loop, (uv_fs_poll_t*) handle);
+    case UV_IDLE:
+      return uv_idle_init(loop, (uv_idle_t*) handle);
+    case UV_NAMED_PIPE:
+      return uv_pipe_init(loop, (uv_pipe_t*) handle, 0);
+    case UV_PREPARE:
+      return uv_prepare_init(loop, (uv_prepare_t*) handle);
+    case UV_SIGNAL:
+      return uv_signal_init(loop, (uv_signal_t*) handle);
+    case UV_TCP:
+      return uv_tcp_init(loop, (uv_tcp_t*) handle);
+    case UV_TIMER:
+      return uv_timer_init(loop, (uv_timer_t*) handle);
+    case UV_UDP:
+      return uv_udp_init(loop, (uv_udp_t*) handle);
+    default:
+      return UV_EINVAL;
+  }
+}
+
+
+void* uv_handle_alloc(uv_loop_t* loop, uv_handle_type type) {
+  struct uv__handle_pool* pool;
+  uv_handle_t* handle;
+  int reused;
+
+  if (loop == NULL || type <= UV_UNKNOWN_HANDLE || type >= UV_HANDLE_TYPE_MAX)
+    return NULL;
+
+  pool = &uv__get_internal_fields(loop)->handle_pool;
+  handle = pool->free[type];
+  reused = handle != NULL;
+  if (reused) {
+    pool->free[type] = handle->data;
+    pool->nfree[type]--;
+  } else {
+    handle = uv__malloc(uv_handle_size(type));
+    if (handle == NULL)
+      return NULL;
+  }
+
+  if (uv__handle_pool_init(loop, handle, type)) {
+    uv__free(handle);
+    return NULL;
+  }
+
+  handle->data = NULL;
+  handle->flags |= UV_HANDLE_POOLED;
+  pool->in_use[type]++;
+  pool->allocated[type]++;
+  pool->reused[type] += reused;
+  return handle;
+}
+
+
+/* Called once the close callback returned, nothing touches |handle| after. */
+void uv__handle_pool_put(uv_handle_t* handle) {
+  struct uv__handle_pool* pool;
+  uv_handle_type type;
+
+  type = handle->type;
+  pool = &uv__get_internal_fields(handle->loop)->handle_pool;
+  pool->in_use[type]--;
+  if (pool->nfree[type] >= UV__HANDLE_POOL_MAX_FREE) {
+    uv__free(handle);
+    return;
+  }
+
+  handle->data = pool->free[type];
+  pool->free[type] = handle;
+  pool->nfree[type]++;
+}
+
+
+void uv__handle_pool_delete(uv_loop_t* loop) {
+  struct uv__handle_pool* pool;
+  uv_handle_t* handle;
+  unsigned int i;
+
+  pool = &uv__get_internal_fields(loop)->handle_pool;
+  for (i = 0; i < UV_HANDLE_TYPE_MAX; i++) {
+    while (pool->free[i] != NULL) {
+      handle = pool->free[i];
+      pool->free[i] = handle->data;
+      uv__free(handle);
+    }
+    pool->nfree[i] = 0;
+  }
+}
+
+
 void uv_os_free_environ(uv_env_item_t* envitems, int count) {
   int i;
 
@@ -953,6 +2060,304 @@ void uv__metrics_set_provider_entry_time(uv_loop_t* loop) {
 }
 
 
+uint64_t uv__metrics_phase_start(uv_loop_t* loop) {
+  if (!(uv__get_internal_fields(loop)->flags & UV__METRICS_PHASE_TIME))
+    return 0;
+
+  return uv_hrtime();
+}
+
+
+/* Charges the time since |*t| to |phase| and starts the next phase. A zero
+ * |*t| means timing was turned on halfway through the loop iteration.
+ */
+void uv__metrics_phase(uv_loop_t* loop, uv_metrics_phase phase, uint64_t* t) {
+  uv__loop_internal_fields_t* lfields;
+  uint64_t now;
+
+  /* The phases always run in the same order, the closing handles phase is
+   * followed by the timers of the next loop iteration.
+   */
+  lfields = uv__get_internal_fields(loop);
+  lfields->phase = phase + 1;
+  if (lfields->phase == UV_METRICS_PHASE_MAX)
+    lfields->phase = UV_METRICS_PHASE_TIMERS;
+
+  if (!(lfields->flags & UV__METRICS_PHASE_TIME))
+    return;
+
+  now = uv_hrtime();
+  if (*t != 0)
+    uv__get_loop_metrics(loop)->phase_time[phase] += now - *t;
+  *t = now;
+}
+
+
+/* Records a callback that started at |start| in the trace and reports it if
+ * it ran for longer than the slow callback threshold. |handle| is only
+ * passed on, it may be closed and gone by now.
+ */
+void uv__callback_done(uv_loop_t* loop,
+                       uv_handle_t* handle,
+                       uv_handle_type type,
+                       void (*cb)(void),
+                       uint64_t start) {
+  uv__loop_internal_fields_t* lfields;
+  uv_slow_callback_info_t info;
+  uv_trace_event_t* event;
+  uint64_t duration;
+
+  duration = uv_hrtime() - start;
+
+  /* Either can have been turned off by the callback. */
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->trace_events != NULL) {
+    event = &lfields->trace_events[lfields->trace_count++ %
+                                   lfields->trace_size];
+    event->start = start;
+    event->duration = duration;
+    event->phase = lfields->phase;
+    event->type = type;
+    event->cb = cb;
+  }
+
+  if (lfields->slow_cb == NULL || duration < lfields->slow_cb_threshold)
+    return;
+
+  info.handle = handle;
+  info.type = type;
+  info.cb = cb;
+  info.duration = duration;
+  lfields->slow_cb(loop, &info);
+}
+
+
+int uv_loop_trace_start(uv_loop_t* loop,
+                        uv_trace_event_t* events,
+                        size_t nevents) {
+  uv__loop_internal_fields_t* lfields;
+
+  if (events == NULL || nevents == 0)
+    return UV_EINVAL;
+
+  lfields = uv__get_internal_fields(loop);
+  lfields->trace_events = events;
+  lfields->trace_size = nevents;
+  lfields->trace_count = 0;
+  return 0;
+}
+
+
+void uv_loop_trace_stop(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+
+  lfields = uv__get_internal_fields(loop);
+  lfields->trace_events = NULL;
+  lfields->trace_size = 0;
+  lfields->trace_count = 0;
+}
+
+
+static const char* uv__trace_phase_name(uv_metrics_phase phase) {
+  switch (phase) {
+    case UV_METRICS_PHASE_TIMERS: return "timers";
+    case UV_METRICS_PHASE_PENDING: return "pending";
+    case UV_METRICS_PHASE_IDLE_PREPARE: return "idle_prepare";
+    case UV_METRICS_PHASE_POLL: return "poll";
+    case UV_METRICS_PHASE_CHECK: return "check";
+    case UV_METRICS_PHASE_CLOSING: return "closing";
+    default: return "unknown";
+  }
+}
+
+
+/* Writes the trace in the Trace Event Format that chrome://tracing and
+ * Perfetto read, as complete events with microsecond timestamps.
+ */
+int uv_loop_trace_dump(uv_loop_t* loop, FILE* stream) {
+  uv__loop_internal_fields_t* lfields;
+  const uv_trace_event_t* event;
+  const char* name;
+  uint64_t first;
+  uint64_t i;
+  int pid;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->trace_events == NULL || stream == NULL)
+    return UV_EINVAL;
+
+  first = 0;
+  if (lfields->trace_count > lfields->trace_size)
+    first = lfields->trace_count - lfields->trace_size;
+
+  pid = (int) uv_os_getpid();
+  if (fprintf(stream, "{\"traceEvents\":[") < 0)
+    return UV_EIO;
+
+  for (i = first; i < lfields->trace_count; i++) {
+    event = &lfields->trace_events[i % lfields->trace_size];
+    name = uv_handle_type_name(event->type);
+    if (name == NULL)
+      name = "callback";
+
+    if (fprintf(stream,
+                "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+                "\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"pid\":%d,\"tid\":0,"
+                "\"args\":{\"cb\":\"%p\"}}",
+                i == first ? "" : ",",
+                name,
+                uv__trace_phase_name(event->phase),
+                (unsigned long long) (event->start / 1000),
+                (unsigned) (event->start % 1000),
+                (unsigned long long) (event->duration / 1000),
+                (unsigned) (event->duration % 1000),
+                pid,
+                (void*) (uintptr_t) event->cb) < 0)
+      return UV_EIO;
+  }
+
+  if (fprintf(stream, "\n]}\n") < 0 || fflush(stream) != 0)
+    return UV_EIO;
+
+  return 0;
+}
+
+
+int uv_metrics_info(uv_loop_t* loop, uv_metrics_t* metrics) {
+  uv__loop_metrics_t* loop_metrics;
+  int i;
+
+  if (loop == NULL || metrics == NULL)
+    return UV_EINVAL;
+
+  loop_metrics = uv__get_loop_metrics(loop);
+  memset(metrics, 0, sizeof(*metrics));
+  metrics->loop_count = loop_metrics->loop_count;
+  metrics->events = loop_metrics->events;
+  for (i = 0; i < UV_METRICS_PHASE_MAX; i++)
+    metrics->phase_time[i] = loop_metrics->phase_time[i];
+  metrics->polls = loop_metrics->polls;
+  metrics->polls_empty = loop_metrics->polls_empty;
+  metrics->polls_saturated = loop_metrics->polls_saturated;
+  for (i = 0; i < UV_METRICS_POLL_HISTOGRAM_SIZE; i++)
+    metrics->poll_histogram[i] = loop_metrics->poll_histogram[i];
+
+  return 0;
+}
+
+
+/* Log-linear buckets of microseconds: 0 to 3 get a bucket each, after that
+ * every power of two is split into four buckets.
+ */
+unsigned int uv__histogram_bucket(uint64_t ns) {
+  unsigned int bucket;
+  unsigned int e;
+  uint64_t v;
+
+  v = ns / 1000;
+  if (v < 4)
+    return (unsigned int) v;
+
+  for (e = 2; (v >> (e + 1)) != 0; e++);
+  bucket = 4 * (e - 1) + (unsigned int) ((v >> (e - 2)) & 3);
+  if (bucket >= UV_THREADPOOL_HISTOGRAM_SIZE)
+    bucket = UV_THREADPOOL_HISTOGRAM_SIZE - 1;
+
+  return bucket;
+}
+
+
+void uv__metrics_record_lag(uv_lag_histogram_t* h, uint64_t lag) {
+  h->count++;
+  h->total += lag;
+  if (lag > h->max)
+    h->max = lag;
+  h->histogram[uv__histogram_bucket(lag)]++;
+}
+
+
+/* Called by the backends right after the event provider returned |nevents|
+ * events into a buffer of |capacity|, 0 when it has no fixed size. Negative
+ * |nevents| are failed polls, EINTR and such, they aren't counted.
+ */
+void uv__metrics_poll(uv_loop_t* loop, int nevents, unsigned int capacity) {
+  uv__loop_metrics_t* m;
+  unsigned int bucket;
+  unsigned int n;
+
+  if (nevents < 0)
+    return;
+
+  m = uv__get_loop_metrics(loop);
+  if (uv__metrics_lag_enabled(loop))
+    m->poll_return = uv_hrtime();
+
+  m->poll_nevents = nevents;
+
+  m->polls++;
+  if (nevents == 0)
+    m->polls_empty++;
+  else if (capacity != 0 && (unsigned int) nevents >= capacity)
+    m->polls_saturated++;
+
+  for (bucket = 0, n = nevents; n != 0; n >>= 1)
+    bucket++;
+  if (bucket >= UV_METRICS_POLL_HISTOGRAM_SIZE)
+    bucket = UV_METRICS_POLL_HISTOGRAM_SIZE - 1;
+  m->poll_histogram[bucket]++;
+}
+
+
+int uv_metrics_lag(uv_loop_t* loop, uv_metrics_lag_t* lag) {
+  if (loop == NULL || lag == NULL)
+    return UV_EINVAL;
+
+  *lag = uv__get_loop_metrics(loop)->lag;
+  return 0;
+}
+
+
+int uv_metrics_handle_counts(const uv_loop_t* loop,
+                             uv_handle_counts_t* counts) {
+  const uv__handle_counts_t* c;
+  int i;
+
+  if (loop == NULL || counts == NULL)
+    return UV_EINVAL;
+
+  c = uv__get_handle_counts(loop);
+  for (i = 0; i < UV_HANDLE_TYPE_MAX; i++) {
+    counts->handles[i] = c->handles[i];
+    counts->active[i] = c->active[i];
+    counts->closing[i] = c->closing[i];
+  }
+  for (i = 0; i < UV_REQ_TYPE_MAX; i++)
+    counts->reqs[i] = c->reqs[i];
+
+  return 0;
+}
+
+
+int uv_metrics_handle_pool(const uv_loop_t* loop,
+                           uv_handle_type type,
+                           uv_handle_pool_stats_t* stats) {
+  const struct uv__handle_pool* pool;
+
+  if (loop == NULL || stats == NULL)
+    return UV_EINVAL;
+
+  if (type <= UV_UNKNOWN_HANDLE || type >= UV_HANDLE_TYPE_MAX)
+    return UV_EINVAL;
+
+  pool = &uv__get_internal_fields(loop)->handle_pool;
+  stats->allocated = pool->allocated[type];
+  stats->reused = pool->reused[type];
+  stats->in_use = pool->in_use[type];
+  stats->free = pool->nfree[type];
+  return 0;
+}
+
+
 uint64_t uv_metrics_idle_time(uv_loop_t* loop) {
   uv__loop_metrics_t* loop_metrics;
   uint64_t entry_time;
@@ -41,6 +41,7 @@
 #include "uv/tree.h"
 #include "queue.h"
 #include "strscpy.h"
+#include "uv-trace.h"
 
 #if EDOM > 0
 # define UV__ERR(x) (-(x))
@@ -80,6 +81,9 @@ enum {
   UV_HANDLE_INTERNAL                    = 0x00000010,
   UV_HANDLE_ENDGAME_QUEUED              = 0x00000020,
 
+  /* Allocated by uv_handle_alloc(), recycled after the close callback. */
+  UV_HANDLE_POOLED                      = 0x40000000,
+
   /* Used by streams. */
   UV_HANDLE_LISTENING                   = 0x00000040,
   UV_HANDLE_CONNECTION                  = 0x00000080,
@@ -103,21 +107,29 @@ enum {
   /* Used by uv_tcp_t and uv_udp_t handles */
   UV_HANDLE_IPV6                        = 0x00400000,
 
+  /* Only used by stream handles, see uv_stream_cork(). */
+  UV_HANDLE_CORKED                      = 0x00800000,
+
   /* Only used by uv_tcp_t handles. */
   UV_HANDLE_TCP_NODELAY                 = 0x01000000,
   UV_HANDLE_TCP_KEEPALIVE               = 0x02000000,
   UV_HANDLE_TCP_SINGLE_ACCEPT           = 0x04000000,
   UV_HANDLE_TCP_ACCEPT_STATE_CHANGING   = 0x08000000,
   UV_HANDLE_SHARED_TCP_SOCKET           = 0x10000000,
+  UV_HANDLE_TCP_READ_AHEAD              = 0x20000000,
 
   /* Only used by uv_udp_t handles. */
   UV_HANDLE_UDP_PROCESSING              = 0x01000000,
   UV_HANDLE_UDP_CONNECTED               = 0x02000000,
   UV_HANDLE_UDP_RECVMMSG                = 0x04000000,
+  UV_HANDLE_UDP_GRO                     = 0x08000000,
+  UV_HANDLE_UDP_RIO                     = 0x10000000,
 
   /* Only used by uv_pipe_t handles. */
   UV_HANDLE_NON_OVERLAPPED_PIPE         = 0x01000000,
   UV_HANDLE_PIPESERVER                  = 0x02000000,
+  UV_HANDLE_PIPE_SEQPACKET              = 0x04000000,
+  UV_HANDLE_PIPE_VMSPLICE               = 0x08000000,
 
   /* Only used by uv_tty_t handles. */
   UV_HANDLE_TTY_READABLE                = 0x01000000,
@@ -128,9 +140,13 @@ enum {
   /* Only used by uv_signal_t handles. */
   UV_SIGNAL_ONE_SHOT_DISPATCHED         = 0x01000000,
   UV_SIGNAL_ONE_SHOT                    = 0x02000000,
+  UV_SIGNAL_SIGNALFD                    = 0x04000000,
 
   /* Only used by uv_poll_t handles. */
-  UV_HANDLE_POLL_SLOW                   = 0x01000000
+  UV_HANDLE_POLL_SLOW                   = 0x01000000,
+
+  /* Only used by uv_timer_t handles. */
+  UV_HANDLE_TIMER_WHEEL                 = 0x01000000
 };
 
 int uv__loop_configure(uv_loop_t* loop, uv_loop_option option, va_list ap);
@@ -152,6 +168,14 @@ int uv__tcp_connect(uv_connect_t* req,
                    unsigned int addrlen,
                    uv_connect_cb cb);
 
+int uv__tcp_connect_fastopen(uv_connect_t* req,
+                             uv_tcp_t* handle,
+                             const struct sockaddr* addr,
+                             unsigned int addrlen,
+                             const uv_buf_t bufs[],
+                             unsigned int nbufs,
+                             uv_connect_cb cb);
+
 int uv__udp_init_ex(uv_loop_t* loop,
                     uv_udp_t* handle,
                     unsigned flags,
@@ -178,12 +202,36 @@ int uv__udp_send(uv_udp_send_t* req,
                  unsigned int addrlen,
                  uv_udp_send_cb send_cb);
 
+int uv__udp_send_segmented(uv_udp_send_t* req,
+                           uv_udp_t* handle,
+                           const uv_buf_t* buf,
+                           size_t segment_size,
+                           const struct sockaddr* addr,
+                           unsigned int addrlen,
+                           uv_udp_send_cb send_cb);
+
+int uv__udp_send_from(uv_udp_send_t* req,
+                      uv_udp_t* handle,
+                      const uv_buf_t bufs[],
+                      unsigned int nbufs,
+                      const struct sockaddr* addr,
+                      unsigned int addrlen,
+                      const struct sockaddr* src,
+                      uv_udp_send_cb send_cb);
+
 int uv__udp_try_send(uv_udp_t* handle,
                      const uv_buf_t bufs[],
                      unsigned int nbufs,
                      const struct sockaddr* addr,
                      unsigned int addrlen);
 
+int uv__udp_check_before_send(uv_udp_t* handle, const struct sockaddr* addr);
+
+int uv__udp_try_send_batch(uv_udp_t* handle,
+                           const uv_buf_t bufs[],
+                           const struct sockaddr* const addrs[],
+                           unsigned int count);
+
 int uv__udp_recv_start(uv_udp_t* handle, uv_alloc_cb alloccb,
                        uv_udp_recv_cb recv_cb);
 
@@ -193,10 +241,32 @@ void uv__fs_poll_close(uv_fs_poll_t* handle);
 
 int uv__getaddrinfo_translate_error(int sys_err);    /* EAI_* error. */
 
+/* Counts threads that reached a point, for start-up handshakes. Arriving
+ * doesn't block and waiting only enters the kernel when it has to sleep.
+ * Unlike a semaphore posted from a thread that then goes on running, an
+ * arriving thread doesn't touch the latch after the count is in, so it may
+ * live on the waiter's stack.
+ */
+typedef struct {
+#if defined(__linux__)
+  unsigned int word;  /* Arrivals, the top bit is set while someone waits. */
+#else
+  uv_mutex_t mutex;
+  uv_cond_t cond;
+  unsigned int count;
+#endif
+} uv__latch_t;
+
+int uv__latch_init(uv__latch_t* latch);
+void uv__latch_destroy(uv__latch_t* latch);
+void uv__latch_arrive(uv__latch_t* latch);
+void uv__latch_wait(uv__latch_t* latch, unsigned int count);
+
+/* Same values as uv_threadpool_work_kind. */
 enum uv__work_kind {
-  UV__WORK_CPU,
-  UV__WORK_FAST_IO,
-  UV__WORK_SLOW_IO
+  UV__WORK_CPU = UV_THREADPOOL_WORK_CPU,
+  UV__WORK_FAST_IO = UV_THREADPOOL_WORK_FAST_IO,
+  UV__WORK_SLOW_IO = UV_THREADPOOL_WORK_SLOW_IO
 };
 
 void uv__work_submit(uv_loop_t* loop,
@@ -204,31 +274,154 @@ void uv__work_submit(uv_loop_t* loop,
                      enum uv__work_kind kind,
                      void (*work)(struct uv__work *w),
                      void (*done)(struct uv__work *w, int status));
+void uv__work_submit_priority(uv_loop_t* loop,
+                              struct uv__work *w,
+                              enum uv__work_kind kind,
+                              uv_work_priority priority,
+                              void (*work)(struct uv__work *w),
+                              void (*done)(struct uv__work *w, int status));
+
+void uv__work_post(uv_loop_t* loop,
+                   struct uv__work *w,
+                   void (*done)(struct uv__work *w, int status));
 
 void uv__work_done(uv_async_t* handle);
+#ifdef _WIN32
+/* Windows resolves names without the threadpool, see win/getaddrinfo.c. */
+int uv__getaddrinfo_cancel(uv_getaddrinfo_t* req);
+#endif
+int uv__threadpool_loop_configure(uv_loop_t* loop, unsigned int nthreads);
+void uv__threadpool_loop_close(uv_loop_t* loop);
+int uv__threadpool_loop_share(uv_loop_t* loop, uv_loop_t* owner);
+int uv__threadpool_loop_affinity(uv_loop_t* loop,
+                                 const char* cpumask,
+                                 size_t mask_size);
+#ifndef _WIN32
+int uv__threadpool_loop_fork(uv_loop_t* loop);
+#endif
+
+int uv__thread_pin(unsigned int cpu);
+int uv__thread_setname(const char* name);
+int uv__thread_setpriority(int priority);
 
 size_t uv__count_bufs(const uv_buf_t bufs[], unsigned int nbufs);
 
+void uv__read_pool_alloc(uv_handle_t* handle,
+                         size_t suggested_size,
+                         uv_buf_t* buf);
+void uv__read_pool_put(uv_loop_t* loop, char* base);
+void uv__read_vec_alloc(uv_handle_t* handle,
+                        size_t suggested_size,
+                        uv_buf_t* buf);
+unsigned int uv__read_alloc(uv_stream_t* stream,
+                            size_t suggested_size,
+                            uv_buf_t bufs[],
+                            unsigned int nbufs);
+/* Kept in a side allocation of the stream by each platform. */
+uv_alloc_vec_cb uv__stream_alloc_vec_cb(const uv_stream_t* stream);
+int uv__stream_set_alloc_vec_cb(uv_stream_t* stream, uv_alloc_vec_cb alloc_cb);
+void uv__read_pool_delete(uv_loop_t* loop);
+int uv__read_pool_configure(uv_loop_t* loop, int node);
+void* uv__huge_alloc(size_t size, int node);
+void uv__huge_free(void* base, size_t size);
+uv_buf_t* uv__bufs_pool_get(uv_loop_t* loop, unsigned int nbufs);
+void uv__bufs_pool_put(uv_loop_t* loop, uv_buf_t* bufs, unsigned int nbufs);
+void uv__req_pool_delete(uv_loop_t* loop);
+void uv__handle_pool_put(uv_handle_t* handle);
+void uv__handle_pool_delete(uv_loop_t* loop);
+
 int uv__socket_sockopt(uv_handle_t* handle, int optname, int* value);
 
+uv_work_priority uv__fs_work_priority(uv_fs_type fs_type);
+int uv__fs_copy_range(uv_file in, uv_file out, int64_t off, uint64_t len);
+int uv__fs_clone(uv_file in, uv_file out);
+int uv__fs_dio_check(const uv_buf_t bufs[],
+                     unsigned int nbufs,
+                     int64_t offset,
+                     size_t mem_align,
+                     size_t offset_align);
+int uv__fs_fallocate_check(int flags);
+void uv__fs_event_batch_stop(uv_fs_event_t* handle);
+
+/* State of a uv_fs_event_t that doesn't fit in the handle, allocated on
+ * first use and stored in handle->u.reserved[0]. Freed when the handle is
+ * closed.
+ */
+struct uv__fs_event_state {
+  void* batch;  /* struct batch_ctx, uv_fs_event_start_batch() */
+#if defined(__linux__)
+  void* fanotify;  /* struct fanotify_watch, UV_FS_EVENT_RECURSIVE */
+#endif
+#if defined(_WIN32)
+  unsigned int buffer_size;  /* uv_fs_event_buffer_size(), 0 for default */
+  unsigned int buffer_len;  /* Size of handle->buffer. */
+  int extended_info;  /* ReadDirectoryChangesExW() */
+  const void* current_info;  /* The entry uv_fs_event_getstat() reports. */
+#endif
+};
+
+struct uv__fs_event_state* uv__fs_event_state(uv_fs_event_t* handle);
+void uv__fs_event_state_free(uv_fs_event_t* handle);
+int uv__fs_write_batch_init(uv_fs_t* req,
+                            const uv_fs_write_segment_t segs[],
+                            unsigned int nsegs,
+                            int flags);
+int uv__fs_stat_many_init(uv_fs_t* req,
+                          const char* const paths[],
+                          unsigned int npaths,
+                          uv_stat_t* statbufs,
+                          int* results,
+                          int copy);
 void uv__fs_scandir_cleanup(uv_fs_t* req);
+int uv__realpath_cache_configure(uv_loop_t* loop, unsigned int max_entries);
+void uv__realpath_cache_delete(uv_loop_t* loop);
+char* uv__realpath_cache_lookup(uv_loop_t* loop, const char* path);
+void uv__realpath_cache_store(uv_loop_t* loop,
+                              const char* path,
+                              const char* resolved);
+/* Set internally when the uv_fs_scandir() result is a single allocation. */
+#define UV__FS_SCANDIR_PACKED 0x40000000
 void uv__fs_readdir_cleanup(uv_fs_t* req);
+size_t uv__dirent_packed_size(size_t namelen);
 uv_dirent_type_t uv__fs_get_dirent_type(uv__dirent_t* dent);
 
 int uv__next_timeout(const uv_loop_t* loop);
 void uv__run_timers(uv_loop_t* loop);
+void uv__run_deferred(uv_loop_t* loop);
 void uv__timer_close(uv_timer_t* handle);
+int uv__timer_wheel_enable(uv_loop_t* loop);
+void uv__timer_wheel_delete(uv_loop_t* loop);
+void uv__timer_heap_delete(uv_loop_t* loop);
 
 void uv__process_title_cleanup(void);
 void uv__signal_cleanup(void);
 void uv__threadpool_cleanup(void);
 
+/* Stored in req->ptr by uv_fs_stat_many(), released by uv_fs_req_cleanup(). */
+struct uv__fs_write_batch {
+  unsigned int nsegs;
+  uv_fs_write_segment_t* segs;  /* bufs point into the same allocation. */
+  ssize_t written;       /* By the ring, before a short write. */
+  unsigned int pending;  /* Ring completions still to come. */
+  unsigned int next;     /* Segment the next ring completion is for. */
+  int resume;            /* First segment the ring didn't finish, or -1. */
+  int error;
+};
+
+struct uv__fs_stat_many {
+  unsigned int npaths;
+  uv_stat_t* statbufs;
+  int* results;
+  const char** paths;
+};
+
 #define uv__has_active_reqs(loop)                                             \
   ((loop)->active_reqs.count > 0)
 
 #define uv__req_register(loop, req)                                           \
   do {                                                                        \
     (loop)->active_reqs.count++;                                              \
+    uv__get_handle_counts(loop)->reqs[(req)->type]++;                         \
   }                                                                           \
   while (0)
 
@@ -236,6 +429,7 @@ void uv__threadpool_cleanup(void);
   do {                                                                        \
     assert(uv__has_active_reqs(loop));                                        \
     (loop)->active_reqs.count--;                                              \
+    uv__get_handle_counts(loop)->reqs[(req)->type]--;                         \
   }                                                                           \
   while (0)
 
@@ -260,10 +454,21 @@ void uv__threadpool_cleanup(void);
 #define uv__is_closing(h)                                                     \
   (((h)->flags & (UV_HANDLE_CLOSING | UV_HANDLE_CLOSED)) != 0)
 
+/* UV_NETIF sits past UV_HANDLE_TYPE_MAX, the internal counters give it the
+ * slot after the last regular handle type.
+ */
+#define UV__HANDLE_TYPE_SLOTS (UV_HANDLE_TYPE_MAX + 1)
+
+#define uv__handle_type_slot(type)                                            \
+  ((type) == UV_NETIF ? (int) UV_HANDLE_TYPE_MAX : (int) (type))
+
+#define uv__handle_slot(h) uv__handle_type_slot((h)->type)
+
 #define uv__handle_start(h)                                                   \
   do {                                                                        \
     if (((h)->flags & UV_HANDLE_ACTIVE) != 0) break;                          \
     (h)->flags |= UV_HANDLE_ACTIVE;                                           \
+    uv__get_handle_counts((h)->loop)->active[uv__handle_slot(h)]++;           \
     if (((h)->flags & UV_HANDLE_REF) != 0) uv__active_handle_add(h);          \
   }                                                                           \
   while (0)
@@ -272,6 +477,7 @@ void uv__threadpool_cleanup(void);
   do {                                                                        \
     if (((h)->flags & UV_HANDLE_ACTIVE) == 0) break;                          \
     (h)->flags &= ~UV_HANDLE_ACTIVE;                                          \
+    uv__get_handle_counts((h)->loop)->active[uv__handle_slot(h)]--;           \
     if (((h)->flags & UV_HANDLE_REF) != 0) uv__active_handle_rm(h);           \
   }                                                                           \
   while (0)
@@ -297,7 +503,9 @@ void uv__threadpool_cleanup(void);
 #define uv__has_ref(h)                                                        \
   (((h)->flags & UV_HANDLE_REF) != 0)
 
-#if defined(_WIN32)
+#if defined(_WIN32) && defined(UV_COMPACT_HANDLES)
+# define uv__handle_platform_init(h) ((h)->endgame_next = NULL)
+#elif defined(_WIN32)
 # define uv__handle_platform_init(h) ((h)->u.fd = -1)
 #else
 # define uv__handle_platform_init(h) ((h)->next_closing = NULL)
@@ -309,10 +517,28 @@ void uv__threadpool_cleanup(void);
     (h)->type = (type_);                                                      \
     (h)->flags = UV_HANDLE_REF;  /* Ref the loop when active. */              \
     QUEUE_INSERT_TAIL(&(loop_)->handle_queue, &(h)->handle_queue);            \
+    uv__get_handle_counts(loop_)->handles[uv__handle_type_slot(type_)]++;     \
     uv__handle_platform_init(h);                                              \
   }                                                                           \
   while (0)
 
+/* Takes |h| off the loop's handle queue, either when it finished closing or
+ * when its init function fails after uv__handle_init().
+ */
+#define uv__handle_remove(h)                                                  \
+  do {                                                                        \
+    uv__handle_counts_t* counts_;                                             \
+    counts_ = uv__get_handle_counts((h)->loop);                               \
+    counts_->handles[uv__handle_slot(h)]--;                                   \
+    if (((h)->flags & UV_HANDLE_CLOSING) != 0)                                \
+      counts_->closing[uv__handle_slot(h)]--;                                 \
+    QUEUE_REMOVE(&(h)->handle_queue);                                         \
+  }                                                                           \
+  while (0)
+
+#define uv__handle_count_closing(h)                                           \
+  (uv__get_handle_counts((h)->loop)->closing[uv__handle_slot(h)]++)
+
 /* Note: uses an open-coded version of SET_REQ_SUCCESS() because of
  * a circular dependency between src/uv-common.h and src/win/internal.h.
  */
@@ -341,33 +567,273 @@ void uv__threadpool_cleanup(void);
 #define uv__get_internal_fields(loop)                                         \
   ((uv__loop_internal_fields_t*) loop->internal_fields)
 
+#define uv__has_deferred(loop)                                                \
+  (!QUEUE_EMPTY(&uv__get_internal_fields(loop)->defer_queue))
+
 #define uv__get_loop_metrics(loop)                                            \
   (&uv__get_internal_fields(loop)->loop_metrics)
 
-/* Allocator prototypes */
-void *uv__calloc(size_t count, size_t size);
-char *uv__strdup(const char* s);
-char *uv__strndup(const char* s, size_t n);
-void* uv__malloc(size_t size);
+#define uv__get_handle_counts(loop)                                           \
+  (&uv__get_internal_fields(loop)->handle_counts)
+
+/* Allocator prototypes. A source file attributes its allocations to a
+ * subsystem by defining UV__ALLOC_TAG before it includes any header, see
+ * uv_replace_allocator_tagged().
+ */
+#ifndef UV__ALLOC_TAG
+# define UV__ALLOC_TAG UV_ALLOC_TAG_OTHER
+#endif
+
+void* uv__calloc_tag(size_t count, size_t size, uv_alloc_tag tag);
+char* uv__strdup_tag(const char* s, uv_alloc_tag tag);
+char* uv__strndup_tag(const char* s, size_t n, uv_alloc_tag tag);
+void* uv__malloc_tag(size_t size, uv_alloc_tag tag);
 void uv__free(void* ptr);
-void* uv__realloc(void* ptr, size_t size);
-void* uv__reallocf(void* ptr, size_t size);
+void* uv__realloc_tag(void* ptr, size_t size, uv_alloc_tag tag);
+void* uv__reallocf_tag(void* ptr, size_t size, uv_alloc_tag tag);
+
+#define uv__calloc(count, size) uv__calloc_tag((count), (size), UV__ALLOC_TAG)
+#define uv__strdup(s) uv__strdup_tag((s), UV__ALLOC_TAG)
+#define uv__strndup(s, n) uv__strndup_tag((s), (n), UV__ALLOC_TAG)
+#define uv__malloc(size) uv__malloc_tag((size), UV__ALLOC_TAG)
+#define uv__realloc(ptr, size) uv__realloc_tag((ptr), (size), UV__ALLOC_TAG)
+#define uv__reallocf(ptr, size) uv__reallocf_tag((ptr), (size), UV__ALLOC_TAG)
 
 typedef struct uv__loop_metrics_s uv__loop_metrics_t;
+typedef struct uv__handle_counts_s uv__handle_counts_t;
 typedef struct uv__loop_internal_fields_s uv__loop_internal_fields_t;
 
 struct uv__loop_metrics_s {
   uint64_t provider_entry_time;
   uint64_t provider_idle_time;
+  uint64_t loop_count;
+  uint64_t events;
+  uint64_t phase_time[UV_METRICS_PHASE_MAX];
+  uint64_t polls;
+  uint64_t polls_empty;
+  uint64_t polls_saturated;
+  uint64_t poll_histogram[UV_METRICS_POLL_HISTOGRAM_SIZE];
+  uint64_t poll_return;  /* With UV_METRICS_LAG, when the last poll ended. */
+  unsigned int poll_nevents;  /* What the last poll returned. */
+  uv_metrics_lag_t lag;
   uv_mutex_t lock;
 };
 
+/* Set in uv__loop_internal_fields_t.flags by UV_METRICS_PHASE_TIME. The
+ * UV_METRICS_IDLE_TIME option doubles as its own flag.
+ */
+#define UV__METRICS_PHASE_TIME 0x100
+#define UV__METRICS_LAG 0x200
+#define UV__LOOP_EDGE_TRIGGERED 0x400  /* UV_LOOP_EDGE_TRIGGERED */
+#define UV__LOOP_COARSE_CLOCK 0x800  /* UV_LOOP_COARSE_CLOCK */
+
+#define uv__metrics_lag_enabled(loop)                                         \
+  ((uv__get_internal_fields(loop)->flags & UV__METRICS_LAG) != 0)
+
+/* Whether callbacks need timing, for UV_LOOP_SLOW_CALLBACK or a trace. */
+#define uv__callbacks_timed(loop)                                             \
+  (uv__get_internal_fields(loop)->slow_cb != NULL ||                          \
+   uv__get_internal_fields(loop)->trace_events != NULL)
+
+#define uv__metrics_inc_loop_count(loop)                                      \
+  (uv__get_loop_metrics(loop)->loop_count++)
+
+#define uv__metrics_inc_events(loop, e)                                       \
+  (uv__get_loop_metrics(loop)->events += (e))
+
+/* Maintained by the handle and request macros above. */
+struct uv__handle_counts_s {
+  unsigned int handles[UV__HANDLE_TYPE_SLOTS];
+  unsigned int active[UV__HANDLE_TYPE_SLOTS];
+  unsigned int closing[UV__HANDLE_TYPE_SLOTS];
+  unsigned int reqs[UV_REQ_TYPE_MAX];
+};
+
 void uv__metrics_update_idle_time(uv_loop_t* loop);
 void uv__metrics_set_provider_entry_time(uv_loop_t* loop);
+uint64_t uv__metrics_phase_start(uv_loop_t* loop);
+void uv__callback_done(uv_loop_t* loop,
+                       uv_handle_t* handle,
+                       uv_handle_type type,
+                       void (*cb)(void),
+                       uint64_t start);
+void uv__metrics_phase(uv_loop_t* loop, uv_metrics_phase phase, uint64_t* t);
+void uv__metrics_record_lag(uv_lag_histogram_t* h, uint64_t lag);
+void uv__metrics_poll(uv_loop_t* loop, int nevents, unsigned int capacity);
+unsigned int uv__histogram_bucket(uint64_t ns);
+
+#ifdef __linux__
+struct uv__iou_ms;
+struct uv__iou_buf;
+
+struct uv__iou {
+  uint32_t* sqhead;
+  uint32_t* sqtail;
+  uint32_t* sqarray;
+  uint32_t sqmask;
+  uint32_t* cqhead;
+  uint32_t* cqtail;
+  uint32_t cqmask;
+  void* sq;   /* pointer to munmap() on event loop teardown */
+  void* cqe;  /* pointer to array of struct uv__io_uring_cqe */
+  void* sqe;  /* pointer to array of struct uv__io_uring_sqe */
+  size_t sqlen;
+  size_t cqlen;
+  size_t maxlen;
+  size_t sqelen;
+  uint32_t* fdgen;       /* Per-fd poll generation, see linux-iouring.c. */
+  uint32_t* fdmask;      /* Per-fd armed poll mask, 0 if not armed. */
+  unsigned int nfdgen;
+  unsigned int in_flight;  /* uv_fs_t requests submitted to the ring. */
+  unsigned int narmed;     /* Poll and multishot requests not ended yet. */
+  struct uv__iou_ms* ms;   /* Per-fd multishot accept or recv state. */
+  struct uv__iou_buf* bufs;  /* Provided buffers, NULL until first recv. */
+  void* bufring;         /* Buffer ring shared with the kernel. */
+  char* bufbase;
+  uint16_t buftail;
+  unsigned int multishot;  /* Multishot requests the kernel supports. */
+  int ready;             /* First fd with received data to hand out. */
+  int ringfd;
+};
+#endif  /* __linux__ */
+
+/* Shared read buffers of uv_read_start_pooled(). */
+#define UV__READ_POOL_BUFSIZE (64 * 1024)
+
+/* Most buffers an alloc_vec_cb can hand out for one read. */
+#define UV__READ_VEC_MAX 16
+#define UV__READ_POOL_MAX_FREE 16
+
+/* With UV_LOOP_HUGE_PAGES the buffers are carved out of arenas of this size,
+ * a 2 MiB huge page on x86_64 and most arm64 kernels.
+ */
+#define UV__READ_POOL_ARENA_SIZE (2 * 1024 * 1024)
+#define UV__NUMA_MAX_NODES 1024
+
+struct uv__read_pool_arena {
+  struct uv__read_pool_arena* next;
+  char* base;
+};
+
+struct uv__read_pool {
+  char* free;
+  unsigned int nfree;
+  unsigned int nused;  /* Buffers handed out and not yet put back. */
+  int huge_pages;
+  int node;  /* NUMA node of the arenas, -1 for the loop thread's. */
+  struct uv__read_pool_arena* arenas;
+};
+
+/* Free lists of uv_req_alloc() and of the uv_buf_t arrays that writes and
+ * sends copy when they don't fit in bufsml. Array class `i` holds
+ * UV__BUFS_POOL_MIN << i entries.
+ */
+#define UV__REQ_POOL_MAX_FREE 64
+#define UV__BUFS_POOL_MIN 8
+#define UV__BUFS_POOL_CLASSES 4
+#define UV__BUFS_POOL_MAX_FREE 16
+
+struct uv__req_pool {
+  void* free[UV_REQ_TYPE_MAX];
+  unsigned int nfree[UV_REQ_TYPE_MAX];
+  uv_buf_t* bufs_free[UV__BUFS_POOL_CLASSES];
+  unsigned int bufs_nfree[UV__BUFS_POOL_CLASSES];
+};
+
+/* Free lists of uv_handle_alloc(), linked through the data field. */
+#define UV__HANDLE_POOL_MAX_FREE 1024
+
+struct uv__handle_pool {
+  void* free[UV_HANDLE_TYPE_MAX];
+  unsigned int nfree[UV_HANDLE_TYPE_MAX];
+  uint64_t in_use[UV_HANDLE_TYPE_MAX];
+  uint64_t allocated[UV_HANDLE_TYPE_MAX];
+  uint64_t reused[UV_HANDLE_TYPE_MAX];
+};
+
+/* Most AcceptEx requests uv_tcp_set_pending_accepts() lets a server post. */
+#define UV__TCP_PENDING_ACCEPTS_MAX 4096
+
+/* Most instances uv_pipe_set_pending_instances() lets a pipe server create. */
+#define UV__PIPE_PENDING_INSTANCES_MAX 1024
+
+/* Most receives uv_udp_set_recv_depth() lets a UDP handle keep posted. */
+#define UV__UDP_RECV_DEPTH_MAX 64
+
+/* Largest buffer uv_tty_set_write_buffer() accepts, in bytes. */
+#define UV__TTY_WRITE_BUFFER_MAX (4 * 1024 * 1024)
+
+/* Largest payload that uv_write_copy() takes. */
+#define UV__WRITE_COPY_MAX (16 * 1024)
+
+/* Array-backed 4-ary min-heap of timers, see src/timer.c. */
+struct uv__timer_heap {
+  uv_timer_t** timers;
+  unsigned int nelts;
+  unsigned int size;
+};
 
 struct uv__loop_internal_fields_s {
   unsigned int flags;
+  void* defer_queue[2];  /* uv_defer() */
+  void* completion_head;  /* uv_loop_poll_completions() */
+  void* completion_tail;
+  uv_completion_ready_cb completion_cb;
+  uv_defer_t completion_req;
+  uv_read_result_t* read_batch;  /* uv_read_batched_cb() */
+  size_t read_batch_count;
+  size_t read_batch_size;
+  uv_read_batch_cb read_batch_cb;
+  uv_defer_t read_batch_req;
   uv__loop_metrics_t loop_metrics;
+  uv__handle_counts_t handle_counts;
+  struct uv__timer_heap timer_heap;
+  struct uv__timer_wheel* timer_wheel;
+  struct uv__threadpool* threadpool;
+  unsigned int threadpool_next;
+  void* work_done;       /* Finished requests, see finish_work(). */
+  void* work_records;    /* Free ones, see work_record_get(). */
+  void* work_tag;        /* uv_work_set_scope() */
+  uint64_t work_timeout; /* In nanoseconds. */
+  char* threadpool_cpumask;  /* UV_LOOP_THREADPOOL_AFFINITY */
+  size_t threadpool_mask_size;
+  struct uv__read_pool read_pool;
+  struct uv__req_pool req_pool;
+  struct uv__handle_pool handle_pool;
+  uv_slow_callback_cb slow_cb;  /* UV_LOOP_SLOW_CALLBACK */
+  uint64_t slow_cb_threshold;   /* In nanoseconds. */
+  uv_trace_event_t* trace_events;  /* uv_loop_trace_start() */
+  size_t trace_size;
+  uint64_t trace_count;  /* Recorded in total, the ring has the last ones. */
+  uv_metrics_phase phase;  /* The one uv_run() is in. */
+  void* poll_events;  /* UV_LOOP_EVENT_BUFFER_SIZE, NULL if on the stack. */
+  unsigned int poll_nevents;    /* Capacity of poll_events. */
+  unsigned int poll_saturated;  /* Consecutive polls that filled it. */
+  struct uv__realpath_cache* realpath_cache;  /* UV_LOOP_REALPATH_CACHE */
+#ifndef _WIN32
+  void* async_pending;  /* Lock-free stack of signalled uv_async_t handles. */
+  int async_awake;  /* In uv_run() but not in uv__io_poll(), see async.c. */
+  unsigned int accept_batch;  /* UV_LOOP_ACCEPT_BATCH, 0 means 1. */
+  struct uv__dns_resolver* dns;  /* UV_LOOP_USE_DNS_RESOLVER */
+  uint64_t busy_poll;  /* UV_LOOP_BUSY_POLL, in nanoseconds. */
+  int prefer_busy_poll;  /* A socket asked for SO_PREFER_BUSY_POLL. */
+  unsigned int io_budget;  /* UV_LOOP_IO_BUDGET callbacks, 0 for no limit. */
+  unsigned int io_budget_time;  /* And milliseconds, 0 for no limit. */
+  /* uv_io_priority by fd, NULL until a watcher isn't UV_IO_PRIORITY_NORMAL. */
+  unsigned char* io_priorities;
+  unsigned int nio_priorities;
+  void* poll_changes;  /* kqueue: EV_DELETEs for the next kevent() call. */
+  int* close_batch;  /* uv_close_many(): fds to close once it's done. */
+  unsigned int close_batch_count;
+  unsigned int close_batch_size;
+#else
+  void* hr_timer;  /* UV_LOOP_HIGH_RES_TIMERS, a waitable timer HANDLE. */
+  void* hr_timer_wait;  /* Its RegisterWaitForSingleObject() handle. */
+#endif
+#ifdef __linux__
+  struct uv__iou iou;
+  uv__io_t signalfd_watcher;  /* UV_SIGNAL_SIGNALFD handles. */
+#endif  /* __linux__ */
 };
 
 #endif /* UV_COMMON_H_ */
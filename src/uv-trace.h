@@ -0,0 +1,63 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Static tracepoints. With <sys/sdt.h> available they are USDT probes in the
+ * "libuv" provider: a single nop per probe site until a tracer such as
+ * bpftrace or perf attaches. Windows builds with UV_USE_ETW emit TraceLogging
+ * events from the "libuv" ETW provider instead. Everywhere else they compile
+ * to nothing and the arguments are never evaluated.
+ *
+ * Every probe passes the object it is about first (loop, stream, timer or
+ * work item) and optionally one integer.
+ */
+
+#ifndef UV_TRACE_H_
+#define UV_TRACE_H_
+
+#if defined(HAVE_SYS_SDT_H)
+# include <sys/sdt.h>
+# define UV__TRACE1(name, p)                                                  \
+  DTRACE_PROBE1(libuv, name, (void*) (p))
+# define UV__TRACE2(name, p, v)                                               \
+  DTRACE_PROBE2(libuv, name, (void*) (p), (long) (v))
+#elif defined(_WIN32) && defined(UV_USE_ETW)
+# include <TraceLoggingProvider.h>
+TRACELOGGING_DECLARE_PROVIDER(uv__trace_provider);
+# define UV__TRACE1(name, p)                                                  \
+  TraceLoggingWrite(uv__trace_provider,                                       \
+                    #name,                                                    \
+                    TraceLoggingPointer((const void*) (p), "object"))
+# define UV__TRACE2(name, p, v)                                               \
+  TraceLoggingWrite(uv__trace_provider,                                       \
+                    #name,                                                    \
+                    TraceLoggingPointer((const void*) (p), "object"),         \
+                    TraceLoggingInt64((INT64) (v), "value"))
+#else
+/* Keep the arguments referenced so variables that only feed a probe don't
+ * trigger unused warnings. The dead branch is compiled out.
+ */
+# define UV__TRACE1(name, p)                                                  \
+  do { if (0) (void) (p); } while (0)
+# define UV__TRACE2(name, p, v)                                               \
+  do { if (0) { (void) (p); (void) (v); } } while (0)
+#endif
+
+#endif  /* UV_TRACE_H_ */
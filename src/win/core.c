@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_LOOP
+
 #include <assert.h>
 #include <errno.h>
 #include <limits.h>
@@ -33,7 +35,6 @@
 #include "internal.h"
 #include "queue.h"
 #include "handle-inl.h"
-#include "heap-inl.h"
 #include "req-inl.h"
 
 /* uv_once initialization guards */
@@ -173,7 +174,19 @@ void uv__wake_all_loops(void) {
   uv_mutex_unlock(&uv__loops_lock);
 }
 
+#ifdef UV_USE_ETW
+/* Name-derived GUID of the "libuv" provider, see uv-trace.h. */
+TRACELOGGING_DEFINE_PROVIDER(uv__trace_provider,
+                             "libuv",
+                             (0x7a95acfb, 0x77ec, 0x5858, 0x8b, 0x77,
+                              0x25, 0x69, 0xd8, 0x96, 0x83, 0x35));
+#endif
+
 static void uv_init(void) {
+#ifdef UV_USE_ETW
+  TraceLoggingRegister(uv__trace_provider);
+#endif
+
   /* Tell Windows that we will handle critical errors. */
   SetErrorMode(SEM_FAILCRITICALERRORS | SEM_NOGPFAULTERRORBOX |
                SEM_NOOPENFILEERRORBOX);
@@ -223,7 +236,6 @@ static void uv_init(void) {
 
 int uv_loop_init(uv_loop_t* loop) {
   uv__loop_internal_fields_t* lfields;
-  struct heap* timer_heap;
   int err;
 
   /* Initialize libuv itself first */
@@ -238,6 +250,7 @@ int uv_loop_init(uv_loop_t* loop) {
   if (lfields == NULL)
     return UV_ENOMEM;
   loop->internal_fields = lfields;
+  QUEUE_INIT(&lfields->defer_queue);
 
   err = uv_mutex_init(&lfields->loop_metrics.lock);
   if (err)
@@ -258,13 +271,8 @@ int uv_loop_init(uv_loop_t* loop) {
 
   loop->endgame_handles = NULL;
 
-  loop->timer_heap = timer_heap = uv__malloc(sizeof(*timer_heap));
-  if (timer_heap == NULL) {
-    err = UV_ENOMEM;
-    goto fail_timers_alloc;
-  }
-
-  heap_init(timer_heap);
+  /* Timers live in the internal fields now, see src/timer.c. */
+  loop->timer_heap = NULL;
 
   loop->check_handles = NULL;
   loop->prepare_handles = NULL;
@@ -303,10 +311,6 @@ fail_async_init:
   uv_mutex_destroy(&loop->wq_mutex);
 
 fail_mutex_init:
-  uv__free(timer_heap);
-  loop->timer_heap = NULL;
-
-fail_timers_alloc:
   uv_mutex_destroy(&lfields->loop_metrics.lock);
 
 fail_metrics_mutex_init:
@@ -360,10 +364,16 @@ void uv__loop_close(uv_loop_t* loop) {
   uv_mutex_unlock(&loop->wq_mutex);
   uv_mutex_destroy(&loop->wq_mutex);
 
-  uv__free(loop->timer_heap);
-  loop->timer_heap = NULL;
+  uv__timer_heap_delete(loop);
+  uv__timer_wheel_delete(loop);
 
   lfields = uv__get_internal_fields(loop);
+  if (lfields->hr_timer != NULL) {
+    UnregisterWaitEx(lfields->hr_timer_wait, INVALID_HANDLE_VALUE);
+    CloseHandle(lfields->hr_timer);
+  }
+  uv__free(lfields->read_batch);
+  uv__free(lfields->poll_events);
   uv_mutex_destroy(&lfields->loop_metrics.lock);
   uv__free(lfields);
   loop->internal_fields = NULL;
@@ -372,6 +382,148 @@ void uv__loop_close(uv_loop_t* loop) {
 }
 
 
+/* Bounds of the UV_LOOP_EVENT_BUFFER_SIZE buffer. It doubles after this many
+ * consecutive polls filled it.
+ */
+#define UV__IOCP_ENTRIES_MAX (64 * 1024)
+#define UV__IOCP_GROW_AFTER 4
+
+
+static int uv__iocp_buffer_size(uv_loop_t* loop, unsigned int nentries) {
+  uv__loop_internal_fields_t* lfields;
+  OVERLAPPED_ENTRY* entries;
+
+  if (nentries == 0 || nentries > UV__IOCP_ENTRIES_MAX)
+    return UV_EINVAL;
+
+  /* Completions are only queued while uv__poll() walks the buffer, no
+   * callback runs in between, so it is never in use here. */
+  lfields = uv__get_internal_fields(loop);
+  entries = uv__malloc(nentries * sizeof(*entries));
+  if (entries == NULL)
+    return UV_ENOMEM;
+
+  uv__free(lfields->poll_events);
+  lfields->poll_events = entries;
+  lfields->poll_nevents = nentries;
+  lfields->poll_saturated = 0;
+
+  return 0;
+}
+
+
+/* Called after a poll that dequeued `count` entries. Failing to grow the
+ * buffer is no problem, the completions that didn't fit are picked up by the
+ * next poll.
+ */
+static void uv__iocp_buffer_update(uv_loop_t* loop, ULONG count) {
+  uv__loop_internal_fields_t* lfields;
+  OVERLAPPED_ENTRY* entries;
+  unsigned int nentries;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->poll_events == NULL)
+    return;
+
+  if (count < lfields->poll_nevents) {
+    lfields->poll_saturated = 0;
+    return;
+  }
+
+  if (++lfields->poll_saturated < UV__IOCP_GROW_AFTER)
+    return;
+
+  lfields->poll_saturated = 0;
+  nentries = lfields->poll_nevents * 2;
+  if (nentries > UV__IOCP_ENTRIES_MAX)
+    return;
+
+  entries = uv__realloc(lfields->poll_events, nentries * sizeof(*entries));
+  if (entries == NULL)
+    return;
+
+  lfields->poll_events = entries;
+  lfields->poll_nevents = nentries;
+}
+
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+# define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+
+/* The timer fires on a thread pool thread and wakes uv__poll() with an empty
+ * packet, GetQueuedCompletionStatusEx() itself can't wait more precisely
+ * than the system timer resolution.
+ */
+static void CALLBACK uv__hr_timer_cb(void* data, BOOLEAN didTimeout) {
+  uv_loop_t* loop;
+
+  loop = data;
+  PostQueuedCompletionStatus(loop->iocp, 0, 0, NULL);
+}
+
+
+static int uv__hr_timer_enable(uv_loop_t* loop) {
+  uv__loop_internal_fields_t* lfields;
+  HANDLE timer;
+  HANDLE wait;
+
+  lfields = uv__get_internal_fields(loop);
+  if (lfields->hr_timer != NULL)
+    return 0;
+
+  /* Fails with ERROR_INVALID_PARAMETER before Windows 10 version 1803. */
+  timer = CreateWaitableTimerExW(NULL,
+                                 NULL,
+                                 CREATE_WAITABLE_TIMER_HIGH_RESOLUTION,
+                                 TIMER_ALL_ACCESS);
+  if (timer == NULL) {
+    if (GetLastError() == ERROR_INVALID_PARAMETER)
+      return UV_ENOTSUP;
+    return uv_translate_sys_error(GetLastError());
+  }
+
+  /* A synchronization timer, so the wait fires once per expiry. */
+  if (!RegisterWaitForSingleObject(&wait,
+                                   timer,
+                                   uv__hr_timer_cb,
+                                   loop,
+                                   INFINITE,
+                                   WT_EXECUTEINWAITTHREAD)) {
+    CloseHandle(timer);
+    return uv_translate_sys_error(GetLastError());
+  }
+
+  lfields->hr_timer = timer;
+  lfields->hr_timer_wait = wait;
+  return 0;
+}
+
+
+/* Arms the timer for a poll that waits `timeout` milliseconds, or cancels
+ * it for a poll that doesn't wait or waits forever. Waking up early because
+ * an expiry from an earlier poll races with this is harmless.
+ */
+static void uv__hr_timer_arm(uv_loop_t* loop, DWORD timeout) {
+  LARGE_INTEGER due;
+  HANDLE timer;
+
+  timer = uv__get_internal_fields(loop)->hr_timer;
+  if (timer == NULL)
+    return;
+
+  if (timeout == 0 || timeout == INFINITE) {
+    CancelWaitableTimer(timer);
+    return;
+  }
+
+  /* Relative, in 100 nanosecond units. */
+  due.QuadPart = -(LONGLONG) timeout * 10000;
+  SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE);
+}
+
+
 int uv__loop_configure(uv_loop_t* loop, uv_loop_option option, va_list ap) {
   uv__loop_internal_fields_t* lfields;
 
@@ -381,6 +533,12 @@ int uv__loop_configure(uv_loop_t* loop, uv_loop_option option, va_list ap) {
     return 0;
   }
 
+  if (option == UV_LOOP_EVENT_BUFFER_SIZE)
+    return uv__iocp_buffer_size(loop, va_arg(ap, unsigned int));
+
+  if (option == UV_LOOP_HIGH_RES_TIMERS)
+    return uv__hr_timer_enable(loop);
+
   return UV_ENOSYS;
 }
 
@@ -395,10 +553,16 @@ int uv_loop_fork(uv_loop_t* loop) {
 }
 
 
+int uv_loop_fork_ex(uv_loop_t* loop, uv_loop_fork_cb rearm_cb, void* arg) {
+  return UV_ENOSYS;
+}
+
+
 static int uv__loop_alive(const uv_loop_t* loop) {
   return uv__has_active_handles(loop) ||
          uv__has_active_reqs(loop) ||
          loop->pending_reqs_tail != NULL ||
+         uv__has_deferred(loop) ||
          loop->endgame_handles != NULL;
 }
 
@@ -414,6 +578,7 @@ int uv_backend_timeout(const uv_loop_t* loop) {
       (uv__has_active_handles(loop) || uv__has_active_reqs(loop)) &&
       loop->pending_reqs_tail == NULL &&
       loop->idle_handles == NULL &&
+      !uv__has_deferred(loop) &&
       loop->endgame_handles == NULL)
     return uv__next_timeout(loop);
   return 0;
@@ -452,6 +617,7 @@ static void uv__poll_wine(uv_loop_t* loop, DWORD timeout) {
                               &key,
                               &overlapped,
                               timeout);
+    uv__metrics_poll(loop, overlapped != NULL, 1);
 
     if (reset_timeout != 0) {
       timeout = user_timeout;
@@ -469,6 +635,7 @@ static void uv__poll_wine(uv_loop_t* loop, DWORD timeout) {
       /* Package was dequeued */
       req = uv_overlapped_to_req(overlapped);
       uv_insert_pending_req(loop, req);
+      uv__metrics_inc_events(loop, 1);
 
       /* Some time might have passed waiting for I/O,
        * so update the loop time here.
@@ -502,7 +669,9 @@ static void uv__poll_wine(uv_loop_t* loop, DWORD timeout) {
 static void uv__poll(uv_loop_t* loop, DWORD timeout) {
   BOOL success;
   uv_req_t* req;
-  OVERLAPPED_ENTRY overlappeds[128];
+  OVERLAPPED_ENTRY stack_overlappeds[128];
+  OVERLAPPED_ENTRY* overlappeds;
+  ULONG capacity;
   ULONG count;
   ULONG i;
   int repeat;
@@ -520,6 +689,13 @@ static void uv__poll(uv_loop_t* loop, DWORD timeout) {
     reset_timeout = 0;
   }
 
+  overlappeds = uv__get_internal_fields(loop)->poll_events;
+  capacity = uv__get_internal_fields(loop)->poll_nevents;
+  if (overlappeds == NULL) {
+    overlappeds = stack_overlappeds;
+    capacity = ARRAY_SIZE(stack_overlappeds);
+  }
+
   for (repeat = 0; ; repeat++) {
     /* Only need to set the provider_entry_time if timeout != 0. The function
      * will return early if the loop isn't configured with UV_METRICS_IDLE_TIME.
@@ -527,12 +703,14 @@ static void uv__poll(uv_loop_t* loop, DWORD timeout) {
     if (timeout != 0)
       uv__metrics_set_provider_entry_time(loop);
 
+    uv__hr_timer_arm(loop, timeout);
     success = pGetQueuedCompletionStatusEx(loop->iocp,
                                            overlappeds,
-                                           ARRAY_SIZE(overlappeds),
+                                           capacity,
                                            &count,
                                            timeout,
                                            FALSE);
+    uv__metrics_poll(loop, success ? (int) count : 0, capacity);
 
     if (reset_timeout != 0) {
       timeout = user_timeout;
@@ -554,8 +732,10 @@ static void uv__poll(uv_loop_t* loop, DWORD timeout) {
         if (overlappeds[i].lpOverlapped) {
           req = uv_overlapped_to_req(overlappeds[i].lpOverlapped);
           uv_insert_pending_req(loop, req);
+          uv__metrics_inc_events(loop, 1);
         }
       }
+      uv__iocp_buffer_update(loop, count);
 
       /* Some time might have passed waiting for I/O,
        * so update the loop time here.
@@ -588,6 +768,8 @@ static void uv__poll(uv_loop_t* loop, DWORD timeout) {
 
 int uv_run(uv_loop_t *loop, uv_run_mode mode) {
   DWORD timeout;
+  uint64_t events;
+  uint64_t t;
   int r;
   int ran_pending;
 
@@ -596,21 +778,33 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode) {
     uv_update_time(loop);
 
   while (r != 0 && loop->stop_flag == 0) {
+    UV__TRACE1(loop__iteration__start, loop);
+    uv__metrics_inc_loop_count(loop);
     uv_update_time(loop);
+    t = uv__metrics_phase_start(loop);
     uv__run_timers(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_METRICS_PHASE_TIMERS, &t);
 
     ran_pending = uv_process_reqs(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_METRICS_PHASE_PENDING, &t);
     uv_idle_invoke(loop);
     uv_prepare_invoke(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_METRICS_PHASE_IDLE_PREPARE, &t);
 
     timeout = 0;
     if ((mode == UV_RUN_ONCE && !ran_pending) || mode == UV_RUN_DEFAULT)
       timeout = uv_backend_timeout(loop);
 
+    events = uv__get_loop_metrics(loop)->events;
+    UV__TRACE2(poll__enter, loop, timeout);
     if (pGetQueuedCompletionStatusEx)
       uv__poll(loop, timeout);
     else
       uv__poll_wine(loop, timeout);
+    UV__TRACE2(poll__exit, loop, uv__get_loop_metrics(loop)->events - events);
 
     /* Run one final update on the provider_idle_time in case uv__poll*
      * returned because the timeout expired, but no events were received. This
@@ -619,8 +813,21 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode) {
      */
     uv__metrics_update_idle_time(loop);
 
+    /* Run the callbacks of what was just dequeued now, in one go, rather than
+     * on the next iteration after the check and closing callbacks. That is
+     * what the Unix backends do. Requests they post can complete right away,
+     * a few more rounds pick those up too without starving the loop. */
+    for (r = 0; r < 8 && loop->pending_reqs_tail != NULL; r++)
+      uv_process_reqs(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_METRICS_PHASE_POLL, &t);
+
     uv_check_invoke(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_METRICS_PHASE_CHECK, &t);
     uv_process_endgames(loop);
+    uv__run_deferred(loop);
+    uv__metrics_phase(loop, UV_METRICS_PHASE_CLOSING, &t);
 
     if (mode == UV_RUN_ONCE) {
       /* UV_RUN_ONCE implies forward progress: at least one callback must have
@@ -632,9 +839,12 @@ int uv_run(uv_loop_t *loop, uv_run_mode mode) {
        * the check.
        */
       uv__run_timers(loop);
+      uv__run_deferred(loop);
+      uv__metrics_phase(loop, UV_METRICS_PHASE_TIMERS, &t);
     }
 
     r = uv__loop_alive(loop);
+    UV__TRACE1(loop__iteration__end, loop);
     if (mode == UV_RUN_ONCE || mode == UV_RUN_NOWAIT)
       break;
   }
@@ -713,6 +923,31 @@ int uv__socket_sockopt(uv_handle_t* handle, int optname, int* value) {
   return 0;
 }
 
+int uv_pacing_rate(uv_handle_t* handle, uint64_t* value) {
+  return UV_ENOSYS;
+}
+
+int uv_handle_set_io_stats(uv_handle_t* handle, int enable) {
+  return UV_ENOSYS;
+}
+
+int uv_handle_get_io_stats(const uv_handle_t* handle, uv_io_stats_t* stats) {
+  return UV_ENOSYS;
+}
+
+int uv_handle_set_io_priority(uv_handle_t* handle,
+                              uv_io_priority priority) {
+  return UV_ENOSYS;
+}
+
+int uv_handle_detach(uv_handle_t* handle) {
+  return UV_ENOSYS;
+}
+
+int uv_handle_attach(uv_handle_t* handle, uv_loop_t* loop) {
+  return UV_ENOSYS;
+}
+
 int uv_cpumask_size(void) {
   return (int)(sizeof(DWORD_PTR) * 8);
 }
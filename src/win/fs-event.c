@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
 #include <assert.h>
 #include <errno.h>
 #include <stdio.h>
@@ -32,29 +34,89 @@
 
 const unsigned int uv_directory_watcher_buffer_size = 4096;
 
+/* Largest buffer that uv_fs_event_buffer_size() accepts. */
+#define UV__FS_EVENT_MAX_BUFFER_SIZE (64 * 1024 * 1024)
+
+#define UV__FS_EVENT_NOTIFY_FILTER                                            \
+  (FILE_NOTIFY_CHANGE_FILE_NAME      |                                        \
+   FILE_NOTIFY_CHANGE_DIR_NAME       |                                        \
+   FILE_NOTIFY_CHANGE_ATTRIBUTES     |                                        \
+   FILE_NOTIFY_CHANGE_SIZE           |                                        \
+   FILE_NOTIFY_CHANGE_LAST_WRITE     |                                        \
+   FILE_NOTIFY_CHANGE_LAST_ACCESS    |                                        \
+   FILE_NOTIFY_CHANGE_CREATION       |                                        \
+   FILE_NOTIFY_CHANGE_SECURITY)
+
+
+/* Starts reading changes into handle->buffer. ReadDirectoryChangesExW()
+ * (Windows 10 1709 and later) adds the size, times and file id of every
+ * entry, for uv_fs_event_getstat(). Not all file systems have that, network
+ * shares for one, those fall back to ReadDirectoryChangesW().
+ */
+static BOOL uv__fs_event_read_changes(uv_fs_event_t* handle,
+                                      BOOL watch_subtree) {
+  struct uv__fs_event_state* state;
+  unsigned int size;
+  DWORD err;
+
+  /* Allocated by uv_fs_event_start(). */
+  state = handle->u.reserved[0];
+  size = state->buffer_size;
+  if (size == 0)
+    size = uv_directory_watcher_buffer_size;
+
+  /* The buffer can only be replaced while no read is pending. */
+  if (state->buffer_len != size) {
+    uv__free(handle->buffer);
+    handle->buffer = (char*)uv__malloc(size);
+    if (!handle->buffer) {
+      uv_fatal_error(ERROR_OUTOFMEMORY, "uv__malloc");
+    }
+    state->buffer_len = size;
+  }
+
+  memset(&(handle->req.u.io.overlapped), 0,
+         sizeof(handle->req.u.io.overlapped));
+
+  if (state->extended_info) {
+    if (pReadDirectoryChangesExW(handle->dir_handle,
+                                 handle->buffer,
+                                 state->buffer_len,
+                                 watch_subtree,
+                                 UV__FS_EVENT_NOTIFY_FILTER,
+                                 NULL,
+                                 &handle->req.u.io.overlapped,
+                                 NULL,
+                                 UV__READ_DIRECTORY_NOTIFY_EXTENDED_INFORMATION))
+      return TRUE;
+
+    err = GetLastError();
+    if (err != ERROR_INVALID_PARAMETER &&
+        err != ERROR_INVALID_FUNCTION &&
+        err != ERROR_NOT_SUPPORTED)
+      return FALSE;
+
+    state->extended_info = 0;
+  }
+
+  return ReadDirectoryChangesW(handle->dir_handle,
+                               handle->buffer,
+                               state->buffer_len,
+                               watch_subtree,
+                               UV__FS_EVENT_NOTIFY_FILTER,
+                               NULL,
+                               &handle->req.u.io.overlapped,
+                               NULL);
+}
+
 
 static void uv_fs_event_queue_readdirchanges(uv_loop_t* loop,
     uv_fs_event_t* handle) {
   assert(handle->dir_handle != INVALID_HANDLE_VALUE);
   assert(!handle->req_pending);
 
-  memset(&(handle->req.u.io.overlapped), 0,
-         sizeof(handle->req.u.io.overlapped));
-  if (!ReadDirectoryChangesW(handle->dir_handle,
-                             handle->buffer,
-                             uv_directory_watcher_buffer_size,
-                             (handle->flags & UV_FS_EVENT_RECURSIVE) ? TRUE : FALSE,
-                             FILE_NOTIFY_CHANGE_FILE_NAME      |
-                               FILE_NOTIFY_CHANGE_DIR_NAME     |
-                               FILE_NOTIFY_CHANGE_ATTRIBUTES   |
-                               FILE_NOTIFY_CHANGE_SIZE         |
-                               FILE_NOTIFY_CHANGE_LAST_WRITE   |
-                               FILE_NOTIFY_CHANGE_LAST_ACCESS  |
-                               FILE_NOTIFY_CHANGE_CREATION     |
-                               FILE_NOTIFY_CHANGE_SECURITY,
-                             NULL,
-                             &handle->req.u.io.overlapped,
-                             NULL)) {
+  if (!uv__fs_event_read_changes(handle,
+          (handle->flags & UV_FS_EVENT_RECURSIVE) ? TRUE : FALSE)) {
     /* Make this req pending reporting an error. */
     SET_REQ_ERROR(&handle->req, GetLastError());
     uv_insert_pending_req(loop, (uv_req_t*)&handle->req);
@@ -139,6 +201,7 @@ static int uv_split_path(const WCHAR* filename, WCHAR** dir,
 
 int uv_fs_event_init(uv_loop_t* loop, uv_fs_event_t* handle) {
   uv__handle_init(loop, (uv_handle_t*) handle, UV_FS_EVENT);
+  handle->u.reserved[0] = NULL;
   handle->dir_handle = INVALID_HANDLE_VALUE;
   handle->buffer = NULL;
   handle->req_pending = 0;
@@ -163,11 +226,16 @@ int uv_fs_event_start(uv_fs_event_t* handle,
   DWORD short_path_buffer_len;
   WCHAR *short_path_buffer;
   WCHAR* short_path, *long_path;
+  struct uv__fs_event_state* state;
 
   short_path = NULL;
   if (uv__is_active(handle))
     return UV_EINVAL;
 
+  state = uv__fs_event_state(handle);
+  if (state == NULL)
+    return UV_ENOMEM;
+
   handle->cb = cb;
   handle->path = uv__strdup(path);
   if (!handle->path) {
@@ -298,31 +366,10 @@ short_path_done:
     goto error;
   }
 
-  if (!handle->buffer) {
-    handle->buffer = (char*)uv__malloc(uv_directory_watcher_buffer_size);
-  }
-  if (!handle->buffer) {
-    uv_fatal_error(ERROR_OUTOFMEMORY, "uv__malloc");
-  }
-
-  memset(&(handle->req.u.io.overlapped), 0,
-         sizeof(handle->req.u.io.overlapped));
+  state->extended_info = pReadDirectoryChangesExW != NULL;
 
-  if (!ReadDirectoryChangesW(handle->dir_handle,
-                             handle->buffer,
-                             uv_directory_watcher_buffer_size,
-                             (flags & UV_FS_EVENT_RECURSIVE) ? TRUE : FALSE,
-                             FILE_NOTIFY_CHANGE_FILE_NAME      |
-                               FILE_NOTIFY_CHANGE_DIR_NAME     |
-                               FILE_NOTIFY_CHANGE_ATTRIBUTES   |
-                               FILE_NOTIFY_CHANGE_SIZE         |
-                               FILE_NOTIFY_CHANGE_LAST_WRITE   |
-                               FILE_NOTIFY_CHANGE_LAST_ACCESS  |
-                               FILE_NOTIFY_CHANGE_CREATION     |
-                               FILE_NOTIFY_CHANGE_SECURITY,
-                             NULL,
-                             &handle->req.u.io.overlapped,
-                             NULL)) {
+  if (!uv__fs_event_read_changes(handle,
+          (flags & UV_FS_EVENT_RECURSIVE) ? TRUE : FALSE)) {
     last_error = GetLastError();
     goto error;
   }
@@ -358,6 +405,7 @@ error:
   if (handle->buffer) {
     uv__free(handle->buffer);
     handle->buffer = NULL;
+    state->buffer_len = 0;
   }
 
   if (uv__is_active(handle))
@@ -373,6 +421,8 @@ int uv_fs_event_stop(uv_fs_event_t* handle) {
   if (!uv__is_active(handle))
     return 0;
 
+  uv__fs_event_batch_stop(handle);
+
   if (handle->dir_handle != INVALID_HANDLE_VALUE) {
     CloseHandle(handle->dir_handle);
     handle->dir_handle = INVALID_HANDLE_VALUE;
@@ -404,6 +454,70 @@ int uv_fs_event_stop(uv_fs_event_t* handle) {
 }
 
 
+int uv_fs_event_getstat(const uv_fs_event_t* handle, uv_stat_t* statbuf) {
+  const struct uv__fs_event_state* state;
+  const uv__file_notify_extended_information_t* info;
+  uv__file_stat_basic_information_t stat_info;
+
+  state = handle->u.reserved[0];
+  if (state == NULL || state->current_info == NULL)
+    return UV_ENOTSUP;
+
+  info = state->current_info;
+
+  memset(&stat_info, 0, sizeof(stat_info));
+  stat_info.FileId = info->FileId;
+  stat_info.CreationTime = info->CreationTime;
+  stat_info.LastAccessTime = info->LastAccessTime;
+  stat_info.LastWriteTime = info->LastModificationTime;
+  stat_info.ChangeTime = info->LastChangeTime;
+  stat_info.AllocationSize = info->AllocatedLength;
+  stat_info.EndOfFile = info->FileSize;
+  stat_info.FileAttributes = info->FileAttributes;
+
+  /* The notification has no volume serial number or link count. */
+  memset(statbuf, 0, sizeof(*statbuf));
+  uv__fs_stat_assign_statbuf(statbuf, &stat_info);
+  return 0;
+}
+
+
+int uv_fs_event_buffer_size(uv_fs_event_t* handle, int* value) {
+  struct uv__fs_event_state* state;
+  unsigned int size;
+
+  if (*value < 0)
+    return UV_EINVAL;
+
+  if (*value == 0) {
+    state = handle->u.reserved[0];
+    if (state == NULL || state->buffer_size == 0)
+      *value = (int) uv_directory_watcher_buffer_size;
+    else
+      *value = (int) state->buffer_size;
+    return 0;
+  }
+
+  if ((unsigned int) *value > UV__FS_EVENT_MAX_BUFFER_SIZE)
+    return UV_EINVAL;
+
+  /* The entries are DWORD aligned. The new size is used from the next read
+   * on, the pending one keeps its buffer.
+   */
+  size = ((unsigned int) *value + 3) & ~3u;
+  if (size < uv_directory_watcher_buffer_size)
+    size = uv_directory_watcher_buffer_size;
+
+  state = uv__fs_event_state(handle);
+  if (state == NULL)
+    return UV_ENOMEM;
+
+  state->buffer_size = size;
+  *value = (int) size;
+  return 0;
+}
+
+
 static int file_info_cmp(WCHAR* str, WCHAR* file_name, size_t file_name_len) {
   size_t str_len;
 
@@ -426,6 +540,12 @@ static int file_info_cmp(WCHAR* str, WCHAR* file_name, size_t file_name_len) {
 void uv_process_fs_event_req(uv_loop_t* loop, uv_req_t* req,
     uv_fs_event_t* handle) {
   FILE_NOTIFY_INFORMATION* file_info;
+  uv__file_notify_extended_information_t* ext_info;
+  struct uv__fs_event_state* state;
+  WCHAR* name;
+  DWORD name_len;
+  DWORD action;
+  DWORD next;
   int err, sizew, size;
   char* filename = NULL;
   WCHAR* filenamew = NULL;
@@ -447,12 +567,27 @@ void uv_process_fs_event_req(uv_loop_t* loop, uv_req_t* req,
     return;
   }
 
+  state = handle->u.reserved[0];
   file_info = (FILE_NOTIFY_INFORMATION*)(handle->buffer + offset);
 
   if (REQ_SUCCESS(req)) {
     if (req->u.io.overlapped.InternalHigh > 0) {
       do {
+        /* Both kinds of entries start with NextEntryOffset. */
         file_info = (FILE_NOTIFY_INFORMATION*)((char*)file_info + offset);
+        if (state->extended_info) {
+          ext_info = (uv__file_notify_extended_information_t*) file_info;
+          next = ext_info->NextEntryOffset;
+          action = ext_info->Action;
+          name = ext_info->FileName;
+          name_len = ext_info->FileNameLength;
+          state->current_info = ext_info;
+        } else {
+          next = file_info->NextEntryOffset;
+          action = file_info->Action;
+          name = file_info->FileName;
+          name_len = file_info->FileNameLength;
+        }
         assert(!filename);
         assert(!filenamew);
         assert(!long_filenamew);
@@ -462,12 +597,8 @@ void uv_process_fs_event_req(uv_loop_t* loop, uv_req_t* req,
          * or if the filename filter matches.
          */
         if (handle->dirw ||
-            file_info_cmp(handle->filew,
-                          file_info->FileName,
-                          file_info->FileNameLength) == 0 ||
-            file_info_cmp(handle->short_filew,
-                          file_info->FileName,
-                          file_info->FileNameLength) == 0) {
+            file_info_cmp(handle->filew, name, name_len) == 0 ||
+            file_info_cmp(handle->short_filew, name, name_len) == 0) {
 
           if (handle->dirw) {
             /*
@@ -476,11 +607,11 @@ void uv_process_fs_event_req(uv_loop_t* loop, uv_req_t* req,
              * If this fails, we use the name given by ReadDirectoryChangesW.
              * This may be the long form or the 8.3 short name in some cases.
              */
-            if (file_info->Action != FILE_ACTION_REMOVED &&
-              file_info->Action != FILE_ACTION_RENAMED_OLD_NAME) {
+            if (action != FILE_ACTION_REMOVED &&
+              action != FILE_ACTION_RENAMED_OLD_NAME) {
               /* Construct a full path to the file. */
               size = wcslen(handle->dirw) +
-                file_info->FileNameLength / sizeof(WCHAR) + 2;
+                name_len / sizeof(WCHAR) + 2;
 
               filenamew = (WCHAR*)uv__malloc(size * sizeof(WCHAR));
               if (!filenamew) {
@@ -488,8 +619,8 @@ void uv_process_fs_event_req(uv_loop_t* loop, uv_req_t* req,
               }
 
               _snwprintf(filenamew, size, L"%s\\%.*s", handle->dirw,
-                file_info->FileNameLength / (DWORD)sizeof(WCHAR),
-                file_info->FileName);
+                name_len / (DWORD)sizeof(WCHAR),
+                name);
 
               filenamew[size - 1] = L'\0';
 
@@ -523,8 +654,8 @@ void uv_process_fs_event_req(uv_loop_t* loop, uv_req_t* req,
                 sizew = -1;
               } else {
                 /* We couldn't get the long filename, use the one reported. */
-                filenamew = file_info->FileName;
-                sizew = file_info->FileNameLength / sizeof(WCHAR);
+                filenamew = name;
+                sizew = name_len / sizeof(WCHAR);
               }
             } else {
               /*
@@ -532,8 +663,8 @@ void uv_process_fs_event_req(uv_loop_t* loop, uv_req_t* req,
                * We therefore use the name given by ReadDirectoryChangesW.
                * This may be the long form or the 8.3 short name in some cases.
                */
-              filenamew = file_info->FileName;
-              sizew = file_info->FileNameLength / sizeof(WCHAR);
+              filenamew = name;
+              sizew = name_len / sizeof(WCHAR);
             }
           } else {
             /* We already have the long name of the file, so just use it. */
@@ -544,7 +675,7 @@ void uv_process_fs_event_req(uv_loop_t* loop, uv_req_t* req,
           /* Convert the filename to utf8. */
           uv__convert_utf16_to_utf8(filenamew, sizew, &filename);
 
-          switch (file_info->Action) {
+          switch (action) {
             case FILE_ACTION_ADDED:
             case FILE_ACTION_REMOVED:
             case FILE_ACTION_RENAMED_OLD_NAME:
@@ -564,7 +695,8 @@ void uv_process_fs_event_req(uv_loop_t* loop, uv_req_t* req,
           filenamew = NULL;
         }
 
-        offset = file_info->NextEntryOffset;
+        state->current_info = NULL;
+        offset = next;
       } while (offset && !(handle->flags & UV_HANDLE_CLOSING));
     } else {
       handle->cb(handle, NULL, UV_CHANGE, 0);
@@ -603,6 +735,7 @@ void uv_fs_event_endgame(uv_loop_t* loop, uv_fs_event_t* handle) {
       handle->buffer = NULL;
     }
 
+    uv__fs_event_state_free(handle);
     uv__handle_close(handle);
   }
 }
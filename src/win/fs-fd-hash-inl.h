@@ -48,6 +48,7 @@ struct uv__fd_info_s {
   HANDLE mapping;
   LARGE_INTEGER size;
   LARGE_INTEGER current_pos;
+  HANDLE iocp;  /* UV_FS_O_OVERLAPPED: the loop's completion port, or NULL. */
 };
 
 struct uv__fd_hash_entry_s {
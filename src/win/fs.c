@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_FS
+
 #include <assert.h>
 #include <stdlib.h>
 #include <direct.h>
@@ -54,11 +56,12 @@
   do {                                                                        \
     if (cb != NULL) {                                                         \
       uv__req_register(loop, req);                                            \
-      uv__work_submit(loop,                                                   \
-                      &req->work_req,                                         \
-                      UV__WORK_FAST_IO,                                       \
-                      uv__fs_work,                                            \
-                      uv__fs_done);                                           \
+      uv__work_submit_priority(loop,                                          \
+                               &req->work_req,                                \
+                               UV__WORK_FAST_IO,                              \
+                               uv__fs_work_priority(req->fs_type),            \
+                               uv__fs_work,                                   \
+                               uv__fs_done);                                  \
       return 0;                                                               \
     } else {                                                                  \
       uv__fs_work(&req->work_req);                                            \
@@ -451,6 +454,11 @@ void fs__open(uv_fs_t* req) {
   int flags = req->fs.info.file_flags;
   struct uv__fd_info_s fd_info;
 
+  /* Overlapped I/O goes around the file position that the mapping
+   * emulation relies on. */
+  if ((flags & UV_FS_O_FILEMAP) && (flags & UV_FS_O_OVERLAPPED))
+    goto einval;
+
   /* Adjust flags to be compatible with the memory file mapping. Save the
    * original flags to emulate the correct behavior. */
   if (flags & UV_FS_O_FILEMAP) {
@@ -606,6 +614,10 @@ void fs__open(uv_fs_t* req) {
     goto einval;
   }
 
+  if (flags & UV_FS_O_OVERLAPPED) {
+    attributes |= FILE_FLAG_OVERLAPPED;
+  }
+
   /* Setting this flag makes it possible to open a directory. */
   attributes |= FILE_FLAG_BACKUP_SEMANTICS;
 
@@ -645,6 +657,24 @@ void fs__open(uv_fs_t* req) {
     return;
   }
 
+  if (flags & UV_FS_O_OVERLAPPED) {
+    /* Reads and writes with a callback on this loop complete on its port.
+     * Without a loop the file only does the waiting kind. */
+    memset(&fd_info, 0, sizeof(fd_info));
+    fd_info.flags = UV_FS_O_OVERLAPPED;
+    fd_info.mapping = INVALID_HANDLE_VALUE;
+    if (req->loop != NULL) {
+      if (CreateIoCompletionPort(file, req->loop->iocp, (ULONG_PTR) file, 0) ==
+          NULL) {
+        SET_REQ_WIN32_ERROR(req, GetLastError());
+        _close(fd);
+        return;
+      }
+      fd_info.iocp = req->loop->iocp;
+    }
+    uv__fd_hash_add(fd, &fd_info);
+  }
+
   if (flags & UV_FS_O_FILEMAP) {
     FILE_STANDARD_INFO file_info;
     if (!GetFileInformationByHandleEx(file,
@@ -843,6 +873,82 @@ void fs__read_filemap(uv_fs_t* req, struct uv__fd_info_s* fd_info) {
   return;
 }
 
+/* Reads or writes a UV_FS_O_OVERLAPPED file and waits for the result. The
+ * low bit of hEvent keeps the completion off the loop's completion port.
+ * Overlapped files have no file position, a write at offset -1 appends. */
+static void fs__rw_wait(uv_fs_t* req, HANDLE handle, int write) {
+  OVERLAPPED overlapped;
+  LARGE_INTEGER offset_;
+  HANDLE event;
+  DWORD incremental_bytes;
+  DWORD bytes;
+  DWORD error;
+  unsigned int index;
+  uv_buf_t* buf;
+  BOOL result;
+
+  if (req->fs.info.offset == -1 && !write) {
+    SET_REQ_UV_ERROR(req, UV_EINVAL, ERROR_INVALID_PARAMETER);
+    return;
+  }
+
+  event = CreateEvent(NULL, TRUE, FALSE, NULL);
+  if (event == NULL) {
+    SET_REQ_WIN32_ERROR(req, GetLastError());
+    return;
+  }
+
+  bytes = 0;
+  error = ERROR_SUCCESS;
+  for (index = 0; index < req->fs.info.nbufs; index++) {
+    buf = &req->fs.info.bufs[index];
+
+    memset(&overlapped, 0, sizeof overlapped);
+    if (req->fs.info.offset == -1) {
+      overlapped.Offset = 0xFFFFFFFF;
+      overlapped.OffsetHigh = 0xFFFFFFFF;
+    } else {
+      offset_.QuadPart = req->fs.info.offset + bytes;
+      overlapped.Offset = offset_.LowPart;
+      overlapped.OffsetHigh = offset_.HighPart;
+    }
+    overlapped.hEvent = (HANDLE) ((ULONG_PTR) event | 1);
+
+    if (write)
+      result = WriteFile(handle, buf->base, buf->len, NULL, &overlapped);
+    else
+      result = ReadFile(handle, buf->base, buf->len, NULL, &overlapped);
+
+    if (result || GetLastError() == ERROR_IO_PENDING)
+      result = GetOverlappedResult(handle,
+                                   &overlapped,
+                                   &incremental_bytes,
+                                   TRUE);
+
+    if (!result) {
+      error = GetLastError();
+      break;
+    }
+
+    bytes += incremental_bytes;
+    if (incremental_bytes < buf->len)
+      break;
+  }
+
+  CloseHandle(event);
+
+  if (error == ERROR_SUCCESS || bytes > 0 ||
+      (!write && error == ERROR_HANDLE_EOF)) {
+    SET_REQ_RESULT(req, bytes);
+  } else {
+    if (error == ERROR_ACCESS_DENIED) {
+      error = ERROR_INVALID_FLAGS;
+    }
+    SET_REQ_WIN32_ERROR(req, error);
+  }
+}
+
+
 void fs__read(uv_fs_t* req) {
   int fd = req->file.fd;
   int64_t offset = req->fs.info.offset;
@@ -856,11 +962,11 @@ void fs__read(uv_fs_t* req) {
   LARGE_INTEGER original_position;
   LARGE_INTEGER zero_offset;
   int restore_position;
-  struct uv__fd_info_s fd_info;
+  struct uv__fd_info_s fd_info = { 0 };
 
   VERIFY_FD(fd, req);
 
-  if (uv__fd_hash_get(fd, &fd_info)) {
+  if (uv__fd_hash_get(fd, &fd_info) && (fd_info.flags & UV_FS_O_FILEMAP)) {
     fs__read_filemap(req, &fd_info);
     return;
   }
@@ -874,6 +980,11 @@ void fs__read(uv_fs_t* req) {
     return;
   }
 
+  if (fd_info.flags & UV_FS_O_OVERLAPPED) {
+    fs__rw_wait(req, handle, 0);
+    return;
+  }
+
   if (offset != -1) {
     memset(&overlapped, 0, sizeof overlapped);
     overlapped_ptr = &overlapped;
@@ -1075,7 +1186,10 @@ void fs__write(uv_fs_t* req) {
   }
 
   if (uv__fd_hash_get(fd, &fd_info)) {
-    fs__write_filemap(req, handle, &fd_info);
+    if (fd_info.flags & UV_FS_O_OVERLAPPED)
+      fs__rw_wait(req, handle, 1);
+    else
+      fs__write_filemap(req, handle, &fd_info);
     return;
   }
 
@@ -1235,6 +1349,58 @@ void fs__mkdir(uv_fs_t* req) {
   }
 }
 
+void fs__mkdir_p(uv_fs_t* req) {
+  WCHAR* pathw;
+  WCHAR* p;
+  WCHAR c;
+  DWORD attr;
+  DWORD error;
+
+  pathw = req->file.pathw;
+  if (CreateDirectoryW(pathw, NULL)) {
+    SET_REQ_RESULT(req, 0);
+    return;
+  }
+
+  error = GetLastError();
+  if (error == ERROR_PATH_NOT_FOUND) {
+    /* Create the parents, the errors for the ones that can't be created,
+     * drive letters and shares, don't matter, the last one tells.
+     */
+    for (p = pathw; *p != L'\0'; p++) {
+      if (p == pathw || (*p != L'\\' && *p != L'/') ||
+          p[-1] == L'\\' || p[-1] == L'/' || p[-1] == L':')
+        continue;
+
+      c = *p;
+      *p = L'\0';
+      CreateDirectoryW(pathw, NULL);
+      *p = c;
+    }
+
+    if (CreateDirectoryW(pathw, NULL)) {
+      SET_REQ_RESULT(req, 0);
+      return;
+    }
+
+    error = GetLastError();
+  }
+
+  if (error == ERROR_ALREADY_EXISTS) {
+    attr = GetFileAttributesW(pathw);
+    if (attr != INVALID_FILE_ATTRIBUTES &&
+        (attr & FILE_ATTRIBUTE_DIRECTORY)) {
+      SET_REQ_RESULT(req, 0);
+      return;
+    }
+  }
+
+  SET_REQ_WIN32_ERROR(req, error);
+  if (req->sys_errno_ == ERROR_INVALID_NAME ||
+      req->sys_errno_ == ERROR_DIRECTORY)
+    req->result = UV_EINVAL;
+}
+
 typedef int (*uv__fs_mktemp_func)(uv_fs_t* req);
 
 /* OpenBSD original: lib/libc/stdio/mktemp.c */
@@ -1360,33 +1526,48 @@ void fs__mkstemp(uv_fs_t* req) {
 }
 
 
-void fs__scandir(uv_fs_t* req) {
-  static const size_t dirents_initial_size = 32;
+/* Size of the buffer that fs__scandir() hands to NtQueryDirectoryFile. It's
+ * large so that big directories take few system calls, each one returns as
+ * many entries as fit. It must hold at least one entry, regardless of the
+ * length of the file names in the directory. A file name is at most 256
+ * WCHARs long.
+ */
+#define UV__SCANDIR_BUFFER_SIZE (64 * 1024)
 
+void fs__scandir(uv_fs_t* req) {
   HANDLE dir_handle = INVALID_HANDLE_VALUE;
 
   uv__dirent_t** dirents = NULL;
-  size_t dirents_size = 0;
+  uv__dirent_t* dirent;
   size_t dirents_used = 0;
+  size_t offset;
+  size_t i;
+
+  /* The entries are collected in `recs` and packed into a single block
+   * together with the pointer table at the end, instead of allocating every
+   * entry on its own.
+   */
+  char* recs = NULL;
+  size_t recs_size = 0;
+  size_t recs_used = 0;
+  size_t reclen;
 
   IO_STATUS_BLOCK iosb;
   NTSTATUS status;
 
   /* Buffer to hold directory entries returned by NtQueryDirectoryFile.
-   * It's important that this buffer can hold at least one entry, regardless
-   * of the length of the file names present in the enumerated directory.
-   * A file name is at most 256 WCHARs long.
-   * According to MSDN, the buffer must be aligned at an 8-byte boundary.
+   * According to MSDN, the buffer must be aligned at an 8-byte boundary,
+   * which uv__malloc() guarantees.
    */
-#if _MSC_VER
-  __declspec(align(8)) char buffer[8192];
-#else
-  __attribute__ ((aligned (8))) char buffer[8192];
-#endif
+  char* buffer = NULL;
 
-  STATIC_ASSERT(sizeof buffer >=
+  STATIC_ASSERT(UV__SCANDIR_BUFFER_SIZE >=
                 sizeof(FILE_DIRECTORY_INFORMATION) + 256 * sizeof(WCHAR));
 
+  buffer = uv__malloc(UV__SCANDIR_BUFFER_SIZE);
+  if (buffer == NULL)
+    goto out_of_memory_error;
+
   /* Open the directory. */
   dir_handle =
       CreateFileW(req->file.pathw,
@@ -1405,8 +1586,8 @@ void fs__scandir(uv_fs_t* req) {
                                  NULL,
                                  NULL,
                                  &iosb,
-                                 &buffer,
-                                 sizeof buffer,
+                                 buffer,
+                                 UV__SCANDIR_BUFFER_SIZE,
                                  FileDirectoryInformation,
                                  FALSE,
                                  NULL,
@@ -1424,7 +1605,6 @@ void fs__scandir(uv_fs_t* req) {
 
     do {
       FILE_DIRECTORY_INFORMATION* info;
-      uv__dirent_t* dirent;
 
       size_t wchar_len;
       size_t utf8_len;
@@ -1460,29 +1640,25 @@ void fs__scandir(uv_fs_t* req) {
       if (utf8_len == 0)
         goto win32_error;
 
-      /* Resize the dirent array if needed. */
-      if (dirents_used >= dirents_size) {
-        size_t new_dirents_size =
-            dirents_size == 0 ? dirents_initial_size : dirents_size << 1;
-        uv__dirent_t** new_dirents =
-            uv__realloc(dirents, new_dirents_size * sizeof *dirents);
+      /* Make room for the entry. Records are padded so that the next one
+       * is pointer aligned. `utf8_len` doesn't count the NULL terminator.
+       */
+      reclen = offsetof(uv__dirent_t, d_name) + utf8_len + 1;
+      reclen = (reclen + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+
+      if (recs_used + reclen > recs_size) {
+        size_t new_recs_size =
+            recs_size == 0 ? UV__SCANDIR_BUFFER_SIZE : recs_size << 1;
+        char* new_recs = uv__realloc(recs, new_recs_size);
 
-        if (new_dirents == NULL)
+        if (new_recs == NULL)
           goto out_of_memory_error;
 
-        dirents_size = new_dirents_size;
-        dirents = new_dirents;
+        recs_size = new_recs_size;
+        recs = new_recs;
       }
 
-      /* Allocate space for the uv dirent structure. The dirent structure
-       * includes room for the first character of the filename, but `utf8_len`
-       * doesn't count the NULL terminator at this point.
-       */
-      dirent = uv__malloc(sizeof *dirent + utf8_len);
-      if (dirent == NULL)
-        goto out_of_memory_error;
-
-      dirents[dirents_used++] = dirent;
+      dirent = (uv__dirent_t*) (recs + recs_used);
 
       /* Convert file name to UTF-8. */
       if (WideCharToMultiByte(CP_UTF8,
@@ -1507,6 +1683,9 @@ void fs__scandir(uv_fs_t* req) {
         dirent->d_type = UV__DT_DIR;
       else
         dirent->d_type = UV__DT_FILE;
+
+      recs_used += reclen;
+      dirents_used++;
     } while (next_entry_offset != 0);
 
     /* Read the next chunk. */
@@ -1515,8 +1694,8 @@ void fs__scandir(uv_fs_t* req) {
                                    NULL,
                                    NULL,
                                    &iosb,
-                                   &buffer,
-                                   sizeof buffer,
+                                   buffer,
+                                   UV__SCANDIR_BUFFER_SIZE,
                                    FileDirectoryInformation,
                                    FALSE,
                                    NULL,
@@ -1534,6 +1713,29 @@ void fs__scandir(uv_fs_t* req) {
     goto nt_error;
 
   CloseHandle(dir_handle);
+  dir_handle = INVALID_HANDLE_VALUE;
+  uv__free(buffer);
+  buffer = NULL;
+
+  if (dirents_used > 0) {
+    offset = dirents_used * sizeof(*dirents);
+    dirents = uv__malloc(offset + recs_used);
+    if (dirents == NULL)
+      goto out_of_memory_error;
+
+    memcpy((char*) dirents + offset, recs, recs_used);
+
+    for (i = 0; i < dirents_used; i++) {
+      dirent = (uv__dirent_t*) ((char*) dirents + offset);
+      dirents[i] = dirent;
+      reclen = offsetof(uv__dirent_t, d_name) + strlen(dirent->d_name) + 1;
+      offset += (reclen + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+    }
+
+    req->flags |= UV__FS_SCANDIR_PACKED;
+  }
+
+  uv__free(recs);
 
   /* Store the result in the request object. */
   req->ptr = dirents;
@@ -1566,10 +1768,8 @@ out_of_memory_error:
 cleanup:
   if (dir_handle != INVALID_HANDLE_VALUE)
     CloseHandle(dir_handle);
-  while (dirents_used > 0)
-    uv__free(dirents[--dirents_used]);
-  if (dirents != NULL)
-    uv__free(dirents);
+  uv__free(buffer);
+  uv__free(recs);
 }
 
 void fs__opendir(uv_fs_t* req) {
@@ -1695,6 +1895,96 @@ error:
   }
 }
 
+/* Like fs__readdir(), the entry that doesn't fit stays in find_data. */
+void fs__readdir_packed(uv_fs_t* req) {
+  uv_dirent_packed_t* ent;
+  PWIN32_FIND_DATAW find_data;
+  uv__dirent_t dent;
+  uv_dir_t* dir;
+  size_t reclen;
+  size_t used;
+  size_t len;
+  char* buf;
+  int namelen;
+  int n;
+
+  dir = req->ptr;
+  find_data = &dir->find_data;
+  buf = req->fs.info.bufsml[0].base;
+  len = (size_t) req->fs.info.offset;
+  used = 0;
+  n = 0;
+
+  for (;;) {
+    if (dir->need_find_call && FindNextFileW(dir->dir_handle, find_data) == 0) {
+      if (GetLastError() == ERROR_NO_MORE_FILES)
+        break;
+      goto error;
+    }
+
+    if (find_data->cFileName[0] == L'.' &&
+        (find_data->cFileName[1] == L'\0' ||
+        (find_data->cFileName[1] == L'.' &&
+        find_data->cFileName[2] == L'\0'))) {
+      dir->need_find_call = TRUE;
+      continue;
+    }
+
+    /* Includes the nul byte. */
+    namelen = WideCharToMultiByte(CP_UTF8,
+                                  0,
+                                  find_data->cFileName,
+                                  -1,
+                                  NULL,
+                                  0,
+                                  NULL,
+                                  NULL);
+    if (namelen == 0)
+      goto error;
+
+    reclen = uv__dirent_packed_size(namelen - 1);
+    if (reclen > len - used) {
+      if (n > 0)
+        break;
+      SET_REQ_UV_ERROR(req, UV_ENOBUFS, ERROR_INSUFFICIENT_BUFFER);
+      return;
+    }
+
+    ent = (uv_dirent_packed_t*) (buf + used);
+    if (WideCharToMultiByte(CP_UTF8,
+                            0,
+                            find_data->cFileName,
+                            -1,
+                            ent->name,
+                            namelen,
+                            NULL,
+                            NULL) == 0)
+      goto error;
+
+    if ((find_data->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+      dent.d_type = UV__DT_DIR;
+    else if ((find_data->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0)
+      dent.d_type = UV__DT_LINK;
+    else if ((find_data->dwFileAttributes & FILE_ATTRIBUTE_DEVICE) != 0)
+      dent.d_type = UV__DT_CHAR;
+    else
+      dent.d_type = UV__DT_FILE;
+
+    ent->reclen = (unsigned int) reclen;
+    ent->namelen = namelen - 1;
+    ent->type = uv__fs_get_dirent_type(&dent);
+    dir->need_find_call = TRUE;
+    used += reclen;
+    n++;
+  }
+
+  SET_REQ_RESULT(req, n);
+  return;
+
+error:
+  SET_REQ_WIN32_ERROR(req, GetLastError());
+}
+
 void fs__closedir(uv_fs_t* req) {
   uv_dir_t* dir;
 
@@ -1704,8 +1994,87 @@ void fs__closedir(uv_fs_t* req) {
   SET_REQ_RESULT(req, 0);
 }
 
+/* Returned by fs__stat_by_name() when it can't stat the file without a
+ * handle.
+ */
+#define FS__STAT_BY_NAME_FALLBACK ((DWORD) -1)
+
+/* Fills in `statbuf` from `stat_info`. The file type and size are only set
+ * when the caller didn't already, for symlinks. Also used by fs-event.c.
+ */
+void uv__fs_stat_assign_statbuf(
+    uv_stat_t* statbuf,
+    const uv__file_stat_basic_information_t* stat_info) {
+  statbuf->st_dev = (uint64_t) stat_info->VolumeSerialNumber.QuadPart;
+
+  if (statbuf->st_mode == 0) {
+    if (stat_info->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+      statbuf->st_mode |= _S_IFDIR;
+      statbuf->st_size = 0;
+    } else {
+      statbuf->st_mode |= _S_IFREG;
+      statbuf->st_size = stat_info->EndOfFile.QuadPart;
+    }
+  }
+
+  if (stat_info->FileAttributes & FILE_ATTRIBUTE_READONLY)
+    statbuf->st_mode |= _S_IREAD | (_S_IREAD >> 3) | (_S_IREAD >> 6);
+  else
+    statbuf->st_mode |= (_S_IREAD | _S_IWRITE) | ((_S_IREAD | _S_IWRITE) >> 3) |
+                        ((_S_IREAD | _S_IWRITE) >> 6);
+
+  uv__filetime_to_timespec(&statbuf->st_atim,
+                           stat_info->LastAccessTime.QuadPart);
+  uv__filetime_to_timespec(&statbuf->st_ctim,
+                           stat_info->ChangeTime.QuadPart);
+  uv__filetime_to_timespec(&statbuf->st_mtim,
+                           stat_info->LastWriteTime.QuadPart);
+  uv__filetime_to_timespec(&statbuf->st_birthtim,
+                           stat_info->CreationTime.QuadPart);
+
+  statbuf->st_ino = stat_info->FileId.QuadPart;
+
+  /* st_blocks contains the on-disk allocation size in 512-byte units. */
+  statbuf->st_blocks = (uint64_t) stat_info->AllocationSize.QuadPart >> 9;
+
+  statbuf->st_nlink = stat_info->NumberOfLinks;
+
+  /* The st_blksize is supposed to be the 'optimal' number of bytes for reading
+   * and writing to the disk. That is, for any definition of 'optimal' - it's
+   * supposed to at least avoid read-update-write behavior when writing to the
+   * disk.
+   *
+   * However nobody knows this and even fewer people actually use this value,
+   * and in order to fill it out we'd have to make another syscall to query the
+   * volume for FILE_FS_SECTOR_SIZE_INFORMATION.
+   *
+   * Therefore we'll just report a sensible value that's quite commonly okay
+   * on modern hardware.
+   *
+   * 4096 is the minimum required to be compatible with newer Advanced Format
+   * drives (which have 4096 bytes per physical sector), and to be backwards
+   * compatible with older drives (which have 512 bytes per physical sector).
+   */
+  statbuf->st_blksize = 4096;
+
+  /* Todo: set st_flags to something meaningful. Also provide a wrapper for
+   * chattr(2).
+   */
+  statbuf->st_flags = 0;
+
+  /* Windows has nothing sensible to say about these values, so they'll just
+   * remain empty.
+   */
+  statbuf->st_gid = 0;
+  statbuf->st_uid = 0;
+  statbuf->st_rdev = 0;
+  statbuf->st_gen = 0;
+}
+
+
 INLINE static int fs__stat_handle(HANDLE handle, uv_stat_t* statbuf,
     int do_lstat) {
+  uv__file_stat_basic_information_t stat_info;
   FILE_ALL_INFORMATION file_info;
   FILE_FS_VOLUME_INFORMATION volume_info;
   NTSTATUS nt_status;
@@ -1731,14 +2100,24 @@ INLINE static int fs__stat_handle(HANDLE handle, uv_stat_t* statbuf,
 
   /* Buffer overflow (a warning status code) is expected here. */
   if (io_status.Status == STATUS_NOT_IMPLEMENTED) {
-    statbuf->st_dev = 0;
+    stat_info.VolumeSerialNumber.QuadPart = 0;
   } else if (NT_ERROR(nt_status)) {
     SetLastError(pRtlNtStatusToDosError(nt_status));
     return -1;
   } else {
-    statbuf->st_dev = volume_info.VolumeSerialNumber;
+    stat_info.VolumeSerialNumber.QuadPart = volume_info.VolumeSerialNumber;
   }
 
+  stat_info.FileId = file_info.InternalInformation.IndexNumber;
+  stat_info.CreationTime = file_info.BasicInformation.CreationTime;
+  stat_info.LastAccessTime = file_info.BasicInformation.LastAccessTime;
+  stat_info.LastWriteTime = file_info.BasicInformation.LastWriteTime;
+  stat_info.ChangeTime = file_info.BasicInformation.ChangeTime;
+  stat_info.AllocationSize = file_info.StandardInformation.AllocationSize;
+  stat_info.EndOfFile = file_info.StandardInformation.EndOfFile;
+  stat_info.FileAttributes = file_info.BasicInformation.FileAttributes;
+  stat_info.NumberOfLinks = file_info.StandardInformation.NumberOfLinks;
+
   /* Todo: st_mode should probably always be 0666 for everyone. We might also
    * want to report 0777 if the file is a .exe or a directory.
    *
@@ -1781,76 +2160,60 @@ INLINE static int fs__stat_handle(HANDLE handle, uv_stat_t* statbuf,
     statbuf->st_mode |= S_IFLNK;
   }
 
-  if (statbuf->st_mode == 0) {
-    if (file_info.BasicInformation.FileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
-      statbuf->st_mode |= _S_IFDIR;
-      statbuf->st_size = 0;
-    } else {
-      statbuf->st_mode |= _S_IFREG;
-      statbuf->st_size = file_info.StandardInformation.EndOfFile.QuadPart;
+  uv__fs_stat_assign_statbuf(statbuf, &stat_info);
+  return 0;
+}
+
+
+/* Stats `path` without opening a handle, with GetFileInformationByName().
+ * Windows has that since Windows 11 24H2. Opening and closing a handle
+ * takes more system calls, and every open goes through the filter drivers
+ * on the volume, like antivirus software. Returns FS__STAT_BY_NAME_FALLBACK
+ * when fs__stat_handle() has to do it.
+ */
+INLINE static DWORD fs__stat_by_name(WCHAR* path, uv_stat_t* statbuf) {
+  uv__file_stat_basic_information_t stat_info;
+  DWORD error;
+
+  if (pGetFileInformationByName == NULL)
+    return FS__STAT_BY_NAME_FALLBACK;
+
+  if (!pGetFileInformationByName(path,
+                                 UV__FILE_STAT_BASIC_BY_NAME_INFO,
+                                 &stat_info,
+                                 sizeof stat_info)) {
+    error = GetLastError();
+    switch (error) {
+      case ERROR_FILE_NOT_FOUND:
+      case ERROR_PATH_NOT_FOUND:
+      case ERROR_NOT_READY:
+      case ERROR_BAD_NET_NAME:
+        /* Opening a handle wouldn't go any better. */
+        return error;
     }
+
+    return FS__STAT_BY_NAME_FALLBACK;
   }
 
-  if (file_info.BasicInformation.FileAttributes & FILE_ATTRIBUTE_READONLY)
-    statbuf->st_mode |= _S_IREAD | (_S_IREAD >> 3) | (_S_IREAD >> 6);
-  else
-    statbuf->st_mode |= (_S_IREAD | _S_IWRITE) | ((_S_IREAD | _S_IWRITE) >> 3) |
-                        ((_S_IREAD | _S_IWRITE) >> 6);
+  /* Reparse points need a handle, to read the link for lstat(), or to
+   * follow it for stat(). Devices and network shares are left to the
+   * handle based path too, it knows how to deal with them.
+   */
+  if (stat_info.FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+    return FS__STAT_BY_NAME_FALLBACK;
 
-  uv__filetime_to_timespec(&statbuf->st_atim,
-                           file_info.BasicInformation.LastAccessTime.QuadPart);
-  uv__filetime_to_timespec(&statbuf->st_ctim,
-                           file_info.BasicInformation.ChangeTime.QuadPart);
-  uv__filetime_to_timespec(&statbuf->st_mtim,
-                           file_info.BasicInformation.LastWriteTime.QuadPart);
-  uv__filetime_to_timespec(&statbuf->st_birthtim,
-                           file_info.BasicInformation.CreationTime.QuadPart);
+  if (stat_info.DeviceType != FILE_DEVICE_DISK &&
+      stat_info.DeviceType != FILE_DEVICE_DISK_FILE_SYSTEM)
+    return FS__STAT_BY_NAME_FALLBACK;
 
-  statbuf->st_ino = file_info.InternalInformation.IndexNumber.QuadPart;
+  statbuf->st_mode = 0;
+  uv__fs_stat_assign_statbuf(statbuf, &stat_info);
+  return 0;
+}
 
-  /* st_blocks contains the on-disk allocation size in 512-byte units. */
-  statbuf->st_blocks =
-      (uint64_t) file_info.StandardInformation.AllocationSize.QuadPart >> 9;
 
-  statbuf->st_nlink = file_info.StandardInformation.NumberOfLinks;
-
-  /* The st_blksize is supposed to be the 'optimal' number of bytes for reading
-   * and writing to the disk. That is, for any definition of 'optimal' - it's
-   * supposed to at least avoid read-update-write behavior when writing to the
-   * disk.
-   *
-   * However nobody knows this and even fewer people actually use this value,
-   * and in order to fill it out we'd have to make another syscall to query the
-   * volume for FILE_FS_SECTOR_SIZE_INFORMATION.
-   *
-   * Therefore we'll just report a sensible value that's quite commonly okay
-   * on modern hardware.
-   *
-   * 4096 is the minimum required to be compatible with newer Advanced Format
-   * drives (which have 4096 bytes per physical sector), and to be backwards
-   * compatible with older drives (which have 512 bytes per physical sector).
-   */
-  statbuf->st_blksize = 4096;
-
-  /* Todo: set st_flags to something meaningful. Also provide a wrapper for
-   * chattr(2).
-   */
-  statbuf->st_flags = 0;
-
-  /* Windows has nothing sensible to say about these values, so they'll just
-   * remain empty.
-   */
-  statbuf->st_gid = 0;
-  statbuf->st_uid = 0;
-  statbuf->st_rdev = 0;
-  statbuf->st_gen = 0;
-
-  return 0;
-}
-
-
-INLINE static void fs__stat_prepare_path(WCHAR* pathw) {
-  size_t len = wcslen(pathw);
+INLINE static void fs__stat_prepare_path(WCHAR* pathw) {
+  size_t len = wcslen(pathw);
 
   /* TODO: ignore namespaced paths. */
   if (len > 1 && pathw[len - 2] != L':' &&
@@ -1867,6 +2230,10 @@ INLINE static DWORD fs__stat_impl_from_path(WCHAR* path,
   DWORD flags;
   DWORD ret;
 
+  ret = fs__stat_by_name(path, statbuf);
+  if (ret != FS__STAT_BY_NAME_FALLBACK)
+    return ret;
+
   flags = FILE_FLAG_BACKUP_SEMANTICS;
   if (do_lstat)
     flags |= FILE_FLAG_OPEN_REPARSE_POINT;
@@ -1920,12 +2287,417 @@ static void fs__stat(uv_fs_t* req) {
 }
 
 
+static void fs__mmap_prefetch(void* addr, size_t length) {
+  uv__win32_memory_range_entry_t range;
+
+  if (pPrefetchVirtualMemory == NULL)
+    return;
+
+  range.VirtualAddress = addr;
+  range.NumberOfBytes = length;
+  pPrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+
+static void fs__mmap(uv_fs_t* req) {
+  int fd = req->file.fd;
+  LARGE_INTEGER view_base;
+  LARGE_INTEGER size;
+  HANDLE mapping;
+  HANDLE handle;
+  size_t length;
+  size_t delta;
+  char* view;
+  int write;
+
+  length = (size_t) (uintptr_t) req->ptr;
+  req->ptr = NULL;
+
+  VERIFY_FD(fd, req);
+
+  if (req->fs.info.offset < 0) {
+    SET_REQ_UV_ERROR(req, UV_EINVAL, ERROR_INVALID_PARAMETER);
+    return;
+  }
+
+  handle = uv__get_osfhandle(fd);
+  write = req->fs.info.file_flags & UV_FS_MMAP_WRITE;
+
+  if (length == 0) {
+    if (!GetFileSizeEx(handle, &size)) {
+      SET_REQ_WIN32_ERROR(req, GetLastError());
+      return;
+    }
+
+    if (req->fs.info.offset >= size.QuadPart) {
+      SET_REQ_UV_ERROR(req, UV_EINVAL, ERROR_INVALID_PARAMETER);
+      return;
+    }
+
+    length = (size_t) (size.QuadPart - req->fs.info.offset);
+  }
+
+  mapping = CreateFileMappingW(handle,
+                               NULL,
+                               write ? PAGE_READWRITE : PAGE_READONLY,
+                               0,
+                               0,
+                               NULL);
+  if (mapping == NULL) {
+    SET_REQ_WIN32_ERROR(req, GetLastError());
+    return;
+  }
+
+  /* Views must start at a multiple of the allocation granularity. */
+  delta = (size_t) (req->fs.info.offset % uv__allocation_granularity);
+  view_base.QuadPart = req->fs.info.offset - delta;
+  view = MapViewOfFile(mapping,
+                       write ? FILE_MAP_WRITE : FILE_MAP_READ,
+                       view_base.HighPart,
+                       view_base.LowPart,
+                       length + delta);
+
+  /* The view keeps the mapping object alive. */
+  CloseHandle(mapping);
+
+  if (view == NULL) {
+    SET_REQ_WIN32_ERROR(req, GetLastError());
+    return;
+  }
+
+  if (req->fs.info.file_flags & UV_FS_MMAP_POPULATE)
+    fs__mmap_prefetch(view, length + delta);
+
+  req->ptr = view + delta;
+  SET_REQ_RESULT(req, length);
+}
+
+
+static void fs__munmap(uv_fs_t* req) {
+  char* addr;
+
+  addr = req->fs.info.bufsml[0].base;
+  addr -= (uintptr_t) addr % uv__allocation_granularity;
+
+  if (!UnmapViewOfFile(addr)) {
+    SET_REQ_WIN32_ERROR(req, GetLastError());
+    return;
+  }
+
+  SET_REQ_RESULT(req, 0);
+}
+
+
+int uv__fs_copy_range(uv_file in, uv_file out, int64_t off, uint64_t len) {
+  OVERLAPPED overlapped;
+  HANDLE in_handle;
+  HANDLE out_handle;
+  DWORD nread;
+  DWORD nwritten;
+  DWORD chunk;
+  DWORD done;
+  char* buf;
+  int err;
+
+  in_handle = uv__get_osfhandle(in);
+  out_handle = uv__get_osfhandle(out);
+  if (in_handle == INVALID_HANDLE_VALUE || out_handle == INVALID_HANDLE_VALUE)
+    return UV_EBADF;
+
+  chunk = 1024 * 1024;
+  if (chunk > len)
+    chunk = (DWORD) len;
+
+  buf = uv__malloc(chunk);
+  if (buf == NULL)
+    return UV_ENOMEM;
+
+  err = 0;
+  while (len > 0) {
+    memset(&overlapped, 0, sizeof(overlapped));
+    overlapped.Offset = (DWORD) off;
+    overlapped.OffsetHigh = (DWORD) (off >> 32);
+
+    if (!ReadFile(in_handle,
+                  buf,
+                  len < chunk ? (DWORD) len : chunk,
+                  &nread,
+                  &overlapped)) {
+      if (GetLastError() != ERROR_HANDLE_EOF)
+        err = uv_translate_sys_error(GetLastError());
+      break;
+    }
+
+    if (nread == 0)
+      break;
+
+    for (done = 0; done < nread; done += nwritten) {
+      memset(&overlapped, 0, sizeof(overlapped));
+      overlapped.Offset = (DWORD) (off + done);
+      overlapped.OffsetHigh = (DWORD) ((off + done) >> 32);
+
+      if (!WriteFile(out_handle,
+                     buf + done,
+                     nread - done,
+                     &nwritten,
+                     &overlapped)) {
+        err = uv_translate_sys_error(GetLastError());
+        goto out;
+      }
+    }
+
+    off += nread;
+    len -= nread;
+  }
+
+out:
+  uv__free(buf);
+  return err;
+}
+
+
+int uv__fs_clone(uv_file in, uv_file out) {
+  return UV_ENOTSUP;
+}
+
+
+static void fs__readahead(uv_fs_t* req) {
+  int fd = req->file.fd;
+  LARGE_INTEGER view_base;
+  LARGE_INTEGER size;
+  HANDLE mapping;
+  HANDLE handle;
+  uint64_t length;
+  size_t delta;
+  char* view;
+
+  length = (uint64_t) (uintptr_t) req->ptr;
+  req->ptr = NULL;
+
+  VERIFY_FD(fd, req);
+
+  /* Without PrefetchVirtualMemory() there is no way to start the I/O
+   * without waiting for it, readahead is only a hint so do nothing.
+   */
+  if (pPrefetchVirtualMemory == NULL) {
+    SET_REQ_RESULT(req, 0);
+    return;
+  }
+
+  handle = uv__get_osfhandle(fd);
+  if (!GetFileSizeEx(handle, &size)) {
+    SET_REQ_WIN32_ERROR(req, GetLastError());
+    return;
+  }
+
+  if (req->fs.info.offset >= size.QuadPart) {
+    SET_REQ_RESULT(req, 0);
+    return;
+  }
+
+  if (length == 0 ||
+      length > (uint64_t) (size.QuadPart - req->fs.info.offset)) {
+    length = size.QuadPart - req->fs.info.offset;
+  }
+
+  mapping = CreateFileMappingW(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (mapping == NULL) {
+    SET_REQ_WIN32_ERROR(req, GetLastError());
+    return;
+  }
+
+  delta = (size_t) (req->fs.info.offset % uv__allocation_granularity);
+  view_base.QuadPart = req->fs.info.offset - delta;
+  view = MapViewOfFile(mapping,
+                       FILE_MAP_READ,
+                       view_base.HighPart,
+                       view_base.LowPart,
+                       (SIZE_T) (length + delta));
+  CloseHandle(mapping);
+
+  if (view == NULL) {
+    SET_REQ_WIN32_ERROR(req, GetLastError());
+    return;
+  }
+
+  /* The pages land in the file cache, unmapping the view doesn't undo it. */
+  fs__mmap_prefetch(view, (size_t) (length + delta));
+  UnmapViewOfFile(view);
+
+  SET_REQ_RESULT(req, 0);
+}
+
+
+static void fs__fadvise(uv_fs_t* req) {
+  if (req->fs.info.file_flags == UV_FS_FADV_WILLNEED) {
+    fs__readahead(req);
+    return;
+  }
+
+  req->ptr = NULL;
+  VERIFY_FD(req->file.fd, req);
+  SET_REQ_RESULT(req, 0);
+}
+
+
+static void fs__fallocate(uv_fs_t* req) {
+  int fd = req->file.fd;
+  int flags = req->fs.info.file_flags;
+  HANDLE handle;
+  struct uv__fd_info_s fd_info = { 0 };
+  FILE_STANDARD_INFO std_info;
+  FILE_ALLOCATION_INFO alloc_info;
+  FILE_END_OF_FILE_INFO eof_info;
+  FILE_ZERO_DATA_INFORMATION zero_info;
+  DWORD bytes;
+  int64_t end;
+
+  VERIFY_FD(fd, req);
+
+  handle = uv__get_osfhandle(fd);
+
+  /* Resizing a file opened with UV_FS_O_FILEMAP would leave the mapping that
+   * backs its reads and writes behind.
+   */
+  if (uv__fd_hash_get(fd, &fd_info) && (fd_info.flags & UV_FS_O_FILEMAP)) {
+    SET_REQ_UV_ERROR(req, UV_ENOTSUP, ERROR_NOT_SUPPORTED);
+    return;
+  }
+
+  end = req->fs.info.offset +
+        (int64_t) (((uint64_t) req->fs.info.bufsml[1].len << 32) |
+                   req->fs.info.bufsml[0].len);
+
+  if (flags & (UV_FS_FALLOCATE_PUNCH_HOLE | UV_FS_FALLOCATE_ZERO_RANGE)) {
+    /* Zeroing only releases the clusters of a sparse file. */
+    if ((flags & UV_FS_FALLOCATE_PUNCH_HOLE) &&
+        !DeviceIoControl(handle, FSCTL_SET_SPARSE, NULL, 0, NULL, 0, &bytes,
+                         NULL)) {
+      SET_REQ_WIN32_ERROR(req, GetLastError());
+      return;
+    }
+
+    zero_info.FileOffset.QuadPart = req->fs.info.offset;
+    zero_info.BeyondFinalZero.QuadPart = end;
+    if (!DeviceIoControl(handle,
+                         FSCTL_SET_ZERO_DATA,
+                         &zero_info,
+                         sizeof zero_info,
+                         NULL,
+                         0,
+                         &bytes,
+                         NULL)) {
+      SET_REQ_WIN32_ERROR(req, GetLastError());
+      return;
+    }
+
+    if (flags & UV_FS_FALLOCATE_PUNCH_HOLE) {
+      SET_REQ_RESULT(req, 0);
+      return;
+    }
+  }
+
+  if (!GetFileInformationByHandleEx(handle,
+                                    FileStandardInfo,
+                                    &std_info,
+                                    sizeof std_info)) {
+    SET_REQ_WIN32_ERROR(req, GetLastError());
+    return;
+  }
+
+  /* A smaller allocation size would truncate the file. */
+  if (std_info.AllocationSize.QuadPart < end) {
+    alloc_info.AllocationSize.QuadPart = end;
+    if (!SetFileInformationByHandle(handle,
+                                    FileAllocationInfo,
+                                    &alloc_info,
+                                    sizeof alloc_info)) {
+      SET_REQ_WIN32_ERROR(req, GetLastError());
+      return;
+    }
+  }
+
+  if ((flags & UV_FS_FALLOCATE_KEEP_SIZE) == 0 &&
+      std_info.EndOfFile.QuadPart < end) {
+    eof_info.EndOfFile.QuadPart = end;
+    if (!SetFileInformationByHandle(handle,
+                                    FileEndOfFileInfo,
+                                    &eof_info,
+                                    sizeof eof_info)) {
+      SET_REQ_WIN32_ERROR(req, GetLastError());
+      return;
+    }
+  }
+
+  SET_REQ_RESULT(req, 0);
+}
+
+
+static void fs__stat_many(uv_fs_t* req) {
+  struct uv__fs_stat_many* sm;
+  unsigned int i;
+  WCHAR* pathw;
+  DWORD error;
+  int pathw_len;
+  int pathw_cap;
+  ssize_t n;
+
+  sm = req->ptr;
+  pathw = NULL;
+  pathw_cap = 0;
+  n = 0;
+
+  for (i = 0; i < sm->npaths; i++) {
+    pathw_len = MultiByteToWideChar(CP_UTF8, 0, sm->paths[i], -1, NULL, 0);
+    if (pathw_len == 0) {
+      sm->results[i] = uv_translate_sys_error(GetLastError());
+      continue;
+    }
+
+    if (pathw_len > pathw_cap) {
+      uv__free(pathw);
+      pathw = uv__malloc(pathw_len * sizeof(WCHAR));
+      if (pathw == NULL) {
+        pathw_cap = 0;
+        sm->results[i] = UV_ENOMEM;
+        continue;
+      }
+      pathw_cap = pathw_len;
+    }
+
+    MultiByteToWideChar(CP_UTF8, 0, sm->paths[i], -1, pathw, pathw_len);
+    fs__stat_prepare_path(pathw);
+
+    error = fs__stat_impl_from_path(pathw, 0, &sm->statbufs[i]);
+    if (error != 0) {
+      sm->results[i] = uv_translate_sys_error(error);
+    } else {
+      sm->results[i] = 0;
+      n++;
+    }
+  }
+
+  uv__free(pathw);
+  SET_REQ_RESULT(req, n);
+}
+
+
 static void fs__lstat(uv_fs_t* req) {
   fs__stat_prepare_path(req->file.pathw);
   fs__stat_impl(req, 1);
 }
 
 
+static void fs__statx(uv_fs_t* req) {
+  fs__stat_prepare_path(req->file.pathw);
+  fs__stat_impl(req, req->fs.info.file_flags & UV_FS_STATX_NOFOLLOW);
+
+  /* The mask and the sync mode don't change what is fetched here. */
+  if (req->result == 0)
+    SET_REQ_RESULT(req, UV_STATX_ALL);
+}
+
+
 static void fs__fstat(uv_fs_t* req) {
   int fd = req->file.fd;
   HANDLE handle;
@@ -1984,6 +2756,45 @@ static void fs__fdatasync(uv_fs_t* req) {
 }
 
 
+/* Applies the segments in order. Stops at the first error, earlier segments
+ * stay written.
+ */
+static void fs__write_batch(uv_fs_t* req) {
+  struct uv__fs_write_batch* wb;
+  ssize_t total;
+  unsigned int i;
+
+  wb = req->ptr;
+  total = 0;
+
+  for (i = 0; i < wb->nsegs; i++) {
+    if (wb->segs[i].nbufs == 0)
+      continue;
+
+    /* Cast away the const, the buffer descriptors are a private copy. */
+    req->fs.info.bufs = (uv_buf_t*) wb->segs[i].bufs;
+    req->fs.info.nbufs = wb->segs[i].nbufs;
+    req->fs.info.offset = wb->segs[i].offset;
+    fs__write(req);
+    req->fs.info.bufs = NULL;
+    req->fs.info.nbufs = 0;
+
+    if (req->result < 0)
+      return;
+
+    total += req->result;
+  }
+
+  if (req->fs.info.file_flags & UV_FS_WRITE_BATCH_DATASYNC) {
+    fs__sync_impl(req);
+    if (req->result < 0)
+      return;
+  }
+
+  SET_REQ_RESULT(req, total);
+}
+
+
 static void fs__ftruncate(uv_fs_t* req) {
   int fd = req->file.fd;
   HANDLE handle;
@@ -2020,7 +2831,7 @@ static void fs__ftruncate(uv_fs_t* req) {
   } else {
     SET_REQ_WIN32_ERROR(req, pRtlNtStatusToDosError(status));
 
-    if (fd_info.flags) {
+    if (fd_info.flags & UV_FS_O_FILEMAP) {
       CloseHandle(handle);
       fd_info.mapping = INVALID_HANDLE_VALUE;
       fd_info.size.QuadPart = 0;
@@ -2030,7 +2841,7 @@ static void fs__ftruncate(uv_fs_t* req) {
     }
   }
 
-  if (fd_info.flags) {
+  if (fd_info.flags & UV_FS_O_FILEMAP) {
     fd_info.size = eof_info.EndOfFile;
 
     if (fd_info.size.QuadPart == 0) {
@@ -2832,6 +3643,16 @@ static void uv__fs_work(struct uv__work* w) {
     XX(FCHOWN, fchown)
     XX(LCHOWN, lchown)
     XX(STATFS, statfs)
+    XX(STAT_MANY, stat_many)
+    XX(STATX, statx)
+    XX(MKDIR_P, mkdir_p)
+    XX(MMAP, mmap)
+    XX(MUNMAP, munmap)
+    XX(FADVISE, fadvise)
+    XX(READAHEAD, readahead)
+    XX(FALLOCATE, fallocate)
+    XX(WRITE_BATCH, write_batch)
+    XX(READDIR_PACKED, readdir_packed)
     default:
       assert(!"bad uv_fs_type");
   }
@@ -2844,11 +3665,15 @@ static void uv__fs_done(struct uv__work* w, int status) {
   req = container_of(w, uv_fs_t, work_req);
   uv__req_unregister(req->loop, req);
 
-  if (status == UV_ECANCELED) {
+  /* Cancelled or expired in the queue, it never ran. */
+  if (status == UV_ECANCELED || status == UV_ETIMEDOUT) {
     assert(req->result == 0);
-    SET_REQ_UV_ERROR(req, UV_ECANCELED, 0);
+    SET_REQ_UV_ERROR(req, status, 0);
   }
 
+  if (req->fs_type == UV_FS_REALPATH && req->result == 0)
+    uv__realpath_cache_store(req->loop, req->path, req->ptr);
+
   req->cb(req);
 }
 
@@ -2909,6 +3734,103 @@ int uv_fs_close(uv_loop_t* loop, uv_fs_t* req, uv_file fd, uv_fs_cb cb) {
 }
 
 
+/* Posts the read or write of the next buffer of a request on a
+ * UV_FS_O_OVERLAPPED file, fs.info.fd_out has its index. The completion comes
+ * through the loop's port even when the call succeeds right away. */
+static void fs__queue_overlapped(uv_loop_t* loop, uv_fs_t* req) {
+  OVERLAPPED* overlapped;
+  LARGE_INTEGER offset;
+  HANDLE handle;
+  uv_buf_t* buf;
+  BOOL result;
+
+  handle = uv__get_osfhandle(req->file.fd);
+  buf = &req->fs.info.bufs[req->fs.info.fd_out];
+  overlapped = &req->u.io.overlapped;
+
+  memset(overlapped, 0, sizeof(*overlapped));
+  if (req->fs.info.offset == -1) {
+    overlapped->Offset = 0xFFFFFFFF;
+    overlapped->OffsetHigh = 0xFFFFFFFF;
+  } else {
+    offset.QuadPart = req->fs.info.offset + req->result;
+    overlapped->Offset = offset.LowPart;
+    overlapped->OffsetHigh = offset.HighPart;
+  }
+
+  if (req->fs_type == UV_FS_WRITE)
+    result = WriteFile(handle, buf->base, buf->len, NULL, overlapped);
+  else
+    result = ReadFile(handle, buf->base, buf->len, NULL, overlapped);
+
+  if (result || GetLastError() == ERROR_IO_PENDING)
+    return;
+
+  SET_REQ_ERROR(req, GetLastError());
+  uv_insert_pending_req(loop, (uv_req_t*) req);
+}
+
+
+/* Starts a read or write without a thread pool thread when the file was
+ * opened with UV_FS_O_OVERLAPPED on this loop. Returns 0 if the request has
+ * to take the thread pool. */
+static int fs__post_overlapped(uv_loop_t* loop, uv_fs_t* req) {
+  struct uv__fd_info_s fd_info;
+
+  if (!uv__fd_hash_get(req->file.fd, &fd_info) ||
+      !(fd_info.flags & UV_FS_O_OVERLAPPED) ||
+      fd_info.iocp != loop->iocp) {
+    return 0;
+  }
+
+  /* Overlapped reads need an offset, fs__rw_wait() reports that. */
+  if (req->fs.info.offset == -1 && req->fs_type == UV_FS_READ)
+    return 0;
+
+  /* Not queued on the thread pool, uv_cancel() returns UV_EBUSY. */
+  req->work_req.loop = loop;
+  req->work_req.work = NULL;
+  QUEUE_INIT(&req->work_req.wq);
+
+  req->fs.info.fd_out = 0;
+  req->result = 0;
+  uv__req_register(loop, req);
+  fs__queue_overlapped(loop, req);
+  return 1;
+}
+
+
+void uv_process_fs_req(uv_loop_t* loop, uv_fs_t* req) {
+  uv_buf_t* buf;
+  DWORD error;
+  size_t bytes;
+
+  assert(req->fs_type == UV_FS_READ || req->fs_type == UV_FS_WRITE);
+  buf = &req->fs.info.bufs[req->fs.info.fd_out];
+
+  if (REQ_SUCCESS(req)) {
+    bytes = (size_t) req->u.io.overlapped.InternalHigh;
+    req->result += bytes;
+    if (bytes == buf->len &&
+        (unsigned int) ++req->fs.info.fd_out < req->fs.info.nbufs) {
+      fs__queue_overlapped(loop, req);
+      return;
+    }
+  } else if (req->result == 0) {
+    error = GET_REQ_ERROR(req);
+    if (error == ERROR_ACCESS_DENIED) {
+      error = ERROR_INVALID_FLAGS;
+    }
+    if (req->fs_type == UV_FS_WRITE || error != ERROR_HANDLE_EOF) {
+      SET_REQ_WIN32_ERROR(req, error);
+    }
+  }
+
+  uv__req_unregister(loop, req);
+  req->cb(req);
+}
+
+
 int uv_fs_read(uv_loop_t* loop,
                uv_fs_t* req,
                uv_file fd,
@@ -2938,6 +3860,8 @@ int uv_fs_read(uv_loop_t* loop,
   memcpy(req->fs.info.bufs, bufs, nbufs * sizeof(*bufs));
 
   req->fs.info.offset = offset;
+  if (cb != NULL && fs__post_overlapped(loop, req))
+    return 0;
   POST;
 }
 
@@ -2971,6 +3895,8 @@ int uv_fs_write(uv_loop_t* loop,
   memcpy(req->fs.info.bufs, bufs, nbufs * sizeof(*bufs));
 
   req->fs.info.offset = offset;
+  if (cb != NULL && fs__post_overlapped(loop, req))
+    return 0;
   POST;
 }
 
@@ -3006,6 +3932,25 @@ int uv_fs_mkdir(uv_loop_t* loop, uv_fs_t* req, const char* path, int mode,
 }
 
 
+int uv_fs_mkdir_p(uv_loop_t* loop,
+                  uv_fs_t* req,
+                  const char* path,
+                  int mode,
+                  uv_fs_cb cb) {
+  int err;
+
+  INIT(UV_FS_MKDIR_P);
+  err = fs__capture_path(req, path, NULL, cb != NULL);
+  if (err) {
+    SET_REQ_WIN32_ERROR(req, err);
+    return req->result;
+  }
+
+  req->fs.info.mode = mode;
+  POST;
+}
+
+
 int uv_fs_mkdtemp(uv_loop_t* loop,
                   uv_fs_t* req,
                   const char* tpl,
@@ -3040,6 +3985,13 @@ int uv_fs_mkstemp(uv_loop_t* loop,
 }
 
 
+int uv_fs_rm_rf(uv_loop_t* loop, uv_fs_t* req, const char* path, uv_fs_cb cb) {
+  INIT(UV_FS_RM_RF);
+  SET_REQ_UV_ERROR(req, UV_ENOSYS, ERROR_NOT_SUPPORTED);
+  return req->result;
+}
+
+
 int uv_fs_rmdir(uv_loop_t* loop, uv_fs_t* req, const char* path, uv_fs_cb cb) {
   int err;
 
@@ -3101,6 +4053,27 @@ int uv_fs_readdir(uv_loop_t* loop,
   POST;
 }
 
+int uv_fs_readdir_packed(uv_loop_t* loop,
+                         uv_fs_t* req,
+                         uv_dir_t* dir,
+                         void* buf,
+                         size_t len,
+                         uv_fs_cb cb) {
+  INIT(UV_FS_READDIR_PACKED);
+
+  if (dir == NULL ||
+      buf == NULL ||
+      dir->dir_handle == INVALID_HANDLE_VALUE) {
+    SET_REQ_UV_ERROR(req, UV_EINVAL, ERROR_INVALID_PARAMETER);
+    return UV_EINVAL;
+  }
+
+  req->ptr = dir;
+  req->fs.info.bufsml[0].base = buf;
+  req->fs.info.offset = (int64_t) len;
+  POST;
+}
+
 int uv_fs_closedir(uv_loop_t* loop,
                    uv_fs_t* req,
                    uv_dir_t* dir,
@@ -3177,6 +4150,28 @@ int uv_fs_realpath(uv_loop_t* loop, uv_fs_t* req, const char* path,
     return req->result;
   }
 
+  /* With UV_LOOP_REALPATH_CACHE, hits skip the threadpool and complete on
+   * the next loop iteration.
+   */
+  req->ptr = uv__realpath_cache_lookup(loop, path);
+  if (req->ptr != NULL) {
+    req->flags |= UV_FS_FREE_PTR;
+    SET_REQ_RESULT(req, 0);
+    if (cb == NULL)
+      return 0;
+
+    uv__req_register(loop, req);
+    uv__work_post(loop, &req->work_req, uv__fs_done);
+    return 0;
+  }
+
+  if (cb == NULL) {
+    uv__fs_work(&req->work_req);
+    if (req->result == 0)
+      uv__realpath_cache_store(loop, path, req->ptr);
+    return req->result;
+  }
+
   POST;
 }
 
@@ -3246,6 +4241,299 @@ int uv_fs_lstat(uv_loop_t* loop, uv_fs_t* req, const char* path, uv_fs_cb cb) {
 }
 
 
+int uv_fs_stat_many(uv_loop_t* loop,
+                    uv_fs_t* req,
+                    const char* const paths[],
+                    unsigned int npaths,
+                    uv_stat_t* statbufs,
+                    int* results,
+                    uv_fs_cb cb) {
+  int err;
+
+  INIT(UV_FS_STAT_MANY);
+  err = uv__fs_stat_many_init(req,
+                              paths,
+                              npaths,
+                              statbufs,
+                              results,
+                              cb != NULL);
+  if (err) {
+    SET_REQ_UV_ERROR(req, err, ERROR_INVALID_PARAMETER);
+    return req->result;
+  }
+
+  req->flags |= UV_FS_FREE_PTR;
+  POST;
+}
+
+
+int uv_fs_statx(uv_loop_t* loop,
+                uv_fs_t* req,
+                const char* path,
+                unsigned int mask,
+                int flags,
+                uv_fs_cb cb) {
+  int err;
+
+  INIT(UV_FS_STATX);
+
+  if ((flags & ~(UV_FS_STATX_NOFOLLOW |
+                 UV_FS_STATX_DONT_SYNC |
+                 UV_FS_STATX_FORCE_SYNC)) ||
+      ((flags & UV_FS_STATX_DONT_SYNC) && (flags & UV_FS_STATX_FORCE_SYNC)) ||
+      mask == 0 ||
+      (mask & ~UV_STATX_ALL)) {
+    SET_REQ_UV_ERROR(req, UV_EINVAL, ERROR_INVALID_PARAMETER);
+    return req->result;
+  }
+
+  err = fs__capture_path(req, path, NULL, cb != NULL);
+  if (err) {
+    SET_REQ_WIN32_ERROR(req, err);
+    return req->result;
+  }
+
+  req->fs.info.file_flags = flags;
+  POST;
+}
+
+
+int uv_fs_mmap(uv_loop_t* loop,
+               uv_fs_t* req,
+               uv_file fd,
+               int64_t offset,
+               size_t length,
+               int flags,
+               uv_fs_cb cb) {
+  INIT(UV_FS_MMAP);
+  req->file.fd = fd;
+  req->fs.info.offset = offset;
+  req->fs.info.file_flags = flags;
+  /* uv_buf_t.len is a ULONG, carry the length in req->ptr instead. It is
+   * replaced with the address of the mapping by fs__mmap().
+   */
+  req->ptr = (void*) (uintptr_t) length;
+  POST;
+}
+
+
+int uv_fs_munmap(uv_loop_t* loop,
+                 uv_fs_t* req,
+                 void* addr,
+                 size_t length,
+                 uv_fs_cb cb) {
+  INIT(UV_FS_MUNMAP);
+  if (addr == NULL || length == 0) {
+    SET_REQ_UV_ERROR(req, UV_EINVAL, ERROR_INVALID_PARAMETER);
+    return req->result;
+  }
+
+  /* UnmapViewOfFile() releases the whole view, the length isn't needed. */
+  req->fs.info.bufsml[0].base = addr;
+  POST;
+}
+
+
+int uv_fs_fadvise(uv_loop_t* loop,
+                  uv_fs_t* req,
+                  uv_file fd,
+                  int64_t offset,
+                  uint64_t length,
+                  uv_fs_fadvice_t advice,
+                  uv_fs_cb cb) {
+  INIT(UV_FS_FADVISE);
+  if (offset < 0 ||
+      advice < UV_FS_FADV_NORMAL ||
+      advice > UV_FS_FADV_DONTNEED) {
+    SET_REQ_UV_ERROR(req, UV_EINVAL, ERROR_INVALID_PARAMETER);
+    return req->result;
+  }
+
+  req->file.fd = fd;
+  req->fs.info.offset = offset;
+  req->fs.info.file_flags = advice;
+  /* See uv_fs_mmap(), fs__readahead() takes the length from req->ptr. */
+  req->ptr = (void*) (uintptr_t) length;
+  POST;
+}
+
+
+int uv_fs_readahead(uv_loop_t* loop,
+                    uv_fs_t* req,
+                    uv_file fd,
+                    int64_t offset,
+                    uint64_t length,
+                    uv_fs_cb cb) {
+  INIT(UV_FS_READAHEAD);
+  if (offset < 0) {
+    SET_REQ_UV_ERROR(req, UV_EINVAL, ERROR_INVALID_PARAMETER);
+    return req->result;
+  }
+
+  req->file.fd = fd;
+  req->fs.info.offset = offset;
+  req->ptr = (void*) (uintptr_t) length;
+  POST;
+}
+
+
+int uv_fs_fallocate(uv_loop_t* loop,
+                    uv_fs_t* req,
+                    uv_file fd,
+                    int64_t offset,
+                    int64_t length,
+                    int flags,
+                    uv_fs_cb cb) {
+  INIT(UV_FS_FALLOCATE);
+  if (offset < 0 || length <= 0 || uv__fs_fallocate_check(flags)) {
+    SET_REQ_UV_ERROR(req, UV_EINVAL, ERROR_INVALID_PARAMETER);
+    return req->result;
+  }
+
+  req->file.fd = fd;
+  req->fs.info.offset = offset;
+  req->fs.info.file_flags = flags;
+  /* The buffer lengths are ULONGs, split the length in two. */
+  req->fs.info.bufsml[0].len = (ULONG) ((uint64_t) length & 0xFFFFFFFF);
+  req->fs.info.bufsml[1].len = (ULONG) ((uint64_t) length >> 32);
+  POST;
+}
+
+
+int uv_fs_write_atomic(uv_loop_t* loop,
+                       uv_fs_t* req,
+                       const char* path,
+                       const uv_buf_t bufs[],
+                       unsigned int nbufs,
+                       int mode,
+                       int flags,
+                       uv_fs_cb cb) {
+  INIT(UV_FS_WRITE_ATOMIC);
+  SET_REQ_UV_ERROR(req, UV_ENOSYS, ERROR_NOT_SUPPORTED);
+  return req->result;
+}
+
+
+int uv_fs_write_batch(uv_loop_t* loop,
+                      uv_fs_t* req,
+                      uv_file fd,
+                      const uv_fs_write_segment_t segments[],
+                      unsigned int nsegments,
+                      int flags,
+                      uv_fs_cb cb) {
+  int err;
+
+  INIT(UV_FS_WRITE_BATCH);
+  err = uv__fs_write_batch_init(req, segments, nsegments, flags);
+  if (err) {
+    SET_REQ_UV_ERROR(req, err, ERROR_INVALID_PARAMETER);
+    return req->result;
+  }
+
+  req->file.fd = fd;
+  req->fs.info.file_flags = flags;
+  req->flags |= UV_FS_FREE_PTR;
+  POST;
+}
+
+
+int uv_fs_get_dio_alignment(uv_file fd,
+                            size_t* mem_align,
+                            size_t* offset_align) {
+  SYSTEM_INFO system_info;
+
+  if (mem_align == NULL || offset_align == NULL)
+    return UV_EINVAL;
+
+  if (uv__get_osfhandle(fd) == INVALID_HANDLE_VALUE)
+    return UV_EBADF;
+
+  /* FILE_FLAG_NO_BUFFERING wants sector aligned I/O. Sectors are never
+   * larger than a page, so the page size satisfies every disk.
+   */
+  GetSystemInfo(&system_info);
+  *mem_align = system_info.dwPageSize;
+  *offset_align = system_info.dwPageSize;
+
+  return 0;
+}
+
+
+static int fs__direct_check(uv_file fd,
+                            const uv_buf_t bufs[],
+                            unsigned int nbufs,
+                            int64_t offset) {
+  size_t offset_align;
+  size_t mem_align;
+  int err;
+
+  err = uv_fs_get_dio_alignment(fd, &mem_align, &offset_align);
+  if (err)
+    return err;
+
+  return uv__fs_dio_check(bufs, nbufs, offset, mem_align, offset_align);
+}
+
+
+int uv_fs_read_direct(uv_loop_t* loop,
+                      uv_fs_t* req,
+                      uv_file fd,
+                      const uv_buf_t bufs[],
+                      unsigned int nbufs,
+                      int64_t offset,
+                      uv_fs_cb cb) {
+  int err;
+
+  err = fs__direct_check(fd, bufs, nbufs, offset);
+  if (err) {
+    INIT(UV_FS_READ);
+    SET_REQ_UV_ERROR(req, err, ERROR_INVALID_PARAMETER);
+    return err;
+  }
+
+  return uv_fs_read(loop, req, fd, bufs, nbufs, offset, cb);
+}
+
+
+int uv_fs_write_direct(uv_loop_t* loop,
+                       uv_fs_t* req,
+                       uv_file fd,
+                       const uv_buf_t bufs[],
+                       unsigned int nbufs,
+                       int64_t offset,
+                       uv_fs_cb cb) {
+  int err;
+
+  err = fs__direct_check(fd, bufs, nbufs, offset);
+  if (err) {
+    INIT(UV_FS_WRITE);
+    SET_REQ_UV_ERROR(req, err, ERROR_INVALID_PARAMETER);
+    return err;
+  }
+
+  return uv_fs_write(loop, req, fd, bufs, nbufs, offset, cb);
+}
+
+
+int uv_fs_madvise(void* addr, size_t length, uv_fs_madvice_t advice) {
+  if (addr == NULL)
+    return UV_EINVAL;
+
+  switch (advice) {
+    case UV_FS_MADV_WILLNEED:
+      fs__mmap_prefetch(addr, length);
+      return 0;
+    case UV_FS_MADV_NORMAL:
+    case UV_FS_MADV_SEQUENTIAL:
+    case UV_FS_MADV_RANDOM:
+    case UV_FS_MADV_DONTNEED:
+      return 0;
+    default:
+      return UV_EINVAL;
+  }
+}
+
+
 int uv_fs_fstat(uv_loop_t* loop, uv_fs_t* req, uv_file fd, uv_fs_cb cb) {
   INIT(UV_FS_FSTAT);
   req->file.fd = fd;
@@ -3433,6 +4721,65 @@ int uv_fs_statfs(uv_loop_t* loop,
   POST;
 }
 
+
+/* CRT file descriptors of directories can't be had, there's nothing for the
+ * *at() variants to be relative to.
+ */
+int uv_fs_openat(uv_loop_t* loop,
+                 uv_fs_t* req,
+                 uv_file dir,
+                 const char* path,
+                 int flags,
+                 int mode,
+                 int at_flags,
+                 uv_fs_cb cb) {
+  INIT(UV_FS_OPENAT);
+  SET_REQ_UV_ERROR(req, UV_ENOSYS, ERROR_NOT_SUPPORTED);
+  return req->result;
+}
+
+
+int uv_fs_statat(uv_loop_t* loop,
+                 uv_fs_t* req,
+                 uv_file dir,
+                 const char* path,
+                 int at_flags,
+                 uv_fs_cb cb) {
+  INIT(UV_FS_STATAT);
+  SET_REQ_UV_ERROR(req, UV_ENOSYS, ERROR_NOT_SUPPORTED);
+  return req->result;
+}
+
+
+int uv_fs_unlinkat(uv_loop_t* loop,
+                   uv_fs_t* req,
+                   uv_file dir,
+                   const char* path,
+                   int at_flags,
+                   uv_fs_cb cb) {
+  INIT(UV_FS_UNLINKAT);
+  SET_REQ_UV_ERROR(req, UV_ENOSYS, ERROR_NOT_SUPPORTED);
+  return req->result;
+}
+
+
+int uv_fs_mkdirat(uv_loop_t* loop,
+                  uv_fs_t* req,
+                  uv_file dir,
+                  const char* path,
+                  int mode,
+                  int at_flags,
+                  uv_fs_cb cb) {
+  INIT(UV_FS_MKDIRAT);
+  SET_REQ_UV_ERROR(req, UV_ENOSYS, ERROR_NOT_SUPPORTED);
+  return req->result;
+}
+
+
+int uv_fs_dir_fileno(const uv_dir_t* dir, uv_file* fd) {
+  return UV_ENOSYS;
+}
+
 int uv_fs_get_system_error(const uv_fs_t* req) {
   return req->sys_errno_;
 }
@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_DNS
+
 #include <assert.h>
 
 #include "uv.h"
@@ -42,36 +44,13 @@ int uv__getaddrinfo_translate_error(int sys_err) {
     case WSA_NOT_ENOUGH_MEMORY:   return UV_EAI_MEMORY;
     case WSAHOST_NOT_FOUND:       return UV_EAI_NONAME;
     case WSATYPE_NOT_FOUND:       return UV_EAI_SERVICE;
+    case WSA_E_CANCELLED:         return UV_EAI_CANCELED;
     case WSAESOCKTNOSUPPORT:      return UV_EAI_SOCKTYPE;
     default:                      return uv_translate_sys_error(sys_err);
   }
 }
 
 
-/*
- * MinGW is missing this
- */
-#if !defined(_MSC_VER) && !defined(__MINGW64_VERSION_MAJOR)
-  typedef struct addrinfoW {
-    int ai_flags;
-    int ai_family;
-    int ai_socktype;
-    int ai_protocol;
-    size_t ai_addrlen;
-    WCHAR* ai_canonname;
-    struct sockaddr* ai_addr;
-    struct addrinfoW* ai_next;
-  } ADDRINFOW, *PADDRINFOW;
-
-  DECLSPEC_IMPORT int WSAAPI GetAddrInfoW(const WCHAR* node,
-                                          const WCHAR* service,
-                                          const ADDRINFOW* hints,
-                                          PADDRINFOW* result);
-
-  DECLSPEC_IMPORT void WSAAPI FreeAddrInfoW(PADDRINFOW pAddrInfo);
-#endif
-
-
 /* Adjust size value to be multiple of 4. Use to keep pointer aligned.
  * Do we need different versions of this for different architectures? */
 #define ALIGNED_SIZE(X)     ((((X) + 3) >> 2) << 2)
@@ -80,16 +59,83 @@ int uv__getaddrinfo_translate_error(int sys_err) {
 #define NDIS_IF_MAX_STRING_SIZE IF_MAX_STRING_SIZE
 #endif
 
-static void uv__getaddrinfo_work(struct uv__work* w) {
+/* Lookups run asynchronously in the system with GetAddrInfoExW(), rather
+ * than blocking a threadpool thread each. The state of a lookup sits at the
+ * start of req->alloc, followed by the UTF-16 node and service names.
+ */
+typedef struct {
+  OVERLAPPED overlapped;
+  HANDLE cancel_handle;
+  uv__addrinfoexw_t hints;
+  uv__addrinfoexw_t* result;
+  int has_hints;
+  uv_getaddrinfo_t* req;
+} uv__getaddrinfo_ctx_t;
+
+static void uv__getaddrinfo_done(struct uv__work* w, int status);
+
+
+/* Runs on a system thread when the lookup is done, hands it to the loop. */
+static void CALLBACK uv__getaddrinfo_complete(DWORD error,
+                                              DWORD bytes,
+                                              LPOVERLAPPED overlapped) {
+  uv__getaddrinfo_ctx_t* ctx;
   uv_getaddrinfo_t* req;
-  struct addrinfoW* hints;
+
+  ctx = container_of(overlapped, uv__getaddrinfo_ctx_t, overlapped);
+  req = ctx->req;
+  req->retcode = uv__getaddrinfo_translate_error(error);
+  uv__work_post(req->loop, &req->work_req, uv__getaddrinfo_done);
+}
+
+
+/* Starts the lookup, or runs it to completion without a callback. Returns
+ * nonzero when it went asynchronous.
+ */
+static int uv__getaddrinfo_start(uv_getaddrinfo_t* req) {
+  uv__getaddrinfo_ctx_t* ctx;
+  int async;
   int err;
 
-  req = container_of(w, uv_getaddrinfo_t, work_req);
-  hints = req->addrinfow;
-  req->addrinfow = NULL;
-  err = GetAddrInfoW(req->node, req->service, hints, &req->addrinfow);
+  ctx = req->alloc;
+  async = req->getaddrinfo_cb != NULL;
+  ctx->cancel_handle = NULL;
+  ctx->result = NULL;
+  memset(&ctx->overlapped, 0, sizeof(ctx->overlapped));
+
+  err = pGetAddrInfoExW(req->node,
+                        req->service,
+                        NS_ALL,
+                        NULL,
+                        ctx->has_hints ? &ctx->hints : NULL,
+                        &ctx->result,
+                        NULL,
+                        async ? &ctx->overlapped : NULL,
+                        async ? uv__getaddrinfo_complete : NULL,
+                        async ? &ctx->cancel_handle : NULL);
+  if (async && err == WSA_IO_PENDING)
+    return 1;
+
+  /* Finished right away, the completion routine isn't called. */
   req->retcode = uv__getaddrinfo_translate_error(err);
+  return 0;
+}
+
+
+int uv__getaddrinfo_cancel(uv_getaddrinfo_t* req) {
+  uv__getaddrinfo_ctx_t* ctx;
+
+  /* Lookups that completed are on their way back to the loop, or done. A
+   * stale cancel handle is rejected with WSA_INVALID_HANDLE.
+   */
+  ctx = req->alloc;
+  if (ctx == NULL || ctx->cancel_handle == NULL)
+    return UV_EBUSY;
+
+  if (pGetAddrInfoExCancel(&ctx->cancel_handle) != NO_ERROR)
+    return UV_EBUSY;
+
+  return 0;
 }
 
 
@@ -104,29 +150,27 @@ static void uv__getaddrinfo_work(struct uv__work* w) {
  */
 static void uv__getaddrinfo_done(struct uv__work* w, int status) {
   uv_getaddrinfo_t* req;
+  uv__getaddrinfo_ctx_t* ctx;
   int addrinfo_len = 0;
   int name_len = 0;
   size_t addrinfo_struct_len = ALIGNED_SIZE(sizeof(struct addrinfo));
-  struct addrinfoW* addrinfow_ptr;
+  uv__addrinfoexw_t* result;
+  uv__addrinfoexw_t* addrinfow_ptr;
   struct addrinfo* addrinfo_ptr;
   char* alloc_ptr = NULL;
   char* cur_ptr = NULL;
 
   req = container_of(w, uv_getaddrinfo_t, work_req);
+  ctx = req->alloc;
+  result = ctx->result;
 
   /* release input parameter memory */
   uv__free(req->alloc);
   req->alloc = NULL;
 
-  if (status == UV_ECANCELED) {
-    assert(req->retcode == 0);
-    req->retcode = UV_EAI_CANCELED;
-    goto complete;
-  }
-
   if (req->retcode == 0) {
-    /* Convert addrinfoW to addrinfo. First calculate required length. */
-    addrinfow_ptr = req->addrinfow;
+    /* Convert ADDRINFOEXW to addrinfo. First calculate required length. */
+    addrinfow_ptr = result;
     while (addrinfow_ptr != NULL) {
       addrinfo_len += addrinfo_struct_len +
           ALIGNED_SIZE(addrinfow_ptr->ai_addrlen);
@@ -154,7 +198,7 @@ static void uv__getaddrinfo_done(struct uv__work* w, int status) {
     /* do conversions */
     if (alloc_ptr != NULL) {
       cur_ptr = alloc_ptr;
-      addrinfow_ptr = req->addrinfow;
+      addrinfow_ptr = result;
 
       while (addrinfow_ptr != NULL) {
         /* copy addrinfo struct data */
@@ -218,13 +262,11 @@ static void uv__getaddrinfo_done(struct uv__work* w, int status) {
     }
   }
 
+complete:
   /* return memory to system */
-  if (req->addrinfow != NULL) {
-    FreeAddrInfoW(req->addrinfow);
-    req->addrinfow = NULL;
-  }
+  if (result != NULL)
+    pFreeAddrInfoExW(result);
 
-complete:
   uv__req_unregister(req->loop, req);
 
   /* finally do callback with converted result */
@@ -241,6 +283,12 @@ void uv_freeaddrinfo(struct addrinfo* ai) {
 }
 
 
+int uv_getaddrinfo_cache_configure(
+    const uv_getaddrinfo_cache_options_t* options) {
+  return UV_ENOSYS;
+}
+
+
 /*
  * Entry point for getaddrinfo
  * we convert the UTF-8 strings to UNICODE
@@ -261,9 +309,10 @@ int uv_getaddrinfo(uv_loop_t* loop,
                    const char* service,
                    const struct addrinfo* hints) {
   char hostname_ascii[256];
+  uv__getaddrinfo_ctx_t* ctx;
+  int ctxsize = ALIGNED_SIZE(sizeof(*ctx));
   int nodesize = 0;
   int servicesize = 0;
-  int hintssize = 0;
   char* alloc_ptr = NULL;
   int err;
   long rc;
@@ -272,9 +321,16 @@ int uv_getaddrinfo(uv_loop_t* loop,
     return UV_EINVAL;
   }
 
+  if (pGetAddrInfoExW == NULL || pFreeAddrInfoExW == NULL ||
+      pGetAddrInfoExCancel == NULL) {
+    return UV_ENOSYS;
+  }
+
   UV_REQ_INIT(req, UV_GETADDRINFO);
   req->getaddrinfo_cb = getaddrinfo_cb;
   req->addrinfo = NULL;
+  req->addrinfow = NULL;
+  req->alloc = NULL;
   req->loop = loop;
   req->retcode = 0;
 
@@ -308,12 +364,9 @@ int uv_getaddrinfo(uv_loop_t* loop,
       goto error;
     }
   }
-  if (hints != NULL) {
-    hintssize = ALIGNED_SIZE(sizeof(struct addrinfoW));
-  }
 
   /* allocate memory for inputs, and partition it as needed */
-  alloc_ptr = (char*)uv__malloc(nodesize + servicesize + hintssize);
+  alloc_ptr = (char*)uv__malloc(ctxsize + nodesize + servicesize);
   if (!alloc_ptr) {
     err = WSAENOBUFS;
     goto error;
@@ -321,6 +374,10 @@ int uv_getaddrinfo(uv_loop_t* loop,
 
   /* save alloc_ptr now so we can free if error */
   req->alloc = (void*)alloc_ptr;
+  ctx = (uv__getaddrinfo_ctx_t*) alloc_ptr;
+  ctx->req = req;
+  ctx->result = NULL;
+  alloc_ptr += ctxsize;
 
   /* Convert node string to UTF16 into allocated memory and save pointer in the
    * request. */
@@ -358,36 +415,30 @@ int uv_getaddrinfo(uv_loop_t* loop,
     req->service = NULL;
   }
 
-  /* copy hints to allocated memory and save pointer in req */
+  /* copy hints into the lookup state, the other fields must be zero */
+  memset(&ctx->hints, 0, sizeof(ctx->hints));
+  ctx->has_hints = hints != NULL;
   if (hints != NULL) {
-    req->addrinfow = (struct addrinfoW*)alloc_ptr;
-    req->addrinfow->ai_family = hints->ai_family;
-    req->addrinfow->ai_socktype = hints->ai_socktype;
-    req->addrinfow->ai_protocol = hints->ai_protocol;
-    req->addrinfow->ai_flags = hints->ai_flags;
-    req->addrinfow->ai_addrlen = 0;
-    req->addrinfow->ai_canonname = NULL;
-    req->addrinfow->ai_addr = NULL;
-    req->addrinfow->ai_next = NULL;
-  } else {
-    req->addrinfow = NULL;
+    ctx->hints.ai_family = hints->ai_family;
+    ctx->hints.ai_socktype = hints->ai_socktype;
+    ctx->hints.ai_protocol = hints->ai_protocol;
+    ctx->hints.ai_flags = hints->ai_flags;
   }
 
   uv__req_register(loop, req);
 
+  if (uv__getaddrinfo_start(req))
+    return 0;
+
   if (getaddrinfo_cb) {
-    uv__work_submit(loop,
-                    &req->work_req,
-                    UV__WORK_SLOW_IO,
-                    uv__getaddrinfo_work,
-                    uv__getaddrinfo_done);
+    /* The callback still runs from the loop, not from here. */
+    uv__work_post(loop, &req->work_req, uv__getaddrinfo_done);
     return 0;
-  } else {
-    uv__getaddrinfo_work(&req->work_req);
-    uv__getaddrinfo_done(&req->work_req, 0);
-    return req->retcode;
   }
 
+  uv__getaddrinfo_done(&req->work_req, 0);
+  return req->retcode;
+
 error:
   if (req != NULL) {
     uv__free(req->alloc);
@@ -99,6 +99,9 @@ static void uv__getnameinfo_done(struct uv__work* w, int status) {
   if (status == UV_ECANCELED) {
     assert(req->retcode == 0);
     req->retcode = UV_EAI_CANCELED;
+  } else if (status == UV_ETIMEDOUT) {
+    assert(req->retcode == 0);
+    req->retcode = UV_ETIMEDOUT;
   } else if (req->retcode == 0) {
     host = req->host;
     service = req->service;
@@ -155,3 +158,19 @@ int uv_getnameinfo(uv_loop_t* loop,
     return req->retcode;
   }
 }
+
+
+int uv_getnameinfo_many(uv_loop_t* loop,
+                        uv_getnameinfo_many_t* req,
+                        uv_nameinfo_t names[],
+                        unsigned int nnames,
+                        int flags,
+                        uv_getnameinfo_many_cb cb) {
+  return UV_ENOSYS;
+}
+
+
+int uv_getnameinfo_cache_configure(
+    const uv_getnameinfo_cache_options_t* options) {
+  return UV_ENOSYS;
+}
@@ -68,20 +68,31 @@
           ((handle)->flags & UV_HANDLE_REF)))                           \
       uv__active_handle_add((uv_handle_t*) (handle));                   \
                                                                         \
+    if ((handle)->flags & UV_HANDLE_ACTIVE)                             \
+      uv__get_handle_counts((handle)->loop)->active[(handle)->type]--;  \
+                                                                        \
     (handle)->flags |= UV_HANDLE_CLOSING;                               \
     (handle)->flags &= ~UV_HANDLE_ACTIVE;                               \
+    uv__handle_count_closing(handle);                                   \
   } while (0)
 
 
 #define uv__handle_close(handle)                                        \
   do {                                                                  \
-    QUEUE_REMOVE(&(handle)->handle_queue);                              \
+    int pooled_;                                                        \
+                                                                        \
+    uv__handle_remove(handle);                                          \
     uv__active_handle_rm((uv_handle_t*) (handle));                      \
                                                                         \
     (handle)->flags |= UV_HANDLE_CLOSED;                                \
+    /* The close callback can free handles that aren't pooled. */       \
+    pooled_ = (handle)->flags & UV_HANDLE_POOLED;                       \
                                                                         \
     if ((handle)->close_cb)                                             \
       (handle)->close_cb((uv_handle_t*) (handle));                      \
+                                                                        \
+    if (pooled_)                                                        \
+      uv__handle_pool_put((uv_handle_t*) (handle));                     \
   } while (0)
 
 
@@ -130,6 +141,10 @@ INLINE static void uv_process_endgames(uv_loop_t* loop) {
         uv__handle_close(handle);
         break;
 
+      case UV_NETIF:
+        uv__handle_close(handle);
+        break;
+
       case UV_PREPARE:
       case UV_CHECK:
       case UV_IDLE:
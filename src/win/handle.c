@@ -64,6 +64,17 @@ int uv_is_active(const uv_handle_t* handle) {
 }
 
 
+void uv_close_many(uv_handle_t* handles[],
+                   unsigned int nhandles,
+                   uv_close_cb close_cb) {
+  unsigned int i;
+
+  /* Windows has nothing like close_range(), close them one by one. */
+  for (i = 0; i < nhandles; i++)
+    uv_close(handles[i], close_cb);
+}
+
+
 void uv_close(uv_handle_t* handle, uv_close_cb cb) {
   uv_loop_t* loop = handle->loop;
 
@@ -141,6 +152,12 @@ void uv_close(uv_handle_t* handle, uv_close_cb cb) {
       uv__handle_closing(handle);
       return;
 
+    case UV_NETIF:
+      uv_netif_stop((uv_netif_t*) handle);
+      uv__handle_closing(handle);
+      uv_want_endgame(loop, handle);
+      return;
+
     default:
       /* Not supported */
       abort();
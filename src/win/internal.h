@@ -57,6 +57,46 @@ extern UV_THREAD_LOCAL int uv__crt_assert_enabled;
 #define UV_END_DISABLE_CRT_ASSERT()
 #endif
 
+/*
+ * Streams
+ */
+
+/* State of a stream that doesn't fit in uv_stream_t, allocated on first use
+ * and stored in handle->u.reserved[1]. u.fd overlaps u.reserved[0].
+ */
+typedef struct {
+  uv_alloc_vec_cb alloc_vec_cb;  /* uv_read_start_vec() */
+  union {
+    struct {
+      /* Zero until uv_tcp_set_pending_accepts() or listen, which means
+       * uv_simultaneous_server_accepts. */
+      unsigned int accepts_min;
+      unsigned int accepts_max;  /* Size of accept_reqs. */
+      unsigned int accepts_posted;  /* accept_reqs in use, grows up to max. */
+      LPFN_TRANSMITFILE func_transmitfile;  /* uv_stream_sendfile() */
+    } tcp;
+    struct {
+      /* Zero until uv_pipe_set_pending_instances() or bind, which means
+       * pending_instances. */
+      int instances_min;
+      int instances_posted;  /* accept_reqs in use. */
+      int instances_waiting;  /* Queued and not processed yet. */
+      uv_pipe_accept_t* spare_accepts;  /* accept_reqs not in use. */
+    } pipe;
+    struct {
+      /* uv_tty_set_write_buffer(), NULL while unbuffered. */
+      WCHAR* write_buf;
+      DWORD write_buf_size;
+      DWORD write_buf_used;
+      DWORD write_error;
+    } tty;
+  } u;
+} uv__stream_state_t;
+
+uv__stream_state_t* uv__stream_state(uv_stream_t* handle);
+void uv__stream_state_free(uv_stream_t* handle);
+
+
 /*
  * TCP
  */
@@ -80,6 +120,8 @@ int uv_tcp_write(uv_loop_t* loop, uv_write_t* req, uv_tcp_t* handle,
     const uv_buf_t bufs[], unsigned int nbufs, uv_write_cb cb);
 int uv__tcp_try_write(uv_tcp_t* handle, const uv_buf_t bufs[],
     unsigned int nbufs);
+int uv__tcp_sendfile(uv_loop_t* loop, uv_write_t* req, uv_tcp_t* handle,
+    HANDLE file, int64_t offset, size_t length, uv_write_cb cb);
 
 void uv_process_tcp_read_req(uv_loop_t* loop, uv_tcp_t* handle, uv_req_t* req);
 void uv_process_tcp_write_req(uv_loop_t* loop, uv_tcp_t* handle,
@@ -244,6 +286,10 @@ int uv_translate_sys_error(int sys_errno);
  * FS
  */
 void uv_fs_init(void);
+void uv_process_fs_req(uv_loop_t* loop, uv_fs_t* req);
+void uv__fs_stat_assign_statbuf(
+    uv_stat_t* statbuf,
+    const uv__file_stat_basic_information_t* stat_info);
 
 
 /*
@@ -294,6 +340,7 @@ void uv__stdio_noinherit(BYTE* buffer);
 int uv__stdio_verify(BYTE* buffer, WORD size);
 WORD uv__stdio_size(BYTE* buffer);
 HANDLE uv__stdio_handle(BYTE* buffer, int fd);
+int uv__stdio_handle_list(BYTE* buffer, HANDLE* handles);
 
 
 /*
@@ -311,6 +358,7 @@ int uv_ntstatus_to_winsock_error(NTSTATUS status);
 
 BOOL uv_get_acceptex_function(SOCKET socket, LPFN_ACCEPTEX* target);
 BOOL uv_get_connectex_function(SOCKET socket, LPFN_CONNECTEX* target);
+BOOL uv_get_transmitfile_function(SOCKET socket, LPFN_TRANSMITFILE* target);
 
 int WSAAPI uv_wsarecv_workaround(SOCKET socket, WSABUF* buffers,
     DWORD buffer_count, DWORD* bytes, DWORD* flags, WSAOVERLAPPED *overlapped,
@@ -331,6 +379,12 @@ extern int uv_tcp_non_ifs_lsp_ipv6;
 extern struct sockaddr_in uv_addr_ip4_any_;
 extern struct sockaddr_in6 uv_addr_ip6_any_;
 
+/* Registered I/O functions, valid when uv__rio_available is set. */
+#ifdef WSAID_MULTIPLE_RIO
+extern RIO_EXTENSION_FUNCTION_TABLE uv__rio;
+#endif
+extern int uv__rio_available;
+
 /*
  * Wake all loops with fake message
  */
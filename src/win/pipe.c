@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_STREAM
+
 #include <assert.h>
 #include <io.h>
 #include <stdio.h>
@@ -98,6 +100,13 @@ static void eof_timer_destroy(uv_pipe_t* pipe);
 static void eof_timer_close_cb(uv_handle_t* handle);
 
 
+/* The stream state of a server, allocated by uv_pipe_bind(). */
+static uv__stream_state_t* uv__pipe_serv_state(uv_pipe_t* handle) {
+  assert(handle->u.reserved[1] != NULL);
+  return handle->u.reserved[1];
+}
+
+
 static void uv_unique_pipe_name(char* ptr, char* name, size_t size) {
   snprintf(name, size, "\\\\?\\pipe\\uv\\%p-%lu", ptr, GetCurrentProcessId());
 }
@@ -120,6 +129,20 @@ int uv_pipe_init(uv_loop_t* loop, uv_pipe_t* handle, int ipc) {
 }
 
 
+int uv_pipe_init_ex(uv_loop_t* loop, uv_pipe_t* handle, unsigned int flags) {
+  if (flags & ~(UV_PIPE_IPC | UV_PIPE_SEQPACKET | UV_PIPE_VMSPLICE))
+    return UV_EINVAL;
+
+  /* Named pipes have a message mode but it doesn't work with the IPC
+   * framing, leave it for now.
+   */
+  if (flags & UV_PIPE_SEQPACKET)
+    return UV_ENOTSUP;
+
+  return uv_pipe_init(loop, handle, !!(flags & UV_PIPE_IPC));
+}
+
+
 static void uv_pipe_connection_init(uv_pipe_t* handle) {
   uv_connection_init((uv_stream_t*) handle);
   handle->read_req.data = handle;
@@ -705,16 +728,44 @@ void uv_pipe_endgame(uv_loop_t* loop, uv_pipe_t* handle) {
       handle->pipe.serv.accept_reqs = NULL;
     }
 
+    uv__stream_state_free((uv_stream_t*) handle);
     uv__handle_close(handle);
   }
 }
 
 
 void uv_pipe_pending_instances(uv_pipe_t* handle, int count) {
+  uv__stream_state_t* state;
+
   if (handle->flags & UV_HANDLE_BOUND)
     return;
   handle->pipe.serv.pending_instances = count;
   handle->flags |= UV_HANDLE_PIPESERVER;
+
+  /* Post all of them, see uv_pipe_bind(). */
+  state = handle->u.reserved[1];
+  if (state != NULL)
+    state->u.pipe.instances_min = 0;
+}
+
+
+int uv_pipe_set_pending_instances(uv_pipe_t* handle, int min, int max) {
+  uv__stream_state_t* state;
+
+  if (min < 1 || min > max || max > UV__PIPE_PENDING_INSTANCES_MAX)
+    return UV_EINVAL;
+
+  if (handle->flags & UV_HANDLE_BOUND)
+    return UV_EBUSY;
+
+  state = uv__stream_state((uv_stream_t*) handle);
+  if (state == NULL)
+    return UV_ENOMEM;
+
+  handle->pipe.serv.pending_instances = max;
+  state->u.pipe.instances_min = min;
+  handle->flags |= UV_HANDLE_PIPESERVER;
+  return 0;
 }
 
 
@@ -722,6 +773,7 @@ void uv_pipe_pending_instances(uv_pipe_t* handle, int count) {
 int uv_pipe_bind(uv_pipe_t* handle, const char* name) {
   uv_loop_t* loop = handle->loop;
   int i, err, nameSize;
+  uv__stream_state_t* state;
   uv_pipe_accept_t* req;
 
   if (handle->flags & UV_HANDLE_BOUND) {
@@ -732,10 +784,19 @@ int uv_pipe_bind(uv_pipe_t* handle, const char* name) {
     return UV_EINVAL;
   }
 
+  state = uv__stream_state((uv_stream_t*) handle);
+  if (state == NULL) {
+    return UV_ENOMEM;
+  }
+
   if (!(handle->flags & UV_HANDLE_PIPESERVER)) {
     handle->pipe.serv.pending_instances = default_pending_pipe_instances;
   }
 
+  if (state->u.pipe.instances_min == 0) {
+    state->u.pipe.instances_min = handle->pipe.serv.pending_instances;
+  }
+
   handle->pipe.serv.accept_reqs = (uv_pipe_accept_t*)
     uv__malloc(sizeof(uv_pipe_accept_t) * handle->pipe.serv.pending_instances);
   if (!handle->pipe.serv.accept_reqs) {
@@ -785,6 +846,9 @@ int uv_pipe_bind(uv_pipe_t* handle, const char* name) {
   }
 
   handle->pipe.serv.pending_accepts = NULL;
+  state->u.pipe.instances_posted = 0;
+  state->u.pipe.instances_waiting = 0;
+  state->u.pipe.spare_accepts = NULL;
   handle->flags |= UV_HANDLE_PIPESERVER;
   handle->flags |= UV_HANDLE_BOUND;
 
@@ -1039,6 +1103,9 @@ static void uv_pipe_queue_accept(uv_loop_t* loop, uv_pipe_t* handle,
     uv_pipe_accept_t* req, BOOL firstInstance) {
   assert(handle->flags & UV_HANDLE_LISTENING);
 
+  /* Every queued req comes back through uv_process_pipe_accept_req(). */
+  uv__pipe_serv_state(handle)->u.pipe.instances_waiting++;
+
   if (!firstInstance && !pipe_alloc_accept(loop, handle, req, FALSE)) {
     SET_REQ_ERROR(req, GetLastError());
     uv_insert_pending_req(loop, (uv_req_t*) req);
@@ -1073,6 +1140,7 @@ static void uv_pipe_queue_accept(uv_loop_t* loop, uv_pipe_t* handle,
 
 int uv_pipe_accept(uv_pipe_t* server, uv_stream_t* client) {
   uv_loop_t* loop = server->loop;
+  uv__stream_state_t* state;
   uv_pipe_t* pipe_client;
   uv_pipe_accept_t* req;
   QUEUE* q;
@@ -1121,7 +1189,17 @@ int uv_pipe_accept(uv_pipe_t* server, uv_stream_t* client) {
 
     server->handle = INVALID_HANDLE_VALUE;
     if (!(server->flags & UV_HANDLE_CLOSING)) {
-      uv_pipe_queue_accept(loop, server, req, FALSE);
+      state = uv__pipe_serv_state(server);
+      if (state->u.pipe.instances_posted > state->u.pipe.instances_min &&
+          2 * state->u.pipe.instances_waiting >
+              state->u.pipe.instances_posted) {
+        /* Most instances are waiting for clients, retire this one. */
+        req->next_pending = state->u.pipe.spare_accepts;
+        state->u.pipe.spare_accepts = req;
+        state->u.pipe.instances_posted--;
+      } else {
+        uv_pipe_queue_accept(loop, server, req, FALSE);
+      }
     }
   }
 
@@ -1132,6 +1210,7 @@ int uv_pipe_accept(uv_pipe_t* server, uv_stream_t* client) {
 /* Starts listening for connections for the given pipe. */
 int uv_pipe_listen(uv_pipe_t* handle, int backlog, uv_connection_cb cb) {
   uv_loop_t* loop = handle->loop;
+  uv__stream_state_t* state;
   int i;
 
   if (handle->flags & UV_HANDLE_LISTENING) {
@@ -1161,7 +1240,18 @@ int uv_pipe_listen(uv_pipe_t* handle, int backlog, uv_connection_cb cb) {
   /* First pipe handle should have already been created in uv_pipe_bind */
   assert(handle->pipe.serv.accept_reqs[0].pipeHandle != INVALID_HANDLE_VALUE);
 
-  for (i = 0; i < handle->pipe.serv.pending_instances; i++) {
+  /* Start out with the minimum, the rest are spares to grow into. */
+  state = uv__pipe_serv_state(handle);
+  for (i = handle->pipe.serv.pending_instances - 1;
+       i >= state->u.pipe.instances_min;
+       i--) {
+    handle->pipe.serv.accept_reqs[i].next_pending =
+        state->u.pipe.spare_accepts;
+    state->u.pipe.spare_accepts = &handle->pipe.serv.accept_reqs[i];
+  }
+
+  state->u.pipe.instances_posted = state->u.pipe.instances_min;
+  for (i = 0; i < state->u.pipe.instances_min; i++) {
     uv_pipe_queue_accept(loop, handle, &handle->pipe.serv.accept_reqs[i], i == 0);
   }
 
@@ -2103,12 +2193,34 @@ void uv_process_pipe_write_req(uv_loop_t* loop, uv_pipe_t* handle,
 }
 
 
+/* Called when a client connected while no other instance was waiting, the
+ * next one would have gotten ERROR_PIPE_BUSY. Doubles the number of posted
+ * instances, up to pending_instances. */
+static void uv__pipe_grow_instances(uv_loop_t* loop, uv_pipe_t* handle) {
+  uv__stream_state_t* state;
+  uv_pipe_accept_t* req;
+  int n;
+
+  state = uv__pipe_serv_state(handle);
+  n = state->u.pipe.instances_posted;
+  while (n-- > 0 && state->u.pipe.spare_accepts != NULL) {
+    req = state->u.pipe.spare_accepts;
+    state->u.pipe.spare_accepts = req->next_pending;
+    req->next_pending = NULL;
+    state->u.pipe.instances_posted++;
+    uv_pipe_queue_accept(loop, handle, req, FALSE);
+  }
+}
+
+
 void uv_process_pipe_accept_req(uv_loop_t* loop, uv_pipe_t* handle,
     uv_req_t* raw_req) {
   uv_pipe_accept_t* req = (uv_pipe_accept_t*) raw_req;
 
   assert(handle->type == UV_NAMED_PIPE);
 
+  uv__pipe_serv_state(handle)->u.pipe.instances_waiting--;
+
   if (handle->flags & UV_HANDLE_CLOSING) {
     /* The req->pipeHandle should be freed already in uv_pipe_cleanup(). */
     assert(req->pipeHandle == INVALID_HANDLE_VALUE);
@@ -2121,6 +2233,9 @@ void uv_process_pipe_accept_req(uv_loop_t* loop, uv_pipe_t* handle,
     req->next_pending = handle->pipe.serv.pending_accepts;
     handle->pipe.serv.pending_accepts = req;
 
+    if (uv__pipe_serv_state(handle)->u.pipe.instances_waiting == 0)
+      uv__pipe_grow_instances(loop, handle);
+
     if (handle->stream.serv.connection_cb) {
       handle->stream.serv.connection_cb((uv_stream_t*)handle, 0);
     }
@@ -2476,6 +2591,53 @@ int uv_pipe_pending_count(uv_pipe_t* handle) {
 }
 
 
+int uv_pipe_accept_fds(uv_pipe_t* handle,
+                       uv_os_fd_t fds[],
+                       unsigned int nfds) {
+  /* Sockets are passed as WSAPROTOCOL_INFOW, not as descriptors. */
+  return UV_ENOSYS;
+}
+
+
+int uv_pipe_buffer_size(uv_pipe_t* handle, int* value) {
+  /* Fixed when the pipe is created. */
+  return UV_ENOSYS;
+}
+
+
+int uv_shm_channel_init(uv_loop_t* loop,
+                        uv_shm_channel_t* channel,
+                        size_t size,
+                        uv_shm_channel_cb recv_cb) {
+  return UV_ENOSYS;
+}
+
+
+int uv_shm_channel_open(uv_loop_t* loop,
+                        uv_shm_channel_t* channel,
+                        const uv_os_fd_t fds[3],
+                        uv_shm_channel_cb recv_cb) {
+  return UV_ENOSYS;
+}
+
+
+int uv_shm_channel_fds(const uv_shm_channel_t* channel, uv_os_fd_t fds[3]) {
+  return UV_ENOSYS;
+}
+
+
+int uv_shm_channel_send(uv_shm_channel_t* channel,
+                        const uv_buf_t bufs[],
+                        unsigned int nbufs) {
+  return UV_ENOSYS;
+}
+
+
+void uv_shm_channel_close(uv_shm_channel_t* channel, uv_close_cb close_cb) {
+  /* Nothing to close, it can't be opened. */
+}
+
+
 int uv_pipe_getsockname(const uv_pipe_t* handle, char* buffer, size_t* size) {
   if (handle->flags & UV_HANDLE_BOUND)
     return uv__pipe_getname(handle, buffer, size);
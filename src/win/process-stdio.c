@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_PROCESS
+
 #include <assert.h>
 #include <io.h>
 #include <stdio.h>
@@ -414,3 +416,35 @@ WORD uv__stdio_size(BYTE* buffer) {
 HANDLE uv__stdio_handle(BYTE* buffer, int fd) {
   return CHILD_STDIO_HANDLE(buffer, fd);
 }
+
+
+/* Stores the distinct handles from `buffer` in `handles`, which must have room
+ * for 256 of them, and returns how many there are. These are the handles the
+ * child inherits when they go into PROC_THREAD_ATTRIBUTE_HANDLE_LIST, which
+ * rejects duplicates.
+ */
+int uv__stdio_handle_list(BYTE* buffer, HANDLE* handles) {
+  HANDLE handle;
+  int count;
+  int fd;
+  int n;
+  int i;
+
+  count = CHILD_STDIO_COUNT(buffer);
+  n = 0;
+
+  for (fd = 0; fd < count; fd++) {
+    handle = CHILD_STDIO_HANDLE(buffer, fd);
+    if (handle == NULL || handle == INVALID_HANDLE_VALUE)
+      continue;
+
+    for (i = 0; i < n; i++)
+      if (handles[i] == handle)
+        break;
+
+    if (i == n)
+      handles[n++] = handle;
+  }
+
+  return n;
+}
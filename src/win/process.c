@@ -19,6 +19,8 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_PROCESS
+
 #include <assert.h>
 #include <io.h>
 #include <stdio.h>
@@ -945,6 +947,11 @@ int uv_spawn(uv_loop_t* loop,
   WCHAR* application_path = NULL, *application = NULL, *arguments = NULL,
          *env = NULL, *cwd = NULL;
   STARTUPINFOW startup;
+  STARTUPINFOEXW startup_ex;
+  LPPROC_THREAD_ATTRIBUTE_LIST attribute_list = NULL;
+  HANDLE inherit_handles[256];
+  SIZE_T attribute_list_size;
+  int inherit_count;
   PROCESS_INFORMATION info;
   DWORD process_flags;
 
@@ -1100,6 +1107,67 @@ int uv_spawn(uv_loop_t* loop,
     process_flags |= DETACHED_PROCESS | CREATE_NEW_PROCESS_GROUP;
   }
 
+  /* With bInheritHandles set the child gets every inheritable handle of this
+   * process, including the stdio pipes that other threads create for their
+   * own uv_spawn() calls at the same time. Those then stay open in the wrong
+   * child and the other side never sees EOF. An explicit handle list
+   * restricts inheritance to the child's own stdio handles.
+   */
+  inherit_count = uv__stdio_handle_list(process->child_stdio_buffer,
+                                        inherit_handles);
+  attribute_list_size = 0;
+  InitializeProcThreadAttributeList(NULL, 1, 0, &attribute_list_size);
+  if (inherit_count > 0 && attribute_list_size > 0) {
+    attribute_list = uv__malloc(attribute_list_size);
+    if (attribute_list != NULL &&
+        !InitializeProcThreadAttributeList(attribute_list,
+                                           1,
+                                           0,
+                                           &attribute_list_size)) {
+      uv__free(attribute_list);
+      attribute_list = NULL;
+    }
+    if (attribute_list != NULL &&
+        !UpdateProcThreadAttribute(attribute_list,
+                                   0,
+                                   PROC_THREAD_ATTRIBUTE_HANDLE_LIST,
+                                   inherit_handles,
+                                   inherit_count * sizeof(HANDLE),
+                                   NULL,
+                                   NULL)) {
+      DeleteProcThreadAttributeList(attribute_list);
+      uv__free(attribute_list);
+      attribute_list = NULL;
+    }
+  }
+
+  if (attribute_list != NULL) {
+    startup_ex.StartupInfo = startup;
+    startup_ex.StartupInfo.cb = sizeof(startup_ex);
+    startup_ex.lpAttributeList = attribute_list;
+
+    if (CreateProcessW(application_path,
+                       arguments,
+                       NULL,
+                       NULL,
+                       1,
+                       process_flags | EXTENDED_STARTUPINFO_PRESENT,
+                       env,
+                       cwd,
+                       &startup_ex.StartupInfo,
+                       &info)) {
+      goto spawned;
+    }
+
+    /* Some handle types, like console handles before Windows 8, can't go in
+     * the list. Retry with plain inheritance in that case.
+     */
+    err = GetLastError();
+    if (err != ERROR_INVALID_PARAMETER)
+      goto done;
+    err = 0;
+  }
+
   if (!CreateProcessW(application_path,
                      arguments,
                      NULL,
@@ -1115,6 +1183,8 @@ int uv_spawn(uv_loop_t* loop,
     goto done;
   }
 
+ spawned:
+
   /* Spawn succeeded. Beyond this point, failure is reported asynchronously. */
 
   process->process_handle = info.hProcess;
@@ -1171,6 +1241,10 @@ int uv_spawn(uv_loop_t* loop,
 
   /* Cleanup, whether we succeeded or failed. */
  done:
+  if (attribute_list != NULL) {
+    DeleteProcThreadAttributeList(attribute_list);
+    uv__free(attribute_list);
+  }
   uv__free(application);
   uv__free(application_path);
   uv__free(arguments);
@@ -1237,6 +1311,16 @@ static int uv__kill(HANDLE process_handle, int signum) {
 }
 
 
+int uv_spawn_server_start(void) {
+  return UV_ENOSYS;
+}
+
+
+int uv_spawn_server_stop(void) {
+  return UV_ENOSYS;
+}
+
+
 int uv_process_kill(uv_process_t* process, int signum) {
   int err;
 
@@ -1281,3 +1365,13 @@ int uv_kill(int pid, int signum) {
 
   return err;  /* err is already translated. */
 }
+
+
+int uv_process_get_stats_many(uv_loop_t* loop,
+                              uv_process_stats_t* req,
+                              uv_process_t* processes[],
+                              uv_process_usage_t usage[],
+                              unsigned int nprocesses,
+                              uv_process_stats_cb cb) {
+  return UV_ENOSYS;
+}
@@ -210,6 +210,11 @@ INLINE static int uv_process_reqs(uv_loop_t* loop) {
         uv_process_fs_event_req(loop, req, (uv_fs_event_t*) req->data);
         break;
 
+      case UV_FS:
+        /* Reads and writes of UV_FS_O_OVERLAPPED files. */
+        uv_process_fs_req(loop, (uv_fs_t*) req);
+        break;
+
       default:
         assert(0);
     }
@@ -35,6 +35,8 @@ INLINE static void uv_stream_init(uv_loop_t* loop,
                                   uv_handle_type type) {
   uv__handle_init(loop, (uv_handle_t*) handle, type);
   handle->write_queue_size = 0;
+  handle->u.fd = -1;
+  handle->u.reserved[1] = NULL;
   handle->activecnt = 0;
   handle->stream.conn.shutdown_req = NULL;
   handle->stream.conn.write_reqs_pending = 0;
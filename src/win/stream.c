@@ -19,7 +19,10 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_STREAM
+
 #include <assert.h>
+#include <string.h>
 
 #include "uv.h"
 #include "internal.h"
@@ -166,6 +169,17 @@ int uv_write2(uv_write_t* req,
 }
 
 
+int uv_write_fds(uv_write_t* req,
+                 uv_stream_t* handle,
+                 const uv_buf_t bufs[],
+                 unsigned int nbufs,
+                 const uv_os_fd_t fds[],
+                 unsigned int nfds,
+                 uv_write_cb cb) {
+  return UV_ENOSYS;
+}
+
+
 int uv_try_write(uv_stream_t* stream,
                  const uv_buf_t bufs[],
                  unsigned int nbufs) {
@@ -223,6 +237,180 @@ int uv_shutdown(uv_shutdown_t* req, uv_stream_t* handle, uv_shutdown_cb cb) {
 }
 
 
+/* Windows has no write coalescing, every uv_write_copy() gets a request. */
+struct uv__write_copy {
+  uv_write_t req;
+  char data[1];
+};
+
+
+static void uv__write_copy_cb(uv_write_t* req, int status) {
+  uv__free(container_of(req, struct uv__write_copy, req));
+}
+
+
+int uv_write_copy(uv_stream_t* stream,
+                  const uv_buf_t bufs[],
+                  unsigned int nbufs) {
+  struct uv__write_copy* wc;
+  uv_buf_t buf;
+  size_t size;
+  size_t skip;
+  size_t len;
+  unsigned int i;
+  int err;
+
+  if (nbufs == 0)
+    return UV_EINVAL;
+
+  size = uv__count_bufs(bufs, nbufs);
+  if (size > UV__WRITE_COPY_MAX)
+    return UV_E2BIG;
+
+  skip = 0;
+  err = uv_try_write(stream, bufs, nbufs);
+  if (err >= 0)
+    skip = err;
+  else if (err != UV_EAGAIN)
+    return err;
+
+  if (skip == size)
+    return 0;
+
+  wc = uv__malloc(sizeof(*wc) + size - skip);
+  if (wc == NULL)
+    return UV_ENOMEM;
+
+  len = 0;
+  for (i = 0; i < nbufs; i++) {
+    if (skip >= bufs[i].len) {
+      skip -= bufs[i].len;
+      continue;
+    }
+
+    memcpy(wc->data + len, bufs[i].base + skip, bufs[i].len - skip);
+    len += bufs[i].len - skip;
+    skip = 0;
+  }
+
+  buf = uv_buf_init(wc->data, (unsigned int) len);
+  err = uv_write(&wc->req, stream, &buf, 1, uv__write_copy_cb);
+  if (err)
+    uv__free(wc);
+
+  return err;
+}
+
+
+uv__stream_state_t* uv__stream_state(uv_stream_t* handle) {
+  if (handle->u.reserved[1] == NULL)
+    handle->u.reserved[1] = uv__calloc(1, sizeof(uv__stream_state_t));
+
+  return handle->u.reserved[1];
+}
+
+
+void uv__stream_state_free(uv_stream_t* handle) {
+  uv__free(handle->u.reserved[1]);
+  handle->u.reserved[1] = NULL;
+}
+
+
+uv_alloc_vec_cb uv__stream_alloc_vec_cb(const uv_stream_t* handle) {
+  const uv__stream_state_t* state;
+
+  state = handle->u.reserved[1];
+  if (state == NULL)
+    return NULL;
+
+  return state->alloc_vec_cb;
+}
+
+
+int uv__stream_set_alloc_vec_cb(uv_stream_t* handle, uv_alloc_vec_cb alloc_cb) {
+  uv__stream_state_t* state;
+
+  state = uv__stream_state(handle);
+  if (state == NULL)
+    return UV_ENOMEM;
+
+  state->alloc_vec_cb = alloc_cb;
+  return 0;
+}
+
+
+int uv_stream_set_read_options(uv_stream_t* handle,
+                               const uv_stream_read_options_t* options) {
+  return UV_ENOSYS;
+}
+
+
+int uv_stream_set_accept_policy(uv_stream_t* server,
+                                const uv_stream_accept_policy_t* policy) {
+  return UV_ENOSYS;
+}
+
+
+int uv_stream_set_write_watermarks(uv_stream_t* handle,
+                                   size_t low,
+                                   size_t high,
+                                   uv_write_watermark_cb cb) {
+  return UV_ENOSYS;
+}
+
+
+int uv_stream_cork(uv_stream_t* handle) {
+  return UV_ENOSYS;
+}
+
+
+int uv_stream_uncork(uv_stream_t* handle) {
+  return UV_ENOSYS;
+}
+
+
+int uv_stream_sendfile(uv_write_t* req,
+                       uv_stream_t* handle,
+                       uv_file fd,
+                       int64_t offset,
+                       size_t length,
+                       uv_write_cb cb) {
+  HANDLE file;
+  int err;
+
+  if (fd < 0 || offset < 0)
+    return UV_EINVAL;
+
+  if (!(handle->flags & UV_HANDLE_WRITABLE))
+    return UV_EPIPE;
+
+  /* TransmitFile() only sends to sockets. */
+  if (handle->type != UV_TCP)
+    return UV_ENOSYS;
+
+  file = uv__get_osfhandle(fd);
+  if (file == INVALID_HANDLE_VALUE)
+    return UV_EBADF;
+
+  err = uv__tcp_sendfile(handle->loop,
+                         req,
+                         (uv_tcp_t*) handle,
+                         file,
+                         offset,
+                         length,
+                         cb);
+  return uv_translate_sys_error(err);
+}
+
+
+int uv_stream_splice(uv_splice_t* req,
+                     uv_stream_t* src,
+                     uv_stream_t* dst,
+                     uv_splice_cb cb) {
+  return UV_ENOSYS;
+}
+
+
 int uv_is_readable(const uv_stream_t* handle) {
   return !!(handle->flags & UV_HANDLE_READABLE);
 }
@@ -19,8 +19,11 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_STREAM
+
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "uv.h"
 #include "internal.h"
@@ -38,13 +41,32 @@
 const unsigned int uv_active_tcp_streams_threshold = 0;
 
 /*
- * Number of simultaneous pending AcceptEx calls.
+ * Default number of simultaneous pending AcceptEx calls.
  */
 const unsigned int uv_simultaneous_server_accepts = 32;
 
+#ifndef TCP_FASTOPEN
+/* Added in Windows 10 1607. */
+#define TCP_FASTOPEN 15
+#endif
+
 /* A zero-size buffer for use by uv_tcp_read */
 static char uv_zero_[] = "";
 
+/* The file and the bytes left of a uv_stream_sendfile() request, kept in the
+ * reserved fields of the write request. The file is NULL for plain writes. */
+#define uv__sendfile_handle(req) ((req)->reserved[0])
+#define uv__sendfile_left(req) ((size_t) (uintptr_t) (req)->reserved[1])
+#define uv__sendfile_set_left(req, n)                                         \
+  ((req)->reserved[1] = (void*) (uintptr_t) (n))
+
+
+/* The stream state of a server, allocated by uv_tcp_listen(). */
+static uv__stream_state_t* uv__tcp_serv_state(uv_tcp_t* handle) {
+  assert(handle->u.reserved[1] != NULL);
+  return handle->u.reserved[1];
+}
+
 static int uv__tcp_nodelay(uv_tcp_t* handle, SOCKET socket, int enable) {
   if (setsockopt(socket,
                  IPPROTO_TCP,
@@ -183,14 +205,14 @@ int uv_tcp_init_ex(uv_loop_t* loop, uv_tcp_t* handle, unsigned int flags) {
     sock = socket(domain, SOCK_STREAM, 0);
     if (sock == INVALID_SOCKET) {
       err = WSAGetLastError();
-      QUEUE_REMOVE(&handle->handle_queue);
+      uv__handle_remove(handle);
       return uv_translate_sys_error(err);
     }
 
     err = uv_tcp_set_socket(handle->loop, handle, sock, domain, 0);
     if (err) {
       closesocket(sock);
-      QUEUE_REMOVE(&handle->handle_queue);
+      uv__handle_remove(handle);
       return uv_translate_sys_error(err);
     }
 
@@ -240,7 +262,7 @@ void uv_tcp_endgame(uv_loop_t* loop, uv_tcp_t* handle) {
 
     if (!(handle->flags & UV_HANDLE_CONNECTION) && handle->tcp.serv.accept_reqs) {
       if (handle->flags & UV_HANDLE_EMULATE_IOCP) {
-        for (i = 0; i < uv_simultaneous_server_accepts; i++) {
+        for (i = 0; i < uv__tcp_serv_state(handle)->u.tcp.accepts_max; i++) {
           req = &handle->tcp.serv.accept_reqs[i];
           if (req->wait_handle != INVALID_HANDLE_VALUE) {
             UnregisterWait(req->wait_handle);
@@ -269,6 +291,7 @@ void uv_tcp_endgame(uv_loop_t* loop, uv_tcp_t* handle) {
       }
     }
 
+    uv__stream_state_free((uv_stream_t*) handle);
     uv__handle_close(handle);
     loop->active_tcp_streams--;
   }
@@ -385,6 +408,9 @@ static void CALLBACK post_write_completion(void* context, BOOLEAN timed_out) {
 }
 
 
+static void uv_tcp_grow_accepts(uv_tcp_t* handle);
+
+
 static void uv_tcp_queue_accept(uv_tcp_t* handle, uv_tcp_accept_t* req) {
   uv_loop_t* loop = handle->loop;
   BOOL success;
@@ -441,6 +467,10 @@ static void uv_tcp_queue_accept(uv_tcp_t* handle, uv_tcp_accept_t* req) {
     req->accept_socket = accept_socket;
     handle->reqs_pending++;
     uv_insert_pending_req(loop, (uv_req_t*)req);
+
+    /* A connection was waiting in the backlog already, post more requests
+     * if the server may grow. */
+    uv_tcp_grow_accepts(handle);
   } else if (UV_SUCCEEDED_WITH_IOCP(success)) {
     /* The req will be processed with IOCP. */
     req->accept_socket = accept_socket;
@@ -469,10 +499,51 @@ static void uv_tcp_queue_accept(uv_tcp_t* handle, uv_tcp_accept_t* req) {
 }
 
 
+static void uv_tcp_post_accept(uv_tcp_t* handle, uv_tcp_accept_t* req) {
+  if (handle->flags & UV_HANDLE_EMULATE_IOCP && req->event_handle == NULL) {
+    req->event_handle = CreateEvent(NULL, 0, 0, NULL);
+    if (req->event_handle == NULL) {
+      uv_fatal_error(GetLastError(), "CreateEvent");
+    }
+  }
+
+  uv_tcp_queue_accept(handle, req);
+}
+
+
+/* Called when AcceptEx completed synchronously, i.e. connections are queueing
+ * up faster than the posted requests pick them up. Doubles the number of
+ * posted requests up to accepts_max. The server doesn't shrink back. */
+static void uv_tcp_grow_accepts(uv_tcp_t* handle) {
+  uv__stream_state_t* state;
+  unsigned int posted;
+  unsigned int i;
+
+  if (handle->flags & (UV_HANDLE_TCP_SINGLE_ACCEPT |
+                       UV_HANDLE_TCP_ACCEPT_STATE_CHANGING))
+    return;
+
+  state = uv__tcp_serv_state(handle);
+  posted = state->u.tcp.accepts_posted;
+  if (posted >= state->u.tcp.accepts_max)
+    return;
+
+  /* Update the count first, the new requests can complete synchronously
+   * too and end up back here. */
+  state->u.tcp.accepts_posted = posted * 2;
+  if (state->u.tcp.accepts_posted > state->u.tcp.accepts_max)
+    state->u.tcp.accepts_posted = state->u.tcp.accepts_max;
+
+  for (i = posted; i < state->u.tcp.accepts_posted; i++)
+    uv_tcp_post_accept(handle, &handle->tcp.serv.accept_reqs[i]);
+}
+
+
 static void uv_tcp_queue_read(uv_loop_t* loop, uv_tcp_t* handle) {
   uv_read_t* req;
   uv_buf_t buf;
   int result;
+  int prealloc;
   DWORD bytes, flags;
 
   assert(handle->flags & UV_HANDLE_READING);
@@ -483,9 +554,18 @@ static void uv_tcp_queue_read(uv_loop_t* loop, uv_tcp_t* handle) {
 
   /*
    * Preallocate a read buffer if the number of active streams is below
-   * the threshold.
+   * the threshold. Pooled reads decide per connection instead: one that
+   * just filled a buffer most likely has more data queued, so it gets a pool
+   * buffer for a real overlapped read, saving the zero read and the
+   * nonblocking read behind it. Idle connections stay on zero reads and
+   * hold no buffer.
   */
-  if (loop->active_tcp_streams < uv_active_tcp_streams_threshold) {
+  if (handle->alloc_cb == uv__read_pool_alloc)
+    prealloc = handle->flags & UV_HANDLE_TCP_READ_AHEAD;
+  else
+    prealloc = loop->active_tcp_streams < uv_active_tcp_streams_threshold;
+
+  if (prealloc) {
     handle->flags &= ~UV_HANDLE_ZERO_READ;
     handle->tcp.conn.read_buffer = uv_buf_init(NULL, 0);
     handle->alloc_cb((uv_handle_t*) handle, 65536, &handle->tcp.conn.read_buffer);
@@ -560,6 +640,7 @@ int uv_tcp_close_reset(uv_tcp_t* handle, uv_close_cb close_cb) {
 
 int uv_tcp_listen(uv_tcp_t* handle, int backlog, uv_connection_cb cb) {
   unsigned int i, simultaneous_accepts;
+  uv__stream_state_t* state;
   uv_tcp_accept_t* req;
   int err;
 
@@ -594,6 +675,15 @@ int uv_tcp_listen(uv_tcp_t* handle, int backlog, uv_connection_cb cb) {
     }
   }
 
+  state = uv__stream_state((uv_stream_t*) handle);
+  if (state == NULL)
+    return ERROR_OUTOFMEMORY;
+
+  if (state->u.tcp.accepts_max == 0) {
+    state->u.tcp.accepts_min = uv_simultaneous_server_accepts;
+    state->u.tcp.accepts_max = uv_simultaneous_server_accepts;
+  }
+
   /* If this flag is set, we already made this listen call in xfer. */
   if (!(handle->flags & UV_HANDLE_SHARED_TCP_SOCKET) &&
       listen(handle->socket, backlog) == SOCKET_ERROR) {
@@ -605,38 +695,19 @@ int uv_tcp_listen(uv_tcp_t* handle, int backlog, uv_connection_cb cb) {
   INCREASE_ACTIVE_COUNT(loop, handle);
 
   simultaneous_accepts = handle->flags & UV_HANDLE_TCP_SINGLE_ACCEPT ? 1
-    : uv_simultaneous_server_accepts;
+    : state->u.tcp.accepts_min;
 
   if (handle->tcp.serv.accept_reqs == NULL) {
     handle->tcp.serv.accept_reqs =
-      uv__malloc(uv_simultaneous_server_accepts * sizeof(uv_tcp_accept_t));
+      uv__malloc(state->u.tcp.accepts_max * sizeof(uv_tcp_accept_t));
     if (!handle->tcp.serv.accept_reqs) {
       uv_fatal_error(ERROR_OUTOFMEMORY, "uv__malloc");
     }
 
-    for (i = 0; i < simultaneous_accepts; i++) {
-      req = &handle->tcp.serv.accept_reqs[i];
-      UV_REQ_INIT(req, UV_ACCEPT);
-      req->accept_socket = INVALID_SOCKET;
-      req->data = handle;
-
-      req->wait_handle = INVALID_HANDLE_VALUE;
-      if (handle->flags & UV_HANDLE_EMULATE_IOCP) {
-        req->event_handle = CreateEvent(NULL, 0, 0, NULL);
-        if (req->event_handle == NULL) {
-          uv_fatal_error(GetLastError(), "CreateEvent");
-        }
-      } else {
-        req->event_handle = NULL;
-      }
-
-      uv_tcp_queue_accept(handle, req);
-    }
-
-    /* Initialize other unused requests too, because uv_tcp_endgame doesn't
-     * know how many requests were initialized, so it will try to clean up
-     * {uv_simultaneous_server_accepts} requests. */
-    for (i = simultaneous_accepts; i < uv_simultaneous_server_accepts; i++) {
+    /* Initialize the requests that aren't posted yet too, uv_tcp_endgame
+     * cleans up all {accepts_max} of them and the server may grow into
+     * them later. */
+    for (i = 0; i < state->u.tcp.accepts_max; i++) {
       req = &handle->tcp.serv.accept_reqs[i];
       UV_REQ_INIT(req, UV_ACCEPT);
       req->accept_socket = INVALID_SOCKET;
@@ -644,6 +715,10 @@ int uv_tcp_listen(uv_tcp_t* handle, int backlog, uv_connection_cb cb) {
       req->wait_handle = INVALID_HANDLE_VALUE;
       req->event_handle = NULL;
     }
+
+    state->u.tcp.accepts_posted = simultaneous_accepts;
+    for (i = 0; i < simultaneous_accepts; i++)
+      uv_tcp_post_accept(handle, &handle->tcp.serv.accept_reqs[i]);
   }
 
   return 0;
@@ -700,12 +775,14 @@ int uv_tcp_accept(uv_tcp_t* server, uv_tcp_t* client) {
 
       server->tcp.serv.processed_accepts++;
 
-      if (server->tcp.serv.processed_accepts >= uv_simultaneous_server_accepts) {
+      if (server->tcp.serv.processed_accepts >=
+          uv__tcp_serv_state(server)->u.tcp.accepts_posted) {
         server->tcp.serv.processed_accepts = 0;
         /*
          * All previously queued accept requests are now processed.
          * We now switch to queueing just a single accept.
          */
+        uv__tcp_serv_state(server)->u.tcp.accepts_posted = 1;
         uv_tcp_queue_accept(server, &server->tcp.serv.accept_reqs[0]);
         server->flags &= ~UV_HANDLE_TCP_ACCEPT_STATE_CHANGING;
         server->flags |= UV_HANDLE_TCP_SINGLE_ACCEPT;
@@ -783,6 +860,8 @@ static int uv_tcp_try_connect(uv_connect_t* req,
                               uv_tcp_t* handle,
                               const struct sockaddr* addr,
                               unsigned int addrlen,
+                              char* data,
+                              DWORD datalen,
                               uv_connect_cb cb) {
   uv_loop_t* loop = handle->loop;
   TCP_INITIAL_RTO_PARAMETERS retransmit_ioctl;
@@ -790,6 +869,7 @@ static int uv_tcp_try_connect(uv_connect_t* req,
   struct sockaddr_storage converted;
   BOOL success;
   DWORD bytes;
+  DWORD on;
   int err;
 
   err = uv__convert_to_localhost_if_unspecified(addr, &converted);
@@ -839,11 +919,24 @@ static int uv_tcp_try_connect(uv_connect_t* req,
              NULL);
   }
 
+  /* Lets ConnectEx() put the data into the SYN when there's a cookie. We do
+   * not care if this fails, the data is then sent after the handshake.
+   */
+  if (datalen > 0) {
+    on = 1;
+    setsockopt(handle->socket,
+               IPPROTO_TCP,
+               TCP_FASTOPEN,
+               (const char*) &on,
+               sizeof(on));
+  }
+
 out:
 
   UV_REQ_INIT(req, UV_CONNECT);
   req->handle = (uv_stream_t*) handle;
   req->cb = cb;
+  req->reserved[0] = data;  /* Freed in uv_process_tcp_connect_req(). */
   memset(&req->u.io.overlapped, 0, sizeof(req->u.io.overlapped));
 
   if (handle->delayed_error != 0) {
@@ -857,8 +950,8 @@ out:
   success = handle->tcp.conn.func_connectex(handle->socket,
                                             (const struct sockaddr*) &converted,
                                             addrlen,
-                                            NULL,
-                                            0,
+                                            data,
+                                            datalen,
                                             &bytes,
                                             &req->u.io.overlapped);
 
@@ -915,6 +1008,7 @@ int uv_tcp_write(uv_loop_t* loop,
   UV_REQ_INIT(req, UV_WRITE);
   req->handle = (uv_stream_t*) handle;
   req->cb = cb;
+  uv__sendfile_handle(req) = NULL;
 
   /* Prepare the overlapped structure. */
   memset(&(req->u.io.overlapped), 0, sizeof(req->u.io.overlapped));
@@ -970,6 +1064,116 @@ int uv_tcp_write(uv_loop_t* loop,
 }
 
 
+/* TransmitFile() sends at most 2^31 - 2 bytes per call, bigger ranges go out
+ * in chunks of this size. */
+#define UV__TRANSMIT_CHUNK (1024 * 1024 * 1024)
+
+
+/* Posts the next chunk of a uv_stream_sendfile() request, starting at file
+ * offset `offset`. Errors are reported through the request. */
+static void uv_tcp_queue_transmit(uv_loop_t* loop,
+                                  uv_write_t* req,
+                                  uv_tcp_t* handle,
+                                  uint64_t offset) {
+  uv__stream_state_t* state;
+  DWORD chunk;
+  BOOL success;
+
+  chunk = uv__sendfile_left(req) < UV__TRANSMIT_CHUNK ?
+          (DWORD) uv__sendfile_left(req) : UV__TRANSMIT_CHUNK;
+
+  memset(&(req->u.io.overlapped), 0, sizeof(req->u.io.overlapped));
+  req->u.io.overlapped.Offset = (DWORD) offset;
+  req->u.io.overlapped.OffsetHigh = (DWORD) (offset >> 32);
+  req->u.io.queued_bytes = 0;
+
+  /* A zero length makes TransmitFile() send the whole file. */
+  if (chunk == 0) {
+    SET_REQ_SUCCESS(req);
+    uv_insert_pending_req(loop, (uv_req_t*) req);
+    return;
+  }
+
+  if (handle->flags & UV_HANDLE_EMULATE_IOCP) {
+    req->u.io.overlapped.hEvent = (HANDLE) ((ULONG_PTR) req->event_handle | 1);
+    req->wait_handle = INVALID_HANDLE_VALUE;
+  }
+
+  /* Allocated by uv__tcp_sendfile(). */
+  state = handle->u.reserved[1];
+  success = state->u.tcp.func_transmitfile(handle->socket,
+                                           uv__sendfile_handle(req),
+                                           chunk,
+                                           0,
+                                           &req->u.io.overlapped,
+                                           NULL,
+                                           0);
+
+  if (UV_SUCCEEDED_WITHOUT_IOCP(success)) {
+    /* Request completed immediately, InternalHigh has the byte count. */
+    uv_insert_pending_req(loop, (uv_req_t*) req);
+  } else if (UV_SUCCEEDED_WITH_IOCP(success)) {
+    /* Request queued by the kernel. */
+    req->u.io.queued_bytes = chunk;
+    handle->write_queue_size += chunk;
+    if (handle->flags & UV_HANDLE_EMULATE_IOCP &&
+        !RegisterWaitForSingleObject(&req->wait_handle,
+          req->event_handle, post_write_completion, (void*) req,
+          INFINITE, WT_EXECUTEINWAITTHREAD | WT_EXECUTEONLYONCE)) {
+      SET_REQ_ERROR(req, GetLastError());
+      uv_insert_pending_req(loop, (uv_req_t*)req);
+    }
+  } else {
+    /* Send failed due to an error, report it later */
+    SET_REQ_ERROR(req, WSAGetLastError());
+    uv_insert_pending_req(loop, (uv_req_t*) req);
+  }
+}
+
+
+int uv__tcp_sendfile(uv_loop_t* loop,
+                     uv_write_t* req,
+                     uv_tcp_t* handle,
+                     HANDLE file,
+                     int64_t offset,
+                     size_t length,
+                     uv_write_cb cb) {
+  uv__stream_state_t* state;
+
+  state = uv__stream_state((uv_stream_t*) handle);
+  if (state == NULL)
+    return ERROR_OUTOFMEMORY;
+
+  if (!state->u.tcp.func_transmitfile) {
+    if (!uv_get_transmitfile_function(handle->socket,
+                                      &state->u.tcp.func_transmitfile)) {
+      return WSAEAFNOSUPPORT;
+    }
+  }
+
+  UV_REQ_INIT(req, UV_WRITE);
+  req->handle = (uv_stream_t*) handle;
+  req->cb = cb;
+  uv__sendfile_handle(req) = file;
+  uv__sendfile_set_left(req, length);
+
+  if (handle->flags & UV_HANDLE_EMULATE_IOCP) {
+    req->event_handle = CreateEvent(NULL, 0, 0, NULL);
+    if (req->event_handle == NULL) {
+      uv_fatal_error(GetLastError(), "CreateEvent");
+    }
+  }
+
+  /* Counted once, the chunks reuse the request. */
+  handle->reqs_pending++;
+  handle->stream.conn.write_reqs_pending++;
+  REGISTER_HANDLE_REQ(loop, handle, req);
+  uv_tcp_queue_transmit(loop, req, handle, (uint64_t) offset);
+
+  return 0;
+}
+
+
 int uv__tcp_try_write(uv_tcp_t* handle,
                      const uv_buf_t bufs[],
                      unsigned int nbufs) {
@@ -997,12 +1201,16 @@ int uv__tcp_try_write(uv_tcp_t* handle,
 void uv_process_tcp_read_req(uv_loop_t* loop, uv_tcp_t* handle,
     uv_req_t* req) {
   DWORD bytes, flags, err;
+  uv_buf_t bufs[UV__READ_VEC_MAX];
+  unsigned int nbufs;
   uv_buf_t buf;
   int count;
+  int ahead;
 
   assert(handle->type == UV_TCP);
 
-  handle->flags &= ~UV_HANDLE_READ_PENDING;
+  handle->flags &= ~(UV_HANDLE_READ_PENDING | UV_HANDLE_TCP_READ_AHEAD);
+  ahead = 0;
 
   if (!REQ_SUCCESS(req)) {
     /* An error occurred doing the read. */
@@ -1055,42 +1263,47 @@ void uv_process_tcp_read_req(uv_loop_t* loop, uv_tcp_t* handle,
     /* Do nonblocking reads until the buffer is empty */
     count = 32;
     while ((handle->flags & UV_HANDLE_READING) && (count-- > 0)) {
-      buf = uv_buf_init(NULL, 0);
-      handle->alloc_cb((uv_handle_t*) handle, 65536, &buf);
-      if (buf.base == NULL || buf.len == 0) {
-        handle->read_cb((uv_stream_t*) handle, UV_ENOBUFS, &buf);
+      ahead = 0;
+      /* Scatters over several buffers for uv_read_start_vec() streams. */
+      nbufs = uv__read_alloc((uv_stream_t*) handle,
+                             65536,
+                             bufs,
+                             ARRAY_SIZE(bufs));
+      if (nbufs == 0) {
+        handle->read_cb((uv_stream_t*) handle, UV_ENOBUFS, bufs);
         break;
       }
-      assert(buf.base != NULL);
+      assert(bufs[0].base != NULL);
 
       flags = 0;
       if (WSARecv(handle->socket,
-                  (WSABUF*)&buf,
-                  1,
+                  (WSABUF*) bufs,
+                  nbufs,
                   &bytes,
                   &flags,
                   NULL,
                   NULL) != SOCKET_ERROR) {
         if (bytes > 0) {
           /* Successful read */
-          handle->read_cb((uv_stream_t*)handle, bytes, &buf);
-          /* Read again only if bytes == buf.len */
-          if (bytes < buf.len) {
+          handle->read_cb((uv_stream_t*)handle, bytes, bufs);
+          /* Read again only if the buffers were filled */
+          if (bytes < uv__count_bufs(bufs, nbufs)) {
             break;
           }
+          ahead = 1;
         } else {
           /* Connection closed */
           handle->flags &= ~UV_HANDLE_READING;
           DECREASE_ACTIVE_COUNT(loop, handle);
 
-          handle->read_cb((uv_stream_t*)handle, UV_EOF, &buf);
+          handle->read_cb((uv_stream_t*)handle, UV_EOF, bufs);
           break;
         }
       } else {
         err = WSAGetLastError();
         if (err == WSAEWOULDBLOCK) {
           /* Read buffer was completely empty, report a 0-byte read. */
-          handle->read_cb((uv_stream_t*)handle, 0, &buf);
+          handle->read_cb((uv_stream_t*)handle, 0, bufs);
         } else {
           /* Ouch! serious error. */
           handle->flags &= ~UV_HANDLE_READING;
@@ -1105,7 +1318,7 @@ void uv_process_tcp_read_req(uv_loop_t* loop, uv_tcp_t* handle,
 
           handle->read_cb((uv_stream_t*)handle,
                           uv_translate_sys_error(err),
-                          &buf);
+                          bufs);
         }
         break;
       }
@@ -1115,6 +1328,8 @@ done:
     /* Post another read if still reading and not closing. */
     if ((handle->flags & UV_HANDLE_READING) &&
         !(handle->flags & UV_HANDLE_READ_PENDING)) {
+      if (ahead)
+        handle->flags |= UV_HANDLE_TCP_READ_AHEAD;
       uv_tcp_queue_read(loop, handle);
     }
   }
@@ -1125,6 +1340,9 @@ done:
 
 void uv_process_tcp_write_req(uv_loop_t* loop, uv_tcp_t* handle,
     uv_write_t* req) {
+  uint64_t offset;
+  size_t chunk;
+  size_t sent;
   int err;
 
   assert(handle->type == UV_TCP);
@@ -1132,6 +1350,28 @@ void uv_process_tcp_write_req(uv_loop_t* loop, uv_tcp_t* handle,
   assert(handle->write_queue_size >= req->u.io.queued_bytes);
   handle->write_queue_size -= req->u.io.queued_bytes;
 
+  /* Post the next chunk of a uv_stream_sendfile() request. A chunk that came
+   * up short hit the end of the file. */
+  if (uv__sendfile_handle(req) != NULL && REQ_SUCCESS(req)) {
+    chunk = uv__sendfile_left(req) < UV__TRANSMIT_CHUNK ?
+            uv__sendfile_left(req) : UV__TRANSMIT_CHUNK;
+    sent = (size_t) req->u.io.overlapped.InternalHigh;
+    uv__sendfile_set_left(req, uv__sendfile_left(req) - sent);
+
+    if (sent == chunk && uv__sendfile_left(req) > 0 &&
+        !(handle->flags & UV_HANDLE_CLOSING)) {
+      if (handle->flags & UV_HANDLE_EMULATE_IOCP &&
+          req->wait_handle != INVALID_HANDLE_VALUE) {
+        UnregisterWait(req->wait_handle);
+        req->wait_handle = INVALID_HANDLE_VALUE;
+      }
+      offset = req->u.io.overlapped.OffsetHigh;
+      offset = (offset << 32) + req->u.io.overlapped.Offset + sent;
+      uv_tcp_queue_transmit(loop, req, handle, offset);
+      return;
+    }
+  }
+
   UNREGISTER_HANDLE_REQ(loop, handle, req);
 
   if (handle->flags & UV_HANDLE_EMULATE_IOCP) {
@@ -1151,6 +1391,11 @@ void uv_process_tcp_write_req(uv_loop_t* loop, uv_tcp_t* handle,
       /* use UV_ECANCELED for consistency with Unix */
       err = UV_ECANCELED;
     }
+    if (err == 0 &&
+        uv__sendfile_handle(req) != NULL &&
+        uv__sendfile_left(req) > 0) {
+      err = handle->flags & UV_HANDLE_CLOSING ? UV_ECANCELED : UV_EOF;
+    }
     req->cb(req, err);
   }
 
@@ -1225,6 +1470,9 @@ void uv_process_tcp_connect_req(uv_loop_t* loop, uv_tcp_t* handle,
 
   UNREGISTER_HANDLE_REQ(loop, handle, req);
 
+  uv__free(req->reserved[0]);
+  req->reserved[0] = NULL;
+
   err = 0;
   if (handle->delayed_error) {
     /* To smooth over the differences between unixes errors that
@@ -1351,6 +1599,97 @@ int uv_tcp_nodelay(uv_tcp_t* handle, int enable) {
 }
 
 
+int uv_tcp_zerocopy(uv_tcp_t* handle, size_t threshold) {
+  return UV_ENOSYS;
+}
+
+
+int uv_tcp_set_notsent_lowat(uv_tcp_t* handle,
+                             unsigned int lowat,
+                             uv_tcp_writable_cb cb) {
+  return UV_ENOSYS;
+}
+
+
+int uv_tcp_recv_timestamps(uv_tcp_t* handle, int enable) {
+  return UV_ENOSYS;
+}
+
+
+int uv_tcp_get_read_timestamp(const uv_tcp_t* handle, uv_timespec_t* ts) {
+  return UV_ENOSYS;
+}
+
+
+int uv_tcp_tls_offload(uv_tcp_t* handle,
+                       uv_tls_direction direction,
+                       const void* crypto_info,
+                       size_t size) {
+  return UV_ENOSYS;
+}
+
+
+int uv_tcp_reuseport_steer_by_cpu(uv_tcp_t* handle) {
+  return UV_ENOSYS;
+}
+
+
+int uv_tcp_set_busy_poll(uv_tcp_t* handle, unsigned int usec) {
+  return UV_ENOSYS;
+}
+
+
+int uv_tcp_defer_accept(uv_tcp_t* handle, unsigned int timeout) {
+  return UV_ENOSYS;
+}
+
+
+int uv_tcp_get_info(const uv_tcp_t* handle, uv_tcp_info_t* info) {
+  uv__tcp_info_v0_t ti;
+  DWORD version;
+  DWORD bytes;
+
+  if (handle->socket == INVALID_SOCKET)
+    return UV_EBADF;
+
+  memset(info, 0, sizeof(*info));
+  memset(&ti, 0, sizeof(ti));
+
+  /* Windows 10 1703 and later. */
+  version = 0;
+  if (WSAIoctl(handle->socket,
+               SIO_TCP_INFO,
+               &version,
+               sizeof(version),
+               &ti,
+               sizeof(ti),
+               &bytes,
+               NULL,
+               NULL) != 0) {
+    return uv_translate_sys_error(WSAGetLastError());
+  }
+
+  /* There is no RTT variance, retransmission timeout or segment count for
+   * retransmissions. The window is in bytes.
+   */
+  info->rtt = ti.RttUs;
+  info->min_rtt = ti.MinRttUs;
+  info->mss = ti.Mss;
+  if (ti.Mss > 0)
+    info->snd_cwnd = ti.Cwnd / ti.Mss;
+  info->bytes_sent = ti.BytesOut;
+  info->bytes_retrans = ti.BytesRetrans;
+  info->bytes_received = ti.BytesIn;
+
+  return 0;
+}
+
+
+int uv_tcp_set_incoming_cpu(uv_tcp_t* handle, int cpu) {
+  return UV_ENOSYS;
+}
+
+
 int uv_tcp_keepalive(uv_tcp_t* handle, int enable, unsigned int delay) {
   int err;
 
@@ -1404,6 +1743,31 @@ int uv_tcp_simultaneous_accepts(uv_tcp_t* handle, int enable) {
 }
 
 
+int uv_tcp_set_pending_accepts(uv_tcp_t* handle,
+                               unsigned int min,
+                               unsigned int max) {
+  uv__stream_state_t* state;
+
+  if (min == 0 || min > max || max > UV__TCP_PENDING_ACCEPTS_MAX)
+    return UV_EINVAL;
+
+  if (handle->flags & UV_HANDLE_CONNECTION)
+    return UV_EINVAL;
+
+  /* The requests are allocated when the server starts listening. */
+  if (handle->flags & UV_HANDLE_LISTENING)
+    return UV_EBUSY;
+
+  state = uv__stream_state((uv_stream_t*) handle);
+  if (state == NULL)
+    return UV_ENOMEM;
+
+  state->u.tcp.accepts_min = min;
+  state->u.tcp.accepts_max = max;
+  return 0;
+}
+
+
 static void uv_tcp_try_cancel_reqs(uv_tcp_t* tcp) {
   SOCKET socket;
   int non_ifs_lsp;
@@ -1467,7 +1831,7 @@ void uv_tcp_close(uv_loop_t* loop, uv_tcp_t* tcp) {
       /* First close the incoming sockets to cancel the accept operations before
        * we free their resources. */
       unsigned int i;
-      for (i = 0; i < uv_simultaneous_server_accepts; i++) {
+      for (i = 0; i < uv__tcp_serv_state(tcp)->u.tcp.accepts_max; i++) {
         uv_tcp_accept_t* req = &tcp->tcp.serv.accept_reqs[i];
         if (req->accept_socket != INVALID_SOCKET) {
           closesocket(req->accept_socket);
@@ -1555,6 +1919,10 @@ int uv__tcp_bind(uv_tcp_t* handle,
                  unsigned int flags) {
   int err;
 
+  /* Windows has no load balancing between sockets bound to the same port. */
+  if (flags & UV_TCP_REUSEPORT)
+    return UV_ENOTSUP;
+
   err = uv_tcp_try_bind(handle, addr, addrlen, flags);
   if (err)
     return uv_translate_sys_error(err);
@@ -1573,13 +1941,84 @@ int uv__tcp_connect(uv_connect_t* req,
                     uv_connect_cb cb) {
   int err;
 
-  err = uv_tcp_try_connect(req, handle, addr, addrlen, cb);
+  err = uv_tcp_try_connect(req, handle, addr, addrlen, NULL, 0, cb);
   if (err)
     return uv_translate_sys_error(err);
 
   return 0;
 }
 
+
+/* This function is an egress point, i.e. it returns libuv errors rather than
+ * system errors.
+ */
+int uv__tcp_connect_fastopen(uv_connect_t* req,
+                             uv_tcp_t* handle,
+                             const struct sockaddr* addr,
+                             unsigned int addrlen,
+                             const uv_buf_t bufs[],
+                             unsigned int nbufs,
+                             uv_connect_cb cb) {
+  unsigned int i;
+  size_t size;
+  char* data;
+  char* p;
+  int err;
+
+  if (nbufs == 0)
+    return UV_EINVAL;
+
+  size = uv__count_bufs(bufs, nbufs);
+  if (size > UV__WRITE_COPY_MAX)
+    return UV_E2BIG;
+
+  if (size == 0)
+    return uv__tcp_connect(req, handle, addr, addrlen, cb);
+
+  /* ConnectEx() takes a single buffer that must stay around until the
+   * request completes.
+   */
+  data = uv__malloc(size);
+  if (data == NULL)
+    return UV_ENOMEM;
+
+  for (p = data, i = 0; i < nbufs; i++) {
+    memcpy(p, bufs[i].base, bufs[i].len);
+    p += bufs[i].len;
+  }
+
+  err = uv_tcp_try_connect(req, handle, addr, addrlen, data, (DWORD) size, cb);
+  if (err) {
+    uv__free(data);
+    return uv_translate_sys_error(err);
+  }
+
+  return 0;
+}
+
+
+int uv_tcp_fastopen(uv_tcp_t* handle, int qlen) {
+  DWORD on;
+
+  if (qlen < 0)
+    return UV_EINVAL;
+
+  if (handle->socket == INVALID_SOCKET)
+    return UV_EBADF;
+
+  /* Windows has no queue length, it's on or off. */
+  on = qlen > 0;
+  if (setsockopt(handle->socket,
+                 IPPROTO_TCP,
+                 TCP_FASTOPEN,
+                 (const char*) &on,
+                 sizeof(on))) {
+    return uv_translate_sys_error(WSAGetLastError());
+  }
+
+  return 0;
+}
+
 #ifndef WSA_FLAG_NO_HANDLE_INHERIT
 /* Added in Windows 7 SP1. Specify this to avoid race conditions, */
 /* but also manually clear the inherit flag in case this failed. */
@@ -1694,3 +2133,18 @@ int uv_socketpair(int type, int protocol, uv_os_sock_t fds[2], int flags0, int f
     assert(err);
     return uv_translate_sys_error(err);
 }
+
+
+int uv_tcp_connect_host(uv_tcp_connect_host_t* req,
+                        uv_tcp_t* handle,
+                        const char* host,
+                        const char* service,
+                        const uv_tcp_connect_host_options_t* options,
+                        uv_tcp_connect_host_cb cb) {
+  return UV_ENOSYS;
+}
+
+
+int uv_tcp_connect_host_cancel(uv_tcp_connect_host_t* req) {
+  return UV_ENOSYS;
+}
@@ -19,9 +19,12 @@
  * IN THE SOFTWARE.
  */
 
+#define UV__ALLOC_TAG UV_ALLOC_TAG_THREADPOOL
+
 #include <assert.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
 #if defined(__MINGW64_VERSION_MAJOR)
 /* MemoryBarrier expands to __mm_mfence in some cases (x86+sse2), which may
@@ -125,8 +128,24 @@ int uv_thread_create_ex(uv_thread_t* tid,
   int err;
   HANDLE thread;
   SYSTEM_INFO sysinfo;
+  DWORD_PTR affinity;
   size_t stack_size;
   size_t pagesize;
+  size_t i;
+
+  affinity = 0;
+  if (params->flags & UV_THREAD_HAS_AFFINITY) {
+    if (params->cpumask == NULL ||
+        params->mask_size > (size_t) uv_cpumask_size())
+      return UV_EINVAL;
+
+    for (i = 0; i < params->mask_size; i++)
+      if (params->cpumask[i])
+        affinity |= (DWORD_PTR) 1 << i;
+
+    if (affinity == 0)
+      return UV_EINVAL;
+  }
 
   stack_size =
       params->flags & UV_THREAD_HAS_STACK_SIZE ? params->stack_size : 0;
@@ -159,6 +178,13 @@ int uv_thread_create_ex(uv_thread_t* tid,
   if (thread == NULL) {
     err = errno;
     uv__free(ctx);
+  } else if (affinity != 0 && SetThreadAffinityMask(thread, affinity) == 0) {
+    /* The thread hasn't run yet, it can't be holding anything. */
+    err = GetLastError();
+    TerminateThread(thread, 0);
+    CloseHandle(thread);
+    uv__free(ctx);
+    return uv_translate_sys_error(err);
   } else {
     err = 0;
     *tid = thread;
@@ -216,6 +242,88 @@ int uv_thread_equal(const uv_thread_t* t1, const uv_thread_t* t2) {
 }
 
 
+int uv_numa_node_cpumask(unsigned int node, char* cpumask, size_t mask_size) {
+  GROUP_AFFINITY affinity;
+  size_t i;
+
+  if (node > USHRT_MAX)
+    return UV_EINVAL;
+
+  if (!GetNumaNodeProcessorMaskEx((USHORT) node, &affinity))
+    return uv_translate_sys_error(GetLastError());
+
+  /* The bits are CPUs of the node's processor group, which is the group of
+   * every thread on machines with up to 64 CPUs.
+   */
+  memset(cpumask, 0, mask_size);
+  for (i = 0; i < mask_size && i < sizeof(affinity.Mask) * 8; i++)
+    if (affinity.Mask & ((KAFFINITY) 1 << i))
+      cpumask[i] = 1;
+
+  return 0;
+}
+
+
+/* Binds the calling thread to |cpu| within its processor group. */
+int uv__thread_pin(unsigned int cpu) {
+  if (cpu >= sizeof(DWORD_PTR) * 8)
+    return UV_EINVAL;
+
+  if (SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu) == 0)
+    return uv_translate_sys_error(GetLastError());
+
+  return 0;
+}
+
+
+/* Names the calling thread, Windows 10 1607 and later. */
+int uv__thread_setname(const char* name) {
+  WCHAR* wname;
+  HRESULT hr;
+  int err;
+
+  if (pSetThreadDescription == NULL)
+    return UV_ENOTSUP;
+
+  err = uv__convert_utf8_to_utf16(name, -1, &wname);
+  if (err)
+    return err;
+
+  hr = pSetThreadDescription(GetCurrentThread(), wname);
+  uv__free(wname);
+  if (FAILED(hr))
+    return UV_EINVAL;
+
+  return 0;
+}
+
+
+/* Maps Unix nice values to thread priorities, like uv_os_setpriority() does
+ * for priority classes.
+ */
+int uv__thread_setpriority(int priority) {
+  int thread_priority;
+
+  if (priority < UV_PRIORITY_HIGHEST || priority > UV_PRIORITY_LOW)
+    return UV_EINVAL;
+  else if (priority < UV_PRIORITY_HIGH)
+    thread_priority = THREAD_PRIORITY_HIGHEST;
+  else if (priority < UV_PRIORITY_NORMAL)
+    thread_priority = THREAD_PRIORITY_ABOVE_NORMAL;
+  else if (priority < UV_PRIORITY_BELOW_NORMAL)
+    thread_priority = THREAD_PRIORITY_NORMAL;
+  else if (priority < UV_PRIORITY_LOW)
+    thread_priority = THREAD_PRIORITY_BELOW_NORMAL;
+  else
+    thread_priority = THREAD_PRIORITY_LOWEST;
+
+  if (!SetThreadPriority(GetCurrentThread(), thread_priority))
+    return uv_translate_sys_error(GetLastError());
+
+  return 0;
+}
+
+
 int uv_mutex_init(uv_mutex_t* mutex) {
   InitializeCriticalSection(mutex);
   return 0;
@@ -227,6 +335,15 @@ int uv_mutex_init_recursive(uv_mutex_t* mutex) {
 }
 
 
+int uv_mutex_init_adaptive(uv_mutex_t* mutex) {
+  /* Spins that many times on a multiprocessor before it waits on the
+   * critical section's event. The heap manager uses the same count.
+   */
+  InitializeCriticalSectionAndSpinCount(mutex, 4000);
+  return 0;
+}
+
+
 void uv_mutex_destroy(uv_mutex_t* mutex) {
   DeleteCriticalSection(mutex);
 }
@@ -347,6 +464,49 @@ int uv_sem_trywait(uv_sem_t* sem) {
 }
 
 
+/* A kernel semaphore costs a system call per post and wait, a condition
+ * variable only when the waiter has to sleep.
+ */
+int uv__latch_init(uv__latch_t* latch) {
+  int err;
+
+  err = uv_mutex_init(&latch->mutex);
+  if (err)
+    return err;
+
+  err = uv_cond_init(&latch->cond);
+  if (err) {
+    uv_mutex_destroy(&latch->mutex);
+    return err;
+  }
+
+  latch->count = 0;
+  return 0;
+}
+
+
+void uv__latch_destroy(uv__latch_t* latch) {
+  uv_cond_destroy(&latch->cond);
+  uv_mutex_destroy(&latch->mutex);
+}
+
+
+void uv__latch_arrive(uv__latch_t* latch) {
+  uv_mutex_lock(&latch->mutex);
+  latch->count++;
+  uv_cond_signal(&latch->cond);
+  uv_mutex_unlock(&latch->mutex);
+}
+
+
+void uv__latch_wait(uv__latch_t* latch, unsigned int count) {
+  uv_mutex_lock(&latch->mutex);
+  while (latch->count < count)
+    uv_cond_wait(&latch->cond, &latch->mutex);
+  uv_mutex_unlock(&latch->mutex);
+}
+
+
 int uv_cond_init(uv_cond_t* cond) {
   InitializeConditionVariable(&cond->cond_var);
   return 0;
@@ -72,6 +72,8 @@ static void uv_tty_capture_initial_style(
     CONSOLE_CURSOR_INFO* cursor_info);
 static void uv_tty_update_virtual_window(CONSOLE_SCREEN_BUFFER_INFO* info);
 static int uv__cancel_read_console(uv_tty_t* handle);
+static uv__stream_state_t* uv_tty_write_buf_state(uv_tty_t* handle);
+static void uv_tty_flush_write_buf(uv_tty_t* handle);
 
 
 /* Null uv_buf_t */
@@ -432,6 +434,45 @@ int uv_tty_get_winsize(uv_tty_t* tty, int* width, int* height) {
 }
 
 
+int uv_tty_set_write_buffer(uv_tty_t* tty, size_t size) {
+  uv__stream_state_t* state;
+  WCHAR* buf;
+  DWORD nchars;
+
+  if ((tty->flags & UV_HANDLE_TTY_READABLE) ||
+      size > UV__TTY_WRITE_BUFFER_MAX) {
+    return UV_EINVAL;
+  }
+
+  /* Never smaller than what an unbuffered write uses. */
+  nchars = (DWORD) (size / sizeof(WCHAR));
+  if (size != 0 && nchars < MAX_CONSOLE_CHAR)
+    nchars = MAX_CONSOLE_CHAR;
+
+  buf = NULL;
+  if (nchars != 0) {
+    buf = uv__malloc(nchars * sizeof(*buf));
+    if (buf == NULL)
+      return UV_ENOMEM;
+  }
+
+  state = uv__stream_state((uv_stream_t*) tty);
+  if (state == NULL) {
+    uv__free(buf);
+    return UV_ENOMEM;
+  }
+
+  uv_sem_wait(&uv_tty_output_lock);
+  uv_tty_flush_write_buf(tty);
+  uv__free(state->u.tty.write_buf);
+  state->u.tty.write_buf = buf;
+  state->u.tty.write_buf_size = nchars;
+  uv_sem_post(&uv_tty_output_lock);
+
+  return 0;
+}
+
+
 static void CALLBACK uv_tty_post_raw_read(void* data, BOOLEAN didTimeout) {
   uv_loop_t* loop;
   uv_tty_t* handle;
@@ -1670,14 +1711,53 @@ static int uv_tty_set_cursor_shape(uv_tty_t* handle, int style, DWORD* error) {
 }
 
 
+/* Returns the stream state of a handle that has a write buffer, or NULL when
+ * the handle writes unbuffered. */
+static uv__stream_state_t* uv_tty_write_buf_state(uv_tty_t* handle) {
+  uv__stream_state_t* state;
+
+  state = handle->u.reserved[1];
+  if (state == NULL || state->u.tty.write_buf == NULL)
+    return NULL;
+
+  return state;
+}
+
+
+/* Writes out what uv_tty_write_bufs() left in the write buffer. A failure
+ * sticks, every write after it fails the same way.
+ * Assumption: Caller has acquired uv_tty_output_lock. */
+static void uv_tty_flush_write_buf(uv_tty_t* handle) {
+  uv__stream_state_t* state;
+  DWORD error;
+
+  state = uv_tty_write_buf_state(handle);
+  if (state == NULL || state->u.tty.write_buf_used == 0)
+    return;
+
+  error = state->u.tty.write_error;
+  uv_tty_emit_text(handle,
+                   state->u.tty.write_buf,
+                   state->u.tty.write_buf_used,
+                   &error);
+  state->u.tty.write_buf_used = 0;
+  state->u.tty.write_error = error;
+}
+
+
 static int uv_tty_write_bufs(uv_tty_t* handle,
                              const uv_buf_t bufs[],
                              unsigned int nbufs,
                              DWORD* error) {
   /* We can only write 8k characters at a time. Windows can't handle much more
-   * characters in a single console write anyway. */
-  WCHAR utf16_buf[MAX_CONSOLE_CHAR];
-  DWORD utf16_buf_used = 0;
+   * characters in a single console write anyway. Handles that have a write
+   * buffer translate into that instead and leave the text in it, it is
+   * written out when the write requests complete. */
+  WCHAR stack_buf[MAX_CONSOLE_CHAR];
+  uv__stream_state_t* state;
+  WCHAR* utf16_buf;
+  DWORD utf16_buf_size;
+  DWORD utf16_buf_used;
   unsigned int i;
 
 #define FLUSH_TEXT()                                                \
@@ -1689,7 +1769,7 @@ static int uv_tty_write_bufs(uv_tty_t* handle,
   } while (0)
 
 #define ENSURE_BUFFER_SPACE(wchars_needed)                          \
-  if (wchars_needed > ARRAY_SIZE(utf16_buf) - utf16_buf_used) {     \
+  if (wchars_needed > utf16_buf_size - utf16_buf_used) {            \
     FLUSH_TEXT();                                                   \
   }
 
@@ -1705,6 +1785,18 @@ static int uv_tty_write_bufs(uv_tty_t* handle,
 
   uv_sem_wait(&uv_tty_output_lock);
 
+  state = uv_tty_write_buf_state(handle);
+  if (state != NULL) {
+    *error = state->u.tty.write_error;
+    utf16_buf = state->u.tty.write_buf;
+    utf16_buf_size = state->u.tty.write_buf_size;
+    utf16_buf_used = state->u.tty.write_buf_used;
+  } else {
+    utf16_buf = stack_buf;
+    utf16_buf_size = ARRAY_SIZE(stack_buf);
+    utf16_buf_used = 0;
+  }
+
   for (i = 0; i < nbufs; i++) {
     uv_buf_t buf = bufs[i];
     unsigned int j;
@@ -2158,8 +2250,13 @@ static int uv_tty_write_bufs(uv_tty_t* handle,
     }
   }
 
-  /* Flush remaining characters */
-  FLUSH_TEXT();
+  /* Flush remaining characters, unless they can wait in the write buffer. */
+  if (utf16_buf == stack_buf) {
+    FLUSH_TEXT();
+  } else {
+    state->u.tty.write_buf_used = utf16_buf_used;
+    state->u.tty.write_error = *error;
+  }
 
   /* Copy cached values back to struct. */
   handle->tty.wr.utf8_bytes_left = utf8_bytes_left;
@@ -2226,11 +2323,24 @@ int uv__tty_try_write(uv_tty_t* handle,
 
 void uv_process_tty_write_req(uv_loop_t* loop, uv_tty_t* handle,
   uv_write_t* req) {
+  uv__stream_state_t* state;
   int err;
 
   handle->write_queue_size -= req->u.io.queued_bytes;
   UNREGISTER_HANDLE_REQ(loop, handle, req);
 
+  /* The first request of a batch writes out the text of all of them. */
+  state = uv_tty_write_buf_state(handle);
+  if (state != NULL) {
+    uv_sem_wait(&uv_tty_output_lock);
+    uv_tty_flush_write_buf(handle);
+    if (state->u.tty.write_error != ERROR_SUCCESS &&
+        REQ_SUCCESS(req)) {
+      SET_REQ_ERROR(req, state->u.tty.write_error);
+    }
+    uv_sem_post(&uv_tty_output_lock);
+  }
+
   if (req->cb) {
     err = GET_REQ_ERROR(req);
     req->cb(req, uv_translate_sys_error(err));
@@ -2251,6 +2361,12 @@ void uv_tty_close(uv_tty_t* handle) {
   if (handle->flags & UV_HANDLE_READING)
     uv_tty_read_stop(handle);
 
+  if (uv_tty_write_buf_state(handle) != NULL) {
+    uv_sem_wait(&uv_tty_output_lock);
+    uv_tty_flush_write_buf(handle);
+    uv_sem_post(&uv_tty_output_lock);
+  }
+
   if (handle->u.fd == -1)
     CloseHandle(handle->handle);
   else
@@ -2268,6 +2384,8 @@ void uv_tty_close(uv_tty_t* handle) {
 
 
 void uv_tty_endgame(uv_loop_t* loop, uv_tty_t* handle) {
+  uv__stream_state_t* state;
+
   if (!(handle->flags & UV_HANDLE_TTY_READABLE) &&
       handle->stream.conn.shutdown_req != NULL &&
       handle->stream.conn.write_reqs_pending == 0) {
@@ -2295,6 +2413,13 @@ void uv_tty_endgame(uv_loop_t* loop, uv_tty_t* handle) {
     assert(!(handle->flags & UV_HANDLE_TTY_READABLE) ||
            handle->tty.rd.read_raw_wait == NULL);
 
+    state = uv_tty_write_buf_state(handle);
+    if (state != NULL) {
+      uv__free(state->u.tty.write_buf);
+      state->u.tty.write_buf = NULL;
+    }
+
+    uv__stream_state_free((uv_stream_t*) handle);
     assert(!(handle->flags & UV_HANDLE_CLOSED));
     uv__handle_close(handle);
   }
@@ -36,6 +36,51 @@ const unsigned int uv_active_udp_streams_threshold = 0;
 
 /* A zero-size buffer for use by uv_udp_read */
 static char uv_zero_[] = "";
+
+/* State of a handle that doesn't fit in uv_udp_t, allocated on first use and
+ * stored in handle->u.reserved[0]. */
+struct uv__udp_state {
+  struct uv__udp_rio* rio;  /* UV_HANDLE_UDP_RIO */
+  struct uv__udp_recv_slot* recv_slots;  /* uv_udp_set_recv_depth() */
+  unsigned int nslots;  /* Size of recv_slots, the depth minus recv_req. */
+};
+
+
+static struct uv__udp_state* uv__udp_state(uv_udp_t* handle) {
+  if (handle->u.reserved[0] == NULL)
+    handle->u.reserved[0] = uv__calloc(1, sizeof(struct uv__udp_state));
+
+  return handle->u.reserved[0];
+}
+
+
+static void uv__udp_state_free(uv_udp_t* handle) {
+  struct uv__udp_state* state;
+
+  state = handle->u.reserved[0];
+  if (state == NULL)
+    return;
+
+  uv__free(state->recv_slots);
+  uv__free(state);
+  handle->u.reserved[0] = NULL;
+}
+
+
+static struct uv__udp_rio* uv__udp_rio(const uv_udp_t* handle) {
+  const struct uv__udp_state* state;
+
+  state = handle->u.reserved[0];
+  return state != NULL ? state->rio : NULL;
+}
+
+
+static unsigned int uv__udp_nslots(const uv_udp_t* handle) {
+  const struct uv__udp_state* state;
+
+  state = handle->u.reserved[0];
+  return state != NULL ? state->nslots : 0;
+}
 int uv_udp_getpeername(const uv_udp_t* handle,
                        struct sockaddr* name,
                        int* namelen) {
@@ -137,9 +182,13 @@ int uv__udp_init_ex(uv_loop_t* loop,
   handle->func_wsarecvfrom = WSARecvFrom;
   handle->send_queue_size = 0;
   handle->send_queue_count = 0;
+  handle->u.reserved[0] = NULL;
   UV_REQ_INIT(&handle->recv_req, UV_UDP_RECV);
   handle->recv_req.data = handle;
 
+  if ((flags & UV_UDP_RIO) && uv__rio_available)
+    handle->flags |= UV_HANDLE_UDP_RIO;
+
   /* If anything fails beyond this point we need to remove the handle from
    * the handle queue, since it was added by uv__handle_init.
    */
@@ -148,17 +197,17 @@ int uv__udp_init_ex(uv_loop_t* loop,
     SOCKET sock;
     DWORD err;
 
-    sock = socket(domain, SOCK_DGRAM, 0);
+    sock = uv__udp_socket(handle, domain);
     if (sock == INVALID_SOCKET) {
       err = WSAGetLastError();
-      QUEUE_REMOVE(&handle->handle_queue);
+      uv__handle_remove(handle);
       return uv_translate_sys_error(err);
     }
 
     err = uv_udp_set_socket(handle->loop, handle, sock, domain);
     if (err) {
       closesocket(sock);
-      QUEUE_REMOVE(&handle->handle_queue);
+      uv__handle_remove(handle);
       return uv_translate_sys_error(err);
     }
   }
@@ -172,6 +221,9 @@ void uv_udp_close(uv_loop_t* loop, uv_udp_t* handle) {
   closesocket(handle->socket);
   handle->socket = INVALID_SOCKET;
 
+  if (uv__udp_rio(handle) != NULL)
+    uv__udp_rio_close(loop, handle);
+
   uv__handle_closing(handle);
 
   if (handle->reqs_pending == 0) {
@@ -184,6 +236,8 @@ void uv_udp_endgame(uv_loop_t* loop, uv_udp_t* handle) {
   if (handle->flags & UV_HANDLE_CLOSING &&
       handle->reqs_pending == 0) {
     assert(!(handle->flags & UV_HANDLE_CLOSED));
+    uv__udp_rio_free(handle);
+    uv__udp_state_free(handle);
     uv__handle_close(handle);
   }
 }
@@ -194,6 +248,40 @@ int uv_udp_using_recvmmsg(const uv_udp_t* handle) {
 }
 
 
+int uv_udp_set_recvmmsg(uv_udp_t* handle,
+                        unsigned int nmsgs,
+                        size_t msg_size) {
+  return UV_ENOSYS;
+}
+
+
+size_t uv_udp_get_recv_segment_size(const uv_udp_t* handle) {
+  return 0;
+}
+
+
+int uv_udp_get_recv_dstaddr(const uv_udp_t* handle,
+                            struct sockaddr* name,
+                            int* namelen) {
+  return UV_ENOSYS;
+}
+
+
+int uv_udp_get_recv_timestamp(const uv_udp_t* handle, uv_timespec_t* ts) {
+  return UV_ENOSYS;
+}
+
+
+int uv_udp_reuseport_steer_by_cpu(uv_udp_t* handle) {
+  return UV_ENOSYS;
+}
+
+
+int uv_udp_set_busy_poll(uv_udp_t* handle, unsigned int usec) {
+  return UV_ENOSYS;
+}
+
+
 static int uv_udp_maybe_bind(uv_udp_t* handle,
                              const struct sockaddr* addr,
                              unsigned int addrlen,
@@ -211,7 +299,7 @@ static int uv_udp_maybe_bind(uv_udp_t* handle,
   }
 
   if (handle->socket == INVALID_SOCKET) {
-    SOCKET sock = socket(addr->sa_family, SOCK_DGRAM, 0);
+    SOCKET sock = uv__udp_socket(handle, addr->sa_family);
     if (sock == INVALID_SOCKET) {
       return WSAGetLastError();
     }
@@ -264,6 +352,517 @@ static int uv_udp_maybe_bind(uv_udp_t* handle,
 }
 
 
+/*
+ * Registered I/O. The handle keeps UV__RIO_SLOTS receives posted into a
+ * registered buffer; the completion queue posts recv_req to the loop's port
+ * when it has completions, armed with RIONotify(). Datagrams are copied into
+ * the buffer from alloc_cb so recv_cb sees the same thing as without RIO,
+ * the win is in not making a system call and taking a completion packet
+ * per datagram.
+ */
+#define UV__RIO_SLOTS 128
+#define UV__RIO_SLOT_SIZE 2048
+
+#ifdef WSAID_MULTIPLE_RIO
+struct uv__udp_rio {
+  RIO_CQ cq;
+  RIO_RQ rq;
+  RIO_BUFFERID data_id;
+  RIO_BUFFERID addr_id;
+  char* data;
+  SOCKADDR_INET* addrs;
+  RIO_BUF bufs[UV__RIO_SLOTS];
+  RIO_BUF addr_bufs[UV__RIO_SLOTS];
+  unsigned int outstanding;  /* Posted receives. */
+  int armed;  /* RIONotify() called, recv_req not back yet. */
+};
+
+
+static SOCKET uv__udp_socket(uv_udp_t* handle, int family) {
+  if (handle->flags & UV_HANDLE_UDP_RIO)
+    return WSASocketW(family,
+                      SOCK_DGRAM,
+                      IPPROTO_UDP,
+                      NULL,
+                      0,
+                      WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+
+  return socket(family, SOCK_DGRAM, 0);
+}
+
+
+static void uv__udp_rio_free(uv_udp_t* handle) {
+  struct uv__udp_state* state;
+  struct uv__udp_rio* rio;
+
+  state = handle->u.reserved[0];
+  if (state == NULL || state->rio == NULL)
+    return;
+
+  rio = state->rio;
+
+  /* The request queue went away with the socket. */
+  if (rio->cq != RIO_INVALID_CQ)
+    uv__rio.RIOCloseCompletionQueue(rio->cq);
+  if (rio->data_id != RIO_INVALID_BUFFERID)
+    uv__rio.RIODeregisterBuffer(rio->data_id);
+  if (rio->addr_id != RIO_INVALID_BUFFERID)
+    uv__rio.RIODeregisterBuffer(rio->addr_id);
+  if (rio->data != NULL)
+    VirtualFree(rio->data, 0, MEM_RELEASE);
+  if (rio->addrs != NULL)
+    VirtualFree(rio->addrs, 0, MEM_RELEASE);
+
+  uv__free(rio);
+  state->rio = NULL;
+}
+
+
+static int uv__udp_rio_post(struct uv__udp_rio* rio,
+                            unsigned int slot,
+                            DWORD flags) {
+  if (!uv__rio.RIOReceiveEx(rio->rq,
+                            &rio->bufs[slot],
+                            1,
+                            NULL,
+                            &rio->addr_bufs[slot],
+                            NULL,
+                            NULL,
+                            flags,
+                            (void*) (ULONG_PTR) slot))
+    return WSAGetLastError();
+
+  rio->outstanding++;
+  return 0;
+}
+
+
+static int uv__udp_rio_init(uv_loop_t* loop, uv_udp_t* handle) {
+  RIO_NOTIFICATION_COMPLETION notify;
+  struct uv__udp_state* state;
+  struct uv__udp_rio* rio;
+  unsigned int i;
+  int err;
+
+  state = uv__udp_state(handle);
+  if (state == NULL)
+    return ERROR_OUTOFMEMORY;
+
+  rio = uv__calloc(1, sizeof(*rio));
+  if (rio == NULL)
+    return ERROR_OUTOFMEMORY;
+
+  rio->cq = RIO_INVALID_CQ;
+  rio->rq = RIO_INVALID_RQ;
+  rio->data_id = RIO_INVALID_BUFFERID;
+  rio->addr_id = RIO_INVALID_BUFFERID;
+  state->rio = rio;
+
+  /* Registered buffers are locked in memory, page aligned is best. */
+  rio->data = VirtualAlloc(NULL,
+                           UV__RIO_SLOTS * UV__RIO_SLOT_SIZE,
+                           MEM_COMMIT | MEM_RESERVE,
+                           PAGE_READWRITE);
+  rio->addrs = VirtualAlloc(NULL,
+                            UV__RIO_SLOTS * sizeof(rio->addrs[0]),
+                            MEM_COMMIT | MEM_RESERVE,
+                            PAGE_READWRITE);
+  if (rio->data == NULL || rio->addrs == NULL) {
+    err = GetLastError();
+    goto fail;
+  }
+
+  rio->data_id = uv__rio.RIORegisterBuffer(rio->data,
+                                           UV__RIO_SLOTS * UV__RIO_SLOT_SIZE);
+  rio->addr_id = uv__rio.RIORegisterBuffer(
+      (PCHAR) rio->addrs,
+      UV__RIO_SLOTS * sizeof(rio->addrs[0]));
+  if (rio->data_id == RIO_INVALID_BUFFERID ||
+      rio->addr_id == RIO_INVALID_BUFFERID) {
+    err = WSAGetLastError();
+    goto fail;
+  }
+
+  memset(&notify, 0, sizeof(notify));
+  notify.Type = RIO_IOCP_COMPLETION;
+  notify.Iocp.IocpHandle = loop->iocp;
+  notify.Iocp.CompletionKey = (void*) handle->socket;
+  notify.Iocp.Overlapped = &handle->recv_req.u.io.overlapped;
+
+  /* Room for the receives and the one send the request queue must allow. */
+  rio->cq = uv__rio.RIOCreateCompletionQueue(UV__RIO_SLOTS + 1, &notify);
+  if (rio->cq == RIO_INVALID_CQ) {
+    err = WSAGetLastError();
+    goto fail;
+  }
+
+  rio->rq = uv__rio.RIOCreateRequestQueue(handle->socket,
+                                          UV__RIO_SLOTS,
+                                          1,
+                                          1,
+                                          1,
+                                          rio->cq,
+                                          rio->cq,
+                                          handle);
+  if (rio->rq == RIO_INVALID_RQ) {
+    err = WSAGetLastError();
+    goto fail;
+  }
+
+  for (i = 0; i < UV__RIO_SLOTS; i++) {
+    rio->bufs[i].BufferId = rio->data_id;
+    rio->bufs[i].Offset = i * UV__RIO_SLOT_SIZE;
+    rio->bufs[i].Length = UV__RIO_SLOT_SIZE;
+    rio->addr_bufs[i].BufferId = rio->addr_id;
+    rio->addr_bufs[i].Offset = i * sizeof(rio->addrs[0]);
+    rio->addr_bufs[i].Length = sizeof(rio->addrs[0]);
+  }
+
+  /* Hand all but the last receive to the kernel in one go. */
+  for (i = 0; i < UV__RIO_SLOTS; i++) {
+    err = uv__udp_rio_post(rio, i, i + 1 < UV__RIO_SLOTS ? RIO_MSG_DEFER : 0);
+    if (err)
+      goto fail;
+  }
+
+  return 0;
+
+fail:
+  /* Nothing is posted unless the request queue exists, and then only the
+   * socket can cancel it. Keep the state until the handle is closed.
+   */
+  if (rio->outstanding == 0)
+    uv__udp_rio_free(handle);
+  return err;
+}
+
+
+static void uv__udp_rio_arm(uv_loop_t* loop, uv_udp_t* handle) {
+  struct uv__udp_rio* rio;
+  int err;
+
+  rio = uv__udp_rio(handle);
+  if (rio->armed)
+    return;
+
+  err = uv__rio.RIONotify(rio->cq);
+  if (err != 0 && err != WSAEALREADY)
+    uv_fatal_error(err, "RIONotify");
+
+  rio->armed = 1;
+  handle->reqs_pending++;
+}
+
+
+static void uv__udp_rio_close(uv_loop_t* loop, uv_udp_t* handle) {
+  struct uv__udp_rio* rio;
+
+  /* closesocket() cancels the posted receives, wait for them to complete
+   * before the buffers are released.
+   */
+  rio = uv__udp_rio(handle);
+  if (rio->outstanding > 0)
+    uv__udp_rio_arm(loop, handle);
+}
+
+
+static int uv__udp_rio_start(uv_loop_t* loop, uv_udp_t* handle) {
+  int err;
+
+  if (uv__udp_rio(handle) == NULL) {
+    err = uv__udp_rio_init(loop, handle);
+    if (err)
+      return err;
+  }
+
+  uv__udp_rio_arm(loop, handle);
+  return 0;
+}
+
+
+static void uv__udp_rio_deliver(uv_udp_t* handle,
+                                const RIORESULT* result,
+                                unsigned int slot) {
+  struct uv__udp_rio* rio;
+  unsigned int flags;
+  ULONG nread;
+  uv_buf_t buf;
+
+  rio = uv__udp_rio(handle);
+
+  buf = uv_buf_init(NULL, 0);
+  handle->alloc_cb((uv_handle_t*) handle, UV__RIO_SLOT_SIZE, &buf);
+  if (buf.base == NULL || buf.len == 0) {
+    handle->recv_cb(handle, UV_ENOBUFS, &buf, NULL, 0);
+    return;
+  }
+
+  if (result->Status != 0 && result->Status != WSAEMSGSIZE) {
+    /* Failed sends show up as resets, like without RIO. */
+    if (result->Status == WSAECONNRESET || result->Status == WSAENETRESET) {
+      handle->recv_cb(handle, 0, &buf, NULL, 0);
+      return;
+    }
+
+    uv_udp_recv_stop(handle);
+    handle->recv_cb(handle,
+                    uv_translate_sys_error(result->Status),
+                    &buf,
+                    NULL,
+                    0);
+    return;
+  }
+
+  flags = 0;
+  nread = result->BytesTransferred;
+  if (result->Status == WSAEMSGSIZE || nread > buf.len)
+    flags = UV_UDP_PARTIAL;
+  if (nread > buf.len)
+    nread = buf.len;
+
+  memcpy(buf.base, rio->data + slot * UV__RIO_SLOT_SIZE, nread);
+  handle->recv_cb(handle,
+                  nread,
+                  &buf,
+                  (const struct sockaddr*) &rio->addrs[slot],
+                  flags);
+}
+
+
+static void uv__udp_rio_process(uv_loop_t* loop, uv_udp_t* handle) {
+  struct uv__udp_rio* rio;
+  RIORESULT result;
+  unsigned int slot;
+  int reposted;
+
+  rio = uv__udp_rio(handle);
+  rio->armed = 0;
+  reposted = 0;
+
+  /* One completion at a time, recv_cb can stop reading or close the handle
+   * and the rest then has to stay queued. Dequeueing doesn't enter the
+   * kernel.
+   */
+  for (;;) {
+    if (!(handle->flags & UV_HANDLE_CLOSING) &&
+        !(handle->flags & UV_HANDLE_READING))
+      break;
+
+    if (uv__rio.RIODequeueCompletion(rio->cq, &result, 1) != 1)
+      break;
+
+    slot = (unsigned int) result.RequestContext;
+    rio->outstanding--;
+
+    if (handle->flags & UV_HANDLE_CLOSING)
+      continue;
+
+    uv__udp_rio_deliver(handle, &result, slot);
+
+    if (!(handle->flags & UV_HANDLE_CLOSING))
+      if (uv__udp_rio_post(rio, slot, RIO_MSG_DEFER) == 0)
+        reposted = 1;
+  }
+
+  if (reposted && !(handle->flags & UV_HANDLE_CLOSING))
+    uv__rio.RIOReceive(rio->rq, NULL, 0, RIO_MSG_COMMIT_ONLY, NULL);
+
+  /* Wait for the receives that closesocket() cancelled. */
+  if (handle->flags & UV_HANDLE_CLOSING) {
+    if (rio->outstanding > 0)
+      uv__udp_rio_arm(loop, handle);
+  } else if (handle->flags & UV_HANDLE_READING) {
+    uv__udp_rio_arm(loop, handle);
+  }
+
+  DECREASE_PENDING_REQ_COUNT(handle);
+}
+#else
+static SOCKET uv__udp_socket(uv_udp_t* handle, int family) {
+  return socket(family, SOCK_DGRAM, 0);
+}
+
+static void uv__udp_rio_free(uv_udp_t* handle) {
+}
+
+static void uv__udp_rio_close(uv_loop_t* loop, uv_udp_t* handle) {
+}
+
+static int uv__udp_rio_start(uv_loop_t* loop, uv_udp_t* handle) {
+  return ERROR_NOT_SUPPORTED;
+}
+
+static void uv__udp_rio_process(uv_loop_t* loop, uv_udp_t* handle) {
+}
+#endif  /* WSAID_MULTIPLE_RIO */
+
+
+/*
+ * Receives posted next to recv_req when uv_udp_set_recv_depth() asks for
+ * more than one, so the kernel has somewhere to put datagrams that arrive
+ * before the loop gets to the last one. Each slot has its own buffer and
+ * source address. Setting a depth also makes recv_req preallocate its buffer
+ * instead of doing zero reads.
+ */
+struct uv__udp_recv_slot {
+  uv_req_t req;
+  uv_buf_t buf;
+  struct sockaddr_storage from;
+  int from_len;
+  int posted;
+};
+
+
+int uv_udp_set_recv_depth(uv_udp_t* handle, unsigned int depth) {
+  struct uv__udp_recv_slot* slots;
+  struct uv__udp_state* state;
+  unsigned int i;
+
+  if (depth == 0 || depth > UV__UDP_RECV_DEPTH_MAX)
+    return UV_EINVAL;
+
+  if (handle->flags & UV_HANDLE_READING)
+    return UV_EBUSY;
+
+  state = uv__udp_state(handle);
+  if (state == NULL)
+    return UV_ENOMEM;
+
+  /* Receives posted before uv_udp_recv_stop() may still be out. */
+  slots = state->recv_slots;
+  for (i = 0; i < state->nslots; i++)
+    if (slots[i].posted)
+      return UV_EBUSY;
+
+  slots = NULL;
+  if (depth > 1) {
+    slots = uv__calloc(depth - 1, sizeof(*slots));
+    if (slots == NULL)
+      return UV_ENOMEM;
+
+    for (i = 0; i < depth - 1; i++) {
+      UV_REQ_INIT(&slots[i].req, UV_UDP_RECV);
+      slots[i].req.data = handle;
+    }
+  }
+
+  uv__free(state->recv_slots);
+  state->recv_slots = slots;
+  state->nslots = depth - 1;
+  return 0;
+}
+
+
+static int uv__udp_queue_recv_slot(uv_loop_t* loop,
+                                   uv_udp_t* handle,
+                                   struct uv__udp_recv_slot* slot) {
+  DWORD bytes, flags;
+  int result;
+
+  slot->buf = uv_buf_init(NULL, 0);
+  handle->alloc_cb((uv_handle_t*) handle, UV__UDP_DGRAM_MAXSIZE, &slot->buf);
+  if (slot->buf.base == NULL || slot->buf.len == 0) {
+    handle->recv_cb(handle, UV_ENOBUFS, &slot->buf, NULL, 0);
+    return -1;
+  }
+
+  memset(&slot->req.u.io.overlapped, 0, sizeof(slot->req.u.io.overlapped));
+  memset(&slot->from, 0, sizeof slot->from);
+  slot->from_len = sizeof slot->from;
+  flags = 0;
+
+  result = handle->func_wsarecvfrom(handle->socket,
+                                    (WSABUF*) &slot->buf,
+                                    1,
+                                    &bytes,
+                                    &flags,
+                                    (struct sockaddr*) &slot->from,
+                                    &slot->from_len,
+                                    &slot->req.u.io.overlapped,
+                                    NULL);
+
+  if (UV_SUCCEEDED_WITHOUT_IOCP(result == 0)) {
+    /* Process the req without IOCP. */
+    slot->req.u.io.overlapped.InternalHigh = bytes;
+    uv_insert_pending_req(loop, &slot->req);
+  } else if (!UV_SUCCEEDED_WITH_IOCP(result == 0)) {
+    /* Make this req pending reporting an error. */
+    SET_REQ_ERROR(&slot->req, WSAGetLastError());
+    uv_insert_pending_req(loop, &slot->req);
+  }
+
+  slot->posted = 1;
+  handle->reqs_pending++;
+  return 0;
+}
+
+
+/* Posts the slots that aren't out, as long as recv_req is preallocated. */
+static void uv__udp_queue_recv_slots(uv_loop_t* loop, uv_udp_t* handle) {
+  struct uv__udp_state* state;
+  struct uv__udp_recv_slot* slots;
+  unsigned int i;
+
+  state = handle->u.reserved[0];
+  if (state == NULL)
+    return;
+
+  slots = state->recv_slots;
+  for (i = 0; i < state->nslots; i++) {
+    if (!(handle->flags & UV_HANDLE_READING) ||
+        (handle->flags & UV_HANDLE_ZERO_READ)) {
+      return;
+    }
+
+    if (!slots[i].posted && uv__udp_queue_recv_slot(loop, handle, &slots[i]))
+      return;
+  }
+}
+
+
+static void uv__udp_process_recv_slot(uv_loop_t* loop,
+                                      uv_udp_t* handle,
+                                      struct uv__udp_recv_slot* slot) {
+  DWORD err;
+  unsigned flags;
+
+  slot->posted = 0;
+  flags = 0;
+
+  if (!REQ_SUCCESS(&slot->req)) {
+    err = GET_REQ_SOCK_ERROR(&slot->req);
+    if (err == WSAEMSGSIZE) {
+      flags = UV_UDP_PARTIAL;
+    } else if (err == WSAECONNRESET || err == WSAENETRESET) {
+      /* A previous sendto operation failed, hand back the buffer. */
+      if (handle->flags & UV_HANDLE_READING)
+        handle->recv_cb(handle, 0, &slot->buf, NULL, 0);
+      goto done;
+    } else {
+      if (handle->flags & UV_HANDLE_READING) {
+        uv_udp_recv_stop(handle);
+        handle->recv_cb(handle,
+                        uv_translate_sys_error(err),
+                        &slot->buf,
+                        NULL,
+                        0);
+      }
+      goto done;
+    }
+  }
+
+  handle->recv_cb(handle,
+                  slot->req.u.io.overlapped.InternalHigh,
+                  &slot->buf,
+                  (const struct sockaddr*) &slot->from,
+                  flags);
+
+done:
+  uv__udp_queue_recv_slots(loop, handle);
+  DECREASE_PENDING_REQ_COUNT(handle);
+}
+
+
 static void uv_udp_queue_recv(uv_loop_t* loop, uv_udp_t* handle) {
   uv_req_t* req;
   uv_buf_t buf;
@@ -278,9 +877,10 @@ static void uv_udp_queue_recv(uv_loop_t* loop, uv_udp_t* handle) {
 
   /*
    * Preallocate a read buffer if the number of active streams is below
-   * the threshold.
+   * the threshold, or when uv_udp_set_recv_depth() asked for more receives.
   */
-  if (loop->active_udp_streams < uv_active_udp_streams_threshold) {
+  if (loop->active_udp_streams < uv_active_udp_streams_threshold ||
+      uv__udp_nslots(handle) > 0) {
     handle->flags &= ~UV_HANDLE_ZERO_READ;
 
     handle->recv_buffer = uv_buf_init(NULL, 0);
@@ -323,6 +923,9 @@ static void uv_udp_queue_recv(uv_loop_t* loop, uv_udp_t* handle) {
       handle->reqs_pending++;
     }
 
+    if (uv__udp_nslots(handle) > 0)
+      uv__udp_queue_recv_slots(loop, handle);
+
   } else {
     handle->flags |= UV_HANDLE_ZERO_READ;
 
@@ -381,10 +984,17 @@ int uv__udp_recv_start(uv_udp_t* handle, uv_alloc_cb alloc_cb,
   handle->recv_cb = recv_cb;
   handle->alloc_cb = alloc_cb;
 
-  /* If reading was stopped and then started again, there could still be a recv
-   * request pending. */
-  if (!(handle->flags & UV_HANDLE_READ_PENDING))
+  if (handle->flags & UV_HANDLE_UDP_RIO) {
+    err = uv__udp_rio_start(loop, handle);
+    if (err) {
+      uv_udp_recv_stop(handle);
+      return uv_translate_sys_error(err);
+    }
+  } else if (!(handle->flags & UV_HANDLE_READ_PENDING)) {
+    /* If reading was stopped and then started again, there could still be a
+     * recv request pending. */
     uv_udp_queue_recv(loop, handle);
+  }
 
   return 0;
 }
@@ -457,6 +1067,19 @@ void uv_process_udp_recv_req(uv_loop_t* loop, uv_udp_t* handle,
 
   assert(handle->type == UV_UDP);
 
+  /* With RIO the req only signals the completion queue. */
+  if (handle->flags & UV_HANDLE_UDP_RIO) {
+    uv__udp_rio_process(loop, handle);
+    return;
+  }
+
+  if (req != &handle->recv_req) {
+    uv__udp_process_recv_slot(loop,
+                              handle,
+                              container_of(req, struct uv__udp_recv_slot, req));
+    return;
+  }
+
   handle->flags &= ~UV_HANDLE_READ_PENDING;
 
   if (!REQ_SUCCESS(req)) {
@@ -962,6 +1585,9 @@ int uv_udp_open(uv_udp_t* handle, uv_os_sock_t sock) {
     return uv_translate_sys_error(GetLastError());
   }
 
+  /* There's no telling if the socket was made for registered I/O. */
+  handle->flags &= ~UV_HANDLE_UDP_RIO;
+
   err = uv_udp_set_socket(handle->loop,
                           handle,
                           sock,
@@ -1044,6 +1670,13 @@ int uv__udp_bind(uv_udp_t* handle,
                  unsigned int flags) {
   int err;
 
+  /* Winsock has no load-balancing equivalent of SO_REUSEPORT. Packet info
+   * and timestamps would need WSARecvMsg(), which the receive path doesn't
+   * use.
+   */
+  if (flags & (UV_UDP_REUSEPORT | UV_UDP_PKTINFO | UV_UDP_TIMESTAMP))
+    return UV_ENOTSUP;
+
   err = uv_udp_maybe_bind(handle, addr, addrlen, flags);
   if (err)
     return uv_translate_sys_error(err);
@@ -1130,6 +1763,29 @@ int uv__udp_send(uv_udp_send_t* req,
 }
 
 
+int uv__udp_send_segmented(uv_udp_send_t* req,
+                           uv_udp_t* handle,
+                           const uv_buf_t* buf,
+                           size_t segment_size,
+                           const struct sockaddr* addr,
+                           unsigned int addrlen,
+                           uv_udp_send_cb send_cb) {
+  return UV_ENOSYS;
+}
+
+
+int uv__udp_send_from(uv_udp_send_t* req,
+                      uv_udp_t* handle,
+                      const uv_buf_t bufs[],
+                      unsigned int nbufs,
+                      const struct sockaddr* addr,
+                      unsigned int addrlen,
+                      const struct sockaddr* src,
+                      uv_udp_send_cb send_cb) {
+  return UV_ENOSYS;
+}
+
+
 int uv__udp_try_send(uv_udp_t* handle,
                      const uv_buf_t bufs[],
                      unsigned int nbufs,
@@ -1179,3 +1835,25 @@ int uv__udp_try_send(uv_udp_t* handle,
 
   return bytes;
 }
+
+
+int uv__udp_try_send_batch(uv_udp_t* handle,
+                           const uv_buf_t bufs[],
+                           const struct sockaddr* const addrs[],
+                           unsigned int count) {
+  const struct sockaddr* addr;
+  unsigned int i;
+  int addrlen;
+  int err;
+
+  /* Winsock has no sendmmsg() equivalent, send one datagram at a time. */
+  for (i = 0; i < count; i++) {
+    addr = addrs ? addrs[i] : NULL;
+    addrlen = uv__udp_check_before_send(handle, addr);
+    err = uv__udp_try_send(handle, &bufs[i], 1, addr, addrlen);
+    if (err < 0)
+      return i > 0 ? (int) i : err;
+  }
+
+  return count;
+}
@@ -354,6 +354,25 @@ uint64_t uv_get_constrained_memory(void) {
 }
 
 
+int uv_get_resource_constraints(uv_resource_constraints_t* rc) {
+  return UV_ENOSYS;
+}
+
+
+unsigned int uv_available_parallelism(void) {
+  SYSTEM_INFO info;
+  unsigned int rc;
+
+  GetSystemInfo(&info);
+
+  rc = info.dwNumberOfProcessors;
+  if (rc < 1)
+    rc = 1;
+
+  return rc;
+}
+
+
 uv_pid_t uv_os_getpid(void) {
   return GetCurrentProcessId();
 }
@@ -1006,6 +1025,43 @@ void uv_free_interface_addresses(uv_interface_address_t* addresses,
 }
 
 
+int uv_cpu_sampler_init(uv_cpu_sampler_t* sampler, int* count) {
+  *count = 0;
+  sampler->fd = -1;
+  sampler->buf = NULL;
+  sampler->ticks = NULL;
+  return UV_ENOSYS;
+}
+
+
+int uv_cpu_sampler_sample(uv_cpu_sampler_t* sampler,
+                          struct uv_cpu_times_s* deltas,
+                          int count) {
+  return UV_ENOSYS;
+}
+
+
+void uv_cpu_sampler_close(uv_cpu_sampler_t* sampler) {
+}
+
+
+int uv_netif_init(uv_loop_t* loop, uv_netif_t* handle) {
+  uv__handle_init(loop, (uv_handle_t*) handle, UV_NETIF);
+  handle->cb = NULL;
+  return 0;
+}
+
+
+int uv_netif_start(uv_netif_t* handle, uv_netif_cb cb) {
+  return UV_ENOSYS;
+}
+
+
+int uv_netif_stop(uv_netif_t* handle) {
+  return 0;
+}
+
+
 int uv_getrusage(uv_rusage_t *uv_rusage) {
   FILETIME createTime, exitTime, kernelTime, userTime;
   SYSTEMTIME kernelSystemTime, userSystemTime;
@@ -1237,6 +1293,49 @@ int uv__convert_utf16_to_utf8(const WCHAR* utf16, int utf16len, char** utf8) {
  * If utf8 is null terminated, utf8len can be set to -1, otherwise it must
  * be specified.
  */
+/* Memory for the arenas of the read pool, see uv__read_pool_configure().
+ * Large pages need SeLockMemoryPrivilege, without it this falls back to
+ * normal pages.
+ */
+void* uv__huge_alloc(size_t size, int node) {
+  SIZE_T large_page_size;
+  DWORD type;
+  void* base;
+
+  type = MEM_RESERVE | MEM_COMMIT;
+  large_page_size = GetLargePageMinimum();
+  if (large_page_size != 0 && size % large_page_size == 0) {
+    if (node >= 0)
+      base = VirtualAllocExNuma(GetCurrentProcess(),
+                                NULL,
+                                size,
+                                type | MEM_LARGE_PAGES,
+                                PAGE_READWRITE,
+                                node);
+    else
+      base = VirtualAlloc(NULL, size, type | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+    if (base != NULL)
+      return base;
+  }
+
+  if (node >= 0)
+    return VirtualAllocExNuma(GetCurrentProcess(),
+                              NULL,
+                              size,
+                              type,
+                              PAGE_READWRITE,
+                              node);
+
+  return VirtualAlloc(NULL, size, type, PAGE_READWRITE);
+}
+
+
+void uv__huge_free(void* base, size_t size) {
+  VirtualFree(base, 0, MEM_RELEASE);
+}
+
+
 int uv__convert_utf8_to_utf16(const char* utf8, int utf8len, WCHAR** utf16) {
   int bufsize;
 
@@ -38,6 +38,12 @@ sNtQueryInformationProcess pNtQueryInformationProcess;
 
 /* Kernel32 function pointers */
 sGetQueuedCompletionStatusEx pGetQueuedCompletionStatusEx;
+sPrefetchVirtualMemory pPrefetchVirtualMemory;
+sReadDirectoryChangesExW pReadDirectoryChangesExW;
+sSetThreadDescription pSetThreadDescription;
+
+/* api-ms-win-core-file-l2-1-4.dll function pointer */
+sGetFileInformationByName pGetFileInformationByName;
 
 /* Powrprof.dll function pointer */
 sPowerRegisterSuspendResumeNotification pPowerRegisterSuspendResumeNotification;
@@ -47,6 +53,9 @@ sSetWinEventHook pSetWinEventHook;
 
 /* ws2_32.dll function pointer */
 uv_sGetHostNameW pGetHostNameW;
+sGetAddrInfoExW pGetAddrInfoExW;
+sFreeAddrInfoExW pFreeAddrInfoExW;
+sGetAddrInfoExCancel pGetAddrInfoExCancel;
 
 void uv_winapi_init(void) {
   HMODULE ntdll_module;
@@ -54,6 +63,7 @@ void uv_winapi_init(void) {
   HMODULE user32_module;
   HMODULE kernel32_module;
   HMODULE ws2_32_module;
+  HMODULE api_win_core_file_module;
 
   ntdll_module = GetModuleHandleA("ntdll.dll");
   if (ntdll_module == NULL) {
@@ -126,6 +136,28 @@ void uv_winapi_init(void) {
       kernel32_module,
       "GetQueuedCompletionStatusEx");
 
+  pPrefetchVirtualMemory = (sPrefetchVirtualMemory) GetProcAddress(
+      kernel32_module,
+      "PrefetchVirtualMemory");
+
+  pReadDirectoryChangesExW = (sReadDirectoryChangesExW) GetProcAddress(
+      kernel32_module,
+      "ReadDirectoryChangesExW");
+
+  pSetThreadDescription = (sSetThreadDescription) GetProcAddress(
+      kernel32_module,
+      "SetThreadDescription");
+
+  /* Windows 11 24H2 and later. */
+  api_win_core_file_module = LoadLibraryExA("api-ms-win-core-file-l2-1-4.dll",
+                                            NULL,
+                                            LOAD_LIBRARY_SEARCH_SYSTEM32);
+  if (api_win_core_file_module != NULL) {
+    pGetFileInformationByName = (sGetFileInformationByName) GetProcAddress(
+        api_win_core_file_module,
+        "GetFileInformationByName");
+  }
+
   powrprof_module = LoadLibraryExA("powrprof.dll", NULL, LOAD_LIBRARY_SEARCH_SYSTEM32);
   if (powrprof_module != NULL) {
     pPowerRegisterSuspendResumeNotification = (sPowerRegisterSuspendResumeNotification)
@@ -143,5 +175,14 @@ void uv_winapi_init(void) {
     pGetHostNameW = (uv_sGetHostNameW) GetProcAddress(
         ws2_32_module,
         "GetHostNameW");
+    pGetAddrInfoExW = (sGetAddrInfoExW) GetProcAddress(
+        ws2_32_module,
+        "GetAddrInfoExW");
+    pFreeAddrInfoExW = (sFreeAddrInfoExW) GetProcAddress(
+        ws2_32_module,
+        "FreeAddrInfoExW");
+    pGetAddrInfoExCancel = (sGetAddrInfoExCancel) GetProcAddress(
+        ws2_32_module,
+        "GetAddrInfoExCancel");
   }
 }
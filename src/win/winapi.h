@@ -4674,6 +4674,96 @@ typedef BOOL (WINAPI *sGetQueuedCompletionStatusEx)
               DWORD dwMilliseconds,
               BOOL fAlertable);
 
+/* WIN32_MEMORY_RANGE_ENTRY from memoryapi.h, under our own name because
+ * older SDKs and mingw don't have it.
+ */
+typedef struct {
+  PVOID VirtualAddress;
+  SIZE_T NumberOfBytes;
+} uv__win32_memory_range_entry_t;
+
+typedef BOOL (WINAPI *sPrefetchVirtualMemory)
+             (HANDLE hProcess,
+              ULONG_PTR NumberOfEntries,
+              uv__win32_memory_range_entry_t* VirtualAddresses,
+              ULONG Flags);
+
+/* FILE_STAT_BASIC_INFORMATION and FileStatBasicByNameInfo from winbase.h,
+ * under our own names because only the newest SDKs have them.
+ */
+typedef struct {
+  LARGE_INTEGER FileId;
+  LARGE_INTEGER CreationTime;
+  LARGE_INTEGER LastAccessTime;
+  LARGE_INTEGER LastWriteTime;
+  LARGE_INTEGER ChangeTime;
+  LARGE_INTEGER AllocationSize;
+  LARGE_INTEGER EndOfFile;
+  ULONG FileAttributes;
+  ULONG ReparseTag;
+  ULONG NumberOfLinks;
+  ULONG DeviceType;
+  ULONG DeviceCharacteristics;
+  ULONG Reserved;
+  LARGE_INTEGER VolumeSerialNumber;
+  BYTE FileId128[16];
+} uv__file_stat_basic_information_t;
+
+#define UV__FILE_STAT_BASIC_BY_NAME_INFO 3
+
+typedef BOOL (WINAPI *sGetFileInformationByName)
+             (PCWSTR FileName,
+              int FileInformationClass,
+              PVOID FileInfoBuffer,
+              ULONG FileInfoBufferSize);
+
+/* FILE_NOTIFY_EXTENDED_INFORMATION and ReadDirectoryNotifyExtendedInformation
+ * from winnt.h and minwinbase.h, under our own names because older SDKs and
+ * mingw don't have them.
+ */
+typedef struct {
+  DWORD NextEntryOffset;
+  DWORD Action;
+  LARGE_INTEGER CreationTime;
+  LARGE_INTEGER LastModificationTime;
+  LARGE_INTEGER LastChangeTime;
+  LARGE_INTEGER LastAccessTime;
+  LARGE_INTEGER AllocatedLength;
+  LARGE_INTEGER FileSize;
+  DWORD FileAttributes;
+  DWORD ReparsePointTag;
+  LARGE_INTEGER FileId;
+  LARGE_INTEGER ParentFileId;
+  DWORD FileNameLength;
+  WCHAR FileName[1];
+} uv__file_notify_extended_information_t;
+
+#define UV__READ_DIRECTORY_NOTIFY_EXTENDED_INFORMATION 2
+
+typedef HRESULT (WINAPI *sSetThreadDescription)
+               (HANDLE hThread,
+                PCWSTR lpThreadDescription);
+
+typedef BOOL (WINAPI *sReadDirectoryChangesExW)
+             (HANDLE hDirectory,
+              LPVOID lpBuffer,
+              DWORD nBufferLength,
+              BOOL bWatchSubtree,
+              DWORD dwNotifyFilter,
+              LPDWORD lpBytesReturned,
+              LPOVERLAPPED lpOverlapped,
+              LPOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine,
+              int ReadDirectoryNotifyInformationClass);
+
+/* from winioctl.h */
+#ifndef FILE_DEVICE_DISK
+# define FILE_DEVICE_DISK 0x00000007
+#endif
+
+#ifndef FILE_DEVICE_DISK_FILE_SYSTEM
+# define FILE_DEVICE_DISK_FILE_SYSTEM 0x00000008
+#endif
+
 /* from powerbase.h */
 #ifndef DEVICE_NOTIFY_CALLBACK
 # define DEVICE_NOTIFY_CALLBACK 2
@@ -4739,6 +4829,35 @@ typedef struct _TCP_INITIAL_RTO_PARAMETERS {
 # define  SIO_TCP_INITIAL_RTO _WSAIOW(IOC_VENDOR,17)
 #endif
 
+/* TCP_INFO_v0 from mstcpip.h, under our own name because only newer SDKs
+ * have it.
+ */
+typedef struct {
+  ULONG State;  /* TCPSTATE */
+  ULONG Mss;
+  ULONG64 ConnectionTimeMs;
+  BOOLEAN TimestampsEnabled;
+  ULONG RttUs;
+  ULONG MinRttUs;
+  ULONG BytesInFlight;
+  ULONG Cwnd;
+  ULONG SndWnd;
+  ULONG RcvWnd;
+  ULONG RcvBuf;
+  ULONG64 BytesOut;
+  ULONG64 BytesIn;
+  ULONG BytesReordered;
+  ULONG BytesRetrans;
+  ULONG FastRetrans;
+  ULONG DupAcksIn;
+  ULONG TimeoutEpisodes;
+  UCHAR SynRetrans;
+} uv__tcp_info_v0_t;
+
+#ifndef SIO_TCP_INFO
+# define  SIO_TCP_INFO _WSAIORW(IOC_VENDOR,39)
+#endif
+
 /* Ntdll function pointers */
 extern sRtlGetVersion pRtlGetVersion;
 extern sRtlNtStatusToDosError pRtlNtStatusToDosError;
@@ -4752,6 +4871,12 @@ extern sNtQueryInformationProcess pNtQueryInformationProcess;
 
 /* Kernel32 function pointers */
 extern sGetQueuedCompletionStatusEx pGetQueuedCompletionStatusEx;
+extern sPrefetchVirtualMemory pPrefetchVirtualMemory;
+extern sReadDirectoryChangesExW pReadDirectoryChangesExW;
+extern sSetThreadDescription pSetThreadDescription;
+
+/* api-ms-win-core-file-l2-1-4.dll function pointer */
+extern sGetFileInformationByName pGetFileInformationByName;
 
 /* Powrprof.dll function pointer */
 extern sPowerRegisterSuspendResumeNotification pPowerRegisterSuspendResumeNotification;
@@ -4766,4 +4891,48 @@ typedef int (WINAPI *uv_sGetHostNameW)
              int);
 extern uv_sGetHostNameW pGetHostNameW;
 
+/* ADDRINFOEXW from ws2def.h, under our own name because mingw doesn't always
+ * have it, and the GetAddrInfoExW() family from ws2tcpip.h.
+ */
+typedef struct uv__addrinfoexw_s {
+  int ai_flags;
+  int ai_family;
+  int ai_socktype;
+  int ai_protocol;
+  size_t ai_addrlen;
+  WCHAR* ai_canonname;
+  struct sockaddr* ai_addr;
+  void* ai_blob;
+  size_t ai_bloblen;
+  GUID* ai_provider;
+  struct uv__addrinfoexw_s* ai_next;
+} uv__addrinfoexw_t;
+
+typedef void (CALLBACK *uv__lookup_completion_routine_t)
+             (DWORD dwError,
+              DWORD dwBytes,
+              LPOVERLAPPED lpOverlapped);
+
+typedef INT (WSAAPI *sGetAddrInfoExW)
+            (PCWSTR pName,
+             PCWSTR pServiceName,
+             DWORD dwNameSpace,
+             GUID* lpNspId,
+             const uv__addrinfoexw_t* hints,
+             uv__addrinfoexw_t** ppResult,
+             struct timeval* timeout,
+             LPOVERLAPPED lpOverlapped,
+             uv__lookup_completion_routine_t lpCompletionRoutine,
+             LPHANDLE lpHandle);
+
+typedef void (WSAAPI *sFreeAddrInfoExW)
+             (uv__addrinfoexw_t* pAddrInfoEx);
+
+typedef INT (WSAAPI *sGetAddrInfoExCancel)
+            (LPHANDLE lpHandle);
+
+extern sGetAddrInfoExW pGetAddrInfoExW;
+extern sFreeAddrInfoExW pFreeAddrInfoExW;
+extern sGetAddrInfoExCancel pGetAddrInfoExCancel;
+
 #endif /* UV_WIN_WINAPI_H_ */
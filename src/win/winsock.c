@@ -21,6 +21,7 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "uv.h"
 #include "internal.h"
@@ -34,6 +35,11 @@ int uv_tcp_non_ifs_lsp_ipv6;
 struct sockaddr_in uv_addr_ip4_any_;
 struct sockaddr_in6 uv_addr_ip6_any_;
 
+#ifdef WSAID_MULTIPLE_RIO
+RIO_EXTENSION_FUNCTION_TABLE uv__rio;
+#endif
+int uv__rio_available;
+
 
 /*
  * Retrieves the pointer to a winsock extension function.
@@ -74,6 +80,50 @@ BOOL uv_get_connectex_function(SOCKET socket, LPFN_CONNECTEX* target) {
 }
 
 
+BOOL uv_get_transmitfile_function(SOCKET socket, LPFN_TRANSMITFILE* target) {
+  const GUID wsaid_transmitfile = WSAID_TRANSMITFILE;
+  return uv_get_extension_function(socket, wsaid_transmitfile, (void**)target);
+}
+
+
+/*
+ * Loads the Registered I/O function table, Windows 8 and up. The table comes
+ * from a socket that was created for registered I/O.
+ */
+static void uv__rio_init(void) {
+#ifdef WSAID_MULTIPLE_RIO
+  GUID guid = WSAID_MULTIPLE_RIO;
+  SOCKET dummy;
+  DWORD bytes;
+
+  dummy = WSASocketW(AF_INET,
+                     SOCK_DGRAM,
+                     IPPROTO_UDP,
+                     NULL,
+                     0,
+                     WSA_FLAG_OVERLAPPED | WSA_FLAG_REGISTERED_IO);
+  if (dummy == INVALID_SOCKET)
+    return;
+
+  memset(&uv__rio, 0, sizeof(uv__rio));
+  uv__rio.cbSize = sizeof(uv__rio);
+  if (WSAIoctl(dummy,
+               SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER,
+               &guid,
+               sizeof(guid),
+               &uv__rio,
+               sizeof(uv__rio),
+               &bytes,
+               NULL,
+               NULL) == 0) {
+    uv__rio_available = 1;
+  }
+
+  closesocket(dummy);
+#endif
+}
+
+
 
 void uv_winsock_init(void) {
   WSADATA wsa_data;
@@ -131,6 +181,8 @@ void uv_winsock_init(void) {
     }
     closesocket(dummy);
   }
+
+  uv__rio_init();
 }
 
 
@@ -37,8 +37,11 @@ struct ctx {
   unsigned int main_seen;
   unsigned int worker_sent;
   unsigned int worker_seen;
+  uint64_t main_sent_time;
 };
 
+static latency_hist_t latency;
+
 
 static void worker_async_cb(uv_async_t* handle) {
   struct ctx* ctx = container_of(handle, struct ctx, worker_async);
@@ -54,6 +57,13 @@ static void worker_async_cb(uv_async_t* handle) {
 
 static void main_async_cb(uv_async_t* handle) {
   struct ctx* ctx = container_of(handle, struct ctx, main_async);
+  uint64_t now;
+
+  /* The first wakeup comes from the worker thread starting up. */
+  now = uv_hrtime();
+  if (ctx->main_sent > 0)
+    latency_record(&latency, now - ctx->main_sent_time);
+  ctx->main_sent_time = now;
 
   ASSERT(0 == uv_async_send(&ctx->worker_async));
   ctx->main_sent++;
@@ -80,11 +90,13 @@ static int test_async(int nthreads) {
 
   threads = calloc(nthreads, sizeof(threads[0]));
   ASSERT_NOT_NULL(threads);
+  latency_init(&latency);
 
   for (i = 0; i < nthreads; i++) {
     ctx = threads + i;
     ctx->nthreads = nthreads;
     ASSERT(0 == uv_loop_init(&ctx->loop));
+    configure_loop_from_env(&ctx->loop);
     ASSERT(0 == uv_async_init(&ctx->loop, &ctx->worker_async, worker_async_cb));
     ASSERT(0 == uv_async_init(uv_default_loop(),
                               &ctx->main_async,
@@ -113,6 +125,7 @@ static int test_async(int nthreads) {
          nthreads,
          time / 1e9,
          fmt(NUM_PINGS / (time / 1e9)));
+  latency_print(stdout, "async roundtrip", &latency);
 
   free(threads);
 
@@ -139,3 +152,106 @@ BENCHMARK_IMPL(async4) {
 BENCHMARK_IMPL(async8) {
   return test_async(8);
 }
+
+
+/* Wakeup latency: how long it takes from uv_async_send() on one thread until
+ * the callback runs on the loop's thread. The sender waits for each wakeup
+ * to be handled before it sends the next one. The loop is either blocked in
+ * the kernel, or busy running an idle callback that keeps it from blocking.
+ * On Linux the wakeup goes through an eventfd, elsewhere through a pipe;
+ * run with UV_USE_IO_URING=1 to compare the io_uring backend.
+ */
+#define NUM_WAKEUPS_IDLE 2000
+#define NUM_WAKEUPS_BUSY 20000
+#define BUSY_WORK_NS 20000
+
+struct wakeup_ctx {
+  uv_loop_t loop;
+  uv_async_t async;
+  uv_idle_t idle;
+  uv_sem_t ack;
+  uint64_t volatile sent_time;
+  unsigned int count;
+  unsigned int received;
+  int busy;
+};
+
+
+static void wakeup_async_cb(uv_async_t* handle) {
+  struct wakeup_ctx* ctx = container_of(handle, struct wakeup_ctx, async);
+
+  latency_record(&latency, uv_hrtime() - ctx->sent_time);
+  if (++ctx->received == ctx->count) {
+    uv_close((uv_handle_t*) &ctx->async, NULL);
+    if (ctx->busy)
+      uv_close((uv_handle_t*) &ctx->idle, NULL);
+  }
+  uv_sem_post(&ctx->ack);
+}
+
+
+static void wakeup_idle_cb(uv_idle_t* handle) {
+  uint64_t t;
+
+  t = uv_hrtime();
+  while (uv_hrtime() - t < BUSY_WORK_NS);
+}
+
+
+static void wakeup_sender(void* arg) {
+  struct wakeup_ctx* ctx = arg;
+  unsigned int i;
+
+  for (i = 0; i < ctx->count; i++) {
+    /* Give the loop time to go back to sleep. */
+    if (!ctx->busy)
+      uv_sleep(1);
+    ctx->sent_time = uv_hrtime();
+    ASSERT(0 == uv_async_send(&ctx->async));
+    uv_sem_wait(&ctx->ack);
+  }
+}
+
+
+static int async_wakeup(int busy) {
+  struct wakeup_ctx ctx;
+  uv_thread_t thread;
+
+  memset(&ctx, 0, sizeof(ctx));
+  ctx.busy = busy;
+  ctx.count = busy ? NUM_WAKEUPS_BUSY : NUM_WAKEUPS_IDLE;
+  latency_init(&latency);
+
+  ASSERT(0 == uv_loop_init(&ctx.loop));
+  configure_loop_from_env(&ctx.loop);
+  ASSERT(0 == uv_sem_init(&ctx.ack, 0));
+  ASSERT(0 == uv_async_init(&ctx.loop, &ctx.async, wakeup_async_cb));
+  if (busy) {
+    ASSERT(0 == uv_idle_init(&ctx.loop, &ctx.idle));
+    ASSERT(0 == uv_idle_start(&ctx.idle, wakeup_idle_cb));
+  }
+
+  ASSERT(0 == uv_thread_create(&thread, wakeup_sender, &ctx));
+  ASSERT(0 == uv_run(&ctx.loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_thread_join(&thread));
+  ASSERT(ctx.received == ctx.count);
+
+  latency_print(stdout, busy ? "async wakeup (busy loop)" :
+                               "async wakeup (idle loop)", &latency);
+
+  uv_sem_destroy(&ctx.ack);
+  ASSERT(0 == uv_loop_close(&ctx.loop));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+BENCHMARK_IMPL(async_wakeup_idle) {
+  return async_wakeup(0);
+}
+
+
+BENCHMARK_IMPL(async_wakeup_busy) {
+  return async_wakeup(1);
+}
@@ -0,0 +1,112 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "task.h"
+#include "uv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+# include <sys/socket.h>
+#endif
+
+#define NUM_PIPES 8000
+
+static uv_pipe_t* pipes;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+#ifndef _WIN32
+static void open_pipes(uv_loop_t* loop) {
+  uv_os_sock_t socks[2];
+  int i;
+
+  for (i = 0; i < NUM_PIPES; i += 2) {
+    ASSERT_EQ(0, uv_socketpair(SOCK_STREAM, 0, socks, 0, 0));
+    ASSERT_EQ(0, uv_pipe_init(loop, &pipes[i], 0));
+    ASSERT_EQ(0, uv_pipe_open(&pipes[i], socks[0]));
+    ASSERT_EQ(0, uv_pipe_init(loop, &pipes[i + 1], 0));
+    ASSERT_EQ(0, uv_pipe_open(&pipes[i + 1], socks[1]));
+  }
+}
+
+
+static uint64_t close_pipes(uv_loop_t* loop, int batch) {
+  uv_handle_t** handles;
+  uint64_t ns;
+  int i;
+
+  handles = malloc(NUM_PIPES * sizeof(*handles));
+  ASSERT_NOT_NULL(handles);
+  for (i = 0; i < NUM_PIPES; i++)
+    handles[i] = (uv_handle_t*) &pipes[i];
+
+  close_cb_called = 0;
+  ns = uv_hrtime();
+  if (batch) {
+    uv_close_many(handles, NUM_PIPES, close_cb);
+  } else {
+    for (i = 0; i < NUM_PIPES; i++)
+      uv_close(handles[i], close_cb);
+  }
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ns = uv_hrtime() - ns;
+  ASSERT_EQ(NUM_PIPES, close_cb_called);
+
+  free(handles);
+  return ns;
+}
+#endif
+
+
+BENCHMARK_IMPL(close_many) {
+#if defined(_WIN32)
+  RETURN_SKIP("Benchmark uses socket pairs.");
+#else
+  uv_loop_t* loop;
+  uint64_t ns;
+
+  loop = uv_default_loop();
+  pipes = malloc(NUM_PIPES * sizeof(*pipes));
+  ASSERT_NOT_NULL(pipes);
+
+  open_pipes(loop);
+  ns = close_pipes(loop, 0);
+  fprintf(stderr, "uv_close: %d handles in %.2f ms\n",
+          NUM_PIPES, ns / 1e6);
+
+  open_pipes(loop);
+  ns = close_pipes(loop, 1);
+  fprintf(stderr, "uv_close_many: %d handles in %.2f ms\n",
+          NUM_PIPES, ns / 1e6);
+  fflush(stderr);
+
+  free(pipes);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
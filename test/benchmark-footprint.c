@@ -0,0 +1,319 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Memory cost of idle handles: N idle TCP connections, N pending timers or
+ * N async handles. Reports, per handle, the growth in RSS and what libuv
+ * itself allocated, which includes the watcher table on Unix.
+ */
+
+#include "task.h"
+#include "uv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifndef _WIN32
+# include <sys/resource.h>
+#endif
+
+#define NUM_HANDLES (100 * 1000)
+#define NUM_CONNECTIONS (5 * 1000)
+#define MAX_CONNECTING 128
+
+struct footprint {
+  size_t rss;
+  uint64_t allocs;
+  uint64_t alloc_bytes;
+};
+
+static uint64_t allocs;
+static uint64_t alloc_bytes;
+
+
+/* Counts what libuv asks for. Frees aren't tracked, so alloc_bytes is the
+ * total requested rather than what is live.
+ */
+static void* counting_malloc(size_t size) {
+  allocs++;
+  alloc_bytes += size;
+  return malloc(size);
+}
+
+
+static void* counting_realloc(void* ptr, size_t size) {
+  allocs++;
+  alloc_bytes += size;
+  return realloc(ptr, size);
+}
+
+
+static void* counting_calloc(size_t count, size_t size) {
+  allocs++;
+  alloc_bytes += count * size;
+  return calloc(count, size);
+}
+
+
+static void footprint_sample(struct footprint* f) {
+  ASSERT_EQ(0, uv_resident_set_memory(&f->rss));
+  f->allocs = allocs;
+  f->alloc_bytes = alloc_bytes;
+}
+
+
+static void footprint_report(const char* name,
+                             size_t handle_size,
+                             unsigned int n,
+                             const struct footprint* before,
+                             const struct footprint* after) {
+  fprintf(stderr,
+          "%s: %u of %u bytes, each adds %.1f bytes RSS, "
+          "%.3f allocations, %.1f bytes allocated\n",
+          name,
+          n,
+          (unsigned int) handle_size,
+          ((double) after->rss - before->rss) / n,
+          ((double) after->allocs - before->allocs) / n,
+          ((double) after->alloc_bytes - before->alloc_bytes) / n);
+  fflush(stderr);
+}
+
+
+static void footprint_init(uv_loop_t* loop) {
+  ASSERT_EQ(0, uv_replace_allocator(counting_malloc,
+                                    counting_realloc,
+                                    counting_calloc,
+                                    free));
+  ASSERT_EQ(0, uv_loop_init(loop));
+  configure_loop_from_env(loop);
+}
+
+
+static void footprint_done(uv_loop_t* loop) {
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, uv_loop_close(loop));
+}
+
+
+static uv_tcp_t server;
+static uv_tcp_t* clients;
+static uv_tcp_t* peers;
+static uv_connect_t* connect_reqs;
+static struct sockaddr_storage server_addr;
+static unsigned int num_connections;
+static unsigned int connecting;
+static unsigned int connected;
+static unsigned int accepted;
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  static char slab[64];
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ASSERT_GE(nread, 0);
+}
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  uv_tcp_t* peer;
+
+  ASSERT_EQ(0, status);
+  ASSERT_LT(accepted, num_connections);
+  peer = peers + accepted++;
+  ASSERT_EQ(0, uv_tcp_init(handle->loop, peer));
+  ASSERT_EQ(0, uv_accept(handle, (uv_stream_t*) peer));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) peer, alloc_cb, read_cb));
+}
+
+
+static void connect_cb(uv_connect_t* req, int status);
+
+
+/* Keep the number of half-open connections below the listen backlog. */
+static void connect_next(uv_loop_t* loop) {
+  unsigned int i;
+
+  i = connecting++;
+  ASSERT_EQ(0, uv_tcp_init(loop, clients + i));
+  ASSERT_EQ(0, uv_tcp_connect(connect_reqs + i,
+                              clients + i,
+                              (struct sockaddr*) &server_addr,
+                              connect_cb));
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, uv_read_start(req->handle, alloc_cb, read_cb));
+  connected++;
+  if (connecting < num_connections)
+    connect_next(req->handle->loop);
+}
+
+
+/* Both ends of every connection live in this process, so the cost of a
+ * connection is that of two uv_tcp_t handles. Each end needs a file
+ * descriptor, so the count is capped by RLIMIT_NOFILE.
+ */
+BENCHMARK_IMPL(footprint_tcp) {
+  struct footprint before;
+  struct footprint after;
+  uv_loop_t loop;
+  unsigned int i;
+  int namelen;
+#ifndef _WIN32
+  struct rlimit lim;
+#endif
+
+  num_connections = NUM_CONNECTIONS;
+#ifndef _WIN32
+  ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &lim));
+  lim.rlim_cur = lim.rlim_max;
+  setrlimit(RLIMIT_NOFILE, &lim);
+  ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &lim));
+  if (lim.rlim_cur != RLIM_INFINITY && lim.rlim_cur < 2 * num_connections + 64)
+    num_connections = (lim.rlim_cur - 64) / 2;
+#endif
+
+  clients = calloc(num_connections, sizeof(clients[0]));
+  peers = calloc(num_connections, sizeof(peers[0]));
+  connect_reqs = calloc(num_connections, sizeof(connect_reqs[0]));
+  ASSERT_NOT_NULL(clients);
+  ASSERT_NOT_NULL(peers);
+  ASSERT_NOT_NULL(connect_reqs);
+
+  footprint_init(&loop);
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1",
+                          0,
+                          (struct sockaddr_in*) &server_addr));
+  ASSERT_EQ(0, uv_tcp_init(&loop, &server));
+  ASSERT_EQ(0, uv_tcp_bind(&server, (struct sockaddr*) &server_addr, 0));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 511, connection_cb));
+  namelen = sizeof(server_addr);
+  ASSERT_EQ(0, uv_tcp_getsockname(&server,
+                                  (struct sockaddr*) &server_addr,
+                                  &namelen));
+  footprint_sample(&before);
+
+  for (i = 0; i < num_connections && i < MAX_CONNECTING; i++)
+    connect_next(&loop);
+
+  while (connected < num_connections || accepted < num_connections)
+    uv_run(&loop, UV_RUN_ONCE);
+
+  footprint_sample(&after);
+  footprint_report("tcp connection",
+                   2 * sizeof(uv_tcp_t),
+                   num_connections,
+                   &before,
+                   &after);
+
+  uv_close((uv_handle_t*) &server, NULL);
+  for (i = 0; i < num_connections; i++) {
+    uv_close((uv_handle_t*) (clients + i), NULL);
+    uv_close((uv_handle_t*) (peers + i), NULL);
+  }
+  footprint_done(&loop);
+
+  free(clients);
+  free(peers);
+  free(connect_reqs);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  ASSERT(0 && "should not be called");
+}
+
+
+BENCHMARK_IMPL(footprint_timers) {
+  struct footprint before;
+  struct footprint after;
+  uv_timer_t* timers;
+  uv_loop_t loop;
+  unsigned int i;
+
+  timers = calloc(NUM_HANDLES, sizeof(timers[0]));
+  ASSERT_NOT_NULL(timers);
+
+  footprint_init(&loop);
+  footprint_sample(&before);
+
+  for (i = 0; i < NUM_HANDLES; i++) {
+    ASSERT_EQ(0, uv_timer_init(&loop, timers + i));
+    ASSERT_EQ(0, uv_timer_start(timers + i, timer_cb, 3600 * 1000 + i, 0));
+  }
+
+  footprint_sample(&after);
+  footprint_report("timer",
+                   sizeof(uv_timer_t),
+                   NUM_HANDLES,
+                   &before,
+                   &after);
+
+  for (i = 0; i < NUM_HANDLES; i++)
+    uv_close((uv_handle_t*) (timers + i), NULL);
+  footprint_done(&loop);
+  free(timers);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+BENCHMARK_IMPL(footprint_async) {
+  struct footprint before;
+  struct footprint after;
+  uv_async_t* handles;
+  uv_loop_t loop;
+  unsigned int i;
+
+  handles = calloc(NUM_HANDLES, sizeof(handles[0]));
+  ASSERT_NOT_NULL(handles);
+
+  footprint_init(&loop);
+  footprint_sample(&before);
+
+  for (i = 0; i < NUM_HANDLES; i++)
+    ASSERT_EQ(0, uv_async_init(&loop, handles + i, NULL));
+
+  footprint_sample(&after);
+  footprint_report("async",
+                   sizeof(uv_async_t),
+                   NUM_HANDLES,
+                   &before,
+                   &after);
+
+  for (i = 0; i < NUM_HANDLES; i++)
+    uv_close((uv_handle_t*) (handles + i), NULL);
+  footprint_done(&loop);
+  free(handles);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
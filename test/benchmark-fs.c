@@ -0,0 +1,505 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Threadpool-bound fs workloads. Each step keeps a number of requests in
+ * flight for TIME ms. The concurrency levels are 1, 4, 16 and 64, or the
+ * single level in the UV_BENCHMARK_FS_CONCURRENCY environment variable.
+ */
+
+#include "task.h"
+#include "uv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TIME 1000
+#define MAX_CONCURRENCY 256
+
+#define FILE_NAME "fs_bench_file"
+#define FILE_SIZE (16 * 1024 * 1024)
+#define SMALL_READ 4096
+#define LARGE_READ (1024 * 1024)
+
+#define WAL_NAME "fs_bench_wal"
+#define WAL_WRITE 4096
+
+#define DIR_NAME "fs_bench_dir"
+#define DIR_FILES 10000
+#define DIRENTS 64
+
+#define COPY_SIZE (1024 * 1024)
+
+struct fs_job {
+  uv_fs_t req;
+  int id;
+  uint64_t offset;
+  uv_dir_t* dir;
+  uv_dirent_t dirents[DIRENTS];
+  char path[64];
+  char* buf;
+};
+
+typedef void (*fs_job_start_cb)(struct fs_job* job);
+
+static struct fs_job jobs[MAX_CONCURRENCY];
+static uv_loop_t* loop;
+static uint64_t start_time;
+static uint64_t ops;
+static uint64_t items;
+static uint64_t bytes;
+static unsigned int concurrency;
+static fs_job_start_cb job_start;
+static uv_file fd;
+
+
+static unsigned int fastrand(void) {
+  static unsigned int g = 0;
+  g = g * 214013 + 2531011;
+  return g >> 8;
+}
+
+
+static int time_left(void) {
+  return uv_now(loop) - start_time < TIME;
+}
+
+
+/* Called when |job| has finished one operation. Starts the next one until
+ * the time is up.
+ */
+static void job_done(struct fs_job* job) {
+  ops++;
+  if (time_left())
+    job_start(job);
+}
+
+
+static void create_file(const char* path, size_t size) {
+  uv_fs_t req;
+  uv_buf_t buf;
+  uv_file file;
+  char* data;
+  size_t off;
+
+  data = malloc(LARGE_READ);
+  ASSERT_NOT_NULL(data);
+  memset(data, 'x', LARGE_READ);
+
+  file = uv_fs_open(NULL,
+                    &req,
+                    path,
+                    O_WRONLY | O_CREAT | O_TRUNC,
+                    S_IWUSR | S_IRUSR,
+                    NULL);
+  ASSERT_GE(file, 0);
+  uv_fs_req_cleanup(&req);
+
+  for (off = 0; off < size; off += buf.len) {
+    buf = uv_buf_init(data, size - off < LARGE_READ ? size - off : LARGE_READ);
+    ASSERT_EQ(buf.len, uv_fs_write(NULL, &req, file, &buf, 1, off, NULL));
+    uv_fs_req_cleanup(&req);
+  }
+
+  ASSERT_EQ(0, uv_fs_close(NULL, &req, file, NULL));
+  uv_fs_req_cleanup(&req);
+  free(data);
+}
+
+
+static void unlink_file(const char* path) {
+  uv_fs_t req;
+
+  uv_fs_unlink(NULL, &req, path, NULL);
+  uv_fs_req_cleanup(&req);
+}
+
+
+static uv_file open_file(const char* path, int flags) {
+  uv_fs_t req;
+  uv_file file;
+
+  file = uv_fs_open(NULL, &req, path, flags, S_IWUSR | S_IRUSR, NULL);
+  ASSERT_GE(file, 0);
+  uv_fs_req_cleanup(&req);
+  return file;
+}
+
+
+static void close_file(uv_file file) {
+  uv_fs_t req;
+
+  ASSERT_EQ(0, uv_fs_close(NULL, &req, file, NULL));
+  uv_fs_req_cleanup(&req);
+}
+
+
+static void run_level(const char* name, unsigned int n, size_t bufsize) {
+  double secs;
+  uint64_t t;
+  unsigned int i;
+
+  ops = 0;
+  items = 0;
+  bytes = 0;
+  concurrency = n;
+
+  for (i = 0; i < n; i++) {
+    jobs[i].id = i;
+    jobs[i].offset = 0;
+    jobs[i].buf = NULL;
+    if (bufsize > 0) {
+      jobs[i].buf = malloc(bufsize);
+      ASSERT_NOT_NULL(jobs[i].buf);
+    }
+  }
+
+  uv_update_time(loop);
+  start_time = uv_now(loop);
+  t = uv_hrtime();
+
+  for (i = 0; i < n; i++)
+    job_start(jobs + i);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+
+  secs = (uv_hrtime() - t) / 1e9;
+  printf("%s (%u concurrent): %s ops/s", name, n, fmt(ops / secs));
+  if (items > 0)
+    printf(", %s items/s", fmt(items / secs));
+  if (bytes > 0)
+    printf(", %.1f MB/s", bytes / secs / (1024 * 1024));
+  printf("\n");
+  fflush(stdout);
+
+  for (i = 0; i < n; i++)
+    free(jobs[i].buf);
+}
+
+
+static void run(const char* name, fs_job_start_cb cb, size_t bufsize) {
+  static const unsigned int levels[] = { 1, 4, 16, 64 };
+  const char* env;
+  unsigned int i;
+  int n;
+
+  loop = uv_default_loop();
+  job_start = cb;
+
+  env = getenv("UV_BENCHMARK_FS_CONCURRENCY");
+  n = env != NULL ? atoi(env) : 0;
+  if (n > MAX_CONCURRENCY)
+    n = MAX_CONCURRENCY;
+
+  if (n > 0) {
+    run_level(name, n, bufsize);
+    return;
+  }
+
+  for (i = 0; i < ARRAY_SIZE(levels); i++)
+    run_level(name, levels[i], bufsize);
+}
+
+
+static void read_cb(uv_fs_t* req) {
+  struct fs_job* job;
+
+  job = container_of(req, struct fs_job, req);
+  ASSERT_GT(req->result, 0);
+  bytes += req->result;
+  job->offset += req->result;
+  if (job->offset >= FILE_SIZE)
+    job->offset = 0;
+  uv_fs_req_cleanup(req);
+  job_done(job);
+}
+
+
+static void read_random_start(struct fs_job* job) {
+  uv_buf_t buf;
+  int64_t offset;
+
+  offset = (int64_t) (fastrand() % (FILE_SIZE / SMALL_READ)) * SMALL_READ;
+  buf = uv_buf_init(job->buf, SMALL_READ);
+  ASSERT_EQ(0, uv_fs_read(loop, &job->req, fd, &buf, 1, offset, read_cb));
+}
+
+
+static void read_sequential_start(struct fs_job* job) {
+  uv_buf_t buf;
+
+  buf = uv_buf_init(job->buf, LARGE_READ);
+  ASSERT_EQ(0, uv_fs_read(loop,
+                          &job->req,
+                          fd,
+                          &buf,
+                          1,
+                          job->offset,
+                          read_cb));
+}
+
+
+BENCHMARK_IMPL(fs_read_random) {
+  create_file(FILE_NAME, FILE_SIZE);
+  fd = open_file(FILE_NAME, O_RDONLY);
+  run("fs_read_random", read_random_start, SMALL_READ);
+  close_file(fd);
+  unlink_file(FILE_NAME);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+/* Every reader streams through the whole file on its own. */
+BENCHMARK_IMPL(fs_read_sequential) {
+  create_file(FILE_NAME, FILE_SIZE);
+  fd = open_file(FILE_NAME, O_RDONLY);
+  run("fs_read_sequential", read_sequential_start, LARGE_READ);
+  close_file(fd);
+  unlink_file(FILE_NAME);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+/* Group commit: every job appends a record to the log, and once all of
+ * them are written a single fsync makes the batch durable. One commit is
+ * one op, every record is an item.
+ */
+static uv_fs_t fsync_req;
+static unsigned int writes_pending;
+static uint64_t wal_offset;
+
+
+static void wal_write(struct fs_job* job);
+
+
+static void fsync_cb(uv_fs_t* req) {
+  unsigned int i;
+
+  ASSERT_EQ(0, req->result);
+  uv_fs_req_cleanup(req);
+  ops++;
+
+  if (!time_left())
+    return;
+
+  for (i = 0; i < concurrency; i++)
+    wal_write(jobs + i);
+}
+
+
+static void wal_write_cb(uv_fs_t* req) {
+  ASSERT_EQ(WAL_WRITE, req->result);
+  uv_fs_req_cleanup(req);
+  items++;
+  bytes += WAL_WRITE;
+
+  if (--writes_pending == 0)
+    ASSERT_EQ(0, uv_fs_fsync(loop, &fsync_req, fd, fsync_cb));
+}
+
+
+static void wal_write(struct fs_job* job) {
+  uv_buf_t buf;
+
+  buf = uv_buf_init(job->buf, WAL_WRITE);
+  writes_pending++;
+  ASSERT_EQ(0, uv_fs_write(loop,
+                           &job->req,
+                           fd,
+                           &buf,
+                           1,
+                           wal_offset,
+                           wal_write_cb));
+  wal_offset += WAL_WRITE;
+}
+
+
+BENCHMARK_IMPL(fs_write_fsync) {
+  fd = open_file(WAL_NAME, O_WRONLY | O_CREAT | O_TRUNC);
+  writes_pending = 0;
+  wal_offset = 0;
+  run("fs_write_fsync", wal_write, WAL_WRITE);
+  close_file(fd);
+  unlink_file(WAL_NAME);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void create_dir(void) {
+  char path[64];
+  uv_fs_t req;
+  int i;
+
+  ASSERT_EQ(0, uv_fs_mkdir(NULL, &req, DIR_NAME, 0755, NULL));
+  uv_fs_req_cleanup(&req);
+
+  for (i = 0; i < DIR_FILES; i++) {
+    snprintf(path, sizeof(path), "%s/file%d", DIR_NAME, i);
+    close_file(open_file(path, O_WRONLY | O_CREAT));
+  }
+}
+
+
+static void remove_dir(void) {
+  char path[64];
+  uv_fs_t req;
+  int i;
+
+  for (i = 0; i < DIR_FILES; i++) {
+    snprintf(path, sizeof(path), "%s/file%d", DIR_NAME, i);
+    unlink_file(path);
+  }
+
+  uv_fs_rmdir(NULL, &req, DIR_NAME, NULL);
+  uv_fs_req_cleanup(&req);
+}
+
+
+static void scandir_cb(uv_fs_t* req) {
+  struct fs_job* job;
+  uv_dirent_t ent;
+
+  job = container_of(req, struct fs_job, req);
+  ASSERT_EQ(DIR_FILES, req->result);
+  while (uv_fs_scandir_next(req, &ent) != UV_EOF)
+    items++;
+  uv_fs_req_cleanup(req);
+  job_done(job);
+}
+
+
+static void scandir_start(struct fs_job* job) {
+  ASSERT_EQ(0, uv_fs_scandir(loop, &job->req, DIR_NAME, 0, scandir_cb));
+}
+
+
+BENCHMARK_IMPL(fs_scandir) {
+  create_dir();
+  run("fs_scandir", scandir_start, 0);
+  remove_dir();
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void readdir_next(struct fs_job* job);
+
+
+static void closedir_cb(uv_fs_t* req) {
+  struct fs_job* job;
+
+  job = container_of(req, struct fs_job, req);
+  ASSERT_EQ(0, req->result);
+  uv_fs_req_cleanup(req);
+  job_done(job);
+}
+
+
+static void readdir_cb(uv_fs_t* req) {
+  struct fs_job* job;
+  ssize_t n;
+
+  job = container_of(req, struct fs_job, req);
+  n = req->result;
+  ASSERT_GE(n, 0);
+  items += n;
+  uv_fs_req_cleanup(req);
+
+  if (n > 0)
+    readdir_next(job);
+  else
+    ASSERT_EQ(0, uv_fs_closedir(loop, &job->req, job->dir, closedir_cb));
+}
+
+
+static void readdir_next(struct fs_job* job) {
+  job->dir->dirents = job->dirents;
+  job->dir->nentries = ARRAY_SIZE(job->dirents);
+  ASSERT_EQ(0, uv_fs_readdir(loop, &job->req, job->dir, readdir_cb));
+}
+
+
+static void opendir_cb(uv_fs_t* req) {
+  struct fs_job* job;
+
+  job = container_of(req, struct fs_job, req);
+  ASSERT_EQ(0, req->result);
+  job->dir = req->ptr;
+  uv_fs_req_cleanup(req);
+  readdir_next(job);
+}
+
+
+/* One op is a full pass over the directory, DIRENTS entries at a time. */
+static void opendir_start(struct fs_job* job) {
+  ASSERT_EQ(0, uv_fs_opendir(loop, &job->req, DIR_NAME, opendir_cb));
+}
+
+
+BENCHMARK_IMPL(fs_readdir) {
+  create_dir();
+  run("fs_readdir", opendir_start, 0);
+  remove_dir();
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void copyfile_cb(uv_fs_t* req) {
+  struct fs_job* job;
+
+  job = container_of(req, struct fs_job, req);
+  ASSERT_EQ(0, req->result);
+  uv_fs_req_cleanup(req);
+  bytes += COPY_SIZE;
+  job_done(job);
+}
+
+
+static void copyfile_start(struct fs_job* job) {
+  snprintf(job->path, sizeof(job->path), "%s_copy%d", FILE_NAME, job->id);
+  ASSERT_EQ(0, uv_fs_copyfile(loop,
+                              &job->req,
+                              FILE_NAME,
+                              job->path,
+                              0,
+                              copyfile_cb));
+}
+
+
+BENCHMARK_IMPL(fs_copyfile) {
+  char path[64];
+  int i;
+
+  create_file(FILE_NAME, COPY_SIZE);
+  run("fs_copyfile", copyfile_start, 0);
+
+  for (i = 0; i < MAX_CONCURRENCY; i++) {
+    snprintf(path, sizeof(path), "%s_copy%d", FILE_NAME, i);
+    unlink_file(path);
+  }
+  unlink_file(FILE_NAME);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
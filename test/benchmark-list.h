@@ -20,8 +20,13 @@
  */
 
 BENCHMARK_DECLARE (sizes)
+BENCHMARK_DECLARE (footprint_tcp)
+BENCHMARK_DECLARE (footprint_timers)
+BENCHMARK_DECLARE (footprint_async)
 BENCHMARK_DECLARE (loop_count)
 BENCHMARK_DECLARE (loop_count_timed)
+BENCHMARK_DECLARE (loop_init_close)
+BENCHMARK_DECLARE (close_many)
 BENCHMARK_DECLARE (ping_pongs)
 BENCHMARK_DECLARE (ping_udp1)
 BENCHMARK_DECLARE (ping_udp10)
@@ -35,10 +40,26 @@ BENCHMARK_DECLARE (tcp_pump100_client)
 BENCHMARK_DECLARE (tcp_pump1_client)
 BENCHMARK_DECLARE (pipe_pump100_client)
 BENCHMARK_DECLARE (pipe_pump1_client)
+BENCHMARK_DECLARE (rpc)
+BENCHMARK_DECLARE (rpc_pipelined)
 
 BENCHMARK_DECLARE (tcp_multi_accept2)
 BENCHMARK_DECLARE (tcp_multi_accept4)
 BENCHMARK_DECLARE (tcp_multi_accept8)
+BENCHMARK_DECLARE (tcp_multi_accept4_batch)
+BENCHMARK_DECLARE (tcp_multi_accept8_batch)
+BENCHMARK_DECLARE (tcp_multi_accept4_reuseport)
+BENCHMARK_DECLARE (tcp_multi_accept8_reuseport)
+BENCHMARK_DECLARE (tcp_churn)
+BENCHMARK_DECLARE (tcp_churn_batch)
+BENCHMARK_DECLARE (tcp_churn4_reuseport)
+
+/* One loop per thread, from 1 up to the number of CPUs. */
+BENCHMARK_DECLARE (multi_loop_tcp_echo)
+BENCHMARK_DECLARE (multi_loop_udp_echo)
+BENCHMARK_DECLARE (multi_loop_fs_read)
+BENCHMARK_DECLARE (multi_loop_queue_work)
+BENCHMARK_DECLARE (multi_loop_all)
 
 /* Run until X packets have been sent/received. */
 BENCHMARK_DECLARE (udp_pummel_1v1)
@@ -66,19 +87,39 @@ BENCHMARK_DECLARE (udp_timed_pummel_1000v1000)
 
 BENCHMARK_DECLARE (getaddrinfo)
 BENCHMARK_DECLARE (fs_stat)
+BENCHMARK_DECLARE (fs_read_random)
+BENCHMARK_DECLARE (fs_read_sequential)
+BENCHMARK_DECLARE (fs_write_fsync)
+BENCHMARK_DECLARE (fs_scandir)
+BENCHMARK_DECLARE (fs_readdir)
+BENCHMARK_DECLARE (fs_copyfile)
 BENCHMARK_DECLARE (async1)
 BENCHMARK_DECLARE (async2)
 BENCHMARK_DECLARE (async4)
 BENCHMARK_DECLARE (async8)
+BENCHMARK_DECLARE (async_wakeup_idle)
+BENCHMARK_DECLARE (async_wakeup_busy)
 BENCHMARK_DECLARE (async_pummel_1)
 BENCHMARK_DECLARE (async_pummel_2)
 BENCHMARK_DECLARE (async_pummel_4)
 BENCHMARK_DECLARE (async_pummel_8)
 BENCHMARK_DECLARE (queue_work)
+BENCHMARK_DECLARE (queue_work_multi_producer)
+BENCHMARK_DECLARE (queue_work_multi_producer16)
+BENCHMARK_DECLARE (queue_work_multi_producer64)
 BENCHMARK_DECLARE (spawn)
+BENCHMARK_DECLARE (spawn_large_rss)
 BENCHMARK_DECLARE (thread_create)
 BENCHMARK_DECLARE (million_async)
 BENCHMARK_DECLARE (million_timers)
+BENCHMARK_DECLARE (million_timers_wheel)
+BENCHMARK_DECLARE (million_timers_start_many)
+BENCHMARK_DECLARE (timer_churn_restart)
+BENCHMARK_DECLARE (timer_churn_restart_wheel)
+BENCHMARK_DECLARE (timer_churn_cancel)
+BENCHMARK_DECLARE (timer_churn_cancel_wheel)
+BENCHMARK_DECLARE (timer_churn_mixed)
+BENCHMARK_DECLARE (timer_churn_mixed_wheel)
 HELPER_DECLARE    (tcp4_blackhole_server)
 HELPER_DECLARE    (tcp_pump_server)
 HELPER_DECLARE    (pipe_pump_server)
@@ -87,8 +128,13 @@ HELPER_DECLARE    (pipe_echo_server)
 
 TASK_LIST_START
   BENCHMARK_ENTRY  (sizes)
+  BENCHMARK_ENTRY  (footprint_tcp)
+  BENCHMARK_ENTRY  (footprint_timers)
+  BENCHMARK_ENTRY  (footprint_async)
   BENCHMARK_ENTRY  (loop_count)
   BENCHMARK_ENTRY  (loop_count_timed)
+  BENCHMARK_ENTRY  (loop_init_close)
+  BENCHMARK_ENTRY  (close_many)
 
   BENCHMARK_ENTRY  (ping_pongs)
   BENCHMARK_HELPER (ping_pongs, tcp4_echo_server)
@@ -97,6 +143,9 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (ping_udp10)
   BENCHMARK_ENTRY  (ping_udp100)
 
+  BENCHMARK_ENTRY  (rpc)
+  BENCHMARK_ENTRY  (rpc_pipelined)
+
   BENCHMARK_ENTRY  (tcp_write_batch)
   BENCHMARK_HELPER (tcp_write_batch, tcp4_blackhole_server)
 
@@ -127,6 +176,19 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (tcp_multi_accept2)
   BENCHMARK_ENTRY  (tcp_multi_accept4)
   BENCHMARK_ENTRY  (tcp_multi_accept8)
+  BENCHMARK_ENTRY  (tcp_multi_accept4_batch)
+  BENCHMARK_ENTRY  (tcp_multi_accept8_batch)
+  BENCHMARK_ENTRY  (tcp_multi_accept4_reuseport)
+  BENCHMARK_ENTRY  (tcp_multi_accept8_reuseport)
+  BENCHMARK_ENTRY  (tcp_churn)
+  BENCHMARK_ENTRY  (tcp_churn_batch)
+  BENCHMARK_ENTRY  (tcp_churn4_reuseport)
+
+  BENCHMARK_ENTRY  (multi_loop_tcp_echo)
+  BENCHMARK_ENTRY  (multi_loop_udp_echo)
+  BENCHMARK_ENTRY  (multi_loop_fs_read)
+  BENCHMARK_ENTRY  (multi_loop_queue_work)
+  BENCHMARK_ENTRY  (multi_loop_all)
 
   BENCHMARK_ENTRY  (udp_pummel_1v1)
   BENCHMARK_ENTRY  (udp_pummel_1v10)
@@ -153,19 +215,39 @@ TASK_LIST_START
   BENCHMARK_ENTRY  (getaddrinfo)
 
   BENCHMARK_ENTRY  (fs_stat)
+  BENCHMARK_ENTRY  (fs_read_random)
+  BENCHMARK_ENTRY  (fs_read_sequential)
+  BENCHMARK_ENTRY  (fs_write_fsync)
+  BENCHMARK_ENTRY  (fs_scandir)
+  BENCHMARK_ENTRY  (fs_readdir)
+  BENCHMARK_ENTRY  (fs_copyfile)
 
   BENCHMARK_ENTRY  (async1)
   BENCHMARK_ENTRY  (async2)
   BENCHMARK_ENTRY  (async4)
   BENCHMARK_ENTRY  (async8)
+  BENCHMARK_ENTRY  (async_wakeup_idle)
+  BENCHMARK_ENTRY  (async_wakeup_busy)
   BENCHMARK_ENTRY  (async_pummel_1)
   BENCHMARK_ENTRY  (async_pummel_2)
   BENCHMARK_ENTRY  (async_pummel_4)
   BENCHMARK_ENTRY  (async_pummel_8)
   BENCHMARK_ENTRY  (queue_work)
+  BENCHMARK_ENTRY  (queue_work_multi_producer)
+  BENCHMARK_ENTRY  (queue_work_multi_producer16)
+  BENCHMARK_ENTRY  (queue_work_multi_producer64)
 
   BENCHMARK_ENTRY  (spawn)
+  BENCHMARK_ENTRY  (spawn_large_rss)
   BENCHMARK_ENTRY  (thread_create)
   BENCHMARK_ENTRY  (million_async)
   BENCHMARK_ENTRY  (million_timers)
+  BENCHMARK_ENTRY  (million_timers_wheel)
+  BENCHMARK_ENTRY  (million_timers_start_many)
+  BENCHMARK_ENTRY  (timer_churn_restart)
+  BENCHMARK_ENTRY  (timer_churn_restart_wheel)
+  BENCHMARK_ENTRY  (timer_churn_cancel)
+  BENCHMARK_ENTRY  (timer_churn_cancel_wheel)
+  BENCHMARK_ENTRY  (timer_churn_mixed)
+  BENCHMARK_ENTRY  (timer_churn_mixed_wheel)
 TASK_LIST_END
@@ -90,3 +90,39 @@ BENCHMARK_IMPL(loop_count_timed) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+#define NUM_LOOPS (20 * 1000)
+
+/* What creating a throwaway loop costs, set up, one turn and teardown. */
+BENCHMARK_IMPL(loop_init_close) {
+  uv_loop_t loop;
+  uint64_t init_ns;
+  uint64_t close_ns;
+  uint64_t start;
+  int i;
+
+  init_ns = 0;
+  close_ns = 0;
+
+  for (i = 0; i < NUM_LOOPS; i++) {
+    start = uv_hrtime();
+    ASSERT(0 == uv_loop_init(&loop));
+    init_ns += uv_hrtime() - start;
+
+    ASSERT(0 == uv_run(&loop, UV_RUN_NOWAIT));
+
+    start = uv_hrtime();
+    ASSERT(0 == uv_loop_close(&loop));
+    close_ns += uv_hrtime() - start;
+  }
+
+  fprintf(stderr, "loop_init_close: %d loops, %.2f us init, %.2f us close\n",
+          NUM_LOOPS,
+          init_ns / 1e3 / NUM_LOOPS,
+          close_ns / 1e3 / NUM_LOOPS);
+  fflush(stderr);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -38,9 +38,11 @@ static void close_cb(uv_handle_t* handle) {
 }
 
 
-BENCHMARK_IMPL(million_timers) {
+static int million_timers(int use_timer_wheel, int use_start_many) {
+  uv_timer_t** handles;
+  uint64_t* timeouts;
   uv_timer_t* timers;
-  uv_loop_t* loop;
+  uv_loop_t loop;
   uint64_t before_all;
   uint64_t before_run;
   uint64_t after_run;
@@ -51,29 +53,55 @@ BENCHMARK_IMPL(million_timers) {
   timers = malloc(NUM_TIMERS * sizeof(timers[0]));
   ASSERT_NOT_NULL(timers);
 
-  loop = uv_default_loop();
+  ASSERT(0 == uv_loop_init(&loop));
+  configure_loop_from_env(&loop);
+  if (use_timer_wheel)
+    ASSERT(0 == uv_loop_configure(&loop, UV_LOOP_USE_TIMER_WHEEL));
   timeout = 0;
 
+  handles = NULL;
+  timeouts = NULL;
+  if (use_start_many) {
+    handles = malloc(NUM_TIMERS * sizeof(handles[0]));
+    timeouts = malloc(NUM_TIMERS * sizeof(timeouts[0]));
+    ASSERT_NOT_NULL(handles);
+    ASSERT_NOT_NULL(timeouts);
+  }
+
   before_all = uv_hrtime();
   for (i = 0; i < NUM_TIMERS; i++) {
     if (i % 1000 == 0) timeout++;
-    ASSERT(0 == uv_timer_init(loop, timers + i));
-    ASSERT(0 == uv_timer_start(timers + i, timer_cb, timeout, 0));
+    ASSERT(0 == uv_timer_init(&loop, timers + i));
+    if (use_start_many) {
+      handles[i] = timers + i;
+      timeouts[i] = timeout;
+    } else {
+      ASSERT(0 == uv_timer_start(timers + i, timer_cb, timeout, 0));
+    }
   }
 
+  if (use_start_many)
+    ASSERT(0 == uv_timer_start_many(handles,
+                                    NUM_TIMERS,
+                                    timer_cb,
+                                    timeouts,
+                                    0));
+
   before_run = uv_hrtime();
-  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
   after_run = uv_hrtime();
 
   for (i = 0; i < NUM_TIMERS; i++)
     uv_close((uv_handle_t*) (timers + i), close_cb);
 
-  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
   after_all = uv_hrtime();
 
   ASSERT(timer_cb_called == NUM_TIMERS);
   ASSERT(close_cb_called == NUM_TIMERS);
   free(timers);
+  free(handles);
+  free(timeouts);
 
   fprintf(stderr, "%.2f seconds total\n", (after_all - before_all) / 1e9);
   fprintf(stderr, "%.2f seconds init\n", (before_run - before_all) / 1e9);
@@ -81,6 +109,21 @@ BENCHMARK_IMPL(million_timers) {
   fprintf(stderr, "%.2f seconds cleanup\n", (after_all - after_run) / 1e9);
   fflush(stderr);
 
-  MAKE_VALGRIND_HAPPY();
+  ASSERT(0 == uv_loop_close(&loop));
   return 0;
 }
+
+
+BENCHMARK_IMPL(million_timers) {
+  return million_timers(0, 0);
+}
+
+
+BENCHMARK_IMPL(million_timers_wheel) {
+  return million_timers(1, 0);
+}
+
+
+BENCHMARK_IMPL(million_timers_start_many) {
+  return million_timers(0, 1);
+}
@@ -67,6 +67,7 @@ struct ipc_client_ctx {
 struct server_ctx {
   handle_storage_t server_handle;
   unsigned int num_connects;
+  uint64_t num_wakeups;
   uv_async_t async_handle;
   uv_thread_t thread_id;
   uv_sem_t semaphore;
@@ -102,6 +103,8 @@ static void cl_idle_cb(uv_idle_t* handle);
 static void cl_close_cb(uv_handle_t* handle);
 
 static struct sockaddr_in listen_addr;
+static unsigned int accept_batch;
+static int reuseport;
 
 
 static void ipc_connection_cb(uv_stream_t* ipc_pipe, int status) {
@@ -256,25 +259,47 @@ static void get_listen_handle(uv_loop_t* loop, uv_stream_t* server_handle) {
 
 static void server_cb(void *arg) {
   struct server_ctx *ctx;
+  uv_metrics_t metrics;
   uv_loop_t loop;
 
   ctx = arg;
   ASSERT(0 == uv_loop_init(&loop));
+  configure_loop_from_env(&loop);
+  if (accept_batch > 1)
+    ASSERT(0 == uv_loop_configure(&loop, UV_LOOP_ACCEPT_BATCH, accept_batch));
 
   ASSERT(0 == uv_async_init(&loop, &ctx->async_handle, sv_async_cb));
   uv_unref((uv_handle_t*) &ctx->async_handle);
 
-  /* Wait until the main thread is ready. */
-  uv_sem_wait(&ctx->semaphore);
-  get_listen_handle(&loop, (uv_stream_t*) &ctx->server_handle);
-  uv_sem_post(&ctx->semaphore);
+  if (reuseport) {
+    /* Every thread gets its own listen socket and accept queue. */
+    ASSERT(0 == uv_tcp_init(&loop, (uv_tcp_t*) &ctx->server_handle));
+    ASSERT(0 == uv_tcp_bind((uv_tcp_t*) &ctx->server_handle,
+                            (const struct sockaddr*) &listen_addr,
+                            UV_TCP_REUSEPORT));
+  } else {
+    /* Wait until the main thread is ready. */
+    uv_sem_wait(&ctx->semaphore);
+    get_listen_handle(&loop, (uv_stream_t*) &ctx->server_handle);
+  }
 
-  /* Now start the actual benchmark. */
+  /* Listen before signalling so no client connects to a socket that's only
+   * bound, there is no shared listen socket to fall back on with reuseport.
+   */
   ASSERT(0 == uv_listen((uv_stream_t*) &ctx->server_handle,
                         128,
                         sv_connection_cb));
+  uv_sem_post(&ctx->semaphore);
+
+  /* Now start the actual benchmark. */
   ASSERT(0 == uv_run(&loop, UV_RUN_DEFAULT));
 
+  /* Polls that returned something. A thread that is woken up for a
+   * connection another thread accepted counts one that accepted nothing.
+   */
+  ASSERT(0 == uv_metrics_info(&loop, &metrics));
+  ctx->num_wakeups = metrics.polls - metrics.polls_empty;
+
   uv_loop_close(&loop);
 }
 
@@ -359,7 +384,10 @@ static void cl_close_cb(uv_handle_t* handle) {
 }
 
 
-static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
+static int test_tcp(unsigned int num_servers,
+                    unsigned int num_clients,
+                    unsigned int batch,
+                    int use_reuseport) {
   struct server_ctx* servers;
   struct client_ctx* clients;
   uv_loop_t* loop;
@@ -369,6 +397,8 @@ static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
 
   ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &listen_addr));
   loop = uv_default_loop();
+  accept_batch = batch;
+  reuseport = use_reuseport;
 
   servers = calloc(num_servers, sizeof(servers[0]));
   clients = calloc(num_clients, sizeof(clients[0]));
@@ -385,7 +415,12 @@ static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
     ASSERT(0 == uv_thread_create(&ctx->thread_id, server_cb, ctx));
   }
 
-  send_listen_handles(UV_TCP, num_servers, servers);
+  if (reuseport) {
+    for (i = 0; i < num_servers; i++)
+      uv_sem_wait(&servers[i].semaphore);
+  } else {
+    send_listen_handles(UV_TCP, num_servers, servers);
+  }
 
   for (i = 0; i < num_clients; i++) {
     struct client_ctx* ctx = clients + i;
@@ -414,18 +449,21 @@ static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
     uv_sem_destroy(&ctx->semaphore);
   }
 
-  printf("accept%u: %.0f accepts/sec (%u total)\n",
+  printf("accept%u%s%s: %.0f accepts/sec (%u total)\n",
          num_servers,
+         batch > 1 ? "_batch" : "",
+         reuseport ? "_reuseport" : "",
          NUM_CONNECTS / time,
          NUM_CONNECTS);
 
   for (i = 0; i < num_servers; i++) {
     struct server_ctx* ctx = servers + i;
-    printf("  thread #%u: %.0f accepts/sec (%u total, %.1f%%)\n",
+    printf("  thread #%u: %.0f accepts/sec (%u total, %.1f%%, %llu wakeups)\n",
            i,
            ctx->num_connects / time,
            ctx->num_connects,
-           ctx->num_connects * 100.0 / NUM_CONNECTS);
+           ctx->num_connects * 100.0 / NUM_CONNECTS,
+           (unsigned long long) ctx->num_wakeups);
   }
 
   free(clients);
@@ -437,15 +475,47 @@ static int test_tcp(unsigned int num_servers, unsigned int num_clients) {
 
 
 BENCHMARK_IMPL(tcp_multi_accept2) {
-  return test_tcp(2, 40);
+  return test_tcp(2, 40, 1, 0);
 }
 
 
 BENCHMARK_IMPL(tcp_multi_accept4) {
-  return test_tcp(4, 40);
+  return test_tcp(4, 40, 1, 0);
 }
 
 
 BENCHMARK_IMPL(tcp_multi_accept8) {
-  return test_tcp(8, 40);
+  return test_tcp(8, 40, 1, 0);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept4_batch) {
+#ifdef _WIN32
+  RETURN_SKIP("UV_LOOP_ACCEPT_BATCH is not supported on Windows");
+#endif
+  return test_tcp(4, 40, 32, 0);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept8_batch) {
+#ifdef _WIN32
+  RETURN_SKIP("UV_LOOP_ACCEPT_BATCH is not supported on Windows");
+#endif
+  return test_tcp(8, 40, 32, 0);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept4_reuseport) {
+#ifdef _WIN32
+  RETURN_SKIP("UV_TCP_REUSEPORT is not supported on Windows");
+#endif
+  return test_tcp(4, 40, 1, 1);
+}
+
+
+BENCHMARK_IMPL(tcp_multi_accept8_reuseport) {
+#ifdef _WIN32
+  RETURN_SKIP("UV_TCP_REUSEPORT is not supported on Windows");
+#endif
+  return test_tcp(8, 40, 1, 1);
 }
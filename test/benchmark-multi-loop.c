@@ -0,0 +1,545 @@
+/* Copyright libuv contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Runs the same workload on 1, 2, 4, ... up to one loop per CPU, each loop
+ * on its own thread and all of them sharing the threadpool, and reports
+ * how well the aggregate throughput scales.
+ */
+
+#include "task.h"
+#include "uv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Run each step for this many ms. */
+#define TIME 1000
+#define MAX_LOOPS 64
+#define MSG_SIZE 64
+#define FS_READ_SIZE 4096
+#define NUM_WORK 4
+
+#define FS_FILE "multi_loop_file"
+
+enum {
+  WORKLOAD_TCP = 1,
+  WORKLOAD_UDP = 2,
+  WORKLOAD_FS = 4,
+  WORKLOAD_WORK = 8,
+  WORKLOAD_ALL = 15
+};
+
+struct ml_loop {
+  uv_loop_t loop;
+  uv_thread_t thread;
+  uv_timer_t timer;
+  unsigned workload;
+  int done;
+  uint64_t ops;
+
+  uv_tcp_t tcp_server;
+  uv_tcp_t tcp_client;
+  uv_tcp_t tcp_peer;
+  uv_connect_t connect_req;
+  size_t client_nread;
+  char client_buf[MSG_SIZE];
+  char peer_buf[MSG_SIZE];
+
+  uv_udp_t udp_client;
+  uv_udp_t udp_echo;
+  struct sockaddr_storage udp_echo_addr;
+  char udp_buf[MSG_SIZE];
+
+  uv_fs_t fs_req;
+  uv_file fd;
+  char fs_buf[FS_READ_SIZE];
+
+  uv_work_t work[NUM_WORK];
+};
+
+static char msg[MSG_SIZE];
+static uv_barrier_t start_barrier;
+
+
+/* Messages are small and one is in flight per connection, so writes go
+ * straight to the socket, as in the UDP round trips.
+ */
+static void tcp_write(uv_tcp_t* handle, const char* base, size_t len) {
+  uv_buf_t buf;
+
+  buf = uv_buf_init((char*) base, len);
+  if (uv_try_write((uv_stream_t*) handle, &buf, 1) != (int) len)
+    FATAL("uv_try_write failed");
+}
+
+
+static void tcp_client_alloc_cb(uv_handle_t* handle,
+                                size_t suggested_size,
+                                uv_buf_t* buf) {
+  struct ml_loop* ml;
+
+  ml = handle->data;
+  buf->base = ml->client_buf + ml->client_nread;
+  buf->len = sizeof(ml->client_buf) - ml->client_nread;
+}
+
+
+static void tcp_client_read_cb(uv_stream_t* stream,
+                               ssize_t nread,
+                               const uv_buf_t* buf) {
+  struct ml_loop* ml;
+
+  ml = stream->data;
+  if (nread == 0)
+    return;
+  ASSERT_GT(nread, 0);
+
+  ml->client_nread += nread;
+  if (ml->client_nread < sizeof(msg))
+    return;
+
+  ml->client_nread = 0;
+  ml->ops++;
+  if (!ml->done)
+    tcp_write(&ml->tcp_client, msg, sizeof(msg));
+}
+
+
+static void tcp_connect_cb(uv_connect_t* req, int status) {
+  struct ml_loop* ml;
+
+  ml = req->handle->data;
+  if (status == UV_ECANCELED)
+    return;
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &ml->tcp_client,
+                             tcp_client_alloc_cb,
+                             tcp_client_read_cb));
+  tcp_write(&ml->tcp_client, msg, sizeof(msg));
+}
+
+
+static void tcp_peer_alloc_cb(uv_handle_t* handle,
+                              size_t suggested_size,
+                              uv_buf_t* buf) {
+  struct ml_loop* ml;
+
+  ml = handle->data;
+  buf->base = ml->peer_buf;
+  buf->len = sizeof(ml->peer_buf);
+}
+
+
+static void tcp_peer_read_cb(uv_stream_t* stream,
+                             ssize_t nread,
+                             const uv_buf_t* buf) {
+  if (nread == 0)
+    return;
+  ASSERT_GT(nread, 0);
+  tcp_write((uv_tcp_t*) stream, buf->base, nread);
+}
+
+
+static void tcp_connection_cb(uv_stream_t* server, int status) {
+  struct ml_loop* ml;
+
+  ml = server->data;
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, uv_tcp_init(&ml->loop, &ml->tcp_peer));
+  ml->tcp_peer.data = ml;
+  ASSERT_EQ(0, uv_accept(server, (uv_stream_t*) &ml->tcp_peer));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &ml->tcp_peer,
+                             tcp_peer_alloc_cb,
+                             tcp_peer_read_cb));
+}
+
+
+static void tcp_start(struct ml_loop* ml) {
+  struct sockaddr_storage addr;
+  int namelen;
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", 0, (struct sockaddr_in*) &addr));
+  ASSERT_EQ(0, uv_tcp_init(&ml->loop, &ml->tcp_server));
+  ASSERT_EQ(0, uv_tcp_init(&ml->loop, &ml->tcp_client));
+  ml->tcp_server.data = ml;
+  ml->tcp_client.data = ml;
+  ml->tcp_peer.data = NULL;
+
+  ASSERT_EQ(0, uv_tcp_bind(&ml->tcp_server, (struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &ml->tcp_server,
+                         1,
+                         tcp_connection_cb));
+
+  namelen = sizeof(addr);
+  ASSERT_EQ(0, uv_tcp_getsockname(&ml->tcp_server,
+                                  (struct sockaddr*) &addr,
+                                  &namelen));
+  ASSERT_EQ(0, uv_tcp_nodelay(&ml->tcp_client, 1));
+  ASSERT_EQ(0, uv_tcp_connect(&ml->connect_req,
+                              &ml->tcp_client,
+                              (struct sockaddr*) &addr,
+                              tcp_connect_cb));
+}
+
+
+static void udp_alloc_cb(uv_handle_t* handle,
+                         size_t suggested_size,
+                         uv_buf_t* buf) {
+  struct ml_loop* ml;
+
+  ml = handle->data;
+  buf->base = ml->udp_buf;
+  buf->len = sizeof(ml->udp_buf);
+}
+
+
+static void udp_send(uv_udp_t* handle,
+                     const char* base,
+                     size_t len,
+                     const struct sockaddr* addr) {
+  uv_buf_t buf;
+
+  buf = uv_buf_init((char*) base, len);
+  if (uv_udp_try_send(handle, &buf, 1, addr) < 0)
+    FATAL("uv_udp_try_send failed");
+}
+
+
+static void udp_echo_recv_cb(uv_udp_t* handle,
+                             ssize_t nread,
+                             const uv_buf_t* buf,
+                             const struct sockaddr* addr,
+                             unsigned flags) {
+  if (nread == 0)
+    return;
+  ASSERT_GT(nread, 0);
+  udp_send(handle, buf->base, nread, addr);
+}
+
+
+static void udp_client_recv_cb(uv_udp_t* handle,
+                               ssize_t nread,
+                               const uv_buf_t* buf,
+                               const struct sockaddr* addr,
+                               unsigned flags) {
+  struct ml_loop* ml;
+
+  ml = handle->data;
+  if (nread == 0)
+    return;
+  ASSERT_GT(nread, 0);
+
+  ml->ops++;
+  if (!ml->done)
+    udp_send(handle,
+             msg,
+             sizeof(msg),
+             (struct sockaddr*) &ml->udp_echo_addr);
+}
+
+
+static void udp_start(struct ml_loop* ml) {
+  struct sockaddr_storage addr;
+  int namelen;
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", 0, (struct sockaddr_in*) &addr));
+  ASSERT_EQ(0, uv_udp_init(&ml->loop, &ml->udp_echo));
+  ASSERT_EQ(0, uv_udp_init(&ml->loop, &ml->udp_client));
+  ml->udp_echo.data = ml;
+  ml->udp_client.data = ml;
+
+  ASSERT_EQ(0, uv_udp_bind(&ml->udp_echo, (struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_udp_bind(&ml->udp_client, (struct sockaddr*) &addr, 0));
+
+  namelen = sizeof(ml->udp_echo_addr);
+  ASSERT_EQ(0, uv_udp_getsockname(&ml->udp_echo,
+                                  (struct sockaddr*) &ml->udp_echo_addr,
+                                  &namelen));
+
+  ASSERT_EQ(0, uv_udp_recv_start(&ml->udp_echo,
+                                 udp_alloc_cb,
+                                 udp_echo_recv_cb));
+  ASSERT_EQ(0, uv_udp_recv_start(&ml->udp_client,
+                                 udp_alloc_cb,
+                                 udp_client_recv_cb));
+  udp_send(&ml->udp_client,
+           msg,
+           sizeof(msg),
+           (struct sockaddr*) &ml->udp_echo_addr);
+}
+
+
+static void fs_read(struct ml_loop* ml);
+
+
+static void fs_read_cb(uv_fs_t* req) {
+  struct ml_loop* ml;
+
+  ml = req->data;
+  ASSERT_EQ(req->result, FS_READ_SIZE);
+  uv_fs_req_cleanup(req);
+
+  ml->ops++;
+  if (!ml->done)
+    fs_read(ml);
+}
+
+
+static void fs_read(struct ml_loop* ml) {
+  uv_buf_t buf;
+
+  buf = uv_buf_init(ml->fs_buf, sizeof(ml->fs_buf));
+  ml->fs_req.data = ml;
+  ASSERT_EQ(0, uv_fs_read(&ml->loop,
+                          &ml->fs_req,
+                          ml->fd,
+                          &buf,
+                          1,
+                          0,
+                          fs_read_cb));
+}
+
+
+static void fs_start(struct ml_loop* ml) {
+  uv_fs_t req;
+
+  ml->fd = uv_fs_open(NULL, &req, FS_FILE, O_RDONLY, 0, NULL);
+  ASSERT_GE(ml->fd, 0);
+  uv_fs_req_cleanup(&req);
+  fs_read(ml);
+}
+
+
+static void work_cb(uv_work_t* req) {
+}
+
+
+static void after_work_cb(uv_work_t* req, int status) {
+  struct ml_loop* ml;
+
+  ml = req->data;
+  ASSERT_EQ(0, status);
+
+  ml->ops++;
+  if (!ml->done)
+    ASSERT_EQ(0, uv_queue_work(&ml->loop, req, work_cb, after_work_cb));
+}
+
+
+static void work_start(struct ml_loop* ml) {
+  int i;
+
+  for (i = 0; i < NUM_WORK; i++) {
+    ml->work[i].data = ml;
+    ASSERT_EQ(0, uv_queue_work(&ml->loop,
+                               &ml->work[i],
+                               work_cb,
+                               after_work_cb));
+  }
+}
+
+
+/* In-flight fs reads and work items finish on their own and aren't
+ * resubmitted.
+ */
+static void ml_close(struct ml_loop* ml) {
+  if (ml->workload & WORKLOAD_TCP) {
+    uv_close((uv_handle_t*) &ml->tcp_server, NULL);
+    uv_close((uv_handle_t*) &ml->tcp_client, NULL);
+    if (ml->tcp_peer.data != NULL)
+      uv_close((uv_handle_t*) &ml->tcp_peer, NULL);
+  }
+
+  if (ml->workload & WORKLOAD_UDP) {
+    uv_close((uv_handle_t*) &ml->udp_echo, NULL);
+    uv_close((uv_handle_t*) &ml->udp_client, NULL);
+  }
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  struct ml_loop* ml;
+
+  ml = handle->data;
+  ml->done = 1;
+  ml_close(ml);
+}
+
+
+static void ml_thread(void* arg) {
+  struct ml_loop* ml;
+  uv_fs_t req;
+
+  ml = arg;
+  ASSERT_EQ(0, uv_loop_init(&ml->loop));
+  configure_loop_from_env(&ml->loop);
+  ASSERT_EQ(0, uv_timer_init(&ml->loop, &ml->timer));
+  ml->timer.data = ml;
+
+  uv_barrier_wait(&start_barrier);
+
+  ASSERT_EQ(0, uv_timer_start(&ml->timer, timer_cb, TIME, 0));
+  if (ml->workload & WORKLOAD_TCP)
+    tcp_start(ml);
+  if (ml->workload & WORKLOAD_UDP)
+    udp_start(ml);
+  if (ml->workload & WORKLOAD_FS)
+    fs_start(ml);
+  if (ml->workload & WORKLOAD_WORK)
+    work_start(ml);
+
+  ASSERT_EQ(0, uv_run(&ml->loop, UV_RUN_DEFAULT));
+
+  if (ml->workload & WORKLOAD_FS) {
+    ASSERT_EQ(0, uv_fs_close(NULL, &req, ml->fd, NULL));
+    uv_fs_req_cleanup(&req);
+  }
+
+  uv_close((uv_handle_t*) &ml->timer, NULL);
+  ASSERT_EQ(0, uv_run(&ml->loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, uv_loop_close(&ml->loop));
+}
+
+
+static uint64_t run_loops(unsigned workload, int nloops) {
+  struct ml_loop* loops;
+  uint64_t ops;
+  int i;
+
+  loops = calloc(nloops, sizeof(loops[0]));
+  ASSERT_NOT_NULL(loops);
+  ASSERT_EQ(0, uv_barrier_init(&start_barrier, nloops));
+
+  for (i = 0; i < nloops; i++) {
+    loops[i].workload = workload;
+    ASSERT_EQ(0, uv_thread_create(&loops[i].thread, ml_thread, &loops[i]));
+  }
+
+  ops = 0;
+  for (i = 0; i < nloops; i++) {
+    ASSERT_EQ(0, uv_thread_join(&loops[i].thread));
+    ops += loops[i].ops;
+  }
+
+  uv_barrier_destroy(&start_barrier);
+  free(loops);
+  return ops;
+}
+
+
+static void create_file(void) {
+  static char data[FS_READ_SIZE];
+  uv_fs_t req;
+  uv_buf_t buf;
+  uv_file fd;
+
+  fd = uv_fs_open(NULL,
+                  &req,
+                  FS_FILE,
+                  O_WRONLY | O_CREAT | O_TRUNC,
+                  S_IWUSR | S_IRUSR,
+                  NULL);
+  ASSERT_GE(fd, 0);
+  uv_fs_req_cleanup(&req);
+
+  buf = uv_buf_init(data, sizeof(data));
+  ASSERT_EQ(sizeof(data), uv_fs_write(NULL, &req, fd, &buf, 1, 0, NULL));
+  uv_fs_req_cleanup(&req);
+
+  ASSERT_EQ(0, uv_fs_close(NULL, &req, fd, NULL));
+  uv_fs_req_cleanup(&req);
+}
+
+
+static int multi_loop(const char* name, unsigned workload) {
+  uv_cpu_info_t* cpus;
+  uv_fs_t req;
+  double base;
+  double rate;
+  int ncpus;
+  int nloops;
+
+  ASSERT_EQ(0, uv_cpu_info(&cpus, &ncpus));
+  uv_free_cpu_info(cpus, ncpus);
+  if (ncpus > MAX_LOOPS)
+    ncpus = MAX_LOOPS;
+
+  memset(msg, 'x', sizeof(msg));
+  if (workload & WORKLOAD_FS)
+    create_file();
+
+  base = 0;
+  nloops = 1;
+  for (;;) {
+    rate = run_loops(workload, nloops) / (TIME / 1000.);
+    if (nloops == 1)
+      base = rate;
+
+    printf("%s: %d loop%s, %s ops/s, %.2fx, %.0f%% efficiency\n",
+           name,
+           nloops,
+           nloops == 1 ? "" : "s",
+           fmt(rate),
+           base > 0 ? rate / base : 0,
+           base > 0 ? 100 * rate / (base * nloops) : 0);
+    fflush(stdout);
+
+    if (nloops == ncpus)
+      break;
+    nloops *= 2;
+    if (nloops > ncpus)
+      nloops = ncpus;
+  }
+
+  if (workload & WORKLOAD_FS) {
+    uv_fs_unlink(NULL, &req, FS_FILE, NULL);
+    uv_fs_req_cleanup(&req);
+  }
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+BENCHMARK_IMPL(multi_loop_tcp_echo) {
+  return multi_loop("multi_loop_tcp_echo", WORKLOAD_TCP);
+}
+
+
+BENCHMARK_IMPL(multi_loop_udp_echo) {
+  return multi_loop("multi_loop_udp_echo", WORKLOAD_UDP);
+}
+
+
+BENCHMARK_IMPL(multi_loop_fs_read) {
+  return multi_loop("multi_loop_fs_read", WORKLOAD_FS);
+}
+
+
+BENCHMARK_IMPL(multi_loop_queue_work) {
+  return multi_loop("multi_loop_queue_work", WORKLOAD_WORK);
+}
+
+
+BENCHMARK_IMPL(multi_loop_all) {
+  return multi_loop("multi_loop_all", WORKLOAD_ALL);
+}
@@ -32,6 +32,7 @@
 typedef struct {
   int pongs;
   int state;
+  uint64_t ping_time;
   uv_tcp_t tcp;
   uv_connect_t connect_req;
   uv_shutdown_t shutdown_req;
@@ -51,6 +52,7 @@ static buf_t* buf_freelist = NULL;
 static int pinger_shutdown_cb_called;
 static int completed_pingers = 0;
 static int64_t start_time;
+static latency_hist_t latency;
 
 
 static void buf_alloc(uv_handle_t* tcp, size_t size, uv_buf_t* buf) {
@@ -81,7 +83,7 @@ static void pinger_close_cb(uv_handle_t* handle) {
 
   pinger = (pinger_t*)handle->data;
   fprintf(stderr, "ping_pongs: %d roundtrips/s\n", (1000 * pinger->pongs) / TIME);
-  fflush(stderr);
+  latency_print(stderr, "ping_pongs", &latency);
 
   free(pinger);
 
@@ -103,6 +105,7 @@ static void pinger_write_ping(pinger_t* pinger) {
   buf = uv_buf_init(PING, sizeof(PING) - 1);
 
   req = malloc(sizeof *req);
+  pinger->ping_time = uv_hrtime();
   if (uv_write(req, (uv_stream_t*) &pinger->tcp, &buf, 1, pinger_write_cb)) {
     FATAL("uv_write failed");
   }
@@ -148,6 +151,7 @@ static void pinger_read_cb(uv_stream_t* tcp,
     pinger->state = (pinger->state + 1) % (sizeof(PING) - 1);
     if (pinger->state == 0) {
       pinger->pongs++;
+      latency_record(&latency, uv_hrtime() - pinger->ping_time);
       if (uv_now(loop) - start_time > TIME) {
         uv_shutdown(&pinger->shutdown_req,
                     (uv_stream_t*) tcp,
@@ -209,6 +213,7 @@ static void pinger_new(void) {
 BENCHMARK_IMPL(ping_pongs) {
   loop = uv_default_loop();
 
+  latency_init(&latency);
   start_time = uv_now(loop);
 
   pinger_new();
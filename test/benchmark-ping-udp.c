@@ -31,6 +31,7 @@
 typedef struct {
   int pongs;
   int state;
+  uint64_t ping_time;
   uv_udp_t udp;
   struct sockaddr_in server_addr;
 } pinger_t;
@@ -47,6 +48,7 @@ static uv_loop_t* loop;
 static int completed_pingers;
 static unsigned long completed_pings;
 static int64_t start_time;
+static latency_hist_t latency;
 
 
 static void buf_alloc(uv_handle_t* tcp, size_t size, uv_buf_t* buf) {
@@ -79,6 +81,7 @@ static void pinger_write_ping(pinger_t* pinger) {
   int r;
 
   buf = uv_buf_init(PING, sizeof(PING) - 1);
+  pinger->ping_time = uv_hrtime();
   r = uv_udp_try_send(&pinger->udp, &buf, 1,
                       (const struct sockaddr*) &pinger->server_addr);
   if (r < 0)
@@ -103,6 +106,7 @@ static void pinger_read_cb(uv_udp_t* udp,
     pinger->state = (pinger->state + 1) % (sizeof(PING) - 1);
     if (pinger->state == 0) {
       pinger->pongs++;
+      latency_record(&latency, uv_hrtime() - pinger->ping_time);
       if (uv_now(loop) - start_time > TIME) {
         uv_close((uv_handle_t*)udp, pinger_close_cb);
         break;
@@ -142,6 +146,7 @@ static int ping_udp(unsigned pingers) {
   unsigned i;
 
   loop = uv_default_loop();
+  latency_init(&latency);
   start_time = uv_now(loop);
 
   for (i = 0; i < pingers; ++i) {
@@ -152,6 +157,7 @@ static int ping_udp(unsigned pingers) {
 
   fprintf(stderr, "ping_pongs: %d pingers, ~ %lu roundtrips/s\n",
           completed_pingers, completed_pings / (TIME/1000));
+  latency_print(stderr, "ping_pongs", &latency);
 
   MAKE_VALGRIND_HAPPY();
   return 0;
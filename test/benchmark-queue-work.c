@@ -66,3 +66,148 @@ BENCHMARK_IMPL(queue_work) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+#define NUM_INFLIGHT 64
+
+struct producer_work {
+  uv_work_t req;
+  uint64_t submitted;
+  uint64_t started;
+};
+
+struct producer {
+  uv_loop_t loop;
+  uv_timer_t timer;
+  struct producer_work work[NUM_INFLIGHT];
+  latency_hist_t latency;
+  unsigned events;
+  int done;
+};
+
+
+static void producer_submit(struct producer* p, struct producer_work* w);
+
+
+static void producer_work_cb(uv_work_t* req) {
+  struct producer_work* w;
+  volatile unsigned i;
+
+  w = container_of(req, struct producer_work, req);
+  w->started = uv_hrtime();
+  for (i = 0; i < 256; i++);
+}
+
+
+static void producer_after_work_cb(uv_work_t* req, int status) {
+  struct producer_work* w;
+  struct producer* p;
+
+  w = container_of(req, struct producer_work, req);
+  p = req->data;
+  p->events++;
+  latency_record(&p->latency, w->started - w->submitted);
+  if (!p->done)
+    producer_submit(p, w);
+}
+
+
+static void producer_submit(struct producer* p, struct producer_work* w) {
+  w->req.data = p;
+  w->submitted = uv_hrtime();
+  ASSERT_EQ(0, uv_queue_work(&p->loop,
+                             &w->req,
+                             producer_work_cb,
+                             producer_after_work_cb));
+}
+
+
+static void producer_timer_cb(uv_timer_t* handle) {
+  struct producer* p;
+
+  p = handle->data;
+  p->done = 1;
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void producer_thread(void* arg) {
+  struct producer* p;
+  unsigned i;
+
+  p = arg;
+  ASSERT_EQ(0, uv_timer_init(&p->loop, &p->timer));
+  p->timer.data = p;
+  ASSERT_EQ(0, uv_timer_start(&p->timer, producer_timer_cb, 5000, 0));
+
+  for (i = 0; i < NUM_INFLIGHT; i++)
+    producer_submit(p, &p->work[i]);
+
+  ASSERT_EQ(0, uv_run(&p->loop, UV_RUN_DEFAULT));
+}
+
+
+/* Several loops hammering the same pool. Compare runs with and without
+ * UV_THREADPOOL_WORK_STEALING=1 in the environment. Latency is the time
+ * from uv_queue_work() to the work callback starting on a pool thread.
+ */
+static int queue_work_multi_producer(int nproducers) {
+  struct producer* producers;
+  uv_thread_t* threads;
+  latency_hist_t* latency;
+  unsigned events;
+  int i;
+
+  producers = calloc(nproducers, sizeof(producers[0]));
+  threads = calloc(nproducers, sizeof(threads[0]));
+  latency = malloc(sizeof(*latency));
+  ASSERT_NOT_NULL(producers);
+  ASSERT_NOT_NULL(threads);
+  ASSERT_NOT_NULL(latency);
+
+  for (i = 0; i < nproducers; i++) {
+    latency_init(&producers[i].latency);
+    ASSERT_EQ(0, uv_loop_init(&producers[i].loop));
+    configure_loop_from_env(&producers[i].loop);
+    ASSERT_EQ(0, uv_thread_create(&threads[i],
+                                  producer_thread,
+                                  &producers[i]));
+  }
+
+  events = 0;
+  latency_init(latency);
+  for (i = 0; i < nproducers; i++) {
+    ASSERT_EQ(0, uv_thread_join(&threads[i]));
+    events += producers[i].events;
+    latency_merge(latency, &producers[i].latency);
+    ASSERT_EQ(0, uv_loop_close(&producers[i].loop));
+  }
+
+  printf("%d producers: %s async jobs in 5.0 seconds (%s/s)\n",
+         nproducers,
+         fmt(events),
+         fmt(events / 5.));
+  latency_print(stdout, "submit to start", latency);
+
+  free(latency);
+  free(threads);
+  free(producers);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+BENCHMARK_IMPL(queue_work_multi_producer) {
+  return queue_work_multi_producer(4);
+}
+
+
+BENCHMARK_IMPL(queue_work_multi_producer16) {
+  return queue_work_multi_producer(16);
+}
+
+
+BENCHMARK_IMPL(queue_work_multi_producer64) {
+  return queue_work_multi_producer(64);
+}
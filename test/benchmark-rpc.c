@@ -0,0 +1,329 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* An HTTP-like RPC server: many connections send small requests, possibly
+ * pipelined, and every response goes out as three small writes. The server
+ * runs its own loop on a separate thread. UV_BENCHMARK_RPC_CONNECTIONS and
+ * UV_BENCHMARK_RPC_DEPTH override the connection count and the number of
+ * requests each connection keeps in flight.
+ */
+
+#include "task.h"
+#include "uv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Run the benchmark for this many ms */
+#define TIME 5000
+#define MAX_DEPTH 64
+
+static const char request[] = "GET /ping HTTP/1.1\r\nHost: localhost\r\n\r\n";
+static const char response_head[] =
+    "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: 13\r\n\r\n";
+static const char response_body1[] = "Hello, ";
+static const char response_body2[] = "world!";
+
+#define REQUEST_LEN (sizeof(request) - 1)
+#define RESPONSE_LEN (sizeof(response_head) - 1 +                             \
+                      sizeof(response_body1) - 1 +                            \
+                      sizeof(response_body2) - 1)
+
+struct server_conn {
+  uv_tcp_t tcp;
+  unsigned int matched;  /* Bytes of "\r\n\r\n" seen so far. */
+};
+
+struct client_conn {
+  uv_tcp_t tcp;
+  uv_connect_t connect_req;
+  uint64_t sent[MAX_DEPTH];
+  unsigned int head;
+  unsigned int inflight;
+  size_t nread;
+};
+
+static uv_loop_t server_loop;
+static uv_tcp_t server;
+static uv_async_t server_stop;
+static uv_thread_t server_thread;
+static struct sockaddr_storage server_addr;
+
+static uv_loop_t* loop;
+static uv_timer_t timer;
+static struct client_conn* clients;
+static unsigned int num_clients;
+static unsigned int closed_clients;
+static unsigned int depth;
+static int done;
+static uint64_t responses;
+static latency_hist_t latency;
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  buf->base = malloc(size);
+  buf->len = size;
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0 || status == UV_ECANCELED || status == UV_EPIPE ||
+         status == UV_ECONNRESET);
+  free(req);
+}
+
+
+static void write_str(uv_stream_t* stream, const char* s, size_t len) {
+  uv_write_t* req;
+  uv_buf_t buf;
+
+  req = malloc(sizeof(*req));
+  ASSERT_NOT_NULL(req);
+  buf = uv_buf_init((char*) s, len);
+  ASSERT_EQ(0, uv_write(req, stream, &buf, 1, write_cb));
+}
+
+
+static void server_close_cb(uv_handle_t* handle) {
+  free(container_of((uv_tcp_t*) handle, struct server_conn, tcp));
+}
+
+
+static void server_read_cb(uv_stream_t* stream,
+                           ssize_t nread,
+                           const uv_buf_t* buf) {
+  static const char eom[] = "\r\n\r\n";
+  struct server_conn* conn;
+  ssize_t i;
+
+  conn = container_of((uv_tcp_t*) stream, struct server_conn, tcp);
+
+  if (nread < 0) {
+    free(buf->base);
+    uv_close((uv_handle_t*) stream, server_close_cb);
+    return;
+  }
+
+  /* The request is done at the first empty line. */
+  for (i = 0; i < nread; i++) {
+    if (buf->base[i] == eom[conn->matched])
+      conn->matched++;
+    else
+      conn->matched = buf->base[i] == eom[0];
+
+    if (conn->matched < sizeof(eom) - 1)
+      continue;
+
+    conn->matched = 0;
+    write_str(stream, response_head, sizeof(response_head) - 1);
+    write_str(stream, response_body1, sizeof(response_body1) - 1);
+    write_str(stream, response_body2, sizeof(response_body2) - 1);
+  }
+
+  free(buf->base);
+}
+
+
+static void server_connection_cb(uv_stream_t* handle, int status) {
+  struct server_conn* conn;
+
+  ASSERT_EQ(0, status);
+  conn = calloc(1, sizeof(*conn));
+  ASSERT_NOT_NULL(conn);
+  ASSERT_EQ(0, uv_tcp_init(handle->loop, &conn->tcp));
+  ASSERT_EQ(0, uv_accept(handle, (uv_stream_t*) &conn->tcp));
+  ASSERT_EQ(0, uv_tcp_nodelay(&conn->tcp, 1));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &conn->tcp,
+                             alloc_cb,
+                             server_read_cb));
+}
+
+
+/* Connections close when the clients hang up. */
+static void server_stop_cb(uv_async_t* handle) {
+  uv_close((uv_handle_t*) &server, NULL);
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void server_run(void* arg) {
+  ASSERT_EQ(0, uv_run(&server_loop, UV_RUN_DEFAULT));
+}
+
+
+static void server_start(void) {
+  int namelen;
+
+  ASSERT_EQ(0, uv_loop_init(&server_loop));
+  configure_loop_from_env(&server_loop);
+  ASSERT_EQ(0, uv_async_init(&server_loop, &server_stop, server_stop_cb));
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1",
+                           0,
+                           (struct sockaddr_in*) &server_addr));
+  ASSERT_EQ(0, uv_tcp_init(&server_loop, &server));
+  ASSERT_EQ(0, uv_tcp_bind(&server, (struct sockaddr*) &server_addr, 0));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 511, server_connection_cb));
+  namelen = sizeof(server_addr);
+  ASSERT_EQ(0, uv_tcp_getsockname(&server,
+                                  (struct sockaddr*) &server_addr,
+                                  &namelen));
+  ASSERT_EQ(0, uv_thread_create(&server_thread, server_run, NULL));
+}
+
+
+static void client_close_cb(uv_handle_t* handle) {
+  if (++closed_clients == num_clients)
+    ASSERT_EQ(0, uv_async_send(&server_stop));
+}
+
+
+static void client_send(struct client_conn* c) {
+  c->sent[(c->head + c->inflight) % depth] = uv_hrtime();
+  c->inflight++;
+  write_str((uv_stream_t*) &c->tcp, request, REQUEST_LEN);
+}
+
+
+static void client_read_cb(uv_stream_t* stream,
+                           ssize_t nread,
+                           const uv_buf_t* buf) {
+  struct client_conn* c;
+  uint64_t now;
+
+  c = container_of((uv_tcp_t*) stream, struct client_conn, tcp);
+  ASSERT_GE(nread, 0);
+
+  now = uv_hrtime();
+  c->nread += nread;
+  while (c->nread >= RESPONSE_LEN) {
+    ASSERT_GT(c->inflight, 0);
+    c->nread -= RESPONSE_LEN;
+    latency_record(&latency, now - c->sent[c->head]);
+    c->head = (c->head + 1) % depth;
+    c->inflight--;
+    responses++;
+    if (!done)
+      client_send(c);
+  }
+
+  free(buf->base);
+
+  if (done && c->inflight == 0)
+    uv_close((uv_handle_t*) stream, client_close_cb);
+}
+
+
+static void client_connect_cb(uv_connect_t* req, int status) {
+  struct client_conn* c;
+  unsigned int i;
+
+  c = container_of(req, struct client_conn, connect_req);
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &c->tcp,
+                             alloc_cb,
+                             client_read_cb));
+  for (i = 0; i < depth; i++)
+    client_send(c);
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  unsigned int i;
+
+  done = 1;
+  for (i = 0; i < num_clients; i++)
+    if (clients[i].inflight == 0)
+      uv_close((uv_handle_t*) &clients[i].tcp, client_close_cb);
+}
+
+
+static unsigned int env_uint(const char* name, unsigned int def) {
+  const char* val;
+  int n;
+
+  val = getenv(name);
+  n = val != NULL ? atoi(val) : 0;
+  return n > 0 ? (unsigned int) n : def;
+}
+
+
+static int rpc(const char* name,
+               unsigned int nconnections,
+               unsigned int pipeline_depth) {
+  uint64_t t;
+  unsigned int i;
+
+  num_clients = env_uint("UV_BENCHMARK_RPC_CONNECTIONS", nconnections);
+  depth = env_uint("UV_BENCHMARK_RPC_DEPTH", pipeline_depth);
+  if (depth > MAX_DEPTH)
+    depth = MAX_DEPTH;
+
+  latency_init(&latency);
+  server_start();
+
+  loop = uv_default_loop();
+  clients = calloc(num_clients, sizeof(clients[0]));
+  ASSERT_NOT_NULL(clients);
+
+  for (i = 0; i < num_clients; i++) {
+    ASSERT_EQ(0, uv_tcp_init(loop, &clients[i].tcp));
+    ASSERT_EQ(0, uv_tcp_nodelay(&clients[i].tcp, 1));
+    ASSERT_EQ(0, uv_tcp_connect(&clients[i].connect_req,
+                                &clients[i].tcp,
+                                (struct sockaddr*) &server_addr,
+                                client_connect_cb));
+  }
+
+  ASSERT_EQ(0, uv_timer_init(loop, &timer));
+  ASSERT_EQ(0, uv_timer_start(&timer, timer_cb, TIME, 0));
+  uv_unref((uv_handle_t*) &timer);
+
+  t = uv_hrtime();
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  t = uv_hrtime() - t;
+
+  ASSERT_EQ(0, uv_thread_join(&server_thread));
+  ASSERT_EQ(0, uv_loop_close(&server_loop));
+
+  printf("%s: %u connections, depth %u: %s req/s\n",
+         name,
+         num_clients,
+         depth,
+         fmt(responses / (t / 1e9)));
+  latency_print(stdout, name, &latency);
+
+  uv_close((uv_handle_t*) &timer, NULL);
+  free(clients);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+BENCHMARK_IMPL(rpc) {
+  return rpc("rpc", 100, 1);
+}
+
+
+BENCHMARK_IMPL(rpc_pipelined) {
+  return rpc("rpc_pipelined", 100, 8);
+}
@@ -134,9 +134,20 @@ static void spawn(void) {
 }
 
 
-BENCHMARK_IMPL(spawn) {
+static int spawn_bench(const char* name, size_t ballast_size) {
   int r;
   static int64_t start_time, end_time;
+  char* ballast;
+
+  /* Touch every page so the parent has a large resident set that fork()
+   * would have to copy the page tables of.
+   */
+  ballast = NULL;
+  if (ballast_size > 0) {
+    ballast = malloc(ballast_size);
+    ASSERT_NOT_NULL(ballast);
+    memset(ballast, 1, ballast_size);
+  }
 
   loop = uv_default_loop();
 
@@ -155,10 +166,23 @@ BENCHMARK_IMPL(spawn) {
   uv_update_time(loop);
   end_time = uv_now(loop);
 
-  fprintf(stderr, "spawn: %.0f spawns/s\n",
+  fprintf(stderr, "%s: %.0f spawns/s\n",
+          name,
           (double) N / (double) (end_time - start_time) * 1000.0);
   fflush(stderr);
 
+  free(ballast);
+
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+BENCHMARK_IMPL(spawn) {
+  return spawn_bench("spawn", 0);
+}
+
+
+BENCHMARK_IMPL(spawn_large_rss) {
+  return spawn_bench("spawn_large_rss", (size_t) 1024 * 1024 * 1024);
+}
@@ -0,0 +1,261 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Short-lived connections: the servers accept and immediately close every
+ * connection, the client reconnects as soon as it sees EOF. Measures the
+ * cost of accept, uv_close() and the close callback on the server side.
+ */
+
+#include "task.h"
+#include "uv.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Run the benchmark for this many ms */
+#define TIME 5000
+#define MAX_SERVERS 8
+#define NUM_CONNECTING 128
+
+struct server_ctx {
+  uv_loop_t loop;
+  uv_thread_t thread;
+  uv_tcp_t server;
+  uv_async_t stop;
+  uv_sem_t ready;
+  uint64_t accepted;
+};
+
+struct client_conn {
+  uv_tcp_t tcp;
+  uv_connect_t connect_req;
+};
+
+static struct server_ctx servers[MAX_SERVERS];
+static struct client_conn conns[NUM_CONNECTING];
+static struct sockaddr_in listen_addr;
+static unsigned int accept_batch;
+static unsigned int flags;
+static uv_loop_t* loop;
+static uint64_t start_time;
+static uint64_t connections;
+
+
+static void server_close_cb(uv_handle_t* handle) {
+  free(handle);
+}
+
+
+static void server_connection_cb(uv_stream_t* handle, int status) {
+  struct server_ctx* ctx;
+  uv_tcp_t* conn;
+
+  ctx = container_of((uv_tcp_t*) handle, struct server_ctx, server);
+  if (status != 0)
+    return;  /* The client went away before we got to it. */
+
+  conn = malloc(sizeof(*conn));
+  ASSERT_NOT_NULL(conn);
+  ASSERT_EQ(0, uv_tcp_init(handle->loop, conn));
+  ASSERT_EQ(0, uv_accept(handle, (uv_stream_t*) conn));
+  uv_close((uv_handle_t*) conn, server_close_cb);
+  ctx->accepted++;
+}
+
+
+static void server_stop_cb(uv_async_t* handle) {
+  struct server_ctx* ctx;
+
+  ctx = container_of(handle, struct server_ctx, stop);
+  uv_close((uv_handle_t*) &ctx->server, NULL);
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void server_run(void* arg) {
+  struct server_ctx* ctx;
+
+  ctx = arg;
+  ASSERT_EQ(0, uv_loop_init(&ctx->loop));
+  configure_loop_from_env(&ctx->loop);
+  if (accept_batch > 1)
+    ASSERT_EQ(0, uv_loop_configure(&ctx->loop,
+                                   UV_LOOP_ACCEPT_BATCH,
+                                   accept_batch));
+  ASSERT_EQ(0, uv_async_init(&ctx->loop, &ctx->stop, server_stop_cb));
+  ASSERT_EQ(0, uv_tcp_init(&ctx->loop, &ctx->server));
+  ASSERT_EQ(0, uv_tcp_bind(&ctx->server,
+                           (const struct sockaddr*) &listen_addr,
+                           flags));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &ctx->server,
+                         511,
+                         server_connection_cb));
+  uv_sem_post(&ctx->ready);
+
+  ASSERT_EQ(0, uv_run(&ctx->loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, uv_loop_close(&ctx->loop));
+}
+
+
+static void client_connect(struct client_conn* c);
+
+
+static void client_close_cb(uv_handle_t* handle) {
+  struct client_conn* c;
+
+  c = container_of((uv_tcp_t*) handle, struct client_conn, tcp);
+  connections++;
+  if (uv_now(loop) - start_time < TIME)
+    client_connect(c);
+}
+
+
+static void client_alloc_cb(uv_handle_t* handle,
+                            size_t suggested_size,
+                            uv_buf_t* buf) {
+  static char slab[64];
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void client_read_cb(uv_stream_t* stream,
+                           ssize_t nread,
+                           const uv_buf_t* buf) {
+  if (nread == 0)
+    return;
+
+  /* EOF, or a reset when the server closed before it saw the data. */
+  ASSERT_LT(nread, 0);
+  uv_close((uv_handle_t*) stream, client_close_cb);
+}
+
+
+static void client_connect_cb(uv_connect_t* req, int status) {
+  struct client_conn* c;
+
+  c = container_of(req, struct client_conn, connect_req);
+  if (status != 0) {
+    uv_close((uv_handle_t*) &c->tcp, client_close_cb);
+    return;
+  }
+
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &c->tcp,
+                             client_alloc_cb,
+                             client_read_cb));
+}
+
+
+static void client_connect(struct client_conn* c) {
+  ASSERT_EQ(0, uv_tcp_init(loop, &c->tcp));
+  ASSERT_EQ(0, uv_tcp_connect(&c->connect_req,
+                              &c->tcp,
+                              (const struct sockaddr*) &listen_addr,
+                              client_connect_cb));
+}
+
+
+static int tcp_churn(unsigned int nservers,
+                     unsigned int batch,
+                     unsigned int bind_flags) {
+  uv_rusage_t before;
+  uv_rusage_t after;
+  uint64_t accepted;
+  double cpu;
+  double secs;
+  uint64_t t;
+  unsigned int i;
+
+  ASSERT_LE(nservers, MAX_SERVERS);
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &listen_addr));
+  accept_batch = batch;
+  flags = bind_flags;
+  loop = uv_default_loop();
+
+  for (i = 0; i < nservers; i++) {
+    ASSERT_EQ(0, uv_sem_init(&servers[i].ready, 0));
+    ASSERT_EQ(0, uv_thread_create(&servers[i].thread,
+                                  server_run,
+                                  servers + i));
+    uv_sem_wait(&servers[i].ready);
+    uv_sem_destroy(&servers[i].ready);
+  }
+
+  ASSERT_EQ(0, uv_getrusage(&before));
+  t = uv_hrtime();
+  uv_update_time(loop);
+  start_time = uv_now(loop);
+
+  for (i = 0; i < NUM_CONNECTING; i++)
+    client_connect(conns + i);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+
+  secs = (uv_hrtime() - t) / 1e9;
+  ASSERT_EQ(0, uv_getrusage(&after));
+
+  accepted = 0;
+  for (i = 0; i < nservers; i++) {
+    ASSERT_EQ(0, uv_async_send(&servers[i].stop));
+    ASSERT_EQ(0, uv_thread_join(&servers[i].thread));
+    accepted += servers[i].accepted;
+  }
+
+  /* Process CPU time, so the client's share is included. */
+  cpu = (after.ru_utime.tv_sec - before.ru_utime.tv_sec) * 1e6 +
+        (after.ru_utime.tv_usec - before.ru_utime.tv_usec) +
+        (after.ru_stime.tv_sec - before.ru_stime.tv_sec) * 1e6 +
+        (after.ru_stime.tv_usec - before.ru_stime.tv_usec);
+
+  printf("tcp_churn: %u server loop%s%s%s: %s connections/s, "
+         "%s accepted, %.1f us CPU per connection\n",
+         nservers,
+         nservers == 1 ? "" : "s",
+         batch > 1 ? ", batch accept" : "",
+         bind_flags & UV_TCP_REUSEPORT ? ", reuseport" : "",
+         fmt(connections / secs),
+         fmt(accepted),
+         connections > 0 ? cpu / connections : 0.0);
+  fflush(stdout);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+BENCHMARK_IMPL(tcp_churn) {
+  return tcp_churn(1, 1, 0);
+}
+
+
+BENCHMARK_IMPL(tcp_churn_batch) {
+#ifdef _WIN32
+  RETURN_SKIP("UV_LOOP_ACCEPT_BATCH is not supported on Windows");
+#endif
+  return tcp_churn(1, 64, 0);
+}
+
+
+BENCHMARK_IMPL(tcp_churn4_reuseport) {
+#ifdef _WIN32
+  RETURN_SKIP("UV_TCP_REUSEPORT is not supported on Windows");
+#endif
+  return tcp_churn(4, 1, UV_TCP_REUSEPORT);
+}
@@ -0,0 +1,183 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* Idle timeouts that are re-armed far more often than they fire, the way
+ * servers push back a connection's timeout on every read.
+ */
+
+#include "task.h"
+#include "uv.h"
+
+#define NUM_TIMERS (1000 * 1000)
+#define NUM_OPS (10 * 1000 * 1000)
+#define BATCH 10000
+
+enum churn_mode {
+  CHURN_RESTART,
+  CHURN_CANCEL,
+  CHURN_MIXED
+};
+
+static uv_timer_t* timers;
+static uv_idle_t idle;
+static enum churn_mode mode;
+static unsigned int ops;
+static unsigned int timer_cb_called;
+
+
+static unsigned int fastrand(void) {
+  static unsigned int g = 0;
+  g = g * 214013 + 2531011;
+  return g >> 8;
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  timer_cb_called++;
+
+  /* Short timers in the mixed workload go straight back in. */
+  if (mode == CHURN_MIXED && uv_timer_get_repeat(handle) == 0)
+    ASSERT_EQ(0, uv_timer_start(handle, timer_cb, 10 + fastrand() % 90, 0));
+}
+
+
+static void churn_one(void) {
+  uv_timer_t* t;
+
+  t = timers + fastrand() % NUM_TIMERS;
+
+  switch (mode) {
+    case CHURN_RESTART:
+      ASSERT_EQ(0, uv_timer_again(t));
+      break;
+
+    case CHURN_CANCEL:
+      /* Arm one with a random deadline, cancel another. */
+      ASSERT_EQ(0, uv_timer_start(t, timer_cb, 1000 + fastrand() % 59000, 0));
+      ASSERT_EQ(0, uv_timer_stop(timers + fastrand() % NUM_TIMERS));
+      break;
+
+    case CHURN_MIXED:
+      if (uv_timer_get_repeat(t) != 0)
+        ASSERT_EQ(0, uv_timer_again(t));
+      break;
+  }
+}
+
+
+static void idle_cb(uv_idle_t* handle) {
+  int i;
+
+  for (i = 0; i < BATCH; i++)
+    churn_one();
+
+  ops += BATCH;
+  if (ops < NUM_OPS)
+    return;
+
+  for (i = 0; i < NUM_TIMERS; i++)
+    uv_close((uv_handle_t*) (timers + i), NULL);
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static int timer_churn(enum churn_mode m, int use_timer_wheel) {
+  uv_loop_t loop;
+  uint64_t timeout;
+  uint64_t before;
+  uint64_t after;
+  int i;
+
+  timers = malloc(NUM_TIMERS * sizeof(timers[0]));
+  ASSERT_NOT_NULL(timers);
+  mode = m;
+  ops = 0;
+  timer_cb_called = 0;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  configure_loop_from_env(&loop);
+  if (use_timer_wheel)
+    ASSERT_EQ(0, uv_loop_configure(&loop, UV_LOOP_USE_TIMER_WHEEL));
+
+  /* Long idle timeouts between 10 and 60 seconds that are pushed back
+   * before they expire. In the mixed workload, one in a hundred timers is a
+   * short one-shot that fires and gets re-armed.
+   */
+  for (i = 0; i < NUM_TIMERS; i++) {
+    timeout = 10000 + fastrand() % 50000;
+    ASSERT_EQ(0, uv_timer_init(&loop, timers + i));
+    if (mode == CHURN_MIXED && i % 100 == 0)
+      ASSERT_EQ(0, uv_timer_start(timers + i, timer_cb, 10 + i % 90, 0));
+    else if (mode != CHURN_CANCEL || i % 2 == 0)
+      ASSERT_EQ(0, uv_timer_start(timers + i, timer_cb, timeout, timeout));
+  }
+
+  ASSERT_EQ(0, uv_idle_init(&loop, &idle));
+  ASSERT_EQ(0, uv_idle_start(&idle, idle_cb));
+
+  before = uv_hrtime();
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  after = uv_hrtime();
+
+  fprintf(stderr,
+          "%s operations in %.2f seconds (%s/s), %s timers fired\n",
+          fmt(ops),
+          (after - before) / 1e9,
+          fmt(ops / ((after - before) / 1e9)),
+          fmt(timer_cb_called));
+  fflush(stderr);
+
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  free(timers);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+BENCHMARK_IMPL(timer_churn_restart) {
+  return timer_churn(CHURN_RESTART, 0);
+}
+
+
+BENCHMARK_IMPL(timer_churn_restart_wheel) {
+  return timer_churn(CHURN_RESTART, 1);
+}
+
+
+BENCHMARK_IMPL(timer_churn_cancel) {
+  return timer_churn(CHURN_CANCEL, 0);
+}
+
+
+BENCHMARK_IMPL(timer_churn_cancel_wheel) {
+  return timer_churn(CHURN_CANCEL, 1);
+}
+
+
+BENCHMARK_IMPL(timer_churn_mixed) {
+  return timer_churn(CHURN_MIXED, 0);
+}
+
+
+BENCHMARK_IMPL(timer_churn_mixed_wheel) {
+  return timer_churn(CHURN_MIXED, 1);
+}
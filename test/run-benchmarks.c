@@ -40,11 +40,15 @@ __attribute__((constructor)) void init() {
 
 
 static int maybe_run_test(int argc, char **argv);
+static int run_backends(const char* name, const char* csv_path);
 
 
 int main(int argc, char **argv) {
   platform_init(argc, argv);
 
+  if (argc >= 3 && argc <= 4 && strcmp(argv[1], "--backends") == 0)
+    return run_backends(argv[2], argc == 4 ? argv[3] : NULL);
+
   switch (argc) {
   case 1: return run_tests(1);
   case 2: return maybe_run_test(argc, argv);
@@ -70,3 +74,121 @@ static int maybe_run_test(int argc, char **argv) {
 
   return run_test(argv[1], 1, 1);
 }
+
+
+/* Environment variables that switch the benchmarks' loops to another
+ * backend, see configure_loop_from_env() and the threadpool.
+ */
+static const struct {
+  const char* name;
+  const char* env;
+  uv_loop_option option;
+} backends[] = {
+  { "default", NULL, 0 },
+  { "io_uring", "UV_USE_IO_URING", UV_LOOP_USE_IO_URING },
+  { "timer_wheel", "UV_USE_TIMER_WHEEL", UV_LOOP_USE_TIMER_WHEEL },
+  { "edge_triggered", "UV_USE_EDGE_TRIGGERED", UV_LOOP_EDGE_TRIGGERED },
+  { "work_stealing", "UV_THREADPOOL_WORK_STEALING", 0 },
+};
+
+
+static int backend_available(unsigned int i) {
+  uv_loop_t loop;
+  int err;
+
+  if (backends[i].option == 0)
+    return 1;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  err = uv_loop_configure(&loop, backends[i].option);
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  return err == 0;
+}
+
+
+static void csv_print_row(FILE* csv,
+                          const char* benchmark,
+                          const char* backend,
+                          int status,
+                          double seconds,
+                          const char* result) {
+  const char* p;
+
+  fprintf(csv, "%s,%s,%d,%.3f,\"", benchmark, backend, status, seconds);
+  for (p = result; *p != '\0'; p++) {
+    if (*p == '"')
+      fputc('"', csv);
+    fputc(*p, csv);
+  }
+  fprintf(csv, "\"\n");
+  fflush(csv);
+}
+
+
+/* Runs benchmark |name|, or every benchmark if it is "all", once per
+ * available backend and writes a CSV table with the exit status, the wall
+ * clock time and what the benchmark printed.
+ */
+static int run_backends(const char* name, const char* csv_path) {
+  task_entry_t* task;
+  unsigned int i;
+  uint64_t t;
+  FILE* csv;
+  int status;
+  int failed;
+  int count;
+
+  csv = stdout;
+  if (csv_path != NULL) {
+    csv = fopen(csv_path, "w");
+    if (csv == NULL) {
+      fprintf(stderr, "Can't open %s\n", csv_path);
+      return EXIT_FAILURE;
+    }
+  }
+
+  fprintf(csv, "benchmark,backend,status,seconds,result\n");
+
+  failed = 0;
+  count = 0;
+  for (i = 0; i < ARRAY_SIZE(backends); i++) {
+    if (!backend_available(i))
+      continue;
+
+    if (backends[i].env != NULL)
+      ASSERT_EQ(0, uv_os_setenv(backends[i].env, "1"));
+
+    for (task = TASKS; task->main; task++) {
+      if (task->is_helper)
+        continue;
+      if (strcmp(name, "all") != 0 && strcmp(name, task->task_name) != 0)
+        continue;
+
+      t = uv_hrtime();
+      status = run_test(task->task_name, 1, ++count);
+      t = uv_hrtime() - t;
+      if (status != TEST_OK && status != TEST_SKIP)
+        failed++;
+
+      csv_print_row(csv,
+                    task->task_name,
+                    backends[i].name,
+                    status,
+                    t / 1e9,
+                    benchmark_result);
+    }
+
+    if (backends[i].env != NULL)
+      ASSERT_EQ(0, uv_os_unsetenv(backends[i].env));
+  }
+
+  if (csv != stdout)
+    fclose(csv);
+
+  if (count == 0) {
+    fprintf(stderr, "No benchmark with that name: %s\n", name);
+    return EXIT_FAILURE;
+  }
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
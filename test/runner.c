@@ -28,6 +28,110 @@
 #include "uv.h"
 
 char executable_path[sizeof(executable_path)];
+char benchmark_result[sizeof(benchmark_result)];
+
+
+void latency_init(latency_hist_t* h) {
+  memset(h, 0, sizeof(*h));
+  h->min = (uint64_t) -1;
+}
+
+
+static unsigned int latency_bucket(uint64_t value) {
+  unsigned int shift;
+
+  if (value < 2 * LATENCY_SUB_BUCKETS)
+    return (unsigned int) value;
+
+  shift = 0;
+  while ((value >> shift) >= 2 * LATENCY_SUB_BUCKETS)
+    shift++;
+
+  return (shift + 1) * LATENCY_SUB_BUCKETS +
+         (unsigned int) (value >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+
+/* Returns the midpoint of the values that land in |bucket|. */
+static uint64_t latency_bucket_value(unsigned int bucket) {
+  unsigned int shift;
+  uint64_t base;
+
+  if (bucket < 2 * LATENCY_SUB_BUCKETS)
+    return bucket;
+
+  shift = bucket / LATENCY_SUB_BUCKETS - 1;
+  base = (uint64_t) (bucket % LATENCY_SUB_BUCKETS + LATENCY_SUB_BUCKETS);
+  return (base << shift) + ((uint64_t) 1 << shift) / 2;
+}
+
+
+void latency_record(latency_hist_t* h, uint64_t value) {
+  h->buckets[latency_bucket(value)]++;
+  h->count++;
+  if (value < h->min)
+    h->min = value;
+  if (value > h->max)
+    h->max = value;
+}
+
+
+void latency_merge(latency_hist_t* dst, const latency_hist_t* src) {
+  unsigned int i;
+
+  for (i = 0; i < LATENCY_BUCKETS; i++)
+    dst->buckets[i] += src->buckets[i];
+  dst->count += src->count;
+  if (src->min < dst->min)
+    dst->min = src->min;
+  if (src->max > dst->max)
+    dst->max = src->max;
+}
+
+
+uint64_t latency_percentile(const latency_hist_t* h, double percentile) {
+  uint64_t target;
+  uint64_t seen;
+  uint64_t value;
+  unsigned int i;
+
+  if (h->count == 0)
+    return 0;
+
+  target = (uint64_t) (h->count * percentile / 100.0 + 0.5);
+  if (target == 0)
+    target = 1;
+
+  seen = 0;
+  for (i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += h->buckets[i];
+    if (seen >= target)
+      break;
+  }
+
+  value = latency_bucket_value(i);
+  if (value < h->min)
+    return h->min;
+  if (value > h->max)
+    return h->max;
+  return value;
+}
+
+
+void latency_print(FILE* stream, const char* name, const latency_hist_t* h) {
+  fprintf(stream,
+          "%s: %s samples, min %.1f us, p50 %.1f us, p90 %.1f us, "
+          "p99 %.1f us, p99.9 %.1f us, max %.1f us\n",
+          name,
+          fmt((double) h->count),
+          h->count ? h->min / 1e3 : 0.0,
+          latency_percentile(h, 50) / 1e3,
+          latency_percentile(h, 90) / 1e3,
+          latency_percentile(h, 99) / 1e3,
+          latency_percentile(h, 99.9) / 1e3,
+          h->max / 1e3);
+  fflush(stream);
+}
 
 
 static int compare_task(const void* va, const void* vb) {
@@ -74,6 +178,123 @@ const char* fmt(double d) {
 }
 
 
+static void save_benchmark_result(process_info_t* p) {
+  char line[1024];
+  char* s;
+  size_t len;
+  size_t n;
+  FILE* f;
+
+  f = tmpfile();
+  if (f == NULL)
+    return;
+
+  if (process_copy_output(p, f) == 0 && fseek(f, 0, SEEK_SET) == 0) {
+    len = 0;
+    while (fgets(line, sizeof(line), f) != NULL) {
+      /* process_copy_output() prefixes every line with "# ". */
+      line[strcspn(line, "\r\n")] = '\0';
+      s = line;
+      if (strncmp(s, "# ", 2) == 0)
+        s += 2;
+      if (*s == '\0')
+        continue;
+      n = snprintf(benchmark_result + len,
+                   sizeof(benchmark_result) - len,
+                   "%s%s",
+                   len > 0 ? "; " : "",
+                   s);
+      if (n >= sizeof(benchmark_result) - len)
+        break;
+      len += n;
+    }
+  }
+
+  fclose(f);
+}
+
+
+/* Environment variables that run the tests and benchmarks on another
+ * backend without rebuilding them, see run-benchmarks.c.
+ */
+static const struct {
+  const char* env;
+  uv_loop_option option;
+} env_options[] = {
+  { "UV_USE_IO_URING", UV_LOOP_USE_IO_URING },
+  { "UV_USE_TIMER_WHEEL", UV_LOOP_USE_TIMER_WHEEL },
+  { "UV_USE_EDGE_TRIGGERED", UV_LOOP_EDGE_TRIGGERED },
+};
+
+
+static int env_enabled(const char* name) {
+  const char* val;
+
+  val = getenv(name);
+  return val != NULL && atoi(val) != 0;
+}
+
+
+static int port_in_use(uv_loop_t* loop, const struct sockaddr* addr) {
+  uv_tcp_t tcp;
+  uv_udp_t udp;
+  int r;
+
+  ASSERT_EQ(0, uv_tcp_init(loop, &tcp));
+  r = uv_tcp_bind(&tcp, addr, 0);
+  if (r == 0)
+    r = uv_listen((uv_stream_t*) &tcp, 1, NULL);
+  uv_close((uv_handle_t*) &tcp, NULL);
+
+  if (r == 0) {
+    ASSERT_EQ(0, uv_udp_init(loop, &udp));
+    r = uv_udp_bind(&udp, addr, 0);
+    uv_close((uv_handle_t*) &udp, NULL);
+  }
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+
+  return r == UV_EADDRINUSE;
+}
+
+
+/* A test that exits without closing its io_uring loop, like a helper that
+ * is killed, leaves its sockets to the kernel, which releases them when it
+ * is done tearing down the ring. That happens shortly after the process is
+ * gone, wait for it here so that the next test can bind the same ports.
+ */
+static void wait_for_test_ports(void) {
+  static const int ports[] = { TEST_PORT, TEST_PORT_2, TEST_PORT_3 };
+  struct sockaddr_in6 addr6;
+  struct sockaddr_in addr;
+  uv_loop_t loop;
+  unsigned int i;
+  int ipv6;
+  int tries;
+
+  if (!env_enabled("UV_USE_IO_URING"))
+    return;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  ipv6 = can_ipv6();
+
+  for (i = 0; i < ARRAY_SIZE(ports); i++) {
+    ASSERT_EQ(0, uv_ip4_addr("0.0.0.0", ports[i], &addr));
+    ASSERT_EQ(0, uv_ip6_addr("::", ports[i], &addr6));
+
+    for (tries = 0; tries < 100; tries++) {
+      if (!port_in_use(&loop, (const struct sockaddr*) &addr))
+        if (!ipv6 || !port_in_use(&loop, (const struct sockaddr*) &addr6))
+          break;
+
+      uv_sleep(10);
+    }
+  }
+
+  ASSERT_EQ(0, uv_loop_close(&loop));
+}
+
+
 int run_tests(int benchmark_output) {
   int actual;
   int total;
@@ -177,6 +398,7 @@ int run_test(const char* test,
   status = 255;
   main_proc = NULL;
   process_count = 0;
+  benchmark_result[0] = '\0';
 
 #ifndef _WIN32
   /* Clean up stale socket from previous run. */
@@ -302,6 +524,8 @@ out:
     FATAL("process_wait failed");
   }
 
+  wait_for_test_ports();
+
   log_tap_result(test_count, test, status, &processes[i]);
 
   /* Show error and output from processes if the test failed. */
@@ -335,6 +559,8 @@ out:
 
   /* In benchmark mode show concise output from the main process. */
   } else if (benchmark_output) {
+    save_benchmark_result(main_proc);
+
     switch (process_output_size(main_proc)) {
      case -1:
       fprintf(stdout, "%s: (unavailable)\n", test);
@@ -363,6 +589,41 @@ out:
 }
 
 
+static int default_loop_io_uring;
+
+
+/* NULL means the default loop, which is only created when one of the
+ * options is set. The platform may not support them, the loop then stays on
+ * the default backend.
+ */
+void configure_loop_from_env(uv_loop_t* loop) {
+  unsigned int i;
+  int is_default;
+  int r;
+
+  is_default = loop == NULL;
+
+  for (i = 0; i < ARRAY_SIZE(env_options); i++) {
+    if (!env_enabled(env_options[i].env))
+      continue;
+
+    if (loop == NULL)
+      loop = uv_default_loop();
+
+    r = uv_loop_configure(loop, env_options[i].option);
+    ASSERT(r == 0 || r == UV_ENOSYS);
+
+    if (r == 0 && is_default && env_options[i].option == UV_LOOP_USE_IO_URING)
+      default_loop_io_uring = 1;
+  }
+}
+
+
+int default_loop_uses_io_uring(void) {
+  return default_loop_io_uring;
+}
+
+
 /* Returns the status code of the task part
  * or 255 if no matching task was not found.
  */
@@ -373,6 +634,7 @@ int run_test_part(const char* test, const char* part) {
   for (task = TASKS; task->main; task++) {
     if (strcmp(test, task->task_name) == 0 &&
         strcmp(part, task->process_name) == 0) {
+      configure_loop_from_env(NULL);
       r = task->main();
       return r;
     }
@@ -86,6 +86,11 @@ typedef struct {
 
 extern char executable_path[4096];
 
+/* Output of the benchmark that ran last, lines separated by "; ", for the
+ * CSV output of run-benchmarks --backends.
+ */
+extern char benchmark_result[4096];
+
 /*
  * Include platform-dependent definitions
  */
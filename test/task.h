@@ -274,6 +274,38 @@ typedef enum {
 /* Format big numbers nicely. WARNING: leaks memory. */
 const char* fmt(double d);
 
+/* Switch `loop` to the backend that UV_USE_IO_URING, UV_USE_TIMER_WHEEL or
+ * UV_USE_EDGE_TRIGGERED selects. The runner does it for the default loop,
+ * benchmarks call it for the loops they create.
+ */
+void configure_loop_from_env(uv_loop_t* loop);
+
+/* Whether configure_loop_from_env() moved the default loop to io_uring. Its
+ * file system requests are then submitted to the ring, not the threadpool.
+ */
+int default_loop_uses_io_uring(void);
+
+/* Latency recorder for benchmarks. Log-linear buckets, like HdrHistogram,
+ * with 32 sub-buckets per power of two; values are exact up to 63 and
+ * within ~3% above that.
+ */
+#define LATENCY_SUB_BUCKETS 32
+#define LATENCY_BUCKETS (59 * LATENCY_SUB_BUCKETS)
+
+typedef struct {
+  uint64_t count;
+  uint64_t min;
+  uint64_t max;
+  uint64_t buckets[LATENCY_BUCKETS];
+} latency_hist_t;
+
+void latency_init(latency_hist_t* h);
+void latency_record(latency_hist_t* h, uint64_t value);
+void latency_merge(latency_hist_t* dst, const latency_hist_t* src);
+uint64_t latency_percentile(const latency_hist_t* h, double percentile);
+/* Print count, min, p50, p90, p99, p99.9 and max of nanosecond values. */
+void latency_print(FILE* stream, const char* name, const latency_hist_t* h);
+
 /* Reserved test exit codes. */
 enum test_status {
   TEST_OK = 0,
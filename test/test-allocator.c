@@ -0,0 +1,82 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+#include <stdlib.h>
+
+static unsigned int allocs[UV_ALLOC_TAG_MAX];
+
+
+static void* tagged_malloc(size_t size, uv_alloc_tag tag) {
+  ASSERT_LT(tag, UV_ALLOC_TAG_MAX);
+  allocs[tag]++;
+  return malloc(size);
+}
+
+
+static void* tagged_realloc(void* ptr, size_t size, uv_alloc_tag tag) {
+  ASSERT_LT(tag, UV_ALLOC_TAG_MAX);
+  allocs[tag]++;
+  return realloc(ptr, size);
+}
+
+
+static void* tagged_calloc(size_t count, size_t size, uv_alloc_tag tag) {
+  ASSERT_LT(tag, UV_ALLOC_TAG_MAX);
+  allocs[tag]++;
+  return calloc(count, size);
+}
+
+
+static void stat_cb(uv_fs_t* req) {
+  uv_fs_req_cleanup(req);
+}
+
+
+TEST_IMPL(replace_allocator_tagged) {
+  uv_loop_t loop;
+  uv_fs_t req;
+
+  ASSERT_EQ(UV_EINVAL,
+            uv_replace_allocator_tagged(NULL, tagged_realloc,
+                                        tagged_calloc, free));
+  ASSERT_EQ(0, uv_replace_allocator_tagged(tagged_malloc,
+                                           tagged_realloc,
+                                           tagged_calloc,
+                                           free));
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  ASSERT_GT(allocs[UV_ALLOC_TAG_LOOP], 0);
+
+  /* The path is copied for the threadpool. */
+  ASSERT_EQ(0, allocs[UV_ALLOC_TAG_FS]);
+  ASSERT_EQ(0, uv_fs_stat(&loop, &req, ".", stat_cb));
+  ASSERT_GT(allocs[UV_ALLOC_TAG_FS], 0);
+
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, uv_loop_close(&loop));
+
+  ASSERT_EQ(0, uv_replace_allocator(malloc, realloc, calloc, free));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
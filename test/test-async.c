@@ -24,6 +24,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifndef _WIN32
+# include <poll.h>
+#endif
+
 static uv_thread_t thread;
 static uv_mutex_t mutex;
 
@@ -132,3 +136,119 @@ TEST_IMPL(async) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static uv_async_t many_handles[64];
+static int many_cb_called[ARRAY_SIZE(many_handles)];
+static int many_close_cb_called;
+
+
+static void many_close_cb(uv_handle_t* handle) {
+  many_close_cb_called++;
+}
+
+
+static void many_async_cb(uv_async_t* handle) {
+  unsigned int i;
+
+  many_cb_called[handle - many_handles]++;
+  if (many_cb_called[3] + many_cb_called[10] < 2)
+    return;
+
+  for (i = 0; i < ARRAY_SIZE(many_handles); i++)
+    if (!uv_is_closing((uv_handle_t*) &many_handles[i]))
+      uv_close((uv_handle_t*) &many_handles[i], many_close_cb);
+}
+
+
+TEST_IMPL(async_many_handles) {
+  unsigned int i;
+
+  for (i = 0; i < ARRAY_SIZE(many_handles); i++)
+    ASSERT_EQ(0, uv_async_init(uv_default_loop(),
+                               &many_handles[i],
+                               many_async_cb));
+
+  /* Only the signalled handles run their callback, a handle that is closed
+   * while pending doesn't.
+   */
+  ASSERT_EQ(0, uv_async_send(&many_handles[20]));
+  ASSERT_EQ(0, uv_async_send(&many_handles[10]));
+  ASSERT_EQ(0, uv_async_send(&many_handles[3]));
+  ASSERT_EQ(0, uv_async_send(&many_handles[3]));
+  uv_close((uv_handle_t*) &many_handles[20], many_close_cb);
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  for (i = 0; i < ARRAY_SIZE(many_handles); i++)
+    ASSERT_EQ(i == 3 || i == 10, many_cb_called[i]);
+  ASSERT_EQ(ARRAY_SIZE(many_handles), many_close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uv_async_t awake_async;
+static uv_prepare_t awake_prepare;
+static uv_check_t awake_check;
+static int awake_cb_called;
+
+
+static void awake_async_cb(uv_async_t* handle) {
+  awake_cb_called++;
+}
+
+
+static void awake_prepare_cb(uv_prepare_t* handle) {
+  /* Before the poll phase, picked up in the same loop iteration. */
+  ASSERT_EQ(0, uv_async_send(&awake_async));
+  ASSERT_EQ(0, uv_prepare_stop(handle));
+}
+
+
+static void awake_check_cb(uv_check_t* handle) {
+  /* After it, the loop returns before looking at the handle again. */
+  ASSERT_EQ(0, uv_async_send(&awake_async));
+  ASSERT_EQ(0, uv_check_stop(handle));
+}
+
+
+TEST_IMPL(async_send_awake) {
+#ifndef _WIN32
+  struct pollfd pfd;
+#endif
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_async_init(loop, &awake_async, awake_async_cb));
+  ASSERT_EQ(0, uv_prepare_init(loop, &awake_prepare));
+  ASSERT_EQ(0, uv_prepare_start(&awake_prepare, awake_prepare_cb));
+  ASSERT_EQ(0, uv_check_init(loop, &awake_check));
+
+  ASSERT_NE(0, uv_run(loop, UV_RUN_NOWAIT));
+  ASSERT_EQ(1, awake_cb_called);
+
+  ASSERT_EQ(0, uv_check_start(&awake_check, awake_check_cb));
+  ASSERT_NE(0, uv_run(loop, UV_RUN_NOWAIT));
+  ASSERT_EQ(1, awake_cb_called);
+
+#ifndef _WIN32
+  /* Embedders that poll the backend fd in between still get woken up. */
+  pfd.fd = uv_backend_fd(loop);
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  ASSERT_EQ(1, poll(&pfd, 1, 0));
+#endif
+
+  ASSERT_NE(0, uv_run(loop, UV_RUN_NOWAIT));
+  ASSERT_EQ(2, awake_cb_called);
+
+  uv_close((uv_handle_t*) &awake_async, NULL);
+  uv_close((uv_handle_t*) &awake_prepare, NULL);
+  uv_close((uv_handle_t*) &awake_check, NULL);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,94 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+
+TEST_IMPL(tcp_busy_poll) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  uv_tcp_t handle;
+  int r;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_tcp_init(loop, &handle));
+
+  r = uv_tcp_set_busy_poll(&handle, 50);
+  if (r == UV_ENOSYS) {
+    uv_close((uv_handle_t*) &handle, NULL);
+    ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("SO_BUSY_POLL is not supported on this platform.");
+  }
+  ASSERT_EQ(UV_EBADF, r);
+
+  /* The loop's epoll instance is asked to prefer busy polling, too. */
+  ASSERT_EQ(0, uv_loop_configure(loop, UV_LOOP_BUSY_POLL, 50));
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_tcp_bind(&handle, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(UV_EINVAL, uv_tcp_set_busy_poll(&handle, (unsigned int) -1));
+
+  /* Going above net.core.busy_read needs privileges, going down doesn't. */
+  r = uv_tcp_set_busy_poll(&handle, 50);
+  ASSERT(r == 0 || r == UV_EPERM);
+  ASSERT_EQ(0, uv_tcp_set_busy_poll(&handle, 0));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_NOWAIT));
+  uv_close((uv_handle_t*) &handle, NULL);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(udp_busy_poll) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  uv_udp_t handle;
+  int r;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_udp_init(loop, &handle));
+
+  r = uv_udp_set_busy_poll(&handle, 50);
+  if (r == UV_ENOSYS) {
+    uv_close((uv_handle_t*) &handle, NULL);
+    ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("SO_BUSY_POLL is not supported on this platform.");
+  }
+  ASSERT_EQ(UV_EBADF, r);
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_udp_bind(&handle, (const struct sockaddr*) &addr, 0));
+
+  r = uv_udp_set_busy_poll(&handle, 50);
+  ASSERT(r == 0 || r == UV_EPERM);
+  ASSERT_EQ(0, uv_udp_set_busy_poll(&handle, 0));
+
+  uv_close((uv_handle_t*) &handle, NULL);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,96 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_PRODUCERS 4
+#define NUM_MESSAGES 10000
+
+struct producer {
+  uv_thread_t thread;
+  uv_channel_msg_t msgs[NUM_MESSAGES];
+  int received;
+};
+
+static struct producer producers[NUM_PRODUCERS];
+static uv_channel_t channel;
+static int channel_cb_called;
+static int close_cb_called;
+
+
+static void producer_cb(void* arg) {
+  struct producer* p;
+  int i;
+
+  p = arg;
+  for (i = 0; i < NUM_MESSAGES; i++) {
+    p->msgs[i].data = p;
+    ASSERT_EQ(0, uv_channel_send(&channel, &p->msgs[i]));
+  }
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  ASSERT_PTR_EQ(handle, (uv_handle_t*) &channel);
+  close_cb_called++;
+}
+
+
+static void channel_cb(uv_channel_t* handle, uv_channel_msg_t* msg) {
+  struct producer* p;
+
+  ASSERT_PTR_EQ(handle, &channel);
+  p = msg->data;
+
+  /* Messages from one sender arrive in the order they were sent. */
+  ASSERT_PTR_EQ(msg, &p->msgs[p->received]);
+  p->received++;
+
+  if (++channel_cb_called == NUM_PRODUCERS * NUM_MESSAGES)
+    uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+TEST_IMPL(channel) {
+  int i;
+
+  ASSERT_EQ(UV_EINVAL, uv_channel_init(uv_default_loop(), &channel, NULL));
+  ASSERT_EQ(0, uv_channel_init(uv_default_loop(), &channel, channel_cb));
+
+  for (i = 0; i < NUM_PRODUCERS; i++)
+    ASSERT_EQ(0, uv_thread_create(&producers[i].thread,
+                                  producer_cb,
+                                  &producers[i]));
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  for (i = 0; i < NUM_PRODUCERS; i++) {
+    ASSERT_EQ(0, uv_thread_join(&producers[i].thread));
+    ASSERT_EQ(NUM_MESSAGES, producers[i].received);
+  }
+
+  ASSERT_EQ(NUM_PRODUCERS * NUM_MESSAGES, channel_cb_called);
+  ASSERT_EQ(1, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,117 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#ifndef _WIN32
+# include <errno.h>
+# include <fcntl.h>
+# include <sys/socket.h>
+#endif
+
+#define NUM_PIPES 16
+#define NUM_TIMERS 4
+
+static uv_pipe_t pipes[NUM_PIPES];
+static uv_timer_t timers[NUM_TIMERS];
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+TEST_IMPL(close_many) {
+#if defined(_WIN32)
+  RETURN_SKIP("Test uses socket pairs.");
+#else
+  uv_handle_t* handles[NUM_PIPES];
+  uv_os_sock_t socks[2];
+  int fds[NUM_PIPES];
+  uv_loop_t* loop;
+  int i;
+
+  loop = uv_default_loop();
+  for (i = 0; i < NUM_PIPES; i += 2) {
+    ASSERT_EQ(0, uv_socketpair(SOCK_STREAM, 0, socks, 0, 0));
+    fds[i] = socks[0];
+    fds[i + 1] = socks[1];
+  }
+
+  /* Out of order, the batch sorts them into runs for close_range(). */
+  for (i = 0; i < NUM_PIPES; i++) {
+    ASSERT_EQ(0, uv_pipe_init(loop, &pipes[i], 0));
+    ASSERT_EQ(0, uv_pipe_open(&pipes[i], fds[NUM_PIPES - 1 - i]));
+    ASSERT_EQ(0, uv_read_start((uv_stream_t*) &pipes[i],
+                               (uv_alloc_cb) abort,
+                               (uv_read_cb) abort));
+    handles[i] = (uv_handle_t*) &pipes[i];
+  }
+
+  uv_close_many(handles, 0, close_cb);
+  uv_close_many(handles, NUM_PIPES, close_cb);
+  for (i = 0; i < NUM_PIPES; i++) {
+    ASSERT(uv_is_closing(handles[i]));
+    ASSERT_EQ(-1, fcntl(fds[i], F_GETFD));
+    ASSERT_EQ(EBADF, errno);
+  }
+
+  ASSERT_EQ(0, close_cb_called);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_PIPES, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+TEST_IMPL(close_all) {
+  uv_idle_t idle;
+  uv_loop_t* loop;
+  int i;
+
+  loop = uv_default_loop();
+  for (i = 0; i < NUM_TIMERS; i++) {
+    ASSERT_EQ(0, uv_timer_init(loop, &timers[i]));
+    ASSERT_EQ(0, uv_timer_start(&timers[i], (uv_timer_cb) abort, 1000, 0));
+  }
+  ASSERT_EQ(0, uv_idle_init(loop, &idle));
+
+  ASSERT_EQ(UV_EINVAL, uv_close_all(loop, UV_HANDLE_TYPE_MAX, close_cb));
+  ASSERT_EQ(0, uv_close_all(loop, UV_TTY, close_cb));
+
+  ASSERT_EQ(NUM_TIMERS, uv_close_all(loop, UV_TIMER, close_cb));
+  ASSERT(!uv_is_closing((uv_handle_t*) &idle));
+  /* Nothing left of that type, closing ones don't count. */
+  ASSERT_EQ(0, uv_close_all(loop, UV_TIMER, close_cb));
+
+  ASSERT_EQ(1, uv_close_all(loop, UV_UNKNOWN_HANDLE, close_cb));
+  ASSERT(uv_is_closing((uv_handle_t*) &idle));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_TIMERS + 1, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,110 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+static uv_fs_t fs_reqs[3];
+static uv_work_t work_reqs[2];
+static int tokens[5];
+static int ready_cb_called;
+static int seen;
+
+
+static void work_cb(uv_work_t* req) {
+}
+
+
+static void take(uv_completion_t* c, size_t n) {
+  size_t i;
+  int* token;
+
+  for (i = 0; i < n; i++) {
+    token = c[i].token;
+    ASSERT_PTR_EQ(token, c[i].req->data);
+    ASSERT_EQ(0, *token);
+    *token = 1;
+    ASSERT_EQ(0, c[i].result);
+    if (c[i].req->type == UV_FS)
+      uv_fs_req_cleanup((uv_fs_t*) c[i].req);
+    seen++;
+  }
+}
+
+
+static void ready_cb(uv_loop_t* loop) {
+  uv_completion_t c[2];
+  size_t n;
+
+  ready_cb_called++;
+
+  /* A small array, so that several polls are needed at times. */
+  while ((n = uv_loop_poll_completions(loop, c, ARRAY_SIZE(c))) > 0)
+    take(c, n);
+}
+
+
+static void submit(uv_loop_t* loop) {
+  unsigned int i;
+
+  for (i = 0; i < ARRAY_SIZE(fs_reqs); i++) {
+    fs_reqs[i].data = tokens + i;
+    ASSERT_EQ(0, uv_fs_stat(loop, fs_reqs + i, ".", uv_completion_fs_cb));
+  }
+
+  for (i = 0; i < ARRAY_SIZE(work_reqs); i++) {
+    work_reqs[i].data = tokens + ARRAY_SIZE(fs_reqs) + i;
+    ASSERT_EQ(0, uv_queue_work(loop, work_reqs + i, work_cb,
+                               uv_completion_work_cb));
+  }
+}
+
+
+TEST_IMPL(loop_poll_completions) {
+  uv_completion_t c[8];
+  uv_loop_t* loop;
+  unsigned int i;
+
+  loop = uv_default_loop();
+
+  /* Polled once uv_run() is done. */
+  submit(loop);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(ARRAY_SIZE(tokens), uv_loop_poll_completions(loop, c, 8));
+  take(c, ARRAY_SIZE(tokens));
+  ASSERT_EQ(0, uv_loop_poll_completions(loop, c, 8));
+
+  /* And from the callback that says there's something to poll. */
+  for (i = 0; i < ARRAY_SIZE(tokens); i++)
+    tokens[i] = 0;
+  uv_loop_set_completion_cb(loop, ready_cb);
+  submit(loop);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2 * ARRAY_SIZE(tokens), seen);
+  ASSERT_GE(ready_cb_called, 1);
+  ASSERT_LE(ready_cb_called, ARRAY_SIZE(tokens));
+  for (i = 0; i < ARRAY_SIZE(tokens); i++)
+    ASSERT_EQ(1, tokens[i]);
+
+  uv_loop_set_completion_cb(loop, NULL);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,65 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+
+
+TEST_IMPL(cpu_sampler) {
+  struct uv_cpu_times_s* deltas;
+  uv_cpu_sampler_t sampler;
+  uint64_t total;
+  int count;
+  int r;
+  int i;
+
+  r = uv_cpu_sampler_init(&sampler, &count);
+  if (r == UV_ENOSYS)
+    RETURN_SKIP("uv_cpu_sampler_init() is not supported on this platform.");
+  ASSERT_EQ(0, r);
+  ASSERT_GT(count, 0);
+
+  deltas = malloc(count * sizeof(*deltas));
+  ASSERT_NOT_NULL(deltas);
+
+  /* Long enough for a few clock ticks to pass on every CPU. */
+  uv_sleep(100);
+  ASSERT_EQ(0, uv_cpu_sampler_sample(&sampler, deltas, count));
+
+  total = 0;
+  for (i = 0; i < count; i++)
+    total += deltas[i].user + deltas[i].nice + deltas[i].sys +
+             deltas[i].idle + deltas[i].irq;
+  ASSERT_GT(total, 0);
+
+  /* Fewer slots than CPUs is fine, so is a second sample right away. */
+  ASSERT_EQ(0, uv_cpu_sampler_sample(&sampler, deltas, 1));
+  ASSERT_EQ(UV_EINVAL, uv_cpu_sampler_sample(&sampler, deltas, -1));
+
+  uv_cpu_sampler_close(&sampler);
+  ASSERT_EQ(UV_EINVAL, uv_cpu_sampler_sample(&sampler, deltas, count));
+  uv_cpu_sampler_close(&sampler);
+
+  free(deltas);
+  return 0;
+}
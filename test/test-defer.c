@@ -0,0 +1,118 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+static uv_defer_t reqs[4];
+static uv_timer_t timer;
+static uv_prepare_t prepare;
+static char order[16];
+
+
+static void record(char c) {
+  size_t n;
+
+  n = strlen(order);
+  ASSERT_LT(n, sizeof(order) - 1);
+  order[n] = c;
+}
+
+
+static void c_cb(uv_defer_t* req) {
+  record('C');
+}
+
+
+static void a_cb(uv_defer_t* req) {
+  ASSERT_PTR_EQ(req, reqs + 0);
+  record('A');
+  /* Queued behind B, but only runs in the next go. */
+  ASSERT_EQ(0, uv_defer(uv_default_loop(), reqs + 2, c_cb));
+}
+
+
+static void b_cb(uv_defer_t* req) {
+  record('B');
+  ASSERT_EQ(0, uv_defer_cancel(reqs + 3));
+}
+
+
+static void d_cb(uv_defer_t* req) {
+  ASSERT(0 && "cancelled request ran");
+}
+
+
+static void prepare_cb(uv_prepare_t* handle) {
+  record('P');
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  record('T');
+  ASSERT_EQ(0, uv_defer(handle->loop, reqs + 0, a_cb));
+  ASSERT_EQ(0, uv_defer(handle->loop, reqs + 1, b_cb));
+  ASSERT_EQ(0, uv_defer(handle->loop, reqs + 3, d_cb));
+  /* Already pending. */
+  ASSERT_EQ(UV_EBUSY, uv_defer(handle->loop, reqs + 1, b_cb));
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(defer) {
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  memset(reqs, 0, sizeof(reqs));
+  ASSERT_EQ(UV_EINVAL, uv_defer(loop, reqs + 0, NULL));
+  ASSERT_EQ(UV_EINVAL, uv_defer_cancel(reqs + 0));
+
+  /* A deferred callback on its own keeps the loop going. */
+  ASSERT_EQ(0, uv_defer(loop, reqs + 2, c_cb));
+  ASSERT(uv_loop_alive(loop));
+  ASSERT_EQ(0, uv_backend_timeout(loop));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_STR_EQ("C", order);
+  ASSERT(!uv_loop_alive(loop));
+
+  /* Cancelled requests don't run and can be deferred again. */
+  ASSERT_EQ(0, uv_defer(loop, reqs + 3, d_cb));
+  ASSERT_EQ(UV_EBUSY, uv_loop_close(loop));
+  ASSERT_EQ(0, uv_defer_cancel(reqs + 3));
+  ASSERT_EQ(UV_EINVAL, uv_defer_cancel(reqs + 3));
+  ASSERT(!uv_loop_alive(loop));
+
+  memset(order, 0, sizeof(order));
+  ASSERT_EQ(0, uv_timer_init(loop, &timer));
+  ASSERT_EQ(0, uv_timer_start(&timer, timer_cb, 0, 0));
+  ASSERT_EQ(0, uv_prepare_init(loop, &prepare));
+  ASSERT_EQ(0, uv_prepare_start(&prepare, prepare_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+
+  /* In order, right after the timers and before the prepare callbacks. */
+  ASSERT_STR_EQ("TABCP", order);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
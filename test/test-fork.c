@@ -217,6 +217,107 @@ TEST_IMPL(fork_socketpair_started) {
 }
 
 
+static uv_poll_t kept_poll;
+static uv_poll_t dropped_poll;
+static uv_timer_t kept_timer;
+static int rearm_cb_called;
+static int kept_cb_called;
+
+
+static int fork_rearm_cb(uv_loop_t* loop, uv_os_fd_t fd, void* arg) {
+  rearm_cb_called++;
+  return fd == *(int*) arg;
+}
+
+
+static void kept_timer_cb(uv_timer_t* timer) {
+  uv_close((uv_handle_t*) timer, NULL);
+  uv_close((uv_handle_t*) &kept_poll, NULL);
+  uv_close((uv_handle_t*) &dropped_poll, NULL);
+}
+
+
+static void kept_poll_cb(uv_poll_t* poll, int status, int events) {
+  ASSERT_EQ(0, status);
+  ASSERT(events & UV_READABLE);
+  kept_cb_called++;
+  ASSERT_EQ(0, uv_poll_stop(poll));
+  /* Give the dropped watcher the time to fire, it mustn't. */
+  ASSERT_EQ(0, uv_timer_init(poll->loop, &kept_timer));
+  ASSERT_EQ(0, uv_timer_start(&kept_timer, kept_timer_cb, 50, 0));
+}
+
+
+/* uv_loop_fork_ex() only rearms the watchers that the callback picks. */
+static void fork_rearm_filter(uv_loop_t* loop) {
+  pid_t child_pid;
+  int kept_fds[2];
+  int dropped_fds[2];
+
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, kept_fds));
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, dropped_fds));
+  ASSERT_EQ(0, uv_poll_init(loop, &kept_poll, kept_fds[0]));
+  ASSERT_EQ(0, uv_poll_start(&kept_poll, UV_READABLE, kept_poll_cb));
+  ASSERT_EQ(0, uv_poll_init(loop, &dropped_poll, dropped_fds[0]));
+  ASSERT_EQ(0, uv_poll_start(&dropped_poll,
+                             UV_READABLE,
+                             (uv_poll_cb) abort));
+
+  /* Register both with the kernel. */
+  ASSERT_EQ(1, uv_run(loop, UV_RUN_NOWAIT));
+
+  child_pid = fork();
+  ASSERT_NE(child_pid, -1);
+
+  if (child_pid != 0) {
+    /* parent */
+    uv_close((uv_handle_t*) &kept_poll, NULL);
+    uv_close((uv_handle_t*) &dropped_poll, NULL);
+    ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+    ASSERT_EQ(3, send(dropped_fds[1], "hi\n", 3, 0));
+    ASSERT_EQ(3, send(kept_fds[1], "hi\n", 3, 0));
+    assert_wait_child(child_pid);
+  } else {
+    /* child */
+    ASSERT_EQ(0, uv_loop_fork_ex(loop, fork_rearm_cb, &kept_fds[0]));
+    ASSERT_EQ(2, rearm_cb_called);
+    ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+    ASSERT_EQ(1, kept_cb_called);
+  }
+}
+
+
+TEST_IMPL(fork_rearm_filter) {
+  fork_rearm_filter(uv_default_loop());
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(fork_rearm_filter_io_uring) {
+#if defined(__linux__)
+  uv_loop_t loop;
+  int r;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  r = uv_loop_configure(&loop, UV_LOOP_USE_IO_URING);
+  if (r == UV_ENOSYS) {
+    ASSERT_EQ(0, uv_loop_close(&loop));
+    RETURN_SKIP("io_uring is not supported.");
+  }
+  ASSERT_EQ(0, r);
+
+  /* The child's ring must not rearm what the callback turns down. */
+  fork_rearm_filter(&loop);
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#else
+  RETURN_SKIP("io_uring is Linux only.");
+#endif
+}
+
+
 static int fork_signal_cb_called;
 
 void fork_signal_to_child_cb(uv_signal_t* handle, int signum)
@@ -0,0 +1,268 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <fcntl.h>
+#include <string.h>
+
+static const char path[] = "test_file_cache";
+static const char path2[] = "test_file_cache2";
+static uv_fs_cache_t cache;
+static uv_fs_cache_req_t reqs[3];
+static uv_timer_t timer;
+static int get_cb_called;
+static int close_cb_called;
+
+
+static void write_file_at(const char* name, const char* contents) {
+  uv_fs_t req;
+  uv_file file;
+  uv_buf_t buf;
+
+  file = uv_fs_open(NULL, &req, name, O_WRONLY | O_CREAT | O_TRUNC,
+                    S_IWUSR | S_IRUSR, NULL);
+  ASSERT_GE(file, 0);
+  uv_fs_req_cleanup(&req);
+
+  buf = uv_buf_init((char*) contents, strlen(contents));
+  ASSERT_EQ((int) buf.len, uv_fs_write(NULL, &req, file, &buf, 1, -1, NULL));
+  uv_fs_req_cleanup(&req);
+
+  ASSERT_EQ(0, uv_fs_close(NULL, &req, file, NULL));
+  uv_fs_req_cleanup(&req);
+}
+
+
+static void write_file(const char* contents) {
+  write_file_at(path, contents);
+}
+
+
+static void unlink_file(void) {
+  uv_fs_t req;
+
+  uv_fs_unlink(NULL, &req, path, NULL);
+  uv_fs_req_cleanup(&req);
+  uv_fs_unlink(NULL, &req, path2, NULL);
+  uv_fs_req_cleanup(&req);
+}
+
+
+static void close_cb(uv_fs_cache_t* c) {
+  ASSERT_PTR_EQ(&cache, c);
+  close_cb_called++;
+}
+
+
+static void get_cb(uv_fs_cache_req_t* req, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_GE(req->file, 0);
+  ASSERT_NOT_NULL(req->statbuf);
+  ASSERT_EQ(5, req->statbuf->st_size);
+  get_cb_called++;
+}
+
+
+static void missing_cb(uv_fs_cache_req_t* req, int status) {
+  ASSERT_EQ(UV_ENOENT, status);
+  ASSERT_NULL(req->statbuf);
+  get_cb_called++;
+}
+
+
+TEST_IMPL(fs_cache) {
+  uv_fs_cache_options_t options;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  unlink_file();
+  write_file("hello");
+
+  memset(&options, 0, sizeof(options));
+  options.flags = ~0u;
+  ASSERT_EQ(UV_EINVAL, uv_fs_cache_init(loop, &cache, &options));
+  options.ttl = 50;
+  options.flags = 0;
+  ASSERT_EQ(0, uv_fs_cache_init(loop, &cache, &options));
+
+  /* The second lookup waits for the open the first one started. */
+  ASSERT_EQ(0, uv_fs_cache_get(&cache, reqs + 0, path, get_cb));
+  ASSERT_EQ(0, uv_fs_cache_get(&cache, reqs + 1, path, get_cb));
+  ASSERT_EQ(UV_EBUSY, uv_fs_cache_close(&cache, close_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, get_cb_called);
+  ASSERT_EQ(reqs[0].file, reqs[1].file);
+  ASSERT_EQ(2, cache.misses);
+
+  /* Open now, served without a trip through the loop. */
+  ASSERT_EQ(1, uv_fs_cache_get(&cache, reqs + 2, path, get_cb));
+  ASSERT_EQ(reqs[0].file, reqs[2].file);
+  ASSERT_PTR_EQ(reqs[0].statbuf, reqs[2].statbuf);
+  ASSERT_EQ(1, cache.hits);
+  ASSERT_EQ(UV_EBUSY, uv_fs_cache_close(&cache, close_cb));
+  uv_fs_cache_put(&cache, reqs + 0);
+  uv_fs_cache_put(&cache, reqs + 1);
+  uv_fs_cache_put(&cache, reqs + 2);
+
+  get_cb_called = 0;
+  ASSERT_EQ(0, uv_fs_cache_invalidate(&cache, path));
+  ASSERT_EQ(UV_ENOENT, uv_fs_cache_invalidate(&cache, path));
+  ASSERT_EQ(0, uv_fs_cache_get(&cache, reqs + 0, path, get_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, get_cb_called);
+  uv_fs_cache_put(&cache, reqs + 0);
+
+  /* Past the TTL the file is opened again. */
+  uv_sleep(100);
+  uv_update_time(loop);
+  ASSERT_EQ(0, uv_fs_cache_get(&cache, reqs + 0, path, get_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, get_cb_called);
+  uv_fs_cache_put(&cache, reqs + 0);
+
+  ASSERT_EQ(0, uv_fs_cache_get(&cache, reqs + 1, "no_such_file", missing_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(3, get_cb_called);
+  ASSERT_EQ(UV_ENOENT, uv_fs_cache_invalidate(&cache, "no_such_file"));
+
+  ASSERT_EQ(0, uv_fs_cache_close(&cache, close_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, close_cb_called);
+  ASSERT_NULL(cache.cache_ctx);
+
+  unlink_file();
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void put_cb(uv_fs_cache_req_t* req, int status) {
+  ASSERT_EQ(0, status);
+  get_cb_called++;
+  uv_fs_cache_put(&cache, req);
+}
+
+
+TEST_IMPL(fs_cache_put_in_cb) {
+  uv_fs_cache_options_t options;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  unlink_file();
+  write_file("hello");
+  write_file_at(path2, "hello");
+
+  memset(&options, 0, sizeof(options));
+  options.max_entries = 1;
+  ASSERT_EQ(0, uv_fs_cache_init(loop, &cache, &options));
+
+  /* Both waiters hand the entry back before the open finished up. */
+  ASSERT_EQ(0, uv_fs_cache_get(&cache, reqs + 0, path, put_cb));
+  ASSERT_EQ(0, uv_fs_cache_get(&cache, reqs + 1, path, put_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, get_cb_called);
+  ASSERT_EQ(1, uv_fs_cache_get(&cache, reqs + 0, path, put_cb));
+  uv_fs_cache_put(&cache, reqs + 0);
+
+  /* Opening another file evicts the first one, which is on the LRU once. */
+  ASSERT_EQ(0, uv_fs_cache_get(&cache, reqs + 0, path2, put_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(3, get_cb_called);
+  ASSERT_EQ(0, uv_fs_cache_get(&cache, reqs + 0, path, put_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(4, get_cb_called);
+  ASSERT_EQ(1, uv_fs_cache_get(&cache, reqs + 0, path, put_cb));
+  uv_fs_cache_put(&cache, reqs + 0);
+
+  ASSERT_EQ(0, uv_fs_cache_close(&cache, close_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, close_cb_called);
+
+  unlink_file();
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void watch_get_cb(uv_fs_cache_req_t* req, int status) {
+  ASSERT_EQ(0, status);
+  get_cb_called++;
+  uv_fs_cache_put(&cache, req);
+}
+
+
+/* Looks until the watcher dropped the entry and a new open starts. */
+static void watch_timer_cb(uv_timer_t* handle) {
+  int r;
+
+  r = uv_fs_cache_get(&cache, reqs + 0, path, watch_get_cb);
+  ASSERT_GE(r, 0);
+  if (r == 1) {
+    uv_fs_cache_put(&cache, reqs + 0);
+    return;
+  }
+
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void watch_touch_cb(uv_timer_t* handle) {
+  write_file("world");
+  ASSERT_EQ(0, uv_timer_start(handle, watch_timer_cb, 10, 10));
+}
+
+
+TEST_IMPL(fs_cache_watch) {
+#if defined(NO_FS_EVENTS)
+  RETURN_SKIP(NO_FS_EVENTS);
+#endif
+  uv_fs_cache_options_t options;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  unlink_file();
+  write_file("hello");
+
+  memset(&options, 0, sizeof(options));
+  options.flags = UV_FS_CACHE_WATCH;
+  ASSERT_EQ(0, uv_fs_cache_init(loop, &cache, &options));
+  ASSERT_EQ(0, uv_fs_cache_get(&cache, reqs + 0, path, watch_get_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, get_cb_called);
+  ASSERT_EQ(1, uv_fs_cache_get(&cache, reqs + 0, path, watch_get_cb));
+  uv_fs_cache_put(&cache, reqs + 0);
+
+  /* Leave the watcher a moment to settle before changing the file. */
+  ASSERT_EQ(0, uv_timer_init(loop, &timer));
+  ASSERT_EQ(0, uv_timer_start(&timer, watch_touch_cb, 50, 0));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, get_cb_called);
+
+  ASSERT_EQ(0, uv_fs_cache_close(&cache, close_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, close_cb_called);
+
+  unlink_file();
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
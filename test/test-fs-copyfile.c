@@ -215,3 +215,130 @@ TEST_IMPL(fs_copyfile) {
   unlink(dst); /* Cleanup */
   return 0;
 }
+
+
+static int parallel_cb_count;
+static int parallel_status;
+static int parallel_progress_count;
+static uint64_t parallel_copied;
+
+
+static void parallel_progress_cb(uv_fs_copy_t* copy,
+                                 uint64_t copied,
+                                 uint64_t total) {
+  ASSERT_LE(copied, total);
+  ASSERT_GT(copied, parallel_copied);
+  parallel_copied = copied;
+  parallel_progress_count++;
+}
+
+
+static void parallel_cb(uv_fs_copy_t* copy, int status) {
+  ASSERT_PTR_EQ(copy->data, &parallel_status);
+  *(int*) copy->data = status;
+  parallel_cb_count++;
+}
+
+
+TEST_IMPL(fs_copyfile_parallel) {
+  const char src[] = "test_file_src";
+  uv_fs_copy_options_t options;
+  uv_fs_copy_t copy;
+  uv_loop_t* loop;
+  uv_fs_t req;
+  char sbuf[4096];
+  char dbuf[4096];
+  uv_buf_t buf;
+  uv_file file;
+  unsigned int i;
+  int r;
+
+  loop = uv_default_loop();
+  memset(&options, 0, sizeof(options));
+  copy.data = &parallel_status;
+
+  /* Fails with EINVAL if bad flags are passed. */
+  options.flags = -1;
+  r = uv_fs_copyfile_parallel(loop, &copy, src, dst, &options, parallel_cb);
+  ASSERT_EQ(r, UV_EINVAL);
+  options.flags = 0;
+
+  /* Fails with ENOENT if source does not exist. */
+  unlink(src);
+  unlink(dst);
+  r = uv_fs_copyfile_parallel(loop, &copy, src, dst, NULL, parallel_cb);
+  ASSERT_EQ(r, 0);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(parallel_cb_count, 1);
+  ASSERT_EQ(parallel_status, UV_ENOENT);
+  ASSERT_NE(0, uv_fs_stat(NULL, &req, dst, NULL));
+  uv_fs_req_cleanup(&req);
+
+  /* Writes a file whose bytes differ per chunk. */
+  for (i = 0; i < sizeof(sbuf); i++)
+    sbuf[i] = (char) (i * 7);
+  r = uv_fs_open(NULL, &req, src, O_WRONLY | O_CREAT | O_TRUNC,
+                 S_IWUSR | S_IRUSR, NULL);
+  ASSERT_GE(r, 0);
+  uv_fs_req_cleanup(&req);
+  file = r;
+  buf = uv_buf_init(sbuf, sizeof(sbuf));
+  ASSERT_EQ(sizeof(sbuf), uv_fs_write(NULL, &req, file, &buf, 1, 0, NULL));
+  uv_fs_req_cleanup(&req);
+  ASSERT_EQ(0, uv_fs_close(NULL, &req, file, NULL));
+  uv_fs_req_cleanup(&req);
+
+  /* Copies in 10 chunks, the last one short, 3 at a time. */
+  options.concurrency = 3;
+  options.chunk_size = 410;
+  options.progress_cb = parallel_progress_cb;
+  touch_file(dst, 8192);
+  r = uv_fs_copyfile_parallel(loop, &copy, src, dst, &options, parallel_cb);
+  ASSERT_EQ(r, 0);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(parallel_cb_count, 2);
+  ASSERT_EQ(parallel_status, 0);
+  ASSERT_EQ(parallel_progress_count, 10);
+  ASSERT_EQ(parallel_copied, sizeof(sbuf));
+
+  r = uv_fs_open(NULL, &req, dst, O_RDONLY, 0, NULL);
+  ASSERT_GE(r, 0);
+  uv_fs_req_cleanup(&req);
+  file = r;
+  buf = uv_buf_init(dbuf, sizeof(dbuf));
+  ASSERT_EQ(sizeof(dbuf), uv_fs_read(NULL, &req, file, &buf, 1, 0, NULL));
+  uv_fs_req_cleanup(&req);
+  ASSERT_EQ(0, uv_fs_fstat(NULL, &req, file, NULL));
+  ASSERT_EQ(req.statbuf.st_size, sizeof(sbuf));
+  uv_fs_req_cleanup(&req);
+  ASSERT_EQ(0, uv_fs_close(NULL, &req, file, NULL));
+  uv_fs_req_cleanup(&req);
+  ASSERT_EQ(0, memcmp(sbuf, dbuf, sizeof(sbuf)));
+
+  /* Fails to overwrite an existing file and leaves it in place. */
+  options.flags = UV_FS_COPYFILE_EXCL;
+  r = uv_fs_copyfile_parallel(loop, &copy, src, dst, &options, parallel_cb);
+  ASSERT_EQ(r, 0);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(parallel_cb_count, 3);
+  ASSERT_EQ(parallel_status, UV_EEXIST);
+  ASSERT_EQ(0, uv_fs_stat(NULL, &req, dst, NULL));
+  uv_fs_req_cleanup(&req);
+
+  /* Succeeds if src and dst files are identical. */
+  options.flags = 0;
+  r = uv_fs_copyfile_parallel(loop, &copy, src, src, &options, parallel_cb);
+  ASSERT_EQ(r, 0);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(parallel_cb_count, 4);
+  ASSERT_EQ(parallel_status, 0);
+  ASSERT_EQ(0, uv_fs_stat(NULL, &req, src, NULL));
+  ASSERT_EQ(req.statbuf.st_size, sizeof(sbuf));
+  uv_fs_req_cleanup(&req);
+
+  unlink(src);
+  unlink(dst);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -29,6 +29,11 @@
 # include <AvailabilityMacros.h>
 #endif
 
+#if defined(__linux__)
+# include <sys/fanotify.h>
+# include <unistd.h>
+#endif
+
 #ifndef HAVE_KQUEUE
 # if defined(__APPLE__) ||                                                    \
      defined(__DragonFly__) ||                                                \
@@ -49,7 +54,7 @@
 static uv_fs_event_t fs_event;
 static const char file_prefix[] = "fsevent-";
 static const int fs_event_file_count = 16;
-#if defined(__APPLE__) || defined(_WIN32)
+#if defined(__APPLE__) || defined(_WIN32) || defined(__linux__)
 static const char file_prefix_in_subdir[] = "subdir";
 static int fs_multievent_cb_called;
 #endif
@@ -222,7 +227,7 @@ static void fs_event_cb_dir_multi_file(uv_fs_event_t* handle,
   }
 }
 
-#if defined(__APPLE__) || defined(_WIN32)
+#if defined(__APPLE__) || defined(_WIN32) || defined(__linux__)
 static const char* fs_event_get_filename_in_subdir(int i) {
   snprintf(fs_event_filename,
            sizeof(fs_event_filename),
@@ -463,12 +468,129 @@ TEST_IMPL(fs_event_watch_dir) {
 }
 
 
+static int fs_event_batches;
+static int fs_event_batch_entries;
+static char fs_event_batch_seen[16];
+
+static void fs_event_batch_cb(uv_fs_event_t* handle,
+                              const uv_fs_event_batch_entry_t* entries,
+                              size_t nentries,
+                              int status) {
+  size_t i;
+  size_t j;
+
+  ASSERT(handle == &fs_event);
+  ASSERT(status == 0);
+  ASSERT(nentries > 0);
+  fs_event_batches++;
+
+  for (i = 0; i < nentries; i++) {
+    ASSERT(entries[i].events & (UV_CHANGE | UV_RENAME));
+    /* Each path shows up once per batch. */
+    for (j = 0; j < i; j++)
+      ASSERT(0 != strcmp(entries[i].filename, entries[j].filename));
+
+    if (strncmp(entries[i].filename, file_prefix, sizeof(file_prefix) - 1))
+      continue;
+
+    /* A file may also be split across two batches. */
+    j = atoi(entries[i].filename + sizeof(file_prefix) - 1);
+    ASSERT(j < ARRAY_SIZE(fs_event_batch_seen));
+    if (fs_event_batch_seen[j]++ == 0)
+      fs_event_batch_entries++;
+  }
+
+  if (fs_event_batch_entries >= fs_event_file_count) {
+    uv_close((uv_handle_t*) handle, close_cb);
+    uv_close((uv_handle_t*) &timer, close_cb);
+  }
+}
+
+static void fs_event_create_and_touch_files(uv_timer_t* handle) {
+  int i;
+
+  /* Two events for every file, all within a single window. */
+  for (i = 0; i < fs_event_file_count; i++) {
+    create_file(fs_event_get_filename(i));
+    touch_file(fs_event_get_filename(i));
+  }
+}
+
+TEST_IMPL(fs_event_watch_dir_batch) {
+#if defined(NO_FS_EVENTS)
+  RETURN_SKIP(NO_FS_EVENTS);
+#elif defined(__MVS__)
+  RETURN_SKIP("Directory watching not supported on this platform.");
+#endif
+
+  uv_loop_t* loop = uv_default_loop();
+  int r;
+
+  /* Setup */
+  fs_event_unlink_files(NULL);
+  remove("watch_dir/");
+  create_dir("watch_dir");
+
+  r = uv_fs_event_init(loop, &fs_event);
+  ASSERT(r == 0);
+  r = uv_fs_event_start_batch(&fs_event, NULL, "watch_dir", 0, 200);
+  ASSERT(r == UV_EINVAL);
+  r = uv_fs_event_start_batch(&fs_event, fs_event_batch_cb, "watch_dir", 0,
+                              200);
+  ASSERT(r == 0);
+  r = uv_timer_init(loop, &timer);
+  ASSERT(r == 0);
+  r = uv_timer_start(&timer, fs_event_create_and_touch_files, 50, 0);
+  ASSERT(r == 0);
+
+  uv_run(loop, UV_RUN_DEFAULT);
+
+  ASSERT(fs_event_batch_entries == fs_event_file_count);
+  ASSERT(fs_event_batches < fs_event_file_count);
+  ASSERT(close_cb_called == 2);
+
+  /* Cleanup */
+  fs_event_unlink_files(NULL);
+  remove("watch_dir/");
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+#if defined(__linux__)
+/* Recursive watches use fanotify, which needs CAP_SYS_ADMIN. Without it
+ * libuv quietly watches the top directory only.
+ */
+static int fanotify_recursive_supported(void) {
+# if defined(FAN_REPORT_DFID_NAME) && defined(FAN_MARK_FILESYSTEM)
+  int fd;
+  int r;
+
+  fd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME, O_RDONLY);
+  if (fd == -1)
+    return 0;
+
+  r = fanotify_mark(fd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM, FAN_CREATE,
+                    AT_FDCWD, ".");
+  close(fd);
+  return r == 0;
+# else
+  return 0;
+# endif
+}
+#endif
+
 TEST_IMPL(fs_event_watch_dir_recursive) {
-#if defined(__APPLE__) || defined(_WIN32)
+#if defined(__APPLE__) || defined(_WIN32) || defined(__linux__)
   uv_loop_t* loop;
   int r;
   uv_fs_event_t fs_event_root;
 
+#if defined(__linux__)
+  if (!fanotify_recursive_supported())
+    RETURN_SKIP("Recursive directory watching needs fanotify.");
+#endif
+
   /* Setup */
   loop = uv_default_loop();
   fs_event_unlink_files(NULL);
@@ -491,7 +613,7 @@ TEST_IMPL(fs_event_watch_dir_recursive) {
   r = uv_timer_start(&timer, fs_event_create_files_in_subdir, 100, 0);
   ASSERT(r == 0);
 
-#ifndef _WIN32
+#if !defined(_WIN32) && !defined(__linux__)
   /* Also try to watch the root directory.
    * This will be noisier, so we're just checking for any couple events to happen. */
   r = uv_fs_event_init(loop, &fs_event_root);
@@ -1052,6 +1174,84 @@ TEST_IMPL(fs_event_getpath) {
   return 0;
 }
 
+
+#ifdef _WIN32
+static int fs_event_getstat_cb_called;
+
+static void fs_event_cb_getstat(uv_fs_event_t* handle,
+                                const char* filename,
+                                int events,
+                                int status) {
+  uv_stat_t statbuf;
+  int r;
+
+  ASSERT_EQ(0, status);
+  if (fs_event_getstat_cb_called++ > 0)
+    return;
+
+  /* Older Windows versions and some file systems don't have it. */
+  r = uv_fs_event_getstat(handle, &statbuf);
+  if (r == 0)
+    ASSERT(statbuf.st_mode & (S_IFREG | S_IFDIR));
+  else
+    ASSERT_EQ(UV_ENOTSUP, r);
+
+  uv_close((uv_handle_t*) handle, close_cb);
+}
+#endif
+
+
+TEST_IMPL(fs_event_getstat) {
+#if defined(NO_FS_EVENTS)
+  RETURN_SKIP(NO_FS_EVENTS);
+#endif
+  uv_stat_t statbuf;
+  uv_loop_t* loop;
+  int value;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_fs_event_init(loop, &fs_event));
+
+#ifdef _WIN32
+  remove("watch_dir/file1");
+  remove("watch_dir/");
+  create_dir("watch_dir");
+
+  /* Only inside the callback. */
+  ASSERT_EQ(UV_ENOTSUP, uv_fs_event_getstat(&fs_event, &statbuf));
+
+  value = 0;
+  ASSERT_EQ(0, uv_fs_event_buffer_size(&fs_event, &value));
+  ASSERT_EQ(4096, value);
+  value = 100001;
+  ASSERT_EQ(0, uv_fs_event_buffer_size(&fs_event, &value));
+  ASSERT_EQ(100004, value);
+  value = -1;
+  ASSERT_EQ(UV_EINVAL, uv_fs_event_buffer_size(&fs_event, &value));
+
+  ASSERT_EQ(0, uv_fs_event_start(&fs_event, fs_event_cb_getstat,
+                                 "watch_dir", 0));
+  create_file("watch_dir/file1");
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_GE(fs_event_getstat_cb_called, 1);
+  ASSERT_EQ(1, close_cb_called);
+
+  remove("watch_dir/file1");
+  remove("watch_dir/");
+#else
+  value = 0;
+  ASSERT_EQ(UV_ENOSYS, uv_fs_event_getstat(&fs_event, &statbuf));
+  ASSERT_EQ(UV_ENOSYS, uv_fs_event_buffer_size(&fs_event, &value));
+  uv_close((uv_handle_t*) &fs_event, close_cb);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, close_cb_called);
+#endif
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
 #if defined(__APPLE__)
 
 static int fs_event_error_reported;
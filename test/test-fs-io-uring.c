@@ -0,0 +1,222 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <fcntl.h>
+#include <string.h>
+
+#define TEST_FILE "test_file_io_uring"
+
+static uv_loop_t loop;
+static uv_fs_t req;
+static uv_file file;
+static char data[] = "hello io_uring";
+static char upper[] = "HELLO IO_URING";
+static uv_fs_write_segment_t segs[2];
+static uv_buf_t batch_bufs[1];
+static char readbuf[64];
+static int step;
+
+
+static void next_step(uv_fs_t* fs_req);
+
+
+static void check_stat(uv_fs_t* fs_req) {
+  uv_stat_t* s;
+
+  ASSERT_EQ(0, fs_req->result);
+  ASSERT_PTR_EQ(&fs_req->statbuf, fs_req->ptr);
+  s = fs_req->ptr;
+  ASSERT_EQ(sizeof(data) - 1, s->st_size);
+  ASSERT(s->st_mode & S_IFREG);
+}
+
+
+static void next_step(uv_fs_t* fs_req) {
+  uv_buf_t bufs[2];
+  int r;
+
+  ASSERT_PTR_EQ(&req, fs_req);
+
+  switch (step++) {
+  case 0:
+    ASSERT_GE(fs_req->result, 0);
+    file = fs_req->result;
+    uv_fs_req_cleanup(fs_req);
+    bufs[0] = uv_buf_init(data, 5);
+    bufs[1] = uv_buf_init(data + 5, sizeof(data) - 1 - 5);
+    r = uv_fs_write(&loop, &req, file, bufs, 2, -1, next_step);
+    break;
+  case 1:
+    ASSERT_EQ(sizeof(data) - 1, fs_req->result);
+    uv_fs_req_cleanup(fs_req);
+    /* Back to front, and the first segment in two buffers. */
+    bufs[0] = uv_buf_init(upper, 2);
+    bufs[1] = uv_buf_init(upper + 2, 4);
+    segs[0].offset = 6;
+    segs[0].bufs = &batch_bufs[0];
+    segs[0].nbufs = 1;
+    segs[1].offset = 0;
+    segs[1].bufs = bufs;
+    segs[1].nbufs = 2;
+    batch_bufs[0] = uv_buf_init(upper + 6, sizeof(upper) - 1 - 6);
+    r = uv_fs_write_batch(&loop,
+                          &req,
+                          file,
+                          segs,
+                          ARRAY_SIZE(segs),
+                          UV_FS_WRITE_BATCH_DATASYNC,
+                          next_step);
+    ASSERT_EQ(UV_EBUSY, uv_cancel((uv_req_t*) &req));
+    break;
+  case 2:
+    ASSERT_EQ(sizeof(upper) - 1, fs_req->result);
+    uv_fs_req_cleanup(fs_req);
+    r = uv_fs_fsync(&loop, &req, file, next_step);
+    /* Ring requests are not on the threadpool queue. */
+    ASSERT_EQ(UV_EBUSY, uv_cancel((uv_req_t*) &req));
+    break;
+  case 3:
+    ASSERT_EQ(0, fs_req->result);
+    uv_fs_req_cleanup(fs_req);
+    r = uv_fs_fdatasync(&loop, &req, file, next_step);
+    break;
+  case 4:
+    ASSERT_EQ(0, fs_req->result);
+    uv_fs_req_cleanup(fs_req);
+    r = uv_fs_fstat(&loop, &req, file, next_step);
+    break;
+  case 5:
+    check_stat(fs_req);
+    uv_fs_req_cleanup(fs_req);
+    r = uv_fs_close(&loop, &req, file, next_step);
+    break;
+  case 6:
+    ASSERT_EQ(0, fs_req->result);
+    uv_fs_req_cleanup(fs_req);
+    r = uv_fs_stat(&loop, &req, TEST_FILE, next_step);
+    break;
+  case 7:
+    check_stat(fs_req);
+    uv_fs_req_cleanup(fs_req);
+    r = uv_fs_lstat(&loop, &req, TEST_FILE, next_step);
+    break;
+  case 8:
+    check_stat(fs_req);
+    uv_fs_req_cleanup(fs_req);
+    r = uv_fs_open(&loop, &req, TEST_FILE, O_RDONLY, 0, next_step);
+    break;
+  case 9:
+    ASSERT_GE(fs_req->result, 0);
+    file = fs_req->result;
+    uv_fs_req_cleanup(fs_req);
+    bufs[0] = uv_buf_init(readbuf, 6);
+    bufs[1] = uv_buf_init(readbuf + 6, sizeof(readbuf) - 6);
+    r = uv_fs_read(&loop, &req, file, bufs, 2, 0, next_step);
+    break;
+  case 10:
+    ASSERT_EQ(sizeof(upper) - 1, fs_req->result);
+    ASSERT_EQ(0, memcmp(readbuf, upper, sizeof(upper) - 1));
+    uv_fs_req_cleanup(fs_req);
+    /* At the end of the file. */
+    bufs[0] = uv_buf_init(readbuf, sizeof(readbuf));
+    r = uv_fs_read(&loop, &req, file, bufs, 1, sizeof(data) - 1, next_step);
+    break;
+  case 11:
+    ASSERT_EQ(0, fs_req->result);
+    uv_fs_req_cleanup(fs_req);
+    /* Opened read-only, the first write fails and takes the chain down. */
+    batch_bufs[0] = uv_buf_init(upper, sizeof(upper) - 1);
+    segs[0].offset = 0;
+    segs[0].bufs = batch_bufs;
+    segs[0].nbufs = 1;
+    segs[1] = segs[0];
+    r = uv_fs_write_batch(&loop,
+                          &req,
+                          file,
+                          segs,
+                          ARRAY_SIZE(segs),
+                          UV_FS_WRITE_BATCH_DATASYNC,
+                          next_step);
+    break;
+  case 12:
+    ASSERT_EQ(UV_EBADF, fs_req->result);
+    uv_fs_req_cleanup(fs_req);
+    r = uv_fs_close(&loop, &req, file, next_step);
+    break;
+  case 13:
+    ASSERT_EQ(0, fs_req->result);
+    uv_fs_req_cleanup(fs_req);
+    r = uv_fs_stat(&loop, &req, TEST_FILE "_missing", next_step);
+    break;
+  case 14:
+    ASSERT_EQ(UV_ENOENT, fs_req->result);
+    ASSERT_NULL(fs_req->ptr);
+    uv_fs_req_cleanup(fs_req);
+    r = uv_fs_close(&loop, &req, file, next_step);
+    break;
+  case 15:
+    ASSERT_EQ(UV_EBADF, fs_req->result);
+    uv_fs_req_cleanup(fs_req);
+    return;
+  default:
+    ASSERT(0 && "unreachable");
+    return;
+  }
+
+  ASSERT_EQ(0, r);
+}
+
+
+TEST_IMPL(fs_io_uring) {
+  uv_fs_t unlink_req;
+  int r;
+
+  uv_fs_unlink(NULL, &unlink_req, TEST_FILE, NULL);
+  uv_fs_req_cleanup(&unlink_req);
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  r = uv_loop_configure(&loop, UV_LOOP_USE_IO_URING);
+  if (r == UV_ENOSYS) {
+    ASSERT_EQ(0, uv_loop_close(&loop));
+    RETURN_SKIP("io_uring is not supported.");
+  }
+  ASSERT_EQ(0, r);
+
+  ASSERT_EQ(0, uv_fs_open(&loop,
+                          &req,
+                          TEST_FILE,
+                          O_WRONLY | O_CREAT | O_TRUNC,
+                          S_IRUSR | S_IWUSR,
+                          next_step));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(16, step);
+
+  ASSERT_EQ(0, uv_loop_close(&loop));
+
+  uv_fs_unlink(NULL, &unlink_req, TEST_FILE, NULL);
+  uv_fs_req_cleanup(&unlink_req);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -298,3 +298,57 @@ TEST_IMPL(fs_poll_close_request_stop_when_active) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static void poll_cb_native(uv_fs_poll_t* handle,
+                           int status,
+                           const uv_stat_t* prev,
+                           const uv_stat_t* curr) {
+  ASSERT(handle == &poll_handle);
+  ASSERT(status == 0);
+  ASSERT(prev->st_size != curr->st_size);
+
+  if (++poll_cb_called == 1) {
+    ASSERT(0 == uv_timer_start(&timer_handle, timer_cb, 50, 0));
+    return;
+  }
+
+  uv_close((uv_handle_t*) handle, close_cb);
+  uv_close((uv_handle_t*) &timer_handle, close_cb);
+}
+
+
+TEST_IMPL(fs_poll_native) {
+  loop = uv_default_loop();
+
+  remove(FIXTURE);
+  touch_file(FIXTURE);
+
+  ASSERT(0 == uv_timer_init(loop, &timer_handle));
+  ASSERT(0 == uv_fs_poll_init(loop, &poll_handle));
+  ASSERT(UV_EINVAL == uv_fs_poll_start_ex(&poll_handle,
+                                          poll_cb_fail,
+                                          FIXTURE,
+                                          100,
+                                          ~0u));
+
+  /* The interval is longer than the test timeout, the changes can only be
+   * picked up through notifications.
+   */
+  ASSERT(0 == uv_fs_poll_start_ex(&poll_handle,
+                                  poll_cb_native,
+                                  FIXTURE,
+                                  3600 * 1000,
+                                  UV_FS_POLL_NATIVE));
+  ASSERT(0 == uv_timer_start(&timer_handle, timer_cb, 100, 0));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(poll_cb_called == 2);
+  ASSERT(timer_cb_called == 2);
+  ASSERT(close_cb_called == 2);
+
+  remove(FIXTURE);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
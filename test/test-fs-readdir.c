@@ -460,3 +460,109 @@ TEST_IMPL(fs_readdir_non_empty_dir) {
   MAKE_VALGRIND_HAPPY();
   return 0;
  }
+
+static void* packed_buf[64];  /* Aligned like a pointer. */
+
+static unsigned int check_packed_entries(int n) {
+  uv_dirent_packed_t* ent;
+  unsigned int seen;
+  int i;
+
+  seen = 0;
+  ent = (uv_dirent_packed_t*) packed_buf;
+  for (i = 0; i < n; i++) {
+    ASSERT_EQ(strlen(ent->name), ent->namelen);
+    if (!strcmp(ent->name, "file1"))
+      seen |= 1;
+    else if (!strcmp(ent->name, "file2"))
+      seen |= 2;
+    else if (!strcmp(ent->name, "test_subdir"))
+      seen |= 4;
+    else
+      ASSERT(0 && "unexpected entry");
+#ifdef HAVE_DIRENT_TYPES
+    if (!strcmp(ent->name, "test_subdir"))
+      ASSERT_EQ(ent->type, UV_DIRENT_DIR);
+    else
+      ASSERT_EQ(ent->type, UV_DIRENT_FILE);
+#endif /* HAVE_DIRENT_TYPES */
+    ASSERT_EQ(0, ent->reclen % sizeof(void*));
+    ent = (uv_dirent_packed_t*) ((char*) ent + ent->reclen);
+  }
+
+  return seen;
+}
+
+TEST_IMPL(fs_readdir_packed) {
+  unsigned int seen;
+  uv_fs_t req;
+  uv_dir_t* dir;
+  int r;
+
+  cleanup_test_files();
+
+  ASSERT_EQ(0, uv_fs_mkdir(NULL, &req, "test_dir", 0755, NULL));
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_open(NULL, &req, "test_dir/file1", O_WRONLY | O_CREAT,
+                 S_IWUSR | S_IRUSR, NULL);
+  ASSERT_GE(r, 0);
+  uv_fs_req_cleanup(&req);
+  uv_fs_close(NULL, &req, r, NULL);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_open(NULL, &req, "test_dir/file2", O_WRONLY | O_CREAT,
+                 S_IWUSR | S_IRUSR, NULL);
+  ASSERT_GE(r, 0);
+  uv_fs_req_cleanup(&req);
+  uv_fs_close(NULL, &req, r, NULL);
+  uv_fs_req_cleanup(&req);
+  ASSERT_EQ(0, uv_fs_mkdir(NULL, &req, "test_dir/test_subdir", 0755, NULL));
+  uv_fs_req_cleanup(&req);
+
+  ASSERT_EQ(0, uv_fs_opendir(NULL, &opendir_req, "test_dir", NULL));
+  dir = opendir_req.ptr;
+  uv_fs_req_cleanup(&opendir_req);
+
+  ASSERT_EQ(UV_EINVAL, uv_fs_readdir_packed(NULL, &readdir_req, dir,
+                                            NULL, 0, NULL));
+  uv_fs_req_cleanup(&readdir_req);
+
+  /* Too small for any of the names, nothing is lost. */
+  ASSERT_EQ(UV_ENOBUFS, uv_fs_readdir_packed(NULL, &readdir_req, dir,
+                                             packed_buf, 8, NULL));
+  uv_fs_req_cleanup(&readdir_req);
+
+  /* Room for one at a time, what doesn't fit comes with the next call. */
+  seen = 0;
+  for (;;) {
+    r = uv_fs_readdir_packed(NULL, &readdir_req, dir,
+                             packed_buf, 32, NULL);
+    ASSERT_EQ(r, readdir_req.result);
+    uv_fs_req_cleanup(&readdir_req);
+    if (r == 0)
+      break;
+    ASSERT_EQ(1, r);
+    seen |= check_packed_entries(r);
+  }
+  ASSERT_EQ(7, seen);
+
+  ASSERT_EQ(0, uv_fs_closedir(NULL, &closedir_req, dir, NULL));
+  uv_fs_req_cleanup(&closedir_req);
+
+  /* All of them in one go. */
+  ASSERT_EQ(0, uv_fs_opendir(NULL, &opendir_req, "test_dir", NULL));
+  dir = opendir_req.ptr;
+  uv_fs_req_cleanup(&opendir_req);
+  ASSERT_EQ(3, uv_fs_readdir_packed(NULL, &readdir_req, dir,
+                                    packed_buf, sizeof(packed_buf), NULL));
+  uv_fs_req_cleanup(&readdir_req);
+  ASSERT_EQ(7, check_packed_entries(3));
+  ASSERT_EQ(0, uv_fs_readdir_packed(NULL, &readdir_req, dir,
+                                    packed_buf, sizeof(packed_buf), NULL));
+  uv_fs_req_cleanup(&readdir_req);
+  ASSERT_EQ(0, uv_fs_closedir(NULL, &closedir_req, dir, NULL));
+  uv_fs_req_cleanup(&closedir_req);
+
+  cleanup_test_files();
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,323 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define FILE_SIZE (1024 * 1024 + 123)
+#define CHUNK_SIZE (64 * 1024)
+
+static const char path[] = "test_file_reader";
+static uv_fs_reader_t reader;
+static uv_buf_t held;
+static uint64_t expected_off;
+static uint64_t end_off;
+static int eof_cb_called;
+static int close_cb_called;
+static int read_cb_called;
+
+
+static char pattern(uint64_t off) {
+  return (char) (off * 7 + off / 251);
+}
+
+
+static void create_file(void) {
+  static char buf[FILE_SIZE];
+  uv_buf_t iov;
+  uv_fs_t req;
+  uv_file fd;
+  int i;
+
+  for (i = 0; i < FILE_SIZE; i++)
+    buf[i] = pattern(i);
+
+  fd = uv_fs_open(NULL, &req, path, UV_FS_O_WRONLY | UV_FS_O_CREAT |
+                  UV_FS_O_TRUNC, 0644, NULL);
+  ASSERT_GE(fd, 0);
+  uv_fs_req_cleanup(&req);
+  iov = uv_buf_init(buf, sizeof(buf));
+  ASSERT_EQ(FILE_SIZE, uv_fs_write(NULL, &req, fd, &iov, 1, 0, NULL));
+  uv_fs_req_cleanup(&req);
+  ASSERT_EQ(0, uv_fs_close(NULL, &req, fd, NULL));
+  uv_fs_req_cleanup(&req);
+}
+
+
+static uv_file open_file(void) {
+  uv_fs_t req;
+  uv_file fd;
+
+  fd = uv_fs_open(NULL, &req, path, UV_FS_O_RDONLY, 0, NULL);
+  ASSERT_GE(fd, 0);
+  uv_fs_req_cleanup(&req);
+  return fd;
+}
+
+
+static void close_file(uv_file fd) {
+  uv_fs_t req;
+
+  ASSERT_EQ(0, uv_fs_close(NULL, &req, fd, NULL));
+  uv_fs_req_cleanup(&req);
+  ASSERT_EQ(0, uv_fs_unlink(NULL, &req, path, NULL));
+  uv_fs_req_cleanup(&req);
+}
+
+
+static void close_cb(uv_fs_reader_t* r) {
+  ASSERT_PTR_EQ(&reader, r);
+  ASSERT_NULL(r->reader_ctx);
+  close_cb_called++;
+}
+
+
+static void read_cb(uv_fs_reader_t* r, ssize_t nread, const uv_buf_t* buf) {
+  ssize_t i;
+
+  if (nread == UV_EOF) {
+    ASSERT_EQ(end_off, expected_off);
+    if (held.base != NULL)
+      ASSERT_EQ(0, uv_fs_reader_release(r, &held));
+    eof_cb_called++;
+    ASSERT_EQ(0, uv_fs_reader_close(r, close_cb));
+    ASSERT_EQ(UV_EINVAL, uv_fs_reader_close(r, close_cb));
+    return;
+  }
+
+  ASSERT_GT(nread, 0);
+  ASSERT_LE(nread, CHUNK_SIZE);
+  for (i = 0; i < nread; i++)
+    ASSERT_EQ(pattern(expected_off + i), buf->base[i]);
+  expected_off += nread;
+  read_cb_called++;
+
+  /* Hang on to one buffer at a time, the others keep reading ahead. */
+  if (held.base != NULL) {
+    ASSERT_EQ(0, uv_fs_reader_release(r, &held));
+    ASSERT_EQ(UV_EINVAL, uv_fs_reader_release(r, &held));
+  }
+  held = *buf;
+}
+
+
+TEST_IMPL(fs_reader) {
+  uv_fs_reader_options_t options;
+  uv_loop_t* loop;
+  uv_file fd;
+
+  loop = uv_default_loop();
+  create_file();
+  fd = open_file();
+
+  memset(&options, 0, sizeof(options));
+  options.chunk_size = CHUNK_SIZE;
+  options.depth = 3;
+  ASSERT_EQ(UV_EINVAL, uv_fs_reader_start(loop, &reader, fd, NULL, NULL));
+  options.offset = -1;
+  ASSERT_EQ(UV_EINVAL, uv_fs_reader_start(loop, &reader, fd, &options,
+                                          read_cb));
+  options.offset = 0;
+
+  /* The whole file. */
+  end_off = FILE_SIZE;
+  ASSERT_EQ(0, uv_fs_reader_start(loop, &reader, fd, &options, read_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, eof_cb_called);
+  ASSERT_EQ(1, close_cb_called);
+  ASSERT_EQ((FILE_SIZE + CHUNK_SIZE - 1) / CHUNK_SIZE, read_cb_called);
+
+  /* A range in the middle, not aligned to the chunks. */
+  held = uv_buf_init(NULL, 0);
+  expected_off = 1000;
+  end_off = 1000 + 3 * CHUNK_SIZE + 17;
+  options.offset = expected_off;
+  options.length = end_off - expected_off;
+  ASSERT_EQ(0, uv_fs_reader_start(loop, &reader, fd, &options, read_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, eof_cb_called);
+  ASSERT_EQ(2, close_cb_called);
+
+  close_file(fd);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void stop_read_cb(uv_fs_reader_t* r,
+                         ssize_t nread,
+                         const uv_buf_t* buf) {
+  ASSERT_GT(nread, 0);
+  ASSERT_EQ(0, read_cb_called++);
+  /* Held buffers go away with the reader. */
+  ASSERT_EQ(0, uv_fs_reader_close(r, close_cb));
+}
+
+
+TEST_IMPL(fs_reader_close) {
+  uv_fs_reader_options_t options;
+  uv_loop_t* loop;
+  uv_file fd;
+
+  loop = uv_default_loop();
+  create_file();
+  fd = open_file();
+
+  /* Closing before anything was read. */
+  ASSERT_EQ(0, uv_fs_reader_start(loop, &reader, fd, NULL, stop_read_cb));
+  ASSERT_EQ(0, uv_fs_reader_close(&reader, close_cb));
+  ASSERT_EQ(0, close_cb_called);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, close_cb_called);
+  ASSERT_EQ(0, read_cb_called);
+
+  /* And from the read callback. */
+  memset(&options, 0, sizeof(options));
+  options.chunk_size = CHUNK_SIZE;
+  options.depth = 8;
+  ASSERT_EQ(0, uv_fs_reader_start(loop, &reader, fd, &options, stop_read_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, read_cb_called);
+  ASSERT_EQ(2, close_cb_called);
+
+  close_file(fd);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uv_fs_pump_t pump;
+static uv_pipe_t pipe_out;
+static uv_pipe_t pipe_in;
+static uint64_t pump_received;
+static int pump_status;
+static int pump_cb_called;
+static char pump_buf[4096];
+
+
+static void pump_alloc_cb(uv_handle_t* handle,
+                          size_t suggested_size,
+                          uv_buf_t* buf) {
+  buf->base = pump_buf;
+  buf->len = sizeof(pump_buf);
+}
+
+
+static void pump_read_cb(uv_stream_t* stream,
+                         ssize_t nread,
+                         const uv_buf_t* buf) {
+  ssize_t i;
+
+  if (nread == UV_EOF) {
+    uv_close((uv_handle_t*) stream, NULL);
+    return;
+  }
+
+  ASSERT_GE(nread, 0);
+  for (i = 0; i < nread; i++)
+    ASSERT_EQ(pattern(pump_received + i), buf->base[i]);
+  pump_received += nread;
+}
+
+
+static void pump_cb(uv_fs_pump_t* p, int status) {
+  ASSERT_PTR_EQ(&pump, p);
+  ASSERT_NULL(p->pump_ctx);
+  pump_status = status;
+  pump_cb_called++;
+  uv_close((uv_handle_t*) &pipe_out, NULL);
+}
+
+
+TEST_IMPL(fs_pump) {
+  uv_fs_reader_options_t options;
+  uv_file fds[2];
+  uv_loop_t* loop;
+  uv_file fd;
+
+  loop = uv_default_loop();
+  create_file();
+  fd = open_file();
+
+  ASSERT_EQ(0, uv_pipe(fds, 0, 0));
+  ASSERT_EQ(0, uv_pipe_init(loop, &pipe_out, 0));
+  ASSERT_EQ(0, uv_pipe_open(&pipe_out, fds[1]));
+  ASSERT_EQ(0, uv_pipe_init(loop, &pipe_in, 0));
+  ASSERT_EQ(0, uv_pipe_open(&pipe_in, fds[0]));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &pipe_in,
+                             pump_alloc_cb,
+                             pump_read_cb));
+
+  /* Smaller than what the pipe holds, reads wait on writes. */
+  memset(&options, 0, sizeof(options));
+  options.depth = 2;
+  options.chunk_size = 16 * 1024;
+  ASSERT_EQ(UV_EINVAL, uv_fs_pump_start(loop, &pump, fd, NULL, &options,
+                                        pump_cb));
+  ASSERT_EQ(0, uv_fs_pump_start(loop, &pump, fd, (uv_stream_t*) &pipe_out,
+                                &options, pump_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, pump_cb_called);
+  ASSERT_EQ(0, pump_status);
+  ASSERT_EQ(FILE_SIZE, pump.written);
+  ASSERT_EQ(FILE_SIZE, pump_received);
+
+  close_file(fd);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(fs_pump_stop) {
+  uv_file fds[2];
+  uv_loop_t* loop;
+  uv_file fd;
+
+  loop = uv_default_loop();
+  create_file();
+  fd = open_file();
+
+  ASSERT_EQ(0, uv_pipe(fds, 0, 0));
+  ASSERT_EQ(0, uv_pipe_init(loop, &pipe_out, 0));
+  ASSERT_EQ(0, uv_pipe_open(&pipe_out, fds[1]));
+  ASSERT_EQ(0, uv_pipe_init(loop, &pipe_in, 0));
+  ASSERT_EQ(0, uv_pipe_open(&pipe_in, fds[0]));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &pipe_in,
+                             pump_alloc_cb,
+                             pump_read_cb));
+
+  ASSERT_EQ(0, uv_fs_pump_start(loop, &pump, fd, (uv_stream_t*) &pipe_out,
+                                NULL, pump_cb));
+  ASSERT_EQ(0, uv_fs_pump_stop(&pump));
+  ASSERT_EQ(UV_EINVAL, uv_fs_pump_stop(&pump));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, pump_cb_called);
+  ASSERT_EQ(UV_ECANCELED, pump_status);
+  ASSERT_EQ(0, pump.written);
+
+  close_file(fd);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,96 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <fcntl.h>
+
+#define NUM_WAITERS 4
+
+static const char path[] = "test_file_sync_group";
+static uv_fs_sync_group_t group;
+static uv_fs_sync_req_t reqs[NUM_WAITERS];
+static uv_fs_sync_req_t late_reqs[2];
+static int late_cb_called;
+static int sync_cb_called;
+
+
+static void late_cb(uv_fs_sync_req_t* req, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(2, group.flushes);
+  late_cb_called++;
+}
+
+
+static void sync_cb(uv_fs_sync_req_t* req, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(1, group.flushes);
+  ASSERT_EQ(NUM_WAITERS * 10, group.synced);
+
+  /* Too late for the flush that just finished, these share the next one. */
+  if (sync_cb_called++ == 0) {
+    ASSERT_EQ(0, uv_fs_sync_group_wait(&group, late_reqs + 0, 50, late_cb));
+    ASSERT_EQ(0, uv_fs_sync_group_wait(&group, late_reqs + 1, 60, late_cb));
+  }
+}
+
+
+TEST_IMPL(fs_sync_group) {
+  uv_loop_t* loop;
+  uv_fs_t req;
+  uv_file file;
+  uv_buf_t buf;
+  int i;
+
+  loop = uv_default_loop();
+  file = uv_fs_open(NULL, &req, path, O_RDWR | O_CREAT | O_TRUNC,
+                    S_IWUSR | S_IRUSR, NULL);
+  ASSERT_GE(file, 0);
+  uv_fs_req_cleanup(&req);
+
+  ASSERT_EQ(UV_EINVAL, uv_fs_sync_group_init(loop, &group, -1));
+  ASSERT_EQ(0, uv_fs_sync_group_init(loop, &group, file));
+
+  buf = uv_buf_init("0123456789", 10);
+  for (i = 0; i < NUM_WAITERS; i++) {
+    ASSERT_EQ(10, uv_fs_write(NULL, &req, file, &buf, 1, i * 10, NULL));
+    uv_fs_req_cleanup(&req);
+    ASSERT_EQ(0, uv_fs_sync_group_wait(&group, reqs + i, (i + 1) * 10,
+                                       sync_cb));
+  }
+  ASSERT_EQ(UV_EBUSY, uv_fs_sync_group_close(&group));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_WAITERS, sync_cb_called);
+  ASSERT_EQ(2, late_cb_called);
+  ASSERT_EQ(2, group.flushes);
+  ASSERT_EQ(60, group.synced);
+  ASSERT_EQ(0, uv_fs_sync_group_close(&group));
+
+  ASSERT_EQ(0, uv_fs_close(NULL, &req, file, NULL));
+  uv_fs_req_cleanup(&req);
+  uv_fs_unlink(NULL, &req, path, NULL);
+  uv_fs_req_cleanup(&req);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,219 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define ROOT "test_walk"
+
+static const char* walk_dirs[] = {
+  ROOT,
+  ROOT "/d1",
+  ROOT "/d1/d2",
+  ROOT "/prune"
+};
+
+static const char* walk_files[] = {
+  ROOT "/f1",
+  ROOT "/d1/f2",
+  ROOT "/d1/d2/f3",
+  ROOT "/prune/f4"
+};
+
+static uv_fs_walk_t walk;
+static int walk_entries;
+static int walk_dir_entries;
+static int walk_errors;
+static int walk_last_status;
+static int walk_done;
+static int walk_stop_after_first;
+
+
+static void remove_tree(void) {
+  uv_fs_t req;
+  int i;
+
+  for (i = ARRAY_SIZE(walk_files) - 1; i >= 0; i--) {
+    uv_fs_unlink(NULL, &req, walk_files[i], NULL);
+    uv_fs_req_cleanup(&req);
+  }
+
+  for (i = ARRAY_SIZE(walk_dirs) - 1; i >= 0; i--) {
+    uv_fs_rmdir(NULL, &req, walk_dirs[i], NULL);
+    uv_fs_req_cleanup(&req);
+  }
+}
+
+
+static void create_tree(void) {
+  uv_fs_t req;
+  size_t i;
+  int r;
+
+  remove_tree();
+
+  for (i = 0; i < ARRAY_SIZE(walk_dirs); i++) {
+    r = uv_fs_mkdir(NULL, &req, walk_dirs[i], 0755, NULL);
+    ASSERT(r == 0);
+    uv_fs_req_cleanup(&req);
+  }
+
+  for (i = 0; i < ARRAY_SIZE(walk_files); i++) {
+    r = uv_fs_open(NULL, &req, walk_files[i],
+                   UV_FS_O_WRONLY | UV_FS_O_CREAT, 0644, NULL);
+    ASSERT(r >= 0);
+    uv_fs_req_cleanup(&req);
+    ASSERT(0 == uv_fs_close(NULL, &req, r, NULL));
+    uv_fs_req_cleanup(&req);
+  }
+}
+
+
+static void reset_counters(void) {
+  walk_entries = 0;
+  walk_dir_entries = 0;
+  walk_errors = 0;
+  walk_last_status = 0;
+  walk_done = 0;
+  walk_stop_after_first = 0;
+}
+
+
+static void walk_cb(uv_fs_walk_t* w,
+                    int status,
+                    const uv_fs_walk_entry_t* entries,
+                    unsigned int nentries) {
+  unsigned int i;
+
+  ASSERT(w == &walk);
+  ASSERT(walk_done == 0);
+
+  if (status == UV_EOF || status == UV_ECANCELED) {
+    ASSERT_NULL(entries);
+    ASSERT(nentries == 0);
+    ASSERT_NULL(w->walk_ctx);
+    walk_last_status = status;
+    walk_done = 1;
+    return;
+  }
+
+  if (status < 0) {
+    ASSERT(nentries == 1);
+    ASSERT(entries[0].type == UV_DIRENT_DIR);
+    walk_last_status = status;
+    walk_errors++;
+    return;
+  }
+
+  ASSERT(nentries > 0);
+  for (i = 0; i < nentries; i++) {
+    ASSERT(0 == strncmp(entries[i].path, ROOT "/", sizeof(ROOT)));
+    ASSERT(entries[i].depth >= 1);
+    if (entries[i].type == UV_DIRENT_DIR) {
+      walk_dir_entries++;
+    } else {
+      ASSERT(entries[i].type == UV_DIRENT_FILE);
+      ASSERT(entries[i].path[strlen(entries[i].path) - 2] == 'f');
+    }
+    if (entries[i].statbuf != NULL) {
+      ASSERT(entries[i].type != UV_DIRENT_FILE ||
+             entries[i].statbuf->st_size == 0);
+    }
+  }
+
+  walk_entries += nentries;
+
+  if (walk_stop_after_first)
+    ASSERT(0 == uv_fs_walk_stop(w));
+}
+
+
+static int prune_filter_cb(uv_fs_walk_t* w, const uv_fs_walk_entry_t* dir) {
+  ASSERT(w == &walk);
+  ASSERT(dir->type == UV_DIRENT_DIR);
+  return strcmp(dir->path, ROOT "/prune") != 0;
+}
+
+
+TEST_IMPL(fs_walk) {
+  uv_fs_walk_options_t options;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  create_tree();
+
+  /* Full walk, with stat data. */
+  reset_counters();
+  memset(&options, 0, sizeof(options));
+  options.flags = UV_FS_WALK_STAT;
+  options.concurrency = 2;
+  ASSERT(0 == uv_fs_walk(loop, &walk, ROOT, &options, walk_cb));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(walk_done == 1);
+  ASSERT(walk_last_status == UV_EOF);
+  ASSERT(walk_entries == 7);
+  ASSERT(walk_dir_entries == 3);
+  ASSERT(walk_errors == 0);
+
+  /* Depth limit: only the children of the root. */
+  reset_counters();
+  memset(&options, 0, sizeof(options));
+  options.max_depth = 1;
+  ASSERT(0 == uv_fs_walk(loop, &walk, ROOT, &options, walk_cb));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(walk_last_status == UV_EOF);
+  ASSERT(walk_entries == 3);
+
+  /* Pruning: the subtree under ROOT/prune is not read. */
+  reset_counters();
+  memset(&options, 0, sizeof(options));
+  options.filter_cb = prune_filter_cb;
+  ASSERT(0 == uv_fs_walk(loop, &walk, ROOT, &options, walk_cb));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(walk_last_status == UV_EOF);
+  ASSERT(walk_entries == 6);
+
+  /* Stopping after the first batch. */
+  reset_counters();
+  walk_stop_after_first = 1;
+  ASSERT(0 == uv_fs_walk(loop, &walk, ROOT, NULL, walk_cb));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(walk_last_status == UV_ECANCELED);
+  ASSERT(walk_entries == 3);
+  ASSERT(UV_EINVAL == uv_fs_walk_stop(&walk));
+
+  /* A missing root is reported through the callback. */
+  reset_counters();
+  ASSERT(0 == uv_fs_walk(loop, &walk, ROOT "/missing", NULL, walk_cb));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(walk_errors == 1);
+  ASSERT(walk_last_status == UV_EOF);
+  ASSERT(walk_entries == 0);
+
+  ASSERT(UV_EINVAL == uv_fs_walk(loop, &walk, ROOT, NULL, NULL));
+
+  remove_tree();
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
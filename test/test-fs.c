@@ -2061,6 +2061,87 @@ TEST_IMPL(fs_realpath) {
 }
 
 
+static int realpath_cache_cb_count;
+
+static void realpath_cache_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_REALPATH);
+  ASSERT(req->result == 0);
+  ASSERT_NOT_NULL(req->ptr);
+  realpath_cache_cb_count++;
+}
+
+
+TEST_IMPL(fs_realpath_cache) {
+  char resolved[1024];
+  char path[1024];
+  uv_fs_t req;
+  size_t len;
+  int r;
+
+  loop = uv_default_loop();
+  rmdir("test_dir/sub");
+  rmdir("test_dir");
+
+  len = sizeof(path);
+  ASSERT(0 == uv_cwd(path, &len));
+  ASSERT(len + sizeof("/test_dir/sub") <= sizeof(path));
+  strcat(path, "/test_dir/sub");
+
+  r = uv_fs_mkdir(NULL, &req, "test_dir", 0755, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_mkdir(NULL, &req, "test_dir/sub", 0755, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  ASSERT(0 == uv_loop_configure(loop, UV_LOOP_REALPATH_CACHE, 16));
+
+  r = uv_fs_realpath(loop, &req, path, realpath_cache_cb);
+  ASSERT(r == 0);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(realpath_cache_cb_count == 1);
+  ASSERT(strlen(req.ptr) < sizeof(resolved));
+  strcpy(resolved, req.ptr);
+  uv_fs_req_cleanup(&req);
+
+  /* Served from the cache, so the removal goes unnoticed. */
+  r = uv_fs_rmdir(NULL, &req, "test_dir/sub", NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_realpath(NULL, &req, path, NULL);
+  ASSERT(r == UV_ENOENT);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_realpath(loop, &req, path, NULL);
+  ASSERT(r == 0);
+  ASSERT(0 == strcmp(req.ptr, resolved));
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_realpath(loop, &req, path, realpath_cache_cb);
+  ASSERT(r == 0);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(realpath_cache_cb_count == 2);
+  ASSERT(0 == strcmp(req.ptr, resolved));
+  uv_fs_req_cleanup(&req);
+
+  /* Flushing the parent drops the entry. */
+  path[strlen(path) - sizeof("/sub") + 1] = '\0';
+  uv_fs_realpath_cache_flush(loop, path);
+  strcat(path, "/sub");
+
+  r = uv_fs_realpath(loop, &req, path, NULL);
+  ASSERT(r == UV_ENOENT);
+  uv_fs_req_cleanup(&req);
+
+  ASSERT(0 == uv_loop_configure(loop, UV_LOOP_REALPATH_CACHE, 0));
+  rmdir("test_dir");
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
 TEST_IMPL(fs_symlink) {
   int r;
   uv_fs_t req;
@@ -2831,197 +2912,1310 @@ TEST_IMPL(fs_stat_missing_path) {
 }
 
 
-TEST_IMPL(fs_scandir_empty_dir) {
-  const char* path;
+static const char* const stat_many_paths[] = {
+  "test_file",
+  "non_existent_file",
+  "."
+};
+static uv_stat_t stat_many_bufs[ARRAY_SIZE(stat_many_paths)];
+static int stat_many_results[ARRAY_SIZE(stat_many_paths)];
+static int stat_many_cb_count;
+
+
+static void check_stat_many(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_STAT_MANY);
+  ASSERT(req->result == 2);
+  ASSERT(stat_many_results[0] == 0);
+  ASSERT(stat_many_bufs[0].st_size == 5);
+  ASSERT(stat_many_bufs[0].st_mode & S_IFREG);
+  ASSERT(stat_many_results[1] == UV_ENOENT);
+  ASSERT(stat_many_results[2] == 0);
+  ASSERT(stat_many_bufs[2].st_mode & S_IFDIR);
+}
+
+
+static void stat_many_cb(uv_fs_t* req) {
+  check_stat_many(req);
+  stat_many_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+TEST_IMPL(fs_stat_many) {
   uv_fs_t req;
-  uv_dirent_t dent;
+  uv_buf_t buf;
+  uv_file file;
   int r;
 
-  path = "./empty_dir/";
   loop = uv_default_loop();
+  unlink("test_file");
 
-  uv_fs_mkdir(NULL, &req, path, 0777, NULL);
+  r = uv_fs_open(NULL, &req, "test_file", O_WRONLY | O_CREAT,
+      S_IWUSR | S_IRUSR, NULL);
+  ASSERT(r >= 0);
+  file = r;
   uv_fs_req_cleanup(&req);
 
-  /* Fill the req to ensure that required fields are cleaned up */
-  memset(&req, 0xdb, sizeof(req));
-
-  r = uv_fs_scandir(NULL, &req, path, 0, NULL);
-  ASSERT(r == 0);
-  ASSERT(req.result == 0);
-  ASSERT_NULL(req.ptr);
-  ASSERT(UV_EOF == uv_fs_scandir_next(&req, &dent));
+  buf = uv_buf_init("hello", 5);
+  r = uv_fs_write(NULL, &req, file, &buf, 1, -1, NULL);
+  ASSERT(r == 5);
   uv_fs_req_cleanup(&req);
 
-  r = uv_fs_scandir(loop, &scandir_req, path, 0, empty_scandir_cb);
+  r = uv_fs_close(NULL, &req, file, NULL);
   ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
 
-  ASSERT(scandir_cb_count == 0);
-  uv_run(loop, UV_RUN_DEFAULT);
-  ASSERT(scandir_cb_count == 1);
+  r = uv_fs_stat_many(NULL, &req, stat_many_paths, 0,
+                      stat_many_bufs, stat_many_results, NULL);
+  ASSERT(r == UV_EINVAL);
 
-  uv_fs_rmdir(NULL, &req, path, NULL);
+  /* Test the synchronous version. */
+  r = uv_fs_stat_many(NULL, &req, stat_many_paths,
+                      ARRAY_SIZE(stat_many_paths),
+                      stat_many_bufs, stat_many_results, NULL);
+  ASSERT(r == 2);
+  check_stat_many(&req);
   uv_fs_req_cleanup(&req);
 
+  /* Test the asynchronous version. */
+  memset(stat_many_bufs, 0, sizeof(stat_many_bufs));
+  memset(stat_many_results, 0, sizeof(stat_many_results));
+  r = uv_fs_stat_many(loop, &req, stat_many_paths,
+                      ARRAY_SIZE(stat_many_paths),
+                      stat_many_bufs, stat_many_results, stat_many_cb);
+  ASSERT(r == 0);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(stat_many_cb_count == 1);
+
+  unlink("test_file");
+
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
 
 
-TEST_IMPL(fs_scandir_non_existent_dir) {
-  const char* path;
+static int statx_cb_count;
+
+static void statx_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_STATX);
+  ASSERT(req->result > 0);
+  ASSERT(req->result & UV_STATX_SIZE);
+  ASSERT(req->ptr == &req->statbuf);
+  ASSERT(req->statbuf.st_size == 5);
+  statx_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+TEST_IMPL(fs_statx) {
   uv_fs_t req;
-  uv_dirent_t dent;
+  uv_buf_t buf;
+  uv_file file;
   int r;
 
-  path = "./non_existent_dir/";
   loop = uv_default_loop();
+  unlink("test_file");
 
-  uv_fs_rmdir(NULL, &req, path, NULL);
+  r = uv_fs_open(NULL, &req, "test_file", O_WRONLY | O_CREAT,
+      S_IWUSR | S_IRUSR, NULL);
+  ASSERT(r >= 0);
+  file = r;
   uv_fs_req_cleanup(&req);
 
-  /* Fill the req to ensure that required fields are cleaned up */
-  memset(&req, 0xdb, sizeof(req));
+  buf = uv_buf_init("hello", 5);
+  r = uv_fs_write(NULL, &req, file, &buf, 1, -1, NULL);
+  ASSERT(r == 5);
+  uv_fs_req_cleanup(&req);
 
-  r = uv_fs_scandir(NULL, &req, path, 0, NULL);
+  r = uv_fs_close(NULL, &req, file, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_statx(NULL, &req, "test_file", 0, 0, NULL);
+  ASSERT(r == UV_EINVAL);
+  r = uv_fs_statx(NULL, &req, "test_file", 0x1000, 0, NULL);
+  ASSERT(r == UV_EINVAL);
+  r = uv_fs_statx(NULL, &req, "test_file", UV_STATX_SIZE,
+                  UV_FS_STATX_DONT_SYNC | UV_FS_STATX_FORCE_SYNC, NULL);
+  ASSERT(r == UV_EINVAL);
+
+  /* The result says which fields are there, it can be more than asked for. */
+  r = uv_fs_statx(NULL, &req, "test_file", UV_STATX_SIZE | UV_STATX_MTIME,
+                  UV_FS_STATX_DONT_SYNC, NULL);
+  ASSERT(r > 0);
+  ASSERT(req.result == r);
+  ASSERT((r & (UV_STATX_SIZE | UV_STATX_MTIME)) ==
+         (UV_STATX_SIZE | UV_STATX_MTIME));
+  ASSERT(req.statbuf.st_size == 5);
+  ASSERT(req.statbuf.st_mtim.tv_sec > 0);
+  ASSERT(req.ptr == &req.statbuf);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_statx(NULL, &req, "test_file", UV_STATX_ALL,
+                  UV_FS_STATX_FORCE_SYNC, NULL);
+  ASSERT(r > 0);
+  ASSERT((r & UV_STATX_BASIC_STATS) == UV_STATX_BASIC_STATS);
+  ASSERT(S_ISREG(req.statbuf.st_mode));
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_statx(NULL, &req, "no_such_file", UV_STATX_SIZE, 0, NULL);
   ASSERT(r == UV_ENOENT);
-  ASSERT(req.result == UV_ENOENT);
-  ASSERT_NULL(req.ptr);
-  ASSERT(UV_ENOENT == uv_fs_scandir_next(&req, &dent));
   uv_fs_req_cleanup(&req);
 
-  r = uv_fs_scandir(loop, &scandir_req, path, 0, non_existent_scandir_cb);
+  r = uv_fs_statx(loop, &req, "test_file", UV_STATX_SIZE, 0, statx_cb);
   ASSERT(r == 0);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(statx_cb_count == 1);
 
-  ASSERT(scandir_cb_count == 0);
-  uv_run(loop, UV_RUN_DEFAULT);
-  ASSERT(scandir_cb_count == 1);
+  unlink("test_file");
 
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
 
-TEST_IMPL(fs_scandir_file) {
-  const char* path;
-  int r;
 
-  path = "test/fixtures/empty_file";
-  loop = uv_default_loop();
+static int mmap_cb_count;
+static int munmap_cb_count;
 
-  r = uv_fs_scandir(NULL, &scandir_req, path, 0, NULL);
-  ASSERT(r == UV_ENOTDIR);
-  uv_fs_req_cleanup(&scandir_req);
 
-  r = uv_fs_scandir(loop, &scandir_req, path, 0, file_scandir_cb);
-  ASSERT(r == 0);
+static void mmap_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_MMAP);
+  ASSERT(req->result == 5);
+  ASSERT_NOT_NULL(req->ptr);
+  ASSERT(0 == memcmp(req->ptr, "world", 5));
+  ASSERT(0 == uv_fs_madvise(req->ptr, req->result, UV_FS_MADV_WILLNEED));
+  mmap_cb_count++;
+}
 
-  ASSERT(scandir_cb_count == 0);
-  uv_run(loop, UV_RUN_DEFAULT);
-  ASSERT(scandir_cb_count == 1);
 
-  MAKE_VALGRIND_HAPPY();
-  return 0;
+static void munmap_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_MUNMAP);
+  ASSERT(req->result == 0);
+  munmap_cb_count++;
 }
 
 
-TEST_IMPL(fs_open_dir) {
-  const char* path;
+TEST_IMPL(fs_mmap) {
+  uv_fs_t mmap_req;
   uv_fs_t req;
-  int r, file;
+  uv_buf_t buf;
+  uv_file file;
+  char data[16];
+  int r;
 
-  path = ".";
   loop = uv_default_loop();
+  unlink("test_file");
 
-  r = uv_fs_open(NULL, &req, path, O_RDONLY, 0, NULL);
+  r = uv_fs_open(NULL, &req, "test_file", UV_FS_O_RDWR | UV_FS_O_CREAT,
+      S_IWUSR | S_IRUSR, NULL);
   ASSERT(r >= 0);
-  ASSERT(req.result >= 0);
-  ASSERT_NULL(req.ptr);
   file = r;
   uv_fs_req_cleanup(&req);
 
-  r = uv_fs_close(NULL, &req, file, NULL);
+  buf = uv_buf_init("hello world", 11);
+  r = uv_fs_write(NULL, &req, file, &buf, 1, 0, NULL);
+  ASSERT(r == 11);
+  uv_fs_req_cleanup(&req);
+
+  /* Synchronous, the whole file, writable. */
+  r = uv_fs_mmap(NULL, &mmap_req, file, 0, 0,
+                 UV_FS_MMAP_WRITE | UV_FS_MMAP_POPULATE, NULL);
+  ASSERT(r == 11);
+  ASSERT(mmap_req.result == 11);
+  ASSERT(0 == memcmp(mmap_req.ptr, "hello world", 11));
+  ASSERT(0 == uv_fs_madvise(mmap_req.ptr, 11, UV_FS_MADV_SEQUENTIAL));
+  ASSERT(UV_EINVAL == uv_fs_madvise(mmap_req.ptr, 11, (uv_fs_madvice_t) 42));
+  memcpy(mmap_req.ptr, "HELLO", 5);
+  r = uv_fs_munmap(NULL, &req, mmap_req.ptr, mmap_req.result, NULL);
   ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  uv_fs_req_cleanup(&mmap_req);
 
-  r = uv_fs_open(loop, &req, path, O_RDONLY, 0, open_cb_simple);
+  memset(data, 0, sizeof(data));
+  buf = uv_buf_init(data, sizeof(data));
+  r = uv_fs_read(NULL, &req, file, &buf, 1, 0, NULL);
+  ASSERT(r == 11);
+  ASSERT(0 == memcmp(data, "HELLO world", 11));
+  uv_fs_req_cleanup(&req);
+
+  /* Asynchronous, at an offset that isn't page aligned. */
+  r = uv_fs_mmap(loop, &mmap_req, file, 6, 5, 0, mmap_cb);
   ASSERT(r == 0);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(mmap_cb_count == 1);
 
-  ASSERT(open_cb_count == 0);
-  uv_run(loop, UV_RUN_DEFAULT);
-  ASSERT(open_cb_count == 1);
+  r = uv_fs_munmap(loop, &req, mmap_req.ptr, mmap_req.result, munmap_cb);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&mmap_req);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(munmap_cb_count == 1);
+  uv_fs_req_cleanup(&req);
+
+  /* Nothing to map past the end of the file. */
+  r = uv_fs_mmap(NULL, &mmap_req, file, 11, 0, 0, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&mmap_req);
+
+  ASSERT(UV_EINVAL == uv_fs_munmap(NULL, &req, NULL, 11, NULL));
+
+  r = uv_fs_close(NULL, &req, file, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  unlink("test_file");
 
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
 
 
-static void fs_file_open_append(int add_flags) {
-  int r;
+static int fadvise_cb_count;
 
-  /* Setup. */
-  unlink("test_file");
 
-  loop = uv_default_loop();
+static void fadvise_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_FADVISE || req->fs_type == UV_FS_READAHEAD);
+  ASSERT(req->result == 0);
+  fadvise_cb_count++;
+  uv_fs_req_cleanup(req);
+}
 
-  r = uv_fs_open(NULL, &open_req1, "test_file",
-      O_WRONLY | O_CREAT | add_flags, S_IWUSR | S_IRUSR, NULL);
-  ASSERT(r >= 0);
-  ASSERT(open_req1.result >= 0);
-  uv_fs_req_cleanup(&open_req1);
 
-  iov = uv_buf_init(test_buf, sizeof(test_buf));
-  r = uv_fs_write(NULL, &write_req, open_req1.result, &iov, 1, -1, NULL);
-  ASSERT(r >= 0);
-  ASSERT(write_req.result >= 0);
-  uv_fs_req_cleanup(&write_req);
+static int fallocate_cb_count;
 
-  r = uv_fs_close(NULL, &close_req, open_req1.result, NULL);
-  ASSERT(r == 0);
-  ASSERT(close_req.result == 0);
-  uv_fs_req_cleanup(&close_req);
+static void fallocate_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_FALLOCATE);
+  ASSERT(req->result == 0);
+  fallocate_cb_count++;
+  uv_fs_req_cleanup(req);
+}
 
-  r = uv_fs_open(NULL, &open_req1, "test_file",
-      O_RDWR | O_APPEND | add_flags, 0, NULL);
-  ASSERT(r >= 0);
-  ASSERT(open_req1.result >= 0);
-  uv_fs_req_cleanup(&open_req1);
 
-  iov = uv_buf_init(test_buf, sizeof(test_buf));
-  r = uv_fs_write(NULL, &write_req, open_req1.result, &iov, 1, -1, NULL);
-  ASSERT(r >= 0);
-  ASSERT(write_req.result >= 0);
-  uv_fs_req_cleanup(&write_req);
+static void fallocate_check_zeros(uv_file file, int64_t offset, size_t len) {
+  char data[4096];
+  uv_buf_t buf;
+  uv_fs_t req;
+  size_t i;
+  int r;
 
-  r = uv_fs_close(NULL, &close_req, open_req1.result, NULL);
-  ASSERT(r == 0);
-  ASSERT(close_req.result == 0);
-  uv_fs_req_cleanup(&close_req);
+  ASSERT(len <= sizeof(data));
+  buf = uv_buf_init(data, len);
+  r = uv_fs_read(NULL, &req, file, &buf, 1, offset, NULL);
+  ASSERT(r == (int) len);
+  uv_fs_req_cleanup(&req);
 
-  r = uv_fs_open(NULL, &open_req1, "test_file", O_RDONLY | add_flags,
-      S_IRUSR, NULL);
-  ASSERT(r >= 0);
-  ASSERT(open_req1.result >= 0);
-  uv_fs_req_cleanup(&open_req1);
+  for (i = 0; i < len; i++)
+    ASSERT(data[i] == 0);
+}
 
-  iov = uv_buf_init(buf, sizeof(buf));
-  r = uv_fs_read(NULL, &read_req, open_req1.result, &iov, 1, -1, NULL);
-  printf("read = %d\n", r);
-  ASSERT(r == 26);
-  ASSERT(read_req.result == 26);
-  ASSERT(memcmp(buf,
-                "test-buffer\n\0test-buffer\n\0",
-                sizeof("test-buffer\n\0test-buffer\n\0") - 1) == 0);
-  uv_fs_req_cleanup(&read_req);
 
-  r = uv_fs_close(NULL, &close_req, open_req1.result, NULL);
-  ASSERT(r == 0);
-  ASSERT(close_req.result == 0);
-  uv_fs_req_cleanup(&close_req);
+TEST_IMPL(fs_fallocate) {
+  static char data[8192];
+  uv_fs_t req;
+  uv_buf_t buf;
+  uv_file file;
+  int r;
 
-  /* Cleanup */
+  loop = uv_default_loop();
   unlink("test_file");
-}
-TEST_IMPL(fs_file_open_append) {
-  fs_file_open_append(0);
+
+  r = uv_fs_open(NULL, &req, "test_file", UV_FS_O_RDWR | UV_FS_O_CREAT,
+      S_IWUSR | S_IRUSR, NULL);
+  ASSERT(r >= 0);
+  file = r;
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_fallocate(NULL, &req, file, 0, 0, 0, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_fallocate(NULL, &req, file, -1, 4096, 0, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_fallocate(NULL, &req, file, 0, 4096, 0x100, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_fallocate(NULL, &req, file, 0, 4096,
+                      UV_FS_FALLOCATE_PUNCH_HOLE | UV_FS_FALLOCATE_ZERO_RANGE,
+                      NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  /* Extends the file. */
+  r = uv_fs_fallocate(NULL, &req, file, 0, 65536, 0, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  ASSERT(0 == uv_fs_fstat(NULL, &req, file, NULL));
+  ASSERT(req.statbuf.st_size == 65536);
+  uv_fs_req_cleanup(&req);
+
+  /* Allocates past the end without changing the size. */
+  r = uv_fs_fallocate(NULL, &req, file, 65536, 65536,
+                      UV_FS_FALLOCATE_KEEP_SIZE, NULL);
+  ASSERT(r == 0 || r == UV_ENOTSUP);
+  uv_fs_req_cleanup(&req);
+  ASSERT(0 == uv_fs_fstat(NULL, &req, file, NULL));
+  ASSERT(req.statbuf.st_size == 65536);
+  uv_fs_req_cleanup(&req);
+
+  memset(data, 'x', sizeof(data));
+  buf = uv_buf_init(data, sizeof(data));
+  r = uv_fs_write(NULL, &req, file, &buf, 1, 0, NULL);
+  ASSERT(r == sizeof(data));
+  uv_fs_req_cleanup(&req);
+
+  /* Not every file system can punch holes or zero ranges. */
+  r = uv_fs_fallocate(NULL, &req, file, 0, 4096,
+                      UV_FS_FALLOCATE_PUNCH_HOLE, NULL);
+  ASSERT(r == 0 || r == UV_ENOTSUP);
+  uv_fs_req_cleanup(&req);
+  if (r == 0)
+    fallocate_check_zeros(file, 0, 4096);
+
+  r = uv_fs_fallocate(NULL, &req, file, 4096, 4096,
+                      UV_FS_FALLOCATE_ZERO_RANGE, NULL);
+  ASSERT(r == 0 || r == UV_ENOTSUP);
+  uv_fs_req_cleanup(&req);
+  if (r == 0)
+    fallocate_check_zeros(file, 4096, 4096);
+
+  ASSERT(0 == uv_fs_fstat(NULL, &req, file, NULL));
+  ASSERT(req.statbuf.st_size == 65536);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_fallocate(loop, &req, file, 65536, 4096, 0, fallocate_cb);
+  ASSERT(r == 0);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(fallocate_cb_count == 1);
+  ASSERT(0 == uv_fs_fstat(NULL, &req, file, NULL));
+  ASSERT(req.statbuf.st_size == 65536 + 4096);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_close(NULL, &req, file, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  unlink("test_file");
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static int write_atomic_cb_count;
+
+static void write_atomic_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_WRITE_ATOMIC);
+  ASSERT(req->result == 0);
+  write_atomic_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+static void check_file_contents(const char* path, const char* expected) {
+  char data[32];
+  uv_fs_t req;
+  uv_buf_t buf;
+  uv_file file;
+  int r;
+
+  r = uv_fs_open(NULL, &req, path, UV_FS_O_RDONLY, 0, NULL);
+  ASSERT(r >= 0);
+  file = r;
+  uv_fs_req_cleanup(&req);
+
+  buf = uv_buf_init(data, sizeof(data));
+  r = uv_fs_read(NULL, &req, file, &buf, 1, 0, NULL);
+  ASSERT(r == (int) strlen(expected));
+  ASSERT(0 == memcmp(data, expected, r));
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_close(NULL, &req, file, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+}
+
+
+TEST_IMPL(fs_write_atomic) {
+#if defined(_WIN32)
+  RETURN_SKIP("uv_fs_write_atomic() is not supported on Windows.");
+#else
+  uv_dirent_t dent;
+  uv_buf_t bufs[2];
+  uv_fs_t req;
+  int r;
+
+  loop = uv_default_loop();
+  unlink("test_dir/test_file");
+  rmdir("test_dir");
+
+  r = uv_fs_mkdir(NULL, &req, "test_dir", 0755, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  bufs[0] = uv_buf_init("old", 3);
+  r = uv_fs_write_atomic(NULL, &req, "test_dir/test_file", bufs, 1,
+                         S_IWUSR | S_IRUSR, 0x100, NULL);
+  ASSERT(r == UV_EINVAL);
+  r = uv_fs_write_atomic(NULL, &req, "no_such_dir/test_file", bufs, 1,
+                         S_IWUSR | S_IRUSR, 0, NULL);
+  ASSERT(r == UV_ENOENT);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_write_atomic(NULL, &req, "test_dir/test_file", bufs, 1,
+                         S_IWUSR | S_IRUSR, UV_FS_WRITE_ATOMIC_NOSYNC, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  check_file_contents("test_dir/test_file", "old");
+
+  /* Replaces the file as a whole. */
+  bufs[0] = uv_buf_init("brand ", 6);
+  bufs[1] = uv_buf_init("new", 3);
+  r = uv_fs_write_atomic(loop, &req, "test_dir/test_file", bufs, 2,
+                         S_IWUSR | S_IRUSR, 0, write_atomic_cb);
+  ASSERT(r == 0);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(write_atomic_cb_count == 1);
+  check_file_contents("test_dir/test_file", "brand new");
+
+  r = uv_fs_write_atomic(NULL, &req, "test_dir/test_file", NULL, 0,
+                         S_IWUSR | S_IRUSR, 0, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  check_file_contents("test_dir/test_file", "");
+
+  /* No temporary files were left behind. */
+  r = uv_fs_scandir(NULL, &req, "test_dir", 0, NULL);
+  ASSERT(r == 1);
+  ASSERT(0 == uv_fs_scandir_next(&req, &dent));
+  ASSERT(0 == strcmp(dent.name, "test_file"));
+  ASSERT(UV_EOF == uv_fs_scandir_next(&req, &dent));
+  uv_fs_req_cleanup(&req);
+
+  unlink("test_dir/test_file");
+  rmdir("test_dir");
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+static int write_batch_cb_count;
+
+static void write_batch_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_WRITE_BATCH);
+  ASSERT(req->result == 6);
+  write_batch_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+TEST_IMPL(fs_write_batch) {
+  uv_fs_write_segment_t segs[3];
+  uv_buf_t bufs[3];
+  uv_fs_t req;
+  uv_buf_t buf;
+  uv_file file;
+  char data[16];
+  int r;
+
+  loop = uv_default_loop();
+  unlink("test_file");
+
+  r = uv_fs_open(NULL, &req, "test_file", UV_FS_O_RDWR | UV_FS_O_CREAT,
+      S_IWUSR | S_IRUSR, NULL);
+  ASSERT(r >= 0);
+  file = r;
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_write_batch(NULL, &req, file, segs, 0, 0, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  bufs[0] = uv_buf_init("ab", 2);
+  bufs[1] = uv_buf_init("cd", 2);
+  bufs[2] = uv_buf_init("XYZ", 3);
+  segs[0].offset = -1;
+  segs[0].bufs = bufs;
+  segs[0].nbufs = 2;
+  r = uv_fs_write_batch(NULL, &req, file, segs, 1, 0, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  segs[0].offset = 0;
+  r = uv_fs_write_batch(NULL, &req, file, segs, 1, 0x100, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  /* A vectored segment, a segment past the end and an empty one. */
+  segs[1].offset = 10;
+  segs[1].bufs = bufs + 2;
+  segs[1].nbufs = 1;
+  segs[2].offset = 4;
+  segs[2].bufs = NULL;
+  segs[2].nbufs = 0;
+  r = uv_fs_write_batch(NULL, &req, file, segs, 3,
+                        UV_FS_WRITE_BATCH_DATASYNC, NULL);
+  ASSERT(r == 7);
+  ASSERT(req.result == 7);
+  uv_fs_req_cleanup(&req);
+
+  /* Later segments win where they overlap. */
+  segs[0].offset = 4;
+  segs[0].bufs = bufs + 1;
+  segs[0].nbufs = 1;
+  segs[1].offset = 5;
+  segs[1].bufs = bufs;
+  segs[1].nbufs = 1;
+  segs[2].offset = 11;
+  segs[2].bufs = bufs + 1;
+  segs[2].nbufs = 1;
+  r = uv_fs_write_batch(loop, &req, file, segs, 3, 0, write_batch_cb);
+  ASSERT(r == 0);
+  /* The segments were copied. */
+  memset(segs, 0, sizeof(segs));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(write_batch_cb_count == 1);
+
+  memset(data, 0, sizeof(data));
+  buf = uv_buf_init(data, sizeof(data));
+  r = uv_fs_read(NULL, &req, file, &buf, 1, 0, NULL);
+  ASSERT(r == 13);
+  uv_fs_req_cleanup(&req);
+  ASSERT(0 == memcmp(data, "abcdcab\0\0\0Xcd", 13));
+
+  r = uv_fs_close(NULL, &req, file, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  unlink("test_file");
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static int unlinkat_cb_count;
+
+static void unlinkat_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_UNLINKAT);
+  ASSERT(req->result == 0);
+  unlinkat_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+TEST_IMPL(fs_openat) {
+#if defined(_WIN32)
+  RETURN_SKIP("Directory relative operations are not supported on Windows.");
+#else
+  uv_fs_t req;
+  uv_dir_t* d;
+  uv_file dir;
+  uv_file fd;
+  int r;
+
+  loop = uv_default_loop();
+  unlink("test_dir/sub/file");
+  unlink("test_dir/link");
+  rmdir("test_dir/sub");
+  rmdir("test_dir");
+
+  r = uv_fs_mkdir(NULL, &req, "test_dir", 0755, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_open(NULL, &req, "test_dir",
+                 UV_FS_O_RDONLY | UV_FS_O_DIRECTORY, 0, NULL);
+  ASSERT(r >= 0);
+  dir = r;
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_mkdirat(NULL, &req, dir, "sub", 0755, 0, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_openat(NULL, &req, dir, "sub/file",
+                   UV_FS_O_WRONLY | UV_FS_O_CREAT, S_IWUSR | S_IRUSR, 0, NULL);
+  ASSERT(r >= 0);
+  fd = r;
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_close(NULL, &req, fd, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_symlink(NULL, &req, "sub/file", "test_dir/link", 0, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_statat(NULL, &req, dir, "link", 0, NULL);
+  ASSERT(r == 0);
+  ASSERT(S_ISREG(req.statbuf.st_mode));
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_statat(NULL, &req, dir, "link", UV_FS_AT_SYMLINK_NOFOLLOW, NULL);
+  ASSERT(r == 0);
+  ASSERT(S_ISLNK(req.statbuf.st_mode));
+  uv_fs_req_cleanup(&req);
+
+  /* Not every flag goes with every operation. */
+  r = uv_fs_openat(NULL, &req, dir, "sub/file", UV_FS_O_RDONLY, 0,
+                   UV_FS_AT_REMOVEDIR, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_mkdirat(NULL, &req, dir, "sub2", 0755,
+                    UV_FS_AT_SYMLINK_NOFOLLOW, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  /* UV_FS_AT_BENEATH keeps the lookup inside the directory. */
+  r = uv_fs_openat(NULL, &req, dir, "sub/file", UV_FS_O_RDONLY, 0,
+                   UV_FS_AT_BENEATH, NULL);
+  uv_fs_req_cleanup(&req);
+  if (r != UV_ENOSYS) {
+    ASSERT(r >= 0);
+    fd = r;
+    r = uv_fs_close(NULL, &req, fd, NULL);
+    ASSERT(r == 0);
+    uv_fs_req_cleanup(&req);
+
+    r = uv_fs_openat(NULL, &req, dir, "../test_dir/sub/file",
+                     UV_FS_O_RDONLY, 0, UV_FS_AT_BENEATH, NULL);
+    ASSERT(r == UV_EXDEV);
+    uv_fs_req_cleanup(&req);
+    r = uv_fs_statat(NULL, &req, dir, "/", UV_FS_AT_BENEATH, NULL);
+    ASSERT(r == UV_EXDEV);
+    uv_fs_req_cleanup(&req);
+    r = uv_fs_mkdirat(NULL, &req, dir, "sub/../../x", 0755,
+                      UV_FS_AT_BENEATH, NULL);
+    ASSERT(r == UV_EXDEV);
+    uv_fs_req_cleanup(&req);
+    r = uv_fs_statat(NULL, &req, dir, "sub/file", UV_FS_AT_BENEATH, NULL);
+    ASSERT(r == 0);
+    ASSERT(S_ISREG(req.statbuf.st_mode));
+    uv_fs_req_cleanup(&req);
+  }
+
+  r = uv_fs_unlinkat(loop, &req, dir, "sub/file", 0, unlinkat_cb);
+  ASSERT(r == 0);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(unlinkat_cb_count == 1);
+
+  r = uv_fs_unlinkat(NULL, &req, dir, "link", 0, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_unlinkat(NULL, &req, dir, "sub", 0, NULL);
+  ASSERT(r == UV_EISDIR || r == UV_EPERM);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_unlinkat(NULL, &req, dir, "sub", UV_FS_AT_REMOVEDIR, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_close(NULL, &req, dir, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  /* The descriptor of a uv_dir_t works as well. */
+  r = uv_fs_opendir(NULL, &req, "test_dir", NULL);
+  ASSERT(r == 0);
+  d = req.ptr;
+  uv_fs_req_cleanup(&req);
+  ASSERT(0 == uv_fs_dir_fileno(d, &dir));
+  r = uv_fs_statat(NULL, &req, dir, ".", 0, NULL);
+  ASSERT(r == 0);
+  ASSERT(S_ISDIR(req.statbuf.st_mode));
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_closedir(NULL, &req, d, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  rmdir("test_dir");
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+static int rm_rf_cb_count;
+
+static void rm_rf_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_RM_RF);
+  ASSERT(req->result == 0);
+  rm_rf_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+static void touch_file(const char* path) {
+  uv_fs_t req;
+  int r;
+
+  r = uv_fs_open(NULL, &req, path, UV_FS_O_WRONLY | UV_FS_O_CREAT,
+                 S_IWUSR | S_IRUSR, NULL);
+  ASSERT(r >= 0);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_close(NULL, &req, r, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+}
+
+
+TEST_IMPL(fs_mkdir_p_rm_rf) {
+  uv_fs_t req;
+  int r;
+
+  loop = uv_default_loop();
+  unlink("test_keep/file");
+  rmdir("test_keep");
+  unlink("test_file");
+
+  r = uv_fs_mkdir_p(NULL, &req, "test_dir/a/b//c/", 0755, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_stat(NULL, &req, "test_dir/a/b/c", NULL);
+  ASSERT(r == 0);
+  ASSERT(req.statbuf.st_mode & S_IFDIR);
+  uv_fs_req_cleanup(&req);
+
+  /* There already, which is fine as long as it's a directory. */
+  r = uv_fs_mkdir_p(NULL, &req, "test_dir/a/b", 0755, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  touch_file("test_file");
+  r = uv_fs_mkdir_p(NULL, &req, "test_file", 0755, NULL);
+  ASSERT(r == UV_EEXIST);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_mkdir_p(NULL, &req, "test_file/a", 0755, NULL);
+  ASSERT(r == UV_ENOTDIR || r == UV_ENOENT);
+  uv_fs_req_cleanup(&req);
+  unlink("test_file");
+
+#ifdef _WIN32
+  r = uv_fs_rm_rf(NULL, &req, "test_dir", NULL);
+  ASSERT(r == UV_ENOSYS);
+  uv_fs_req_cleanup(&req);
+  rmdir("test_dir/a/b/c");
+  rmdir("test_dir/a/b");
+  rmdir("test_dir/a");
+  rmdir("test_dir");
+#else
+  touch_file("test_dir/file");
+  touch_file("test_dir/a/file");
+  touch_file("test_dir/a/b/c/file");
+
+  /* The link goes, what it points to stays. */
+  r = uv_fs_mkdir(NULL, &req, "test_keep", 0755, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  touch_file("test_keep/file");
+  r = uv_fs_symlink(NULL, &req, "../../test_keep", "test_dir/a/link", 0, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_rm_rf(loop, &req, "test_dir", rm_rf_cb);
+  ASSERT(r == 0);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(rm_rf_cb_count == 1);
+
+  r = uv_fs_stat(NULL, &req, "test_dir", NULL);
+  ASSERT(r == UV_ENOENT);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_stat(NULL, &req, "test_keep/file", NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  /* Not there is not an error, and neither is a plain file. */
+  r = uv_fs_rm_rf(NULL, &req, "test_dir", NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_rm_rf(NULL, &req, "test_keep/file", NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_rm_rf(NULL, &req, "test_keep", NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_stat(NULL, &req, "test_keep", NULL);
+  ASSERT(r == UV_ENOENT);
+  uv_fs_req_cleanup(&req);
+#endif
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(fs_fadvise) {
+  static char data[64 * 1024];
+  uv_fs_t fadvise_req;
+  uv_fs_t readahead_req;
+  uv_fs_t req;
+  uv_buf_t buf;
+  uv_file file;
+  int advice;
+  int r;
+
+  loop = uv_default_loop();
+  unlink("test_file");
+
+  r = uv_fs_open(NULL, &req, "test_file", UV_FS_O_RDWR | UV_FS_O_CREAT,
+      S_IWUSR | S_IRUSR, NULL);
+  ASSERT(r >= 0);
+  file = r;
+  uv_fs_req_cleanup(&req);
+
+  memset(data, 'x', sizeof(data));
+  buf = uv_buf_init(data, sizeof(data));
+  r = uv_fs_write(NULL, &req, file, &buf, 1, 0, NULL);
+  ASSERT(r == sizeof(data));
+  uv_fs_req_cleanup(&req);
+
+  for (advice = UV_FS_FADV_NORMAL; advice <= UV_FS_FADV_DONTNEED; advice++) {
+    r = uv_fs_fadvise(NULL, &req, file, 0, 0, advice, NULL);
+    ASSERT(r == 0);
+    uv_fs_req_cleanup(&req);
+  }
+
+  r = uv_fs_fadvise(NULL, &req, file, 0, 0, (uv_fs_fadvice_t) 42, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_readahead(NULL, &req, file, 4096, 8192, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_readahead(NULL, &req, file, -1, 0, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_fadvise(loop, &fadvise_req, file, 0, sizeof(data) / 2,
+                    UV_FS_FADV_WILLNEED, fadvise_cb);
+  ASSERT(r == 0);
+  r = uv_fs_readahead(loop, &readahead_req, file, sizeof(data) / 2, 0,
+                      fadvise_cb);
+  ASSERT(r == 0);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(fadvise_cb_count == 2);
+
+  r = uv_fs_close(NULL, &req, file, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  unlink("test_file");
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static int direct_cb_count;
+
+
+static void direct_read_cb(uv_fs_t* req) {
+  ASSERT(req->fs_type == UV_FS_READ);
+  ASSERT(req->result > 0);
+  direct_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+TEST_IMPL(fs_read_write_direct) {
+  size_t offset_align;
+  size_t mem_align;
+  uv_fs_t req;
+  uv_buf_t buf;
+  uv_file file;
+  char* data;
+  char* p;
+  int r;
+
+  loop = uv_default_loop();
+  unlink("test_file");
+
+  p = uv_fs_aligned_alloc(4096, 100);
+  ASSERT_NOT_NULL(p);
+  ASSERT(((uintptr_t) p % 4096) == 0);
+  memset(p, 0, 100);
+  uv_fs_aligned_free(p);
+  uv_fs_aligned_free(NULL);
+  ASSERT_NULL(uv_fs_aligned_alloc(3, 100));
+
+  /* Not every file system supports O_DIRECT, the checks don't need it. */
+  r = uv_fs_open(NULL, &req, "test_file",
+                 UV_FS_O_RDWR | UV_FS_O_CREAT | UV_FS_O_DIRECT,
+                 S_IWUSR | S_IRUSR, NULL);
+  uv_fs_req_cleanup(&req);
+  if (r < 0) {
+    r = uv_fs_open(NULL, &req, "test_file", UV_FS_O_RDWR | UV_FS_O_CREAT,
+                   S_IWUSR | S_IRUSR, NULL);
+    uv_fs_req_cleanup(&req);
+  }
+  ASSERT(r >= 0);
+  file = r;
+
+  r = uv_fs_get_dio_alignment(file, &mem_align, &offset_align);
+  if (r == UV_ENOTSUP) {
+    uv_fs_close(NULL, &req, file, NULL);
+    uv_fs_req_cleanup(&req);
+    unlink("test_file");
+    RETURN_SKIP("File system doesn't support direct I/O");
+  }
+  ASSERT(r == 0);
+  ASSERT(mem_align > 0 && (mem_align & (mem_align - 1)) == 0);
+  ASSERT(offset_align > 0 && (offset_align & (offset_align - 1)) == 0);
+  ASSERT(UV_EINVAL == uv_fs_get_dio_alignment(file, NULL, &offset_align));
+
+  data = uv_fs_aligned_alloc(mem_align, 2 * offset_align);
+  ASSERT_NOT_NULL(data);
+  memset(data, 'x', 2 * offset_align);
+
+  /* Misaligned offset, length and buffer are rejected. */
+  buf = uv_buf_init(data, offset_align);
+  r = uv_fs_write_direct(NULL, &req, file, &buf, 1, 1, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  buf = uv_buf_init(data, offset_align - 1);
+  r = uv_fs_write_direct(NULL, &req, file, &buf, 1, 0, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  if (mem_align > 1) {
+    buf = uv_buf_init(data + 1, offset_align);
+    r = uv_fs_write_direct(NULL, &req, file, &buf, 1, 0, NULL);
+    ASSERT(r == UV_EINVAL);
+    uv_fs_req_cleanup(&req);
+  }
+
+  r = uv_fs_read_direct(NULL, &req, file, &buf, 1, -1, NULL);
+  ASSERT(r == UV_EINVAL);
+  uv_fs_req_cleanup(&req);
+
+  /* Aligned I/O goes through. */
+  buf = uv_buf_init(data, 2 * offset_align);
+  r = uv_fs_write_direct(NULL, &req, file, &buf, 1, 0, NULL);
+  ASSERT(r == (int) (2 * offset_align));
+  uv_fs_req_cleanup(&req);
+
+  memset(data, 0, 2 * offset_align);
+  buf = uv_buf_init(data, offset_align);
+  r = uv_fs_read_direct(NULL, &req, file, &buf, 1, offset_align, NULL);
+  ASSERT(r == (int) offset_align);
+  ASSERT(data[0] == 'x' && data[offset_align - 1] == 'x');
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_read_direct(loop, &req, file, &buf, 1, 0, direct_read_cb);
+  ASSERT(r == 0);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(direct_cb_count == 1);
+
+  uv_fs_aligned_free(data);
+
+  r = uv_fs_close(NULL, &req, file, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  unlink("test_file");
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(fs_scandir_empty_dir) {
+  const char* path;
+  uv_fs_t req;
+  uv_dirent_t dent;
+  int r;
+
+  path = "./empty_dir/";
+  loop = uv_default_loop();
+
+  uv_fs_mkdir(NULL, &req, path, 0777, NULL);
+  uv_fs_req_cleanup(&req);
+
+  /* Fill the req to ensure that required fields are cleaned up */
+  memset(&req, 0xdb, sizeof(req));
+
+  r = uv_fs_scandir(NULL, &req, path, 0, NULL);
+  ASSERT(r == 0);
+  ASSERT(req.result == 0);
+  ASSERT_NULL(req.ptr);
+  ASSERT(UV_EOF == uv_fs_scandir_next(&req, &dent));
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_scandir(loop, &scandir_req, path, 0, empty_scandir_cb);
+  ASSERT(r == 0);
+
+  ASSERT(scandir_cb_count == 0);
+  uv_run(loop, UV_RUN_DEFAULT);
+  ASSERT(scandir_cb_count == 1);
+
+  uv_fs_rmdir(NULL, &req, path, NULL);
+  uv_fs_req_cleanup(&req);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(fs_scandir_non_existent_dir) {
+  const char* path;
+  uv_fs_t req;
+  uv_dirent_t dent;
+  int r;
+
+  path = "./non_existent_dir/";
+  loop = uv_default_loop();
+
+  uv_fs_rmdir(NULL, &req, path, NULL);
+  uv_fs_req_cleanup(&req);
+
+  /* Fill the req to ensure that required fields are cleaned up */
+  memset(&req, 0xdb, sizeof(req));
+
+  r = uv_fs_scandir(NULL, &req, path, 0, NULL);
+  ASSERT(r == UV_ENOENT);
+  ASSERT(req.result == UV_ENOENT);
+  ASSERT_NULL(req.ptr);
+  ASSERT(UV_ENOENT == uv_fs_scandir_next(&req, &dent));
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_scandir(loop, &scandir_req, path, 0, non_existent_scandir_cb);
+  ASSERT(r == 0);
+
+  ASSERT(scandir_cb_count == 0);
+  uv_run(loop, UV_RUN_DEFAULT);
+  ASSERT(scandir_cb_count == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+#define SCANDIR_UNSORTED_FILES 100
+
+static void scandir_unsorted_check(uv_fs_t* req) {
+  char seen[SCANDIR_UNSORTED_FILES + 1];
+  uv_dirent_t dent;
+  int n;
+
+  memset(seen, 0, sizeof(seen));
+  ASSERT(req->fs_type == UV_FS_SCANDIR);
+  ASSERT(req->result == SCANDIR_UNSORTED_FILES + 1);
+
+  while (UV_EOF != uv_fs_scandir_next(req, &dent)) {
+    if (strcmp(dent.name, "sub") == 0) {
+      ASSERT(dent.type == UV_DIRENT_DIR || dent.type == UV_DIRENT_UNKNOWN);
+      n = SCANDIR_UNSORTED_FILES;
+    } else {
+      ASSERT(dent.type == UV_DIRENT_FILE || dent.type == UV_DIRENT_UNKNOWN);
+      ASSERT(dent.name[0] == 'f');
+      n = atoi(dent.name + 1);
+      ASSERT(n >= 0 && n < SCANDIR_UNSORTED_FILES);
+    }
+    ASSERT(seen[n] == 0);
+    seen[n] = 1;
+  }
+
+  for (n = 0; n <= SCANDIR_UNSORTED_FILES; n++)
+    ASSERT(seen[n] == 1);
+
+  ASSERT_NULL(req->ptr);
+}
+
+
+static void scandir_unsorted_cb(uv_fs_t* req) {
+  ASSERT(req == &scandir_req);
+  scandir_unsorted_check(req);
+  scandir_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+TEST_IMPL(fs_scandir_unsorted) {
+  uv_dirent_t dent;
+  uv_fs_t req;
+  char path[64];
+  int r;
+  int i;
+
+  loop = uv_default_loop();
+
+  rmdir("test_dir/sub");
+  for (i = 0; i < SCANDIR_UNSORTED_FILES; i++) {
+    snprintf(path, sizeof(path), "test_dir/f%03d", i);
+    unlink(path);
+  }
+  rmdir("test_dir");
+
+  r = uv_fs_mkdir(NULL, &req, "test_dir", 0755, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+  r = uv_fs_mkdir(NULL, &req, "test_dir/sub", 0755, NULL);
+  ASSERT(r == 0);
+  uv_fs_req_cleanup(&req);
+
+  for (i = 0; i < SCANDIR_UNSORTED_FILES; i++) {
+    snprintf(path, sizeof(path), "test_dir/f%03d", i);
+    r = uv_fs_open(NULL, &req, path, O_WRONLY | O_CREAT,
+        S_IWUSR | S_IRUSR, NULL);
+    ASSERT(r >= 0);
+    uv_fs_req_cleanup(&req);
+    uv_fs_close(NULL, &req, r, NULL);
+    uv_fs_req_cleanup(&req);
+  }
+
+  /* Test the synchronous version. */
+  r = uv_fs_scandir(NULL, &scandir_req, "test_dir", UV_FS_SCANDIR_UNSORTED,
+                    NULL);
+  ASSERT(r == SCANDIR_UNSORTED_FILES + 1);
+  scandir_unsorted_check(&scandir_req);
+  uv_fs_req_cleanup(&scandir_req);
+
+  /* Stopping halfway through must not leak or double free. */
+  r = uv_fs_scandir(NULL, &scandir_req, "test_dir", UV_FS_SCANDIR_UNSORTED,
+                    NULL);
+  ASSERT(r == SCANDIR_UNSORTED_FILES + 1);
+  ASSERT(0 == uv_fs_scandir_next(&scandir_req, &dent));
+  ASSERT(0 == uv_fs_scandir_next(&scandir_req, &dent));
+  uv_fs_req_cleanup(&scandir_req);
+
+  /* Test the asynchronous version. */
+  r = uv_fs_scandir(loop, &scandir_req, "test_dir", UV_FS_SCANDIR_UNSORTED,
+                    scandir_unsorted_cb);
+  ASSERT(r == 0);
+  ASSERT(scandir_cb_count == 0);
+  uv_run(loop, UV_RUN_DEFAULT);
+  ASSERT(scandir_cb_count == 1);
+
+  rmdir("test_dir/sub");
+  for (i = 0; i < SCANDIR_UNSORTED_FILES; i++) {
+    snprintf(path, sizeof(path), "test_dir/f%03d", i);
+    unlink(path);
+  }
+  rmdir("test_dir");
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+TEST_IMPL(fs_scandir_file) {
+  const char* path;
+  int r;
+
+  path = "test/fixtures/empty_file";
+  loop = uv_default_loop();
+
+  r = uv_fs_scandir(NULL, &scandir_req, path, 0, NULL);
+  ASSERT(r == UV_ENOTDIR);
+  uv_fs_req_cleanup(&scandir_req);
+
+  r = uv_fs_scandir(loop, &scandir_req, path, 0, file_scandir_cb);
+  ASSERT(r == 0);
+
+  ASSERT(scandir_cb_count == 0);
+  uv_run(loop, UV_RUN_DEFAULT);
+  ASSERT(scandir_cb_count == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(fs_open_dir) {
+  const char* path;
+  uv_fs_t req;
+  int r, file;
+
+  path = ".";
+  loop = uv_default_loop();
+
+  r = uv_fs_open(NULL, &req, path, O_RDONLY, 0, NULL);
+  ASSERT(r >= 0);
+  ASSERT(req.result >= 0);
+  ASSERT_NULL(req.ptr);
+  file = r;
+  uv_fs_req_cleanup(&req);
+
+  r = uv_fs_close(NULL, &req, file, NULL);
+  ASSERT(r == 0);
+
+  r = uv_fs_open(loop, &req, path, O_RDONLY, 0, open_cb_simple);
+  ASSERT(r == 0);
+
+  ASSERT(open_cb_count == 0);
+  uv_run(loop, UV_RUN_DEFAULT);
+  ASSERT(open_cb_count == 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void fs_file_open_append(int add_flags) {
+  int r;
+
+  /* Setup. */
+  unlink("test_file");
+
+  loop = uv_default_loop();
+
+  r = uv_fs_open(NULL, &open_req1, "test_file",
+      O_WRONLY | O_CREAT | add_flags, S_IWUSR | S_IRUSR, NULL);
+  ASSERT(r >= 0);
+  ASSERT(open_req1.result >= 0);
+  uv_fs_req_cleanup(&open_req1);
+
+  iov = uv_buf_init(test_buf, sizeof(test_buf));
+  r = uv_fs_write(NULL, &write_req, open_req1.result, &iov, 1, -1, NULL);
+  ASSERT(r >= 0);
+  ASSERT(write_req.result >= 0);
+  uv_fs_req_cleanup(&write_req);
+
+  r = uv_fs_close(NULL, &close_req, open_req1.result, NULL);
+  ASSERT(r == 0);
+  ASSERT(close_req.result == 0);
+  uv_fs_req_cleanup(&close_req);
+
+  r = uv_fs_open(NULL, &open_req1, "test_file",
+      O_RDWR | O_APPEND | add_flags, 0, NULL);
+  ASSERT(r >= 0);
+  ASSERT(open_req1.result >= 0);
+  uv_fs_req_cleanup(&open_req1);
+
+  iov = uv_buf_init(test_buf, sizeof(test_buf));
+  r = uv_fs_write(NULL, &write_req, open_req1.result, &iov, 1, -1, NULL);
+  ASSERT(r >= 0);
+  ASSERT(write_req.result >= 0);
+  uv_fs_req_cleanup(&write_req);
+
+  r = uv_fs_close(NULL, &close_req, open_req1.result, NULL);
+  ASSERT(r == 0);
+  ASSERT(close_req.result == 0);
+  uv_fs_req_cleanup(&close_req);
+
+  r = uv_fs_open(NULL, &open_req1, "test_file", O_RDONLY | add_flags,
+      S_IRUSR, NULL);
+  ASSERT(r >= 0);
+  ASSERT(open_req1.result >= 0);
+  uv_fs_req_cleanup(&open_req1);
+
+  iov = uv_buf_init(buf, sizeof(buf));
+  r = uv_fs_read(NULL, &read_req, open_req1.result, &iov, 1, -1, NULL);
+  printf("read = %d\n", r);
+  ASSERT(r == 26);
+  ASSERT(read_req.result == 26);
+  ASSERT(memcmp(buf,
+                "test-buffer\n\0test-buffer\n\0",
+                sizeof("test-buffer\n\0test-buffer\n\0") - 1) == 0);
+  uv_fs_req_cleanup(&read_req);
+
+  r = uv_fs_close(NULL, &close_req, open_req1.result, NULL);
+  ASSERT(r == 0);
+  ASSERT(close_req.result == 0);
+  uv_fs_req_cleanup(&close_req);
+
+  /* Cleanup */
+  unlink("test_file");
+}
+TEST_IMPL(fs_file_open_append) {
+  fs_file_open_append(0);
   fs_file_open_append(UV_FS_O_FILEMAP);
 
   MAKE_VALGRIND_HAPPY();
@@ -3150,6 +4344,7 @@ static void fs_read_bufs(int add_flags) {
 TEST_IMPL(fs_read_bufs) {
   fs_read_bufs(0);
   fs_read_bufs(UV_FS_O_FILEMAP);
+  fs_read_bufs(UV_FS_O_OVERLAPPED);
 
   MAKE_VALGRIND_HAPPY();
   return 0;
@@ -3316,6 +4511,74 @@ TEST_IMPL(fs_write_multiple_bufs) {
 }
 
 
+static char overlapped_out[2][64];
+static char overlapped_in[2][64];
+
+
+static void overlapped_read_cb(uv_fs_t* req) {
+  ASSERT_PTR_EQ(req, &read_req);
+  ASSERT_EQ(2 * sizeof(overlapped_out[0]), req->result);
+  ASSERT_EQ(0, memcmp(overlapped_in, overlapped_out, sizeof(overlapped_in)));
+  read_cb_count++;
+  uv_fs_req_cleanup(req);
+}
+
+
+static void overlapped_write_cb(uv_fs_t* req) {
+  uv_buf_t bufs[2];
+
+  ASSERT_PTR_EQ(req, &write_req);
+  ASSERT_EQ(2 * sizeof(overlapped_out[0]), req->result);
+  write_cb_count++;
+  uv_fs_req_cleanup(req);
+
+  bufs[0] = uv_buf_init(overlapped_in[0], sizeof(overlapped_in[0]));
+  bufs[1] = uv_buf_init(overlapped_in[1], sizeof(overlapped_in[1]));
+  ASSERT_EQ(0, uv_fs_read(loop, &read_req, open_req1.result, bufs, 2, 100,
+                          overlapped_read_cb));
+}
+
+
+TEST_IMPL(fs_read_write_overlapped) {
+  uv_buf_t bufs[2];
+  uv_buf_t buf;
+  int r;
+
+  unlink("test_file");
+  loop = uv_default_loop();
+  memset(overlapped_out[0], 'a', sizeof(overlapped_out[0]));
+  memset(overlapped_out[1], 'b', sizeof(overlapped_out[1]));
+
+  /* Opened with a loop, so its reads and writes can complete on it. */
+  r = uv_fs_open(loop, &open_req1, "test_file",
+                 O_RDWR | O_CREAT | UV_FS_O_OVERLAPPED, S_IWUSR | S_IRUSR,
+                 NULL);
+  ASSERT_GE(r, 0);
+  uv_fs_req_cleanup(&open_req1);
+
+  bufs[0] = uv_buf_init(overlapped_out[0], sizeof(overlapped_out[0]));
+  bufs[1] = uv_buf_init(overlapped_out[1], sizeof(overlapped_out[1]));
+  ASSERT_EQ(0, uv_fs_write(loop, &write_req, open_req1.result, bufs, 2, 100,
+                           overlapped_write_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, write_cb_count);
+  ASSERT_EQ(1, read_cb_count);
+
+  /* Past the end of the file. */
+  buf = uv_buf_init(overlapped_in[0], sizeof(overlapped_in[0]));
+  r = uv_fs_read(NULL, &read_req, open_req1.result, &buf, 1, 1000, NULL);
+  ASSERT_EQ(0, r);
+  uv_fs_req_cleanup(&read_req);
+
+  ASSERT_EQ(0, uv_fs_close(NULL, &close_req, open_req1.result, NULL));
+  uv_fs_req_cleanup(&close_req);
+  unlink("test_file");
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
 static void fs_write_alotof_bufs(int add_flags) {
   size_t iovcount;
   size_t iovmax;
@@ -42,3 +42,37 @@ TEST_IMPL(get_memory) {
 #endif
   return 0;
 }
+
+
+TEST_IMPL(get_resource_constraints) {
+  uv_resource_constraints_t rc;
+  int err;
+
+  err = uv_get_resource_constraints(&rc);
+#ifndef __linux__
+  ASSERT_EQ(UV_ENOSYS, err);
+#else
+  if (err == UV_ENOENT)
+    RETURN_SKIP("/proc/self/cgroup is not available.");
+  ASSERT_EQ(0, err);
+
+  printf("cgroup v%d, cpu quota=%llu/%llu, memory limit=%llu usage=%llu\n",
+         rc.cgroup_version,
+         (unsigned long long) rc.cpu_quota,
+         (unsigned long long) rc.cpu_period,
+         (unsigned long long) rc.memory_limit,
+         (unsigned long long) rc.memory_usage);
+
+  ASSERT_GE(rc.cgroup_version, 0);
+  ASSERT_LE(rc.cgroup_version, 2);
+  ASSERT(rc.cpu_quota == 0 || rc.cpu_period > 0);
+  ASSERT_EQ(rc.memory_limit, uv_get_constrained_memory());
+  ASSERT(rc.cpu_pressure[0] == -1 || rc.cpu_pressure[0] >= 0);
+  ASSERT(rc.io_pressure[2] == -1 || rc.io_pressure[2] <= 100);
+
+  if (rc.cpu_quota != 0)
+    ASSERT_LE(uv_available_parallelism(),
+              (rc.cpu_quota + rc.cpu_period - 1) / rc.cpu_period);
+#endif
+  return 0;
+}
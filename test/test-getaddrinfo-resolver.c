@@ -0,0 +1,276 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+
+#define RESOLV_CONF "resolv-test.conf"
+
+/* A name server that answers based on the first label of the question:
+ * "udp" gets 10.0.0.1, "tcp" gets a truncated UDP answer and 10.0.0.2 over
+ * TCP, "nx" gets NXDOMAIN and "drop" gets nothing at all.
+ */
+static uv_udp_t udp_server;
+static uv_tcp_t tcp_server;
+static uv_tcp_t tcp_conn;
+static char tcp_buf[1024];
+static size_t tcp_len;
+static int lookup_cb_called;
+
+
+struct lookup {
+  uv_getaddrinfo_t req;
+  const char* name;
+  int status;
+  const char* addr;
+};
+
+static struct lookup lookups[] = {
+  { { 0 }, "udp.example.test.", 0, "10.0.0.1" },
+  { { 0 }, "tcp.example.test.", 0, "10.0.0.2" },
+  { { 0 }, "nx.example.test.", UV_EAI_NONAME, NULL },
+  { { 0 }, "drop.example.test.", UV_EAI_AGAIN, NULL },
+};
+
+
+static size_t make_answer(const char* query, size_t len, char* out, int tcp) {
+  unsigned char* p;
+  size_t qend;
+  char label[16];
+  size_t n;
+
+  p = (unsigned char*) out;
+  ASSERT(len > 12 && len < 512);
+  n = (unsigned char) query[12];
+  ASSERT(n < sizeof(label));
+  memcpy(label, query + 13, n);
+  label[n] = '\0';
+
+  /* Header and question, the question runs up to the type and class. */
+  for (qend = 12; query[qend] != 0; qend += 1 + (unsigned char) query[qend]);
+  qend += 5;
+  ASSERT(qend <= len);
+  memcpy(out, query, qend);
+
+  p[2] = 0x81;  /* QR, RD */
+  p[3] = 0x80;  /* RA */
+  memset(p + 6, 0, 6);
+
+  if (0 == strcmp(label, "drop"))
+    return 0;
+
+  if (0 == strcmp(label, "nx")) {
+    p[3] |= 3;
+    return qend;
+  }
+
+  if (0 == strcmp(label, "tcp") && !tcp) {
+    p[2] |= 0x02;  /* TC */
+    return qend;
+  }
+
+  p[7] = 1;
+  memcpy(p + qend, "\xC0\x0C\x00\x01\x00\x01\x00\x00\x00\x3C\x00\x04", 12);
+  p[qend + 12] = 10;
+  p[qend + 13] = 0;
+  p[qend + 14] = 0;
+  p[qend + 15] = tcp ? 2 : 1;
+
+  return qend + 16;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  static char slab[1024];
+
+  if (handle == (uv_handle_t*) &tcp_conn) {
+    buf->base = tcp_buf + tcp_len;
+    buf->len = 512 - tcp_len;
+  } else {
+    buf->base = slab;
+    buf->len = sizeof(slab);
+  }
+}
+
+
+static void udp_recv_cb(uv_udp_t* handle,
+                        ssize_t nread,
+                        const uv_buf_t* buf,
+                        const struct sockaddr* addr,
+                        unsigned flags) {
+  char answer[1024];
+  uv_buf_t reply;
+  size_t n;
+
+  ASSERT(nread >= 0);
+  if (nread == 0)
+    return;
+
+  n = make_answer(buf->base, nread, answer, 0);
+  if (n == 0)
+    return;
+
+  reply = uv_buf_init(answer, n);
+  ASSERT(n == (size_t) uv_udp_try_send(handle, &reply, 1, addr));
+}
+
+
+static void tcp_read_cb(uv_stream_t* stream,
+                        ssize_t nread,
+                        const uv_buf_t* buf) {
+  uv_buf_t reply;
+  size_t need;
+  size_t n;
+
+  if (nread < 0) {
+    uv_close((uv_handle_t*) stream, NULL);
+    return;
+  }
+
+  tcp_len += nread;
+  if (tcp_len < 2)
+    return;
+
+  need = 2 + ((unsigned char) tcp_buf[0] << 8 | (unsigned char) tcp_buf[1]);
+  if (tcp_len < need)
+    return;
+
+  /* The answer goes after the query in tcp_buf, behind its length. */
+  n = make_answer(tcp_buf + 2, need - 2, tcp_buf + 512, 1);
+  tcp_buf[510] = n >> 8;
+  tcp_buf[511] = n & 0xFF;
+  reply = uv_buf_init(tcp_buf + 510, n + 2);
+  ASSERT((int) n + 2 == uv_try_write(stream, &reply, 1));
+  uv_close((uv_handle_t*) stream, NULL);
+}
+
+
+static void connection_cb(uv_stream_t* server, int status) {
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(server->loop, &tcp_conn));
+  ASSERT(0 == uv_accept(server, (uv_stream_t*) &tcp_conn));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &tcp_conn, alloc_cb, tcp_read_cb));
+}
+
+
+static void lookup_cb(uv_getaddrinfo_t* req, int status, struct addrinfo* res) {
+  struct lookup* l;
+  struct sockaddr_in* sin;
+  char addr[16];
+
+  l = container_of(req, struct lookup, req);
+  ASSERT(status == l->status);
+
+  if (l->addr != NULL) {
+    ASSERT_NOT_NULL(res);
+    ASSERT(res->ai_family == AF_INET);
+    ASSERT(res->ai_socktype == SOCK_STREAM);
+    ASSERT_NULL(res->ai_next);
+    sin = (struct sockaddr_in*) res->ai_addr;
+    ASSERT(ntohs(sin->sin_port) == 80);
+    ASSERT(0 == uv_ip4_name(sin, addr, sizeof(addr)));
+    ASSERT(0 == strcmp(addr, l->addr));
+  } else {
+    ASSERT_NULL(res);
+  }
+
+  uv_freeaddrinfo(res);
+
+  if (++lookup_cb_called == (int) ARRAY_SIZE(lookups)) {
+    uv_close((uv_handle_t*) &udp_server, NULL);
+    uv_close((uv_handle_t*) &tcp_server, NULL);
+  }
+}
+
+#endif  /* !_WIN32 */
+
+
+TEST_IMPL(getaddrinfo_resolver) {
+#ifdef _WIN32
+  ASSERT(UV_ENOSYS == uv_loop_configure(uv_default_loop(),
+                                        UV_LOOP_USE_DNS_RESOLVER,
+                                        NULL));
+  RETURN_SKIP("Not implemented on Windows");
+#else
+  struct sockaddr_in addr;
+  struct addrinfo hints;
+  uv_loop_t* loop;
+  char conf[128];
+  int namelen;
+  size_t i;
+  FILE* fp;
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", 0, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &tcp_server));
+  ASSERT(0 == uv_tcp_bind(&tcp_server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &tcp_server, 1, connection_cb));
+  namelen = sizeof(addr);
+  ASSERT(0 == uv_tcp_getsockname(&tcp_server,
+                                 (struct sockaddr*) &addr,
+                                 &namelen));
+
+  /* Same port number for both, like a real name server. */
+  ASSERT(0 == uv_udp_init(loop, &udp_server));
+  ASSERT(0 == uv_udp_bind(&udp_server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_udp_recv_start(&udp_server, alloc_cb, udp_recv_cb));
+
+  snprintf(conf,
+           sizeof(conf),
+           "nameserver 127.0.0.1:%d\noptions timeout:1 attempts:1\n",
+           ntohs(addr.sin_port));
+  fp = fopen(RESOLV_CONF, "w");
+  ASSERT_NOT_NULL(fp);
+  ASSERT(strlen(conf) == fwrite(conf, 1, strlen(conf), fp));
+  ASSERT(0 == fclose(fp));
+
+  ASSERT(0 == uv_loop_configure(loop, UV_LOOP_USE_DNS_RESOLVER, RESOLV_CONF));
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+
+  for (i = 0; i < ARRAY_SIZE(lookups); i++)
+    ASSERT(0 == uv_getaddrinfo(loop,
+                               &lookups[i].req,
+                               lookup_cb,
+                               lookups[i].name,
+                               "80",
+                               &hints));
+
+  /* Nothing went to the threadpool. */
+  ASSERT(UV_EBUSY == uv_cancel((uv_req_t*) &lookups[0].req));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(lookup_cb_called == (int) ARRAY_SIZE(lookups));
+
+  remove(RESOLV_CONF);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
@@ -22,6 +22,7 @@
 #include "uv.h"
 #include "task.h"
 #include <stdlib.h>
+#include <string.h>
 
 #define CONCURRENT_COUNT    10
 
@@ -213,3 +214,113 @@ TEST_IMPL(getaddrinfo_concurrent) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static uv_work_t cache_pause_reqs[4];
+static uv_sem_t cache_pause_sems[ARRAY_SIZE(cache_pause_reqs)];
+static int cache_cb_called;
+
+
+static void cache_pause_work_cb(uv_work_t* req) {
+  uv_sem_wait(cache_pause_sems + (req - cache_pause_reqs));
+}
+
+
+static void cache_pause_done_cb(uv_work_t* req, int status) {
+  ASSERT(status == 0);
+  uv_sem_destroy(cache_pause_sems + (req - cache_pause_reqs));
+}
+
+
+static void getaddrinfo_cache_cb(uv_getaddrinfo_t* req,
+                                 int status,
+                                 struct addrinfo* res) {
+  size_t i;
+
+  ASSERT(status == 0);
+  ASSERT_NOT_NULL(res);
+  ASSERT_NOT_NULL(res->ai_addr);
+  uv_freeaddrinfo(res);
+  cache_cb_called++;
+
+  /* Let the threadpool go again, the hit didn't need it. */
+  if (req->data != NULL)
+    for (i = 0; i < ARRAY_SIZE(cache_pause_reqs); i++)
+      uv_sem_post(cache_pause_sems + i);
+}
+
+
+TEST_IMPL(getaddrinfo_cache) {
+#if defined(__QEMU__)
+  RETURN_SKIP("Test does not currently work in QEMU");
+#endif
+  uv_getaddrinfo_cache_options_t options;
+  uv_getaddrinfo_t req;
+  uv_loop_t* loop;
+  char buf[64];
+  size_t i;
+
+  memset(&options, 0, sizeof(options));
+#ifdef _WIN32
+  ASSERT(UV_ENOSYS == uv_getaddrinfo_cache_configure(&options));
+  RETURN_SKIP("Not implemented on Windows");
+#endif
+  ASSERT(UV_EINVAL == uv_getaddrinfo_cache_configure(&options));
+
+  options.ttl = 60000;
+  ASSERT(0 == uv_getaddrinfo_cache_configure(&options));
+
+  snprintf(buf,
+           sizeof(buf),
+           "UV_THREADPOOL_SIZE=%lu",
+           (unsigned long) ARRAY_SIZE(cache_pause_reqs));
+  putenv(buf);
+
+  loop = uv_default_loop();
+
+  /* Fills the cache. */
+  ASSERT(0 == uv_getaddrinfo(loop, &req, NULL, name, NULL, NULL));
+  ASSERT_NOT_NULL(req.addrinfo);
+  uv_freeaddrinfo(req.addrinfo);
+
+  for (i = 0; i < ARRAY_SIZE(cache_pause_reqs); i++) {
+    ASSERT(0 == uv_sem_init(cache_pause_sems + i, 0));
+    ASSERT(0 == uv_queue_work(loop,
+                              cache_pause_reqs + i,
+                              cache_pause_work_cb,
+                              cache_pause_done_cb));
+  }
+
+  /* The threadpool is busy, a lookup that went to it could be cancelled. */
+  req.data = &req;
+  ASSERT(0 == uv_getaddrinfo(loop, &req, getaddrinfo_cache_cb, name, NULL,
+                             NULL));
+  ASSERT(UV_EBUSY == uv_cancel((uv_req_t*) &req));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(1 == cache_cb_called);
+
+  /* Served stale, then refreshed in the background. */
+  ASSERT(0 == uv_getaddrinfo_cache_configure(NULL));
+  options.ttl = 1;
+  options.stale_ttl = 60000;
+  ASSERT(0 == uv_getaddrinfo_cache_configure(&options));
+
+  ASSERT(0 == uv_getaddrinfo(loop, &req, NULL, name, NULL, NULL));
+  uv_freeaddrinfo(req.addrinfo);
+  uv_sleep(10);
+
+  req.data = NULL;
+  ASSERT(0 == uv_getaddrinfo(loop, &req, getaddrinfo_cache_cb, name, NULL,
+                             NULL));
+  ASSERT(UV_EBUSY == uv_cancel((uv_req_t*) &req));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(2 == cache_cb_called);
+
+  /* Disabled again, lookups go to libc. */
+  ASSERT(0 == uv_getaddrinfo_cache_configure(NULL));
+  ASSERT(0 == uv_getaddrinfo(loop, &req, NULL, name, NULL, NULL));
+  uv_freeaddrinfo(req.addrinfo);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -114,3 +114,192 @@ TEST_IMPL(getnameinfo_basic_ip6) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static uv_nameinfo_t names[3];
+static int many_cb_called;
+
+
+static void check_names(void) {
+  ASSERT(names[0].status == 0);
+  ASSERT(names[0].host[0] != '\0');
+  ASSERT(names[0].service[0] != '\0');
+  ASSERT(names[1].status == UV_EINVAL);
+  ASSERT(names[2].status == 0);
+  ASSERT(0 == strcmp(names[0].host, names[2].host));
+  ASSERT(0 == strcmp(names[0].service, names[2].service));
+}
+
+
+static void getnameinfo_many_cb(uv_getnameinfo_many_t* handle, int status) {
+  ASSERT(status == 0);
+  ASSERT_PTR_EQ(names, handle->names);
+  ASSERT(ARRAY_SIZE(names) == handle->nnames);
+  check_names();
+  many_cb_called++;
+}
+
+
+TEST_IMPL(getnameinfo_many) {
+#if defined(__QEMU__)
+  RETURN_SKIP("Test does not currently work in QEMU");
+#endif
+  uv_getnameinfo_many_t many_req;
+  int r;
+
+  memset(names, 0, sizeof(names));
+  ASSERT(0 == uv_ip4_addr(address_ip4, port, &addr4));
+  memcpy(&names[0].addr, &addr4, sizeof(addr4));
+  names[1].addr.ss_family = AF_UNIX;
+  memcpy(&names[2].addr, &addr4, sizeof(addr4));
+
+  r = uv_getnameinfo_many(uv_default_loop(),
+                          &many_req,
+                          names,
+                          ARRAY_SIZE(names),
+                          0,
+                          NULL);
+#ifdef _WIN32
+  ASSERT(r == UV_ENOSYS);
+  RETURN_SKIP("Not implemented on Windows");
+#endif
+  ASSERT(r == 0);
+  check_names();
+
+  memset(names[0].host, 0, sizeof(names[0].host));
+  ASSERT(0 == uv_getnameinfo_many(uv_default_loop(),
+                                  &many_req,
+                                  names,
+                                  ARRAY_SIZE(names),
+                                  0,
+                                  getnameinfo_many_cb));
+  ASSERT(0 == uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT(1 == many_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uv_work_t cache_pause_reqs[4];
+static uv_sem_t cache_pause_sems[ARRAY_SIZE(cache_pause_reqs)];
+static int cache_cb_called;
+
+
+static void cache_pause_work_cb(uv_work_t* req) {
+  uv_sem_wait(cache_pause_sems + (req - cache_pause_reqs));
+}
+
+
+static void cache_pause_done_cb(uv_work_t* req, int status) {
+  ASSERT(status == 0);
+  uv_sem_destroy(cache_pause_sems + (req - cache_pause_reqs));
+}
+
+
+static void cache_resume(void) {
+  size_t i;
+
+  /* Let the threadpool go again once both hits are in, neither needed it. */
+  if (++cache_cb_called == 2)
+    for (i = 0; i < ARRAY_SIZE(cache_pause_reqs); i++)
+      uv_sem_post(cache_pause_sems + i);
+}
+
+
+static void getnameinfo_cache_cb(uv_getnameinfo_t* handle,
+                                 int status,
+                                 const char* hostname,
+                                 const char* service) {
+  ASSERT(status == 0);
+  ASSERT(0 == strcmp(names[0].host, hostname));
+  ASSERT(0 == strcmp(names[0].service, service));
+  cache_resume();
+}
+
+
+static void getnameinfo_many_cache_cb(uv_getnameinfo_many_t* handle,
+                                      int status) {
+  ASSERT(status == 0);
+  ASSERT(names[1].status == 0);
+  ASSERT(0 == strcmp(names[0].host, names[1].host));
+  cache_resume();
+}
+
+
+TEST_IMPL(getnameinfo_cache) {
+#if defined(__QEMU__)
+  RETURN_SKIP("Test does not currently work in QEMU");
+#endif
+  uv_getnameinfo_cache_options_t options;
+  uv_getnameinfo_many_t many_req;
+  uv_loop_t* loop;
+  char buf[64];
+  size_t i;
+
+  memset(&options, 0, sizeof(options));
+#ifdef _WIN32
+  ASSERT(UV_ENOSYS == uv_getnameinfo_cache_configure(&options));
+  RETURN_SKIP("Not implemented on Windows");
+#endif
+  ASSERT(UV_EINVAL == uv_getnameinfo_cache_configure(&options));
+
+  options.ttl = 60000;
+  ASSERT(0 == uv_getnameinfo_cache_configure(&options));
+
+  snprintf(buf,
+           sizeof(buf),
+           "UV_THREADPOOL_SIZE=%lu",
+           (unsigned long) ARRAY_SIZE(cache_pause_reqs));
+  putenv(buf);
+
+  loop = uv_default_loop();
+
+  /* Fills the cache. */
+  ASSERT(0 == uv_ip4_addr(address_ip4, port, &addr4));
+  ASSERT(0 == uv_getnameinfo(loop,
+                             &req,
+                             NULL,
+                             (const struct sockaddr*) &addr4,
+                             0));
+  memset(names, 0, sizeof(names));
+  strcpy(names[0].host, req.host);
+  strcpy(names[0].service, req.service);
+  memcpy(&names[1].addr, &addr4, sizeof(addr4));
+
+  for (i = 0; i < ARRAY_SIZE(cache_pause_reqs); i++) {
+    ASSERT(0 == uv_sem_init(cache_pause_sems + i, 0));
+    ASSERT(0 == uv_queue_work(loop,
+                              cache_pause_reqs + i,
+                              cache_pause_work_cb,
+                              cache_pause_done_cb));
+  }
+
+  /* The threadpool is busy, lookups that went to it could be cancelled. */
+  ASSERT(0 == uv_getnameinfo(loop,
+                             &req,
+                             getnameinfo_cache_cb,
+                             (const struct sockaddr*) &addr4,
+                             0));
+  ASSERT(UV_EBUSY == uv_cancel((uv_req_t*) &req));
+  ASSERT(0 == uv_getnameinfo_many(loop,
+                                  &many_req,
+                                  names + 1,
+                                  1,
+                                  0,
+                                  getnameinfo_many_cache_cb));
+  ASSERT(UV_EBUSY == uv_cancel((uv_req_t*) &many_req));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(2 == cache_cb_called);
+
+  /* Disabled again, lookups go to libc. */
+  ASSERT(0 == uv_getnameinfo_cache_configure(NULL));
+  ASSERT(0 == uv_getnameinfo(loop,
+                             &req,
+                             NULL,
+                             (const struct sockaddr*) &addr4,
+                             0));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,258 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define TRANSFER_BYTES (16 * 1024 * 1024)
+
+static uv_loop_t loop_a;
+static uv_loop_t loop_b;
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t incoming;
+static uv_connect_t connect_req;
+static uv_write_t ping_req;
+static uv_write_t pong_req;
+static uv_write_t big_req;
+static uv_udp_t receiver;
+static uv_udp_t sender;
+static char big[TRANSFER_BYTES];
+static char buffer[64 * 1024];
+static size_t client_nread;
+static int incoming_read_cb_called;
+static int big_write_cb_called;
+static int recv_cb_called;
+static int close_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  buf->base = buffer;
+  buf->len = sizeof(buffer);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void incoming_read_cb(uv_stream_t* handle,
+                             ssize_t nread,
+                             const uv_buf_t* buf);
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, uv_tcp_init(handle->loop, &incoming));
+  ASSERT_EQ(0, uv_accept(handle, (uv_stream_t*) &incoming));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &incoming,
+                             alloc_cb,
+                             incoming_read_cb));
+  uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_buf_t buf;
+
+  ASSERT_EQ(0, status);
+  buf = uv_buf_init("PING", 4);
+  ASSERT_EQ(0, uv_write(&ping_req, req->handle, &buf, 1, NULL));
+}
+
+
+static void incoming_read_cb(uv_stream_t* handle,
+                             ssize_t nread,
+                             const uv_buf_t* buf) {
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(4, nread);
+  incoming_read_cb_called++;
+
+  if (incoming_read_cb_called == 1) {
+    ASSERT_PTR_EQ(&loop_a, handle->loop);
+    ASSERT_MEM_EQ("PING", buf->base, 4);
+    uv_stop(handle->loop);
+    return;
+  }
+
+  /* Arrived after the move. */
+  ASSERT_PTR_EQ(&loop_b, handle->loop);
+  ASSERT_MEM_EQ("PONG", buf->base, 4);
+  uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+static void big_write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_PTR_EQ(&loop_b, req->handle->loop);
+  big_write_cb_called++;
+}
+
+
+static void client_read_cb(uv_stream_t* handle,
+                           ssize_t nread,
+                           const uv_buf_t* buf) {
+  uv_buf_t pong;
+
+  ASSERT_GE(nread, 0);
+  client_nread += nread;
+  if (client_nread < TRANSFER_BYTES)
+    return;
+
+  ASSERT_EQ(TRANSFER_BYTES, client_nread);
+  pong = uv_buf_init("PONG", 4);
+  ASSERT_EQ(0, uv_write(&pong_req, handle, &pong, 1, NULL));
+  uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+static unsigned int handle_count(uv_loop_t* loop, uv_handle_type type) {
+  uv_handle_counts_t counts;
+
+  ASSERT_EQ(0, uv_metrics_handle_counts(loop, &counts));
+  return (unsigned int) counts.handles[type];
+}
+
+
+TEST_IMPL(tcp_handle_detach) {
+#ifdef _WIN32
+  RETURN_SKIP("uv_handle_detach() is not supported on Windows.");
+#else
+  struct sockaddr_in addr;
+  uv_buf_t buf;
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_loop_init(&loop_a));
+  ASSERT_EQ(0, uv_loop_init(&loop_b));
+
+  ASSERT_EQ(0, uv_tcp_init(&loop_a, &server));
+  ASSERT_EQ(0, uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 1, connection_cb));
+  ASSERT_EQ(0, uv_tcp_init(&loop_a, &client));
+  ASSERT_EQ(0, uv_tcp_connect(&connect_req,
+                              &client,
+                              (const struct sockaddr*) &addr,
+                              connect_cb));
+
+  /* Stops in incoming_read_cb() once the PING is in. */
+  uv_run(&loop_a, UV_RUN_DEFAULT);
+  ASSERT_EQ(1, incoming_read_cb_called);
+  ASSERT_EQ(UV_ENOTSUP, uv_handle_detach((uv_handle_t*) &connect_req));
+
+  /* The client doesn't read yet, most of this stays queued. */
+  buf = uv_buf_init(big, sizeof(big));
+  ASSERT_EQ(0, uv_write(&big_req, (uv_stream_t*) &incoming, &buf, 1,
+                        big_write_cb));
+  ASSERT_GT(incoming.write_queue_size, 0);
+
+  ASSERT_EQ(2, handle_count(&loop_a, UV_TCP));
+  ASSERT_EQ(0, uv_handle_detach((uv_handle_t*) &incoming));
+  ASSERT_NULL(uv_handle_get_loop((uv_handle_t*) &incoming));
+  ASSERT_EQ(UV_EINVAL, uv_handle_detach((uv_handle_t*) &incoming));
+  ASSERT_EQ(1, handle_count(&loop_a, UV_TCP));
+
+  ASSERT_EQ(0, uv_handle_attach((uv_handle_t*) &incoming, &loop_b));
+  ASSERT_EQ(UV_EINVAL, uv_handle_attach((uv_handle_t*) &incoming, &loop_a));
+  ASSERT_PTR_EQ(&loop_b, uv_handle_get_loop((uv_handle_t*) &incoming));
+  ASSERT_EQ(1, handle_count(&loop_b, UV_TCP));
+  ASSERT(uv_loop_alive(&loop_b));
+
+  /* The loops run on the same thread here, take turns. */
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &client,
+                             alloc_cb,
+                             client_read_cb));
+  while (close_cb_called < 3) {
+    uv_run(&loop_a, UV_RUN_NOWAIT);
+    uv_run(&loop_b, UV_RUN_NOWAIT);
+  }
+
+  ASSERT_EQ(2, incoming_read_cb_called);
+  ASSERT_EQ(1, big_write_cb_called);
+  ASSERT_EQ(TRANSFER_BYTES, client_nread);
+
+  ASSERT_EQ(0, uv_run(&loop_a, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, uv_run(&loop_b, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, uv_loop_close(&loop_a));
+  ASSERT_EQ(0, uv_loop_close(&loop_b));
+  return 0;
+#endif
+}
+
+
+static void recv_cb(uv_udp_t* handle,
+                    ssize_t nread,
+                    const uv_buf_t* buf,
+                    const struct sockaddr* addr,
+                    unsigned int flags) {
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(4, nread);
+  ASSERT_MEM_EQ("PING", buf->base, 4);
+  ASSERT_PTR_EQ(&loop_b, handle->loop);
+  recv_cb_called++;
+  uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+TEST_IMPL(udp_handle_detach) {
+#ifdef _WIN32
+  RETURN_SKIP("uv_handle_detach() is not supported on Windows.");
+#else
+  struct sockaddr_in addr;
+  uv_buf_t buf;
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_loop_init(&loop_a));
+  ASSERT_EQ(0, uv_loop_init(&loop_b));
+
+  ASSERT_EQ(0, uv_udp_init(&loop_a, &receiver));
+  ASSERT_EQ(0, uv_udp_bind(&receiver, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_udp_recv_start(&receiver, alloc_cb, recv_cb));
+  uv_run(&loop_a, UV_RUN_NOWAIT);
+
+  ASSERT_EQ(0, uv_handle_detach((uv_handle_t*) &receiver));
+  ASSERT_EQ(0, uv_loop_alive(&loop_a));
+  ASSERT_EQ(0, uv_handle_attach((uv_handle_t*) &receiver, &loop_b));
+
+  ASSERT_EQ(0, uv_udp_init(&loop_a, &sender));
+  buf = uv_buf_init("PING", 4);
+  ASSERT_EQ(4, uv_udp_try_send(&sender,
+                               &buf,
+                               1,
+                               (const struct sockaddr*) &addr));
+  uv_close((uv_handle_t*) &sender, close_cb);
+
+  ASSERT_EQ(0, uv_run(&loop_b, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, recv_cb_called);
+  ASSERT_EQ(0, uv_run(&loop_a, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, close_cb_called);
+
+  ASSERT_EQ(0, uv_loop_close(&loop_a));
+  ASSERT_EQ(0, uv_loop_close(&loop_b));
+  return 0;
+#endif
+}
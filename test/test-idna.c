@@ -206,6 +206,36 @@ TEST_IMPL(idna_toascii) {
   T("βόλος.com", "xn--nxasmm1c.com");
   T("ශ්‍රී.com", "xn--10cl1a0b660p.com");
   T("نامه‌ای.com", "xn--mgba3gch31f060k.com");
+  /* ASCII fast path, longer than a word and cut short. */
+  T("www.Example-Host.example.com", "www.Example-Host.example.com");
+  {
+    char d[8];
+    ASSERT_EQ(8, uv__idna_toascii("www.example.com", "www.example.com" + 15,
+                                  d, d + sizeof(d)));
+    ASSERT_MEM_EQ("www.exam", d, 8);
+  }
+  return 0;
+}
+
+
+TEST_IMPL(idna_toascii_public) {
+  char d[32];
+
+  ASSERT_EQ(UV_EINVAL, uv_idna_toascii(NULL, d, sizeof(d)));
+  ASSERT_EQ(UV_EINVAL, uv_idna_toascii("\xC0\x80", d, sizeof(d)));
+
+  ASSERT_EQ(11, uv_idna_toascii("example.com", d, sizeof(d)));
+  ASSERT_STR_EQ("example.com", d);
+  ASSERT_EQ(17, uv_idna_toascii("bücher.com", d, sizeof(d)));
+  ASSERT_STR_EQ("xn--bcher-kva.com", d);
+
+  /* The nul byte has to fit too. */
+  ASSERT_EQ(11, uv_idna_toascii("example.com", d, 12));
+  ASSERT_EQ(UV_ENOSPC, uv_idna_toascii("example.com", d, 11));
+  ASSERT_EQ(UV_ENOSPC, uv_idna_toascii("bücher.com", d, 8));
+  ASSERT_EQ(UV_ENOSPC, uv_idna_toascii("", d, 0));
+  ASSERT_EQ(0, uv_idna_toascii("", d, 1));
+
   return 0;
 }
 
@@ -0,0 +1,127 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#define NUM_HANDLES 6
+
+static uv_poll_t handles[NUM_HANDLES];
+static int order[NUM_HANDLES];
+static int ncalls;
+
+
+static void poll_cb(uv_poll_t* handle, int status, int events) {
+  ASSERT_EQ(0, status);
+  ASSERT_LT(ncalls, NUM_HANDLES);
+  order[ncalls++] = (int) (handle - handles);
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(io_priority) {
+#ifdef _WIN32
+  RETURN_SKIP("I/O priorities are not supported on Windows.");
+#else
+  uv_os_sock_t fds[NUM_HANDLES][2];
+  uv_timer_t timer;
+  uv_tcp_t tcp;
+  uv_loop_t* loop;
+  const char* s;
+  int r;
+  int i;
+
+  /* The io_uring backend doesn't look at them. */
+  s = getenv("UV_USE_IO_URING");
+  if (s != NULL && atoi(s) != 0)
+    RETURN_SKIP("I/O priorities need the epoll backend.");
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_timer_init(loop, &timer));
+  ASSERT_EQ(UV_ENOTSUP,
+            uv_handle_set_io_priority((uv_handle_t*) &timer,
+                                      UV_IO_PRIORITY_HIGH));
+  uv_close((uv_handle_t*) &timer, NULL);
+
+  /* The loop keeps the priority by fd, there's none yet. */
+  ASSERT_EQ(0, uv_tcp_init(loop, &tcp));
+  ASSERT_EQ(UV_EBADF,
+            uv_handle_set_io_priority((uv_handle_t*) &tcp,
+                                      UV_IO_PRIORITY_HIGH));
+  uv_close((uv_handle_t*) &tcp, NULL);
+
+  for (i = 0; i < NUM_HANDLES; i++) {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]));
+    ASSERT_EQ(1, write(fds[i][1], "x", 1));
+    ASSERT_EQ(0, uv_poll_init_socket(loop, handles + i, fds[i][0]));
+  }
+
+  ASSERT_EQ(UV_EINVAL,
+            uv_handle_set_io_priority((uv_handle_t*) handles, 42));
+  r = uv_handle_set_io_priority((uv_handle_t*) (handles + 0),
+                                UV_IO_PRIORITY_LOW);
+  if (r == UV_ENOSYS) {
+    for (i = 0; i < NUM_HANDLES; i++) {
+      uv_close((uv_handle_t*) (handles + i), NULL);
+      ASSERT_EQ(0, close(fds[i][0]));
+      ASSERT_EQ(0, close(fds[i][1]));
+    }
+    ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("I/O priorities are not supported on this platform.");
+  }
+  ASSERT_EQ(0, r);
+  ASSERT_EQ(0, uv_handle_set_io_priority((uv_handle_t*) (handles + 4),
+                                         UV_IO_PRIORITY_HIGH));
+  ASSERT_EQ(0, uv_handle_set_io_priority((uv_handle_t*) (handles + 5),
+                                         UV_IO_PRIORITY_HIGH));
+
+  /* All ready at once, whatever order the kernel reports them in. */
+  for (i = 0; i < NUM_HANDLES; i++)
+    ASSERT_EQ(0, uv_poll_start(handles + i, UV_READABLE, poll_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_HANDLES, ncalls);
+
+  ASSERT(order[0] == 4 || order[0] == 5);
+  ASSERT(order[1] == 4 || order[1] == 5);
+  for (i = 2; i < NUM_HANDLES - 1; i++) {
+    ASSERT_GE(order[i], 1);
+    ASSERT_LE(order[i], 3);
+  }
+  ASSERT_EQ(0, order[NUM_HANDLES - 1]);
+
+  for (i = 0; i < NUM_HANDLES; i++) {
+    ASSERT_EQ(0, close(fds[i][0]));
+    ASSERT_EQ(0, close(fds[i][1]));
+  }
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
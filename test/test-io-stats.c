@@ -0,0 +1,153 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+#include <string.h>
+
+static uv_pipe_t reader;
+static uv_pipe_t writer;
+static uv_udp_t udp;
+static char chunk[65536];
+static char readbuf[64];
+static int read_cb_called;
+static int recv_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  buf->base = readbuf;
+  buf->len = sizeof(readbuf);
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  uv_io_stats_t stats;
+  uv_buf_t b;
+  uint64_t total;
+  int r;
+
+  ASSERT_EQ(5, nread);
+  read_cb_called++;
+
+  ASSERT_EQ(0, uv_handle_get_io_stats((uv_handle_t*) stream, &stats));
+  ASSERT_EQ(1, stats.read_calls);
+  ASSERT_EQ(5, stats.bytes_read);
+  ASSERT_EQ(0, stats.read_eagain);
+  ASSERT_EQ(0, stats.write_calls);
+
+  /* Fill the pipe so the last write fails with EAGAIN. */
+  b = uv_buf_init(chunk, sizeof(chunk));
+  total = 5;
+  while ((r = uv_try_write((uv_stream_t*) &writer, &b, 1)) > 0)
+    total += r;
+  ASSERT_EQ(r, UV_EAGAIN);
+
+  ASSERT_EQ(0, uv_handle_get_io_stats((uv_handle_t*) &writer, &stats));
+  ASSERT_EQ(total, stats.bytes_written);
+  ASSERT_EQ(1, stats.write_eagain);
+  ASSERT_GE(stats.write_calls, 3);
+
+  uv_close((uv_handle_t*) &reader, NULL);
+  uv_close((uv_handle_t*) &writer, NULL);
+}
+
+
+static void recv_cb(uv_udp_t* handle,
+                    ssize_t nread,
+                    const uv_buf_t* buf,
+                    const struct sockaddr* addr,
+                    unsigned flags) {
+  uv_io_stats_t stats;
+
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(3, nread);
+  recv_cb_called++;
+
+  ASSERT_EQ(0, uv_handle_get_io_stats((uv_handle_t*) handle, &stats));
+  ASSERT_GE(stats.read_calls, 1);
+  ASSERT_EQ(3, stats.bytes_read);
+
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(io_stats) {
+  struct sockaddr_in addr;
+  struct sockaddr_storage name;
+  uv_io_stats_t stats;
+  uv_timer_t timer;
+  uv_file fds[2];
+  uv_loop_t* loop;
+  uv_buf_t buf;
+  int namelen;
+  int r;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_pipe_init(loop, &reader, 0));
+  ASSERT_EQ(0, uv_pipe_init(loop, &writer, 0));
+
+  r = uv_handle_set_io_stats((uv_handle_t*) &reader, 1);
+#ifdef _WIN32
+  ASSERT_EQ(r, UV_ENOSYS);
+  uv_close((uv_handle_t*) &reader, NULL);
+  uv_close((uv_handle_t*) &writer, NULL);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  MAKE_VALGRIND_HAPPY();
+  RETURN_SKIP("Not implemented on Windows");
+#endif
+  ASSERT_EQ(0, r);
+
+  ASSERT_EQ(UV_EINVAL,
+            uv_handle_get_io_stats((uv_handle_t*) &writer, &stats));
+  ASSERT_EQ(0, uv_handle_set_io_stats((uv_handle_t*) &writer, 1));
+
+  ASSERT_EQ(0, uv_timer_init(loop, &timer));
+  ASSERT_EQ(UV_ENOTSUP, uv_handle_set_io_stats((uv_handle_t*) &timer, 1));
+  uv_close((uv_handle_t*) &timer, NULL);
+
+  ASSERT_EQ(0, uv_pipe(fds, UV_NONBLOCK_PIPE, UV_NONBLOCK_PIPE));
+  ASSERT_EQ(0, uv_pipe_open(&reader, fds[0]));
+  ASSERT_EQ(0, uv_pipe_open(&writer, fds[1]));
+
+  buf = uv_buf_init("hello", 5);
+  ASSERT_EQ(5, uv_try_write((uv_stream_t*) &writer, &buf, 1));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &reader, alloc_cb, read_cb));
+
+  /* Datagrams are counted too. */
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", 0, &addr));
+  ASSERT_EQ(0, uv_udp_init(loop, &udp));
+  ASSERT_EQ(0, uv_udp_bind(&udp, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_handle_set_io_stats((uv_handle_t*) &udp, 1));
+  namelen = sizeof(name);
+  ASSERT_EQ(0, uv_udp_getsockname(&udp, (struct sockaddr*) &name, &namelen));
+  buf = uv_buf_init("abc", 3);
+  ASSERT_EQ(3, uv_udp_try_send(&udp, &buf, 1, (struct sockaddr*) &name));
+  ASSERT_EQ(0, uv_udp_recv_start(&udp, alloc_cb, recv_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, read_cb_called);
+  ASSERT_EQ(1, recv_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -161,6 +161,43 @@ TEST_IMPL(ip6_pton) {
 #undef GOOD_ADDR_LIST
 #undef BAD_ADDR_LIST
 
+
+TEST_IMPL(ip6_ntop) {
+  static const char* const canonical[] = {
+    "::",
+    "::1",
+    "1::",
+    "fe80::2acf:daff:fedd:342a",
+    "1:0:0:1::",
+    "1::1:0:0:1",
+    "abcd:ef01:2345:6789:abcd:ef01:2345:6789",
+    "::ffff:1.2.3.4",
+    "::1.2.3.4",
+    "::ffff:255.255.255.255",
+  };
+  struct in6_addr addr;
+  char dst[64];
+  size_t i;
+
+  for (i = 0; i < ARRAY_SIZE(canonical); i++) {
+    ASSERT_EQ(0, uv_inet_pton(AF_INET6, canonical[i], &addr));
+    ASSERT_EQ(0, uv_inet_ntop(AF_INET6, &addr, dst, sizeof(dst)));
+    ASSERT_STR_EQ(canonical[i], dst);
+  }
+
+  /* Digits in upper case and leading zeroes are accepted going in. */
+  ASSERT_EQ(0, uv_inet_pton(AF_INET6, "FE80::0ABC:00Ef", &addr));
+  ASSERT_EQ(0, uv_inet_ntop(AF_INET6, &addr, dst, sizeof(dst)));
+  ASSERT_STR_EQ("fe80::abc:ef", dst);
+  ASSERT_EQ(0, uv_inet_ntop(AF_INET6, &addr, dst, strlen("fe80::abc:ef") + 1));
+  ASSERT_EQ(UV_ENOSPC,
+            uv_inet_ntop(AF_INET6, &addr, dst, strlen("fe80::abc:ef")));
+  ASSERT(0 != uv_inet_pton(AF_INET6, "fe80::g", &addr));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
 TEST_IMPL(ip6_sin6_len) {
   struct sockaddr_in6 s;
   ASSERT_EQ(0, uv_ip6_addr("::", 0, &s));
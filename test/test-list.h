@@ -24,6 +24,8 @@
 TEST_DECLARE   (platform_output)
 TEST_DECLARE   (callback_order)
 TEST_DECLARE   (close_order)
+TEST_DECLARE   (close_many)
+TEST_DECLARE   (close_all)
 TEST_DECLARE   (run_once)
 TEST_DECLARE   (run_nowait)
 TEST_DECLARE   (loop_alive)
@@ -33,7 +35,18 @@ TEST_DECLARE   (loop_stop)
 TEST_DECLARE   (loop_update_time)
 TEST_DECLARE   (loop_backend_timeout)
 TEST_DECLARE   (loop_configure)
+TEST_DECLARE   (loop_configure_io_uring)
+TEST_DECLARE   (loop_configure_busy_poll)
+TEST_DECLARE   (loop_configure_coarse_clock)
+TEST_DECLARE   (loop_configure_event_buffer)
+TEST_DECLARE   (loop_configure_high_res_timers)
+TEST_DECLARE   (loop_configure_io_budget)
+TEST_DECLARE   (loop_group)
+TEST_DECLARE   (loop_group_least_loaded)
 TEST_DECLARE   (default_loop_close)
+TEST_DECLARE   (defer)
+TEST_DECLARE   (loop_poll_completions)
+TEST_DECLARE   (read_batch)
 TEST_DECLARE   (barrier_1)
 TEST_DECLARE   (barrier_2)
 TEST_DECLARE   (barrier_3)
@@ -52,6 +65,7 @@ TEST_DECLARE   (tty)
 TEST_DECLARE   (tty_raw)
 TEST_DECLARE   (tty_empty_write)
 TEST_DECLARE   (tty_large_write)
+TEST_DECLARE   (tty_buffered_write)
 TEST_DECLARE   (tty_raw_cancel)
 TEST_DECLARE   (tty_duplicate_vt100_fn_key)
 TEST_DECLARE   (tty_duplicate_alt_modifier_key)
@@ -75,9 +89,11 @@ TEST_DECLARE   (tty_escape_sequence_processing)
 #endif
 TEST_DECLARE   (tty_file)
 TEST_DECLARE   (tty_pty)
+TEST_DECLARE   (tty_write_buffer)
 TEST_DECLARE   (stdio_over_pipes)
 TEST_DECLARE   (stdio_emulate_iocp)
 TEST_DECLARE   (ip6_pton)
+TEST_DECLARE   (ip6_ntop)
 TEST_DECLARE   (ip6_sin6_len)
 TEST_DECLARE   (connect_unspecified)
 TEST_DECLARE   (ipc_heavy_traffic_deadlock_bug)
@@ -91,6 +107,7 @@ TEST_DECLARE   (ipc_send_recv_tcp)
 TEST_DECLARE   (ipc_send_recv_tcp_inprocess)
 TEST_DECLARE   (ipc_tcp_connection)
 TEST_DECLARE   (ipc_send_zero)
+TEST_DECLARE   (tcp_accept_policy)
 TEST_DECLARE   (tcp_alloc_cb_fail)
 TEST_DECLARE   (tcp_ping_pong)
 TEST_DECLARE   (tcp_ping_pong_vec)
@@ -106,9 +123,20 @@ TEST_DECLARE   (tcp_write_after_connect)
 TEST_DECLARE   (tcp_writealot)
 TEST_DECLARE   (tcp_write_fail)
 TEST_DECLARE   (tcp_try_write)
+TEST_DECLARE   (tcp_io_uring_multishot)
+TEST_DECLARE   (tcp_notsent_lowat)
 TEST_DECLARE   (tcp_try_write_error)
 TEST_DECLARE   (tcp_write_queue_order)
+TEST_DECLARE   (tcp_write_zerocopy)
+TEST_DECLARE   (tcp_tls_offload)
+TEST_DECLARE   (tcp_accept_batch)
+TEST_DECLARE   (tcp_edge_triggered)
+TEST_DECLARE   (tcp_reuseport)
+TEST_DECLARE   (tcp_fastopen)
+TEST_DECLARE   (tcp_defer_accept)
+TEST_DECLARE   (tcp_get_info)
 TEST_DECLARE   (tcp_open)
+TEST_DECLARE   (tcp_pending_accepts)
 TEST_DECLARE   (tcp_open_twice)
 TEST_DECLARE   (tcp_open_bound)
 TEST_DECLARE   (tcp_open_connected)
@@ -125,6 +153,9 @@ TEST_DECLARE   (tcp_bind_invalid_flags)
 TEST_DECLARE   (tcp_bind_writable_flags)
 TEST_DECLARE   (tcp_listen_without_bind)
 TEST_DECLARE   (tcp_connect_error_fault)
+TEST_DECLARE   (tcp_connect_host)
+TEST_DECLARE   (tcp_connect_host_refused)
+TEST_DECLARE   (tcp_connect_host_cancel)
 TEST_DECLARE   (tcp_connect_timeout)
 TEST_DECLARE   (tcp_local_connect_timeout)
 TEST_DECLARE   (tcp6_local_connect_timeout)
@@ -143,6 +174,7 @@ TEST_DECLARE   (tcp_close_accept)
 TEST_DECLARE   (tcp_oob)
 #endif
 TEST_DECLARE   (tcp_flags)
+TEST_DECLARE   (tcp_busy_poll)
 TEST_DECLARE   (tcp_write_to_half_open_connection)
 TEST_DECLARE   (tcp_unexpected_read)
 TEST_DECLARE   (tcp_read_stop)
@@ -166,6 +198,11 @@ TEST_DECLARE   (udp_send_hang_loop)
 TEST_DECLARE   (udp_send_immediate)
 TEST_DECLARE   (udp_send_unreachable)
 TEST_DECLARE   (udp_mmsg)
+TEST_DECLARE   (udp_edge_triggered)
+TEST_DECLARE   (tcp_handle_detach)
+TEST_DECLARE   (udp_handle_detach)
+TEST_DECLARE   (udp_mmsg_batch)
+TEST_DECLARE   (udp_recv_depth)
 TEST_DECLARE   (udp_multicast_join)
 TEST_DECLARE   (udp_multicast_join6)
 TEST_DECLARE   (udp_multicast_ttl)
@@ -175,6 +212,7 @@ TEST_DECLARE   (udp_dgram_too_big)
 TEST_DECLARE   (udp_dual_stack)
 TEST_DECLARE   (udp_ipv6_only)
 TEST_DECLARE   (udp_options)
+TEST_DECLARE   (udp_busy_poll)
 TEST_DECLARE   (udp_options6)
 TEST_DECLARE   (udp_no_autobind)
 TEST_DECLARE   (udp_open)
@@ -186,9 +224,19 @@ TEST_DECLARE   (udp_send_unix)
 #endif
 TEST_DECLARE   (udp_sendmmsg_error)
 TEST_DECLARE   (udp_try_send)
+TEST_DECLARE   (udp_try_send_batch)
+TEST_DECLARE   (udp_send_segmented)
+TEST_DECLARE   (udp_recv_gro)
+TEST_DECLARE   (udp_pktinfo)
+TEST_DECLARE   (udp_recv_timestamp)
+TEST_DECLARE   (tcp_read_timestamp)
+TEST_DECLARE   (udp_reuseport)
+TEST_DECLARE   (udp_rio)
 TEST_DECLARE   (pipe_bind_error_addrinuse)
 TEST_DECLARE   (pipe_bind_error_addrnotavail)
 TEST_DECLARE   (pipe_bind_error_inval)
+TEST_DECLARE   (pipe_buffer_size)
+TEST_DECLARE   (pipe_vmsplice)
 TEST_DECLARE   (pipe_connect_multiple)
 TEST_DECLARE   (pipe_listen_without_bind)
 TEST_DECLARE   (pipe_connect_bad_name)
@@ -198,7 +246,10 @@ TEST_DECLARE   (pipe_getsockname)
 TEST_DECLARE   (pipe_getsockname_abstract)
 TEST_DECLARE   (pipe_getsockname_blocking)
 TEST_DECLARE   (pipe_pending_instances)
+TEST_DECLARE   (pipe_set_pending_instances)
 TEST_DECLARE   (pipe_sendmsg)
+TEST_DECLARE   (pipe_seqpacket)
+TEST_DECLARE   (pipe_write_fds)
 TEST_DECLARE   (pipe_server_close)
 TEST_DECLARE   (connection_fail)
 TEST_DECLARE   (connection_fail_doesnt_auto_close)
@@ -222,13 +273,21 @@ TEST_DECLARE   (timer_run_once)
 TEST_DECLARE   (timer_from_check)
 TEST_DECLARE   (timer_is_closing)
 TEST_DECLARE   (timer_null_callback)
+TEST_DECLARE   (timer_wheel)
+TEST_DECLARE   (timer_slack)
+TEST_DECLARE   (timer_heap_order)
+TEST_DECLARE   (timer_start_many)
 TEST_DECLARE   (timer_early_check)
 TEST_DECLARE   (idle_starvation)
 TEST_DECLARE   (loop_handles)
 TEST_DECLARE   (get_loadavg)
 TEST_DECLARE   (walk_handles)
+TEST_DECLARE   (loop_snapshot)
 TEST_DECLARE   (watcher_cross_stop)
 TEST_DECLARE   (ref)
+TEST_DECLARE   (ring_basic)
+TEST_DECLARE   (spsc_ring_async)
+TEST_DECLARE   (mpmc_ring_async)
 TEST_DECLARE   (idle_ref)
 TEST_DECLARE   (async_ref)
 TEST_DECLARE   (prepare_ref)
@@ -261,6 +320,20 @@ TEST_DECLARE   (has_ref)
 TEST_DECLARE   (active)
 TEST_DECLARE   (embed)
 TEST_DECLARE   (async)
+TEST_DECLARE   (async_many_handles)
+TEST_DECLARE   (async_send_awake)
+TEST_DECLARE   (read_pooled)
+TEST_DECLARE   (read_pooled_huge_pages)
+TEST_DECLARE   (stream_cork)
+TEST_DECLARE   (stream_read_options)
+TEST_DECLARE   (stream_sendfile)
+TEST_DECLARE   (stream_read_vec)
+TEST_DECLARE   (stream_write_copy)
+TEST_DECLARE   (stream_write_fanout)
+TEST_DECLARE   (stream_write_watermarks)
+TEST_DECLARE   (stream_splice)
+TEST_DECLARE   (channel)
+TEST_DECLARE   (shm_channel)
 TEST_DECLARE   (async_null_cb)
 TEST_DECLARE   (eintr_handling)
 TEST_DECLARE   (get_currentexe)
@@ -269,6 +342,7 @@ TEST_DECLARE   (process_title_big_argv)
 TEST_DECLARE   (process_title_threadsafe)
 TEST_DECLARE   (cwd_and_chdir)
 TEST_DECLARE   (get_memory)
+TEST_DECLARE   (get_resource_constraints)
 TEST_DECLARE   (get_passwd)
 TEST_DECLARE   (handle_fileno)
 TEST_DECLARE   (homedir)
@@ -279,10 +353,14 @@ TEST_DECLARE   (getaddrinfo_fail_sync)
 TEST_DECLARE   (getaddrinfo_basic)
 TEST_DECLARE   (getaddrinfo_basic_sync)
 TEST_DECLARE   (getaddrinfo_concurrent)
+TEST_DECLARE   (getaddrinfo_cache)
+TEST_DECLARE   (getaddrinfo_resolver)
 TEST_DECLARE   (gethostname)
 TEST_DECLARE   (getnameinfo_basic_ip4)
 TEST_DECLARE   (getnameinfo_basic_ip4_sync)
 TEST_DECLARE   (getnameinfo_basic_ip6)
+TEST_DECLARE   (getnameinfo_many)
+TEST_DECLARE   (getnameinfo_cache)
 TEST_DECLARE   (getsockname_tcp)
 TEST_DECLARE   (getsockname_udp)
 TEST_DECLARE   (gettimeofday)
@@ -290,17 +368,21 @@ TEST_DECLARE   (test_macros)
 TEST_DECLARE   (fail_always)
 TEST_DECLARE   (pass_always)
 TEST_DECLARE   (socket_buffer_size)
+TEST_DECLARE   (socket_pacing_rate)
 TEST_DECLARE   (spawn_fails)
 #ifndef _WIN32
 TEST_DECLARE   (spawn_fails_check_for_waitpid_cleanup)
+TEST_DECLARE   (spawn_server)
 #endif
 TEST_DECLARE   (spawn_empty_env)
 TEST_DECLARE   (spawn_exit_code)
+TEST_DECLARE   (spawn_exit_code_many)
 TEST_DECLARE   (spawn_stdout)
 TEST_DECLARE   (spawn_stdin)
 TEST_DECLARE   (spawn_stdio_greater_than_3)
 TEST_DECLARE   (spawn_ignored_stdio)
 TEST_DECLARE   (spawn_and_kill)
+TEST_DECLARE   (spawn_process_stats)
 TEST_DECLARE   (spawn_detached)
 TEST_DECLARE   (spawn_and_kill_with_std)
 TEST_DECLARE   (spawn_and_ping)
@@ -320,6 +402,8 @@ TEST_DECLARE   (spawn_tcp_server)
 TEST_DECLARE   (spawn_exercise_sigchld_issue)
 TEST_DECLARE   (fs_poll)
 TEST_DECLARE   (fs_poll_getpath)
+TEST_DECLARE   (fs_poll_native)
+TEST_DECLARE   (fs_walk)
 TEST_DECLARE   (fs_poll_close_request)
 TEST_DECLARE   (fs_poll_close_request_multi_start_stop)
 TEST_DECLARE   (fs_poll_close_request_multi_stop_start)
@@ -341,6 +425,15 @@ TEST_DECLARE   (fs_fstat)
 TEST_DECLARE   (fs_access)
 TEST_DECLARE   (fs_chmod)
 TEST_DECLARE   (fs_copyfile)
+TEST_DECLARE   (fs_copyfile_parallel)
+TEST_DECLARE   (fs_reader)
+TEST_DECLARE   (fs_reader_close)
+TEST_DECLARE   (fs_pump)
+TEST_DECLARE   (fs_pump_stop)
+TEST_DECLARE   (fs_cache)
+TEST_DECLARE   (fs_cache_watch)
+TEST_DECLARE   (fs_cache_put_in_cb)
+TEST_DECLARE   (fs_sync_group)
 TEST_DECLARE   (fs_unlink_readonly)
 #ifdef _WIN32
 TEST_DECLARE   (fs_unlink_archive_readonly)
@@ -349,6 +442,7 @@ TEST_DECLARE   (fs_chown)
 TEST_DECLARE   (fs_link)
 TEST_DECLARE   (fs_readlink)
 TEST_DECLARE   (fs_realpath)
+TEST_DECLARE   (fs_realpath_cache)
 TEST_DECLARE   (fs_symlink)
 TEST_DECLARE   (fs_symlink_dir)
 #ifdef _WIN32
@@ -367,10 +461,22 @@ TEST_DECLARE   (fs_lutime)
 TEST_DECLARE   (fs_file_open_append)
 TEST_DECLARE   (fs_statfs)
 TEST_DECLARE   (fs_stat_missing_path)
+TEST_DECLARE   (fs_stat_many)
+TEST_DECLARE   (fs_statx)
+TEST_DECLARE   (fs_mmap)
+TEST_DECLARE   (fs_fadvise)
+TEST_DECLARE   (fs_fallocate)
+TEST_DECLARE   (fs_write_atomic)
+TEST_DECLARE   (fs_write_batch)
+TEST_DECLARE   (fs_read_write_direct)
+TEST_DECLARE   (fs_openat)
+TEST_DECLARE   (fs_mkdir_p_rm_rf)
 TEST_DECLARE   (fs_read_bufs)
+TEST_DECLARE   (fs_io_uring)
 TEST_DECLARE   (fs_read_file_eof)
 TEST_DECLARE   (fs_event_watch_dir)
 TEST_DECLARE   (fs_event_watch_dir_recursive)
+TEST_DECLARE   (fs_event_watch_dir_batch)
 #ifdef _WIN32
 TEST_DECLARE   (fs_event_watch_dir_short_path)
 #endif
@@ -390,17 +496,21 @@ TEST_DECLARE   (fs_event_close_in_callback)
 TEST_DECLARE   (fs_event_start_and_close)
 TEST_DECLARE   (fs_event_error_reporting)
 TEST_DECLARE   (fs_event_getpath)
+TEST_DECLARE   (fs_event_getstat)
 TEST_DECLARE   (fs_event_stop_in_cb)
 TEST_DECLARE   (fs_scandir_empty_dir)
 TEST_DECLARE   (fs_scandir_non_existent_dir)
 TEST_DECLARE   (fs_scandir_file)
+TEST_DECLARE   (fs_scandir_unsorted)
 TEST_DECLARE   (fs_open_dir)
 TEST_DECLARE   (fs_readdir_empty_dir)
 TEST_DECLARE   (fs_readdir_file)
 TEST_DECLARE   (fs_readdir_non_empty_dir)
 TEST_DECLARE   (fs_readdir_non_existing_dir)
+TEST_DECLARE   (fs_readdir_packed)
 TEST_DECLARE   (fs_rename_to_existing_file)
 TEST_DECLARE   (fs_write_multiple_bufs)
+TEST_DECLARE   (fs_read_write_overlapped)
 TEST_DECLARE   (fs_read_write_null_arguments)
 TEST_DECLARE   (get_osfhandle_valid_handle)
 TEST_DECLARE   (open_osfhandle_valid_handle)
@@ -431,11 +541,24 @@ TEST_DECLARE   (threadpool_cancel_random)
 TEST_DECLARE   (threadpool_cancel_work)
 TEST_DECLARE   (threadpool_cancel_fs)
 TEST_DECLARE   (threadpool_cancel_single)
+TEST_DECLARE   (threadpool_cancel_tag)
+TEST_DECLARE   (threadpool_work_deadline)
+TEST_DECLARE   (threadpool_loop_pool)
+TEST_DECLARE   (threadpool_loop_affinity)
+TEST_DECLARE   (threadpool_queue_work_priority)
+TEST_DECLARE   (threadpool_queue_work_batch)
+TEST_DECLARE   (threadpool_parallel_for)
+TEST_DECLARE   (threadpool_set_limits)
+TEST_DECLARE   (threadpool_kind_size)
+TEST_DECLARE   (threadpool_metrics)
+TEST_DECLARE   (threadpool_set_options)
 TEST_DECLARE   (thread_local_storage)
 TEST_DECLARE   (thread_stack_size)
 TEST_DECLARE   (thread_stack_size_explicit)
+TEST_DECLARE   (thread_affinity)
 TEST_DECLARE   (thread_mutex)
 TEST_DECLARE   (thread_mutex_recursive)
+TEST_DECLARE   (thread_mutex_adaptive)
 TEST_DECLARE   (thread_rwlock)
 TEST_DECLARE   (thread_rwlock_trylock)
 TEST_DECLARE   (thread_create)
@@ -456,10 +579,13 @@ TEST_DECLARE   (poll_nested_epoll)
 TEST_DECLARE   (poll_nested_kqueue)
 #endif
 TEST_DECLARE   (poll_multiple_handles)
+TEST_DECLARE   (poll_high_fd)
 
 TEST_DECLARE   (ip4_addr)
 TEST_DECLARE   (ip6_addr_link_local)
 TEST_DECLARE   (ip_name)
+TEST_DECLARE   (netif_basic)
+TEST_DECLARE   (cpu_sampler)
 
 TEST_DECLARE   (poll_close_doesnt_corrupt_stack)
 TEST_DECLARE   (poll_closesocket)
@@ -483,6 +609,7 @@ TEST_DECLARE   (emfile)
 TEST_DECLARE   (spawn_setuid_setgid)
 TEST_DECLARE   (we_get_signal)
 TEST_DECLARE   (we_get_signals)
+TEST_DECLARE   (we_get_signals_blocked)
 TEST_DECLARE   (we_get_signal_one_shot)
 TEST_DECLARE   (we_get_signals_mixed)
 TEST_DECLARE   (signal_multiple_loops)
@@ -502,6 +629,7 @@ TEST_DECLARE   (queue_foreach_delete)
 
 TEST_DECLARE   (random_async)
 TEST_DECLARE   (random_sync)
+TEST_DECLARE   (random_fast)
 
 TEST_DECLARE   (handle_type_name)
 TEST_DECLARE   (req_type_name)
@@ -515,6 +643,8 @@ TEST_DECLARE   (readable_on_eof)
 TEST_DECLARE  (fork_timer)
 TEST_DECLARE  (fork_socketpair)
 TEST_DECLARE  (fork_socketpair_started)
+TEST_DECLARE  (fork_rearm_filter)
+TEST_DECLARE  (fork_rearm_filter_io_uring)
 TEST_DECLARE  (fork_signal_to_child)
 TEST_DECLARE  (fork_signal_to_child_closed)
 #ifndef __APPLE__ /* This is forbidden in a fork child: The process has forked
@@ -530,6 +660,7 @@ TEST_DECLARE  (fork_threadpool_queue_work_simple)
 #endif
 
 TEST_DECLARE  (idna_toascii)
+TEST_DECLARE  (idna_toascii_public)
 TEST_DECLARE  (utf8_decode1)
 TEST_DECLARE  (utf8_decode1_overrun)
 TEST_DECLARE  (uname)
@@ -537,6 +668,17 @@ TEST_DECLARE  (uname)
 TEST_DECLARE  (metrics_idle_time)
 TEST_DECLARE  (metrics_idle_time_thread)
 TEST_DECLARE  (metrics_idle_time_zero)
+TEST_DECLARE  (metrics_info)
+TEST_DECLARE  (metrics_slow_callback)
+TEST_DECLARE  (metrics_trace)
+TEST_DECLARE  (metrics_handle_counts)
+TEST_DECLARE  (metrics_lag)
+TEST_DECLARE  (replace_allocator_tagged)
+TEST_DECLARE  (req_alloc)
+TEST_DECLARE  (req_alloc_bufs)
+TEST_DECLARE  (handle_alloc)
+TEST_DECLARE  (io_stats)
+TEST_DECLARE  (io_priority)
 
 TASK_LIST_START
   TEST_ENTRY_CUSTOM (platform_output, 0, 1, 5000)
@@ -546,6 +688,8 @@ TASK_LIST_START
 #endif
   TEST_ENTRY  (test_macros)
   TEST_ENTRY  (close_order)
+  TEST_ENTRY  (close_many)
+  TEST_ENTRY  (close_all)
   TEST_ENTRY  (run_once)
   TEST_ENTRY  (run_nowait)
   TEST_ENTRY  (loop_alive)
@@ -555,7 +699,18 @@ TASK_LIST_START
   TEST_ENTRY  (loop_update_time)
   TEST_ENTRY  (loop_backend_timeout)
   TEST_ENTRY  (loop_configure)
+  TEST_ENTRY  (loop_configure_io_uring)
+  TEST_ENTRY  (loop_configure_busy_poll)
+  TEST_ENTRY  (loop_configure_coarse_clock)
+  TEST_ENTRY  (loop_configure_event_buffer)
+  TEST_ENTRY  (loop_configure_high_res_timers)
+  TEST_ENTRY  (loop_configure_io_budget)
+  TEST_ENTRY  (loop_group)
+  TEST_ENTRY  (loop_group_least_loaded)
   TEST_ENTRY  (default_loop_close)
+  TEST_ENTRY  (defer)
+  TEST_ENTRY  (loop_poll_completions)
+  TEST_ENTRY  (read_batch)
   TEST_ENTRY  (barrier_1)
   TEST_ENTRY  (barrier_2)
   TEST_ENTRY  (barrier_3)
@@ -586,6 +741,7 @@ TASK_LIST_START
   TEST_ENTRY  (tty_raw)
   TEST_ENTRY  (tty_empty_write)
   TEST_ENTRY  (tty_large_write)
+  TEST_ENTRY  (tty_buffered_write)
   TEST_ENTRY  (tty_raw_cancel)
   TEST_ENTRY  (tty_duplicate_vt100_fn_key)
   TEST_ENTRY  (tty_duplicate_alt_modifier_key)
@@ -609,9 +765,11 @@ TASK_LIST_START
 #endif
   TEST_ENTRY  (tty_file)
   TEST_ENTRY  (tty_pty)
+  TEST_ENTRY  (tty_write_buffer)
   TEST_ENTRY  (stdio_over_pipes)
   TEST_ENTRY  (stdio_emulate_iocp)
   TEST_ENTRY  (ip6_pton)
+  TEST_ENTRY  (ip6_ntop)
   TEST_ENTRY  (ip6_sin6_len)
   TEST_ENTRY  (connect_unspecified)
   TEST_ENTRY  (ipc_heavy_traffic_deadlock_bug)
@@ -626,6 +784,7 @@ TASK_LIST_START
   TEST_ENTRY  (ipc_tcp_connection)
   TEST_ENTRY  (ipc_send_zero)
 
+  TEST_ENTRY  (tcp_accept_policy)
   TEST_ENTRY  (tcp_alloc_cb_fail)
 
   TEST_ENTRY  (tcp_ping_pong)
@@ -664,12 +823,23 @@ TASK_LIST_START
   TEST_HELPER (tcp_write_fail, tcp4_echo_server)
 
   TEST_ENTRY  (tcp_try_write)
+  TEST_ENTRY  (tcp_io_uring_multishot)
+  TEST_ENTRY  (tcp_notsent_lowat)
   TEST_ENTRY  (tcp_try_write_error)
 
   TEST_ENTRY  (tcp_write_queue_order)
+  TEST_ENTRY  (tcp_write_zerocopy)
+  TEST_ENTRY  (tcp_tls_offload)
+  TEST_ENTRY  (tcp_accept_batch)
+  TEST_ENTRY  (tcp_edge_triggered)
+  TEST_ENTRY  (tcp_reuseport)
+  TEST_ENTRY  (tcp_fastopen)
+  TEST_ENTRY  (tcp_defer_accept)
+  TEST_ENTRY  (tcp_get_info)
 
   TEST_ENTRY  (tcp_open)
   TEST_HELPER (tcp_open, tcp4_echo_server)
+  TEST_ENTRY  (tcp_pending_accepts)
   TEST_ENTRY  (tcp_open_twice)
   TEST_ENTRY  (tcp_open_bound)
   TEST_ENTRY  (tcp_open_connected)
@@ -697,6 +867,9 @@ TASK_LIST_START
   TEST_ENTRY  (tcp_bind_writable_flags)
   TEST_ENTRY  (tcp_listen_without_bind)
   TEST_ENTRY  (tcp_connect_error_fault)
+  TEST_ENTRY  (tcp_connect_host)
+  TEST_ENTRY  (tcp_connect_host_refused)
+  TEST_ENTRY  (tcp_connect_host_cancel)
   TEST_ENTRY  (tcp_connect_timeout)
   TEST_ENTRY  (tcp_local_connect_timeout)
   TEST_ENTRY  (tcp6_local_connect_timeout)
@@ -715,6 +888,7 @@ TASK_LIST_START
   TEST_ENTRY  (tcp_oob)
 #endif
   TEST_ENTRY  (tcp_flags)
+  TEST_ENTRY  (tcp_busy_poll)
   TEST_ENTRY  (tcp_write_to_half_open_connection)
   TEST_ENTRY  (tcp_unexpected_read)
 
@@ -745,9 +919,15 @@ TASK_LIST_START
   TEST_ENTRY  (udp_dual_stack)
   TEST_ENTRY  (udp_ipv6_only)
   TEST_ENTRY  (udp_options)
+  TEST_ENTRY  (udp_busy_poll)
   TEST_ENTRY  (udp_options6)
   TEST_ENTRY  (udp_no_autobind)
   TEST_ENTRY  (udp_mmsg)
+  TEST_ENTRY  (udp_edge_triggered)
+  TEST_ENTRY  (tcp_handle_detach)
+  TEST_ENTRY  (udp_handle_detach)
+  TEST_ENTRY  (udp_mmsg_batch)
+  TEST_ENTRY  (udp_recv_depth)
   TEST_ENTRY  (udp_multicast_interface)
   TEST_ENTRY  (udp_multicast_interface6)
   TEST_ENTRY  (udp_multicast_join)
@@ -755,6 +935,14 @@ TASK_LIST_START
   TEST_ENTRY  (udp_multicast_ttl)
   TEST_ENTRY  (udp_sendmmsg_error)
   TEST_ENTRY  (udp_try_send)
+  TEST_ENTRY  (udp_try_send_batch)
+  TEST_ENTRY  (udp_send_segmented)
+  TEST_ENTRY  (udp_recv_gro)
+  TEST_ENTRY  (udp_pktinfo)
+  TEST_ENTRY  (udp_recv_timestamp)
+  TEST_ENTRY  (tcp_read_timestamp)
+  TEST_ENTRY  (udp_reuseport)
+  TEST_ENTRY  (udp_rio)
 
   TEST_ENTRY  (udp_open)
   TEST_ENTRY  (udp_open_twice)
@@ -767,13 +955,18 @@ TASK_LIST_START
   TEST_ENTRY  (pipe_bind_error_addrinuse)
   TEST_ENTRY  (pipe_bind_error_addrnotavail)
   TEST_ENTRY  (pipe_bind_error_inval)
+  TEST_ENTRY  (pipe_buffer_size)
+  TEST_ENTRY  (pipe_vmsplice)
   TEST_ENTRY  (pipe_connect_multiple)
   TEST_ENTRY  (pipe_listen_without_bind)
   TEST_ENTRY  (pipe_getsockname)
   TEST_ENTRY  (pipe_getsockname_abstract)
   TEST_ENTRY  (pipe_getsockname_blocking)
   TEST_ENTRY  (pipe_pending_instances)
+  TEST_ENTRY  (pipe_set_pending_instances)
   TEST_ENTRY  (pipe_sendmsg)
+  TEST_ENTRY  (pipe_seqpacket)
+  TEST_ENTRY  (pipe_write_fds)
 
   TEST_ENTRY  (connection_fail)
   TEST_ENTRY  (connection_fail_doesnt_auto_close)
@@ -811,11 +1004,18 @@ TASK_LIST_START
   TEST_ENTRY  (timer_from_check)
   TEST_ENTRY  (timer_is_closing)
   TEST_ENTRY  (timer_null_callback)
+  TEST_ENTRY  (timer_wheel)
+  TEST_ENTRY  (timer_slack)
+  TEST_ENTRY  (timer_heap_order)
+  TEST_ENTRY  (timer_start_many)
   TEST_ENTRY  (timer_early_check)
 
   TEST_ENTRY  (idle_starvation)
 
   TEST_ENTRY  (ref)
+  TEST_ENTRY  (ring_basic)
+  TEST_ENTRY  (spsc_ring_async)
+  TEST_ENTRY  (mpmc_ring_async)
   TEST_ENTRY  (idle_ref)
   TEST_ENTRY  (fs_poll_ref)
   TEST_ENTRY  (async_ref)
@@ -848,6 +1048,7 @@ TASK_LIST_START
 
   TEST_ENTRY  (loop_handles)
   TEST_ENTRY  (walk_handles)
+  TEST_ENTRY  (loop_snapshot)
 
   TEST_ENTRY  (watcher_cross_stop)
 
@@ -856,6 +1057,20 @@ TASK_LIST_START
   TEST_ENTRY  (embed)
 
   TEST_ENTRY  (async)
+  TEST_ENTRY  (async_many_handles)
+  TEST_ENTRY  (async_send_awake)
+  TEST_ENTRY  (read_pooled)
+  TEST_ENTRY  (read_pooled_huge_pages)
+  TEST_ENTRY  (stream_cork)
+  TEST_ENTRY  (stream_read_options)
+  TEST_ENTRY  (stream_sendfile)
+  TEST_ENTRY  (stream_read_vec)
+  TEST_ENTRY  (stream_write_copy)
+  TEST_ENTRY  (stream_write_fanout)
+  TEST_ENTRY  (stream_write_watermarks)
+  TEST_ENTRY  (stream_splice)
+  TEST_ENTRY  (channel)
+  TEST_ENTRY  (shm_channel)
   TEST_ENTRY  (async_null_cb)
   TEST_ENTRY  (eintr_handling)
 
@@ -868,6 +1083,7 @@ TASK_LIST_START
   TEST_ENTRY  (cwd_and_chdir)
 
   TEST_ENTRY  (get_memory)
+  TEST_ENTRY  (get_resource_constraints)
 
   TEST_ENTRY  (get_passwd)
 
@@ -887,12 +1103,16 @@ TASK_LIST_START
   TEST_ENTRY  (getaddrinfo_basic)
   TEST_ENTRY  (getaddrinfo_basic_sync)
   TEST_ENTRY  (getaddrinfo_concurrent)
+  TEST_ENTRY  (getaddrinfo_cache)
+  TEST_ENTRY  (getaddrinfo_resolver)
 
   TEST_ENTRY  (gethostname)
 
   TEST_ENTRY  (getnameinfo_basic_ip4)
   TEST_ENTRY  (getnameinfo_basic_ip4_sync)
   TEST_ENTRY  (getnameinfo_basic_ip6)
+  TEST_ENTRY  (getnameinfo_many)
+  TEST_ENTRY  (getnameinfo_cache)
 
   TEST_ENTRY  (getsockname_tcp)
   TEST_ENTRY  (getsockname_udp)
@@ -915,20 +1135,25 @@ TASK_LIST_START
   TEST_ENTRY  (poll_nested_kqueue)
 #endif
   TEST_ENTRY  (poll_multiple_handles)
+  TEST_ENTRY  (poll_high_fd)
 
   TEST_ENTRY  (socket_buffer_size)
+  TEST_ENTRY  (socket_pacing_rate)
 
   TEST_ENTRY  (spawn_fails)
 #ifndef _WIN32
   TEST_ENTRY  (spawn_fails_check_for_waitpid_cleanup)
+  TEST_ENTRY  (spawn_server)
 #endif
   TEST_ENTRY  (spawn_empty_env)
   TEST_ENTRY  (spawn_exit_code)
+  TEST_ENTRY  (spawn_exit_code_many)
   TEST_ENTRY  (spawn_stdout)
   TEST_ENTRY  (spawn_stdin)
   TEST_ENTRY  (spawn_stdio_greater_than_3)
   TEST_ENTRY  (spawn_ignored_stdio)
   TEST_ENTRY  (spawn_and_kill)
+  TEST_ENTRY  (spawn_process_stats)
   TEST_ENTRY  (spawn_detached)
   TEST_ENTRY  (spawn_and_kill_with_std)
   TEST_ENTRY  (spawn_and_ping)
@@ -948,6 +1173,8 @@ TASK_LIST_START
   TEST_ENTRY  (spawn_exercise_sigchld_issue)
   TEST_ENTRY  (fs_poll)
   TEST_ENTRY  (fs_poll_getpath)
+  TEST_ENTRY  (fs_poll_native)
+  TEST_ENTRY  (fs_walk)
   TEST_ENTRY  (fs_poll_close_request)
   TEST_ENTRY  (fs_poll_close_request_multi_start_stop)
   TEST_ENTRY  (fs_poll_close_request_multi_stop_start)
@@ -977,6 +1204,7 @@ TASK_LIST_START
   TEST_ENTRY  (spawn_setuid_setgid)
   TEST_ENTRY  (we_get_signal)
   TEST_ENTRY  (we_get_signals)
+  TEST_ENTRY  (we_get_signals_blocked)
   TEST_ENTRY  (we_get_signal_one_shot)
   TEST_ENTRY  (we_get_signals_mixed)
   TEST_ENTRY  (signal_multiple_loops)
@@ -1004,6 +1232,15 @@ TASK_LIST_START
   TEST_ENTRY  (fs_access)
   TEST_ENTRY  (fs_chmod)
   TEST_ENTRY  (fs_copyfile)
+  TEST_ENTRY  (fs_copyfile_parallel)
+  TEST_ENTRY  (fs_reader)
+  TEST_ENTRY  (fs_reader_close)
+  TEST_ENTRY  (fs_pump)
+  TEST_ENTRY  (fs_pump_stop)
+  TEST_ENTRY  (fs_cache)
+  TEST_ENTRY  (fs_cache_watch)
+  TEST_ENTRY  (fs_cache_put_in_cb)
+  TEST_ENTRY  (fs_sync_group)
   TEST_ENTRY  (fs_unlink_readonly)
 #ifdef _WIN32
   TEST_ENTRY  (fs_unlink_archive_readonly)
@@ -1015,6 +1252,7 @@ TASK_LIST_START
   TEST_ENTRY  (fs_lutime)
   TEST_ENTRY  (fs_readlink)
   TEST_ENTRY  (fs_realpath)
+  TEST_ENTRY  (fs_realpath_cache)
   TEST_ENTRY  (fs_symlink)
   TEST_ENTRY  (fs_symlink_dir)
 #ifdef _WIN32
@@ -1028,11 +1266,23 @@ TASK_LIST_START
 #endif
   TEST_ENTRY  (fs_statfs)
   TEST_ENTRY  (fs_stat_missing_path)
+  TEST_ENTRY  (fs_stat_many)
+  TEST_ENTRY  (fs_statx)
+  TEST_ENTRY  (fs_mmap)
+  TEST_ENTRY  (fs_fadvise)
+  TEST_ENTRY  (fs_fallocate)
+  TEST_ENTRY  (fs_write_atomic)
+  TEST_ENTRY  (fs_write_batch)
+  TEST_ENTRY  (fs_read_write_direct)
+  TEST_ENTRY  (fs_openat)
+  TEST_ENTRY  (fs_mkdir_p_rm_rf)
   TEST_ENTRY  (fs_read_bufs)
+  TEST_ENTRY  (fs_io_uring)
   TEST_ENTRY  (fs_read_file_eof)
   TEST_ENTRY  (fs_file_open_append)
   TEST_ENTRY  (fs_event_watch_dir)
   TEST_ENTRY  (fs_event_watch_dir_recursive)
+  TEST_ENTRY  (fs_event_watch_dir_batch)
 #ifdef _WIN32
   TEST_ENTRY  (fs_event_watch_dir_short_path)
 #endif
@@ -1052,17 +1302,21 @@ TASK_LIST_START
   TEST_ENTRY  (fs_event_start_and_close)
   TEST_ENTRY_CUSTOM (fs_event_error_reporting, 0, 0, 60000)
   TEST_ENTRY  (fs_event_getpath)
+  TEST_ENTRY  (fs_event_getstat)
   TEST_ENTRY  (fs_event_stop_in_cb)
   TEST_ENTRY  (fs_scandir_empty_dir)
   TEST_ENTRY  (fs_scandir_non_existent_dir)
   TEST_ENTRY  (fs_scandir_file)
+  TEST_ENTRY  (fs_scandir_unsorted)
   TEST_ENTRY  (fs_open_dir)
   TEST_ENTRY  (fs_readdir_empty_dir)
   TEST_ENTRY  (fs_readdir_file)
   TEST_ENTRY  (fs_readdir_non_empty_dir)
   TEST_ENTRY  (fs_readdir_non_existing_dir)
+  TEST_ENTRY  (fs_readdir_packed)
   TEST_ENTRY  (fs_rename_to_existing_file)
   TEST_ENTRY  (fs_write_multiple_bufs)
+  TEST_ENTRY  (fs_read_write_overlapped)
   TEST_ENTRY  (fs_write_alotof_bufs)
   TEST_ENTRY  (fs_write_alotof_bufs_with_offset)
   TEST_ENTRY  (fs_partial_read)
@@ -1093,11 +1347,24 @@ TASK_LIST_START
   TEST_ENTRY  (threadpool_cancel_work)
   TEST_ENTRY  (threadpool_cancel_fs)
   TEST_ENTRY  (threadpool_cancel_single)
+  TEST_ENTRY  (threadpool_cancel_tag)
+  TEST_ENTRY  (threadpool_work_deadline)
+  TEST_ENTRY  (threadpool_loop_pool)
+  TEST_ENTRY  (threadpool_loop_affinity)
+  TEST_ENTRY  (threadpool_queue_work_priority)
+  TEST_ENTRY  (threadpool_queue_work_batch)
+  TEST_ENTRY  (threadpool_parallel_for)
+  TEST_ENTRY  (threadpool_set_limits)
+  TEST_ENTRY  (threadpool_kind_size)
+  TEST_ENTRY  (threadpool_metrics)
+  TEST_ENTRY  (threadpool_set_options)
   TEST_ENTRY  (thread_local_storage)
   TEST_ENTRY  (thread_stack_size)
   TEST_ENTRY  (thread_stack_size_explicit)
+  TEST_ENTRY  (thread_affinity)
   TEST_ENTRY  (thread_mutex)
   TEST_ENTRY  (thread_mutex_recursive)
+  TEST_ENTRY  (thread_mutex_adaptive)
   TEST_ENTRY  (thread_rwlock)
   TEST_ENTRY  (thread_rwlock_trylock)
   TEST_ENTRY  (thread_create)
@@ -1106,11 +1373,14 @@ TASK_LIST_START
   TEST_ENTRY  (ip4_addr)
   TEST_ENTRY  (ip6_addr_link_local)
   TEST_ENTRY  (ip_name)
+  TEST_ENTRY  (netif_basic)
+  TEST_ENTRY  (cpu_sampler)
 
   TEST_ENTRY  (queue_foreach_delete)
 
   TEST_ENTRY  (random_async)
   TEST_ENTRY  (random_sync)
+  TEST_ENTRY  (random_fast)
 
   TEST_ENTRY  (handle_type_name)
   TEST_ENTRY  (req_type_name)
@@ -1120,6 +1390,8 @@ TASK_LIST_START
   TEST_ENTRY  (fork_timer)
   TEST_ENTRY  (fork_socketpair)
   TEST_ENTRY  (fork_socketpair_started)
+  TEST_ENTRY  (fork_rearm_filter)
+  TEST_ENTRY  (fork_rearm_filter_io_uring)
   TEST_ENTRY  (fork_signal_to_child)
   TEST_ENTRY  (fork_signal_to_child_closed)
 #ifndef __APPLE__
@@ -1139,6 +1411,7 @@ TASK_LIST_START
 /* Doesn't work on z/OS because that platform uses EBCDIC, not ASCII. */
 #ifndef __MVS__
   TEST_ENTRY  (idna_toascii)
+  TEST_ENTRY  (idna_toascii_public)
 #endif
 
   TEST_ENTRY    (not_writable_after_shutdown)
@@ -1151,6 +1424,17 @@ TASK_LIST_START
   TEST_ENTRY  (metrics_idle_time)
   TEST_ENTRY  (metrics_idle_time_thread)
   TEST_ENTRY  (metrics_idle_time_zero)
+  TEST_ENTRY  (metrics_info)
+  TEST_ENTRY  (metrics_slow_callback)
+  TEST_ENTRY  (metrics_trace)
+  TEST_ENTRY  (metrics_handle_counts)
+  TEST_ENTRY  (metrics_lag)
+  TEST_ENTRY  (replace_allocator_tagged)
+  TEST_ENTRY  (req_alloc)
+  TEST_ENTRY  (req_alloc_bufs)
+  TEST_ENTRY  (handle_alloc)
+  TEST_ENTRY  (io_stats)
+  TEST_ENTRY  (io_priority)
 
 #if 0
   /* These are for testing the test runner. */
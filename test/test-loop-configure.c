@@ -36,3 +36,382 @@ TEST_IMPL(loop_configure) {
   ASSERT(0 == uv_loop_close(&loop));
   return 0;
 }
+
+
+static uv_pipe_t io_uring_reader;
+static uv_pipe_t io_uring_writer;
+static uv_write_t io_uring_write_req;
+static uv_async_t io_uring_async;
+static char io_uring_buf[64];
+static int io_uring_read_cb_called;
+static int io_uring_async_cb_called;
+
+
+static void io_uring_alloc_cb(uv_handle_t* handle,
+                              size_t suggested_size,
+                              uv_buf_t* buf) {
+  buf->base = io_uring_buf;
+  buf->len = sizeof(io_uring_buf);
+}
+
+
+static void io_uring_read_cb(uv_stream_t* stream,
+                             ssize_t nread,
+                             const uv_buf_t* buf) {
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(4, nread);
+  ASSERT_MEM_EQ("PING", buf->base, 4);
+  io_uring_read_cb_called++;
+  ASSERT_EQ(0, uv_async_send(&io_uring_async));
+}
+
+
+static void io_uring_async_cb(uv_async_t* handle) {
+  io_uring_async_cb_called++;
+  uv_close((uv_handle_t*) &io_uring_reader, NULL);
+  uv_close((uv_handle_t*) &io_uring_writer, NULL);
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(loop_configure_io_uring) {
+  uv_timer_t timer_handle;
+  uv_loop_t loop;
+  uv_file fds[2];
+  uv_buf_t buf;
+  int r;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  r = uv_loop_configure(&loop, UV_LOOP_USE_IO_URING);
+  if (r == UV_ENOSYS) {
+    ASSERT_EQ(0, uv_loop_close(&loop));
+    RETURN_SKIP("io_uring is not supported.");
+  }
+  ASSERT_EQ(0, r);
+
+  ASSERT_EQ(0, uv_pipe(fds, 0, 0));
+  ASSERT_EQ(0, uv_pipe_init(&loop, &io_uring_reader, 0));
+  ASSERT_EQ(0, uv_pipe_init(&loop, &io_uring_writer, 0));
+  ASSERT_EQ(0, uv_pipe_open(&io_uring_reader, fds[0]));
+  ASSERT_EQ(0, uv_pipe_open(&io_uring_writer, fds[1]));
+  ASSERT_EQ(0, uv_async_init(&loop, &io_uring_async, io_uring_async_cb));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &io_uring_reader,
+                             io_uring_alloc_cb,
+                             io_uring_read_cb));
+
+  buf = uv_buf_init("PING", 4);
+  ASSERT_EQ(0, uv_write(&io_uring_write_req,
+                        (uv_stream_t*) &io_uring_writer,
+                        &buf,
+                        1,
+                        NULL));
+
+  ASSERT_EQ(0, uv_timer_init(&loop, &timer_handle));
+  ASSERT_EQ(0, uv_timer_start(&timer_handle, timer_cb, 10, 0));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(1, io_uring_read_cb_called);
+  ASSERT_EQ(1, io_uring_async_cb_called);
+
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  return 0;
+}
+
+
+static uv_async_t busy_poll_async;
+static uint64_t busy_poll_sent;
+static uint64_t busy_poll_timer_start;
+static int busy_poll_async_cb_called;
+static int busy_poll_timer_cb_called;
+
+
+static void busy_poll_thread(void* arg) {
+  uv_sleep(5);
+  busy_poll_sent = uv_hrtime();
+  ASSERT_EQ(0, uv_async_send(&busy_poll_async));
+}
+
+
+static void busy_poll_async_cb(uv_async_t* handle) {
+  /* Spinning, uv_now() must not lag behind the clock. */
+  ASSERT_LE(uv_hrtime() / 1000000 - uv_now(handle->loop), 5);
+  ASSERT_GT(uv_hrtime(), busy_poll_sent);
+  busy_poll_async_cb_called++;
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void busy_poll_timer_cb(uv_timer_t* handle) {
+  /* The time spent spinning counts towards the timeout. */
+  ASSERT_GE(uv_now(handle->loop) - busy_poll_timer_start, 30);
+  ASSERT_LT(uv_now(handle->loop) - busy_poll_timer_start, 1000);
+  busy_poll_timer_cb_called++;
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(loop_configure_busy_poll) {
+  uv_timer_t timer_handle;
+  uv_thread_t thread;
+  uv_loop_t loop;
+  int r;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  r = uv_loop_configure(&loop, UV_LOOP_BUSY_POLL, 20000);
+  if (r == UV_ENOSYS) {
+    ASSERT_EQ(0, uv_loop_close(&loop));
+    RETURN_SKIP("Busy polling is not supported.");
+  }
+  ASSERT_EQ(0, r);
+
+  ASSERT_EQ(0, uv_async_init(&loop, &busy_poll_async, busy_poll_async_cb));
+  ASSERT_EQ(0, uv_timer_init(&loop, &timer_handle));
+  busy_poll_timer_start = uv_now(&loop);
+  ASSERT_EQ(0, uv_timer_start(&timer_handle, busy_poll_timer_cb, 30, 0));
+  ASSERT_EQ(0, uv_thread_create(&thread, busy_poll_thread, NULL));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, uv_thread_join(&thread));
+
+  ASSERT_EQ(1, busy_poll_async_cb_called);
+  ASSERT_EQ(1, busy_poll_timer_cb_called);
+
+  /* Zero turns it off again. */
+  ASSERT_EQ(0, uv_loop_configure(&loop, UV_LOOP_BUSY_POLL, 0));
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  return 0;
+}
+
+
+static uint64_t coarse_clock_start;
+static int coarse_clock_timer_cb_called;
+
+
+static void coarse_clock_timer_cb(uv_timer_t* handle) {
+  /* The loop's clock lags behind by a timer tick at most, 10 ms with
+   * HZ=100, and the timeout was counted from the lagging time.
+   */
+  ASSERT_GE(uv_hrtime() - coarse_clock_start, 10 * 1000000);
+  coarse_clock_timer_cb_called++;
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(loop_configure_coarse_clock) {
+  uv_timer_t timer_handle;
+  uv_loop_t loop;
+  uint64_t now;
+  int r;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  r = uv_loop_configure(&loop, UV_LOOP_COARSE_CLOCK);
+  if (r == UV_ENOSYS) {
+    ASSERT_EQ(0, uv_loop_close(&loop));
+    RETURN_SKIP("UV_LOOP_COARSE_CLOCK is not supported.");
+  }
+  ASSERT_EQ(0, r);
+
+  now = uv_now(&loop);
+  uv_update_time(&loop);
+  ASSERT_GE(uv_now(&loop), now);
+
+  coarse_clock_start = uv_hrtime();
+  ASSERT_EQ(0, uv_timer_init(&loop, &timer_handle));
+  ASSERT_EQ(0, uv_timer_start(&timer_handle, coarse_clock_timer_cb, 20, 0));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, coarse_clock_timer_cb_called);
+
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  return 0;
+}
+
+
+#ifndef _WIN32
+static int event_buffer_poll_cb_called;
+
+
+static void event_buffer_poll_cb(uv_poll_t* handle, int status, int events) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(UV_READABLE, events);
+  event_buffer_poll_cb_called++;
+  uv_close((uv_handle_t*) handle, NULL);
+}
+#endif
+
+
+TEST_IMPL(loop_configure_event_buffer) {
+#ifdef _WIN32
+  uv_loop_t loop;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  ASSERT_EQ(UV_EINVAL, uv_loop_configure(&loop, UV_LOOP_EVENT_BUFFER_SIZE, 0));
+  ASSERT_EQ(0, uv_loop_configure(&loop, UV_LOOP_EVENT_BUFFER_SIZE, 2));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  RETURN_SKIP("The growth check needs socketpair().");
+#else
+  uv_poll_t handles[64];
+  uv_os_sock_t fds[64][2];
+  uv_metrics_t metrics;
+  uv_loop_t loop;
+  unsigned int i;
+  uint64_t big;
+  int r;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  if (uv_loop_configure(&loop, UV_LOOP_USE_IO_URING) == 0) {
+    /* The ring doesn't use the buffer. */
+    ASSERT_EQ(UV_ENOTSUP,
+              uv_loop_configure(&loop, UV_LOOP_EVENT_BUFFER_SIZE, 2));
+    ASSERT_EQ(0, uv_loop_close(&loop));
+    ASSERT_EQ(0, uv_loop_init(&loop));
+  }
+
+  ASSERT_EQ(UV_EINVAL, uv_loop_configure(&loop, UV_LOOP_EVENT_BUFFER_SIZE, 0));
+  r = uv_loop_configure(&loop, UV_LOOP_EVENT_BUFFER_SIZE, 2);
+  if (r == UV_ENOSYS) {
+    ASSERT_EQ(0, uv_loop_close(&loop));
+    RETURN_SKIP("UV_LOOP_EVENT_BUFFER_SIZE is not supported.");
+  }
+  ASSERT_EQ(0, r);
+
+  for (i = 0; i < ARRAY_SIZE(handles); i++) {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]));
+    ASSERT_EQ(1, write(fds[i][1], "x", 1));
+    ASSERT_EQ(0, uv_poll_init_socket(&loop, &handles[i], fds[i][0]));
+    ASSERT_EQ(0, uv_poll_start(&handles[i],
+                               UV_READABLE,
+                               event_buffer_poll_cb));
+  }
+
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(ARRAY_SIZE(handles), event_buffer_poll_cb_called);
+
+  /* The buffer started out with room for two events and filled up on every
+   * poll, it must have grown past that.
+   */
+  ASSERT_EQ(0, uv_metrics_info(&loop, &metrics));
+  ASSERT_GT(metrics.polls_saturated, 0);
+  big = 0;
+  for (i = 3; i < UV_METRICS_POLL_HISTOGRAM_SIZE; i++)
+    big += metrics.poll_histogram[i];
+  ASSERT_GT(big, 0);
+
+  for (i = 0; i < ARRAY_SIZE(handles); i++) {
+    ASSERT_EQ(0, close(fds[i][0]));
+    ASSERT_EQ(0, close(fds[i][1]));
+  }
+
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  return 0;
+#endif
+}
+
+
+static int high_res_timer_cb_called;
+
+
+static void high_res_timer_cb(uv_timer_t* handle) {
+  if (++high_res_timer_cb_called < 10)
+    ASSERT_EQ(0, uv_timer_start(handle, high_res_timer_cb, 2, 0));
+  else
+    uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(loop_configure_high_res_timers) {
+  uv_timer_t timer_handle;
+  uv_loop_t loop;
+  uint64_t start;
+  int r;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  r = uv_loop_configure(&loop, UV_LOOP_HIGH_RES_TIMERS);
+  if (r == UV_ENOSYS || r == UV_ENOTSUP) {
+    ASSERT_EQ(0, uv_loop_close(&loop));
+    RETURN_SKIP("UV_LOOP_HIGH_RES_TIMERS is not supported.");
+  }
+  ASSERT_EQ(0, r);
+  /* Enabling it twice is fine. */
+  ASSERT_EQ(0, uv_loop_configure(&loop, UV_LOOP_HIGH_RES_TIMERS));
+
+  /* Waking up sooner must not make the timers expire early. */
+  start = uv_hrtime();
+  ASSERT_EQ(0, uv_timer_init(&loop, &timer_handle));
+  ASSERT_EQ(0, uv_timer_start(&timer_handle, high_res_timer_cb, 2, 0));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(10, high_res_timer_cb_called);
+  ASSERT_GE(uv_hrtime() - start, 10 * 2 * 1000000);
+
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  return 0;
+}
+
+
+#ifndef _WIN32
+static uv_check_t io_budget_check;
+static unsigned int io_budget_iteration_cbs;
+static unsigned int io_budget_poll_cb_called;
+
+
+static void io_budget_poll_cb(uv_poll_t* handle, int status, int events) {
+  ASSERT_EQ(0, status);
+  io_budget_iteration_cbs++;
+  io_budget_poll_cb_called++;
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+/* Runs once per loop iteration, after the poll phase. */
+static void io_budget_check_cb(uv_check_t* handle) {
+  ASSERT_LE(io_budget_iteration_cbs, 3);
+  io_budget_iteration_cbs = 0;
+  if (io_budget_poll_cb_called == 8)
+    uv_close((uv_handle_t*) handle, NULL);
+}
+#endif
+
+
+TEST_IMPL(loop_configure_io_budget) {
+#ifdef _WIN32
+  RETURN_SKIP("UV_LOOP_IO_BUDGET is not supported on Windows.");
+#else
+  uv_poll_t handles[8];
+  uv_os_sock_t fds[8][2];
+  uv_loop_t loop;
+  unsigned int i;
+  int r;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  r = uv_loop_configure(&loop, UV_LOOP_IO_BUDGET, 3, 0);
+  if (r == UV_ENOSYS) {
+    ASSERT_EQ(0, uv_loop_close(&loop));
+    RETURN_SKIP("UV_LOOP_IO_BUDGET is not supported.");
+  }
+  ASSERT_EQ(0, r);
+
+  /* All of them are ready at once, the budget spreads them out. */
+  for (i = 0; i < ARRAY_SIZE(handles); i++) {
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, fds[i]));
+    ASSERT_EQ(1, write(fds[i][1], "x", 1));
+    ASSERT_EQ(0, uv_poll_init_socket(&loop, &handles[i], fds[i][0]));
+    ASSERT_EQ(0, uv_poll_start(&handles[i], UV_READABLE, io_budget_poll_cb));
+  }
+
+  ASSERT_EQ(0, uv_check_init(&loop, &io_budget_check));
+  ASSERT_EQ(0, uv_check_start(&io_budget_check, io_budget_check_cb));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(ARRAY_SIZE(handles), io_budget_poll_cb_called);
+
+  for (i = 0; i < ARRAY_SIZE(handles); i++) {
+    ASSERT_EQ(0, close(fds[i][0]));
+    ASSERT_EQ(0, close(fds[i][1]));
+  }
+
+  /* Zeroes lift the limits again. */
+  ASSERT_EQ(0, uv_loop_configure(&loop, UV_LOOP_IO_BUDGET, 0, 0));
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  return 0;
+#endif
+}
@@ -0,0 +1,205 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define TRANSFER_BYTES (256 * 1024)
+#define NUM_DATAGRAMS 100
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t incoming;
+static uv_connect_t connect_req;
+static uv_write_t write_req;
+static uv_timer_t timer;
+static uv_udp_t receiver;
+static uv_udp_t sender;
+static char data[TRANSFER_BYTES];
+static char buffer[4096];
+static size_t nread_total;
+static int read_stopped;
+static int write_cb_called;
+static int datagrams;
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  *buf = uv_buf_init(buffer, sizeof(buffer));
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf);
+
+
+static void timer_cb(uv_timer_t* handle) {
+  /* Everything that's left has arrived by now, the kernel won't report the
+   * socket readable again.
+   */
+  ASSERT_EQ(1, write_cb_called);
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &incoming, alloc_cb, read_cb));
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ASSERT_GE(nread, 0);
+  nread_total += nread;
+
+  if (!read_stopped && nread_total >= TRANSFER_BYTES / 4) {
+    read_stopped = 1;
+    ASSERT_EQ(0, uv_read_stop(stream));
+    ASSERT_EQ(0, uv_timer_start(&timer, timer_cb, 50, 0));
+    return;
+  }
+
+  if (nread_total == TRANSFER_BYTES) {
+    uv_close((uv_handle_t*) &incoming, NULL);
+    uv_close((uv_handle_t*) &client, NULL);
+    uv_close((uv_handle_t*) &server, NULL);
+    uv_close((uv_handle_t*) &timer, NULL);
+  }
+}
+
+
+static void connection_cb(uv_stream_t* stream, int status) {
+  uv_stream_read_options_t options;
+
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, uv_tcp_init(stream->loop, &incoming));
+  ASSERT_EQ(0, uv_accept(stream, (uv_stream_t*) &incoming));
+
+  /* One small read per loop iteration, the rest of the data is only read
+   * if the stream is rearmed.
+   */
+  memset(&options, 0, sizeof(options));
+  options.min_size = sizeof(buffer);
+  options.max_size = sizeof(buffer);
+  options.max_reads = 1;
+  ASSERT_EQ(0, uv_stream_set_read_options((uv_stream_t*) &incoming,
+                                          &options));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &incoming, alloc_cb, read_cb));
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+  write_cb_called++;
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_buf_t buf;
+
+  ASSERT_EQ(0, status);
+  buf = uv_buf_init(data, sizeof(data));
+  ASSERT_EQ(0, uv_write(&write_req,
+                        (uv_stream_t*) &client,
+                        &buf,
+                        1,
+                        write_cb));
+}
+
+
+TEST_IMPL(tcp_edge_triggered) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  int err;
+
+  loop = uv_default_loop();
+  err = uv_loop_configure(loop, UV_LOOP_EDGE_TRIGGERED);
+  if (err == UV_ENOSYS)
+    RETURN_SKIP("UV_LOOP_EDGE_TRIGGERED is only supported on Linux");
+  ASSERT_EQ(0, err);
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_timer_init(loop, &timer));
+  ASSERT_EQ(0, uv_tcp_init(loop, &server));
+  ASSERT_EQ(0, uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 1, connection_cb));
+  ASSERT_EQ(0, uv_tcp_init(loop, &client));
+  ASSERT_EQ(0, uv_tcp_connect(&connect_req,
+                              &client,
+                              (const struct sockaddr*) &addr,
+                              connect_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, write_cb_called);
+  ASSERT_EQ(1, read_stopped);
+  ASSERT_EQ(TRANSFER_BYTES, nread_total);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void recv_cb(uv_udp_t* handle,
+                    ssize_t nread,
+                    const uv_buf_t* buf,
+                    const struct sockaddr* addr,
+                    unsigned flags) {
+  ASSERT_GE(nread, 0);
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(1, nread);
+  if (++datagrams == NUM_DATAGRAMS) {
+    uv_close((uv_handle_t*) &receiver, NULL);
+    uv_close((uv_handle_t*) &sender, NULL);
+  }
+}
+
+
+TEST_IMPL(udp_edge_triggered) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  uv_buf_t buf;
+  int err;
+  int i;
+
+  loop = uv_default_loop();
+  err = uv_loop_configure(loop, UV_LOOP_EDGE_TRIGGERED);
+  if (err == UV_ENOSYS)
+    RETURN_SKIP("UV_LOOP_EDGE_TRIGGERED is only supported on Linux");
+  ASSERT_EQ(0, err);
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_udp_init(loop, &receiver));
+  ASSERT_EQ(0, uv_udp_bind(&receiver, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_udp_recv_start(&receiver, alloc_cb, recv_cb));
+
+  /* More datagrams than are read per loop iteration, all queued before the
+   * receiver is registered with the kernel.
+   */
+  ASSERT_EQ(0, uv_udp_init(loop, &sender));
+  buf = uv_buf_init("x", 1);
+  for (i = 0; i < NUM_DATAGRAMS; i++)
+    ASSERT_EQ(1, uv_udp_try_send(&sender,
+                                 &buf,
+                                 1,
+                                 (const struct sockaddr*) &addr));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_DATAGRAMS, datagrams);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
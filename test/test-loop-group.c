@@ -0,0 +1,190 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NLOOPS 3
+
+enum {
+  OP_WORK,
+  OP_TIMER_START,
+  OP_TIMER_CLOSE
+};
+
+struct group_msg {
+  uv_channel_msg_t msg;
+  int op;
+  unsigned int index;
+  uv_work_t work_req;
+  uv_timer_t timer;
+};
+
+static uv_loop_group_t group;
+static struct group_msg msgs[NLOOPS];
+static struct group_msg closes[NLOOPS];
+static uv_sem_t done_sem;
+static uv_mutex_t mutex;
+static int work_cb_called;
+static int after_work_cb_called;
+
+
+static void work_cb(uv_work_t* req) {
+  uv_mutex_lock(&mutex);
+  work_cb_called++;
+  uv_mutex_unlock(&mutex);
+}
+
+
+static void after_work_cb(uv_work_t* req, int status) {
+  struct group_msg* m;
+
+  ASSERT_EQ(0, status);
+  m = container_of(req, struct group_msg, work_req);
+  ASSERT_PTR_EQ(uv_loop_group_get(&group, m->index), req->loop);
+
+  uv_mutex_lock(&mutex);
+  after_work_cb_called++;
+  uv_mutex_unlock(&mutex);
+  uv_sem_post(&done_sem);
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  ASSERT(0 && "timer_cb should not have been called");
+}
+
+
+static void msg_cb(uv_loop_group_t* g,
+                   uv_loop_t* loop,
+                   uv_channel_msg_t* msg) {
+  struct group_msg* m;
+  struct group_msg* owner;
+
+  m = msg->data;
+  ASSERT_PTR_EQ(&group, g);
+  ASSERT_PTR_EQ(uv_loop_group_get(g, m->index), loop);
+
+  switch (m->op) {
+    case OP_WORK:
+      ASSERT_EQ(0, uv_queue_work(loop, &m->work_req, work_cb, after_work_cb));
+      break;
+    case OP_TIMER_START:
+      ASSERT_EQ(0, uv_timer_init(loop, &m->timer));
+      ASSERT_EQ(0, uv_timer_start(&m->timer, timer_cb, 60000, 0));
+      uv_sem_post(&done_sem);
+      break;
+    case OP_TIMER_CLOSE:
+      owner = &msgs[m->index];
+      uv_close((uv_handle_t*) &owner->timer, NULL);
+      break;
+  }
+}
+
+
+static void send_msg(struct group_msg* m, int op, unsigned int index) {
+  m->msg.data = m;
+  m->op = op;
+  m->index = index;
+  ASSERT_EQ(0, uv_loop_group_send(&group, index, &m->msg));
+}
+
+
+TEST_IMPL(loop_group) {
+  uv_threadpool_metrics_t metrics;
+  unsigned int i;
+
+  ASSERT_EQ(UV_EINVAL, uv_loop_group_init(&group, 0, 0, 0, msg_cb));
+  ASSERT_EQ(UV_EINVAL, uv_loop_group_init(&group, NLOOPS, 0, 0, NULL));
+  ASSERT_EQ(UV_EINVAL, uv_loop_group_init(&group, NLOOPS, 0, 4, msg_cb));
+
+  ASSERT_EQ(0, uv_sem_init(&done_sem, 0));
+  ASSERT_EQ(0, uv_mutex_init(&mutex));
+  ASSERT_EQ(0, uv_loop_group_init(&group,
+                                   NLOOPS,
+                                   2,
+                                   UV_LOOP_GROUP_PIN_THREADS,
+                                   msg_cb));
+  ASSERT_EQ(NLOOPS, uv_loop_group_size(&group));
+  ASSERT_NULL(uv_loop_group_get(&group, NLOOPS));
+  ASSERT_EQ(UV_EINVAL, uv_loop_group_send(&group, NLOOPS, &msgs[0].msg));
+
+  /* Round-robin placement. */
+  for (i = 0; i < 2 * NLOOPS; i++)
+    ASSERT_EQ(i % NLOOPS, uv_loop_group_next(&group));
+
+  for (i = 0; i < NLOOPS; i++)
+    send_msg(&msgs[i], OP_WORK, i);
+  for (i = 0; i < NLOOPS; i++)
+    uv_sem_wait(&done_sem);
+
+  uv_mutex_lock(&mutex);
+  ASSERT_EQ(NLOOPS, work_cb_called);
+  ASSERT_EQ(NLOOPS, after_work_cb_called);
+  uv_mutex_unlock(&mutex);
+
+  /* The loops share one pool of two threads. */
+  for (i = 0; i < NLOOPS; i++) {
+    ASSERT_EQ(0, uv_threadpool_metrics(uv_loop_group_get(&group, i),
+                                       &metrics));
+    ASSERT_EQ(2, metrics.threads);
+    ASSERT_EQ(NLOOPS, metrics.kinds[UV_THREADPOOL_WORK_CPU].completed);
+  }
+
+  ASSERT_EQ(0, uv_loop_group_close(&group));
+  ASSERT_EQ(UV_EINVAL, uv_loop_group_close(&group));
+
+  uv_mutex_destroy(&mutex);
+  uv_sem_destroy(&done_sem);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(loop_group_least_loaded) {
+  unsigned int i;
+
+  ASSERT_EQ(0, uv_sem_init(&done_sem, 0));
+  ASSERT_EQ(0, uv_loop_group_init(&group,
+                                   NLOOPS,
+                                   0,
+                                   UV_LOOP_GROUP_LEAST_LOADED,
+                                   msg_cb));
+
+  /* Everything but loop 1 gets busy. */
+  send_msg(&msgs[0], OP_TIMER_START, 0);
+  send_msg(&msgs[2], OP_TIMER_START, 2);
+  uv_sem_wait(&done_sem);
+  uv_sem_wait(&done_sem);
+
+  for (i = 0; i < 2 * NLOOPS; i++)
+    ASSERT_EQ(1, uv_loop_group_next(&group));
+
+  send_msg(&closes[0], OP_TIMER_CLOSE, 0);
+  send_msg(&closes[2], OP_TIMER_CLOSE, 2);
+  ASSERT_EQ(0, uv_loop_group_close(&group));
+
+  uv_sem_destroy(&done_sem);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
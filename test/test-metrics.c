@@ -133,3 +133,417 @@ TEST_IMPL(metrics_idle_time_zero) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static uv_async_t metrics_async;
+static uv_check_t metrics_check;
+
+static void metrics_async_cb(uv_async_t* handle) {
+  uv_close((uv_handle_t*) handle, NULL);
+  uv_close((uv_handle_t*) &metrics_check, NULL);
+}
+
+
+static void metrics_spin_timer_cb(uv_timer_t* handle) {
+  uint64_t t;
+
+  (*(int*) handle->data)++;
+  t = uv_hrtime();
+  while (uv_hrtime() - t < 50 * UV_NS_TO_MS) { }
+  ASSERT_EQ(0, uv_async_send(&metrics_async));
+}
+
+
+static void metrics_spin_check_cb(uv_check_t* handle) {
+  uint64_t t;
+
+  t = uv_hrtime();
+  while (uv_hrtime() - t < 20 * UV_NS_TO_MS) { }
+  ASSERT_EQ(0, uv_check_stop(handle));
+}
+
+
+TEST_IMPL(metrics_info) {
+  uv_metrics_t metrics;
+  uv_timer_t timer;
+  uv_loop_t* loop;
+  uint64_t polls;
+  int cntr;
+  int i;
+
+  loop = uv_default_loop();
+  cntr = 0;
+  timer.data = &cntr;
+
+  ASSERT_EQ(0, uv_metrics_info(loop, &metrics));
+  ASSERT_EQ(0, metrics.loop_count);
+  ASSERT_EQ(0, metrics.events);
+
+  ASSERT_EQ(0, uv_loop_configure(loop, UV_METRICS_PHASE_TIME));
+  ASSERT_EQ(0, uv_async_init(loop, &metrics_async, metrics_async_cb));
+  ASSERT_EQ(0, uv_check_init(loop, &metrics_check));
+  ASSERT_EQ(0, uv_check_start(&metrics_check, metrics_spin_check_cb));
+  ASSERT_EQ(0, uv_timer_init(loop, &timer));
+  ASSERT_EQ(0, uv_timer_start(&timer, metrics_spin_timer_cb, 10, 0));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, cntr);
+
+  ASSERT_EQ(0, uv_metrics_info(loop, &metrics));
+  ASSERT_GE(metrics.loop_count, 2);
+  ASSERT_GE(metrics.events, 1);
+  ASSERT_GE(metrics.phase_time[UV_METRICS_PHASE_TIMERS], 50 * UV_NS_TO_MS);
+  ASSERT_GE(metrics.phase_time[UV_METRICS_PHASE_CHECK], 20 * UV_NS_TO_MS);
+  /* The poll phase waited for the timer. */
+  ASSERT_GT(metrics.phase_time[UV_METRICS_PHASE_POLL], 0);
+  ASSERT_LT(metrics.phase_time[UV_METRICS_PHASE_CLOSING], 20 * UV_NS_TO_MS);
+
+  /* At least the async wakeup and the timer going off. On Unix, an async
+   * handle signalled from the loop thread is picked up without a wakeup.
+   */
+  ASSERT_GE(metrics.polls, 2);
+  ASSERT_GE(metrics.polls_empty, 1);
+#ifdef _WIN32
+  ASSERT_GE(metrics.poll_histogram[1], 1);
+#endif
+  ASSERT_EQ(metrics.polls_empty, metrics.poll_histogram[0]);
+  ASSERT_EQ(0, metrics.polls_saturated);
+  polls = 0;
+  for (i = 0; i < UV_METRICS_POLL_HISTOGRAM_SIZE; i++)
+    polls += metrics.poll_histogram[i];
+  ASSERT_EQ(polls, metrics.polls);
+
+  ASSERT_EQ(UV_EINVAL, uv_metrics_info(loop, NULL));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uv_udp_t slow_udp;
+static uv_timer_t slow_timer;
+static uv_timer_t fast_timer;
+static int slow_hook_called;
+static uv_handle_type slow_types[2];
+static void (*slow_cbs[2])(void);
+
+static void slow_spin(void) {
+  uint64_t t;
+
+  t = uv_hrtime();
+  while (uv_hrtime() - t < 30 * UV_NS_TO_MS) { }
+}
+
+
+static void slow_hook(uv_loop_t* loop, const uv_slow_callback_info_t* info) {
+  ASSERT_LT(slow_hook_called, 2);
+  ASSERT_NOT_NULL(info->handle);
+  ASSERT_EQ(info->type, info->handle->type);
+  ASSERT_GE(info->duration, 30 * UV_NS_TO_MS);
+  slow_types[slow_hook_called] = info->type;
+  slow_cbs[slow_hook_called] = info->cb;
+  slow_hook_called++;
+}
+
+
+static void slow_alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  static char slab[64];
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void slow_recv_cb(uv_udp_t* handle,
+                         ssize_t nread,
+                         const uv_buf_t* buf,
+                         const struct sockaddr* addr,
+                         unsigned flags) {
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(4, nread);
+  slow_spin();
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void slow_timer_cb(uv_timer_t* handle) {
+  struct sockaddr_in addr;
+  uv_buf_t buf;
+  int namelen;
+
+  slow_spin();
+
+  namelen = sizeof(addr);
+  ASSERT_EQ(0, uv_udp_getsockname(&slow_udp,
+                                  (struct sockaddr*) &addr,
+                                  &namelen));
+  buf = uv_buf_init("PING", 4);
+  ASSERT_EQ(4, uv_udp_try_send(&slow_udp,
+                               &buf,
+                               1,
+                               (const struct sockaddr*) &addr));
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void fast_timer_cb(uv_timer_t* handle) {
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(metrics_slow_callback) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  int r;
+
+  loop = uv_default_loop();
+  r = uv_loop_configure(loop, UV_LOOP_SLOW_CALLBACK, slow_hook, 20);
+#ifdef _WIN32
+  ASSERT_EQ(r, UV_ENOSYS);
+  RETURN_SKIP("Not implemented on Windows");
+#endif
+  ASSERT_EQ(0, r);
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", 0, &addr));
+  ASSERT_EQ(0, uv_udp_init(loop, &slow_udp));
+  ASSERT_EQ(0, uv_udp_bind(&slow_udp, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_udp_recv_start(&slow_udp, slow_alloc_cb, slow_recv_cb));
+  ASSERT_EQ(0, uv_timer_init(loop, &fast_timer));
+  ASSERT_EQ(0, uv_timer_start(&fast_timer, fast_timer_cb, 0, 0));
+  ASSERT_EQ(0, uv_timer_init(loop, &slow_timer));
+  ASSERT_EQ(0, uv_timer_start(&slow_timer, slow_timer_cb, 1, 0));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+
+  /* The fast timer isn't reported. */
+  ASSERT_EQ(2, slow_hook_called);
+  ASSERT_EQ(UV_TIMER, slow_types[0]);
+  ASSERT(slow_cbs[0] == (void (*)(void)) slow_timer_cb);
+  ASSERT_EQ(UV_UDP, slow_types[1]);
+  ASSERT(slow_cbs[1] == (void (*)(void)) slow_recv_cb);
+
+  ASSERT_EQ(0, uv_loop_configure(loop, UV_LOOP_SLOW_CALLBACK, NULL, 0));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static int trace_timer_called;
+static int trace_close_called;
+
+
+static void trace_close_cb(uv_handle_t* handle) {
+  trace_close_called++;
+}
+
+
+static void trace_timer_cb(uv_timer_t* handle) {
+  if (++trace_timer_called == 6)
+    uv_close((uv_handle_t*) handle, trace_close_cb);
+}
+
+
+TEST_IMPL(metrics_trace) {
+  uv_trace_event_t events[4];
+  uv_timer_t timer;
+  uv_loop_t loop;
+  char buf[4096];
+  FILE* stream;
+  size_t n;
+  char* p;
+  int i;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  ASSERT_EQ(UV_EINVAL, uv_loop_trace_start(&loop, events, 0));
+  ASSERT_EQ(UV_EINVAL, uv_loop_trace_dump(&loop, stderr));
+  ASSERT_EQ(0, uv_loop_trace_start(&loop, events, ARRAY_SIZE(events)));
+
+  ASSERT_EQ(0, uv_timer_init(&loop, &timer));
+  ASSERT_EQ(0, uv_timer_start(&timer, trace_timer_cb, 1, 1));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(6, trace_timer_called);
+  ASSERT_EQ(1, trace_close_called);
+
+  /* The ring has wrapped around, in the order they ran the last ones are the
+   * timer callbacks and, except on Windows, the close callback.
+   */
+#ifdef _WIN32
+  i = 6 % ARRAY_SIZE(events);
+#else
+  i = 7 % ARRAY_SIZE(events);
+  ASSERT_EQ(UV_TIMER, events[(i + 3) % 4].type);
+  ASSERT_EQ(UV_METRICS_PHASE_CLOSING, events[(i + 3) % 4].phase);
+  ASSERT(events[(i + 3) % 4].cb == (void (*)(void)) trace_close_cb);
+#endif
+  ASSERT_EQ(UV_TIMER, events[i].type);
+  ASSERT_EQ(UV_METRICS_PHASE_TIMERS, events[i].phase);
+  ASSERT(events[i].cb == (void (*)(void)) trace_timer_cb);
+  ASSERT_LE(events[i].start, events[(i + 1) % 4].start);
+
+  stream = tmpfile();
+  ASSERT_NOT_NULL(stream);
+  ASSERT_EQ(0, uv_loop_trace_dump(&loop, stream));
+  rewind(stream);
+  n = fread(buf, 1, sizeof(buf) - 1, stream);
+  buf[n] = '\0';
+  fclose(stream);
+
+  ASSERT_EQ(0, strncmp(buf, "{\"traceEvents\":[", 16));
+  ASSERT_NOT_NULL(strstr(buf, "\"name\":\"timer\",\"cat\":\"timers\""));
+  for (i = 0, p = buf; (p = strstr(p, "\"ph\":\"X\"")) != NULL; p++)
+    i++;
+  ASSERT_EQ(4, i);
+
+  uv_loop_trace_stop(&loop);
+  ASSERT_EQ(UV_EINVAL, uv_loop_trace_dump(&loop, stderr));
+  ASSERT_EQ(0, uv_loop_close(&loop));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void counts_work_cb(uv_work_t* req) {
+}
+
+
+static void counts_after_work_cb(uv_work_t* req, int status) {
+  ASSERT_EQ(0, status);
+}
+
+
+TEST_IMPL(metrics_handle_counts) {
+  uv_handle_counts_t base;
+  uv_handle_counts_t counts;
+  uv_timer_t timers[3];
+  uv_work_t work;
+  uv_loop_t loop;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  ASSERT_EQ(0, uv_metrics_handle_counts(&loop, &base));
+  ASSERT_EQ(0, base.handles[UV_TIMER]);
+  ASSERT_EQ(0, base.reqs[UV_WORK]);
+
+  ASSERT_EQ(0, uv_timer_init(&loop, &timers[0]));
+  ASSERT_EQ(0, uv_timer_init(&loop, &timers[1]));
+  ASSERT_EQ(0, uv_timer_init(&loop, &timers[2]));
+  ASSERT_EQ(0, uv_timer_start(&timers[0], timer_noop_cb, 1000, 0));
+  ASSERT_EQ(0, uv_timer_start(&timers[1], timer_noop_cb, 1000, 0));
+  uv_timer_stop(&timers[1]);
+  uv_close((uv_handle_t*) &timers[2], NULL);
+  ASSERT_EQ(0, uv_queue_work(&loop, &work, counts_work_cb,
+                             counts_after_work_cb));
+
+  ASSERT_EQ(0, uv_metrics_handle_counts(&loop, &counts));
+  ASSERT_EQ(3, counts.handles[UV_TIMER]);
+  ASSERT_EQ(1, counts.active[UV_TIMER]);
+  ASSERT_EQ(1, counts.closing[UV_TIMER]);
+  ASSERT_EQ(1, counts.reqs[UV_WORK]);
+
+  /* The first threadpool request sets up the loop's internal async handle
+   * on Unix, there's none before.
+   */
+  ASSERT_LE(counts.handles[UV_ASYNC], base.handles[UV_ASYNC] + 1);
+  base.handles[UV_ASYNC] = counts.handles[UV_ASYNC];
+  base.active[UV_ASYNC] = counts.active[UV_ASYNC];
+
+  uv_close((uv_handle_t*) &timers[0], NULL);
+  uv_close((uv_handle_t*) &timers[1], NULL);
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(0, uv_metrics_handle_counts(&loop, &counts));
+  ASSERT_EQ(0, counts.handles[UV_TIMER]);
+  ASSERT_EQ(0, counts.active[UV_TIMER]);
+  ASSERT_EQ(0, counts.closing[UV_TIMER]);
+  ASSERT_EQ(0, counts.reqs[UV_WORK]);
+  ASSERT_EQ(0, memcmp(&base, &counts, sizeof(base)));
+
+  ASSERT_EQ(UV_EINVAL, uv_metrics_handle_counts(&loop, NULL));
+
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uv_udp_t lag_udp[2];
+static int lag_recv_cb_called;
+
+static void lag_timer_cb(uv_timer_t* handle) {
+  slow_spin();
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+static void lag_recv_cb(uv_udp_t* handle,
+                        ssize_t nread,
+                        const uv_buf_t* buf,
+                        const struct sockaddr* addr,
+                        unsigned flags) {
+  if (nread <= 0)
+    return;
+
+  lag_recv_cb_called++;
+  slow_spin();
+  uv_close((uv_handle_t*) handle, NULL);
+}
+
+
+TEST_IMPL(metrics_lag) {
+  struct sockaddr_storage name;
+  struct sockaddr_in addr;
+  uv_metrics_lag_t lag;
+  uv_timer_t timers[2];
+  uv_loop_t* loop;
+  uv_buf_t buf;
+  int namelen;
+  int i;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_metrics_lag(loop, &lag));
+  ASSERT_EQ(0, lag.timers.count);
+  ASSERT_EQ(0, lag.io.count);
+  ASSERT_EQ(0, uv_loop_configure(loop, UV_METRICS_LAG));
+
+  /* Both are due at once, the second one waits for the first to spin. */
+  ASSERT_EQ(0, uv_timer_init(loop, &timers[0]));
+  ASSERT_EQ(0, uv_timer_init(loop, &timers[1]));
+  ASSERT_EQ(0, uv_timer_start(&timers[0], lag_timer_cb, 1, 0));
+  ASSERT_EQ(0, uv_timer_start(&timers[1], lag_timer_cb, 1, 0));
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", 0, &addr));
+  buf = uv_buf_init("lag", 3);
+  for (i = 0; i < 2; i++) {
+    ASSERT_EQ(0, uv_udp_init(loop, &lag_udp[i]));
+    ASSERT_EQ(0, uv_udp_bind(&lag_udp[i], (const struct sockaddr*) &addr, 0));
+    namelen = sizeof(name);
+    ASSERT_EQ(0, uv_udp_getsockname(&lag_udp[i],
+                                    (struct sockaddr*) &name,
+                                    &namelen));
+    ASSERT_EQ(3, uv_udp_try_send(&lag_udp[i],
+                                 &buf,
+                                 1,
+                                 (const struct sockaddr*) &name));
+    ASSERT_EQ(0, uv_udp_recv_start(&lag_udp[i], slow_alloc_cb, lag_recv_cb));
+  }
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, lag_recv_cb_called);
+
+  ASSERT_EQ(0, uv_metrics_lag(loop, &lag));
+  ASSERT_EQ(2, lag.timers.count);
+  ASSERT_GE(lag.timers.max, 30 * UV_NS_TO_MS);
+  ASSERT_GE(lag.timers.total, lag.timers.max);
+#ifndef _WIN32
+  /* Both datagrams are ready after the same poll. */
+  ASSERT_GE(lag.io.count, 2);
+  ASSERT_GE(lag.io.max, 30 * UV_NS_TO_MS);
+#endif
+
+  ASSERT_EQ(UV_EINVAL, uv_metrics_lag(loop, NULL));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -70,6 +70,44 @@ TEST_IMPL(thread_mutex_recursive) {
 }
 
 
+static void adaptive_mutex_worker(void* arg) {
+  int* counter;
+  int i;
+
+  counter = arg;
+  for (i = 0; i < 10000; i++) {
+    uv_mutex_lock(&mutex);
+    (*counter)++;
+    uv_mutex_unlock(&mutex);
+  }
+}
+
+
+TEST_IMPL(thread_mutex_adaptive) {
+  uv_thread_t threads[4];
+  int counter;
+  int i;
+
+  ASSERT_EQ(0, uv_mutex_init_adaptive(&mutex));
+
+  counter = 0;
+  for (i = 0; i < (int) ARRAY_SIZE(threads); i++)
+    ASSERT_EQ(0, uv_thread_create(threads + i,
+                                  adaptive_mutex_worker,
+                                  &counter));
+
+  for (i = 0; i < (int) ARRAY_SIZE(threads); i++)
+    ASSERT_EQ(0, uv_thread_join(threads + i));
+
+  ASSERT_EQ(0, uv_mutex_trylock(&mutex));
+  uv_mutex_unlock(&mutex);
+  uv_mutex_destroy(&mutex);
+
+  ASSERT_EQ(40000, counter);
+  return 0;
+}
+
+
 TEST_IMPL(thread_rwlock) {
   uv_rwlock_t rwlock;
   int r;
@@ -0,0 +1,98 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+static uv_netif_t netif;
+static uv_timer_t timer;
+static int close_cb_called;
+
+
+static void netif_cb(uv_netif_t* handle,
+                     int events,
+                     const uv_interface_address_t* address,
+                     int status) {
+  /* Changes made by other processes may race with the test, they must be
+   * well formed, that's all.
+   */
+  ASSERT_PTR_EQ(handle, &netif);
+  if (status == 0) {
+    ASSERT_NOT_NULL(address);
+    ASSERT_NOT_NULL(address->name);
+    ASSERT_NE(0, events);
+  } else {
+    ASSERT_EQ(UV_ENOBUFS, status);
+  }
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  ASSERT(uv_is_active((uv_handle_t*) &netif));
+  uv_close((uv_handle_t*) &netif, close_cb);
+  uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+TEST_IMPL(netif_basic) {
+  uv_loop_t* loop;
+  int r;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, strcmp("netif", uv_handle_type_name(UV_NETIF)));
+  ASSERT_EQ(0, uv_netif_init(loop, &netif));
+
+  r = uv_netif_start(&netif, netif_cb);
+#ifdef __linux__
+  if (r == UV_EAFNOSUPPORT || r == UV_EPERM || r == UV_EACCES)
+    RETURN_SKIP("Netlink sockets are not available.");
+  ASSERT_EQ(0, r);
+#else
+  ASSERT_EQ(UV_ENOSYS, r);
+  uv_close((uv_handle_t*) &netif, close_cb);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, close_cb_called);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+
+  ASSERT_EQ(UV_EINVAL, uv_netif_start(&netif, netif_cb));
+  ASSERT(uv_is_active((uv_handle_t*) &netif));
+  ASSERT_EQ(0, uv_netif_stop(&netif));
+  ASSERT_EQ(0, uv_is_active((uv_handle_t*) &netif));
+  ASSERT_EQ(0, uv_netif_stop(&netif));
+  ASSERT_EQ(0, uv_netif_start(&netif, netif_cb));
+
+  ASSERT_EQ(0, uv_timer_init(loop, &timer));
+  ASSERT_EQ(0, uv_timer_start(&timer, timer_cb, 10, 0));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
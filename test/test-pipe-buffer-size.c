@@ -0,0 +1,181 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#ifndef _WIN32
+
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define DATA_SIZE (256 * 1024)
+
+static uv_pipe_t reader;
+static uv_pipe_t writer;
+static uv_write_t write_req;
+static char data[DATA_SIZE];
+static char buffer[64 * 1024];
+static size_t nread_total;
+static int write_cb_called;
+static int close_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  buf->base = buffer;
+  buf->len = sizeof(buffer);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+  write_cb_called++;
+  uv_close((uv_handle_t*) req->handle, close_cb);
+}
+
+
+static void read_cb(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf) {
+  if (nread == UV_EOF) {
+    uv_close((uv_handle_t*) handle, close_cb);
+    return;
+  }
+
+  ASSERT_GE(nread, 0);
+  ASSERT_LE(nread_total + nread, DATA_SIZE);
+  ASSERT_EQ(0, memcmp(data + nread_total, buf->base, nread));
+  nread_total += nread;
+}
+
+
+static void vmsplice_write(uv_loop_t* loop, uv_os_fd_t fds[2]) {
+  uv_buf_t buf;
+
+  nread_total = 0;
+  write_cb_called = 0;
+  close_cb_called = 0;
+
+  ASSERT_EQ(0, uv_pipe_init(loop, &reader, 0));
+  ASSERT_EQ(0, uv_pipe_open(&reader, fds[0]));
+  ASSERT_EQ(0, uv_pipe_init_ex(loop, &writer, UV_PIPE_VMSPLICE));
+  ASSERT_EQ(0, uv_pipe_open(&writer, fds[1]));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &reader, alloc_cb, read_cb));
+
+  /* More than the pipe holds, so it goes out in several parts. */
+  buf = uv_buf_init(data, sizeof(data));
+  ASSERT_EQ(0, uv_write(&write_req, (uv_stream_t*) &writer, &buf, 1,
+                        write_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, write_cb_called);
+  ASSERT_EQ(2, close_cb_called);
+  ASSERT_EQ(DATA_SIZE, nread_total);
+}
+
+#endif  /* !_WIN32 */
+
+
+TEST_IMPL(pipe_buffer_size) {
+#if defined(_WIN32)
+  RETURN_SKIP("Pipe buffers are fixed on Windows.");
+#else
+  uv_os_sock_t socks[2];
+  uv_os_fd_t fds[2];
+  uv_loop_t* loop;
+  int value;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_pipe_init(loop, &writer, 0));
+  value = 0;
+  ASSERT_EQ(UV_EBADF, uv_pipe_buffer_size(&writer, &value));
+  value = -1;
+  ASSERT_EQ(UV_EINVAL, uv_pipe_buffer_size(&writer, &value));
+
+#if defined(__linux__)
+  ASSERT_EQ(0, uv_pipe(fds, 0, 0));
+  ASSERT_EQ(0, uv_pipe_open(&writer, fds[1]));
+  value = 0;
+  ASSERT_EQ(0, uv_pipe_buffer_size(&writer, &value));
+  ASSERT_GT(value, 0);
+
+  /* Rounded up to a power of two number of pages. */
+  value = 200 * 1024;
+  ASSERT_EQ(0, uv_pipe_buffer_size(&writer, &value));
+  ASSERT_GE(value, 200 * 1024);
+  ASSERT_EQ(0, value & (value - 1));
+  value = 0;
+  ASSERT_EQ(0, uv_pipe_buffer_size(&writer, &value));
+  ASSERT_GE(value, 200 * 1024);
+
+  uv_close((uv_handle_t*) &writer, NULL);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, close(fds[0]));
+  ASSERT_EQ(0, uv_pipe_init(loop, &writer, 0));
+#endif
+
+  /* Socket pairs, as uv_spawn() makes for stdio, get socket buffers. */
+  ASSERT_EQ(0, uv_socketpair(SOCK_STREAM, 0, socks, 0, 0));
+  ASSERT_EQ(0, uv_pipe_open(&writer, socks[0]));
+  value = 256 * 1024;
+  ASSERT_EQ(0, uv_pipe_buffer_size(&writer, &value));
+  value = 0;
+  ASSERT_EQ(0, uv_pipe_buffer_size(&writer, &value));
+  ASSERT_GE(value, 256 * 1024);
+
+  uv_close((uv_handle_t*) &writer, NULL);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, close(socks[1]));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+TEST_IMPL(pipe_vmsplice) {
+#if defined(_WIN32)
+  RETURN_SKIP("UV_PIPE_VMSPLICE is not supported on Windows.");
+#else
+  uv_os_sock_t socks[2];
+  uv_os_fd_t fds[2];
+  uv_loop_t* loop;
+  size_t i;
+
+  for (i = 0; i < sizeof(data); i++)
+    data[i] = (char) (i * 31 + i / 4096);
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_pipe(fds, UV_NONBLOCK_PIPE, UV_NONBLOCK_PIPE));
+  vmsplice_write(loop, fds);
+
+  /* Not a pipe, falls back to plain writes. */
+  ASSERT_EQ(0, uv_socketpair(SOCK_STREAM, 0, socks, 0, 0));
+  vmsplice_write(loop, socks);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
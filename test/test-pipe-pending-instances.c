@@ -57,3 +57,74 @@ TEST_IMPL(pipe_pending_instances) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+#define NUM_CLIENTS 12
+
+static uv_pipe_t server_handle;
+static uv_pipe_t clients[NUM_CLIENTS];
+static uv_pipe_t accepted[NUM_CLIENTS];
+static uv_connect_t connect_reqs[NUM_CLIENTS];
+static int connection_cb_called;
+static int connect_cb_called;
+
+
+static void adaptive_connection_cb(uv_stream_t* server, int status) {
+  uv_pipe_t* conn;
+
+  ASSERT_EQ(0, status);
+  ASSERT_LT(connection_cb_called, NUM_CLIENTS);
+  conn = &accepted[connection_cb_called++];
+  ASSERT_EQ(0, uv_pipe_init(server->loop, conn, 0));
+  ASSERT_EQ(0, uv_accept(server, (uv_stream_t*) conn));
+  uv_close((uv_handle_t*) conn, NULL);
+
+  if (connection_cb_called == NUM_CLIENTS)
+    uv_close((uv_handle_t*) server, NULL);
+}
+
+
+static void adaptive_connect_cb(uv_connect_t* req, int status) {
+  ASSERT_EQ(0, status);
+  connect_cb_called++;
+  uv_close((uv_handle_t*) req->handle, NULL);
+}
+
+
+TEST_IMPL(pipe_set_pending_instances) {
+  uv_loop_t* loop;
+  int i;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_pipe_init(loop, &server_handle, 0));
+
+  ASSERT_EQ(UV_EINVAL, uv_pipe_set_pending_instances(&server_handle, 0, 4));
+  ASSERT_EQ(UV_EINVAL, uv_pipe_set_pending_instances(&server_handle, 4, 2));
+  ASSERT_EQ(UV_EINVAL,
+            uv_pipe_set_pending_instances(&server_handle, 1, 1 << 20));
+  ASSERT_EQ(0, uv_pipe_set_pending_instances(&server_handle, 1, 8));
+
+  ASSERT_EQ(0, uv_pipe_bind(&server_handle, TEST_PIPENAME));
+#ifdef _WIN32
+  ASSERT_EQ(UV_EBUSY, uv_pipe_set_pending_instances(&server_handle, 1, 8));
+#endif
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server_handle,
+                         NUM_CLIENTS,
+                         adaptive_connection_cb));
+
+  /* More clients than the server starts out with instances for. */
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    ASSERT_EQ(0, uv_pipe_init(loop, &clients[i], 0));
+    uv_pipe_connect(&connect_reqs[i],
+                    &clients[i],
+                    TEST_PIPENAME,
+                    adaptive_connect_cb);
+  }
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_CLIENTS, connect_cb_called);
+  ASSERT_EQ(NUM_CLIENTS, connection_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
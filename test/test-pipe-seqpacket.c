@@ -0,0 +1,237 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#ifndef _WIN32
+
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uv_pipe_t server;
+static uv_pipe_t client;
+static uv_pipe_t conn;
+static uv_connect_t connect_req;
+static uv_write_t write_reqs[2];
+static char buffer[64 * 1024];
+static int messages;
+static int write_cb_called;
+static int close_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  buf->base = buffer;
+  buf->len = sizeof(buffer);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+  write_cb_called++;
+}
+
+
+static void read_cb(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf) {
+  if (nread == 0)
+    return;
+
+  if (nread == UV_EOF) {
+    ASSERT_EQ(2, messages);
+    uv_close((uv_handle_t*) handle, close_cb);
+    uv_close((uv_handle_t*) &server, close_cb);
+    return;
+  }
+
+  /* Queued back to back, but each write is a message of its own. */
+  messages++;
+  if (messages == 1) {
+    ASSERT_EQ(1, nread);
+    ASSERT_MEM_EQ("A", buf->base, 1);
+  } else {
+    ASSERT_EQ(2, messages);
+    ASSERT_EQ(3, nread);
+    ASSERT_MEM_EQ("BCD", buf->base, 3);
+  }
+}
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, uv_pipe_init(handle->loop, &conn, 0));
+  ASSERT_EQ(0, uv_accept(handle, (uv_stream_t*) &conn));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &conn, alloc_cb, read_cb));
+}
+
+
+static void seqpacket_write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+  if (++write_cb_called == 2)
+    uv_close((uv_handle_t*) req->handle, close_cb);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT_EQ(0, status);
+}
+
+#endif  /* !_WIN32 */
+
+
+TEST_IMPL(pipe_seqpacket) {
+#if defined(_WIN32) || defined(__APPLE__)
+  RETURN_SKIP("No SOCK_SEQPACKET Unix domain sockets on this platform.");
+#else
+  uv_loop_t* loop;
+  uv_buf_t buf;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(UV_EINVAL, uv_pipe_init_ex(loop, &server, 8));
+  ASSERT_EQ(0, uv_pipe_init_ex(loop, &server, UV_PIPE_SEQPACKET));
+  ASSERT_EQ(0, uv_pipe_bind(&server, TEST_PIPENAME));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 1, connection_cb));
+
+  ASSERT_EQ(0, uv_pipe_init_ex(loop, &client, UV_PIPE_SEQPACKET));
+  uv_pipe_connect(&connect_req, &client, TEST_PIPENAME, connect_cb);
+
+  /* Still connecting, so these end up in the write queue together. */
+  buf = uv_buf_init("A", 1);
+  ASSERT_EQ(0, uv_write(write_reqs + 0, (uv_stream_t*) &client, &buf, 1,
+                        seqpacket_write_cb));
+  buf = uv_buf_init("BCD", 3);
+  ASSERT_EQ(0, uv_write(write_reqs + 1, (uv_stream_t*) &client, &buf, 1,
+                        seqpacket_write_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, messages);
+  ASSERT_EQ(3, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+#ifndef _WIN32
+
+static uv_os_fd_t sent_fds[3];
+static int accepted;
+
+
+static void fds_read_cb(uv_stream_t* handle,
+                        ssize_t nread,
+                        const uv_buf_t* buf) {
+  uv_os_fd_t fds[3];
+  struct stat a;
+  struct stat b;
+  int i;
+
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(1, nread);
+  ASSERT_EQ(3, uv_pipe_pending_count((uv_pipe_t*) handle));
+
+  /* In two goes, the rest stays queued in between. */
+  ASSERT_EQ(2, uv_pipe_accept_fds((uv_pipe_t*) handle, fds, 2));
+  ASSERT_EQ(1, uv_pipe_pending_count((uv_pipe_t*) handle));
+  ASSERT_EQ(1, uv_pipe_accept_fds((uv_pipe_t*) handle, fds + 2, 2));
+  ASSERT_EQ(0, uv_pipe_pending_count((uv_pipe_t*) handle));
+  ASSERT_EQ(0, uv_pipe_accept_fds((uv_pipe_t*) handle, fds, 3));
+
+  for (i = 0; i < 3; i++) {
+    ASSERT_NE(sent_fds[i], fds[i]);
+    ASSERT_EQ(0, fstat(sent_fds[i], &a));
+    ASSERT_EQ(0, fstat(fds[i], &b));
+    ASSERT_EQ(a.st_dev, b.st_dev);
+    ASSERT_EQ(a.st_ino, b.st_ino);
+    ASSERT_EQ(0, close(fds[i]));
+  }
+
+  accepted = 1;
+  uv_close((uv_handle_t*) handle, close_cb);
+  uv_close((uv_handle_t*) &client, close_cb);
+}
+
+#endif  /* !_WIN32 */
+
+
+TEST_IMPL(pipe_write_fds) {
+#if defined(_WIN32)
+  RETURN_SKIP("uv_write_fds() is not supported on Windows.");
+#else
+  uv_os_sock_t socks[2];
+  uv_os_fd_t bad_fd;
+  uv_file extra[2];
+  uv_loop_t* loop;
+  uv_buf_t buf;
+  int i;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_pipe(sent_fds, 0, 0));
+  ASSERT_EQ(0, uv_pipe(extra, 0, 0));
+  sent_fds[2] = extra[0];
+
+#if defined(__APPLE__)
+  ASSERT_EQ(0, uv_socketpair(SOCK_STREAM, 0, socks, 0, 0));
+#else
+  ASSERT_EQ(0, uv_socketpair(SOCK_SEQPACKET, 0, socks, 0, 0));
+#endif
+  ASSERT_EQ(0, uv_pipe_init_ex(loop, &client, UV_PIPE_IPC));
+  ASSERT_EQ(0, uv_pipe_open(&client, socks[0]));
+  ASSERT_EQ(0, uv_pipe_init_ex(loop, &conn, UV_PIPE_IPC));
+  ASSERT_EQ(0, uv_pipe_open(&conn, socks[1]));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &conn, alloc_cb, fds_read_cb));
+
+  buf = uv_buf_init("X", 1);
+  ASSERT_EQ(UV_EINVAL, uv_write_fds(write_reqs, (uv_stream_t*) &client,
+                                    &buf, 1, sent_fds, 0, write_cb));
+  bad_fd = -1;
+  ASSERT_EQ(UV_EBADF, uv_write_fds(write_reqs, (uv_stream_t*) &client,
+                                   &buf, 1, &bad_fd, 1, write_cb));
+  buf = uv_buf_init("", 0);
+  ASSERT_EQ(UV_EINVAL, uv_write_fds(write_reqs, (uv_stream_t*) &client,
+                                    &buf, 1, sent_fds, 3, write_cb));
+
+  buf = uv_buf_init("X", 1);
+  ASSERT_EQ(0, uv_write_fds(write_reqs, (uv_stream_t*) &client,
+                            &buf, 1, sent_fds, 3, write_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, accepted);
+  ASSERT_EQ(1, write_cb_called);
+  ASSERT_EQ(2, close_cb_called);
+
+  for (i = 0; i < 3; i++)
+    ASSERT_EQ(0, close(sent_fds[i]));
+  ASSERT_EQ(0, close(extra[1]));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
@@ -24,6 +24,7 @@
 #ifdef _WIN32
 # include <fcntl.h>
 #else
+# include <sys/resource.h>
 # include <sys/socket.h>
 # include <unistd.h>
 #endif
@@ -652,6 +653,67 @@ TEST_IMPL(poll_bad_fdtype) {
 }
 
 
+#ifndef _WIN32
+static void high_fd_poll_cb(uv_poll_t* handle, int status, int events) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(UV_READABLE, events);
+  uv_close((uv_handle_t*) handle, NULL);
+  (*(int*) handle->data)++;
+}
+#endif
+
+
+/* A watcher on a file descriptor far above the others, the watcher table
+ * grows to cover it.
+ */
+TEST_IMPL(poll_high_fd) {
+#ifdef _WIN32
+  RETURN_SKIP("Test does not currently work in _WIN32");
+#else
+  uv_poll_t low_handle;
+  uv_poll_t high_handle;
+  struct rlimit lim;
+  int low_called;
+  int high_called;
+  int fds[2];
+  int high_fd;
+
+  ASSERT_EQ(0, getrlimit(RLIMIT_NOFILE, &lim));
+  if (lim.rlim_max != RLIM_INFINITY && lim.rlim_max < 4096)
+    RETURN_SKIP("RLIMIT_NOFILE is too low.");
+  if (lim.rlim_cur != RLIM_INFINITY && lim.rlim_cur < 4096) {
+    lim.rlim_cur = 4096;
+    ASSERT_EQ(0, setrlimit(RLIMIT_NOFILE, &lim));
+  }
+
+  ASSERT_EQ(0, pipe(fds));
+  high_fd = dup2(fds[0], 4000);
+  ASSERT_EQ(4000, high_fd);
+
+  low_called = 0;
+  high_called = 0;
+  low_handle.data = &low_called;
+  high_handle.data = &high_called;
+  ASSERT_EQ(0, uv_poll_init(uv_default_loop(), &low_handle, fds[0]));
+  ASSERT_EQ(0, uv_poll_init(uv_default_loop(), &high_handle, high_fd));
+  ASSERT_EQ(0, uv_poll_start(&low_handle, UV_READABLE, high_fd_poll_cb));
+  ASSERT_EQ(0, uv_poll_start(&high_handle, UV_READABLE, high_fd_poll_cb));
+
+  ASSERT_EQ(1, write(fds[1], "x", 1));
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(1, low_called);
+  ASSERT_EQ(1, high_called);
+
+  ASSERT_EQ(0, close(high_fd));
+  ASSERT_EQ(0, close(fds[0]));
+  ASSERT_EQ(0, close(fds[1]));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
 #ifdef __linux__
 TEST_IMPL(poll_nested_epoll) {
   uv_poll_t poll_handle;
@@ -92,3 +92,43 @@ TEST_IMPL(random_sync) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+TEST_IMPL(random_fast) {
+  uv_random_t req;
+  char zero[256];
+  char big[4096];
+  char a[16];
+  char b[16];
+  int i;
+
+  ASSERT_EQ(UV_EINVAL, uv_random(NULL, NULL, a, sizeof(a), 2, NULL));
+
+  ASSERT_EQ(0, uv_random(NULL, NULL, a, sizeof(a), UV_RANDOM_FAST, NULL));
+  ASSERT_EQ(0, uv_random(NULL, NULL, b, sizeof(b), UV_RANDOM_FAST, NULL));
+  ASSERT(0 != memcmp(a, b, sizeof(a)));
+
+  /* Crosses several refills of the buffer. */
+  memset(zero, 0, sizeof(zero));
+  for (i = 0; i < 64; i++) {
+    memset(big, 0, sizeof(big));
+    ASSERT_EQ(0, uv_random(NULL, NULL, big, sizeof(big), UV_RANDOM_FAST,
+                           NULL));
+    ASSERT(0 != memcmp(big + sizeof(big) - sizeof(zero), zero, sizeof(zero)));
+  }
+
+  memset(scratch, 0, sizeof(scratch));
+  ASSERT_EQ(0, uv_random(uv_default_loop(), &req, scratch, 0, UV_RANDOM_FAST,
+                         random_cb));
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(1, random_cb_called);
+
+  ASSERT_EQ(0, uv_random(uv_default_loop(), &req, scratch, sizeof(scratch),
+                         UV_RANDOM_FAST, random_cb));
+  ASSERT_EQ(1, random_cb_called);
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(2, random_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
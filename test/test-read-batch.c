@@ -0,0 +1,123 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define NUM_PIPES 3
+
+static const char* messages[NUM_PIPES] = { "one", "two", "three" };
+static uv_pipe_t readers[NUM_PIPES];
+static uv_pipe_t writers[NUM_PIPES];
+static uv_write_t write_reqs[NUM_PIPES];
+static char buffers[NUM_PIPES][64];
+static size_t first_batch_size;
+static int batch_cb_called;
+static int data_read;
+static int eof_read;
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  buf->base = buffers[(uv_pipe_t*) handle - readers];
+  buf->len = sizeof(buffers[0]);
+}
+
+
+static void batch_cb(uv_loop_t* loop,
+                     uv_read_result_t* results,
+                     size_t nresults) {
+  size_t i;
+  int n;
+
+  ASSERT_PTR_EQ(uv_default_loop(), loop);
+  ASSERT_GT(nresults, 0);
+  if (batch_cb_called++ == 0)
+    first_batch_size = nresults;
+
+  for (i = 0; i < nresults; i++) {
+    n = (int) ((uv_pipe_t*) results[i].stream - readers);
+    ASSERT_GE(n, 0);
+    ASSERT_LT(n, NUM_PIPES);
+
+    if (results[i].nread == UV_EOF) {
+      eof_read++;
+      uv_close((uv_handle_t*) results[i].stream, NULL);
+      continue;
+    }
+
+    ASSERT_GE(results[i].nread, 0);
+    if (results[i].nread == 0)
+      continue;
+
+    ASSERT_PTR_EQ(buffers[n], results[i].buf.base);
+    ASSERT_EQ(strlen(messages[n]), (size_t) results[i].nread);
+    ASSERT_MEM_EQ(messages[n], results[i].buf.base, results[i].nread);
+    uv_close((uv_handle_t*) &writers[n], NULL);
+    data_read++;
+  }
+}
+
+
+TEST_IMPL(read_batch) {
+  uv_file fds[2];
+  uv_buf_t buf;
+  int i;
+
+  for (i = 0; i < NUM_PIPES; i++) {
+    ASSERT_EQ(0, uv_pipe(fds, 0, 0));
+    ASSERT_EQ(0, uv_pipe_init(uv_default_loop(), &readers[i], 0));
+    ASSERT_EQ(0, uv_pipe_init(uv_default_loop(), &writers[i], 0));
+    ASSERT_EQ(0, uv_pipe_open(&readers[i], fds[0]));
+    ASSERT_EQ(0, uv_pipe_open(&writers[i], fds[1]));
+    ASSERT_EQ(0, uv_read_start((uv_stream_t*) &readers[i],
+                               alloc_cb,
+                               uv_read_batched_cb));
+
+    buf = uv_buf_init((char*) messages[i], strlen(messages[i]));
+    ASSERT_EQ(0, uv_write(&write_reqs[i],
+                          (uv_stream_t*) &writers[i],
+                          &buf,
+                          1,
+                          NULL));
+  }
+
+  /* The loop reads from the streams without a callback to go to until
+   * there is one.
+   */
+  ASSERT_EQ(1, uv_run(uv_default_loop(), UV_RUN_NOWAIT));
+  ASSERT_EQ(0, batch_cb_called);
+  uv_loop_set_read_batch_cb(uv_default_loop(), batch_cb);
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_PIPES, data_read);
+  ASSERT_EQ(NUM_PIPES, eof_read);
+#ifndef _WIN32
+  /* All three were ready at the same time. */
+  ASSERT_GE(first_batch_size, NUM_PIPES);
+#endif
+
+  uv_loop_set_read_batch_cb(uv_default_loop(), NULL);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
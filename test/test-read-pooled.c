@@ -0,0 +1,124 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+static uv_pipe_t reader;
+static uv_pipe_t writer;
+static uv_write_t write_req;
+static char* first_base;
+static int read_cb_called;
+static int eof_cb_called;
+static int huge_pages;
+
+
+static void write_message(const char* msg) {
+  uv_buf_t buf;
+
+  buf = uv_buf_init((char*) msg, strlen(msg));
+  ASSERT_EQ(0, uv_write(&write_req, (uv_stream_t*) &writer, &buf, 1, NULL));
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  if (nread == 0) {
+#ifndef _WIN32
+    ASSERT_NULL(buf->base);
+#endif
+    uv_read_buf_release(stream->loop, buf);
+    return;
+  }
+
+  if (nread == UV_EOF) {
+#ifndef _WIN32
+    ASSERT_NULL(buf->base);
+#endif
+    uv_read_buf_release(stream->loop, buf);
+    eof_cb_called++;
+    uv_close((uv_handle_t*) stream, NULL);
+    return;
+  }
+
+  ASSERT_EQ(4, nread);
+  ASSERT_GE(buf->len, 4);
+  read_cb_called++;
+
+  if (read_cb_called == 1) {
+    ASSERT_EQ(0, memcmp(buf->base, "PING", 4));
+    first_base = buf->base;
+    if (huge_pages) {
+      /* The first buffer of an arena. */
+      ASSERT_EQ(0, (uintptr_t) buf->base % (64 * 1024));
+      ASSERT_EQ(UV_EBUSY,
+                uv_loop_configure(stream->loop, UV_LOOP_HUGE_PAGES, -1));
+    }
+    uv_read_buf_release(stream->loop, buf);
+    write_message("PONG");
+  } else {
+    /* The released buffer is handed out again. */
+    ASSERT_EQ(0, memcmp(buf->base, "PONG", 4));
+    ASSERT_PTR_EQ(first_base, buf->base);
+    uv_read_buf_release(stream->loop, buf);
+    uv_close((uv_handle_t*) &writer, NULL);
+  }
+}
+
+
+static int read_pooled(void) {
+  uv_file fds[2];
+
+  ASSERT_EQ(0, uv_pipe(fds, 0, 0));
+  ASSERT_EQ(0, uv_pipe_init(uv_default_loop(), &reader, 0));
+  ASSERT_EQ(0, uv_pipe_init(uv_default_loop(), &writer, 0));
+  ASSERT_EQ(0, uv_pipe_open(&reader, fds[0]));
+  ASSERT_EQ(0, uv_pipe_open(&writer, fds[1]));
+
+  ASSERT_EQ(UV_EINVAL, uv_read_start_pooled((uv_stream_t*) &reader, NULL));
+  ASSERT_EQ(0, uv_read_start_pooled((uv_stream_t*) &reader, read_cb));
+  write_message("PING");
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(2, read_cb_called);
+  ASSERT_EQ(1, eof_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(read_pooled) {
+  return read_pooled();
+}
+
+
+TEST_IMPL(read_pooled_huge_pages) {
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(UV_EINVAL, uv_loop_configure(loop, UV_LOOP_HUGE_PAGES, -2));
+  ASSERT_EQ(0, uv_loop_configure(loop, UV_LOOP_HUGE_PAGES, -1));
+  huge_pages = 1;
+
+  return read_pooled();
+}
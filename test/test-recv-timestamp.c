@@ -0,0 +1,263 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+static uv_udp_t udp_server;
+static uv_udp_t udp_client;
+static uv_udp_send_t send_req;
+static uv_tcp_t tcp_server;
+static uv_tcp_t tcp_accepted;
+static uv_tcp_t tcp_client;
+static uv_connect_t connect_req;
+static uv_write_t write_req;
+static uv_timer_t ping_timer;
+static int tcp_pings;
+static int tcp_ready;
+static int recv_cb_called;
+static int close_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle,
+                     size_t suggested_size,
+                     uv_buf_t* buf) {
+  static char slab[65536];
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+/* Software timestamps are CLOCK_REALTIME, from before the callback. */
+static void check_timestamp(const uv_timespec_t* ts) {
+  uv_timeval64_t now;
+  int64_t ms;
+
+  ASSERT_EQ(0, uv_gettimeofday(&now));
+  ms = ((int64_t) now.tv_sec - ts->tv_sec) * 1000 +
+       (now.tv_usec / 1000 - ts->tv_nsec / 1000000);
+  ASSERT_GE(ms, -1);
+  ASSERT_LT(ms, 10000);
+}
+
+
+static void udp_recv_cb(uv_udp_t* handle,
+                        ssize_t nread,
+                        const uv_buf_t* buf,
+                        const struct sockaddr* addr,
+                        unsigned flags) {
+  struct sockaddr_storage dst;
+  uv_timespec_t ts;
+  int len;
+
+  ASSERT_GE(nread, 0);
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(4, nread);
+  ASSERT_EQ(0, memcmp(buf->base, "PING", 4));
+  ASSERT_EQ(0, uv_udp_get_recv_timestamp(handle, &ts));
+  check_timestamp(&ts);
+
+  len = sizeof(dst);
+  ASSERT_EQ(UV_EINVAL, uv_udp_get_recv_dstaddr(handle,
+                                               (struct sockaddr*) &dst,
+                                               &len));
+  recv_cb_called++;
+
+  uv_close((uv_handle_t*) &udp_server, close_cb);
+  uv_close((uv_handle_t*) &udp_client, close_cb);
+}
+
+
+static void send_cb(uv_udp_send_t* req, int status) {
+  ASSERT_EQ(0, status);
+}
+
+
+TEST_IMPL(udp_recv_timestamp) {
+  struct sockaddr_in addr;
+  uv_timespec_t ts;
+  uv_buf_t buf;
+  int err;
+
+  /* Through recvmmsg(), where every chunk gets its own. */
+  ASSERT_EQ(0, uv_udp_init_ex(uv_default_loop(),
+                              &udp_server,
+                              UV_UDP_RECVMMSG));
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  err = uv_udp_bind(&udp_server,
+                    (const struct sockaddr*) &addr,
+                    UV_UDP_TIMESTAMP);
+  if (err == UV_ENOTSUP) {
+    uv_close((uv_handle_t*) &udp_server, NULL);
+    ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("UV_UDP_TIMESTAMP is not supported on this platform");
+  }
+  ASSERT_EQ(0, err);
+
+  ASSERT_EQ(UV_ENOENT, uv_udp_get_recv_timestamp(&udp_server, &ts));
+  ASSERT_EQ(0, uv_udp_recv_start(&udp_server, alloc_cb, udp_recv_cb));
+
+  ASSERT_EQ(0, uv_udp_init(uv_default_loop(), &udp_client));
+  ASSERT_EQ(UV_EINVAL, uv_udp_get_recv_timestamp(&udp_client, &ts));
+  buf = uv_buf_init("PING", 4);
+  ASSERT_EQ(0, uv_udp_send(&send_req, &udp_client, &buf, 1,
+                           (const struct sockaddr*) &addr, send_cb));
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(1, recv_cb_called);
+  ASSERT_EQ(2, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+}
+
+
+static void send_ping(void) {
+  uv_buf_t buf;
+
+  tcp_pings++;
+  buf = uv_buf_init("PING", 4);
+  ASSERT_EQ(0, uv_write(&write_req,
+                        (uv_stream_t*) &tcp_client,
+                        &buf,
+                        1,
+                        write_cb));
+}
+
+
+static void ping_timer_cb(uv_timer_t* timer) {
+  send_ping();
+}
+
+
+static void tcp_read_cb(uv_stream_t* handle,
+                        ssize_t nread,
+                        const uv_buf_t* buf) {
+  uv_timespec_t ts;
+  int err;
+
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(4, nread);
+  ASSERT_EQ(0, memcmp(buf->base, "PING", 4));
+
+  /* The kernel switches timestamps on from a work queue, segments that
+   * come in before that have none. Try again a little later.
+   */
+  err = uv_tcp_get_read_timestamp((uv_tcp_t*) handle, &ts);
+  if (err == UV_ENOENT && tcp_pings < 100) {
+    ASSERT_EQ(0, uv_timer_start(&ping_timer, ping_timer_cb, 10, 0));
+    return;
+  }
+
+  ASSERT_EQ(0, err);
+  check_timestamp(&ts);
+  recv_cb_called++;
+
+  uv_close((uv_handle_t*) &tcp_server, close_cb);
+  uv_close((uv_handle_t*) &tcp_accepted, close_cb);
+  uv_close((uv_handle_t*) &tcp_client, close_cb);
+  uv_close((uv_handle_t*) &ping_timer, close_cb);
+}
+
+
+/* Only write once both sides are set up, a segment that arrives before the
+ * option is on comes without a timestamp.
+ */
+static void write_ping(void) {
+  if (++tcp_ready < 2)
+    return;
+
+  send_ping();
+}
+
+
+static void connection_cb(uv_stream_t* server, int status) {
+  uv_timespec_t ts;
+
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, uv_tcp_init(server->loop, &tcp_accepted));
+  ASSERT_EQ(0, uv_accept(server, (uv_stream_t*) &tcp_accepted));
+  ASSERT_EQ(UV_EINVAL, uv_tcp_get_read_timestamp(&tcp_accepted, &ts));
+  ASSERT_EQ(0, uv_tcp_recv_timestamps(&tcp_accepted, 1));
+  ASSERT_EQ(UV_ENOENT, uv_tcp_get_read_timestamp(&tcp_accepted, &ts));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &tcp_accepted,
+                             alloc_cb,
+                             tcp_read_cb));
+  write_ping();
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT_EQ(0, status);
+  write_ping();
+}
+
+
+TEST_IMPL(tcp_read_timestamp) {
+  struct sockaddr_in addr;
+  int err;
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_tcp_init(uv_default_loop(), &tcp_server));
+  ASSERT_EQ(UV_EBADF, uv_tcp_recv_timestamps(&tcp_server, 1));
+  ASSERT_EQ(0, uv_tcp_bind(&tcp_server, (const struct sockaddr*) &addr, 0));
+
+  err = uv_tcp_recv_timestamps(&tcp_server, 0);
+  if (err == UV_ENOSYS) {
+    uv_close((uv_handle_t*) &tcp_server, NULL);
+    ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("Receive timestamps are not supported on this platform");
+  }
+  ASSERT_EQ(0, err);
+
+  ASSERT_EQ(0, uv_timer_init(uv_default_loop(), &ping_timer));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &tcp_server, 1, connection_cb));
+  ASSERT_EQ(0, uv_tcp_init(uv_default_loop(), &tcp_client));
+  ASSERT_EQ(0, uv_tcp_connect(&connect_req,
+                              &tcp_client,
+                              (const struct sockaddr*) &addr,
+                              connect_cb));
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(1, recv_cb_called);
+  ASSERT_EQ(4, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,205 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+#include <stdlib.h>
+#include <string.h>
+
+static unsigned int mallocs;
+static unsigned int write_cb_called;
+static unsigned int stat_cb_called;
+static unsigned int close_cb_called;
+static uv_loop_t* loop;
+
+
+static void* counting_malloc(size_t size) {
+  mallocs++;
+  return malloc(size);
+}
+
+
+static void stat_cb(uv_fs_t* req) {
+  ASSERT_EQ(0, req->result);
+  uv_fs_req_cleanup(req);
+  uv_req_free(req->loop, req);
+  stat_cb_called++;
+}
+
+
+TEST_IMPL(req_alloc) {
+  uv_write_t* w1;
+  uv_write_t* w2;
+  uv_fs_t* req;
+
+  loop = uv_default_loop();
+  ASSERT_NULL(uv_req_alloc(loop, UV_UNKNOWN_REQ));
+  ASSERT_NULL(uv_req_alloc(loop, UV_REQ_TYPE_MAX));
+
+  w1 = uv_req_alloc(loop, UV_WRITE);
+  ASSERT_NOT_NULL(w1);
+  ASSERT_EQ(UV_WRITE, w1->type);
+  ASSERT_NULL(w1->data);
+  w1->data = w1;
+  uv_req_free(loop, w1);
+
+  /* The free list hands back the last request that was put on it. */
+  w2 = uv_req_alloc(loop, UV_WRITE);
+  ASSERT_PTR_EQ(w1, w2);
+  ASSERT_NULL(w2->data);
+  uv_req_free(loop, w2);
+  uv_req_free(loop, NULL);
+
+  req = uv_req_alloc(loop, UV_FS);
+  ASSERT_NOT_NULL(req);
+  ASSERT_EQ(0, uv_fs_stat(loop, req, ".", stat_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, stat_cb_called);
+
+  /* Pending free lists don't keep the loop from closing. */
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+  uv_req_free(req->handle->loop, req);
+  write_cb_called++;
+}
+
+
+static void write_bufs(uv_pipe_t* pipe) {
+  uv_write_t* req;
+  uv_buf_t bufs[16];
+  unsigned int i;
+
+  for (i = 0; i < ARRAY_SIZE(bufs); i++)
+    bufs[i] = uv_buf_init("x", 1);
+
+  req = uv_req_alloc(loop, UV_WRITE);
+  ASSERT_NOT_NULL(req);
+  ASSERT_EQ(0, uv_write(req,
+                        (uv_stream_t*) pipe,
+                        bufs,
+                        ARRAY_SIZE(bufs),
+                        write_cb));
+}
+
+
+TEST_IMPL(req_alloc_bufs) {
+#ifdef _WIN32
+  RETURN_SKIP("Windows doesn't copy the uv_buf_t array.");
+#else
+  uv_pipe_t pipe;
+  uv_file fds[2];
+  unsigned int n;
+  char buf[64];
+
+  ASSERT_EQ(0, uv_replace_allocator(counting_malloc, realloc, calloc, free));
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_pipe(fds, 0, 0));
+  ASSERT_EQ(0, uv_pipe_init(loop, &pipe, 0));
+  ASSERT_EQ(0, uv_pipe_open(&pipe, fds[1]));
+
+  /* The first write allocates the request and the copy of the array. */
+  write_bufs(&pipe);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, write_cb_called);
+
+  /* The second one takes both from the free lists of the loop. */
+  n = mallocs;
+  write_bufs(&pipe);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, write_cb_called);
+  ASSERT_EQ(n, mallocs);
+
+  ASSERT_EQ(32, read(fds[0], buf, sizeof(buf)));
+
+  uv_close((uv_handle_t*) &pipe, NULL);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, close(fds[0]));
+
+  MAKE_VALGRIND_HAPPY();
+  ASSERT_EQ(0, uv_replace_allocator(malloc, realloc, calloc, free));
+  return 0;
+#endif
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  /* Still intact, it goes back on the free list after this returns. */
+  ASSERT_EQ(UV_TCP, handle->type);
+  ASSERT_PTR_EQ(handle, handle->data);
+  close_cb_called++;
+}
+
+
+TEST_IMPL(handle_alloc) {
+  uv_handle_pool_stats_t stats;
+  uv_tcp_t* t1;
+  uv_tcp_t* t2;
+
+  loop = uv_default_loop();
+  ASSERT_NULL(uv_handle_alloc(loop, UV_UNKNOWN_HANDLE));
+  ASSERT_NULL(uv_handle_alloc(loop, UV_HANDLE_TYPE_MAX));
+  /* Needs more than the loop to initialize. */
+  ASSERT_NULL(uv_handle_alloc(loop, UV_TTY));
+  ASSERT_EQ(UV_EINVAL, uv_metrics_handle_pool(loop, UV_HANDLE_TYPE_MAX,
+                                              &stats));
+
+  t1 = uv_handle_alloc(loop, UV_TCP);
+  ASSERT_NOT_NULL(t1);
+  ASSERT_EQ(UV_TCP, t1->type);
+  ASSERT_NULL(t1->data);
+  ASSERT_EQ(0, uv_is_active((uv_handle_t*) t1));
+  ASSERT_EQ(0, uv_metrics_handle_pool(loop, UV_TCP, &stats));
+  ASSERT_EQ(1, stats.allocated);
+  ASSERT_EQ(0, stats.reused);
+  ASSERT_EQ(1, stats.in_use);
+  ASSERT_EQ(0, stats.free);
+
+  t1->data = t1;
+  uv_close((uv_handle_t*) t1, close_cb);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, close_cb_called);
+  ASSERT_EQ(0, uv_metrics_handle_pool(loop, UV_TCP, &stats));
+  ASSERT_EQ(0, stats.in_use);
+  ASSERT_EQ(1, stats.free);
+
+  /* Recycled and initialized again. */
+  t2 = uv_handle_alloc(loop, UV_TCP);
+  ASSERT_PTR_EQ(t1, t2);
+  ASSERT_NULL(t2->data);
+  ASSERT_EQ(0, uv_is_closing((uv_handle_t*) t2));
+  ASSERT_EQ(0, uv_metrics_handle_pool(loop, UV_TCP, &stats));
+  ASSERT_EQ(2, stats.allocated);
+  ASSERT_EQ(1, stats.reused);
+  ASSERT_EQ(1, stats.in_use);
+  ASSERT_EQ(0, stats.free);
+
+  uv_close((uv_handle_t*) t2, NULL);
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+
+  /* The free lists go with the loop. */
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
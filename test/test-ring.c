@@ -0,0 +1,196 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdint.h>
+
+#define NUM_PRODUCERS 4
+#define NUM_ITEMS 10000
+
+static uv_spsc_ring_t spsc;
+static uv_mpmc_ring_t mpmc;
+static uv_async_t async;
+static uv_thread_t producers[NUM_PRODUCERS];
+static unsigned int next_item[NUM_PRODUCERS];
+static unsigned int num_popped;
+static int num_producers;
+
+
+/* Items are (producer << 16 | sequence number) + 1, so none is NULL. */
+static void* make_item(int producer, unsigned int seq) {
+  return (void*) (uintptr_t) ((producer << 16 | seq) + 1);
+}
+
+
+static void check_item(void* item) {
+  uintptr_t val;
+  int producer;
+
+  val = (uintptr_t) item - 1;
+  producer = (int) (val >> 16);
+  ASSERT_GE(producer, 0);
+  ASSERT_LT(producer, num_producers);
+  /* Items of one producer come out in the order they went in. */
+  ASSERT_EQ(next_item[producer], (unsigned int) (val & 0xFFFF));
+  next_item[producer]++;
+  num_popped++;
+}
+
+
+static void join_producers(void) {
+  int i;
+
+  for (i = 0; i < num_producers; i++)
+    ASSERT_EQ(0, uv_thread_join(producers + i));
+}
+
+
+static void spsc_producer(void* arg) {
+  unsigned int i;
+
+  for (i = 0; i < NUM_ITEMS; i++)
+    while (uv_spsc_ring_push(&spsc, make_item(0, i)) == UV_ENOBUFS)
+      uv_sleep(1);
+}
+
+
+static void spsc_async_cb(uv_async_t* handle) {
+  void* item;
+
+  while (0 == uv_spsc_ring_pop(&spsc, &item))
+    check_item(item);
+
+  if (num_popped == NUM_ITEMS) {
+    join_producers();
+    uv_close((uv_handle_t*) handle, NULL);
+  }
+}
+
+
+static void mpmc_producer(void* arg) {
+  unsigned int i;
+  int producer;
+
+  producer = (int) (intptr_t) arg;
+  for (i = 0; i < NUM_ITEMS; i++)
+    while (uv_mpmc_ring_push(&mpmc, make_item(producer, i)) == UV_ENOBUFS)
+      uv_sleep(1);
+}
+
+
+static void mpmc_async_cb(uv_async_t* handle) {
+  void* item;
+
+  while (0 == uv_mpmc_ring_pop(&mpmc, &item))
+    check_item(item);
+
+  if (num_popped == NUM_PRODUCERS * NUM_ITEMS) {
+    join_producers();
+    uv_close((uv_handle_t*) handle, NULL);
+  }
+}
+
+
+TEST_IMPL(ring_basic) {
+  void* item;
+  unsigned int i;
+  unsigned int j;
+
+  ASSERT_EQ(UV_EINVAL, uv_spsc_ring_init(&spsc, 0, NULL));
+  ASSERT_EQ(UV_EINVAL, uv_mpmc_ring_init(&mpmc, 0, NULL));
+
+  /* Rounded up to a power of two. */
+  ASSERT_EQ(0, uv_spsc_ring_init(&spsc, 5, NULL));
+  ASSERT_EQ(8, uv_spsc_ring_capacity(&spsc));
+  ASSERT_EQ(0, uv_mpmc_ring_init(&mpmc, 5, NULL));
+  ASSERT_EQ(8, uv_mpmc_ring_capacity(&mpmc));
+
+  /* Go round a few times so the positions wrap the slots. */
+  for (i = 0; i < 3 * 8; i++) {
+    ASSERT_EQ(0, uv_spsc_ring_push(&spsc, make_item(0, i)));
+    ASSERT_EQ(0, uv_mpmc_ring_push(&mpmc, make_item(0, i)));
+    if (i % 8 != 7)
+      continue;
+
+    ASSERT_EQ(UV_ENOBUFS, uv_spsc_ring_push(&spsc, NULL));
+    ASSERT_EQ(UV_ENOBUFS, uv_mpmc_ring_push(&mpmc, NULL));
+
+    for (j = i - 7; 0 == uv_spsc_ring_pop(&spsc, &item); j++)
+      ASSERT_PTR_EQ(make_item(0, j), item);
+    ASSERT_EQ(i + 1, j);
+    ASSERT_EQ(UV_EAGAIN, uv_spsc_ring_pop(&spsc, &item));
+
+    for (j = i - 7; 0 == uv_mpmc_ring_pop(&mpmc, &item); j++)
+      ASSERT_PTR_EQ(make_item(0, j), item);
+    ASSERT_EQ(i + 1, j);
+    ASSERT_EQ(UV_EAGAIN, uv_mpmc_ring_pop(&mpmc, &item));
+  }
+
+  uv_spsc_ring_destroy(&spsc);
+  uv_mpmc_ring_destroy(&mpmc);
+  return 0;
+}
+
+
+TEST_IMPL(spsc_ring_async) {
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  num_producers = 1;
+  ASSERT_EQ(0, uv_async_init(loop, &async, spsc_async_cb));
+  /* Small enough that the producer runs into a full ring. */
+  ASSERT_EQ(0, uv_spsc_ring_init(&spsc, 64, &async));
+  ASSERT_EQ(0, uv_thread_create(producers, spsc_producer, NULL));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_ITEMS, num_popped);
+  ASSERT_EQ(NUM_ITEMS, next_item[0]);
+
+  uv_spsc_ring_destroy(&spsc);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(mpmc_ring_async) {
+  uv_loop_t* loop;
+  int i;
+
+  loop = uv_default_loop();
+  num_producers = NUM_PRODUCERS;
+  ASSERT_EQ(0, uv_async_init(loop, &async, mpmc_async_cb));
+  ASSERT_EQ(0, uv_mpmc_ring_init(&mpmc, 64, &async));
+  for (i = 0; i < NUM_PRODUCERS; i++)
+    ASSERT_EQ(0, uv_thread_create(producers + i,
+                                  mpmc_producer,
+                                  (void*) (intptr_t) i));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_PRODUCERS * NUM_ITEMS, num_popped);
+  for (i = 0; i < NUM_PRODUCERS; i++)
+    ASSERT_EQ(NUM_ITEMS, next_item[i]);
+
+  uv_mpmc_ring_destroy(&mpmc);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,191 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#if defined(__linux__)
+
+#include <string.h>
+#include <sys/socket.h>
+
+#define NUM_MESSAGES 2000
+
+static uv_shm_channel_t creator;
+static uv_shm_channel_t peer;
+static uv_pipe_t ipc_out;
+static uv_pipe_t ipc_in;
+static uv_write_t write_req;
+static char buffer[16];
+static unsigned int num_sent;
+static unsigned int num_received;
+static int writable_cb_called;
+static int done_received;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  buf->base = buffer;
+  buf->len = sizeof(buffer);
+}
+
+
+/* Odd sizes, so records get padded and wrap around the end of the ring. */
+static size_t make_message(unsigned int seq, char* msg) {
+  size_t len;
+
+  len = 20 + seq % 180;
+  memset(msg, (int) (seq & 0xFF), len);
+  memcpy(msg, &seq, sizeof(seq));
+  return len;
+}
+
+
+static void send_messages(uv_shm_channel_t* channel) {
+  uv_buf_t bufs[2];
+  char msg[256];
+  size_t len;
+  int r;
+
+  while (num_sent < NUM_MESSAGES) {
+    len = make_message(num_sent, msg);
+    /* Two parts, one message. */
+    bufs[0] = uv_buf_init(msg, 8);
+    bufs[1] = uv_buf_init(msg + 8, len - 8);
+    r = uv_shm_channel_send(channel, bufs, 2);
+    if (r == UV_ENOBUFS)
+      return;  /* Until writable_cb. */
+
+    ASSERT_EQ(0, r);
+    num_sent++;
+  }
+}
+
+
+static void writable_cb(uv_shm_channel_t* channel) {
+  writable_cb_called++;
+  send_messages(channel);
+}
+
+
+static void creator_recv_cb(uv_shm_channel_t* channel, const uv_buf_t* msg) {
+  ASSERT_EQ(4, msg->len);
+  ASSERT_MEM_EQ("done", msg->base, 4);
+  ASSERT_EQ(NUM_MESSAGES, num_sent);
+  done_received++;
+  uv_shm_channel_close(channel, close_cb);
+}
+
+
+static void peer_recv_cb(uv_shm_channel_t* channel, const uv_buf_t* msg) {
+  char expected[256];
+  uv_buf_t buf;
+  size_t len;
+
+  ASSERT_LT(num_received, NUM_MESSAGES);
+  len = make_message(num_received, expected);
+  ASSERT_EQ(len, msg->len);
+  ASSERT_MEM_EQ(expected, msg->base, len);
+  num_received++;
+
+  if (num_received < NUM_MESSAGES)
+    return;
+
+  buf = uv_buf_init("done", 4);
+  ASSERT_EQ(0, uv_shm_channel_send(channel, &buf, 1));
+  uv_shm_channel_close(channel, close_cb);
+}
+
+
+static void ipc_read_cb(uv_stream_t* handle,
+                        ssize_t nread,
+                        const uv_buf_t* buf) {
+  uv_os_fd_t fds[3];
+
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(1, nread);
+  ASSERT_EQ(3, uv_pipe_accept_fds((uv_pipe_t*) handle, fds, 3));
+  ASSERT_EQ(0, uv_shm_channel_open(handle->loop, &peer, fds, peer_recv_cb));
+
+  uv_close((uv_handle_t*) handle, close_cb);
+  uv_close((uv_handle_t*) &ipc_out, close_cb);
+}
+
+
+static void ipc_write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+}
+
+#endif  /* defined(__linux__) */
+
+
+TEST_IMPL(shm_channel) {
+#if !defined(__linux__)
+  RETURN_SKIP("Shared memory channels are only supported on Linux.");
+#else
+  uv_os_sock_t socks[2];
+  uv_os_fd_t fds[3];
+  uv_loop_t* loop;
+  char big[4096];
+  uv_buf_t buf;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_shm_channel_init(loop, &creator, 4096, creator_recv_cb));
+  creator.writable_cb = writable_cb;
+
+  buf = uv_buf_init(big, sizeof(big));
+  ASSERT_EQ(UV_EINVAL, uv_shm_channel_send(&creator, &buf, 1));
+
+  /* Hand the memfd and the eventfds over an IPC pipe. */
+  ASSERT_EQ(0, uv_shm_channel_fds(&creator, fds));
+  ASSERT_EQ(0, uv_socketpair(SOCK_SEQPACKET, 0, socks, 0, 0));
+  ASSERT_EQ(0, uv_pipe_init_ex(loop, &ipc_out, UV_PIPE_IPC));
+  ASSERT_EQ(0, uv_pipe_open(&ipc_out, socks[0]));
+  ASSERT_EQ(0, uv_pipe_init_ex(loop, &ipc_in, UV_PIPE_IPC));
+  ASSERT_EQ(0, uv_pipe_open(&ipc_in, socks[1]));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &ipc_in, alloc_cb, ipc_read_cb));
+
+  buf = uv_buf_init("X", 1);
+  ASSERT_EQ(0, uv_write_fds(&write_req, (uv_stream_t*) &ipc_out,
+                            &buf, 1, fds, 3, ipc_write_cb));
+
+  /* The first ones go out before the peer is there, until the ring fills. */
+  send_messages(&creator);
+  ASSERT_LT(num_sent, NUM_MESSAGES);
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_MESSAGES, num_sent);
+  ASSERT_EQ(NUM_MESSAGES, num_received);
+  ASSERT_GT(writable_cb_called, 0);
+  ASSERT_EQ(1, done_received);
+  ASSERT_EQ(4, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
@@ -210,6 +210,48 @@ TEST_IMPL(we_get_signals) {
   return 0;
 }
 
+TEST_IMPL(we_get_signals_blocked) {
+#if defined(__linux__)
+  struct signal_ctx sc[4];
+  struct timer_ctx tc[2];
+  sigset_t saved_mask;
+  sigset_t mask;
+  uv_loop_t* loop;
+  unsigned int i;
+
+  /* Blocked signals are read from a signalfd. */
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGUSR1);
+  sigaddset(&mask, SIGUSR2);
+  ASSERT(0 == pthread_sigmask(SIG_BLOCK, &mask, &saved_mask));
+
+  loop = uv_default_loop();
+  start_watcher(loop, SIGUSR1, sc + 0, 0);
+  start_watcher(loop, SIGUSR1, sc + 1, 0);
+  start_watcher(loop, SIGUSR2, sc + 2, 0);
+  start_watcher(loop, SIGUSR2, sc + 3, 1);
+  start_timer(loop, SIGUSR1, tc + 0);
+  start_timer(loop, SIGUSR2, tc + 1);
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(sc[0].ncalls == NSIGNALS);
+  ASSERT(sc[1].ncalls == NSIGNALS);
+  ASSERT(sc[2].ncalls == NSIGNALS);
+  ASSERT(sc[3].ncalls == 1);
+
+  for (i = 0; i < ARRAY_SIZE(tc); i++)
+    ASSERT(tc[i].ncalls == NSIGNALS);
+
+  ASSERT(0 == pthread_sigmask(SIG_SETMASK, &saved_mask, NULL));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#else
+  RETURN_SKIP("signalfd is Linux only");
+#endif
+}
+
+
 TEST_IMPL(we_get_signal_one_shot) {
   struct signal_ctx sc;
   struct timer_ctx tc;
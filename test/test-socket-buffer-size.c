@@ -75,3 +75,54 @@ TEST_IMPL(socket_buffer_size) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static void check_pacing_rate(uv_handle_t* handle) {
+  uint64_t value;
+  int r;
+
+  value = 0;
+  r = uv_pacing_rate(handle, &value);
+  if (r == UV_ENOTSUP || r == UV_ENOSYS)
+    return;
+  ASSERT(r == 0);
+  ASSERT(value > 0);
+
+  value = 1000 * 1000;
+  ASSERT(0 == uv_pacing_rate(handle, &value));
+
+  value = 0;
+  ASSERT(0 == uv_pacing_rate(handle, &value));
+  ASSERT(value == 1000 * 1000);
+
+  /* No limit. */
+  value = (uint64_t) -1;
+  ASSERT(0 == uv_pacing_rate(handle, &value));
+}
+
+
+TEST_IMPL(socket_pacing_rate) {
+  struct sockaddr_in addr;
+  uint64_t value;
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+
+  ASSERT(0 == uv_tcp_init(uv_default_loop(), &tcp));
+  value = 0;
+  ASSERT(uv_pacing_rate((uv_handle_t*) &tcp, &value) < 0);
+  ASSERT(0 == uv_tcp_bind(&tcp, (struct sockaddr*) &addr, 0));
+  check_pacing_rate((uv_handle_t*) &tcp);
+  uv_close((uv_handle_t*) &tcp, close_cb);
+
+  ASSERT(0 == uv_udp_init(uv_default_loop(), &udp));
+  ASSERT(0 == uv_udp_bind(&udp, (struct sockaddr*) &addr, 0));
+  check_pacing_rate((uv_handle_t*) &udp);
+  uv_close((uv_handle_t*) &udp, close_cb);
+
+  ASSERT(0 == uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT(close_cb_called == 2);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -155,7 +155,9 @@ static void write_null_cb(uv_write_t* req, int status) {
 
 static void init_process_options(char* test, uv_exit_cb exit_cb) {
   /* Note spawn_helper1 defined in test/run-tests.c */
-  int r = uv_exepath(exepath, &exepath_size);
+  int r;
+  exepath_size = sizeof(exepath);
+  r = uv_exepath(exepath, &exepath_size);
   ASSERT(r == 0);
   exepath[exepath_size] = '\0';
   args[0] = exepath;
@@ -226,6 +228,64 @@ TEST_IMPL(spawn_fails_check_for_waitpid_cleanup) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+TEST_IMPL(spawn_server) {
+  uv_stdio_container_t stdio[2];
+  uv_pipe_t out;
+  int r;
+
+  ASSERT(0 == uv_spawn_server_start());
+  ASSERT(UV_EBUSY == uv_spawn_server_start());
+
+  /* Exit status. */
+  init_process_options("spawn_helper1", exit_cb);
+  ASSERT(0 == uv_spawn(uv_default_loop(), &process, &options));
+  ASSERT(0 == uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT(exit_cb_called == 1);
+  ASSERT(close_cb_called == 1);
+
+  /* Stdio is passed on. */
+  init_process_options("spawn_helper2", exit_cb);
+  ASSERT(0 == uv_pipe_init(uv_default_loop(), &out, 0));
+  options.stdio = stdio;
+  options.stdio[0].flags = UV_IGNORE;
+  options.stdio[1].flags = UV_CREATE_PIPE | UV_WRITABLE_PIPE;
+  options.stdio[1].data.stream = (uv_stream_t*) &out;
+  options.stdio_count = 2;
+  ASSERT(0 == uv_spawn(uv_default_loop(), &process, &options));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &out, on_alloc, on_read));
+  ASSERT(0 == uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT(exit_cb_called == 2);
+  ASSERT(close_cb_called == 3);
+  ASSERT(0 == strcmp("hello world\n", output));
+
+  /* Exec errors. */
+  init_process_options("", fail_cb);
+  options.stdio = NULL;
+  options.stdio_count = 0;
+  options.file = options.args[0] = "program-that-had-better-not-exist";
+  r = uv_spawn(uv_default_loop(), &process, &options);
+  ASSERT(r == UV_ENOENT || r == UV_EACCES);
+  ASSERT(0 == uv_is_active((uv_handle_t*) &process));
+  uv_close((uv_handle_t*) &process, NULL);
+  ASSERT(0 == uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  /* Signals. */
+  init_process_options("spawn_helper4", kill_cb);
+  ASSERT(0 == uv_spawn(uv_default_loop(), &process, &options));
+  ASSERT(0 == uv_timer_init(uv_default_loop(), &timer));
+  ASSERT(0 == uv_timer_start(&timer, timer_cb, 500, 0));
+  ASSERT(0 == uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT(exit_cb_called == 3);
+  ASSERT(close_cb_called == 5);
+
+  ASSERT(0 == uv_spawn_server_stop());
+  ASSERT(UV_EINVAL == uv_spawn_server_stop());
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
 #endif
 
 
@@ -277,6 +337,29 @@ TEST_IMPL(spawn_exit_code) {
 }
 
 
+TEST_IMPL(spawn_exit_code_many) {
+  uv_process_t processes[32];
+  unsigned i;
+  int r;
+
+  init_process_options("spawn_helper1", exit_cb);
+
+  for (i = 0; i < ARRAY_SIZE(processes); i++) {
+    r = uv_spawn(uv_default_loop(), &processes[i], &options);
+    ASSERT(r == 0);
+  }
+
+  r = uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+  ASSERT(r == 0);
+
+  ASSERT(exit_cb_called == ARRAY_SIZE(processes));
+  ASSERT(close_cb_called == ARRAY_SIZE(processes));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
 TEST_IMPL(spawn_stdout) {
   int r;
   uv_pipe_t out;
@@ -780,6 +863,86 @@ TEST_IMPL(spawn_and_kill) {
 }
 
 
+static uv_process_usage_t stats_usage[2];
+static int stats_cb_called;
+
+
+static void stats_cb(uv_process_stats_t* req, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_PTR_EQ(stats_usage, req->usage);
+  ASSERT_EQ(2, req->nusage);
+  ASSERT_EQ(0, stats_usage[0].status);
+  ASSERT_EQ(process.pid, stats_usage[0].pid);
+  ASSERT_GT(stats_usage[0].rss, 0);
+  ASSERT_GE(stats_usage[0].nthreads, 1);
+  ASSERT_EQ(UV_ESRCH, stats_usage[1].status);
+  stats_cb_called++;
+
+  ASSERT_EQ(0, uv_process_kill(&process, SIGTERM));
+}
+
+
+/* Give the child time to map its pages before looking at it again. */
+static void stats_timer_cb(uv_timer_t* handle) {
+  static uv_process_stats_t req;
+  uv_process_t* processes[2];
+  uv_process_t unspawned;
+
+  memset(&unspawned, 0, sizeof(unspawned));
+  processes[0] = &process;
+  processes[1] = &unspawned;
+
+  /* The callback kills the child. */
+  ASSERT_EQ(0, uv_process_get_stats_many(handle->loop, &req, processes,
+                                         stats_usage, 2, stats_cb));
+  uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+TEST_IMPL(spawn_process_stats) {
+  uv_process_t* processes[2];
+  uv_process_stats_t req;
+  uv_process_t unspawned;
+  int r;
+
+  memset(&unspawned, 0, sizeof(unspawned));
+  processes[0] = &process;
+  processes[1] = &unspawned;
+
+  r = uv_process_get_stats_many(uv_default_loop(), &req, processes + 1,
+                                stats_usage + 1, 1, NULL);
+  if (r == UV_ENOSYS)
+    RETURN_SKIP("Process stats are not supported on this platform.");
+  ASSERT_EQ(0, r);
+  ASSERT_EQ(UV_ESRCH, stats_usage[1].status);
+
+  init_process_options("spawn_helper4", kill_cb);
+  ASSERT_EQ(0, uv_spawn(uv_default_loop(), &process, &options));
+
+  ASSERT_EQ(0, uv_process_get_stats_many(uv_default_loop(), &req, processes,
+                                         stats_usage, 2, NULL));
+  ASSERT_EQ(0, stats_usage[0].status);
+  ASSERT_EQ(process.pid, stats_usage[0].pid);
+  ASSERT_GE(stats_usage[0].nthreads, 1);
+  ASSERT_EQ(UV_ESRCH, stats_usage[1].status);
+
+  ASSERT_EQ(0, uv_timer_init(uv_default_loop(), &timer));
+  ASSERT_EQ(0, uv_timer_start(&timer, stats_timer_cb, 250, 0));
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(1, stats_cb_called);
+  ASSERT_EQ(1, exit_cb_called);
+  ASSERT_EQ(2, close_cb_called);
+
+  /* Reaped, the handle doesn't stand for a process anymore. */
+  ASSERT_EQ(0, uv_process_get_stats_many(uv_default_loop(), &req, processes,
+                                         stats_usage, 1, NULL));
+  ASSERT_EQ(UV_ESRCH, stats_usage[0].status);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
 TEST_IMPL(spawn_preserve_env) {
   int r;
   uv_pipe_t out;
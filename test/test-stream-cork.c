@@ -0,0 +1,126 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define WRITE_COUNT 3
+
+static const char* chunks[WRITE_COUNT] = { "header,", "body,", "trailer" };
+static uv_pipe_t writer;
+static uv_pipe_t reader;
+static uv_write_t write_reqs[WRITE_COUNT];
+static char received[64];
+static size_t bytes_read;
+static int write_cb_called;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  *buf = uv_buf_init(received + bytes_read, sizeof(received) - bytes_read);
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ASSERT(nread >= 0);
+  bytes_read += nread;
+
+  if (bytes_read == strlen("header,body,trailer")) {
+    uv_close((uv_handle_t*) &reader, close_cb);
+    uv_close((uv_handle_t*) &writer, close_cb);
+  }
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+  ASSERT_PTR_EQ(req, &write_reqs[write_cb_called]);
+  write_cb_called++;
+}
+
+
+TEST_IMPL(stream_cork) {
+  uv_os_sock_t fds[2];
+  uv_loop_t* loop;
+  uv_buf_t buf;
+  size_t size;
+  int r;
+  int i;
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_socketpair(SOCK_STREAM, 0, fds, 0, 0));
+  ASSERT(0 == uv_pipe_init(loop, &writer, 0));
+  ASSERT(0 == uv_pipe_open(&writer, fds[0]));
+  ASSERT(0 == uv_pipe_init(loop, &reader, 0));
+  ASSERT(0 == uv_pipe_open(&reader, fds[1]));
+
+  r = uv_stream_cork((uv_stream_t*) &writer);
+  if (r == UV_ENOSYS) {
+    uv_close((uv_handle_t*) &reader, NULL);
+    uv_close((uv_handle_t*) &writer, NULL);
+    uv_run(loop, UV_RUN_DEFAULT);
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("uv_stream_cork() is not supported");
+  }
+  ASSERT(r == 0);
+
+  size = 0;
+  for (i = 0; i < WRITE_COUNT; i++) {
+    buf = uv_buf_init((char*) chunks[i], strlen(chunks[i]));
+    ASSERT(0 == uv_write(&write_reqs[i],
+                         (uv_stream_t*) &writer,
+                         &buf,
+                         1,
+                         write_cb));
+    size += buf.len;
+  }
+
+  /* Nothing goes out while corked, not even in the next loop iteration. */
+  ASSERT(writer.write_queue_size == size);
+  ASSERT(UV_EAGAIN == uv_try_write((uv_stream_t*) &writer, &buf, 1));
+  ASSERT(0 != uv_run(loop, UV_RUN_NOWAIT));  /* The requests are pending. */
+  ASSERT(writer.write_queue_size == size);
+  ASSERT(write_cb_called == 0);
+
+  /* All three requests are written at once. */
+  ASSERT(0 == uv_stream_uncork((uv_stream_t*) &writer));
+  ASSERT(writer.write_queue_size == 0);
+  ASSERT(0 == uv_stream_uncork((uv_stream_t*) &writer));
+
+  ASSERT(0 == uv_read_start((uv_stream_t*) &reader, alloc_cb, read_cb));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(write_cb_called == WRITE_COUNT);
+  ASSERT(close_cb_called == 2);
+  ASSERT(bytes_read == size);
+  ASSERT(0 == memcmp(received, "header,body,trailer", size));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
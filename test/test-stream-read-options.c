@@ -0,0 +1,115 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+static const char message[] = "0123456789abcdef";
+
+static uv_pipe_t reader;
+static uv_pipe_t writer;
+static uv_write_t write_req;
+static uv_prepare_t prepare;
+static char data[sizeof(message)];
+static char slab[4];
+static size_t bytes_read;
+static int iteration;
+static int last_read_iteration;
+
+
+static void prepare_cb(uv_prepare_t* handle) {
+  iteration++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) {
+  ASSERT_EQ(4, suggested_size);
+  *buf = uv_buf_init(slab, suggested_size);
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ASSERT_GE(nread, 0);
+  if (nread == 0)
+    return;
+
+  /* Reading stops for this loop iteration once max_bytes is reached. */
+  ASSERT_LE(nread, 4);
+  ASSERT_GT(iteration, last_read_iteration);
+  last_read_iteration = iteration;
+
+  memcpy(data + bytes_read, buf->base, nread);
+  bytes_read += nread;
+  if (bytes_read < sizeof(message) - 1)
+    return;
+
+  uv_close((uv_handle_t*) &reader, NULL);
+  uv_close((uv_handle_t*) &writer, NULL);
+  uv_close((uv_handle_t*) &prepare, NULL);
+}
+
+
+TEST_IMPL(stream_read_options) {
+  uv_stream_read_options_t options;
+  uv_file fds[2];
+  uv_buf_t buf;
+  int r;
+
+  ASSERT_EQ(0, uv_pipe(fds, 0, 0));
+  ASSERT_EQ(0, uv_pipe_init(uv_default_loop(), &reader, 0));
+  ASSERT_EQ(0, uv_pipe_init(uv_default_loop(), &writer, 0));
+  ASSERT_EQ(0, uv_pipe_open(&reader, fds[0]));
+  ASSERT_EQ(0, uv_pipe_open(&writer, fds[1]));
+
+  memset(&options, 0, sizeof(options));
+  r = uv_stream_set_read_options((uv_stream_t*) &reader, &options);
+  if (r == UV_ENOSYS)
+    RETURN_SKIP("Read options are not supported on this platform.");
+  ASSERT_EQ(UV_EINVAL, r);
+
+  options.min_size = 8;
+  options.max_size = 4;
+  ASSERT_EQ(UV_EINVAL,
+            uv_stream_set_read_options((uv_stream_t*) &reader, &options));
+
+  options.min_size = 4;
+  options.max_size = 4;
+  options.max_reads = 0;
+  options.max_bytes = 4;
+  ASSERT_EQ(0, uv_stream_set_read_options((uv_stream_t*) &reader, NULL));
+  ASSERT_EQ(0, uv_stream_set_read_options((uv_stream_t*) &reader, &options));
+
+  ASSERT_EQ(0, uv_prepare_init(uv_default_loop(), &prepare));
+  ASSERT_EQ(0, uv_prepare_start(&prepare, prepare_cb));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &reader, alloc_cb, read_cb));
+
+  buf = uv_buf_init((char*) message, sizeof(message) - 1);
+  ASSERT_EQ(0, uv_write(&write_req, (uv_stream_t*) &writer, &buf, 1, NULL));
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(sizeof(message) - 1, bytes_read);
+  ASSERT_EQ(0, memcmp(data, message, bytes_read));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,159 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MESSAGES 200
+#define HEADER_SIZE 8  /* "H%07d" */
+#define BODY_SIZE 100
+#define MESSAGE_SIZE (HEADER_SIZE + BODY_SIZE)
+
+static uv_pipe_t writer;
+static uv_pipe_t reader;
+static uv_write_t write_req;
+static char data[MESSAGES * MESSAGE_SIZE];
+static char header[HEADER_SIZE];
+static char body[BODY_SIZE];
+static const uv_buf_t* last_bufs;
+static size_t pos;  /* In the current message. */
+static int messages;
+static int scattered;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void make_message(int i, char* p) {
+  char hdr[HEADER_SIZE + 1];
+
+  snprintf(hdr, sizeof(hdr), "H%07d", i);
+  memcpy(p, hdr, HEADER_SIZE);
+  memset(p + HEADER_SIZE, 'a' + i % 26, BODY_SIZE);
+}
+
+
+/* The header and the body of a message go to separate buffers. */
+static void alloc_vec_cb(uv_handle_t* handle,
+                         size_t size,
+                         uv_buf_t bufs[],
+                         unsigned int* nbufs) {
+  ASSERT_GE(*nbufs, 1);
+
+  if (pos < HEADER_SIZE) {
+    bufs[0] = uv_buf_init(header + pos, HEADER_SIZE - pos);
+    if (*nbufs >= 2) {
+      bufs[1] = uv_buf_init(body, BODY_SIZE);
+      *nbufs = 2;
+    } else {
+      *nbufs = 1;
+    }
+  } else {
+    bufs[0] = uv_buf_init(body + pos - HEADER_SIZE, MESSAGE_SIZE - pos);
+    *nbufs = 1;
+  }
+
+  last_bufs = bufs;
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  char expected[MESSAGE_SIZE];
+
+  if (nread == 0)
+    return;
+
+  ASSERT_GT(nread, 0);
+  ASSERT_PTR_EQ(last_bufs, buf);
+  ASSERT_LE(pos + nread, MESSAGE_SIZE);
+
+  if (pos < HEADER_SIZE && pos + nread > HEADER_SIZE)
+    scattered++;
+
+  pos += nread;
+  if (pos < MESSAGE_SIZE)
+    return;
+
+  make_message(messages, expected);
+  ASSERT_MEM_EQ(expected, header, HEADER_SIZE);
+  ASSERT_MEM_EQ(expected + HEADER_SIZE, body, BODY_SIZE);
+  pos = 0;
+
+  if (++messages == MESSAGES) {
+    uv_close((uv_handle_t*) &reader, close_cb);
+    uv_close((uv_handle_t*) &writer, close_cb);
+  }
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+}
+
+
+TEST_IMPL(stream_read_vec) {
+  uv_os_sock_t fds[2];
+  uv_loop_t* loop;
+  uv_buf_t buf;
+  int i;
+
+  loop = uv_default_loop();
+
+  for (i = 0; i < MESSAGES; i++)
+    make_message(i, data + i * MESSAGE_SIZE);
+
+  ASSERT_EQ(0, uv_socketpair(SOCK_STREAM, 0, fds, 0, 0));
+  ASSERT_EQ(0, uv_pipe_init(loop, &writer, 0));
+  ASSERT_EQ(0, uv_pipe_open(&writer, fds[0]));
+  ASSERT_EQ(0, uv_pipe_init(loop, &reader, 0));
+  ASSERT_EQ(0, uv_pipe_open(&reader, fds[1]));
+
+  ASSERT_EQ(UV_EINVAL, uv_read_start_vec((uv_stream_t*) &reader,
+                                         NULL,
+                                         read_cb));
+  ASSERT_EQ(0, uv_read_start_vec((uv_stream_t*) &reader,
+                                 alloc_vec_cb,
+                                 read_cb));
+  ASSERT_EQ(UV_EALREADY, uv_read_start_vec((uv_stream_t*) &reader,
+                                           alloc_vec_cb,
+                                           read_cb));
+
+  buf = uv_buf_init(data, sizeof(data));
+  ASSERT_EQ(0, uv_write(&write_req, (uv_stream_t*) &writer, &buf, 1,
+                        write_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(MESSAGES, messages);
+  ASSERT_EQ(2, close_cb_called);
+#ifndef _WIN32
+  /* Everything is there at once, most reads fill both buffers. */
+  ASSERT_GT(scattered, 0);
+#endif
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
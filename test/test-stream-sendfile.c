@@ -0,0 +1,233 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+# include <unistd.h> /* unlink */
+#else
+# include <io.h>
+# define unlink _unlink
+#endif
+
+#define FILE_SIZE (256 * 1024)
+#define RANGE_OFFSET 1000
+#define RANGE_SIZE 200000
+#define TAIL_SIZE 100
+
+static const char file_name[] = "test_file_stream_sendfile";
+static const char header[] = "header";
+static const char trailer[] = "trailer";
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t incoming;
+static uv_connect_t connect_req;
+static uv_write_t write_reqs[4];
+static char* file_data;
+static char* expected;
+static size_t expected_size;
+static char* received;
+static size_t bytes_read;
+static uv_file file;
+static int write_cb_called;
+static int close_cb_called;
+static int skipped;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  *buf = uv_buf_init(received + bytes_read, expected_size + 1 - bytes_read);
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  if (nread > 0) {
+    bytes_read += nread;
+    ASSERT(bytes_read <= expected_size);
+    return;
+  }
+
+  ASSERT(nread == UV_EOF);
+  uv_close((uv_handle_t*) stream, close_cb);
+  uv_close((uv_handle_t*) &server, close_cb);
+}
+
+
+static void shutdown_cb(uv_shutdown_t* req, int status) {
+  ASSERT(status == 0);
+  uv_close((uv_handle_t*) &client, close_cb);
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  static uv_shutdown_t shutdown_req;
+
+  /* Callbacks run in order, sendfile requests are queued like writes. */
+  ASSERT_PTR_EQ(req, &write_reqs[write_cb_called]);
+  write_cb_called++;
+
+  /* The last request asks for more than what is left of the file. */
+  if (req == &write_reqs[3]) {
+    ASSERT(status == UV_EOF);
+    ASSERT(0 == uv_shutdown(&shutdown_req,
+                            (uv_stream_t*) &client,
+                            shutdown_cb));
+  } else {
+    ASSERT(status == 0);
+  }
+}
+
+
+static void connection_cb(uv_stream_t* stream, int status) {
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(stream->loop, &incoming));
+  ASSERT(0 == uv_accept(stream, (uv_stream_t*) &incoming));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &incoming, alloc_cb, read_cb));
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_stream_t* stream;
+  uv_buf_t buf;
+  int r;
+
+  ASSERT(status == 0);
+  stream = (uv_stream_t*) &client;
+
+  buf = uv_buf_init((char*) header, sizeof(header) - 1);
+  ASSERT(0 == uv_write(&write_reqs[0], stream, &buf, 1, write_cb));
+
+  r = uv_stream_sendfile(&write_reqs[1],
+                         stream,
+                         file,
+                         RANGE_OFFSET,
+                         RANGE_SIZE,
+                         write_cb);
+  if (r == UV_ENOSYS) {
+    skipped = 1;
+    uv_close((uv_handle_t*) &client, close_cb);
+    uv_close((uv_handle_t*) &server, close_cb);
+    return;
+  }
+  ASSERT(r == 0);
+
+  buf = uv_buf_init((char*) trailer, sizeof(trailer) - 1);
+  ASSERT(0 == uv_write(&write_reqs[2], stream, &buf, 1, write_cb));
+
+  ASSERT(0 == uv_stream_sendfile(&write_reqs[3],
+                                 stream,
+                                 file,
+                                 FILE_SIZE - TAIL_SIZE,
+                                 10 * TAIL_SIZE,
+                                 write_cb));
+}
+
+
+TEST_IMPL(stream_sendfile) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  uv_fs_t req;
+  uv_buf_t buf;
+  char* p;
+  int i;
+
+  loop = uv_default_loop();
+
+  file_data = malloc(FILE_SIZE);
+  ASSERT_NOT_NULL(file_data);
+  for (i = 0; i < FILE_SIZE; i++)
+    file_data[i] = i % 251;
+
+  unlink(file_name);
+  ASSERT(0 <= uv_fs_open(NULL,
+                         &req,
+                         file_name,
+                         O_RDWR | O_CREAT | O_TRUNC,
+                         S_IWUSR | S_IRUSR,
+                         NULL));
+  file = req.result;
+  uv_fs_req_cleanup(&req);
+
+  buf = uv_buf_init(file_data, FILE_SIZE);
+  ASSERT(FILE_SIZE == uv_fs_write(NULL, &req, file, &buf, 1, 0, NULL));
+  uv_fs_req_cleanup(&req);
+
+  /* What the server should see. */
+  expected_size = sizeof(header) - 1 + RANGE_SIZE +
+                  sizeof(trailer) - 1 + TAIL_SIZE;
+  expected = malloc(expected_size);
+  received = malloc(expected_size + 1);
+  ASSERT_NOT_NULL(expected);
+  ASSERT_NOT_NULL(received);
+  p = expected;
+  memcpy(p, header, sizeof(header) - 1);
+  p += sizeof(header) - 1;
+  memcpy(p, file_data + RANGE_OFFSET, RANGE_SIZE);
+  p += RANGE_SIZE;
+  memcpy(p, trailer, sizeof(trailer) - 1);
+  p += sizeof(trailer) - 1;
+  memcpy(p, file_data + FILE_SIZE - TAIL_SIZE, TAIL_SIZE);
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 128, connection_cb));
+  ASSERT(0 == uv_tcp_init(loop, &client));
+  ASSERT(0 == uv_tcp_connect(&connect_req,
+                             &client,
+                             (const struct sockaddr*) &addr,
+                             connect_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(0 == uv_fs_close(NULL, &req, file, NULL));
+  uv_fs_req_cleanup(&req);
+  unlink(file_name);
+
+  if (!skipped) {
+    ASSERT(write_cb_called == 4);
+    ASSERT(close_cb_called == 3);
+    ASSERT(bytes_read == expected_size);
+    ASSERT(0 == memcmp(received, expected, expected_size));
+  }
+
+  free(file_data);
+  free(expected);
+  free(received);
+
+  if (skipped) {
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("uv_stream_sendfile() is not supported");
+  }
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,213 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WRITE_SIZE (1024 * 1024)
+#define WRITE_COUNT 4
+
+static uv_pipe_t writer;
+static uv_pipe_t src;
+static uv_tcp_t server;
+static uv_tcp_t dst;
+static uv_tcp_t incoming;
+static uv_connect_t connect_req;
+static uv_shutdown_t writer_shutdown_req;
+static uv_shutdown_t dst_shutdown_req;
+static uv_write_t write_reqs[WRITE_COUNT];
+static uv_splice_t splice_req;
+static char* write_data;
+static char read_data[64 * 1024];
+static size_t bytes_read;
+static int read_mismatch;
+static int splice_cb_called;
+static int close_cb_called;
+static int skipped;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  *buf = uv_buf_init(read_data, sizeof(read_data));
+}
+
+
+static void never_read_cb(uv_stream_t* stream,
+                          ssize_t nread,
+                          const uv_buf_t* buf) {
+  ASSERT(0 && "should not be called");
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ssize_t i;
+
+  if (nread > 0) {
+    for (i = 0; i < nread; i++)
+      if (buf->base[i] != write_data[(bytes_read + i) % WRITE_SIZE])
+        read_mismatch = 1;
+    bytes_read += nread;
+    return;
+  }
+
+  ASSERT(nread == UV_EOF);
+  uv_close((uv_handle_t*) stream, close_cb);
+  uv_close((uv_handle_t*) &server, close_cb);
+  uv_close((uv_handle_t*) &dst, close_cb);
+  uv_close((uv_handle_t*) &src, close_cb);
+  uv_close((uv_handle_t*) &writer, close_cb);
+}
+
+
+static void shutdown_cb(uv_shutdown_t* req, int status) {
+  ASSERT(status == 0);
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+}
+
+
+static void splice_cb(uv_splice_t* req, int status) {
+  ASSERT_PTR_EQ(req, &splice_req);
+  ASSERT(status == 0);
+  ASSERT(req->nbytes == (uint64_t) WRITE_SIZE * WRITE_COUNT);
+  splice_cb_called++;
+
+  /* The request is done, src can be read from again. */
+  ASSERT(0 == uv_read_start((uv_stream_t*) &src, alloc_cb, never_read_cb));
+  ASSERT(0 == uv_read_stop((uv_stream_t*) &src));
+
+  ASSERT(0 == uv_shutdown(&dst_shutdown_req,
+                          (uv_stream_t*) &dst,
+                          shutdown_cb));
+}
+
+
+static void connection_cb(uv_stream_t* stream, int status) {
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(stream->loop, &incoming));
+  ASSERT(0 == uv_accept(stream, (uv_stream_t*) &incoming));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &incoming, alloc_cb, read_cb));
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_splice_t busy_req;
+  uv_buf_t buf;
+  int r;
+  int i;
+
+  ASSERT(status == 0);
+
+  r = uv_stream_splice(&splice_req,
+                       (uv_stream_t*) &src,
+                       (uv_stream_t*) &dst,
+                       splice_cb);
+  if (r == UV_ENOSYS) {
+    skipped = 1;
+    uv_close((uv_handle_t*) &server, close_cb);
+    uv_close((uv_handle_t*) &dst, close_cb);
+    uv_close((uv_handle_t*) &src, close_cb);
+    uv_close((uv_handle_t*) &writer, close_cb);
+    return;
+  }
+  ASSERT(r == 0);
+
+  ASSERT(UV_EBUSY == uv_stream_splice(&busy_req,
+                                      (uv_stream_t*) &src,
+                                      (uv_stream_t*) &writer,
+                                      splice_cb));
+  ASSERT(UV_EBUSY == uv_read_start((uv_stream_t*) &src,
+                                   alloc_cb,
+                                   never_read_cb));
+
+  buf = uv_buf_init(write_data, WRITE_SIZE);
+  for (i = 0; i < WRITE_COUNT; i++)
+    ASSERT(0 == uv_write(&write_reqs[i],
+                         (uv_stream_t*) &writer,
+                         &buf,
+                         1,
+                         write_cb));
+
+  ASSERT(0 == uv_shutdown(&writer_shutdown_req,
+                          (uv_stream_t*) &writer,
+                          shutdown_cb));
+}
+
+
+TEST_IMPL(stream_splice) {
+  struct sockaddr_in addr;
+  uv_os_sock_t fds[2];
+  uv_loop_t* loop;
+  int i;
+
+  loop = uv_default_loop();
+
+  /* A 251 byte pattern doesn't line up with any buffer size, so a misplaced
+   * chunk shows.
+   */
+  write_data = malloc(WRITE_SIZE);
+  ASSERT_NOT_NULL(write_data);
+  for (i = 0; i < WRITE_SIZE; i++)
+    write_data[i] = i % 251;
+
+  ASSERT(0 == uv_socketpair(SOCK_STREAM, 0, fds, 0, 0));
+  ASSERT(0 == uv_pipe_init(loop, &writer, 0));
+  ASSERT(0 == uv_pipe_open(&writer, fds[0]));
+  ASSERT(0 == uv_pipe_init(loop, &src, 0));
+  ASSERT(0 == uv_pipe_open(&src, fds[1]));
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 128, connection_cb));
+  ASSERT(0 == uv_tcp_init(loop, &dst));
+  ASSERT(0 == uv_tcp_connect(&connect_req,
+                             &dst,
+                             (const struct sockaddr*) &addr,
+                             connect_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  free(write_data);
+
+  if (skipped) {
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("uv_stream_splice() is not supported");
+  }
+
+  ASSERT(splice_cb_called == 1);
+  ASSERT(bytes_read == (size_t) WRITE_SIZE * WRITE_COUNT);
+  ASSERT(read_mismatch == 0);
+  ASSERT(close_cb_called == 5);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
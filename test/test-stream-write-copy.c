@@ -0,0 +1,145 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BIG_SIZE (4 * 1024 * 1024)
+#define MESSAGES 2000
+#define MESSAGE_SIZE 8  /* "msg%04d," */
+
+static uv_pipe_t writer;
+static uv_pipe_t reader;
+static uv_write_t big_req;
+static char* big_data;
+static char* received;
+static size_t expected_size;
+static size_t bytes_read;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  size = expected_size - bytes_read;
+  if (size > 65536)
+    size = 65536;
+  *buf = uv_buf_init(received + bytes_read, size);
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ASSERT(nread >= 0);
+  bytes_read += nread;
+  ASSERT(bytes_read <= expected_size);
+
+  if (bytes_read == expected_size) {
+    uv_close((uv_handle_t*) &reader, close_cb);
+    uv_close((uv_handle_t*) &writer, close_cb);
+  }
+}
+
+
+static void big_write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+}
+
+
+TEST_IMPL(stream_write_copy) {
+  uv_os_sock_t fds[2];
+  uv_loop_t* loop;
+  uv_buf_t bufs[2];
+  char message[MESSAGE_SIZE + 1];
+  char* p;
+  int i;
+
+  loop = uv_default_loop();
+
+  big_data = malloc(BIG_SIZE);
+  ASSERT_NOT_NULL(big_data);
+  memset(big_data, 'x', BIG_SIZE);
+
+  expected_size = 5 + BIG_SIZE + MESSAGES * MESSAGE_SIZE;
+  received = malloc(expected_size);
+  ASSERT_NOT_NULL(received);
+
+  ASSERT(0 == uv_socketpair(SOCK_STREAM, 0, fds, 0, 0));
+  ASSERT(0 == uv_pipe_init(loop, &writer, 0));
+  ASSERT(0 == uv_pipe_open(&writer, fds[0]));
+  ASSERT(0 == uv_pipe_init(loop, &reader, 0));
+  ASSERT(0 == uv_pipe_open(&reader, fds[1]));
+
+  bufs[0] = uv_buf_init(big_data, 16 * 1024 + 1);
+  ASSERT(UV_E2BIG == uv_write_copy((uv_stream_t*) &writer, bufs, 1));
+  ASSERT(UV_EINVAL == uv_write_copy((uv_stream_t*) &writer, bufs, 0));
+
+  /* With nothing queued it goes out right away. */
+  bufs[0] = uv_buf_init("fir", 3);
+  bufs[1] = uv_buf_init("st", 2);
+  ASSERT(0 == uv_write_copy((uv_stream_t*) &writer, bufs, 2));
+  ASSERT(writer.write_queue_size == 0);
+
+  /* Fill the socket buffer, the messages have to wait behind this one. */
+  bufs[0] = uv_buf_init(big_data, BIG_SIZE);
+  ASSERT(0 == uv_write(&big_req,
+                       (uv_stream_t*) &writer,
+                       bufs,
+                       1,
+                       big_write_cb));
+  ASSERT(writer.write_queue_size > 0);
+
+  for (i = 0; i < MESSAGES; i++) {
+    snprintf(message, sizeof(message), "msg%04d,", i);
+    bufs[0] = uv_buf_init(message, MESSAGE_SIZE);
+    ASSERT(0 == uv_write_copy((uv_stream_t*) &writer, bufs, 1));
+  }
+
+  /* The caller's buffer can be reused right away. */
+  memset(message, 0, sizeof(message));
+
+  ASSERT(0 == uv_read_start((uv_stream_t*) &reader, alloc_cb, read_cb));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(close_cb_called == 2);
+  ASSERT(bytes_read == expected_size);
+  ASSERT(0 == memcmp(received, "first", 5));
+  ASSERT(0 == memcmp(received + 5, big_data, BIG_SIZE));
+
+  p = received + 5 + BIG_SIZE;
+  for (i = 0; i < MESSAGES; i++) {
+    snprintf(message, sizeof(message), "msg%04d,", i);
+    ASSERT(0 == memcmp(p, message, MESSAGE_SIZE));
+    p += MESSAGE_SIZE;
+  }
+
+  free(big_data);
+  free(received);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,142 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define NUM_STREAMS 8
+#define PAYLOAD_SIZE (256 * 1024)
+
+struct reader {
+  uv_pipe_t handle;
+  size_t nread;
+};
+
+static uv_pipe_t writers[NUM_STREAMS];
+static struct reader readers[NUM_STREAMS];
+static uv_pipe_t unopened;
+static uv_shared_buf_t* payload;
+static char readbuf[65536];
+static unsigned int fanout_nfailed;
+static int fanout_cb_called;
+static int close_cb_called;
+static int done;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  *buf = uv_buf_init(readbuf, sizeof(readbuf));
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  struct reader* r;
+
+  r = container_of((uv_pipe_t*) stream, struct reader, handle);
+  ASSERT_GE(nread, 0);
+  ASSERT_LE(r->nread + nread, PAYLOAD_SIZE);
+  ASSERT_MEM_EQ(payload->buf.base + r->nread, buf->base, nread);
+  r->nread += nread;
+
+  if (r->nread == PAYLOAD_SIZE) {
+    uv_close((uv_handle_t*) stream, close_cb);
+    done++;
+  }
+}
+
+
+static void fanout_cb(uv_shared_buf_t* buf, unsigned int nfailed) {
+  int i;
+
+  ASSERT_PTR_EQ(payload, buf);
+  /* The caller's reference and the one released after the callback. */
+  ASSERT_EQ(2, buf->refcount);
+  fanout_nfailed = nfailed;
+  fanout_cb_called++;
+
+  for (i = 0; i < NUM_STREAMS; i++)
+    uv_close((uv_handle_t*) &writers[i], close_cb);
+  uv_close((uv_handle_t*) &unopened, close_cb);
+}
+
+
+TEST_IMPL(stream_write_fanout) {
+  uv_stream_t* handles[NUM_STREAMS + 1];
+  uv_os_sock_t fds[2];
+  uv_loop_t* loop;
+  size_t i;
+
+  loop = uv_default_loop();
+
+  payload = uv_shared_buf_new(PAYLOAD_SIZE);
+  ASSERT_NOT_NULL(payload);
+  ASSERT_EQ(PAYLOAD_SIZE, payload->buf.len);
+  ASSERT_EQ(1, payload->refcount);
+  for (i = 0; i < PAYLOAD_SIZE; i++)
+    payload->buf.base[i] = (char) (i % 251);
+
+  for (i = 0; i < NUM_STREAMS; i++) {
+    ASSERT_EQ(0, uv_socketpair(SOCK_STREAM, 0, fds, 0, 0));
+    ASSERT_EQ(0, uv_pipe_init(loop, &writers[i], 0));
+    ASSERT_EQ(0, uv_pipe_open(&writers[i], fds[0]));
+    ASSERT_EQ(0, uv_pipe_init(loop, &readers[i].handle, 0));
+    ASSERT_EQ(0, uv_pipe_open(&readers[i].handle, fds[1]));
+    handles[i] = (uv_stream_t*) &writers[i];
+  }
+
+  /* Fails, no callback, the caller keeps its reference. */
+  ASSERT_EQ(0, uv_pipe_init(loop, &unopened, 0));
+  handles[NUM_STREAMS] = (uv_stream_t*) &unopened;
+  ASSERT_EQ(UV_EINVAL, uv_write_fanout(handles, 0, payload, fanout_cb));
+  ASSERT_LT(uv_write_fanout(handles + NUM_STREAMS, 1, payload, fanout_cb), 0);
+  ASSERT_EQ(1, payload->refcount);
+
+  /* More than the socket buffers take, so the writes have to wait. */
+  ASSERT_EQ(0, uv_write_fanout(handles, NUM_STREAMS + 1, payload, fanout_cb));
+  ASSERT_EQ(2, payload->refcount);
+  ASSERT_EQ(0, fanout_cb_called);
+
+  for (i = 0; i < NUM_STREAMS; i++)
+    ASSERT_EQ(0, uv_read_start((uv_stream_t*) &readers[i].handle,
+                               alloc_cb,
+                               read_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, fanout_cb_called);
+  ASSERT_EQ(1, fanout_nfailed);
+  ASSERT_EQ(NUM_STREAMS, done);
+  ASSERT_EQ(2 * NUM_STREAMS + 1, close_cb_called);
+
+  ASSERT_EQ(1, payload->refcount);
+  ASSERT_PTR_EQ(payload, uv_shared_buf_ref(payload));
+  ASSERT_EQ(2, payload->refcount);
+  uv_shared_buf_unref(payload);
+  uv_shared_buf_unref(payload);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
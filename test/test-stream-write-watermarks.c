@@ -0,0 +1,146 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define CHUNK_SIZE (64 * 1024)
+#define MAX_WRITES 1024
+#define LOW_WATERMARK (2 * CHUNK_SIZE)
+#define HIGH_WATERMARK (8 * CHUNK_SIZE)
+
+static uv_pipe_t writer;
+static uv_pipe_t reader;
+static uv_write_t write_reqs[MAX_WRITES];
+static char chunk[CHUNK_SIZE];
+static char read_buf[CHUNK_SIZE];
+static int writes;
+static int write_cb_called;
+static int high_cb_called;
+static int low_cb_called;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  *buf = uv_buf_init(read_buf, sizeof(read_buf));
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ASSERT(nread >= 0);
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0 || status == UV_ECANCELED);
+  write_cb_called++;
+}
+
+
+static void watermark_cb(uv_stream_t* stream, int above) {
+  ASSERT_PTR_EQ(stream, (uv_stream_t*) &writer);
+
+  if (above) {
+    ASSERT(stream->write_queue_size >= HIGH_WATERMARK);
+    ASSERT(low_cb_called == 0);
+    high_cb_called++;
+    return;
+  }
+
+  ASSERT(stream->write_queue_size <= LOW_WATERMARK);
+  ASSERT(high_cb_called == 1);
+  low_cb_called++;
+
+  uv_close((uv_handle_t*) &writer, close_cb);
+  uv_close((uv_handle_t*) &reader, close_cb);
+}
+
+
+TEST_IMPL(stream_write_watermarks) {
+  uv_os_sock_t fds[2];
+  uv_loop_t* loop;
+  uv_buf_t buf;
+  int r;
+
+  loop = uv_default_loop();
+
+  ASSERT(0 == uv_socketpair(SOCK_STREAM, 0, fds, 0, 0));
+  ASSERT(0 == uv_pipe_init(loop, &writer, 0));
+  ASSERT(0 == uv_pipe_open(&writer, fds[0]));
+  ASSERT(0 == uv_pipe_init(loop, &reader, 0));
+  ASSERT(0 == uv_pipe_open(&reader, fds[1]));
+
+  r = uv_stream_set_write_watermarks((uv_stream_t*) &writer,
+                                     LOW_WATERMARK,
+                                     HIGH_WATERMARK,
+                                     watermark_cb);
+  if (r == UV_ENOSYS) {
+    uv_close((uv_handle_t*) &reader, NULL);
+    uv_close((uv_handle_t*) &writer, NULL);
+    uv_run(loop, UV_RUN_DEFAULT);
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("uv_stream_set_write_watermarks() is not supported");
+  }
+  ASSERT(r == 0);
+
+  ASSERT(UV_EINVAL == uv_stream_set_write_watermarks((uv_stream_t*) &writer,
+                                                     HIGH_WATERMARK,
+                                                     LOW_WATERMARK,
+                                                     watermark_cb));
+  ASSERT(UV_EINVAL == uv_stream_set_write_watermarks((uv_stream_t*) &writer,
+                                                     LOW_WATERMARK,
+                                                     HIGH_WATERMARK,
+                                                     NULL));
+
+  /* Nobody reads yet. Once the socket buffer is full the queue grows until
+   * the high watermark callback, which runs from within uv_write(), says
+   * to stop.
+   */
+  buf = uv_buf_init(chunk, sizeof(chunk));
+  while (high_cb_called == 0) {
+    ASSERT(writes < MAX_WRITES);
+    ASSERT(0 == uv_write(&write_reqs[writes++],
+                         (uv_stream_t*) &writer,
+                         &buf,
+                         1,
+                         write_cb));
+  }
+
+  ASSERT(writer.write_queue_size >= HIGH_WATERMARK);
+  ASSERT(writer.write_queue_size < HIGH_WATERMARK + CHUNK_SIZE);
+
+  /* Draining the queue brings it below the low watermark. */
+  ASSERT(0 == uv_read_start((uv_stream_t*) &reader, alloc_cb, read_cb));
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT(high_cb_called == 1);
+  ASSERT(low_cb_called == 1);
+  ASSERT(write_cb_called == writes);
+  ASSERT(close_cb_called == 2);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
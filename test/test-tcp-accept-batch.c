@@ -0,0 +1,121 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_CLIENTS 5
+
+static uv_tcp_t server;
+static uv_tcp_t clients[NUM_CLIENTS];
+static uv_tcp_t incoming[NUM_CLIENTS];
+static uv_connect_t connect_reqs[NUM_CLIENTS];
+static int connect_cb_called;
+static int connection_cb_called;
+static int accepted;
+static int initialized;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void connection_cb(uv_stream_t* stream, int status) {
+  ASSERT_EQ(0, status);
+  connection_cb_called++;
+
+  /* The whole batch is available from a single callback. */
+  while (accepted < NUM_CLIENTS) {
+    if (initialized == accepted)
+      ASSERT_EQ(0, uv_tcp_init(stream->loop, &incoming[initialized++]));
+    if (uv_accept(stream, (uv_stream_t*) &incoming[accepted]))
+      break;
+    accepted++;
+  }
+
+  ASSERT_EQ(UV_EAGAIN, uv_accept(stream, (uv_stream_t*) &incoming[0]));
+
+  if (accepted == NUM_CLIENTS)
+    uv_close((uv_handle_t*) stream, close_cb);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT_EQ(0, status);
+  connect_cb_called++;
+}
+
+
+TEST_IMPL(tcp_accept_batch) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  int err;
+  int i;
+
+#ifdef _WIN32
+  RETURN_SKIP("UV_LOOP_ACCEPT_BATCH is not supported on Windows");
+#endif
+
+  loop = uv_default_loop();
+  ASSERT_EQ(UV_EINVAL, uv_loop_configure(loop, UV_LOOP_ACCEPT_BATCH, 0u));
+  ASSERT_EQ(0, uv_loop_configure(loop, UV_LOOP_ACCEPT_BATCH, 16u));
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_tcp_init(loop, &server));
+  ASSERT_EQ(UV_EBADF, uv_tcp_set_incoming_cpu(&server, 0));
+  ASSERT_EQ(0, uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+
+  err = uv_tcp_set_incoming_cpu(&server, 0);
+  ASSERT(err == 0 || err == UV_ENOSYS);
+  if (err == 0)
+    ASSERT_EQ(UV_EINVAL, uv_tcp_set_incoming_cpu(&server, -1));
+
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 128, connection_cb));
+
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    ASSERT_EQ(0, uv_tcp_init(loop, &clients[i]));
+    ASSERT_EQ(0, uv_tcp_connect(&connect_reqs[i],
+                                &clients[i],
+                                (const struct sockaddr*) &addr,
+                                connect_cb));
+  }
+
+  while (accepted < NUM_CLIENTS || connect_cb_called < NUM_CLIENTS)
+    ASSERT(uv_run(loop, UV_RUN_ONCE) >= 0);
+
+  ASSERT_EQ(NUM_CLIENTS, accepted);
+  ASSERT_EQ(NUM_CLIENTS, connect_cb_called);
+  ASSERT(connection_cb_called >= 1);
+  ASSERT(connection_cb_called <= NUM_CLIENTS);
+
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    uv_close((uv_handle_t*) &clients[i], close_cb);
+    uv_close((uv_handle_t*) &incoming[i], close_cb);
+  }
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1 + 2 * NUM_CLIENTS, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,122 @@
+/* Copyright Joyent, Inc. and other Node contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_BUSY 10
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t conn;
+static uv_poll_t poll_handle;
+static uv_connect_t connect_req;
+static uv_file fds[2];
+static int poll_cb_called;
+static int connection_cb_called;
+static int connect_cb_called;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+/* Always writable, so each poll returns this besides the listener. */
+static void poll_cb(uv_poll_t* handle, int status, int events) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, connection_cb_called);
+
+  if (++poll_cb_called == NUM_BUSY)
+    uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(NUM_BUSY, poll_cb_called);
+  connection_cb_called++;
+
+  ASSERT_EQ(0, uv_tcp_init(handle->loop, &conn));
+  ASSERT_EQ(0, uv_accept(handle, (uv_stream_t*) &conn));
+  uv_close((uv_handle_t*) &conn, close_cb);
+  uv_close((uv_handle_t*) handle, close_cb);
+  uv_close((uv_handle_t*) &client, close_cb);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT_EQ(0, status);
+  connect_cb_called++;
+}
+
+
+TEST_IMPL(tcp_accept_policy) {
+  uv_stream_accept_policy_t policy;
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  uv_fs_t req;
+  int r;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_tcp_init(loop, &server));
+
+  policy.max_lag = 0;
+  policy.max_events = 1;
+  r = uv_stream_set_accept_policy((uv_stream_t*) &server, &policy);
+  if (r == UV_ENOSYS) {
+    uv_close((uv_handle_t*) &server, NULL);
+    ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("Accept policies are not supported on this platform.");
+  }
+  ASSERT_EQ(0, r);
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 1, connection_cb));
+
+  ASSERT_EQ(0, uv_pipe(fds, 0, 0));
+  ASSERT_EQ(0, uv_poll_init(loop, &poll_handle, fds[1]));
+  ASSERT_EQ(0, uv_poll_start(&poll_handle, UV_WRITABLE, poll_cb));
+
+  /* The connection waits in the backlog until the loop has less to do. */
+  ASSERT_EQ(0, uv_tcp_init(loop, &client));
+  ASSERT_EQ(0, uv_tcp_connect(&connect_req,
+                              &client,
+                              (const struct sockaddr*) &addr,
+                              connect_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_BUSY, poll_cb_called);
+  ASSERT_EQ(1, connection_cb_called);
+  ASSERT_EQ(1, connect_cb_called);
+  ASSERT_EQ(4, close_cb_called);
+
+  ASSERT_EQ(0, uv_fs_close(NULL, &req, fds[0], NULL));
+  uv_fs_req_cleanup(&req);
+  ASSERT_EQ(0, uv_fs_close(NULL, &req, fds[1], NULL));
+  uv_fs_req_cleanup(&req);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,204 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static uv_tcp_t server;
+static uv_tcp_t peer;
+static uv_tcp_t client;
+static uv_tcp_connect_host_t connect_req;
+static uv_write_t write_req;
+static int connect_cb_called;
+static int connection_cb_called;
+static int read_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  static char slab[64];
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  if (nread == 0)
+    return;
+
+  ASSERT(nread == 4);
+  ASSERT(0 == memcmp(buf->base, "PING", 4));
+  read_cb_called++;
+
+  uv_close((uv_handle_t*) &peer, NULL);
+  uv_close((uv_handle_t*) &server, NULL);
+  uv_close((uv_handle_t*) &client, NULL);
+}
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(handle->loop, &peer));
+  ASSERT(0 == uv_accept(handle, (uv_stream_t*) &peer));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &peer, alloc_cb, read_cb));
+  connection_cb_called++;
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+}
+
+
+static void connect_cb(uv_tcp_connect_host_t* req, int status) {
+  struct sockaddr_storage name;
+  uv_buf_t buf;
+  int namelen;
+
+  ASSERT(req == &connect_req);
+  ASSERT(req->handle == &client);
+  ASSERT(status == 0);
+  connect_cb_called++;
+
+  namelen = sizeof(name);
+  ASSERT(0 == uv_tcp_getpeername(&client, (struct sockaddr*) &name, &namelen));
+  ASSERT(name.ss_family == AF_INET);
+  ASSERT(ntohs(((struct sockaddr_in*) &name)->sin_port) == TEST_PORT);
+
+  /* The socket of the winning attempt now belongs to |client|. */
+  buf = uv_buf_init("PING", 4);
+  ASSERT(0 == uv_write(&write_req, (uv_stream_t*) &client, &buf, 1, write_cb));
+}
+
+
+static void connect_error_cb(uv_tcp_connect_host_t* req, int status) {
+  ASSERT(req == &connect_req);
+  ASSERT(req->handle == &client);
+  ASSERT(status == *(int*) req->data);
+  connect_cb_called++;
+  uv_close((uv_handle_t*) &client, NULL);
+}
+
+
+TEST_IMPL(tcp_connect_host) {
+  uv_tcp_connect_host_options_t options;
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  char port[16];
+  int r;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_tcp_init(loop, &client));
+  snprintf(port, sizeof(port), "%d", TEST_PORT);
+  memset(&options, 0, sizeof(options));
+  options.attempt_delay = 50;
+
+  /* The server only listens on IPv4, an IPv6 attempt for localhost fails
+   * and makes way for the IPv4 one.
+   */
+  r = uv_tcp_connect_host(&connect_req, &client, "localhost", port, &options,
+                          connect_cb);
+#ifdef _WIN32
+  ASSERT(r == UV_ENOSYS);
+  RETURN_SKIP("Not implemented on Windows");
+#endif
+  ASSERT(r == 0);
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 1, connection_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(1 == connect_cb_called);
+  ASSERT(1 == connection_cb_called);
+  ASSERT(1 == read_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(tcp_connect_host_refused) {
+  uv_loop_t* loop;
+  char port[16];
+  int expected;
+  int r;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_tcp_init(loop, &client));
+  snprintf(port, sizeof(port), "%d", TEST_PORT);
+  expected = UV_ECONNREFUSED;
+  connect_req.data = &expected;
+
+  r = uv_tcp_connect_host(&connect_req, &client, "127.0.0.1", port, NULL,
+                          connect_error_cb);
+#ifdef _WIN32
+  ASSERT(r == UV_ENOSYS);
+  RETURN_SKIP("Not implemented on Windows");
+#endif
+  ASSERT(r == 0);
+
+  ASSERT(UV_EINVAL == uv_tcp_connect_host(&connect_req, &client, NULL, port,
+                                          NULL, connect_error_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(1 == connect_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(tcp_connect_host_cancel) {
+  uv_loop_t* loop;
+  char port[16];
+  int expected;
+  int r;
+
+  loop = uv_default_loop();
+  ASSERT(0 == uv_tcp_init(loop, &client));
+  snprintf(port, sizeof(port), "%d", TEST_PORT);
+  expected = UV_ECANCELED;
+  connect_req.data = &expected;
+
+  r = uv_tcp_connect_host(&connect_req, &client, "localhost", port, NULL,
+                          connect_error_cb);
+#ifdef _WIN32
+  ASSERT(r == UV_ENOSYS);
+  RETURN_SKIP("Not implemented on Windows");
+#endif
+  ASSERT(r == 0);
+
+  /* The callback is deferred to the loop. */
+  ASSERT(0 == uv_tcp_connect_host_cancel(&connect_req));
+  ASSERT(0 == uv_tcp_connect_host_cancel(&connect_req));
+  ASSERT(0 == connect_cb_called);
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT(1 == connect_cb_called);
+  ASSERT(UV_EINVAL == uv_tcp_connect_host_cancel(&connect_req));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
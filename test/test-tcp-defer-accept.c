@@ -0,0 +1,122 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t incoming;
+static uv_connect_t connect_req;
+static uv_write_t write_req;
+static uv_timer_t timer;
+static int connection_cb_called;
+static int read_cb_called;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  static char slab[64];
+  *buf = uv_buf_init(slab, sizeof(slab));
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ASSERT_EQ(1, nread);
+  ASSERT_EQ('x', buf->base[0]);
+  read_cb_called++;
+  uv_close((uv_handle_t*) &incoming, close_cb);
+  uv_close((uv_handle_t*) &client, close_cb);
+  uv_close((uv_handle_t*) &server, close_cb);
+}
+
+
+static void connection_cb(uv_stream_t* stream, int status) {
+  ASSERT_EQ(0, status);
+  connection_cb_called++;
+  ASSERT_EQ(0, uv_tcp_init(stream->loop, &incoming));
+  ASSERT_EQ(0, uv_accept(stream, (uv_stream_t*) &incoming));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &incoming, alloc_cb, read_cb));
+}
+
+
+static void timer_cb(uv_timer_t* handle) {
+  uv_buf_t buf;
+
+  /* Connected but silent, so the server hasn't heard of it yet. */
+  ASSERT_EQ(0, connection_cb_called);
+
+  buf = uv_buf_init("x", 1);
+  ASSERT_EQ(0, uv_write(&write_req, (uv_stream_t*) &client, &buf, 1, NULL));
+  uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, uv_timer_start(&timer, timer_cb, 200, 0));
+}
+
+
+TEST_IMPL(tcp_defer_accept) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  int err;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_timer_init(loop, &timer));
+
+  ASSERT_EQ(0, uv_tcp_init(loop, &server));
+  ASSERT_EQ(UV_EBADF, uv_tcp_defer_accept(&server, 5));
+  ASSERT_EQ(0, uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 16, connection_cb));
+
+  err = uv_tcp_defer_accept(&server, 5);
+  if (err == UV_ENOSYS || err == UV_ENOENT) {
+    uv_close((uv_handle_t*) &server, NULL);
+    uv_close((uv_handle_t*) &timer, NULL);
+    ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("Deferred accept is not supported on this platform");
+  }
+  ASSERT_EQ(0, err);
+
+  ASSERT_EQ(0, uv_tcp_init(loop, &client));
+  ASSERT_EQ(0, uv_tcp_connect(&connect_req,
+                              &client,
+                              (const struct sockaddr*) &addr,
+                              connect_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(1, connection_cb_called);
+  ASSERT_EQ(1, read_cb_called);
+  ASSERT_EQ(4, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,146 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t incoming;
+static uv_connect_t connect_req;
+static uv_write_t write_req;
+static char received[64];
+static size_t bytes_read;
+static int connect_cb_called;
+static int write_cb_called;
+static int close_cb_called;
+
+static const char expected[] = "hello, fast world";
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  *buf = uv_buf_init(received + bytes_read, sizeof(received) - bytes_read);
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ASSERT(nread >= 0);
+  bytes_read += nread;
+  ASSERT(bytes_read <= sizeof(expected) - 1);
+
+  if (bytes_read < sizeof(expected) - 1)
+    return;
+
+  ASSERT_EQ(0, memcmp(received, expected, bytes_read));
+  uv_close((uv_handle_t*) &incoming, close_cb);
+  uv_close((uv_handle_t*) &client, close_cb);
+  uv_close((uv_handle_t*) &server, close_cb);
+}
+
+
+static void connection_cb(uv_stream_t* stream, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, uv_tcp_init(stream->loop, &incoming));
+  ASSERT_EQ(0, uv_accept(stream, (uv_stream_t*) &incoming));
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &incoming, alloc_cb, read_cb));
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT_EQ(0, status);
+  connect_cb_called++;
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+  write_cb_called++;
+}
+
+
+TEST_IMPL(tcp_fastopen) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  uv_buf_t bufs[2];
+  uv_buf_t buf;
+  char big[64 * 1024];
+  int err;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+
+  ASSERT_EQ(0, uv_tcp_init(loop, &server));
+  ASSERT_EQ(UV_EBADF, uv_tcp_fastopen(&server, 16));
+  ASSERT_EQ(0, uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  err = uv_tcp_fastopen(&server, 16);
+  ASSERT(err == 0 || err == UV_ENOSYS);
+  ASSERT_EQ(UV_EINVAL, uv_tcp_fastopen(&server, -1));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 16, connection_cb));
+
+  ASSERT_EQ(0, uv_tcp_init(loop, &client));
+
+  memset(big, 'x', sizeof(big));
+  buf = uv_buf_init(big, sizeof(big));
+  ASSERT_EQ(UV_E2BIG, uv_tcp_connect_fastopen(&connect_req,
+                                              &client,
+                                              (const struct sockaddr*) &addr,
+                                              &buf,
+                                              1,
+                                              connect_cb));
+  ASSERT_EQ(UV_EINVAL, uv_tcp_connect_fastopen(&connect_req,
+                                               &client,
+                                               (const struct sockaddr*) &addr,
+                                               &buf,
+                                               0,
+                                               connect_cb));
+
+  /* The data that doesn't make it into the SYN goes out ahead of writes
+   * made after the connect call.
+   */
+  bufs[0] = uv_buf_init((char*) expected, 5);
+  bufs[1] = uv_buf_init((char*) expected + 5, 7);
+  ASSERT_EQ(0, uv_tcp_connect_fastopen(&connect_req,
+                                       &client,
+                                       (const struct sockaddr*) &addr,
+                                       bufs,
+                                       2,
+                                       connect_cb));
+  buf = uv_buf_init((char*) expected + 12, sizeof(expected) - 1 - 12);
+  ASSERT_EQ(0, uv_write(&write_req, (uv_stream_t*) &client, &buf, 1,
+                        write_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+
+  ASSERT_EQ(1, connect_cb_called);
+  ASSERT_EQ(1, write_cb_called);
+  ASSERT_EQ(3, close_cb_called);
+  ASSERT_EQ(sizeof(expected) - 1, bytes_read);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,231 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define NUM_CLIENTS 4
+#define TOTAL_BYTES (256 * 1024)
+
+struct conn {
+  uv_tcp_t handle;
+  uv_timer_t timer;
+  unsigned int pos;
+  unsigned int reads;
+  int vec;
+};
+
+static uv_loop_t loop;
+static uv_tcp_t server;
+static uv_timer_t accept_timer;
+static uv_tcp_t clients[NUM_CLIENTS];
+static uv_connect_t connect_reqs[NUM_CLIENTS];
+static uv_write_t write_reqs[NUM_CLIENTS];
+static uv_shutdown_t shutdown_reqs[NUM_CLIENTS];
+static struct conn conns[NUM_CLIENTS];
+static char data[TOTAL_BYTES];
+static char readbuf[1000];
+static int num_accepted;
+static int num_eof;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  /* Much smaller than the ring's buffers, so reads start in the middle. */
+  buf->base = readbuf;
+  buf->len = sizeof(readbuf);
+}
+
+
+/* Both halves of the same buffer, so the data ends up in one piece. */
+static void alloc_vec_cb(uv_handle_t* handle,
+                         size_t size,
+                         uv_buf_t bufs[],
+                         unsigned int* nbufs) {
+  ASSERT_GE(*nbufs, 2);
+  bufs[0] = uv_buf_init(readbuf, sizeof(readbuf) / 2);
+  bufs[1] = uv_buf_init(readbuf + sizeof(readbuf) / 2, sizeof(readbuf) / 2);
+  *nbufs = 2;
+}
+
+
+static void read_cb(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf);
+
+
+static void start_reading(struct conn* c) {
+  if (c->vec)
+    ASSERT_EQ(0, uv_read_start_vec((uv_stream_t*) &c->handle,
+                                   alloc_vec_cb,
+                                   read_cb));
+  else
+    ASSERT_EQ(0, uv_read_start((uv_stream_t*) &c->handle, alloc_cb, read_cb));
+}
+
+
+static void restart_cb(uv_timer_t* timer) {
+  start_reading(container_of(timer, struct conn, timer));
+}
+
+
+static void read_cb(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf) {
+  struct conn* c;
+
+  c = container_of((uv_tcp_t*) handle, struct conn, handle);
+
+  if (nread == UV_EOF) {
+    ASSERT_EQ(TOTAL_BYTES, c->pos);
+    uv_close((uv_handle_t*) handle, close_cb);
+    uv_close((uv_handle_t*) &c->timer, close_cb);
+    if (++num_eof == NUM_CLIENTS)
+      uv_close((uv_handle_t*) &server, close_cb);
+    return;
+  }
+
+  ASSERT_GE(nread, 0);
+  ASSERT_LE(c->pos + nread, TOTAL_BYTES);
+  ASSERT_MEM_EQ(data + c->pos, buf->base, nread);
+  c->pos += nread;
+  c->reads++;
+
+  /* Stop and start again, right away and from a timer, to cancel the recv
+   * request while it has data in store.
+   */
+  if (c->reads % 10 == 0) {
+    ASSERT_EQ(0, uv_read_stop(handle));
+    start_reading(c);
+  } else if (c->reads % 25 == 0) {
+    ASSERT_EQ(0, uv_read_stop(handle));
+    ASSERT_EQ(0, uv_timer_start(&c->timer, restart_cb, 1, 0));
+  }
+}
+
+
+static void accept_conn(void) {
+  struct conn* c;
+
+  ASSERT_LT(num_accepted, NUM_CLIENTS);
+  c = conns + num_accepted++;
+  /* Every other one scatters its reads over two buffers. */
+  c->vec = num_accepted % 2;
+  ASSERT_EQ(0, uv_tcp_init(&loop, &c->handle));
+  ASSERT_EQ(0, uv_timer_init(&loop, &c->timer));
+  ASSERT_EQ(0, uv_accept((uv_stream_t*) &server, (uv_stream_t*) &c->handle));
+  start_reading(c);
+}
+
+
+static void accept_timer_cb(uv_timer_t* timer) {
+  accept_conn();
+  uv_close((uv_handle_t*) timer, close_cb);
+}
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  ASSERT_EQ(0, status);
+
+  /* Leave the first one waiting, the others queue up behind it. */
+  if (num_accepted == 0 && !uv_is_closing((uv_handle_t*) &accept_timer)) {
+    ASSERT_EQ(0, uv_timer_start(&accept_timer, accept_timer_cb, 20, 0));
+    return;
+  }
+
+  accept_conn();
+}
+
+
+static void shutdown_cb(uv_shutdown_t* req, int status) {
+  ASSERT_EQ(0, status);
+  uv_close((uv_handle_t*) req->handle, close_cb);
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_buf_t buf;
+  int i;
+
+  ASSERT_EQ(0, status);
+  i = req - connect_reqs;
+  buf = uv_buf_init(data, sizeof(data));
+  ASSERT_EQ(0, uv_write(write_reqs + i, req->handle, &buf, 1, write_cb));
+  ASSERT_EQ(0, uv_shutdown(shutdown_reqs + i, req->handle, shutdown_cb));
+}
+
+
+TEST_IMPL(tcp_io_uring_multishot) {
+  struct sockaddr_in addr;
+  unsigned int i;
+  int r;
+
+  for (i = 0; i < sizeof(data); i++)
+    data[i] = (char) (i % 251);
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  r = uv_loop_configure(&loop, UV_LOOP_USE_IO_URING);
+  if (r == UV_ENOSYS) {
+    ASSERT_EQ(0, uv_loop_close(&loop));
+    RETURN_SKIP("io_uring is not supported.");
+  }
+  ASSERT_EQ(0, r);
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_tcp_init(&loop, &server));
+  ASSERT_EQ(0, uv_timer_init(&loop, &accept_timer));
+  ASSERT_EQ(0, uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 128, connection_cb));
+
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    ASSERT_EQ(0, uv_tcp_init(&loop, clients + i));
+    ASSERT_EQ(0, uv_tcp_connect(connect_reqs + i,
+                                clients + i,
+                                (const struct sockaddr*) &addr,
+                                connect_cb));
+  }
+
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_CLIENTS, num_accepted);
+  ASSERT_EQ(NUM_CLIENTS, num_eof);
+  for (i = 0; i < NUM_CLIENTS; i++)
+    ASSERT_EQ(TOTAL_BYTES, conns[i].pos);
+  /* Server, accept timer, clients, connections and their timers. */
+  ASSERT_EQ(2 + 3 * NUM_CLIENTS, close_cb_called);
+  ASSERT_EQ(0, uv_loop_close(&loop));
+
+  /* The ring let go of the listener, the port can be bound again. */
+  ASSERT_EQ(0, uv_tcp_init(uv_default_loop(), &server));
+  ASSERT_EQ(0, uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 128, connection_cb));
+  uv_close((uv_handle_t*) &server, NULL);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
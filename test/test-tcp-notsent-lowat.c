@@ -0,0 +1,146 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_WRITES 2
+#define WRITE_SIZE (1024 * 1024)
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t conn;
+static uv_timer_t timer;
+static uv_connect_t connect_req;
+static uv_write_t write_req;
+static char data[WRITE_SIZE];
+static char readbuf[64 * 1024];
+static size_t nread_total;
+static int write_cb_called;
+static int writable_cb_called;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  buf->base = readbuf;
+  buf->len = sizeof(readbuf);
+}
+
+
+static void read_cb(uv_stream_t* handle, ssize_t nread, const uv_buf_t* buf) {
+  if (nread == UV_EOF) {
+    ASSERT_EQ(NUM_WRITES * WRITE_SIZE, nread_total);
+    uv_close((uv_handle_t*) handle, close_cb);
+    uv_close((uv_handle_t*) &server, close_cb);
+    return;
+  }
+
+  ASSERT_GE(nread, 0);
+  nread_total += nread;
+}
+
+
+/* Reading starts late, so the client's writes back up in the meantime. */
+static void timer_cb(uv_timer_t* handle) {
+  ASSERT_EQ(0, uv_read_start((uv_stream_t*) &conn, alloc_cb, read_cb));
+  uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, uv_tcp_init(handle->loop, &conn));
+  ASSERT_EQ(0, uv_accept(handle, (uv_stream_t*) &conn));
+  ASSERT_EQ(0, uv_timer_start(&timer, timer_cb, 50, 0));
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+  write_cb_called++;
+}
+
+
+static void writable_cb(uv_tcp_t* handle) {
+  uv_buf_t buf;
+
+  ASSERT_PTR_EQ(&client, handle);
+  ASSERT_EQ(0, uv_stream_get_write_queue_size((uv_stream_t*) handle));
+  writable_cb_called++;
+
+  /* Armed once when it was set and then by each write. */
+  if (writable_cb_called == 1) {
+    ASSERT_EQ(0, write_cb_called);
+  } else {
+    ASSERT_EQ(writable_cb_called - 1, write_cb_called);
+    if (write_cb_called == NUM_WRITES) {
+      uv_close((uv_handle_t*) handle, close_cb);
+      return;
+    }
+  }
+
+  buf = uv_buf_init(data, sizeof(data));
+  ASSERT_EQ(0, uv_write(&write_req, (uv_stream_t*) handle, &buf, 1, write_cb));
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(0, uv_tcp_set_notsent_lowat(&client, 16 * 1024, writable_cb));
+}
+
+
+TEST_IMPL(tcp_notsent_lowat) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  int r;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_tcp_init(loop, &client));
+  r = uv_tcp_set_notsent_lowat(&client, 16 * 1024, writable_cb);
+  if (r == UV_ENOSYS)
+    RETURN_SKIP("TCP_NOTSENT_LOWAT is not supported on this platform.");
+  ASSERT_EQ(UV_EBADF, r);
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_tcp_init(loop, &server));
+  ASSERT_EQ(0, uv_timer_init(loop, &timer));
+  ASSERT_EQ(0, uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 1, connection_cb));
+  ASSERT_EQ(0, uv_tcp_connect(&connect_req,
+                              &client,
+                              (const struct sockaddr*) &addr,
+                              connect_cb));
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_WRITES, write_cb_called);
+  ASSERT_EQ(NUM_WRITES + 1, writable_cb_called);
+  ASSERT_EQ(NUM_WRITES * WRITE_SIZE, nread_total);
+  ASSERT_EQ(4, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,98 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_CLIENTS 16
+
+static uv_tcp_t server;
+static uv_tcp_t clients[NUM_CLIENTS];
+static uv_tcp_t incoming[NUM_CLIENTS];
+static uv_connect_t connect_reqs[NUM_CLIENTS];
+static int connection_cb_called;
+static int connect_cb_called;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void connection_cb(uv_stream_t* handle, int status) {
+  uv_tcp_t* conn;
+
+  ASSERT_EQ(0, status);
+  conn = &incoming[connection_cb_called++];
+  ASSERT_EQ(0, uv_tcp_init(handle->loop, conn));
+  ASSERT_EQ(0, uv_accept(handle, (uv_stream_t*) conn));
+  uv_close((uv_handle_t*) conn, close_cb);
+
+  if (connection_cb_called == NUM_CLIENTS)
+    uv_close((uv_handle_t*) handle, close_cb);
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT_EQ(0, status);
+  connect_cb_called++;
+  uv_close((uv_handle_t*) req->handle, close_cb);
+}
+
+
+TEST_IMPL(tcp_pending_accepts) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  int i;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_tcp_init(loop, &server));
+
+  ASSERT_EQ(UV_EINVAL, uv_tcp_set_pending_accepts(&server, 0, 4));
+  ASSERT_EQ(UV_EINVAL, uv_tcp_set_pending_accepts(&server, 8, 4));
+  ASSERT_EQ(UV_EINVAL, uv_tcp_set_pending_accepts(&server, 1, 4097));
+  ASSERT_EQ(0, uv_tcp_set_pending_accepts(&server, 1, 8));
+
+  ASSERT_EQ(0, uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 128, connection_cb));
+#ifdef _WIN32
+  ASSERT_EQ(UV_EBUSY, uv_tcp_set_pending_accepts(&server, 1, 8));
+#endif
+
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    ASSERT_EQ(0, uv_tcp_init(loop, &clients[i]));
+    ASSERT_EQ(0, uv_tcp_connect(&connect_reqs[i],
+                                &clients[i],
+                                (const struct sockaddr*) &addr,
+                                connect_cb));
+  }
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_CLIENTS, connection_cb_called);
+  ASSERT_EQ(NUM_CLIENTS, connect_cb_called);
+  ASSERT_EQ(2 * NUM_CLIENTS + 1, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,120 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#define NUM_CLIENTS 8
+
+static uv_tcp_t servers[2];
+static uv_tcp_t plain;
+static uv_tcp_t clients[NUM_CLIENTS];
+static uv_tcp_t incoming[NUM_CLIENTS];
+static uv_connect_t connect_reqs[NUM_CLIENTS];
+static int connect_cb_called;
+static int accepted;
+static int close_cb_called;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void connection_cb(uv_stream_t* stream, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT(accepted < NUM_CLIENTS);
+  ASSERT_EQ(0, uv_tcp_init(stream->loop, &incoming[accepted]));
+  ASSERT_EQ(0, uv_accept(stream, (uv_stream_t*) &incoming[accepted]));
+  accepted++;
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  ASSERT_EQ(0, status);
+  connect_cb_called++;
+}
+
+
+TEST_IMPL(tcp_reuseport) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  int err;
+  int i;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+
+  ASSERT_EQ(0, uv_tcp_init(loop, &servers[0]));
+  ASSERT_EQ(UV_EBADF, uv_tcp_reuseport_steer_by_cpu(&servers[0]));
+  err = uv_tcp_bind(&servers[0], (const struct sockaddr*) &addr,
+                    UV_TCP_REUSEPORT);
+  if (err == UV_ENOTSUP) {
+    uv_close((uv_handle_t*) &servers[0], NULL);
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("UV_TCP_REUSEPORT is not supported on this platform");
+  }
+  ASSERT_EQ(0, err);
+
+  err = uv_tcp_reuseport_steer_by_cpu(&servers[0]);
+  ASSERT(err == 0 || err == UV_ENOSYS);
+
+  ASSERT_EQ(0, uv_tcp_init(loop, &servers[1]));
+  ASSERT_EQ(0, uv_tcp_bind(&servers[1], (const struct sockaddr*) &addr,
+                           UV_TCP_REUSEPORT));
+
+  for (i = 0; i < 2; i++)
+    ASSERT_EQ(0, uv_listen((uv_stream_t*) &servers[i], 128, connection_cb));
+
+  /* Without the flag the address is still taken. */
+  ASSERT_EQ(0, uv_tcp_init(loop, &plain));
+  ASSERT_EQ(0, uv_tcp_bind(&plain, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(UV_EADDRINUSE,
+            uv_listen((uv_stream_t*) &plain, 128, connection_cb));
+
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    ASSERT_EQ(0, uv_tcp_init(loop, &clients[i]));
+    ASSERT_EQ(0, uv_tcp_connect(&connect_reqs[i],
+                                &clients[i],
+                                (const struct sockaddr*) &addr,
+                                connect_cb));
+  }
+
+  while (accepted < NUM_CLIENTS || connect_cb_called < NUM_CLIENTS)
+    ASSERT(uv_run(loop, UV_RUN_ONCE) >= 0);
+
+  ASSERT_EQ(NUM_CLIENTS, accepted);
+  ASSERT_EQ(NUM_CLIENTS, connect_cb_called);
+
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    uv_close((uv_handle_t*) &clients[i], close_cb);
+    uv_close((uv_handle_t*) &incoming[i], close_cb);
+  }
+  uv_close((uv_handle_t*) &servers[0], close_cb);
+  uv_close((uv_handle_t*) &servers[1], close_cb);
+  uv_close((uv_handle_t*) &plain, close_cb);
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(3 + 2 * NUM_CLIENTS, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
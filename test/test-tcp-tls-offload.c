@@ -0,0 +1,166 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#if defined(__linux__)
+# include <linux/tls.h>
+#endif
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t incoming;
+static uv_connect_t connect_req;
+static uv_write_t write_req;
+static char received[256];
+static size_t bytes_read;
+static int close_cb_called;
+static int connection_cb_called;
+static int skipped;
+
+static const char message[] = "hello, world";
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void close_all(void) {
+  uv_close((uv_handle_t*) &client, close_cb);
+  uv_close((uv_handle_t*) &server, close_cb);
+  if (connection_cb_called)
+    uv_close((uv_handle_t*) &incoming, close_cb);
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  *buf = uv_buf_init(received + bytes_read, sizeof(received) - bytes_read);
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ASSERT(nread >= 0);
+  bytes_read += nread;
+
+  /* A TLS record: 5 byte header, 8 byte explicit nonce, ciphertext and a
+   * 16 byte tag. The plaintext doesn't show up on the wire.
+   */
+  if (bytes_read < 5 + 8 + sizeof(message) - 1 + 16)
+    return;
+
+  ASSERT(bytes_read == 5 + 8 + sizeof(message) - 1 + 16);
+  ASSERT(received[0] == 23);  /* Application data. */
+  ASSERT(received[1] == 3 && received[2] == 3);  /* TLS 1.2 */
+  ASSERT(0 != memcmp(received + 5 + 8, message, sizeof(message) - 1));
+  close_all();
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  ASSERT(status == 0);
+}
+
+
+static void connection_cb(uv_stream_t* stream, int status) {
+  ASSERT(status == 0);
+  connection_cb_called++;
+  ASSERT(0 == uv_tcp_init(stream->loop, &incoming));
+  ASSERT(0 == uv_accept(stream, (uv_stream_t*) &incoming));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &incoming, alloc_cb, read_cb));
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+#if defined(__linux__)
+  struct tls12_crypto_info_aes_gcm_128 info;
+  uv_buf_t buf;
+  int r;
+
+  ASSERT(status == 0);
+
+  /* A key that was negotiated elsewhere, all zeroes will do here. */
+  memset(&info, 0, sizeof(info));
+  info.info.version = TLS_1_2_VERSION;
+  info.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+
+  ASSERT(UV_EINVAL == uv_tcp_tls_offload(&client, 0, &info, sizeof(info)));
+  ASSERT(UV_EINVAL == uv_tcp_tls_offload(&client, UV_TLS_TX, NULL, 0));
+
+  r = uv_tcp_tls_offload(&client, UV_TLS_TX, &info, sizeof(info));
+  if (r == UV_ENOENT || r == UV_ENOPROTOOPT || r == UV_ENOSYS) {
+    skipped = 1;  /* No tls module. */
+    close_all();
+    return;
+  }
+  ASSERT(r == 0);
+
+  /* The TLS layer is already attached but a TLS 1.2 key can't be replaced. */
+  ASSERT(UV_EBUSY == uv_tcp_tls_offload(&client,
+                                        UV_TLS_TX,
+                                        &info,
+                                        sizeof(info)));
+
+  buf = uv_buf_init((char*) message, sizeof(message) - 1);
+  ASSERT(0 == uv_write(&write_req, (uv_stream_t*) &client, &buf, 1, write_cb));
+#endif  /* defined(__linux__) */
+}
+
+
+TEST_IMPL(tcp_tls_offload) {
+#if defined(__linux__)
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  int zero;
+
+  loop = uv_default_loop();
+  zero = 0;
+
+  ASSERT(0 == uv_tcp_init(loop, &client));
+  ASSERT(UV_EBADF == uv_tcp_tls_offload(&client, UV_TLS_TX, &zero, 1));
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 128, connection_cb));
+  ASSERT(0 == uv_tcp_connect(&connect_req,
+                             &client,
+                             (const struct sockaddr*) &addr,
+                             connect_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  if (skipped) {
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("kernel TLS is not available");
+  }
+
+  ASSERT(close_cb_called == 3);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#else
+  RETURN_SKIP("kernel TLS is Linux only");
+#endif  /* defined(__linux__) */
+}
@@ -0,0 +1,166 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define WRITE_SIZE (1024 * 1024)
+#define WRITE_COUNT 2
+
+static uv_tcp_t server;
+static uv_tcp_t client;
+static uv_tcp_t incoming;
+static uv_connect_t connect_req;
+static uv_write_t write_reqs[WRITE_COUNT];
+static char* write_data;
+static char read_data[64 * 1024];
+static size_t bytes_read;
+static int write_cb_called;
+static int close_cb_called;
+static int skipped;
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void alloc_cb(uv_handle_t* handle, size_t size, uv_buf_t* buf) {
+  *buf = uv_buf_init(read_data, sizeof(read_data));
+}
+
+
+static void read_cb(uv_stream_t* stream, ssize_t nread, const uv_buf_t* buf) {
+  ASSERT(nread >= 0 || nread == UV_EOF);
+
+  if (nread > 0) {
+    bytes_read += nread;
+    return;
+  }
+
+  if (nread == UV_EOF) {
+    uv_close((uv_handle_t*) stream, close_cb);
+    uv_close((uv_handle_t*) &server, close_cb);
+  }
+}
+
+
+static void shutdown_cb(uv_shutdown_t* req, int status) {
+  ASSERT(status == 0);
+  uv_close((uv_handle_t*) &client, close_cb);
+}
+
+
+static void write_cb(uv_write_t* req, int status) {
+  static uv_shutdown_t shutdown_req;
+
+  ASSERT(status == 0);
+  /* Callbacks run in the order the writes were made. */
+  ASSERT_PTR_EQ(req, &write_reqs[write_cb_called]);
+  write_cb_called++;
+
+  if (write_cb_called == WRITE_COUNT)
+    ASSERT(0 == uv_shutdown(&shutdown_req,
+                            (uv_stream_t*) &client,
+                            shutdown_cb));
+}
+
+
+static void connection_cb(uv_stream_t* stream, int status) {
+  ASSERT(status == 0);
+  ASSERT(0 == uv_tcp_init(stream->loop, &incoming));
+  ASSERT(0 == uv_accept(stream, (uv_stream_t*) &incoming));
+  ASSERT(0 == uv_read_start((uv_stream_t*) &incoming, alloc_cb, read_cb));
+}
+
+
+static void connect_cb(uv_connect_t* req, int status) {
+  uv_buf_t buf;
+  int r;
+  int i;
+
+  ASSERT(status == 0);
+
+  r = uv_tcp_zerocopy(&client, 1);
+  if (r == UV_ENOSYS || r == UV_ENOPROTOOPT || r == UV_EINVAL) {
+    skipped = 1;
+    uv_close((uv_handle_t*) &client, close_cb);
+    uv_close((uv_handle_t*) &server, close_cb);
+    return;
+  }
+  ASSERT(r == 0);
+
+  buf = uv_buf_init(write_data, WRITE_SIZE);
+  for (i = 0; i < WRITE_COUNT; i++)
+    ASSERT(0 == uv_write(&write_reqs[i],
+                         (uv_stream_t*) &client,
+                         &buf,
+                         1,
+                         write_cb));
+}
+
+
+TEST_IMPL(tcp_write_zerocopy) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+
+  loop = uv_default_loop();
+  write_data = malloc(WRITE_SIZE);
+  ASSERT_NOT_NULL(write_data);
+  memset(write_data, 'z', WRITE_SIZE);
+
+  /* No socket yet. */
+  ASSERT(0 == uv_tcp_init(loop, &client));
+#ifdef _WIN32
+  ASSERT(UV_ENOSYS == uv_tcp_zerocopy(&client, 1));
+#else
+  ASSERT(UV_EBADF == uv_tcp_zerocopy(&client, 1) ||
+         UV_ENOSYS == uv_tcp_zerocopy(&client, 1));
+#endif
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT(0 == uv_tcp_init(loop, &server));
+  ASSERT(0 == uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT(0 == uv_listen((uv_stream_t*) &server, 128, connection_cb));
+  ASSERT(0 == uv_tcp_connect(&connect_req,
+                             &client,
+                             (const struct sockaddr*) &addr,
+                             connect_cb));
+
+  ASSERT(0 == uv_run(loop, UV_RUN_DEFAULT));
+
+  if (skipped) {
+    free(write_data);
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("MSG_ZEROCOPY is not supported");
+  }
+
+  ASSERT(write_cb_called == WRITE_COUNT);
+  ASSERT(bytes_read == (size_t) WRITE_SIZE * WRITE_COUNT);
+  ASSERT(close_cb_called == 3);
+
+  free(write_data);
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
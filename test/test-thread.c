@@ -30,6 +30,10 @@
 #include <pthread.h>
 #endif
 
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 struct getaddrinfo_req {
   uv_thread_t thread_id;
   unsigned int counter;
@@ -298,3 +302,73 @@ TEST_IMPL(thread_stack_size_explicit) {
 
   return 0;
 }
+
+
+/* Returns a CPU that the process is allowed to run on. */
+static int first_allowed_cpu(void) {
+#ifdef __linux__
+  cpu_set_t set;
+  int cpu;
+
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(set), &set));
+  for (cpu = 0; !CPU_ISSET(cpu, &set); cpu++);
+  return cpu;
+#else
+  return 0;
+#endif
+}
+
+
+static void thread_check_affinity(void* arg) {
+#ifdef __linux__
+  cpu_set_t set;
+
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(set), &set));
+  ASSERT_EQ(1, CPU_COUNT(&set));
+  ASSERT(CPU_ISSET(*(int*) arg, &set));
+#endif
+}
+
+
+TEST_IMPL(thread_affinity) {
+  uv_thread_options_t options;
+  uv_thread_t thread;
+  char* mask;
+  int mask_size;
+  int cpu;
+  int r;
+
+  mask_size = uv_cpumask_size();
+  if (mask_size == UV_ENOTSUP)
+    RETURN_SKIP("Thread affinity is not supported on this platform.");
+  ASSERT_GT(mask_size, 0);
+
+  mask = calloc(mask_size + 1, 1);
+  ASSERT_NOT_NULL(mask);
+
+  options.flags = UV_THREAD_HAS_AFFINITY;
+  options.cpumask = mask;
+  options.mask_size = mask_size;
+
+  /* No CPU at all. */
+  ASSERT_EQ(UV_EINVAL, uv_thread_create_ex(&thread, &options,
+                                           thread_check_affinity, &cpu));
+
+  cpu = first_allowed_cpu();
+  mask[cpu] = 1;
+  options.mask_size = mask_size + 1;
+  ASSERT_EQ(UV_EINVAL, uv_thread_create_ex(&thread, &options,
+                                           thread_check_affinity, &cpu));
+
+  options.mask_size = mask_size;
+  ASSERT_EQ(0, uv_thread_create_ex(&thread, &options,
+                                   thread_check_affinity, &cpu));
+  ASSERT_EQ(0, uv_thread_join(&thread));
+
+  /* Machines that aren't NUMA may not list any nodes. */
+  r = uv_numa_node_cpumask(0, mask, mask_size);
+  ASSERT(r == 0 || r == UV_ENOENT || r == UV_ENOTSUP);
+
+  free(mask);
+  return 0;
+}
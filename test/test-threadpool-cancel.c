@@ -162,6 +162,9 @@ static void nop_random_cb(uv_random_t* req, int status, void* buf, size_t len) {
 
 
 TEST_IMPL(threadpool_cancel_getaddrinfo) {
+#ifdef _WIN32
+  RETURN_SKIP("getaddrinfo doesn't use the threadpool on Windows.");
+#else
   uv_getaddrinfo_t reqs[4];
   struct cancel_info ci;
   struct addrinfo hints;
@@ -191,6 +194,7 @@ TEST_IMPL(threadpool_cancel_getaddrinfo) {
 
   MAKE_VALGRIND_HAPPY();
   return 0;
+#endif
 }
 
 
@@ -284,6 +288,9 @@ TEST_IMPL(threadpool_cancel_fs) {
   unsigned n;
   uv_buf_t iov;
 
+  if (default_loop_uses_io_uring())
+    RETURN_SKIP("File system requests don't go through the threadpool.");
+
   INIT_CANCEL_INFO(&ci, reqs);
   loop = uv_default_loop();
   saturate_threadpool();
@@ -347,3 +354,88 @@ TEST_IMPL(threadpool_cancel_single) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static void expired_done_cb(uv_work_t* req, int status) {
+  ASSERT_EQ(UV_ETIMEDOUT, status);
+  done2_cb_called++;
+}
+
+
+static void untagged_work_cb(uv_work_t* req) {
+}
+
+
+static void untagged_done_cb(uv_work_t* req, int status) {
+  ASSERT_EQ(0, status);
+  done_cb_called++;
+}
+
+
+static void expired_fs_cb(uv_fs_t* req) {
+  ASSERT_EQ(UV_ETIMEDOUT, req->result);
+  uv_fs_req_cleanup(req);
+  fs_cb_called++;
+}
+
+
+TEST_IMPL(threadpool_cancel_tag) {
+  uv_work_t tagged[4];
+  uv_work_t other;
+  uv_loop_t* loop;
+  int tag;
+  unsigned i;
+
+  saturate_threadpool();
+  loop = uv_default_loop();
+
+  uv_work_set_scope(loop, &tag, 0);
+  for (i = 0; i < ARRAY_SIZE(tagged); i++)
+    ASSERT_EQ(0, uv_queue_work(loop, tagged + i, work2_cb, done2_cb));
+  uv_work_set_scope(loop, NULL, 0);
+  ASSERT_EQ(0, uv_queue_work(loop, &other, untagged_work_cb,
+                             untagged_done_cb));
+
+  ASSERT_EQ(UV_EINVAL, uv_work_cancel_tag(loop, NULL));
+  ASSERT_EQ(ARRAY_SIZE(tagged), uv_work_cancel_tag(loop, &tag));
+  ASSERT_EQ(0, uv_work_cancel_tag(loop, &tag));
+  ASSERT_EQ(UV_EBUSY, uv_cancel((uv_req_t*) tagged));
+
+  unblock_threadpool();
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(ARRAY_SIZE(tagged), done2_cb_called);
+  ASSERT_EQ(1, done_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+TEST_IMPL(threadpool_work_deadline) {
+  uv_work_t reqs[4];
+  uv_fs_t fs_req;
+  uv_loop_t* loop;
+  unsigned i;
+
+  if (default_loop_uses_io_uring())
+    RETURN_SKIP("File system requests don't go through the threadpool.");
+
+  saturate_threadpool();
+  loop = uv_default_loop();
+
+  uv_work_set_scope(loop, NULL, 1);
+  for (i = 0; i < ARRAY_SIZE(reqs); i++)
+    ASSERT_EQ(0, uv_queue_work(loop, reqs + i, work2_cb, expired_done_cb));
+  ASSERT_EQ(0, uv_fs_stat(loop, &fs_req, ".", expired_fs_cb));
+  uv_work_set_scope(loop, NULL, 0);
+
+  /* Everything sits in the queue for longer than its deadline. */
+  uv_sleep(50);
+  unblock_threadpool();
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(ARRAY_SIZE(reqs), done2_cb_called);
+  ASSERT_EQ(1, fs_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -22,6 +22,12 @@
 #include "uv.h"
 #include "task.h"
 
+#include <string.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 static int work_cb_count;
 static int after_work_cb_count;
 static uv_work_t work_req;
@@ -74,3 +80,599 @@ TEST_IMPL(threadpool_queue_work_einval) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static uv_sem_t blocker_sem;
+static int blocker_done_count;
+static int loop_pool_work_count;
+static int loop_pool_done_count;
+
+
+static void blocker_cb(uv_work_t* req) {
+  uv_sem_wait(&blocker_sem);
+}
+
+
+static void blocker_done_cb(uv_work_t* req, int status) {
+  ASSERT_EQ(0, status);
+  blocker_done_count++;
+}
+
+
+static void loop_pool_work_cb(uv_work_t* req) {
+  loop_pool_work_count++;
+}
+
+
+static void loop_pool_done_cb(uv_work_t* req, int status) {
+  ASSERT_EQ(0, status);
+  loop_pool_done_count++;
+}
+
+
+TEST_IMPL(threadpool_loop_pool) {
+  uv_work_t blockers[4];
+  uv_work_t req;
+  uv_loop_t loop;
+  unsigned int i;
+
+  /* Tie up the global pool. */
+  ASSERT_EQ(0, uv_sem_init(&blocker_sem, 0));
+  for (i = 0; i < ARRAY_SIZE(blockers); i++)
+    ASSERT_EQ(0, uv_queue_work(uv_default_loop(),
+                               &blockers[i],
+                               blocker_cb,
+                               blocker_done_cb));
+
+  /* Work on a loop with its own pool still makes progress. */
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  ASSERT_EQ(0, uv_loop_configure(&loop, UV_LOOP_THREADPOOL_SIZE, 2));
+  ASSERT_EQ(0, uv_queue_work(&loop, &req, loop_pool_work_cb,
+                             loop_pool_done_cb));
+  ASSERT_EQ(UV_EBUSY, uv_loop_configure(&loop, UV_LOOP_THREADPOOL_SIZE, 1));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, loop_pool_work_count);
+  ASSERT_EQ(1, loop_pool_done_count);
+
+  /* Zero switches the loop back to the global pool. */
+  ASSERT_EQ(0, uv_loop_configure(&loop, UV_LOOP_THREADPOOL_SIZE, 0));
+  ASSERT_EQ(0, uv_loop_close(&loop));
+
+  for (i = 0; i < ARRAY_SIZE(blockers); i++)
+    uv_sem_post(&blocker_sem);
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(ARRAY_SIZE(blockers), blocker_done_count);
+  uv_sem_destroy(&blocker_sem);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#ifdef __linux__
+static int affinity_cpu;
+
+
+static void affinity_work_cb(uv_work_t* req) {
+  cpu_set_t set;
+
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(set), &set));
+  ASSERT_EQ(1, CPU_COUNT(&set));
+  ASSERT(CPU_ISSET(affinity_cpu, &set));
+  loop_pool_work_count++;
+}
+#endif
+
+
+TEST_IMPL(threadpool_loop_affinity) {
+#ifndef __linux__
+  RETURN_SKIP("Only checked on Linux.");
+#else
+  uv_work_t req;
+  uv_loop_t loop;
+  cpu_set_t set;
+  char mask[CPU_SETSIZE];
+
+  ASSERT_EQ(0, sched_getaffinity(0, sizeof(set), &set));
+  for (affinity_cpu = 0; !CPU_ISSET(affinity_cpu, &set); affinity_cpu++);
+
+  memset(mask, 0, sizeof(mask));
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  ASSERT_EQ(UV_EINVAL, uv_loop_configure(&loop,
+                                         UV_LOOP_THREADPOOL_AFFINITY,
+                                         mask,
+                                         sizeof(mask)));
+
+  /* Applies to a pool that's created later... */
+  mask[affinity_cpu] = 1;
+  ASSERT_EQ(0, uv_loop_configure(&loop,
+                                 UV_LOOP_THREADPOOL_AFFINITY,
+                                 mask,
+                                 sizeof(mask)));
+  ASSERT_EQ(0, uv_loop_configure(&loop, UV_LOOP_THREADPOOL_SIZE, 2));
+  ASSERT_EQ(0, uv_queue_work(&loop, &req, affinity_work_cb,
+                             loop_pool_done_cb));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+
+  /* ...and replaces one that exists already. */
+  ASSERT_EQ(0, uv_loop_configure(&loop,
+                                 UV_LOOP_THREADPOOL_AFFINITY,
+                                 mask,
+                                 (size_t) affinity_cpu + 1));
+  ASSERT_EQ(0, uv_queue_work(&loop, &req, affinity_work_cb,
+                             loop_pool_done_cb));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, loop_pool_work_count);
+  ASSERT_EQ(2, loop_pool_done_count);
+
+  /* NULL lets the threads run anywhere again. */
+  ASSERT_EQ(0, uv_loop_configure(&loop,
+                                 UV_LOOP_THREADPOOL_AFFINITY,
+                                 NULL,
+                                 (size_t) 0));
+  ASSERT_EQ(0, uv_loop_close(&loop));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+#endif
+}
+
+
+static uv_work_priority priority_order[3];
+static int priority_work_count;
+
+
+static void priority_work_cb(uv_work_t* req) {
+  priority_order[priority_work_count++] = *(uv_work_priority*) req->data;
+}
+
+
+TEST_IMPL(threadpool_queue_work_priority) {
+  static uv_work_priority priorities[] = {
+    UV_WORK_PRIORITY_BACKGROUND,
+    UV_WORK_PRIORITY_NORMAL,
+    UV_WORK_PRIORITY_HIGH
+  };
+  uv_work_t reqs[ARRAY_SIZE(priorities)];
+  uv_work_t blocker;
+  uv_loop_t loop;
+  unsigned int i;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  ASSERT_EQ(0, uv_loop_configure(&loop, UV_LOOP_THREADPOOL_SIZE, 1));
+  ASSERT_EQ(UV_EINVAL, uv_queue_work_ex(&loop,
+                                        &reqs[0],
+                                        (uv_work_priority) 42,
+                                        priority_work_cb,
+                                        NULL));
+
+  /* Keep the only thread busy while the requests are queued. */
+  ASSERT_EQ(0, uv_sem_init(&blocker_sem, 0));
+  ASSERT_EQ(0, uv_queue_work(&loop, &blocker, blocker_cb, blocker_done_cb));
+
+  for (i = 0; i < ARRAY_SIZE(priorities); i++) {
+    reqs[i].data = &priorities[i];
+    ASSERT_EQ(0, uv_queue_work_ex(&loop,
+                                  &reqs[i],
+                                  priorities[i],
+                                  priority_work_cb,
+                                  NULL));
+  }
+
+  uv_sem_post(&blocker_sem);
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, blocker_done_count);
+  ASSERT_EQ(3, priority_work_count);
+  ASSERT_EQ(UV_WORK_PRIORITY_HIGH, priority_order[0]);
+  ASSERT_EQ(UV_WORK_PRIORITY_NORMAL, priority_order[1]);
+  ASSERT_EQ(UV_WORK_PRIORITY_BACKGROUND, priority_order[2]);
+
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  uv_sem_destroy(&blocker_sem);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void batch_work_cb(uv_work_t* req) {
+  *(char*) req->data = 1;
+}
+
+
+static void batch_done_cb(uv_work_t* req, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(1, *(char*) req->data);
+  after_work_cb_count++;
+}
+
+
+TEST_IMPL(threadpool_queue_work_batch) {
+  uv_work_t* ptrs[200];
+  uv_work_t reqs[200];
+  char ran[200];
+  unsigned int i;
+
+  memset(ran, 0, sizeof(ran));
+  for (i = 0; i < ARRAY_SIZE(reqs); i++) {
+    reqs[i].data = ran + i;
+    ptrs[i] = reqs + i;
+  }
+
+  ASSERT_EQ(UV_EINVAL, uv_queue_work_batch(uv_default_loop(),
+                                           ptrs,
+                                           ARRAY_SIZE(ptrs),
+                                           NULL,
+                                           batch_done_cb));
+  ptrs[7] = NULL;
+  ASSERT_EQ(UV_EINVAL, uv_queue_work_batch(uv_default_loop(),
+                                           ptrs,
+                                           ARRAY_SIZE(ptrs),
+                                           batch_work_cb,
+                                           batch_done_cb));
+  ptrs[7] = reqs + 7;
+
+  /* More than fit into one slice. */
+  ASSERT_EQ(0, uv_queue_work_batch(uv_default_loop(),
+                                   ptrs,
+                                   ARRAY_SIZE(ptrs),
+                                   batch_work_cb,
+                                   batch_done_cb));
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(ARRAY_SIZE(reqs), after_work_cb_count);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static char pfor_seen[10007];
+static int pfor_done_count;
+
+
+static void pfor_body_cb(uv_parallel_for_t* pfor, size_t begin, size_t end) {
+  ASSERT_LT(begin, end);
+  ASSERT_LE(end, sizeof(pfor_seen));
+  while (begin < end)
+    pfor_seen[begin++]++;
+}
+
+
+static void pfor_done_cb(uv_parallel_for_t* pfor, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_NULL(pfor->pfor_ctx);
+  pfor_done_count++;
+}
+
+
+TEST_IMPL(threadpool_parallel_for) {
+  uv_parallel_for_t pfor;
+  uv_loop_t* loop;
+  size_t i;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(UV_EINVAL, uv_parallel_for(loop, &pfor, 5, 5, 0,
+                                       pfor_body_cb, pfor_done_cb));
+  ASSERT_EQ(UV_EINVAL, uv_parallel_for(loop, &pfor, 0, 5, 0,
+                                       NULL, pfor_done_cb));
+
+  /* A grain that doesn't divide the range, so the last chunk is short. */
+  ASSERT_EQ(0, uv_parallel_for(loop, &pfor, 1, sizeof(pfor_seen), 64,
+                               pfor_body_cb, pfor_done_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, pfor_done_count);
+  ASSERT_EQ(0, pfor_seen[0]);
+  for (i = 1; i < sizeof(pfor_seen); i++)
+    ASSERT_EQ(1, pfor_seen[i]);
+
+  /* And one picked by the library. */
+  ASSERT_EQ(0, uv_parallel_for(loop, &pfor, 0, sizeof(pfor_seen), 0,
+                               pfor_body_cb, pfor_done_cb));
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, pfor_done_count);
+  ASSERT_EQ(1, pfor_seen[0]);
+  for (i = 1; i < sizeof(pfor_seen); i++)
+    ASSERT_EQ(2, pfor_seen[i]);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uv_barrier_t dynamic_barrier;
+static int dynamic_done_count;
+
+
+static void dynamic_work_cb(uv_work_t* req) {
+  uv_barrier_wait(&dynamic_barrier);
+}
+
+
+static void dynamic_done_cb(uv_work_t* req, int status) {
+  ASSERT_EQ(0, status);
+  dynamic_done_count++;
+}
+
+
+TEST_IMPL(threadpool_set_limits) {
+  uv_work_t reqs[8];
+  unsigned int i;
+  int r;
+
+  ASSERT_EQ(UV_EINVAL, uv_threadpool_set_limits(0, 4, 0));
+  ASSERT_EQ(UV_EINVAL, uv_threadpool_set_limits(4, 2, 0));
+  ASSERT_EQ(UV_EINVAL, uv_threadpool_set_limits(1, 4096, 0));
+
+  r = uv_threadpool_set_limits(2, ARRAY_SIZE(reqs), 10);
+  if (r == UV_ENOTSUP)
+    RETURN_SKIP("Thread pool has a fixed size.");
+  ASSERT_EQ(0, r);
+
+  /* Only completes if the pool grows to run all of them at once. */
+  ASSERT_EQ(0, uv_barrier_init(&dynamic_barrier, ARRAY_SIZE(reqs)));
+  for (i = 0; i < ARRAY_SIZE(reqs); i++)
+    ASSERT_EQ(0, uv_queue_work(uv_default_loop(),
+                               &reqs[i],
+                               dynamic_work_cb,
+                               dynamic_done_cb));
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(ARRAY_SIZE(reqs), dynamic_done_count);
+  uv_barrier_destroy(&dynamic_barrier);
+
+  /* Shrink back, the excess threads retire while work keeps running. */
+  ASSERT_EQ(0, uv_threadpool_set_limits(1, 1, 0));
+  ASSERT_EQ(0, uv_queue_work(uv_default_loop(),
+                             &reqs[0],
+                             loop_pool_work_cb,
+                             loop_pool_done_cb));
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(1, loop_pool_done_count);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void kind_stat_cb(uv_fs_t* req) {
+  ASSERT_EQ(0, req->result);
+  uv_fs_req_cleanup(req);
+  /* The CPU thread is still blocked, this ran on a thread of its own. */
+  ASSERT_EQ(0, blocker_done_count);
+  uv_sem_post(&blocker_sem);
+}
+
+
+TEST_IMPL(threadpool_kind_size) {
+  uv_threadpool_metrics_t metrics;
+  uv_work_t blocker;
+  uv_fs_t fs_req;
+  uv_loop_t* loop;
+
+  ASSERT_EQ(UV_EINVAL,
+            uv_threadpool_set_kind_size(UV_THREADPOOL_WORK_MAX, 1));
+  ASSERT_EQ(UV_EINVAL,
+            uv_threadpool_set_kind_size(UV_THREADPOOL_WORK_FAST_IO, 4096));
+  ASSERT_EQ(0, uv_threadpool_set_kind_size(UV_THREADPOOL_WORK_CPU, 1));
+  ASSERT_EQ(0, uv_threadpool_set_kind_size(UV_THREADPOOL_WORK_FAST_IO, 1));
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_sem_init(&blocker_sem, 0));
+  ASSERT_EQ(0, uv_queue_work(loop, &blocker, blocker_cb, blocker_done_cb));
+  ASSERT_EQ(0, uv_fs_stat(loop, &fs_req, ".", kind_stat_cb));
+
+  ASSERT_EQ(UV_EBUSY,
+            uv_threadpool_set_kind_size(UV_THREADPOOL_WORK_SLOW_IO, 1));
+  ASSERT_EQ(0, uv_threadpool_metrics(NULL, &metrics));
+  ASSERT_EQ(2, metrics.threads);
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(1, blocker_done_count);
+  uv_sem_destroy(&blocker_sem);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uv_sem_t metrics_started_sem;
+static int metrics_done_count;
+
+
+static void metrics_blocker_cb(uv_work_t* req) {
+  uv_sem_post(&metrics_started_sem);
+  uv_sem_wait(&blocker_sem);
+}
+
+
+static void metrics_noop_cb(uv_work_t* req) {
+}
+
+
+static void metrics_done_cb(uv_work_t* req, int status) {
+  ASSERT(status == 0 || status == UV_ECANCELED);
+  metrics_done_count++;
+}
+
+
+static void metrics_stat_cb(uv_fs_t* req) {
+  ASSERT_EQ(0, req->result);
+  uv_fs_req_cleanup(req);
+  metrics_done_count++;
+}
+
+
+static uint64_t histogram_sum(const uint64_t* histogram) {
+  uint64_t sum;
+  unsigned int i;
+
+  sum = 0;
+  for (i = 0; i < UV_THREADPOOL_HISTOGRAM_SIZE; i++)
+    sum += histogram[i];
+
+  return sum;
+}
+
+
+TEST_IMPL(threadpool_metrics) {
+  uv_threadpool_work_metrics_t* cpu;
+  uv_threadpool_metrics_t metrics;
+  uv_work_t reqs[3];
+  uv_fs_t stat_req;
+  uv_loop_t loop;
+
+  ASSERT_EQ(0, uv_threadpool_histogram_bound(0));
+  ASSERT_EQ(3, uv_threadpool_histogram_bound(3));
+  ASSERT_EQ(4, uv_threadpool_histogram_bound(4));
+  ASSERT_EQ(7, uv_threadpool_histogram_bound(7));
+  ASSERT_EQ(8, uv_threadpool_histogram_bound(8));
+  ASSERT_EQ(14, uv_threadpool_histogram_bound(11));
+  ASSERT_EQ(16, uv_threadpool_histogram_bound(12));
+  ASSERT_EQ(UINT64_MAX,
+            uv_threadpool_histogram_bound(UV_THREADPOOL_HISTOGRAM_SIZE));
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  ASSERT_EQ(0, uv_loop_configure(&loop, UV_LOOP_THREADPOOL_SIZE, 1));
+  ASSERT_EQ(UV_EINVAL, uv_threadpool_metrics(&loop, NULL));
+
+  /* The only thread is stuck, the other requests have to wait. */
+  ASSERT_EQ(0, uv_sem_init(&blocker_sem, 0));
+  ASSERT_EQ(0, uv_sem_init(&metrics_started_sem, 0));
+  ASSERT_EQ(0, uv_queue_work(&loop, &reqs[0], metrics_blocker_cb,
+                             metrics_done_cb));
+  uv_sem_wait(&metrics_started_sem);
+  ASSERT_EQ(0, uv_queue_work(&loop, &reqs[1], metrics_noop_cb,
+                             metrics_done_cb));
+  ASSERT_EQ(0, uv_queue_work(&loop, &reqs[2], metrics_noop_cb,
+                             metrics_done_cb));
+  ASSERT_EQ(0, uv_fs_stat(&loop, &stat_req, ".", metrics_stat_cb));
+  ASSERT_EQ(0, uv_cancel((uv_req_t*) &reqs[2]));
+
+  ASSERT_EQ(0, uv_threadpool_metrics(&loop, &metrics));
+  cpu = &metrics.kinds[UV_THREADPOOL_WORK_CPU];
+  ASSERT_EQ(1, metrics.threads);
+  ASSERT_EQ(0, metrics.idle_threads);
+  ASSERT_EQ(3, cpu->submitted);
+  ASSERT_EQ(1, cpu->queued);
+  ASSERT_EQ(1, cpu->cancelled);
+  ASSERT_EQ(0, cpu->completed);
+  ASSERT_EQ(1, metrics.kinds[UV_THREADPOOL_WORK_FAST_IO].queued);
+
+  uv_sleep(20);
+  uv_sem_post(&blocker_sem);
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(4, metrics_done_count);
+
+  ASSERT_EQ(0, uv_threadpool_metrics(&loop, &metrics));
+  ASSERT_EQ(0, cpu->queued);
+  ASSERT_EQ(2, cpu->completed);
+  ASSERT_EQ(2, histogram_sum(cpu->wait_histogram));
+  ASSERT_EQ(2, histogram_sum(cpu->exec_histogram));
+  ASSERT_GE(cpu->exec_time, 20 * 1000000);  /* The blocker. */
+  ASSERT_GE(cpu->wait_time, 20 * 1000000);  /* The request behind it. */
+  ASSERT_EQ(1, metrics.kinds[UV_THREADPOOL_WORK_FAST_IO].completed);
+  ASSERT_EQ(0, metrics.kinds[UV_THREADPOOL_WORK_SLOW_IO].submitted);
+
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  uv_sem_destroy(&metrics_started_sem);
+  uv_sem_destroy(&blocker_sem);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uv_mutex_t options_mutex;
+static int contexts[2];
+static int init_cb_count;
+static int exit_cb_count;
+static int options_work_count;
+
+
+static void* options_init_cb(void* arg) {
+  void* context;
+
+  ASSERT_PTR_EQ(&options_mutex, arg);
+  uv_mutex_lock(&options_mutex);
+  ASSERT_LT(init_cb_count, ARRAY_SIZE(contexts));
+  context = &contexts[init_cb_count++];
+  uv_mutex_unlock(&options_mutex);
+  return context;
+}
+
+
+static void options_exit_cb(void* arg, void* context) {
+  ASSERT_PTR_EQ(&options_mutex, arg);
+  ASSERT_PTR_EQ(context, uv_threadpool_context());
+  uv_mutex_lock(&options_mutex);
+  exit_cb_count++;
+  uv_mutex_unlock(&options_mutex);
+}
+
+
+static void options_work_cb(uv_work_t* req) {
+  int* context;
+
+  context = uv_threadpool_context();
+  ASSERT(context == &contexts[0] || context == &contexts[1]);
+  uv_mutex_lock(&options_mutex);
+  (*context)++;
+  uv_mutex_unlock(&options_mutex);
+}
+
+
+static void options_done_cb(uv_work_t* req, int status) {
+  ASSERT_EQ(0, status);
+  options_work_count++;
+}
+
+
+TEST_IMPL(threadpool_set_options) {
+  uv_threadpool_options_t options;
+  uv_work_t reqs[8];
+  uv_loop_t loop;
+  unsigned int i;
+
+  ASSERT_EQ(UV_EINVAL, uv_threadpool_set_options(NULL));
+
+  memset(&options, 0, sizeof(options));
+  options.flags = 0x80;
+  ASSERT_EQ(UV_EINVAL, uv_threadpool_set_options(&options));
+  options.flags = UV_THREADPOOL_HAS_PRIORITY;
+  options.priority = UV_PRIORITY_LOW + 1;
+  ASSERT_EQ(UV_EINVAL, uv_threadpool_set_options(&options));
+
+  ASSERT_EQ(0, uv_mutex_init(&options_mutex));
+  options.flags = UV_THREADPOOL_HAS_STACK_SIZE | UV_THREADPOOL_HAS_PRIORITY;
+  options.init_cb = options_init_cb;
+  options.exit_cb = options_exit_cb;
+  options.arg = &options_mutex;
+  options.name = "uv-test-pool";
+  options.stack_size = 256 * 1024;
+  options.priority = UV_PRIORITY_BELOW_NORMAL;  /* Lowering is allowed. */
+  ASSERT_EQ(0, uv_threadpool_set_options(&options));
+  ASSERT_NULL(uv_threadpool_context());
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  ASSERT_EQ(0, uv_loop_configure(&loop, UV_LOOP_THREADPOOL_SIZE, 2));
+  ASSERT_EQ(UV_EBUSY, uv_threadpool_set_options(&options));
+
+  for (i = 0; i < ARRAY_SIZE(reqs); i++)
+    ASSERT_EQ(0, uv_queue_work(&loop,
+                               &reqs[i],
+                               options_work_cb,
+                               options_done_cb));
+
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(ARRAY_SIZE(reqs), options_work_count);
+  ASSERT_EQ(ARRAY_SIZE(reqs), contexts[0] + contexts[1]);
+  ASSERT_EQ(2, init_cb_count);
+
+  /* Closing the loop stops the threads of its pool. */
+  ASSERT_EQ(0, uv_loop_close(&loop));
+  ASSERT_EQ(2, exit_cb_count);
+  uv_mutex_destroy(&options_mutex);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
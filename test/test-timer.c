@@ -345,3 +345,238 @@ TEST_IMPL(timer_early_check) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static uv_timer_t* wheel_order[8];
+static int wheel_order_count;
+
+
+static void wheel_cb(uv_timer_t* handle) {
+  uint64_t* deadline;
+
+  deadline = handle->data;
+  ASSERT_GE(uv_now(handle->loop), *deadline);
+  ASSERT_LT(wheel_order_count, ARRAY_SIZE(wheel_order));
+  wheel_order[wheel_order_count++] = handle;
+
+  if (uv_timer_get_repeat(handle) != 0 && *deadline - start_time >= 512) {
+    uv_timer_stop(handle);
+    return;
+  }
+
+  *deadline += uv_timer_get_repeat(handle);
+}
+
+
+TEST_IMPL(timer_wheel) {
+  static const uint64_t timeouts[] = { 300, 10, 260, 300, 400, 256 };
+  uint64_t deadlines[ARRAY_SIZE(timeouts)];
+  uv_timer_t handles[ARRAY_SIZE(timeouts)];
+  uv_loop_t loop;
+  unsigned int i;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  ASSERT_EQ(0, uv_loop_configure(&loop, UV_LOOP_USE_TIMER_WHEEL));
+
+  start_time = uv_now(&loop);
+  for (i = 0; i < ARRAY_SIZE(timeouts); i++) {
+    deadlines[i] = start_time + timeouts[i];
+    ASSERT_EQ(0, uv_timer_init(&loop, &handles[i]));
+    handles[i].data = &deadlines[i];
+  }
+
+  /* The poll timeout is the earliest deadline, not the next cascade. */
+  ASSERT_EQ(0, uv_timer_start(&handles[4], wheel_cb, timeouts[4], 0));
+  ASSERT_EQ(400, uv_backend_timeout(&loop));
+  ASSERT_EQ(0, uv_timer_start(&handles[0], wheel_cb, timeouts[0], 0));
+  ASSERT_EQ(300, uv_backend_timeout(&loop));
+  ASSERT_EQ(0, uv_timer_stop(&handles[0]));
+  ASSERT_EQ(400, uv_backend_timeout(&loop));
+
+  for (i = 0; i < ARRAY_SIZE(timeouts) - 1; i++)
+    ASSERT_EQ(0, uv_timer_start(&handles[i], wheel_cb, timeouts[i], 0));
+  ASSERT_EQ(0, uv_timer_start(&handles[i], wheel_cb, timeouts[i], 256));
+
+  /* Stopping a timer takes it out of the wheel. */
+  ASSERT_EQ(0, uv_timer_stop(&handles[4]));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+
+  /* Timers with the same deadline run in the order they were started. */
+  ASSERT_EQ(6, wheel_order_count);
+  ASSERT_PTR_EQ(&handles[1], wheel_order[0]);
+  ASSERT_PTR_EQ(&handles[5], wheel_order[1]);
+  ASSERT_PTR_EQ(&handles[2], wheel_order[2]);
+  ASSERT_PTR_EQ(&handles[0], wheel_order[3]);
+  ASSERT_PTR_EQ(&handles[3], wheel_order[4]);
+  ASSERT_PTR_EQ(&handles[5], wheel_order[5]);
+
+  for (i = 0; i < ARRAY_SIZE(timeouts); i++)
+    uv_close((uv_handle_t*) &handles[i], NULL);
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, uv_loop_close(&loop));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static uint64_t slack_cb_time[2];
+static int slack_cb_called;
+
+
+static void slack_cb(uv_timer_t* handle) {
+  ASSERT_LT(slack_cb_called, 2);
+  slack_cb_time[slack_cb_called++] = uv_now(handle->loop);
+}
+
+
+TEST_IMPL(timer_slack) {
+  uv_timer_t handle_a;
+  uv_timer_t handle_b;
+  uint64_t start;
+
+  ASSERT_EQ(0, uv_timer_init(uv_default_loop(), &handle_a));
+  ASSERT_EQ(0, uv_timer_init(uv_default_loop(), &handle_b));
+  ASSERT_EQ(0, uv_timer_get_slack(&handle_a));
+
+  uv_timer_set_slack(&handle_a, 100);
+  ASSERT_EQ(100, uv_timer_get_slack(&handle_a));
+
+  /* handle_a may be delayed until handle_b expires, they should run in
+   * the same loop iteration.
+   */
+  start = uv_now(uv_default_loop());
+  ASSERT_EQ(0, uv_timer_start(&handle_a, slack_cb, 10, 0));
+  ASSERT_EQ(0, uv_timer_start(&handle_b, slack_cb, 60, 0));
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT_EQ(2, slack_cb_called);
+  ASSERT_GE(slack_cb_time[0], start + 60);
+  ASSERT_EQ(slack_cb_time[0], slack_cb_time[1]);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#define HEAP_ORDER_TIMERS 1000
+
+static uv_timer_t heap_order_handles[HEAP_ORDER_TIMERS];
+static uint64_t heap_order_last;
+static int heap_order_called;
+
+
+static void heap_order_cb(uv_timer_t* handle) {
+  uint64_t timeout;
+  int i;
+
+  i = (int) (handle - heap_order_handles);
+  ASSERT_NE(0, i % 3);
+  timeout = (uint64_t) (uintptr_t) handle->data;
+  ASSERT_LE(heap_order_last, timeout);
+  heap_order_last = timeout;
+  heap_order_called++;
+}
+
+
+TEST_IMPL(timer_heap_order) {
+  uv_loop_t loop;
+  uint64_t timeout;
+  int i;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+
+  /* Enough timers to make the heap grow a few times, started in scrambled
+   * order. Every third one is stopped again, which takes timers out of the
+   * middle of the heap.
+   */
+  for (i = 0; i < HEAP_ORDER_TIMERS; i++) {
+    timeout = (i * 7919) % 64;
+    heap_order_handles[i].data = (void*) (uintptr_t) timeout;
+    ASSERT_EQ(0, uv_timer_init(&loop, &heap_order_handles[i]));
+    ASSERT_EQ(0, uv_timer_start(&heap_order_handles[i],
+                                heap_order_cb,
+                                timeout,
+                                0));
+  }
+
+  for (i = 0; i < HEAP_ORDER_TIMERS; i += 3)
+    ASSERT_EQ(0, uv_timer_stop(&heap_order_handles[i]));
+
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(HEAP_ORDER_TIMERS - (HEAP_ORDER_TIMERS + 2) / 3,
+            heap_order_called);
+
+  for (i = 0; i < HEAP_ORDER_TIMERS; i++)
+    uv_close((uv_handle_t*) &heap_order_handles[i], NULL);
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, uv_loop_close(&loop));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+static void start_many_cb(uv_timer_t* handle) {
+  uint64_t timeout;
+
+  timeout = (uint64_t) (uintptr_t) handle->data;
+  ASSERT_LE(heap_order_last, timeout);
+  heap_order_last = timeout;
+  heap_order_called++;
+}
+
+
+TEST_IMPL(timer_start_many) {
+  uv_timer_t* handles[HEAP_ORDER_TIMERS];
+  uint64_t timeouts[HEAP_ORDER_TIMERS];
+  uv_loop_t loop;
+  int i;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+
+  for (i = 0; i < HEAP_ORDER_TIMERS; i++) {
+    timeouts[i] = (i * 7919) % 64;
+    handles[i] = &heap_order_handles[i];
+    handles[i]->data = (void*) (uintptr_t) timeouts[i];
+    ASSERT_EQ(0, uv_timer_init(&loop, handles[i]));
+  }
+
+  ASSERT_EQ(0, uv_timer_start_many(handles, 0, start_many_cb, timeouts, 0));
+  ASSERT_EQ(UV_EINVAL, uv_timer_start_many(handles, 2, NULL, timeouts, 0));
+  handles[1] = NULL;
+  ASSERT_EQ(UV_EINVAL,
+            uv_timer_start_many(handles, 2, start_many_cb, timeouts, 0));
+  handles[1] = &heap_order_handles[1];
+  ASSERT_EQ(0, uv_is_active((uv_handle_t*) handles[0]));
+
+  /* A few on their own, then most of them in a batch that is large enough
+   * to be heapified, including ones that are already active. The last few
+   * make a batch that is small next to what's in the heap by then.
+   */
+  for (i = 0; i < 10; i++)
+    ASSERT_EQ(0, uv_timer_start(handles[i], start_many_cb, timeouts[i], 0));
+  ASSERT_EQ(0, uv_timer_start_many(handles + 5,
+                                   HEAP_ORDER_TIMERS - 20,
+                                   start_many_cb,
+                                   timeouts + 5,
+                                   0));
+  ASSERT_EQ(0, uv_timer_start_many(handles + HEAP_ORDER_TIMERS - 15,
+                                   15,
+                                   start_many_cb,
+                                   timeouts + HEAP_ORDER_TIMERS - 15,
+                                   0));
+  for (i = 0; i < HEAP_ORDER_TIMERS; i++)
+    ASSERT_EQ(1, uv_is_active((uv_handle_t*) handles[i]));
+
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(HEAP_ORDER_TIMERS, heap_order_called);
+
+  for (i = 0; i < HEAP_ORDER_TIMERS; i++)
+    uv_close((uv_handle_t*) handles[i], NULL);
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, uv_loop_close(&loop));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -311,6 +311,61 @@ TEST_IMPL(tty_large_write) {
   return 0;
 }
 
+static int buffered_write_cb_called;
+
+
+static void buffered_write_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+  buffered_write_cb_called++;
+}
+
+
+TEST_IMPL(tty_buffered_write) {
+  uv_write_t reqs[64];
+  uv_tty_t tty_out;
+  uv_buf_t buf;
+  HANDLE handle;
+  int ttyout_fd;
+  int i;
+
+  handle = CreateFileA("conout$",
+                       GENERIC_READ | GENERIC_WRITE,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE,
+                       NULL,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL,
+                       NULL);
+  ASSERT(handle != INVALID_HANDLE_VALUE);
+  ttyout_fd = _open_osfhandle((intptr_t) handle, 0);
+  ASSERT_GE(ttyout_fd, 0);
+
+  ASSERT_EQ(0, uv_tty_init(uv_default_loop(), &tty_out, ttyout_fd, 0));
+  ASSERT_EQ(UV_EINVAL, uv_tty_set_write_buffer(&tty_out, 64 << 20));
+  ASSERT_EQ(0, uv_tty_set_write_buffer(&tty_out, 256 * 1024));
+
+  buf = uv_buf_init("buffered\n", 9);
+  for (i = 0; i < (int) ARRAY_SIZE(reqs); i++)
+    ASSERT_EQ(0, uv_write(&reqs[i],
+                          (uv_stream_t*) &tty_out,
+                          &buf,
+                          1,
+                          buffered_write_cb));
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(ARRAY_SIZE(reqs), buffered_write_cb_called);
+
+  /* Back to unbuffered, uv_try_write() goes straight to the console. */
+  ASSERT_EQ(0, uv_tty_set_write_buffer(&tty_out, 0));
+  ASSERT_EQ(9, uv_try_write((uv_stream_t*) &tty_out, &buf, 1));
+
+  uv_close((uv_handle_t*) &tty_out, NULL);
+  uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
 TEST_IMPL(tty_raw_cancel) {
   int r;
   int ttyin_fd;
@@ -472,3 +527,84 @@ TEST_IMPL(tty_pty) {
 #endif
   return 0;
 }
+
+#if !defined(_WIN32)
+static int write_buffer_cb_called;
+
+
+static void write_buffer_cb(uv_write_t* req, int status) {
+  ASSERT_EQ(0, status);
+  write_buffer_cb_called++;
+}
+#endif
+
+TEST_IMPL(tty_write_buffer) {
+#if defined(__APPLE__)                            || \
+    defined(__DragonFly__)                        || \
+    defined(__FreeBSD__)                          || \
+    defined(__FreeBSD_kernel__)                   || \
+    (defined(__linux__) && !defined(__ANDROID__)) || \
+    defined(__NetBSD__)                           || \
+    defined(__OpenBSD__)
+  int master_fd, slave_fd;
+  uv_write_t reqs[3];
+  uv_loop_t loop;
+  uv_tty_t tty;
+  uv_buf_t buf;
+  char data[32];
+  ssize_t n;
+  ssize_t r;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+
+  if (openpty(&master_fd, &slave_fd, NULL, NULL, NULL) != 0)
+    RETURN_SKIP("No pty available, skipping.");
+
+  ASSERT_EQ(0, uv_tty_init(&loop, &tty, slave_fd, 0));
+  ASSERT_EQ(UV_EINVAL, uv_tty_set_write_buffer(&tty, 64 << 20));
+  ASSERT_EQ(0, uv_tty_set_write_buffer(&tty, 8));
+
+  /* Held back until the loop runs, then written out together. */
+  buf = uv_buf_init("abc", 3);
+  ASSERT_EQ(0, uv_write(reqs + 0, (uv_stream_t*) &tty, &buf, 1,
+                        write_buffer_cb));
+  ASSERT_EQ(0, uv_write(reqs + 1, (uv_stream_t*) &tty, &buf, 1,
+                        write_buffer_cb));
+  ASSERT_EQ(6, uv_stream_get_write_queue_size((uv_stream_t*) &tty));
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(2, write_buffer_cb_called);
+  ASSERT_EQ(0, uv_stream_get_write_queue_size((uv_stream_t*) &tty));
+
+  /* Past the size, the queue is written out right away. */
+  ASSERT_EQ(0, uv_write_copy((uv_stream_t*) &tty, &buf, 1));
+  ASSERT_EQ(3, uv_stream_get_write_queue_size((uv_stream_t*) &tty));
+  buf = uv_buf_init("defghi", 6);
+  ASSERT_EQ(0, uv_write_copy((uv_stream_t*) &tty, &buf, 1));
+  ASSERT_EQ(0, uv_stream_get_write_queue_size((uv_stream_t*) &tty));
+
+  /* Unbuffered again, written out immediately. */
+  ASSERT_EQ(0, uv_tty_set_write_buffer(&tty, 0));
+  buf = uv_buf_init("X", 1);
+  ASSERT_EQ(0, uv_write(reqs + 2, (uv_stream_t*) &tty, &buf, 1,
+                        write_buffer_cb));
+  ASSERT_EQ(0, uv_stream_get_write_queue_size((uv_stream_t*) &tty));
+
+  uv_close((uv_handle_t*) &tty, NULL);
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(3, write_buffer_cb_called);
+
+  for (n = 0; n < 16; n += r) {
+    r = read(master_fd, data + n, sizeof(data) - n);
+    ASSERT_GT(r, 0);
+  }
+  ASSERT_EQ(16, n);
+  ASSERT_MEM_EQ("abcabcabcdefghiX", data, 16);
+
+  ASSERT_EQ(0, close(slave_fd));
+  ASSERT_EQ(0, close(master_fd));
+  ASSERT_EQ(0, uv_loop_close(&loop));
+
+  MAKE_VALGRIND_HAPPY();
+#endif
+  return 0;
+}
@@ -140,3 +140,188 @@ TEST_IMPL(udp_mmsg) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+#define BATCH_WIDTH 50
+#define BATCH_MSG_SIZE 256
+#define BATCH_SENDS (2 * BATCH_WIDTH)
+
+
+static void batch_alloc_cb(uv_handle_t* handle,
+                           size_t suggested_size,
+                           uv_buf_t* buf) {
+  CHECK_HANDLE(handle);
+  ASSERT_EQ(suggested_size, BATCH_WIDTH * BATCH_MSG_SIZE);
+
+  buf->base = malloc(suggested_size);
+  ASSERT_NOT_NULL(buf->base);
+  buf->len = suggested_size;
+  alloc_cb_called++;
+}
+
+
+static void batch_recv_cb(uv_udp_t* handle,
+                          ssize_t nread,
+                          const uv_buf_t* rcvbuf,
+                          const struct sockaddr* addr,
+                          unsigned flags) {
+  ASSERT_GE(nread, 0);
+
+  if (flags & UV_UDP_MMSG_FREE) {
+    ASSERT_EQ(0, nread);
+    /* The new batch only applies to the next read. */
+    ASSERT_EQ(0, uv_udp_set_recvmmsg(handle, BATCH_WIDTH, BATCH_MSG_SIZE));
+    free(rcvbuf->base);
+    return;
+  }
+
+  if (nread == 0) {
+    free(rcvbuf->base);
+    return;
+  }
+
+  ASSERT(flags & UV_UDP_MMSG_CHUNK);
+  ASSERT_EQ(BATCH_MSG_SIZE, rcvbuf->len);
+  ASSERT_EQ(UV_EBUSY, uv_udp_set_recvmmsg(handle, 1, 1));
+  ASSERT_EQ(nread, 4);
+  ASSERT_MEM_EQ("PING", rcvbuf->base, nread);
+
+  recv_cb_called++;
+  if (recv_cb_called == BATCH_SENDS) {
+    uv_close((uv_handle_t*)handle, close_cb);
+    uv_close((uv_handle_t*)&sender, close_cb);
+  }
+}
+
+
+TEST_IMPL(udp_mmsg_batch) {
+  struct sockaddr_in addr;
+  uv_buf_t buf;
+  int i;
+
+  ASSERT_EQ(0, uv_ip4_addr("0.0.0.0", TEST_PORT, &addr));
+
+  ASSERT_EQ(0, uv_udp_init(uv_default_loop(), &sender));
+  ASSERT_EQ(0, uv_udp_init_ex(uv_default_loop(), &recver,
+                              AF_UNSPEC | UV_UDP_RECVMMSG));
+
+  if (!uv_udp_using_recvmmsg(&recver)) {
+    ASSERT(uv_udp_set_recvmmsg(&recver, BATCH_WIDTH, BATCH_MSG_SIZE) < 0);
+    uv_close((uv_handle_t*) &recver, NULL);
+    uv_close((uv_handle_t*) &sender, NULL);
+    ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("recvmmsg() is not supported on this platform");
+  }
+
+  ASSERT_EQ(UV_ENOTSUP,
+            uv_udp_set_recvmmsg(&sender, BATCH_WIDTH, BATCH_MSG_SIZE));
+  ASSERT_EQ(UV_EINVAL, uv_udp_set_recvmmsg(&recver, 0, BATCH_MSG_SIZE));
+  ASSERT_EQ(UV_EINVAL, uv_udp_set_recvmmsg(&recver, 1 << 20, 1));
+  ASSERT_EQ(UV_EINVAL, uv_udp_set_recvmmsg(&recver, BATCH_WIDTH, 0));
+  ASSERT_EQ(UV_EINVAL,
+            uv_udp_set_recvmmsg(&recver, BATCH_WIDTH, MAX_DGRAM_SIZE + 1));
+  /* Shrinking reuses the arrays of a wider batch. */
+  ASSERT_EQ(0, uv_udp_set_recvmmsg(&recver, 2 * BATCH_WIDTH, 1500));
+  ASSERT_EQ(0, uv_udp_set_recvmmsg(&recver, BATCH_WIDTH, BATCH_MSG_SIZE));
+
+  ASSERT_EQ(0, uv_udp_bind(&recver, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_udp_recv_start(&recver, batch_alloc_cb, batch_recv_cb));
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+
+  buf = uv_buf_init("PING", 4);
+  for (i = 0; i < BATCH_SENDS; i++) {
+    ASSERT_EQ(4, uv_udp_try_send(&sender, &buf, 1, (const struct sockaddr*) &addr));
+  }
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT_EQ(close_cb_called, 2);
+  ASSERT_EQ(recv_cb_called, BATCH_SENDS);
+  ASSERT_EQ(alloc_cb_called, BATCH_SENDS / BATCH_WIDTH);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
+
+
+#define DEPTH 8
+#define DEPTH_SENDS (3 * DEPTH)
+
+
+static void depth_alloc_cb(uv_handle_t* handle,
+                           size_t suggested_size,
+                           uv_buf_t* buf) {
+  CHECK_HANDLE(handle);
+  buf->base = malloc(suggested_size);
+  ASSERT_NOT_NULL(buf->base);
+  buf->len = suggested_size;
+}
+
+
+static void depth_recv_cb(uv_udp_t* handle,
+                          ssize_t nread,
+                          const uv_buf_t* rcvbuf,
+                          const struct sockaddr* addr,
+                          unsigned flags) {
+  ASSERT_GE(nread, 0);
+
+  if (nread == 0) {
+    free(rcvbuf->base);
+    return;
+  }
+
+  ASSERT_EQ(4, nread);
+  ASSERT_MEM_EQ("PING", rcvbuf->base, nread);
+  ASSERT_NOT_NULL(addr);
+  free(rcvbuf->base);
+
+  recv_cb_called++;
+  if (recv_cb_called == DEPTH_SENDS) {
+    uv_close((uv_handle_t*) handle, close_cb);
+    uv_close((uv_handle_t*) &sender, close_cb);
+  }
+}
+
+
+TEST_IMPL(udp_recv_depth) {
+  struct sockaddr_in addr;
+  uv_buf_t buf;
+  int i;
+
+  ASSERT_EQ(0, uv_ip4_addr("0.0.0.0", TEST_PORT, &addr));
+
+  ASSERT_EQ(0, uv_udp_init(uv_default_loop(), &sender));
+  ASSERT_EQ(0, uv_udp_init(uv_default_loop(), &recver));
+
+  ASSERT_EQ(UV_EINVAL, uv_udp_set_recv_depth(&recver, 0));
+  ASSERT_EQ(UV_EINVAL, uv_udp_set_recv_depth(&recver, 1 << 20));
+  ASSERT_EQ(0, uv_udp_set_recv_depth(&recver, 2));
+  ASSERT_EQ(0, uv_udp_set_recv_depth(&recver, DEPTH));
+
+  ASSERT_EQ(0, uv_udp_bind(&recver, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_udp_recv_start(&recver, depth_alloc_cb, depth_recv_cb));
+#ifdef _WIN32
+  ASSERT_EQ(UV_EBUSY, uv_udp_set_recv_depth(&recver, 1));
+#endif
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+
+  /* More datagrams than receives, the slots get posted again. */
+  buf = uv_buf_init("PING", 4);
+  for (i = 0; i < DEPTH_SENDS; i++) {
+    ASSERT_EQ(4, uv_udp_try_send(&sender,
+                                 &buf,
+                                 1,
+                                 (const struct sockaddr*) &addr));
+  }
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT_EQ(2, close_cb_called);
+  ASSERT_EQ(DEPTH_SENDS, recv_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
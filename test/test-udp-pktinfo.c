@@ -0,0 +1,186 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+static uv_udp_t server;
+static uv_udp_t client;
+static uv_udp_send_t send_req;
+static uv_udp_send_t reply_req;
+static int server_recv_cb_called;
+static int client_recv_cb_called;
+static int send_cb_called;
+static int close_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle,
+                     size_t suggested_size,
+                     uv_buf_t* buf) {
+  static char slab[65536];
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void send_cb(uv_udp_send_t* req, int status) {
+  ASSERT_EQ(0, status);
+  send_cb_called++;
+}
+
+
+static void server_recv_cb(uv_udp_t* handle,
+                           ssize_t nread,
+                           const uv_buf_t* buf,
+                           const struct sockaddr* addr,
+                           unsigned flags) {
+  struct sockaddr_storage dst;
+  struct sockaddr_in* in;
+  char ip[INET_ADDRSTRLEN];
+  uv_buf_t reply;
+  int len;
+
+  ASSERT_GE(nread, 0);
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(4, nread);
+  ASSERT_EQ(0, memcmp(buf->base, "PING", 4));
+
+  /* The handle is bound to 0.0.0.0 but the datagram went to 127.0.0.3. */
+  len = 1;
+  ASSERT_EQ(UV_ENOBUFS, uv_udp_get_recv_dstaddr(handle,
+                                                (struct sockaddr*) &dst,
+                                                &len));
+  len = sizeof(dst);
+  ASSERT_EQ(0, uv_udp_get_recv_dstaddr(handle,
+                                       (struct sockaddr*) &dst,
+                                       &len));
+  ASSERT_EQ(sizeof(*in), len);
+  in = (struct sockaddr_in*) &dst;
+  ASSERT_EQ(AF_INET, in->sin_family);
+  ASSERT_EQ(TEST_PORT, ntohs(in->sin_port));
+  ASSERT_EQ(0, uv_ip4_name(in, ip, sizeof(ip)));
+  ASSERT_EQ(0, strcmp("127.0.0.3", ip));
+  server_recv_cb_called++;
+
+  /* Answer from that address, rather than from 127.0.0.1. */
+  reply = uv_buf_init("PONG", 4);
+  ASSERT_EQ(0, uv_udp_send_from(&reply_req, handle, &reply, 1, addr,
+                                (const struct sockaddr*) &dst, send_cb));
+}
+
+
+static void client_recv_cb(uv_udp_t* handle,
+                           ssize_t nread,
+                           const uv_buf_t* buf,
+                           const struct sockaddr* addr,
+                           unsigned flags) {
+  struct sockaddr_storage dst;
+  char ip[INET_ADDRSTRLEN];
+  int len;
+
+  ASSERT_GE(nread, 0);
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(4, nread);
+  ASSERT_EQ(0, memcmp(buf->base, "PONG", 4));
+  ASSERT_NOT_NULL(addr);
+  ASSERT_EQ(AF_INET, addr->sa_family);
+  ASSERT_EQ(TEST_PORT, ntohs(((const struct sockaddr_in*) addr)->sin_port));
+  ASSERT_EQ(0, uv_ip4_name((const struct sockaddr_in*) addr, ip, sizeof(ip)));
+  ASSERT_EQ(0, strcmp("127.0.0.3", ip));
+
+  len = sizeof(dst);
+  ASSERT_EQ(UV_EINVAL, uv_udp_get_recv_dstaddr(handle,
+                                               (struct sockaddr*) &dst,
+                                               &len));
+  client_recv_cb_called++;
+
+  uv_close((uv_handle_t*) &server, close_cb);
+  uv_close((uv_handle_t*) &client, close_cb);
+}
+
+
+TEST_IMPL(udp_pktinfo) {
+  struct sockaddr_storage dst;
+  struct sockaddr_in addr;
+  struct sockaddr_in bad;
+  uv_buf_t buf;
+  int len;
+  int err;
+
+  /* recvmmsg() on the server, plain recvmsg() on the client. */
+  ASSERT_EQ(0, uv_udp_init_ex(uv_default_loop(), &server, UV_UDP_RECVMMSG));
+  ASSERT_EQ(0, uv_ip4_addr("0.0.0.0", TEST_PORT, &addr));
+  err = uv_udp_bind(&server, (const struct sockaddr*) &addr, UV_UDP_PKTINFO);
+  if (err == UV_ENOTSUP) {
+    uv_close((uv_handle_t*) &server, NULL);
+    ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("UV_UDP_PKTINFO is not supported on this platform");
+  }
+  ASSERT_EQ(0, err);
+
+  len = sizeof(dst);
+  ASSERT_EQ(UV_ENOENT, uv_udp_get_recv_dstaddr(&server,
+                                               (struct sockaddr*) &dst,
+                                               &len));
+  ASSERT_EQ(0, uv_udp_recv_start(&server, alloc_cb, server_recv_cb));
+
+  ASSERT_EQ(0, uv_udp_init(uv_default_loop(), &client));
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", 0, &addr));
+  ASSERT_EQ(0, uv_udp_bind(&client, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_udp_recv_start(&client, alloc_cb, client_recv_cb));
+
+  /* Only IPv4 and IPv6 sources. */
+  memset(&bad, 0, sizeof(bad));
+  bad.sin_family = AF_UNIX;
+  buf = uv_buf_init("PING", 4);
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.3", TEST_PORT, &addr));
+  ASSERT_EQ(UV_EINVAL, uv_udp_send_from(&send_req, &client, &buf, 1,
+                                        (const struct sockaddr*) &addr,
+                                        (const struct sockaddr*) &bad,
+                                        send_cb));
+
+  /* A NULL source is a plain uv_udp_send(). */
+  ASSERT_EQ(0, uv_udp_send_from(&send_req, &client, &buf, 1,
+                                (const struct sockaddr*) &addr, NULL,
+                                send_cb));
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT_EQ(1, server_recv_cb_called);
+  ASSERT_EQ(1, client_recv_cb_called);
+  ASSERT_EQ(2, send_cb_called);
+  ASSERT_EQ(2, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,139 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define SEGMENT_SIZE 100
+#define PAYLOAD_SIZE (10 * SEGMENT_SIZE + 50)
+
+static uv_udp_t server;
+static uv_udp_t client;
+static uv_udp_send_t send_reqs[2];
+static char payload[PAYLOAD_SIZE];
+static size_t received;
+static int coalesced;
+static int send_cb_called;
+static int close_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle,
+                     size_t suggested_size,
+                     uv_buf_t* buf) {
+  static char slab[65536];
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void recv_cb(uv_udp_t* handle,
+                    ssize_t nread,
+                    const uv_buf_t* buf,
+                    const struct sockaddr* addr,
+                    unsigned flags) {
+  ASSERT(nread >= 0);
+  ASSERT_EQ(0, flags & UV_UDP_PARTIAL);
+  if (nread == 0) {
+    ASSERT_EQ(0, uv_udp_get_recv_segment_size(handle));
+    return;
+  }
+
+  if (received == PAYLOAD_SIZE) {
+    /* The plain datagram sent after the segmented one is never merged. */
+    ASSERT_EQ(4, nread);
+    ASSERT_EQ(0, flags & UV_UDP_GRO_SEGMENTS);
+    ASSERT_EQ(0, uv_udp_get_recv_segment_size(handle));
+    ASSERT_EQ(0, memcmp(buf->base, "PING", 4));
+    uv_close((uv_handle_t*) &server, close_cb);
+    uv_close((uv_handle_t*) &client, close_cb);
+    return;
+  }
+
+  if (flags & UV_UDP_GRO_SEGMENTS) {
+    ASSERT_EQ(SEGMENT_SIZE, uv_udp_get_recv_segment_size(handle));
+    coalesced++;
+  } else {
+    ASSERT_EQ(0, uv_udp_get_recv_segment_size(handle));
+    ASSERT(nread <= SEGMENT_SIZE);
+  }
+
+  ASSERT(received + nread <= PAYLOAD_SIZE);
+  ASSERT_EQ(0, memcmp(buf->base, payload + received, nread));
+  received += nread;
+}
+
+
+static void send_cb(uv_udp_send_t* req, int status) {
+  ASSERT_EQ(0, status);
+  send_cb_called++;
+}
+
+
+TEST_IMPL(udp_recv_gro) {
+  struct sockaddr_in addr;
+  uv_buf_t buf;
+  int err;
+  int i;
+
+  for (i = 0; i < PAYLOAD_SIZE; i++)
+    payload[i] = i % 251;
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_udp_init(uv_default_loop(), &server));
+  ASSERT_EQ(0, uv_udp_bind(&server,
+                           (const struct sockaddr*) &addr,
+                           UV_UDP_LINUX_GRO));
+  ASSERT_EQ(0, uv_udp_recv_start(&server, alloc_cb, recv_cb));
+  ASSERT_EQ(0, uv_udp_init(uv_default_loop(), &client));
+
+  buf = uv_buf_init(payload, sizeof(payload));
+  err = uv_udp_send_segmented(&send_reqs[0], &client, &buf, SEGMENT_SIZE,
+                              (const struct sockaddr*) &addr, send_cb);
+  if (err == UV_ENOSYS) {
+    uv_close((uv_handle_t*) &server, NULL);
+    uv_close((uv_handle_t*) &client, NULL);
+    ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("uv_udp_send_segmented() is not supported on this platform");
+  }
+  ASSERT_EQ(0, err);
+
+  buf = uv_buf_init("PING", 4);
+  ASSERT_EQ(0, uv_udp_send(&send_reqs[1], &client, &buf, 1,
+                           (const struct sockaddr*) &addr, send_cb));
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT_EQ(2, send_cb_called);
+  ASSERT_EQ(PAYLOAD_SIZE, received);
+  ASSERT_EQ(2, close_cb_called);
+  ASSERT(coalesced <= 1);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,125 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define NUM_CLIENTS 16
+
+static uv_udp_t servers[2];
+static uv_udp_t plain;
+static uv_udp_t clients[NUM_CLIENTS];
+static int received;
+static int close_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle,
+                     size_t suggested_size,
+                     uv_buf_t* buf) {
+  static char slab[65536];
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void recv_cb(uv_udp_t* handle,
+                    ssize_t nread,
+                    const uv_buf_t* buf,
+                    const struct sockaddr* addr,
+                    unsigned flags) {
+  ASSERT(nread >= 0);
+  if (nread == 0)
+    return;
+
+  ASSERT(handle == &servers[0] || handle == &servers[1]);
+  ASSERT_EQ(4, nread);
+  ASSERT_EQ(0, memcmp(buf->base, "PING", 4));
+  received++;
+}
+
+
+TEST_IMPL(udp_reuseport) {
+  struct sockaddr_in addr;
+  uv_loop_t* loop;
+  uv_buf_t buf;
+  int err;
+  int i;
+
+  loop = uv_default_loop();
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+
+  ASSERT_EQ(0, uv_udp_init(loop, &servers[0]));
+  err = uv_udp_bind(&servers[0], (const struct sockaddr*) &addr,
+                    UV_UDP_REUSEPORT);
+  if (err == UV_ENOTSUP) {
+    uv_close((uv_handle_t*) &servers[0], NULL);
+    ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("UV_UDP_REUSEPORT is not supported on this platform");
+  }
+  ASSERT_EQ(0, err);
+
+  err = uv_udp_reuseport_steer_by_cpu(&servers[0]);
+  ASSERT(err == 0 || err == UV_ENOSYS);
+
+  ASSERT_EQ(0, uv_udp_init(loop, &servers[1]));
+  ASSERT_EQ(0, uv_udp_bind(&servers[1], (const struct sockaddr*) &addr,
+                           UV_UDP_REUSEPORT));
+
+  /* Without the flag the address is still taken. */
+  ASSERT_EQ(0, uv_udp_init(loop, &plain));
+  ASSERT_EQ(UV_EADDRINUSE,
+            uv_udp_bind(&plain, (const struct sockaddr*) &addr, 0));
+
+  for (i = 0; i < 2; i++)
+    ASSERT_EQ(0, uv_udp_recv_start(&servers[i], alloc_cb, recv_cb));
+
+  /* Each client has its own source port, so a hash spreads them. */
+  buf = uv_buf_init("PING", 4);
+  for (i = 0; i < NUM_CLIENTS; i++) {
+    ASSERT_EQ(0, uv_udp_init(loop, &clients[i]));
+    ASSERT_EQ(4, uv_udp_try_send(&clients[i], &buf, 1,
+                                 (const struct sockaddr*) &addr));
+  }
+
+  while (received < NUM_CLIENTS)
+    ASSERT(uv_run(loop, UV_RUN_ONCE) >= 0);
+
+  for (i = 0; i < NUM_CLIENTS; i++)
+    uv_close((uv_handle_t*) &clients[i], close_cb);
+  uv_close((uv_handle_t*) &servers[0], close_cb);
+  uv_close((uv_handle_t*) &servers[1], close_cb);
+  uv_close((uv_handle_t*) &plain, close_cb);
+
+  ASSERT_EQ(0, uv_run(loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_CLIENTS, received);
+  ASSERT_EQ(3 + NUM_CLIENTS, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,103 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define NUM_SENDS 64
+
+static uv_udp_t recver;
+static uv_udp_t sender;
+static char slab[4096];
+static int recv_cb_called;
+static int close_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle,
+                     size_t suggested_size,
+                     uv_buf_t* buf) {
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void recv_cb(uv_udp_t* handle,
+                    ssize_t nread,
+                    const uv_buf_t* buf,
+                    const struct sockaddr* addr,
+                    unsigned flags) {
+  if (nread == 0)
+    return;
+
+  ASSERT_EQ(4, nread);
+  ASSERT_NOT_NULL(addr);
+  ASSERT_EQ(0, flags & UV_UDP_PARTIAL);
+  ASSERT_MEM_EQ("PING", buf->base, 4);
+
+  /* Stopping and restarting keeps the datagrams that are queued. */
+  if (++recv_cb_called == NUM_SENDS / 2) {
+    ASSERT_EQ(0, uv_udp_recv_stop(handle));
+    ASSERT_EQ(0, uv_udp_recv_start(handle, alloc_cb, recv_cb));
+  }
+
+  if (recv_cb_called == NUM_SENDS) {
+    uv_close((uv_handle_t*) handle, close_cb);
+    uv_close((uv_handle_t*) &sender, close_cb);
+  }
+}
+
+
+TEST_IMPL(udp_rio) {
+  struct sockaddr_in addr;
+  uv_buf_t buf;
+  int i;
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+
+  /* Works the same where there's no registered I/O. */
+  ASSERT_EQ(0, uv_udp_init_ex(uv_default_loop(),
+                              &recver,
+                              AF_INET | UV_UDP_RIO));
+  ASSERT_EQ(0, uv_udp_bind(&recver, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_udp_recv_start(&recver, alloc_cb, recv_cb));
+
+  ASSERT_EQ(0, uv_udp_init(uv_default_loop(), &sender));
+  buf = uv_buf_init("PING", 4);
+  for (i = 0; i < NUM_SENDS; i++)
+    ASSERT_EQ(4, uv_udp_try_send(&sender,
+                                 &buf,
+                                 1,
+                                 (const struct sockaddr*) &addr));
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+  ASSERT_EQ(NUM_SENDS, recv_cb_called);
+  ASSERT_EQ(2, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -0,0 +1,147 @@
+/* Copyright libuv project contributors. All rights reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include "uv.h"
+#include "task.h"
+
+#include <string.h>
+
+#define SEGMENT_SIZE 100
+#define PAYLOAD_SIZE (10 * SEGMENT_SIZE + 50)
+#define NUM_DATAGRAMS (2 * 11 + 1)
+
+static uv_udp_t server;
+static uv_udp_t client;
+static uv_udp_send_t send_reqs[3];
+static char payload[PAYLOAD_SIZE];
+static int datagrams;
+static int send_cb_called;
+static int close_cb_called;
+
+
+static void alloc_cb(uv_handle_t* handle,
+                     size_t suggested_size,
+                     uv_buf_t* buf) {
+  static char slab[65536];
+  buf->base = slab;
+  buf->len = sizeof(slab);
+}
+
+
+static void close_cb(uv_handle_t* handle) {
+  close_cb_called++;
+}
+
+
+static void recv_cb(uv_udp_t* handle,
+                    ssize_t nread,
+                    const uv_buf_t* buf,
+                    const struct sockaddr* addr,
+                    unsigned flags) {
+  size_t offset;
+  int i;
+
+  ASSERT(nread >= 0);
+  if (nread == 0)
+    return;
+
+  /* Segments of the first request, the plain datagram, then the second
+   * request again.
+   */
+  i = datagrams++;
+  if (i == 11) {
+    ASSERT_EQ(4, nread);
+    ASSERT_EQ(0, memcmp(buf->base, "PING", 4));
+  } else {
+    if (i > 11)
+      i -= 12;
+    offset = i * SEGMENT_SIZE;
+    ASSERT_EQ(i < 10 ? SEGMENT_SIZE : 50, nread);
+    ASSERT_EQ(0, memcmp(buf->base, payload + offset, nread));
+  }
+
+  if (datagrams == NUM_DATAGRAMS) {
+    uv_close((uv_handle_t*) &server, close_cb);
+    uv_close((uv_handle_t*) &client, close_cb);
+  }
+}
+
+
+static void send_cb(uv_udp_send_t* req, int status) {
+  ASSERT_EQ(0, status);
+  ASSERT_PTR_EQ(&send_reqs[send_cb_called], req);
+  send_cb_called++;
+}
+
+
+TEST_IMPL(udp_send_segmented) {
+  struct sockaddr_in addr;
+  uv_udp_send_t req;
+  uv_buf_t buf;
+  int err;
+  int i;
+
+  for (i = 0; i < PAYLOAD_SIZE; i++)
+    payload[i] = i % 251;
+
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_udp_init(uv_default_loop(), &server));
+  ASSERT_EQ(0, uv_udp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_udp_recv_start(&server, alloc_cb, recv_cb));
+  ASSERT_EQ(0, uv_udp_init(uv_default_loop(), &client));
+
+  buf = uv_buf_init(payload, sizeof(payload));
+  err = uv_udp_send_segmented(&req, &client, &buf, 0,
+                              (const struct sockaddr*) &addr, send_cb);
+  if (err == UV_ENOSYS) {
+    uv_close((uv_handle_t*) &server, NULL);
+    uv_close((uv_handle_t*) &client, NULL);
+    ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+    MAKE_VALGRIND_HAPPY();
+    RETURN_SKIP("uv_udp_send_segmented() is not supported on this platform");
+  }
+  ASSERT_EQ(UV_EINVAL, err);
+  ASSERT_EQ(UV_EMSGSIZE, uv_udp_send_segmented(&req, &client, &buf, 10,
+                                               (const struct sockaddr*) &addr,
+                                               send_cb));
+
+  ASSERT_EQ(0, uv_udp_send_segmented(&send_reqs[0], &client, &buf,
+                                     SEGMENT_SIZE,
+                                     (const struct sockaddr*) &addr,
+                                     send_cb));
+  buf = uv_buf_init("PING", 4);
+  ASSERT_EQ(0, uv_udp_send(&send_reqs[1], &client, &buf, 1,
+                           (const struct sockaddr*) &addr, send_cb));
+  buf = uv_buf_init(payload, sizeof(payload));
+  ASSERT_EQ(0, uv_udp_send_segmented(&send_reqs[2], &client, &buf,
+                                     SEGMENT_SIZE,
+                                     (const struct sockaddr*) &addr,
+                                     send_cb));
+
+  ASSERT_EQ(0, uv_run(uv_default_loop(), UV_RUN_DEFAULT));
+
+  ASSERT_EQ(3, send_cb_called);
+  ASSERT_EQ(NUM_DATAGRAMS, datagrams);
+  ASSERT_EQ(2, close_cb_called);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
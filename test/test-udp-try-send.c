@@ -119,3 +119,90 @@ TEST_IMPL(udp_try_send) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+#define BATCH_SIZE 200
+
+static int batch_received;
+
+
+static void batch_recv_cb(uv_udp_t* handle,
+                          ssize_t nread,
+                          const uv_buf_t* rcvbuf,
+                          const struct sockaddr* addr,
+                          unsigned flags) {
+  ASSERT(nread >= 0);
+
+  if (nread == 0)
+    return;
+
+  /* Datagrams arrive in the order of the batch. */
+  ASSERT(nread == sizeof(batch_received));
+  ASSERT(memcmp(&batch_received, rcvbuf->base, nread) == 0);
+
+  if (++batch_received == BATCH_SIZE) {
+    uv_close((uv_handle_t*) handle, close_cb);
+    uv_close((uv_handle_t*) &client, close_cb);
+  }
+}
+
+
+TEST_IMPL(udp_try_send_batch) {
+  static int payloads[BATCH_SIZE];
+  uv_buf_t bufs[BATCH_SIZE];
+  const struct sockaddr* addrs[BATCH_SIZE];
+  struct sockaddr_in addr;
+  struct sockaddr bad_addr;
+  int r;
+  int i;
+
+  ASSERT(0 == uv_ip4_addr("0.0.0.0", TEST_PORT, &addr));
+
+  r = uv_udp_init(uv_default_loop(), &server);
+  ASSERT(r == 0);
+
+  r = uv_udp_bind(&server, (const struct sockaddr*) &addr, 0);
+  ASSERT(r == 0);
+
+  r = uv_udp_recv_start(&server, alloc_cb, batch_recv_cb);
+  ASSERT(r == 0);
+
+  ASSERT(0 == uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+
+  r = uv_udp_init(uv_default_loop(), &client);
+  ASSERT(r == 0);
+
+  for (i = 0; i < BATCH_SIZE; i++) {
+    payloads[i] = i;
+    bufs[i] = uv_buf_init((char*) &payloads[i], sizeof(payloads[i]));
+    addrs[i] = (const struct sockaddr*) &addr;
+  }
+
+  r = uv_udp_try_send_batch(&client, bufs, addrs, 0);
+  ASSERT(r == UV_EINVAL);
+
+  r = uv_udp_try_send_batch(&client, bufs, NULL, BATCH_SIZE);
+  ASSERT(r == UV_EDESTADDRREQ);
+
+  /* One bad address fails the whole batch before anything is sent. */
+  memset(&bad_addr, 0, sizeof(bad_addr));
+  bad_addr.sa_family = AF_UNSPEC;
+  addrs[BATCH_SIZE - 1] = &bad_addr;
+  r = uv_udp_try_send_batch(&client, bufs, addrs, BATCH_SIZE);
+  ASSERT(r == UV_EINVAL);
+  addrs[BATCH_SIZE - 1] = (const struct sockaddr*) &addr;
+
+  r = uv_udp_try_send_batch(&client, bufs, addrs, BATCH_SIZE);
+  ASSERT(r == BATCH_SIZE);
+
+  uv_run(uv_default_loop(), UV_RUN_DEFAULT);
+
+  ASSERT(close_cb_called == 2);
+  ASSERT(batch_received == BATCH_SIZE);
+
+  ASSERT(client.send_queue_size == 0);
+  ASSERT(server.send_queue_size == 0);
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}
@@ -75,3 +75,82 @@ TEST_IMPL(walk_handles) {
   MAKE_VALGRIND_HAPPY();
   return 0;
 }
+
+
+static void snapshot_timer_cb(uv_timer_t* handle) {
+  ASSERT(0 && "should not be called");
+}
+
+
+TEST_IMPL(loop_snapshot) {
+  uv_handle_snapshot_t handles[8];
+  uv_handle_snapshot_t* s;
+  struct sockaddr_in addr;
+  uv_loop_t loop;
+  uv_timer_t t;
+  uv_idle_t idle;
+  uv_tcp_t server;
+  uv_os_fd_t fd;
+  size_t count;
+  size_t total;
+  size_t i;
+  int seen;
+
+  ASSERT_EQ(0, uv_loop_init(&loop));
+  ASSERT_EQ(0, uv_idle_init(&loop, &idle));
+  ASSERT_EQ(0, uv_timer_init(&loop, &t));
+  ASSERT_EQ(0, uv_timer_start(&t, snapshot_timer_cb, 10000, 500));
+  ASSERT_EQ(0, uv_ip4_addr("127.0.0.1", TEST_PORT, &addr));
+  ASSERT_EQ(0, uv_tcp_init(&loop, &server));
+  ASSERT_EQ(0, uv_tcp_bind(&server, (const struct sockaddr*) &addr, 0));
+  ASSERT_EQ(0, uv_listen((uv_stream_t*) &server, 1, NULL));
+  uv_unref((uv_handle_t*) &server);
+
+  count = 0;
+  ASSERT_EQ(UV_EINVAL, uv_loop_snapshot(&loop, NULL, NULL));
+  ASSERT_EQ(UV_ENOBUFS, uv_loop_snapshot(&loop, NULL, &count));
+  ASSERT_GE(count, 2);
+  total = count;
+
+  count = 1;
+  ASSERT_EQ(UV_ENOBUFS, uv_loop_snapshot(&loop, handles, &count));
+  ASSERT_EQ(count, total);
+
+  count = ARRAY_SIZE(handles);
+  ASSERT_EQ(0, uv_loop_snapshot(&loop, handles, &count));
+  ASSERT_EQ(count, total);
+
+  seen = 0;
+  for (i = 0; i < count; i++) {
+    s = &handles[i];
+    ASSERT(s->flags & UV_SNAPSHOT_ACTIVE);
+    ASSERT(s->handle != (uv_handle_t*) &idle);
+
+    if (s->handle == (uv_handle_t*) &t) {
+      ASSERT_EQ(s->type, UV_TIMER);
+      ASSERT_EQ(s->flags, UV_SNAPSHOT_ACTIVE | UV_SNAPSHOT_REF);
+      ASSERT_EQ(s->timer_due, uv_now(&loop) + 10000);
+      ASSERT_EQ(s->timer_repeat, 500);
+      seen |= 1;
+    } else if (s->handle == (uv_handle_t*) &server) {
+      ASSERT_EQ(s->type, UV_TCP);
+      ASSERT_EQ(s->flags, UV_SNAPSHOT_ACTIVE);
+      ASSERT_EQ(0, uv_fileno(s->handle, &fd));
+      ASSERT_EQ(s->fd, fd);
+      ASSERT_EQ(s->write_queue_size, 0);
+      seen |= 2;
+    } else {
+      ASSERT(s->flags & UV_SNAPSHOT_INTERNAL);
+    }
+  }
+  ASSERT_EQ(seen, 3);
+
+  uv_close((uv_handle_t*) &t, NULL);
+  uv_close((uv_handle_t*) &idle, NULL);
+  uv_close((uv_handle_t*) &server, NULL);
+  ASSERT_EQ(0, uv_run(&loop, UV_RUN_DEFAULT));
+  ASSERT_EQ(0, uv_loop_close(&loop));
+
+  MAKE_VALGRIND_HAPPY();
+  return 0;
+}